@@ -13,8 +13,8 @@
 // limitations under the License.
 
 #include "application_sandbox/sample_application_framework/sample_application.h"
-#include "support/containers/deque.h"
 #include "support/entry/entry.h"
+#include "support/trace/trace.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
 #include "vulkan_helpers/vulkan_application.h"
@@ -23,11 +23,10 @@
 
 #include "particle_data_shared.h"
 
+#include <atomic>
 #include <chrono>
 
-#include <condition_variable>
 #include <functional>
-#include <mutex>
 #include <thread>
 
 namespace quad_model {
@@ -57,6 +56,7 @@ namespace particle_texture {
 
 const auto& texture_data = particle_texture::texture;
 
+// The simulation results are triple buffered, see ASyncThreadRunner.
 const size_t kNumAsyncComputeBuffers = 3;
 struct time_data {
   int32_t frame_number;
@@ -76,10 +76,20 @@ struct time_data {
 // The AsyncThreadRunner actually is responsible for updating the simulation.
 // It has 2 sets of buffers. The first is the simulation data. At the
 // moment this is velocity and position for every particle.
-// The second is a set of N buffers that are used for passing the data
-// to the main thread for rendering. In order to minimize the potential for
-// the simulation and rendering threads blocking each other, we use 3 buffers
-// in mailbox mode.
+// The second is a set of 3 buffers that are used for passing the data
+// to the main thread for rendering, as a triple buffer: at any time, the
+// simulation writes to one of them, the main thread renders from another,
+// and the newest simulated one waits in the mailbox. Both threads swap their
+// buffer with the one in the mailbox with a single atomic exchange, so
+// neither ever waits for the other.
+//
+// The GPU work is ordered with one timeline semaphore per buffer. Every
+// submit that uses a buffer waits for the last value that was signaled for
+// it, by either queue, and signals the next one. So the simulation into a
+// buffer waits for the last frame that rendered from it, and the frames
+// that render from it wait for the simulation, all on the GPU. The buffers
+// are shared by both queue families, so they do not need ownership
+// transfers either.
 
 // In order for our data-dependencies for the N-Body simulation to work properly
 // we split the actual simulation into 2 compute passes, with a
@@ -90,22 +100,24 @@ struct time_data {
 class ASyncThreadRunner {
  public:
   ASyncThreadRunner(containers::Allocator* allocator,
-                    vulkan::VulkanApplication* app,
-                    uint32_t num_async_compute_buffers)
-      : allocator_(allocator),
-        ready_buffers_(allocator),
-        returned_buffers_(allocator),
-        data_(allocator),
-        app_(app),
-        mailbox_buffer_(-1),
+                    vulkan::VulkanApplication* app)
+      : data_(allocator),
+        allocator_(allocator),
         last_update_time_(std::chrono::high_resolution_clock::now()),
+        // The simulation starts with buffer 0, and the main thread with
+        // buffer 2, which it never renders from.
+        mailbox_(1),
+        simulation_buffer_(0),
+        render_buffer_(2),
+        first_data_ready_(false),
+        app_(app),
         exit_(false) {
     if (!app_->async_compute_queue()) {
       return;
     }
 
     update_time_data_ = containers::make_unique<vulkan::BufferFrameData<Mat44>>(
-        allocator_, app_, num_async_compute_buffers,
+        allocator_, app_, kNumAsyncComputeBuffers,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0, app_->async_compute_queue()->index());
 
     // Both compute passes use the same set of descriptors for simplicity.
@@ -216,10 +228,13 @@ class ASyncThreadRunner {
 
     uint32_t queue_family_indices[2] = {app_->render_queue().index(),
                                         app_->async_compute_queue()->index()};
+    // Concurrent sharing needs two different families.
+    const bool concurrent =
+        queue_family_indices[0] != queue_family_indices[1];
 
     // For each async compute buffer, we have to create the output SSBO,
-    // the command_buffers, descriptor sets, and some synchronization data.
-    for (size_t i = 0; i < num_async_compute_buffers; ++i) {
+    // the command_buffers, descriptor sets, and the timeline semaphore.
+    for (size_t i = 0; i < kNumAsyncComputeBuffers; ++i) {
       VkBufferCreateInfo create_info = {
           VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
           nullptr,                               // pNext
@@ -227,21 +242,24 @@ class ASyncThreadRunner {
           sizeof(draw_data) * TOTAL_PARTICLES,   // size
           VK_BUFFER_USAGE_TRANSFER_DST_BIT |
               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
-          VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
-          2,                                       // queueFamilyIndexCount
-          queue_family_indices                     // pQueueFamilyIndices
+          concurrent ? VK_SHARING_MODE_CONCURRENT
+                     : VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
+          concurrent ? 2u : 0u,                    // queueFamilyIndexCount
+          concurrent ? queue_family_indices : nullptr  // pQueueFamilyIndices
       };
 
-      data_.push_back(
-          PrivateAsyncData{vulkan::CreateFence(&app_->device()),
-                           app_->CreateAndBindDeviceBuffer(&create_info),
-                           app_->GetCommandBuffer(app_->async_compute_queue()->index()), app_->GetCommandBuffer(),
-                           containers::make_unique<vulkan::DescriptorSet>(
-                               allocator_,
-                               app_->AllocateDescriptorSet(
-                                   {compute_descriptor_set_layouts_[0],
-                                    compute_descriptor_set_layouts_[1],
-                                    compute_descriptor_set_layouts_[2]}))});
+      data_.push_back(PrivateAsyncData{
+          vulkan::CreateTimelineSemaphore(&app_->device(), 0),
+          app_->CreateAndBindDeviceBuffer(&create_info),
+          app_->GetCommandBuffer(app_->async_compute_queue()->index()),
+          containers::make_unique<vulkan::DescriptorSet>(
+              allocator_,
+              app_->AllocateDescriptorSet({compute_descriptor_set_layouts_[0],
+                                           compute_descriptor_set_layouts_[1],
+                                           compute_descriptor_set_layouts_[2]})),
+          0,  // value_
+          0   // ready_value_
+      });
       auto& dat = data_.back();
       VkDescriptorBufferInfo buffer_infos[3] = {
           {
@@ -277,28 +295,10 @@ class ASyncThreadRunner {
       app_->device()->vkUpdateDescriptorSets(app_->device(), 1, &write, 0,
                                              nullptr);
 
-      VkBufferMemoryBarrier barrier = {
-          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-          nullptr,                                  // pNext
-          VK_ACCESS_SHADER_READ_BIT,                // srcAccessMask
-          VK_ACCESS_SHADER_WRITE_BIT,               // dstAccessMask
-          app_->render_queue().index(),             // srcQueueFamilyIndex
-          app_->async_compute_queue()->index(),     // dstQueueFamilyIndex
-          *dat.render_ssbo_,                        // buffer
-          0,                                        //  offset
-          dat.render_ssbo_->size(),                 // size
-      };
-
       auto& command_buffer = dat.command_buffer_;
       command_buffer->vkBeginCommandBuffer(
           command_buffer, &sample_application::kBeginCommandBuffer);
 
-      // Transfer the ownership from the render_queue to this queue.
-      command_buffer->vkCmdPipelineBarrier(
-          command_buffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0,
-          nullptr);
-
       command_buffer->vkCmdBindDescriptorSets(
           command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
           ::VkPipelineLayout(*compute_pipeline_layout_), 0, 1,
@@ -334,41 +334,7 @@ class ASyncThreadRunner {
       command_buffer->vkCmdDispatch(
           command_buffer, TOTAL_PARTICLES / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
 
-      // Transition the old buffer back.
-      barrier.srcQueueFamilyIndex = app_->async_compute_queue()->index();
-      barrier.dstQueueFamilyIndex = app_->render_queue().index();
-      barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-      command_buffer->vkCmdPipelineBarrier(
-          command_buffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0,
-          nullptr);
-
       command_buffer->vkEndCommandBuffer(command_buffer);
-      ready_buffers_.push_back(static_cast<uint32_t>(i));
-
-      // Wake command buffer
-      auto& wake_command_buffer = dat.wake_command_buffer_;
-      wake_command_buffer->vkBeginCommandBuffer(
-          wake_command_buffer, &sample_application::kBeginCommandBuffer);
-      VkBufferMemoryBarrier wake_barrier = {
-          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-          nullptr,                                  // pNext
-          VK_ACCESS_SHADER_READ_BIT,                // srcAccessMask
-          VK_ACCESS_SHADER_WRITE_BIT,               //  dstAccessMask
-          app_->render_queue().index(),             // srcQueueFamilyIndex
-          app_->async_compute_queue()->index(),     // dstQueueFamilyIndex
-          *dat.render_ssbo_,                        // buffer
-          0,                                        //  offset
-          dat.render_ssbo_->size(),                 // size
-      };
-      wake_command_buffer->vkCmdPipelineBarrier(
-          wake_command_buffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &wake_barrier,
-          0, nullptr);
-
-      wake_command_buffer->vkEndCommandBuffer(wake_command_buffer);
     }
 
     (*initial_data_buffer)->vkEndCommandBuffer(*initial_data_buffer);
@@ -400,118 +366,82 @@ class ASyncThreadRunner {
     runner_.join();
   }
 
-  // There is only one time that index can be a value that was not
-  // returned from this function before, and that is if this is the
-  // first time.
-  // This returns the current buffer and gets the next simulated buffer.
-  // If there is no simulated buffer ready, then, this simply returns the
-  // existing buffer.
-  int32_t TryToReturnAndGetNextBuffer(int32_t index) {
-    if (index == -1) {
-      // The first time we put something in the mailbox,
-      // this is set. So that the first time we can block for there
-      // to be a valid value there.
-      std::unique_lock<std::mutex> lock(first_data_mutex_);
-      first_data_cv_.wait(lock, [this] { return first_data_ready_; });
+  // Returns the buffer with the newest simulation result. If nothing was
+  // simulated since the last call, this is the same buffer again. The
+  // buffer that was returned before goes back to the simulation, as soon
+  // as the render queue signals RenderValue() for it. This only ever waits
+  // for the very first result.
+  uint32_t GetNewestBuffer() {
+    if (!first_data_ready_) {
+      while ((mailbox_.load(std::memory_order_acquire) & kNewBuffer) == 0) {
+        std::this_thread::yield();
+      }
+      first_data_ready_ = true;
     }
-
-    std::lock_guard<std::mutex> lock(data_mutex_);
-    if (mailbox_buffer_ == -1) {
-      // Nothing is ready;
-      return index;
+    if (mailbox_.load(std::memory_order_relaxed) & kNewBuffer) {
+      render_buffer_ =
+          mailbox_.exchange(render_buffer_, std::memory_order_acq_rel) &
+          kBufferMask;
     }
-
-    int32_t mb = mailbox_buffer_;
-    mailbox_buffer_ = -1;
-    if (index != -1) {
-      // Enqueues a command-buffer that transitions the buffer back to
-      // the compute queue. It also sets the fence that we can wait on
-      // in the future.
-      auto& data = data_[index];
-      VkSubmitInfo wake_submit_info{
-          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-          nullptr,                        // pNext
-          0,                              // waitSemaphoreCount
-          nullptr,                        // pWaitSemaphores
-          nullptr,                        // pWaitDstStageMask,
-          1,                              // commandBufferCount
-          &(data.wake_command_buffer_.get_command_buffer()),
-          0,       // signalSemaphoreCount
-          nullptr  // pSignalSemaphores
-      };
-
-      app_->render_queue()->vkQueueSubmit(
-          app_->render_queue(), 1, &wake_submit_info, data.return_fence_);
-      returned_buffers_.push_back(index);
-    }
-
-    return mb;
+    return render_buffer_;
   }
 
   // Returns the buffer data for a given index
-  vulkan::VulkanApplication::Buffer* GetBufferForIndex(int32_t buffer) const {
+  vulkan::VulkanApplication::Buffer* GetBufferForIndex(uint32_t buffer) const {
     return data_[buffer].render_ssbo_.get();
   }
 
+  // The timeline semaphore of the buffer from GetNewestBuffer(). Rendering
+  // has to wait for it to reach ReadyValue(), and signal RenderValue() once
+  // it is done reading.
+  ::VkSemaphore GetSemaphore() const {
+    return data_[render_buffer_].semaphore_.get_raw_object();
+  }
+  uint64_t ReadyValue() const { return data_[render_buffer_].ready_value_; }
+  // Returns the next value to signal, every frame that renders from the
+  // buffer signals a new one.
+  uint64_t RenderValue() { return ++data_[render_buffer_].value_; }
+
   // Starts the simulation.
   void start() {
     runner_ = std::thread(std::bind(&ASyncThreadRunner::AsyncThread, this));
   }
 
  private:
+  // The bit of mailbox_ that is set while the buffer in it has a result
+  // that the main thread has not taken yet.
+  static const uint32_t kNewBuffer = 0x80000000u;
+  static const uint32_t kBufferMask = 0x7FFFFFFFu;
+
   void AsyncThread() {
-    // 1. Wait for previous computation. We want to do this so that
-    //    we can accurately describe the delta_time between the time we
-    //    started the last computation and when we started this one.
-    // 2. Put the previous computation result into the mailbox.
-    //    If there was something IN the mailbox, take it back out.
-    // 3. Find the right buffer to be using for computations
-    //    (new buffer, or the one we just popped from the mailbox)
-    // 4. Actually run the computation.
-    // 5. Set a fence to notify when this computation is done, so that
-    //    #1 will work for the next iteration.
-    int32_t last_buffer = -1;
-
-    vulkan::VkFence computation_fence = vulkan::CreateFence(&app_->device());
+    // 1. Wait for the last simulation into this buffer to be done, so that
+    //    its time data can be written. This also keeps the simulation from
+    //    running more than a few steps ahead of the GPU.
+    // 2. Submit the simulation, which waits on the GPU for the last use of
+    //    the buffer, which may be a frame that rendered from it.
+    // 3. Put the buffer in the mailbox, right away, the main thread's
+    //    frames wait on the GPU for the result. Whatever was in the mailbox
+    //    is simulated into next.
+    last_update_time_ = std::chrono::high_resolution_clock::now();
+    last_notify_time_ = std::chrono::high_resolution_clock::now();
     while (!exit_.load()) {
+      TRACE_ZONE("AsyncThread");
+      auto& dat = data_[simulation_buffer_];
       // 1)
-      if (!first) {
-        LOG_ASSERT(
-            ==, app_->GetLogger(), VK_SUCCESS,
-            app_->device()->vkWaitForFences(app_->device(), 1,
-                                        &computation_fence.get_raw_object(),
-                                        false, 0xFFFFFFFFFFFFFFFF));
-        app_->device()->vkResetFences(app_->device(), 1,
-                                      &computation_fence.get_raw_object());
-        // 2)
-        PutBufferInMailbox(last_buffer);
-        if (!first_data_ready_) {
-          {
-            std::lock_guard<std::mutex> lg(first_data_mutex_);
-            first_data_ready_ = true;
-          }
-          first_data_cv_.notify_all();
-        }
-      } else {
-        last_update_time_ = std::chrono::high_resolution_clock::now();
-        last_notify_time_ = std::chrono::high_resolution_clock::now();
+      {
+        TRACE_ZONE("vkWaitSemaphores");
+        VkSemaphoreWaitInfoKHR wait_info{
+            VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,  // sType
+            nullptr,                                    // pNext
+            0,                                          // flags
+            1,                                          // semaphoreCount
+            &dat.semaphore_.get_raw_object(),           // pSemaphores
+            &dat.ready_value_                           // pValues
+        };
+        LOG_ASSERT(==, app_->GetLogger(), VK_SUCCESS,
+                   app_->device()->vkWaitSemaphoresKHR(
+                       app_->device(), &wait_info, 0xFFFFFFFFFFFFFFFF));
       }
-      first = false;
-
-      // 3)
-      ProcessReturnedBuffers();
-      int32_t buffer = GetNextBuffer();
-      while (buffer == -1) {
-        if (exit_.load()) {
-          return;
-        }
-        ProcessReturnedBuffers();
-        buffer = GetNextBuffer();
-        // Would be nice for a std::counting_semaphore, but alas
-        // they do not exist, should probably at last sleep here.
-        // For now just burn CPU cycles and hot-loop.
-      }
-      // 4)
 
       auto current_time = std::chrono::high_resolution_clock::now();
       std::chrono::duration<float> elapsed_time =
@@ -533,93 +463,69 @@ class ASyncThreadRunner {
       if (current_frame >= TOTAL_PARTICLES) {
         current_frame = 0;
       }
-      update_time_data_->UpdateBuffer(app_->async_compute_queue(), buffer);
-
-      auto& dat = data_[buffer];
+      update_time_data_->UpdateBuffer(app_->async_compute_queue(),
+                                      simulation_buffer_);
+
+      // 2)
+      const uint64_t wait_value = dat.value_;
+      dat.ready_value_ = ++dat.value_;
+      VkTimelineSemaphoreSubmitInfoKHR timeline_info{
+          VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,  // sType
+          nullptr,                                               // pNext
+          1,                 // waitSemaphoreValueCount
+          &wait_value,       // pWaitSemaphoreValues
+          1,                 // signalSemaphoreValueCount
+          &dat.ready_value_  // pSignalSemaphoreValues
+      };
+      VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
       // This is where the computation actually happens
       VkSubmitInfo computation_submit_info{
-          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-          nullptr,                        // pNext
-          0,                              // waitSemaphoreCount
-          nullptr,                        // pWaitSemaphores
-          nullptr,                        // pWaitDstStageMask,
-          1,                              // commandBufferCount
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,     // sType
+          &timeline_info,                    // pNext
+          1,                                 // waitSemaphoreCount
+          &dat.semaphore_.get_raw_object(),  // pWaitSemaphores
+          &wait_stage,                       // pWaitDstStageMask,
+          1,                                 // commandBufferCount
           &(dat.command_buffer_.get_command_buffer()),
-          0,       // signalSemaphoreCount
-          nullptr  // pSignalSemaphores
+          1,                                 // signalSemaphoreCount
+          &dat.semaphore_.get_raw_object()   // pSignalSemaphores
       };
 
-      // 5)
-      (*app_->async_compute_queue())
-          ->vkQueueSubmit(*app_->async_compute_queue(), 1,
-                          &computation_submit_info, computation_fence);
-
-      last_buffer = buffer;
-    }
-  }
-
-  // Returns the next buffer that is valid to be computed in.
-  // If this returns -1, it means there are no currently available
-  // buffers.
-  int32_t GetNextBuffer() {
-    std::lock_guard<std::mutex> lock(data_mutex_);
-    if (ready_buffers_.empty()) {
-      return -1;
-    }
-    int32_t value = ready_buffers_.front();
-    ready_buffers_.pop_front();
-    return value;
-  }
-
-  // Walks through all of the buffers that have been returned.
-  // Once their fences have been signaled, then they are good
-  // to be used again.
-  void ProcessReturnedBuffers() {
-    std::lock_guard<std::mutex> lock(data_mutex_);
-    while (!returned_buffers_.empty()) {
-      if (VK_SUCCESS !=
-          app_->device()->vkGetFenceStatus(
-              app_->device(),
-              data_[returned_buffers_.front()]
-                  .return_fence_.get_raw_object())) {
-        break;
+      {
+        TRACE_ZONE("vkQueueSubmit");
+        (*app_->async_compute_queue())
+            ->vkQueueSubmit(*app_->async_compute_queue(), 1,
+                            &computation_submit_info,
+                            static_cast<VkFence>(VK_NULL_HANDLE));
       }
-      app_->device()->vkResetFences(
-          app_->device(), 1,
-          &data_[returned_buffers_.front()].return_fence_.get_raw_object());
-      ready_buffers_.push_back(returned_buffers_.front());
-      returned_buffers_.pop_front();
-    }
-  }
 
-  // Puts the given buffer in the mailbox. If there was a buffer
-  // already in the mailbox, moves it to the ready_buffers_.
-  void PutBufferInMailbox(int32_t buffer) {
-    std::lock_guard<std::mutex> lock(data_mutex_);
-    if (mailbox_buffer_ != -1) {
-      ready_buffers_.push_back(mailbox_buffer_);
+      // 3)
+      simulation_buffer_ =
+          mailbox_.exchange(simulation_buffer_ | kNewBuffer,
+                            std::memory_order_acq_rel) &
+          kBufferMask;
     }
-    mailbox_buffer_ = buffer;
   }
 
+  // Everything but the buffer and its semaphore belongs to the thread that
+  // owns the buffer at the time. Handing it over through mailbox_ makes
+  // the writes of one thread visible to the other.
   struct PrivateAsyncData {
-    // Fence that is signalled once a buffer is returned.
-    vulkan::VkFence return_fence_;
+    // Every submit that uses this buffer waits for value_, and signals
+    // value_ + 1, on either queue.
+    vulkan::VkSemaphore semaphore_;
     // The SSBO used for actually rendering.
     containers::unique_ptr<vulkan::VulkanApplication::Buffer> render_ssbo_;
     // The command buffer for simulating.
     vulkan::VkCommandBuffer command_buffer_;
-    // The command buffer for transferring this back to the simulation thread.
-    vulkan::VkCommandBuffer wake_command_buffer_;
     // The descriptor set needed for simulating.
     containers::unique_ptr<vulkan::DescriptorSet> compute_descriptor_set_;
+    // The last value that was submitted to be signaled.
+    uint64_t value_;
+    // The value that the last simulation into this buffer signals.
+    uint64_t ready_value_;
   };
 
-  // The list of all buffers that are currently free for simulation.
-  containers::deque<uint32_t> ready_buffers_;
-  // The list of all buffers that have been returned, and we are waiting for
-  // their fences to complete.
-  containers::deque<uint32_t> returned_buffers_;
   // The actual data associated with those buffers.
   containers::vector<PrivateAsyncData> data_;
 
@@ -648,9 +554,15 @@ class ASyncThreadRunner {
   // The time that the last update was started.
   std::chrono::time_point<std::chrono::high_resolution_clock> last_update_time_;
 
-  // The current buffer sitting in the output mailbox.
-  int32_t mailbox_buffer_;
-  bool first = true;
+  // The buffer in the mailbox, with kNewBuffer set if it was simulated
+  // into since the main thread last took one.
+  std::atomic<uint32_t> mailbox_;
+  // The buffer that the simulation thread writes to next.
+  uint32_t simulation_buffer_;
+  // The buffer that the main thread renders from.
+  uint32_t render_buffer_;
+  // Whether the main thread has taken a buffer yet.
+  bool first_data_ready_;
   int current_frame = 0;
 
   // The number of times the simulation has run since the last log.
@@ -658,12 +570,6 @@ class ASyncThreadRunner {
   // The time of the last simulation log.
   std::chrono::time_point<std::chrono::high_resolution_clock> last_notify_time_;
 
-  // Mutex to protect the mailbox and related buffers.
-  std::mutex data_mutex_;
-  // This lock + cv + value becomes our semaphore
-  std::mutex first_data_mutex_;
-  std::condition_variable first_data_cv_;
-  bool first_data_ready_ = false;
   // The thread that runs the simulation.
   std::thread runner_;
   vulkan::VulkanApplication* app_;
@@ -681,14 +587,17 @@ class AsyncSample : public sample_application::Sample<AsyncFrameData> {
  public:
   AsyncSample(const entry::EntryData* data)
       : data_(data),
-        Sample<AsyncFrameData>(data->allocator(), data, 1, 512, 32, 1,
-                               sample_application::SampleOptions()
-                                   .EnableAsyncCompute()
-                                   .EnableMultisampling()),
+        Sample<AsyncFrameData>(
+            data->allocator(), data, 1, 512, 32, 1,
+            sample_application::SampleOptions()
+                .EnableAsyncCompute()
+                .EnableMultisampling()
+                .EnableTimelineFrameSync(),
+            {0}, {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+            {VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME}),
         quad_model_(data->allocator(), data->logger(), quad_data),
         particle_texture_(data->allocator(), data->logger(), texture_data),
-        thread_runner_(data->allocator(), app(), kNumAsyncComputeBuffers) {
-    current_computation_result_buffer_ = -1;
+        thread_runner_(data->allocator(), app()) {
     if (!app()->async_compute_queue()) {
       app()->GetLogger()->LogError("Could not find async compute queue.");
       set_invalid(true);
@@ -703,7 +612,9 @@ class AsyncSample : public sample_application::Sample<AsyncFrameData> {
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
     // All of this is the fairly standard setup for rendering.
     quad_model_.InitializeData(app(), initialization_buffer);
-    particle_texture_.InitializeData(app(), initialization_buffer);
+    particle_texture_.InitializeData(app(), initialization_buffer,
+                                     VK_IMAGE_USAGE_SAMPLED_BIT, 0, nullptr,
+                                     true);
 
     particle_descriptor_set_layouts_[0] = {
         0,                                  // binding
@@ -867,13 +778,8 @@ class AsyncSample : public sample_application::Sample<AsyncFrameData> {
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       AsyncFrameData* data) override {
     // Get the next buffer that we use for the particle positions.
-    int32_t old_buffer = current_computation_result_buffer_;
-    current_computation_result_buffer_ =
-        thread_runner_.TryToReturnAndGetNextBuffer(
-            current_computation_result_buffer_);
-    bool swapped_buffer = old_buffer != current_computation_result_buffer_;
     auto* buffer =
-        thread_runner_.GetBufferForIndex(current_computation_result_buffer_);
+        thread_runner_.GetBufferForIndex(thread_runner_.GetNewestBuffer());
     aspect_buffer_->UpdateBuffer(&app()->render_queue(), frame_index);
 
     // Write that buffer into the descriptor sets.
@@ -964,26 +870,6 @@ class AsyncSample : public sample_application::Sample<AsyncFrameData> {
     vulkan::MemoryClear(&clear);
     clear.color.float32[3] = 1.0f;
 
-    if (swapped_buffer) {
-      // If we have not transitioned this buffer yet, then move it from
-      // the compute queue over to this queue.
-      VkBufferMemoryBarrier barrier = {
-          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-          nullptr,                                  // pNext
-          VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
-          VK_ACCESS_SHADER_READ_BIT,                //  dstAccessMask
-          app()->async_compute_queue()->index(),    // srcQueueFamilyIndex
-          app()->render_queue().index(),            // dstQueueFamilyIndex
-          *buffer,                                  // bufferdraw_data
-          0,                                        //  offset
-          buffer->size(),                           // size
-      };
-      cmdBuffer->vkCmdPipelineBarrier(cmdBuffer,
-                                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0,
-                                      nullptr, 1, &barrier, 0, nullptr);
-    }
-
     // The rest of the normal drawing.
     VkRenderPassBeginInfo pass_begin = {
         VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
@@ -1013,16 +899,30 @@ class AsyncSample : public sample_application::Sample<AsyncFrameData> {
 
     (*data->command_buffer_)->vkEndCommandBuffer(*data->command_buffer_);
 
+    // The particles are read once the simulation has written them, and the
+    // simulation may write to the buffer again once this has read them.
+    ::VkSemaphore semaphore = thread_runner_.GetSemaphore();
+    const uint64_t wait_value = thread_runner_.ReadyValue();
+    const uint64_t signal_value = thread_runner_.RenderValue();
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info{
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,  // sType
+        nullptr,                                               // pNext
+        1,              // waitSemaphoreValueCount
+        &wait_value,    // pWaitSemaphoreValues
+        1,              // signalSemaphoreValueCount
+        &signal_value,  // pSignalSemaphoreValues
+    };
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-        nullptr,                        // pNext
-        0,                              // waitSemaphoreCount
-        nullptr,                        // pWaitSemaphores
-        nullptr,                        // pWaitDstStageMask,
+        &timeline_info,                 // pNext
+        1,                              // waitSemaphoreCount
+        &semaphore,                     // pWaitSemaphores
+        &wait_stage,                    // pWaitDstStageMask,
         1,                              // commandBufferCount
         &(data->command_buffer_->get_command_buffer()),
-        0,       // signalSemaphoreCount
-        nullptr  // pSignalSemaphores
+        1,          // signalSemaphoreCount
+        &semaphore  // pSignalSemaphores
     };
 
     app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
@@ -1054,10 +954,6 @@ class AsyncSample : public sample_application::Sample<AsyncFrameData> {
   // Data so that we can print out update information once per frame.
   float time_since_last_notify_ = 0.f;
   uint32_t frames_since_last_notify_ = 0;
-  // This is the buffer that contains the most up-to-date simulation results.
-  // Since the render and simulation may run at different frequencies, this may
-  // or may not update every frame.
-  int32_t current_computation_result_buffer_;
 };
 
 int main_entry(const entry::EntryData* data) {
@@ -0,0 +1,112 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The including shader defines counter_type, and kElementBytes as its size.
+// The workgroup size, the contention, the scope and the semantics are set by
+// main.cpp.
+layout (local_size_x = 256, local_size_x_id = 0) in;
+layout (constant_id = 1) const uint kContention = 0;
+layout (constant_id = 2) const uint kScope = 0;
+layout (constant_id = 3) const uint kSemantics = 0;
+
+// These must match Contention, Scope and Semantics in main.cpp.
+const uint kSameAddress = 0;
+const uint kSameLine = 1;
+const uint kSpread = 2;
+
+const uint kDevice = 0;
+const uint kWorkgroup = 1;
+const uint kSubgroup = 2;
+
+const uint kRelaxed = 0;
+const uint kAcquireRelease = 1;
+
+// The counters of one cache line.
+const uint kLineBytes = 128;
+const uint kLineElements = kLineBytes / kElementBytes;
+
+layout (binding = 0, set = 0, std430) buffer counter_data {
+    counter_type counters[];
+};
+
+layout (push_constant) uniform contention_constants {
+    // The number of atomic adds of every invocation.
+    uint iterations;
+};
+
+// Adds 1 to counters[index] with the scope and semantics of the
+// configuration. The device scope is the queue family scope, which needs no
+// vulkanMemoryModelDeviceScope feature, and covers every invocation of the
+// dispatch all the same.
+void add(uint index) {
+    const counter_type one = counter_type(1);
+    if (kSemantics == kRelaxed) {
+        if (kScope == kDevice) {
+            atomicAdd(counters[index], one, gl_ScopeQueueFamily,
+                      gl_StorageSemanticsNone, gl_SemanticsRelaxed);
+        } else if (kScope == kWorkgroup) {
+            atomicAdd(counters[index], one, gl_ScopeWorkgroup,
+                      gl_StorageSemanticsNone, gl_SemanticsRelaxed);
+        } else {
+            atomicAdd(counters[index], one, gl_ScopeSubgroup,
+                      gl_StorageSemanticsNone, gl_SemanticsRelaxed);
+        }
+    } else {
+        if (kScope == kDevice) {
+            atomicAdd(counters[index], one, gl_ScopeQueueFamily,
+                      gl_StorageSemanticsBuffer, gl_SemanticsAcquireRelease);
+        } else if (kScope == kWorkgroup) {
+            atomicAdd(counters[index], one, gl_ScopeWorkgroup,
+                      gl_StorageSemanticsBuffer, gl_SemanticsAcquireRelease);
+        } else {
+            atomicAdd(counters[index], one, gl_ScopeSubgroup,
+                      gl_StorageSemanticsBuffer, gl_SemanticsAcquireRelease);
+        }
+    }
+}
+
+// Every instance of the scope, the whole dispatch, a workgroup or a
+// subgroup, gets its own region of counters, so that only the invocations
+// that share the scope contend. Within a region, all lanes add to the same
+// counter, to consecutive counters of one cache line, or each to a cache
+// line of its own.
+void main() {
+    uint region;
+    uint lane;
+    uint lanes;
+    if (kScope == kDevice) {
+        region = 0u;
+        lane = gl_GlobalInvocationID.x;
+        lanes = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+    } else if (kScope == kWorkgroup) {
+        region = gl_WorkGroupID.x;
+        lane = gl_LocalInvocationID.x;
+        lanes = gl_WorkGroupSize.x;
+    } else {
+        region = gl_WorkGroupID.x * gl_NumSubgroups + gl_SubgroupID;
+        lane = gl_SubgroupInvocationID;
+        lanes = gl_SubgroupSize;
+    }
+    uint offset = 0u;
+    if (kContention == kSameLine) {
+        offset = lane % kLineElements;
+    } else if (kContention == kSpread) {
+        offset = lane * kLineElements;
+    }
+    const uint index = region * lanes * kLineElements + offset;
+    for (uint i = 0u; i < iterations; ++i) {
+        add(index);
+    }
+}
@@ -0,0 +1,474 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#include "support/containers/unique_ptr.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/specialization_constants.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t atomic_contention32_shader[] =
+#include "atomic_contention32.comp.spv"
+    ;
+
+uint32_t atomic_contention64_shader[] =
+#include "atomic_contention64.comp.spv"
+    ;
+
+namespace {
+const uint32_t kDefaultWorkGroupSize = 256;
+const uint32_t kDefaultGroups = 1024;
+const uint32_t kDefaultIterations = 64;
+// The counters of every lane are a cache line apart with kSpread. This must
+// match kLineBytes in atomic_contention_common.glsl.
+const uint32_t kLineBytes = 128;
+// The largest subgroup size of any device. The subgroups of a workgroup may
+// cover up to a subgroup more invocations than the workgroup has.
+const uint32_t kMaxSubgroupSize = 128;
+// The size of the device and host buffer arenas, that the counters have to
+// fit in.
+const uint32_t kArenaSize = 1 << 26;
+// Every configuration is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 5;
+
+// These must match the constants in atomic_contention_common.glsl.
+enum Contention {
+  kSameAddress,
+  kSameLine,
+  kSpread,
+  kNumContentions,
+};
+
+const char* const kContentionNames[kNumContentions] = {"address", "line",
+                                                        "spread"};
+
+enum Scope {
+  kDevice,
+  kWorkgroup,
+  kSubgroup,
+  kNumScopes,
+};
+
+const char* const kScopeNames[kNumScopes] = {"device", "workgroup",
+                                              "subgroup"};
+
+enum Semantics {
+  kRelaxed,
+  kAcquireRelease,
+  kNumSemantics,
+};
+
+const char* const kSemanticsNames[kNumSemantics] = {"relaxed", "acq_rel"};
+
+struct WidthInfo {
+  // The name of the width in the sample options and the results.
+  const char* name;
+  uint32_t* shader;
+  size_t shader_size;
+  uint32_t element_bytes;
+};
+
+const WidthInfo kWidths[] = {
+    {"32", atomic_contention32_shader, sizeof(atomic_contention32_shader), 4},
+    {"64", atomic_contention64_shader, sizeof(atomic_contention64_shader), 8},
+};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// Returns true if |option| is not given, or is |name|.
+bool Selected(const char* option, const char* name) {
+  return !option || strcmp(option, name) == 0;
+}
+
+void SubmitAndWait(vulkan::VkQueue* queue, vulkan::VkCommandBuffer* cmd) {
+  VkSubmitInfo submit_info = {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &cmd->get_command_buffer(),     // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+  (*queue)->vkQueueWaitIdle(*queue);
+}
+
+void MemoryBarrier(vulkan::VkCommandBuffer* cmd, VkPipelineStageFlags src,
+                   VkAccessFlags src_access, VkPipelineStageFlags dst,
+                   VkAccessFlags dst_access) {
+  VkMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+      nullptr,                           // pNext
+      src_access,                        // srcAccessMask
+      dst_access,                        // dstAccessMask
+  };
+  (*cmd)->vkCmdPipelineBarrier(*cmd, src, dst, 0, 1, &barrier, 0, nullptr, 0,
+                               nullptr);
+}
+
+// Measures the throughput of atomic adds to global memory for 32-bit and
+// 64-bit counters, with device, workgroup and subgroup scope, with relaxed
+// and acquire-release semantics, and with every invocation of the scope
+// adding to the same address, to the same cache line, or to a cache line of
+// its own. The counters of every configuration are checked on the host
+// before its throughput is logged.
+class AtomicContentionBenchmark {
+ public:
+  AtomicContentionBenchmark(const entry::EntryData* data,
+                            vulkan::VulkanApplication* app, bool int64)
+      : data_(data),
+        app_(app),
+        int64_(int64),
+        groups_(data->sample_option_uint("groups", kDefaultGroups)),
+        iterations_(data->sample_option_uint("iterations", kDefaultIterations)),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        subgroup_supported_(false) {
+    vulkan::VkDevice& device = app->device();
+    const VkPhysicalDeviceLimits& limits = device.limits();
+    workgroup_size_ = std::min(
+        std::min(data->sample_option_uint("workgroup_size",
+                                          kDefaultWorkGroupSize),
+                 limits.maxComputeWorkGroupSize[0]),
+        limits.maxComputeWorkGroupInvocations);
+    groups_ = std::min(
+        std::min(groups_, limits.maxComputeWorkGroupCount[0]),
+        kArenaSize / ((workgroup_size_ + kMaxSubgroupSize) * kLineBytes));
+
+    VkPhysicalDeviceSubgroupProperties subgroup_properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,  // sType
+        nullptr,                                                // pNext
+        0,                                                      // subgroupSize
+        0,                                                      // stages
+        0,                                                      // operations
+        VK_FALSE  // quadOperationsInAllStages
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,  // sType
+        &subgroup_properties,                            // pNext
+        {}                                               // properties
+    };
+    app->instance()->vkGetPhysicalDeviceProperties2KHR(
+        device.physical_device(), &properties);
+    subgroup_supported_ =
+        (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+        (subgroup_properties.supportedOperations &
+         VK_SUBGROUP_FEATURE_BASIC_BIT);
+
+    binding_ = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(uint32_t)              // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(), app->CreatePipelineLayout({{binding_}}, {range}));
+
+    // Every lane may get a cache line of its own, in the region of its
+    // scope.
+    size_ = VkDeviceSize(groups_) * (workgroup_size_ + kMaxSubgroupSize) *
+            kLineBytes;
+    counters_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(
+        size_, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    host_counters_ = app->CreateAndBindDefaultExclusiveHostBuffer(
+        size_, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    set_ = containers::make_unique<vulkan::DescriptorSet>(
+        data->allocator(), app->AllocateDescriptorSet({binding_}));
+    VkDescriptorBufferInfo buffer_info = {*counters_, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *set_,                                   // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        1,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        &buffer_info,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    device->vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+  }
+
+  // Measures every configuration, or only the ones that match the width,
+  // scope, semantics and contention options, and logs the results.
+  void Run() {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+    if (!subgroup_supported_) {
+      data_->logger()->LogInfo(
+          "ATOMICS: the subgroup scope is skipped, compute shaders do not "
+          "support subgroups");
+    }
+
+    const char* only_width = data_->sample_option("width");
+    const char* only_scope = data_->sample_option("scope");
+    const char* only_semantics = data_->sample_option("semantics");
+    const char* only_contention = data_->sample_option("contention");
+    for (const WidthInfo& width : kWidths) {
+      if (!Selected(only_width, width.name) ||
+          (width.element_bytes == 8 && !int64_)) {
+        continue;
+      }
+      for (uint32_t scope = 0; scope < kNumScopes; ++scope) {
+        if (!Selected(only_scope, kScopeNames[scope]) ||
+            (scope == kSubgroup && !subgroup_supported_)) {
+          continue;
+        }
+        for (uint32_t semantics = 0; semantics < kNumSemantics; ++semantics) {
+          if (!Selected(only_semantics, kSemanticsNames[semantics])) {
+            continue;
+          }
+          for (uint32_t contention = 0; contention < kNumContentions;
+               ++contention) {
+            if (!Selected(only_contention, kContentionNames[contention])) {
+              continue;
+            }
+            vulkan::SpecializationConstants constants(data_->allocator());
+            constants.Set(0, workgroup_size_);
+            constants.Set(1, contention);
+            constants.Set(2, scope);
+            constants.Set(3, semantics);
+            vulkan::VulkanComputePipeline pipeline =
+                app_->CreateComputePipeline(
+                    pipeline_layout_.get(),
+                    VkShaderModuleCreateInfo{
+                        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr,
+                        0, width.shader_size, width.shader},
+                    "main", constants);
+            const double gops = Measure(&pipeline, width.element_bytes);
+            if (gops < 0.0) {
+              data_->logger()->LogError(
+                  "ATOMICS: width: ", width.name,
+                  " scope: ", kScopeNames[scope],
+                  " semantics: ", kSemanticsNames[semantics],
+                  " contention: ", kContentionNames[contention],
+                  " the counters are wrong");
+              continue;
+            }
+            data_->logger()->LogInfo(
+                "ATOMICS: width: ", width.name, " scope: ", kScopeNames[scope],
+                " semantics: ", kSemanticsNames[semantics],
+                " contention: ", kContentionNames[contention],
+                " Gops/s: ", gops);
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  // Returns the number of atomic adds per nanosecond of the fastest of
+  // kNumRuns runs of |pipeline|, or a negative number if it could not be
+  // measured or the counters are wrong.
+  double Measure(vulkan::VulkanComputePipeline* pipeline,
+                 uint32_t element_bytes) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags transfer = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      const bool last_run = run + 1 == kNumRuns;
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      cmd->vkCmdFillBuffer(cmd, *counters_, 0, VK_WHOLE_SIZE, 0);
+      MemoryBarrier(&cmd, transfer, VK_ACCESS_TRANSFER_WRITE_BIT, compute,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 0);
+      cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline);
+      cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *pipeline_layout_, 0, 1, &set_->raw_set(),
+                                   0, nullptr);
+      cmd->vkCmdPushConstants(cmd, *pipeline_layout_,
+                              VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                              sizeof(iterations_), &iterations_);
+      cmd->vkCmdDispatch(cmd, groups_, 1, 1);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      if (last_run) {
+        // Only the last run is read back and checked.
+        MemoryBarrier(&cmd, compute, VK_ACCESS_SHADER_WRITE_BIT, transfer,
+                      VK_ACCESS_TRANSFER_READ_BIT);
+        VkBufferCopy region = {0, 0, size_};
+        cmd->vkCmdCopyBuffer(cmd, *counters_, *host_counters_, 1, &region);
+        MemoryBarrier(&cmd, transfer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+      }
+      cmd->vkEndCommandBuffer(cmd);
+      SubmitAndWait(&queue, &cmd);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    if (best <= 0.0) {
+      return -1.0;
+    }
+
+    const uint64_t adds = uint64_t(groups_) * workgroup_size_ * iterations_;
+    if (Sum(element_bytes) != adds) {
+      return -1.0;
+    }
+    return adds / best;
+  }
+
+  // Returns the sum of all counters that Measure read back. Every atomic add
+  // adds 1, so it is the number of adds that took effect, whatever the
+  // contention.
+  uint64_t Sum(uint32_t element_bytes) {
+    host_counters_->invalidate();
+    const char* base = host_counters_->base_address();
+    const size_t num_counters = static_cast<size_t>(size_ / element_bytes);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < num_counters; ++i) {
+      if (element_bytes == 8) {
+        sum += reinterpret_cast<const uint64_t*>(base)[i];
+      } else {
+        sum += reinterpret_cast<const uint32_t*>(base)[i];
+      }
+    }
+    return sum;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  bool int64_;
+  uint32_t workgroup_size_;
+  uint32_t groups_;
+  uint32_t iterations_;
+  VkDeviceSize size_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+  bool subgroup_supported_;
+  VkDescriptorSetLayoutBinding binding_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> counters_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> host_counters_;
+  containers::unique_ptr<vulkan::DescriptorSet> set_;
+};
+
+// Creates a Vulkan 1.1 device with the Vulkan memory model, and with 64-bit
+// buffer atomics if |int64|, and measures every configuration on it.
+void RunBenchmark(const entry::EntryData* data,
+                  std::initializer_list<const char*> device_extensions,
+                  bool int64) {
+  VkPhysicalDeviceShaderAtomicInt64FeaturesKHR int64_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES_KHR,
+      nullptr,   // pNext
+      VK_TRUE,   // shaderBufferInt64Atomics
+      VK_FALSE,  // shaderSharedInt64Atomics
+  };
+  VkPhysicalDeviceVulkanMemoryModelFeaturesKHR memory_model_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_MEMORY_MODEL_FEATURES_KHR,
+      int64 ? &int64_features : nullptr,  // pNext
+      VK_TRUE,                            // vulkanMemoryModel
+      VK_FALSE,                           // vulkanMemoryModelDeviceScope
+      VK_FALSE,  // vulkanMemoryModelAvailabilityVisibilityChains
+  };
+  VkPhysicalDeviceFeatures features = {0};
+  features.shaderInt64 = int64 ? VK_TRUE : VK_FALSE;
+
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data,
+      {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+      device_extensions, features, kArenaSize, 1024 * 1024, kArenaSize,
+      1024 * 1024, false, false, false, 0, false, false,
+      VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, false, false, nullptr, true, false,
+      &memory_model_features);
+  AtomicContentionBenchmark benchmark(data, &app, int64);
+  benchmark.Run();
+}
+}  // anonymous namespace
+
+// This sample measures the throughput of contended atomic adds to global
+// memory, for every counter width, scope, memory semantics and contention
+// level. It logs one line per configuration whose counters are correct:
+//   ATOMICS: width: <32|64> scope: <scope> semantics: <semantics>
+//       contention: <contention> Gops/s: <atomic adds per nanosecond>
+// -sample-option=width, scope, semantics and contention only measure those,
+// and workgroup_size, groups and iterations set the size of the dispatch.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  // 64-bit counters need VK_KHR_shader_atomic_int64, which is not asked for
+  // when only 32-bit counters are measured, so that those run on any device
+  // with the Vulkan memory model.
+  if (Selected(data->sample_option("width"), "64")) {
+    RunBenchmark(data,
+                 {VK_KHR_VULKAN_MEMORY_MODEL_EXTENSION_NAME,
+                  VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME},
+                 true);
+  } else {
+    RunBenchmark(data, {VK_KHR_VULKAN_MEMORY_MODEL_EXTENSION_NAME}, false);
+  }
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -164,6 +164,8 @@ class AtomicInt64Sample : public sample_application::Sample<TriangleFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
     counter_data_ =
         containers::make_unique<vulkan::BufferFrameData<CounterData>>(
             data_->allocator(), app(), num_swapchain_images,
@@ -299,9 +301,6 @@ class AtomicInt64Sample : public sample_application::Sample<TriangleFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       TriangleFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
     counter_data_->UpdateBuffer(queue, frame_index, 0, true);
 
     VkSubmitInfo init_submit_info{
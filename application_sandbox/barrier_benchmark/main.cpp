@@ -0,0 +1,506 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t barrier_work_shader[] =
+#include "barrier_work.comp.spv"
+    ;
+
+namespace {
+// This must match local_size_x in barrier_work.comp.
+const uint32_t kWorkGroupSize = 64;
+
+const uint32_t kDefaultGroups = 16;
+const uint32_t kDefaultIterations = 256;
+const uint32_t kDefaultBarriers = 256;
+// Every kind is measured this many times, and the fastest run is kept.
+const uint32_t kNumRuns = 5;
+
+// What is recorded in between the dispatches of the chain.
+enum class Pattern {
+  // Nothing, the dispatches may overlap.
+  kNone,
+  // A global memory barrier from and to VK_PIPELINE_STAGE_ALL_COMMANDS_BIT.
+  kAllCommands,
+  // A global memory barrier from and to the compute shader stage.
+  kComputeGlobal,
+  // A buffer memory barrier for the buffer of the chain.
+  kComputeBuffer,
+  // An image memory barrier for the image of the chain.
+  kComputeImage,
+  // A dispatch that does not depend on the chain, and nothing else.
+  kIndependentNone,
+  // A dispatch that does not depend on the chain, then a global memory
+  // barrier from and to the compute shader stage.
+  kIndependentBarrier,
+  // vkCmdSetEvent, a dispatch that does not depend on the chain, then
+  // vkCmdWaitEvents, so the independent dispatch can overlap the barrier.
+  kIndependentSplit,
+};
+
+struct PatternInfo {
+  Pattern pattern;
+  // The name of the kind of barrier in the sample options and the results.
+  const char* name;
+  // The pattern without the barrier, that this one is compared with. It is
+  // the pattern itself for the baselines.
+  Pattern baseline;
+};
+
+const PatternInfo kPatterns[] = {
+    {Pattern::kNone, "none", Pattern::kNone},
+    {Pattern::kAllCommands, "all_commands", Pattern::kNone},
+    {Pattern::kComputeGlobal, "compute_global", Pattern::kNone},
+    {Pattern::kComputeBuffer, "compute_buffer", Pattern::kNone},
+    {Pattern::kComputeImage, "compute_image", Pattern::kNone},
+    {Pattern::kIndependentNone, "independent_none", Pattern::kIndependentNone},
+    {Pattern::kIndependentBarrier, "independent_barrier",
+     Pattern::kIndependentNone},
+    {Pattern::kIndependentSplit, "independent_split_event",
+     Pattern::kIndependentNone},
+};
+const size_t kNumPatterns = sizeof(kPatterns) / sizeof(kPatterns[0]);
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// Runs a chain of compute dispatches that each depend on the one before,
+// with every pattern in between them, and measures how much longer the
+// chain takes than without the barrier.
+class BarrierBenchmark {
+ public:
+  BarrierBenchmark(const entry::EntryData* data,
+                   vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        groups_(data->sample_option_uint("groups", kDefaultGroups)),
+        iterations_(data->sample_option_uint("iterations", kDefaultIterations)),
+        num_barriers_(data->sample_option_uint("barriers", kDefaultBarriers)),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        events_(data->allocator()),
+        image_initialized_(false) {
+    vulkan::VkDevice& device = app->device();
+    // Every workgroup writes a row of the image.
+    groups_ = std::min(groups_, device.limits().maxImageDimension2D);
+
+    bindings_[0] = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    bindings_[1] = {
+        1,                                 // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  // descriptorType
+        1,                                 // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,       // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(uint32_t)              // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout({{bindings_[0], bindings_[1]}}, {range}));
+    pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+        data->allocator(),
+        app->CreateComputePipeline(
+            pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                sizeof(barrier_work_shader), barrier_work_shader},
+            "main"));
+
+    // The chain and the independent dispatches each have a buffer and an
+    // image of their own.
+    for (uint32_t i = 0; i < 2; ++i) {
+      Target& target = targets_[i];
+      target.buffer = app->CreateAndBindDefaultExclusiveDeviceBuffer(
+          groups_ * kWorkGroupSize * sizeof(float),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+      VkImageCreateInfo image_create_info{
+          VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+          nullptr,                              // pNext
+          0,                                    // flags
+          VK_IMAGE_TYPE_2D,                     // imageType
+          VK_FORMAT_R32_SFLOAT,                 // format
+          {kWorkGroupSize, groups_, 1},         // extent
+          1,                                    // mipLevels
+          1,                                    // arrayLayers
+          VK_SAMPLE_COUNT_1_BIT,                // samples
+          VK_IMAGE_TILING_OPTIMAL,              // tiling
+          VK_IMAGE_USAGE_STORAGE_BIT,           // usage
+          VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+          0,                                    // queueFamilyIndexCount
+          nullptr,                              // pQueueFamilyIndices
+          VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+      };
+      target.image = app->CreateAndBindImage(&image_create_info);
+      target.view = app->CreateImageView(
+          target.image.get(), VK_IMAGE_VIEW_TYPE_2D,
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+      target.set = containers::make_unique<vulkan::DescriptorSet>(
+          data->allocator(),
+          app->AllocateDescriptorSet({bindings_[0], bindings_[1]}));
+
+      VkDescriptorBufferInfo buffer_info = {
+          *target.buffer,  // buffer
+          0,               // offset
+          VK_WHOLE_SIZE,   // range
+      };
+      VkDescriptorImageInfo image_info = {
+          VK_NULL_HANDLE,           // sampler
+          *target.view,             // imageView
+          VK_IMAGE_LAYOUT_GENERAL,  // imageLayout
+      };
+      VkWriteDescriptorSet writes[2] = {
+          {
+              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+              nullptr,                                 // pNext
+              *target.set,                             // dstSet
+              0,                                       // dstbinding
+              0,                                       // dstArrayElement
+              1,                                       // descriptorCount
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+              nullptr,                                 // pImageInfo
+              &buffer_info,                            // pBufferInfo
+              nullptr,                                 // pTexelBufferView
+          },
+          {
+              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+              nullptr,                                 // pNext
+              *target.set,                             // dstSet
+              1,                                       // dstbinding
+              0,                                       // dstArrayElement
+              1,                                       // descriptorCount
+              VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,        // descriptorType
+              &image_info,                             // pImageInfo
+              nullptr,                                 // pBufferInfo
+              nullptr,                                 // pTexelBufferView
+          }};
+      device->vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+
+    // Every split barrier has an event of its own, so that none of them
+    // has to be reset on the device in between.
+    events_.reserve(num_barriers_);
+    for (uint32_t i = 0; i < num_barriers_; ++i) {
+      events_.push_back(vulkan::CreateEvent(&device));
+    }
+  }
+
+  // Measures every pattern, or only the one named |only|, and logs the
+  // results.
+  void Run(const char* only) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    // The baselines are always measured, since every other pattern is
+    // compared with one of them.
+    double times[kNumPatterns];
+    for (size_t i = 0; i < kNumPatterns; ++i) {
+      const PatternInfo& info = kPatterns[i];
+      times[i] = -1.0;
+      if (info.pattern == info.baseline ||
+          !only || strcmp(only, info.name) == 0) {
+        times[i] = Measure(info.pattern);
+      }
+    }
+
+    for (size_t i = 0; i < kNumPatterns; ++i) {
+      const PatternInfo& info = kPatterns[i];
+      if (times[i] < 0.0 || (only && strcmp(only, info.name) != 0)) {
+        continue;
+      }
+      double baseline = -1.0;
+      for (size_t j = 0; j < kNumPatterns; ++j) {
+        if (kPatterns[j].pattern == info.baseline) {
+          baseline = times[j];
+        }
+      }
+      // The chain has one barrier less than dispatches.
+      data_->logger()->LogInfo(
+          "BARRIER: kind: ", info.name,
+          " ns_per_iteration: ", times[i] / num_barriers_,
+          " ns_per_barrier: ",
+          baseline < 0.0 ? -1.0 : (times[i] - baseline) / num_barriers_);
+    }
+  }
+
+ private:
+  struct Target {
+    containers::unique_ptr<vulkan::VulkanApplication::Buffer> buffer;
+    containers::unique_ptr<vulkan::VulkanApplication::Image> image;
+    containers::unique_ptr<vulkan::VkImageView> view;
+    containers::unique_ptr<vulkan::DescriptorSet> set;
+  };
+
+  // Returns the fastest of kNumRuns runs of the chain with |pattern|, in
+  // nanoseconds, or a negative number if it could not be measured.
+  double Measure(Pattern pattern) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      for (auto& event : events_) {
+        device->vkResetEvent(device, event);
+      }
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      if (!image_initialized_) {
+        InitializeImages(&cmd);
+        image_initialized_ = true;
+      }
+      cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline_);
+      cmd->vkCmdPushConstants(cmd, *pipeline_layout_,
+                              VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                              sizeof(iterations_), &iterations_);
+
+      // The first dispatch starts the chain, and the timestamps are only
+      // written once it is done, so the timed chain starts from an idle
+      // queue.
+      Dispatch(&cmd, 0);
+      FullBarrier(&cmd);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 0);
+      for (uint32_t i = 0; i < num_barriers_; ++i) {
+        RecordPattern(&cmd, pattern, i);
+        Dispatch(&cmd, 0);
+      }
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      cmd->vkEndCommandBuffer(cmd);
+
+      VkSubmitInfo submit_info = {
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+          nullptr,                        // pNext
+          0,                              // waitSemaphoreCount
+          nullptr,                        // pWaitSemaphores
+          nullptr,                        // pWaitDstStageMask
+          1,                              // commandBufferCount
+          &cmd.get_command_buffer(),      // pCommandBuffers
+          0,                              // signalSemaphoreCount
+          nullptr                         // pSignalSemaphores
+      };
+      queue->vkQueueSubmit(queue, 1, &submit_info, ::VkFence(0));
+      queue->vkQueueWaitIdle(queue);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    return best;
+  }
+
+  // Records what comes in between the dispatches of the chain. |index| is
+  // the index of the barrier in the chain.
+  void RecordPattern(vulkan::VkCommandBuffer* cmd, Pattern pattern,
+                     uint32_t index) {
+    const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkAccessFlags shader_access =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    VkMemoryBarrier memory_barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,        // srcAccessMask
+        shader_access,                     // dstAccessMask
+    };
+    switch (pattern) {
+      case Pattern::kNone:
+        break;
+      case Pattern::kAllCommands:
+        FullBarrier(cmd);
+        break;
+      case Pattern::kComputeGlobal:
+        (*cmd)->vkCmdPipelineBarrier(*cmd, compute, compute, 0, 1,
+                                     &memory_barrier, 0, nullptr, 0, nullptr);
+        break;
+      case Pattern::kComputeBuffer: {
+        VkBufferMemoryBarrier buffer_barrier = {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+            shader_access,                            // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *targets_[0].buffer,                      // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        };
+        (*cmd)->vkCmdPipelineBarrier(*cmd, compute, compute, 0, 0, nullptr, 1,
+                                     &buffer_barrier, 0, nullptr);
+        break;
+      }
+      case Pattern::kComputeImage: {
+        VkImageMemoryBarrier image_barrier = ImageBarrier(
+            *targets_[0].image, VK_IMAGE_LAYOUT_GENERAL,
+            VK_ACCESS_SHADER_WRITE_BIT, shader_access);
+        (*cmd)->vkCmdPipelineBarrier(*cmd, compute, compute, 0, 0, nullptr, 0,
+                                     nullptr, 1, &image_barrier);
+        break;
+      }
+      case Pattern::kIndependentNone:
+        Dispatch(cmd, 1);
+        break;
+      case Pattern::kIndependentBarrier:
+        Dispatch(cmd, 1);
+        (*cmd)->vkCmdPipelineBarrier(*cmd, compute, compute, 0, 1,
+                                     &memory_barrier, 0, nullptr, 0, nullptr);
+        break;
+      case Pattern::kIndependentSplit: {
+        ::VkEvent event = events_[index];
+        (*cmd)->vkCmdSetEvent(*cmd, event, compute);
+        Dispatch(cmd, 1);
+        (*cmd)->vkCmdWaitEvents(*cmd, 1, &event, compute, compute, 1,
+                                &memory_barrier, 0, nullptr, 0, nullptr);
+        break;
+      }
+    }
+  }
+
+  // Dispatches the work with the resources of |targets_[target]|.
+  void Dispatch(vulkan::VkCommandBuffer* cmd, uint32_t target) {
+    (*cmd)->vkCmdBindDescriptorSets(
+        *cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline_layout_, 0, 1,
+        &targets_[target].set->raw_set(), 0, nullptr);
+    (*cmd)->vkCmdDispatch(*cmd, groups_, 1, 1);
+  }
+
+  void FullBarrier(vulkan::VkCommandBuffer* cmd) {
+    const VkAccessFlags all_memory =
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    VkMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        all_memory,                        // srcAccessMask
+        all_memory,                        // dstAccessMask
+    };
+    (*cmd)->vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                                 &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  VkImageMemoryBarrier ImageBarrier(::VkImage image, VkImageLayout old_layout,
+                                    VkAccessFlags src_access,
+                                    VkAccessFlags dst_access) {
+    return {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        src_access,                              // srcAccessMask
+        dst_access,                              // dstAccessMask
+        old_layout,                              // oldLayout
+        VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        image,                                   // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}  // subresourceRange
+    };
+  }
+
+  // Moves both images to VK_IMAGE_LAYOUT_GENERAL, where they stay.
+  void InitializeImages(vulkan::VkCommandBuffer* cmd) {
+    VkImageMemoryBarrier barriers[2];
+    for (uint32_t i = 0; i < 2; ++i) {
+      barriers[i] =
+          ImageBarrier(*targets_[i].image, VK_IMAGE_LAYOUT_UNDEFINED, 0,
+                       VK_ACCESS_SHADER_WRITE_BIT);
+    }
+    (*cmd)->vkCmdPipelineBarrier(
+        *cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2,
+        barriers);
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t groups_;
+  uint32_t iterations_;
+  uint32_t num_barriers_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+  VkDescriptorSetLayoutBinding bindings_[2];
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> pipeline_;
+  // The resources of the chain, and of the independent dispatches.
+  Target targets_[2];
+  containers::vector<vulkan::VkEvent> events_;
+  bool image_initialized_;
+};
+}  // anonymous namespace
+
+// This sample measures the GPU cost of different kinds of barriers, with a
+// chain of small compute dispatches that each depend on the one before. It
+// logs, for every kind, how long an iteration of the chain takes, and how
+// much longer than without the barrier:
+//   BARRIER: kind: <kind> ns_per_iteration: <ns> ns_per_barrier: <ns>
+// -sample-option=kind=<kind> only measures one kind, and groups, iterations
+// and barriers change the size of the dispatches, how long they take, and
+// the length of the chain.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data);
+  BarrierBenchmark benchmark(data, &app);
+  benchmark.Run(data->sample_option("kind"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
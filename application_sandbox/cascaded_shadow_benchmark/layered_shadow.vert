@@ -0,0 +1,27 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_ARB_shader_viewport_layer_array : require
+#include "shadow.glsl"
+
+// The layered path draws an instance of every cube per cascade, and sends
+// each instance to the layer of its cascade.
+void main() {
+    uint cascade = uint(gl_InstanceIndex) % draw.num_cascades;
+    gl_Position =
+        cascade_position(uint(gl_VertexIndex), draw.object, cascade);
+    gl_Layer = int(cascade);
+}
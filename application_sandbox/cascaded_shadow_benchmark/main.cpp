@@ -0,0 +1,497 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "support/containers/unique_ptr.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/offscreen_depth_pass.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t multiview_shadow_shader[] =
+#include "multiview_shadow.vert.spv"
+    ;
+
+uint32_t layered_shadow_shader[] =
+#include "layered_shadow.vert.spv"
+    ;
+
+uint32_t separate_shadow_shader[] =
+#include "separate_shadow.vert.spv"
+    ;
+
+namespace {
+using Mode = vulkan::OffscreenDepthPass::Mode;
+
+// The frames of every run, unless frames=<N> was given.
+const uint32_t kDefaultFrames = 8;
+// The cubes of the scene, unless objects=<N> was given.
+const uint32_t kDefaultObjects = 1024;
+// The width and height of every cascade, unless resolution=<N> was given.
+const uint32_t kDefaultResolution = 2048;
+// Every configuration is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 5;
+// The cascade counts that are measured, unless cascades=<N> was given.
+const uint32_t kCascadeCounts[] = {2, 4};
+// The paths that are measured, unless paths=<list> was given. The layered
+// path needs VK_EXT_shader_viewport_index_layer, and a device without it
+// can not run the sample at all, so it is only measured when asked for.
+const char* kDefaultPaths = "separate,multiview";
+const VkFormat kDepthFormat = VK_FORMAT_D16_UNORM;
+// The depth bias of the casters, in the units of depthBiasConstantFactor
+// and depthBiasSlopeFactor. Shadow maps need it against acne, and it is
+// part of what every path pays for.
+const float kConstantBias = 1.25f;
+const float kSlopeBias = 1.75f;
+// The vertices of a cube, see shadow.glsl.
+const uint32_t kCubeVertices = 36;
+
+const Mode kModes[] = {Mode::kSeparate, Mode::kMultiview, Mode::kLayered};
+
+// The device extensions of each set of paths. The separate path needs none.
+const std::initializer_list<const char*> kNoExtensions = {};
+const std::initializer_list<const char*> kMultiviewExtensions = {
+    VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME,
+    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME};
+const std::initializer_list<const char*> kLayeredExtensions = {
+    VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME};
+const std::initializer_list<const char*> kMultiviewLayeredExtensions = {
+    VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME,
+    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+    VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME};
+const std::initializer_list<const char*> kMultiviewInstanceExtensions = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// The push constants of shadow.glsl.
+struct DrawData {
+  uint32_t object;
+  uint32_t cascade;
+  uint32_t num_cascades;
+};
+
+const char* GetPaths(const entry::EntryData* data) {
+  const char* paths = data->sample_option("paths");
+  return paths ? paths : kDefaultPaths;
+}
+
+// The GPU times of a configuration, in milliseconds per frame, or negative
+// if they were not measured.
+struct Result {
+  uint32_t num_cascades;
+  const char* path;
+  uint32_t resolution;
+  double gpu_ms;
+  // Only measured in the separate path, which has a pass per cascade.
+  std::vector<double> cascade_gpu_ms;
+};
+
+// Renders the shadow casters of a scene into the cascades of a shadow map
+// with every path, and measures the GPU time of a frame, and of every
+// cascade where it has a pass of its own.
+class CascadedShadowBenchmark {
+ public:
+  CascadedShadowBenchmark(const entry::EntryData* data,
+                          vulkan::VulkanApplication* app, bool depth_clamp)
+      : data_(data),
+        app_(app),
+        frames_(data->sample_option_uint("frames", kDefaultFrames)),
+        objects_(data->sample_option_uint("objects", kDefaultObjects)),
+        resolution_(
+            data->sample_option_uint("resolution", kDefaultResolution)),
+        paths_(GetPaths(data)),
+        depth_clamp_(depth_clamp),
+        timestamp_mask_(0) {
+    VkPushConstantRange draw_range = {
+        VK_SHADER_STAGE_VERTEX_BIT,  // stageFlags
+        0,                           // offset
+        sizeof(DrawData)             // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(), app_->CreatePipelineLayout({}, {draw_range}));
+  }
+
+  // Measures every path of paths_ at every cascade count that the sample
+  // options do not rule out, logs the results, and adds them to |results|.
+  // Returns false if nothing can be measured.
+  bool Run(std::vector<Result>* results) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return false;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    const uint32_t cascades_option = data_->sample_option_uint("cascades", 0);
+    for (uint32_t num_cascades : kCascadeCounts) {
+      if (cascades_option) {
+        // Any cascade count can be asked for, not only the default ones.
+        if (num_cascades != kCascadeCounts[0]) {
+          break;
+        }
+        num_cascades = cascades_option;
+      }
+      // The separate path is what the others save on.
+      double separate_ms = -1.0;
+      const Result* best = nullptr;
+      const size_t first_result = results->size();
+      for (Mode mode : kModes) {
+        const char* path = vulkan::LayeredRenderPass::ModeName(mode);
+        if (!entry::ListHas(paths_, path)) {
+          continue;
+        }
+        if (mode == Mode::kMultiview &&
+            !vulkan::LayeredRenderPass::MultiviewSupported(app_,
+                                                           num_cascades)) {
+          data_->logger()->LogInfo("CASCADED_SHADOW: cascades: ",
+                                   num_cascades, " path: ", path,
+                                   " is skipped, it is not supported");
+          continue;
+        }
+        results->push_back(Measure(mode, num_cascades));
+        const Result& result = results->back();
+        // Do not modify this line, scripts may look for it in the output.
+        data_->logger()->LogInfo(
+            "CASCADED_SHADOW: cascades: ", num_cascades, " path: ", path,
+            " resolution: ", resolution_,
+            " passes_per_frame: ", mode == Mode::kSeparate ? num_cascades : 1,
+            " draws_per_frame: ",
+            (mode == Mode::kSeparate ? num_cascades : 1) * objects_,
+            " gpu_ms_per_frame: ", result.gpu_ms,
+            " gpu_ms_per_cascade: ",
+            result.gpu_ms < 0.0 ? -1.0 : result.gpu_ms / num_cascades);
+        for (size_t i = 0; i < result.cascade_gpu_ms.size(); ++i) {
+          // Do not modify this line, scripts may look for it in the output.
+          data_->logger()->LogInfo("CASCADED_SHADOW_CASCADE: cascades: ",
+                                   num_cascades, " path: ", path,
+                                   " cascade: ", i,
+                                   " gpu_ms: ", result.cascade_gpu_ms[i]);
+        }
+        if (mode == Mode::kSeparate) {
+          separate_ms = result.gpu_ms;
+        }
+      }
+      // The results may have grown, find the best one only now.
+      for (size_t i = first_result; i < results->size(); ++i) {
+        const Result& result = (*results)[i];
+        if (result.gpu_ms >= 0.0 && (!best || result.gpu_ms < best->gpu_ms)) {
+          best = &result;
+        }
+      }
+      if (best) {
+        // Do not modify this line, scripts may look for it in the output.
+        data_->logger()->LogInfo(
+            "CASCADED_SHADOW_BEST: cascades: ", num_cascades,
+            " path: ", best->path,
+            " gpu_saving_percent: ", SavingPercent(separate_ms, best->gpu_ms));
+      }
+    }
+    return true;
+  }
+
+ private:
+  // How much less time |ms| takes than |separate_ms|, or 0 if either was
+  // not measured.
+  static double SavingPercent(double separate_ms, double ms) {
+    if (separate_ms <= 0.0 || ms < 0.0) {
+      return 0.0;
+    }
+    return 100.0 * (separate_ms - ms) / separate_ms;
+  }
+
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreatePipeline(
+      vulkan::OffscreenDepthPass* pass) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app_->CreateGraphicsPipeline(pipeline_layout_.get(),
+                                     &pass->render_pass(), 0));
+    switch (pass->mode()) {
+      case Mode::kSeparate:
+        pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                            separate_shadow_shader);
+        break;
+      case Mode::kMultiview:
+        pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                            multiview_shadow_shader);
+        break;
+      case Mode::kLayered:
+        pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                            layered_shadow_shader);
+        break;
+    }
+    pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pass->ConfigurePipeline(pipeline.get(), kConstantBias, kSlopeBias,
+                            depth_clamp_);
+    pipeline->Commit();
+    return pipeline;
+  }
+
+  // Draws every cube into pass |pass| of |shadow|.
+  void DrawPass(vulkan::VkCommandBuffer* cmd,
+                vulkan::OffscreenDepthPass* shadow,
+                vulkan::VulkanGraphicsPipeline* pipeline, uint32_t pass) {
+    (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              *pipeline);
+    DrawData draw = {0, pass, shadow->num_layers()};
+    const uint32_t instances = shadow->instance_count(1);
+    for (uint32_t object = 0; object < objects_; ++object) {
+      draw.object = object;
+      (*cmd)->vkCmdPushConstants(*cmd, ::VkPipelineLayout(*pipeline_layout_),
+                                 VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw),
+                                 &draw);
+      (*cmd)->vkCmdDraw(*cmd, kCubeVertices, instances, 0, 0);
+    }
+  }
+
+  // Returns the fastest of kNumRuns runs of frames_ frames with |mode|.
+  // Every frame writes a timestamp before its first pass, and after each
+  // of its passes, so that the separate path has the time of every
+  // cascade.
+  Result Measure(Mode mode, uint32_t num_cascades) {
+    vulkan::OffscreenDepthPass shadow(app_, mode, num_cascades, resolution_,
+                                      resolution_, kDepthFormat);
+    auto pipeline = CreatePipeline(&shadow);
+
+    const uint32_t num_passes = shadow.num_passes();
+    const uint32_t timestamps_per_frame = num_passes + 1;
+    const uint32_t num_timestamps = frames_ * timestamps_per_frame;
+    vulkan::VkQueryPool query_pool = vulkan::CreateQueryPool(
+        &app_->device(),
+        {
+            VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+            nullptr,                                   // pNext
+            0,                                         // flags
+            VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+            num_timestamps,                            // queryCount
+            0                                          // pipelineStatistics
+        });
+    std::vector<uint64_t> timestamps(num_timestamps);
+
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    const double period =
+        static_cast<double>(device.limits().timestampPeriod);
+    Result best = {num_cascades, vulkan::LayeredRenderPass::ModeName(mode),
+                   resolution_, -1.0, std::vector<double>()};
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool, 0, num_timestamps);
+      for (uint32_t frame = 0; frame < frames_; ++frame) {
+        const uint32_t first_query = frame * timestamps_per_frame;
+        cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 query_pool, first_query);
+        for (uint32_t i = 0; i < num_passes; ++i) {
+          shadow.RecordPass(
+              &cmd, i,
+              [this, &shadow, &pipeline](vulkan::VkCommandBuffer* pass_cmd,
+                                         uint32_t pass) {
+                DrawPass(pass_cmd, &shadow, pipeline.get(), pass);
+              });
+          cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                   query_pool, first_query + i + 1);
+        }
+      }
+      cmd->vkEndCommandBuffer(cmd);
+
+      VkSubmitInfo submit_info = {
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+          nullptr,                        // pNext
+          0,                              // waitSemaphoreCount
+          nullptr,                        // pWaitSemaphores
+          nullptr,                        // pWaitDstStageMask
+          1,                              // commandBufferCount
+          &cmd.get_command_buffer(),      // pCommandBuffers
+          0,                              // signalSemaphoreCount
+          nullptr                         // pSignalSemaphores
+      };
+      queue->vkQueueSubmit(queue, 1, &submit_info, ::VkFence(0));
+      queue->vkQueueWaitIdle(queue);
+
+      if (device->vkGetQueryPoolResults(
+              device, query_pool, 0, num_timestamps,
+              num_timestamps * sizeof(uint64_t), timestamps.data(),
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      // The time of every pass, summed over the frames.
+      std::vector<double> pass_ns(num_passes, 0.0);
+      double frames_ns = 0.0;
+      for (uint32_t frame = 0; frame < frames_; ++frame) {
+        const uint64_t* frame_timestamps =
+            &timestamps[frame * timestamps_per_frame];
+        for (uint32_t i = 0; i < num_passes; ++i) {
+          pass_ns[i] +=
+              ((frame_timestamps[i + 1] - frame_timestamps[i]) &
+               timestamp_mask_) *
+              period;
+        }
+        frames_ns +=
+            ((frame_timestamps[num_passes] - frame_timestamps[0]) &
+             timestamp_mask_) *
+            period;
+      }
+      const double gpu_ms = frames_ns / frames_ / 1.0e6;
+      if (best.gpu_ms < 0.0 || gpu_ms < best.gpu_ms) {
+        best.gpu_ms = gpu_ms;
+        // A single pass has every cascade in it, the cost of each is only
+        // known when it has a pass of its own.
+        best.cascade_gpu_ms.clear();
+        if (mode == Mode::kSeparate) {
+          for (double ns : pass_ns) {
+            best.cascade_gpu_ms.push_back(ns / frames_ / 1.0e6);
+          }
+        }
+      }
+    }
+    return best;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t frames_;
+  uint32_t objects_;
+  uint32_t resolution_;
+  const char* paths_;
+  bool depth_clamp_;
+  uint64_t timestamp_mask_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+};
+
+// Returns the device extensions of |paths|.
+const std::initializer_list<const char*>& DeviceExtensions(
+    const char* paths) {
+  const bool multiview = entry::ListHas(paths, "multiview");
+  const bool layered = entry::ListHas(paths, "layered");
+  if (multiview) {
+    return layered ? kMultiviewLayeredExtensions : kMultiviewExtensions;
+  }
+  return layered ? kLayeredExtensions : kNoExtensions;
+}
+}  // anonymous namespace
+
+// This sample renders the shadow casters of a scene, a grid of cubes, into
+// 2 and 4 cascades of a directional light's shadow map with
+// vulkan::OffscreenDepthPass. The cascades are layers of a depth array
+// image of their own resolution, bound from an arena of their own, and are
+// rendered depth only, with depth bias, with:
+//  - separate: one render pass per cascade, which draws every cube,
+//  - multiview: one VK_KHR_multiview render pass with a view mask of every
+//    cascade, which draws every cube once,
+//  - layered: one render pass with a framebuffer of every cascade, which
+//    draws an instance of every cube per cascade and picks the layer with
+//    gl_Layer, which needs VK_EXT_shader_viewport_index_layer.
+// For every cascade count and path it logs:
+//   CASCADED_SHADOW: cascades: <n> path: <name> resolution: <n>
+//       passes_per_frame: <n> draws_per_frame: <n> gpu_ms_per_frame: <ms>
+//       gpu_ms_per_cascade: <ms>
+// the GPU time of each cascade where it has a pass of its own as
+//   CASCADED_SHADOW_CASCADE: cascades: <n> path: <name> cascade: <i>
+//       gpu_ms: <ms>
+// and the path with the fastest GPU time, with what it saves compared to
+// the separate path, as
+//   CASCADED_SHADOW_BEST: cascades: <n> path: <name> gpu_saving_percent: <p>
+// -sample-option=paths is a comma separated list of the paths to measure,
+// e.g. -sample-option=paths=separate,layered, by default
+// separate,multiview, and the device needs the extensions of each. An
+// unknown path is an error. cascades only measures that cascade count,
+// resolution sets the width and height of every cascade, objects the cubes
+// of the scene, frames the frames of every run, depth_clamp=1 clamps the
+// casters in front of the cascades instead of clipping them, which needs
+// depthClamp, and results=<file> writes the results to <file>, as CSV.
+int main_entry(const entry::EntryData* data) {
+  logging::Logger* log = data->logger();
+  log->LogInfo("Application Startup");
+
+  const char* paths = GetPaths(data);
+  std::string unknown_path;
+  if (!vulkan::LayeredRenderPass::ModeNamesValid(paths, &unknown_path)) {
+    log->LogError("Unknown path \"", unknown_path,
+                  "\" in -sample-option=paths");
+    return -1;
+  }
+  const bool multiview = entry::ListHas(paths, "multiview");
+  const bool depth_clamp = data->sample_option_uint("depth_clamp", 0) != 0;
+  VkPhysicalDeviceFeatures features = {0};
+  features.depthClamp = depth_clamp;
+  // VK_KHR_multiview requires the feature, but the device must still be
+  // created with it.
+  VkPhysicalDeviceMultiviewFeatures multiview_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES,  // sType
+      nullptr,                                               // pNext
+      VK_TRUE,                                               // multiview
+      VK_FALSE,  // multiviewGeometryShader
+      VK_FALSE   // multiviewTessellationShader
+  };
+
+  // The cascades have an arena of their own, the device-only image arena
+  // only has to be large enough to create.
+  vulkan::VulkanApplication app(
+      data->allocator(), log, data,
+      multiview ? kMultiviewInstanceExtensions : kNoExtensions,
+      DeviceExtensions(paths), features, 1024 * 1024, 1024 * 1024,
+      1024 * 1024, 1024 * 1024, false, false, false, 0, false, false,
+      VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, false, false, nullptr, false, false,
+      multiview ? &multiview_features : nullptr);
+  CascadedShadowBenchmark benchmark(data, &app, depth_clamp);
+  std::vector<Result> results;
+  if (!benchmark.Run(&results)) {
+    return -1;
+  }
+
+  const char* results_file = data->sample_option("results");
+  if (results_file) {
+    std::ofstream out_file(results_file);
+    out_file << "cascades,path,resolution,gpu_ms,cascade,cascade_gpu_ms\n";
+    for (const Result& result : results) {
+      // One row for the frame, with a cascade of -1, and one per cascade
+      // that was measured on its own.
+      out_file << result.num_cascades << "," << result.path << ","
+               << result.resolution << "," << result.gpu_ms << ",-1,"
+               << result.gpu_ms << "\n";
+      for (size_t i = 0; i < result.cascade_gpu_ms.size(); ++i) {
+        out_file << result.num_cascades << "," << result.path << ","
+                 << result.resolution << "," << result.gpu_ms << "," << i
+                 << "," << result.cascade_gpu_ms[i] << "\n";
+      }
+    }
+    LOG_ASSERT(==, log, false, out_file.bad());
+    log->LogInfo("Wrote the results to \"", results_file, "\"");
+  }
+
+  log->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,77 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The shadow casters that every path renders into the cascades of one
+// directional light: a grid of cubes of different heights around the
+// camera, which is at the origin. The vertex shaders only differ in where
+// they get the cascade of a vertex from, and call cascade_position() with
+// it. There is no fragment shader, the passes only write depth.
+
+layout(push_constant) uniform draw_data {
+    // The cube of the draw.
+    uint object;
+    // The cascade of the draw in the separate path.
+    uint cascade;
+    // The cascades of the pass. The layered path draws an instance per
+    // cascade.
+    uint num_cascades;
+} draw;
+
+// The first cascade covers this far around the camera, and every cascade
+// covers kCascadeScale times as far as the one before it.
+const float kFirstCascadeExtent = 4.0;
+const float kCascadeScale = 3.0;
+// The depth range of the light, around the camera.
+const float kLightDepth = 200.0;
+// The cubes are kGridSpacing apart on a square grid.
+const float kGridSpacing = 3.0;
+
+// Two triangles for each face of a cube, as indices of its corners. Bit 0,
+// 1 and 2 of a corner index are its x, y and z.
+const uint kCubeIndices[36] = uint[](
+    0u, 2u, 4u, 4u, 2u, 6u,
+    1u, 3u, 5u, 5u, 3u, 7u,
+    0u, 1u, 4u, 4u, 1u, 5u,
+    2u, 3u, 6u, 6u, 3u, 7u,
+    0u, 1u, 2u, 2u, 1u, 3u,
+    4u, 5u, 6u, 6u, 5u, 7u);
+
+// Returns the clip space position of vertex |vertex| of cube |object| in
+// the orthographic projection of cascade |cascade|.
+vec4 cascade_position(uint vertex, uint object, uint cascade) {
+    uint corner = kCubeIndices[vertex];
+    vec3 position =
+        vec3(corner & 1u, (corner >> 1u) & 1u, (corner >> 2u) & 1u);
+
+    // Rows of 32 cubes, so that the default 1024 of them cover the inner
+    // cascades and reach into the outer ones.
+    float row = float(object / 32u) - 15.5;
+    float column = float(object % 32u) - 15.5;
+    float height = 1.0 + float((object * 7u) % 5u);
+    vec3 world = vec3(column * kGridSpacing + position.x,
+                      position.y * height,
+                      row * kGridSpacing + position.z);
+
+    // The light shines down at an angle, from the side of +x and +y.
+    const vec3 light_z = normalize(vec3(-1.0, -2.0, -0.5));
+    const vec3 light_x = normalize(cross(vec3(0.0, 0.0, 1.0), light_z));
+    const vec3 light_y = cross(light_z, light_x);
+    vec3 light = vec3(dot(world, light_x), dot(world, light_y),
+                      dot(world, light_z));
+
+    float extent = kFirstCascadeExtent * pow(kCascadeScale, float(cascade));
+    return vec4(light.xy / extent,
+                light.z / (2.0 * kLightDepth) + 0.5, 1.0);
+}
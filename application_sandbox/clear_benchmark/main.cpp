@@ -0,0 +1,523 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace {
+// The clears of every run, unless frames=<N> was given.
+const uint32_t kDefaultFrames = 16;
+// Every configuration is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 5;
+// Enough for the largest target, 4K with 4 samples of 4 bytes.
+const uint32_t kImageMemory = 192 * 1024 * 1024;
+
+// The ways in which a target is cleared. All of them then store the target
+// at the end of a render pass.
+enum class ClearMethod {
+  // The load op of the render pass clears the target.
+  kLoadOpClear,
+  // vkCmdClearAttachments clears the target at the start of a render pass
+  // that does not load it.
+  kClearAttachments,
+  // vkCmdClearColorImage or vkCmdClearDepthStencilImage clears the target
+  // before a render pass that loads it.
+  kClearImage,
+  // The target is neither cleared nor loaded, which is what the others are
+  // compared with.
+  kDontCare,
+};
+
+struct MethodInfo {
+  ClearMethod method;
+  // The name of the method in the sample options and the results.
+  const char* name;
+};
+
+const MethodInfo kMethods[] = {
+    {ClearMethod::kLoadOpClear, "load_op_clear"},
+    {ClearMethod::kClearAttachments, "clear_attachments"},
+    {ClearMethod::kClearImage, "clear_image"},
+    {ClearMethod::kDontCare, "dont_care"},
+};
+
+struct TargetInfo {
+  // The name of the target in the sample options and the results.
+  const char* name;
+  VkFormat format;
+  VkImageAspectFlags aspect;
+  // The size of a sample, in bytes.
+  uint32_t sample_size;
+};
+
+// Both formats can be rendered to on every device.
+const TargetInfo kTargets[] = {
+    {"color", VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 4},
+    {"depth", VK_FORMAT_D16_UNORM, VK_IMAGE_ASPECT_DEPTH_BIT, 2},
+};
+
+struct Resolution {
+  const char* name;
+  uint32_t width;
+  uint32_t height;
+};
+
+const Resolution kResolutions[] = {
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+};
+
+// The sample counts are checked against the limits of the device.
+const VkSampleCountFlagBits kSampleCounts[] = {VK_SAMPLE_COUNT_1_BIT,
+                                               VK_SAMPLE_COUNT_4_BIT};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// The render pass of a clear waits for the store of the one before, and
+// for a clear of the image before it.
+const VkSubpassDependency kClearDependency = {
+    VK_SUBPASS_EXTERNAL,  // srcSubpass
+    0,                    // dstSubpass
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_TRANSFER_BIT,  // srcStageMask
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,  // dstStageMask
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_TRANSFER_WRITE_BIT,  // srcAccessMask
+    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,  // dstAccessMask
+    0                                                  // dependencyFlags
+};
+
+// Clears color and depth targets at every resolution and sample count with
+// every method, and measures the GPU time of a clear.
+class ClearBenchmark {
+ public:
+  ClearBenchmark(const entry::EntryData* data, vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        frames_(data->sample_option_uint("frames", kDefaultFrames)),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })) {}
+
+  // Measures every configuration that the sample options do not rule out,
+  // and logs the results.
+  void Run() {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    const char* target_option = data_->sample_option("target");
+    const char* resolution_option = data_->sample_option("resolution");
+    const uint32_t samples_option = data_->sample_option_uint("samples", 0);
+    const char* method_option = data_->sample_option("method");
+    for (const TargetInfo& target : kTargets) {
+      if (target_option && strcmp(target_option, target.name) != 0) {
+        continue;
+      }
+      for (const Resolution& resolution : kResolutions) {
+        if (resolution_option &&
+            strcmp(resolution_option, resolution.name) != 0) {
+          continue;
+        }
+        for (VkSampleCountFlagBits samples : kSampleCounts) {
+          if (samples_option && samples_option != samples) {
+            continue;
+          }
+          const VkPhysicalDeviceLimits& limits = app_->device().limits();
+          const VkSampleCountFlags supported =
+              target.aspect == VK_IMAGE_ASPECT_DEPTH_BIT
+                  ? limits.framebufferDepthSampleCounts
+                  : limits.framebufferColorSampleCounts;
+          if (!(supported & samples)) {
+            data_->logger()->LogInfo("CLEAR: target: ", target.name,
+                                     " samples: ", samples,
+                                     " is skipped, it is not supported");
+            continue;
+          }
+          // The fastest method of the configuration, which is what the
+          // render passes of the device should use.
+          const char* best_method = nullptr;
+          double best_ns = -1.0;
+          for (const MethodInfo& method : kMethods) {
+            if (method_option && strcmp(method_option, method.name) != 0) {
+              continue;
+            }
+            const double ns = Measure(target, resolution, samples, method);
+            data_->logger()->LogInfo(
+                "CLEAR: target: ", target.name,
+                " resolution: ", resolution.name, " samples: ", samples,
+                " method: ", method.name,
+                " ms_per_clear: ", ns < 0.0 ? -1.0 : ns / frames_ / 1.0e6,
+                " estimated_mb_per_clear: ",
+                EstimatedBytes(target, resolution, samples, method) /
+                    (1024.0 * 1024.0));
+            // Not clearing is only the baseline, it is never a choice.
+            if (method.method != ClearMethod::kDontCare && ns >= 0.0 &&
+                (best_ns < 0.0 || ns < best_ns)) {
+              best_method = method.name;
+              best_ns = ns;
+            }
+          }
+          if (best_method) {
+            data_->logger()->LogInfo("CLEAR_BEST: target: ", target.name,
+                                     " resolution: ", resolution.name,
+                                     " samples: ", samples,
+                                     " method: ", best_method);
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  // The target of one configuration, and the render pass that clears it.
+  struct Frame {
+    containers::unique_ptr<vulkan::VulkanApplication::Image> image;
+    containers::unique_ptr<vulkan::VkImageView> view;
+    containers::unique_ptr<vulkan::VkRenderPass> render_pass;
+    containers::unique_ptr<vulkan::VkFramebuffer> framebuffer;
+  };
+
+  static VkImageLayout AttachmentLayout(const TargetInfo& target) {
+    return target.aspect == VK_IMAGE_ASPECT_DEPTH_BIT
+               ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+               : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  }
+
+  // The bytes that a clear moves to and from memory on a tiled GPU, if the
+  // target is not compressed: the store of every sample, plus the clear
+  // and the load of an image that is cleared outside of the render pass.
+  // Immediate mode GPUs often clear only the metadata of a compressed
+  // target instead.
+  static double EstimatedBytes(const TargetInfo& target,
+                               const Resolution& resolution,
+                               VkSampleCountFlagBits samples,
+                               const MethodInfo& method) {
+    const double bytes = static_cast<double>(resolution.width) *
+                         resolution.height * samples * target.sample_size;
+    return method.method == ClearMethod::kClearImage ? 3.0 * bytes : bytes;
+  }
+
+  void CreateFrame(const TargetInfo& target, const Resolution& resolution,
+                   VkSampleCountFlagBits samples, const MethodInfo& method,
+                   Frame* frame) {
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,            // sType
+        nullptr,                                        // pNext
+        0,                                              // flags
+        VK_IMAGE_TYPE_2D,                               // imageType
+        target.format,                                  // format
+        {resolution.width, resolution.height, 1},       // extent
+        1,                                              // mipLevels
+        1,                                              // arrayLayers
+        samples,                                        // samples
+        VK_IMAGE_TILING_OPTIMAL,                        // tiling
+        static_cast<VkImageUsageFlags>(
+            (target.aspect == VK_IMAGE_ASPECT_DEPTH_BIT
+                 ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                 : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) |
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT),  // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr,                               // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,             // initialLayout
+    };
+    frame->image = app_->CreateAndBindImage(&image_create_info);
+    frame->view = app_->CreateImageView(frame->image.get(),
+                                        VK_IMAGE_VIEW_TYPE_2D,
+                                        {target.aspect, 0, 1, 0, 1});
+
+    const VkImageLayout layout = AttachmentLayout(target);
+    VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    if (method.method == ClearMethod::kLoadOpClear) {
+      load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    } else if (method.method == ClearMethod::kClearImage) {
+      load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+    }
+    const bool depth = target.aspect == VK_IMAGE_ASPECT_DEPTH_BIT;
+    const VkAttachmentDescription description = {
+        0,                                    // flags
+        target.format,                        // format
+        samples,                              // samples
+        load_op,                              // loadOp
+        VK_ATTACHMENT_STORE_OP_STORE,         // storeOp
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE,      // stencilLoadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,     // stencilStoreOp
+        load_op == VK_ATTACHMENT_LOAD_OP_LOAD
+            ? layout
+            : VK_IMAGE_LAYOUT_UNDEFINED,  // initialLayout
+        layout                            // finalLayout
+    };
+    VkAttachmentReference reference = {0, layout};
+    VkSubpassDescription subpass = {
+        0,                                // flags
+        VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+        0,                                // inputAttachmentCount
+        nullptr,                          // pInputAttachments
+        depth ? 0u : 1u,                  // colorAttachmentCount
+        depth ? nullptr : &reference,     // pColorAttachments
+        nullptr,                          // pResolveAttachments
+        depth ? &reference : nullptr,     // pDepthStencilAttachment
+        0,                                // preserveAttachmentCount
+        nullptr                           // pPreserveAttachments
+    };
+    frame->render_pass = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app_->CreateRenderPass({description}, {subpass}, {kClearDependency}));
+
+    ::VkImageView raw_view = *frame->view;
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *frame->render_pass,                        // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        resolution.width,                           // width
+        resolution.height,                          // height
+        1                                           // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    app_->device()->vkCreateFramebuffer(
+        app_->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame->framebuffer = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app_->device()));
+  }
+
+  // Records one clear of |frame| as |method|, and the render pass that
+  // stores it.
+  void RecordClear(vulkan::VkCommandBuffer* cmd, const TargetInfo& target,
+                   const Resolution& resolution, const MethodInfo& method,
+                   const Frame& frame) {
+    const bool depth = target.aspect == VK_IMAGE_ASPECT_DEPTH_BIT;
+    VkClearValue clear_value;
+    if (depth) {
+      clear_value.depthStencil = {1.0f, 0};
+    } else {
+      clear_value.color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    }
+
+    if (method.method == ClearMethod::kClearImage) {
+      const VkImageLayout layout = AttachmentLayout(target);
+      const VkAccessFlags attachment_access =
+          depth ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+                : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      const VkPipelineStageFlags attachment_stages =
+          depth ? VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+                : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      VkImageMemoryBarrier barrier = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+          nullptr,                                 // pNext
+          attachment_access,                       // srcAccessMask
+          VK_ACCESS_TRANSFER_WRITE_BIT,            // dstAccessMask
+          layout,                                  // oldLayout
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,    // newLayout
+          VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+          *frame.image,                            // image
+          {target.aspect, 0, 1, 0, 1}              // subresourceRange
+      };
+      (*cmd)->vkCmdPipelineBarrier(*cmd, attachment_stages,
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                   nullptr, 0, nullptr, 1, &barrier);
+      const VkImageSubresourceRange range = {target.aspect, 0, 1, 0, 1};
+      if (depth) {
+        (*cmd)->vkCmdClearDepthStencilImage(
+            *cmd, *frame.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            &clear_value.depthStencil, 1, &range);
+      } else {
+        (*cmd)->vkCmdClearColorImage(*cmd, *frame.image,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     &clear_value.color, 1, &range);
+      }
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask =
+          depth ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+                : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = layout;
+      (*cmd)->vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   attachment_stages, 0, 0, nullptr, 0,
+                                   nullptr, 1, &barrier);
+    }
+
+    const VkRect2D area = {{0, 0}, {resolution.width, resolution.height}};
+    VkRenderPassBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *frame.render_pass,                        // renderPass
+        *frame.framebuffer,                        // framebuffer
+        area,                                      // renderArea
+        method.method == ClearMethod::kLoadOpClear ? 1u
+                                                   : 0u,  // clearValueCount
+        &clear_value                                      // pClearValues
+    };
+    (*cmd)->vkCmdBeginRenderPass(*cmd, &begin_info,
+                                 VK_SUBPASS_CONTENTS_INLINE);
+    if (method.method == ClearMethod::kClearAttachments) {
+      const VkClearAttachment attachment = {
+          target.aspect,  // aspectMask
+          0,              // colorAttachment
+          clear_value     // clearValue
+      };
+      const VkClearRect rect = {
+          area,  // rect
+          0,     // baseArrayLayer
+          1      // layerCount
+      };
+      (*cmd)->vkCmdClearAttachments(*cmd, 1, &attachment, 1, &rect);
+    }
+    (*cmd)->vkCmdEndRenderPass(*cmd);
+  }
+
+  // Returns the fastest of kNumRuns runs of frames_ clears, in nanoseconds,
+  // or a negative number if it could not be measured.
+  double Measure(const TargetInfo& target, const Resolution& resolution,
+                 VkSampleCountFlagBits samples, const MethodInfo& method) {
+    Frame frame;
+    CreateFrame(target, resolution, samples, method, &frame);
+
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      // The render pass may load the target, so it starts out in the
+      // attachment layout.
+      VkImageMemoryBarrier barrier = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+          nullptr,                                 // pNext
+          0,                                       // srcAccessMask
+          0,                                       // dstAccessMask
+          VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+          AttachmentLayout(target),                // newLayout
+          VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+          *frame.image,                            // image
+          {target.aspect, 0, 1, 0, 1}              // subresourceRange
+      };
+      cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+                                nullptr, 0, nullptr, 1, &barrier);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               query_pool_, 0);
+      for (uint32_t i = 0; i < frames_; ++i) {
+        RecordClear(&cmd, target, resolution, method, frame);
+      }
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      cmd->vkEndCommandBuffer(cmd);
+
+      VkSubmitInfo submit_info = {
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+          nullptr,                        // pNext
+          0,                              // waitSemaphoreCount
+          nullptr,                        // pWaitSemaphores
+          nullptr,                        // pWaitDstStageMask
+          1,                              // commandBufferCount
+          &cmd.get_command_buffer(),      // pCommandBuffers
+          0,                              // signalSemaphoreCount
+          nullptr                         // pSignalSemaphores
+      };
+      queue->vkQueueSubmit(queue, 1, &submit_info, ::VkFence(0));
+      queue->vkQueueWaitIdle(queue);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    return best;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t frames_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+};
+}  // anonymous namespace
+
+// This sample clears a color and a depth target, at 1080p and 4K, with 1
+// and 4 samples, with the load op of the render pass, with
+// vkCmdClearAttachments in the render pass, with vkCmdClear*Image before
+// it, and not at all. For every configuration it logs:
+//   CLEAR: target: <color|depth> resolution: <1080p|4k> samples: <1|4>
+//       method: <name> ms_per_clear: <ms> estimated_mb_per_clear: <mb>
+// and the fastest method that clears as
+//   CLEAR_BEST: target: <name> resolution: <name> samples: <n>
+//       method: <name>
+// -sample-option=target, resolution, samples and method only measure one of
+// them, and frames sets the number of clears of every run.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data, {},
+                                {}, {0}, 1024 * 1024, kImageMemory);
+  ClearBenchmark benchmark(data, &app);
+  benchmark.Run();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,543 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/upload_batch.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+#include <chrono>
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector3 = mathfu::Vector<float, 3>;
+
+namespace torus_model {
+#include "torus_knot.obj.h"
+}
+const auto& torus_data = torus_model::model;
+
+uint32_t cluster_cull_shader[] =
+#include "cluster_cull.comp.spv"
+    ;
+
+uint32_t cluster_culling_vertex_shader[] =
+#include "cluster_culling.vert.spv"
+    ;
+
+uint32_t cluster_culling_fragment_shader[] =
+#include "cluster_culling.frag.spv"
+    ;
+
+// This must match local_size_x in cluster_cull.comp.
+const uint32_t kClusterCullGroupSize = 64;
+
+struct ClusterCullingFrameData {
+  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> torus_descriptor_set_;
+  containers::unique_ptr<vulkan::DescriptorSet> cull_descriptor_set_;
+  // The draws of the clusters that survived culling, and how many there are.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> draw_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> count_buffer_;
+};
+
+// This renders a torus knot, split into clusters of triangles by
+// convert_obj_to_c.py. Every frame a compute shader culls the clusters that
+// are outside of the view frustum, or that face away from the camera, and
+// writes a compacted list of draws for the rest. That list is drawn with
+// vkCmdDrawIndexedIndirectCountKHR.
+class ClusterCullingSample
+    : public sample_application::Sample<ClusterCullingFrameData> {
+ public:
+  ClusterCullingSample(const entry::EntryData* data,
+                       const VkPhysicalDeviceFeatures& requested_features)
+      : data_(data),
+        Sample<ClusterCullingFrameData>(
+            data->allocator(), data, 1, 512, 1, 1,
+            sample_application::SampleOptions().EnableDepthBuffer(),
+            requested_features, {},
+            {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME}),
+        torus_(data->allocator(), data->logger(), torus_data) {}
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    cluster_bounds_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        sizeof(torus_data.cluster_bounds),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    cluster_ranges_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        sizeof(torus_data.cluster_ranges),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    vulkan::UploadBatch upload_batch(app());
+    upload_batch.AddModel(&torus_);
+    upload_batch.AddBuffer(cluster_bounds_buffer_.get(), 0,
+                           torus_data.cluster_bounds,
+                           sizeof(torus_data.cluster_bounds),
+                           VK_ACCESS_SHADER_READ_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    upload_batch.AddBuffer(cluster_ranges_buffer_.get(), 0,
+                           torus_data.cluster_ranges,
+                           sizeof(torus_data.cluster_ranges),
+                           VK_ACCESS_SHADER_READ_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    upload_staging_buffer_ = upload_batch.Record(initialization_buffer);
+
+    torus_descriptor_set_layouts_[0] = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    torus_descriptor_set_layouts_[1] = {
+        1,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{torus_descriptor_set_layouts_[0],
+                                      torus_descriptor_set_layouts_[1]}}));
+
+    // The cull shader reads the camera and the model uniforms, and the
+    // clusters, and writes the draws and the draw count.
+    for (uint32_t i = 0; i < 6; ++i) {
+      cull_descriptor_set_layouts_[i] = {
+          i,  // binding
+          i < 2 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+          nullptr                                     // pImmutableSamplers
+      };
+    }
+
+    cull_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{cull_descriptor_set_layouts_[0], cull_descriptor_set_layouts_[1],
+              cull_descriptor_set_layouts_[2], cull_descriptor_set_layouts_[3],
+              cull_descriptor_set_layouts_[4],
+              cull_descriptor_set_layouts_[5]}}));
+    cull_pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+        data_->allocator(),
+        app()->CreateComputePipeline(
+            cull_pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                sizeof(cluster_cull_shader), cluster_cull_shader},
+            "main"));
+
+    VkAttachmentReference depth_attachment = {
+        0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference color_attachment = {
+        1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                 0,                                 // flags
+                 depth_format(),                    // format
+                 num_samples(),                     // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stenilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stenilStoreOp
+                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // initialLayout
+                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // finalLayout
+             },
+             {
+                 0,                                         // flags
+                 render_format(),                           // format
+                 num_samples(),                             // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+             }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                &depth_attachment,                // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    torus_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    torus_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                               cluster_culling_vertex_shader);
+    torus_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                               cluster_culling_fragment_shader);
+    torus_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    torus_pipeline_->SetInputStreams(&torus_);
+    torus_pipeline_->SetViewport(viewport());
+    torus_pipeline_->SetScissor(scissor());
+    torus_pipeline_->SetSamples(num_samples());
+    torus_pipeline_->AddAttachment();
+    torus_pipeline_->Commit();
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(Vector3{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+
+    // Close enough to the camera that part of the torus is off-screen.
+    model_data_->data().transform =
+        Mat44::FromTranslationVector(Vector3{1.5f, 0.0f, -2.5f}) *
+        Mat44::FromScaleVector(Vector3{0.5f, 0.5f, 0.5f});
+  }
+
+  virtual void InitializationComplete() override {
+    upload_staging_buffer_.reset();
+  }
+
+  virtual void InitializeFrameData(
+      ClusterCullingFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            data_->allocator(), app()->GetCommandBuffer());
+
+    frame_data->draw_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        torus_data.num_clusters * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    frame_data->count_buffer_ =
+        app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+            sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    frame_data->torus_descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({torus_descriptor_set_layouts_[0],
+                                          torus_descriptor_set_layouts_[1]}));
+    frame_data->cull_descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet(
+                {cull_descriptor_set_layouts_[0],
+                 cull_descriptor_set_layouts_[1],
+                 cull_descriptor_set_layouts_[2],
+                 cull_descriptor_set_layouts_[3],
+                 cull_descriptor_set_layouts_[4],
+                 cull_descriptor_set_layouts_[5]}));
+
+    VkDescriptorBufferInfo buffer_infos[6] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            model_data_->get_buffer(),                       // buffer
+            model_data_->get_offset_for_frame(frame_index),  // offset
+            model_data_->size(),                             // range
+        },
+        {
+            *cluster_bounds_buffer_,  // buffer
+            0,                        // offset
+            VK_WHOLE_SIZE,            // range
+        },
+        {
+            *cluster_ranges_buffer_,  // buffer
+            0,                        // offset
+            VK_WHOLE_SIZE,            // range
+        },
+        {
+            *frame_data->draw_buffer_,  // buffer
+            0,                          // offset
+            VK_WHOLE_SIZE,              // range
+        },
+        {
+            *frame_data->count_buffer_,  // buffer
+            0,                           // offset
+            VK_WHOLE_SIZE,               // range
+        }};
+
+    VkWriteDescriptorSet writes[3] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->torus_descriptor_set_,      // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->cull_descriptor_set_,       // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->cull_descriptor_set_,       // dstSet
+            2,                                       // dstbinding
+            0,                                       // dstArrayElement
+            4,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos + 2,                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 3, writes, 0,
+                                            nullptr);
+
+    ::VkImageView raw_views[2] = {depth_view(frame_data),
+                                  color_view(frame_data)};
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        2,                                          // attachmentCount
+        raw_views,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+
+    (*frame_data->command_buffer_)
+        ->vkBeginCommandBuffer((*frame_data->command_buffer_),
+                               &sample_application::kBeginCommandBuffer);
+    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
+
+    // Reset the draw count. The draws of the last use of this frame have
+    // finished reading the buffers before the cull shader writes to them.
+    cmdBuffer->vkCmdFillBuffer(cmdBuffer, *frame_data->count_buffer_, 0,
+                               sizeof(uint32_t), 0);
+    VkBufferMemoryBarrier count_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,  // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,     // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,     // dstQueueFamilyIndex
+        *frame_data->count_buffer_,  // buffer
+        0,                           // offset
+        VK_WHOLE_SIZE,               // size
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+        &count_barrier, 0, nullptr);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *cull_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*cull_pipeline_layout_), 0, 1,
+        &frame_data->cull_descriptor_set_->raw_set(), 0, nullptr);
+    cmdBuffer->vkCmdDispatch(
+        cmdBuffer,
+        static_cast<uint32_t>(
+            (torus_data.num_clusters + kClusterCullGroupSize - 1) /
+            kClusterCullGroupSize),
+        1, 1);
+
+    VkBufferMemoryBarrier draw_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *frame_data->draw_buffer_,                // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *frame_data->count_buffer_,               // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 2, draw_barriers,
+        0, nullptr);
+
+    VkClearValue clears[2];
+    vulkan::MemoryClear(&clears[0]);
+    clears[0].depthStencil.depth = 1.0f;
+    vulkan::MemoryClear(&clears[1]);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        2,                                // clearValueCount
+        clears                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *torus_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->torus_descriptor_set_->raw_set(), 0, nullptr);
+    torus_.BindVertexAndIndexBuffers(&cmdBuffer);
+
+    cmdBuffer->vkCmdDrawIndexedIndirectCountKHR(
+        cmdBuffer, *frame_data->draw_buffer_, 0, *frame_data->count_buffer_, 0,
+        static_cast<uint32_t>(torus_data.num_clusters),
+        static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+
+    (*frame_data->command_buffer_)
+        ->vkEndCommandBuffer(*frame_data->command_buffer_);
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    model_data_->data().transform =
+        model_data_->data().transform *
+        Mat44::FromRotationMatrix(
+            Mat44::RotationX(3.14f * time_since_last_render * 0.25f) *
+            Mat44::RotationY(3.14f * time_since_last_render * 0.125f));
+  }
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      ClusterCullingFrameData* frame_data) override {
+    VkSubmitInfo init_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &(frame_data->command_buffer_->get_command_buffer()),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &init_submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+  }
+
+ private:
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  struct ModelData {
+    Mat44 transform;
+  };
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> torus_pipeline_;
+  containers::unique_ptr<vulkan::PipelineLayout> cull_pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> cull_pipeline_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding torus_descriptor_set_layouts_[2];
+  VkDescriptorSetLayoutBinding cull_descriptor_set_layouts_[6];
+  vulkan::VulkanModel torus_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      upload_staging_buffer_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      cluster_bounds_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      cluster_ranges_buffer_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  VkPhysicalDeviceFeatures requested_features = {0};
+  // More than one draw is read from the indirect buffer.
+  requested_features.multiDrawIndirect = VK_TRUE;
+  ClusterCullingSample sample(data, requested_features);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
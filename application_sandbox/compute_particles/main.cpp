@@ -17,15 +17,19 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/radix_sort.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 #include "vulkan_helpers/vulkan_texture.h"
+#include "vulkan_helpers/workgroup_size_tuner.h"
 
 #include "particle_data_shared.h"
 
 #include <chrono>
 
 #include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <mutex>
 #include <thread>
@@ -43,6 +47,54 @@ uint32_t velocity_shader[] =
 #include "particle_velocity_update.comp.spv"
     ;
 
+uint32_t tiled_velocity_shader[] =
+#include "particle_velocity_update_tiled.comp.spv"
+    ;
+
+uint32_t grid_velocity_shader[] =
+#include "particle_velocity_update_grid.comp.spv"
+    ;
+
+uint32_t grid_count_shader[] =
+#include "grid_count.comp.spv"
+    ;
+
+uint32_t grid_scan_shader[] =
+#include "grid_scan.comp.spv"
+    ;
+
+uint32_t grid_scatter_shader[] =
+#include "grid_scatter.comp.spv"
+    ;
+
+uint32_t grid_reduce_shader[] =
+#include "grid_reduce.comp.spv"
+    ;
+
+uint32_t sorted_simulation_shader[] =
+#include "particle_update_sorted.comp.spv"
+    ;
+
+uint32_t gather_shader[] =
+#include "particle_gather.comp.spv"
+    ;
+
+uint32_t sort_count_shader[] =
+#include "sort/radix_sort_count.comp.spv"
+    ;
+
+uint32_t sort_scan_shader[] =
+#include "sort/radix_sort_scan.comp.spv"
+    ;
+
+uint32_t sort_scatter_shader[] =
+#include "sort/radix_sort_scatter.comp.spv"
+    ;
+
+uint32_t sort_scatter_subgroup_shader[] =
+#include "sort/radix_sort_scatter_subgroup.comp.spv"
+    ;
+
 uint32_t particle_fragment_shader[] =
 #include "particle.frag.spv"
     ;
@@ -51,6 +103,34 @@ uint32_t particle_vertex_shader[] =
 #include "particle.vert.spv"
     ;
 
+uint32_t point_vertex_shader[] =
+#include "particle_point.vert.spv"
+    ;
+
+uint32_t point_fragment_shader[] =
+#include "particle_point.frag.spv"
+    ;
+
+uint32_t expand_shader[] =
+#include "particle_expand.comp.spv"
+    ;
+
+uint32_t expanded_vertex_shader[] =
+#include "particle_expanded.vert.spv"
+    ;
+
+uint32_t raster_shader[] =
+#include "particle_raster.comp.spv"
+    ;
+
+uint32_t resolve_vertex_shader[] =
+#include "particle_resolve.vert.spv"
+    ;
+
+uint32_t resolve_fragment_shader[] =
+#include "particle_resolve.frag.spv"
+    ;
+
 namespace particle_texture {
 #include "particle.png.h"
 }
@@ -62,13 +142,131 @@ struct time_data {
   float time;
 };
 
+// Returns the number of particles from -sample-option=particles, rounded up
+// to a multiple of PARTICLE_GRANULARITY, or TOTAL_PARTICLES.
+uint32_t GetNumParticles(const entry::EntryData* data) {
+  const char* particles = data->sample_option("particles");
+  if (!particles) {
+    return TOTAL_PARTICLES;
+  }
+  uint32_t num_particles =
+      static_cast<uint32_t>(strtoul(particles, nullptr, 10));
+  num_particles = (num_particles + PARTICLE_GRANULARITY - 1) /
+                  PARTICLE_GRANULARITY * PARTICLE_GRANULARITY;
+  return num_particles > 0 ? num_particles : PARTICLE_GRANULARITY;
+}
+
+// How the particles are sorted before they are drawn, from
+// -sample-option=sort=shared or -sample-option=sort=subgroup.
+enum class SortMode {
+  kNone,
+  // vulkan::RadixSort ranks the keys of every tile in shared memory.
+  kShared,
+  // vulkan::RadixSort ranks them with subgroup ballots.
+  kSubgroup,
+};
+
+SortMode GetSortMode(const entry::EntryData* data) {
+  const char* sort = data->sample_option("sort");
+  if (!sort) {
+    return SortMode::kNone;
+  }
+  return strcmp(sort, "subgroup") == 0 ? SortMode::kSubgroup
+                                       : SortMode::kShared;
+}
+
+// How the particles are drawn, from -sample-option=render.
+enum class RenderPath : uint32_t {
+  // Every particle is an instance of the quad model.
+  kInstanced,
+  // Every particle is a point sprite, which needs the largePoints feature.
+  kPoints,
+  // particle_expand.comp writes the corners of every quad into a vertex
+  // buffer, which is drawn with a single indexed draw.
+  kExpanded,
+  // particle_raster.comp adds every particle to the pixels it covers with
+  // atomics, and a fullscreen pass writes the sums to the render target.
+  kRaster,
+};
+const uint32_t kNumRenderPaths = 4;
+const char* const kRenderPathNames[kNumRenderPaths] = {"instanced", "points",
+                                                       "expanded", "raster"};
+// The GPU profiler zones that measure the paths.
+const char* const kRenderPathZones[kNumRenderPaths] = {
+    "draw_instanced", "draw_points", "draw_expanded", "draw_raster"};
+// With -sample-option=render=all, every path draws this many frames in turn.
+const uint32_t kFramesPerRenderPath = 240;
+
+// Returns true if -sample-option=render=all was given.
+bool CyclesRenderPaths(const entry::EntryData* data) {
+  const char* render = data->sample_option("render");
+  return render && strcmp(render, "all") == 0;
+}
+
+// Returns the path of -sample-option=render, or the first one that
+// -sample-option=render=all draws.
+RenderPath GetRenderPath(const entry::EntryData* data) {
+  const char* render = data->sample_option("render");
+  for (uint32_t i = 0; render && i < kNumRenderPaths; ++i) {
+    if (strcmp(render, kRenderPathNames[i]) == 0) {
+      return static_cast<RenderPath>(i);
+    }
+  }
+  return RenderPath::kInstanced;
+}
+
+// Returns true if |path| draws at some point.
+bool UsesRenderPath(const entry::EntryData* data, RenderPath path) {
+  return CyclesRenderPaths(data) || GetRenderPath(data) == path;
+}
+
+// Returns true if |path| runs a compute shader on the render queue.
+bool IsComputeRenderPath(RenderPath path) {
+  return path == RenderPath::kExpanded || path == RenderPath::kRaster;
+}
+
+// Point sprites of more than one pixel need largePoints.
+VkPhysicalDeviceFeatures ParticleFeatures(const entry::EntryData* data) {
+  VkPhysicalDeviceFeatures features = {0};
+  if (UsesRenderPath(data, RenderPath::kPoints)) {
+    features.largePoints = VK_TRUE;
+  }
+  return features;
+}
+
+const std::initializer_list<const char*> kNoExtensions = {};
+// vulkan::RadixSort::SubgroupsSupported needs these.
+const std::initializer_list<const char*> kSubgroupInstanceExtensions = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
+
+// The drawing and the sort are measured by the GPU profiler, and the
+// subgroup scatter needs Vulkan 1.1.
+sample_application::SampleOptions ParticleOptions(
+    const entry::EntryData* data) {
+  sample_application::SampleOptions options;
+  options.EnableAsyncCompute().EnableMultisampling();
+  options.EnableGpuProfiler(2);
+  if (GetSortMode(data) == SortMode::kSubgroup) {
+    options.EnableVulkan11();
+  }
+  return options;
+}
+
 class ComputeTask {
  public:
-  ComputeTask(containers::Allocator* allocator, vulkan::VulkanApplication* app)
+  // |profiler| measures the sort, if -sample-option=sort was given.
+  ComputeTask(containers::Allocator* allocator, vulkan::VulkanApplication* app,
+              vulkan::GpuProfiler* profiler)
       : allocator_(allocator),
         compute_data_(allocator),
+        grid_reduce_pipelines_(allocator),
+        profiler_(profiler),
         app_(app),
         last_update_time_(std::chrono::high_resolution_clock::now()) {
+    num_particles_ = GetNumParticles(app_->entry_data());
+    const char* simulation = app_->entry_data()->sample_option("simulation");
+    grid_ = simulation && strcmp(simulation, "grid") == 0;
+    app_->GetLogger()->LogInfo("Simulating ", num_particles_, " particles");
     if (!app_->async_compute_queue()) {
       return;
     }
@@ -80,7 +278,16 @@ class ComputeTask {
 
     InitSimulationSSBO();
     InitRenderSSBO();
+    if (grid_) {
+      InitGridSSBOs();
+    }
+    const SortMode sort = GetSortMode(app_->entry_data());
+    if (sort != SortMode::kNone) {
+      InitSort(sort);
+    }
     CreateComputePipelines();
+    // Tuning ran the simulation, so only fill it in afterwards.
+    FillSimulationSSBO();
     InitComputeTaskData();
   }
 
@@ -88,6 +295,11 @@ class ComputeTask {
     return render_ssbo_.get();
   }
 
+  uint32_t num_particles() const { return num_particles_; }
+
+  // Returns true if the particles are drawn from slow to fast.
+  bool sorted() const { return sort_ != nullptr; }
+
   vulkan::VkSemaphore* GetSemaphoreForIndex(int32_t buffer) const {
     return compute_data_[buffer].semaphore_.get();
   }
@@ -110,13 +322,19 @@ class ComputeTask {
 
     update_time_data_->data()[0] = static_cast<float>(current_frame++);
     update_time_data_->data()[1] = elapsed_time.count();
-    if (current_frame >= TOTAL_PARTICLES) {
+    if (current_frame >= static_cast<int>(num_particles_)) {
       current_frame = 0;
     }
     update_time_data_->UpdateBuffer(app_->async_compute_queue(), frame_index);
 
     VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
     auto& dat = compute_data_[frame_index];
+    if (sort_) {
+      // The zone of the sort is recorded every frame. The last frame of
+      // this image waited for this command buffer, and it is done.
+      dat.command_buffer_->vkResetCommandBuffer(dat.command_buffer_, 0);
+      RecordComputeCommandBuffer(frame_index);
+    }
     // This is where the computation actually happens
     VkSubmitInfo computation_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
@@ -139,32 +357,61 @@ class ComputeTask {
 
  private:
   void InitSimulationSSBO() {
-    auto initial_data_buffer = containers::make_unique<vulkan::VkCommandBuffer>(
-        allocator_, GetComputeCommandBuffer());
-
-    (*initial_data_buffer)
-        ->vkBeginCommandBuffer(*initial_data_buffer,
-                               &sample_application::kBeginCommandBuffer);
-
     // Create the single SSBO for simulation
     VkBufferCreateInfo create_info = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,       // sType
-        nullptr,                                    // pNext
-        0,                                          // createFlags
-        sizeof(simulation_data) * TOTAL_PARTICLES,  // size
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,      // sType
+        nullptr,                                   // pNext
+        0,                                         // createFlags
+        sizeof(simulation_data) * num_particles_,  // size
         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,    // usageFlags
-        VK_SHARING_MODE_EXCLUSIVE,                 // sharingMode
-        0,                                         // queueFamilyIndexCount
-        nullptr                                    // pQueueFamilyIndices
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
+        VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
+        0,                                       // queueFamilyIndexCount
+        nullptr                                  // pQueueFamilyIndices
     };
 
     simulation_ssbo_ = app_->CreateAndBindDeviceBuffer(&create_info);
+  }
+
+  // Creates the SSBOs that the grid simulation is built in every step. Like
+  // simulation_ssbo_, they are shared by all frames. See particle_grid.glsl
+  // for their contents.
+  void InitGridSSBOs() {
+    const VkDeviceSize sizes[4] = {
+        sizeof(uint32_t) * 2 * GRID_CELLS,       // cell_count, cell_start
+        sizeof(float) * 4 * GRID_PYRAMID_CELLS,  // cell_mass
+        sizeof(uint32_t) * 2 * num_particles_,   // particle_slot
+        // A grid_particle is padded to 16 bytes.
+        sizeof(float) * 4 * num_particles_,  // sorted_particles
+    };
+    for (size_t i = 0; i < 4; ++i) {
+      VkBufferCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // createFlags
+          sizes[i],                              // size
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
+          VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
+          0,                                       // queueFamilyIndexCount
+          nullptr                                  // pQueueFamilyIndices
+      };
+      grid_ssbos_[i] = app_->CreateAndBindDeviceBuffer(&create_info);
+    }
+  }
+
+  void FillSimulationSSBO() {
+    auto initial_data_buffer = containers::make_unique<vulkan::VkCommandBuffer>(
+        allocator_, GetComputeCommandBuffer());
+
+    (*initial_data_buffer)
+        ->vkBeginCommandBuffer(*initial_data_buffer,
+                               &sample_application::kBeginCommandBuffer);
 
     srand(0);
     // Fill this SSBO with random initial positions.
     containers::vector<simulation_data> fill_data(allocator_);
-    fill_data.resize(TOTAL_PARTICLES);
+    fill_data.resize(num_particles_);
     for (auto& particle : fill_data) {
       float distance =
           static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
@@ -228,111 +475,300 @@ class ComputeTask {
                               {compute_descriptor_set_layouts_[0],
                                compute_descriptor_set_layouts_[1],
                                compute_descriptor_set_layouts_[2]}))});
+      WriteComputeDescriptorSet(*compute_data_.back().compute_descriptor_set_,
+                                i);
+      // With the sort, the command buffers are recorded every frame.
+      if (!sort_) {
+        RecordComputeCommandBuffer(i);
+      }
+    }
+  }
 
-      VkDescriptorBufferInfo buffer_infos[3] = {
-          {
-              update_time_data_->get_buffer(),             // buffer
-              update_time_data_->get_offset_for_frame(i),  // offset
-              update_time_data_->size(),                   // range
-          },
-          {
-              *simulation_ssbo_,         // buffer
-              0,                         // offset
-              simulation_ssbo_->size(),  // range
-          },
-          {
-              *render_ssbo_,         // buffer
-              0,                     // offset
-              render_ssbo_->size(),  // range
-          },
-      };
-      VkWriteDescriptorSet write = {
-          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,         // sType
-          nullptr,                                        // pNext
-          *compute_data_.back().compute_descriptor_set_,  // dstSet
-          0,                                              // dstbinding
-          0,                                              // dstArrayElement
-          3,                                              // descriptorCount
-          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,              // descriptorType
-          nullptr,                                        // pImageInfo
-          buffer_infos,                                   // pBufferInfo
-          nullptr,                                        // pTexelBufferView
-      };
-
-      app_->device()->vkUpdateDescriptorSets(app_->device(), 1, &write, 0,
-                                             nullptr);
-
-      auto& dat = compute_data_.back();
-      VkBufferMemoryBarrier barrier = {
-          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-          nullptr,                                  // pNext
-          0,                                        // srcAccessMask
-          0,                                        // dstAccessMask
-          app_->render_queue().index(),             // srcQueueFamilyIndex
-          app_->async_compute_queue()->index(),     // dstQueueFamilyIndex
-          *render_ssbo_,                            // buffer
-          0,                                        //  offset
-          render_ssbo_->size(),                     // size
-      };
+  // Records the simulation step into the command buffer of |frame_index|.
+  void RecordComputeCommandBuffer(size_t frame_index) {
+    auto& dat = compute_data_[frame_index];
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        0,                                        // srcAccessMask
+        0,                                        // dstAccessMask
+        app_->render_queue().index(),             // srcQueueFamilyIndex
+        app_->async_compute_queue()->index(),     // dstQueueFamilyIndex
+        *render_ssbo_,                            // buffer
+        0,                                        //  offset
+        render_ssbo_->size(),                     // size
+    };
 
-      auto& command_buffer = dat.command_buffer_;
-      command_buffer->vkBeginCommandBuffer(
-          command_buffer, &sample_application::kBeginCommandBuffer);
-
-      // Transfer the ownership from the render_queue to this queue.
-      command_buffer->vkCmdPipelineBarrier(
-          command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0,
-          nullptr);
-
-      command_buffer->vkCmdBindDescriptorSets(
-          command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-          ::VkPipelineLayout(*compute_pipeline_layout_), 0, 1,
-          &dat.compute_descriptor_set_->raw_set(), 0, nullptr);
-      command_buffer->vkCmdBindPipeline(
-          command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, *velocity_pipeline_);
-      // Run the first half of the simulation.
-      command_buffer->vkCmdDispatch(
-          command_buffer, TOTAL_PARTICLES / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
-      VkBufferMemoryBarrier simulation_barrier = {
-          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-          nullptr,                                  // pNext
-          VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
-          VK_ACCESS_SHADER_READ_BIT,                // dstAccessMask
-          VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
-          VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
-          *simulation_ssbo_,                        // buffer
-          0,                                        //  offset
-          simulation_ssbo_->size(),                 // size
-      };
-      // Wait for all of the updates to velocity to be done before
-      // moving on to the position updates. This is because the velocity
-      // for a single particle is dependent on the positions of all other
-      // particles, so avoid race conditions.
-      command_buffer->vkCmdPipelineBarrier(
-          command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
-          &simulation_barrier, 0, nullptr);
+    auto& command_buffer = dat.command_buffer_;
+    command_buffer->vkBeginCommandBuffer(
+        command_buffer, &sample_application::kBeginCommandBuffer);
+
+    // Transfer the ownership from the render_queue to this queue.
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0,
+        nullptr);
+
+    command_buffer->vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*compute_pipeline_layout_), 0, 1,
+        &dat.compute_descriptor_set_->raw_set(), 0, nullptr);
+    // Run the first half of the simulation.
+    RecordVelocityUpdate(&command_buffer);
+    VkBufferMemoryBarrier simulation_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,                // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *simulation_ssbo_,                        // buffer
+        0,                                        //  offset
+        simulation_ssbo_->size(),                 // size
+    };
+    // Wait for all of the updates to velocity to be done before
+    // moving on to the position updates. This is because the velocity
+    // for a single particle is dependent on the positions of all other
+    // particles, so avoid race conditions.
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+        &simulation_barrier, 0, nullptr);
+    if (sort_) {
+      RecordSortedPositionUpdate(&command_buffer,
+                                 *dat.compute_descriptor_set_);
+    } else {
       command_buffer->vkCmdBindPipeline(command_buffer,
                                         VK_PIPELINE_BIND_POINT_COMPUTE,
                                         *position_update_pipeline_);
       // Update the positions, and fill the output buffer.
       command_buffer->vkCmdDispatch(
-          command_buffer, TOTAL_PARTICLES / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
+          command_buffer, num_particles_ / position_update_local_size_, 1,
+          1);
+    }
+
+    // Transition the old buffer back.
+    barrier.srcQueueFamilyIndex = app_->async_compute_queue()->index();
+    barrier.dstQueueFamilyIndex = app_->render_queue().index();
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = 0;
+
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0,
+        nullptr);
+
+    command_buffer->vkEndCommandBuffer(command_buffer);
+  }
+
+  // Records the position update of -sample-option=sort into
+  // |command_buffer|, where |compute_set| is bound with
+  // compute_pipeline_layout_. The particles are sorted by their speed, and
+  // the output buffer is filled in that order.
+  void RecordSortedPositionUpdate(vulkan::VkCommandBuffer* command_buffer,
+                                  ::VkDescriptorSet compute_set) {
+    vulkan::VkCommandBuffer& cmd = *command_buffer;
+    // Set 0 is the same in both layouts, so it stays bound.
+    cmd->vkCmdBindDescriptorSets(
+        cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*sort_pipeline_layout_), 1, 1,
+        &sort_descriptor_set_->raw_set(), 0, nullptr);
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           *sorted_update_pipeline_);
+    cmd->vkCmdDispatch(cmd, num_particles_ / position_update_local_size_, 1,
+                       1);
+    {
+      vulkan::GpuZone zone(profiler_, command_buffer, "radix_sort");
+      sort_->Sort(command_buffer, num_particles_);
+    }
+    // The layout of the sort is not compatible with either set, so both are
+    // bound again.
+    ::VkDescriptorSet sets[2] = {compute_set, sort_descriptor_set_->raw_set()};
+    cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 ::VkPipelineLayout(*sort_pipeline_layout_),
+                                 0, 2, sets, 0, nullptr);
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           *gather_pipeline_);
+    cmd->vkCmdDispatch(cmd, num_particles_ / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
+  }
+
+  // Records the velocity update into |command_buffer|, where the set of
+  // compute_pipeline_layout_ is bound. The grid simulation builds the grid
+  // first.
+  void RecordVelocityUpdate(vulkan::VkCommandBuffer* command_buffer) {
+    vulkan::VkCommandBuffer& cmd = *command_buffer;
+    if (grid_) {
+      // Set 0 is the same in both layouts, so it stays bound.
+      cmd->vkCmdBindDescriptorSets(
+          cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+          ::VkPipelineLayout(*grid_pipeline_layout_), 1, 1,
+          &grid_descriptor_set_->raw_set(), 0, nullptr);
+      // The last step has finished reading the counts before they are
+      // cleared.
+      cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                                0, nullptr, 0, nullptr);
+      cmd->vkCmdFillBuffer(cmd, *grid_ssbos_[0], 0,
+                           sizeof(uint32_t) * GRID_CELLS, 0);
+      VkMemoryBarrier clear_barrier = {
+          VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+          nullptr,                           // pNext
+          VK_ACCESS_TRANSFER_WRITE_BIT,      // srcAccessMask
+          VK_ACCESS_SHADER_READ_BIT |
+              VK_ACCESS_SHADER_WRITE_BIT  // dstAccessMask
+      };
+      cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                &clear_barrier, 0, nullptr, 0, nullptr);
+
+      const uint32_t particle_groups =
+          num_particles_ / COMPUTE_SHADER_LOCAL_SIZE;
+      DispatchGridPass(command_buffer, *grid_count_pipeline_, particle_groups);
+      DispatchGridPass(command_buffer, *grid_scan_pipeline_, 1);
+      DispatchGridPass(command_buffer, *grid_scatter_pipeline_,
+                       particle_groups);
+      for (uint32_t level = 0; level < GRID_LEVELS; ++level) {
+        const uint32_t level_size = GRID_SIZE >> level;
+        DispatchGridPass(command_buffer, *grid_reduce_pipelines_[level],
+                         (level_size * level_size + COMPUTE_SHADER_LOCAL_SIZE -
+                          1) / COMPUTE_SHADER_LOCAL_SIZE);
+      }
+    }
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           *velocity_pipeline_);
+    cmd->vkCmdDispatch(cmd, num_particles_ / velocity_local_size_, 1, 1);
+  }
+
+  // Dispatches one of the passes that build the grid, and waits for its
+  // writes before the next pass.
+  void DispatchGridPass(vulkan::VkCommandBuffer* command_buffer,
+                        ::VkPipeline pipeline, uint32_t num_workgroups) {
+    vulkan::VkCommandBuffer& cmd = *command_buffer;
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    cmd->vkCmdDispatch(cmd, num_workgroups, 1, 1);
+    VkMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,        // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT  // dstAccessMask
+    };
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                              &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  void WriteGridDescriptorSet(::VkDescriptorSet set) {
+    VkDescriptorBufferInfo buffer_infos[4];
+    for (size_t i = 0; i < 4; ++i) {
+      buffer_infos[i] = {
+          *grid_ssbos_[i],         // buffer
+          0,                       // offset
+          grid_ssbos_[i]->size(),  // range
+      };
+    }
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        set,                                     // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        4,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+
+    app_->device()->vkUpdateDescriptorSets(app_->device(), 1, &write, 0,
+                                           nullptr);
+  }
+
+  void WriteComputeDescriptorSet(::VkDescriptorSet set, size_t frame) {
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        {
+            update_time_data_->get_buffer(),                 // buffer
+            update_time_data_->get_offset_for_frame(frame),  // offset
+            update_time_data_->size(),                       // range
+        },
+        {
+            *simulation_ssbo_,         // buffer
+            0,                         // offset
+            simulation_ssbo_->size(),  // range
+        },
+        {
+            *render_ssbo_,         // buffer
+            0,                     // offset
+            render_ssbo_->size(),  // range
+        },
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        set,                                     // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        3,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
 
-      // Transition the old buffer back.
-      barrier.srcQueueFamilyIndex = app_->async_compute_queue()->index();
-      barrier.dstQueueFamilyIndex = app_->render_queue().index();
-      barrier.srcAccessMask = 0;
-      barrier.dstAccessMask = 0;
+    app_->device()->vkUpdateDescriptorSets(app_->device(), 1, &write, 0,
+                                           nullptr);
+  }
 
-      command_buffer->vkCmdPipelineBarrier(
-          command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0,
-          nullptr);
+  // Creates a pipeline with |layout|, or compute_pipeline_layout_. Only
+  // grid_reduce.comp uses |grid_level|.
+  containers::unique_ptr<vulkan::VulkanComputePipeline> CreateComputePipeline(
+      const VkShaderModuleCreateInfo& shader, uint32_t local_size,
+      vulkan::PipelineLayout* layout = nullptr, uint32_t grid_level = 0) {
+    vulkan::SpecializationConstants constants(allocator_);
+    constants.Set(0, local_size);
+    constants.Set(1, num_particles_);
+    constants.Set(2, grid_level);
+    return containers::make_unique<vulkan::VulkanComputePipeline>(
+        allocator_,
+        app_->CreateComputePipeline(
+            layout ? layout : compute_pipeline_layout_.get(), shader, "main",
+            constants));
+  }
 
-      command_buffer->vkEndCommandBuffer(command_buffer);
+  // Returns the fastest workgroup size of |shader| on this device, which
+  // is tuned with |set| bound if it was not already.
+  uint32_t TuneComputePipeline(const char* name,
+                               const VkShaderModuleCreateInfo& shader,
+                               ::VkDescriptorSet set) {
+    vulkan::WorkgroupSizeTuner tuner(app_, name, COMPUTE_SHADER_LOCAL_SIZE,
+                                     num_particles_);
+    if (tuner.tuned()) {
+      return tuner.local_size();
+    }
+    containers::vector<containers::unique_ptr<vulkan::VulkanComputePipeline>>
+        pipelines(allocator_);
+    for (uint32_t local_size : tuner.candidates()) {
+      pipelines.push_back(CreateComputePipeline(shader, local_size));
     }
+    return tuner.Tune(
+        app_->async_compute_queue(),
+        [&](vulkan::VkCommandBuffer* command_buffer, uint32_t local_size) {
+          size_t i = 0;
+          while (tuner.candidates()[i] != local_size) {
+            ++i;
+          }
+          (*command_buffer)
+              ->vkCmdBindDescriptorSets(
+                  *command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                  ::VkPipelineLayout(*compute_pipeline_layout_), 0, 1, &set,
+                  0, nullptr);
+          (*command_buffer)
+              ->vkCmdBindPipeline(*command_buffer,
+                                  VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  *pipelines[i]);
+          (*command_buffer)
+              ->vkCmdDispatch(*command_buffer, num_particles_ / local_size,
+                              1, 1);
+        });
   }
 
   void CreateComputePipelines() {
@@ -370,26 +806,198 @@ class ComputeTask {
         app_->CreatePipelineLayout({{compute_descriptor_set_layouts_[0],
                                      compute_descriptor_set_layouts_[1],
                                      compute_descriptor_set_layouts_[2]}}));
-    position_update_pipeline_ =
-        containers::make_unique<vulkan::VulkanComputePipeline>(
-            allocator_,
-            app_->CreateComputePipeline(
-                compute_pipeline_layout_.get(),
-                VkShaderModuleCreateInfo{
-                    VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
-                    sizeof(simulation_shader), simulation_shader},
-                "main"));
+    const VkShaderModuleCreateInfo position_update_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(simulation_shader), simulation_shader};
+
+    // The workgroup sizes are tuned on the real buffers, whose contents are
+    // filled in afterwards.
+    vulkan::DescriptorSet tuning_set = app_->AllocateDescriptorSet(
+        {compute_descriptor_set_layouts_[0], compute_descriptor_set_layouts_[1],
+         compute_descriptor_set_layouts_[2]});
+    WriteComputeDescriptorSet(tuning_set, 0);
+    position_update_local_size_ = TuneComputePipeline(
+        "particle_update", position_update_shader, tuning_set);
+    position_update_pipeline_ = CreateComputePipeline(
+        position_update_shader, position_update_local_size_);
+    if (sort_) {
+      CreateSortPipelines();
+    }
 
+    if (grid_) {
+      CreateGridPipelines();
+      return;
+    }
     // This is the pipeline that updates the velocity based on all of the
-    // particles positions.
-    velocity_pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+    // particles positions. With -sample-option=velocity_update=tiled, the
+    // positions are staged in shared memory.
+    const char* velocity_update =
+        app_->entry_data()->sample_option("velocity_update");
+    const bool tiled = velocity_update && strcmp(velocity_update, "tiled") == 0;
+    app_->GetLogger()->LogInfo("Updating velocities with the ",
+                               tiled ? "tiled" : "default", " shader");
+    const VkShaderModuleCreateInfo velocity_update_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        tiled ? sizeof(tiled_velocity_shader) : sizeof(velocity_shader),
+        tiled ? tiled_velocity_shader : velocity_shader};
+
+    velocity_local_size_ = TuneComputePipeline(
+        tiled ? "particle_velocity_update_tiled" : "particle_velocity_update",
+        velocity_update_shader, tuning_set);
+    velocity_pipeline_ =
+        CreateComputePipeline(velocity_update_shader, velocity_local_size_);
+  }
+
+  // Creates the pipelines of the grid simulation, whose second set holds
+  // the grid. They keep the default workgroup size, since timing them would
+  // need a grid that was built from the real positions.
+  void CreateGridPipelines() {
+    app_->GetLogger()->LogInfo("Updating velocities with the grid shader");
+    for (uint32_t i = 0; i < 4; ++i) {
+      grid_descriptor_set_layouts_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    grid_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
         allocator_,
-        app_->CreateComputePipeline(
-            compute_pipeline_layout_.get(),
-            VkShaderModuleCreateInfo{
-                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
-                sizeof(velocity_shader), velocity_shader},
-            "main"));
+        app_->CreatePipelineLayout({{compute_descriptor_set_layouts_[0],
+                                     compute_descriptor_set_layouts_[1],
+                                     compute_descriptor_set_layouts_[2]},
+                                    {grid_descriptor_set_layouts_[0],
+                                     grid_descriptor_set_layouts_[1],
+                                     grid_descriptor_set_layouts_[2],
+                                     grid_descriptor_set_layouts_[3]}}));
+    grid_descriptor_set_ = containers::make_unique<vulkan::DescriptorSet>(
+        allocator_, app_->AllocateDescriptorSet(
+                        {grid_descriptor_set_layouts_[0],
+                         grid_descriptor_set_layouts_[1],
+                         grid_descriptor_set_layouts_[2],
+                         grid_descriptor_set_layouts_[3]}));
+    WriteGridDescriptorSet(*grid_descriptor_set_);
+
+    const VkShaderModuleCreateInfo count_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(grid_count_shader), grid_count_shader};
+    const VkShaderModuleCreateInfo scan_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(grid_scan_shader), grid_scan_shader};
+    const VkShaderModuleCreateInfo scatter_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(grid_scatter_shader), grid_scatter_shader};
+    const VkShaderModuleCreateInfo reduce_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(grid_reduce_shader), grid_reduce_shader};
+    const VkShaderModuleCreateInfo velocity_update_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(grid_velocity_shader), grid_velocity_shader};
+
+    vulkan::PipelineLayout* layout = grid_pipeline_layout_.get();
+    grid_count_pipeline_ =
+        CreateComputePipeline(count_shader, COMPUTE_SHADER_LOCAL_SIZE, layout);
+    grid_scan_pipeline_ =
+        CreateComputePipeline(scan_shader, COMPUTE_SHADER_LOCAL_SIZE, layout);
+    grid_scatter_pipeline_ = CreateComputePipeline(
+        scatter_shader, COMPUTE_SHADER_LOCAL_SIZE, layout);
+    for (uint32_t level = 0; level < GRID_LEVELS; ++level) {
+      grid_reduce_pipelines_.push_back(CreateComputePipeline(
+          reduce_shader, COMPUTE_SHADER_LOCAL_SIZE, layout, level));
+    }
+    velocity_pipeline_ =
+        CreateComputePipeline(velocity_update_shader, velocity_local_size_,
+                              layout);
+  }
+
+  // Creates the sort of -sample-option=sort. If the device cannot run the
+  // subgroup scatter, the shared memory one is used instead.
+  void InitSort(SortMode mode) {
+    if (mode == SortMode::kSubgroup &&
+        !vulkan::RadixSort::SubgroupsSupported(app_)) {
+      app_->GetLogger()->LogInfo(
+          "Subgroup ballots are not supported, sorting in shared memory");
+      mode = SortMode::kShared;
+    }
+    app_->GetLogger()->LogInfo("Sorting the particles with the ",
+                               mode == SortMode::kSubgroup ? "subgroup"
+                                                           : "shared",
+                               " scatter");
+    if (mode == SortMode::kSubgroup) {
+      sort_ = containers::make_unique<vulkan::RadixSort>(
+          allocator_, app_, num_particles_, sort_count_shader,
+          sort_scan_shader, sort_scatter_subgroup_shader);
+    } else {
+      sort_ = containers::make_unique<vulkan::RadixSort>(
+          allocator_, app_, num_particles_, sort_count_shader,
+          sort_scan_shader, sort_scatter_shader);
+    }
+  }
+
+  // Creates the pipelines that write the sort keys and that gather the
+  // sorted particles, whose second set holds the keys and values of sort_.
+  // The update keeps the tuned size of particle_update.comp, which does the
+  // same work.
+  void CreateSortPipelines() {
+    for (uint32_t i = 0; i < 2; ++i) {
+      sort_descriptor_set_layouts_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    sort_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        allocator_,
+        app_->CreatePipelineLayout({{compute_descriptor_set_layouts_[0],
+                                     compute_descriptor_set_layouts_[1],
+                                     compute_descriptor_set_layouts_[2]},
+                                    {sort_descriptor_set_layouts_[0],
+                                     sort_descriptor_set_layouts_[1]}}));
+    sort_descriptor_set_ = containers::make_unique<vulkan::DescriptorSet>(
+        allocator_,
+        app_->AllocateDescriptorSet({sort_descriptor_set_layouts_[0],
+                                     sort_descriptor_set_layouts_[1]}));
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {
+            *sort_->keys(),         // buffer
+            0,                      // offset
+            sort_->keys()->size(),  // range
+        },
+        {
+            *sort_->values(),         // buffer
+            0,                        // offset
+            sort_->values()->size(),  // range
+        },
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *sort_descriptor_set_,                   // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    app_->device()->vkUpdateDescriptorSets(app_->device(), 1, &write, 0,
+                                           nullptr);
+
+    const VkShaderModuleCreateInfo update_shader = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(sorted_simulation_shader), sorted_simulation_shader};
+    const VkShaderModuleCreateInfo gather = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+        sizeof(gather_shader), gather_shader};
+    vulkan::PipelineLayout* layout = sort_pipeline_layout_.get();
+    sorted_update_pipeline_ = CreateComputePipeline(
+        update_shader, position_update_local_size_, layout);
+    gather_pipeline_ =
+        CreateComputePipeline(gather, COMPUTE_SHADER_LOCAL_SIZE, layout);
   }
 
   void InitRenderSSBO() {
@@ -399,7 +1007,7 @@ class ComputeTask {
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
         nullptr,                               // pNext
         0,                                     // createFlags
-        sizeof(draw_data) * TOTAL_PARTICLES,   // size
+        sizeof(draw_data) * num_particles_,    // size
         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
         VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
@@ -447,6 +1055,48 @@ class ComputeTask {
   containers::unique_ptr<vulkan::VulkanComputePipeline>
       position_update_pipeline_;
 
+  // The number of particles that are simulated.
+  uint32_t num_particles_ = TOTAL_PARTICLES;
+  // Whether the velocities are updated with the grid, from
+  // -sample-option=simulation=grid.
+  bool grid_ = false;
+  // The cells, their masses, the slot of every particle in its cell, and the
+  // sorted particles, see particle_grid.glsl.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> grid_ssbos_[4];
+  // The layout of the grid pipelines. Its first set is the one of
+  // compute_pipeline_layout_, and its second one holds grid_ssbos_.
+  containers::unique_ptr<vulkan::PipelineLayout> grid_pipeline_layout_;
+  VkDescriptorSetLayoutBinding grid_descriptor_set_layouts_[4];
+  containers::unique_ptr<vulkan::DescriptorSet> grid_descriptor_set_;
+  // The passes that build the grid, in order. There is one reduce pipeline
+  // per level.
+  containers::unique_ptr<vulkan::VulkanComputePipeline> grid_count_pipeline_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> grid_scan_pipeline_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> grid_scatter_pipeline_;
+  containers::vector<containers::unique_ptr<vulkan::VulkanComputePipeline>>
+      grid_reduce_pipelines_;
+
+  // The sort of -sample-option=sort, or nullptr.
+  containers::unique_ptr<vulkan::RadixSort> sort_;
+  // The layout of the sorted update and the gather. Its first set is the one
+  // of compute_pipeline_layout_, and its second one holds the keys and
+  // values of sort_.
+  containers::unique_ptr<vulkan::PipelineLayout> sort_pipeline_layout_;
+  VkDescriptorSetLayoutBinding sort_descriptor_set_layouts_[2];
+  containers::unique_ptr<vulkan::DescriptorSet> sort_descriptor_set_;
+  // This replaces position_update_pipeline_, and writes the sort keys
+  // instead of the output buffer.
+  containers::unique_ptr<vulkan::VulkanComputePipeline>
+      sorted_update_pipeline_;
+  // This fills the output buffer in the order of the sorted keys.
+  containers::unique_ptr<vulkan::VulkanComputePipeline> gather_pipeline_;
+  // This measures the sort.
+  vulkan::GpuProfiler* profiler_;
+
+  // The workgroup sizes that the pipelines above were specialized with.
+  uint32_t velocity_local_size_ = COMPUTE_SHADER_LOCAL_SIZE;
+  uint32_t position_update_local_size_ = COMPUTE_SHADER_LOCAL_SIZE;
+
   // This contains the current timing information.
   containers::unique_ptr<vulkan::BufferFrameData<Mat44>> update_time_data_;
   // The time that the last update was started.
@@ -466,6 +1116,8 @@ struct ComputeParticlesFrameData {
   containers::unique_ptr<vulkan::VkCommandBuffer> draw_command_buffer_;
   containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
   containers::unique_ptr<vulkan::DescriptorSet> particle_descriptor_set_;
+  // The set of the paths that run compute shaders, and of the resolve.
+  containers::unique_ptr<vulkan::DescriptorSet> path_descriptor_set_;
   containers::unique_ptr<vulkan::VkSemaphore> render_semaphore_;
 };
 
@@ -474,18 +1126,193 @@ class ComputeParticlesSample
  public:
   ComputeParticlesSample(const entry::EntryData* data)
       : data_(data),
-        Sample<ComputeParticlesFrameData>(data->allocator(), data, 1, 512, 32,
-                                          1,
-                                          sample_application::SampleOptions()
-                                              .EnableAsyncCompute()
-                                              .EnableMultisampling()),
+        Sample<ComputeParticlesFrameData>(
+            data->allocator(), data, 1, 512, 32, 1, ParticleOptions(data),
+            ParticleFeatures(data),
+            GetSortMode(data) == SortMode::kSubgroup
+                ? kSubgroupInstanceExtensions
+                : kNoExtensions,
+            kNoExtensions),
         quad_model_(data->allocator(), data->logger(), quad_data),
         particle_texture_(data->allocator(), data->logger(), texture_data),
-        compute_task_(data->allocator(), app()) {
+        compute_task_(data->allocator(), app(), gpu_profiler()),
+        render_path_(GetRenderPath(data)),
+        cycle_render_paths_(CyclesRenderPaths(data)) {
     if (!app()->async_compute_queue()) {
       app()->GetLogger()->LogError("Could not find async compute queue.");
       set_invalid(true);
     }
+    app()->GetLogger()->LogInfo(
+        "Drawing the particles ",
+        cycle_render_paths_ ? "with every path in turn"
+                            : kRenderPathNames[uint32_t(render_path_)]);
+  }
+
+  // Additive blending does not depend on the order of the particles, the
+  // sorted ones are blended over each other instead.
+  VkPipelineColorBlendAttachmentState ParticleBlendState() const {
+    return VkPipelineColorBlendAttachmentState{
+        VK_TRUE, VK_BLEND_FACTOR_SRC_ALPHA,
+        compute_task_.sorted() ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA
+                               : VK_BLEND_FACTOR_ONE,
+        VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE,
+        VK_BLEND_OP_ADD,
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
+  }
+
+  // Creates a graphics pipeline of the render pass with |layout|, which
+  // draws |topology| without vertex buffers.
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreateDrawPipeline(
+      vulkan::PipelineLayout* layout, VkPrimitiveTopology topology) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app()->CreateGraphicsPipeline(layout, render_pass_.get(), 0));
+    pipeline->SetTopology(topology);
+    pipeline->SetViewport(viewport());
+    pipeline->SetScissor(scissor());
+    pipeline->SetSamples(num_samples());
+    return pipeline;
+  }
+
+  // Creates the pipelines of the paths other than kInstanced that draw.
+  void preparePathPipelines() {
+    if (UsesRenderPath(data_, RenderPath::kPoints)) {
+      point_pipeline_ = CreateDrawPipeline(pipeline_layout_.get(),
+                                           VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
+      point_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                                 point_vertex_shader);
+      point_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                 point_fragment_shader);
+      point_pipeline_->AddAttachment(ParticleBlendState());
+      point_pipeline_->Commit();
+    }
+    const bool expanded = UsesRenderPath(data_, RenderPath::kExpanded);
+    const bool raster = UsesRenderPath(data_, RenderPath::kRaster);
+    if (!expanded && !raster) {
+      return;
+    }
+
+    for (uint32_t i = 0; i < 6; ++i) {
+      path_bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    path_bindings_[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    path_bindings_[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    // The resolve reads the sums of the compute rasterizer.
+    path_bindings_[5].stageFlags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+    path_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{path_bindings_[0], path_bindings_[1], path_bindings_[2],
+              path_bindings_[3], path_bindings_[4], path_bindings_[5]}},
+            {{VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+              2 * sizeof(uint32_t)}}));
+
+    vulkan::SpecializationConstants constants(data_->allocator());
+    constants.Set(0, COMPUTE_SHADER_LOCAL_SIZE);
+    constants.Set(1, compute_task_.num_particles());
+    if (expanded) {
+      const VkShaderModuleCreateInfo shader = {
+          VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+          sizeof(expand_shader), expand_shader};
+      expand_pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+          data_->allocator(),
+          app()->CreateComputePipeline(path_pipeline_layout_.get(), shader,
+                                       "main", constants));
+      expanded_pipeline_ =
+          CreateDrawPipeline(pipeline_layout_.get(),
+                             VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+      expanded_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                                    expanded_vertex_shader);
+      expanded_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                    particle_fragment_shader);
+      expanded_pipeline_->AddInputStream(
+          3 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX,
+          {{0, VK_FORMAT_R32G32B32_SFLOAT, 0}});
+      expanded_pipeline_->AddAttachment(ParticleBlendState());
+      expanded_pipeline_->Commit();
+    }
+    if (raster) {
+      const VkShaderModuleCreateInfo shader = {
+          VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+          sizeof(raster_shader), raster_shader};
+      raster_pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+          data_->allocator(),
+          app()->CreateComputePipeline(path_pipeline_layout_.get(), shader,
+                                       "main", constants));
+      // The sums are the whole color of the pixel, nothing is blended.
+      resolve_pipeline_ =
+          CreateDrawPipeline(path_pipeline_layout_.get(),
+                             VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+      resolve_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                                   resolve_vertex_shader);
+      resolve_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                   resolve_fragment_shader);
+      resolve_pipeline_->AddAttachment();
+      resolve_pipeline_->Commit();
+    }
+  }
+
+  // Creates the buffers of the paths that run compute shaders. Like the
+  // particles that they are made from, every frame draws from the same ones.
+  void preparePathBuffers(vulkan::VkCommandBuffer* initialization_buffer) {
+    const uint32_t num_particles = compute_task_.num_particles();
+    if (UsesRenderPath(data_, RenderPath::kExpanded)) {
+      VkBufferCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // createFlags
+          // 4 corners of x, y and the speed.
+          sizeof(float) * 12 * num_particles,  // size
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
+          VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
+          0,                                       // queueFamilyIndexCount
+          nullptr                                  // pQueueFamilyIndices
+      };
+      expanded_vertices_ = app()->CreateAndBindDeviceBuffer(&create_info);
+
+      // Two triangles of the corners of every quad, which never change.
+      containers::vector<uint32_t> indices(data_->allocator());
+      indices.resize(6 * num_particles);
+      for (uint32_t i = 0; i < num_particles; ++i) {
+        const uint32_t quad_indices[6] = {0, 1, 2, 2, 1, 3};
+        for (uint32_t j = 0; j < 6; ++j) {
+          indices[6 * i + j] = 4 * i + quad_indices[j];
+        }
+      }
+      create_info.size = sizeof(uint32_t) * indices.size();
+      create_info.usage =
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+      expanded_indices_ = app()->CreateAndBindDeviceBuffer(&create_info);
+      // Like the particles, this is not a small buffer, but the helper
+      // does the job.
+      app()->FillSmallBuffer(expanded_indices_.get(), indices.data(),
+                             sizeof(uint32_t) * indices.size(), 0,
+                             initialization_buffer, VK_ACCESS_INDEX_READ_BIT);
+    }
+    if (UsesRenderPath(data_, RenderPath::kRaster)) {
+      VkBufferCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // createFlags
+          // The red, green and blue sums of every pixel.
+          sizeof(uint32_t) * 3 * app()->swapchain().width() *
+              app()->swapchain().height(),  // size
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
+          VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
+          0,                                       // queueFamilyIndexCount
+          nullptr                                  // pQueueFamilyIndices
+      };
+      raster_accumulation_ = app()->CreateAndBindDeviceBuffer(&create_info);
+    }
   }
 
   void prepareDrawPipeline() {
@@ -576,13 +1403,9 @@ class ComputeParticlesSample
     particle_pipeline_->SetViewport(viewport());
     particle_pipeline_->SetScissor(scissor());
     particle_pipeline_->SetSamples(num_samples());
-    particle_pipeline_->AddAttachment(VkPipelineColorBlendAttachmentState{
-        VK_TRUE, VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE,
-        VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE,
-        VK_BLEND_OP_ADD,
-        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT});
+    particle_pipeline_->AddAttachment(ParticleBlendState());
     particle_pipeline_->Commit();
+    preparePathPipelines();
   }
 
   virtual void InitializeApplicationData(
@@ -593,8 +1416,11 @@ class ComputeParticlesSample
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
     // All of this is the fairly standard setup for rendering.
     quad_model_.InitializeData(app(), initialization_buffer);
-    particle_texture_.InitializeData(app(), initialization_buffer);
+    particle_texture_.InitializeData(app(), initialization_buffer,
+                                     VK_IMAGE_USAGE_SAMPLED_BIT, 0, nullptr,
+                                     true);
     prepareDrawPipeline();
+    preparePathBuffers(initialization_buffer);
   }
 
   virtual void InitializeFrameData(
@@ -617,6 +1443,15 @@ class ComputeParticlesSample
                                      particle_descriptor_set_layouts_[1],
                                      particle_descriptor_set_layouts_[2],
                                      particle_descriptor_set_layouts_[3]}));
+    if (path_pipeline_layout_) {
+      frame_data->path_descriptor_set_ =
+          containers::make_unique<vulkan::DescriptorSet>(
+              data_->allocator(),
+              app()->AllocateDescriptorSet(
+                  {path_bindings_[0], path_bindings_[1], path_bindings_[2],
+                   path_bindings_[3], path_bindings_[4], path_bindings_[5]}));
+      WriteStaticPathDescriptors(*frame_data->path_descriptor_set_);
+    }
 
     frame_data->render_semaphore_ =
         containers::make_unique<vulkan::VkSemaphore>(
@@ -660,6 +1495,56 @@ class ComputeParticlesSample
         vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
   }
 
+  // Writes the texture and the buffers of the paths that run compute shaders
+  // into |set|, which do not change from frame to frame.
+  void WriteStaticPathDescriptors(::VkDescriptorSet set) {
+    VkDescriptorImageInfo sampler_info = {
+        *sampler_,                 // sampler
+        VK_NULL_HANDLE,            // imageView
+        VK_IMAGE_LAYOUT_UNDEFINED  //  imageLayout
+    };
+    VkDescriptorImageInfo texture_info = {
+        VK_NULL_HANDLE,                            // sampler
+        particle_texture_.view(),                  // imageView
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+    };
+    VkDescriptorBufferInfo buffer_infos[2];
+    VkWriteDescriptorSet writes[4];
+    uint32_t num_writes = 0;
+    auto add_write = [&](uint32_t binding, VkDescriptorType type,
+                         const VkDescriptorImageInfo* image_info,
+                         const VkDescriptorBufferInfo* buffer_info) {
+      writes[num_writes++] = {
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+          nullptr,                                 // pNext
+          set,                                     // dstSet
+          binding,                                 // dstbinding
+          0,                                       // dstArrayElement
+          1,                                       // descriptorCount
+          type,                                    // descriptorType
+          image_info,                              // pImageInfo
+          buffer_info,                             // pBufferInfo
+          nullptr,                                 // pTexelBufferView
+      };
+    };
+    add_write(1, VK_DESCRIPTOR_TYPE_SAMPLER, &sampler_info, nullptr);
+    add_write(2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &texture_info, nullptr);
+    // Bindings that the pipelines do not use may stay empty.
+    if (expanded_vertices_) {
+      buffer_infos[0] = {*expanded_vertices_, 0, expanded_vertices_->size()};
+      add_write(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr,
+                &buffer_infos[0]);
+    }
+    if (raster_accumulation_) {
+      buffer_infos[1] = {*raster_accumulation_, 0,
+                         raster_accumulation_->size()};
+      add_write(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr,
+                &buffer_infos[1]);
+    }
+    app()->device()->vkUpdateDescriptorSets(app()->device(), num_writes,
+                                            writes, 0, nullptr);
+  }
+
   virtual void InitializationComplete() override {
     particle_texture_.InitializationComplete();
   }
@@ -675,10 +1560,202 @@ class ComputeParticlesSample
     }
     aspect_buffer_->data()[0] =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    // The size of a particle in pixels, for the point sprites and the
+    // compute rasterizer.
+    aspect_buffer_->data()[1] =
+        (float)app()->swapchain().height() * PARTICLE_SIZE;
+  }
+
+  // With -sample-option=render=all, records the GPU time of the path that
+  // is drawn, and moves on to the next path every kFramesPerRenderPath
+  // frames. Once every path had its turn, the fastest one is logged.
+  void CycleRenderPaths() {
+    const uint32_t path = static_cast<uint32_t>(render_path_);
+    // The zones are read back when their frame slot is used again, so the
+    // first frames of a turn would still see the time of the last turn.
+    if (frames_on_render_path_ > frames_in_flight()) {
+      const float time =
+          gpu_profiler()->GetLastZoneTime(kRenderPathZones[path]);
+      if (time >= 0.0f) {
+        render_path_times_[path] += time;
+        ++render_path_samples_[path];
+      }
+    }
+    if (++frames_on_render_path_ < kFramesPerRenderPath) {
+      return;
+    }
+    frames_on_render_path_ = 0;
+    // Do not modify this line, scripts may look for it in the output.
+    app()->GetLogger()->LogInfo(
+        "PARTICLE_RENDER: path=", kRenderPathNames[path],
+        " particles=", compute_task_.num_particles(),
+        " gpu_ms=", RenderPathMilliseconds(path));
+    if (path + 1 < kNumRenderPaths) {
+      render_path_ = static_cast<RenderPath>(path + 1);
+      return;
+    }
+    uint32_t fastest = 0;
+    for (uint32_t i = 1; i < kNumRenderPaths; ++i) {
+      if (render_path_samples_[i] > 0 &&
+          (render_path_samples_[fastest] == 0 ||
+           RenderPathMilliseconds(i) < RenderPathMilliseconds(fastest))) {
+        fastest = i;
+      }
+    }
+    app()->GetLogger()->LogInfo(
+        "PARTICLE_RENDER: fastest=", kRenderPathNames[fastest],
+        " particles=", compute_task_.num_particles(),
+        " gpu_ms=", RenderPathMilliseconds(fastest));
+    for (uint32_t i = 0; i < kNumRenderPaths; ++i) {
+      render_path_times_[i] = 0.0f;
+      render_path_samples_[i] = 0;
+    }
+    render_path_ = RenderPath::kInstanced;
+  }
+
+  // Returns the mean GPU time of |path| in its last turn, or -1 if it was
+  // not measured.
+  float RenderPathMilliseconds(uint32_t path) const {
+    if (render_path_samples_[path] == 0) {
+      return -1.0f;
+    }
+    return render_path_times_[path] * 1000.0f / render_path_samples_[path];
+  }
+
+  // Records a barrier between two uses of |buffer| on the render queue.
+  void BufferBarrier(vulkan::VkCommandBuffer* cmd,
+                     vulkan::VulkanApplication::Buffer* buffer,
+                     VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                     VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        src_access,                               // srcAccessMask
+        dst_access,                               // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *buffer,                                  // buffer
+        0,                                        // offset
+        buffer->size(),                           // size
+    };
+    (*cmd)->vkCmdPipelineBarrier(*cmd, src_stage, dst_stage, 0, 0, nullptr, 1,
+                                 &barrier, 0, nullptr);
+  }
+
+  // Records the compute pass of |path| on the render queue, before its
+  // render pass.
+  void RecordPathCompute(vulkan::VkCommandBuffer* cmd, RenderPath path,
+                         ComputeParticlesFrameData* data) {
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*path_pipeline_layout_), 0, 1,
+        &data->path_descriptor_set_->raw_set(), 0, nullptr);
+    const uint32_t num_workgroups =
+        compute_task_.num_particles() / COMPUTE_SHADER_LOCAL_SIZE;
+    if (path == RenderPath::kExpanded) {
+      // The previous frame may still be drawing from the vertices.
+      BufferBarrier(cmd, expanded_vertices_.get(),
+                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_WRITE_BIT);
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *expand_pipeline_);
+      cmdBuffer->vkCmdDispatch(cmdBuffer, num_workgroups, 1, 1);
+      BufferBarrier(cmd, expanded_vertices_.get(),
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+      return;
+    }
+    // The previous frame may still be resolving the sums.
+    BufferBarrier(cmd, raster_accumulation_.get(),
+                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT);
+    cmdBuffer->vkCmdFillBuffer(cmdBuffer, *raster_accumulation_, 0,
+                               VK_WHOLE_SIZE, 0);
+    BufferBarrier(cmd, raster_accumulation_.get(),
+                  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *raster_pipeline_);
+    PushRasterSize(cmd);
+    cmdBuffer->vkCmdDispatch(cmdBuffer, num_workgroups, 1, 1);
+    BufferBarrier(cmd, raster_accumulation_.get(),
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT);
+  }
+
+  // Pushes the size of the swapchain, which the sums of the compute
+  // rasterizer cover.
+  void PushRasterSize(vulkan::VkCommandBuffer* cmd) {
+    const uint32_t size[2] = {app()->swapchain().width(),
+                              app()->swapchain().height()};
+    (*cmd)->vkCmdPushConstants(
+        *cmd, *path_pipeline_layout_,
+        VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+        sizeof(size), size);
+  }
+
+  // Records the draw of |path|, inside the render pass.
+  void RecordPathDraw(vulkan::VkCommandBuffer* cmd, RenderPath path,
+                      ComputeParticlesFrameData* data) {
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    if (path == RenderPath::kRaster) {
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *resolve_pipeline_);
+      cmdBuffer->vkCmdBindDescriptorSets(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          ::VkPipelineLayout(*path_pipeline_layout_), 0, 1,
+          &data->path_descriptor_set_->raw_set(), 0, nullptr);
+      PushRasterSize(cmd);
+      cmdBuffer->vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+      return;
+    }
+    const vulkan::VulkanGraphicsPipeline* pipelines[kNumRenderPaths] = {
+        particle_pipeline_.get(), point_pipeline_.get(),
+        expanded_pipeline_.get(), resolve_pipeline_.get()};
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *pipelines[uint32_t(path)]);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &data->particle_descriptor_set_->raw_set(), 0, nullptr);
+    const uint32_t num_particles = compute_task_.num_particles();
+    switch (path) {
+      case RenderPath::kInstanced:
+        // We only have to draw one model N times, in the shader we move
+        // each instance to the correct location.
+        quad_model_.DrawInstanced(cmd, num_particles);
+        break;
+      case RenderPath::kPoints:
+        cmdBuffer->vkCmdDraw(cmdBuffer, num_particles, 1, 0, 0);
+        break;
+      default: {
+        ::VkBuffer vertices = *expanded_vertices_;
+        VkDeviceSize offset = 0;
+        cmdBuffer->vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertices,
+                                          &offset);
+        cmdBuffer->vkCmdBindIndexBuffer(cmdBuffer, *expanded_indices_, 0,
+                                        VK_INDEX_TYPE_UINT32);
+        cmdBuffer->vkCmdDrawIndexed(cmdBuffer, 6 * num_particles, 1, 0, 0, 0);
+        break;
+      }
+    }
   }
 
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       ComputeParticlesFrameData* data) override {
+    if (cycle_render_paths_) {
+      CycleRenderPaths();
+    }
+    const RenderPath path = render_path_;
     compute_task_.SubmitComputeTask(frame_index,
                                     data->render_semaphore_->get_raw_object());
     // Get the next buffer that we use for the particle positions.
@@ -710,7 +1787,7 @@ class ComputeParticlesSample
         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
     };
 
-    VkWriteDescriptorSet writes[4]{
+    VkWriteDescriptorSet writes[6]{
         {
             VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
             nullptr,                                 // pNext
@@ -760,9 +1837,19 @@ class ComputeParticlesSample
             nullptr,                                 // pTexelBufferView
         },
     };
+    uint32_t num_writes = 4;
+    if (data->path_descriptor_set_) {
+      // The particles and the aspect ratio are bound to the same bindings
+      // of the set of the compute paths.
+      writes[4] = writes[0];
+      writes[5] = writes[1];
+      writes[4].dstSet = *data->path_descriptor_set_;
+      writes[5].dstSet = *data->path_descriptor_set_;
+      num_writes = 6;
+    }
 
-    app()->device()->vkUpdateDescriptorSets(app()->device(), 4, writes, 0,
-                                            nullptr);
+    app()->device()->vkUpdateDescriptorSets(app()->device(), num_writes,
+                                            writes, 0, nullptr);
 
     // Record our command-buffer for rendering this frame
     (*data->draw_command_buffer_)
@@ -791,34 +1878,35 @@ class ComputeParticlesSample
                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
                                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
                                     nullptr, 1, &barrier, 0, nullptr);
-    // }
 
-    // The rest of the normal drawing.
-    VkRenderPassBeginInfo pass_begin = {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        nullptr,                                   // pNext
-        *render_pass_,                             // renderPass
-        *data->framebuffer_,                       // framebuffer
-        {{0, 0},
-         {app()->swapchain().width(),
-          app()->swapchain().height()}},  // renderArea
-        1,                                // clearValueCount
-        &clear                            // clears
-    };
+    {
+      // The zone covers the compute pass of the path too, and has to begin
+      // outside of the render pass.
+      vulkan::GpuZone zone(gpu_profiler(), &cmdBuffer,
+                           kRenderPathZones[uint32_t(path)]);
+      if (IsComputeRenderPath(path)) {
+        RecordPathCompute(&cmdBuffer, path, data);
+      }
+
+      // The rest of the normal drawing.
+      VkRenderPassBeginInfo pass_begin = {
+          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+          nullptr,                                   // pNext
+          *render_pass_,                             // renderPass
+          *data->framebuffer_,                       // framebuffer
+          {{0, 0},
+           {app()->swapchain().width(),
+            app()->swapchain().height()}},  // renderArea
+          1,                                // clearValueCount
+          &clear                            // clears
+      };
 
-    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
-                                    VK_SUBPASS_CONTENTS_INLINE);
+      cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                      VK_SUBPASS_CONTENTS_INLINE);
 
-    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *particle_pipeline_);
-    cmdBuffer->vkCmdBindDescriptorSets(
-        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
-        &data->particle_descriptor_set_->raw_set(), 0, nullptr);
-    // We only have to draw one model N times, in the shader we move
-    // each instance to the correct location.
-    quad_model_.DrawInstanced(&cmdBuffer, TOTAL_PARTICLES);
-    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+      RecordPathDraw(&cmdBuffer, path, data);
+      cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    }
 
     VkBufferMemoryBarrier transfer_barrier = {
         VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
@@ -840,6 +1928,10 @@ class ComputeParticlesSample
         ->vkEndCommandBuffer(*data->draw_command_buffer_);
 
     VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    if (IsComputeRenderPath(path)) {
+      // The compute pass of the path reads the particles as well.
+      waitStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
 
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
@@ -868,8 +1960,26 @@ class ComputeParticlesSample
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> particle_pipeline_;
   containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
 
-  // This ssbo just contains the aspect ratio. We use a Vector4 just so we
-  // get proper alignment.
+  // The pipelines of the other paths, if they are drawn.
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> point_pipeline_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> expanded_pipeline_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> resolve_pipeline_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> expand_pipeline_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> raster_pipeline_;
+  // The bindings of the paths that run compute shaders, see
+  // particle_raster.comp.
+  VkDescriptorSetLayoutBinding path_bindings_[6];
+  containers::unique_ptr<vulkan::PipelineLayout> path_pipeline_layout_;
+  // The corners that particle_expand.comp writes, and the indices of their
+  // triangles.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> expanded_vertices_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> expanded_indices_;
+  // The colors that particle_raster.comp adds up for every pixel.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      raster_accumulation_;
+
+  // This ssbo contains the aspect ratio, and the size of a particle in
+  // pixels. We use a Vector4 just so we get proper alignment.
   containers::unique_ptr<vulkan::BufferFrameData<Vector4>> aspect_buffer_;
   // A model of a quad with corners. (-1, -1), (1, 1), (-1, 1), (1, -1)
   vulkan::VulkanModel quad_model_;
@@ -881,6 +1991,14 @@ class ComputeParticlesSample
   float time_since_last_notify_ = 0.f;
   uint32_t frames_since_last_notify_ = 0;
   ComputeTask compute_task_;
+  // The path that the next frame is drawn with.
+  RenderPath render_path_;
+  // True with -sample-option=render=all.
+  bool cycle_render_paths_;
+  uint32_t frames_on_render_path_ = 0;
+  // The GPU times of every path in its last turn, in seconds.
+  float render_path_times_[kNumRenderPaths] = {};
+  uint32_t render_path_samples_[kNumRenderPaths] = {};
 };
 
 int main_entry(const entry::EntryData* data) {
@@ -21,7 +21,7 @@ layout (location = 1) out vec2 texcoord;
 layout (location = 2) out float speed;
 
 layout (binding = 0) buffer DrawData {
-  draw_data drawData[TOTAL_PARTICLES];
+  draw_data drawData[];
 };
 
 layout (binding = 3) buffer frame {
@@ -29,7 +29,7 @@ layout (binding = 3) buffer frame {
 };
 
 void main() {
-    vec4 position = get_position() / 250.0f;
+    vec4 position = get_position() * PARTICLE_SIZE;
     gl_Position =
         vec4(position.xy + drawData[gl_InstanceIndex].position_speed.xy, 0.0f, 1.0f);
     gl_Position.x /= aspect_data.x;
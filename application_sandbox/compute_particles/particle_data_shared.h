@@ -25,9 +25,42 @@ struct simulation_data {
   Vector4 position_velocity;
 };
 
+// The number of particles, unless -sample-option=particles is given. The
+// shaders take the actual number from a specialization constant.
 #define TOTAL_PARTICLES (1024 * 64)
+// The number of particles is rounded up to a multiple of this, so that it
+// is divisible by every workgroup size.
+#define PARTICLE_GRANULARITY 1024
+// The workgroup size until it is tuned for the device.
 #define COMPUTE_SHADER_LOCAL_SIZE 128
 
+// The brute force velocity updates attract every particle by one in
+// PARTICLE_SPLIT of the others. The grid scales its masses down by the same
+// factor, so that both simulations behave the same.
+#define PARTICLE_SPLIT 128
+
+// With -sample-option=simulation=grid, the particles are sorted into a grid
+// of GRID_SIZE x GRID_SIZE cells, which covers [-GRID_EXTENT, GRID_EXTENT]
+// in x and y. Particles outside of it count as being in the closest cell.
+#define GRID_SIZE 256
+#define GRID_EXTENT 2.0f
+#define GRID_CELLS (GRID_SIZE * GRID_SIZE)
+// The masses of the cells are summed up into levels of half the size each,
+// down to 4 x 4 cells, so GRID_PYRAMID_CELLS is
+// GRID_CELLS * (1 + 1/4 + ... + 1/4^(GRID_LEVELS - 1)).
+#define GRID_LEVELS 7
+#define GRID_PYRAMID_CELLS 87376
+
 #define TOTAL_MASS (1024.0f * 1024.0f * 64.0f)
 
+// Every particle covers a square of 2 * PARTICLE_SIZE in normalized device
+// coordinates, in y, whichever way it is drawn.
+#define PARTICLE_SIZE (1.0f / 250.0f)
+// With -sample-option=render=raster, the colors are added up in fixed
+// point, with this many steps per unit.
+#define RASTER_FIXED_POINT_SCALE 256.0f
+// The compute rasterizer is meant for tiny particles, it draws at most this
+// many pixels of every particle in x and in y.
+#define RASTER_MAX_FOOTPRINT 8
+
 #endif  // _PARTICLE_DATA_SHARED_H_
\ No newline at end of file
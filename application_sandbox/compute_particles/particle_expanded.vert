@@ -0,0 +1,30 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// Draws the corners that particle_expand.comp wrote. The index of the
+// corner within its quad is the vertex index modulo 4.
+layout (location = 0) in vec3 position_speed;
+
+layout (location = 1) out vec2 texcoord;
+layout (location = 2) out float speed;
+
+void main() {
+    uint corner = uint(gl_VertexIndex) & 3u;
+    gl_Position = vec4(position_speed.xy, 0.0f, 1.0f);
+    texcoord = vec2(float(corner & 1u), float(corner >> 1));
+    speed = position_speed.z;
+}
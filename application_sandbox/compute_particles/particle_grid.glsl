@@ -0,0 +1,81 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The buffers and helpers that are shared by the shaders of the grid
+// simulation. Every step, grid_count.comp counts the particles of every
+// cell, grid_scan.comp turns the counts into the start of every cell,
+// grid_scatter.comp sorts the particles by cell, grid_reduce.comp sums up
+// the masses of the cells level by level, and
+// particle_velocity_update_grid.comp computes the forces from them.
+
+// The number of particles, see -sample-option=particles.
+layout (constant_id = 1) const uint num_particles = uint(TOTAL_PARTICLES);
+
+layout (binding = 1) buffer SimulationData {
+  simulation_data simulation[];
+};
+
+// The cells of the finest level, in rows.
+layout (std430, set = 1, binding = 0) buffer GridCells {
+  uint cell_count[GRID_CELLS];
+  // The index of the first particle of every cell in sorted_particles.
+  uint cell_start[GRID_CELLS];
+};
+
+// The center of mass of every cell in xy, and its mass in z, for all
+// levels, the finest first.
+layout (std430, set = 1, binding = 1) buffer GridMass {
+  vec4 cell_mass[GRID_PYRAMID_CELLS];
+};
+
+// The cell of every particle, and its index within that cell.
+layout (std430, set = 1, binding = 2) buffer ParticleSlots {
+  uvec2 particle_slot[];
+};
+
+struct grid_particle {
+  vec2 position;
+  // The index of the particle in simulation.
+  uint index;
+};
+
+// The particles, sorted by cell.
+layout (std430, set = 1, binding = 3) buffer SortedParticles {
+  grid_particle sorted_particles[];
+};
+
+uint LevelSize(uint level) {
+  return uint(GRID_SIZE) >> level;
+}
+
+// The index of the first cell of |level| in cell_mass.
+uint LevelOffset(uint level) {
+  uint offset = 0;
+  for (uint i = 0; i < level; ++i) {
+    offset += LevelSize(i) * LevelSize(i);
+  }
+  return offset;
+}
+
+// The cell of the finest level that |position| is in.
+ivec2 CellOf(vec2 position) {
+  vec2 cell =
+      (position + GRID_EXTENT) * (float(GRID_SIZE) / (2.0 * GRID_EXTENT));
+  return clamp(ivec2(floor(cell)), ivec2(0), ivec2(GRID_SIZE - 1));
+}
+
+uint CellIndex(ivec2 cell) {
+  return uint(cell.y * GRID_SIZE + cell.x);
+}
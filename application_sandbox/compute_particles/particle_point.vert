@@ -0,0 +1,37 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#include "particle_data_shared.h"
+
+// With -sample-option=render=points, every particle is a point sprite of
+// aspect_data.y pixels, which needs the largePoints feature.
+layout (location = 2) out float speed;
+
+layout (binding = 0) buffer DrawData {
+  draw_data drawData[];
+};
+
+layout (binding = 3) buffer frame {
+    Vector4 aspect_data;
+};
+
+void main() {
+    vec4 position_speed = drawData[gl_VertexIndex].position_speed;
+    gl_Position = vec4(position_speed.xy, 0.0f, 1.0f);
+    gl_Position.x /= aspect_data.x;
+    gl_PointSize = aspect_data.y;
+    speed = length(position_speed.zw);
+}
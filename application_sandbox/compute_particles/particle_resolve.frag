@@ -0,0 +1,37 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#include "particle_data_shared.h"
+
+// Writes the colors that particle_raster.comp added up.
+layout(location = 0) out vec4 out_color;
+
+layout (binding = 5) buffer Accumulation {
+  uint accumulation[];
+};
+
+layout (push_constant) uniform raster_data {
+  uint width;
+  uint height;
+};
+
+void main() {
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    uint offset = (pixel.y * width + pixel.x) * 3;
+    vec3 sum = vec3(accumulation[offset], accumulation[offset + 1],
+                    accumulation[offset + 2]);
+    out_color = vec4(sum / RASTER_FIXED_POINT_SCALE, 1.0f);
+}
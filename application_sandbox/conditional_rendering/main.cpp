@@ -155,6 +155,8 @@ class ConditionalRenderingSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     conditional_data_ = containers::make_unique<
         vulkan::BufferFrameData<ConditionalRenderingData>>(
@@ -457,9 +459,6 @@ class ConditionalRenderingSample
 
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       ConditionalRenderingFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
     conditional_data_->UpdateBuffer(queue, frame_index);
     // Force update for the compute shader buffer, since it is
     // updated by the GPU.
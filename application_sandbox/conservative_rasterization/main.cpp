@@ -16,6 +16,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/structure_chain.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
@@ -137,16 +138,14 @@ class ConservativeRasterizationSample
     conservative_rasterization_pipeline_->AddAttachment();
 
 	// Setup conservative rasterization
-    VkPhysicalDeviceConservativeRasterizationPropertiesEXT
-        conservativeRasterProps{};
-    VkPhysicalDeviceProperties2KHR deviceProperties2{};
-    conservativeRasterProps.sType =
-        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONSERVATIVE_RASTERIZATION_PROPERTIES_EXT;
-    deviceProperties2.sType =
-        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
-    deviceProperties2.pNext = &conservativeRasterProps;
+    vulkan::StructureChain<VkPhysicalDeviceProperties2,
+                           VkPhysicalDeviceConservativeRasterizationPropertiesEXT>
+        deviceProperties2;
     app()->instance()->vkGetPhysicalDeviceProperties2KHR(
-        app()->device().physical_device(), &deviceProperties2);
+        app()->device().physical_device(), deviceProperties2.head());
+    const VkPhysicalDeviceConservativeRasterizationPropertiesEXT&
+        conservativeRasterProps = deviceProperties2.get<
+            VkPhysicalDeviceConservativeRasterizationPropertiesEXT>();
 
     VkPipelineRasterizationConservativeStateCreateInfoEXT
         conservativeRasterState{};
@@ -169,6 +168,8 @@ class ConservativeRasterizationSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -297,10 +298,6 @@ class ConservativeRasterizationSample
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       ConservativeRasterizationFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
@@ -20,6 +20,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/query_allocator.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
@@ -93,31 +94,24 @@ class CopyQueryPoolHostResetResultSample
     // Replay device: First 3 frames (corresponding to frame 100, 101, 102 on
     // the tracing device) are blank, following ones shows the model.
 
-    // Create a occlusion query pool that contains a query for each frame.
-    VkQueryPoolCreateInfo query_pool_create_info{
-        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
-        nullptr,                                   // pNext
-        0,
-        VK_QUERY_TYPE_OCCLUSION,
-        uint32_t(num_swapchain_images),
-        0,
-    };
-    query_pool_ = containers::make_unique<vulkan::VkQueryPool>(
-        data_->allocator(),
-        vulkan::CreateQueryPool(&app()->device(), query_pool_create_info));
+    // Allocate an occlusion query for each frame. The queries are reset
+    // from the host when they are allocated.
+    query_allocator_ = containers::make_unique<vulkan::QueryAllocator>(
+        data_->allocator(), app(), true);
+    occlusion_queries_ = query_allocator_->Allocate(
+        VK_QUERY_TYPE_OCCLUSION, uint32_t(num_swapchain_images));
 
     // Query before drawing anything to make sure the initial value of query
     // pool results are zero.
     for (size_t i = 0; i < num_swapchain_images; i++) {
-      app()->device()->vkResetQueryPoolEXT(app()->device(), *query_pool_,
-                                           static_cast<uint32_t>(i), 1);
       (*initialization_buffer)
-          ->vkCmdBeginQuery(*initialization_buffer, *query_pool_,
-                            static_cast<uint32_t>(i),
-                            VkQueryControlFlagBits(0));
+          ->vkCmdBeginQuery(
+              *initialization_buffer, occlusion_queries_.pool,
+              occlusion_queries_.query(static_cast<uint32_t>(i)),
+              VkQueryControlFlagBits(0));
       (*initialization_buffer)
-          ->vkCmdEndQuery(*initialization_buffer, *query_pool_,
-                          static_cast<uint32_t>(i));
+          ->vkCmdEndQuery(*initialization_buffer, occlusion_queries_.pool,
+                          occlusion_queries_.query(static_cast<uint32_t>(i)));
     }
 
     // Create a buffer to store the query results for each frame, and to be
@@ -413,9 +407,10 @@ class CopyQueryPoolHostResetResultSample
         cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 1,
         &to_use_query_results, 0, nullptr);
-    cmdBuffer->vkCmdBeginQuery(cmdBuffer, *query_pool_,
-                               static_cast<uint32_t>(frame_index),
-                               VkQueryControlFlagBits(0));
+    cmdBuffer->vkCmdBeginQuery(
+        cmdBuffer, occlusion_queries_.pool,
+        occlusion_queries_.query(static_cast<uint32_t>(frame_index)),
+        VkQueryControlFlagBits(0));
 
     cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
                                     VK_SUBPASS_CONTENTS_INLINE);
@@ -431,19 +426,20 @@ class CopyQueryPoolHostResetResultSample
     cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
 
     // End query for this frame and get the result in the query result buffer
-    cmdBuffer->vkCmdEndQuery(cmdBuffer, *query_pool_,
-                             static_cast<uint32_t>(frame_index));
+    cmdBuffer->vkCmdEndQuery(
+        cmdBuffer, occlusion_queries_.pool,
+        occlusion_queries_.query(static_cast<uint32_t>(frame_index)));
     cmdBuffer->vkCmdPipelineBarrier(
         cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
         &to_store_query_results, 0, nullptr);
 
     // Copy the query results to be used in the next frame.
-    cmdBuffer->vkCmdCopyQueryPoolResults(
-        cmdBuffer, *query_pool_, static_cast<uint32_t>(frame_index),
-        static_cast<uint32_t>(1), *query_pool_results_buf_,
+    query_allocator_->RecordCopyResults(
+        &cmdBuffer, occlusion_queries_, *query_pool_results_buf_,
         static_cast<VkDeviceSize>(frame_index * vulkan::kMaxOffsetAlignment),
-        static_cast<VkDeviceSize>(sizeof(uint32_t)), VK_QUERY_RESULT_WAIT_BIT);
+        static_cast<VkDeviceSize>(sizeof(uint32_t)), VK_QUERY_RESULT_WAIT_BIT,
+        static_cast<uint32_t>(frame_index), 1);
 
     (*frame_data->command_buffer_)
         ->vkEndCommandBuffer(*frame_data->command_buffer_);
@@ -460,8 +456,8 @@ class CopyQueryPoolHostResetResultSample
                       WireframeFrameData* frame_data) override {
     // Previous execution of the commands using this frame's query must have
     // completed by now, so it's safe to reset.
-    app()->device()->vkResetQueryPoolEXT(app()->device(), *query_pool_,
-                                         static_cast<uint32_t>(frame_index), 1);
+    query_allocator_->ResetOnHost(occlusion_queries_,
+                                  static_cast<uint32_t>(frame_index), 1);
     // Update our uniform buffers.
     camera_data_->UpdateBuffer(queue, frame_index);
     model_data_->UpdateBuffer(queue, frame_index);
@@ -496,7 +492,8 @@ class CopyQueryPoolHostResetResultSample
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> torus_pipeline_;
   containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
-  containers::unique_ptr<vulkan::VkQueryPool> query_pool_;
+  containers::unique_ptr<vulkan::QueryAllocator> query_allocator_;
+  vulkan::QueryRange occlusion_queries_;
   vulkan::BufferPointer query_pool_results_buf_;
   VkDescriptorSetLayoutBinding torus_descriptor_set_layouts_[3];
   vulkan::VulkanModel torus_;
@@ -299,6 +299,8 @@ class MixedSamplesSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect = ((float)app()->swapchain().width() / 2.0f) /
                    (float)app()->swapchain().height();
@@ -628,10 +630,6 @@ class MixedSamplesSample
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       MixedSamplesFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
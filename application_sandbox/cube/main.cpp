@@ -41,8 +41,7 @@ uint32_t cube_fragment_shader[] =
 
 struct CubeFrameData {
   containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
-  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
-  containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
+  vulkan::FramebufferCache::Handle framebuffer_;
 };
 
 // This creates an application with 16MB of image memory, and defaults
@@ -53,7 +52,9 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
       : data_(data),
         Sample<CubeFrameData>(
             data->allocator(), data, 1, 512, 1, 1,
-            sample_application::SampleOptions().EnableMultisampling()),
+            sample_application::SampleOptions()
+                .EnableMultisampling()
+                .EnableResizableSwapchain()),
         cube_(data->allocator(), data->logger(), cube_data) {}
   virtual void InitializeApplicationData(
       vulkan::VkCommandBuffer* initialization_buffer,
@@ -61,18 +62,18 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     cube_.InitializeData(app(), initialization_buffer);
 
     cube_descriptor_set_layouts_[0] = {
-        0,                                  // binding
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
-        1,                                  // descriptorCount
-        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
-        nullptr                             // pImmutableSamplers
+        0,                                          // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,  // descriptorType
+        1,                                          // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,                 // stageFlags
+        nullptr                                     // pImmutableSamplers
     };
     cube_descriptor_set_layouts_[1] = {
-        1,                                  // binding
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
-        1,                                  // descriptorCount
-        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
-        nullptr                             // pImmutableSamplers
+        1,                                          // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,  // descriptorType
+        1,                                          // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,                 // stageFlags
+        nullptr                                     // pImmutableSamplers
     };
 
     pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
@@ -80,6 +81,10 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
         app()->CreatePipelineLayout({{cube_descriptor_set_layouts_[0],
                                       cube_descriptor_set_layouts_[1]}}));
 
+    descriptor_writer_ = containers::make_unique<vulkan::DescriptorWriter>(
+        data_->allocator(),
+        app()->CreateDescriptorWriter(*pipeline_layout_, 0));
+
     VkAttachmentReference color_attachment = {
         0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
 
@@ -122,8 +127,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
                               cube_fragment_shader);
     cube_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
     cube_pipeline_->SetInputStreams(&cube_);
-    cube_pipeline_->SetViewport(viewport());
-    cube_pipeline_->SetScissor(scissor());
+    // The viewport and scissor stay dynamic, so the pipeline outlives a
+    // resize of the swapchain.
     cube_pipeline_->SetSamples(num_samples());
     cube_pipeline_->AddAttachment();
     cube_pipeline_->Commit();
@@ -135,15 +140,30 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
-    float aspect =
-        (float)app()->swapchain().width() / (float)app()->swapchain().height();
-    camera_data_->data().projection_matrix =
-        Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
-        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+    UpdateProjection();
 
     model_data_->data().transform = Mat44::FromTranslationVector(
         mathfu::Vector<float, 3>{0.0f, 0.0f, -3.0f});
+
+    // One set serves every frame, the frame's data is selected with dynamic
+    // offsets when the set is bound.
+    cube_descriptor_set_ = containers::make_unique<vulkan::DescriptorSet>(
+        data_->allocator(),
+        app()->AllocateDescriptorSet({cube_descriptor_set_layouts_[0],
+                                      cube_descriptor_set_layouts_[1]}));
+    // The camera and model buffers, for bindings 0 and 1.
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        camera_data_->get_dynamic_descriptor_info(),
+        model_data_->get_dynamic_descriptor_info()};
+    descriptor_writer_->Write(*cube_descriptor_set_, buffer_infos);
+  }
+
+  virtual void SwapchainRecreated(
+      vulkan::VkCommandBuffer* initialization_buffer) override {
+    UpdateProjection();
   }
 
   virtual void InitializeFrameData(
@@ -153,61 +173,12 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
         containers::make_unique<vulkan::VkCommandBuffer>(
             data_->allocator(), app()->GetCommandBuffer());
 
-    frame_data->cube_descriptor_set_ =
-        containers::make_unique<vulkan::DescriptorSet>(
-            data_->allocator(),
-            app()->AllocateDescriptorSet({cube_descriptor_set_layouts_[0],
-                                          cube_descriptor_set_layouts_[1]}));
-
-    VkDescriptorBufferInfo buffer_infos[2] = {
-        {
-            camera_data_->get_buffer(),                       // buffer
-            camera_data_->get_offset_for_frame(frame_index),  // offset
-            camera_data_->size(),                             // range
-        },
-        {
-            model_data_->get_buffer(),                       // buffer
-            model_data_->get_offset_for_frame(frame_index),  // offset
-            model_data_->size(),                             // range
-        }};
-
-    VkWriteDescriptorSet write{
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-        nullptr,                                 // pNext
-        *frame_data->cube_descriptor_set_,       // dstSet
-        0,                                       // dstbinding
-        0,                                       // dstArrayElement
-        2,                                       // descriptorCount
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
-        nullptr,                                 // pImageInfo
-        buffer_infos,                            // pBufferInfo
-        nullptr,                                 // pTexelBufferView
-    };
-
-    app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
-                                            nullptr);
-
     ::VkImageView raw_view = color_view(frame_data);
 
-    // Create a framebuffer with depth and image attachments
-    VkFramebufferCreateInfo framebuffer_create_info{
-        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
-        nullptr,                                    // pNext
-        0,                                          // flags
-        *render_pass_,                              // renderPass
-        1,                                          // attachmentCount
-        &raw_view,                                  // attachments
-        app()->swapchain().width(),                 // width
-        app()->swapchain().height(),                // height
-        1                                           // layers
-    };
-
-    ::VkFramebuffer raw_framebuffer;
-    app()->device()->vkCreateFramebuffer(
-        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
-    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
-        data_->allocator(),
-        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+    // With imageless framebuffers, every frame shares this one.
+    frame_data->framebuffer_ = app()->framebuffer_cache().Get(
+        *render_pass_, &color_attachment(frame_data), 1,
+        app()->swapchain().width(), app()->swapchain().height());
 
     (*frame_data->command_buffer_)
         ->vkBeginCommandBuffer((*frame_data->command_buffer_),
@@ -217,11 +188,13 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     VkClearValue clear;
     vulkan::MemoryClear(&clear);
 
+    VkRenderPassAttachmentBeginInfoKHR pass_begin_attachment;
     VkRenderPassBeginInfo pass_begin = {
         VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        nullptr,                                   // pNext
-        *render_pass_,                             // renderPass
-        *frame_data->framebuffer_,                 // framebuffer
+        app()->framebuffer_cache().GetAttachmentBeginInfo(
+            &pass_begin_attachment, &raw_view, 1),  // pNext
+        *render_pass_,                              // renderPass
+        frame_data->framebuffer_,                   // framebuffer
         {{0, 0},
          {app()->swapchain().width(),
           app()->swapchain().height()}},  // renderArea
@@ -234,10 +207,15 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
 
     cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                                  *cube_pipeline_);
+    cmdBuffer->vkCmdSetViewport(cmdBuffer, 0, 1, &viewport());
+    cmdBuffer->vkCmdSetScissor(cmdBuffer, 0, 1, &scissor());
+    const uint32_t dynamic_offsets[2] = {
+        camera_data_->get_dynamic_offset(frame_index),
+        model_data_->get_dynamic_offset(frame_index)};
     cmdBuffer->vkCmdBindDescriptorSets(
         cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
         ::VkPipelineLayout(*pipeline_layout_), 0, 1,
-        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
+        &cube_descriptor_set_->raw_set(), 2, dynamic_offsets);
     cube_.Draw(&cmdBuffer);
     cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
 
@@ -254,10 +232,6 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
@@ -276,6 +250,15 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   }
 
  private:
+  // Matches the projection to the aspect ratio of the swapchain.
+  void UpdateProjection() {
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+  }
+
   struct CameraData {
     Mat44 projection_matrix;
   };
@@ -286,6 +269,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
 
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::DescriptorWriter> descriptor_writer_;
+  containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
   containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
   VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[2];
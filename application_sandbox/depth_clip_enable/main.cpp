@@ -241,6 +241,8 @@ class DepthClipEnableSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     color_red_data_ =
         containers::make_unique<vulkan::BufferFrameData<ColorData>>(
@@ -498,9 +500,6 @@ class DepthClipEnableSample
 
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       DepthClipEnableFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
     color_red_data_->UpdateBuffer(queue, frame_index);
     color_green_data_->UpdateBuffer(queue, frame_index);
     color_blue_data_->UpdateBuffer(queue, frame_index);
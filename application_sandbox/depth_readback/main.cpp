@@ -246,6 +246,8 @@ class DepthReadbackSample : public sample_application::Sample<DepthFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect = (float)width / (float)height;
     camera_data_->data().projection_matrix =
@@ -398,10 +400,6 @@ class DepthReadbackSample : public sample_application::Sample<DepthFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       DepthFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
@@ -0,0 +1,36 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#include "models/model_setup.glsl"
+#include "descriptor_benchmark_common.glsl"
+
+layout (binding = 0, set = 0, std430) readonly buffer resource_0 {
+    vec4 value_0;
+};
+layout (binding = 1, set = 0, std430) readonly buffer resource_1 {
+    vec4 value_1;
+};
+layout (binding = 2, set = 0, std430) readonly buffer resource_2 {
+    vec4 value_2;
+};
+layout (binding = 3, set = 0, std430) readonly buffer resource_3 {
+    vec4 value_3;
+};
+
+void main() {
+    gl_Position = get_cube_position(gl_InstanceIndex, get_position());
+    color = (value_0 + value_1 + value_2 + value_3).rgb;
+}
@@ -0,0 +1,37 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#include "models/model_setup.glsl"
+#include "descriptor_benchmark_common.glsl"
+
+// The storage buffers of the bindless table of the application.
+layout (binding = 1, set = 0, std430) readonly buffer resource_data {
+    vec4 value;
+} resources[];
+
+layout (push_constant) uniform draw_data {
+    // The index in the table of the first of the resources of the draw.
+    uint first_resource;
+};
+
+void main() {
+    gl_Position = get_cube_position(gl_InstanceIndex, get_position());
+    color = (resources[first_resource].value +
+             resources[first_resource + 1].value +
+             resources[first_resource + 2].value +
+             resources[first_resource + 3].value).rgb;
+}
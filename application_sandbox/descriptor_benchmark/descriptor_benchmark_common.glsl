@@ -0,0 +1,29 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The cubes are laid out in a square grid of this many cubes per side, by
+// the index of their draw. Grids with more draws than that wrap around.
+const uint kGridSide = 100;
+
+layout (location = 0) out vec3 color;
+
+// Returns the clip space position of |position| of the cube of draw |index|.
+vec4 get_cube_position(int index, vec4 position) {
+    uint cell = uint(index) % (kGridSide * kGridSide);
+    vec2 center = (vec2(cell % kGridSide, cell / kGridSide) + 0.5) /
+                  float(kGridSide) * 2.0 - 1.0;
+    float scale = 0.35 / float(kGridSide);
+    return vec4(center + position.xy * scale, position.z * 0.25 + 0.5, 1.0);
+}
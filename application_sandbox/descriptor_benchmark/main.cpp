@@ -0,0 +1,697 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/bindless_table.h"
+#include "vulkan_helpers/descriptor_writer.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace cube_model {
+#include "cube.obj.h"
+}
+const auto& cube_data = cube_model::model;
+
+uint32_t descriptor_benchmark_vertex_shader[] =
+#include "descriptor_benchmark.vert.spv"
+    ;
+
+uint32_t descriptor_benchmark_bindless_vertex_shader[] =
+#include "descriptor_benchmark_bindless.vert.spv"
+    ;
+
+uint32_t descriptor_benchmark_fragment_shader[] =
+#include "descriptor_benchmark.frag.spv"
+    ;
+
+// The number of storage buffers that every draw reads. This must match the
+// vertex shaders.
+const uint32_t kResourcesPerDraw = 4;
+// The number of distinct buffer ranges that the draws bind, in turn. It is
+// a multiple of kResourcesPerDraw, so the resources of a draw are
+// contiguous, and small enough for the bindless table.
+const uint32_t kNumResources = 1024;
+
+// The ways in which the resources of every draw are bound.
+enum class Strategy {
+  // A set for every draw that was written once, bound for every draw.
+  kPrebuiltSets,
+  // A set for every draw that is written with vkUpdateDescriptorSets, and
+  // bound, for every draw.
+  kUpdateSets,
+  // Like kUpdateSets, but written with a descriptor update template.
+  kUpdateTemplate,
+  // A single set of dynamic storage buffers, bound with new offsets for
+  // every draw.
+  kDynamicOffsets,
+  // The descriptors are pushed with vkCmdPushDescriptorSetKHR for every
+  // draw.
+  kPushDescriptors,
+  // Every resource is in the bindless table, which is bound once, and
+  // every draw gets the index of its first resource as a push constant.
+  kBindless,
+};
+
+struct StrategyInfo {
+  Strategy strategy;
+  // The name of the strategy in the sample options, and of its GPU zone.
+  const char* name;
+};
+
+const StrategyInfo kStrategies[] = {
+    {Strategy::kPrebuiltSets, "prebuilt_sets"},
+    {Strategy::kUpdateSets, "update_sets"},
+    {Strategy::kUpdateTemplate, "update_template"},
+    {Strategy::kDynamicOffsets, "dynamic_offsets"},
+    {Strategy::kPushDescriptors, "push_descriptors"},
+    {Strategy::kBindless, "bindless"},
+};
+const size_t kNumStrategies = sizeof(kStrategies) / sizeof(kStrategies[0]);
+
+// The numbers of draws that every strategy is measured with, unless
+// draws=<N> was given.
+const uint32_t kDrawCounts[] = {100, 1000, 10000};
+
+// The frames of every configuration that are measured, after the warmup
+// frames, which let the frames in flight and the GPU times of the previous
+// configuration drain.
+const uint32_t kDefaultFramesPerConfig = 120;
+const uint32_t kWarmupFrames = 30;
+
+// The descriptors of one draw, in the layout that DescriptorWriter reads.
+struct DrawDescriptors {
+  VkDescriptorBufferInfo resources[kResourcesPerDraw];
+};
+
+// One number of draws, bound with one strategy.
+struct BenchmarkConfig {
+  uint32_t num_draws;
+  size_t strategy_index;
+};
+
+struct DescriptorBenchmarkFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  // The index of the first set of this frame in draw_sets_.
+  size_t first_draw_set_;
+};
+
+// This draws a grid of cubes, one cube per draw, which each read
+// kResourcesPerDraw storage buffers, and binds them with every strategy in
+// turn. It logs the CPU time that it takes to bind the resources and record
+// the draws, and the GPU time of the draws, for a range of numbers of
+// draws. Every strategy binds the same buffer ranges for every draw, so
+// that they all draw exactly the same thing.
+class DescriptorBenchmark
+    : public sample_application::Sample<DescriptorBenchmarkFrameData> {
+ public:
+  DescriptorBenchmark(const entry::EntryData* data, void* device_next)
+      : data_(data),
+        Sample<DescriptorBenchmarkFrameData>(
+            data->allocator(), data, 1, 512, 1, 1,
+            sample_application::SampleOptions()
+                .EnableGpuProfiler(1)
+                .AddDeviceExtensionStructure(device_next),
+            {0}, {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+            {VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+             VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME,
+             VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+             VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME}),
+        cube_(data->allocator(), data->logger(), cube_data),
+        draw_sets_(data->allocator()),
+        bindless_indices_(data->allocator()),
+        configs_(data->allocator()),
+        max_draws_(0),
+        resource_stride_(0),
+        frames_per_config_(kDefaultFramesPerConfig),
+        config_index_(0),
+        config_frame_(0),
+        done_(false),
+        record_time_(0.0),
+        gpu_time_(0.0),
+        num_gpu_times_(0) {
+    const char* frames_option = data->sample_option("frames_per_config");
+    if (frames_option) {
+      frames_per_config_ =
+          static_cast<uint32_t>(strtoul(frames_option, nullptr, 10));
+    }
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+
+    const char* draws_option = data->sample_option("draws");
+    const char* strategy_option = data->sample_option("strategy");
+    const uint32_t num_draws =
+        draws_option ? static_cast<uint32_t>(strtoul(draws_option, nullptr, 10))
+                     : 0;
+    const size_t num_counts =
+        num_draws > 0 ? 1 : sizeof(kDrawCounts) / sizeof(kDrawCounts[0]);
+    for (size_t count = 0; count < num_counts; ++count) {
+      const uint32_t draws = num_draws > 0 ? num_draws : kDrawCounts[count];
+      for (size_t i = 0; i < kNumStrategies; ++i) {
+        if (strategy_option &&
+            strcmp(strategy_option, kStrategies[i].name) != 0) {
+          continue;
+        }
+        configs_.push_back({draws, i});
+        max_draws_ = std::max(max_draws_, draws);
+      }
+    }
+    if (configs_.empty()) {
+      data->logger()->LogError("Unknown strategy ", strategy_option);
+      for (size_t i = 0; i < kNumStrategies; ++i) {
+        configs_.push_back({kDrawCounts[0], i});
+      }
+      max_draws_ = kDrawCounts[0];
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    cube_.InitializeData(app(), initialization_buffer);
+    vulkan::VkDevice& device = app()->device();
+
+    // Every resource is a vec4 in its own range of one buffer, which holds
+    // a color that the draw adds to the others that it reads.
+    const VkDeviceSize alignment =
+        device.limits().minStorageBufferOffsetAlignment;
+    resource_stride_ =
+        (sizeof(float) * 4 + alignment - 1) / alignment * alignment;
+    containers::vector<float> resource_data(data_->allocator());
+    resource_data.resize(kNumResources * resource_stride_ / sizeof(float),
+                         0.0f);
+    for (uint32_t i = 0; i < kNumResources; ++i) {
+      float* value = &resource_data[i * resource_stride_ / sizeof(float)];
+      value[i % 3] = 0.25f + 0.5f * (i % 7) / 6.0f;
+    }
+    resource_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        kNumResources * resource_stride_,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    app()->FillSmallBuffer(resource_buffer_.get(), resource_data.data(),
+                           resource_data.size() * sizeof(float), 0,
+                           initialization_buffer, VK_ACCESS_SHADER_READ_BIT);
+
+    for (uint32_t i = 0; i < kResourcesPerDraw; ++i) {
+      draw_bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+      dynamic_bindings_[i] = draw_bindings_[i];
+      dynamic_bindings_[i].descriptorType =
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    }
+
+    // The sets of every draw are allocated with a layout of their own, that
+    // is compatible with the one of the pipeline layout.
+    draw_set_layout_ = containers::make_unique<vulkan::VkDescriptorSetLayout>(
+        data_->allocator(),
+        vulkan::CreateDescriptorSetLayout(
+            data_->allocator(), &device,
+            {draw_bindings_[0], draw_bindings_[1], draw_bindings_[2],
+             draw_bindings_[3]}));
+    draw_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{draw_bindings_[0], draw_bindings_[1],
+                                      draw_bindings_[2], draw_bindings_[3]}}));
+    containers::vector<VkDescriptorSetLayoutBinding> draw_bindings(
+        draw_bindings_, draw_bindings_ + kResourcesPerDraw, data_->allocator());
+    template_writer_ = containers::make_unique<vulkan::DescriptorWriter>(
+        data_->allocator(), data_->allocator(), &device, *draw_set_layout_,
+        draw_bindings, true);
+    draw_sets_.reserve(num_swapchain_images * max_draws_);
+
+    // The dynamic set points at the first resources, and every draw offsets
+    // them to its own.
+    dynamic_set_layout_ =
+        containers::make_unique<vulkan::VkDescriptorSetLayout>(
+            data_->allocator(),
+            vulkan::CreateDescriptorSetLayout(
+                data_->allocator(), &device,
+                {dynamic_bindings_[0], dynamic_bindings_[1],
+                 dynamic_bindings_[2], dynamic_bindings_[3]}));
+    dynamic_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{dynamic_bindings_[0], dynamic_bindings_[1], dynamic_bindings_[2],
+              dynamic_bindings_[3]}}));
+    dynamic_set_ = containers::make_unique<vulkan::DescriptorAllocator::Set>(
+        data_->allocator(),
+        app()->descriptor_allocator().Allocate(
+            *dynamic_set_layout_,
+            {dynamic_bindings_[0], dynamic_bindings_[1], dynamic_bindings_[2],
+             dynamic_bindings_[3]}));
+    VkDescriptorBufferInfo dynamic_infos[kResourcesPerDraw];
+    VkWriteDescriptorSet dynamic_writes[kResourcesPerDraw];
+    for (uint32_t i = 0; i < kResourcesPerDraw; ++i) {
+      dynamic_infos[i] = {
+          *resource_buffer_,  // buffer
+          0,                  // offset
+          sizeof(float) * 4,  // range
+      };
+      dynamic_writes[i] = {
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+          nullptr,                                    // pNext
+          *dynamic_set_,                              // dstSet
+          i,                                          // dstbinding
+          0,                                          // dstArrayElement
+          1,                                          // descriptorCount
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,  // descriptorType
+          nullptr,                                    // pImageInfo
+          &dynamic_infos[i],                          // pBufferInfo
+          nullptr,                                    // pTexelBufferView
+      };
+    }
+    device->vkUpdateDescriptorSets(device, kResourcesPerDraw, dynamic_writes,
+                                   0, nullptr);
+
+    push_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{{draw_bindings_[0], draw_bindings_[1], draw_bindings_[2],
+               draw_bindings_[3]},
+              VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR}}));
+    push_writer_ = containers::make_unique<vulkan::DescriptorWriter>(
+        data_->allocator(),
+        app()->CreateDescriptorWriter(*push_pipeline_layout_, 0));
+
+    // The bindless table is the only set of its pipeline layout.
+    VkPushConstantRange bindless_range = {
+        VK_SHADER_STAGE_VERTEX_BIT,  // stageFlags
+        0,                           // offset
+        sizeof(uint32_t)             // size
+    };
+    bindless_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreateBindlessPipelineLayout({}, {bindless_range}));
+    vulkan::BindlessTable* table = app()->bindless_table();
+    bindless_indices_.reserve(kNumResources);
+    for (uint32_t i = 0; i < kNumResources; ++i) {
+      bindless_indices_.push_back(table->AddBuffer(
+          *resource_buffer_, i * resource_stride_, sizeof(float) * 4));
+      // The shader reads the resources of a draw from consecutive indices.
+      LOG_ASSERT(==, data_->logger(), bindless_indices_[0] + i,
+                 bindless_indices_.back());
+    }
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    draw_pipeline_ = CreatePipeline(draw_pipeline_layout_.get(),
+                                    descriptor_benchmark_vertex_shader);
+    dynamic_pipeline_ = CreatePipeline(dynamic_pipeline_layout_.get(),
+                                       descriptor_benchmark_vertex_shader);
+    push_pipeline_ = CreatePipeline(push_pipeline_layout_.get(),
+                                    descriptor_benchmark_vertex_shader);
+    bindless_pipeline_ =
+        CreatePipeline(bindless_pipeline_layout_.get(),
+                       descriptor_benchmark_bindless_vertex_shader);
+  }
+
+  virtual void InitializeFrameData(
+      DescriptorBenchmarkFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    // The sets of the prebuilt strategy are written once here. The update
+    // strategies write the same descriptors to them again every frame.
+    frame_data->first_draw_set_ = draw_sets_.size();
+    for (uint32_t i = 0; i < max_draws_; ++i) {
+      draw_sets_.push_back(app()->descriptor_allocator().Allocate(
+          *draw_set_layout_, {draw_bindings_[0], draw_bindings_[1],
+                              draw_bindings_[2], draw_bindings_[3]}));
+      template_writer_->Write(draw_sets_.back(), GetDrawDescriptors(i));
+    }
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {}
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      DescriptorBenchmarkFrameData* frame_data) override {
+    const BenchmarkConfig& config = configs_[config_index_];
+    const Strategy strategy = kStrategies[config.strategy_index].strategy;
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    auto record_start = std::chrono::high_resolution_clock::now();
+    const uint32_t zone = gpu_profiler()->BeginZone(
+        &cmdBuffer, kStrategies[config.strategy_index].name, false);
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    cube_.BindVertexAndIndexBuffers(&cmdBuffer);
+    const uint32_t num_indices = static_cast<uint32_t>(cube_.NumIndices());
+
+    vulkan::DescriptorAllocator::Set* sets =
+        &draw_sets_[frame_data->first_draw_set_];
+    switch (strategy) {
+      case Strategy::kPrebuiltSets:
+      case Strategy::kUpdateSets:
+      case Strategy::kUpdateTemplate:
+        cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                     *draw_pipeline_);
+        break;
+      case Strategy::kDynamicOffsets:
+        cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                     *dynamic_pipeline_);
+        break;
+      case Strategy::kPushDescriptors:
+        cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                     *push_pipeline_);
+        break;
+      case Strategy::kBindless:
+        cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                     *bindless_pipeline_);
+        app()->bindless_table()->Bind(
+            &cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            ::VkPipelineLayout(*bindless_pipeline_layout_), 0);
+        break;
+    }
+
+    for (uint32_t i = 0; i < config.num_draws; ++i) {
+      switch (strategy) {
+        case Strategy::kPrebuiltSets:
+          cmdBuffer->vkCmdBindDescriptorSets(
+              cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+              ::VkPipelineLayout(*draw_pipeline_layout_), 0, 1,
+              &sets[i].raw_set(), 0, nullptr);
+          break;
+        case Strategy::kUpdateSets: {
+          const DrawDescriptors descriptors = GetDrawDescriptors(i);
+          VkWriteDescriptorSet writes[kResourcesPerDraw];
+          for (uint32_t j = 0; j < kResourcesPerDraw; ++j) {
+            writes[j] = {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+                nullptr,                                 // pNext
+                sets[i],                                 // dstSet
+                j,                                       // dstbinding
+                0,                                       // dstArrayElement
+                1,                                       // descriptorCount
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+                nullptr,                                 // pImageInfo
+                &descriptors.resources[j],               // pBufferInfo
+                nullptr,                                 // pTexelBufferView
+            };
+          }
+          app()->device()->vkUpdateDescriptorSets(
+              app()->device(), kResourcesPerDraw, writes, 0, nullptr);
+          cmdBuffer->vkCmdBindDescriptorSets(
+              cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+              ::VkPipelineLayout(*draw_pipeline_layout_), 0, 1,
+              &sets[i].raw_set(), 0, nullptr);
+          break;
+        }
+        case Strategy::kUpdateTemplate:
+          template_writer_->Write(sets[i], GetDrawDescriptors(i));
+          cmdBuffer->vkCmdBindDescriptorSets(
+              cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+              ::VkPipelineLayout(*draw_pipeline_layout_), 0, 1,
+              &sets[i].raw_set(), 0, nullptr);
+          break;
+        case Strategy::kDynamicOffsets: {
+          uint32_t offsets[kResourcesPerDraw];
+          for (uint32_t j = 0; j < kResourcesPerDraw; ++j) {
+            offsets[j] =
+                static_cast<uint32_t>(GetResource(i, j) * resource_stride_);
+          }
+          cmdBuffer->vkCmdBindDescriptorSets(
+              cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+              ::VkPipelineLayout(*dynamic_pipeline_layout_), 0, 1,
+              &dynamic_set_->raw_set(), kResourcesPerDraw, offsets);
+          break;
+        }
+        case Strategy::kPushDescriptors:
+          push_writer_->Push(&cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                             ::VkPipelineLayout(*push_pipeline_layout_), 0,
+                             GetDrawDescriptors(i));
+          break;
+        case Strategy::kBindless: {
+          const uint32_t first_resource = bindless_indices_[GetResource(i, 0)];
+          cmdBuffer->vkCmdPushConstants(
+              cmdBuffer, ::VkPipelineLayout(*bindless_pipeline_layout_),
+              VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(first_resource),
+              &first_resource);
+          break;
+        }
+      }
+      // The index of the draw is its first instance, which places its cube.
+      cmdBuffer->vkCmdDrawIndexed(cmdBuffer, num_indices, 1, 0, 0, i);
+    }
+
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, zone);
+    auto record_end = std::chrono::high_resolution_clock::now();
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (config_frame_ >= kWarmupFrames) {
+      record_time_ +=
+          std::chrono::duration<double, std::milli>(record_end - record_start)
+              .count();
+      // The GPU time is the one of the last frame that finished.
+      const float gpu_time = gpu_profiler()->GetLastZoneTime(
+          kStrategies[config.strategy_index].name);
+      if (gpu_time >= 0.0f) {
+        gpu_time_ += gpu_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      const double num_frames = frames_per_config_ - kWarmupFrames;
+      app()->GetLogger()->LogInfo(
+          "BENCHMARK: draws: ", config.num_draws,
+          " resources: ", config.num_draws * kResourcesPerDraw,
+          " strategy: ", kStrategies[config.strategy_index].name,
+          " record: ", record_time_ / num_frames, "ms gpu: ",
+          num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0, "ms");
+      config_frame_ = 0;
+      record_time_ = 0.0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (++config_index_ == configs_.size()) {
+        done_ = true;
+        config_index_ = 0;
+      }
+    }
+  }
+
+  // Returns true once every configuration has been measured.
+  bool benchmark_done() const { return done_; }
+
+ private:
+  // Returns the index of resource |resource| of draw |draw|.
+  uint32_t GetResource(uint32_t draw, uint32_t resource) const {
+    return (draw * kResourcesPerDraw + resource) % kNumResources;
+  }
+
+  DrawDescriptors GetDrawDescriptors(uint32_t draw) const {
+    DrawDescriptors descriptors;
+    for (uint32_t i = 0; i < kResourcesPerDraw; ++i) {
+      descriptors.resources[i] = {
+          *resource_buffer_,                        // buffer
+          GetResource(draw, i) * resource_stride_,  // offset
+          sizeof(float) * 4,                        // range
+      };
+    }
+    return descriptors;
+  }
+
+  template <int N>
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreatePipeline(
+      vulkan::PipelineLayout* layout, uint32_t (&vertex_shader)[N]) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app()->CreateGraphicsPipeline(layout, render_pass_.get(), 0));
+    pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main", vertex_shader);
+    pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                        descriptor_benchmark_fragment_shader);
+    // The cubes are placed straight in clip space, without a projection
+    // that keeps the winding of the model, so both sides are drawn.
+    pipeline->SetCullMode(VK_CULL_MODE_NONE);
+    pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline->SetInputStreams(&cube_);
+    pipeline->SetViewport(viewport());
+    pipeline->SetScissor(scissor());
+    pipeline->SetSamples(num_samples());
+    pipeline->AddAttachment();
+    pipeline->Commit();
+    return pipeline;
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  vulkan::VulkanModel cube_;
+  // kNumResources ranges of resource_stride_ bytes.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> resource_buffer_;
+
+  VkDescriptorSetLayoutBinding draw_bindings_[kResourcesPerDraw];
+  VkDescriptorSetLayoutBinding dynamic_bindings_[kResourcesPerDraw];
+
+  // The prebuilt and update strategies.
+  containers::unique_ptr<vulkan::VkDescriptorSetLayout> draw_set_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> draw_pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> draw_pipeline_;
+  containers::unique_ptr<vulkan::DescriptorWriter> template_writer_;
+  // max_draws_ sets for every frame.
+  containers::vector<vulkan::DescriptorAllocator::Set> draw_sets_;
+
+  // The dynamic offset strategy.
+  containers::unique_ptr<vulkan::VkDescriptorSetLayout> dynamic_set_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> dynamic_pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> dynamic_pipeline_;
+  containers::unique_ptr<vulkan::DescriptorAllocator::Set> dynamic_set_;
+
+  // The push descriptor strategy.
+  containers::unique_ptr<vulkan::PipelineLayout> push_pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> push_pipeline_;
+  containers::unique_ptr<vulkan::DescriptorWriter> push_writer_;
+
+  // The bindless strategy, and the index of every resource in the table.
+  containers::unique_ptr<vulkan::PipelineLayout> bindless_pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> bindless_pipeline_;
+  containers::vector<uint32_t> bindless_indices_;
+
+  // The configurations that are measured, one after the other.
+  containers::vector<BenchmarkConfig> configs_;
+  uint32_t max_draws_;
+  VkDeviceSize resource_stride_;
+  uint32_t frames_per_config_;
+  size_t config_index_;
+  uint32_t config_frame_;
+  bool done_;
+  // The sums of the measured frames of the current configuration, in
+  // milliseconds.
+  double record_time_;
+  double gpu_time_;
+  uint32_t num_gpu_times_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  // The bindless table needs these features of VK_EXT_descriptor_indexing.
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features{};
+  descriptor_indexing_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  descriptor_indexing_features.runtimeDescriptorArray = VK_TRUE;
+  descriptor_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+  descriptor_indexing_features.descriptorBindingUpdateUnusedWhilePending =
+      VK_TRUE;
+  descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind =
+      VK_TRUE;
+  descriptor_indexing_features.descriptorBindingStorageBufferUpdateAfterBind =
+      VK_TRUE;
+  DescriptorBenchmark sample(data, &descriptor_indexing_features);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing() &&
+         !sample.benchmark_done()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -151,6 +151,8 @@ class DispatchIndirectSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     dispatch_data_ =
         containers::make_unique<vulkan::BufferFrameData<DispatchData>>(
@@ -430,9 +432,6 @@ class DispatchIndirectSample
 
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
     indirect_command_data_->UpdateBuffer(queue, frame_index);
 
     VkSubmitInfo init_submit_info{
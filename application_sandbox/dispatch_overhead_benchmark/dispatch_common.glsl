@@ -0,0 +1,34 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Every workgroup of every dispatch runs one work item, which is a few
+// instructions and one 4 byte write for each invocation, so that the cost of
+// the dispatches is what is measured.
+
+// These must match kWorkGroupSize and ItemValue in main.cpp.
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+uint item_value(uint index) {
+    return index * 2654435761u + 1u;
+}
+
+layout (binding = 0, set = 0, std430) writeonly buffer output_data {
+    uint values[];
+};
+
+void run_item(uint item) {
+    uint index = item * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+    values[index] = item_value(index);
+}
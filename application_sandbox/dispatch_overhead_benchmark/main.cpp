@@ -0,0 +1,467 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/dispatch_batch.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t dispatch_direct_shader[] =
+#include "dispatch_direct.comp.spv"
+    ;
+
+uint32_t dispatch_persistent_shader[] =
+#include "dispatch_persistent.comp.spv"
+    ;
+
+uint32_t dispatch_batched_shader[] =
+#include "dispatch_batched.comp.spv"
+    ;
+
+namespace {
+// This must match local_size_x in dispatch_common.glsl.
+const uint32_t kWorkGroupSize = 64;
+// The dispatches of every run, unless dispatches=<N> was given.
+const uint32_t kDefaultDispatches = 1000;
+// The workgroups that take work items in the persistent method, unless
+// persistent_groups=<N> was given.
+const uint32_t kDefaultPersistentGroups = 128;
+// The workgroups of every dispatch go from 1 to kMaxGroups, by
+// kGroupsStep at a time.
+const uint32_t kMaxGroups = 64;
+const uint32_t kGroupsStep = 4;
+// Every configuration is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 5;
+// The bindings of the batch tables, which must match DISPATCH_BATCH_BINDING
+// in dispatch_batched.comp.
+const uint32_t kBatchBinding = 2;
+
+enum Method {
+  // One vkCmdDispatch for every dispatch.
+  kDirect,
+  // Like kDirect, with a compute to compute barrier between dispatches.
+  kDirectBarrier,
+  // One vkCmdDispatchIndirect for every dispatch.
+  kIndirect,
+  // Like kIndirect, with a compute to compute barrier between dispatches.
+  kIndirectBarrier,
+  // One dispatch of a few workgroups, that take the work items of all of
+  // the dispatches from a queue.
+  kPersistent,
+  // One dispatch of all of the workgroups of all of the dispatches, through
+  // vulkan::DispatchBatch.
+  kBatched,
+  kNumMethods,
+};
+
+// The name of every method in the sample options and the results.
+const char* const kMethodNames[kNumMethods] = {
+    "direct",     "direct_barrier", "indirect", "indirect_barrier",
+    "persistent", "batched"};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// This must match item_value in dispatch_common.glsl.
+uint32_t ItemValue(uint32_t index) { return index * 2654435761u + 1u; }
+
+void SubmitAndWait(vulkan::VkQueue* queue, vulkan::VkCommandBuffer* cmd) {
+  VkSubmitInfo submit_info = {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &cmd->get_command_buffer(),     // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+  (*queue)->vkQueueWaitIdle(*queue);
+}
+
+void MemoryBarrier(vulkan::VkCommandBuffer* cmd, VkPipelineStageFlags src,
+                   VkAccessFlags src_access, VkPipelineStageFlags dst,
+                   VkAccessFlags dst_access) {
+  VkMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+      nullptr,                           // pNext
+      src_access,                        // srcAccessMask
+      dst_access,                        // dstAccessMask
+  };
+  (*cmd)->vkCmdPipelineBarrier(*cmd, src, dst, 0, 1, &barrier, 0, nullptr, 0,
+                               nullptr);
+}
+
+// Measures the overhead of many small compute dispatches, for every number
+// of workgroups per dispatch, with every method. The results of every
+// configuration are checked on the host before its time is logged.
+class DispatchBenchmark {
+ public:
+  DispatchBenchmark(const entry::EntryData* data,
+                    vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        num_dispatches_(
+            data->sample_option_uint("dispatches", kDefaultDispatches)),
+        persistent_groups_(data->sample_option_uint("persistent_groups",
+                                                    kDefaultPersistentGroups)),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        batch_(app, num_dispatches_ * kMaxGroups, num_dispatches_) {
+    vulkan::VkDevice& device = app->device();
+    for (uint32_t i = 0; i < kBatchBinding; ++i) {
+      bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    VkDescriptorSetLayoutBinding batch_bindings[2];
+    vulkan::DispatchBatch::GetBindings(kBatchBinding, batch_bindings);
+    bindings_[kBatchBinding] = batch_bindings[0];
+    bindings_[kBatchBinding + 1] = batch_bindings[1];
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(uint32_t)              // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout(
+            {{bindings_[0], bindings_[1], bindings_[2], bindings_[3]}},
+            {range}));
+    direct_pipeline_ = CreatePipeline(dispatch_direct_shader,
+                                      sizeof(dispatch_direct_shader));
+    persistent_pipeline_ = CreatePipeline(dispatch_persistent_shader,
+                                          sizeof(dispatch_persistent_shader));
+    batched_pipeline_ = CreatePipeline(dispatch_batched_shader,
+                                       sizeof(dispatch_batched_shader));
+
+    const VkDeviceSize size = static_cast<VkDeviceSize>(num_dispatches_) *
+                              kMaxGroups * kWorkGroupSize * sizeof(uint32_t);
+    values_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(
+        size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    queue_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(
+        sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    host_values_ = app->CreateAndBindDefaultExclusiveHostBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    indirect_ = app->CreateAndBindDefaultExclusiveHostBuffer(
+        num_dispatches_ * sizeof(VkDispatchIndirectCommand),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    set_ = containers::make_unique<vulkan::DescriptorSet>(
+        data->allocator(),
+        app->AllocateDescriptorSet(
+            {bindings_[0], bindings_[1], bindings_[2], bindings_[3]}));
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {*values_, 0, VK_WHOLE_SIZE},
+        {*queue_, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *set_,                                   // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    device->vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    batch_.WriteDescriptors(*set_, kBatchBinding, 0);
+  }
+
+  // Measures every method with every number of workgroups per dispatch, or
+  // only the ones that the sample options name, and logs the results, and
+  // the fastest method for every number of workgroups.
+  void Run() {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    const char* method_option = data_->sample_option("method");
+    const uint32_t groups_option = data_->sample_option_uint("groups", 0);
+    for (uint32_t groups = 1; groups <= kMaxGroups; groups *= kGroupsStep) {
+      if (groups_option && groups_option != groups) {
+        continue;
+      }
+      const char* best_method = nullptr;
+      double best_ns = -1.0;
+      for (uint32_t method = 0; method < kNumMethods; ++method) {
+        if (method_option && strcmp(method_option, kMethodNames[method]) != 0) {
+          continue;
+        }
+        const double ns = Measure(static_cast<Method>(method), groups);
+        if (ns < 0.0) {
+          continue;
+        }
+        data_->logger()->LogInfo(
+            "DISPATCH: method: ", kMethodNames[method],
+            " dispatches: ", num_dispatches_, " groups: ", groups,
+            " us_per_dispatch: ", ns / num_dispatches_ / 1.0e3,
+            " ns_per_group: ", ns / (num_dispatches_ * groups));
+        if (best_ns < 0.0 || ns < best_ns) {
+          best_method = kMethodNames[method];
+          best_ns = ns;
+        }
+      }
+      if (best_method) {
+        data_->logger()->LogInfo("DISPATCH_BEST: dispatches: ",
+                                 num_dispatches_, " groups: ", groups,
+                                 " method: ", best_method);
+      }
+    }
+  }
+
+ private:
+  containers::unique_ptr<vulkan::VulkanComputePipeline> CreatePipeline(
+      uint32_t* shader, size_t shader_size) {
+    return containers::make_unique<vulkan::VulkanComputePipeline>(
+        data_->allocator(),
+        app_->CreateComputePipeline(
+            pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                shader_size, shader},
+            "main"));
+  }
+
+  // Records the dispatches of |groups| workgroups each with |method|.
+  void RecordDispatches(vulkan::VkCommandBuffer* cmd, Method method,
+                        uint32_t groups) {
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const uint32_t num_items = num_dispatches_ * groups;
+    switch (method) {
+      case kDirect:
+      case kDirectBarrier:
+      case kIndirect:
+      case kIndirectBarrier: {
+        const bool indirect = method == kIndirect || method == kIndirectBarrier;
+        const bool barriers =
+            method == kDirectBarrier || method == kIndirectBarrier;
+        cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                     *direct_pipeline_);
+        for (uint32_t i = 0; i < num_dispatches_; ++i) {
+          if (barriers && i > 0) {
+            MemoryBarrier(cmd, compute, VK_ACCESS_SHADER_WRITE_BIT, compute,
+                          VK_ACCESS_SHADER_READ_BIT |
+                              VK_ACCESS_SHADER_WRITE_BIT);
+          }
+          const uint32_t first_item = i * groups;
+          cmdBuffer->vkCmdPushConstants(
+              cmdBuffer, *pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+              sizeof(first_item), &first_item);
+          if (indirect) {
+            cmdBuffer->vkCmdDispatchIndirect(
+                cmdBuffer, *indirect_, i * sizeof(VkDispatchIndirectCommand));
+          } else {
+            cmdBuffer->vkCmdDispatch(cmdBuffer, groups, 1, 1);
+          }
+        }
+        break;
+      }
+      case kPersistent:
+        cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                     *persistent_pipeline_);
+        cmdBuffer->vkCmdPushConstants(
+            cmdBuffer, *pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+            sizeof(num_items), &num_items);
+        cmdBuffer->vkCmdDispatch(cmdBuffer, persistent_groups_, 1, 1);
+        break;
+      case kBatched:
+        cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                     *batched_pipeline_);
+        for (uint32_t i = 0; i < num_dispatches_; ++i) {
+          batch_.Add(groups, i * groups);
+        }
+        batch_.Record(cmd, 0);
+        break;
+      case kNumMethods:
+        break;
+    }
+  }
+
+  // Returns the GPU time of the fastest of kNumRuns runs of the dispatches
+  // of |groups| workgroups each with |method|, in nanoseconds, or a
+  // negative number if it could not be measured or the result is wrong.
+  double Measure(Method method, uint32_t groups) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags transfer = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    const uint32_t num_items = num_dispatches_ * groups;
+    const VkDeviceSize size = static_cast<VkDeviceSize>(num_items) *
+                              kWorkGroupSize * sizeof(uint32_t);
+
+    VkDispatchIndirectCommand* commands =
+        reinterpret_cast<VkDispatchIndirectCommand*>(indirect_->base_address());
+    for (uint32_t i = 0; i < num_dispatches_; ++i) {
+      commands[i] = {groups, 1, 1};
+    }
+    indirect_->flush();
+
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      const bool last_run = run + 1 == kNumRuns;
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      // Every run starts with no values and an empty queue, so that the
+      // last one can be checked.
+      cmd->vkCmdFillBuffer(cmd, *values_, 0, size, 0);
+      cmd->vkCmdFillBuffer(cmd, *queue_, 0, sizeof(uint32_t), 0);
+      MemoryBarrier(&cmd, transfer, VK_ACCESS_TRANSFER_WRITE_BIT, compute,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+      cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *pipeline_layout_, 0, 1, &set_->raw_set(),
+                                   0, nullptr);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 0);
+      RecordDispatches(&cmd, method, groups);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      if (last_run) {
+        // Only the last run is read back and checked.
+        MemoryBarrier(&cmd, compute, VK_ACCESS_SHADER_WRITE_BIT, transfer,
+                      VK_ACCESS_TRANSFER_READ_BIT);
+        VkBufferCopy region = {0, 0, size};
+        cmd->vkCmdCopyBuffer(cmd, *values_, *host_values_, 1, &region);
+        MemoryBarrier(&cmd, transfer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+      }
+      cmd->vkEndCommandBuffer(cmd);
+      SubmitAndWait(&queue, &cmd);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    if (best <= 0.0) {
+      return -1.0;
+    }
+
+    host_values_->invalidate();
+    const uint32_t* values =
+        reinterpret_cast<const uint32_t*>(host_values_->base_address());
+    for (uint32_t i = 0; i < num_items * kWorkGroupSize; ++i) {
+      if (values[i] != ItemValue(i)) {
+        data_->logger()->LogError("DISPATCH: method: ", kMethodNames[method],
+                                  " groups: ", groups,
+                                  " the result is wrong");
+        return -1.0;
+      }
+    }
+    return best;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t num_dispatches_;
+  uint32_t persistent_groups_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+  vulkan::DispatchBatch batch_;
+  VkDescriptorSetLayoutBinding bindings_[kBatchBinding + 2];
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> direct_pipeline_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> persistent_pipeline_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> batched_pipeline_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> values_;
+  // The work item queue of the persistent method.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> queue_;
+  // The values are read back into this.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> host_values_;
+  // The commands of the indirect methods.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> indirect_;
+  containers::unique_ptr<vulkan::DescriptorSet> set_;
+};
+}  // anonymous namespace
+
+// This sample measures many small compute dispatches, each of 1 to 64
+// workgroups that write one value per invocation, recorded as direct and
+// indirect dispatches with and without barriers between them, as a
+// persistent-threads work queue, and as one vulkan::DispatchBatch. It logs
+// one line per configuration whose result is correct, and the fastest
+// method for every number of workgroups:
+//   DISPATCH: method: <method> dispatches: <n> groups: <n>
+//       us_per_dispatch: <us> ns_per_group: <ns>
+//   DISPATCH_BEST: dispatches: <n> groups: <n> method: <method>
+// -sample-option=method=<method> and groups=<n> only measure those,
+// dispatches sets the number of dispatches of every run, and
+// persistent_groups the workgroups of the persistent method.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  // The values of the default 1000 dispatches of 64 workgroups are 16 MB,
+  // and they are read back through host memory.
+  const uint32_t dispatches =
+      data->sample_option_uint("dispatches", kDefaultDispatches);
+  const uint32_t values_size =
+      dispatches * kMaxGroups * kWorkGroupSize * sizeof(uint32_t);
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data, {},
+                                {}, {0}, values_size + 4 * 1024 * 1024,
+                                1024 * 1024, values_size + 1024 * 1024);
+  DispatchBenchmark benchmark(data, &app);
+  benchmark.Run();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,813 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector3 = mathfu::Vector<float, 3>;
+
+namespace cube_model {
+#include "cube.obj.h"
+}
+const auto& cube_data = cube_model::model;
+
+uint32_t draw_path_vertex_shader[] =
+#include "draw_path.vert.spv"
+    ;
+
+uint32_t draw_path_fragment_shader[] =
+#include "draw_path.frag.spv"
+    ;
+
+uint32_t generate_draws_shader[] =
+#include "generate_draws.comp.spv"
+    ;
+
+// This must match local_size_x in generate_draws.comp.
+const uint32_t kGenerateGroupSize = 64;
+
+// The ways in which the cubes are drawn.
+enum class DrawPath {
+  // One vkCmdDrawIndexed per cube.
+  kDirect,
+  // A single vkCmdDrawIndexed with an instance per cube.
+  kInstanced,
+  // A single vkCmdDrawIndexedIndirect, with a command per cube that the
+  // CPU wrote once.
+  kIndirect,
+  // A single vkCmdDrawIndexedIndirectCountKHR, with the commands and their
+  // count written by a compute shader every frame.
+  kIndirectCount,
+};
+
+struct DrawPathInfo {
+  DrawPath path;
+  // The name of the path in the sample options, and of its GPU zone.
+  const char* name;
+};
+
+const DrawPathInfo kDrawPaths[] = {
+    {DrawPath::kDirect, "direct"},
+    {DrawPath::kInstanced, "instanced"},
+    {DrawPath::kIndirect, "indirect"},
+    {DrawPath::kIndirectCount, "indirect_count"},
+};
+const size_t kNumDrawPaths = sizeof(kDrawPaths) / sizeof(kDrawPaths[0]);
+
+// The numbers of cubes that every path is measured with, unless objects=<N>
+// was given.
+const uint32_t kObjectCounts[] = {1000, 10000, 100000, 1000000};
+
+// The frames of every configuration that are measured, after the warmup
+// frames, which let the frames in flight and the GPU times of the previous
+// configuration drain.
+const uint32_t kDefaultFramesPerConfig = 120;
+const uint32_t kWarmupFrames = 30;
+
+// The storage buffer data of every cube, the position of its center, and
+// its scale.
+struct ObjectData {
+  float position[3];
+  float scale;
+};
+
+// The push constants of generate_draws.comp.
+struct GenerateData {
+  uint32_t num_objects;
+  uint32_t index_count;
+};
+
+// One number of cubes, drawn with one path.
+struct BenchmarkConfig {
+  uint32_t num_objects;
+  size_t path_index;
+};
+
+struct DrawPathBenchmarkFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
+};
+
+// This draws the same grid of cubes with every draw path in turn, and logs
+// the CPU time that it takes to record the draws, and the GPU time of
+// drawing them, for a range of numbers of cubes. Every cube reads its
+// position from a storage buffer with its instance index, so that every
+// path draws exactly the same thing.
+class DrawPathBenchmark
+    : public sample_application::Sample<DrawPathBenchmarkFrameData> {
+ public:
+  DrawPathBenchmark(const entry::EntryData* data,
+                    const VkPhysicalDeviceFeatures& requested_features)
+      : data_(data),
+        Sample<DrawPathBenchmarkFrameData>(
+            data->allocator(), data, 64, 512, 128, 1,
+            sample_application::SampleOptions().EnableGpuProfiler(1),
+            requested_features, {},
+            {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME}),
+        cube_(data->allocator(), data->logger(), cube_data),
+        configs_(data->allocator()),
+        max_objects_(0),
+        max_draw_indirect_count_(0),
+        frames_per_config_(kDefaultFramesPerConfig),
+        config_index_(0),
+        config_frame_(0),
+        configured_objects_(0),
+        upload_pending_(false),
+        done_(false),
+        record_time_(0.0),
+        gpu_time_(0.0),
+        num_gpu_times_(0) {
+    const char* frames_option = data->sample_option("frames_per_config");
+    if (frames_option) {
+      frames_per_config_ =
+          static_cast<uint32_t>(strtoul(frames_option, nullptr, 10));
+    }
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+
+    // Every path runs with one number of cubes before the next one, so that
+    // the cubes only have to be uploaded once per number.
+    const char* objects_option = data->sample_option("objects");
+    const char* path_option = data->sample_option("path");
+    const uint32_t num_objects =
+        objects_option
+            ? static_cast<uint32_t>(strtoul(objects_option, nullptr, 10))
+            : 0;
+    const size_t num_counts =
+        num_objects > 0 ? 1 : sizeof(kObjectCounts) / sizeof(kObjectCounts[0]);
+    for (size_t count = 0; count < num_counts; ++count) {
+      const uint32_t objects =
+          num_objects > 0 ? num_objects : kObjectCounts[count];
+      for (size_t i = 0; i < kNumDrawPaths; ++i) {
+        if (path_option && strcmp(path_option, kDrawPaths[i].name) != 0) {
+          continue;
+        }
+        configs_.push_back({objects, i});
+        max_objects_ = std::max(max_objects_, objects);
+      }
+    }
+    if (configs_.empty()) {
+      data->logger()->LogError("Unknown draw path ", path_option);
+      for (size_t i = 0; i < kNumDrawPaths; ++i) {
+        configs_.push_back({kObjectCounts[0], i});
+      }
+      max_objects_ = kObjectCounts[0];
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    cube_.InitializeData(app(), initialization_buffer);
+
+    VkPhysicalDeviceProperties properties;
+    app()->instance()->vkGetPhysicalDeviceProperties(
+        app()->device().physical_device(), &properties);
+    max_draw_indirect_count_ = properties.limits.maxDrawIndirectCount;
+
+    // The cubes and the commands of the indirect path are written to the
+    // staging buffer whenever the number of cubes changes, and copied to
+    // the device from there.
+    const VkDeviceSize object_size = max_objects_ * sizeof(ObjectData);
+    const VkDeviceSize command_size =
+        max_objects_ * sizeof(VkDrawIndexedIndirectCommand);
+    staging_buffer_ = app()->CreateAndBindDefaultExclusiveHostBuffer(
+        object_size + command_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    object_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        object_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    command_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        command_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    generated_command_buffer_ =
+        app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+            command_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    count_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    for (uint32_t i = 0; i < 3; ++i) {
+      cube_descriptor_set_layouts_[i] = {
+          i,  // binding
+          i < 2 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_VERTEX_BIT,                 // stageFlags
+          nullptr                                     // pImmutableSamplers
+      };
+    }
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{cube_descriptor_set_layouts_[0],
+                                      cube_descriptor_set_layouts_[1],
+                                      cube_descriptor_set_layouts_[2]}}));
+
+    // The generate shader writes the commands and their count.
+    for (uint32_t i = 0; i < 2; ++i) {
+      generate_descriptor_set_layouts_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    VkPushConstantRange generate_range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(GenerateData)          // size
+    };
+
+    generate_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{generate_descriptor_set_layouts_[0],
+                                      generate_descriptor_set_layouts_[1]}},
+                                    {generate_range}));
+    generate_pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+        data_->allocator(),
+        app()->CreateComputePipeline(
+            generate_pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                sizeof(generate_draws_shader), generate_draws_shader},
+            "main"));
+
+    generate_descriptor_set_ = containers::make_unique<vulkan::DescriptorSet>(
+        data_->allocator(),
+        app()->AllocateDescriptorSet({generate_descriptor_set_layouts_[0],
+                                      generate_descriptor_set_layouts_[1]}));
+    VkDescriptorBufferInfo generate_buffer_infos[2] = {
+        {
+            *generated_command_buffer_,  // buffer
+            0,                           // offset
+            VK_WHOLE_SIZE,               // range
+        },
+        {
+            *count_buffer_,  // buffer
+            0,               // offset
+            VK_WHOLE_SIZE,   // range
+        }};
+    VkWriteDescriptorSet generate_write{
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *generate_descriptor_set_,               // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        generate_buffer_infos,                   // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 1,
+                                            &generate_write, 0, nullptr);
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    cube_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                              draw_path_vertex_shader);
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                              draw_path_fragment_shader);
+    cube_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    cube_pipeline_->SetInputStreams(&cube_);
+    cube_pipeline_->SetViewport(viewport());
+    cube_pipeline_->SetScissor(scissor());
+    cube_pipeline_->SetSamples(num_samples());
+    cube_pipeline_->AddAttachment();
+    cube_pipeline_->Commit();
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(Vector3{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+
+    // Every cube rotates around its own center.
+    model_data_->data().transform = Mat44::Identity();
+  }
+
+  virtual void InitializeFrameData(
+      DrawPathBenchmarkFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->cube_descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({cube_descriptor_set_layouts_[0],
+                                          cube_descriptor_set_layouts_[1],
+                                          cube_descriptor_set_layouts_[2]}));
+
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            model_data_->get_buffer(),                       // buffer
+            model_data_->get_offset_for_frame(frame_index),  // offset
+            model_data_->size(),                             // range
+        },
+        {
+            *object_buffer_,  // buffer
+            0,                // offset
+            VK_WHOLE_SIZE,    // range
+        }};
+
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->cube_descriptor_set_,       // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->cube_descriptor_set_,       // dstSet
+            2,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos + 2,                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 2, writes, 0,
+                                            nullptr);
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    model_data_->data().transform =
+        model_data_->data().transform *
+        Mat44::FromRotationMatrix(
+            Mat44::RotationX(3.14f * time_since_last_render) *
+            Mat44::RotationY(3.14f * time_since_last_render * 0.5f));
+  }
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      DrawPathBenchmarkFrameData* frame_data) override {
+    const BenchmarkConfig& config = configs_[config_index_];
+    if (configured_objects_ != config.num_objects) {
+      LayOutObjects(config.num_objects);
+    }
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+    if (upload_pending_) {
+      RecordUpload(&cmdBuffer, config.num_objects);
+      upload_pending_ = false;
+    }
+
+    auto record_start = std::chrono::high_resolution_clock::now();
+    const DrawPath path = kDrawPaths[config.path_index].path;
+    const uint32_t zone = gpu_profiler()->BeginZone(
+        &cmdBuffer, kDrawPaths[config.path_index].name, false);
+    const uint32_t num_indices = static_cast<uint32_t>(cube_.NumIndices());
+    const uint32_t num_indirect_draws =
+        std::min(config.num_objects, max_draw_indirect_count_);
+    if (path == DrawPath::kIndirectCount) {
+      RecordGenerateDraws(&cmdBuffer, config.num_objects);
+    }
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *cube_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
+    cube_.BindVertexAndIndexBuffers(&cmdBuffer);
+
+    switch (path) {
+      case DrawPath::kDirect:
+        // The index of the cube is the first instance of its draw.
+        for (uint32_t i = 0; i < config.num_objects; ++i) {
+          cmdBuffer->vkCmdDrawIndexed(cmdBuffer, num_indices, 1, 0, 0, i);
+        }
+        break;
+      case DrawPath::kInstanced:
+        cmdBuffer->vkCmdDrawIndexed(cmdBuffer, num_indices,
+                                    config.num_objects, 0, 0, 0);
+        break;
+      case DrawPath::kIndirect:
+        cmdBuffer->vkCmdDrawIndexedIndirect(
+            cmdBuffer, *command_buffer_, 0, num_indirect_draws,
+            static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+        break;
+      case DrawPath::kIndirectCount:
+        cmdBuffer->vkCmdDrawIndexedIndirectCountKHR(
+            cmdBuffer, *generated_command_buffer_, 0, *count_buffer_, 0,
+            num_indirect_draws,
+            static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+        break;
+    }
+
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, zone);
+    auto record_end = std::chrono::high_resolution_clock::now();
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (config_frame_ >= kWarmupFrames) {
+      record_time_ +=
+          std::chrono::duration<double, std::milli>(record_end - record_start)
+              .count();
+      // The GPU time is the one of the last frame that finished.
+      const float gpu_time =
+          gpu_profiler()->GetLastZoneTime(kDrawPaths[config.path_index].name);
+      if (gpu_time >= 0.0f) {
+        gpu_time_ += gpu_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      const double num_frames = frames_per_config_ - kWarmupFrames;
+      app()->GetLogger()->LogInfo(
+          "BENCHMARK: objects: ", config.num_objects,
+          " path: ", kDrawPaths[config.path_index].name,
+          " record: ", record_time_ / num_frames, "ms gpu: ",
+          num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0, "ms");
+      config_frame_ = 0;
+      record_time_ = 0.0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (++config_index_ == configs_.size()) {
+        done_ = true;
+        config_index_ = 0;
+      }
+    }
+  }
+
+  // Returns true once every configuration has been measured.
+  bool benchmark_done() const { return done_; }
+
+ private:
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  struct ModelData {
+    Mat44 transform;
+  };
+
+  // Writes a square grid of |num_objects| cubes in front of the camera, and
+  // an indirect command to draw every one of them, to the staging buffer.
+  // They are copied to the device at the start of the next frame. The
+  // device is idle afterwards, so that no frame uses the previous cubes
+  // anymore.
+  void LayOutObjects(uint32_t num_objects) {
+    app()->device()->vkDeviceWaitIdle(app()->device());
+    configured_objects_ = num_objects;
+    upload_pending_ = true;
+
+    const uint32_t side = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(num_objects))));
+    const float spacing = 4.0f / side;
+    const float scale = 0.7f * spacing;
+    ObjectData* objects =
+        reinterpret_cast<ObjectData*>(staging_buffer_->base_address());
+    VkDrawIndexedIndirectCommand* commands =
+        reinterpret_cast<VkDrawIndexedIndirectCommand*>(
+            staging_buffer_->base_address() +
+            max_objects_ * sizeof(ObjectData));
+    for (uint32_t i = 0; i < num_objects; ++i) {
+      objects[i] = {
+          {(i % side - (side - 1) * 0.5f) * spacing,
+           (i / side - (side - 1) * 0.5f) * spacing, -3.0f},  // position
+          scale                                               // scale
+      };
+      commands[i] = {
+          static_cast<uint32_t>(cube_.NumIndices()),  // indexCount
+          1,                                          // instanceCount
+          0,                                          // firstIndex
+          0,                                          // vertexOffset
+          i,                                          // firstInstance
+      };
+    }
+    staging_buffer_->flush();
+
+    if (num_objects > max_draw_indirect_count_) {
+      app()->GetLogger()->LogError(
+          "The indirect paths only draw ", max_draw_indirect_count_, " of ",
+          num_objects, " cubes, that is maxDrawIndirectCount");
+    }
+  }
+
+  // Copies the cubes and the indirect commands from the staging buffer.
+  void RecordUpload(vulkan::VkCommandBuffer* cmd, uint32_t num_objects) {
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    VkBufferCopy object_copy = {
+        0,                                // srcOffset
+        0,                                // dstOffset
+        num_objects * sizeof(ObjectData)  // size
+    };
+    VkBufferCopy command_copy = {
+        max_objects_ * sizeof(ObjectData),                 // srcOffset
+        0,                                                 // dstOffset
+        num_objects * sizeof(VkDrawIndexedIndirectCommand)  // size
+    };
+    cmdBuffer->vkCmdCopyBuffer(cmdBuffer, *staging_buffer_, *object_buffer_, 1,
+                               &object_copy);
+    cmdBuffer->vkCmdCopyBuffer(cmdBuffer, *staging_buffer_, *command_buffer_,
+                               1, &command_copy);
+    VkBufferMemoryBarrier barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT,                // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *object_buffer_,                          // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *command_buffer_,                         // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0, 0, nullptr, 2, barriers, 0, nullptr);
+  }
+
+  // Resets the draw count, and writes the draws of the indirect count path
+  // with the generate shader.
+  void RecordGenerateDraws(vulkan::VkCommandBuffer* cmd,
+                           uint32_t num_objects) {
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    // The draws of the last frame have finished reading the buffers before
+    // they are written again.
+    cmdBuffer->vkCmdFillBuffer(cmdBuffer, *count_buffer_, 0, sizeof(uint32_t),
+                               0);
+    VkBufferMemoryBarrier count_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT |
+            VK_ACCESS_SHADER_WRITE_BIT,  // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,         // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,         // dstQueueFamilyIndex
+        *count_buffer_,                  // buffer
+        0,                               // offset
+        VK_WHOLE_SIZE,                   // size
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+        &count_barrier, 0, nullptr);
+
+    const GenerateData generate_data = {
+        num_objects,                                // num_objects
+        static_cast<uint32_t>(cube_.NumIndices()),  // index_count
+    };
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *generate_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*generate_pipeline_layout_), 0, 1,
+        &generate_descriptor_set_->raw_set(), 0, nullptr);
+    cmdBuffer->vkCmdPushConstants(
+        cmdBuffer, ::VkPipelineLayout(*generate_pipeline_layout_),
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(generate_data), &generate_data);
+    cmdBuffer->vkCmdDispatch(
+        cmdBuffer, (num_objects + kGenerateGroupSize - 1) / kGenerateGroupSize,
+        1, 1);
+
+    VkBufferMemoryBarrier draw_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *generated_command_buffer_,               // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *count_buffer_,                           // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 2, draw_barriers,
+        0, nullptr);
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
+  containers::unique_ptr<vulkan::PipelineLayout> generate_pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> generate_pipeline_;
+  containers::unique_ptr<vulkan::DescriptorSet> generate_descriptor_set_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[3];
+  VkDescriptorSetLayoutBinding generate_descriptor_set_layouts_[2];
+  vulkan::VulkanModel cube_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+
+  // The cubes, followed by the commands of the indirect path, for the
+  // largest number of cubes.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> staging_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> object_buffer_;
+  // The commands of the indirect path.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> command_buffer_;
+  // The commands of the indirect count path, and their count.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      generated_command_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> count_buffer_;
+
+  // The configurations that are measured, one after the other.
+  containers::vector<BenchmarkConfig> configs_;
+  uint32_t max_objects_;
+  uint32_t max_draw_indirect_count_;
+  uint32_t frames_per_config_;
+  size_t config_index_;
+  uint32_t config_frame_;
+  // The number of cubes in the device buffers, or that are being copied
+  // there if upload_pending_ is true.
+  uint32_t configured_objects_;
+  bool upload_pending_;
+  bool done_;
+  // The sums of the measured frames of the current configuration, in
+  // milliseconds.
+  double record_time_;
+  double gpu_time_;
+  uint32_t num_gpu_times_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  VkPhysicalDeviceFeatures requested_features = {0};
+  // The indirect paths draw a command per cube from one buffer, and every
+  // command draws its cube as its first instance.
+  requested_features.multiDrawIndirect = VK_TRUE;
+  requested_features.drawIndirectFirstInstance = VK_TRUE;
+  DrawPathBenchmark sample(data, requested_features);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing() &&
+         !sample.benchmark_done()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
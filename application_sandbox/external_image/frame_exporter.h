@@ -0,0 +1,753 @@
+// Copyright 2019 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef EXTERNAL_IMAGE_FRAME_EXPORTER_H_
+#define EXTERNAL_IMAGE_FRAME_EXPORTER_H_
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/helper_functions.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// FrameExporter hands a ring of rendered images to a consumer in another
+// process, e.g. an encoder, and FrameImporter is that consumer. The images
+// share one exported allocation, so frames are never copied through the
+// CPU. Every image has an exported semaphore, that the producer signals
+// once the frame is rendered and the consumer waits on, and an exported
+// fence, that the consumer signals once it is done with the frame and the
+// producer waits on before it renders to the image again. The size and
+// format of the images, and which frames were published, are in a small
+// block of shared memory.
+//
+// The consumer takes the frames in the order that they were published. If it
+// falls behind, the producer waits for it.
+
+#ifdef _WIN32
+typedef HANDLE NativeHandle;
+#elif __linux__
+typedef int NativeHandle;
+#endif
+
+// The most images that a ring can have.
+const uint32_t kMaxExportedFrames = 8;
+// The memory, the metadata, and the semaphore and the fence of every image.
+const uint32_t kMaxExportedHandles = 2 + 2 * kMaxExportedFrames;
+
+#ifdef _WIN32
+const VkExternalMemoryHandleTypeFlagBits kExternalMemoryHandleType =
+    VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+const VkExternalSemaphoreHandleTypeFlagBits kExternalSemaphoreHandleType =
+    VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+const VkExternalFenceHandleTypeFlagBits kExternalFenceHandleType =
+    VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+#elif __linux__
+const VkExternalMemoryHandleTypeFlagBits kExternalMemoryHandleType =
+    VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+const VkExternalSemaphoreHandleTypeFlagBits kExternalSemaphoreHandleType =
+    VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+const VkExternalFenceHandleTypeFlagBits kExternalFenceHandleType =
+    VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_FD_BIT;
+#endif
+
+// The metadata of one published frame.
+struct ExportedFrameInfo {
+  // The frames are numbered from 1 in the order that they were published.
+  uint64_t sequence;
+  // When the frame was submitted, in nanoseconds of steady_clock.
+  int64_t submit_ns;
+};
+
+// The shared memory. Everything but |published| and |frames| is written once,
+// before the handles are sent.
+struct ExportedFrameRing {
+  uint32_t num_frames;
+  uint32_t width;
+  uint32_t height;
+  // The VkFormat and the VkImageUsageFlags that the images were created
+  // with, the consumer has to create its images with the same ones.
+  uint32_t format;
+  uint32_t usage;
+  // The offset between two images in the exported memory, and the size of
+  // all of it.
+  uint64_t image_stride;
+  uint64_t memory_size;
+  // The number of frames that were published. Frame |sequence| is in image
+  // (sequence - 1) % num_frames.
+  std::atomic<uint64_t> published;
+  ExportedFrameInfo frames[kMaxExportedFrames];
+};
+
+inline int64_t SteadyClockNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Creates the images of the ring, releasing them to the consumer happens in
+// the command buffers that render to them. Only 2D images with one mip
+// level and one layer can be exported.
+class FrameExporter {
+ public:
+  FrameExporter(vulkan::VkDevice& device, logging::Logger* log,
+                containers::Allocator* allocator, uint32_t num_frames,
+                const VkImageCreateInfo* create_info)
+      : device_(device),
+        log_(log),
+        device_memory_(VK_NULL_HANDLE, nullptr, &device),
+        images_(allocator),
+        ready_semaphores_(allocator),
+        free_fences_(allocator),
+        ring_(nullptr),
+        published_(0) {
+    LOG_ASSERT(<=, log_, num_frames, kMaxExportedFrames);
+    LOG_ASSERT(==, log_, create_info->imageType, VK_IMAGE_TYPE_2D);
+    LOG_ASSERT(==, log_, create_info->mipLevels, 1u);
+    LOG_ASSERT(==, log_, create_info->arrayLayers, 1u);
+
+    VkExternalMemoryImageCreateInfo external_create_info{
+        VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,  // sType
+        nullptr,                                              // pNext
+        static_cast<VkExternalMemoryHandleTypeFlags>(
+            kExternalMemoryHandleType)  // handleTypes
+    };
+    VkImageCreateInfo image_create_info = *create_info;
+    image_create_info.pNext = &external_create_info;
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      ::VkImage image;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkCreateImage(device_, &image_create_info, nullptr,
+                                        &image));
+      images_.push_back(containers::make_unique<vulkan::VkImage>(
+          allocator, image, nullptr, &device_));
+    }
+
+    VkMemoryRequirements requirements;
+    device_->vkGetImageMemoryRequirements(device_, *images_[0],
+                                          &requirements);
+    const size_t image_stride =
+        vulkan::RoundUp(requirements.size, requirements.alignment);
+    uint32_t memory_index =
+        vulkan::GetMemoryIndex(&device, log, requirements.memoryTypeBits,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkExportMemoryAllocateInfo export_allocate_info{
+        VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,  // sType
+        nullptr,                                        // pNext
+        static_cast<VkExternalMemoryHandleTypeFlags>(
+            kExternalMemoryHandleType)  // handleTypes
+    };
+    VkMemoryAllocateInfo allocate_info{
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
+        &export_allocate_info,                   // pNext
+        image_stride * num_frames,               // allocationSize
+        memory_index                             // memoryTypeIndex
+    };
+    ::VkDeviceMemory device_memory;
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_->vkAllocateMemory(device_, &allocate_info, nullptr,
+                                         &device_memory));
+    device_memory_.initialize(device_memory);
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      device_->vkBindImageMemory(device_, *images_[i], device_memory,
+                                 image_stride * i);
+    }
+
+    VkExportSemaphoreCreateInfo semaphore_export_info{
+        VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,  // sType
+        nullptr,                                         // pNext
+        static_cast<VkExternalSemaphoreHandleTypeFlags>(
+            kExternalSemaphoreHandleType)  // handleTypes
+    };
+    VkSemaphoreCreateInfo semaphore_create_info{
+        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,  // sType
+        &semaphore_export_info,                   // pNext
+        0                                         // flags
+    };
+    VkExportFenceCreateInfo fence_export_info{
+        VK_STRUCTURE_TYPE_EXPORT_FENCE_CREATE_INFO,  // sType
+        nullptr,                                     // pNext
+        static_cast<VkExternalFenceHandleTypeFlags>(
+            kExternalFenceHandleType)  // handleTypes
+    };
+    // Every image is free until it is rendered to for the first time.
+    VkFenceCreateInfo fence_create_info{
+        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,  // sType
+        &fence_export_info,                   // pNext
+        VK_FENCE_CREATE_SIGNALED_BIT          // flags
+    };
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      ::VkSemaphore semaphore;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkCreateSemaphore(device_, &semaphore_create_info,
+                                            nullptr, &semaphore));
+      ready_semaphores_.push_back(containers::make_unique<vulkan::VkSemaphore>(
+          allocator, semaphore, nullptr, &device_));
+      ::VkFence fence;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkCreateFence(device_, &fence_create_info, nullptr,
+                                        &fence));
+      free_fences_.push_back(containers::make_unique<vulkan::VkFence>(
+          allocator, fence, nullptr, &device_));
+    }
+
+#ifdef _WIN32
+    ring_handle_ =
+        CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                          sizeof(ExportedFrameRing), NULL);
+    LOG_ASSERT(!=, log_, static_cast<HANDLE>(NULL), ring_handle_);
+    void* ring_memory = MapViewOfFile(ring_handle_, FILE_MAP_ALL_ACCESS, 0, 0,
+                                      sizeof(ExportedFrameRing));
+    LOG_ASSERT(!=, log_, static_cast<void*>(NULL), ring_memory);
+#elif __linux__
+    ring_handle_ =
+        static_cast<int>(syscall(SYS_memfd_create, "exported_frames", 0));
+    LOG_ASSERT(!=, log_, -1, ring_handle_);
+    LOG_ASSERT(==, log_, 0,
+               ftruncate(ring_handle_, sizeof(ExportedFrameRing)));
+    void* ring_memory =
+        mmap(nullptr, sizeof(ExportedFrameRing), PROT_READ | PROT_WRITE,
+             MAP_SHARED, ring_handle_, 0);
+    LOG_ASSERT(!=, log_, MAP_FAILED, ring_memory);
+#endif
+    ring_ = new (ring_memory) ExportedFrameRing();
+    ring_->num_frames = num_frames;
+    ring_->width = create_info->extent.width;
+    ring_->height = create_info->extent.height;
+    ring_->format = static_cast<uint32_t>(create_info->format);
+    ring_->usage = static_cast<uint32_t>(create_info->usage);
+    ring_->image_stride = image_stride;
+    ring_->memory_size = image_stride * num_frames;
+    ring_->published.store(0);
+  }
+
+  ~FrameExporter() {
+#ifdef _WIN32
+    UnmapViewOfFile(ring_);
+    CloseHandle(ring_handle_);
+#elif __linux__
+    munmap(ring_, sizeof(ExportedFrameRing));
+    close(ring_handle_);
+#endif
+  }
+
+  // Sends the handles of the ring to the consumer, waiting until it
+  // connects.
+  void SendHandles() {
+    NativeHandle handles[kMaxExportedHandles];
+    const uint32_t num_frames = ring_->num_frames;
+    const uint32_t num_handles = 2 + 2 * num_frames;
+#ifdef _WIN32
+    VkMemoryGetWin32HandleInfoKHR memory_info{
+        VK_STRUCTURE_TYPE_MEMORY_GET_WIN32_HANDLE_INFO_KHR,  // sType
+        nullptr,                                             // pNext
+        device_memory_,                                      // memory
+        kExternalMemoryHandleType                            // handleType
+    };
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_->vkGetMemoryWin32HandleKHR(device_, &memory_info,
+                                                  &handles[0]));
+    handles[1] = ring_handle_;
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      VkSemaphoreGetWin32HandleInfoKHR semaphore_info{
+          VK_STRUCTURE_TYPE_SEMAPHORE_GET_WIN32_HANDLE_INFO_KHR,  // sType
+          nullptr,                                                // pNext
+          *ready_semaphores_[i],                                  // semaphore
+          kExternalSemaphoreHandleType                            // handleType
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkGetSemaphoreWin32HandleKHR(
+                     device_, &semaphore_info, &handles[2 + 2 * i]));
+      VkFenceGetWin32HandleInfoKHR fence_info{
+          VK_STRUCTURE_TYPE_FENCE_GET_WIN32_HANDLE_INFO_KHR,  // sType
+          nullptr,                                            // pNext
+          *free_fences_[i],                                   // fence
+          kExternalFenceHandleType                            // handleType
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkGetFenceWin32HandleKHR(device_, &fence_info,
+                                                   &handles[3 + 2 * i]));
+    }
+
+    HANDLE pipe_handle = CreateNamedPipe(
+        TEXT("\\\\.\\pipe\\LOCAL\\vulkan_external_image_frames"),
+        PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, 1,
+        1024 * 16, 1024 * 16, NMPWAIT_USE_DEFAULT_WAIT, NULL);
+    if (ConnectNamedPipe(pipe_handle, NULL) != FALSE) {
+      ULONG pid;
+      GetNamedPipeClientProcessId(pipe_handle, &pid);
+      HANDLE client_process = OpenProcess(PROCESS_DUP_HANDLE, FALSE, pid);
+      HANDLE current_process = GetCurrentProcess();
+      // The number of handles, followed by the handles in the consumer.
+      HANDLE message[1 + kMaxExportedHandles];
+      message[0] =
+          reinterpret_cast<HANDLE>(static_cast<uintptr_t>(num_handles));
+      for (uint32_t i = 0; i < num_handles; ++i) {
+        // The shared memory stays open here, the rest only had to get to
+        // the consumer.
+        const DWORD options =
+            i == 1 ? DUPLICATE_SAME_ACCESS
+                   : DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE;
+        DuplicateHandle(current_process, handles[i], client_process,
+                        &message[1 + i], 0, FALSE, options);
+      }
+      DWORD bytes_written;
+      WriteFile(pipe_handle, message, sizeof(HANDLE) * (1 + num_handles),
+                &bytes_written, NULL);
+      FlushFileBuffers(pipe_handle);
+      CloseHandle(current_process);
+      CloseHandle(client_process);
+    }
+    DisconnectNamedPipe(pipe_handle);
+    CloseHandle(pipe_handle);
+#elif __linux__
+    VkMemoryGetFdInfoKHR memory_info{
+        VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,  // sType
+        nullptr,                                   // pNext
+        device_memory_,                            // memory
+        kExternalMemoryHandleType                  // handleType
+    };
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_->vkGetMemoryFdKHR(device_, &memory_info, &handles[0]));
+    handles[1] = ring_handle_;
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      VkSemaphoreGetFdInfoKHR semaphore_info{
+          VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,  // sType
+          nullptr,                                      // pNext
+          *ready_semaphores_[i],                        // semaphore
+          kExternalSemaphoreHandleType                  // handleType
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkGetSemaphoreFdKHR(device_, &semaphore_info,
+                                              &handles[2 + 2 * i]));
+      VkFenceGetFdInfoKHR fence_info{
+          VK_STRUCTURE_TYPE_FENCE_GET_FD_INFO_KHR,  // sType
+          nullptr,                                  // pNext
+          *free_fences_[i],                         // fence
+          kExternalFenceHandleType                  // handleType
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkGetFenceFdKHR(device_, &fence_info,
+                                          &handles[3 + 2 * i]));
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(&addr.sun_path[1], "vulkan_external_image_frames");
+    bind(sock, (struct sockaddr*)&addr, sizeof(addr));
+    listen(sock, 1);
+    int conn = accept(sock, NULL, 0);
+
+    // The number of handles is the data, the handles are passed as rights.
+    struct msghdr msg;
+    struct iovec iov[1];
+    char ctrl_buf[CMSG_SPACE(sizeof(int) * kMaxExportedHandles)];
+    memset(&msg, 0, sizeof(msg));
+    memset(ctrl_buf, 0, sizeof(ctrl_buf));
+    uint32_t sent_num_handles = num_handles;
+    iov[0].iov_base = &sent_num_handles;
+    iov[0].iov_len = sizeof(sent_num_handles);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl_buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * num_handles);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_handles);
+    memcpy(CMSG_DATA(cmsg), handles, sizeof(int) * num_handles);
+    sendmsg(conn, &msg, 0);
+    close(conn);
+    close(sock);
+
+    // The shared memory stays open here, the rest only had to get to the
+    // consumer.
+    for (uint32_t i = 0; i < num_handles; ++i) {
+      if (i != 1) {
+        close(handles[i]);
+      }
+    }
+#endif
+  }
+
+  // Waits until the consumer is done with the image that the next frame is
+  // rendered to, and returns it.
+  uint32_t AcquireFrame() {
+    const uint32_t index = static_cast<uint32_t>(published_ % num_frames());
+    ::VkFence fence = *free_fences_[index];
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_->vkWaitForFences(device_, 1, &fence, VK_TRUE,
+                                        UINT64_MAX));
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_->vkResetFences(device_, 1, &fence));
+    return index;
+  }
+
+  // Submits |command_buffer|, which renders to the image that the last
+  // AcquireFrame() returned and releases it to VK_QUEUE_FAMILY_EXTERNAL,
+  // and publishes the frame.
+  void SubmitFrame(vulkan::VkQueue* queue, ::VkCommandBuffer command_buffer) {
+    const uint32_t index = static_cast<uint32_t>(published_ % num_frames());
+    ::VkSemaphore semaphore = *ready_semaphores_[index];
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &command_buffer,                // pCommandBuffers
+        1,                              // signalSemaphoreCount
+        &semaphore                      // pSignalSemaphores
+    };
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               (*queue)->vkQueueSubmit(*queue, 1, &submit_info,
+                                       static_cast<::VkFence>(VK_NULL_HANDLE)));
+    // The consumer may only wait on the semaphore once its signal was
+    // submitted.
+    ExportedFrameInfo& info = ring_->frames[index];
+    info.sequence = ++published_;
+    info.submit_ns = SteadyClockNanoseconds();
+    ring_->published.store(published_, std::memory_order_release);
+  }
+
+  ::VkImage image(uint32_t index) const { return *images_[index]; }
+  uint32_t num_frames() const { return ring_->num_frames; }
+
+ private:
+  vulkan::VkDevice& device_;
+  logging::Logger* log_;
+  vulkan::VkDeviceMemory device_memory_;
+  containers::vector<containers::unique_ptr<vulkan::VkImage>> images_;
+  containers::vector<containers::unique_ptr<vulkan::VkSemaphore>>
+      ready_semaphores_;
+  containers::vector<containers::unique_ptr<vulkan::VkFence>> free_fences_;
+  NativeHandle ring_handle_;
+  ExportedFrameRing* ring_;
+  uint64_t published_;
+};
+
+// Receives the ring of a FrameExporter, and creates the images, semaphores
+// and fences of the consumer from it.
+class FrameImporter {
+ public:
+  // Waits until the producer sends the handles of its ring.
+  FrameImporter(vulkan::VkDevice& device, logging::Logger* log,
+                containers::Allocator* allocator)
+      : device_(device),
+        log_(log),
+        device_memory_(VK_NULL_HANDLE, nullptr, &device),
+        images_(allocator),
+        ready_semaphores_(allocator),
+        free_fences_(allocator),
+        ring_(nullptr),
+        consumed_(0) {
+    NativeHandle handles[kMaxExportedHandles];
+    const uint32_t num_handles = ReceiveHandles(handles);
+    LOG_ASSERT(>=, log_, num_handles, 4u);
+
+#ifdef _WIN32
+    void* ring_memory = MapViewOfFile(handles[1], FILE_MAP_ALL_ACCESS, 0, 0,
+                                      sizeof(ExportedFrameRing));
+    LOG_ASSERT(!=, log_, static_cast<void*>(NULL), ring_memory);
+    CloseHandle(handles[1]);
+#elif __linux__
+    void* ring_memory =
+        mmap(nullptr, sizeof(ExportedFrameRing), PROT_READ | PROT_WRITE,
+             MAP_SHARED, handles[1], 0);
+    LOG_ASSERT(!=, log_, MAP_FAILED, ring_memory);
+    close(handles[1]);
+#endif
+    ring_ = static_cast<ExportedFrameRing*>(ring_memory);
+    const uint32_t num_frames = ring_->num_frames;
+    LOG_ASSERT(==, log_, num_handles, 2 + 2 * num_frames);
+
+    VkExternalMemoryImageCreateInfo external_create_info{
+        VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,  // sType
+        nullptr,                                              // pNext
+        static_cast<VkExternalMemoryHandleTypeFlags>(
+            kExternalMemoryHandleType)  // handleTypes
+    };
+    // Opaque memory can only be bound to images that were created like the
+    // ones of the producer.
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        &external_create_info,                // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        format(),                             // format
+        {
+            ring_->width,   // width
+            ring_->height,  // height
+            1,              // depth
+        },                  // extent
+        1,                  // mipLevels
+        1,                  // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                         // samples
+        VK_IMAGE_TILING_OPTIMAL,                       // tiling
+        static_cast<VkImageUsageFlags>(ring_->usage),  // usage
+        VK_SHARING_MODE_EXCLUSIVE,                     // sharingMode
+        0,                                             // queueFamilyIndexCount
+        nullptr,                                       // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,                     // initialLayout
+    };
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      ::VkImage image;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkCreateImage(device_, &image_create_info, nullptr,
+                                        &image));
+      images_.push_back(containers::make_unique<vulkan::VkImage>(
+          allocator, image, nullptr, &device_));
+    }
+
+    VkMemoryRequirements requirements;
+    device_->vkGetImageMemoryRequirements(device_, *images_[0],
+                                          &requirements);
+    uint32_t memory_index =
+        vulkan::GetMemoryIndex(&device, log, requirements.memoryTypeBits,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+#ifdef _WIN32
+    VkImportMemoryWin32HandleInfoKHR import_allocate_info{
+        VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR,  // sType
+        nullptr,                                                // pNext
+        kExternalMemoryHandleType,                              // handleType
+        handles[0],                                             // handle
+        nullptr                                                 // name
+    };
+#elif __linux__
+    VkImportMemoryFdInfoKHR import_allocate_info{
+        VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,  // sType
+        nullptr,                                      // pNext
+        kExternalMemoryHandleType,                    // handleType
+        handles[0]                                    // fd
+    };
+#endif
+    VkMemoryAllocateInfo allocate_info{
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
+        &import_allocate_info,                   // pNext
+        ring_->memory_size,                      // allocationSize
+        memory_index                             // memoryTypeIndex
+    };
+    ::VkDeviceMemory device_memory;
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_->vkAllocateMemory(device_, &allocate_info, nullptr,
+                                         &device_memory));
+    device_memory_.initialize(device_memory);
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      device_->vkBindImageMemory(device_, *images_[i], device_memory,
+                                 ring_->image_stride * i);
+    }
+
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      ready_semaphores_.push_back(containers::make_unique<vulkan::VkSemaphore>(
+          allocator, vulkan::CreateSemaphore(&device_)));
+      free_fences_.push_back(containers::make_unique<vulkan::VkFence>(
+          allocator, vulkan::CreateFence(&device_)));
+#ifdef _WIN32
+      VkImportSemaphoreWin32HandleInfoKHR semaphore_import_info{
+          VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_WIN32_HANDLE_INFO_KHR,  // sType
+          nullptr,                                                   // pNext
+          *ready_semaphores_[i],         // semaphore
+          0,                             // flags
+          kExternalSemaphoreHandleType,  // handleType
+          handles[2 + 2 * i],            // handle
+          nullptr                        // name
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkImportSemaphoreWin32HandleKHR(
+                     device_, &semaphore_import_info));
+      VkImportFenceWin32HandleInfoKHR fence_import_info{
+          VK_STRUCTURE_TYPE_IMPORT_FENCE_WIN32_HANDLE_INFO_KHR,  // sType
+          nullptr,                                               // pNext
+          *free_fences_[i],          // fence
+          0,                         // flags
+          kExternalFenceHandleType,  // handleType
+          handles[3 + 2 * i],        // handle
+          nullptr                    // name
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkImportFenceWin32HandleKHR(device_,
+                                                      &fence_import_info));
+#elif __linux__
+      // Importing from a file descriptor takes it over.
+      VkImportSemaphoreFdInfoKHR semaphore_import_info{
+          VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,  // sType
+          nullptr,                                         // pNext
+          *ready_semaphores_[i],                           // semaphore
+          0,                                               // flags
+          kExternalSemaphoreHandleType,                    // handleType
+          handles[2 + 2 * i]                               // fd
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkImportSemaphoreFdKHR(device_,
+                                                 &semaphore_import_info));
+      VkImportFenceFdInfoKHR fence_import_info{
+          VK_STRUCTURE_TYPE_IMPORT_FENCE_FD_INFO_KHR,  // sType
+          nullptr,                                     // pNext
+          *free_fences_[i],                            // fence
+          0,                                           // flags
+          kExternalFenceHandleType,                    // handleType
+          handles[3 + 2 * i]                           // fd
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkImportFenceFdKHR(device_, &fence_import_info));
+#endif
+    }
+#ifdef _WIN32
+    // Importing from a handle does not take it over.
+    CloseHandle(handles[0]);
+    for (uint32_t i = 2; i < num_handles; ++i) {
+      CloseHandle(handles[i]);
+    }
+#endif
+  }
+
+  ~FrameImporter() {
+#ifdef _WIN32
+    UnmapViewOfFile(ring_);
+#elif __linux__
+    munmap(ring_, sizeof(ExportedFrameRing));
+#endif
+  }
+
+  // Waits until the next frame is published, and returns its image, which
+  // the consumer acquires from VK_QUEUE_FAMILY_EXTERNAL in the command
+  // buffer that it passes to SubmitFrame().
+  uint32_t AcquireFrame() {
+    while (ring_->published.load(std::memory_order_acquire) <= consumed_) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return static_cast<uint32_t>(consumed_ % num_frames());
+  }
+
+  // Submits |command_buffer|, which reads the image that the last
+  // AcquireFrame() returned from |wait_stage| on, and gives the image back
+  // to the producer once it is done.
+  void SubmitFrame(vulkan::VkQueue* queue, ::VkCommandBuffer command_buffer,
+                   VkPipelineStageFlags wait_stage) {
+    const uint32_t index = static_cast<uint32_t>(consumed_ % num_frames());
+    ::VkSemaphore semaphore = *ready_semaphores_[index];
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        1,                              // waitSemaphoreCount
+        &semaphore,                     // pWaitSemaphores
+        &wait_stage,                    // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &command_buffer,                // pCommandBuffers
+        0,                              // signalSemaphoreCount
+        nullptr                         // pSignalSemaphores
+    };
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               (*queue)->vkQueueSubmit(*queue, 1, &submit_info,
+                                       *free_fences_[index]));
+    ++consumed_;
+  }
+
+  // The metadata of the frame in image |index|.
+  const ExportedFrameInfo& frame_info(uint32_t index) const {
+    return ring_->frames[index];
+  }
+  ::VkImage image(uint32_t index) const { return *images_[index]; }
+  uint32_t num_frames() const { return ring_->num_frames; }
+  VkFormat format() const { return static_cast<VkFormat>(ring_->format); }
+  uint32_t width() const { return ring_->width; }
+  uint32_t height() const { return ring_->height; }
+
+ private:
+  // Fills |handles| with the handles from the producer, and returns how
+  // many there are.
+  uint32_t ReceiveHandles(NativeHandle* handles) {
+#ifdef _WIN32
+    HANDLE pipe_handle;
+    do {
+      pipe_handle = CreateFile(
+          TEXT("\\\\.\\pipe\\LOCAL\\vulkan_external_image_frames"),
+          GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+      if (pipe_handle == INVALID_HANDLE_VALUE) Sleep(1000);
+    } while (pipe_handle == INVALID_HANDLE_VALUE);
+    HANDLE message[1 + kMaxExportedHandles];
+    DWORD bytes_read;
+    ReadFile(pipe_handle, message, sizeof(message), &bytes_read, NULL);
+    CloseHandle(pipe_handle);
+    const uint32_t num_handles =
+        static_cast<uint32_t>(reinterpret_cast<uintptr_t>(message[0]));
+    LOG_ASSERT(<=, log_, num_handles, kMaxExportedHandles);
+    memcpy(handles, message + 1, sizeof(HANDLE) * num_handles);
+    return num_handles;
+#elif __linux__
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(&addr.sun_path[1], "vulkan_external_image_frames");
+    while (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+      sleep(1);
+    }
+
+    struct msghdr msg;
+    struct iovec iov[1];
+    char ctrl_buf[CMSG_SPACE(sizeof(int) * kMaxExportedHandles)];
+    memset(&msg, 0, sizeof(msg));
+    memset(ctrl_buf, 0, sizeof(ctrl_buf));
+    uint32_t num_handles = 0;
+    iov[0].iov_base = &num_handles;
+    iov[0].iov_len = sizeof(num_handles);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl_buf;
+    msg.msg_controllen = sizeof(ctrl_buf);
+    LOG_ASSERT(==, log_, static_cast<ssize_t>(sizeof(num_handles)),
+               recvmsg(sock, &msg, 0));
+    close(sock);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    LOG_ASSERT(!=, log_, static_cast<struct cmsghdr*>(NULL), cmsg);
+    LOG_ASSERT(<=, log_, num_handles, kMaxExportedHandles);
+    LOG_ASSERT(==, log_, cmsg->cmsg_len, CMSG_LEN(sizeof(int) * num_handles));
+    memcpy(handles, CMSG_DATA(cmsg), sizeof(int) * num_handles);
+    return num_handles;
+#endif
+  }
+
+  vulkan::VkDevice& device_;
+  logging::Logger* log_;
+  vulkan::VkDeviceMemory device_memory_;
+  containers::vector<containers::unique_ptr<vulkan::VkImage>> images_;
+  containers::vector<containers::unique_ptr<vulkan::VkSemaphore>>
+      ready_semaphores_;
+  containers::vector<containers::unique_ptr<vulkan::VkFence>> free_fences_;
+  ExportedFrameRing* ring_;
+  // The number of frames that were submitted with SubmitFrame().
+  uint64_t consumed_;
+};
+
+#endif  // EXTERNAL_IMAGE_FRAME_EXPORTER_H_
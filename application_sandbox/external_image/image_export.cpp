@@ -13,18 +13,14 @@
 // limitations under the License.
 
 #include "application_sandbox/sample_application_framework/sample_application.h"
+#include "frame_exporter.h"
 #include "mathfu/matrix.h"
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
-#ifdef __linux__
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <sys/un.h>
-#include <unistd.h>
-#endif
+#include <algorithm>
 
 using Mat44 = mathfu::Matrix<float, 4, 4>;
 
@@ -49,106 +45,7 @@ uint32_t cube_fragment_shader[] =
 #include "cube.frag.spv"
     ;
 
-class VkImagesExported {
- public:
-  VkImagesExported(vulkan::VkDevice& device, logging::Logger* log,
-                   containers::Allocator* allocator, size_t num_images,
-                   const VkImageCreateInfo* create_info)
-      : device_(device),
-        log_(log),
-        device_memory_(VK_NULL_HANDLE, nullptr, &device),
-        images_(allocator) {
-    images_.resize(num_images);
-
-    for (int i = 0; i < num_images; i++) {
-      ::VkImage image;
-      LOG_ASSERT(==, log_,
-                 device_->vkCreateImage(device_, create_info, nullptr, &image),
-                 VK_SUCCESS);
-      images_[i] = containers::make_unique<vulkan::VkImage>(allocator, image,
-                                                            nullptr, &device_);
-    }
-
-    ::VkImage image = *images_[0];
-
-    VkMemoryRequirements requirements;
-    device_->vkGetImageMemoryRequirements(device_, image, &requirements);
-
-    aligned_data_size_ =
-        vulkan::RoundUp(requirements.size, requirements.alignment);
-
-    uint32_t memory_index =
-        vulkan::GetMemoryIndex(&device, log, requirements.memoryTypeBits,
-                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    VkExportMemoryAllocateInfo export_allocate_info{
-        VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO, nullptr,
-#ifdef _WIN32
-        VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT
-#elif __linux__
-        VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT
-#endif
-    };
-
-    VkMemoryAllocateInfo allocate_info{
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
-        &export_allocate_info,                   // pNext
-        aligned_data_size_ * num_images,         // allocationSize
-        memory_index};
-
-    VkDeviceMemory device_memory;
-
-    LOG_ASSERT(==, log, VK_SUCCESS,
-               device->vkAllocateMemory(device, &allocate_info, nullptr,
-                                        &device_memory));
-    device_memory_.initialize(device_memory);
-
-    for (int i = 0; i < num_images; i++) {
-      device_->vkBindImageMemory(device_, *images_[i], device_memory,
-                                 aligned_data_size_ * i);
-    }
-  }
-
-  ::VkImage get_image(size_t i) const { return *images_[i]; }
-
-  size_t size() const { return aligned_data_size_; }
-
-#ifdef _WIN32
-  HANDLE getMemoryWin32Handle(void) {
-    HANDLE handle;
-    VkMemoryGetWin32HandleInfoKHR get_handle_info{
-        VK_STRUCTURE_TYPE_MEMORY_GET_WIN32_HANDLE_INFO_KHR,  // sType
-        nullptr,                                             // pNext
-        device_memory_, VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT};
-    LOG_ASSERT(
-        ==, log_, VK_SUCCESS,
-        device_->vkGetMemoryWin32HandleKHR(device_, &get_handle_info, &handle));
-    return handle;
-  }
-#elif __linux__
-  int getMemoryFd(void) {
-    int file_descriptor;
-    VkMemoryGetFdInfoKHR get_fd_info{
-        VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR, nullptr, device_memory_,
-        VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT};
-    LOG_ASSERT(
-        ==, log_, VK_SUCCESS,
-        device_->vkGetMemoryFdKHR(device_, &get_fd_info, &file_descriptor));
-    return file_descriptor;
-  }
-#endif
-
- private:
-  vulkan::VkDevice& device_;
-  logging::Logger* log_;
-  vulkan::VkDeviceMemory device_memory_;
-  containers::vector<containers::unique_ptr<vulkan::VkImage>> images_;
-  size_t aligned_data_size_;
-};
-
 struct FrameData {
-  containers::unique_ptr<vulkan::VkFence> free_fence;
-  containers::unique_ptr<vulkan::VkFence> ready_fence;
   containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
   containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
   containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
@@ -162,21 +59,27 @@ int main_entry(const entry::EntryData* data) {
   vulkan::VulkanApplication app(
       data->allocator(), data->logger(), data,
       {VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,
+       VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME,
        VK_KHR_EXTERNAL_FENCE_CAPABILITIES_EXTENSION_NAME},
       {VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+       VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
        VK_KHR_EXTERNAL_FENCE_EXTENSION_NAME,
 #ifdef _WIN32
        VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME,
+       VK_KHR_EXTERNAL_SEMAPHORE_WIN32_EXTENSION_NAME,
        VK_KHR_EXTERNAL_FENCE_WIN32_EXTENSION_NAME
 #elif __linux__
        VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+       VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
        VK_KHR_EXTERNAL_FENCE_FD_EXTENSION_NAME
 #endif
       });
 
   vulkan::VkDevice& device = app.device();
 
-  size_t num_swapchain_images = app.swapchain_images().size();
+  // The number of frames that the consumer can hold on to.
+  const uint32_t num_frames = std::min(
+      static_cast<uint32_t>(app.swapchain_images().size()), kMaxExportedFrames);
 
   vulkan::VkCommandBuffer initialization_command_buffer =
       app.GetCommandBuffer();
@@ -288,12 +191,12 @@ int main_entry(const entry::EntryData* data) {
 
   containers::unique_ptr<vulkan::BufferFrameData<camera_data_>> camera_data =
       containers::make_unique<vulkan::BufferFrameData<camera_data_>>(
-          data->allocator(), &app, num_swapchain_images,
+          data->allocator(), &app, num_frames,
           VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 
   containers::unique_ptr<vulkan::BufferFrameData<model_data_>> model_data =
       containers::make_unique<vulkan::BufferFrameData<model_data_>>(
-          data->allocator(), &app, num_swapchain_images,
+          data->allocator(), &app, num_frames,
           VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 
   camera_data->data().projection_matrix =
@@ -332,47 +235,20 @@ int main_entry(const entry::EntryData* data) {
       VK_IMAGE_LAYOUT_UNDEFINED,
   };
 
-  VkImagesExported render_images(app.device(), app.GetLogger(),
-                                 data->allocator(), num_swapchain_images,
-                                 &render_img_create_info);
+  FrameExporter exporter(app.device(), app.GetLogger(), data->allocator(),
+                         num_frames, &render_img_create_info);
 
   containers::vector<FrameData> frame_data(data->allocator());
-  frame_data.resize(num_swapchain_images);
+  frame_data.resize(num_frames);
 
-  for (int i = 0; i < num_swapchain_images; i++) {
+  for (uint32_t i = 0; i < num_frames; i++) {
     FrameData& frame_data_i = frame_data[i];
 
-    VkFence fence;
-    VkExportFenceCreateInfo fence_export_info{
-        VK_STRUCTURE_TYPE_EXPORT_FENCE_CREATE_INFO, nullptr,
-#ifdef _WIN32
-        VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_WIN32_BIT
-#elif __linux__
-        VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_FD_BIT
-#endif
-    };
-    VkFenceCreateInfo fence_create_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-                                        &fence_export_info,
-                                        VK_FENCE_CREATE_SIGNALED_BIT};
-
-    LOG_ASSERT(
-        ==, log, VK_SUCCESS,
-        device->vkCreateFence(device, &fence_create_info, nullptr, &fence));
-    frame_data_i.free_fence = containers::make_unique<vulkan::VkFence>(
-        data->allocator(), fence, nullptr, &device);
-
-    fence_create_info.flags = 0;
-    LOG_ASSERT(
-        ==, log, VK_SUCCESS,
-        device->vkCreateFence(device, &fence_create_info, nullptr, &fence));
-    frame_data_i.ready_fence = containers::make_unique<vulkan::VkFence>(
-        data->allocator(), fence, nullptr, &device);
-
     VkImageViewCreateInfo render_img_view_create_info{
         VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
         nullptr,                                   // pNext
         0,                                         // flags
-        render_images.get_image(i),                // image
+        exporter.image(i),                // image
         VK_IMAGE_VIEW_TYPE_2D,                     // viewType
         render_target_format,                      // format
         {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
@@ -463,7 +339,7 @@ int main_entry(const entry::EntryData* data) {
         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // newLayout
         VK_QUEUE_FAMILY_IGNORED,                   // srcQueueFamilyIndex
         VK_QUEUE_FAMILY_IGNORED,                   // dstQueueFamilyIndex
-        render_images.get_image(i),                // image
+        exporter.image(i),                // image
         {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
     VkImageMemoryBarrier attach_to_shader{
@@ -475,7 +351,7 @@ int main_entry(const entry::EntryData* data) {
         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // newLayout
         app.render_queue().index(),                // srcQueueFamilyIndex
         VK_QUEUE_FAMILY_EXTERNAL,                  // dstQueueFamilyIndex
-        render_images.get_image(i),                // image
+        exporter.image(i),                // image
         {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
     // Change the layout of render image to COLOR_ATTACHMENT_OPTIMAL
@@ -519,162 +395,24 @@ int main_entry(const entry::EntryData* data) {
         ->vkEndCommandBuffer(*frame_data_i.command_buffer_);
   }
 
-  VkSubmitInfo submit_info{
-      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-      nullptr,                        // pNext
-      0,                              // waitSemaphoreCount
-      nullptr,                        // pWaitSemaphores
-      nullptr,                        // pWaitDstStageMask,
-      1,                              // commandBufferCount
-      nullptr,                        //
-      0,                              // signalSemaphoreCount
-      nullptr                         // pSignalSemaphores
-  };
-
-#ifdef _WIN32
-  HANDLE pipe_handle;
-
-  HANDLE render_images_handle = render_images.getMemoryWin32Handle();
-
-  pipe_handle = CreateNamedPipe(
-      TEXT("\\\\.\\pipe\\LOCAL\\vulkan_external_buffer_example"),
-      PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, 1,
-      1024 * 16, 1024 * 16, NMPWAIT_USE_DEFAULT_WAIT, NULL);
-  if (ConnectNamedPipe(pipe_handle, NULL) != FALSE) {
-    ULONG pid;
-    GetNamedPipeClientProcessId(pipe_handle, &pid);
-
-    HANDLE client_process = OpenProcess(PROCESS_DUP_HANDLE, FALSE, pid);
-    HANDLE current_process = GetCurrentProcess();
-    containers::vector<HANDLE> client_data_handles(data->allocator());
-    client_data_handles.resize(1 + num_swapchain_images * 2);
-
-    DuplicateHandle(current_process, render_images_handle, client_process,
-                    &client_data_handles[0], 0, FALSE,
-                    DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE);
-
-    for (int i = 0; i < num_swapchain_images; i++) {
-      FrameData& frame_data_i = frame_data[i];
-      VkFenceGetWin32HandleInfoKHR export_info{
-          VK_STRUCTURE_TYPE_FENCE_GET_WIN32_HANDLE_INFO_KHR, nullptr,
-          frame_data_i.free_fence->get_raw_object(),
-          VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_WIN32_BIT};
-      HANDLE fence_handle;
-
-      device->vkGetFenceWin32HandleKHR(device, &export_info, &fence_handle);
-
-      DuplicateHandle(current_process, fence_handle, client_process,
-                      &client_data_handles[1 + i * 2], 0, FALSE,
-                      DUPLICATE_SAME_ACCESS);
-
-      export_info.fence = frame_data_i.ready_fence->get_raw_object();
-      device->vkGetFenceWin32HandleKHR(device, &export_info, &fence_handle);
-      DuplicateHandle(current_process, fence_handle, client_process,
-                      &client_data_handles[2 + i * 2], 0, FALSE,
-                      DUPLICATE_SAME_ACCESS);
-    }
-
-    DWORD bytes_writen;
-    WriteFile(pipe_handle, client_data_handles.data(),
-              sizeof(HANDLE) * client_data_handles.size(), &bytes_writen, NULL);
-    FlushFileBuffers(pipe_handle);
-
-    CloseHandle(current_process);
-    CloseHandle(client_process);
-  }
-  DisconnectNamedPipe(pipe_handle);
-#elif __linux__
-  containers::vector<int> file_descriptors(data->allocator());
-  file_descriptors.resize(1 + num_swapchain_images * 2);
-
-  file_descriptors[0] = render_images.getMemoryFd();
-  for (int i = 0; i < num_swapchain_images; i++) {
-    FrameData& frame_data_i = frame_data[i];
-    VkFenceGetFdInfoKHR export_info{
-        VK_STRUCTURE_TYPE_FENCE_GET_FD_INFO_KHR, nullptr,
-        frame_data_i.free_fence->get_raw_object(),
-        VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_FD_BIT};
-
-    device->vkGetFenceFdKHR(device, &export_info, &file_descriptors[1 + i * 2]);
-
-    export_info.fence = frame_data_i.ready_fence->get_raw_object();
-    device->vkGetFenceFdKHR(device, &export_info, &file_descriptors[2 + i * 2]);
-  }
-
-  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
-
-  struct sockaddr_un addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sun_family = AF_UNIX;
-  strcpy(&addr.sun_path[1], "vulkan_external_buffer_example");
-  bind(sock, (struct sockaddr*)&addr, sizeof(addr));
-
-  listen(sock, 1);
-  int conn = accept(sock, NULL, 0);
-
-  struct msghdr msg;
-  struct iovec iov[1];
-  containers::vector<char> ctrl_buf(data->allocator());
-  ctrl_buf.resize(CMSG_SPACE(sizeof(int) * file_descriptors.size()), 0);
-
-  memset(&msg, 0, sizeof(struct msghdr));
-
-  char sock_data[1] = {' '};
-  iov[0].iov_base = sock_data;
-  iov[0].iov_len = sizeof(sock_data);
-
-  msg.msg_name = NULL;
-  msg.msg_namelen = 0;
-  msg.msg_iov = iov;
-  msg.msg_iovlen = 1;
-  msg.msg_controllen = CMSG_SPACE(sizeof(int) * file_descriptors.size());
-  msg.msg_control = ctrl_buf.data();
-
-  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
-  cmsg->cmsg_level = SOL_SOCKET;
-  cmsg->cmsg_type = SCM_RIGHTS;
-  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * file_descriptors.size());
-
-  memcpy(CMSG_DATA(cmsg), file_descriptors.data(),
-         sizeof(int) * file_descriptors.size());
-
-  sendmsg(conn, &msg, 0);
-
-  close(conn);
-  close(sock);
-
-  for (int fd : file_descriptors) {
-    close(fd);
-  }
-#endif
+  // The images are only handed out once their command buffers exist.
+  exporter.SendHandles();
 
   float speed = 0.0001f;
-  int i = 0;
 
   while (true) {
+    const uint32_t i = exporter.AcquireFrame();
     FrameData& frame_data_i = frame_data[i];
-    device->vkWaitForFences(device, 1,
-                            &frame_data_i.free_fence->get_raw_object(), VK_TRUE,
-                            UINT64_MAX);
-    device->vkResetFences(device, 1,
-                          &frame_data_i.free_fence->get_raw_object());
 
     camera_data->UpdateBuffer(&app.render_queue(), i);
-    model_data->UpdateBuffer(&app.render_queue(), i++);
-
-    i %= num_swapchain_images;
+    model_data->UpdateBuffer(&app.render_queue(), i);
 
     model_data->data().transform =
         model_data->data().transform *
         Mat44::FromRotationMatrix(Mat44::RotationX(3.14f * speed) *
                                   Mat44::RotationY(3.14f * speed * 0.5f));
-    submit_info.pCommandBuffers =
-        &frame_data_i.command_buffer_->get_command_buffer();
-
-    LOG_ASSERT(==, log, VK_SUCCESS,
-               app.render_queue()->vkQueueSubmit(
-                   app.render_queue(), 1, &submit_info,
-                   frame_data_i.ready_fence->get_raw_object()));
+    exporter.SubmitFrame(&app.render_queue(),
+                         frame_data_i.command_buffer_->get_command_buffer());
   }
 
   log->LogInfo("Application Shutdown");
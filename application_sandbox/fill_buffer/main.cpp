@@ -166,6 +166,8 @@ class FillSample : public sample_application::Sample<FillFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -357,10 +359,6 @@ class FillSample : public sample_application::Sample<FillFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       FillFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     if (frame_number++ > 300) {
       VkSubmitInfo submit_info{
           VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
@@ -0,0 +1,31 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// The vertices were skinned once into the geometry cache.
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec4 normal;
+
+layout (location = 0) out vec3 out_normal;
+
+layout (binding = 0, set = 0) uniform camera_data {
+    layout(column_major) mat4x4 view_projection;
+};
+
+void main() {
+    gl_Position = view_projection * position;
+    out_normal = normal.xyz;
+}
@@ -0,0 +1,652 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/geometry_cache.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector3 = mathfu::Vector<float, 3>;
+
+uint32_t skin_shader[] =
+#include "geometry_cache/skin_vertices.comp.spv"
+    ;
+
+uint32_t skinned_vertex_shader[] =
+#include "skinned.vert.spv"
+    ;
+
+uint32_t cached_vertex_shader[] =
+#include "cached.vert.spv"
+    ;
+
+uint32_t shade_fragment_shader[] =
+#include "shade.frag.spv"
+    ;
+
+// The ways in which every pass gets the skinned vertices.
+enum class SkinningPath {
+  // The vertex shader of every pass skins the vertices again.
+  kVertexShader,
+  // A compute dispatch skins the vertices once into a GeometryCache, and
+  // every pass reads them from there.
+  kGeometryCache,
+};
+
+struct SkinningPathInfo {
+  SkinningPath path;
+  // The name of the path in the sample options, and of its GPU zone.
+  const char* name;
+};
+
+const SkinningPathInfo kSkinningPaths[] = {
+    {SkinningPath::kVertexShader, "vertex_shader"},
+    {SkinningPath::kGeometryCache, "geometry_cache"},
+};
+const size_t kNumSkinningPaths =
+    sizeof(kSkinningPaths) / sizeof(kSkinningPaths[0]);
+
+// The size of the tube that is skinned, unless rings=<N> or segments=<N>
+// were given. Every ring has a vertex for every segment.
+const uint32_t kDefaultRings = 2048;
+const uint32_t kDefaultSegments = 64;
+// The number of times that the tube is drawn every frame, unless
+// passes=<N> was given, like a depth pre-pass, a shadow pass and the main
+// pass would.
+const uint32_t kDefaultPasses = 3;
+
+// The frames of every path that are measured, after the warmup frames,
+// which let the frames in flight and the GPU times of the previous path
+// drain.
+const uint32_t kDefaultFramesPerConfig = 120;
+const uint32_t kWarmupFrames = 30;
+
+const float kTubeRadius = 0.15f;
+
+struct GeometryCacheBenchmarkFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> descriptor_set_;
+  // The cache of the skinned vertices of this frame.
+  size_t cache_;
+};
+
+// This draws a skinned tube several times every frame, once with every
+// pass skinning the vertices in its vertex shader, and once with the
+// vertices skinned once per frame into a GeometryCache, and logs the GPU
+// time of both. Only the last pass writes colors, the ones before it stand
+// in for passes that only write depth, or the shadows.
+class GeometryCacheBenchmark
+    : public sample_application::Sample<GeometryCacheBenchmarkFrameData> {
+ public:
+  GeometryCacheBenchmark(const entry::EntryData* data)
+      : data_(data),
+        Sample<GeometryCacheBenchmarkFrameData>(
+            data->allocator(), data, 32, 512, 128, 1,
+            sample_application::SampleOptions().EnableGpuProfiler(1)),
+        paths_(data->allocator()),
+        num_rings_(kDefaultRings),
+        num_segments_(kDefaultSegments),
+        num_passes_(kDefaultPasses),
+        frames_per_config_(kDefaultFramesPerConfig),
+        path_index_(0),
+        config_frame_(0),
+        done_(false),
+        time_(0.0f),
+        gpu_time_(0.0),
+        num_gpu_times_(0) {
+    const char* frames_option = data->sample_option("frames_per_config");
+    if (frames_option) {
+      frames_per_config_ =
+          static_cast<uint32_t>(strtoul(frames_option, nullptr, 10));
+    }
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+    const char* rings_option = data->sample_option("rings");
+    if (rings_option) {
+      num_rings_ = static_cast<uint32_t>(strtoul(rings_option, nullptr, 10));
+    }
+    num_rings_ = std::max(num_rings_, 2u);
+    const char* segments_option = data->sample_option("segments");
+    if (segments_option) {
+      num_segments_ =
+          static_cast<uint32_t>(strtoul(segments_option, nullptr, 10));
+    }
+    num_segments_ = std::max(num_segments_, 3u);
+    const char* passes_option = data->sample_option("passes");
+    if (passes_option) {
+      num_passes_ = static_cast<uint32_t>(strtoul(passes_option, nullptr, 10));
+    }
+    num_passes_ = std::max(num_passes_, 1u);
+
+    const char* path_option = data->sample_option("path");
+    for (size_t i = 0; i < kNumSkinningPaths; ++i) {
+      if (path_option && strcmp(path_option, kSkinningPaths[i].name) != 0) {
+        continue;
+      }
+      paths_.push_back(i);
+    }
+    if (paths_.empty()) {
+      data->logger()->LogError("Unknown path ", path_option);
+      for (size_t i = 0; i < kNumSkinningPaths; ++i) {
+        paths_.push_back(i);
+      }
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    CreateTube(initialization_buffer);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+      descriptor_set_layouts_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    // Only the vertex shader path reads the joints, but all of the
+    // pipelines have the same layout.
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{descriptor_set_layouts_[0], descriptor_set_layouts_[1]}}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    for (size_t i = 0; i < kNumSkinningPaths; ++i) {
+      const bool cached =
+          kSkinningPaths[i].path == SkinningPath::kGeometryCache;
+      hidden_pipelines_[i] = CreatePipeline(cached, false);
+      visible_pipelines_[i] = CreatePipeline(cached, true);
+    }
+
+    geometry_cache_ = containers::make_unique<vulkan::GeometryCache>(
+        data_->allocator(), app(), num_vertices(), skin_shader);
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    joint_data_ = containers::make_unique<vulkan::BufferFrameData<JointData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(joint_data_.get());
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().view_projection =
+        Mat44::FromScaleVector(Vector3{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f) *
+        Mat44::FromTranslationVector(Vector3{0.0f, 0.0f, -2.0f});
+    PoseJoints();
+  }
+
+  virtual void InitializeFrameData(
+      GeometryCacheBenchmarkFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet(
+                {descriptor_set_layouts_[0], descriptor_set_layouts_[1]}));
+
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            joint_data_->get_buffer(),                       // buffer
+            joint_data_->get_offset_for_frame(frame_index),  // offset
+            joint_data_->size(),                             // range
+        }};
+
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *frame_data->descriptor_set_,            // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
+                                            nullptr);
+
+    // Every frame in flight skins into its own cache.
+    VkDescriptorBufferInfo vertices = {
+        *vertex_buffer_,  // buffer
+        0,                // offset
+        VK_WHOLE_SIZE,    // range
+    };
+    frame_data->cache_ = geometry_cache_->AddCache(vertices, buffer_infos[1]);
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void InitializationComplete() override {
+    vertex_staging_buffer_.reset();
+    index_staging_buffer_.reset();
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    time_ += time_since_last_render;
+    PoseJoints();
+  }
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      GeometryCacheBenchmarkFrameData* frame_data) override {
+    const size_t path_index = paths_[path_index_];
+    const bool cached =
+        kSkinningPaths[path_index].path == SkinningPath::kGeometryCache;
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    const uint32_t zone = gpu_profiler()->BeginZone(
+        &cmdBuffer, kSkinningPaths[path_index].name, false);
+
+    // The skinning is part of what is measured.
+    if (cached) {
+      geometry_cache_->Update(&cmdBuffer, frame_data->cache_);
+    }
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->descriptor_set_->raw_set(), 0, nullptr);
+    if (cached) {
+      geometry_cache_->BindVertexBuffer(&cmdBuffer, frame_data->cache_, 0);
+    } else {
+      ::VkBuffer vertex_buffer = *vertex_buffer_;
+      ::VkDeviceSize offset = 0;
+      cmdBuffer->vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertex_buffer,
+                                        &offset);
+    }
+    cmdBuffer->vkCmdBindIndexBuffer(cmdBuffer, *index_buffer_, 0,
+                                    VK_INDEX_TYPE_UINT32);
+
+    for (uint32_t pass = 0; pass < num_passes_; ++pass) {
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   pass + 1 == num_passes_
+                                       ? *visible_pipelines_[path_index]
+                                       : *hidden_pipelines_[path_index]);
+      cmdBuffer->vkCmdDrawIndexed(cmdBuffer, num_indices(), 1, 0, 0, 0);
+    }
+
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, zone);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (config_frame_ >= kWarmupFrames) {
+      // The GPU time is the one of the last frame that finished.
+      const float gpu_time =
+          gpu_profiler()->GetLastZoneTime(kSkinningPaths[path_index].name);
+      if (gpu_time >= 0.0f) {
+        gpu_time_ += gpu_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      app()->GetLogger()->LogInfo(
+          "BENCHMARK: path: ", kSkinningPaths[path_index].name,
+          " vertices: ", num_vertices(), " passes: ", num_passes_, " gpu: ",
+          num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0, "ms");
+      config_frame_ = 0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (++path_index_ == paths_.size()) {
+        done_ = true;
+        path_index_ = 0;
+      }
+    }
+  }
+
+  // Returns true once every path has been measured.
+  bool benchmark_done() const { return done_; }
+
+ private:
+  struct CameraData {
+    Mat44 view_projection;
+  };
+
+  struct JointData {
+    Mat44 joints[vulkan::GeometryCache::kMaxJoints];
+  };
+
+  uint32_t num_vertices() const { return num_rings_ * num_segments_; }
+  uint32_t num_indices() const {
+    return (num_rings_ - 1) * num_segments_ * 6;
+  }
+
+  // Creates the pipeline of the cached path if |cached|, or of the vertex
+  // shader path if not. Unless |write_color|, the pipeline writes nothing.
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreatePipeline(
+      bool cached, bool write_color) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    if (cached) {
+      pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                          cached_vertex_shader);
+      vulkan::GeometryCache::AddCachedInputStream(pipeline.get());
+    } else {
+      pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                          skinned_vertex_shader);
+      vulkan::GeometryCache::AddSkinnedInputStream(pipeline.get());
+    }
+    pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                        shade_fragment_shader);
+    pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline->SetViewport(viewport());
+    pipeline->SetScissor(scissor());
+    pipeline->SetSamples(num_samples());
+    if (write_color) {
+      pipeline->AddAttachment();
+    } else {
+      pipeline->AddAttachment(VkPipelineColorBlendAttachmentState{
+          VK_FALSE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO,
+          VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO,
+          VK_BLEND_OP_ADD, 0});
+    }
+    pipeline->Commit();
+    return pipeline;
+  }
+
+  // Writes the vertices and indices of a tube along y from -1 to 1 to the
+  // staging buffers, and records the copy of them to the device into |cmd|.
+  // Every vertex is skinned with the 4 joints around it, with cubic
+  // B-spline weights, so that the tube bends smoothly.
+  void CreateTube(vulkan::VkCommandBuffer* cmd) {
+    const uint32_t max_joint = vulkan::GeometryCache::kMaxJoints - 1;
+    const VkDeviceSize vertex_size =
+        num_vertices() * sizeof(vulkan::GeometryCache::SkinnedVertex);
+    const VkDeviceSize index_size = num_indices() * sizeof(uint32_t);
+    vertex_staging_buffer_ = app()->CreateAndBindDefaultExclusiveHostBuffer(
+        vertex_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    index_staging_buffer_ = app()->CreateAndBindDefaultExclusiveHostBuffer(
+        index_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    vertex_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        vertex_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    index_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        index_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+    vulkan::GeometryCache::SkinnedVertex* vertices =
+        reinterpret_cast<vulkan::GeometryCache::SkinnedVertex*>(
+            vertex_staging_buffer_->base_address());
+    for (uint32_t ring = 0; ring < num_rings_; ++ring) {
+      const float joint = static_cast<float>(ring) * max_joint /
+                          static_cast<float>(num_rings_ - 1);
+      const int32_t first = static_cast<int32_t>(joint) - 1;
+      const float f = joint - std::floor(joint);
+      const float weights[4] = {
+          (1.0f - f) * (1.0f - f) * (1.0f - f) / 6.0f,
+          (3.0f * f * f * f - 6.0f * f * f + 4.0f) / 6.0f,
+          (-3.0f * f * f * f + 3.0f * f * f + 3.0f * f + 1.0f) / 6.0f,
+          f * f * f / 6.0f,
+      };
+      uint32_t joint_indices[4];
+      for (int32_t i = 0; i < 4; ++i) {
+        joint_indices[i] = static_cast<uint32_t>(
+            std::min(std::max(first + i, 0), static_cast<int32_t>(max_joint)));
+      }
+      const float y = -1.0f + 2.0f * ring / static_cast<float>(num_rings_ - 1);
+      for (uint32_t segment = 0; segment < num_segments_; ++segment) {
+        const float angle = 6.2831853f * segment / num_segments_;
+        const float x = std::cos(angle);
+        const float z = std::sin(angle);
+        vertices[ring * num_segments_ + segment] = {
+            {x * kTubeRadius, y, z * kTubeRadius, 1.0f},  // position
+            {x, 0.0f, z, 0.0f},                           // normal
+            {joint_indices[0], joint_indices[1], joint_indices[2],
+             joint_indices[3]},                               // joint_indices
+            {weights[0], weights[1], weights[2], weights[3]}  // weights
+        };
+      }
+    }
+    vertex_staging_buffer_->flush();
+
+    uint32_t* indices =
+        reinterpret_cast<uint32_t*>(index_staging_buffer_->base_address());
+    for (uint32_t ring = 0; ring + 1 < num_rings_; ++ring) {
+      for (uint32_t segment = 0; segment < num_segments_; ++segment) {
+        const uint32_t next = (segment + 1) % num_segments_;
+        const uint32_t a = ring * num_segments_ + segment;
+        const uint32_t b = ring * num_segments_ + next;
+        const uint32_t c = a + num_segments_;
+        const uint32_t d = b + num_segments_;
+        const uint32_t quad[6] = {a, c, b, b, c, d};
+        memcpy(indices, quad, sizeof(quad));
+        indices += 6;
+      }
+    }
+    index_staging_buffer_->flush();
+
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    VkBufferCopy vertex_copy = {
+        0,           // srcOffset
+        0,           // dstOffset
+        vertex_size  // size
+    };
+    cmdBuffer->vkCmdCopyBuffer(cmdBuffer, *vertex_staging_buffer_,
+                               *vertex_buffer_, 1, &vertex_copy);
+    VkBufferCopy index_copy = {
+        0,          // srcOffset
+        0,          // dstOffset
+        index_size  // size
+    };
+    cmdBuffer->vkCmdCopyBuffer(cmdBuffer, *index_staging_buffer_,
+                               *index_buffer_, 1, &index_copy);
+    VkMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,      // srcAccessMask
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+            VK_ACCESS_SHADER_READ_BIT,  // dstAccessMask
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  // Bends the tube at every joint, with a wave that travels along it.
+  void PoseJoints() {
+    const uint32_t num_joints = vulkan::GeometryCache::kMaxJoints;
+    const float spacing = 2.0f / (num_joints - 1);
+    Mat44 world = Mat44::FromTranslationVector(Vector3{0.0f, -1.0f, 0.0f});
+    for (uint32_t i = 0; i < num_joints; ++i) {
+      if (i > 0) {
+        world = world *
+                Mat44::FromTranslationVector(Vector3{0.0f, spacing, 0.0f});
+      }
+      world = world * Mat44::FromRotationMatrix(Mat44::RotationZ(
+                          0.08f * std::sin(2.0f * time_ + 0.4f * i)));
+      // The vertices are in bind space, where the joint is at its rest
+      // height on the y axis.
+      joint_data_->data().joints[i] =
+          world * Mat44::FromTranslationVector(
+                      Vector3{0.0f, 1.0f - spacing * i, 0.0f});
+    }
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  // In the order of kSkinningPaths. The hidden pipelines draw all of the
+  // passes but the last, and write no colors.
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline>
+      hidden_pipelines_[kNumSkinningPaths];
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline>
+      visible_pipelines_[kNumSkinningPaths];
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding descriptor_set_layouts_[2];
+  containers::unique_ptr<vulkan::GeometryCache> geometry_cache_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<JointData>> joint_data_;
+
+  // Only alive until the tube has been copied to the device.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      vertex_staging_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      index_staging_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> vertex_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> index_buffer_;
+
+  // The indices in kSkinningPaths of the paths that are measured, one after
+  // the other.
+  containers::vector<size_t> paths_;
+  uint32_t num_rings_;
+  uint32_t num_segments_;
+  uint32_t num_passes_;
+  uint32_t frames_per_config_;
+  size_t path_index_;
+  uint32_t config_frame_;
+  bool done_;
+  float time_;
+  // The sum of the GPU times of the measured frames of the current path, in
+  // milliseconds.
+  double gpu_time_;
+  uint32_t num_gpu_times_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  GeometryCacheBenchmark sample(data);
+  if (!sample.is_valid()) {
+    data->logger()->LogInfo("Application is invalid.");
+    return -1;
+  }
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing() &&
+         !sample.benchmark_done()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
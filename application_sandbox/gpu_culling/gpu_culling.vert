@@ -0,0 +1,36 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#include "models/model_setup.glsl"
+
+layout (location = 1) out vec2 texcoord;
+
+layout (binding = 0, set = 0) uniform camera_data {
+    layout(column_major) mat4x4 view_projection;
+};
+
+layout (binding = 1, set = 0, std430) readonly buffer object_data {
+    // xyz is the center of the cube, w its scale.
+    vec4 objects[];
+};
+
+void main() {
+    // Every draw command draws its cube as its first instance.
+    vec4 object = objects[gl_InstanceIndex];
+    gl_Position =
+        view_projection * vec4(get_position().xyz * object.w + object.xyz, 1.0);
+    texcoord = get_texcoord();
+}
@@ -0,0 +1,574 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/gpu_culling.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/upload_batch.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector3 = mathfu::Vector<float, 3>;
+
+namespace cube_model {
+#include "cube.obj.h"
+}
+const auto& cube_data = cube_model::model;
+
+uint32_t gpu_culling_vertex_shader[] =
+#include "gpu_culling.vert.spv"
+    ;
+
+uint32_t gpu_culling_fragment_shader[] =
+#include "gpu_culling.frag.spv"
+    ;
+
+uint32_t cull_instances_shader[] =
+#include "culling/cull_instances.comp.spv"
+    ;
+
+uint32_t depth_pyramid_shader[] =
+#include "culling/depth_pyramid.comp.spv"
+    ;
+
+// How the cubes that are not visible are culled.
+enum class CullingMode {
+  // Every cube is drawn.
+  kNone,
+  // The cubes outside of the view frustum are culled.
+  kFrustum,
+  // The cubes outside of the view frustum, or behind the depth of the
+  // previous frame, are culled.
+  kOcclusion,
+};
+
+struct CullingModeInfo {
+  CullingMode mode;
+  // The name of the mode in the sample options.
+  const char* name;
+};
+
+const CullingModeInfo kCullingModes[] = {
+    {CullingMode::kNone, "none"},
+    {CullingMode::kFrustum, "frustum"},
+    {CullingMode::kOcclusion, "occlusion"},
+};
+const size_t kNumCullingModes =
+    sizeof(kCullingModes) / sizeof(kCullingModes[0]);
+
+const uint32_t kDefaultObjects = 100000;
+// The distance between the centers of neighbouring cubes.
+const float kSpacing = 1.5f;
+// The GPU time of the frames is logged every this many frames.
+const uint32_t kLogFrames = 100;
+const char kCullAndDrawZone[] = "Cull and draw";
+
+// The storage buffer data of every cube, the position of its center, and
+// its scale.
+struct ObjectData {
+  float position[3];
+  float scale;
+};
+
+struct GpuCullingFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
+  // The depth buffer of this frame, as a depth source of the culling.
+  size_t depth_source_;
+};
+
+// This draws a large field of cubes around a turning camera, which only
+// ever sees a small part of them, most of which are hidden by the cubes in
+// front. vulkan::GpuCulling culls the cubes on the GPU, without the CPU
+// looking at any cube, and the GPU time of culling and drawing them is
+// logged for every culling mode.
+class GpuCullingSample
+    : public sample_application::Sample<GpuCullingFrameData> {
+ public:
+  GpuCullingSample(const entry::EntryData* data,
+                   const VkPhysicalDeviceFeatures& requested_features)
+      : data_(data),
+        Sample<GpuCullingFrameData>(
+            data->allocator(), data, 1, 512, 64, 1,
+            sample_application::SampleOptions()
+                .EnableDepthBuffer()
+                .EnableSampledDepthBuffer()
+                .EnableGpuProfiler(1),
+            requested_features, {},
+            {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME}),
+        cube_(data->allocator(), data->logger(), cube_data),
+        num_objects_(kDefaultObjects),
+        mode_(CullingMode::kOcclusion),
+        angle_(0.0f),
+        num_frames_(0),
+        gpu_time_(0.0),
+        num_gpu_times_(0) {
+    const char* objects_option = data->sample_option("objects");
+    if (objects_option) {
+      num_objects_ =
+          static_cast<uint32_t>(strtoul(objects_option, nullptr, 10));
+    }
+    if (num_objects_ == 0) {
+      num_objects_ = 1;
+    }
+    const char* culling_option = data->sample_option("culling");
+    if (culling_option) {
+      size_t i = 0;
+      while (i < kNumCullingModes &&
+             strcmp(culling_option, kCullingModes[i].name) != 0) {
+        ++i;
+      }
+      if (i < kNumCullingModes) {
+        mode_ = kCullingModes[i].mode;
+      } else {
+        data->logger()->LogError("Unknown culling mode ", culling_option);
+      }
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    containers::vector<ObjectData> objects(data_->allocator());
+    containers::vector<float> bounds(data_->allocator());
+    containers::vector<VkDrawIndexedIndirectCommand> draws(data_->allocator());
+    LayOutObjects(&objects, &bounds, &draws);
+
+    object_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        objects.size() * sizeof(ObjectData),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    bounds_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        bounds.size() * sizeof(float),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    // Without culling, these are drawn directly.
+    instance_draw_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        draws.size() * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    vulkan::UploadBatch upload_batch(app());
+    upload_batch.AddModel(&cube_);
+    upload_batch.AddBuffer(object_buffer_.get(), 0, objects.data(),
+                           objects.size() * sizeof(ObjectData),
+                           VK_ACCESS_SHADER_READ_BIT,
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    upload_batch.AddBuffer(bounds_buffer_.get(), 0, bounds.data(),
+                           bounds.size() * sizeof(float),
+                           VK_ACCESS_SHADER_READ_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    upload_batch.AddBuffer(
+        instance_draw_buffer_.get(), 0, draws.data(),
+        draws.size() * sizeof(VkDrawIndexedIndirectCommand),
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    upload_staging_buffer_ = upload_batch.Record(initialization_buffer);
+
+    culling_ = containers::make_unique<vulkan::GpuCulling>(
+        data_->allocator(), app(), num_objects_, app()->swapchain().width(),
+        app()->swapchain().height(), cull_instances_shader,
+        depth_pyramid_shader);
+    culling_->SetInstances(
+        {
+            *bounds_buffer_,  // buffer
+            0,                // offset
+            VK_WHOLE_SIZE,    // range
+        },
+        {
+            *instance_draw_buffer_,  // buffer
+            0,                       // offset
+            VK_WHOLE_SIZE,           // range
+        });
+
+    for (uint32_t i = 0; i < 2; ++i) {
+      cube_descriptor_set_layouts_[i] = {
+          i,  // binding
+          i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                 : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                           // descriptorCount
+          VK_SHADER_STAGE_VERTEX_BIT,                  // stageFlags
+          nullptr                                      // pImmutableSamplers
+      };
+    }
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{cube_descriptor_set_layouts_[0],
+                                      cube_descriptor_set_layouts_[1]}}));
+
+    VkAttachmentReference depth_attachment = {
+        0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference color_attachment = {
+        1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    // The depth is stored for the depth pyramid.
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                 0,                                 // flags
+                 depth_format(),                    // format
+                 num_samples(),                     // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stenilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stenilStoreOp
+                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // initialLayout
+                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // finalLayout
+             },
+             {
+                 0,                                         // flags
+                 render_format(),                           // format
+                 num_samples(),                             // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+             }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                &depth_attachment,                // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    cube_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                              gpu_culling_vertex_shader);
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                              gpu_culling_fragment_shader);
+    cube_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    cube_pipeline_->SetInputStreams(&cube_);
+    cube_pipeline_->SetViewport(viewport());
+    cube_pipeline_->SetScissor(scissor());
+    cube_pipeline_->SetSamples(num_samples());
+    cube_pipeline_->AddAttachment();
+    cube_pipeline_->Commit();
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    projection_ = Mat44::FromScaleVector(Vector3{1.0f, -1.0f, 1.0f}) *
+                  Mat44::Perspective(1.5708f, aspect, 0.1f, 200.0f);
+    camera_data_->data().view_projection = projection_;
+  }
+
+  virtual void InitializationComplete() override {
+    upload_staging_buffer_.reset();
+  }
+
+  virtual void InitializeFrameData(
+      GpuCullingFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->cube_descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({cube_descriptor_set_layouts_[0],
+                                          cube_descriptor_set_layouts_[1]}));
+
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            *object_buffer_,  // buffer
+            0,                // offset
+            VK_WHOLE_SIZE,    // range
+        }};
+
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->cube_descriptor_set_,       // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->cube_descriptor_set_,       // dstSet
+            1,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos + 1,                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 2, writes, 0,
+                                            nullptr);
+
+    frame_data->depth_source_ = culling_->AddDepthSource(
+        depth_image(frame_data), depth_view(frame_data));
+
+    ::VkImageView raw_views[2] = {depth_view(frame_data),
+                                  color_view(frame_data)};
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        2,                                          // attachmentCount
+        raw_views,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    // The camera turns around in the middle of the cubes.
+    angle_ += 0.3f * time_since_last_render;
+    camera_data_->data().view_projection =
+        projection_ * Mat44::FromRotationMatrix(Mat44::RotationY(angle_));
+  }
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      GpuCullingFrameData* frame_data) override {
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    // The matrix that the uniform buffer of this frame was updated with.
+    const float* view_projection = &camera_data_->data().view_projection[0];
+    const uint32_t zone =
+        gpu_profiler()->BeginZone(&cmdBuffer, kCullAndDrawZone, false);
+    if (mode_ != CullingMode::kNone) {
+      culling_->Cull(&cmdBuffer, view_projection, num_objects_,
+                     mode_ == CullingMode::kOcclusion);
+    }
+
+    VkClearValue clears[2];
+    vulkan::MemoryClear(&clears[0]);
+    clears[0].depthStencil.depth = 1.0f;
+    vulkan::MemoryClear(&clears[1]);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        2,                                // clearValueCount
+        clears                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *cube_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
+    cube_.BindVertexAndIndexBuffers(&cmdBuffer);
+
+    if (mode_ == CullingMode::kNone) {
+      cmdBuffer->vkCmdDrawIndexedIndirect(
+          cmdBuffer, *instance_draw_buffer_, 0, culling_->max_draws(),
+          static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+    } else {
+      culling_->Draw(&cmdBuffer);
+    }
+
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    if (mode_ == CullingMode::kOcclusion) {
+      // What the next frame is tested against.
+      culling_->BuildDepthPyramid(&cmdBuffer, frame_data->depth_source_,
+                                  view_projection);
+    }
+    gpu_profiler()->EndZone(&cmdBuffer, zone);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    // The GPU time is the one of the last frame that finished.
+    const float gpu_time = gpu_profiler()->GetLastZoneTime(kCullAndDrawZone);
+    if (gpu_time >= 0.0f) {
+      gpu_time_ += gpu_time * 1000.0;
+      ++num_gpu_times_;
+    }
+    if (++num_frames_ == kLogFrames) {
+      app()->GetLogger()->LogInfo(
+          "Culling: ", kCullingModes[static_cast<size_t>(mode_)].name,
+          " objects: ", num_objects_, " gpu: ",
+          num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0, "ms");
+      num_frames_ = 0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+    }
+  }
+
+ private:
+  struct CameraData {
+    Mat44 view_projection;
+  };
+
+  // Lays out num_objects_ cubes of different sizes on a square grid around
+  // the camera, with some room around the camera itself. Writes their
+  // bounding spheres, four floats each, and a draw of every cube, with its
+  // index as the first instance.
+  void LayOutObjects(containers::vector<ObjectData>* objects,
+                     containers::vector<float>* bounds,
+                     containers::vector<VkDrawIndexedIndirectCommand>* draws) {
+    // The cubes of the model go from -0.5 to 0.5.
+    const float kHalfDiagonal = 0.5f * std::sqrt(3.0f);
+    const int32_t side = static_cast<int32_t>(
+                             std::ceil(std::sqrt(static_cast<double>(
+                                 num_objects_ + 16)))) |
+                         1;
+    const int32_t half_side = side / 2;
+    objects->reserve(num_objects_);
+    bounds->reserve(4 * num_objects_);
+    draws->reserve(num_objects_);
+    for (int32_t z = -half_side; z <= half_side; ++z) {
+      for (int32_t x = -half_side; x <= half_side; ++x) {
+        if (objects->size() == num_objects_) {
+          return;
+        }
+        if (std::abs(x) < 2 && std::abs(z) < 2) {
+          continue;
+        }
+        const uint32_t i = static_cast<uint32_t>(objects->size());
+        const float scale = 0.6f + 0.006f * ((i * 7919) % 101);
+        const float position[3] = {x * kSpacing, 0.0f, z * kSpacing};
+        objects->push_back({
+            {position[0], position[1], position[2]},  // position
+            scale                                     // scale
+        });
+        bounds->push_back(position[0]);
+        bounds->push_back(position[1]);
+        bounds->push_back(position[2]);
+        bounds->push_back(scale * kHalfDiagonal);
+        draws->push_back({
+            static_cast<uint32_t>(cube_.NumIndices()),  // indexCount
+            1,                                          // instanceCount
+            0,                                          // firstIndex
+            0,                                          // vertexOffset
+            i,                                          // firstInstance
+        });
+      }
+    }
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[2];
+  vulkan::VulkanModel cube_;
+  containers::unique_ptr<vulkan::GpuCulling> culling_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  Mat44 projection_;
+
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> object_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> bounds_buffer_;
+  // The draw of every cube, which the culling compacts.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      instance_draw_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      upload_staging_buffer_;
+
+  uint32_t num_objects_;
+  CullingMode mode_;
+  float angle_;
+  // The frames since the last log, and the sum of their GPU times in
+  // milliseconds.
+  uint32_t num_frames_;
+  double gpu_time_;
+  uint32_t num_gpu_times_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  VkPhysicalDeviceFeatures requested_features = {0};
+  // All of the cubes are drawn from one buffer of commands, and every
+  // command draws its cube as its first instance.
+  requested_features.multiDrawIndirect = VK_TRUE;
+  requested_features.drawIndirectFirstInstance = VK_TRUE;
+  GpuCullingSample sample(data, requested_features);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,686 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/frame_pacer.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+uint32_t fullscreen_vertex_shader[] =
+#include "fullscreen.vert.spv"
+    ;
+
+uint32_t scene_fragment_shader[] =
+#include "scene.frag.spv"
+    ;
+
+uint32_t resolve_fragment_shader[] =
+#include "resolve.frag.spv"
+    ;
+
+namespace {
+// The number of blended full screen layers of the scene.
+const uint32_t kSceneLayers = 8;
+
+// The frames of every configuration that are measured, after the warmup
+// frames, which let the frames in flight, the GPU times and the present
+// timings of the previous configuration drain.
+const uint32_t kDefaultFramesPerConfig = 120;
+const uint32_t kWarmupFrames = 30;
+
+// The GPU zones of every frame.
+const char kSceneZone[] = "scene";
+const char kResolveZone[] = "resolve";
+
+struct FormatInfo {
+  VkFormat format;
+  // The name of the format in the sample options and the results.
+  const char* name;
+};
+
+// The formats of the intermediate targets that the scene is rendered to,
+// and of the swapchains it can be resolved to.
+const FormatInfo kFormats[] = {
+    {VK_FORMAT_B8G8R8A8_UNORM, "b8g8r8a8"},
+    {VK_FORMAT_A2B10G10R10_UNORM_PACK32, "a2b10g10r10"},
+    {VK_FORMAT_R16G16B16A16_SFLOAT, "r16g16b16a16"},
+};
+const size_t kNumFormats = sizeof(kFormats) / sizeof(kFormats[0]);
+
+// How the resolve encodes the scene for the swapchain. This must match
+// resolve.frag.
+enum Encoding {
+  // Tone mapped, with a 2.2 gamma, for UNORM SDR swapchains.
+  kEncodingGamma = 0,
+  // Tone mapped, for SRGB swapchains which encode it themselves.
+  kEncodingSrgb = 1,
+  // HDR10, BT.2020 with the ST 2084 transfer function, for
+  // Enable10BitHDR().
+  kEncodingPq = 2,
+  // Linear, for the extended sRGB color space of EnableFp16HDR().
+  kEncodingScRgb = 3,
+};
+
+// This must match resolve_data in resolve.frag.
+struct ResolveData {
+  int32_t encoding;
+};
+
+const std::initializer_list<const char*> kNoExtensions = {};
+const std::initializer_list<const char*> kHdrInstanceExtensions = {
+    VK_EXT_SWAPCHAIN_COLOR_SPACE_EXTENSION_NAME,
+    VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME};
+const std::initializer_list<const char*> kDisplayTimingExtensions = {
+    VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME};
+
+const char* FormatName(VkFormat format) {
+  for (size_t i = 0; i < kNumFormats; ++i) {
+    if (kFormats[i].format == format) {
+      return kFormats[i].name;
+    }
+  }
+  switch (format) {
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      return "b8g8r8a8_srgb";
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      return "r8g8b8a8";
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      return "r8g8b8a8_srgb";
+    case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+      return "a2r10g10b10";
+    default:
+      return "other";
+  }
+}
+
+uint32_t BytesPerPixel(VkFormat format) {
+  return format == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 4;
+}
+
+// Returns the swapchain format that -sample-option=swapchain=<name> asks
+// for. It is only a request, the surface decides.
+VkFormat RequestedSwapchainFormat(const entry::EntryData* data) {
+  const char* option = data->sample_option("swapchain");
+  for (size_t i = 0; option && i < kNumFormats; ++i) {
+    if (strcmp(option, kFormats[i].name) == 0) {
+      return kFormats[i].format;
+    }
+  }
+  return VK_FORMAT_B8G8R8A8_UNORM;
+}
+
+// Present latencies need VK_GOOGLE_display_timing, unless
+// -sample-option=present_latency=0.
+bool MeasurePresentLatency(const entry::EntryData* data) {
+  const char* option = data->sample_option("present_latency");
+  return !option || strtoul(option, nullptr, 10) != 0;
+}
+
+sample_application::SampleOptions BenchmarkOptions(
+    const entry::EntryData* data) {
+  sample_application::SampleOptions options;
+  options.EnableGpuProfiler(2);
+  switch (RequestedSwapchainFormat(data)) {
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+      options.Enable10BitHDR();
+      break;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      options.EnableFp16HDR();
+      break;
+    default:
+      break;
+  }
+  if (MeasurePresentLatency(data)) {
+    options.EnableDisplayTiming();
+  }
+  return options;
+}
+
+struct HdrFormatBenchmarkFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+};
+
+// This renders the same scene of blended full screen layers into an
+// intermediate target of every format in kFormats, and resolves it into
+// the swapchain, which is in one of the formats per run. It logs the GPU
+// time of rendering and of resolving, the latency of the presents, and the
+// memory of the target and of the swapchain, for every target format.
+class HdrFormatBenchmark
+    : public sample_application::Sample<HdrFormatBenchmarkFrameData> {
+ public:
+  HdrFormatBenchmark(const entry::EntryData* data)
+      : data_(data),
+        Sample<HdrFormatBenchmarkFrameData>(
+            data->allocator(), data, 1, 256, 1, 1, BenchmarkOptions(data),
+            {0},
+            RequestedSwapchainFormat(data) != VK_FORMAT_B8G8R8A8_UNORM
+                ? kHdrInstanceExtensions
+                : kNoExtensions,
+            MeasurePresentLatency(data) ? kDisplayTimingExtensions
+                                        : kNoExtensions),
+        targets_(data->allocator()),
+        encoding_(kEncodingGamma),
+        swapchain_size_(0),
+        frames_per_config_(kDefaultFramesPerConfig),
+        config_index_(0),
+        config_frame_(0),
+        done_(false),
+        scene_time_(0.0),
+        resolve_time_(0.0),
+        num_gpu_times_(0),
+        pacer_statistics_{} {
+    const char* frames_option = data->sample_option("frames_per_config");
+    if (frames_option) {
+      frames_per_config_ =
+          static_cast<uint32_t>(strtoul(frames_option, nullptr, 10));
+    }
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    const VkFormat swapchain_format = render_format();
+    if (swapchain_format != RequestedSwapchainFormat(data_)) {
+      app()->GetLogger()->LogInfo("HDR: the swapchain is ",
+                                  FormatName(swapchain_format), ", not ",
+                                  FormatName(RequestedSwapchainFormat(data_)));
+    }
+    switch (swapchain_format) {
+      case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+      case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        encoding_ = kEncodingPq;
+        break;
+      case VK_FORMAT_R16G16B16A16_SFLOAT:
+        encoding_ = kEncodingScRgb;
+        break;
+      case VK_FORMAT_B8G8R8A8_SRGB:
+      case VK_FORMAT_R8G8B8A8_SRGB:
+        encoding_ = kEncodingSrgb;
+        break;
+      default:
+        encoding_ = kEncodingGamma;
+        break;
+    }
+
+    sampler_ = containers::make_unique<vulkan::VkSampler>(
+        data_->allocator(),
+        vulkan::CreateSampler(&app()->device(), VK_FILTER_NEAREST,
+                              VK_FILTER_NEAREST));
+    resolve_binding_ = {
+        0,                                          // binding
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+        1,                                          // descriptorCount
+        VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+        nullptr                                     // pImmutableSamplers
+    };
+    VkPushConstantRange resolve_range = {
+        VK_SHADER_STAGE_FRAGMENT_BIT,  // stageFlags
+        0,                             // offset
+        sizeof(ResolveData)            // size
+    };
+    scene_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(), app()->CreatePipelineLayout({{}}));
+    resolve_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{resolve_binding_}}, {resolve_range}));
+
+    const char* target_option = data_->sample_option("target");
+    for (size_t i = 0; i < kNumFormats; ++i) {
+      if (target_option && strcmp(target_option, kFormats[i].name) != 0) {
+        continue;
+      }
+      VkFormatProperties properties;
+      app()->instance()->vkGetPhysicalDeviceFormatProperties(
+          app()->device().physical_device(), kFormats[i].format, &properties);
+      const VkFormatFeatureFlags needed =
+          VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+      if ((properties.optimalTilingFeatures & needed) != needed) {
+        app()->GetLogger()->LogInfo("HDR: target: ", kFormats[i].name,
+                                    " is skipped, it can not be blended");
+        continue;
+      }
+      targets_.push_back(CreateTarget(kFormats[i]));
+    }
+    if (targets_.empty()) {
+      app()->GetLogger()->LogError("Unknown or unsupported target ",
+                                   target_option);
+      done_ = true;
+    }
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    // The resolve writes every pixel of the swapchain image.
+    resolve_render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                swapchain_format,                          // format
+                VK_SAMPLE_COUNT_1_BIT,                     // samples
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    resolve_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app()->CreateGraphicsPipeline(resolve_pipeline_layout_.get(),
+                                      resolve_render_pass_.get(), 0));
+    resolve_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                                 fullscreen_vertex_shader);
+    resolve_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                 resolve_fragment_shader);
+    resolve_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    resolve_pipeline_->SetViewport(viewport());
+    resolve_pipeline_->SetScissor(scissor());
+    resolve_pipeline_->SetSamples(VK_SAMPLE_COUNT_1_BIT);
+    resolve_pipeline_->AddAttachment();
+    resolve_pipeline_->Commit();
+
+    swapchain_size_ = VkDeviceSize(app()->swapchain().width()) *
+                      app()->swapchain().height() *
+                      BytesPerPixel(swapchain_format) * num_swapchain_images;
+  }
+
+  virtual void InitializeFrameData(
+      HdrFormatBenchmarkFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    ::VkImageView raw_view = color_view(frame_data);
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *resolve_render_pass_,                      // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {}
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      HdrFormatBenchmarkFrameData* frame_data) override {
+    Target& target = targets_[config_index_];
+    const VkExtent2D extent = {app()->swapchain().width(),
+                               app()->swapchain().height()};
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+    VkRenderPassBeginInfo scene_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *target.render_pass,                       // renderPass
+        *target.framebuffer,                       // framebuffer
+        {{0, 0}, extent},                          // renderArea
+        1,                                         // clearValueCount
+        &clear                                     // clears
+    };
+    const uint32_t scene_zone =
+        gpu_profiler()->BeginZone(&cmdBuffer, kSceneZone, false);
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &scene_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *target.pipeline);
+    cmdBuffer->vkCmdDraw(cmdBuffer, 3, kSceneLayers, 0, 0);
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, scene_zone);
+
+    VkRenderPassBeginInfo resolve_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *resolve_render_pass_,                     // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0}, extent},                          // renderArea
+        0,                                         // clearValueCount
+        nullptr                                    // clears
+    };
+    const ResolveData resolve_data = {encoding_};
+    const uint32_t resolve_zone =
+        gpu_profiler()->BeginZone(&cmdBuffer, kResolveZone, false);
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &resolve_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *resolve_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*resolve_pipeline_layout_), 0, 1,
+        &target.descriptor_set->raw_set(), 0, nullptr);
+    cmdBuffer->vkCmdPushConstants(
+        cmdBuffer, ::VkPipelineLayout(*resolve_pipeline_layout_),
+        VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(resolve_data), &resolve_data);
+    cmdBuffer->vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, resolve_zone);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (config_frame_ == kWarmupFrames && frame_pacer()) {
+      pacer_statistics_ = frame_pacer()->statistics();
+    }
+    if (config_frame_ >= kWarmupFrames) {
+      // The GPU times are the ones of the last frame that finished.
+      const float scene_time = gpu_profiler()->GetLastZoneTime(kSceneZone);
+      const float resolve_time = gpu_profiler()->GetLastZoneTime(kResolveZone);
+      if (scene_time >= 0.0f && resolve_time >= 0.0f) {
+        scene_time_ += scene_time * 1000.0;
+        resolve_time_ += resolve_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      LogResults(target);
+      config_frame_ = 0;
+      scene_time_ = 0.0;
+      resolve_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (++config_index_ == targets_.size()) {
+        done_ = true;
+        config_index_ = 0;
+      }
+    }
+  }
+
+  // Returns true once every target format has been measured.
+  bool benchmark_done() const { return done_; }
+
+ private:
+  // The intermediate target of one format, and what renders the scene into
+  // it and resolves it.
+  struct Target {
+    const FormatInfo* format;
+    containers::unique_ptr<vulkan::VulkanApplication::Image> image;
+    containers::unique_ptr<vulkan::VkImageView> view;
+    containers::unique_ptr<vulkan::VkRenderPass> render_pass;
+    containers::unique_ptr<vulkan::VkFramebuffer> framebuffer;
+    containers::unique_ptr<vulkan::VulkanGraphicsPipeline> pipeline;
+    containers::unique_ptr<vulkan::DescriptorSet> descriptor_set;
+  };
+
+  Target CreateTarget(const FormatInfo& format) {
+    const uint32_t width = app()->swapchain().width();
+    const uint32_t height = app()->swapchain().height();
+    Target target;
+    target.format = &format;
+
+    VkImageCreateInfo image_create_info = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        format.format,                        // format
+        {width, height, 1},                   // extent
+        1,                                    // mipLevels
+        1,                                    // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                // samples
+        VK_IMAGE_TILING_OPTIMAL,              // tiling
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,       // sharingMode
+        0,                               // queueFamilyIndexCount
+        nullptr,                         // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,       // initialLayout
+    };
+    target.image = app()->CreateAndBindImage(&image_create_info);
+    target.view =
+        app()->CreateImageView(target.image.get(), VK_IMAGE_VIEW_TYPE_2D,
+                               {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    // The scene of a frame must not overwrite the target before the resolve
+    // of the frame before read it, and the resolve must wait for the scene.
+    const VkSubpassDependency dependencies[2] = {
+        {
+            VK_SUBPASS_EXTERNAL,                            // srcSubpass
+            0,                                              // dstSubpass
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,          // srcStageMask
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
+            0,                                              // srcAccessMask
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,  // dstAccessMask
+            0,                                         // dependencyFlags
+        },
+        {
+            0,                                              // srcSubpass
+            VK_SUBPASS_EXTERNAL,                            // dstSubpass
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,          // dstStageMask
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,           // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT,                      // dstAccessMask
+            0,                                              // dependencyFlags
+        }};
+    target.render_pass = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                format.format,                             // format
+                VK_SAMPLE_COUNT_1_BIT,                     // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_UNDEFINED,                 // initialLayout
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {dependencies[0], dependencies[1]}    // SubpassDependencies
+            ));
+
+    ::VkImageView raw_view = *target.view;
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *target.render_pass,                        // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        width,                                      // width
+        height,                                     // height
+        1                                           // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    target.framebuffer = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+
+    target.pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app()->CreateGraphicsPipeline(scene_pipeline_layout_.get(),
+                                      target.render_pass.get(), 0));
+    target.pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                               fullscreen_vertex_shader);
+    target.pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                               scene_fragment_shader);
+    target.pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    target.pipeline->SetViewport(viewport());
+    target.pipeline->SetScissor(scissor());
+    target.pipeline->SetSamples(VK_SAMPLE_COUNT_1_BIT);
+    target.pipeline->AddAttachment(VkPipelineColorBlendAttachmentState{
+        VK_TRUE, VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO,
+        VK_BLEND_OP_ADD,
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT});
+    target.pipeline->Commit();
+
+    target.descriptor_set = containers::make_unique<vulkan::DescriptorSet>(
+        data_->allocator(), app()->AllocateDescriptorSet({resolve_binding_}));
+    VkDescriptorImageInfo image_info = {
+        *sampler_,                                 // sampler
+        *target.view,                              // imageView
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+        nullptr,                                    // pNext
+        *target.descriptor_set,                     // dstSet
+        0,                                          // dstbinding
+        0,                                          // dstArrayElement
+        1,                                          // descriptorCount
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+        &image_info,                                // pImageInfo
+        nullptr,                                    // pBufferInfo
+        nullptr,                                    // pTexelBufferView
+    };
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
+                                            nullptr);
+    return target;
+  }
+
+  // Logs the results of the frames of |target| that were measured.
+  void LogResults(const Target& target) {
+    // The presents that the display reported back while |target| was
+    // measured, which lag behind the frames by a few.
+    double present_latency = -1.0;
+    if (frame_pacer()) {
+      const vulkan::FramePacer::Statistics& statistics =
+          frame_pacer()->statistics();
+      const uint64_t num_latencies =
+          statistics.num_latencies - pacer_statistics_.num_latencies;
+      if (num_latencies > 0) {
+        present_latency = (statistics.total_latency_ns -
+                           pacer_statistics_.total_latency_ns) *
+                          1e-6 / num_latencies;
+      }
+    }
+    // The swapchain images are allocated by the platform, their size is
+    // only estimated from the format.
+    app()->GetLogger()->LogInfo(
+        "HDR: swapchain: ", FormatName(render_format()),
+        " target: ", target.format->name, " scene_ms: ",
+        num_gpu_times_ > 0 ? scene_time_ / num_gpu_times_ : -1.0,
+        " resolve_ms: ",
+        num_gpu_times_ > 0 ? resolve_time_ / num_gpu_times_ : -1.0,
+        " present_latency_ms: ", present_latency,
+        " target_MB: ", target.image->size() / (1024.0 * 1024.0),
+        " swapchain_MB: ", swapchain_size_ / (1024.0 * 1024.0));
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::VkSampler> sampler_;
+  VkDescriptorSetLayoutBinding resolve_binding_;
+  containers::unique_ptr<vulkan::PipelineLayout> scene_pipeline_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> resolve_pipeline_layout_;
+  containers::unique_ptr<vulkan::VkRenderPass> resolve_render_pass_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> resolve_pipeline_;
+  // The targets that are measured, one after the other, in the order of
+  // kFormats.
+  containers::vector<Target> targets_;
+  int32_t encoding_;
+  VkDeviceSize swapchain_size_;
+
+  uint32_t frames_per_config_;
+  size_t config_index_;
+  uint32_t config_frame_;
+  bool done_;
+  // The sums of the GPU times of the measured frames of the current
+  // target, in milliseconds.
+  double scene_time_;
+  double resolve_time_;
+  uint32_t num_gpu_times_;
+  // The statistics of the frame pacer when the current target started to
+  // be measured.
+  vulkan::FramePacer::Statistics pacer_statistics_;
+};
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  HdrFormatBenchmark sample(data);
+  if (!sample.is_valid()) {
+    data->logger()->LogInfo(
+        "The device does not support the requested swapchain format, or "
+        "VK_GOOGLE_display_timing without present_latency=0");
+    return -1;
+  }
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing() &&
+         !sample.benchmark_done()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,64 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// Encodes the scene for the swapchain. These must match Encoding in
+// main.cpp.
+const int kEncodingGamma = 0;
+const int kEncodingSrgb = 1;
+const int kEncodingPq = 2;
+const int kEncodingScRgb = 3;
+
+layout(set = 0, binding = 0) uniform sampler2D scene;
+
+// This must match ResolveData in main.cpp.
+layout(push_constant) uniform resolve_data {
+    int encoding;
+};
+
+layout(location = 0) out vec4 out_color;
+
+// The SMPTE ST 2084 encoding of |value|, of which 1.0 is 10000 nits.
+vec3 Pq(vec3 value) {
+    const float m1 = 0.1593017578125;
+    const float m2 = 78.84375;
+    const float c1 = 0.8359375;
+    const float c2 = 18.8515625;
+    const float c3 = 18.6875;
+    vec3 p = pow(clamp(value, 0.0, 1.0), vec3(m1));
+    return pow((c1 + c2 * p) / (1.0 + c3 * p), vec3(m2));
+}
+
+void main() {
+    vec3 color = texelFetch(scene, ivec2(gl_FragCoord.xy), 0).rgb;
+    if (encoding == kEncodingPq) {
+        // From the BT.709 primaries to the BT.2020 ones, with 1.0 as 100
+        // nits.
+        const mat3 bt709_to_bt2020 = mat3(
+            0.6274, 0.0691, 0.0164,
+            0.3293, 0.9195, 0.0880,
+            0.0433, 0.0114, 0.8956);
+        color = Pq(bt709_to_bt2020 * color * 0.01);
+    } else if (encoding != kEncodingScRgb) {
+        // scRGB takes the linear colors as they are, the SDR swapchains get
+        // them tone mapped.
+        color = color / (1.0 + color);
+        if (encoding == kEncodingGamma) {
+            color = pow(color, vec3(1.0 / 2.2));
+        }
+    }
+    out_color = vec4(color, 1.0);
+}
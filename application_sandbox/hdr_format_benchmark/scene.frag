@@ -0,0 +1,28 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// One of the blended layers of the scene. Every layer is brighter than the
+// one below it, so that the scene goes well beyond 1.0, which the 8-bit and
+// 10-bit targets clip and the 16-bit float target keeps.
+layout(location = 0) flat in int layer;
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    vec2 uv = gl_FragCoord.xy * 0.002 + float(layer) * 0.37;
+    vec3 color = 0.5 + 0.5 * sin(vec3(uv.x, uv.y, uv.x + uv.y) * 6.2831853);
+    out_color = vec4(color * (1.0 + 0.5 * float(layer)), 0.25);
+}
@@ -41,7 +41,7 @@ uint32_t cube_fragment_shader[] =
 
 struct CubeFrameData {
   containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
-  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  vulkan::FramebufferCache::Handle framebuffer_;
   containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
 };
 
@@ -140,6 +140,8 @@ class ImagelessFramebufferSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -192,47 +194,13 @@ class ImagelessFramebufferSample
     app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
                                             nullptr);
 
-    VkFormat format = render_format();
-
-    VkFramebufferAttachmentImageInfoKHR attachment_image_info{
-        VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO_KHR,  // sType
-        nullptr,                                                  // pNext
-        0,                                                        // flags
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,  // usage
-        app()->swapchain().width(),           // width
-        app()->swapchain().height(),          // height
-        1,                                    // layerCount
-        1,                                    // viewFormatCount
-        &format,                              // pViewFormats
-    };
-
-    VkFramebufferAttachmentsCreateInfoKHR attachment_create_info{
-        VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO_KHR,  // sType
-        nullptr,                                                    // pNext
-        1,                      // attachmentImageInfoCount
-        &attachment_image_info  // pAttachmentImageInfos
-    };
-
-    // Create a framebuffer with depth and image attachments
-    VkFramebufferCreateInfo framebuffer_create_info{
-        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
-        &attachment_create_info,                    // pNext
-        VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT_KHR,    // flags
-        *render_pass_,                              // renderPass
-        1,                                          // attachmentCount
-        nullptr,                                    // attachments
-        app()->swapchain().width(),                 // width
-        app()->swapchain().height(),                // height
-        1                                           // layers
-    };
-
-    ::VkFramebuffer raw_framebuffer;
-    app()->device()->vkCreateFramebuffer(
-        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
-    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
-        data_->allocator(),
-        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+    // The framebuffer is imageless, since the device has
+    // VK_KHR_imageless_framebuffer, so every frame shares this one.
+    LOG_ASSERT(==, data_->logger(), true,
+               app()->framebuffer_cache().imageless());
+    frame_data->framebuffer_ = app()->framebuffer_cache().Get(
+        *render_pass_, &color_attachment(frame_data), 1,
+        app()->swapchain().width(), app()->swapchain().height());
 
     (*frame_data->command_buffer_)
         ->vkBeginCommandBuffer((*frame_data->command_buffer_),
@@ -244,18 +212,14 @@ class ImagelessFramebufferSample
 
     ::VkImageView raw_view = color_view(frame_data);
 
-    VkRenderPassAttachmentBeginInfoKHR pass_begin_attachment{
-        VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO_KHR,  // sType
-        nullptr,                                                  // pNext
-        1,         // attachmentCount
-        &raw_view  // pAttachments
-    };
+    VkRenderPassAttachmentBeginInfoKHR pass_begin_attachment;
 
     VkRenderPassBeginInfo pass_begin = {
         VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        &pass_begin_attachment,                    // pNext
-        *render_pass_,                             // renderPass
-        *frame_data->framebuffer_,                 // framebuffer
+        app()->framebuffer_cache().GetAttachmentBeginInfo(
+            &pass_begin_attachment, &raw_view, 1),  // pNext
+        *render_pass_,                              // renderPass
+        frame_data->framebuffer_,                   // framebuffer
         {{0, 0},
          {app()->swapchain().width(),
           app()->swapchain().height()}},  // renderArea
@@ -288,10 +252,6 @@ class ImagelessFramebufferSample
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
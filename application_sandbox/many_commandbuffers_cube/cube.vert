@@ -26,7 +26,14 @@ layout (binding = 1, set = 0) uniform model_data {
     layout(column_major) mat4x4 transform;
 };
 
+// The center of this cube, and its scale.
+layout (push_constant) uniform object_data {
+    vec4 position_scale;
+};
+
 void main() {
-    gl_Position =  projection * transform * get_position();
+    vec3 position = (transform * get_position()).xyz;
+    gl_Position = projection *
+        vec4(position * position_scale.w + position_scale.xyz, 1.0);
     texcoord = get_texcoord();
 }
\ No newline at end of file
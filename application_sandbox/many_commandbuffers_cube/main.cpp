@@ -14,12 +14,21 @@
 
 #include "application_sandbox/sample_application_framework/sample_application.h"
 #include "support/entry/entry.h"
+#include "support/jobs/job_system.h"
 #include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/command_buffer_allocator.h"
+#include "vulkan_helpers/gpu_profiler.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/parallel_command_recorder.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 #include "mathfu/matrix.h"
 #include "mathfu/vector.h"
 
@@ -40,14 +49,50 @@ uint32_t cube_fragment_shader[] =
     ;
 
 struct ManyCommandbuffersCubeFrameData {
-  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
   containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
   containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
-  std::vector<vulkan::VkCommandBuffer> dummy_command_buffers_;
 };
 
-// Number of dummy command buffer inserted in the queue submit info.
-const int dummy_command_buffer_num = 257;
+// How the cubes of a frame are recorded and submitted.
+struct BenchmarkConfig {
+  // The number of cubes, each of which is its own draw.
+  uint32_t num_objects;
+  // The number of command buffers that the cubes are spread over. Command
+  // buffers without any cubes are still recorded and submitted.
+  uint32_t num_command_buffers;
+  // If true, the command buffers are secondary ones that are executed from
+  // a single primary, otherwise every one of them is a primary command
+  // buffer with a render pass of its own, and a submit info of its own.
+  bool secondary;
+  // The number of threads that record the command buffers.
+  uint32_t num_threads;
+};
+
+// The defaults draw one cube, and submit it with 257 command buffers that
+// have nothing to draw.
+const uint32_t kDefaultObjects = 1;
+const uint32_t kDefaultCommandBuffers = 258;
+const uint32_t kDefaultThreads = 1;
+// The frames of every configuration that are measured, after the warmup
+// frames, which let the frames in flight and the GPU times of the previous
+// configuration drain.
+const uint32_t kDefaultFramesPerConfig = 300;
+const uint32_t kWarmupFrames = 30;
+
+// The values that sweep=<axis> steps through, while every other axis keeps
+// the value of its own option.
+const uint32_t kSweepObjects[] = {1, 10, 100, 1000, 10000, 100000};
+const uint32_t kSweepCommandBuffers[] = {1, 4, 16, 64, 256, 1024};
+
+// The GPU zone that covers all of the cubes of a frame.
+const char kDrawZone[] = "Draw cubes";
+
+// The push constants of every cube, the position of its center, and its
+// scale.
+struct ObjectData {
+  float position[3];
+  float scale;
+};
 
 // This creates an application with 16MB of image memory, and defaults
 // for host, and device buffer sizes.
@@ -58,11 +103,76 @@ class ManyCommandbuffersCube
       : data_(data),
         Sample<ManyCommandbuffersCubeFrameData>(
             data->allocator(), data, 1, 512, 1, 1,
-            sample_application::SampleOptions().EnableMultisampling()),
-        cube_(data->allocator(), data->logger(), cube_data) {}
+            sample_application::SampleOptions()
+                .EnableMultisampling()
+                .EnableGpuProfiler(1)),
+        cube_(data->allocator(), data->logger(), cube_data),
+        configs_(data->allocator()),
+        objects_(data->allocator()),
+        thread_allocators_(data->allocator()),
+        command_buffers_(data->allocator()),
+        submit_infos_(data->allocator()),
+        num_swapchain_images_(0),
+        frames_per_config_(data->sample_option_uint("frames_per_config",
+                                                    kDefaultFramesPerConfig)),
+        config_index_(0),
+        config_frame_(0),
+        configured_(false),
+        sweep_(false),
+        done_(false),
+        record_time_(0.0),
+        submit_time_(0.0),
+        gpu_time_(0.0),
+        num_gpu_times_(0) {
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+    const char* secondary_option = data->sample_option("secondary");
+    const BenchmarkConfig base = {
+        data->sample_option_uint("objects", kDefaultObjects),  // num_objects
+        // num_command_buffers
+        data->sample_option_uint("command_buffers", kDefaultCommandBuffers),
+        secondary_option && strcmp(secondary_option, "0") != 0,  // secondary
+        data->sample_option_uint("threads", kDefaultThreads)  // num_threads
+    };
+
+    const char* sweep_option = data->sample_option("sweep");
+    sweep_ = sweep_option != nullptr;
+    if (!sweep_) {
+      configs_.push_back(base);
+    } else if (strcmp(sweep_option, "objects") == 0) {
+      for (uint32_t objects : kSweepObjects) {
+        configs_.push_back(base);
+        configs_.back().num_objects = objects;
+      }
+    } else if (strcmp(sweep_option, "command_buffers") == 0) {
+      for (uint32_t command_buffers : kSweepCommandBuffers) {
+        configs_.push_back(base);
+        configs_.back().num_command_buffers = command_buffers;
+      }
+    } else if (strcmp(sweep_option, "secondary") == 0) {
+      configs_.push_back(base);
+      configs_.back().secondary = false;
+      configs_.push_back(base);
+      configs_.back().secondary = true;
+    } else if (strcmp(sweep_option, "threads") == 0) {
+      const uint32_t max_threads =
+          std::max(1u, std::thread::hardware_concurrency());
+      for (uint32_t threads = 1; threads <= max_threads; threads *= 2) {
+        configs_.push_back(base);
+        configs_.back().num_threads = threads;
+      }
+    } else {
+      data->logger()->LogError("Unknown sweep axis ", sweep_option);
+      sweep_ = false;
+      configs_.push_back(base);
+    }
+  }
+
   virtual void InitializeApplicationData(
       vulkan::VkCommandBuffer* initialization_buffer,
       size_t num_swapchain_images) override {
+    num_swapchain_images_ = num_swapchain_images;
     cube_.InitializeData(app(), initialization_buffer);
 
     cube_descriptor_set_layouts_[0] = {
@@ -80,46 +190,60 @@ class ManyCommandbuffersCube
         nullptr                             // pImmutableSamplers
     };
 
+    VkPushConstantRange object_range = {
+        VK_SHADER_STAGE_VERTEX_BIT,  // stageFlags
+        0,                           // offset
+        sizeof(ObjectData)           // size
+    };
+
     pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
         data_->allocator(),
         app()->CreatePipelineLayout({{cube_descriptor_set_layouts_[0],
-                                      cube_descriptor_set_layouts_[1]}}));
+                                      cube_descriptor_set_layouts_[1]}},
+                                    {object_range}));
 
     VkAttachmentReference color_attachment = {
         0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
 
-    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
-        data_->allocator(),
-        app()->CreateRenderPass(
-            {{
-                0,                                         // flags
-                render_format(),                           // format
-                num_samples(),                             // samples
-                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
-                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
-                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
-                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
-            }},  // AttachmentDescriptions
-            {{
-                0,                                // flags
-                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
-                0,                                // inputAttachmentCount
-                nullptr,                          // pInputAttachments
-                1,                                // colorAttachmentCount
-                &color_attachment,                // colorAttachment
-                nullptr,                          // pResolveAttachments
-                nullptr,                          // pDepthStencilAttachment
-                0,                                // preserveAttachmentCount
-                nullptr                           // pPreserveAttachments
-            }},                                   // SubpassDescriptions
-            {}                                    // SubpassDependencies
-            ));
+    // Only the first render pass of a frame clears, the ones of the other
+    // primary command buffers draw on top of it.
+    VkAttachmentLoadOp load_ops[2] = {VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                      VK_ATTACHMENT_LOAD_OP_LOAD};
+    for (size_t i = 0; i < 2; ++i) {
+      render_passes_[i] = containers::make_unique<vulkan::VkRenderPass>(
+          data_->allocator(),
+          app()->CreateRenderPass(
+              {{
+                  0,                                         // flags
+                  render_format(),                           // format
+                  num_samples(),                             // samples
+                  load_ops[i],                               // loadOp
+                  VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                  VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                  VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+              }},  // AttachmentDescriptions
+              {{
+                  0,                                // flags
+                  VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                  0,                                // inputAttachmentCount
+                  nullptr,                          // pInputAttachments
+                  1,                                // colorAttachmentCount
+                  &color_attachment,                // colorAttachment
+                  nullptr,                          // pResolveAttachments
+                  nullptr,                          // pDepthStencilAttachment
+                  0,                                // preserveAttachmentCount
+                  nullptr                           // pPreserveAttachments
+              }},                                   // SubpassDescriptions
+              {}                                    // SubpassDependencies
+              ));
+    }
 
     cube_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
-        data_->allocator(), app()->CreateGraphicsPipeline(
-                                pipeline_layout_.get(), render_pass_.get(), 0));
+        data_->allocator(),
+        app()->CreateGraphicsPipeline(pipeline_layout_.get(),
+                                      render_passes_[0].get(), 0));
     cube_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
                               cube_vertex_shader);
     cube_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
@@ -139,6 +263,8 @@ class ManyCommandbuffersCube
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -146,18 +272,15 @@ class ManyCommandbuffersCube
         Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
         Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
 
-    model_data_->data().transform = Mat44::FromTranslationVector(
-        mathfu::Vector<float, 3>{0.0f, 0.0f, -3.0f});
+    // Every cube rotates around its own center, which comes from its push
+    // constants.
+    model_data_->data().transform = Mat44::Identity();
   }
 
   virtual void InitializeFrameData(
       ManyCommandbuffersCubeFrameData* frame_data,
       vulkan::VkCommandBuffer* initialization_buffer,
       size_t frame_index) override {
-    frame_data->command_buffer_ =
-        containers::make_unique<vulkan::VkCommandBuffer>(
-            data_->allocator(), app()->GetCommandBuffer());
-
     frame_data->cube_descriptor_set_ =
         containers::make_unique<vulkan::DescriptorSet>(
             data_->allocator(),
@@ -199,7 +322,7 @@ class ManyCommandbuffersCube
         VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
         nullptr,                                    // pNext
         0,                                          // flags
-        *render_pass_,                              // renderPass
+        *render_passes_[0],                         // renderPass
         1,                                          // attachmentCount
         &raw_view,                                  // attachments
         app()->swapchain().width(),                 // width
@@ -213,46 +336,6 @@ class ManyCommandbuffersCube
     frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
         data_->allocator(),
         vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
-
-    (*frame_data->command_buffer_)
-        ->vkBeginCommandBuffer((*frame_data->command_buffer_),
-                               &sample_application::kBeginCommandBuffer);
-    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
-
-    VkClearValue clear;
-    vulkan::MemoryClear(&clear);
-
-    VkRenderPassBeginInfo pass_begin = {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        nullptr,                                   // pNext
-        *render_pass_,                             // renderPass
-        *frame_data->framebuffer_,                 // framebuffer
-        {{0, 0},
-         {app()->swapchain().width(),
-          app()->swapchain().height()}},  // renderArea
-        1,                                // clearValueCount
-        &clear                            // clears
-    };
-
-    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
-                                    VK_SUBPASS_CONTENTS_INLINE);
-
-    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *cube_pipeline_);
-    cmdBuffer->vkCmdBindDescriptorSets(
-        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
-        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
-    cube_.Draw(&cmdBuffer);
-    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
-
-    (*frame_data->command_buffer_)
-        ->vkEndCommandBuffer(*frame_data->command_buffer_);
-
-    frame_data->dummy_command_buffers_.clear();
-    for (int i = 0; i < dummy_command_buffer_num; i++) {
-      frame_data->dummy_command_buffers_.push_back(app()->GetCommandBuffer());
-    }
   }
 
   virtual void Update(float time_since_last_render) override {
@@ -264,49 +347,143 @@ class ManyCommandbuffersCube
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       ManyCommandbuffersCubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
-    std::vector<VkSubmitInfo> submit_info_list;
-    for (int i = 0; i < dummy_command_buffer_num; i++) {
-      auto& cb = frame_data->dummy_command_buffers_[i];
-      cb->vkResetCommandBuffer(cb, 0);
-      cb->vkBeginCommandBuffer(cb, &sample_application::kBeginCommandBuffer);
-      cb->vkCmdSetLineWidth(cb, 1.0);
-      cb->vkEndCommandBuffer(cb);
-      VkSubmitInfo dummy_submit_info{
+    if (!configured_) {
+      Configure(configs_[config_index_]);
+    }
+    const BenchmarkConfig& config = configs_[config_index_];
+    for (auto& thread_allocator : thread_allocators_) {
+      // The last frame of this image is done, so are its command buffers.
+      thread_allocator->BeginFrame(frame_index);
+    }
+    if (secondary_recorder_) {
+      secondary_recorder_->BeginFrame(frame_index);
+    }
+
+    auto record_start = std::chrono::high_resolution_clock::now();
+    // The zone is written from command buffers of its own, so that the
+    // recording threads never touch the profiler.
+    command_buffers_.clear();
+    vulkan::VkCommandBuffer* begin_zone = app()->GetFrameCommandBuffer();
+    (*begin_zone)
+        ->vkBeginCommandBuffer(*begin_zone,
+                               &sample_application::kBeginCommandBuffer);
+    const uint32_t zone =
+        gpu_profiler()->BeginZone(begin_zone, kDrawZone, false);
+    (*begin_zone)->vkEndCommandBuffer(*begin_zone);
+    command_buffers_.push_back(begin_zone->get_command_buffer());
+
+    if (config.secondary) {
+      vulkan::VkCommandBuffer* primary = app()->GetFrameCommandBuffer();
+      (*primary)->vkBeginCommandBuffer(
+          *primary, &sample_application::kBeginCommandBuffer);
+      BeginRenderPass(primary, frame_data, true,
+                      VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+      VkCommandBufferInheritanceInfo inheritance =
+          sample_application::kInheritanceCommandBuffer;
+      inheritance.renderPass = *render_passes_[0];
+      inheritance.subpass = 0;
+      inheritance.framebuffer = *frame_data->framebuffer_;
+      secondary_recorder_->Record(
+          primary, inheritance, config.num_command_buffers,
+          [this, frame_data](size_t task, vulkan::VkCommandBuffer* cmd) {
+            RecordObjects(cmd, frame_data, task);
+          });
+      (*primary)->vkCmdEndRenderPass(*primary);
+      (*primary)->vkEndCommandBuffer(*primary);
+      command_buffers_.push_back(primary->get_command_buffer());
+    } else {
+      // Every thread records a contiguous range of the command buffers with
+      // a command pool of its own.
+      const size_t first = command_buffers_.size();
+      command_buffers_.resize(first + config.num_command_buffers,
+                              static_cast<::VkCommandBuffer>(VK_NULL_HANDLE));
+      const uint64_t num_buffers = config.num_command_buffers;
+      const uint64_t num_threads = thread_allocators_.size();
+      recording_jobs_->ParallelFor(
+          0, thread_allocators_.size(), 1,
+          [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+              for (size_t i = t * num_buffers / num_threads;
+                   i < (t + 1) * num_buffers / num_threads; ++i) {
+                vulkan::VkCommandBuffer* cmd = thread_allocators_[t]->Allocate(
+                    app()->render_queue().index());
+                (*cmd)->vkBeginCommandBuffer(
+                    *cmd, &sample_application::kBeginCommandBuffer);
+                BeginRenderPass(cmd, frame_data, i == 0,
+                                VK_SUBPASS_CONTENTS_INLINE);
+                RecordObjects(cmd, frame_data, i);
+                (*cmd)->vkCmdEndRenderPass(*cmd);
+                (*cmd)->vkEndCommandBuffer(*cmd);
+                command_buffers_[first + i] = cmd->get_command_buffer();
+              }
+            }
+          });
+    }
+
+    vulkan::VkCommandBuffer* end_zone = app()->GetFrameCommandBuffer();
+    (*end_zone)->vkBeginCommandBuffer(*end_zone,
+                                      &sample_application::kBeginCommandBuffer);
+    gpu_profiler()->EndZone(end_zone, zone);
+    (*end_zone)->vkEndCommandBuffer(*end_zone);
+    command_buffers_.push_back(end_zone->get_command_buffer());
+    auto record_end = std::chrono::high_resolution_clock::now();
+
+    // Like the command buffers, every one of them is submitted on its own.
+    submit_infos_.clear();
+    for (const ::VkCommandBuffer& command_buffer : command_buffers_) {
+      VkSubmitInfo submit_info{
           VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
           nullptr,                        // pNext
           0,                              // waitSemaphoreCount
           nullptr,                        // pWaitSemaphores
           nullptr,                        // pWaitDstStageMask,
           1,                              // commandBufferCount
-          &(cb.get_command_buffer()),
-          0,       // signalSemaphoreCount
-          nullptr  // pSignalSemaphores
+          &command_buffer,                // pCommandBuffers
+          0,                              // signalSemaphoreCount
+          nullptr                         // pSignalSemaphores
       };
-      submit_info_list.push_back(dummy_submit_info);
+      submit_infos_.push_back(submit_info);
     }
 
-    VkSubmitInfo cube_submit_info{
-        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-        nullptr,                        // pNext
-        0,                              // waitSemaphoreCount
-        nullptr,                        // pWaitSemaphores
-        nullptr,                        // pWaitDstStageMask,
-        1,                              // commandBufferCount
-        &(frame_data->command_buffer_->get_command_buffer()),
-        0,       // signalSemaphoreCount
-        nullptr  // pSignalSemaphores
-    };
-    submit_info_list.push_back(cube_submit_info);
-
     app()->render_queue()->vkQueueSubmit(
-        app()->render_queue(), submit_info_list.size(), submit_info_list.data(),
-        static_cast<VkFence>(VK_NULL_HANDLE));
+        app()->render_queue(), static_cast<uint32_t>(submit_infos_.size()),
+        submit_infos_.data(), static_cast<VkFence>(VK_NULL_HANDLE));
+    auto submit_end = std::chrono::high_resolution_clock::now();
+
+    if (config_frame_ >= kWarmupFrames) {
+      record_time_ +=
+          std::chrono::duration<double, std::milli>(record_end - record_start)
+              .count();
+      submit_time_ +=
+          std::chrono::duration<double, std::milli>(submit_end - record_end)
+              .count();
+      // The GPU time is the one of the last frame that finished.
+      const float gpu_time = gpu_profiler()->GetLastZoneTime(kDrawZone);
+      if (gpu_time >= 0.0f) {
+        gpu_time_ += gpu_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      LogResults(config);
+      config_frame_ = 0;
+      record_time_ = 0.0;
+      submit_time_ = 0.0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (sweep_) {
+        configured_ = false;
+        if (++config_index_ == configs_.size()) {
+          done_ = true;
+          config_index_ = 0;
+        }
+      }
+    }
   }
 
+  // Returns true once every configuration of a sweep has been measured.
+  bool benchmark_done() const { return done_; }
+
  private:
   struct CameraData {
     Mat44 projection_matrix;
@@ -316,15 +493,155 @@ class ManyCommandbuffersCube
     Mat44 transform;
   };
 
+  // Lays out the cubes of |config| and creates what records its command
+  // buffers. The device is idle afterwards, so that nothing of the previous
+  // configuration is in use anymore.
+  void Configure(const BenchmarkConfig& config) {
+    app()->device()->vkDeviceWaitIdle(app()->device());
+    configured_ = true;
+    secondary_recorder_.reset();
+    recording_jobs_.reset();
+    thread_allocators_.clear();
+    if (config.secondary) {
+      secondary_recorder_ =
+          containers::make_unique<vulkan::ParallelCommandRecorder>(
+              data_->allocator(), app(), config.num_threads,
+              num_swapchain_images_, app()->render_queue().index());
+    } else {
+      recording_jobs_ = containers::make_unique<jobs::JobSystem>(
+          data_->allocator(), data_->allocator(), config.num_threads);
+      for (uint32_t i = 0; i < config.num_threads; ++i) {
+        thread_allocators_.push_back(
+            containers::make_unique<vulkan::CommandBufferAllocator>(
+                data_->allocator(), data_->allocator(), &app()->device()));
+      }
+    }
+
+    // The cubes are on a square grid in front of the camera, which a single
+    // cube fills on its own.
+    const uint32_t side = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(config.num_objects))));
+    const float spacing = 4.0f / side;
+    const float scale = std::min(1.0f, 0.7f * spacing);
+    objects_.clear();
+    for (uint32_t i = 0; i < config.num_objects; ++i) {
+      const ObjectData object = {
+          {(i % side - (side - 1) * 0.5f) * spacing,
+           (i / side - (side - 1) * 0.5f) * spacing, -3.0f},  // position
+          scale                                               // scale
+      };
+      objects_.push_back(object);
+    }
+
+    app()->GetLogger()->LogInfo(
+        "Drawing ", config.num_objects, " cubes with ",
+        config.num_command_buffers,
+        config.secondary ? " secondary" : " primary",
+        " command buffers on ", config.num_threads, " threads");
+  }
+
+  void BeginRenderPass(vulkan::VkCommandBuffer* cmd,
+                       ManyCommandbuffersCubeFrameData* frame_data,
+                       bool clear, VkSubpassContents contents) {
+    VkClearValue clear_value;
+    vulkan::MemoryClear(&clear_value);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_passes_[clear ? 0 : 1],            // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear_value                      // clears
+    };
+    (*cmd)->vkCmdBeginRenderPass(*cmd, &pass_begin, contents);
+  }
+
+  // Records the cubes of command buffer |index| of the current
+  // configuration into |cmd|, which is inside the render pass. This is
+  // called from the recording threads, so it only reads shared state.
+  void RecordObjects(vulkan::VkCommandBuffer* cmd,
+                     ManyCommandbuffersCubeFrameData* frame_data,
+                     size_t index) {
+    const uint64_t num_objects = objects_.size();
+    const uint64_t num_buffers = configs_[config_index_].num_command_buffers;
+    const size_t begin = static_cast<size_t>(index * num_objects / num_buffers);
+    const size_t end =
+        static_cast<size_t>((index + 1) * num_objects / num_buffers);
+    if (begin == end) {
+      return;
+    }
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *cube_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
+    cube_.BindVertexAndIndexBuffers(&cmdBuffer);
+    const uint32_t num_indices = static_cast<uint32_t>(cube_.NumIndices());
+    for (size_t i = begin; i < end; ++i) {
+      cmdBuffer->vkCmdPushConstants(
+          cmdBuffer, ::VkPipelineLayout(*pipeline_layout_),
+          VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ObjectData), &objects_[i]);
+      cmdBuffer->vkCmdDrawIndexed(cmdBuffer, num_indices, 1, 0, 0, 0);
+    }
+  }
+
+  // Logs the average times per frame of the frames of |config| that were
+  // measured, as one point of the scaling curve.
+  void LogResults(const BenchmarkConfig& config) {
+    const double num_frames = frames_per_config_ - kWarmupFrames;
+    app()->GetLogger()->LogInfo(
+        "BENCHMARK: objects: ", config.num_objects,
+        " command_buffers: ", config.num_command_buffers,
+        " secondary: ", config.secondary ? 1 : 0,
+        " threads: ", config.num_threads,
+        " record: ", record_time_ / num_frames,
+        "ms submit: ", submit_time_ / num_frames, "ms gpu: ",
+        num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0, "ms");
+  }
+
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
-  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  // The render pass that clears, and the one that loads.
+  containers::unique_ptr<vulkan::VkRenderPass> render_passes_[2];
   VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[2];
   vulkan::VulkanModel cube_;
 
   containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
   containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+
+  // The configurations that are measured, one after the other.
+  containers::vector<BenchmarkConfig> configs_;
+  containers::vector<ObjectData> objects_;
+  // What records the command buffers of the current configuration, either
+  // the secondary recorder, or the jobs and per-thread command pools of the
+  // primary command buffers.
+  containers::unique_ptr<vulkan::ParallelCommandRecorder> secondary_recorder_;
+  containers::unique_ptr<jobs::JobSystem> recording_jobs_;
+  containers::vector<containers::unique_ptr<vulkan::CommandBufferAllocator>>
+      thread_allocators_;
+  containers::vector<::VkCommandBuffer> command_buffers_;
+  containers::vector<VkSubmitInfo> submit_infos_;
+  size_t num_swapchain_images_;
+
+  uint32_t frames_per_config_;
+  size_t config_index_;
+  uint32_t config_frame_;
+  bool configured_;
+  bool sweep_;
+  bool done_;
+  // The sums of the measured frames of the current configuration, in
+  // milliseconds.
+  double record_time_;
+  double submit_time_;
+  double gpu_time_;
+  uint32_t num_gpu_times_;
 };
 
 int main_entry(const entry::EntryData* data) {
@@ -332,7 +649,8 @@ int main_entry(const entry::EntryData* data) {
   ManyCommandbuffersCube cube(data);
   cube.Initialize();
 
-  while (!cube.should_exit() && !data->WindowClosing()) {
+  while (!cube.should_exit() && !data->WindowClosing() &&
+         !cube.benchmark_done()) {
     cube.ProcessFrame();
   }
   cube.WaitIdle();
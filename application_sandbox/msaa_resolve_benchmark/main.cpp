@@ -0,0 +1,905 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/specialization_constants.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t scene_vert[] =
+#include "scene.vert.spv"
+    ;
+
+uint32_t scene_frag[] =
+#include "scene.frag.spv"
+    ;
+
+uint32_t fullscreen_vert[] =
+#include "fullscreen.vert.spv"
+    ;
+
+uint32_t resolve_subpass_frag[] =
+#include "resolve_subpass.frag.spv"
+    ;
+
+uint32_t resolve_sampled_frag[] =
+#include "resolve_sampled.frag.spv"
+    ;
+
+namespace {
+// These must match kColumns and kRows in scene.vert.
+const uint32_t kColumns = 64;
+const uint32_t kRows = 36;
+const uint32_t kSceneVertices = kColumns * kRows * 3;
+
+const uint32_t kDefaultFrames = 16;
+// Every configuration is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 5;
+
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkFormat kDepthFormat = VK_FORMAT_D16_UNORM;
+
+const VkExtent2D kResolutions[] = {
+    {1280, 720},
+    {1920, 1080},
+    {3840, 2160},
+};
+const VkSampleCountFlagBits kSampleCounts[] = {
+    VK_SAMPLE_COUNT_1_BIT,
+    VK_SAMPLE_COUNT_2_BIT,
+    VK_SAMPLE_COUNT_4_BIT,
+    VK_SAMPLE_COUNT_8_BIT,
+};
+
+// How the multisampled color attachment is resolved.
+enum class ColorResolve {
+  // It is stored and not resolved, which every other method is compared
+  // with. This is the only method without multisampling.
+  kNone,
+  // By a resolve attachment of the subpass.
+  kRenderPass,
+  // By vkCmdResolveImage after the render pass.
+  kResolveImage,
+  // By a fragment shader in a second subpass that reads it as an input
+  // attachment.
+  kShaderSubpass,
+  // By a fragment shader in a second render pass that samples it.
+  kShaderSampled,
+};
+
+struct ColorResolveInfo {
+  ColorResolve method;
+  // The name of the method in the sample options and the results.
+  const char* name;
+};
+
+const ColorResolveInfo kColorResolves[] = {
+    {ColorResolve::kNone, "none"},
+    {ColorResolve::kRenderPass, "render_pass"},
+    {ColorResolve::kResolveImage, "resolve_image"},
+    {ColorResolve::kShaderSubpass, "shader_subpass"},
+    {ColorResolve::kShaderSampled, "shader_sampled"},
+};
+
+// The depth resolve modes, which are measured with a resolve attachment for
+// the color.
+struct DepthResolveInfo {
+  VkResolveModeFlagBitsKHR mode;
+  const char* name;
+};
+
+const DepthResolveInfo kDepthResolves[] = {
+    {VK_RESOLVE_MODE_SAMPLE_ZERO_BIT_KHR, "sample_zero"},
+    {VK_RESOLVE_MODE_MIN_BIT_KHR, "min"},
+    {VK_RESOLVE_MODE_MAX_BIT_KHR, "max"},
+    {VK_RESOLVE_MODE_AVERAGE_BIT_KHR, "average"},
+};
+
+// What one measurement renders.
+struct Config {
+  VkExtent2D extent;
+  VkSampleCountFlagBits samples;
+  ColorResolve color;
+  // VK_RESOLVE_MODE_NONE_KHR if the depth is not resolved.
+  VkResolveModeFlagBitsKHR depth_mode;
+};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+VkAttachmentDescription2KHR AttachmentDescription(
+    VkFormat format, VkSampleCountFlagBits samples, VkAttachmentLoadOp load_op,
+    VkAttachmentStoreOp store_op, VkImageLayout final_layout) {
+  return {
+      VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2_KHR,  // sType
+      nullptr,                                         // pNext
+      0,                                               // flags
+      format,                                          // format
+      samples,                                         // samples
+      load_op,                                         // loadOp
+      store_op,                                        // storeOp
+      VK_ATTACHMENT_LOAD_OP_DONT_CARE,                 // stencilLoadOp
+      VK_ATTACHMENT_STORE_OP_DONT_CARE,                // stencilStoreOp
+      VK_IMAGE_LAYOUT_UNDEFINED,                       // initialLayout
+      final_layout                                     // finalLayout
+  };
+}
+
+VkAttachmentReference2KHR AttachmentReference(uint32_t attachment,
+                                              VkImageLayout layout,
+                                              VkImageAspectFlags aspect) {
+  return {
+      VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2_KHR,  // sType
+      nullptr,                                       // pNext
+      attachment,                                    // attachment
+      layout,                                        // layout
+      aspect                                         // aspectMask
+  };
+}
+
+VkSubpassDependency2KHR SubpassDependency(
+    uint32_t src_subpass, uint32_t dst_subpass, VkPipelineStageFlags src_stage,
+    VkPipelineStageFlags dst_stage, VkAccessFlags src_access,
+    VkAccessFlags dst_access, VkDependencyFlags flags) {
+  return {
+      VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2_KHR,  // sType
+      nullptr,                                     // pNext
+      src_subpass,                                 // srcSubpass
+      dst_subpass,                                 // dstSubpass
+      src_stage,                                   // srcStageMask
+      dst_stage,                                   // dstStageMask
+      src_access,                                  // srcAccessMask
+      dst_access,                                  // dstAccessMask
+      flags,                                       // dependencyFlags
+      0                                            // viewOffset
+  };
+}
+
+VkSubpassDescription2KHR SubpassDescription(
+    const void* next, uint32_t num_inputs,
+    const VkAttachmentReference2KHR* inputs,
+    const VkAttachmentReference2KHR* color,
+    const VkAttachmentReference2KHR* resolve,
+    const VkAttachmentReference2KHR* depth) {
+  return {
+      VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2_KHR,  // sType
+      next,                                         // pNext
+      0,                                            // flags
+      VK_PIPELINE_BIND_POINT_GRAPHICS,              // pipelineBindPoint
+      0,                                            // viewMask
+      num_inputs,                                   // inputAttachmentCount
+      inputs,                                       // pInputAttachments
+      1,                                            // colorAttachmentCount
+      color,                                        // pColorAttachments
+      resolve,                                      // pResolveAttachments
+      depth,                                        // pDepthStencilAttachment
+      0,                                            // preserveAttachmentCount
+      nullptr                                       // pPreserveAttachments
+  };
+}
+
+// Every frame waits for the attachments of the frame before.
+VkSubpassDependency2KHR FrameDependency(uint32_t dst_subpass) {
+  return SubpassDependency(
+      VK_SUBPASS_EXTERNAL, dst_subpass,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+          VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      0);
+}
+
+// Renders a scene with many edges with every sample count, and resolves it
+// in every way, and measures the GPU time of a frame.
+class MsaaResolveBenchmark {
+ public:
+  MsaaResolveBenchmark(const entry::EntryData* data,
+                       vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        frames_(data->sample_option_uint("frames", kDefaultFrames)),
+        only_samples_(data->sample_option_uint("samples", 0)),
+        timestamp_mask_(0),
+        supported_depth_modes_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        sampler_(vulkan::CreateSampler(&app->device(), VK_FILTER_NEAREST,
+                                       VK_FILTER_NEAREST)) {
+    VkPhysicalDeviceDepthStencilResolvePropertiesKHR resolve_properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES_KHR,
+        nullptr,   // pNext
+        0,         // supportedDepthResolveModes
+        0,         // supportedStencilResolveModes
+        VK_FALSE,  // independentResolveNone
+        VK_FALSE   // independentResolve
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        &resolve_properties  // pNext
+    };
+    app->instance()->vkGetPhysicalDeviceProperties2KHR(
+        app->device().physical_device(), &properties);
+    supported_depth_modes_ = resolve_properties.supportedDepthResolveModes;
+
+    input_binding_ = {
+        0,                                    // binding
+        VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,  // descriptorType
+        1,                                    // descriptorCount
+        VK_SHADER_STAGE_FRAGMENT_BIT,         // stageFlags
+        nullptr                               // pImmutableSamplers
+    };
+    sampled_binding_ = {
+        0,                                          // binding
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+        1,                                          // descriptorCount
+        VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+        nullptr                                     // pImmutableSamplers
+    };
+    scene_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(), app->CreatePipelineLayout({{}}));
+    input_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(), app->CreatePipelineLayout({{input_binding_}}));
+    sampled_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(), app->CreatePipelineLayout({{sampled_binding_}}));
+  }
+
+  // Measures every configuration, or only those with the color method or
+  // "depth" named |only| and their baselines, and logs the results.
+  void Run(const char* only) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    const VkPhysicalDeviceLimits& limits = app_->device().limits();
+    const VkSampleCountFlags framebuffer_samples =
+        limits.framebufferColorSampleCounts &
+        limits.framebufferDepthSampleCounts;
+    for (const VkExtent2D& extent : kResolutions) {
+      if (extent.width > limits.maxFramebufferWidth ||
+          extent.height > limits.maxFramebufferHeight) {
+        continue;
+      }
+      for (VkSampleCountFlagBits samples : kSampleCounts) {
+        if ((framebuffer_samples & samples) == 0 ||
+            (only_samples_ != 0 && only_samples_ != samples)) {
+          continue;
+        }
+        Config config = {extent, samples, ColorResolve::kNone,
+                         VK_RESOLVE_MODE_NONE_KHR};
+        const double baseline = Measure(config);
+        Log(config, "none", "none", baseline, baseline);
+        if (samples == VK_SAMPLE_COUNT_1_BIT) {
+          continue;
+        }
+        for (const ColorResolveInfo& info : kColorResolves) {
+          if (info.method == ColorResolve::kNone ||
+              (only && strcmp(only, info.name) != 0)) {
+            continue;
+          }
+          if (info.method == ColorResolve::kShaderSampled &&
+              (limits.sampledImageColorSampleCounts & samples) == 0) {
+            continue;
+          }
+          config.color = info.method;
+          Log(config, info.name, "none", Measure(config), baseline);
+        }
+        if (only && strcmp(only, "depth") != 0) {
+          continue;
+        }
+        config.color = ColorResolve::kRenderPass;
+        for (const DepthResolveInfo& info : kDepthResolves) {
+          if ((supported_depth_modes_ & info.mode) == 0) {
+            continue;
+          }
+          config.depth_mode = info.mode;
+          Log(config, "render_pass", info.name, Measure(config), baseline);
+        }
+      }
+    }
+  }
+
+ private:
+  // The images of a configuration.
+  enum Image { kColor, kDepth, kResolvedColor, kResolvedDepth, kNumImages };
+
+  // Everything that a frame of a configuration is rendered with.
+  struct Frame {
+    containers::unique_ptr<vulkan::VulkanApplication::Image>
+        images[kNumImages];
+    containers::unique_ptr<vulkan::VkImageView> views[kNumImages];
+    // The second render pass and framebuffer are only used by
+    // ColorResolve::kShaderSampled.
+    containers::unique_ptr<vulkan::VkRenderPass> render_passes[2];
+    containers::unique_ptr<vulkan::VkFramebuffer> framebuffers[2];
+    containers::unique_ptr<vulkan::VulkanGraphicsPipeline> scene_pipeline;
+    // Only used by the shader resolves.
+    containers::unique_ptr<vulkan::VulkanGraphicsPipeline> resolve_pipeline;
+    containers::unique_ptr<vulkan::DescriptorSet> set;
+  };
+
+  void Log(const Config& config, const char* color, const char* depth,
+           double ns, double baseline_ns) {
+    data_->logger()->LogInfo(
+        "MSAA: width: ", config.extent.width,
+        " height: ", config.extent.height,
+        " samples: ", static_cast<uint32_t>(config.samples),
+        " color: ", color, " depth: ", depth,
+        " ms_per_frame: ", ns < 0.0 ? -1.0 : ns / frames_ / 1.0e6,
+        " resolve_ms: ",
+        ns < 0.0 || baseline_ns < 0.0 ? -1.0
+                                      : (ns - baseline_ns) / frames_ / 1.0e6);
+  }
+
+  void CreateImage(const Config& config, Image image, VkFormat format,
+                   VkSampleCountFlagBits samples, VkImageUsageFlags usage,
+                   Frame* frame) {
+    const VkExtent3D extent = {config.extent.width, config.extent.height, 1};
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        format,                               // format
+        extent,                               // extent
+        1,                                    // mipLevels
+        1,                                    // arrayLayers
+        samples,                              // samples
+        VK_IMAGE_TILING_OPTIMAL,              // tiling
+        usage,                                // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    frame->images[image] = app_->CreateAndBindImage(&image_create_info);
+    frame->views[image] = app_->CreateImageView(
+        frame->images[image].get(), VK_IMAGE_VIEW_TYPE_2D,
+        {static_cast<VkImageAspectFlags>(format == kDepthFormat
+                                             ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                             : VK_IMAGE_ASPECT_COLOR_BIT),
+         0, 1, 0, 1});
+  }
+
+  // Creates the images of |config|. The multisampled attachments are
+  // transient unless they are stored.
+  void CreateImages(const Config& config, Frame* frame) {
+    VkImageUsageFlags color_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    switch (config.color) {
+      case ColorResolve::kNone:
+        break;
+      case ColorResolve::kRenderPass:
+        color_usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        break;
+      case ColorResolve::kResolveImage:
+        color_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        break;
+      case ColorResolve::kShaderSubpass:
+        color_usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT |
+                       VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        break;
+      case ColorResolve::kShaderSampled:
+        color_usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        break;
+    }
+    CreateImage(config, kColor, kColorFormat, config.samples, color_usage,
+                frame);
+    CreateImage(config, kDepth, kDepthFormat, config.samples,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                frame);
+    if (config.color != ColorResolve::kNone) {
+      CreateImage(config, kResolvedColor, kColorFormat, VK_SAMPLE_COUNT_1_BIT,
+                  config.color == ColorResolve::kResolveImage
+                      ? VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                      : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                  frame);
+    }
+    if (config.depth_mode != VK_RESOLVE_MODE_NONE_KHR) {
+      CreateImage(config, kResolvedDepth, kDepthFormat, VK_SAMPLE_COUNT_1_BIT,
+                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, frame);
+    }
+  }
+
+  vulkan::VkRenderPass CreateRenderPass(
+      const containers::vector<VkAttachmentDescription2KHR>& attachments,
+      const containers::vector<VkSubpassDescription2KHR>& subpasses,
+      const containers::vector<VkSubpassDependency2KHR>& dependencies) {
+    vulkan::VkDevice& device = app_->device();
+    VkRenderPassCreateInfo2KHR create_info{
+        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2_KHR,  // sType
+        nullptr,                                          // pNext
+        0,                                                // flags
+        static_cast<uint32_t>(attachments.size()),        // attachmentCount
+        attachments.data(),                               // pAttachments
+        static_cast<uint32_t>(subpasses.size()),          // subpassCount
+        subpasses.data(),                                 // pSubpasses
+        static_cast<uint32_t>(dependencies.size()),       // dependencyCount
+        dependencies.data(),                              // pDependencies
+        0,       // correlatedViewMaskCount
+        nullptr  // pCorrelatedViewMasks
+    };
+    ::VkRenderPass render_pass;
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkCreateRenderPass2KHR(device, &create_info, nullptr,
+                                              &render_pass));
+    return vulkan::VkRenderPass(render_pass, nullptr, &device);
+  }
+
+  vulkan::VkFramebuffer CreateFramebuffer(
+      const Config& config, const vulkan::VkRenderPass& render_pass,
+      const containers::vector<::VkImageView>& views) {
+    vulkan::VkDevice& device = app_->device();
+    VkFramebufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        render_pass,                                // renderPass
+        static_cast<uint32_t>(views.size()),        // attachmentCount
+        views.data(),                               // pAttachments
+        config.extent.width,                        // width
+        config.extent.height,                       // height
+        1                                           // layers
+    };
+    ::VkFramebuffer framebuffer;
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkCreateFramebuffer(device, &create_info, nullptr,
+                                           &framebuffer));
+    return vulkan::VkFramebuffer(framebuffer, nullptr, &device);
+  }
+
+  // Creates the render passes and framebuffers of |config|.
+  void CreateRenderPasses(const Config& config, Frame* frame) {
+    containers::Allocator* allocator = data_->allocator();
+    const bool in_pass_color = config.color == ColorResolve::kRenderPass ||
+                               config.color == ColorResolve::kShaderSubpass;
+    VkAttachmentStoreOp color_store_op = VK_ATTACHMENT_STORE_OP_STORE;
+    VkImageLayout color_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    if (in_pass_color) {
+      color_store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    } else if (config.color == ColorResolve::kResolveImage) {
+      color_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    } else if (config.color == ColorResolve::kShaderSampled) {
+      color_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    containers::vector<VkAttachmentDescription2KHR> attachments(allocator);
+    containers::vector<::VkImageView> views(allocator);
+    attachments.push_back(AttachmentDescription(
+        kColorFormat, config.samples, VK_ATTACHMENT_LOAD_OP_CLEAR,
+        color_store_op, color_layout));
+    views.push_back(*frame->views[kColor]);
+    attachments.push_back(AttachmentDescription(
+        kDepthFormat, config.samples, VK_ATTACHMENT_LOAD_OP_CLEAR,
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+    views.push_back(*frame->views[kDepth]);
+
+    const VkAttachmentReference2KHR color_reference = AttachmentReference(
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+    const VkAttachmentReference2KHR depth_reference = AttachmentReference(
+        1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_ASPECT_DEPTH_BIT);
+    const VkAttachmentReference2KHR input_reference = AttachmentReference(
+        0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+    VkAttachmentReference2KHR resolved_color_reference =
+        AttachmentReference(VK_ATTACHMENT_UNUSED,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                            VK_IMAGE_ASPECT_COLOR_BIT);
+    VkAttachmentReference2KHR resolved_depth_reference = AttachmentReference(
+        VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_ASPECT_DEPTH_BIT);
+    if (in_pass_color) {
+      resolved_color_reference.attachment =
+          static_cast<uint32_t>(attachments.size());
+      attachments.push_back(AttachmentDescription(
+          kColorFormat, VK_SAMPLE_COUNT_1_BIT,
+          VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+      views.push_back(*frame->views[kResolvedColor]);
+    }
+    if (config.depth_mode != VK_RESOLVE_MODE_NONE_KHR) {
+      resolved_depth_reference.attachment =
+          static_cast<uint32_t>(attachments.size());
+      attachments.push_back(AttachmentDescription(
+          kDepthFormat, VK_SAMPLE_COUNT_1_BIT,
+          VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+      views.push_back(*frame->views[kResolvedDepth]);
+    }
+    VkSubpassDescriptionDepthStencilResolveKHR depth_resolve = {
+        VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE_KHR,
+        nullptr,                   // pNext
+        config.depth_mode,         // depthResolveMode
+        VK_RESOLVE_MODE_NONE_KHR,  // stencilResolveMode
+        &resolved_depth_reference  // pDepthStencilResolveAttachment
+    };
+
+    containers::vector<VkSubpassDescription2KHR> subpasses(allocator);
+    containers::vector<VkSubpassDependency2KHR> dependencies(allocator);
+    subpasses.push_back(SubpassDescription(
+        config.depth_mode != VK_RESOLVE_MODE_NONE_KHR ? &depth_resolve
+                                                      : nullptr,
+        0, nullptr, &color_reference,
+        config.color == ColorResolve::kRenderPass ? &resolved_color_reference
+                                                  : nullptr,
+        &depth_reference));
+    dependencies.push_back(FrameDependency(0));
+    switch (config.color) {
+      case ColorResolve::kNone:
+      case ColorResolve::kRenderPass:
+        break;
+      case ColorResolve::kResolveImage:
+        dependencies.push_back(SubpassDependency(
+            0, VK_SUBPASS_EXTERNAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            0));
+        break;
+      case ColorResolve::kShaderSubpass:
+        // The resolve of a pixel only reads the samples of the same pixel,
+        // so they can stay in tile memory.
+        subpasses.push_back(SubpassDescription(nullptr, 1, &input_reference,
+                                               &resolved_color_reference,
+                                               nullptr, nullptr));
+        dependencies.push_back(SubpassDependency(
+            0, 1, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, VK_DEPENDENCY_BY_REGION_BIT));
+        dependencies.push_back(FrameDependency(1));
+        break;
+      case ColorResolve::kShaderSampled:
+        dependencies.push_back(SubpassDependency(
+            0, VK_SUBPASS_EXTERNAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            0));
+        break;
+    }
+    frame->render_passes[0] = containers::make_unique<vulkan::VkRenderPass>(
+        allocator, CreateRenderPass(attachments, subpasses, dependencies));
+    frame->framebuffers[0] = containers::make_unique<vulkan::VkFramebuffer>(
+        allocator, CreateFramebuffer(config, *frame->render_passes[0], views));
+
+    if (config.color == ColorResolve::kShaderSampled) {
+      attachments.clear();
+      subpasses.clear();
+      dependencies.clear();
+      views.clear();
+      attachments.push_back(AttachmentDescription(
+          kColorFormat, VK_SAMPLE_COUNT_1_BIT,
+          VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+      resolved_color_reference.attachment = 0;
+      subpasses.push_back(SubpassDescription(
+          nullptr, 0, nullptr, &resolved_color_reference, nullptr, nullptr));
+      dependencies.push_back(FrameDependency(0));
+      views.push_back(*frame->views[kResolvedColor]);
+      frame->render_passes[1] = containers::make_unique<vulkan::VkRenderPass>(
+          allocator, CreateRenderPass(attachments, subpasses, dependencies));
+      frame->framebuffers[1] = containers::make_unique<vulkan::VkFramebuffer>(
+          allocator,
+          CreateFramebuffer(config, *frame->render_passes[1], views));
+    }
+  }
+
+  // Creates the pipelines of |config|, and the set that the shader resolves
+  // read the samples through.
+  void CreatePipelines(const Config& config, Frame* frame) {
+    const VkViewport viewport = {
+        0.0f,                                      // x
+        0.0f,                                      // y
+        static_cast<float>(config.extent.width),   // width
+        static_cast<float>(config.extent.height),  // height
+        0.0f,                                      // minDepth
+        1.0f                                       // maxDepth
+    };
+    const VkRect2D scissor = {{0, 0}, config.extent};
+
+    frame->scene_pipeline =
+        containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+            data_->allocator(),
+            app_->CreateGraphicsPipeline(scene_layout_.get(),
+                                         frame->render_passes[0].get(), 0));
+    frame->scene_pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                                     scene_vert);
+    frame->scene_pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                     scene_frag);
+    frame->scene_pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    frame->scene_pipeline->SetCullMode(VK_CULL_MODE_NONE);
+    frame->scene_pipeline->SetViewport(viewport);
+    frame->scene_pipeline->SetScissor(scissor);
+    frame->scene_pipeline->SetSamples(config.samples);
+    frame->scene_pipeline->AddAttachment();
+    frame->scene_pipeline->Commit();
+
+    const bool subpass = config.color == ColorResolve::kShaderSubpass;
+    if (!subpass && config.color != ColorResolve::kShaderSampled) {
+      return;
+    }
+    vulkan::PipelineLayout* layout =
+        subpass ? input_layout_.get() : sampled_layout_.get();
+    const VkDescriptorSetLayoutBinding& binding =
+        subpass ? input_binding_ : sampled_binding_;
+    frame->resolve_pipeline =
+        containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+            data_->allocator(),
+            app_->CreateGraphicsPipeline(
+                layout, frame->render_passes[subpass ? 0 : 1].get(),
+                subpass ? 1 : 0));
+    vulkan::SpecializationConstants constants(data_->allocator());
+    constants.Set(0, static_cast<int32_t>(config.samples));
+    frame->resolve_pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                                       fullscreen_vert);
+    if (subpass) {
+      frame->resolve_pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                         resolve_subpass_frag, &constants);
+    } else {
+      frame->resolve_pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                         resolve_sampled_frag, &constants);
+    }
+    frame->resolve_pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    frame->resolve_pipeline->SetCullMode(VK_CULL_MODE_NONE);
+    frame->resolve_pipeline->SetViewport(viewport);
+    frame->resolve_pipeline->SetScissor(scissor);
+    frame->resolve_pipeline->SetSamples(VK_SAMPLE_COUNT_1_BIT);
+    frame->resolve_pipeline->AddAttachment();
+    frame->resolve_pipeline->Commit();
+
+    frame->set = containers::make_unique<vulkan::DescriptorSet>(
+        data_->allocator(), app_->AllocateDescriptorSet({binding}));
+    VkDescriptorImageInfo image_info = {
+        subpass ? static_cast<::VkSampler>(VK_NULL_HANDLE)
+                : static_cast<::VkSampler>(sampler_),  // sampler
+        *frame->views[kColor],                         // imageView
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,      // imageLayout
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *frame->set,                             // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        1,                                       // descriptorCount
+        binding.descriptorType,                  // descriptorType
+        &image_info,                             // pImageInfo
+        nullptr,                                 // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    app_->device()->vkUpdateDescriptorSets(app_->device(), 1, &write, 0,
+                                           nullptr);
+  }
+
+  // Records the scene and the resolve of one frame.
+  void RecordFrame(vulkan::VkCommandBuffer* cmd, const Config& config,
+                   const Frame& frame) {
+    VkClearValue clear_values[2];
+    clear_values[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    clear_values[1].depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *frame.render_passes[0],                   // renderPass
+        *frame.framebuffers[0],                    // framebuffer
+        {{0, 0}, config.extent},                   // renderArea
+        2,                                         // clearValueCount
+        clear_values                               // pClearValues
+    };
+    (*cmd)->vkCmdBeginRenderPass(*cmd, &begin_info,
+                                 VK_SUBPASS_CONTENTS_INLINE);
+    (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              *frame.scene_pipeline);
+    (*cmd)->vkCmdDraw(*cmd, kSceneVertices, 1, 0, 0);
+
+    switch (config.color) {
+      case ColorResolve::kNone:
+      case ColorResolve::kRenderPass:
+        (*cmd)->vkCmdEndRenderPass(*cmd);
+        break;
+      case ColorResolve::kResolveImage: {
+        (*cmd)->vkCmdEndRenderPass(*cmd);
+        // The resolve of the frame before is overwritten.
+        VkImageMemoryBarrier barrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+            nullptr,                                 // pNext
+            0,                                       // srcAccessMask
+            VK_ACCESS_TRANSFER_WRITE_BIT,            // dstAccessMask
+            VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,    // newLayout
+            VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+            *frame.images[kResolvedColor],           // image
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}  // subresourceRange
+        };
+        (*cmd)->vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                     nullptr, 0, nullptr, 1, &barrier);
+        VkImageResolve region = {
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // srcSubresource
+            {0, 0, 0},                             // srcOffset
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // dstSubresource
+            {0, 0, 0},                             // dstOffset
+            {config.extent.width, config.extent.height, 1}  // extent
+        };
+        (*cmd)->vkCmdResolveImage(
+            *cmd, *frame.images[kColor], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            *frame.images[kResolvedColor],
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        break;
+      }
+      case ColorResolve::kShaderSubpass:
+        (*cmd)->vkCmdNextSubpass(*cmd, VK_SUBPASS_CONTENTS_INLINE);
+        RecordShaderResolve(cmd, frame, *input_layout_);
+        (*cmd)->vkCmdEndRenderPass(*cmd);
+        break;
+      case ColorResolve::kShaderSampled:
+        (*cmd)->vkCmdEndRenderPass(*cmd);
+        begin_info.renderPass = *frame.render_passes[1];
+        begin_info.framebuffer = *frame.framebuffers[1];
+        begin_info.clearValueCount = 0;
+        begin_info.pClearValues = nullptr;
+        (*cmd)->vkCmdBeginRenderPass(*cmd, &begin_info,
+                                     VK_SUBPASS_CONTENTS_INLINE);
+        RecordShaderResolve(cmd, frame, *sampled_layout_);
+        (*cmd)->vkCmdEndRenderPass(*cmd);
+        break;
+    }
+  }
+
+  void RecordShaderResolve(vulkan::VkCommandBuffer* cmd, const Frame& frame,
+                           const vulkan::PipelineLayout& layout) {
+    (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              *frame.resolve_pipeline);
+    (*cmd)->vkCmdBindDescriptorSets(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    layout, 0, 1, &frame.set->raw_set(), 0,
+                                    nullptr);
+    (*cmd)->vkCmdDraw(*cmd, 3, 1, 0, 0);
+  }
+
+  // Returns the fastest of kNumRuns runs of frames_ frames of |config|, in
+  // nanoseconds, or a negative number if it could not be measured.
+  double Measure(const Config& config) {
+    Frame frame;
+    CreateImages(config, &frame);
+    CreateRenderPasses(config, &frame);
+    CreatePipelines(config, &frame);
+
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               query_pool_, 0);
+      for (uint32_t i = 0; i < frames_; ++i) {
+        RecordFrame(&cmd, config, frame);
+      }
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      cmd->vkEndCommandBuffer(cmd);
+
+      VkSubmitInfo submit_info = {
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+          nullptr,                        // pNext
+          0,                              // waitSemaphoreCount
+          nullptr,                        // pWaitSemaphores
+          nullptr,                        // pWaitDstStageMask
+          1,                              // commandBufferCount
+          &cmd.get_command_buffer(),      // pCommandBuffers
+          0,                              // signalSemaphoreCount
+          nullptr                         // pSignalSemaphores
+      };
+      queue->vkQueueSubmit(queue, 1, &submit_info, ::VkFence(0));
+      queue->vkQueueWaitIdle(queue);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    return best;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t frames_;
+  // 0 to measure every sample count.
+  uint32_t only_samples_;
+  uint64_t timestamp_mask_;
+  VkResolveModeFlagsKHR supported_depth_modes_;
+  vulkan::VkQueryPool query_pool_;
+  vulkan::VkSampler sampler_;
+  VkDescriptorSetLayoutBinding input_binding_;
+  VkDescriptorSetLayoutBinding sampled_binding_;
+  containers::unique_ptr<vulkan::PipelineLayout> scene_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> input_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> sampled_layout_;
+};
+}  // anonymous namespace
+
+// This sample renders a scene where most pixels are on an edge with 1, 2, 4
+// and 8 samples at several resolutions, and resolves it with every method
+// and every supported depth resolve mode. For every configuration it logs:
+//   MSAA: width: <n> height: <n> samples: <n> color: <method>
+//       depth: <mode> ms_per_frame: <ms> resolve_ms: <ms>
+// where resolve_ms is the difference to the same sample count stored
+// without a resolve. -sample-option=method=<name> only measures one color
+// method, or the depth modes with "depth", samples only one sample count,
+// and frames sets the number of frames of every run.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data,
+      {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+      {VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME,
+       VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+       VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME});
+  MsaaResolveBenchmark benchmark(data, &app);
+  benchmark.Run(data->sample_option("method"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,33 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// Averages the samples of the multisampled color image that a render pass
+// before stored.
+layout(constant_id = 0) const int kSamples = 4;
+
+layout(set = 0, binding = 0) uniform sampler2DMS color;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 sum = vec4(0.0);
+    for (int i = 0; i < kSamples; ++i) {
+        sum += texelFetch(color, texel, i);
+    }
+    out_color = sum / float(kSamples);
+}
@@ -0,0 +1,36 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// A grid of small overlapping triangles at different depths, so that most
+// pixels are on an edge. These must match kColumns and kRows in main.cpp.
+const uint kColumns = 64;
+const uint kRows = 36;
+
+layout(location = 0) out vec3 color;
+
+void main() {
+    uint triangle = uint(gl_VertexIndex) / 3;
+    uint corner = uint(gl_VertexIndex) % 3;
+    vec2 grid = vec2(kColumns, kRows);
+    vec2 cell = vec2(triangle % kColumns, triangle / kColumns);
+    vec2 center = (cell + 0.5) / grid * 2.0 - 1.0;
+    float angle = float(triangle) * 2.3999632 + float(corner) * 2.0943951;
+    vec2 offset = 1.5 / grid * vec2(cos(angle), sin(angle));
+    float depth = fract(float(triangle) * 0.618034);
+    gl_Position = vec4(center + offset, depth, 1.0);
+    color = vec3(fract(cell / grid * 3.0), depth);
+}
@@ -17,6 +17,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/specialization_constants.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 #include "vulkan_helpers/vulkan_texture.h"
@@ -24,11 +25,8 @@
 #include "particle_data_shared.h"
 
 #include <chrono>
-
-#include <condition_variable>
-#include <functional>
-#include <mutex>
-#include <thread>
+#include <cstdlib>
+#include <cstring>
 
 const VkCommandBufferBeginInfo kBeginCommandBuffer = {
     VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
@@ -76,10 +74,6 @@ const uint32_t kMaskGPUAll = 1 << 0 | 1 << 1;
 const uint32_t kGPU0 = 0;
 const uint32_t kGPU1 = 1;
 
-const uint32_t kAllOn0Indices[] = {0, 0};
-const uint32_t kAllOn1Indices[] = {1, 1};
-const uint32_t kDefaultIndices[] = {0, 1};
-
 const VkDeviceGroupCommandBufferBeginInfo kDeviceGroupBeginCommandBufferOn0 = {
     VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO,  // sType
     nullptr,                                                   // pNext
@@ -93,6 +87,146 @@ const VkCommandBufferBeginInfo kBeginCommandBufferOn0 = {
     nullptr                                       // pInheritanceInfo
 };
 
+const VkDeviceGroupCommandBufferBeginInfo kDeviceGroupBeginCommandBufferOn1 = {
+    VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                                   // pNext
+    kMaskGPU1,                                                 // deviceMask
+};
+
+const VkCommandBufferBeginInfo kBeginCommandBufferOn1 = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    &kDeviceGroupBeginCommandBufferOn1,           // pNext
+    0,                                            // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// How the work of every frame is distributed over the two GPUs. GPU0 always
+// presents, whatever GPU1 draws is copied to GPU0 through peer memory.
+enum class WorkMode {
+  // Everything runs on GPU0. This is the baseline for the other modes.
+  kSingleGPU,
+  // GPU1 simulates, and copies the particles to GPU0, which draws them.
+  kSimulateRender,
+  // The GPUs take turns simulating and drawing whole frames. The simulation
+  // is copied to the other GPU after every step, since each step depends on
+  // the one before it.
+  kAlternateFrame,
+  // Each GPU simulates half of the particles, and copies them to the other
+  // GPU. GPU0 draws all of them.
+  kSplitSimulation,
+  // Like kSplitSimulation, but each GPU also draws one half of the frame.
+  kSplitFrame,
+};
+
+struct WorkModeInfo {
+  const char* name;
+  WorkMode mode;
+  // The number of GPUs that do work in this mode.
+  uint32_t num_gpus;
+};
+
+const WorkModeInfo kWorkModes[] = {
+    {"single", WorkMode::kSingleGPU, 1},
+    {"simulate_render", WorkMode::kSimulateRender, 2},
+    {"afr", WorkMode::kAlternateFrame, 2},
+    {"split_simulation", WorkMode::kSplitSimulation, 2},
+    {"split_frame", WorkMode::kSplitFrame, 2},
+};
+const size_t kNumWorkModes = sizeof(kWorkModes) / sizeof(kWorkModes[0]);
+// The kSimulateRender mode, which is what this sample always did.
+const size_t kDefaultWorkMode = 1;
+
+// The frames at the start of every mode that are not timed, so that the
+// handover from the last mode does not count.
+const uint64_t kWarmupFrames = 60;
+const uint64_t kDefaultFramesPerMode = 600;
+
+// Returns the GPUs that have to have the current simulation before the first
+// frame of |mode|.
+uint32_t GetFirstSimulationMask(WorkMode mode) {
+  switch (mode) {
+    case WorkMode::kSingleGPU:
+    case WorkMode::kAlternateFrame:
+      return kMaskGPU0;
+    case WorkMode::kSimulateRender:
+      return kMaskGPU1;
+    case WorkMode::kSplitSimulation:
+    case WorkMode::kSplitFrame:
+      return kMaskGPUAll;
+  }
+  return kMaskGPUAll;
+}
+
+const size_t kMaxBatches = 4;
+
+// One batch of a submission, which runs |command_buffer| on the GPUs of
+// |device_mask|. Every semaphore is waited for, or signaled, by one GPU.
+struct SubmitBatch {
+  SubmitBatch() : SubmitBatch(VK_NULL_HANDLE, 0) {}
+  SubmitBatch(::VkCommandBuffer command_buffer, uint32_t device_mask)
+      : command_buffer(command_buffer),
+        device_mask(device_mask),
+        num_waits(0),
+        num_signals(0) {}
+
+  void Wait(::VkSemaphore semaphore, VkPipelineStageFlags stages,
+            uint32_t device) {
+    wait_semaphores[num_waits] = semaphore;
+    wait_stages[num_waits] = stages;
+    wait_devices[num_waits++] = device;
+  }
+  void Signal(::VkSemaphore semaphore, uint32_t device) {
+    signal_semaphores[num_signals] = semaphore;
+    signal_devices[num_signals++] = device;
+  }
+
+  ::VkCommandBuffer command_buffer;
+  uint32_t device_mask;
+  ::VkSemaphore wait_semaphores[2];
+  VkPipelineStageFlags wait_stages[2];
+  uint32_t wait_devices[2];
+  uint32_t num_waits;
+  ::VkSemaphore signal_semaphores[2];
+  uint32_t signal_devices[2];
+  uint32_t num_signals;
+};
+
+// Submits all |batches| to |queue| at once, and signals |fence| when all of
+// them are done.
+void SubmitBatches(vulkan::VulkanApplication* app, vulkan::VkQueue* queue,
+                   const SubmitBatch* batches, size_t num_batches,
+                   ::VkFence fence) {
+  VkDeviceGroupSubmitInfo group_submit_infos[kMaxBatches];
+  VkSubmitInfo submit_infos[kMaxBatches];
+  for (size_t i = 0; i < num_batches; ++i) {
+    const SubmitBatch& batch = batches[i];
+    group_submit_infos[i] = {
+        VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO,  // sType
+        nullptr,                                     // pNext
+        batch.num_waits,                             // waitSemaphoreCount
+        batch.wait_devices,    // pWaitSemaphoreDeviceIndices
+        1,                     // commandBufferCount
+        &batch.device_mask,    // pCommandBufferDeviceMasks
+        batch.num_signals,     // signalSemaphoreCount
+        batch.signal_devices,  // pSignalSemaphoreDeviceIndices
+    };
+    submit_infos[i] = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        &group_submit_infos[i],         // pNext
+        batch.num_waits,                // waitSemaphoreCount
+        batch.wait_semaphores,          // pWaitSemaphores
+        batch.wait_stages,              // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &batch.command_buffer,          // pCommandBuffers
+        batch.num_signals,              // signalSemaphoreCount
+        batch.signal_semaphores,        // pSignalSemaphores
+    };
+  }
+  LOG_ASSERT(==, app->GetLogger(), VK_SUCCESS,
+             (*queue)->vkQueueSubmit(*queue, static_cast<uint32_t>(num_batches),
+                                     submit_infos, fence));
+}
+
 int main_entry(const entry::EntryData* data) {
   auto* allocator = data->allocator();
   data->logger()->LogInfo("Application Startup");
@@ -105,6 +239,36 @@ int main_entry(const entry::EntryData* data) {
   vulkan::VkDevice& device = app.device();
   vulkan::VkQueue& render_queue = app.render_queue();
 
+  size_t mode_index = kDefaultWorkMode;
+  // Whether every mode is run in turn, to compare them.
+  bool sweep = false;
+  const char* mode_option = data->sample_option("mode");
+  if (mode_option && strcmp(mode_option, "sweep") == 0) {
+    sweep = true;
+    mode_index = 0;
+  } else if (mode_option) {
+    size_t i = 0;
+    while (i < kNumWorkModes && strcmp(mode_option, kWorkModes[i].name) != 0) {
+      ++i;
+    }
+    if (i == kNumWorkModes) {
+      data->logger()->LogError("Unknown mode ", mode_option);
+    } else {
+      mode_index = i;
+    }
+  }
+  uint64_t frames_per_mode = kDefaultFramesPerMode;
+  const char* frames_option = data->sample_option("frames_per_mode");
+  if (frames_option) {
+    frames_per_mode = strtoull(frames_option, nullptr, 10);
+    if (frames_per_mode <= kWarmupFrames) {
+      frames_per_mode = kWarmupFrames + 1;
+    }
+  }
+  data->logger()->LogInfo("Distributing the work as ",
+                          sweep ? "every mode in turn"
+                                : kWorkModes[mode_index].name);
+
   VkDescriptorSetLayoutBinding compute_descriptor_set_layouts[3];
 
   // Both compute passes use the same set of descriptors for simplicity.
@@ -141,33 +305,43 @@ int main_entry(const entry::EntryData* data) {
                                      compute_descriptor_set_layouts[1],
                                      compute_descriptor_set_layouts[2]}}));
 
-  auto simulation_pipeline =
-      containers::make_unique<vulkan::VulkanComputePipeline>(
-          allocator,
-          app.CreateComputePipeline(
-              compute_pipeline_layout.get(),
-              VkShaderModuleCreateInfo{
-                  VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
-                  sizeof(simulation_shader), simulation_shader},
-              "main"));
-
-  auto velocity_pipeline =
-      containers::make_unique<vulkan::VulkanComputePipeline>(
-          allocator,
-          app.CreateComputePipeline(
-              compute_pipeline_layout.get(),
-              VkShaderModuleCreateInfo{
-                  VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
-                  sizeof(velocity_shader), velocity_shader},
-              "main"));
-
-  // Create the single SSBO for simulation
+  // The split modes simulate half of the particles on each GPU. Pipeline
+  // [h] of each pass starts at half h, and the first one is also used to
+  // simulate all of the particles.
+  const uint32_t kHalfParticles = TOTAL_PARTICLES / 2;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> simulation_pipelines[2];
+  containers::unique_ptr<vulkan::VulkanComputePipeline> velocity_pipelines[2];
+  for (uint32_t half = 0; half < 2; ++half) {
+    vulkan::SpecializationConstants constants(allocator);
+    constants.Set(0, half * kHalfParticles);
+    simulation_pipelines[half] =
+        containers::make_unique<vulkan::VulkanComputePipeline>(
+            allocator,
+            app.CreateComputePipeline(
+                compute_pipeline_layout.get(),
+                VkShaderModuleCreateInfo{
+                    VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                    sizeof(simulation_shader), simulation_shader},
+                "main", constants));
+    velocity_pipelines[half] =
+        containers::make_unique<vulkan::VulkanComputePipeline>(
+            allocator,
+            app.CreateComputePipeline(
+                compute_pipeline_layout.get(),
+                VkShaderModuleCreateInfo{
+                    VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                    sizeof(velocity_shader), velocity_shader},
+                "main", constants));
+  }
+
+  // Create the single SSBO for simulation. Every GPU has its own instance of
+  // it, which is current on the GPUs that simulated the last step.
   VkBufferCreateInfo buffer_create_info = {
       VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,       // sType
       nullptr,                                    // pNext
       0,                                          // createFlags
       sizeof(simulation_data) * TOTAL_PARTICLES,  // size
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
       VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
       0,                                       // queueFamilyIndexCount
@@ -177,8 +351,7 @@ int main_entry(const entry::EntryData* data) {
   auto setup_command_buffer = app.GetCommandBuffer();
   setup_command_buffer.begin_command_buffer(&kBeginCommandBuffer);
 
-  auto simulation_ssbo =
-      app.CreateAndBindDeviceBuffer(&buffer_create_info, &kAllOn1Indices[0]);
+  auto simulation_ssbo = app.CreateAndBindDeviceBuffer(&buffer_create_info);
   srand(0);
   containers::vector<simulation_data> fill_data(allocator);
   fill_data.resize(TOTAL_PARTICLES);
@@ -200,46 +373,73 @@ int main_entry(const entry::EntryData* data) {
   const size_t kNBuffers = 2;
   // Double-buffer the universe
 
-  // These buffers live on GPU1. They will actually perform the
-  // computation.
+  // The particles to draw. Every GPU has its own instance, that it writes
+  // when it simulates, or copies the particles of the other GPU to.
   containers::unique_ptr<vulkan::VulkanApplication::Buffer>
-      computation_buffer[kNBuffers];
+      draw_buffers[kNBuffers];
 
-  // These buffers live on GPU0 they will be copied from
-  // GPU1, and drawn on GPU0.
+  // exchange_buffers[d] live in the memory of GPU d, and the other GPU copies
+  // its particles to them through peer memory. GPU0 draws straight from
+  // exchange_buffers[0] when GPU1 does all of the simulation.
   containers::unique_ptr<vulkan::VulkanApplication::Buffer>
-      draw_buffers[kNBuffers];
+      exchange_buffers[2][kNBuffers];
 
+  // compute_descriptor_sets[d] are bound on GPU d, with its time data.
   containers::unique_ptr<vulkan::DescriptorSet>
-      compute_descriptor_sets[kNBuffers];
+      compute_descriptor_sets[2][kNBuffers];
 
   vulkan::VkCommandBuffer compute_command_buffers[kNBuffers] = {
       app.GetCommandBuffer(),
       app.GetCommandBuffer(),
   };
 
-  vulkan::VkCommandBuffer transfer_command_buffers[kNBuffers] = {
+  vulkan::VkCommandBuffer import_command_buffers[kNBuffers] = {
       app.GetCommandBuffer(),
       app.GetCommandBuffer(),
   };
 
-  vulkan::VkSemaphore compute_ready_semaphores[kNBuffers] = {
-      vulkan::CreateSemaphore(&app.device()),
-      vulkan::CreateSemaphore(&app.device()),
+  // Used to hand the simulation over to another GPU when the mode changes.
+  vulkan::VkCommandBuffer handover_command_buffers[2] = {
+      app.GetCommandBuffer(),
+      app.GetCommandBuffer(),
+  };
+
+  // exported_semaphores[d] are signaled by GPU d, once its particles are in
+  // the exchange buffer of the other GPU.
+  vulkan::VkSemaphore exported_semaphores[2][kNBuffers] = {
+      {
+          vulkan::CreateSemaphore(&app.device()),
+          vulkan::CreateSemaphore(&app.device()),
+      },
+      {
+          vulkan::CreateSemaphore(&app.device()),
+          vulkan::CreateSemaphore(&app.device()),
+      },
   };
+  vulkan::VkSemaphore handover_semaphore =
+      vulkan::CreateSemaphore(&app.device());
   vulkan::VkFence frame_ready_fence[kNBuffers] = {
       vulkan::CreateFence(&app.device()),
       vulkan::CreateFence(&app.device()),
   };
 
-  auto update_time_data =
+  // The time and aspect data are written on the GPU that reads them.
+  containers::unique_ptr<vulkan::BufferFrameData<Mat44>> update_time_data[2] = {
+      containers::make_unique<vulkan::BufferFrameData<Mat44>>(
+          allocator, &app, kNBuffers, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          kMaskGPU0),
       containers::make_unique<vulkan::BufferFrameData<Mat44>>(
           allocator, &app, kNBuffers, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-          kMaskGPU1);
-  auto aspect_buffer =
+          kMaskGPU1),
+  };
+  containers::unique_ptr<vulkan::BufferFrameData<Vector4>> aspect_buffers[2] = {
+      containers::make_unique<vulkan::BufferFrameData<Vector4>>(
+          allocator, &app, kNBuffers, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          kMaskGPU0),
       containers::make_unique<vulkan::BufferFrameData<Vector4>>(
           allocator, &app, kNBuffers, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-          kMaskGPU0);
+          kMaskGPU1),
+  };
 
   // Fill the buffer. Technically we probably want to use a staging buffer
   // and fill from that, since this is not really a "small" buffer.
@@ -249,68 +449,14 @@ int main_entry(const entry::EntryData* data) {
                       &setup_command_buffer,
                       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
                           VK_ACCESS_TRANSFER_READ_BIT,
-                      kMaskGPU1);
-
-  buffer_create_info = {
-      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
-      nullptr,                               // pNext
-      0,                                     // createFlags
-      sizeof(draw_data) * TOTAL_PARTICLES,   // size
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
-          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
-      VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
-      0,                                       // queueFamilyIndexCount
-      nullptr                                  // pQueueFamilyIndices
-  };
-
-  for (size_t i = 0; i < kNBuffers; ++i) {
-    computation_buffer[i] =
-        app.CreateAndBindDeviceBuffer(&buffer_create_info, &kAllOn1Indices[0]);
-    compute_descriptor_sets[i] = containers::make_unique<vulkan::DescriptorSet>(
-        allocator,
-        app.AllocateDescriptorSet({compute_descriptor_set_layouts[0],
-                                   compute_descriptor_set_layouts[1],
-                                   compute_descriptor_set_layouts[2]}));
-    VkDescriptorBufferInfo buffer_infos[3] = {
-        {
-            update_time_data->get_buffer(),             // buffer
-            update_time_data->get_offset_for_frame(i),  // offset
-            update_time_data->size(),                   // range
-        },
-        {
-            *simulation_ssbo,         // buffer
-            0,                        // offset
-            simulation_ssbo->size(),  // range
-        },
-        {
-            *computation_buffer[i],         // buffer
-            0,                              // offset
-            computation_buffer[i]->size(),  // range
-        },
-    };
-
-    VkWriteDescriptorSet write = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-        nullptr,                                 // pNext
-        *compute_descriptor_sets[i],             // dstSet
-        0,                                       // dstbinding
-        0,                                       // dstArrayElement
-        3,                                       // descriptorCount
-        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
-        nullptr,                                 // pImageInfo
-        buffer_infos,                            // pBufferInfo
-        nullptr,                                 // pTexelBufferView
-    };
-
-    app.device()->vkUpdateDescriptorSets(app.device(), 1, &write, 0, nullptr);
-  }
+                      kMaskGPUAll);
 
   buffer_create_info = {
       VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
       nullptr,                               // pNext
       0,                                     // createFlags
       sizeof(draw_data) * TOTAL_PARTICLES,   // size
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usageFlags
       VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
       0,                                       // queueFamilyIndexCount
@@ -318,10 +464,54 @@ int main_entry(const entry::EntryData* data) {
   };
 
   for (size_t i = 0; i < kNBuffers; ++i) {
-    draw_buffers[i] = app.CreateAndBindPeerBuffer(&buffer_create_info, kGPU0);
-    app.FillSmallBuffer(draw_buffers[i].get(), nullptr, 0, 0,
-                        &setup_command_buffer, VK_ACCESS_TRANSFER_WRITE_BIT,
-                        kMaskGPU0);
+    draw_buffers[i] = app.CreateAndBindDeviceBuffer(&buffer_create_info);
+    for (uint32_t gpu = 0; gpu < 2; ++gpu) {
+      exchange_buffers[gpu][i] =
+          app.CreateAndBindPeerBuffer(&buffer_create_info, gpu);
+      app.FillSmallBuffer(exchange_buffers[gpu][i].get(), nullptr, 0, 0,
+                          &setup_command_buffer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                          1 << gpu);
+
+      compute_descriptor_sets[gpu][i] =
+          containers::make_unique<vulkan::DescriptorSet>(
+              allocator,
+              app.AllocateDescriptorSet({compute_descriptor_set_layouts[0],
+                                         compute_descriptor_set_layouts[1],
+                                         compute_descriptor_set_layouts[2]}));
+      VkDescriptorBufferInfo buffer_infos[3] = {
+          {
+              update_time_data[gpu]->get_buffer(),             // buffer
+              update_time_data[gpu]->get_offset_for_frame(i),  // offset
+              update_time_data[gpu]->size(),                   // range
+          },
+          {
+              *simulation_ssbo,         // buffer
+              0,                        // offset
+              simulation_ssbo->size(),  // range
+          },
+          {
+              *draw_buffers[i],         // buffer
+              0,                        // offset
+              draw_buffers[i]->size(),  // range
+          },
+      };
+
+      VkWriteDescriptorSet write = {
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+          nullptr,                                 // pNext
+          *compute_descriptor_sets[gpu][i],        // dstSet
+          0,                                       // dstbinding
+          0,                                       // dstArrayElement
+          3,                                       // descriptorCount
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+          nullptr,                                 // pImageInfo
+          buffer_infos,                            // pBufferInfo
+          nullptr,                                 // pTexelBufferView
+      };
+
+      app.device()->vkUpdateDescriptorSets(app.device(), 1, &write, 0,
+                                           nullptr);
+    }
   }
 
   // All of the compute stuff is now done:
@@ -421,6 +611,8 @@ int main_entry(const entry::EntryData* data) {
        static_cast<float>(app.swapchain().height()), 0.0f, 1.0f});
   render_pipeline->SetScissor(
       {{0, 0}, app.swapchain().width(), app.swapchain().height()});
+  // The split-frame mode only draws into half of the frame on each GPU.
+  render_pipeline->AddDynamicState(VK_DYNAMIC_STATE_SCISSOR);
   render_pipeline->SetSamples(VK_SAMPLE_COUNT_1_BIT);
   render_pipeline->AddAttachment(VkPipelineColorBlendAttachmentState{
       VK_TRUE, VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE, VK_BLEND_OP_ADD,
@@ -429,103 +621,135 @@ int main_entry(const entry::EntryData* data) {
           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT});
   render_pipeline->Commit();
 
-  containers::unique_ptr<vulkan::DescriptorSet>
-      render_descriptor_sets[kNBuffers];
-  for (size_t i = 0; i < kNBuffers; ++i) {
-    render_descriptor_sets[i] = containers::make_unique<vulkan::DescriptorSet>(
+  auto write_render_descriptor_set =
+      [&](vulkan::DescriptorSet* set, vulkan::VulkanApplication::Buffer* draw,
+          vulkan::BufferFrameData<Vector4>* aspect, size_t frame) {
+        // Write that buffer into the descriptor sets.
+        VkDescriptorBufferInfo buffer_infos[2] = {
+            {
+                *draw,         // buffer
+                0,             // offset
+                draw->size(),  // range
+            },
+            {
+                aspect->get_buffer(),                 // buffer
+                aspect->get_offset_for_frame(frame),  // offset
+                aspect->size(),                       // range
+            }};
+
+        VkDescriptorImageInfo sampler_info = {
+            *sampler,                  // sampler
+            VK_NULL_HANDLE,            // imageView
+            VK_IMAGE_LAYOUT_UNDEFINED  //  imageLayout
+        };
+
+        VkDescriptorImageInfo texture_info = {
+            VK_NULL_HANDLE,                            // sampler
+            particle_texture.view(),                   // imageView
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+        };
+
+        VkWriteDescriptorSet writes[4]{
+            {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+                nullptr,                                 // pNext
+                *set,                                    // dstSet
+                0,                                       // dstbinding
+                0,                                       // dstArrayElement
+                1,                                       // descriptorCount
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+                nullptr,                                 // pImageInfo
+                &buffer_infos[0],                        // pBufferInfo
+                nullptr,                                 // pTexelBufferView
+            },
+            {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+                nullptr,                                 // pNext
+                *set,                                    // dstSet
+                3,                                       // dstbinding
+                0,                                       // dstArrayElement
+                1,                                       // descriptorCount
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+                nullptr,                                 // pImageInfo
+                &buffer_infos[1],                        // pBufferInfo
+                nullptr,                                 // pTexelBufferView
+            },
+            {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+                nullptr,                                 // pNext
+                *set,                                    // dstSet
+                1,                                       // dstbinding
+                0,                                       // dstArrayElement
+                1,                                       // descriptorCount
+                VK_DESCRIPTOR_TYPE_SAMPLER,              // descriptorType
+                &sampler_info,                           // pImageInfo
+                nullptr,                                 // pBufferInfo
+                nullptr,                                 // pTexelBufferView
+            },
+            {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+                nullptr,                                 // pNext
+                *set,                                    // dstSet
+                2,                                       // dstbinding
+                0,                                       // dstArrayElement
+                1,                                       // descriptorCount
+                VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,        // descriptorType
+                &texture_info,                           // pImageInfo
+                nullptr,                                 // pBufferInfo
+                nullptr,                                 // pTexelBufferView
+            },
+        };
+
+        app.device()->vkUpdateDescriptorSets(app.device(), 4, writes, 0,
+                                             nullptr);
+      };
+
+  auto allocate_render_descriptor_set = [&]() {
+    return containers::make_unique<vulkan::DescriptorSet>(
         allocator,
-        app.AllocateDescriptorSet({render_descriptor_set_layouts[0],
-                                   render_descriptor_set_layouts[1],
-                                   render_descriptor_set_layouts[2],
-                                   render_descriptor_set_layouts[3]}));
-
-    // Write that buffer into the descriptor sets.
-    VkDescriptorBufferInfo buffer_infos[2] = {
-        {
-            *draw_buffers[i],         // buffer
-            0,                        // offset
-            draw_buffers[i]->size(),  // range
-        },
-        {
-            aspect_buffer->get_buffer(),             // buffer
-            aspect_buffer->get_offset_for_frame(i),  // offset
-            aspect_buffer->size(),                   // range
-        }};
-
-    VkDescriptorImageInfo sampler_info = {
-        *sampler,                  // sampler
-        VK_NULL_HANDLE,            // imageView
-        VK_IMAGE_LAYOUT_UNDEFINED  //  imageLayout
-    };
-
-    VkDescriptorImageInfo texture_info = {
-        VK_NULL_HANDLE,                            // sampler
-        particle_texture.view(),                   // imageView
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
-    };
-
-    VkWriteDescriptorSet writes[4]{
-        {
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-            nullptr,                                 // pNext
-            *render_descriptor_sets[i],              // dstSet
-            0,                                       // dstbinding
-            0,                                       // dstArrayElement
-            1,                                       // descriptorCount
-            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
-            nullptr,                                 // pImageInfo
-            &buffer_infos[0],                        // pBufferInfo
-            nullptr,                                 // pTexelBufferView
-        },
-        {
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-            nullptr,                                 // pNext
-            *render_descriptor_sets[i],              // dstSet
-            3,                                       // dstbinding
-            0,                                       // dstArrayElement
-            1,                                       // descriptorCount
-            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
-            nullptr,                                 // pImageInfo
-            &buffer_infos[1],                        // pBufferInfo
-            nullptr,                                 // pTexelBufferView
-        },
-        {
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-            nullptr,                                 // pNext
-            *render_descriptor_sets[i],              // dstSet
-            1,                                       // dstbinding
-            0,                                       // dstArrayElement
-            1,                                       // descriptorCount
-            VK_DESCRIPTOR_TYPE_SAMPLER,              // descriptorType
-            &sampler_info,                           // pImageInfo
-            nullptr,                                 // pBufferInfo
-            nullptr,                                 // pTexelBufferView
-        },
-        {
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-            nullptr,                                 // pNext
-            *render_descriptor_sets[i],              // dstSet
-            2,                                       // dstbinding
-            0,                                       // dstArrayElement
-            1,                                       // descriptorCount
-            VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,        // descriptorType
-            &texture_info,                           // pImageInfo
-            nullptr,                                 // pBufferInfo
-            nullptr,                                 // pTexelBufferView
-        },
-    };
+        app.AllocateDescriptorSet(
+            {render_descriptor_set_layouts[0], render_descriptor_set_layouts[1],
+             render_descriptor_set_layouts[2],
+             render_descriptor_set_layouts[3]}));
+  };
 
-    app.device()->vkUpdateDescriptorSets(app.device(), 4, writes, 0, nullptr);
+  // render_descriptor_sets[d] draw the draw buffers on GPU d, and
+  // exchange_render_descriptor_sets draw exchange_buffers[0] on GPU0.
+  containers::unique_ptr<vulkan::DescriptorSet>
+      render_descriptor_sets[2][kNBuffers];
+  containers::unique_ptr<vulkan::DescriptorSet>
+      exchange_render_descriptor_sets[kNBuffers];
+  for (size_t i = 0; i < kNBuffers; ++i) {
+    for (uint32_t gpu = 0; gpu < 2; ++gpu) {
+      render_descriptor_sets[gpu][i] = allocate_render_descriptor_set();
+      write_render_descriptor_set(render_descriptor_sets[gpu][i].get(),
+                                  draw_buffers[i].get(),
+                                  aspect_buffers[gpu].get(), i);
+    }
+    exchange_render_descriptor_sets[i] = allocate_render_descriptor_set();
+    write_render_descriptor_set(exchange_render_descriptor_sets[i].get(),
+                                exchange_buffers[kGPU0][i].get(),
+                                aspect_buffers[kGPU0].get(), i);
   }
 
   vulkan::VkCommandBuffer render_command_buffers[kNBuffers] = {
       app.GetCommandBuffer(),
       app.GetCommandBuffer(),
   };
+  // These draw on GPU1.
+  vulkan::VkCommandBuffer remote_render_command_buffers[kNBuffers] = {
+      app.GetCommandBuffer(),
+      app.GetCommandBuffer(),
+  };
   vulkan::VkSemaphore swap_ready_semaphores[kNBuffers] = {
       vulkan::CreateSemaphore(&app.device()),
       vulkan::CreateSemaphore(&app.device()),
   };
+  // Signaled by GPU1, once what it drew is in the memory of GPU0.
+  vulkan::VkSemaphore remote_rendered_semaphores[kNBuffers] = {
+      vulkan::CreateSemaphore(&app.device()),
+      vulkan::CreateSemaphore(&app.device()),
+  };
 
   containers::vector<containers::unique_ptr<vulkan::VkFramebuffer>>
       framebuffers(allocator);
@@ -547,15 +771,17 @@ int main_entry(const entry::EntryData* data) {
        VK_COMPONENT_SWIZZLE_A},
       {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
-  for (size_t i = 0; i < app.swapchain_images().size(); ++i) {
-    layouts[i] = VK_IMAGE_LAYOUT_UNDEFINED;
-
+  auto create_framebuffer = [&](::VkImage image,
+                                containers::unique_ptr<vulkan::VkImageView>*
+                                    image_view,
+                                containers::unique_ptr<vulkan::VkFramebuffer>*
+                                    framebuffer) {
     ::VkImageView raw_image_view;
-    view_create_info.image = app.swapchain_images()[i];
+    view_create_info.image = image;
     LOG_ASSERT(==, data->logger(), VK_SUCCESS,
                app.device()->vkCreateImageView(app.device(), &view_create_info,
                                                nullptr, &raw_image_view));
-    image_views[i] = containers::make_unique<vulkan::VkImageView>(
+    *image_view = containers::make_unique<vulkan::VkImageView>(
         allocator, vulkan::VkImageView(raw_image_view, nullptr, &app.device()));
     VkFramebufferCreateInfo framebuffer_create_info{
         VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
@@ -563,7 +789,7 @@ int main_entry(const entry::EntryData* data) {
         0,                                          // flags
         *render_pass,                               // renderPass
         1,                                          // attachmentCount
-        &(image_views[i]->get_raw_object()),        // attachments
+        &((*image_view)->get_raw_object()),         // attachments
         app.swapchain().width(),                    // width
         app.swapchain().height(),                   // height
         1                                           // layers
@@ -575,9 +801,66 @@ int main_entry(const entry::EntryData* data) {
         app.device()->vkCreateFramebuffer(
             app.device(), &framebuffer_create_info, nullptr, &raw_framebuffer));
 
-    framebuffers[i] = containers::make_unique<vulkan::VkFramebuffer>(
+    *framebuffer = containers::make_unique<vulkan::VkFramebuffer>(
         allocator,
         vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app.device()));
+  };
+
+  for (size_t i = 0; i < app.swapchain_images().size(); ++i) {
+    layouts[i] = VK_IMAGE_LAYOUT_UNDEFINED;
+    create_framebuffer(app.swapchain_images()[i], &image_views[i],
+                       &framebuffers[i]);
+  }
+
+  // GPU1 cannot present, so it draws into these images instead, and copies
+  // its part of the frame to GPU0 through the peer buffers.
+  VkImageCreateInfo remote_image_create_info{
+      VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+      nullptr,                              // pNext
+      0,                                    // flags
+      VK_IMAGE_TYPE_2D,                     // imageType
+      app.swapchain().format(),             // format
+      {
+          // extent
+          app.swapchain().width(),   // width
+          app.swapchain().height(),  // height
+          1,                         // depth
+      },
+      1,                        // mipLevels
+      1,                        // arrayLayers
+      VK_SAMPLE_COUNT_1_BIT,    // samples
+      VK_IMAGE_TILING_OPTIMAL,  // tiling
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+          VK_IMAGE_USAGE_TRANSFER_SRC_BIT,  // usage
+      VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+      0,                                    // queueFamilyIndexCount
+      nullptr,                              // pQueueFamilyIndices
+      VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+  };
+  // The swapchain formats are all 4 bytes per texel.
+  VkBufferCreateInfo remote_pixels_create_info = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+      nullptr,                               // pNext
+      0,                                     // createFlags
+      4 * app.swapchain().width() * app.swapchain().height(),  // size
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,  // usageFlags
+      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+      0,                                     // queueFamilyIndexCount
+      nullptr                                // pQueueFamilyIndices
+  };
+  containers::unique_ptr<vulkan::VulkanApplication::Image>
+      remote_images[kNBuffers];
+  containers::unique_ptr<vulkan::VkImageView> remote_image_views[kNBuffers];
+  containers::unique_ptr<vulkan::VkFramebuffer> remote_framebuffers[kNBuffers];
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      remote_pixels[kNBuffers];
+  for (size_t i = 0; i < kNBuffers; ++i) {
+    remote_images[i] = app.CreateAndBindImage(&remote_image_create_info);
+    create_framebuffer(*remote_images[i], &remote_image_views[i],
+                       &remote_framebuffers[i]);
+    remote_pixels[i] =
+        app.CreateAndBindPeerBuffer(&remote_pixels_create_info, kGPU0);
   }
   setup_command_buffer->vkEndCommandBuffer(setup_command_buffer);
 
@@ -608,10 +891,266 @@ int main_entry(const entry::EntryData* data) {
 
   app.render_queue()->vkQueueWaitIdle(app.render_queue());
 
+  // Copies |count| particles, from |first| on, from the simulation of |gpu|
+  // into the exchange buffer of the other GPU, through peer memory.
+  auto record_export = [&](vulkan::VkCommandBuffer& cmd, uint32_t gpu,
+                           size_t slot, uint32_t first, uint32_t count) {
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT,              // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *simulation_ssbo,                         // buffer
+        0,                                        //  offset
+        simulation_ssbo->size(),                  // size
+    };
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                              &barrier, 0, nullptr);
+    VkBufferCopy region = {
+        first * sizeof(simulation_data),  // srcOffset
+        first * sizeof(simulation_data),  // dstOffset
+        count * sizeof(simulation_data),  // size
+    };
+    cmd->vkCmdCopyBuffer(cmd, *simulation_ssbo,
+                         *exchange_buffers[1 - gpu][slot], 1, &region);
+  };
+
+  // Copies |count| particles, from |first| on, that the other GPU exported
+  // to |gpu|, into the simulation, and into the draw buffer of |slot| if
+  // |draw| is set.
+  auto record_import = [&](vulkan::VkCommandBuffer& cmd, uint32_t gpu,
+                           size_t slot, uint32_t first, uint32_t count,
+                           bool draw) {
+    VkBufferMemoryBarrier barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT,  // srcAccessMask
+            VK_ACCESS_TRANSFER_WRITE_BIT,    // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,         // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,         // dstQueueFamilyIndex
+            *simulation_ssbo,                // buffer
+            0,                               //  offset
+            simulation_ssbo->size(),         // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT,  // srcAccessMask
+            VK_ACCESS_TRANSFER_WRITE_BIT,    // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,         // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,         // dstQueueFamilyIndex
+            *draw_buffers[slot],             // buffer
+            0,                               //  offset
+            draw_buffers[slot]->size(),      // size
+        }};
+    const uint32_t num_barriers = draw ? 2 : 1;
+    cmd->vkCmdPipelineBarrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                              num_barriers, barriers, 0, nullptr);
+    VkBufferCopy region = {
+        first * sizeof(simulation_data),  // srcOffset
+        first * sizeof(simulation_data),  // dstOffset
+        count * sizeof(simulation_data),  // size
+    };
+    cmd->vkCmdCopyBuffer(cmd, *exchange_buffers[gpu][slot], *simulation_ssbo, 1,
+                         &region);
+    if (draw) {
+      cmd->vkCmdCopyBuffer(cmd, *exchange_buffers[gpu][slot],
+                           *draw_buffers[slot], 1, &region);
+    }
+    for (auto& barrier : barriers) {
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask =
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    }
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                              0, 0, nullptr, num_barriers, barriers, 0,
+                              nullptr);
+  };
+
+  // Simulates |count| particles, from |first| on, on |gpu|, and writes them
+  // to the draw buffer of |slot|. All particles have to be current.
+  auto record_simulation = [&](vulkan::VkCommandBuffer& cmd, uint32_t gpu,
+                               size_t slot, uint32_t first, uint32_t count) {
+    VkBufferMemoryBarrier simulation_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT |
+                VK_ACCESS_TRANSFER_WRITE_BIT,  // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT,  // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,         // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,         // dstQueueFamilyIndex
+            *simulation_ssbo,                // buffer
+            0,                               //  offset
+            simulation_ssbo->size(),         // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+            VK_ACCESS_SHADER_WRITE_BIT,               // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *draw_buffers[slot],                      // buffer
+            0,                                        //  offset
+            draw_buffers[slot]->size(),               // size
+        }};
+    cmd->vkCmdPipelineBarrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                              nullptr, 2, simulation_barriers, 0, nullptr);
+    const uint32_t half = first / kHalfParticles;
+    cmd->vkCmdBindDescriptorSets(
+        cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *compute_pipeline_layout, 0, 1,
+        &compute_descriptor_sets[gpu][slot]->raw_set(), 0, nullptr);
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           *velocity_pipelines[half]);
+    cmd->vkCmdDispatch(cmd, count / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
+    // The positions have to be read by every velocity update before they
+    // are moved.
+    simulation_barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                              nullptr, 1, &simulation_barriers[0], 0, nullptr);
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           *simulation_pipelines[half]);
+    cmd->vkCmdDispatch(cmd, count / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
+  };
+
+  // Draws the particles of |draw| with |descriptor_set| into |area| of
+  // |framebuffer|, on the GPUs of |device_mask|.
+  auto record_draw = [&](vulkan::VkCommandBuffer& cmd,
+                         ::VkFramebuffer framebuffer, uint32_t device_mask,
+                         const VkRect2D& area,
+                         vulkan::VulkanApplication::Buffer* draw,
+                         vulkan::DescriptorSet* descriptor_set) {
+    VkBufferMemoryBarrier draw_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_SHADER_WRITE_BIT |
+            VK_ACCESS_TRANSFER_WRITE_BIT,  // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,         // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,           // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,           // dstQueueFamilyIndex
+        *draw,                             // buffer
+        0,                                 //  offset
+        draw->size(),                      // size
+    };
+
+    cmd->vkCmdPipelineBarrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0,
+                              nullptr, 1, &draw_barrier, 0, nullptr);
+
+    VkDeviceGroupRenderPassBeginInfo device_group_begin{
+        VK_STRUCTURE_TYPE_DEVICE_GROUP_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                                // pNext
+        device_mask, 0, nullptr};
+
+    VkClearValue clear{};
+    vulkan::MemoryClear(&clear);
+    clear.color.float32[3] = 1.0f;
+    // The rest of the normal drawing.
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        &device_group_begin,                       // pNext
+        *render_pass,                              // renderPass
+        framebuffer,                               // framebuffer
+        area,                                      // renderArea
+        1,                                         // clearValueCount
+        &clear                                     // clears
+    };
+    cmd->vkCmdBeginRenderPass(cmd, &pass_begin, VK_SUBPASS_CONTENTS_INLINE);
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           *render_pipeline);
+    cmd->vkCmdSetScissor(cmd, 0, 1, &area);
+    cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 ::VkPipelineLayout(*render_pipeline_layout), 0,
+                                 1, &descriptor_set->raw_set(), 0, nullptr);
+
+    quad_model.DrawInstanced(&cmd, TOTAL_PARTICLES);
+    cmd->vkCmdEndRenderPass(cmd);
+  };
+
   auto last_update_time = std::chrono::high_resolution_clock::now();
-  auto last_print_time = last_update_time;
+  auto mode_start_time = last_update_time;
   uint64_t frame_idx = 0;
   uint64_t current_frame = 0;
+  // The number of frames that were drawn in the current mode.
+  uint64_t mode_frame = 0;
+  // The average frame time of every mode, in ms, or 0 if it did not run.
+  double mode_frame_times[kNumWorkModes] = {};
+
+  // The GPUs whose instance of the simulation is current.
+  uint32_t simulation_mask = kMaskGPUAll;
+  // In the alternate-frame mode, the GPU that simulates the next step has to
+  // import the particles from the exchange buffer of |handover_slot| first,
+  // once the other GPU signals that they are there.
+  bool handover_pending = false;
+  uint32_t handover_gpu = kGPU0;
+  size_t handover_slot = 0;
+
+  // Waits for all frames, and makes the simulation current on the GPUs that
+  // |mode| starts with.
+  auto hand_over = [&](WorkMode mode) {
+    app.device()->vkDeviceWaitIdle(app.device());
+    if (handover_pending) {
+      auto& cmd = handover_command_buffers[0];
+      cmd.begin_command_buffer(&kBeginCommandBuffer);
+      cmd.set_device_mask(1 << handover_gpu);
+      record_import(cmd, handover_gpu, handover_slot, 0, TOTAL_PARTICLES,
+                    false);
+      cmd->vkEndCommandBuffer(cmd);
+      SubmitBatch batch(cmd, 1 << handover_gpu);
+      batch.Wait(exported_semaphores[1 - handover_gpu][handover_slot],
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, handover_gpu);
+      SubmitBatches(&app, &render_queue, &batch, 1, VK_NULL_HANDLE);
+      render_queue->vkQueueWaitIdle(render_queue);
+      simulation_mask |= 1 << handover_gpu;
+      handover_pending = false;
+    }
+    const uint32_t needed = GetFirstSimulationMask(mode);
+    if ((needed & ~simulation_mask) == 0) {
+      return;
+    }
+    const uint32_t from = (simulation_mask & kMaskGPU0) ? kGPU0 : kGPU1;
+    const uint32_t to = 1 - from;
+    auto& export_cmd = handover_command_buffers[0];
+    export_cmd.begin_command_buffer(&kBeginCommandBuffer);
+    export_cmd.set_device_mask(1 << from);
+    record_export(export_cmd, from, 0, 0, TOTAL_PARTICLES);
+    export_cmd->vkEndCommandBuffer(export_cmd);
+    auto& import_cmd = handover_command_buffers[1];
+    import_cmd.begin_command_buffer(&kBeginCommandBuffer);
+    import_cmd.set_device_mask(1 << to);
+    record_import(import_cmd, to, 0, 0, TOTAL_PARTICLES, false);
+    import_cmd->vkEndCommandBuffer(import_cmd);
+    SubmitBatch batches[2] = {
+        SubmitBatch(export_cmd, 1 << from),
+        SubmitBatch(import_cmd, 1 << to),
+    };
+    batches[0].Signal(handover_semaphore, from);
+    batches[1].Wait(handover_semaphore, VK_PIPELINE_STAGE_TRANSFER_BIT, to);
+    SubmitBatches(&app, &render_queue, batches, 2, VK_NULL_HANDLE);
+    render_queue->vkQueueWaitIdle(render_queue);
+    simulation_mask = kMaskGPUAll;
+  };
+  hand_over(kWorkModes[mode_index].mode);
 
   // Weird swap semaphore stuff.
   containers::deque<vulkan::VkSemaphore> render_ready_semaphores(allocator);
@@ -619,33 +1158,20 @@ int main_entry(const entry::EntryData* data) {
     render_ready_semaphores.push_back(vulkan::CreateSemaphore(&app.device()));
   }
 
-  containers::deque<vulkan::VkSemaphore> compute_done_semaphores(allocator);
-  for (size_t i = 0; i < kNBuffers; ++i) {
-    compute_done_semaphores.push_back(vulkan::CreateSemaphore(&app.device()));
-  }
-
   data->NotifyReady();
 
-  VkBufferCreateInfo tb_create_info = {
-      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
-      nullptr,                               // pNext
-      0,                                     // createFlags
-      sizeof(draw_data) * TOTAL_PARTICLES,   // size
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usageFlags
-      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
-      0,                                     // queueFamilyIndexCount
-      nullptr                                // pQueueFamilyIndices
-  };
-
-  auto temp_buff =
-      app.CreateAndBindCoherentBuffer(&buffer_create_info, &kAllOn0Indices[0]);
-  char* dat = temp_buff->base_address();
+  const uint32_t width = app.swapchain().width();
+  const uint32_t height = app.swapchain().height();
+  const VkRect2D kFullFrame = {{0, 0}, {width, height}};
+  const VkRect2D kNoFrame = {{0, 0}, {0, 0}};
+  const VkRect2D kTopHalf = {{0, 0}, {width, height / 2}};
+  const VkRect2D kBottomHalf = {{0, static_cast<int32_t>(height / 2)},
+                                {width, height - height / 2}};
 
   // Actually draw stuff
   for (; !data->WindowClosing();) {
     uint32_t i = frame_idx % kNBuffers;
 
-    ::VkSemaphore wait_semaphore = compute_ready_semaphores[i];
     ::VkFence wait_fence = frame_ready_fence[i];
     // Next swapchain
     if (++frame_idx > kNBuffers) {
@@ -654,102 +1180,167 @@ int main_entry(const entry::EntryData* data) {
                                                false, 0xFFFFFFFFFFFFFFFF),
                  VK_SUCCESS);
       app.device()->vkResetFences(app.device(), 1, &wait_fence);
-    } else {
-      wait_semaphore = ::VkSemaphore(VK_NULL_HANDLE);
     }
 
-    auto& computeBuff = compute_command_buffers[i];
-
-    aspect_buffer->data()[0] =
-        (float)app.swapchain().width() / (float)app.swapchain().height();
-    aspect_buffer->UpdateBuffer(&app.render_queue(), i);
+    const WorkMode mode = kWorkModes[mode_index].mode;
+    const bool split =
+        mode == WorkMode::kSplitSimulation || mode == WorkMode::kSplitFrame;
+    // The GPUs that simulate, the ones that export their particles to the
+    // other GPU, and the part of the frame that each GPU draws.
+    uint32_t simulating = kMaskGPU0;
+    uint32_t exporting = 0;
+    VkRect2D areas[2] = {kFullFrame, kNoFrame};
+    switch (mode) {
+      case WorkMode::kSingleGPU:
+        break;
+      case WorkMode::kSimulateRender:
+        simulating = kMaskGPU1;
+        exporting = kMaskGPU1;
+        break;
+      case WorkMode::kAlternateFrame:
+        simulating = 1 << (mode_frame % 2);
+        exporting = simulating;
+        if (simulating == kMaskGPU1) {
+          areas[kGPU0] = kNoFrame;
+          areas[kGPU1] = kFullFrame;
+        }
+        break;
+      case WorkMode::kSplitSimulation:
+        simulating = kMaskGPUAll;
+        exporting = kMaskGPUAll;
+        break;
+      case WorkMode::kSplitFrame:
+        simulating = kMaskGPUAll;
+        exporting = kMaskGPUAll;
+        areas[kGPU0] = kTopHalf;
+        areas[kGPU1] = kBottomHalf;
+        break;
+    }
+    const bool remote_draw = areas[kGPU1].extent.height != 0;
+    const bool local_draw = areas[kGPU0].extent.height != 0;
 
     auto current_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> elapsed_time = current_time - last_update_time;
     last_update_time = current_time;
 
-    update_time_data->data()[0] = static_cast<float>(current_frame);
-    update_time_data->data()[1] = elapsed_time.count() * 2.0f;
+    for (uint32_t gpu = 0; gpu < 2; ++gpu) {
+      aspect_buffers[gpu]->data()[0] =
+          (float)app.swapchain().width() / (float)app.swapchain().height();
+      aspect_buffers[gpu]->UpdateBuffer(&app.render_queue(), i);
+      update_time_data[gpu]->data()[0] = static_cast<float>(current_frame);
+      update_time_data[gpu]->data()[1] = elapsed_time.count() * 2.0f;
+      update_time_data[gpu]->UpdateBuffer(&app.render_queue(), i);
+    }
     if (++current_frame >= TOTAL_PARTICLES) {
       current_frame = 0;
     }
-    if ((frame_idx % 1000) == 0) {
-      auto t = std::chrono::duration_cast<std::chrono::milliseconds>(
-          current_time - last_print_time);
-      last_print_time = current_time;
 
-      data->logger()->LogInfo("Frame time: ", (double)t.count() / (double)1000,
-                              "ms");
+    SubmitBatch batches[kMaxBatches];
+    size_t num_batches = 0;
+
+    // Simulate, on each GPU that simulates, and export the particles.
+    auto& compute_buffer = compute_command_buffers[i];
+    compute_buffer.begin_command_buffer(&kBeginCommandBuffer);
+    SubmitBatch& compute_batch = batches[num_batches++];
+    compute_batch = SubmitBatch(compute_buffer, simulating);
+    if (handover_pending) {
+      LOG_ASSERT(==, app.GetLogger(), simulating,
+                 static_cast<uint32_t>(1 << handover_gpu));
+      compute_buffer.set_device_mask(1 << handover_gpu);
+      record_import(compute_buffer, handover_gpu, handover_slot, 0,
+                    TOTAL_PARTICLES, false);
+      compute_batch.Wait(
+          exported_semaphores[1 - handover_gpu][handover_slot],
+          VK_PIPELINE_STAGE_TRANSFER_BIT, handover_gpu);
+      handover_pending = false;
+    }
+    for (uint32_t gpu = 0; gpu < 2; ++gpu) {
+      if (!(simulating & (1 << gpu))) {
+        continue;
+      }
+      const uint32_t first = split ? gpu * kHalfParticles : 0;
+      const uint32_t count = split ? kHalfParticles : TOTAL_PARTICLES;
+      compute_buffer.set_device_mask(1 << gpu);
+      record_simulation(compute_buffer, gpu, i, first, count);
+      if (exporting & (1 << gpu)) {
+        record_export(compute_buffer, gpu, i, first, count);
+        compute_batch.Signal(exported_semaphores[gpu][i], gpu);
+      }
+    }
+    compute_buffer->vkEndCommandBuffer(compute_buffer);
+    simulation_mask = simulating;
+    if (mode == WorkMode::kAlternateFrame) {
+      handover_pending = true;
+      handover_gpu = simulating == kMaskGPU0 ? kGPU1 : kGPU0;
+      handover_slot = i;
     }
-    update_time_data->UpdateBuffer(&app.render_queue(), i);
-    app.device()->vkDeviceWaitIdle(app.device());
-    VkBufferMemoryBarrier simulation_barriers[2] = {
-        {
-            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-            nullptr,                                  // pNext
-            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
-            VK_ACCESS_SHADER_READ_BIT,                // dstAccessMask
-            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
-            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
-            *simulation_ssbo,                         // buffer
-            0,                                        //  offset
-            simulation_ssbo->size(),                  // size
-        },
-        {
-            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-            nullptr,                                  // pNext
-            VK_ACCESS_TRANSFER_READ_BIT,              // srcAccessMask
-            VK_ACCESS_SHADER_WRITE_BIT,               // dstAccessMask
-            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
-            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
-            *computation_buffer[i],                   // buffer
-            0,                                        //  offset
-            computation_buffer[i]->size(),            // size
-        }};
 
-    computeBuff.begin_command_buffer(&kBeginCommandBuffer);
-    computeBuff->vkCmdSetDeviceMask(computeBuff, kMaskGPU1);
-
-    computeBuff->vkCmdPipelineBarrier(
-        computeBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
-        &simulation_barriers[0], 0, nullptr);
-    computeBuff->vkCmdPipelineBarrier(
-        computeBuff, VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
-        &simulation_barriers[1], 0, nullptr);
-    computeBuff->vkCmdBindDescriptorSets(
-        computeBuff, VK_PIPELINE_BIND_POINT_COMPUTE, *compute_pipeline_layout,
-        0, 1, &compute_descriptor_sets[i]->raw_set(), 0, nullptr);
-    computeBuff->vkCmdBindPipeline(computeBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
-                                   *velocity_pipeline);
-    computeBuff->vkCmdDispatch(
-        computeBuff, TOTAL_PARTICLES / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
-    computeBuff->vkCmdBindPipeline(computeBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
-                                   *simulation_pipeline);
-    computeBuff->vkCmdDispatch(
-        computeBuff, TOTAL_PARTICLES / COMPUTE_SHADER_LOCAL_SIZE, 1, 1);
-    simulation_barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    simulation_barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    computeBuff->vkCmdPipelineBarrier(
-        computeBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
-        &simulation_barriers[1], 0, nullptr);
-
-    VkBufferCopy cp{0, 0, sizeof(draw_data) * TOTAL_PARTICLES};
-    computeBuff->vkCmdCopyBuffer(computeBuff, *computation_buffer[i],
-                                 *draw_buffers[i], 1, &cp);
-
-    simulation_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    simulation_barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    computeBuff->vkCmdPipelineBarrier(
-        computeBuff, VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, 0, 0, nullptr, 1,
-        &simulation_barriers[1], 0, nullptr);
-
-    computeBuff->vkEndCommandBuffer(computeBuff);
+    // Each GPU imports the half that the other one simulated.
+    if (split) {
+      auto& import_buffer = import_command_buffers[i];
+      import_buffer.begin_command_buffer(&kBeginCommandBuffer);
+      SubmitBatch& import_batch = batches[num_batches++];
+      import_batch = SubmitBatch(import_buffer, kMaskGPUAll);
+      for (uint32_t gpu = 0; gpu < 2; ++gpu) {
+        import_buffer.set_device_mask(1 << gpu);
+        record_import(import_buffer, gpu, i, (1 - gpu) * kHalfParticles,
+                      kHalfParticles, true);
+        import_batch.Wait(exported_semaphores[1 - gpu][i],
+                          VK_PIPELINE_STAGE_TRANSFER_BIT, gpu);
+      }
+      import_buffer->vkEndCommandBuffer(import_buffer);
+    }
 
+    // GPU1 draws its part of the frame, and copies it to GPU0.
+    if (remote_draw) {
+      auto& remote_buffer = remote_render_command_buffers[i];
+      remote_buffer.begin_command_buffer(&kBeginCommandBufferOn1);
+      VkImageMemoryBarrier barrier = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,    // sType
+          nullptr,                                   // pNext
+          0,                                         // srcAccessMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,      // dstAccessMask
+          VK_IMAGE_LAYOUT_UNDEFINED,                 // oldLayout
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // newLayout
+          VK_QUEUE_FAMILY_IGNORED,                   // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                   // dstQueueFamilyIndex
+          *remote_images[i],                         // image
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+      remote_buffer->vkCmdPipelineBarrier(
+          remote_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0,
+          nullptr, 1, &barrier);
+      record_draw(remote_buffer, *remote_framebuffers[i], kMaskGPU1,
+                  areas[kGPU1], draw_buffers[i].get(),
+                  render_descriptor_sets[kGPU1][i].get());
+      barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      remote_buffer->vkCmdPipelineBarrier(
+          remote_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+          &barrier);
+      VkBufferImageCopy region = {
+          0,                                    // bufferOffset
+          0,                                    // bufferRowLength
+          0,                                    // bufferImageHeight
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // imageSubresource
+          {areas[kGPU1].offset.x, areas[kGPU1].offset.y, 0},  // imageOffset
+          {areas[kGPU1].extent.width, areas[kGPU1].extent.height,
+           1},  // imageExtent
+      };
+      remote_buffer->vkCmdCopyImageToBuffer(
+          remote_buffer, *remote_images[i],
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *remote_pixels[i], 1, &region);
+      remote_buffer->vkEndCommandBuffer(remote_buffer);
+      SubmitBatch& remote_batch = batches[num_batches++];
+      remote_batch = SubmitBatch(remote_buffer, kMaskGPU1);
+      remote_batch.Signal(remote_rendered_semaphores[i], kGPU1);
+    }
+
+    // GPU0 draws its part of the frame, copies in the part of GPU1, and
+    // presents.
     auto& render_buffer = render_command_buffers[i];
     render_buffer.begin_command_buffer(&kBeginCommandBufferOn0);
     uint32_t swapchain_idx;
@@ -768,164 +1359,103 @@ int main_entry(const entry::EntryData* data) {
                app.device()->vkAcquireNextImage2KHR(app.device(), &acquire,
                                                     &swapchain_idx));
     VkImageMemoryBarrier barrier = {
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,    // sType
-        nullptr,                                   // pNext
-        VK_ACCESS_MEMORY_READ_BIT,                 // srcAccessMask
-        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,      // dstAccessMask
-        layouts[swapchain_idx],                    // oldLayout
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // newLayout
-        0,                                         // srcQueueFamilyIndex
-        0,                                         // dstQueueFamilyIndex
-        app.swapchain_images()[swapchain_idx],     // image
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        VK_ACCESS_MEMORY_READ_BIT,               // srcAccessMask
+        local_draw ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                   : VK_ACCESS_TRANSFER_WRITE_BIT,  // dstAccessMask
+        layouts[swapchain_idx],                     // oldLayout
+        local_draw ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                   : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,  // newLayout
+        0,                                     // srcQueueFamilyIndex
+        0,                                     // dstQueueFamilyIndex
+        app.swapchain_images()[swapchain_idx],  // image
         {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
     render_buffer->vkCmdPipelineBarrier(
-        render_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0,
-        nullptr, 1, &barrier);
-
-    VkBufferMemoryBarrier draw_barrier = {
-        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-        nullptr,                                  // pNext
-        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
-        VK_ACCESS_SHADER_READ_BIT,                // dstAccessMask
-        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
-        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
-        *draw_buffers[i],                         // buffer
-        0,                                        //  offset
-        draw_buffers[i]->size(),                  // size
-    };
-
-    render_buffer->vkCmdPipelineBarrier(
-        render_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1, &draw_barrier, 0,
-        nullptr);
-
-    VkDeviceGroupRenderPassBeginInfo device_group_begin{
-        VK_STRUCTURE_TYPE_DEVICE_GROUP_RENDER_PASS_BEGIN_INFO,  // sType
-        nullptr,                                                // pNext
-        kMaskGPU0, 0, nullptr};
-
-    VkClearValue clear{};
-    vulkan::MemoryClear(&clear);
-    clear.color.float32[3] = 1.0f;
-    // The rest of the normal drawing.
-    VkRenderPassBeginInfo pass_begin = {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        &device_group_begin,                       // pNext
-        *render_pass,                              // renderPass
-        *framebuffers[swapchain_idx],              // framebuffer
-        {{0, 0},
-         {app.swapchain().width(), app.swapchain().height()}},  // renderArea
-        1,      // clearValueCount
-        &clear  // clears
-    };
-    render_buffer->vkCmdBeginRenderPass(render_buffer, &pass_begin,
-                                        VK_SUBPASS_CONTENTS_INLINE);
-    render_buffer->vkCmdBindPipeline(
-        render_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *render_pipeline);
-    render_buffer->vkCmdBindDescriptorSets(
-        render_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ::VkPipelineLayout(*render_pipeline_layout), 0, 1,
-        &render_descriptor_sets[i]->raw_set(), 0, nullptr);
-
-    quad_model.DrawInstanced(&render_buffer, TOTAL_PARTICLES);
-    render_buffer->vkCmdEndRenderPass(render_buffer);
+        render_buffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    if (local_draw) {
+      const bool from_exchange = mode == WorkMode::kSimulateRender;
+      record_draw(render_buffer, *framebuffers[swapchain_idx], kMaskGPU0,
+                  areas[kGPU0],
+                  from_exchange ? exchange_buffers[kGPU0][i].get()
+                                : draw_buffers[i].get(),
+                  from_exchange ? exchange_render_descriptor_sets[i].get()
+                                : render_descriptor_sets[kGPU0][i].get());
+    }
+    if (remote_draw) {
+      if (local_draw) {
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        render_buffer->vkCmdPipelineBarrier(
+            render_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+            &barrier);
+      }
+      VkBufferImageCopy region = {
+          0,                                    // bufferOffset
+          0,                                    // bufferRowLength
+          0,                                    // bufferImageHeight
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // imageSubresource
+          {areas[kGPU1].offset.x, areas[kGPU1].offset.y, 0},  // imageOffset
+          {areas[kGPU1].extent.width, areas[kGPU1].extent.height,
+           1},  // imageExtent
+      };
+      render_buffer->vkCmdCopyBufferToImage(
+          render_buffer, *remote_pixels[i],
+          app.swapchain_images()[swapchain_idx],
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
 
     VkImageMemoryBarrier present_barrier = {
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,    // sType
-        nullptr,                                   // pNext
-        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,      // srcAccessMask
-        VK_ACCESS_MEMORY_READ_BIT,                 // dstAccessMask
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // oldLayout
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,           // newLayout
-        0,                                         // srcQueueFamilyIndex
-        0,                                         // dstQueueFamilyIndex
-        app.swapchain_images()[swapchain_idx],     // image
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        remote_draw ? VK_ACCESS_TRANSFER_WRITE_BIT
+                    : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,  // srcAccessMask
+        VK_ACCESS_MEMORY_READ_BIT,                           // dstAccessMask
+        remote_draw ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                    : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // oldLayout
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,                         // newLayout
+        0,                                     // srcQueueFamilyIndex
+        0,                                     // dstQueueFamilyIndex
+        app.swapchain_images()[swapchain_idx],  // image
         {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
     layouts[swapchain_idx] = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     render_buffer->vkCmdPipelineBarrier(
-        render_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &draw_barrier,
-        1, &present_barrier);
-    draw_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    draw_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-    render_buffer->vkCmdPipelineBarrier(render_buffer,
-                                        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-                                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                                        nullptr, 1, &draw_barrier, 0, nullptr);
+        render_buffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &present_barrier);
 
     render_buffer->vkEndCommandBuffer(render_buffer);
 
-    VkPipelineStageFlags stage_mask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    VkPipelineStageFlags stage_mask2 =
-        // VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-    const uint32_t gpu0 = 0;
-    const uint32_t gpu1 = 1;
-
-    const uint32_t gpu01[] = {0, 1};
-    const uint32_t gpu11[] = {1, 1};
-    const uint32_t gpu00[] = {0, 0};
-
-    VkDeviceGroupSubmitInfo group_submit_infos[2] = {
-        {VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO, nullptr, 1, &gpu1, 1,
-         &kMaskGPU1, 2, &gpu11[0]},
-        {VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO, nullptr, 2, &gpu00[0], 1,
-         &kMaskGPU0, 1, &gpu0}};
-
-    ::VkSemaphore CDS[2] = {
-        compute_ready_semaphores[i].get_raw_object(),
-        compute_done_semaphores[i],
-    };
-
-    ::VkSemaphore CDR[2] = {
-        swap_ready_semaphores[i].get_raw_object(),
-        compute_done_semaphores[i],
-    };
-
-    VkSubmitInfo render_submit_infos[2]{
-        {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-            &group_submit_infos[0],         // pNext
-            1,                              // waitSemaphoreCount
-            &wait_semaphore,                // pWaitSemaphores
-            &stage_mask,                    // pWaitDstStageMask,
-            1,                              // commandBufferCount
-            &(computeBuff.get_command_buffer()),
-            2,       // signalSemaphoreCount
-            &CDS[0]  // pSignalSemaphores
-        },
-        {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-            &group_submit_infos[1],         // pNext
-            2,                              // waitSemaphoreCount
-            &CDR[0],                        // pWaitSemaphores
-            &stage_mask2,                   // pWaitDstStageMask,
-            1,                              // commandBufferCount
-            &(render_buffer.get_command_buffer()),
-            1,  // signalSemaphoreCount
-            &render_ready_semaphores[swapchain_idx]
-                 .get_raw_object()  // pSignalSemaphores
-        }};
-
-    if (wait_semaphore == VK_NULL_HANDLE) {
-      render_submit_infos[0].waitSemaphoreCount = 0;
-      render_submit_infos[0].pWaitSemaphores = nullptr;
-      render_submit_infos[0].pWaitDstStageMask = nullptr;
-      group_submit_infos[0].waitSemaphoreCount = 0;
-      group_submit_infos[0].pWaitSemaphoreDeviceIndices = nullptr;
+    SubmitBatch& render_batch = batches[num_batches++];
+    render_batch = SubmitBatch(render_buffer, kMaskGPU0);
+    render_batch.Wait(swap_ready_semaphores[i],
+                      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      kGPU0);
+    if (mode == WorkMode::kSimulateRender) {
+      render_batch.Wait(exported_semaphores[kGPU1][i],
+                        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, kGPU0);
+    }
+    if (remote_draw) {
+      render_batch.Wait(remote_rendered_semaphores[i],
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, kGPU0);
     }
+    render_batch.Signal(render_ready_semaphores[swapchain_idx], kGPU0);
 
-    app.device()->vkDeviceWaitIdle(app.device());
-    LOG_ASSERT(==, app.GetLogger(),
-               app.render_queue()->vkQueueSubmit(
-                   app.render_queue(), 2, &render_submit_infos[0], wait_fence),
-               VK_SUCCESS);
-    app.device()->vkDeviceWaitIdle(app.device());
+    SubmitBatches(&app, &render_queue, batches, num_batches, wait_fence);
 
     VkDeviceGroupPresentInfoKHR device_group_present = {
         VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_INFO_KHR,  // sType
@@ -947,8 +1477,37 @@ int main_entry(const entry::EntryData* data) {
                app.render_queue()->vkQueuePresentKHR(app.present_queue(),
                                                      &present_info),
                VK_SUCCESS);
+
+    if (++mode_frame == kWarmupFrames) {
+      mode_start_time = std::chrono::high_resolution_clock::now();
+    } else if (mode_frame == frames_per_mode) {
+      std::chrono::duration<double, std::milli> mode_time =
+          std::chrono::high_resolution_clock::now() - mode_start_time;
+      const double frame_time =
+          mode_time.count() / static_cast<double>(frames_per_mode -
+                                                  kWarmupFrames);
+      mode_frame_times[mode_index] = frame_time;
+      data->logger()->LogInfo("Frame time: ", frame_time, "ms (",
+                              kWorkModes[mode_index].name, ")");
+      mode_frame = 0;
+      if (sweep) {
+        if (mode_index + 1 == kNumWorkModes) {
+          // Every mode ran, compare them to the single GPU.
+          for (size_t m = 0; m < kNumWorkModes; ++m) {
+            const double speedup = mode_frame_times[0] / mode_frame_times[m];
+            data->logger()->LogInfo(
+                kWorkModes[m].name, ": ", mode_frame_times[m], "ms, ", speedup,
+                "x one GPU, ", 100.0 * speedup / kWorkModes[m].num_gpus,
+                "% scaling efficiency");
+          }
+        }
+        mode_index = (mode_index + 1) % kNumWorkModes;
+        hand_over(kWorkModes[mode_index].mode);
+      }
+    }
     data->logger()->Flush();
   }
+  app.device()->vkDeviceWaitIdle(app.device());
   data->logger()->LogInfo("Application Shutdown");
   return 0;
 }
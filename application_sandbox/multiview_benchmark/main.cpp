@@ -0,0 +1,472 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+
+#include "support/containers/unique_ptr.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/layered_render_pass.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t multiview_vertex_shader[] =
+#include "multiview_scene.vert.spv"
+    ;
+
+uint32_t layered_vertex_shader[] =
+#include "layered_scene.vert.spv"
+    ;
+
+uint32_t separate_vertex_shader[] =
+#include "separate_scene.vert.spv"
+    ;
+
+uint32_t scene_fragment_shader[] =
+#include "scene.frag.spv"
+    ;
+
+namespace {
+using Mode = vulkan::LayeredRenderPass::Mode;
+
+// The frames of every run, unless frames=<N> was given.
+const uint32_t kDefaultFrames = 8;
+// The cubes of the scene, unless objects=<N> was given.
+const uint32_t kDefaultObjects = 1024;
+// Every configuration is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 5;
+// The views of a stereo pair and of a cubemap, unless views=<N> was given.
+const uint32_t kViewCounts[] = {2, 6};
+// The paths that are measured, unless paths=<list> was given. The layered
+// path needs VK_EXT_shader_viewport_index_layer, and a device without it
+// can not run the sample at all, so it is only measured when asked for.
+const char* kDefaultPaths = "separate,multiview";
+// The width and height of every view.
+const uint32_t kViewSize = 1024;
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkFormat kDepthFormat = VK_FORMAT_D16_UNORM;
+// Enough for the color and depth layers of six views.
+const uint32_t kImageMemory = 64 * 1024 * 1024;
+// The vertices of a cube, see scene.glsl.
+const uint32_t kCubeVertices = 36;
+
+const Mode kModes[] = {Mode::kSeparate, Mode::kMultiview, Mode::kLayered};
+
+// The device extensions of each set of paths. The separate path needs none.
+const std::initializer_list<const char*> kNoExtensions = {};
+const std::initializer_list<const char*> kMultiviewExtensions = {
+    VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME,
+    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME};
+const std::initializer_list<const char*> kLayeredExtensions = {
+    VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME};
+const std::initializer_list<const char*> kMultiviewLayeredExtensions = {
+    VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME,
+    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+    VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME};
+const std::initializer_list<const char*> kMultiviewInstanceExtensions = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// The push constants of scene.glsl.
+struct DrawData {
+  uint32_t object;
+  uint32_t view;
+  uint32_t num_views;
+};
+
+const char* GetPaths(const entry::EntryData* data) {
+  const char* paths = data->sample_option("paths");
+  return paths ? paths : kDefaultPaths;
+}
+
+// Renders a scene of cubes into 2 and 6 views with every path, and
+// measures the CPU time of recording a frame, its GPU time, and how often
+// the vertex shader runs in it.
+class MultiviewBenchmark {
+ public:
+  MultiviewBenchmark(const entry::EntryData* data,
+                     vulkan::VulkanApplication* app, bool statistics)
+      : data_(data),
+        app_(app),
+        frames_(data->sample_option_uint("frames", kDefaultFrames)),
+        objects_(data->sample_option_uint("objects", kDefaultObjects)),
+        paths_(GetPaths(data)),
+        statistics_(statistics),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })) {
+    if (statistics_) {
+      statistics_pool_ = containers::make_unique<vulkan::VkQueryPool>(
+          data_->allocator(),
+          vulkan::CreateQueryPool(
+              &app->device(),
+              {
+                  VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                  nullptr,                                   // pNext
+                  0,                                         // flags
+                  VK_QUERY_TYPE_PIPELINE_STATISTICS,         // queryType
+                  1,                                         // queryCount
+                  VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+                  // pipelineStatistics
+              }));
+    }
+    VkPushConstantRange draw_range = {
+        VK_SHADER_STAGE_VERTEX_BIT,  // stageFlags
+        0,                           // offset
+        sizeof(DrawData)             // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(), app_->CreatePipelineLayout({}, {draw_range}));
+  }
+
+  // Measures every path of paths_ at every view count that the sample
+  // options do not rule out, and logs the results.
+  void Run() {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    const uint32_t views_option = data_->sample_option_uint("views", 0);
+    for (uint32_t num_views : kViewCounts) {
+      if (views_option) {
+        // Any view count can be asked for, not only the default ones.
+        if (num_views != kViewCounts[0]) {
+          break;
+        }
+        num_views = views_option;
+      }
+      // The separate path is what the others save on.
+      Result separate;
+      Result best;
+      const char* best_path = nullptr;
+      for (Mode mode : kModes) {
+        const char* path = vulkan::LayeredRenderPass::ModeName(mode);
+        if (!entry::ListHas(paths_, path)) {
+          continue;
+        }
+        if (mode == Mode::kMultiview &&
+            !vulkan::LayeredRenderPass::MultiviewSupported(app_, num_views)) {
+          data_->logger()->LogInfo("MULTIVIEW: views: ", num_views,
+                                   " path: ", path,
+                                   " is skipped, it is not supported");
+          continue;
+        }
+        const Result result = Measure(mode, num_views);
+        data_->logger()->LogInfo(
+            "MULTIVIEW: views: ", num_views, " path: ", path,
+            " passes_per_frame: ", mode == Mode::kSeparate ? num_views : 1,
+            " draws_per_frame: ",
+            (mode == Mode::kSeparate ? num_views : 1) * objects_,
+            " cpu_ms_per_frame: ", Milliseconds(result.cpu_ns),
+            " gpu_ms_per_frame: ", Milliseconds(result.gpu_ns),
+            " vertex_invocations_per_frame: ",
+            result.vertex_invocations < 0.0
+                ? -1.0
+                : result.vertex_invocations / frames_);
+        if (mode == Mode::kSeparate) {
+          separate = result;
+        }
+        if (result.gpu_ns >= 0.0 &&
+            (best.gpu_ns < 0.0 || result.gpu_ns < best.gpu_ns)) {
+          best = result;
+          best_path = path;
+        }
+      }
+      if (best_path) {
+        data_->logger()->LogInfo(
+            "MULTIVIEW_BEST: views: ", num_views, " path: ", best_path,
+            " cpu_saving_percent: ",
+            SavingPercent(separate.cpu_ns, best.cpu_ns),
+            " gpu_saving_percent: ",
+            SavingPercent(separate.gpu_ns, best.gpu_ns));
+      }
+    }
+  }
+
+ private:
+  // The fastest CPU and GPU times of the runs of a configuration, in
+  // nanoseconds, and the vertex shader invocations of a run. All of them
+  // are negative if they were not measured.
+  struct Result {
+    Result() : cpu_ns(-1.0), gpu_ns(-1.0), vertex_invocations(-1.0) {}
+    double cpu_ns;
+    double gpu_ns;
+    double vertex_invocations;
+  };
+
+  double Milliseconds(double ns) const {
+    return ns < 0.0 ? -1.0 : ns / frames_ / 1.0e6;
+  }
+
+  // How much less time |ns| takes than |separate_ns|, or 0 if either was
+  // not measured.
+  static double SavingPercent(double separate_ns, double ns) {
+    if (separate_ns <= 0.0 || ns < 0.0) {
+      return 0.0;
+    }
+    return 100.0 * (separate_ns - ns) / separate_ns;
+  }
+
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreatePipeline(
+      vulkan::LayeredRenderPass* pass) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app_->CreateGraphicsPipeline(pipeline_layout_.get(),
+                                     &pass->render_pass(), 0));
+    switch (pass->mode()) {
+      case Mode::kSeparate:
+        pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                            separate_vertex_shader);
+        break;
+      case Mode::kMultiview:
+        pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                            multiview_vertex_shader);
+        break;
+      case Mode::kLayered:
+        pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                            layered_vertex_shader);
+        break;
+    }
+    pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                        scene_fragment_shader);
+    pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline->SetViewport({
+        0.0f,                           // x
+        0.0f,                           // y
+        static_cast<float>(kViewSize),  // width
+        static_cast<float>(kViewSize),  // height
+        0.0f,                           // minDepth
+        1.0f                            // maxDepth
+    });
+    pipeline->SetScissor({{0, 0}, {kViewSize, kViewSize}});
+    pipeline->AddAttachment();
+    pipeline->Commit();
+    return pipeline;
+  }
+
+  // Records frames_ frames of every view into |cmd|. This is what the CPU
+  // time of a run is measured on.
+  void RecordFrames(vulkan::VkCommandBuffer* cmd,
+                    vulkan::LayeredRenderPass* pass,
+                    vulkan::VulkanGraphicsPipeline* pipeline) {
+    const VkClearColorValue clear_color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    DrawData draw = {0, 0, pass->num_views()};
+    const uint32_t instances = pass->instance_count(1);
+    for (uint32_t frame = 0; frame < frames_; ++frame) {
+      for (uint32_t i = 0; i < pass->num_passes(); ++i) {
+        pass->Begin(cmd, i, clear_color);
+        (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  *pipeline);
+        draw.view = i;
+        for (uint32_t object = 0; object < objects_; ++object) {
+          draw.object = object;
+          (*cmd)->vkCmdPushConstants(
+              *cmd, ::VkPipelineLayout(*pipeline_layout_),
+              VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw), &draw);
+          (*cmd)->vkCmdDraw(*cmd, kCubeVertices, instances, 0, 0);
+        }
+        pass->End(cmd);
+      }
+    }
+  }
+
+  // Returns the fastest of kNumRuns runs of frames_ frames with |mode|.
+  Result Measure(Mode mode, uint32_t num_views) {
+    vulkan::LayeredRenderPass pass(app_, mode, num_views, kViewSize,
+                                   kViewSize, kColorFormat, kDepthFormat);
+    auto pipeline = CreatePipeline(&pass);
+
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    Result best;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      if (statistics_) {
+        cmd->vkCmdResetQueryPool(cmd, *statistics_pool_, 0, 1);
+        cmd->vkCmdBeginQuery(cmd, *statistics_pool_, 0, 0);
+      }
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               query_pool_, 0);
+      const auto record_start = std::chrono::high_resolution_clock::now();
+      RecordFrames(&cmd, &pass, pipeline.get());
+      const auto record_end = std::chrono::high_resolution_clock::now();
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      if (statistics_) {
+        cmd->vkCmdEndQuery(cmd, *statistics_pool_, 0);
+      }
+      cmd->vkEndCommandBuffer(cmd);
+
+      VkSubmitInfo submit_info = {
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+          nullptr,                        // pNext
+          0,                              // waitSemaphoreCount
+          nullptr,                        // pWaitSemaphores
+          nullptr,                        // pWaitDstStageMask
+          1,                              // commandBufferCount
+          &cmd.get_command_buffer(),      // pCommandBuffers
+          0,                              // signalSemaphoreCount
+          nullptr                         // pSignalSemaphores
+      };
+      queue->vkQueueSubmit(queue, 1, &submit_info, ::VkFence(0));
+      queue->vkQueueWaitIdle(queue);
+
+      const double cpu_ns = static_cast<double>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(record_end -
+                                                               record_start)
+              .count());
+      if (best.cpu_ns < 0.0 || cpu_ns < best.cpu_ns) {
+        best.cpu_ns = cpu_ns;
+      }
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) ==
+          VK_SUCCESS) {
+        const double ns =
+            ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+            static_cast<double>(device.limits().timestampPeriod);
+        if (best.gpu_ns < 0.0 || ns < best.gpu_ns) {
+          best.gpu_ns = ns;
+        }
+      }
+      uint64_t invocations;
+      if (statistics_ &&
+          device->vkGetQueryPoolResults(
+              device, *statistics_pool_, 0, 1, sizeof(invocations),
+              &invocations, sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) ==
+              VK_SUCCESS) {
+        // Every run renders the same, so any of them will do.
+        best.vertex_invocations = static_cast<double>(invocations);
+      }
+    }
+    return best;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t frames_;
+  uint32_t objects_;
+  const char* paths_;
+  bool statistics_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+  containers::unique_ptr<vulkan::VkQueryPool> statistics_pool_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+};
+
+// Returns the device extensions of |paths|.
+const std::initializer_list<const char*>& DeviceExtensions(
+    const char* paths) {
+  const bool multiview = entry::ListHas(paths, "multiview");
+  const bool layered = entry::ListHas(paths, "layered");
+  if (multiview) {
+    return layered ? kMultiviewLayeredExtensions : kMultiviewExtensions;
+  }
+  return layered ? kLayeredExtensions : kNoExtensions;
+}
+}  // anonymous namespace
+
+// This sample renders a ring of cubes into the 2 views of a stereo pair and
+// the 6 views of a cubemap, each view a layer of an array image, with:
+//  - separate: one render pass per view, which draws every cube,
+//  - multiview: one VK_KHR_multiview render pass with a view mask of every
+//    view, which draws every cube once,
+//  - layered: one render pass with a framebuffer of every layer, which
+//    draws an instance of every cube per view and picks the layer with
+//    gl_Layer. This is the fallback for devices without multiview.
+// For every view count and path it logs:
+//   MULTIVIEW: views: <n> path: <name> passes_per_frame: <n>
+//       draws_per_frame: <n> cpu_ms_per_frame: <ms> gpu_ms_per_frame: <ms>
+//       vertex_invocations_per_frame: <n>
+// and the path with the fastest GPU time, with what it saves on the CPU
+// and the GPU compared to the separate path, as
+//   MULTIVIEW_BEST: views: <n> path: <name> cpu_saving_percent: <p>
+//       gpu_saving_percent: <p>
+// -sample-option=paths is a comma separated list of the paths to measure,
+// e.g. -sample-option=paths=separate,layered, by default
+// separate,multiview, and the device needs the extensions of each. An
+// unknown path is an error. views only measures that view count, objects
+// sets the cubes of the scene, frames the frames of every run, and
+// statistics=1 counts the vertex shader invocations, which needs
+// pipelineStatisticsQuery. Without it they are logged as -1.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  const char* paths = GetPaths(data);
+  std::string unknown_path;
+  if (!vulkan::LayeredRenderPass::ModeNamesValid(paths, &unknown_path)) {
+    data->logger()->LogError("Unknown path \"", unknown_path,
+                             "\" in -sample-option=paths");
+    return -1;
+  }
+  const bool multiview = entry::ListHas(paths, "multiview");
+  const bool statistics = data->sample_option_uint("statistics", 0) != 0;
+  VkPhysicalDeviceFeatures features = {0};
+  features.pipelineStatisticsQuery = statistics;
+  // VK_KHR_multiview requires the feature, but the device must still be
+  // created with it.
+  VkPhysicalDeviceMultiviewFeatures multiview_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES,  // sType
+      nullptr,                                               // pNext
+      VK_TRUE,                                               // multiview
+      VK_FALSE,  // multiviewGeometryShader
+      VK_FALSE   // multiviewTessellationShader
+  };
+
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data,
+      multiview ? kMultiviewInstanceExtensions : kNoExtensions,
+      DeviceExtensions(paths), features, 1024 * 1024, kImageMemory,
+      1024 * 1024, 1024 * 1024, false, false, false, 0, false, false,
+      VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, false, false, nullptr, false, false,
+      multiview ? &multiview_features : nullptr);
+  MultiviewBenchmark benchmark(data, &app, statistics);
+  benchmark.Run();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
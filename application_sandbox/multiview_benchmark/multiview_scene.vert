@@ -0,0 +1,25 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_EXT_multiview : require
+#include "scene.glsl"
+
+// The multiview path draws every cube once per pass, and the
+// implementation runs the vertex shader for each view of the view mask.
+void main() {
+    gl_Position = scene_position(uint(gl_VertexIndex), draw.object,
+                                 uint(gl_ViewIndex));
+}
@@ -0,0 +1,75 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The scene that every path renders: cubes on a ring around the views,
+// each turned its own way. The vertex shaders only differ in where they get
+// the view of a vertex from, and call scene_position() with it.
+
+layout(push_constant) uniform draw_data {
+    // The cube of the draw.
+    uint object;
+    // The view of the draw in the separate path.
+    uint view;
+    // The views of the pass. The layered path draws an instance per view.
+    uint num_views;
+} draw;
+
+layout(location = 0) out vec3 color;
+
+// The views turn about the y axis by this much each, so that six of them
+// look along the faces of a cubemap around the y axis, and two of them see
+// mostly the same cubes, like a stereo pair.
+const float kViewAngle = 1.04719755;
+const float kNear = 0.1;
+const float kFar = 100.0;
+
+// Two triangles for each face of a cube, as indices of its corners. Bit 0,
+// 1 and 2 of a corner index are its x, y and z.
+const uint kCubeIndices[36] = uint[](
+    0u, 2u, 4u, 4u, 2u, 6u,
+    1u, 3u, 5u, 5u, 3u, 7u,
+    0u, 1u, 4u, 4u, 1u, 5u,
+    2u, 3u, 6u, 6u, 3u, 7u,
+    0u, 1u, 2u, 2u, 1u, 3u,
+    4u, 5u, 6u, 6u, 5u, 7u);
+
+vec3 rotate_y(vec3 position, float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return vec3(c * position.x + s * position.z, position.y,
+                c * position.z - s * position.x);
+}
+
+// Returns the clip space position of vertex |vertex| of cube |object| in
+// view |view|.
+vec4 scene_position(uint vertex, uint object, uint view) {
+    uint corner = kCubeIndices[vertex];
+    vec3 position =
+        vec3(corner & 1u, (corner >> 1u) & 1u, (corner >> 2u) & 1u) * 2.0 -
+        1.0;
+    color = position * 0.5 + 0.5;
+
+    // The golden angle spreads the cubes evenly around the ring.
+    float ring_angle = float(object) * 2.39996323;
+    vec3 world = rotate_y(position * 0.25, float(object) * 0.37) +
+        vec3(10.0 * cos(ring_angle), float(object % 16u) - 7.5,
+             10.0 * sin(ring_angle));
+
+    vec3 eye = rotate_y(world, -float(view) * kViewAngle);
+    // A projection with a field of view of 90 degrees, looking along -z.
+    return vec4(eye.x, eye.y,
+                eye.z * kFar / (kNear - kFar) + kNear * kFar / (kNear - kFar),
+                -eye.z);
+}
@@ -0,0 +1,540 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t precision_fp32_shader[] =
+#include "precision_fp32.comp.spv"
+    ;
+
+uint32_t precision_fp16_shader[] =
+#include "precision_fp16.comp.spv"
+    ;
+
+uint32_t precision_int8_shader[] =
+#include "precision_int8.comp.spv"
+    ;
+
+namespace {
+// This must match local_size_x in precision_common.glsl.
+const uint32_t kWorkGroupSize = 256;
+// The smallest maxComputeWorkGroupCount[0] that a device may have.
+const uint32_t kMaxGroups = 65535;
+// The number of four component vectors that every kernel reads and writes.
+const uint32_t kDefaultVectors = 1 << 22;
+// The iterations of the arithmetic kernel, the bandwidth kernel has none.
+const uint32_t kDefaultIterations = 256;
+// Every measurement is run this many times, and the fastest run is kept.
+const uint32_t kNumRuns = 5;
+// The input element i is the same as element i % kInputPeriod, so the
+// reference results are only computed for those.
+const uint32_t kInputPeriod = 1024;
+// The number of independent chains of every invocation, this must match
+// precision_common.glsl.
+const uint32_t kNumChains = 4;
+
+enum Type {
+  kFp32,
+  kFp16,
+  kInt8,
+  kNumTypes,
+};
+
+struct TypeInfo {
+  // The name of the type in the sample options and the results.
+  const char* name;
+  uint32_t* shader;
+  size_t shader_size;
+  uint32_t scalar_size;
+  // The shader computes x = x * scale + bias.
+  float scale;
+  float bias;
+  // The largest difference from the reference that is allowed, relative to
+  // its magnitude. The integer arithmetic has to match exactly.
+  double tolerance;
+};
+
+const TypeInfo kTypes[kNumTypes] = {
+    {"fp32", precision_fp32_shader, sizeof(precision_fp32_shader), 4, 0.5f,
+     0.25f, 1e-5},
+    {"fp16", precision_fp16_shader, sizeof(precision_fp16_shader), 2, 0.5f,
+     0.25f, 1e-2},
+    {"int8", precision_int8_shader, sizeof(precision_int8_shader), 1, 3.0f,
+     1.0f, 0.0},
+};
+
+enum Kernel {
+  kArithmetic,
+  kBandwidth,
+  kNumKernels,
+};
+
+const char* const kKernelNames[kNumKernels] = {"alu", "bandwidth"};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// Returns the input element at |index| of the floating point types.
+float FloatInput(uint32_t index) {
+  return static_cast<float>(index % kInputPeriod) / kInputPeriod;
+}
+
+// Returns the input element at |index| of the integer type.
+uint8_t IntInput(uint32_t index) { return static_cast<uint8_t>(index * 7); }
+
+void SubmitAndWait(vulkan::VkQueue* queue, vulkan::VkCommandBuffer* cmd) {
+  VkSubmitInfo submit_info = {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &cmd->get_command_buffer(),     // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+  (*queue)->vkQueueWaitIdle(*queue);
+}
+
+void MemoryBarrier(vulkan::VkCommandBuffer* cmd, VkPipelineStageFlags src,
+                   VkAccessFlags src_access, VkPipelineStageFlags dst,
+                   VkAccessFlags dst_access) {
+  VkMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+      nullptr,                           // pNext
+      src_access,                        // srcAccessMask
+      dst_access,                        // dstAccessMask
+  };
+  (*cmd)->vkCmdPipelineBarrier(*cmd, src, dst, 0, 1, &barrier, 0, nullptr, 0,
+                               nullptr);
+}
+
+// Runs the same arithmetic-bound and bandwidth-bound kernels with 32-bit
+// floats, 16-bit floats and 8-bit integers, for both arithmetic and storage.
+// The results of every type are checked on the host before its throughput
+// is logged, along with how it compares to 32-bit floats.
+class PrecisionBenchmark {
+ public:
+  PrecisionBenchmark(const entry::EntryData* data,
+                     vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        num_vectors_(data->sample_option_uint("vectors", kDefaultVectors)),
+        iterations_(data->sample_option_uint("iterations", kDefaultIterations)),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })) {
+    vulkan::VkDevice& device = app->device();
+    // Every invocation handles one vector, and the dispatch is at most
+    // kMaxGroups workgroups.
+    num_vectors_ = std::min(num_vectors_, kMaxGroups * kWorkGroupSize);
+    num_vectors_ = std::max(num_vectors_ / kWorkGroupSize, 1u) *
+                   kWorkGroupSize;
+
+    for (uint32_t i = 0; i < 2; ++i) {
+      bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(Constants)             // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout({{bindings_[0], bindings_[1]}}, {range}));
+
+    // The buffers are large enough for the 32-bit type.
+    const VkDeviceSize size =
+        VkDeviceSize(num_vectors_) * 4 * kTypes[kFp32].scalar_size;
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    input_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(size, usage);
+    output_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(size, usage);
+    host_buffer_ = app->CreateAndBindDefaultExclusiveHostBuffer(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    set_ = containers::make_unique<vulkan::DescriptorSet>(
+        data->allocator(),
+        app->AllocateDescriptorSet({bindings_[0], bindings_[1]}));
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {*input_, 0, VK_WHOLE_SIZE},
+        {*output_, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *set_,                                   // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    device->vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+  }
+
+  // Measures both kernels with every type, or only with |only_type| and
+  // 32-bit floats, and logs the results.
+  void Run(const char* only_type) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    // The fastest time of every kernel and type in nanoseconds, negative if
+    // it was not measured or the result was wrong.
+    double times[kNumKernels][kNumTypes];
+    for (uint32_t type = 0; type < kNumTypes; ++type) {
+      for (uint32_t kernel = 0; kernel < kNumKernels; ++kernel) {
+        times[kernel][type] = -1.0;
+      }
+      // 32-bit floats are always measured, since the other types are
+      // compared with them.
+      if (type != kFp32 && only_type &&
+          strcmp(only_type, kTypes[type].name) != 0) {
+        continue;
+      }
+      Upload(static_cast<Type>(type));
+      vulkan::VulkanComputePipeline pipeline = app_->CreateComputePipeline(
+          pipeline_layout_.get(),
+          VkShaderModuleCreateInfo{
+              VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+              kTypes[type].shader_size, kTypes[type].shader},
+          "main");
+      for (uint32_t kernel = 0; kernel < kNumKernels; ++kernel) {
+        times[kernel][type] = Measure(&pipeline, static_cast<Type>(type),
+                                      static_cast<Kernel>(kernel));
+      }
+    }
+
+    const double vectors = num_vectors_;
+    for (uint32_t kernel = 0; kernel < kNumKernels; ++kernel) {
+      for (uint32_t type = 0; type < kNumTypes; ++type) {
+        const double ns = times[kernel][type];
+        if (ns <= 0.0) {
+          continue;
+        }
+        const double fp32_ns = times[kernel][kFp32];
+        // The kernels do the same work in every type, so the ratio of the
+        // throughput is the inverse ratio of the time.
+        const double ratio = fp32_ns > 0.0 ? fp32_ns / ns : -1.0;
+        if (kernel == kArithmetic) {
+          // Every iteration is a multiply and an add of every chain.
+          const double ops = vectors * 4 * kNumChains * 2 * iterations_;
+          data_->logger()->LogInfo(
+              "PRECISION: kernel: ", kKernelNames[kernel],
+              " type: ", kTypes[type].name, " Gops/s: ", ops / ns,
+              " ratio_to_fp32: ", ratio);
+        } else {
+          const double elements = vectors * 4;
+          const double bytes = elements * kTypes[type].scalar_size * 2;
+          data_->logger()->LogInfo(
+              "PRECISION: kernel: ", kKernelNames[kernel],
+              " type: ", kTypes[type].name, " GB/s: ", bytes / ns,
+              " Gelements/s: ", elements / ns, " ratio_to_fp32: ", ratio);
+        }
+      }
+    }
+  }
+
+ private:
+  struct Constants {
+    uint32_t iterations;
+    float scale;
+    float bias;
+  };
+
+  // Writes the input of |type| to the input buffer.
+  void Upload(Type type) {
+    const uint32_t num_elements = num_vectors_ * 4;
+    char* base = host_buffer_->base_address();
+    for (uint32_t i = 0; i < num_elements; ++i) {
+      switch (type) {
+        case kFp32:
+          reinterpret_cast<float*>(base)[i] = FloatInput(i);
+          break;
+        case kFp16:
+          reinterpret_cast<uint16_t*>(base)[i] =
+              vulkan::FloatToHalf(FloatInput(i));
+          break;
+        case kInt8:
+          reinterpret_cast<uint8_t*>(base)[i] = IntInput(i);
+          break;
+        case kNumTypes:
+          break;
+      }
+    }
+    host_buffer_->flush();
+    vulkan::VkCommandBuffer cmd =
+        app_->GetCommandBuffer(app_->render_queue().index());
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    VkBufferCopy region = {
+        0,                                                      // srcOffset
+        0,                                                      // dstOffset
+        VkDeviceSize(num_elements) * kTypes[type].scalar_size  // size
+    };
+    cmd->vkCmdCopyBuffer(cmd, *host_buffer_, *input_, 1, &region);
+    cmd->vkEndCommandBuffer(cmd);
+    SubmitAndWait(&app_->render_queue(), &cmd);
+  }
+
+  // Returns the fastest of kNumRuns runs of |kernel| with |type| in
+  // nanoseconds, or a negative number if it could not be measured or the
+  // result is not within the tolerance of the type.
+  double Measure(vulkan::VulkanComputePipeline* pipeline, Type type,
+                 Kernel kernel) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    const TypeInfo& info = kTypes[type];
+    const Constants constants = {
+        kernel == kArithmetic ? iterations_ : 0,  // iterations
+        info.scale,                               // scale
+        info.bias                                 // bias
+    };
+    const VkDeviceSize size = VkDeviceSize(num_vectors_) * 4 * info.scalar_size;
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 0);
+      cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline);
+      cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *pipeline_layout_, 0, 1, &set_->raw_set(),
+                                   0, nullptr);
+      cmd->vkCmdPushConstants(cmd, *pipeline_layout_,
+                              VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                              sizeof(constants), &constants);
+      cmd->vkCmdDispatch(cmd, num_vectors_ / kWorkGroupSize, 1, 1);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      if (run + 1 == kNumRuns) {
+        // Only the last run is read back and checked.
+        MemoryBarrier(&cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_READ_BIT);
+        VkBufferCopy region = {0, 0, size};
+        cmd->vkCmdCopyBuffer(cmd, *output_, *host_buffer_, 1, &region);
+        MemoryBarrier(&cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                      VK_ACCESS_HOST_READ_BIT);
+      }
+      cmd->vkEndCommandBuffer(cmd);
+      SubmitAndWait(&queue, &cmd);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    if (best <= 0.0) {
+      return -1.0;
+    }
+
+    const double error = MaxError(type, constants);
+    if (error > info.tolerance) {
+      data_->logger()->LogError(
+          "PRECISION: kernel: ", kKernelNames[kernel], " type: ", info.name,
+          " the result is not within the tolerance, relative error: ", error,
+          " tolerance: ", info.tolerance);
+      return -1.0;
+    }
+    return best;
+  }
+
+  // Returns the largest difference of the results in the host buffer from
+  // the reference, relative to its magnitude.
+  double MaxError(Type type, const Constants& constants) {
+    host_buffer_->invalidate();
+    const char* base = host_buffer_->base_address();
+    const uint32_t num_elements = num_vectors_ * 4;
+
+    if (type == kInt8) {
+      // Unsigned arithmetic wraps around the same way as the 8-bit integers
+      // of the shader.
+      const uint8_t scale = static_cast<uint8_t>(constants.scale);
+      const uint8_t bias = static_cast<uint8_t>(constants.bias);
+      uint8_t reference[kInputPeriod];
+      for (uint32_t i = 0; i < kInputPeriod; ++i) {
+        uint8_t x[kNumChains];
+        x[0] = IntInput(i);
+        for (uint32_t chain = 1; chain < kNumChains; ++chain) {
+          x[chain] = static_cast<uint8_t>(x[chain - 1] + bias);
+        }
+        for (uint32_t j = 0; j < constants.iterations; ++j) {
+          for (uint32_t chain = 0; chain < kNumChains; ++chain) {
+            x[chain] = static_cast<uint8_t>(x[chain] * scale + bias);
+          }
+        }
+        reference[i] = static_cast<uint8_t>(x[0] + x[1] + x[2] + x[3]);
+      }
+      const uint8_t* results = reinterpret_cast<const uint8_t*>(base);
+      for (uint32_t i = 0; i < num_elements; ++i) {
+        if (results[i] != reference[i % kInputPeriod]) {
+          return 1.0;
+        }
+      }
+      return 0.0;
+    }
+
+    double reference[kInputPeriod];
+    for (uint32_t i = 0; i < kInputPeriod; ++i) {
+      double x[kNumChains];
+      x[0] = FloatInput(i);
+      for (uint32_t chain = 1; chain < kNumChains; ++chain) {
+        x[chain] = x[chain - 1] + constants.bias;
+      }
+      for (uint32_t j = 0; j < constants.iterations; ++j) {
+        for (uint32_t chain = 0; chain < kNumChains; ++chain) {
+          x[chain] = x[chain] * constants.scale + constants.bias;
+        }
+      }
+      reference[i] = x[0] + x[1] + x[2] + x[3];
+    }
+    double max_error = 0.0;
+    for (uint32_t i = 0; i < num_elements; ++i) {
+      const double result =
+          type == kFp32
+              ? reinterpret_cast<const float*>(base)[i]
+              : vulkan::HalfToFloat(reinterpret_cast<const uint16_t*>(base)[i]);
+      const double expected = reference[i % kInputPeriod];
+      const double error =
+          std::abs(result - expected) / std::max(std::abs(expected), 1.0);
+      // NaNs fail the comparison, so they are counted as wrong.
+      if (!(error <= max_error)) {
+        max_error = std::isnan(error) ? 1.0 : error;
+      }
+    }
+    return max_error;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t num_vectors_;
+  uint32_t iterations_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+  VkDescriptorSetLayoutBinding bindings_[2];
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> input_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> output_;
+  // The input is uploaded from this, and the results are read back into it.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> host_buffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> set_;
+};
+}  // anonymous namespace
+
+// This sample runs the same kernels with 32-bit floats, 16-bit floats and
+// 8-bit integers in both arithmetic and storage, one bound by the arithmetic
+// and one by the bandwidth. It checks that the results are within the
+// tolerance of every type, and then logs their throughput and how it
+// compares to 32-bit floats:
+//   PRECISION: kernel: alu type: <type> Gops/s: <ops> ratio_to_fp32: <ratio>
+//   PRECISION: kernel: bandwidth type: <type> GB/s: <bandwidth>
+//       Gelements/s: <elements> ratio_to_fp32: <ratio>
+// -sample-option=type=<type> only measures that type and 32-bit floats, and
+// vectors and iterations change the size of the kernels.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16_int8_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR,
+      nullptr,  // pNext
+      VK_TRUE,  // shaderFloat16
+      VK_TRUE   // shaderInt8
+  };
+  VkPhysicalDevice16BitStorageFeaturesKHR sixteen_bit_storage_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES_KHR,
+      &float16_int8_features,  // pNext
+      VK_TRUE,                 // storageBuffer16BitAccess
+      VK_FALSE,                // uniformAndStorageBuffer16BitAccess
+      VK_FALSE,                // storagePushConstant16
+      VK_FALSE                 // storageInputOutput16
+  };
+  VkPhysicalDevice8BitStorageFeaturesKHR eight_bit_storage_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES_KHR,
+      &sixteen_bit_storage_features,  // pNext
+      VK_TRUE,                        // storageBuffer8BitAccess
+      VK_FALSE,                       // uniformAndStorageBuffer8BitAccess
+      VK_FALSE                        // storagePushConstant8
+  };
+
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data,
+      {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+      {VK_KHR_STORAGE_BUFFER_STORAGE_CLASS_EXTENSION_NAME,
+       VK_KHR_16BIT_STORAGE_EXTENSION_NAME, VK_KHR_8BIT_STORAGE_EXTENSION_NAME,
+       VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME},
+      {0}, 1024 * 1024, 1024 * 1024, 1024 * 1024, 1024 * 1024, false, false,
+      false, 0, false, false, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, false, false,
+      nullptr, false, false, &eight_bit_storage_features);
+  PrecisionBenchmark benchmark(data, &app);
+  benchmark.Run(data->sample_option("type"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,56 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The kernel that every type runs. The shaders define these before
+// including this:
+//   SCALAR(x): converts the float x to the scalar type.
+//   VEC4: the four component vector of the scalar type.
+// With iterations set to 0 the kernel is bound by the bandwidth of the
+// buffers, and with many iterations by the arithmetic.
+
+// This must match kWorkGroupSize in main.cpp.
+layout (local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+layout (binding = 0, set = 0, std430) readonly buffer input_data {
+    VEC4 values[];
+};
+
+layout (binding = 1, set = 0, std430) writeonly buffer output_data {
+    VEC4 results[];
+};
+
+layout (push_constant) uniform precision_constants {
+    uint iterations;
+    float scale;
+    float bias;
+};
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    VEC4 a = VEC4(SCALAR(scale));
+    VEC4 b = VEC4(SCALAR(bias));
+    // Four independent chains, so the arithmetic is not bound by latency.
+    VEC4 x0 = values[index];
+    VEC4 x1 = x0 + b;
+    VEC4 x2 = x1 + b;
+    VEC4 x3 = x2 + b;
+    for (uint i = 0; i < iterations; ++i) {
+        x0 = x0 * a + b;
+        x1 = x1 * a + b;
+        x2 = x2 * a + b;
+        x3 = x3 * a + b;
+    }
+    results[index] = x0 + x1 + x2 + x3;
+}
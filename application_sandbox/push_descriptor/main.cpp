@@ -83,6 +83,10 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
             {{{cube_descriptor_set_layouts[0], cube_descriptor_set_layouts[1]},
               VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR}}));
 
+    descriptor_writer_ = containers::make_unique<vulkan::DescriptorWriter>(
+        data_->allocator(),
+        app()->CreateDescriptorWriter(*pipeline_layout_, 0));
+
     VkAttachmentReference color_attachment = {
         0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
 
@@ -137,6 +141,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -215,22 +221,9 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                                  *cube_pipeline_);
 
-    VkWriteDescriptorSet write{
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-        nullptr,                                 // pNext
-        VK_NULL_HANDLE,                          // dstSet
-        0,                                       // dstbinding
-        0,                                       // dstArrayElement
-        2,                                       // descriptorCount
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
-        nullptr,                                 // pImageInfo
-        buffer_infos,                            // pBufferInfo
-        nullptr,                                 // pTexelBufferView
-    };
-
-    cmdBuffer->vkCmdPushDescriptorSetKHR(cmdBuffer,
-                                         VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                         *pipeline_layout_, 0, 1, &write);
+    // The camera and model buffers, for bindings 0 and 1.
+    descriptor_writer_->Push(&cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                             *pipeline_layout_, 0, buffer_infos);
 
     cube_.Draw(&cmdBuffer);
     cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
@@ -248,10 +241,6 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
@@ -280,6 +269,7 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
 
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::DescriptorWriter> descriptor_writer_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
   containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
   vulkan::VulkanModel cube_;
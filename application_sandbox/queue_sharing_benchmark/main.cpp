@@ -0,0 +1,483 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "support/trace/trace.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+uint32_t fill_compute_shader[] =
+#include "fill.comp.spv"
+    ;
+
+uint32_t fullscreen_vertex_shader[] =
+#include "fullscreen.vert.spv"
+    ;
+
+uint32_t show_fragment_shader[] =
+#include "show.frag.spv"
+    ;
+
+namespace {
+// The frames of every configuration that are measured, after the warmup
+// frames, which fill the swapchain and the frames in flight.
+const uint32_t kDefaultFramesPerConfig = 300;
+const uint32_t kWarmupFrames = 30;
+// The size of the buffer that the compute work of every frame writes, and
+// its graphics work reads.
+const uint32_t kDefaultBufferKb = 4096;
+// The local size of fill.comp.
+const uint32_t kFillGroupSize = 64;
+
+struct Config {
+  // Shares the swapchain images and the buffers between the queue families
+  // with VK_SHARING_MODE_CONCURRENT, instead of transferring their
+  // ownership every frame.
+  bool concurrent;
+  // Writes the buffer with the compute stage of the Sample, on the async
+  // compute queue, instead of on the render queue before the graphics work.
+  bool async_compute;
+};
+
+const Config kConfigs[] = {
+    {false, false},
+    {true, false},
+    {false, true},
+    {true, true},
+};
+
+const char* SharingName(bool concurrent) {
+  return concurrent ? "concurrent" : "exclusive";
+}
+
+struct ConfigResult {
+  Config config;
+  // Whether the present and async compute queues were of another queue
+  // family than the render queue, so that the sharing mode mattered.
+  bool separate_present_family;
+  bool separate_compute_family;
+  double frames_per_second;
+  double frame_time_ms;
+};
+
+sample_application::SampleOptions BenchmarkOptions(const entry::EntryData* data,
+                                                   const Config& config) {
+  sample_application::SampleOptions options;
+  // The throughput is not limited by the display, unless the surface can
+  // not present without waiting for it.
+  options.SetPresentMode(data->present_mode() ? data->present_mode()
+                                              : "immediate");
+  if (config.concurrent) {
+    options.EnableConcurrentSharing();
+  }
+  if (config.async_compute) {
+    options.EnableAsyncComputeStage(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  }
+  return options;
+}
+
+struct QueueSharingFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> values_;
+  containers::unique_ptr<vulkan::DescriptorSet> descriptor_set_;
+};
+
+// This writes a buffer with compute work every frame, and reads all of it
+// in a full screen draw into the swapchain, with one configuration of
+// sharing modes and compute queues. It measures the frames per second.
+class QueueSharingBenchmark
+    : public sample_application::Sample<QueueSharingFrameData> {
+ public:
+  QueueSharingBenchmark(const entry::EntryData* data, const Config& config,
+                        uint32_t frames_per_config, uint32_t buffer_kb)
+      : data_(data),
+        Sample<QueueSharingFrameData>(data->allocator(), data, 1, 1, 32, 1,
+                                      BenchmarkOptions(data, config)),
+        frames_per_config_(frames_per_config),
+        num_values_(buffer_kb * 1024 / sizeof(float)),
+        frame_number_(0),
+        measure_begin_ns_(0),
+        done_(false),
+        result_{} {
+    result_.config = config;
+    result_.separate_present_family =
+        app()->present_queue().index() != app()->render_queue().index();
+    result_.separate_compute_family =
+        app()->async_compute_queue() &&
+        app()->async_compute_queue()->index() != app()->render_queue().index();
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    values_binding_ = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT |
+            VK_SHADER_STAGE_FRAGMENT_BIT,  // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{values_binding_}},
+            {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float)}}));
+    fill_pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+        data_->allocator(),
+        app()->CreateComputePipeline(
+            pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                sizeof(fill_compute_shader), fill_compute_shader},
+            "main"));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                VK_SAMPLE_COUNT_1_BIT,                     // samples
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    show_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    show_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                              fullscreen_vertex_shader);
+    show_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                              show_fragment_shader);
+    show_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    show_pipeline_->SetViewport(viewport());
+    show_pipeline_->SetScissor(scissor());
+    show_pipeline_->SetSamples(VK_SAMPLE_COUNT_1_BIT);
+    show_pipeline_->AddAttachment();
+    show_pipeline_->Commit();
+  }
+
+  virtual void InitializeFrameData(
+      QueueSharingFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    ::VkImageView raw_view = color_view(frame_data);
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // createFlags
+        num_values_ * sizeof(float),           // size
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,    // usageFlags
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr                                // pQueueFamilyIndices
+    };
+    if (result_.config.async_compute) {
+      SetComputeStageSharing(&create_info);
+    }
+    frame_data->values_ = app()->CreateAndBindDeviceBuffer(&create_info);
+    if (result_.config.async_compute) {
+      AddComputeStageBuffer(frame_index, *frame_data->values_);
+    }
+
+    frame_data->descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({values_binding_}));
+    VkDescriptorBufferInfo buffer_info = {
+        *frame_data->values_,         // buffer
+        0,                            // offset
+        frame_data->values_->size(),  // range
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *frame_data->descriptor_set_,            // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        1,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        &buffer_info,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
+                                            nullptr);
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    time_ += time_since_last_render;
+  }
+
+  virtual void RecordComputeStage(vulkan::VkCommandBuffer* command_buffer,
+                                  size_t frame_index,
+                                  QueueSharingFrameData* frame_data) override {
+    RecordFill(command_buffer, frame_data);
+  }
+
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      QueueSharingFrameData* frame_data) override {
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+    if (!result_.config.async_compute) {
+      RecordFill(&cmdBuffer, frame_data);
+      VkMemoryBarrier barrier{
+          VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+          nullptr,                           // pNext
+          VK_ACCESS_SHADER_WRITE_BIT,        // srcAccessMask
+          VK_ACCESS_SHADER_READ_BIT,         // dstAccessMask
+      };
+      cmdBuffer->vkCmdPipelineBarrier(
+          cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr,
+          0, nullptr);
+    }
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        0,                                // clearValueCount
+        nullptr                           // clears
+    };
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *show_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->descriptor_set_->raw_set(), 0, nullptr);
+    cmdBuffer->vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info = sample_application::kEmptySubmitInfo;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmdBuffer.get_command_buffer();
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (frame_number_ == kWarmupFrames) {
+      measure_begin_ns_ = trace::NowNanoseconds();
+    }
+    if (++frame_number_ == frames_per_config_) {
+      const uint32_t num_frames = frames_per_config_ - kWarmupFrames;
+      const double seconds =
+          (trace::NowNanoseconds() - measure_begin_ns_) / 1000000000.0;
+      result_.frames_per_second = seconds > 0.0 ? num_frames / seconds : 0.0;
+      result_.frame_time_ms = seconds * 1000.0 / num_frames;
+      done_ = true;
+    }
+  }
+
+  // Returns true once the configuration has been measured.
+  bool benchmark_done() const { return done_; }
+  const ConfigResult& result() const { return result_; }
+
+ private:
+  // Writes every value of the buffer of |frame_data|.
+  void RecordFill(vulkan::VkCommandBuffer* command_buffer,
+                  QueueSharingFrameData* frame_data) {
+    vulkan::VkCommandBuffer& cmd = *command_buffer;
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           *fill_pipeline_);
+    cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+                                 &frame_data->descriptor_set_->raw_set(), 0,
+                                 nullptr);
+    cmd->vkCmdPushConstants(cmd, ::VkPipelineLayout(*pipeline_layout_),
+                            VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float),
+                            &time_);
+    cmd->vkCmdDispatch(cmd, (num_values_ + kFillGroupSize - 1) / kFillGroupSize,
+                       1, 1);
+  }
+
+  const entry::EntryData* data_;
+  VkDescriptorSetLayoutBinding values_binding_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> fill_pipeline_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> show_pipeline_;
+  uint32_t frames_per_config_;
+  uint32_t num_values_;
+  float time_ = 0.0f;
+  uint64_t frame_number_;
+  int64_t measure_begin_ns_;
+  bool done_;
+  ConfigResult result_;
+};
+
+uint32_t OptionValue(const entry::EntryData* data, const char* name,
+                     uint32_t default_value) {
+  const char* option = data->sample_option(name);
+  return option ? static_cast<uint32_t>(strtoul(option, nullptr, 10))
+                : default_value;
+}
+
+void LogResult(logging::Logger* log, const char* prefix,
+               const ConfigResult& result) {
+  log->LogInfo(prefix, " sharing=", SharingName(result.config.concurrent),
+               " async_compute=", result.config.async_compute ? 1 : 0,
+               " separate_present=", result.separate_present_family ? 1 : 0,
+               " separate_compute=", result.separate_compute_family ? 1 : 0,
+               " fps=", result.frames_per_second,
+               " frame_ms=", result.frame_time_ms);
+}
+}  // anonymous namespace
+
+// Measures every configuration in turn, each with a Sample of its own, and
+// logs the sharing mode that was fastest with and without the async compute
+// stage.
+//   -sample-option=frames_per_config=<n>  the frames of every
+//                                         configuration, the first 30 are
+//                                         not measured.
+//   -sample-option=buffer_kb=<n>          the size of the buffer that every
+//                                         frame writes and reads.
+//   -sample-option=results=<file>         writes the results to <file>, as
+//                                         CSV.
+int main_entry(const entry::EntryData* data) {
+  logging::Logger* log = data->logger();
+  log->LogInfo("Application Startup");
+
+  const uint32_t frames_per_config = std::max(
+      OptionValue(data, "frames_per_config", kDefaultFramesPerConfig),
+      kWarmupFrames + 1);
+  const uint32_t buffer_kb =
+      std::max(OptionValue(data, "buffer_kb", kDefaultBufferKb), 1u);
+
+  std::vector<ConfigResult> results;
+  for (const Config& config : kConfigs) {
+    if (data->WindowClosing()) {
+      break;
+    }
+    // The sample of the last configuration, and its surface, is gone.
+    auto sample = containers::make_unique<QueueSharingBenchmark>(
+        data->allocator(), data, config, frames_per_config, buffer_kb);
+    if (!sample->is_valid()) {
+      log->LogError("The device can not run the benchmark");
+      return -1;
+    }
+    sample->Initialize();
+    while (!sample->should_exit() && !data->WindowClosing() &&
+           !sample->benchmark_done()) {
+      sample->ProcessFrame();
+    }
+    sample->WaitIdle();
+    if (sample->benchmark_done()) {
+      // Do not modify this line, scripts may look for it in the output.
+      LogResult(log, "QUEUE_SHARING:", sample->result());
+      results.push_back(sample->result());
+    }
+  }
+
+  if (results.empty()) {
+    log->LogError("No configuration was measured");
+    return -1;
+  }
+
+  // The sharing mode to pick, with and without the async compute stage.
+  for (bool async_compute : {false, true}) {
+    const ConfigResult* fastest = nullptr;
+    for (const ConfigResult& result : results) {
+      if (result.config.async_compute == async_compute &&
+          (!fastest || result.frames_per_second > fastest->frames_per_second)) {
+        fastest = &result;
+      }
+    }
+    if (!fastest) {
+      continue;
+    }
+    if (!fastest->separate_present_family &&
+        (!async_compute || !fastest->separate_compute_family)) {
+      log->LogInfo("QUEUE_SHARING: async_compute=", async_compute ? 1 : 0,
+                   " has no queue families to share between, the sharing "
+                   "modes only differ by noise");
+    }
+    LogResult(log, "QUEUE_SHARING: fastest:", *fastest);
+  }
+
+  const char* results_file = data->sample_option("results");
+  if (results_file) {
+    std::ofstream out_file(results_file);
+    out_file << "sharing,async_compute,separate_present,separate_compute,fps,"
+                "frame_ms\n";
+    for (const ConfigResult& result : results) {
+      out_file << SharingName(result.config.concurrent) << ","
+               << (result.config.async_compute ? 1 : 0) << ","
+               << (result.separate_present_family ? 1 : 0) << ","
+               << (result.separate_compute_family ? 1 : 0) << ","
+               << result.frames_per_second << "," << result.frame_time_ms
+               << "\n";
+    }
+    LOG_ASSERT(==, log, false, out_file.bad());
+    log->LogInfo("Wrote the results to \"", results_file, "\"");
+  }
+
+  log->LogInfo("Application Shutdown");
+  return 0;
+}
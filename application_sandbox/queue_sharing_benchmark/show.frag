@@ -0,0 +1,30 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// Shows the values that the compute work of the frame wrote, one per pixel,
+// so that every value is read.
+layout(location = 0) out vec4 out_color;
+
+layout(set = 0, binding = 0) readonly buffer Values {
+    float values[];
+};
+
+void main() {
+    uint index = uint(gl_FragCoord.y) * 1024u + uint(gl_FragCoord.x);
+    float value = values[index % uint(values.length())];
+    out_color = vec4(value, value * 0.5, 1.0 - value, 1.0);
+}
@@ -0,0 +1,550 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/specialization_constants.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t reduction_shared_shader[] =
+#include "reduction_shared.comp.spv"
+    ;
+
+uint32_t reduction_subgroup_shader[] =
+#include "reduction_subgroup.comp.spv"
+    ;
+
+uint32_t reduction_atomics_shader[] =
+#include "reduction_atomics.comp.spv"
+    ;
+
+namespace {
+// The data sizes go from kMinElements to the max_elements option, by
+// kElementsStep at a time.
+const uint32_t kMinElements = 1 << 16;
+const uint32_t kDefaultMaxElements = 1 << 24;
+const uint32_t kElementsStep = 4;
+// The workgroup sizes go from kMinWorkGroupSize to the device limit, by
+// powers of two.
+const uint32_t kMinWorkGroupSize = 64;
+const uint32_t kMaxWorkGroupSize = 1024;
+// The smallest maxComputeWorkGroupCount[0] that a device may have. The
+// shaders loop over the tiles that the dispatch does not cover.
+const uint32_t kMaxGroups = 65535;
+// Every configuration is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 5;
+
+// These must match the constants in reduction_common.glsl.
+enum Operation {
+  kReduce,
+  kScan,
+  kCompact,
+  kNumOperations,
+};
+
+const char* const kOperationNames[kNumOperations] = {"reduce", "scan",
+                                                      "compact"};
+
+enum Method {
+  kShared,
+  kSubgroup,
+  kAtomics,
+  kNumMethods,
+};
+
+struct MethodInfo {
+  // The name of the method in the sample options and the results.
+  const char* name;
+  uint32_t* shader;
+  size_t shader_size;
+  // False if the method has no prefix sum.
+  bool scan;
+};
+
+const MethodInfo kMethods[kNumMethods] = {
+    {"shared", reduction_shared_shader, sizeof(reduction_shared_shader),
+     true},
+    {"subgroup", reduction_subgroup_shader, sizeof(reduction_subgroup_shader),
+     true},
+    {"atomics", reduction_atomics_shader, sizeof(reduction_atomics_shader),
+     false},
+};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+// Returns the input element at |index|, a number from 0 to 255.
+uint32_t Value(uint32_t index) { return (index * 2654435761u) >> 24; }
+
+// This must match keep in reduction_common.glsl.
+bool Keep(uint32_t value) { return (value & 1) != 0; }
+
+void SubmitAndWait(vulkan::VkQueue* queue, vulkan::VkCommandBuffer* cmd) {
+  VkSubmitInfo submit_info = {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &cmd->get_command_buffer(),     // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+  (*queue)->vkQueueWaitIdle(*queue);
+}
+
+void MemoryBarrier(vulkan::VkCommandBuffer* cmd, VkPipelineStageFlags src,
+                   VkAccessFlags src_access, VkPipelineStageFlags dst,
+                   VkAccessFlags dst_access) {
+  VkMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+      nullptr,                           // pNext
+      src_access,                        // srcAccessMask
+      dst_access,                        // dstAccessMask
+  };
+  (*cmd)->vkCmdPipelineBarrier(*cmd, src, dst, 0, 1, &barrier, 0, nullptr, 0,
+                               nullptr);
+}
+
+// Measures reduction, prefix sums and stream compaction of 32-bit elements,
+// with trees in shared memory, with subgroup arithmetic and with global
+// atomics, for every data size and workgroup size. The results of every
+// configuration are checked on the host before its bandwidth is logged.
+class ReductionBenchmark {
+ public:
+  ReductionBenchmark(const entry::EntryData* data,
+                     vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        max_elements_(kMinElements),
+        max_workgroup_size_(kMinWorkGroupSize),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        subgroup_supported_(false) {
+    vulkan::VkDevice& device = app->device();
+    const VkPhysicalDeviceLimits& limits = device.limits();
+    const uint32_t max_elements =
+        data->sample_option_uint("max_elements", kDefaultMaxElements);
+    while (max_elements_ * kElementsStep <= max_elements) {
+      max_elements_ *= kElementsStep;
+    }
+    const uint32_t max_workgroup_size =
+        std::min(std::min(limits.maxComputeWorkGroupSize[0],
+                          limits.maxComputeWorkGroupInvocations),
+                 kMaxWorkGroupSize);
+    while (max_workgroup_size_ * 2 <= max_workgroup_size) {
+      max_workgroup_size_ *= 2;
+    }
+
+    VkPhysicalDeviceSubgroupProperties subgroup_properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,  // sType
+        nullptr,                                                // pNext
+        0,                                                      // subgroupSize
+        0,                                                      // stages
+        0,                                                      // operations
+        VK_FALSE  // quadOperationsInAllStages
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,  // sType
+        &subgroup_properties,                            // pNext
+        {}                                               // properties
+    };
+    app->instance()->vkGetPhysicalDeviceProperties2KHR(
+        device.physical_device(), &properties);
+    const VkSubgroupFeatureFlags subgroup_operations =
+        VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+    subgroup_supported_ =
+        (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+        (subgroup_properties.supportedOperations & subgroup_operations) ==
+            subgroup_operations;
+
+    for (uint32_t i = 0; i < 3; ++i) {
+      bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(uint32_t)              // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout({{bindings_[0], bindings_[1], bindings_[2]}},
+                                  {range}));
+
+    const VkDeviceSize size = max_elements_ * sizeof(uint32_t);
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    input_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(size, usage);
+    output_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(size, usage);
+    counter_ =
+        app->CreateAndBindDefaultExclusiveDeviceBuffer(sizeof(uint32_t), usage);
+    const VkBufferUsageFlags host_usage =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    host_output_ =
+        app->CreateAndBindDefaultExclusiveHostBuffer(size, host_usage);
+    host_counter_ = app->CreateAndBindDefaultExclusiveHostBuffer(
+        sizeof(uint32_t), host_usage);
+
+    set_ = containers::make_unique<vulkan::DescriptorSet>(
+        data->allocator(),
+        app->AllocateDescriptorSet({bindings_[0], bindings_[1], bindings_[2]}));
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        {*input_, 0, VK_WHOLE_SIZE},
+        {*output_, 0, VK_WHOLE_SIZE},
+        {*counter_, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *set_,                                   // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        3,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    device->vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    // The input is uploaded once through the host buffer, that the results
+    // are read back into later.
+    uint32_t* host_values =
+        reinterpret_cast<uint32_t*>(host_output_->base_address());
+    for (uint32_t i = 0; i < max_elements_; ++i) {
+      host_values[i] = Value(i);
+    }
+    host_output_->flush();
+    vulkan::VkCommandBuffer cmd =
+        app->GetCommandBuffer(app->render_queue().index());
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    VkBufferCopy region = {0, 0, size};
+    cmd->vkCmdCopyBuffer(cmd, *host_output_, *input_, 1, &region);
+    cmd->vkEndCommandBuffer(cmd);
+    SubmitAndWait(&app->render_queue(), &cmd);
+  }
+
+  // Measures every operation with every method, or only the ones named
+  // |only_operation| and |only_method|, and logs the results, and the
+  // fastest configuration for every operation and data size.
+  void Run(const char* only_operation, const char* only_method) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+    if (!subgroup_supported_) {
+      data_->logger()->LogInfo(
+          "REDUCTION: the subgroup method is skipped, compute shaders do not "
+          "support subgroup arithmetic");
+    }
+
+    for (uint32_t operation = 0; operation < kNumOperations; ++operation) {
+      const char* operation_name = kOperationNames[operation];
+      if (only_operation && strcmp(only_operation, operation_name) != 0) {
+        continue;
+      }
+      containers::vector<Result> best(data_->allocator());
+      for (uint32_t elements = kMinElements; elements <= max_elements_;
+           elements *= kElementsStep) {
+        best.push_back({nullptr, 0, -1.0});
+      }
+      for (const MethodInfo& method : kMethods) {
+        if ((only_method && strcmp(only_method, method.name) != 0) ||
+            (operation == kScan && !method.scan) ||
+            (&method == &kMethods[kSubgroup] && !subgroup_supported_)) {
+          continue;
+        }
+        for (uint32_t workgroup_size = kMinWorkGroupSize;
+             workgroup_size <= max_workgroup_size_; workgroup_size *= 2) {
+          vulkan::SpecializationConstants constants(data_->allocator());
+          constants.Set(0, workgroup_size);
+          constants.Set(1, operation);
+          vulkan::VulkanComputePipeline pipeline =
+              app_->CreateComputePipeline(
+                  pipeline_layout_.get(),
+                  VkShaderModuleCreateInfo{
+                      VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                      method.shader_size, method.shader},
+                  "main", constants);
+          size_t size_index = 0;
+          for (uint32_t elements = kMinElements; elements <= max_elements_;
+               elements *= kElementsStep, ++size_index) {
+            const double gb_per_second = Measure(
+                &pipeline, static_cast<Operation>(operation), elements,
+                workgroup_size);
+            if (gb_per_second < 0.0) {
+              continue;
+            }
+            data_->logger()->LogInfo(
+                "REDUCTION: operation: ", operation_name,
+                " method: ", method.name, " elements: ", elements,
+                " workgroup_size: ", workgroup_size,
+                " GB/s: ", gb_per_second);
+            Result& result = best[size_index];
+            if (gb_per_second > result.gb_per_second) {
+              result.method = method.name;
+              result.workgroup_size = workgroup_size;
+              result.gb_per_second = gb_per_second;
+            }
+          }
+        }
+      }
+
+      size_t size_index = 0;
+      for (uint32_t elements = kMinElements; elements <= max_elements_;
+           elements *= kElementsStep, ++size_index) {
+        const Result& result = best[size_index];
+        if (!result.method) {
+          continue;
+        }
+        data_->logger()->LogInfo(
+            "REDUCTION_BEST: operation: ", operation_name,
+            " elements: ", elements, " method: ", result.method,
+            " workgroup_size: ", result.workgroup_size,
+            " GB/s: ", result.gb_per_second);
+      }
+    }
+  }
+
+ private:
+  struct Result {
+    const char* method;
+    uint32_t workgroup_size;
+    double gb_per_second;
+  };
+
+  // Returns the bandwidth of the fastest of kNumRuns runs of |operation|
+  // over |elements| elements, in GB/s of elements read and written, or a
+  // negative number if it could not be measured or the result is wrong.
+  double Measure(vulkan::VulkanComputePipeline* pipeline,
+                 Operation operation, uint32_t elements,
+                 uint32_t workgroup_size) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    const uint32_t num_tiles = elements / workgroup_size;
+    const uint32_t groups = std::min(num_tiles, kMaxGroups);
+    const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags transfer = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      const bool last_run = run + 1 == kNumRuns;
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      cmd->vkCmdFillBuffer(cmd, *counter_, 0, sizeof(uint32_t), 0);
+      MemoryBarrier(&cmd, transfer, VK_ACCESS_TRANSFER_WRITE_BIT, compute,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 0);
+      cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline);
+      cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *pipeline_layout_, 0, 1, &set_->raw_set(),
+                                   0, nullptr);
+      cmd->vkCmdPushConstants(cmd, *pipeline_layout_,
+                              VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                              sizeof(num_tiles), &num_tiles);
+      cmd->vkCmdDispatch(cmd, groups, 1, 1);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      if (last_run) {
+        // Only the last run is read back and checked.
+        MemoryBarrier(&cmd, compute, VK_ACCESS_SHADER_WRITE_BIT, transfer,
+                      VK_ACCESS_TRANSFER_READ_BIT);
+        VkBufferCopy counter_region = {0, 0, sizeof(uint32_t)};
+        cmd->vkCmdCopyBuffer(cmd, *counter_, *host_counter_, 1,
+                             &counter_region);
+        if (operation != kReduce) {
+          VkBufferCopy output_region = {0, 0, elements * sizeof(uint32_t)};
+          cmd->vkCmdCopyBuffer(cmd, *output_, *host_output_, 1,
+                               &output_region);
+        }
+        MemoryBarrier(&cmd, transfer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+      }
+      cmd->vkEndCommandBuffer(cmd);
+      SubmitAndWait(&queue, &cmd);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    if (best <= 0.0) {
+      return -1.0;
+    }
+
+    uint64_t bytes = 0;
+    if (!Verify(operation, elements, workgroup_size, &bytes)) {
+      data_->logger()->LogError(
+          "REDUCTION: operation: ", kOperationNames[operation],
+          " elements: ", elements, " workgroup_size: ", workgroup_size,
+          " the result is wrong");
+      return -1.0;
+    }
+    // Bytes per nanosecond are GB/s.
+    return bytes / best;
+  }
+
+  // Checks the results that Measure read back, and sets |bytes| to the
+  // number of bytes that the operation read and wrote.
+  bool Verify(Operation operation, uint32_t elements,
+              uint32_t workgroup_size, uint64_t* bytes) {
+    host_counter_->invalidate();
+    host_output_->invalidate();
+    const uint32_t counter =
+        *reinterpret_cast<const uint32_t*>(host_counter_->base_address());
+    const uint32_t* results =
+        reinterpret_cast<const uint32_t*>(host_output_->base_address());
+    const uint64_t input_bytes = uint64_t(elements) * sizeof(uint32_t);
+    switch (operation) {
+      case kReduce: {
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < elements; ++i) {
+          sum += Value(i);
+        }
+        *bytes = input_bytes;
+        return counter == sum;
+      }
+      case kScan: {
+        uint32_t prefix = 0;
+        for (uint32_t i = 0; i < elements; ++i) {
+          if (i % workgroup_size == 0) {
+            prefix = 0;
+          }
+          if (results[i] != prefix) {
+            return false;
+          }
+          prefix += Value(i);
+        }
+        *bytes = 2 * input_bytes;
+        return true;
+      }
+      case kCompact: {
+        // The order of the tiles in the output is not defined, so only the
+        // number and the sum of the kept elements are checked.
+        uint32_t kept = 0;
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < elements; ++i) {
+          if (Keep(Value(i))) {
+            ++kept;
+            sum += Value(i);
+          }
+        }
+        if (counter != kept) {
+          return false;
+        }
+        for (uint32_t i = 0; i < kept; ++i) {
+          sum -= results[i];
+        }
+        *bytes = input_bytes + uint64_t(kept) * sizeof(uint32_t);
+        return sum == 0;
+      }
+      case kNumOperations:
+        break;
+    }
+    return false;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t max_elements_;
+  uint32_t max_workgroup_size_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+  bool subgroup_supported_;
+  VkDescriptorSetLayoutBinding bindings_[3];
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> input_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> output_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> counter_;
+  // The input is uploaded from this, and the results are read back into it.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> host_output_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> host_counter_;
+  containers::unique_ptr<vulkan::DescriptorSet> set_;
+};
+}  // anonymous namespace
+
+// This sample measures reduction, prefix sums and stream compaction, each
+// with trees in shared memory, subgroup arithmetic and global atomics, for
+// every data size and workgroup size. It logs one line per configuration
+// whose result is correct, and the fastest one per operation and size:
+//   REDUCTION: operation: <op> method: <method> elements: <n>
+//       workgroup_size: <size> GB/s: <bandwidth>
+//   REDUCTION_BEST: operation: <op> elements: <n> method: <method>
+//       workgroup_size: <size> GB/s: <bandwidth>
+// -sample-option=operation=<op> and method=<method> only measure those, and
+// max_elements sets the largest data size.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data,
+      {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME}, {}, {0},
+      1024 * 1024, 1024 * 1024, 1024 * 1024, 1024 * 1024, false, false,
+      false, 0, false, false, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, false, false,
+      nullptr, true);
+  ReductionBenchmark benchmark(data, &app);
+  benchmark.Run(data->sample_option("operation"),
+                data->sample_option("method"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,51 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The workgroup size and the operation are set by main.cpp. The workgroup
+// size is a power of two.
+layout (local_size_x = 64, local_size_x_id = 0) in;
+layout (constant_id = 1) const uint kOperation = 0;
+
+// These must match Operation in main.cpp.
+const uint kReduce = 0;
+const uint kScan = 1;
+const uint kCompact = 2;
+
+layout (binding = 0, set = 0, std430) readonly buffer input_data {
+    uint values[];
+};
+
+// The prefix sums, or the elements that stream compaction keeps.
+layout (binding = 1, set = 0, std430) writeonly buffer output_data {
+    uint results[];
+};
+
+// The sum of all elements, or the number of elements that stream
+// compaction keeps. It is 0 before every dispatch.
+layout (binding = 2, set = 0, std430) buffer counter_data {
+    uint counter;
+};
+
+layout (push_constant) uniform reduction_constants {
+    // Every workgroup handles a tile of gl_WorkGroupSize.x elements at a
+    // time, and loops over the tiles that the dispatch does not cover.
+    uint num_tiles;
+};
+
+// Returns true if stream compaction keeps |value|. This must match Keep in
+// main.cpp.
+bool keep(uint value) {
+    return (value & 1u) != 0u;
+}
@@ -0,0 +1,55 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The main function of the methods that combine a tile in the workgroup.
+// They define these before including this:
+//   // Returns the sum of |value| over the workgroup.
+//   uint workgroup_sum(uint value);
+//   // Returns the sum of |value| over the invocations of the workgroup
+//   // before this one, and sets |total| to the sum over the workgroup.
+//   uint workgroup_exclusive_scan(uint value, out uint total);
+
+// The offset in results of the elements that stream compaction keeps from
+// the current tile.
+shared uint tile_offset;
+
+void main() {
+    for (uint tile = gl_WorkGroupID.x; tile < num_tiles;
+         tile += gl_NumWorkGroups.x) {
+        uint index = tile * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+        uint value = values[index];
+        if (kOperation == kReduce) {
+            uint sum = workgroup_sum(value);
+            if (gl_LocalInvocationID.x == 0) {
+                atomicAdd(counter, sum);
+            }
+        } else if (kOperation == kScan) {
+            uint total;
+            results[index] = workgroup_exclusive_scan(value, total);
+        } else {
+            uint total;
+            uint kept = keep(value) ? 1u : 0u;
+            uint offset = workgroup_exclusive_scan(kept, total);
+            if (gl_LocalInvocationID.x == 0) {
+                tile_offset = atomicAdd(counter, total);
+            }
+            barrier();
+            if (kept != 0u) {
+                results[tile_offset + offset] = value;
+            }
+            barrier();
+        }
+    }
+}
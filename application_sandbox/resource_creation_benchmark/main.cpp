@@ -0,0 +1,573 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "support/jobs/job_system.h"
+#include "vulkan_helpers/frame_time_recorder.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t compute_shader[] =
+#include "resource_creation.comp.spv"
+    ;
+
+uint32_t vertex_shader[] =
+#include "resource_creation.vert.spv"
+    ;
+
+uint32_t fragment_shader[] =
+#include "resource_creation.frag.spv"
+    ;
+
+namespace {
+const uint32_t kDefaultThreads = 4;
+// The number of objects that every thread creates in every run. Pipelines
+// take much longer to create than the other objects, so there are fewer of
+// them.
+const uint32_t kDefaultCount = 1000;
+const uint32_t kDefaultPipelineCount = 20;
+// Every measurement is repeated this many times, after a run that is not
+// measured.
+const uint32_t kNumRuns = 5;
+
+// The render pass that the graphics pipelines are created for, with a
+// single color attachment.
+vulkan::VkRenderPass CreateRenderPass(vulkan::VulkanApplication* app) {
+  VkAttachmentReference color_attachment = {
+      0,                                        // attachment
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // layout
+  };
+  return app->CreateRenderPass(
+      {{
+          0,                                        // flags
+          VK_FORMAT_R8G8B8A8_UNORM,                 // format
+          VK_SAMPLE_COUNT_1_BIT,                    // samples
+          VK_ATTACHMENT_LOAD_OP_CLEAR,              // loadOp
+          VK_ATTACHMENT_STORE_OP_STORE,             // storeOp
+          VK_ATTACHMENT_LOAD_OP_DONT_CARE,          // stencilLoadOp
+          VK_ATTACHMENT_STORE_OP_DONT_CARE,         // stencilStoreOp
+          VK_IMAGE_LAYOUT_UNDEFINED,                // initialLayout
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // finalLayout
+      }},  // AttachmentDescriptions
+      {{
+          0,                                // flags
+          VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+          0,                                // inputAttachmentCount
+          nullptr,                          // pInputAttachments
+          1,                                // colorAttachmentCount
+          &color_attachment,                // colorAttachment
+          nullptr,                          // pResolveAttachments
+          nullptr,                          // pDepthStencilAttachment
+          0,                                // preserveAttachmentCount
+          nullptr                           // pPreserveAttachments
+      }},  // SubpassDescriptions
+      {}   // SubpassDependencies
+  );
+}
+
+// Measures how many objects of every kind the device creates and destroys
+// per second, on a single thread and on several threads at once. The
+// objects are created with the same create infos as the gapid
+// resource_creation_tests, with raw Vulkan calls so that the wrappers of
+// the framework are not measured.
+class ResourceCreationBenchmark {
+ public:
+  ResourceCreationBenchmark(const entry::EntryData* data,
+                            vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        num_threads_(data->sample_option_uint("threads", kDefaultThreads)),
+        count_(data->sample_option_uint("count", kDefaultCount)),
+        pipeline_count_(
+            data->sample_option_uint("pipeline_count", kDefaultPipelineCount)),
+        only_object_(data->sample_option("object")),
+        jobs_(data->allocator(), num_threads_),
+        compute_module_(app->CreateShaderModule(compute_shader)),
+        vertex_module_(app->CreateShaderModule(vertex_shader)),
+        fragment_module_(app->CreateShaderModule(fragment_shader)),
+        render_pass_(CreateRenderPass(app)) {
+    image_info_ = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        VK_FORMAT_R8G8B8A8_UNORM,             // format
+        {256, 256, 1},                        // extent
+        1,                                    // mipLevels
+        1,                                    // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                // samples
+        VK_IMAGE_TILING_OPTIMAL,              // tiling
+        VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    // Views need an image that is bound to memory.
+    view_image_ = app->CreateAndBindImage(&image_info_);
+
+    compute_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout({{{
+            0,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+            nullptr                             // pImmutableSamplers
+        }}}));
+    graphics_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout({{
+            {
+                0,                                  // binding
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+                1,                                  // descriptorCount
+                VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+                nullptr                             // pImmutableSamplers
+            },
+            {
+                1,                                          // binding
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+                1,                                          // descriptorCount
+                VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+                nullptr  // pImmutableSamplers
+            },
+        }}));
+  }
+
+  void Run() {
+    vulkan::VkDevice& device = app_->device();
+    data_->logger()->LogInfo("RESOURCE_CREATION: threads: ", num_threads_,
+                             " count: ", count_,
+                             " pipeline_count: ", pipeline_count_);
+
+    const VkBufferCreateInfo buffer_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        65536,                                 // size
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,               // sharingMode
+        0,                                       // queueFamilyIndexCount
+        nullptr                                  // pQueueFamilyIndices
+    };
+    Measure<::VkBuffer>(
+        "buffer", count_, ~0u,
+        [&](::VkBuffer* buffer) {
+          return device->vkCreateBuffer(device, &buffer_info, nullptr,
+                                        buffer);
+        },
+        [&](::VkBuffer buffer) {
+          device->vkDestroyBuffer(device, buffer, nullptr);
+        });
+
+    Measure<::VkImage>(
+        "image", count_, ~0u,
+        [&](::VkImage* image) {
+          return device->vkCreateImage(device, &image_info_, nullptr, image);
+        },
+        [&](::VkImage image) {
+          device->vkDestroyImage(device, image, nullptr);
+        });
+
+    const VkImageViewCreateInfo view_info = {
+        VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
+        nullptr,                                   // pNext
+        0,                                         // flags
+        *view_image_,                              // image
+        VK_IMAGE_VIEW_TYPE_2D,                     // viewType
+        image_info_.format,                        // format
+        {
+            VK_COMPONENT_SWIZZLE_IDENTITY,  // r
+            VK_COMPONENT_SWIZZLE_IDENTITY,  // g
+            VK_COMPONENT_SWIZZLE_IDENTITY,  // b
+            VK_COMPONENT_SWIZZLE_IDENTITY,  // a
+        },                                  // components
+        {
+            VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+            0,                          // baseMipLevel
+            1,                          // levelCount
+            0,                          // baseArrayLayer
+            1,                          // layerCount
+        },                              // subresourceRange
+    };
+    Measure<::VkImageView>(
+        "image_view", count_, ~0u,
+        [&](::VkImageView* view) {
+          return device->vkCreateImageView(device, &view_info, nullptr, view);
+        },
+        [&](::VkImageView view) {
+          device->vkDestroyImageView(device, view, nullptr);
+        });
+
+    const VkSamplerCreateInfo sampler_info = vulkan::GetSamplerCreateInfo(
+        VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    // Devices only have to support 4000 samplers at once.
+    Measure<::VkSampler>(
+        "sampler", count_, device.limits().maxSamplerAllocationCount,
+        [&](::VkSampler* sampler) {
+          return device->vkCreateSampler(device, &sampler_info, nullptr,
+                                         sampler);
+        },
+        [&](::VkSampler sampler) {
+          device->vkDestroySampler(device, sampler, nullptr);
+        });
+
+    const VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 16},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16},
+    };
+    const VkDescriptorPoolCreateInfo pool_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,      // sType
+        nullptr,                                            // pNext
+        VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,  // flags
+        16,                                                 // maxSets
+        sizeof(pool_sizes) / sizeof(pool_sizes[0]),         // poolSizeCount
+        pool_sizes                                          // pPoolSizes
+    };
+    Measure<::VkDescriptorPool>(
+        "descriptor_pool", count_, ~0u,
+        [&](::VkDescriptorPool* pool) {
+          return device->vkCreateDescriptorPool(device, &pool_info, nullptr,
+                                                pool);
+        },
+        [&](::VkDescriptorPool pool) {
+          device->vkDestroyDescriptorPool(device, pool, nullptr);
+        });
+
+    const VkQueryPoolCreateInfo query_pool_info = {
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+        nullptr,                                   // pNext
+        0,                                         // flags
+        VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+        64,                                        // queryCount
+        0                                          // pipelineStatistics
+    };
+    Measure<::VkQueryPool>(
+        "query_pool", count_, ~0u,
+        [&](::VkQueryPool* pool) {
+          return device->vkCreateQueryPool(device, &query_pool_info, nullptr,
+                                           pool);
+        },
+        [&](::VkQueryPool pool) {
+          device->vkDestroyQueryPool(device, pool, nullptr);
+        });
+
+    MeasurePipelines();
+  }
+
+ private:
+  // Creates |count| objects with |create| on every thread, and then
+  // destroys all of them with |destroy|, with one thread and with
+  // num_threads_ threads, and logs how many objects are created and
+  // destroyed per second. No more than |max_objects| objects are alive at
+  // once, which lowers |count| if needed.
+  template <typename T, typename Create, typename Destroy>
+  void Measure(const char* object, uint32_t count, uint32_t max_objects,
+               const Create& create, const Destroy& destroy) {
+    if (only_object_ && strcmp(only_object_, object) != 0) {
+      return;
+    }
+    logging::Logger* log = data_->logger();
+    const uint32_t thread_counts[] = {1, num_threads_};
+    const uint32_t num_thread_counts = num_threads_ > 1 ? 2 : 1;
+    for (uint32_t c = 0; c < num_thread_counts; ++c) {
+      const uint32_t threads = thread_counts[c];
+      const uint32_t per_thread = std::min(count, max_objects / threads);
+      containers::vector<T> handles(size_t(threads) * per_thread, T(),
+                                    data_->allocator());
+      vulkan::FrameTimeRecorder create_times(data_->allocator(), kNumRuns);
+      vulkan::FrameTimeRecorder destroy_times(data_->allocator(), kNumRuns);
+      for (uint32_t run = 0; run <= kNumRuns; ++run) {
+        // Every thread creates and destroys a contiguous range of the
+        // handles.
+        const auto start = std::chrono::high_resolution_clock::now();
+        jobs_.ParallelFor(0, threads, 1, [&](size_t begin, size_t end) {
+          for (size_t i = begin * per_thread; i < end * per_thread; ++i) {
+            LOG_ASSERT(==, log, VK_SUCCESS, create(&handles[i]));
+          }
+        });
+        const auto created = std::chrono::high_resolution_clock::now();
+        jobs_.ParallelFor(0, threads, 1, [&](size_t begin, size_t end) {
+          for (size_t i = begin * per_thread; i < end * per_thread; ++i) {
+            destroy(handles[i]);
+          }
+        });
+        const auto end = std::chrono::high_resolution_clock::now();
+        // The first run warms up the driver.
+        if (run > 0) {
+          create_times.Record(
+              std::chrono::duration<float>(created - start).count());
+          destroy_times.Record(
+              std::chrono::duration<float>(end - created).count());
+        }
+      }
+      LogRates(object, threads, per_thread, create_times, destroy_times);
+    }
+  }
+
+  void LogRates(const char* object, uint32_t threads, uint32_t per_thread,
+                const vulkan::FrameTimeRecorder& create_times,
+                const vulkan::FrameTimeRecorder& destroy_times) {
+    const vulkan::FrameTimeRecorder::Statistics create =
+        create_times.ComputeStatistics(0.0f);
+    const vulkan::FrameTimeRecorder::Statistics destroy =
+        destroy_times.ComputeStatistics(0.0f);
+    const float objects = float(threads) * per_thread;
+    data_->logger()->LogInfo(
+        "RESOURCE_CREATION: object: ", object, " threads: ", threads,
+        " count: ", per_thread,
+        " creates_per_second: ",
+        create.p50 > 0.0f ? objects / create.p50 : 0.0f,
+        " destroys_per_second: ",
+        destroy.p50 > 0.0f ? objects / destroy.p50 : 0.0f,
+        " create_us: ", create.p50 * 1.0e6f / objects,
+        " destroy_us: ", destroy.p50 * 1.0e6f / objects);
+  }
+
+  // Pipelines are created without a pipeline cache, so that every one of
+  // them is compiled, unless the driver caches them itself.
+  void MeasurePipelines() {
+    vulkan::VkDevice& device = app_->device();
+
+    const VkComputePipelineCreateInfo compute_info = {
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,  // sType
+        nullptr,                                         // pNext
+        0,                                               // flags
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+            nullptr,                                              // pNext
+            0,                                                    // flags
+            VK_SHADER_STAGE_COMPUTE_BIT,                          // stage
+            compute_module_,                                      // module
+            "main",                                               // pName
+            nullptr  // pSpecializationInfo
+        },                 // stage
+        *compute_layout_,  // layout
+        VK_NULL_HANDLE,    // basePipelineHandle
+        0                  // basePipelineIndex
+    };
+    Measure<::VkPipeline>(
+        "compute_pipeline", pipeline_count_, ~0u,
+        [&](::VkPipeline* pipeline) {
+          return device->vkCreateComputePipelines(
+              device, VK_NULL_HANDLE, 1, &compute_info, nullptr, pipeline);
+        },
+        [&](::VkPipeline pipeline) {
+          device->vkDestroyPipeline(device, pipeline, nullptr);
+        });
+
+    const VkPipelineShaderStageCreateInfo stages[2] = {
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+            nullptr,                                              // pNext
+            0,                                                    // flags
+            VK_SHADER_STAGE_VERTEX_BIT,                           // stage
+            vertex_module_,                                       // module
+            "main",                                               // pName
+            nullptr  // pSpecializationInfo
+        },
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+            nullptr,                                              // pNext
+            0,                                                    // flags
+            VK_SHADER_STAGE_FRAGMENT_BIT,                         // stage
+            fragment_module_,                                     // module
+            "main",                                               // pName
+            nullptr  // pSpecializationInfo
+        }};
+    const VkVertexInputBindingDescription vertex_binding = {
+        0,                           // binding
+        4 * 6, /* vec4 + vec2 */     // stride
+        VK_VERTEX_INPUT_RATE_VERTEX  // inputRate
+    };
+    const VkVertexInputAttributeDescription vertex_attributes[2] = {
+        {
+            0,                              // location
+            0,                              // binding
+            VK_FORMAT_R32G32B32A32_SFLOAT,  // format
+            0                               // offset
+        },
+        {
+            1,                        // location
+            0,                        // binding
+            VK_FORMAT_R32G32_SFLOAT,  // format
+            4 * 4                     // offset
+        }};
+    const VkPipelineVertexInputStateCreateInfo vertex_input_state = {
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,  // sType
+        nullptr,                                                    // pNext
+        0,                                                          // flags
+        1,                  // vertexBindingDescriptionCount
+        &vertex_binding,    // pVertexBindingDescriptions
+        2,                  // vertexAttributeDescriptionCount
+        vertex_attributes   // pVertexAttributeDescriptions
+    };
+    const VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,  // sType
+        nullptr,                                                      // pNext
+        0,                                                            // flags
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,  // topology
+        VK_FALSE                              // primitiveRestartEnable
+    };
+    // The viewport and scissor are dynamic, so that no swapchain is needed.
+    const VkPipelineViewportStateCreateInfo viewport_state = {
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,  // sType
+        nullptr,                                                // pNext
+        0,                                                      // flags
+        1,                                                      // viewportCount
+        nullptr,                                                // pViewports
+        1,                                                      // scissorCount
+        nullptr,                                                // pScissors
+    };
+    const VkPipelineRasterizationStateCreateInfo rasterization_state = {
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,  // sType
+        nullptr,                                                     // pNext
+        0,                                                           // flags
+        VK_FALSE,                 // depthClampEnable
+        VK_FALSE,                 // rasterizerDiscardEnable
+        VK_POLYGON_MODE_FILL,     // polygonMode
+        VK_CULL_MODE_BACK_BIT,    // cullMode
+        VK_FRONT_FACE_CLOCKWISE,  // frontFace
+        VK_FALSE,                 // depthBiasEnable
+        0.0f,                     // depthBiasConstantFactor
+        0.0f,                     // depthBiasClamp
+        0.0f,                     // depthBiasSlopeFactor
+        1.0f                      // lineWidth
+    };
+    const VkPipelineMultisampleStateCreateInfo multisample_state = {
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,  // sType
+        nullptr,                                                   // pNext
+        0,                                                         // flags
+        VK_SAMPLE_COUNT_1_BIT,  // rasterizationSamples
+        VK_FALSE,               // sampleShadingEnable
+        0,                      // minSampleShading
+        nullptr,                // pSampleMask
+        VK_FALSE,               // alphaToCoverageEnable
+        VK_FALSE                // alphaToOneEnable
+    };
+    const VkPipelineColorBlendAttachmentState color_blend_attachment = {
+        VK_FALSE,                 // blendEnable
+        VK_BLEND_FACTOR_ONE,      // srcColorBlendFactor
+        VK_BLEND_FACTOR_ZERO,     // dstColorBlendFactor
+        VK_BLEND_OP_ADD,          // colorBlendOp
+        VK_BLEND_FACTOR_ONE,      // srcAlphaBlendFactor
+        VK_BLEND_FACTOR_ZERO,     // dstAlphaBlendFactor
+        VK_BLEND_OP_ADD,          // alphaBlendOp
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT |
+            VK_COLOR_COMPONENT_A_BIT  // colorWriteMask
+    };
+    const VkPipelineColorBlendStateCreateInfo color_blend_state = {
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,  // sType
+        nullptr,                                                   // pNext
+        0,                                                         // flags
+        VK_FALSE,                 // logicOpEnable
+        VK_LOGIC_OP_CLEAR,        // logicOp
+        1,                        // attachmentCount
+        &color_blend_attachment,  // pAttachments
+        {1.0f, 1.0f, 1.0f, 1.0f}  // blendConstants[4]
+    };
+    const VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                             VK_DYNAMIC_STATE_SCISSOR};
+    const VkPipelineDynamicStateCreateInfo dynamic_state = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,  // sType
+        nullptr,                                               // pNext
+        0,                                                     // flags
+        2,               // dynamicStateCount
+        dynamic_states   // pDynamicStates
+    };
+    const VkGraphicsPipelineCreateInfo graphics_info = {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,  // sType
+        nullptr,                                          // pNext
+        0,                                                // flags
+        2,                                                // stageCount
+        stages,                                           // pStages
+        &vertex_input_state,                              // pVertexInputState
+        &input_assembly_state,  // pInputAssemblyState
+        nullptr,                // pTessellationState
+        &viewport_state,        // pViewportState
+        &rasterization_state,   // pRasterizationState
+        &multisample_state,     // pMultisampleState
+        nullptr,                // pDepthStencilState
+        &color_blend_state,     // pColorBlendState
+        &dynamic_state,         // pDynamicState
+        *graphics_layout_,      // layout
+        render_pass_,           // renderPass
+        0,                      // subpass
+        VK_NULL_HANDLE,         // basePipelineHandle
+        0                       // basePipelineIndex
+    };
+    Measure<::VkPipeline>(
+        "graphics_pipeline", pipeline_count_, ~0u,
+        [&](::VkPipeline* pipeline) {
+          return device->vkCreateGraphicsPipelines(
+              device, VK_NULL_HANDLE, 1, &graphics_info, nullptr, pipeline);
+        },
+        [&](::VkPipeline pipeline) {
+          device->vkDestroyPipeline(device, pipeline, nullptr);
+        });
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t num_threads_;
+  uint32_t count_;
+  uint32_t pipeline_count_;
+  // If set, only objects of this kind are measured.
+  const char* only_object_;
+  jobs::JobSystem jobs_;
+  VkImageCreateInfo image_info_;
+  containers::unique_ptr<vulkan::VulkanApplication::Image> view_image_;
+  vulkan::VkShaderModule compute_module_;
+  vulkan::VkShaderModule vertex_module_;
+  vulkan::VkShaderModule fragment_module_;
+  containers::unique_ptr<vulkan::PipelineLayout> compute_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> graphics_layout_;
+  vulkan::VkRenderPass render_pass_;
+};
+}  // anonymous namespace
+
+// This sample measures how fast buffers, images, image views, samplers,
+// descriptor pools, query pools and pipelines are created and destroyed,
+// on one thread and on -sample-option=threads=<n> threads at once. It logs
+// one line for every kind of object and number of threads:
+//   RESOURCE_CREATION: object: <name> threads: <n> count: <n>
+//       creates_per_second: <n> destroys_per_second: <n>
+//       create_us: <us> destroy_us: <us>
+// where count is the number of objects of every thread, and the times are
+// the median of the runs per object.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data);
+  {
+    ResourceCreationBenchmark benchmark(data, &app);
+    benchmark.Run();
+  }
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
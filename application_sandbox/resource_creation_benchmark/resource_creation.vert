@@ -0,0 +1,30 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec2 texcoord;
+
+layout (location = 0) out vec2 out_texcoord;
+
+layout (binding = 0, set = 0) uniform transform_data {
+    mat4 transform;
+};
+
+void main() {
+    gl_Position = transform * position;
+    out_texcoord = texcoord;
+}
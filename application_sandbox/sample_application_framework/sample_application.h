@@ -15,20 +15,63 @@
 #ifndef SAMPLE_APPLICATION_FRAMEWORK_SAMPLE_APPLICATION_H_
 #define SAMPLE_APPLICATION_FRAMEWORK_SAMPLE_APPLICATION_H_
 
+#include "support/containers/linear_allocator.h"
 #include "support/entry/entry.h"
+#include "support/jobs/job_system.h"
+#include "support/trace/startup.h"
+#include "support/trace/trace.h"
+#include "vulkan_helpers/allocation_audit.h"
+#include "vulkan_helpers/api_call_stats.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/debug_labels.h"
+#include "vulkan_helpers/fence_waiter.h"
+#include "vulkan_helpers/frame_capture.h"
+#include "vulkan_helpers/frame_pacer.h"
+#include "vulkan_helpers/frame_time_recorder.h"
+#include "vulkan_helpers/gpu_profiler.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/parallel_command_recorder.h"
+#include "vulkan_helpers/thermal_limiter.h"
+#include "vulkan_helpers/transient_ring_buffer.h"
 #include "vulkan_helpers/vulkan_application.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <string>
+#include <thread>
 
 namespace sample_application {
 
 const static VkSampleCountFlagBits kVkMultiSampledSampleCount =
     VK_SAMPLE_COUNT_4_BIT;
+// The format of the depth buffer, unless SampleOptions::SetDepthFormat()
+// chooses another one.
 const static VkFormat kDepthFormat = VK_FORMAT_D16_UNORM;
+// The frame time over which a frame counts as over budget in the frame time
+// statistics, and how many of the most recent frames they cover.
+const static float kFrameTimeBudget = 1.0f / 60.0f;
+const static size_t kMaxRecordedFrames = 1 << 16;
+// A frame that waited longer than this for the GPU counts as over budget in
+// the FENCE_WAIT: statistics, as it was bound by the GPU rather than the CPU.
+const static float kGpuBoundWaitTime = 0.001f;
+// The initial size of the frame allocator, it grows to fit the busiest frame.
+const static size_t kFrameAllocatorSize = 64 * 1024;
+// The GPU zone that measures every frame with dynamic resolution.
+const static char kDynamicResolutionZone[] = "Frame";
 const static VkFormat kMutableSwapchainFormats[] = {VK_FORMAT_B8G8R8A8_UNORM,
                                                     VK_FORMAT_B8G8R8A8_SRGB};
+// The number of threads that write the frames of -output-frames.
+const static size_t kFrameCaptureThreads = 2;
+// The number of damaged rectangles that are presented for a frame, beyond
+// it they are merged into one.
+const static uint32_t kMaxDamageRects = 16;
+const static uint32_t kMaxComputeStageBuffers = 8;
+// Every how many frames a measured frame is submitted again for the other
+// passes of the performance counters.
+const static uint64_t kCounterReplayInterval = 60;
 const static VkImageFormatListCreateInfoKHR kMutableSwapchainImageFormatList = {
     VK_STRUCTURE_TYPE_IMAGE_FORMAT_LIST_CREATE_INFO_KHR, nullptr, 2,
     kMutableSwapchainFormats};
@@ -37,17 +80,46 @@ struct SampleOptions {
   bool enable_multisampling = false;
   bool enable_mixed_multisampling = false;
   bool enable_depth_buffer = false;
+  VkFormat depth_buffer_format = kDepthFormat;
+  bool depth_pre_pass = false;
   bool verbose_output = false;
   bool async_compute = false;
+  uint32_t num_async_compute_queues = 1;
   bool sparse_binding = false;
   bool protected_memory = false;
   bool host_query_reset = false;
   bool extended_swapchain_color_space = false;
   bool shared_presentation = false;
+  bool low_latency_presentation = false;
+  bool damage_tracking = false;
+  bool pipelined_update = false;
   bool enable_vulkan_1_1 = false;
   bool mutable_swapchain_format = false;
   bool enable_display_timing = false;
+  uint32_t display_timing_refresh_divisor = 1;
   bool enable_10bit_hdr = false;
+  bool enable_fp16_hdr = false;
+  bool tlsf_arenas = false;
+  bool transient_attachments = false;
+  bool sampled_depth_buffer = false;
+  bool transfer_queue = false;
+  bool batched_submits = false;
+  bool timeline_frame_sync = false;
+  bool async_compute_stage = false;
+  bool concurrent_sharing = false;
+  bool resizable_swapchain = false;
+  bool submit_ahead = false;
+  VkPipelineStageFlags compute_stage_wait_stages = 0;
+  VkPipelineStageFlags submit_ahead_wait_stages = 0;
+  uint32_t transient_ring_buffer_size_in_MB = 0;
+  uint32_t frames_in_flight = 0;
+  uint32_t swapchain_images = 0;
+  const char* present_mode = nullptr;
+  uint32_t parallel_recording_threads = 0;
+  uint32_t gpu_profiler_zones = 0;
+  bool performance_counters = false;
+  float dynamic_resolution_budget = 0.0f;
+  float dynamic_resolution_min_scale = 1.0f;
   void* device_extension_structures = nullptr;
 
   SampleOptions& EnableMultisampling() {
@@ -62,12 +134,34 @@ struct SampleOptions {
     enable_depth_buffer = true;
     return *this;
   }
+  // Creates the depth buffer with |format| instead of kDepthFormat. The
+  // device must support it as a depth/stencil attachment with optimal
+  // tiling.
+  SampleOptions& SetDepthFormat(VkFormat format) {
+    depth_buffer_format = format;
+    return *this;
+  }
+  // Renders the depth of the scene before shading it, so that the fragment
+  // shaders only run for the visible fragments. The application creates its
+  // opaque pipelines with
+  // vulkan::VulkanGraphicsPipeline::CommitWithDepthPrePass when
+  // Sample::depth_pre_pass() is true, and draws its opaque geometry with the
+  // depth pre-pass pipelines before it draws it again with the main ones.
+  // Implies EnableDepthBuffer().
+  SampleOptions& EnableDepthPrePass() {
+    enable_depth_buffer = true;
+    depth_pre_pass = true;
+    return *this;
+  }
   SampleOptions& EnableVerbose() {
     verbose_output = true;
     return *this;
   }
-  SampleOptions& EnableAsyncCompute() {
+  // Creates up to |num_queues| async compute queues, as many as the device
+  // has, see VulkanApplication::async_compute_queue().
+  SampleOptions& EnableAsyncCompute(uint32_t num_queues = 1) {
     async_compute = true;
+    num_async_compute_queues = num_queues;
     return *this;
   }
   SampleOptions& EnableSparseBinding() {
@@ -90,6 +184,37 @@ struct SampleOptions {
     shared_presentation = true;
     return *this;
   }
+  // Renders every frame straight into the shared presentable image that the
+  // display keeps scanning out, instead of queueing frames. The image is
+  // only acquired once and keeps its contents between frames, so a frame may
+  // update just a part of it. The latency from Update() to the present is
+  // logged as LATENCY:. Implies EnableSharedPresentation(), and needs the
+  // same extensions.
+  SampleOptions& EnableLowLatencyPresentation() {
+    shared_presentation = true;
+    low_latency_presentation = true;
+    return *this;
+  }
+  // Presents only what the application reported as changed with
+  // Sample::AddDamage(), as VK_KHR_incremental_present regions, and keeps
+  // the contents of every swapchain image between the frames that render to
+  // it. The application should only render to Sample::damage_scissor(), and
+  // must enable VK_KHR_incremental_present. It can not be combined with
+  // multisampling or dynamic resolution.
+  SampleOptions& EnableDamageTracking() {
+    damage_tracking = true;
+    return *this;
+  }
+  // Runs Update() for the next frame on a worker of the job system while
+  // Render() records and submits the current one. Update() then must not
+  // use frame_allocator(), buffer_update_batch() or AddDamage(), and
+  // Render() must only read the state that Update() writes, through a
+  // PipelinedState. The frame that is rendered is one Update() behind. It
+  // can not be combined with damage tracking or low latency presentation.
+  SampleOptions& EnablePipelinedUpdate() {
+    pipelined_update = true;
+    return *this;
+  }
   SampleOptions& EnableVulkan11() {
     enable_vulkan_1_1 = true;
     return *this;
@@ -98,14 +223,203 @@ struct SampleOptions {
     mutable_swapchain_format = true;
     return *this;
   }
-  SampleOptions& EnableDisplayTiming() {
+  // Paces the presents with VK_GOOGLE_display_timing, showing every frame
+  // for at least |refresh_divisor| refresh cycles, see Sample::frame_pacer().
+  // A |refresh_divisor| of 0 does not pace them, it only measures them.
+  SampleOptions& EnableDisplayTiming(uint32_t refresh_divisor = 1) {
     enable_display_timing = true;
+    display_timing_refresh_divisor = refresh_divisor;
     return *this;
   }
   SampleOptions& Enable10BitHDR() {
     enable_10bit_hdr = true;
     return *this;
   }
+  // Asks for a swapchain in the linear extended sRGB color space, which is
+  // R16G16B16A16_SFLOAT where the surface has it. Like
+  // EnableExtendedSwapchainColorSpace(), this needs the
+  // VK_EXT_swapchain_colorspace and VK_KHR_get_surface_capabilities2
+  // instance extensions.
+  SampleOptions& EnableFp16HDR() {
+    enable_fp16_hdr = true;
+    return *this;
+  }
+  // Use the O(1) TLSF allocator for all of the memory arenas.
+  SampleOptions& EnableTLSFArenas() {
+    tlsf_arenas = true;
+    return *this;
+  }
+  // Creates the depth buffer as a transient attachment in lazily allocated
+  // memory, when the device has it. The depth buffer can then only be used
+  // as an attachment, and render passes should not store it, see
+  // depth_store_op().
+  SampleOptions& EnableTransientAttachments() {
+    transient_attachments = true;
+    return *this;
+  }
+  // Creates the depth buffer so that shaders can also sample it, in
+  // VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, e.g. to build the depth
+  // pyramid of vulkan::GpuCulling. It can not be combined with transient
+  // attachments.
+  SampleOptions& EnableSampledDepthBuffer() {
+    sampled_depth_buffer = true;
+    return *this;
+  }
+  // Creates a queue from a transfer-only queue family, when the device has
+  // one, for VulkanApplication::FillImageLayersDataAsync.
+  SampleOptions& EnableTransferQueue() {
+    transfer_queue = true;
+    return *this;
+  }
+  // Submits all of the render queue work of a frame with a single
+  // vkQueueSubmit. The application must then not submit to the render queue
+  // from Render(), but add its command buffers with
+  // Sample::AddFrameCommandBuffer().
+  SampleOptions& EnableBatchedSubmits() {
+    batched_submits = true;
+    return *this;
+  }
+  // Records a compute stage every frame with Sample::RecordComputeStage,
+  // and submits it to the async compute queue before the frame's graphics
+  // work, so that it overlaps with the graphics work of the previous frame.
+  // The graphics work of the frame waits for it in |wait_stages|. Without an
+  // async compute queue, it runs on the render queue instead. Implies
+  // EnableAsyncCompute().
+  SampleOptions& EnableAsyncComputeStage(
+      VkPipelineStageFlags wait_stages =
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+          VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+          VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) {
+    async_compute = true;
+    async_compute_stage = true;
+    compute_stage_wait_stages = wait_stages;
+    return *this;
+  }
+  // Shares the swapchain images between a separate present queue family and
+  // the render queue family, and the compute stage buffers between the async
+  // compute and render queue families, with VK_SHARING_MODE_CONCURRENT.
+  // By default they are exclusive, and their ownership moves between the
+  // families every frame, which takes two more submits to the present queue
+  // and a semaphore per image, and barriers around the compute stage.
+  // Concurrent resources may be slower to access on some devices instead,
+  // see queue_sharing_benchmark. The application creates the compute stage
+  // buffers with Sample::SetComputeStageSharing().
+  SampleOptions& EnableConcurrentSharing() {
+    concurrent_sharing = true;
+    return *this;
+  }
+  // Recreates the swapchain when it is out of date or suboptimal, e.g. after
+  // the window was resized or rotated, instead of failing. Only what depends
+  // on the swapchain is rebuilt: InitializeFrameData() is called again for
+  // every image, after Sample::SwapchainRecreated(). The pipelines are kept,
+  // so the application has to leave their viewport and scissor dynamic, and
+  // set viewport() and scissor() when it records.
+  SampleOptions& EnableResizableSwapchain() {
+    resizable_swapchain = true;
+    return *this;
+  }
+  // Synchronizes frames with one timeline semaphore per queue, signaled with
+  // an increasing frame value, instead of a fence per frame in flight.
+  // The application must enable VK_KHR_timeline_semaphore in its device
+  // extensions. Sample::frame_fence() is then not available.
+  SampleOptions& EnableTimelineFrameSync() {
+    timeline_frame_sync = true;
+    return *this;
+  }
+  // Submits the work of every frame before its latest input is read. The
+  // submission of the frame waits in |wait_stages| on a timeline semaphore
+  // that the host only signals after Sample::LateUpdate() has read the input
+  // and written the data that depends on it, so vkQueueSubmit is no longer
+  // between the input and the GPU. LateUpdate() may only write to
+  // host-visible memory that the frame reads in |wait_stages|, e.g. with
+  // BufferFrameData's kBufferFrameDataDirect, or the transient ring buffer.
+  // The compute stage is not held back. Implies EnableTimelineFrameSync()
+  // and EnableBatchedSubmits(), so the application must enable
+  // VK_KHR_timeline_semaphore, and add its command buffers with
+  // Sample::AddFrameCommandBuffer() instead of submitting them.
+  SampleOptions& EnableSubmitAhead(
+      VkPipelineStageFlags wait_stages =
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+          VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) {
+    submit_ahead = true;
+    timeline_frame_sync = true;
+    batched_submits = true;
+    submit_ahead_wait_stages = wait_stages;
+    return *this;
+  }
+  // Creates a per-frame ring of host-visible memory for transient data,
+  // see Sample::transient_ring_buffer().
+  SampleOptions& EnableTransientRingBuffer(uint32_t size_in_MB) {
+    transient_ring_buffer_size_in_MB = size_in_MB;
+    return *this;
+  }
+  // Limits the number of frames that can be queued on the GPU at once to
+  // |count|, independently of how many images the swapchain has. 0, the
+  // default, allows one frame per swapchain image.
+  SampleOptions& SetFramesInFlight(uint32_t count) {
+    frames_in_flight = count;
+    return *this;
+  }
+  // Asks for a swapchain with |count| images, clamped to what the surface
+  // allows, instead of the number from -swapchain-images.
+  SampleOptions& SetSwapchainImages(uint32_t count) {
+    swapchain_images = count;
+    return *this;
+  }
+  // Presents with the mode called |name|, see vulkan::GetPresentModeFromName,
+  // instead of the one from -present-mode. |name| must outlive the Sample.
+  SampleOptions& SetPresentMode(const char* name) {
+    present_mode = name;
+    return *this;
+  }
+  // Starts |num_threads| worker threads that record secondary command
+  // buffers, see Sample::parallel_recorder().
+  SampleOptions& EnableParallelRecording(uint32_t num_threads) {
+    parallel_recording_threads = num_threads;
+    return *this;
+  }
+  // Measures up to |max_zones_per_frame| named GPU zones per frame with
+  // timestamp queries, see Sample::gpu_profiler(). The query pools are reset
+  // from the host if host_query_reset is also enabled.
+  SampleOptions& EnableGpuProfiler(uint32_t max_zones_per_frame) {
+    gpu_profiler_zones = max_zones_per_frame;
+    return *this;
+  }
+  // Also counts hardware performance counters, such as cache hit rates, ALU
+  // utilization and memory traffic, in the outermost GPU zones, see
+  // vulkan::PerformanceCounters. The application must enable
+  // VK_KHR_performance_query, and chain a
+  // VkPhysicalDevicePerformanceQueryFeaturesKHR with
+  // performanceCounterQueryPools into device_extension_structures. If the
+  // counters need more than one pass, every kCounterReplayInterval measured
+  // frames one frame is submitted again for every other pass, which needs
+  // batched submits, host query reset and no async compute stage, separate
+  // present queue or -output-frames. The replays wait for the GPU, so they
+  // stall those frames.
+  SampleOptions& EnablePerformanceCounters() {
+    performance_counters = true;
+    return *this;
+  }
+  // Renders to an offscreen target of the swapchain size, of which only
+  // Sample::resolution_scale() of the width and height is used, and blits
+  // that to the swapchain image. The scale follows the GPU time of the
+  // frames, measured with the GPU profiler, towards |gpu_budget_ms|, but
+  // never goes below |min_scale|. The application has to set viewport() and
+  // scissor() as dynamic state every frame, and render only to scissor().
+  // It can not be combined with multisampling.
+  SampleOptions& EnableDynamicResolution(float gpu_budget_ms,
+                                         float min_scale = 0.5f) {
+    dynamic_resolution_budget = gpu_budget_ms / 1000.0f;
+    dynamic_resolution_min_scale = min_scale;
+    return *this;
+  }
+  // Chains |device_extension_structure| into the creation of the device.
+  // More than one structure can be given as the head() of a
+  // vulkan::StructureChain, which has to outlive the construction of the
+  // Sample.
   SampleOptions& AddDeviceExtensionStructure(void* device_extension_structure) {
     device_extension_structures = device_extension_structure;
     return *this;
@@ -141,6 +455,37 @@ const VkSubmitInfo kEmptySubmitInfo{
     nullptr  // pSignalSemaphores
 };
 
+// PipelinedState double-buffers the state that Update() writes for
+// Render(), with SampleOptions::EnablePipelinedUpdate. Update() writes the
+// copy that BeginUpdate() returns while Render() reads the other one; the
+// two are swapped every frame. Without pipelined updates, both use the
+// same copy.
+template <typename T>
+class PipelinedState {
+ public:
+  explicit PipelinedState(const T& initial) : states_{initial, initial} {}
+
+  // Returns the copy for Update() of |sample|, which starts out as the
+  // state of the last update.
+  template <typename S>
+  T& BeginUpdate(const S* sample) {
+    T& state = states_[sample->update_state_index()];
+    if (sample->update_state_index() != sample->render_state_index()) {
+      state = states_[sample->render_state_index()];
+    }
+    return state;
+  }
+
+  // Returns the copy for Render() of |sample|.
+  template <typename S>
+  const T& render(const S* sample) const {
+    return states_[sample->render_state_index()];
+  }
+
+ private:
+  T states_[2];
+};
+
 template <typename FrameData>
 class Sample {
   // The per-frame data for an application.
@@ -151,6 +496,9 @@ class Sample {
     containers::unique_ptr<vulkan::VkImageView> image_view;
     // The view for the depth that is to be rendered to on this frame
     containers::unique_ptr<vulkan::VkImageView> depth_view_;
+    // image_view and depth_view_, described for the framebuffer cache.
+    vulkan::FramebufferCache::Attachment color_attachment_;
+    vulkan::FramebufferCache::Attachment depth_attachment_;
     // A commandbuffer to transfer the swapchain from the present queue to
     // the main queue.
     containers::unique_ptr<vulkan::VkCommandBuffer>
@@ -167,18 +515,51 @@ class Sample {
     // The semaphore that handles transfering the swapchain image
     // between the present and render queues.
     containers::unique_ptr<vulkan::VkSemaphore> transfer_semaphore_;
+    // Whether the child's static command buffers for this frame are
+    // recorded, and the key they were recorded with.
+    bool static_recorded_ = false;
+    uint64_t static_key_ = 0;
+    // Whether the image has been presented, and whether the setup command
+    // buffer keeps what was presented instead of discarding it.
+    bool presented_ = false;
+    bool keeps_contents_ = false;
+    // With damage tracking, the bounds of everything that changed since the
+    // image was last presented.
+    VkRect2D damage_ = {{0, 0}, {0, 0}};
     // The depth_stencil image, if it exists.
     vulkan::ImagePointer depth_stencil_;
     // The multisampled render target if it exists.
     vulkan::ImagePointer multisampled_target_;
-    // The semaphore controlling access to the swapchain.
-    containers::unique_ptr<vulkan::VkSemaphore> ready_semaphore_;
-    // The fence that signals that the resources for this frame are free.
-    containers::unique_ptr<vulkan::VkFence> ready_fence_;
+    // The render target of the swapchain size with dynamic resolution, of
+    // which only the scissor() is rendered to and blit to the swapchain.
+    vulkan::ImagePointer scaled_target_;
+    // The buffers that the compute stage of this frame writes, and the
+    // graphics work reads, see AddComputeStageBuffer().
+    ::VkBuffer compute_buffers_[kMaxComputeStageBuffers];
+    uint32_t num_compute_buffers_ = 0;
+    // Whether the graphics work of the last frame that rendered to this
+    // image released compute_buffers_ to the compute queue family.
+    bool compute_buffers_released_ = false;
     // The application-specific data for this frame.
     FrameData child_data_;
   };
 
+  // The synchronization for one of the frames that can be in flight. Frames
+  // use the slots in turn, independently of the swapchain image they get.
+  struct FrameSlot {
+    // The semaphore controlling access to the swapchain. It goes back to the
+    // pool once ready_fence_ has signaled.
+    containers::unique_ptr<vulkan::VkSemaphore> ready_semaphore_;
+    // The fence that signals that the frame rendered with this slot is done.
+    // With timeline frame sync, frame_value_ is used instead.
+    containers::unique_ptr<vulkan::VkFence> ready_fence_;
+    // The value of frame_timeline_ that the last frame rendered with this
+    // slot signals, or 0 if there was none.
+    uint64_t frame_value_ = 0;
+    // Signaled by the compute stage of the frame, for its graphics work.
+    containers::unique_ptr<vulkan::VkSemaphore> compute_semaphore_;
+  };
+
  public:
   Sample(containers::Allocator* allocator, const entry::EntryData* entry_data,
          uint32_t host_buffer_size_in_MB, uint32_t image_memory_size_in_MB,
@@ -191,6 +572,12 @@ class Sample {
       : options_(options),
         data_(entry_data),
         allocator_(allocator),
+        job_system_(allocator),
+        timeline_features_{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+            options.device_extension_structures,  // pNext
+            VK_TRUE,                              // timelineSemaphore
+        },
         application_(
             allocator, entry_data->logger(), entry_data, instance_extensions,
             device_extensions, physical_device_features,
@@ -200,15 +587,62 @@ class Sample {
             coherent_buffer_size_in_MB * 1024 * 1024, options.async_compute,
             options.sparse_binding, false, 0, options.protected_memory,
             options.host_query_reset,
-            options.extended_swapchain_color_space
-                ? VK_COLOR_SPACE_EXTENDED_SRGB_NONLINEAR_EXT
-                : VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+            options.enable_fp16_hdr
+                ? VK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT
+                : options.extended_swapchain_color_space
+                      ? VK_COLOR_SPACE_EXTENDED_SRGB_NONLINEAR_EXT
+                      : VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
             options.shared_presentation, options.mutable_swapchain_format,
             options.mutable_swapchain_format ? &kMutableSwapchainImageFormatList
                                              : nullptr,
             options.enable_vulkan_1_1, options.enable_10bit_hdr,
-            options.device_extension_structures),
+            options.timeline_frame_sync ? &timeline_features_
+                                        : options.device_extension_structures,
+            options.tlsf_arenas ? vulkan::ArenaStrategy::kTLSF
+                                : vulkan::ArenaStrategy::kOrderedFreeList,
+            options.transfer_queue, &job_system_,
+            options.num_async_compute_queues, options.swapchain_images,
+            options.present_mode,
+            options.concurrent_sharing ? VK_SHARING_MODE_CONCURRENT
+                                       : VK_SHARING_MODE_EXCLUSIVE),
         frame_data_(allocator),
+        every_frame_buffers_(allocator),
+        frame_slots_(allocator),
+        image_fences_(allocator),
+        image_values_(allocator),
+        last_frame_value_(0),
+        next_frame_slot_(0),
+        free_semaphores_(allocator),
+        num_semaphores_created_(0),
+        next_headless_image_(0),
+        num_headless_frames_(0),
+        headless_frame_time_(0.0f),
+        frame_times_(allocator,
+                     entry_data->benchmark_frames() > 0
+                         ? entry_data->benchmark_frames()
+                         : entry_data->stats_file() ? kMaxRecordedFrames : 0),
+        present_latencies_(allocator, options.low_latency_presentation
+                                          ? kMaxRecordedFrames
+                                          : 0),
+        fence_wait_times_(allocator,
+                          entry_data->benchmark_frames() > 0
+                              ? entry_data->benchmark_frames()
+                              : entry_data->stats_file() ? kMaxRecordedFrames
+                                                         : 0),
+        frame_wait_time_(0.0f),
+        num_frames_processed_(0),
+        shared_image_acquired_(false),
+        swapchain_out_of_date_(false),
+        num_frame_damage_rects_(0),
+        update_pending_(false),
+        pending_input_time_ns_(0),
+        update_state_index_(0),
+        render_state_index_(0),
+        frame_allocator_(allocator, kFrameAllocatorSize),
+        frame_command_buffers_(allocator),
+        replay_counter_passes_(false),
+        resolution_scale_(1.0f),
+        blit_filter_(VK_FILTER_NEAREST),
         swapchain_images_(application_.swapchain_images()),
         last_frame_time_(std::chrono::high_resolution_clock::now()),
         initialization_command_buffer_(application_.GetCommandBuffer()),
@@ -217,8 +651,85 @@ class Sample {
     if (data_->fixed_timestep()) {
       app()->GetLogger()->LogInfo("Running with a fixed timestep of 0.1s");
     }
+    if (data_->trace_file()) {
+      trace::Start(allocator_);
+    }
 
     frame_data_.reserve(swapchain_images_.size());
+    // There is no point in more frames than images, the next acquire would
+    // only block on the presentation engine instead.
+    // -max-frame-latency overrides what the application asked for.
+    size_t frames_in_flight = swapchain_images_.size();
+    uint32_t max_frame_latency = data_->max_frame_latency() > 0
+                                     ? data_->max_frame_latency()
+                                     : options.frames_in_flight;
+    if (max_frame_latency > 0 && max_frame_latency < frames_in_flight) {
+      frames_in_flight = max_frame_latency;
+    }
+    vulkan::FenceWaiter::Policy wait_policy =
+        vulkan::FenceWaiter::Policy::kBlock;
+    uint64_t wait_interval_ns = 0;
+    if (entry_data->fence_wait()) {
+      if (vulkan::FenceWaiter::ParsePolicy(entry_data->fence_wait(),
+                                           &wait_policy, &wait_interval_ns)) {
+        app()->GetLogger()->LogInfo(
+            "Waiting for the GPU with the ",
+            vulkan::FenceWaiter::PolicyName(wait_policy), " policy, ",
+            wait_interval_ns / 1000, "us at a time");
+      } else {
+        app()->GetLogger()->LogError("Unknown -fence-wait policy ",
+                                     entry_data->fence_wait(),
+                                     ", blocking instead");
+      }
+    }
+    fence_waiter_ = containers::make_unique<vulkan::FenceWaiter>(
+        allocator_, &application_.device(), wait_policy, wait_interval_ns);
+    frame_slots_.resize(frames_in_flight);
+    image_fences_.resize(swapchain_images_.size(),
+                         static_cast<::VkFence>(VK_NULL_HANDLE));
+    if (options.timeline_frame_sync) {
+      LOG_ASSERT(==, app()->GetLogger(), true,
+                 HasExtension(device_extensions,
+                              VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME));
+      frame_timeline_ = containers::make_unique<vulkan::VkSemaphore>(
+          allocator_,
+          vulkan::CreateTimelineSemaphore(&application_.device(), 0));
+      application_.SetObjectName(VK_OBJECT_TYPE_SEMAPHORE,
+                                 uint64_t(::VkSemaphore(*frame_timeline_)),
+                                 "frame_timeline");
+      if (TransfersSwapchainImages()) {
+        present_timeline_ = containers::make_unique<vulkan::VkSemaphore>(
+            allocator_,
+            vulkan::CreateTimelineSemaphore(&application_.device(), 0));
+      }
+      if (options.submit_ahead) {
+        input_timeline_ = containers::make_unique<vulkan::VkSemaphore>(
+            allocator_,
+            vulkan::CreateTimelineSemaphore(&application_.device(), 0));
+        application_.SetObjectName(VK_OBJECT_TYPE_SEMAPHORE,
+                                   uint64_t(::VkSemaphore(*input_timeline_)),
+                                   "input_timeline");
+      }
+      image_values_.resize(swapchain_images_.size(), 0);
+    } else {
+      for (size_t i = 0; i < frame_slots_.size(); ++i) {
+        auto& slot = frame_slots_[i];
+        slot.ready_fence_ = containers::make_unique<vulkan::VkFence>(
+            allocator_, vulkan::CreateFence(&application_.device(), true));
+        if (application_.use_debug_utils()) {
+          const std::string name = "frame_fence_" + std::to_string(i);
+          application_.SetObjectName(VK_OBJECT_TYPE_FENCE,
+                                     uint64_t(::VkFence(*slot.ready_fence_)),
+                                     name.c_str());
+        }
+      }
+    }
+    if (options.async_compute_stage && application_.async_compute_queue()) {
+      for (auto& slot : frame_slots_) {
+        slot.compute_semaphore_ = containers::make_unique<vulkan::VkSemaphore>(
+            allocator_, vulkan::CreateSemaphore(&application_.device()));
+      }
+    }
     // TODO: The image format used by the swapchain image may not suppport
     // multi-sampling. Fix this later by adding a vkCmdBlitImage command
     // after the vkCmdResolveImage.
@@ -242,6 +753,113 @@ class Sample {
     default_scissor_ = {
         {0, 0},
         {application_.swapchain().width(), application_.swapchain().height()}};
+
+    if (options.transient_ring_buffer_size_in_MB > 0) {
+      transient_ring_buffer_ =
+          containers::make_unique<vulkan::TransientRingBuffer>(
+              allocator_, &application_,
+              options.transient_ring_buffer_size_in_MB * 1024 * 1024,
+              VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+              swapchain_images_.size());
+    }
+    buffer_update_batch_ = containers::make_unique<vulkan::BufferUpdateBatch>(
+        allocator_, &application_, swapchain_images_.size());
+    if (options.parallel_recording_threads > 0) {
+      parallel_recorder_ =
+          containers::make_unique<vulkan::ParallelCommandRecorder>(
+              allocator_, &application_, options.parallel_recording_threads,
+              frame_slots_.size(), application_.render_queue().index());
+    }
+    const bool dynamic_resolution = options.dynamic_resolution_budget > 0.0f;
+    // Dynamic resolution measures every frame with a zone of its own.
+    const uint32_t gpu_profiler_zones =
+        options.gpu_profiler_zones + (dynamic_resolution ? 1 : 0);
+    if (gpu_profiler_zones > 0) {
+      gpu_profiler_ = containers::make_unique<vulkan::GpuProfiler>(
+          allocator_, &application_, frame_slots_.size(), gpu_profiler_zones,
+          options.host_query_reset,
+          HasExtension(device_extensions,
+                       VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME),
+          physical_device_features.pipelineStatisticsQuery == VK_TRUE,
+          options.performance_counters &&
+              HasExtension(device_extensions,
+                           VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME));
+    }
+    if (options.damage_tracking) {
+      LOG_ASSERT(==, app()->GetLogger(), true,
+                 HasExtension(device_extensions,
+                              VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME));
+      // Only the swapchain image itself keeps its contents.
+      LOG_ASSERT(==, app()->GetLogger(), false,
+                 options.enable_multisampling || dynamic_resolution);
+    }
+    if (options.pipelined_update) {
+      // Both need the damage and the update of the frame that is rendered.
+      LOG_ASSERT(==, app()->GetLogger(), false,
+                 options.damage_tracking || options.low_latency_presentation);
+      update_tasks_ =
+          containers::make_unique<jobs::TaskGroup>(allocator_, &job_system_);
+    }
+    if (dynamic_resolution) {
+      LOG_ASSERT(==, data_->logger(), false, options.enable_multisampling);
+      VkFormatProperties properties;
+      application_.instance()->vkGetPhysicalDeviceFormatProperties(
+          application_.device().physical_device(), render_target_format_,
+          &properties);
+      blit_filter_ = (properties.optimalTilingFeatures &
+                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+                         ? VK_FILTER_LINEAR
+                         : VK_FILTER_NEAREST;
+    }
+    if (options.enable_display_timing && !application_.headless()) {
+      frame_pacer_ = containers::make_unique<vulkan::FramePacer>(
+          allocator_, &application_, options.display_timing_refresh_divisor);
+    }
+    if (data_->thermal_status() >= 0) {
+      thermal_limiter_ = containers::make_unique<vulkan::ThermalLimiter>(
+          allocator_, data_, app()->GetLogger());
+    }
+    if (data_->capture_first_frame() > 0) {
+      if (TransfersSwapchainImages()) {
+        // The resolve already hands the image to the present queue.
+        app()->GetLogger()->LogError(
+            "-output-frames does not support a separate present queue");
+      } else {
+        frame_capture_ = containers::make_unique<vulkan::FrameCapture>(
+            allocator_, &application_, application_.swapchain().width(),
+            application_.swapchain().height(),
+            application_.swapchain().format(), data_->output_frame_file(),
+            data_->capture_raw(), frame_slots_.size(), kFrameCaptureThreads);
+      }
+    }
+    if (data_->count_api_calls() || data_->audit_allocator()) {
+      api_call_stats_ = containers::make_unique<vulkan::ApiCallStats>(
+          allocator_, allocator_, &application_.device());
+    }
+    if (data_->audit_allocator()) {
+      allocation_audit_ = containers::make_unique<vulkan::AllocationAudit>(
+          allocator_, data_->audit_allocator(), api_call_stats_.get(),
+          application_.host_allocation_statistics(),
+          data_->audit_allocations() == entry::kAllocationAuditFatal,
+          app()->GetLogger());
+    }
+    if (gpu_profiler_ && gpu_profiler_->num_counter_passes() > 1) {
+      replay_counter_passes_ = gpu_profiler_->can_replay_counter_passes() &&
+                               options.batched_submits &&
+                               !options.async_compute_stage &&
+                               !TransfersSwapchainImages() &&
+                               !frame_capture_;
+      if (!replay_counter_passes_) {
+        app()->GetLogger()->LogError(
+            "The performance counters need ",
+            gpu_profiler_->num_counter_passes(),
+            " passes, which needs batched submits, host query reset and no "
+            "async compute stage, separate present queue or -output-frames");
+      }
+    }
   }
 
   // This must be called before any other methods on this class. It initializes
@@ -249,72 +867,61 @@ class Sample {
   // on the subclass, as well as InitializeLocalFrameData for every
   // image in the swapchain.
   void Initialize() {
+    STARTUP_PHASE("Sample::Initialize");
     initialization_command_buffer_->vkBeginCommandBuffer(
         initialization_command_buffer_, &kBeginCommandBuffer);
 
     InitializeApplicationData(&initialization_command_buffer_,
                               swapchain_images_.size());
-	
-    if (options_.enable_10bit_hdr) {
-      VkHdrMetadataEXT hdr10_metadata{
-          VK_STRUCTURE_TYPE_HDR_METADATA_EXT,
-          nullptr,             // pNext;
-          {0.708f, 0.292f},    // displayPrimaryRed;
-          {0.17f, 0.797f},     // displayPrimaryGreen;
-          {0.131f, 0.046f},    // displayPrimaryBlue;
-          {0.3127f, 0.329f},   // whitePoint;
-          1000.0f * 10000.0f,  // maxLuminance;
-          0.001 * 10000.0f,    // minLuminance;
-          2000.0f,             // maxContentLightLevel;
-          500.0f               // maxFrameAverageLightLevel;
-      };
-
-      application_.device()->vkSetHdrMetadataEXT(
-          application_.device(), 1, &application_.swapchain().get_raw_object(),
-          &hdr10_metadata);
-    }
-
-    for (size_t i = 0; i < swapchain_images_.size(); ++i) {
-      frame_data_.push_back(SampleFrameData());
-      InitializeLocalFrameData(&frame_data_.back(),
-                               &initialization_command_buffer_, i);
-    }
-
-    initialization_command_buffer_->vkEndCommandBuffer(
-        initialization_command_buffer_);
-
-    VkSubmitInfo submit_info = kEmptySubmitInfo;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers =
-        &(initialization_command_buffer_.get_command_buffer());
-
-    vulkan::VkFence init_fence = vulkan::CreateFence(&application_.device());
-
-    application_.render_queue()->vkQueueSubmit(application_.render_queue(), 1,
-                                               &submit_info,
-                                               init_fence.get_raw_object());
-    application_.device()->vkWaitForFences(application_.device(), 1,
-                                           &init_fence.get_raw_object(), false,
-                                           0xFFFFFFFFFFFFFFFF);
-    // Bit gross but submit all of the fences here
-    for (auto& frame_data : frame_data_) {
-      application_.render_queue()->vkQueueSubmit(
-          application_.render_queue(), 0, nullptr, *frame_data.ready_fence_);
-    }
+    // Pipelines the application committed asynchronously are compiled in
+    // parallel, the frame data may already record commands that use them.
+    application_.WaitForPipelines();
+    SetHdrMetadata();
+    InitializeSwapchainFrameData(&initialization_command_buffer_);
+    SubmitInitializationCommands(&initialization_command_buffer_);
 
     application_.InitializationComplete();
     InitializationComplete();
     data_->NotifyReady();
   }
 
-  void WaitIdle() { app()->device()->vkDeviceWaitIdle(app()->device()); }
+  void WaitIdle() {
+    WaitForUpdate();
+    app()->device()->vkDeviceWaitIdle(app()->device());
+  }
+
+  // With pipelined updates, which copy of a PipelinedState Update() and
+  // Render() use. Both are 0 otherwise.
+  size_t update_state_index() const { return update_state_index_; }
+  size_t render_state_index() const { return render_state_index_; }
 
   // The format that we are using to render. This will be either the swapchain
   // format if we are not rendering multi-sampled, or the multisampled image
   // format if we are rendering multi-sampled.
   VkFormat render_format() const { return render_target_format_; }
 
-  VkFormat depth_format() const { return kDepthFormat; }
+  VkFormat depth_format() const { return options_.depth_buffer_format; }
+  // The aspects of depth_format(), for image views and barriers of the
+  // depth buffer.
+  VkImageAspectFlags depth_aspects() const {
+    switch (options_.depth_buffer_format) {
+      case VK_FORMAT_D16_UNORM_S8_UINT:
+      case VK_FORMAT_D24_UNORM_S8_UINT:
+      case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+      default:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    }
+  }
+  // True if the application should draw its opaque geometry in a depth
+  // pre-pass first, see SampleOptions::EnableDepthPrePass().
+  bool depth_pre_pass() const { return options_.depth_pre_pass; }
+  // The store op to use for the depth buffer when its contents are not
+  // needed after the render pass.
+  VkAttachmentStoreOp depth_store_op() const {
+    return options_.transient_attachments ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                          : VK_ATTACHMENT_STORE_OP_STORE;
+  }
 
   // The number of samples that we are rendering with.
   VkSampleCountFlagBits num_samples() const { return num_samples_; }
@@ -324,192 +931,660 @@ class Sample {
   VkSampleCountFlagBits num_depth_stencil_samples() const { return num_depth_stencil_samples_; }
 
   vulkan::VulkanApplication* app() { return &application_; }
+
+  // Returns the ring of host-visible memory for data that only lives for
+  // one frame, or nullptr if SampleOptions::EnableTransientRingBuffer was not
+  // used. Allocations made during Render() are reclaimed once that frame's
+  // fence has signaled, the next time the same swapchain image is rendered.
+  // Update() runs before the frame is known, so it must not allocate from
+  // here.
+  vulkan::TransientRingBuffer* transient_ring_buffer() {
+    return transient_ring_buffer_.get();
+  }
+  // Returns an allocator for host memory that only lives for one frame, e.g.
+  // scratch containers::vectors in Update() or Render(). Everything that was
+  // allocated from it must be gone by the time the next frame is processed,
+  // when it takes all of its memory back at once. It may only be used from
+  // the thread that processes frames.
+  containers::Allocator* frame_allocator() { return &frame_allocator_; }
+  // Returns the job system, with a worker thread per core, to split CPU
+  // work in Update() or Render() over, e.g. with ParallelFor(). Its jobs
+  // must not use frame_allocator().
+  jobs::JobSystem* job_system() { return &job_system_; }
+  // Returns the worker threads that record secondary command buffers for
+  // the current frame, or nullptr if SampleOptions::EnableParallelRecording
+  // was not used. The command buffers it records are reclaimed once the
+  // frame has finished on the GPU, so they must be re-recorded every frame
+  // from Render().
+  vulkan::ParallelCommandRecorder* parallel_recorder() {
+    return parallel_recorder_.get();
+  }
+  // Returns the GPU zone profiler for the current frame, or nullptr if
+  // SampleOptions::EnableGpuProfiler was not used. Zones are measured with
+  // vulkan::GpuZone, in command buffers that are recorded every frame, and
+  // their statistics are logged on exit together with the frame times.
+  // If the application enables VK_EXT_calibrated_timestamps, the GPU times
+  // are also calibrated against the CPU clock, and if it enables the
+  // pipelineStatisticsQuery feature, zones also count shader invocations.
+  // With SampleOptions::EnablePerformanceCounters, the outermost zones also
+  // count hardware performance counters.
+  vulkan::GpuProfiler* gpu_profiler() { return gpu_profiler_.get(); }
+  // Returns the pacer of the swapchain's presents, or nullptr if
+  // SampleOptions::EnableDisplayTiming was not used or there is no
+  // swapchain. Its late, early and on time presents are logged with the
+  // frame time statistics.
+  vulkan::FramePacer* frame_pacer() { return frame_pacer_.get(); }
+  // Returns the batch that BufferFrameData::UpdateBuffer calls made from
+  // UpdateFrameBuffers() should add their copies to.
+  vulkan::BufferUpdateBatch* buffer_update_batch() {
+    return buffer_update_batch_.get();
+  }
+  // Makes the default UpdateFrameBuffers() update |data| every frame, in the
+  // order in which they were given. |data| must outlive the Sample.
+  template <typename T>
+  void UpdateBufferEveryFrame(vulkan::BufferFrameData<T>* data) {
+    every_frame_buffers_.push_back(
+        {data, [](void* buffer, vulkan::BufferUpdateBatch* batch,
+                  vulkan::VkQueue* queue, size_t frame_index) {
+           static_cast<vulkan::BufferFrameData<T>*>(buffer)->UpdateBuffer(
+               batch, queue, frame_index);
+         }});
+  }
+  // Returns the fence that the commands of |frame_index| are submitted with,
+  // e.g. for VulkanApplication::DumpImageLayersDataAsync. This is only valid
+  // while that frame is being rendered, and is VK_NULL_HANDLE with timeline
+  // frame sync.
+  ::VkFence frame_fence(size_t frame_index) {
+    return image_fences_[frame_index];
+  }
+  // The number of frames that can be in flight at once. This is at most the
+  // number of swapchain images.
+  size_t frames_in_flight() const { return frame_slots_.size(); }
+  // The number of semaphores that ProcessFrame has had to create. They are
+  // recycled once the frame that used them is done, so this stops growing
+  // after the first frames_in_flight() frames.
+  size_t num_semaphores_created() const { return num_semaphores_created_; }
+  // Adds |command_buffer| to the submission of the current frame, after the
+  // framework's setup and before its resolve. This may only be called from
+  // Render(), and |command_buffer| must stay valid until the frame's fence
+  // has signaled.
+  void AddFrameCommandBuffer(vulkan::VkCommandBuffer* command_buffer) {
+    frame_command_buffers_.push_back(command_buffer->get_command_buffer());
+  }
+  // Adds |buffer| to the buffers that the compute stage of |frame_index|
+  // writes, and its graphics work reads, see
+  // SampleOptions::EnableAsyncComputeStage. If the async compute queue is of
+  // another queue family, the ownership of the buffer moves to it and back
+  // every frame, unless SampleOptions::EnableConcurrentSharing was given. The
+  // buffer should be created with SetComputeStageSharing(). It should be
+  // called from InitializeFrameData().
+  void AddComputeStageBuffer(size_t frame_index, ::VkBuffer buffer) {
+    SampleFrameData& data = frame_data_[frame_index];
+    LOG_ASSERT(<, app()->GetLogger(), data.num_compute_buffers_,
+               kMaxComputeStageBuffers);
+    data.compute_buffers_[data.num_compute_buffers_++] = buffer;
+  }
+  // Sets the sharing mode of |create_info|, for a buffer of the compute
+  // stage: concurrent between the async compute and render queue families
+  // with SampleOptions::EnableConcurrentSharing if they differ, exclusive
+  // otherwise. |create_info| refers to memory of the Sample.
+  void SetComputeStageSharing(VkBufferCreateInfo* create_info) {
+    const vulkan::VkQueue* compute_queue = app()->async_compute_queue();
+    compute_stage_families_[0] = app()->render_queue().index();
+    compute_stage_families_[1] =
+        compute_queue ? compute_queue->index() : compute_stage_families_[0];
+    if (options_.concurrent_sharing &&
+        compute_stage_families_[0] != compute_stage_families_[1]) {
+      create_info->sharingMode = VK_SHARING_MODE_CONCURRENT;
+      create_info->queueFamilyIndexCount = 2;
+      create_info->pQueueFamilyIndices = compute_stage_families_;
+    } else {
+      create_info->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      create_info->queueFamilyIndexCount = 0;
+      create_info->pQueueFamilyIndices = nullptr;
+    }
+  }
+  // Returns true if the swapchain images are exclusive to a present queue
+  // family of their own, and move to the render queue family and back every
+  // frame.
+  bool TransfersSwapchainImages() const {
+    return application_.HasSeparatePresentQueue() &&
+           !options_.concurrent_sharing;
+  }
+  // Returns true if the command buffers of |frame_index| that do not change
+  // from frame to frame were already recorded with |key|, e.g. a hash of
+  // the pipeline state they use, and can simply be resubmitted. Otherwise
+  // the frame is marked as recorded with |key|, and the caller must record
+  // them now. This may only be called from Render().
+  bool IsStaticFrameRecorded(size_t frame_index, uint64_t key) {
+    SampleFrameData& frame = frame_data_[frame_index];
+    if (frame.static_recorded_ && frame.static_key_ == key) {
+      return true;
+    }
+    frame.static_recorded_ = true;
+    frame.static_key_ = key;
+    return false;
+  }
+  // Makes the next IsStaticFrameRecorded call of every frame return false,
+  // e.g. after a pipeline or attachment the command buffers use changed.
+  void InvalidateStaticFrames() {
+    for (auto& frame : frame_data_) {
+      frame.static_recorded_ = false;
+    }
+  }
   const vulkan::VulkanApplication* app() const { return &application_; }
 
   const VkViewport& viewport() const { return default_viewport_; }
   const VkRect2D& scissor() const { return default_scissor_; }
+  // With SampleOptions::EnableDamageTracking, marks |rect| of the swapchain
+  // as changed by the current frame. It is presented as changed, and added
+  // to the damage_scissor() of every image. This should be called from
+  // Update().
+  void AddDamage(const VkRect2D& rect) {
+    if (num_frame_damage_rects_ == kMaxDamageRects) {
+      for (uint32_t i = 1; i < kMaxDamageRects; ++i) {
+        frame_damage_rects_[0] = DamageRect(
+            UnionRect(ScissorRect(frame_damage_rects_[0]),
+                      ScissorRect(frame_damage_rects_[i])));
+      }
+      num_frame_damage_rects_ = 1;
+    }
+    frame_damage_rects_[num_frame_damage_rects_++] = DamageRect(rect);
+    for (auto& frame : frame_data_) {
+      frame.damage_ = UnionRect(frame.damage_, rect);
+    }
+  }
+  // The part of the image of |frame_index| that changed since it was last
+  // presented, and has to be rendered again. This is the whole image until
+  // it has been presented once, and empty if nothing changed.
+  const VkRect2D& damage_scissor(size_t frame_index) const {
+    return frame_data_[frame_index].damage_;
+  }
+  // The fraction of the swapchain width and height that is rendered with
+  // dynamic resolution, 1 otherwise.
+  float resolution_scale() const { return resolution_scale_; }
 
   // This calls both Update(time) and Render() for the subclass.
   // The update is meant to update all of the non-graphics state of the
   // application. Render() is used to actually process the commands
   // for rendering this particular frame.
   void ProcessFrame() {
+    TRACE_ZONE("ProcessFrame");
+    std::chrono::duration<float> slept_time(0.0f);
+    if (thermal_limiter_ && thermal_limiter_->min_frame_time() > 0.0f) {
+      TRACE_ZONE("ThermalLimit");
+      const auto sleep_start = std::chrono::high_resolution_clock::now();
+      std::this_thread::sleep_until(
+          last_frame_time_ +
+          std::chrono::duration_cast<
+              std::chrono::high_resolution_clock::duration>(
+              std::chrono::duration<float>(
+                  thermal_limiter_->min_frame_time())));
+      slept_time = std::chrono::high_resolution_clock::now() - sleep_start;
+    }
     auto current_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> elapsed_time = current_time - last_frame_time_;
     last_frame_time_ = current_time;
-    Update(data_->fixed_timestep() ? 0.1f : elapsed_time.count());
+    if (thermal_limiter_) {
+      thermal_limiter_->EndFrame(elapsed_time.count(), slept_time.count());
+    }
+    frame_allocator_.Reset();
+    num_frame_damage_rects_ = 0;
+    const auto update_time = std::chrono::high_resolution_clock::now();
+    // The input of the frame, for the latency of its present.
+    uint64_t input_time_ns = static_cast<uint64_t>(trace::NowNanoseconds());
+    const float frame_time = data_->FrameTime(elapsed_time.count());
+    if (update_tasks_) {
+      // Render this frame with the update that ran during the last one, and
+      // run the update for the next frame while it is recorded.
+      if (update_pending_) {
+        WaitForUpdate();
+        std::swap(input_time_ns, pending_input_time_ns_);
+      } else {
+        pending_input_time_ns_ = input_time_ns;
+        TRACE_ZONE("Update");
+        Update(frame_time);
+      }
+      render_state_index_ = update_state_index_;
+      update_state_index_ = 1 - render_state_index_;
+      update_pending_ = true;
+      update_tasks_->Run([this, frame_time]() {
+        TRACE_ZONE("Update");
+        Update(frame_time);
+      });
+    } else {
+      TRACE_ZONE("Update");
+      Update(frame_time);
+    }
 
     // Smooth this out, so that it is more sensible.
     average_frame_time_ =
         elapsed_time.count() * 0.05f + average_frame_time_ * 0.95f;
-
-	// Display Timing
-    VkRefreshCycleDurationGOOGLE rc_dur = {};
-    static unsigned refresh_multiplier = 1;
-    static uint32_t present_id = 0;
-
-    if (options_.enable_display_timing) {
-      VkResult res = app()->instance()->vkGetRefreshCycleDurationGOOGLE(
-          app()->device(), app()->swapchain(), &rc_dur);
-
-      VkPastPresentationTimingGOOGLE past[256] = {};
-      uint32_t count = 0;
-
-      res = app()->instance()->vkGetPastPresentationTimingGOOGLE(
-          app()->device(), app()->swapchain(), &count, nullptr);
-
-      if (count) {
-        static unsigned early_frame_count = 0;
-        static uint32_t last_late_frame_id = 0;
-        bool increase_refresh_multiplier = false;
-        res = app()->instance()->vkGetPastPresentationTimingGOOGLE(
-            app()->device(), app()->swapchain(), &count, &past[0]);
-
-        for (uint32_t i = 0; i < count; ++i) {
-          if (past[i].actualPresentTime >
-              (past[i].desiredPresentTime + rc_dur.refreshDuration)) {
-            early_frame_count = 0;
-            // Mark the end of a group of late frames so that the refresh
-            // multiplier is only updated once per group
-            if (last_late_frame_id < past[i].presentID) {
-              increase_refresh_multiplier = true;
-              last_late_frame_id = present_id - 1;
-            }
-          }
-          // Decrease image present duration by one refresh cycle if image can
-          // be presented early for 3 seconds worth of frames
-          else if (past[i].earliestPresentTime < past[i].actualPresentTime) {
-            uint64_t present_time_difference =
-                past[i].actualPresentTime - past[i].earliestPresentTime;
-            if ((present_time_difference >= 8E6) &&
-                (past[i].presentMargin >= 8E6)) {
-              increase_refresh_multiplier = false;
-              early_frame_count += 1;
-
-              unsigned early_frame_count_limit = static_cast<unsigned>(
-                  3E9 / (rc_dur.refreshDuration * refresh_multiplier));
-
-              if (early_frame_count >= early_frame_count_limit) {
-                early_frame_count = 0;
-                if (refresh_multiplier > 1) {
-                  refresh_multiplier -= 1;
-                }
-              }
-            }
-            // reset late the early frame counter if image presentation occurs
-            // on schedule
-            else {
-              increase_refresh_multiplier = false;
-              early_frame_count = 0;
-            }
-          }
+    // The first frame also measures initialization, so it is left out, as
+    // are the warmup frames.
+    const bool measured_frame = num_frames_processed_++ >=
+                                std::max<uint64_t>(1, data_->warmup_frames());
+    if (measured_frame) {
+      frame_times_.Record(elapsed_time.count());
+      // The waits of the frame that the elapsed time covers.
+      fence_wait_times_.Record(frame_wait_time_);
+      if (api_call_stats_) {
+        api_call_stats_->EndFrame();
+      }
+      if (frame_times_.num_recorded() == data_->benchmark_frames()) {
+        // Do not modify this line, scripts may look for it in the output.
+        frame_times_.LogStatistics("BENCHMARK:", kFrameTimeBudget,
+                                   app()->GetLogger());
+        fence_wait_times_.LogStatistics("FENCE_WAIT:", kGpuBoundWaitTime,
+                                        app()->GetLogger());
+        if (gpu_profiler_) {
+          gpu_profiler_->LogStatistics(app()->GetLogger());
+        }
+        if (frame_pacer_) {
+          frame_pacer_->LogStatistics("PACING:", app()->GetLogger());
+        }
+        if (thermal_limiter_) {
+          thermal_limiter_->LogStatistics("THERMAL:", app()->GetLogger());
         }
-        // Increase image present duration by an additional refresh cycle
-        if (increase_refresh_multiplier) {
-          refresh_multiplier += 1;
+        if (options_.low_latency_presentation) {
+          present_latencies_.LogStatistics("LATENCY:", 0.0f,
+                                           app()->GetLogger());
+        }
+        if (api_call_stats_ && data_->count_api_calls()) {
+          api_call_stats_->LogStatistics("API_CALLS:", app()->GetLogger());
+        }
+        if (allocation_audit_) {
+          allocation_audit_->LogSummary("ALLOCATION_AUDIT:");
         }
-        rc_dur.refreshDuration *= refresh_multiplier;
       }
+    } else if (api_call_stats_) {
+      api_call_stats_->DiscardFrame();
+    }
+    if (allocation_audit_) {
+      allocation_audit_->CheckFrame(measured_frame, num_frames_processed_ - 1);
     }
+    frame_wait_time_ = 0.0f;
 
-    uint32_t image_idx;
+    if (frame_pacer_) {
+      frame_pacer_->BeginFrame();
+    }
 
-    // This is a bit weird as we have to make new semaphores every frame, but
-    // for now this will do. It will get cleaned up the next time
-    // this image is used.
-    vulkan::VkSemaphore temp_semaphore =
-        vulkan::CreateSemaphore(&app()->device());
+    uint32_t image_idx;
 
-    LOG_ASSERT(==, app()->GetLogger(), VK_SUCCESS,
-               app()->device()->vkAcquireNextImageKHR(
-                   app()->device(), app()->swapchain(), 0xFFFFFFFFFFFFFFFF,
-                   temp_semaphore.get_raw_object(),
-                   static_cast<::VkFence>(VK_NULL_HANDLE), &image_idx));
+    // Waiting for the oldest frame in flight before acquiring is what bounds
+    // how far ahead of the GPU we can get.
+    const size_t slot_index = next_frame_slot_;
+    FrameSlot& slot = frame_slots_[slot_index];
+    next_frame_slot_ = (next_frame_slot_ + 1) % frame_slots_.size();
+    ::VkFence ready_fence = VK_NULL_HANDLE;
+    if (frame_timeline_) {
+      TRACE_ZONE("vkWaitSemaphores");
+      WaitForFrameValue(slot.frame_value_);
+    } else {
+      TRACE_ZONE("vkWaitForFences");
+      ready_fence = *slot.ready_fence_;
+      frame_wait_time_ += fence_waiter_->WaitForFence(ready_fence);
+    }
+    if (frame_capture_) {
+      // The copies of the last frame of this slot are done.
+      frame_capture_->CompleteFrames(slot_index);
+    }
 
-    ::VkFence ready_fence = *frame_data_[image_idx].ready_fence_;
+    ::VkSemaphore ready_semaphore = VK_NULL_HANDLE;
+    // Only signaled by the render queue for the present, when nothing was
+    // acquired.
+    ::VkSemaphore shared_present_semaphore = VK_NULL_HANDLE;
+    if (application_.headless()) {
+      // There is nothing to acquire from, the offscreen images are simply
+      // used in turn.
+      image_idx = next_headless_image_;
+      next_headless_image_ =
+          (next_headless_image_ + 1) % swapchain_images_.size();
+    } else {
+      // The last frame of this slot has finished waiting on its semaphore, so
+      // it can be used for any later acquire.
+      if (slot.ready_semaphore_) {
+        free_semaphores_.push_back(std::move(slot.ready_semaphore_));
+      }
+      if (free_semaphores_.empty()) {
+        free_semaphores_.push_back(
+            containers::make_unique<vulkan::VkSemaphore>(
+                allocator_, vulkan::CreateSemaphore(&app()->device())));
+        ++num_semaphores_created_;
+      }
+      slot.ready_semaphore_ = std::move(free_semaphores_.back());
+      free_semaphores_.pop_back();
+
+      if (shared_image_acquired_) {
+        // The shared image stays acquired, and is scanned out continuously,
+        // so there is nothing to wait for but the last frame.
+        TRACE_ZONE("vkGetSwapchainStatusKHR");
+        image_idx = 0;
+        shared_present_semaphore = *slot.ready_semaphore_;
+        if (app()->device()->vkGetSwapchainStatusKHR(
+                app()->device(), app()->swapchain()) < VK_SUCCESS) {
+          LOG_CRASH(app()->GetLogger(),
+                    "The shared image can no longer be presented");
+        }
+      } else {
+        ready_semaphore = *slot.ready_semaphore_;
+        TRACE_ZONE("vkAcquireNextImageKHR");
+        const VkResult acquire_result = app()->device()->vkAcquireNextImageKHR(
+            app()->device(), app()->swapchain(), 0xFFFFFFFFFFFFFFFF,
+            ready_semaphore, static_cast<::VkFence>(VK_NULL_HANDLE),
+            &image_idx);
+        if (options_.resizable_swapchain &&
+            acquire_result == VK_ERROR_OUT_OF_DATE_KHR) {
+          // Nothing was acquired, so this frame is dropped. The fence of the
+          // slot is still signaled, and its semaphore was not used.
+          RecreateSwapchain();
+          return;
+        }
+        // A suboptimal image can still be presented, the swapchain is
+        // recreated after that.
+        if (options_.resizable_swapchain &&
+            acquire_result == VK_SUBOPTIMAL_KHR) {
+          swapchain_out_of_date_ = true;
+        } else {
+          LOG_ASSERT(==, app()->GetLogger(), VK_SUCCESS, acquire_result);
+        }
+        shared_image_acquired_ = options_.low_latency_presentation;
+      }
+    }
 
-    LOG_ASSERT(
-        ==, app()->GetLogger(), VK_SUCCESS,
-        app()->device()->vkWaitForFences(app()->device(), 1, &ready_fence,
-                                         VK_FALSE, 0xFFFFFFFFFFFFFFFF));
-    LOG_ASSERT(
-        ==, app()->GetLogger(), VK_SUCCESS,
-        app()->device()->vkResetFences(app()->device(), 1, &ready_fence));
+    // The per-image data may still be used by the last frame that rendered
+    // to this image, if that was with another slot.
+    // With timeline frame sync, frames never have to be reset, the values
+    // only grow.
+    const uint64_t frame_value = ++last_frame_value_;
+    slot.frame_value_ = frame_value;
+    if (frame_timeline_) {
+      WaitForFrameValue(image_values_[image_idx]);
+      image_values_[image_idx] = frame_value;
+      app()->PollImageReadbacks();
+    } else {
+      ::VkFence image_fence = image_fences_[image_idx];
+      if (image_fence != VK_NULL_HANDLE && image_fence != ready_fence) {
+        frame_wait_time_ += fence_waiter_->WaitForFence(image_fence);
+      }
+      image_fences_[image_idx] = ready_fence;
+      // Readbacks are keyed on the frame fences, so they have to be
+      // collected before the fence is reset.
+      app()->PollImageReadbacks();
+      LOG_ASSERT(
+          ==, app()->GetLogger(), VK_SUCCESS,
+          app()->device()->vkResetFences(app()->device(), 1, &ready_fence));
+    }
+    if ((options_.low_latency_presentation || options_.damage_tracking) &&
+        frame_data_[image_idx].presented_ &&
+        !frame_data_[image_idx].keeps_contents_) {
+      // The image has been presented, from now on every frame that renders
+      // to it starts with what the last one left in it.
+      frame_data_[image_idx].keeps_contents_ = true;
+      RecordSetupAndResolve(&frame_data_[image_idx], false);
+    }
+    if (transient_ring_buffer_) {
+      // Everything this frame allocated last time is done on the GPU.
+      transient_ring_buffer_->BeginFrame(image_idx);
+    }
+    // The transient descriptor sets of this image are no longer in use.
+    app()->descriptor_allocator().BeginFrame(image_idx);
+    // So are the command buffers that it got with GetFrameCommandBuffer.
+    app()->command_buffer_allocator().BeginFrame(image_idx);
+    // And the objects that were deleted with DeleteDeferred.
+    app()->deferred_deletion_queue().BeginFrame(image_idx);
+    if (parallel_recorder_) {
+      // The last frame of this slot is done, so are its command buffers.
+      parallel_recorder_->BeginFrame(slot_index);
+    }
+    if (gpu_profiler_) {
+      // The timestamps of the last frame of this slot are available.
+      gpu_profiler_->BeginFrame(slot_index);
+    }
+    if (options_.dynamic_resolution_budget > 0.0f) {
+      UpdateResolutionScale();
+      // The last frame of this image is done, so are its command buffers.
+      RecordSetupAndResolve(&frame_data_[image_idx], true);
+    }
+    // Images that were last used by the frames that are done may be evicted.
+    app()->BeginResidencyFrame(static_cast<uint32_t>(frames_in_flight()));
+    app()->PollMemoryBudget();
+    app()->ReleaseCompletedUploads();
+    // All of the buffer updates for the frame are submitted together with
+    // the setup command buffer.
+    buffer_update_batch_->BeginFrame(image_idx);
+    UpdateFrameBuffers(image_idx, &frame_data_[image_idx].child_data_);
+    vulkan::VkCommandBuffer* update_command_buffer =
+        buffer_update_batch_->End();
+    ::VkSemaphore compute_semaphore = VK_NULL_HANDLE;
+    vulkan::VkCommandBuffer* compute_acquire_command_buffer = nullptr;
+    vulkan::VkCommandBuffer* compute_release_command_buffer = nullptr;
+    if (options_.async_compute_stage) {
+      TRACE_ZONE("ComputeStage");
+      SubmitComputeStage(image_idx, &slot, &compute_semaphore,
+                         &compute_acquire_command_buffer,
+                         &compute_release_command_buffer);
+    }
     if (options_.verbose_output) {
       app()->GetLogger()->LogInfo("Rendering frame <", elapsed_time.count(),
                                   ">: <", image_idx, ">", " Average: <",
-                                  average_frame_time_, ">");
+                                  average_frame_time_, ">", " Semaphores: <",
+                                  num_semaphores_created_, ">");
     }
 
-    frame_data_[image_idx].ready_semaphore_ =
-        containers::make_unique<vulkan::VkSemaphore>(allocator_,
-                                                     std::move(temp_semaphore));
-    ::VkSemaphore ready_semaphore = *frame_data_[image_idx].ready_semaphore_;
-
     ::VkSemaphore render_wait_semaphore = ready_semaphore;
 
     VkPipelineStageFlags flags =
         VkPipelineStageFlags(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 
-    if (application_.HasSeparatePresentQueue()) {
-      render_wait_semaphore = *frame_data_[image_idx].transfer_semaphore_;
+    // With timeline frame sync, the hand-offs between the queues wait on
+    // frame_value instead of binary semaphores. The values of binary
+    // semaphores in the same submit are ignored.
+    const uint64_t timeline_values[3] = {frame_value, frame_value,
+                                         frame_value};
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info{
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,  // sType
+        nullptr,                                               // pNext
+        0,                // waitSemaphoreValueCount
+        timeline_values,  // pWaitSemaphoreValues
+        0,                // signalSemaphoreValueCount
+        timeline_values   // pSignalSemaphoreValues
+    };
+
+    if (TransfersSwapchainImages()) {
+      render_wait_semaphore = present_timeline_
+                                  ? *present_timeline_
+                                  : *frame_data_[image_idx].transfer_semaphore_;
       VkSubmitInfo transfer_submit_info{
           VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
           nullptr,                        // pNext
-          1,                              // waitSemaphoreCount
-          &ready_semaphore,               // pWaitSemaphores
-          &flags,                         // pWaitDstStageMask,
-          1,                              // commandBufferCount
+          ready_semaphore == VK_NULL_HANDLE ? 0u : 1u,  // waitSemaphoreCount
+          &ready_semaphore,                             // pWaitSemaphores
+          &flags,                                       // pWaitDstStageMask,
+          1,                                            // commandBufferCount
           &(frame_data_[image_idx]
                 .transfer_from_present_command_buffer_->get_command_buffer()),
           1,                      // signalSemaphoreCount
           &render_wait_semaphore  // pSignalSemaphores
       };
+      if (present_timeline_) {
+        timeline_info.waitSemaphoreValueCount =
+            transfer_submit_info.waitSemaphoreCount;
+        timeline_info.signalSemaphoreValueCount = 1;
+        transfer_submit_info.pNext = &timeline_info;
+      }
 
       app()->present_queue()->vkQueueSubmit(
           app()->present_queue(), 1, &transfer_submit_info,
           static_cast<::VkFence>(VK_NULL_HANDLE));
     }
 
-    VkSubmitInfo init_submit_info{
-        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-        nullptr,                        // pNext
-        1,                              // waitSemaphoreCount
-        &render_wait_semaphore,         // pWaitSemaphores
-        &flags,                         // pWaitDstStageMask,
-        1,                              // commandBufferCount
-        &(frame_data_[image_idx].setup_command_buffer_->get_command_buffer()),
-        0,       // signalSemaphoreCount
-        nullptr  // pSignalSemaphores
-    };
-
-    ::VkSemaphore present_ready_semaphore = render_wait_semaphore;
-    if (application_.HasSeparatePresentQueue()) {
+    ::VkSemaphore present_ready_semaphore =
+        shared_present_semaphore != VK_NULL_HANDLE ? shared_present_semaphore
+                                                   : render_wait_semaphore;
+    if (TransfersSwapchainImages()) {
       present_ready_semaphore = *frame_data_[image_idx].transfer_semaphore_;
     }
 
-    app()->render_queue()->vkQueueSubmit(
-        app()->render_queue(), 1, &init_submit_info,
-        static_cast<::VkFence>(VK_NULL_HANDLE));
+    frame_command_buffers_.clear();
+    frame_command_buffers_.push_back(
+        frame_data_[image_idx].setup_command_buffer_->get_command_buffer());
+    if (update_command_buffer) {
+      frame_command_buffers_.push_back(
+          update_command_buffer->get_command_buffer());
+    }
+    if (compute_acquire_command_buffer) {
+      frame_command_buffers_.push_back(
+          compute_acquire_command_buffer->get_command_buffer());
+    }
+    // Frames that did not acquire an image have nothing to wait for, but the
+    // compute stage and the input.
+    ::VkSemaphore frame_wait_semaphores[3];
+    VkPipelineStageFlags frame_wait_stages[3];
+    uint32_t num_frame_waits = 0;
+    if (!application_.headless() && render_wait_semaphore != VK_NULL_HANDLE) {
+      frame_wait_semaphores[num_frame_waits] = render_wait_semaphore;
+      frame_wait_stages[num_frame_waits++] = flags;
+    }
+    if (compute_semaphore != VK_NULL_HANDLE) {
+      frame_wait_semaphores[num_frame_waits] = compute_semaphore;
+      frame_wait_stages[num_frame_waits++] =
+          options_.compute_stage_wait_stages;
+    }
+    if (input_timeline_) {
+      // Submits are batched, so this holds back all of the frame.
+      frame_wait_semaphores[num_frame_waits] = *input_timeline_;
+      frame_wait_stages[num_frame_waits++] = options_.submit_ahead_wait_stages;
+    }
+    VkSubmitInfo frame_submit_info = kEmptySubmitInfo;
+    if (num_frame_waits) {
+      frame_submit_info.waitSemaphoreCount = num_frame_waits;
+      frame_submit_info.pWaitSemaphores = frame_wait_semaphores;
+      frame_submit_info.pWaitDstStageMask = frame_wait_stages;
+    }
+    if (!options_.batched_submits) {
+      // The application may submit to the render queue itself, so the setup
+      // has to be submitted before it renders.
+      frame_submit_info.commandBufferCount =
+          static_cast<uint32_t>(frame_command_buffers_.size());
+      frame_submit_info.pCommandBuffers = frame_command_buffers_.data();
+      if (frame_timeline_) {
+        timeline_info.waitSemaphoreValueCount =
+            frame_submit_info.waitSemaphoreCount;
+        timeline_info.signalSemaphoreValueCount = 0;
+        frame_submit_info.pNext = &timeline_info;
+      }
+      app()->render_queue()->vkQueueSubmit(
+          app()->render_queue(), 1, &frame_submit_info,
+          static_cast<::VkFence>(VK_NULL_HANDLE));
+      frame_command_buffers_.clear();
+      frame_submit_info.waitSemaphoreCount = 0;
+      frame_submit_info.pWaitSemaphores = nullptr;
+      frame_submit_info.pWaitDstStageMask = nullptr;
+    }
 
-    Render(&app()->render_queue(), image_idx,
-           &frame_data_[image_idx].child_data_);
-    init_submit_info.pCommandBuffers =
-        &(frame_data_[image_idx].resolve_command_buffer_->get_command_buffer());
+    {
+      TRACE_ZONE("Render");
+      Render(&app()->render_queue(), image_idx,
+             &frame_data_[image_idx].child_data_);
+    }
+    if (compute_release_command_buffer) {
+      frame_command_buffers_.push_back(
+          compute_release_command_buffer->get_command_buffer());
+    }
+    frame_command_buffers_.push_back(
+        frame_data_[image_idx].resolve_command_buffer_->get_command_buffer());
+    if (frame_capture_ &&
+        num_frames_processed_ >= data_->capture_first_frame() &&
+        num_frames_processed_ <= data_->capture_last_frame()) {
+      vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer(
+          app()->render_queue().index());
+      cmdBuffer->vkBeginCommandBuffer(cmdBuffer, &kBeginCommandBuffer);
+      frame_capture_->Capture(&cmdBuffer,
+                              frame_data_[image_idx].swapchain_image_,
+                              PresentLayout(),
+                              static_cast<uint32_t>(num_frames_processed_),
+                              slot_index);
+      cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+      frame_command_buffers_.push_back(cmdBuffer.get_command_buffer());
+    }
 
-    init_submit_info.waitSemaphoreCount = 0;
-    init_submit_info.pWaitSemaphores = nullptr;
-    init_submit_info.pWaitDstStageMask = nullptr;
-    init_submit_info.signalSemaphoreCount = 1;
-    init_submit_info.pSignalSemaphores = &present_ready_semaphore;
+    frame_submit_info.commandBufferCount =
+        static_cast<uint32_t>(frame_command_buffers_.size());
+    frame_submit_info.pCommandBuffers = frame_command_buffers_.data();
+    ::VkSemaphore frame_signal_semaphores[2] = {present_ready_semaphore};
+    if (!application_.headless()) {
+      frame_submit_info.signalSemaphoreCount = 1;
+      frame_submit_info.pSignalSemaphores = &present_ready_semaphore;
+    }
+    if (frame_timeline_) {
+      // The present queue waits on the frame value instead, if it is
+      // separate.
+      const uint32_t num_binary =
+          application_.headless() || TransfersSwapchainImages() ? 0 : 1;
+      frame_signal_semaphores[num_binary] = *frame_timeline_;
+      frame_submit_info.signalSemaphoreCount = num_binary + 1;
+      frame_submit_info.pSignalSemaphores = frame_signal_semaphores;
+      timeline_info.waitSemaphoreValueCount =
+          frame_submit_info.waitSemaphoreCount;
+      timeline_info.signalSemaphoreValueCount = num_binary + 1;
+      frame_submit_info.pNext = &timeline_info;
+    }
 
-    app()->render_queue()->vkQueueSubmit(
-        app()->render_queue(), 1, &init_submit_info, ::VkFence(ready_fence));
+    {
+      vulkan::QueueZone zone(&app()->render_queue(), app()->use_debug_utils(),
+                             "vkQueueSubmit");
+      app()->render_queue()->vkQueueSubmit(
+          app()->render_queue(), 1, &frame_submit_info,
+          ::VkFence(ready_fence));
+    }
+    if (gpu_profiler_) {
+      gpu_profiler_->MarkSubmit();
+    }
+    if (input_timeline_) {
+      TRACE_ZONE("LateUpdate");
+      // The input of the frame is only read now.
+      input_time_ns = static_cast<uint64_t>(trace::NowNanoseconds());
+      LateUpdate(image_idx, &frame_data_[image_idx].child_data_);
+      VkSemaphoreSignalInfoKHR signal_info = {
+          VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO_KHR,  // sType
+          nullptr,                                      // pNext
+          *input_timeline_,                             // semaphore
+          frame_value                                   // value
+      };
+      LOG_ASSERT(==, app()->GetLogger(), VK_SUCCESS,
+                 app()->device()->vkSignalSemaphoreKHR(app()->device(),
+                                                       &signal_info));
+    }
+    if (replay_counter_passes_ && measured_frame &&
+        num_frames_processed_ % kCounterReplayInterval == 0) {
+      TRACE_ZONE("CounterPasses");
+      ReplayCounterPasses(update_command_buffer);
+    }
 
-    if (application_.HasSeparatePresentQueue()) {
+    if (application_.headless()) {
+      // The first frame also measures initialization, so it is left out.
+      if (num_headless_frames_++ > 0) {
+        headless_frame_time_ += elapsed_time.count();
+      }
+      if (num_headless_frames_ == data_->headless_frames()) {
+        app()->GetLogger()->LogInfo(
+            "Rendered <", num_headless_frames_, "> headless frames,",
+            " average frame time: <",
+            num_headless_frames_ > 1
+                ? headless_frame_time_ / (num_headless_frames_ - 1)
+                : 0.0f,
+            ">");
+      }
+      trace::EndStartup(app()->GetLogger());
+      return;
+    }
+
+    if (TransfersSwapchainImages()) {
       ::VkSemaphore transfer_semaphore =
-          *frame_data_[image_idx].transfer_semaphore_;
-      present_ready_semaphore = render_wait_semaphore;
+          frame_timeline_ ? *frame_timeline_
+                          : *frame_data_[image_idx].transfer_semaphore_;
+      present_ready_semaphore = *frame_data_[image_idx].transfer_semaphore_;
       VkSubmitInfo transfer_submit_info{
           VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
           nullptr,                        // pNext
@@ -522,6 +1597,11 @@ class Sample {
           1,                        // signalSemaphoreCount
           &present_ready_semaphore  // pSignalSemaphores
       };
+      if (frame_timeline_) {
+        timeline_info.waitSemaphoreValueCount = 1;
+        timeline_info.signalSemaphoreValueCount = 1;
+        transfer_submit_info.pNext = &timeline_info;
+      }
 
       app()->present_queue()->vkQueueSubmit(
           app()->present_queue(), 1, &transfer_submit_info,
@@ -539,34 +1619,161 @@ class Sample {
         nullptr,                               // pResults
     };
 
-    VkPresentTimeGOOGLE ptime;
-    ptime.desiredPresentTime =
-        (current_time.time_since_epoch().count() + rc_dur.refreshDuration);
-    ptime.presentID = present_id++;
+    // Nothing changed if there is no damage, rather than everything, which
+    // is what a region without rectangles would mean.
+    const VkRectLayerKHR no_damage = {{0, 0}, {0, 0}, 0};
+    const bool damaged = num_frame_damage_rects_ > 0;
+    VkPresentRegionKHR damage_region = {
+        damaged ? num_frame_damage_rects_ : 1u,      // rectangleCount
+        damaged ? frame_damage_rects_ : &no_damage,  // pRectangles
+    };
+    VkPresentRegionsKHR present_regions = {
+        VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,  // sType
+        present_info.pNext,                     // pNext
+        present_info.swapchainCount,            // swapchainCount
+        &damage_region,                         // pRegions
+    };
+    if (options_.damage_tracking) {
+      present_info.pNext = &present_regions;
+    }
 
+    VkPresentTimeGOOGLE ptime;
     VkPresentTimesInfoGOOGLE present_time = {
         VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
         present_info.pNext,           // pNext
         present_info.swapchainCount,  // swapchainCount
         &ptime,                       // pTimes
     };
-
-	if (options_.enable_display_timing) {
+    if (frame_pacer_) {
+      frame_pacer_->GetPresentTime(&ptime, input_time_ns);
       present_info.pNext = &present_time;
     }
 
-    LOG_ASSERT(==, app()->GetLogger(),
-               app()->present_queue()->vkQueuePresentKHR(app()->present_queue(),
-                                                         &present_info),
-               VK_SUCCESS);
+    vulkan::QueueZone zone(&app()->present_queue(), app()->use_debug_utils(),
+                           "vkQueuePresentKHR");
+    const VkResult present_result = app()->present_queue()->vkQueuePresentKHR(
+        app()->present_queue(), &present_info);
+    // The semaphore wait of an out of date present still happens.
+    if (options_.resizable_swapchain &&
+        (present_result == VK_ERROR_OUT_OF_DATE_KHR ||
+         present_result == VK_SUBOPTIMAL_KHR)) {
+      swapchain_out_of_date_ = true;
+    } else {
+      LOG_ASSERT(==, app()->GetLogger(), present_result, VK_SUCCESS);
+    }
+    frame_data_[image_idx].presented_ = true;
+    frame_data_[image_idx].damage_ = {{0, 0}, {0, 0}};
+    if (measured_frame) {
+      std::chrono::duration<float> latency =
+          std::chrono::high_resolution_clock::now() - update_time;
+      present_latencies_.Record(latency.count());
+    }
+    if (swapchain_out_of_date_) {
+      RecreateSwapchain();
+    }
+    trace::EndStartup(app()->GetLogger());
+  }
+
+  ~Sample() {
+    WaitForUpdate();
+    if (frame_capture_) {
+      frame_capture_->Finish();
+    }
+    if (data_->stats_file()) {
+      frame_times_.WriteStatistics(data_->stats_file(), kFrameTimeBudget,
+                                   app()->GetLogger());
+    }
+    if (gpu_profiler_ && data_->benchmark_frames() == 0) {
+      gpu_profiler_->LogStatistics(app()->GetLogger());
+    }
+    if (frame_pacer_ && data_->benchmark_frames() == 0) {
+      frame_pacer_->LogStatistics("PACING:", app()->GetLogger());
+    }
+    if (thermal_limiter_ && data_->benchmark_frames() == 0) {
+      thermal_limiter_->LogStatistics("THERMAL:", app()->GetLogger());
+    }
+    if (options_.low_latency_presentation && data_->benchmark_frames() == 0) {
+      present_latencies_.LogStatistics("LATENCY:", 0.0f, app()->GetLogger());
+    }
+    if (fence_wait_times_.num_recorded() > 0 &&
+        data_->benchmark_frames() == 0) {
+      fence_wait_times_.LogStatistics("FENCE_WAIT:", kGpuBoundWaitTime,
+                                      app()->GetLogger());
+    }
+    if (api_call_stats_ && data_->count_api_calls() &&
+        data_->benchmark_frames() == 0) {
+      api_call_stats_->LogStatistics("API_CALLS:", app()->GetLogger());
+    }
+    if (allocation_audit_ && data_->benchmark_frames() == 0) {
+      allocation_audit_->LogSummary("ALLOCATION_AUDIT:");
+    }
+    if (data_->trace_file()) {
+      trace::Stop(data_->trace_file(), app()->GetLogger());
+    }
   }
 
   void set_invalid(bool invaid) { is_valid_ = false; }
   const bool is_valid() { return is_valid_; }
 
-  bool should_exit() const { return app()->should_exit(); }
+  // In headless mode with a frame count, this is also true once that many
+  // frames have been rendered, and in benchmark mode once all of the
+  // benchmark frames have been measured.
+  bool should_exit() const {
+    return app()->should_exit() ||
+           (application_.headless() && data_->headless_frames() > 0 &&
+            num_headless_frames_ >= data_->headless_frames()) ||
+           (data_->benchmark_frames() > 0 &&
+            frame_times_.num_recorded() >= data_->benchmark_frames()) ||
+           (frame_capture_ &&
+            num_frames_processed_ >= data_->capture_last_frame());
+  }
 
  private:
+  static bool HasExtension(const std::initializer_list<const char*>& extensions,
+                           const char* name) {
+    for (const char* extension : extensions) {
+      if (strcmp(extension, name) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Submits the command buffers of the frame that was just submitted again,
+  // once for every other pass of the performance counters, but for the
+  // one-time |update_command_buffer|. The frame has finished afterwards.
+  void ReplayCounterPasses(vulkan::VkCommandBuffer* update_command_buffer) {
+    containers::vector<::VkCommandBuffer> command_buffers(allocator_);
+    for (::VkCommandBuffer command_buffer : frame_command_buffers_) {
+      if (!update_command_buffer ||
+          command_buffer != update_command_buffer->get_command_buffer()) {
+        command_buffers.push_back(command_buffer);
+      }
+    }
+    app()->render_queue()->vkQueueWaitIdle(app()->render_queue());
+    for (uint32_t pass = 1; pass < gpu_profiler_->num_counter_passes();
+         ++pass) {
+      const VkPerformanceQuerySubmitInfoKHR pass_info =
+          gpu_profiler_->BeginCounterPass(pass);
+      VkSubmitInfo submit_info = kEmptySubmitInfo;
+      submit_info.pNext = &pass_info;
+      submit_info.commandBufferCount =
+          static_cast<uint32_t>(command_buffers.size());
+      submit_info.pCommandBuffers = command_buffers.data();
+      app()->render_queue()->vkQueueSubmit(
+          app()->render_queue(), 1, &submit_info,
+          static_cast<::VkFence>(VK_NULL_HANDLE));
+      app()->render_queue()->vkQueueWaitIdle(app()->render_queue());
+    }
+  }
+
+  // Waits until frame_timeline_ has reached |value|, and adds the time
+  // that took to the waits of this frame.
+  void WaitForFrameValue(uint64_t value) {
+    frame_wait_time_ +=
+        fence_waiter_->WaitForSemaphoreValue(*frame_timeline_, value);
+  }
+
   const size_t sample_frame_data_offset =
       reinterpret_cast<size_t>(
           &(reinterpret_cast<SampleFrameData*>(4096)->child_data_)) -
@@ -585,6 +1792,23 @@ class Sample {
     return base->image_view->get_raw_object();
   }
 
+  // Describe color_view() and depth_view() for
+  // VulkanApplication::framebuffer_cache(). With imageless framebuffers,
+  // the framebuffers of every frame are the same.
+  const vulkan::FramebufferCache::Attachment& color_attachment(
+      FrameData* data) {
+    SampleFrameData* base = reinterpret_cast<SampleFrameData*>(
+        reinterpret_cast<uint8_t*>(data) - sample_frame_data_offset);
+    return base->color_attachment_;
+  }
+
+  const vulkan::FramebufferCache::Attachment& depth_attachment(
+      FrameData* data) {
+    SampleFrameData* base = reinterpret_cast<SampleFrameData*>(
+        reinterpret_cast<uint8_t*>(data) - sample_frame_data_offset);
+    return base->depth_attachment_;
+  }
+
   const ::VkImage& swapchain_image(FrameData* data) {
     SampleFrameData* base = reinterpret_cast<SampleFrameData*>(
         reinterpret_cast<uint8_t*>(data) - sample_frame_data_offset);
@@ -619,11 +1843,152 @@ class Sample {
   // frame-specific data.
   virtual void Update(float time_since_last_render) = 0;
 
+  // Will be called once the frame <frame_index> is known, before Render().
+  // BufferFrameData that is updated here with buffer_update_batch() is
+  // copied by a single command buffer that is submitted together with the
+  // frame's setup commands, instead of one submission per buffer. By
+  // default it updates every BufferFrameData given to
+  // UpdateBufferEveryFrame(), so only applications that do more than that
+  // need to override it.
+  virtual void UpdateFrameBuffers(size_t frame_index, FrameData* data) {
+    for (const EveryFrameBuffer& buffer : every_frame_buffers_) {
+      buffer.update(buffer.data, buffer_update_batch(),
+                    &application_.render_queue(), frame_index);
+    }
+  }
+
+  // With SampleOptions::EnableSubmitAhead, will be called once the frame
+  // <frame_index> has been submitted, right before the GPU is allowed to
+  // run it. The application is expected to read its latest input here, and
+  // write what depends on it into the host-visible memory of the frame.
+  virtual void LateUpdate(size_t frame_index, FrameData* data) {}
+
   // Will be called to instruct the application to enqueue the necessary
-  // commands for rendering frame <frame_index> into the provided queue
+  // commands for rendering frame <frame_index> into the provided queue.
+  // Command buffers added with AddFrameCommandBuffer() are submitted
+  // together with the framework's own, which is cheaper than submitting
+  // them one by one.
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       FrameData* data) = 0;
 
+  // With SampleOptions::EnableAsyncComputeStage, will be called before
+  // Render() to record the compute work of frame <frame_index> into
+  // |command_buffer|, which is already begun. It runs before the buffer
+  // updates of UpdateFrameBuffers(), so it can not read what they copy, and
+  // must only write to the data of <frame_index>, since the previous frames
+  // may still be rendering.
+  virtual void RecordComputeStage(vulkan::VkCommandBuffer* command_buffer,
+                                  size_t frame_index, FrameData* data) {}
+
+  // With SampleOptions::EnableResizableSwapchain, will be called once the
+  // swapchain was recreated, while the device is idle, and before
+  // InitializeFrameData() is called again for every image. The application
+  // is expected to update any non frame-specific data that depends on the
+  // size of the swapchain here.
+  virtual void SwapchainRecreated(
+      vulkan::VkCommandBuffer* initialization_buffer) {}
+
+  // Sets the HDR10 metadata of the swapchain, with
+  // SampleOptions::Enable10BitHDR.
+  void SetHdrMetadata() {
+    if (!options_.enable_10bit_hdr || application_.headless()) {
+      return;
+    }
+    VkHdrMetadataEXT hdr10_metadata{
+        VK_STRUCTURE_TYPE_HDR_METADATA_EXT,
+        nullptr,             // pNext;
+        {0.708f, 0.292f},    // displayPrimaryRed;
+        {0.17f, 0.797f},     // displayPrimaryGreen;
+        {0.131f, 0.046f},    // displayPrimaryBlue;
+        {0.3127f, 0.329f},   // whitePoint;
+        1000.0f * 10000.0f,  // maxLuminance;
+        0.001 * 10000.0f,    // minLuminance;
+        2000.0f,             // maxContentLightLevel;
+        500.0f               // maxFrameAverageLightLevel;
+    };
+
+    application_.device()->vkSetHdrMetadataEXT(
+        application_.device(), 1, &application_.swapchain().get_raw_object(),
+        &hdr10_metadata);
+  }
+
+  // Creates the SampleFrameData of every swapchain image.
+  void InitializeSwapchainFrameData(
+      vulkan::VkCommandBuffer* initialization_buffer) {
+    for (size_t i = 0; i < swapchain_images_.size(); ++i) {
+      frame_data_.push_back(SampleFrameData());
+      // Nothing has been rendered to the image yet.
+      frame_data_.back().damage_ = default_scissor_;
+      InitializeLocalFrameData(&frame_data_.back(), initialization_buffer, i);
+    }
+  }
+
+  // Ends |initialization_buffer|, submits it to the render queue and waits
+  // for it to complete.
+  void SubmitInitializationCommands(
+      vulkan::VkCommandBuffer* initialization_buffer) {
+    (*initialization_buffer)->vkEndCommandBuffer(*initialization_buffer);
+
+    VkSubmitInfo submit_info = kEmptySubmitInfo;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers =
+        &(initialization_buffer->get_command_buffer());
+
+    vulkan::VkFence init_fence = vulkan::CreateFence(&application_.device());
+
+    application_.render_queue()->vkQueueSubmit(application_.render_queue(), 1,
+                                               &submit_info,
+                                               init_fence.get_raw_object());
+    fence_waiter_->WaitForFence(init_fence.get_raw_object());
+  }
+
+  // Recreates the swapchain once nothing is in flight anymore, and rebuilds
+  // the frame data, which is all that depends on it. If the surface has no
+  // area, the old swapchain is kept and this is tried again after the next
+  // present.
+  void RecreateSwapchain() {
+    TRACE_ZONE("RecreateSwapchain");
+    WaitIdle();
+    const size_t num_images = swapchain_images_.size();
+    const uint32_t old_width = application_.swapchain().width();
+    const uint32_t old_height = application_.swapchain().height();
+    if (!application_.RecreateSwapchain()) {
+      swapchain_out_of_date_ = true;
+      return;
+    }
+    swapchain_out_of_date_ = false;
+    // The per-image data of the frame buffers, ring buffers and descriptor
+    // sets was all sized for this many images.
+    LOG_ASSERT(==, app()->GetLogger(), num_images, swapchain_images_.size());
+    const uint32_t width = application_.swapchain().width();
+    const uint32_t height = application_.swapchain().height();
+    // With dynamic resolution, UpdateResolutionScale() scales these down
+    // again with the next frame.
+    default_viewport_.width = static_cast<float>(width);
+    default_viewport_.height = static_cast<float>(height);
+    default_scissor_.extent = {width, height};
+    if (frame_capture_ && (width != old_width || height != old_height)) {
+      app()->GetLogger()->LogError(
+          "-output-frames stops capturing at a swapchain resize");
+      frame_capture_->Finish();
+      frame_capture_.reset();
+    }
+    // Nothing is in flight, and nothing has been acquired from the new
+    // swapchain.
+    std::fill(image_fences_.begin(), image_fences_.end(),
+              static_cast<::VkFence>(VK_NULL_HANDLE));
+    shared_image_acquired_ = false;
+    SetHdrMetadata();
+
+    vulkan::VkCommandBuffer initialization_buffer = app()->GetCommandBuffer();
+    initialization_buffer->vkBeginCommandBuffer(initialization_buffer,
+                                                &kBeginCommandBuffer);
+    SwapchainRecreated(&initialization_buffer);
+    frame_data_.clear();
+    InitializeSwapchainFrameData(&initialization_buffer);
+    SubmitInitializationCommands(&initialization_buffer);
+  }
+
   // This initializes the per-frame data for the sample application framework.
   //  This is equivalent to the InitializeFrameData(), except this handles
   //  all of the under-the-hood data that the application itself should not
@@ -633,19 +1998,13 @@ class Sample {
                                 size_t frame_index) {
     data->swapchain_image_ = swapchain_images_[frame_index];
 
-    data->ready_semaphore_ = containers::make_unique<vulkan::VkSemaphore>(
-        allocator_, vulkan::CreateSemaphore(&application_.device()));
-
-    data->ready_fence_ = containers::make_unique<vulkan::VkFence>(
-        allocator_, vulkan::CreateFence(&application_.device()));
-
     VkImageCreateInfo image_create_info{
         /* sType = */
         VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         /* pNext = */ nullptr,
         /* flags = */ 0,
         /* imageType = */ VK_IMAGE_TYPE_2D,
-        /* format = */ kDepthFormat,
+        /* format = */ options_.depth_buffer_format,
         /* extent = */
         {
             /* width = */ application_.swapchain().width(),
@@ -675,10 +2034,10 @@ class Sample {
         0,                                         // flags
         VK_NULL_HANDLE,                            // image
         VK_IMAGE_VIEW_TYPE_2D,                     // viewType
-        kDepthFormat,                              // format
+        options_.depth_buffer_format,              // format
         {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
          VK_COMPONENT_SWIZZLE_A},
-        {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1}};
+        {depth_aspects(), 0, 1, 0, 1}};
 
     ::VkImageView raw_view;
 
@@ -686,6 +2045,14 @@ class Sample {
       if (options_.enable_mixed_multisampling) {
         image_create_info.samples = num_depth_stencil_samples_;
       }
+      if (options_.transient_attachments) {
+        // Transient attachments may only be used as attachments.
+        image_create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      } else if (options_.sampled_depth_buffer) {
+        image_create_info.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+      }
 
       data->depth_stencil_ =
           application_.CreateAndBindImage(&image_create_info);
@@ -698,6 +2065,17 @@ class Sample {
       data->depth_view_ = containers::make_unique<vulkan::VkImageView>(
           allocator_,
           vulkan::VkImageView(raw_view, nullptr, &application_.device()));
+      data->depth_attachment_ = {
+          raw_view,                            // view
+          options_.depth_buffer_format,        // format
+          image_create_info.usage,             // usage
+          image_create_info.flags,             // flags
+          image_create_info.extent.width,      // width
+          image_create_info.extent.height,     // height
+          image_create_info.arrayLayers,       // layer_count
+          0,                                   // num_view_formats
+          nullptr,                             // view_formats
+      };
 
       if (options_.enable_mixed_multisampling) {
         image_create_info.samples = num_samples_;
@@ -713,10 +2091,20 @@ class Sample {
           application_.CreateAndBindImage(&image_create_info);
     }
 
-    view_create_info.image =
-		(options_.enable_multisampling && !options_.enable_mixed_multisampling)
-                                 ? *data->multisampled_target_
-                                 : data->swapchain_image_;
+    if (options_.dynamic_resolution_budget > 0.0f) {
+      image_create_info.format = render_target_format_;
+      image_create_info.usage =
+          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      if (options_.mutable_swapchain_format) {
+        // Like the swapchain images, it is viewed as sRGB.
+        image_create_info.pNext = &kMutableSwapchainImageFormatList;
+        image_create_info.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+      }
+      data->scaled_target_ =
+          application_.CreateAndBindImage(&image_create_info);
+    }
+
+    view_create_info.image = RenderTarget(data);
     view_create_info.format = options_.mutable_swapchain_format
                                   ? VK_FORMAT_B8G8R8A8_SRGB
                                   : render_target_format_;
@@ -729,6 +2117,33 @@ class Sample {
     data->image_view = containers::make_unique<vulkan::VkImageView>(
         allocator_,
         vulkan::VkImageView(raw_view, nullptr, &application_.device()));
+    // The swapchain images of a mutable format swapchain are created with
+    // both flags, and its format list.
+    const bool swapchain_target = RenderTarget(data) == data->swapchain_image_;
+    const bool mutable_target =
+        options_.mutable_swapchain_format &&
+        (options_.dynamic_resolution_budget > 0.0f ||
+         (swapchain_target && !application_.headless()));
+    data->color_attachment_ = {
+        raw_view,                 // view
+        view_create_info.format,  // format
+        swapchain_target ? application_.swapchain().usage()
+                         : image_create_info.usage,  // usage
+        !mutable_target ? 0u
+        : swapchain_target
+            ? static_cast<VkImageCreateFlags>(
+                  VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT |
+                  VK_IMAGE_CREATE_EXTENDED_USAGE_BIT)
+            : static_cast<VkImageCreateFlags>(
+                  VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT),  // flags
+        application_.swapchain().width(),               // width
+        application_.swapchain().height(),              // height
+        1,                                              // layer_count
+        mutable_target ? kMutableSwapchainImageFormatList.viewFormatCount
+                       : 0u,  // num_view_formats
+        mutable_target ? kMutableSwapchainImageFormatList.pViewFormats
+                       : nullptr,  // view_formats
+    };
 
     VkImageMemoryBarrier barriers[2] = {
         {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,            // sType
@@ -742,7 +2157,7 @@ class Sample {
          options_.enable_depth_buffer
              ? static_cast<::VkImage>(*data->depth_stencil_)
              : static_cast<::VkImage>(VK_NULL_HANDLE),  // image
-         {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1}},
+         {depth_aspects(), 0, 1, 0, 1}},
         {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,    // sType
          nullptr,                                   // pNext
          0,                                         // srcAccessMask
@@ -751,9 +2166,7 @@ class Sample {
          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // newLayout
          VK_QUEUE_FAMILY_IGNORED,                   // srcQueueFamilyIndex
          VK_QUEUE_FAMILY_IGNORED,                   // dstQueueFamilyIndex
-         (options_.enable_multisampling && !options_.enable_mixed_multisampling)
-             ? *data->multisampled_target_
-		     : data->swapchain_image_,  // image
+         RenderTarget(data),                        // image
          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}}};
 
     (*initialization_buffer)
@@ -765,7 +2178,7 @@ class Sample {
 
     uint32_t srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    if (application_.HasSeparatePresentQueue()) {
+    if (TransfersSwapchainImages()) {
       data->transfer_semaphore_ = containers::make_unique<vulkan::VkSemaphore>(
           allocator_, vulkan::CreateSemaphore(&application_.device()));
       srcQueueFamilyIndex = application_.present_queue().index();
@@ -807,40 +2220,275 @@ class Sample {
           containers::make_unique<vulkan::VkCommandBuffer>(
               allocator_, app()->GetCommandBuffer());
 
-      (*data->transfer_from_graphics_command_buffer_)
-          ->vkBeginCommandBuffer((*data->setup_command_buffer_),
-                                 &kBeginCommandBuffer);
+      vulkan::VkCommandBuffer& transfer_from_graphics =
+          *data->transfer_from_graphics_command_buffer_;
+      transfer_from_graphics->vkBeginCommandBuffer(transfer_from_graphics,
+                                                   &kBeginCommandBuffer);
+      transfer_from_graphics->vkCmdPipelineBarrier(
+          transfer_from_graphics, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0,
+          nullptr, 1, &barrier);
+      transfer_from_graphics->vkEndCommandBuffer(transfer_from_graphics);
+    }
 
-      (*data->transfer_from_graphics_command_buffer_)
-          ->vkCmdPipelineBarrier((*data->setup_command_buffer_),
-                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
-      (*data->transfer_from_graphics_command_buffer_)
-          ->vkEndCommandBuffer(*data->setup_command_buffer_);
+    data->setup_command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            allocator_, app()->GetCommandBuffer());
+    data->resolve_command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            allocator_, app()->GetCommandBuffer());
+    RecordSetupAndResolve(data, false);
+
+    InitializeFrameData(&data->child_data_, initialization_buffer, frame_index);
+  }
+
+  // Moves resolution_scale_ towards the scale at which the frames would
+  // take the dynamic resolution budget on the GPU, and updates the viewport
+  // and scissor to match.
+  void UpdateResolutionScale() {
+    // Replayed sessions scale the same way as the recorded one.
+    const float gpu_time = data_->SessionValue(
+        "dynamic_resolution_gpu_time",
+        gpu_profiler_->GetLastZoneTime(kDynamicResolutionZone));
+    const float budget = options_.dynamic_resolution_budget;
+    // Within 15% under budget the scale is left alone, so it does not
+    // oscillate around the budget.
+    if (gpu_time > 0.0f && (gpu_time > budget || gpu_time < budget * 0.85f)) {
+      // The GPU time is roughly proportional to the number of pixels. The
+      // frames in flight were measured at older scales, so the scale only
+      // moves part of the way every frame.
+      const float target = std::min(
+          1.0f, std::max(options_.dynamic_resolution_min_scale,
+                         resolution_scale_ *
+                             std::sqrt(budget * 0.925f / gpu_time)));
+      resolution_scale_ += (target - resolution_scale_) * 0.25f;
     }
+    const uint32_t width = std::max(
+        1u, static_cast<uint32_t>(application_.swapchain().width() *
+                                  resolution_scale_));
+    const uint32_t height = std::max(
+        1u, static_cast<uint32_t>(application_.swapchain().height() *
+                                  resolution_scale_));
+    default_viewport_.width = static_cast<float>(width);
+    default_viewport_.height = static_cast<float>(height);
+    default_scissor_.extent = {width, height};
+  }
+
+  // Records the compute stage of |frame_index| and, with an async compute
+  // queue, submits it there, signaling the compute semaphore of |slot|,
+  // which is returned in |wait_semaphore|. Returns the command buffers that
+  // the render queue has to run before and after the graphics work of the
+  // frame in |acquire_command_buffer| and |release_command_buffer|. They
+  // move the ownership of the compute stage buffers between the queue
+  // families, or hold the compute stage itself if there is no async compute
+  // queue, and may be nullptr.
+  void SubmitComputeStage(size_t frame_index, FrameSlot* slot,
+                          ::VkSemaphore* wait_semaphore,
+                          vulkan::VkCommandBuffer** acquire_command_buffer,
+                          vulkan::VkCommandBuffer** release_command_buffer) {
+    const VkAccessFlags kComputeAccess =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    const VkAccessFlags kGraphicsReadAccess =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+        VK_ACCESS_SHADER_READ_BIT;
+    const VkPipelineStageFlags wait_stages =
+        options_.compute_stage_wait_stages;
+    SampleFrameData& data = frame_data_[frame_index];
+    vulkan::VkQueue* compute_queue = app()->async_compute_queue();
+    const uint32_t render_family = app()->render_queue().index();
+    const uint32_t compute_family =
+        compute_queue ? compute_queue->index() : render_family;
+    const bool transfer_ownership = compute_family != render_family &&
+                                    data.num_compute_buffers_ > 0 &&
+                                    !options_.concurrent_sharing;
+    *wait_semaphore = VK_NULL_HANDLE;
+    *acquire_command_buffer = nullptr;
+    *release_command_buffer = nullptr;
+
+    VkBufferMemoryBarrier barriers[kMaxComputeStageBuffers];
+    auto set_barriers = [&](VkAccessFlags src_access, VkAccessFlags dst_access,
+                            uint32_t src_family, uint32_t dst_family) {
+      for (uint32_t i = 0; i < data.num_compute_buffers_; ++i) {
+        barriers[i] = {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            src_access,                               // srcAccessMask
+            dst_access,                               // dstAccessMask
+            src_family,                               // srcQueueFamilyIndex
+            dst_family,                               // dstQueueFamilyIndex
+            data.compute_buffers_[i],                 // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        };
+      }
+    };
+
+    vulkan::VkCommandBuffer& cmd =
+        *app()->GetFrameCommandBuffer(compute_family);
+    cmd->vkBeginCommandBuffer(cmd, &kBeginCommandBuffer);
+    // The buffers were released by the last graphics work that read them,
+    // which the host already waited for.
+    if (transfer_ownership && data.compute_buffers_released_) {
+      set_barriers(0, kComputeAccess, render_family, compute_family);
+      cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                                nullptr, data.num_compute_buffers_, barriers,
+                                0, nullptr);
+    }
+    RecordComputeStage(&cmd, frame_index, &data.child_data_);
+    if (transfer_ownership) {
+      set_barriers(VK_ACCESS_SHADER_WRITE_BIT, 0, compute_family,
+                   render_family);
+      cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                                nullptr, data.num_compute_buffers_, barriers,
+                                0, nullptr);
+    } else if (!compute_queue) {
+      VkMemoryBarrier barrier{
+          VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+          nullptr,                           // pNext
+          VK_ACCESS_SHADER_WRITE_BIT,        // srcAccessMask
+          kGraphicsReadAccess,               // dstAccessMask
+      };
+      cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                wait_stages, 0, 1, &barrier, 0, nullptr, 0,
+                                nullptr);
+    }
+    cmd->vkEndCommandBuffer(cmd);
+
+    if (!compute_queue) {
+      // The render queue runs the compute stage in order with the rest of
+      // the frame.
+      *acquire_command_buffer = &cmd;
+      return;
+    }
+    ::VkSemaphore semaphore = *slot->compute_semaphore_;
+    VkSubmitInfo submit_info = kEmptySubmitInfo;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd.get_command_buffer();
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &semaphore;
+    vulkan::BeginQueueLabel(compute_queue, app()->use_debug_utils(),
+                            "ComputeStage");
+    (*compute_queue)
+        ->vkQueueSubmit(*compute_queue, 1, &submit_info,
+                        static_cast<::VkFence>(VK_NULL_HANDLE));
+    vulkan::EndQueueLabel(compute_queue, app()->use_debug_utils());
+    *wait_semaphore = semaphore;
+    if (!transfer_ownership) {
+      return;
+    }
+
+    vulkan::VkCommandBuffer& acquire =
+        *app()->GetFrameCommandBuffer(render_family);
+    acquire->vkBeginCommandBuffer(acquire, &kBeginCommandBuffer);
+    set_barriers(0, kGraphicsReadAccess, compute_family, render_family);
+    acquire->vkCmdPipelineBarrier(acquire, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                  wait_stages, 0, 0, nullptr,
+                                  data.num_compute_buffers_, barriers, 0,
+                                  nullptr);
+    acquire->vkEndCommandBuffer(acquire);
+    *acquire_command_buffer = &acquire;
+
+    vulkan::VkCommandBuffer& release =
+        *app()->GetFrameCommandBuffer(render_family);
+    release->vkBeginCommandBuffer(release, &kBeginCommandBuffer);
+    set_barriers(0, 0, render_family, compute_family);
+    release->vkCmdPipelineBarrier(release, wait_stages,
+                                  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                                  nullptr, data.num_compute_buffers_, barriers,
+                                  0, nullptr);
+    release->vkEndCommandBuffer(release);
+    *release_command_buffer = &release;
+    data.compute_buffers_released_ = true;
+  }
+
+  // Returns the bounds of |a| and |b|, either of which may be empty.
+  static VkRect2D UnionRect(const VkRect2D& a, const VkRect2D& b) {
+    if (a.extent.width == 0 || a.extent.height == 0) {
+      return b;
+    }
+    if (b.extent.width == 0 || b.extent.height == 0) {
+      return a;
+    }
+    const int32_t x0 = std::min(a.offset.x, b.offset.x);
+    const int32_t y0 = std::min(a.offset.y, b.offset.y);
+    const int32_t x1 =
+        std::max(a.offset.x + static_cast<int32_t>(a.extent.width),
+                 b.offset.x + static_cast<int32_t>(b.extent.width));
+    const int32_t y1 =
+        std::max(a.offset.y + static_cast<int32_t>(a.extent.height),
+                 b.offset.y + static_cast<int32_t>(b.extent.height));
+    return {{x0, y0},
+            {static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}};
+  }
+  static VkRectLayerKHR DamageRect(const VkRect2D& rect) {
+    return {rect.offset, rect.extent, 0};
+  }
+  static VkRect2D ScissorRect(const VkRectLayerKHR& rect) {
+    return {rect.offset, rect.extent};
+  }
+
+  // Returns the layout that the swapchain images are presented in. A shared
+  // presentable image has to be presented in
+  // VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR, which also keeps its contents.
+  VkImageLayout PresentLayout() const {
+    return options_.shared_presentation ? VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR
+                                        : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  }
+
+  // Returns the image that the application renders to for |data|.
+  ::VkImage RenderTarget(SampleFrameData* data) {
+    if (options_.enable_multisampling && !options_.enable_mixed_multisampling) {
+      return *data->multisampled_target_;
+    }
+    if (options_.dynamic_resolution_budget > 0.0f) {
+      return *data->scaled_target_;
+    }
+    return data->swapchain_image_;
+  }
+
+  // Records the setup and resolve command buffers of |data|. With dynamic
+  // resolution this happens every frame, for the current scale, and with
+  // |measure_frame| they also measure the frame as a GPU zone.
+  void RecordSetupAndResolve(SampleFrameData* data, bool measure_frame) {
+    uint32_t srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    if (TransfersSwapchainImages()) {
+      srcQueueFamilyIndex = application_.present_queue().index();
+      dstQueueFamilyIndex = application_.render_queue().index();
+    }
+    const ::VkImage render_target = RenderTarget(data);
+    const bool dynamic_resolution = options_.dynamic_resolution_budget > 0.0f;
+    measure_frame &= dynamic_resolution;
+
+    const VkImageLayout present_layout = PresentLayout();
+    const VkImageLayout initial_layout =
+        data->keeps_contents_ && render_target == data->swapchain_image_
+            ? present_layout
+            : VK_IMAGE_LAYOUT_UNDEFINED;
 
     VkImageMemoryBarrier barrier = {
         VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,    // sType
         nullptr,                                   // pNext
         0,                                         // srcAccessMask
         VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,      // dstAccessMask
-        VK_IMAGE_LAYOUT_UNDEFINED,                 // oldLayout
+        initial_layout,                            // oldLayout
         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // newLayout
         srcQueueFamilyIndex,                       // srcQueueFamilyIndex
         dstQueueFamilyIndex,                       // dstQueueFamilyIndex
-        (options_.enable_multisampling && !options_.enable_mixed_multisampling)
-            ? *data->multisampled_target_
-		    : data->swapchain_image_,  // image
+        render_target,                             // image
         {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
-    data->setup_command_buffer_ =
-        containers::make_unique<vulkan::VkCommandBuffer>(
-            allocator_, app()->GetCommandBuffer());
-
     (*data->setup_command_buffer_)
         ->vkBeginCommandBuffer((*data->setup_command_buffer_),
                                &kBeginCommandBuffer);
+    uint32_t frame_zone = 0xFFFFFFFF;
+    if (measure_frame) {
+      frame_zone = gpu_profiler_->BeginZone(data->setup_command_buffer_.get(),
+                                            kDynamicResolutionZone, false);
+    }
 
     (*data->setup_command_buffer_)
         ->vkCmdPipelineBarrier((*data->setup_command_buffer_),
@@ -850,16 +2498,12 @@ class Sample {
     (*data->setup_command_buffer_)
         ->vkEndCommandBuffer(*data->setup_command_buffer_);
 
-    data->resolve_command_buffer_ =
-        containers::make_unique<vulkan::VkCommandBuffer>(
-            allocator_, app()->GetCommandBuffer());
-
     (*data->resolve_command_buffer_)
         ->vkBeginCommandBuffer((*data->resolve_command_buffer_),
                                &kBeginCommandBuffer);
     VkImageLayout old_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     VkAccessFlags old_access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    if (options_.enable_multisampling && !options_.enable_mixed_multisampling) {
+    if (render_target != data->swapchain_image_) {
       old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
       old_access = VK_ACCESS_TRANSFER_WRITE_BIT;
       VkImageMemoryBarrier resolve_barrier[2] = {
@@ -871,7 +2515,7 @@ class Sample {
            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,      // newLayout
            VK_QUEUE_FAMILY_IGNORED,                   // srcQueueFamilyIndex
            VK_QUEUE_FAMILY_IGNORED,                   // dstQueueFamilyIndex
-           *data->multisampled_target_,               // image
+           render_target,                             // image
            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}},
           {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
            nullptr,                                 // pNext
@@ -888,40 +2532,71 @@ class Sample {
                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                                  VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
                                  0, nullptr, 2, resolve_barrier);
-      VkImageResolve region = {
-          {
-              VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
-              0,                          // mipLevel
-              0,                          // baseArrayLayer
-              1,                          // layerCount
-          },                              // srcSubresource
-          {
-              0,  // x
-              0,  // y
-              0   // z
-          },      // srcOffset
-          {
-              VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
-              0,                          // mipLevel
-              0,                          // baseArrayLayer
-              1,                          // layerCount
-          },                              // dstSubresource
-          {
-              0,  // x
-              0,  // y
-              0   // z
-          },      // dstOffset
-          {
-              app()->swapchain().width(),   // width
-              app()->swapchain().height(),  // height
-              1                             // depth
-          }                                 // extent
-      };
-      (*data->resolve_command_buffer_)
-          ->vkCmdResolveImage(
-              (*data->resolve_command_buffer_), *data->multisampled_target_,
-              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data->swapchain_image_,
-              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+      if (dynamic_resolution) {
+        const VkImageBlit region = {
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+                0,                          // mipLevel
+                0,                          // baseArrayLayer
+                1,                          // layerCount
+            },                              // srcSubresource
+            {{0, 0, 0},
+             {static_cast<int32_t>(default_scissor_.extent.width),
+              static_cast<int32_t>(default_scissor_.extent.height),
+              1}},  // srcOffsets
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+                0,                          // mipLevel
+                0,                          // baseArrayLayer
+                1,                          // layerCount
+            },                              // dstSubresource
+            {{0, 0, 0},
+             {static_cast<int32_t>(app()->swapchain().width()),
+              static_cast<int32_t>(app()->swapchain().height()),
+              1}}  // dstOffsets
+        };
+        (*data->resolve_command_buffer_)
+            ->vkCmdBlitImage((*data->resolve_command_buffer_), render_target,
+                             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             data->swapchain_image_,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                             blit_filter_);
+      } else {
+        VkImageResolve region = {
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+                0,                          // mipLevel
+                0,                          // baseArrayLayer
+                1,                          // layerCount
+            },                              // srcSubresource
+            {
+                0,  // x
+                0,  // y
+                0   // z
+            },      // srcOffset
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+                0,                          // mipLevel
+                0,                          // baseArrayLayer
+                1,                          // layerCount
+            },                              // dstSubresource
+            {
+                0,  // x
+                0,  // y
+                0   // z
+            },      // dstOffset
+            {
+                app()->swapchain().width(),   // width
+                app()->swapchain().height(),  // height
+                1                             // depth
+            }                                 // extent
+        };
+        (*data->resolve_command_buffer_)
+            ->vkCmdResolveImage(
+                (*data->resolve_command_buffer_), *data->multisampled_target_,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data->swapchain_image_,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+      }
     }
 
     VkImageMemoryBarrier present_barrier = {
@@ -930,7 +2605,7 @@ class Sample {
         old_access,                              // srcAccessMask
         VK_ACCESS_MEMORY_READ_BIT,               // dstAccessMask
         old_layout,                              // oldLayout
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,         // newLayout
+        present_layout,                          // newLayout
         dstQueueFamilyIndex,                     // srcQueueFamilyIndex
         srcQueueFamilyIndex,                     // dstQueueFamilyIndex
         data->swapchain_image_,                  // image
@@ -940,15 +2615,29 @@ class Sample {
                                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
                                nullptr, 0, nullptr, 1, &present_barrier);
+    if (measure_frame) {
+      gpu_profiler_->EndZone(data->resolve_command_buffer_.get(), frame_zone);
+    }
     (*data->resolve_command_buffer_)
         ->vkEndCommandBuffer(*data->resolve_command_buffer_);
+  }
 
-    InitializeFrameData(&data->child_data_, initialization_buffer, frame_index);
+  // Returns once the pipelined update of the next frame, if any, is done.
+  void WaitForUpdate() {
+    if (update_pending_) {
+      update_tasks_->Wait();
+      update_pending_ = false;
+    }
   }
 
   SampleOptions options_;
   const entry::EntryData* data_;
   containers::Allocator* allocator_;
+  // Also runs the parts of bring-up in application_ that are independent.
+  jobs::JobSystem job_system_;
+  // Chained in front of SampleOptions::device_extension_structures with
+  // timeline frame sync. It has to outlive the creation of application_.
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features_;
   // The VulkanApplication that we build on, we want this to be the
   // last thing deleted, it goes at the top.
   vulkan::VulkanApplication application_;
@@ -956,6 +2645,93 @@ class Sample {
   // This contains one SampleFrameData per swapchain image. It will be used
   // to render frames to the appropriate swapchains
   containers::vector<SampleFrameData> frame_data_;
+  // A BufferFrameData of UpdateBufferEveryFrame(), and how to update it.
+  struct EveryFrameBuffer {
+    void* data;
+    void (*update)(void* data, vulkan::BufferUpdateBatch* batch,
+                   vulkan::VkQueue* queue, size_t frame_index);
+  };
+  containers::vector<EveryFrameBuffer> every_frame_buffers_;
+  // One slot per frame that can be in flight, used in turn.
+  containers::vector<FrameSlot> frame_slots_;
+  // The fence of the slot that last rendered to each swapchain image, or
+  // VK_NULL_HANDLE if none has yet.
+  containers::vector<::VkFence> image_fences_;
+  // With timeline frame sync, the frame value that the last frame that
+  // rendered to each swapchain image signals, instead of image_fences_.
+  containers::vector<uint64_t> image_values_;
+  // The timeline semaphores of the render queue and, if it is separate, the
+  // present queue. Only created with timeline frame sync.
+  containers::unique_ptr<vulkan::VkSemaphore> frame_timeline_;
+  containers::unique_ptr<vulkan::VkSemaphore> present_timeline_;
+  // With submit ahead, the timeline semaphore that the host signals with the
+  // frame value once LateUpdate() is done.
+  containers::unique_ptr<vulkan::VkSemaphore> input_timeline_;
+  // The value of the most recent frame, frames count up from 1.
+  uint64_t last_frame_value_;
+  size_t next_frame_slot_;
+  // Semaphores that no frame in flight uses anymore.
+  containers::vector<containers::unique_ptr<vulkan::VkSemaphore>>
+      free_semaphores_;
+  size_t num_semaphores_created_;
+  // In headless mode, the offscreen image to render the next frame to.
+  size_t next_headless_image_;
+  // In headless mode, the number of frames rendered so far, and the time
+  // they took, apart from the first one.
+  uint32_t num_headless_frames_;
+  float headless_frame_time_;
+  // The most recent frame times, only recorded with -stats-file or
+  // -benchmark-frames.
+  vulkan::FrameTimeRecorder frame_times_;
+  // From Update() to the present, with low latency presentation.
+  vulkan::FrameTimeRecorder present_latencies_;
+  // The time that every recorded frame waited for its fences or timeline
+  // values, recorded along with frame_times_.
+  vulkan::FrameTimeRecorder fence_wait_times_;
+  // The time that the current frame has waited so far.
+  float frame_wait_time_;
+  // Waits with the policy of -fence-wait.
+  containers::unique_ptr<vulkan::FenceWaiter> fence_waiter_;
+  uint64_t num_frames_processed_;
+  // With low latency presentation, the shared image is only acquired by the
+  // first frame.
+  bool shared_image_acquired_;
+  // With a resizable swapchain, set once an acquire or present reported
+  // that the swapchain no longer matches the surface.
+  bool swapchain_out_of_date_;
+  // With damage tracking, what the current frame changed.
+  VkRectLayerKHR frame_damage_rects_[kMaxDamageRects];
+  uint32_t num_frame_damage_rects_;
+  // Runs Update() for the next frame with pipelined updates.
+  containers::unique_ptr<jobs::TaskGroup> update_tasks_;
+  bool update_pending_;
+  // The steady_clock time at which the pending update started.
+  uint64_t pending_input_time_ns_;
+  size_t update_state_index_;
+  size_t render_state_index_;
+  containers::LinearAllocator frame_allocator_;
+  // The render queue command buffers of the frame being processed.
+  containers::vector<::VkCommandBuffer> frame_command_buffers_;
+  // The ring of host-visible memory for per-frame transient data, if
+  // enabled.
+  containers::unique_ptr<vulkan::TransientRingBuffer> transient_ring_buffer_;
+  containers::unique_ptr<vulkan::BufferUpdateBatch> buffer_update_batch_;
+  // The worker threads for recording, if enabled.
+  containers::unique_ptr<vulkan::ParallelCommandRecorder> parallel_recorder_;
+  // The timestamp queries of every frame slot, if enabled.
+  containers::unique_ptr<vulkan::GpuProfiler> gpu_profiler_;
+  // True if frames are submitted again for the other passes of the
+  // performance counters.
+  bool replay_counter_passes_;
+  containers::unique_ptr<vulkan::FramePacer> frame_pacer_;
+  // Samples the thermal state, and caps the frame rate to the thermal
+  // headroom target, on devices that report their thermal state.
+  containers::unique_ptr<vulkan::ThermalLimiter> thermal_limiter_;
+  containers::unique_ptr<vulkan::FrameCapture> frame_capture_;
+  // The calls to the device of every frame, with -count-api-calls.
+  containers::unique_ptr<vulkan::ApiCallStats> api_call_stats_;
+  // Checks that the measured frames do not allocate, with -audit-allocations.
+  containers::unique_ptr<vulkan::AllocationAudit> allocation_audit_;
   // The number of samples that we will render with
   VkSampleCountFlagBits num_samples_;
   // The number of color samples that will be used with mixed sampling
@@ -968,6 +2744,10 @@ class Sample {
   VkViewport default_viewport_;
   // The scissor we use to render
   VkRect2D default_scissor_;
+  // With dynamic resolution, the current scale of the viewport and scissor,
+  // and the filter that scales the render target to the swapchain.
+  float resolution_scale_;
+  VkFilter blit_filter_;
   // The last time ProcessFrame was called. This is used to calculate the
   // delta
   //  to be passed to Update.
@@ -981,6 +2761,8 @@ class Sample {
   float average_frame_time_;
   // If this is set to false, the application cannot be safely run.
   bool is_valid_;
+  // The queue families of SetComputeStageSharing().
+  uint32_t compute_stage_families_[2] = {0, 0};
 };  // namespace sample_application
 }  // namespace sample_application
 
@@ -15,11 +15,13 @@
 #include "application_sandbox/sample_application_framework/sample_application.h"
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/gpu_profiler.h"
 #include "vulkan_helpers/helper_functions.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
 #include <chrono>
+#include <cstring>
 #include "mathfu/matrix.h"
 #include "mathfu/vector.h"
 
@@ -56,6 +58,10 @@ uint32_t mirror_vertex_shader[] =
 #include "mirror.vert.spv"
     ;
 
+uint32_t taa_resolve_shader[] =
+#include "taa_resolve.comp.spv"
+    ;
+
 /// SAMPLE_LOCATION
 static VkSampleLocationEXT sample_locations[4]{
 //    {
@@ -100,6 +106,81 @@ static VkPhysicalDeviceSampleLocationsPropertiesEXT
 
 const VkFormat kDepthStencilFormat = VK_FORMAT_D32_SFLOAT_S8_UINT;
 
+// How the edges of the scene are anti-aliased, see GetAntiAliasing.
+enum class AntiAliasing {
+  // 4x MSAA with the static sample_locations above, which the framework
+  // resolves to the swapchain.
+  kMsaa,
+  // The scene is rendered with 1 or 2 samples at locations that change
+  // every frame, and taa_resolve.comp blends every frame into a history of
+  // the frames before it.
+  kTemporal,
+};
+
+// -sample-option=aa=taa selects temporal AA, and taa_samples=2 renders its
+// scene with 2 samples instead of 1.
+AntiAliasing GetAntiAliasing(const entry::EntryData* data) {
+  const char* aa = data->sample_option("aa");
+  return aa && strcmp(aa, "taa") == 0 ? AntiAliasing::kTemporal
+                                      : AntiAliasing::kMsaa;
+}
+
+VkSampleCountFlagBits GetTemporalSamples(const entry::EntryData* data) {
+  const char* samples = data->sample_option("taa_samples");
+  return samples && strcmp(samples, "2") == 0 ? VK_SAMPLE_COUNT_2_BIT
+                                              : VK_SAMPLE_COUNT_1_BIT;
+}
+
+// The sample locations of 4x MSAA on a rotated grid. Temporal AA visits
+// all of them every 4 / samples frames, so that the history gets close to
+// 4x MSAA while the scene stands still.
+const VkSampleLocationEXT kJitterLocations[4] = {
+    {0.375f, 0.125f},
+    {0.875f, 0.375f},
+    {0.125f, 0.625f},
+    {0.625f, 0.875f},
+};
+// The format of the scene and of the history of temporal AA, which
+// taa_resolve.comp stores to and every device can.
+const VkFormat kTemporalFormat = VK_FORMAT_R8G8B8A8_UNORM;
+// The workgroup size of taa_resolve.comp in x and y.
+const uint32_t kResolveGroupSize = 8;
+
+// The scene pass of temporal AA writes the image that the resolve of the
+// last frame with these frame data read, and is read by the resolve after
+// it.
+const VkSubpassDependency kTemporalDependencies[2] = {
+    {
+        VK_SUBPASS_EXTERNAL,                            // srcSubpass
+        0,                                              // dstSubpass
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,           // srcStageMask
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
+        0,                                              // srcAccessMask
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,           // dstAccessMask
+        0                                               // dependencyFlags
+    },
+    {
+        0,                                              // srcSubpass
+        VK_SUBPASS_EXTERNAL,                            // dstSubpass
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,           // dstStageMask
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,           // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,                      // dstAccessMask
+        0                                               // dependencyFlags
+    }};
+
+// Both modes measure the scene, and temporal AA its resolve, with the GPU
+// profiler, which logs them with the benchmark results.
+sample_application::SampleOptions SampleLocationsOptions(
+    const entry::EntryData* data) {
+  sample_application::SampleOptions options;
+  options.EnableGpuProfiler(2);
+  if (GetAntiAliasing(data) == AntiAliasing::kMsaa) {
+    options.EnableMultisampling();
+  }
+  return options;
+}
+
 struct StencilFrameData {
   containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
   containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
@@ -110,6 +191,16 @@ struct StencilFrameData {
   // and its view here.
   vulkan::ImagePointer depth_stencil_image_;
   containers::unique_ptr<vulkan::VkImageView> depth_stencil_image_view_;
+
+  // With temporal AA, the scene of this frame, of one sample. If the scene
+  // has 2 samples, it is rendered to scene_image_ and resolved to this.
+  vulkan::ImagePointer current_image_;
+  containers::unique_ptr<vulkan::VkImageView> current_image_view_;
+  vulkan::ImagePointer scene_image_;
+  containers::unique_ptr<vulkan::VkImageView> scene_image_view_;
+  // The sets of taa_resolve.comp, which read the history of the other
+  // parity and write the one of theirs.
+  containers::unique_ptr<vulkan::DescriptorSet> resolve_descriptor_sets_[2];
 };
 
 // This creates an application with 16MB of image memory, and defaults
@@ -120,11 +211,17 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
       : data_(data),
         Sample<StencilFrameData>(
             data->allocator(), data, 1, 512, 1, 1,
-            sample_application::SampleOptions().EnableMultisampling(), {0},
+            SampleLocationsOptions(data), {0},
             {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
             {VK_EXT_SAMPLE_LOCATIONS_EXTENSION_NAME}),
         cube_(data->allocator(), data->logger(), cube_data),
-        floor_(data->allocator(), data->logger(), floor_data) {}
+        floor_(data->allocator(), data->logger(), floor_data),
+        anti_aliasing_(GetAntiAliasing(data)),
+        scene_samples_(anti_aliasing_ == AntiAliasing::kMsaa
+                           ? num_samples()
+                           : GetTemporalSamples(data)),
+        jitter_sample_locations_(false),
+        frame_count_(0) {}
   virtual void InitializeApplicationData(
       vulkan::VkCommandBuffer* initialization_buffer,
       size_t num_swapchain_images) override {
@@ -160,46 +257,6 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     VkAttachmentReference depth_attachment = {
         1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
 
-    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
-        data_->allocator(),
-        app()->CreateRenderPass(
-            {{
-                 0,                                         // flags
-                 render_format(),                           // format
-                 num_samples(),                             // samples
-                 VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
-                 VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
-                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
-                 VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
-                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
-                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
-             },
-             {
-                 0,                                 // flags
-                 kDepthStencilFormat,               // format
-                 num_samples(),                     // samples
-                 VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
-                 VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
-                 VK_ATTACHMENT_LOAD_OP_CLEAR,       // stenilLoadOp
-                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stenilStoreOp
-                 VK_IMAGE_LAYOUT_UNDEFINED,         // initialLayout
-                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // finalLayout
-             }},  // AttachmentDescriptions
-            {{
-                0,                                // flags
-                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
-                0,                                // inputAttachmentCount
-                nullptr,                          // pInputAttachments
-                1,                                // colorAttachmentCount
-                &color_attachment,                // colorAttachment
-                nullptr,                          // pResolveAttachments
-                &depth_attachment,                // pDepthStencilAttachment
-                0,                                // preserveAttachmentCount
-                nullptr                           // pPreserveAttachments
-            }},                                   // SubpassDescriptions
-            {}                                    // SubpassDependencies
-            ));
-
     VkPhysicalDeviceProperties2 physical_device_properties{
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
         &physical_device_sample_locations_properties  // pNext
@@ -208,6 +265,60 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     app()->instance()->vkGetPhysicalDeviceProperties2KHR(
         app()->device().physical_device(), &physical_device_properties);
 
+    if (temporal()) {
+      // Without programmable locations for the sample count of the scene,
+      // the projection is jittered instead.
+      jitter_sample_locations_ =
+          (physical_device_sample_locations_properties
+               .sampleLocationSampleCounts &
+           scene_samples_) != 0;
+      data_->logger()->LogInfo(
+          "Temporal AA with ", scene_samples_, " samples, jittered with ",
+          jitter_sample_locations_ ? "sample locations" : "the projection");
+      CreateTemporalRenderPass();
+      InitializeTemporalResolve(initialization_buffer);
+    } else {
+      render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+          data_->allocator(),
+          app()->CreateRenderPass(
+              {{
+                   0,                                         // flags
+                   render_format(),                           // format
+                   num_samples(),                             // samples
+                   VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                   VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                   VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                   VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                   VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                   VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+               },
+               {
+                   0,                                 // flags
+                   kDepthStencilFormat,               // format
+                   num_samples(),                     // samples
+                   VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
+                   VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
+                   VK_ATTACHMENT_LOAD_OP_CLEAR,       // stenilLoadOp
+                   VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stenilStoreOp
+                   VK_IMAGE_LAYOUT_UNDEFINED,         // initialLayout
+                   VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // finalLayout
+               }},  // AttachmentDescriptions
+              {{
+                  0,                                // flags
+                  VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                  0,                                // inputAttachmentCount
+                  nullptr,                          // pInputAttachments
+                  1,                                // colorAttachmentCount
+                  &color_attachment,                // colorAttachment
+                  nullptr,                          // pResolveAttachments
+                  &depth_attachment,                // pDepthStencilAttachment
+                  0,                                // preserveAttachmentCount
+                  nullptr                           // pPreserveAttachments
+              }},                                   // SubpassDescriptions
+              {}                                    // SubpassDependencies
+              ));
+    }
+
     VkSampleLocationsInfoEXT pipeline_sample_location_info{
         VK_STRUCTURE_TYPE_SAMPLE_LOCATIONS_INFO_EXT,
         nullptr,                // pNext
@@ -217,6 +328,14 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
         num_samples(),                   // sampleLocationsCount
         sample_locations                 // pSampleLocations
     };
+    if (temporal()) {
+      // RecordCommandBuffer sets the locations of every frame, these are
+      // only the ones that the pipelines are created with.
+      pipeline_sample_location_info.sampleLocationsPerPixel = scene_samples_;
+      pipeline_sample_location_info.sampleLocationGridSize = {1, 1};
+      pipeline_sample_location_info.sampleLocationsCount = scene_samples_;
+      pipeline_sample_location_info.pSampleLocations = kJitterLocations;
+    }
     VkPipelineSampleLocationsStateCreateInfoEXT pipeline_sample_locations{
         VK_STRUCTURE_TYPE_PIPELINE_SAMPLE_LOCATIONS_STATE_CREATE_INFO_EXT,
         nullptr,                       // pNext
@@ -236,10 +355,10 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     cube_pipeline_->SetInputStreams(&cube_);
     cube_pipeline_->SetViewport(viewport());
     cube_pipeline_->SetScissor(scissor());
-    cube_pipeline_->SetSamples(num_samples());
+    cube_pipeline_->SetSamples(scene_samples_);
     cube_pipeline_->AddAttachment();
 
-    cube_pipeline_->SetPipelineExtensions(&pipeline_sample_locations);
+    SetSampleLocations(cube_pipeline_.get(), &pipeline_sample_locations);
 
     cube_pipeline_->Commit();
 
@@ -255,7 +374,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     floor_pipeline_->SetInputStreams(&floor_);
     floor_pipeline_->SetViewport(viewport());
     floor_pipeline_->SetScissor(scissor());
-    floor_pipeline_->SetSamples(num_samples());
+    floor_pipeline_->SetSamples(scene_samples_);
     floor_pipeline_->AddAttachment();
     // Need to enable the stencil buffer to be written. The reference and
     // write mask will be set later dynamically, the actual value write to
@@ -266,7 +385,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     floor_pipeline_->DepthStencilState().front.compareOp = VK_COMPARE_OP_ALWAYS;
     floor_pipeline_->DepthStencilState().front.passOp = VK_STENCIL_OP_REPLACE;
 
-    floor_pipeline_->SetPipelineExtensions(&pipeline_sample_locations);
+    SetSampleLocations(floor_pipeline_.get(), &pipeline_sample_locations);
 
     floor_pipeline_->Commit();
 
@@ -283,7 +402,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     mirror_pipeline_->SetInputStreams(&cube_);
     mirror_pipeline_->SetViewport(viewport());
     mirror_pipeline_->SetScissor(scissor());
-    mirror_pipeline_->SetSamples(num_samples());
+    mirror_pipeline_->SetSamples(scene_samples_);
     // Enable color blend
     mirror_pipeline_->AddDynamicState(VK_DYNAMIC_STATE_BLEND_CONSTANTS);
     mirror_pipeline_->AddAttachment(VkPipelineColorBlendAttachmentState{
@@ -308,7 +427,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     // Disable depth test, so the reflection can be shown on the floor.
     mirror_pipeline_->DepthStencilState().depthTestEnable = VK_FALSE;
 
-    mirror_pipeline_->SetPipelineExtensions(&pipeline_sample_locations);
+    SetSampleLocations(mirror_pipeline_.get(), &pipeline_sample_locations);
 
     mirror_pipeline_->Commit();
 
@@ -321,11 +440,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 
-    float aspect =
-        (float)app()->swapchain().width() / (float)app()->swapchain().height();
-    camera_data_->data().projection_matrix =
-        Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
-        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+    camera_data_->data().projection_matrix = Projection();
 
     model_data_->data().transform =
         Mat44::FromTranslationVector(
@@ -351,7 +466,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
         },                                            // extent
         1,                                            // mipLevels
         1,                                            // arrayLayers
-        VK_SAMPLE_COUNT_4_BIT,                        // samples
+        scene_samples_,                               // samples
         VK_IMAGE_TILING_OPTIMAL,                      // tiling
         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,  // usage
         VK_SHARING_MODE_EXCLUSIVE,                    // sharingMode
@@ -365,6 +480,10 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
         frame_data->depth_stencil_image_.get(), VK_IMAGE_VIEW_TYPE_2D,
         {VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1});
 
+    if (temporal()) {
+      InitializeTemporalFrameData(frame_data);
+    }
+
     // Initialize the descriptor sets
     frame_data->cube_descriptor_set_ =
         containers::make_unique<vulkan::DescriptorSet>(
@@ -400,8 +519,17 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
                                             nullptr);
 
-    ::VkImageView raw_views[2] = {color_view(frame_data),
-                                  *frame_data->depth_stencil_image_view_};
+    ::VkImageView raw_views[3] = {color_view(frame_data),
+                                  *frame_data->depth_stencil_image_view_,
+                                  VK_NULL_HANDLE};
+    uint32_t num_attachments = 2;
+    if (temporal() && scene_samples_ == VK_SAMPLE_COUNT_1_BIT) {
+      raw_views[0] = *frame_data->current_image_view_;
+    } else if (temporal()) {
+      raw_views[0] = *frame_data->scene_image_view_;
+      raw_views[2] = *frame_data->current_image_view_;
+      num_attachments = 3;
+    }
 
     // Create a framebuffer with depth and image attachments
     VkFramebufferCreateInfo framebuffer_create_info{
@@ -409,7 +537,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
         nullptr,                                    // pNext
         0,                                          // flags
         *render_pass_,                              // renderPass
-        2,                                          // attachmentCount
+        num_attachments,                            // attachmentCount
         raw_views,                                  // attachments
         app()->swapchain().width(),                 // width
         app()->swapchain().height(),                // height
@@ -427,11 +555,444 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     frame_data->command_buffer_ =
         containers::make_unique<vulkan::VkCommandBuffer>(
             data_->allocator(), app()->GetCommandBuffer());
+    // With temporal AA, Render records it for every frame instead.
+    if (!temporal()) {
+      RecordCommandBuffer(frame_data);
+    }
+  }
 
-    (*frame_data->command_buffer_)
-        ->vkBeginCommandBuffer((*frame_data->command_buffer_),
-                               &sample_application::kBeginCommandBuffer);
+  virtual void Update(float time_since_last_render) override {
+    model_data_->data().transform = model_data_->data().transform *
+                                    Mat44::FromRotationMatrix(Mat44::RotationY(
+                                        3.14f * time_since_last_render * 0.5f));
+  }
+  virtual void UpdateFrameBuffers(size_t frame_index,
+                                  StencilFrameData* frame_data) override {
+    if (temporal() && !jitter_sample_locations_) {
+      camera_data_->data().projection_matrix = JitteredProjection();
+    }
+    // Update our uniform buffers.
+    camera_data_->UpdateBuffer(buffer_update_batch(), &app()->render_queue(),
+                               frame_index);
+    model_data_->UpdateBuffer(buffer_update_batch(), &app()->render_queue(),
+                              frame_index);
+  }
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      StencilFrameData* frame_data) override {
+    if (temporal()) {
+      // The sample locations and the history change every frame.
+      RecordCommandBuffer(frame_data);
+    }
+    VkSubmitInfo init_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &(frame_data->command_buffer_->get_command_buffer()),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &init_submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+    ++frame_count_;
+  }
+
+ private:
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  struct ModelData {
+    Mat44 transform;
+  };
+
+  // The push constants of taa_resolve.comp.
+  struct ResolveData {
+    uint32_t history_valid;
+    float current_weight;
+  };
+
+  bool temporal() const { return anti_aliasing_ == AntiAliasing::kTemporal; }
+
+  // The frames in which temporal AA visits every location of
+  // kJitterLocations, and the locations of the samples of this frame.
+  uint32_t jitter_phases() const { return 4 / scene_samples_; }
+  const VkSampleLocationEXT* jitter_locations() const {
+    return &kJitterLocations[(frame_count_ % jitter_phases()) *
+                             scene_samples_];
+  }
+
+  Mat44 Projection() const {
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    return Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
+           Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+  }
+
+  // Without programmable sample locations, temporal AA moves the whole
+  // frame by the offset of its first location from the center of a pixel.
+  Mat44 JitteredProjection() const {
+    const VkSampleLocationEXT& location = jitter_locations()[0];
+    const float x = (location.x - 0.5f) * 2.0f /
+                    static_cast<float>(app()->swapchain().width());
+    const float y = (location.y - 0.5f) * 2.0f /
+                    static_cast<float>(app()->swapchain().height());
+    return Mat44::FromTranslationVector(mathfu::Vector<float, 3>{x, y, 0.0f}) *
+           Projection();
+  }
+
+  // Chains |state| to |pipeline| if the scene is rendered at programmable
+  // sample locations. With temporal AA they are set for every frame.
+  void SetSampleLocations(
+      vulkan::VulkanGraphicsPipeline* pipeline,
+      const VkPipelineSampleLocationsStateCreateInfoEXT* state) {
+    if (!temporal()) {
+      pipeline->SetPipelineExtensions(state);
+    } else if (jitter_sample_locations_) {
+      pipeline->AddDynamicState(VK_DYNAMIC_STATE_SAMPLE_LOCATIONS_EXT);
+      pipeline->SetPipelineExtensions(state);
+    }
+  }
+
+  // The scene pass of temporal AA renders into current_image_, or into
+  // scene_image_ with 2 samples, which it resolves into current_image_.
+  // Only current_image_ is stored, for taa_resolve.comp.
+  void CreateTemporalRenderPass() {
+    const bool resolve = scene_samples_ != VK_SAMPLE_COUNT_1_BIT;
+    const VkAttachmentDescription current = {
+        0,                                // flags
+        kTemporalFormat,                  // format
+        VK_SAMPLE_COUNT_1_BIT,            // samples
+        resolve ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
+                : VK_ATTACHMENT_LOAD_OP_CLEAR,  // loadOp
+        VK_ATTACHMENT_STORE_OP_STORE,           // storeOp
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE,        // stencilLoadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,       // stencilStoreOp
+        VK_IMAGE_LAYOUT_UNDEFINED,              // initialLayout
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL  // finalLayout
+    };
+    const VkAttachmentDescription scene = {
+        0,                                        // flags
+        kTemporalFormat,                          // format
+        scene_samples_,                           // samples
+        VK_ATTACHMENT_LOAD_OP_CLEAR,              // loadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,         // storeOp
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE,          // stencilLoadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,         // stencilStoreOp
+        VK_IMAGE_LAYOUT_UNDEFINED,                // initialLayout
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // finalLayout
+    };
+    const VkAttachmentDescription depth_stencil = {
+        0,                                                // flags
+        kDepthStencilFormat,                              // format
+        scene_samples_,                                   // samples
+        VK_ATTACHMENT_LOAD_OP_CLEAR,                      // loadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,                 // storeOp
+        VK_ATTACHMENT_LOAD_OP_CLEAR,                      // stencilLoadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,                 // stencilStoreOp
+        VK_IMAGE_LAYOUT_UNDEFINED,                        // initialLayout
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // finalLayout
+    };
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depth_attachment = {
+        1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference resolve_attachment = {
+        2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    const VkSubpassDescription subpass = {
+        0,                                        // flags
+        VK_PIPELINE_BIND_POINT_GRAPHICS,          // pipelineBindPoint
+        0,                                        // inputAttachmentCount
+        nullptr,                                  // pInputAttachments
+        1,                                        // colorAttachmentCount
+        &color_attachment,                        // colorAttachment
+        resolve ? &resolve_attachment : nullptr,  // pResolveAttachments
+        &depth_attachment,                        // pDepthStencilAttachment
+        0,                                        // preserveAttachmentCount
+        nullptr                                   // pPreserveAttachments
+    };
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        resolve ? app()->CreateRenderPass(
+                      {scene, depth_stencil, current}, {subpass},
+                      {kTemporalDependencies[0], kTemporalDependencies[1]})
+                : app()->CreateRenderPass(
+                      {current, depth_stencil}, {subpass},
+                      {kTemporalDependencies[0], kTemporalDependencies[1]}));
+  }
+
+  // Creates taa_resolve.comp and the two histories, which stay in
+  // VK_IMAGE_LAYOUT_GENERAL.
+  void InitializeTemporalResolve(
+      vulkan::VkCommandBuffer* initialization_buffer) {
+    sampler_ = containers::make_unique<vulkan::VkSampler>(
+        data_->allocator(), vulkan::CreateDefaultSampler(&app()->device()));
+    for (uint32_t i = 0; i < 2; ++i) {
+      resolve_bindings_[i] = {
+          i,                                          // binding
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+          nullptr                                     // pImmutableSamplers
+      };
+    }
+    resolve_bindings_[2] = {
+        2,                                 // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  // descriptorType
+        1,                                 // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,       // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    VkPushConstantRange resolve_range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(ResolveData)           // size
+    };
+    resolve_pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{resolve_bindings_[0], resolve_bindings_[1],
+              resolve_bindings_[2]}},
+                                    {resolve_range}));
+    resolve_pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+        data_->allocator(),
+        app()->CreateComputePipeline(
+            resolve_pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                sizeof(taa_resolve_shader), taa_resolve_shader},
+            "main"));
+
+    for (uint32_t i = 0; i < 2; ++i) {
+      history_images_[i] = CreateTemporalImage(
+          VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT |
+                                     VK_IMAGE_USAGE_STORAGE_BIT |
+                                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+      history_views_[i] = app()->CreateImageView(
+          history_images_[i].get(), VK_IMAGE_VIEW_TYPE_2D,
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+      VkImageMemoryBarrier barrier = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+          nullptr,                                 // pNext
+          0,                                       // srcAccessMask
+          VK_ACCESS_SHADER_READ_BIT |
+              VK_ACCESS_SHADER_WRITE_BIT,          // dstAccessMask
+          VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+          VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+          VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+          *history_images_[i],                     // image
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}  // subresourceRange
+      };
+      (*initialization_buffer)
+          ->vkCmdPipelineBarrier(*initialization_buffer,
+                                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+    }
+  }
+
+  vulkan::ImagePointer CreateTemporalImage(VkSampleCountFlagBits samples,
+                                           VkImageUsageFlags usage) {
+    VkImageCreateInfo image_create_info = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        kTemporalFormat,                      // format
+        {
+            app()->swapchain().width(),
+            app()->swapchain().height(),
+            app()->swapchain().depth(),
+        },                          // extent
+        1,                          // mipLevels
+        1,                          // arrayLayers
+        samples,                    // samples
+        VK_IMAGE_TILING_OPTIMAL,    // tiling
+        usage,                      // usage
+        VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
+        0,                          // queueFamilyIndexCount
+        nullptr,                    // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,  // initialLayout
+    };
+    return app()->CreateAndBindImage(&image_create_info);
+  }
+
+  void InitializeTemporalFrameData(StencilFrameData* frame_data) {
+    frame_data->current_image_ = CreateTemporalImage(
+        VK_SAMPLE_COUNT_1_BIT,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    frame_data->current_image_view_ = app()->CreateImageView(
+        frame_data->current_image_.get(), VK_IMAGE_VIEW_TYPE_2D,
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+    if (scene_samples_ != VK_SAMPLE_COUNT_1_BIT) {
+      frame_data->scene_image_ = CreateTemporalImage(
+          scene_samples_, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+      frame_data->scene_image_view_ = app()->CreateImageView(
+          frame_data->scene_image_.get(), VK_IMAGE_VIEW_TYPE_2D,
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+    }
+
+    for (uint32_t parity = 0; parity < 2; ++parity) {
+      auto& set = frame_data->resolve_descriptor_sets_[parity];
+      set = containers::make_unique<vulkan::DescriptorSet>(
+          data_->allocator(),
+          app()->AllocateDescriptorSet({resolve_bindings_[0],
+                                        resolve_bindings_[1],
+                                        resolve_bindings_[2]}));
+      VkDescriptorImageInfo image_infos[3] = {
+          {
+              *sampler_,                                 // sampler
+              *frame_data->current_image_view_,          // imageView
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+          },
+          {
+              *sampler_,                      // sampler
+              *history_views_[1 - parity],    // imageView
+              VK_IMAGE_LAYOUT_GENERAL,        // imageLayout
+          },
+          {
+              VK_NULL_HANDLE,            // sampler
+              *history_views_[parity],   // imageView
+              VK_IMAGE_LAYOUT_GENERAL,   // imageLayout
+          }};
+      VkWriteDescriptorSet writes[2] = {
+          {
+              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+              nullptr,                                    // pNext
+              *set,                                       // dstSet
+              0,                                          // dstbinding
+              0,                                          // dstArrayElement
+              2,                                          // descriptorCount
+              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+              image_infos,                                // pImageInfo
+              nullptr,                                    // pBufferInfo
+              nullptr,                                    // pTexelBufferView
+          },
+          {
+              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+              nullptr,                                 // pNext
+              *set,                                    // dstSet
+              2,                                       // dstbinding
+              0,                                       // dstArrayElement
+              1,                                       // descriptorCount
+              VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,        // descriptorType
+              &image_infos[2],                         // pImageInfo
+              nullptr,                                 // pBufferInfo
+              nullptr,                                 // pTexelBufferView
+          }};
+      app()->device()->vkUpdateDescriptorSets(app()->device(), 2, writes, 0,
+                                              nullptr);
+    }
+  }
+
+  // Blends this frame into the history of the frames before it, and blits
+  // the new history to the swapchain image, measured as "taa_resolve".
+  void RecordTemporalResolve(vulkan::VkCommandBuffer* cmd,
+                             StencilFrameData* frame_data) {
+    const uint32_t parity = static_cast<uint32_t>(frame_count_ & 1);
+    vulkan::GpuZone zone(gpu_profiler(), cmd, "taa_resolve");
+
+    // The history that this frame reads was written by the resolve of the
+    // last frame, and the one it writes was read by the blit of the last
+    // frame.
+    VkMemoryBarrier history_barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,        // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT  // dstAccessMask
+    };
+    (*cmd)->vkCmdPipelineBarrier(
+        *cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &history_barrier, 0,
+        nullptr, 0, nullptr);
+
+    (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              *resolve_pipeline_);
+    (*cmd)->vkCmdBindDescriptorSets(
+        *cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*resolve_pipeline_layout_), 0, 1,
+        &frame_data->resolve_descriptor_sets_[parity]->raw_set(), 0, nullptr);
+    const ResolveData resolve_data = {
+        frame_count_ > 0 ? 1u : 0u,                     // history_valid
+        1.0f / static_cast<float>(jitter_phases())  // current_weight
+    };
+    (*cmd)->vkCmdPushConstants(
+        *cmd, ::VkPipelineLayout(*resolve_pipeline_layout_),
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(resolve_data), &resolve_data);
+    const uint32_t width = app()->swapchain().width();
+    const uint32_t height = app()->swapchain().height();
+    (*cmd)->vkCmdDispatch(*cmd,
+                          (width + kResolveGroupSize - 1) / kResolveGroupSize,
+                          (height + kResolveGroupSize - 1) / kResolveGroupSize,
+                          1);
+
+    VkImageMemoryBarrier barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+            nullptr,                                 // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,              // srcAccessMask
+            VK_ACCESS_TRANSFER_READ_BIT,             // dstAccessMask
+            VK_IMAGE_LAYOUT_GENERAL,                 // oldLayout
+            VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+            VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+            *history_images_[parity],                // image
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}  // subresourceRange
+        },
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,    // sType
+            nullptr,                                   // pNext
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,      // srcAccessMask
+            VK_ACCESS_TRANSFER_WRITE_BIT,              // dstAccessMask
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // oldLayout
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,      // newLayout
+            VK_QUEUE_FAMILY_IGNORED,                   // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                   // dstQueueFamilyIndex
+            swapchain_image(frame_data),               // image
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}    // subresourceRange
+        }};
+    (*cmd)->vkCmdPipelineBarrier(
+        *cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2,
+        barriers);
+
+    VkImageBlit blit_region{
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        {{0, 0, 0}, {int32_t(width), int32_t(height), 1}},
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        {{0, 0, 0}, {int32_t(width), int32_t(height), 1}},
+    };
+    (*cmd)->vkCmdBlitImage(*cmd, *history_images_[parity],
+                           VK_IMAGE_LAYOUT_GENERAL, swapchain_image(frame_data),
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &blit_region, VK_FILTER_NEAREST);
+
+    // The framework expects the swapchain image back in
+    // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL.
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    (*cmd)->vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+  }
+
+  // Records the scene into the command buffer of |frame_data|, measured as
+  // "scene", and with temporal AA its resolve.
+  void RecordCommandBuffer(StencilFrameData* frame_data) {
     vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
+    cmdBuffer->vkResetCommandBuffer(cmdBuffer, 0);
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
 
     VkClearValue clears[2];
     clears[0].color = {1.0f, 1.0f, 1.0f, 1.0f};
@@ -447,6 +1008,14 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
         num_samples(),                   // sampleLocationsCount
         sample_locations                 // pSampleLocations
     };
+    if (temporal()) {
+      attachment_sample_location_info.sampleLocationsPerPixel = scene_samples_;
+      attachment_sample_location_info.sampleLocationGridSize = {1, 1};
+      attachment_sample_location_info.sampleLocationsCount = scene_samples_;
+      attachment_sample_location_info.pSampleLocations = jitter_locations();
+    }
+    const bool programmable_locations =
+        !temporal() || jitter_sample_locations_;
     VkAttachmentSampleLocationsEXT attachment_sample_locations{
         1,                               // attachmentIndex;
         attachment_sample_location_info  // sampleLocationsInfo;
@@ -463,8 +1032,9 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
 
     VkRenderPassBeginInfo pass_begin = {
         VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        &render_pass_sample_location_begin_info,   // pNext
-        *render_pass_,                             // renderPass
+        programmable_locations ? &render_pass_sample_location_begin_info
+                               : nullptr,  // pNext
+        *render_pass_,                     // renderPass
         *frame_data->framebuffer_,                 // framebuffer
         {{0, 0},
          {app()->swapchain().width(),
@@ -473,81 +1043,55 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
         clears                            // clears
     };
 
-    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
-                                    VK_SUBPASS_CONTENTS_INLINE);
-    cmdBuffer->vkCmdBindDescriptorSets(
-        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
-        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
-
-    // Draw the cube
-    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *cube_pipeline_);
-    cube_.Draw(&cmdBuffer);
-
-    // Draw the floor
-    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *floor_pipeline_);
-    cmdBuffer->vkCmdSetStencilReference(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                        0xAB);
-    cmdBuffer->vkCmdSetStencilWriteMask(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                        0x0F);
-    floor_.Draw(&cmdBuffer);
-
-    // Draw the reflection
-    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *mirror_pipeline_);
-    float blend_constants[4] = {0.5f, 0.5f, 0.5f, 0.5f};
-    cmdBuffer->vkCmdSetBlendConstants(cmdBuffer, blend_constants);
-    cmdBuffer->vkCmdSetStencilReference(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                        0xFF);
-    cmdBuffer->vkCmdSetStencilCompareMask(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                          0x0B);
-    cube_.Draw(&cmdBuffer);
-
-    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    {
+      vulkan::GpuZone zone(gpu_profiler(), &cmdBuffer, "scene");
+      cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                      VK_SUBPASS_CONTENTS_INLINE);
+      if (temporal() && jitter_sample_locations_) {
+        cmdBuffer->vkCmdSetSampleLocationsEXT(cmdBuffer,
+                                              &attachment_sample_location_info);
+      }
+      cmdBuffer->vkCmdBindDescriptorSets(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+          &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
+
+      // Draw the cube
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *cube_pipeline_);
+      cube_.Draw(&cmdBuffer);
+
+      // Draw the floor
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *floor_pipeline_);
+      cmdBuffer->vkCmdSetStencilReference(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
+                                          0xAB);
+      cmdBuffer->vkCmdSetStencilWriteMask(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
+                                          0x0F);
+      floor_.Draw(&cmdBuffer);
+
+      // Draw the reflection
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *mirror_pipeline_);
+      float blend_constants[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+      cmdBuffer->vkCmdSetBlendConstants(cmdBuffer, blend_constants);
+      cmdBuffer->vkCmdSetStencilReference(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
+                                          0xFF);
+      cmdBuffer->vkCmdSetStencilCompareMask(cmdBuffer,
+                                            VK_STENCIL_FACE_FRONT_BIT, 0x0B);
+      cube_.Draw(&cmdBuffer);
+
+      cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    }
+
+    if (temporal()) {
+      RecordTemporalResolve(&cmdBuffer, frame_data);
+    }
 
     (*frame_data->command_buffer_)
         ->vkEndCommandBuffer(*frame_data->command_buffer_);
   }
 
-  virtual void Update(float time_since_last_render) override {
-    model_data_->data().transform = model_data_->data().transform *
-                                    Mat44::FromRotationMatrix(Mat44::RotationY(
-                                        3.14f * time_since_last_render * 0.5f));
-  }
-  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
-                      StencilFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
-    VkSubmitInfo init_submit_info{
-        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-        nullptr,                        // pNext
-        0,                              // waitSemaphoreCount
-        nullptr,                        // pWaitSemaphores
-        nullptr,                        // pWaitDstStageMask,
-        1,                              // commandBufferCount
-        &(frame_data->command_buffer_->get_command_buffer()),
-        0,       // signalSemaphoreCount
-        nullptr  // pSignalSemaphores
-    };
-
-    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
-                                         &init_submit_info,
-                                         static_cast<VkFence>(VK_NULL_HANDLE));
-  }
-
- private:
-  struct CameraData {
-    Mat44 projection_matrix;
-  };
-
-  struct ModelData {
-    Mat44 transform;
-  };
-
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
@@ -560,6 +1104,19 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
 
   containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
   containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+
+  AntiAliasing anti_aliasing_;
+  VkSampleCountFlagBits scene_samples_;
+  // Whether temporal AA jitters the sample locations, rather than the
+  // projection.
+  bool jitter_sample_locations_;
+  uint64_t frame_count_;
+  containers::unique_ptr<vulkan::VkSampler> sampler_;
+  VkDescriptorSetLayoutBinding resolve_bindings_[3];
+  containers::unique_ptr<vulkan::PipelineLayout> resolve_pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> resolve_pipeline_;
+  vulkan::ImagePointer history_images_[2];
+  containers::unique_ptr<vulkan::VkImageView> history_views_[2];
 };
 
 int main_entry(const entry::EntryData* data) {
@@ -100,13 +100,11 @@ class TexturedCubeSample
         nullptr                            // pImmutableSamplers
     };
 
-    sampler_ = containers::make_unique<vulkan::VkSampler>(
-        data_->allocator(),
-        vulkan::CreateSampler(&app()->device(), VK_FILTER_LINEAR,
-                              VK_FILTER_LINEAR,
-                              VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE,
-                              VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE,
-                              VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE));
+    sampler_ = app()->GetSampler(vulkan::GetSamplerCreateInfo(
+        VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+        VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE,
+        VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE,
+        VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE));
 
     pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
         data_->allocator(),
@@ -118,39 +116,36 @@ class TexturedCubeSample
     VkAttachmentReference color_attachment = {
         0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
 
-    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
-        data_->allocator(),
-        app()->CreateRenderPass(
-            {{
-                0,                                         // flags
-                render_format(),                           // format
-                num_samples(),                             // samples
-                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
-                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
-                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
-                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
-            }},  // AttachmentDescriptions
-            {{
-                0,                                // flags
-                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
-                0,                                // inputAttachmentCount
-                nullptr,                          // pInputAttachments
-                1,                                // colorAttachmentCount
-                &color_attachment,                // colorAttachment
-                nullptr,                          // pResolveAttachments
-                nullptr,                          // pDepthStencilAttachment
-                0,                                // preserveAttachmentCount
-                nullptr                           // pPreserveAttachments
-            }},                                   // SubpassDescriptions
-            {}                                    // SubpassDependencies
-            ));
+    render_pass_ = app()->GetRenderPass(
+        {{
+            0,                                         // flags
+            render_format(),                           // format
+            num_samples(),                             // samples
+            VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+            VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+            VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+        }},  // AttachmentDescriptions
+        {{
+            0,                                // flags
+            VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+            0,                                // inputAttachmentCount
+            nullptr,                          // pInputAttachments
+            1,                                // colorAttachmentCount
+            &color_attachment,                // colorAttachment
+            nullptr,                          // pResolveAttachments
+            nullptr,                          // pDepthStencilAttachment
+            0,                                // preserveAttachmentCount
+            nullptr                           // pPreserveAttachments
+        }},                                   // SubpassDescriptions
+        {}                                    // SubpassDependencies
+    );
 
     cube_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
         data_->allocator(),
-        app()->CreateGraphicsPipeline(pipeline_layout_.get(),
-                                      render_pass_.get(), 0));
+        app()->CreateGraphicsPipeline(pipeline_layout_.get(), render_pass_, 0));
     cube_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
                               textured_cube_vertex_shader);
     cube_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
@@ -170,6 +165,8 @@ class TexturedCubeSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -214,7 +211,7 @@ class TexturedCubeSample
         }};
 
     VkDescriptorImageInfo sampler_info = {
-        *sampler_,                 // sampler
+        sampler_,                  // sampler
         VK_NULL_HANDLE,            // imageView
         VK_IMAGE_LAYOUT_UNDEFINED  //  imageLayout
     };
@@ -273,7 +270,7 @@ class TexturedCubeSample
         VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
         nullptr,                                    // pNext
         0,                                          // flags
-        *render_pass_,                              // renderPass
+        render_pass_,                               // renderPass
         1,                                          // attachmentCount
         &raw_view,                                  // attachments
         app()->swapchain().width(),                 // width
@@ -299,7 +296,7 @@ class TexturedCubeSample
     VkRenderPassBeginInfo pass_begin = {
         VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
         nullptr,                                   // pNext
-        *render_pass_,                             // renderPass
+        render_pass_,                              // renderPass
         *frame_data->framebuffer_,                 // framebuffer
         {{0, 0},
          {app()->swapchain().width(),
@@ -333,10 +330,6 @@ class TexturedCubeSample
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       TexturedCubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
@@ -366,11 +359,11 @@ class TexturedCubeSample
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
-  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  vulkan::RenderPassCache::Handle render_pass_;
   VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[4];
   vulkan::VulkanModel cube_;
   vulkan::VulkanTexture texture_;
-  containers::unique_ptr<vulkan::VkSampler> sampler_;
+  vulkan::SamplerCache::Handle sampler_;
 
   containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
   containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
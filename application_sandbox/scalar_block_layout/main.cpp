@@ -16,6 +16,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/shader_layout.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
@@ -35,6 +36,7 @@ const auto& cube_data = cube_model::model;
 uint32_t vertex_shader[] =
 #include "scalar_block_layout.vert.spv"
     ;
+#include "scalar_block_layout.vert.spv.layout.h"
 
 uint32_t fragment_shader[] =
 #include "scalar_block_layout.frag.spv"
@@ -155,6 +157,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
 	color_data_ = containers::make_unique<vulkan::BufferFrameData<ColorData>>(
         data_->allocator(), app(), num_swapchain_images,
@@ -162,7 +166,7 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
-    camera_data_->data().projection_matrix =
+    camera_data_->data().projection =
         Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
         Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
 
@@ -292,9 +296,6 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
     color_data_->UpdateBuffer(queue, frame_index);
 
     VkSubmitInfo init_submit_info{
@@ -316,17 +317,21 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
 
  private:
   struct CameraData {
-    Mat44 projection_matrix;
+    Mat44 projection;
   };
+  CHECK_CAMERA_DATA_LAYOUT(CameraData);
 
   struct ModelData {
     Mat44 transform;
   };
+  CHECK_MODEL_DATA_LAYOUT(ModelData);
 
+  // The colors are in a scalar block, so color2 directly follows color1.
   struct ColorData {
-    Vector3 color1;
-    Vector3 color2;
+    vulkan::ScalarVec3 color1;
+    vulkan::ScalarVec3 color2;
   };
+  CHECK_COLOR_DATA_LAYOUT(ColorData);
 
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
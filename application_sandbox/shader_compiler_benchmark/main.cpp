@@ -0,0 +1,466 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/shader_collection.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+namespace {
+
+std::vector<uint32_t> glslc_glsl_vertex_shader =
+#include "shade.glsl.vert.spv"
+    ;
+
+std::vector<uint32_t> glslc_glsl_fragment_shader =
+#include "shade.glsl.frag.spv"
+    ;
+
+std::vector<uint32_t> glslc_hlsl_vertex_shader =
+#include "shade.glslc.hlsl.vert.spv"
+    ;
+
+std::vector<uint32_t> glslc_hlsl_fragment_shader =
+#include "shade.glslc.hlsl.frag.spv"
+    ;
+
+std::vector<uint32_t> dxc_hlsl_vertex_shader =
+#include "shade.dxc.hlsl.vert.spv"
+    ;
+
+std::vector<uint32_t> dxc_hlsl_fragment_shader =
+#include "shade.dxc.hlsl.frag.spv"
+    ;
+
+std::vector<uint32_t> optimized_glsl_vertex_shader =
+#include "shade.glsl.vert.opt.spv"
+    ;
+
+std::vector<uint32_t> optimized_glsl_fragment_shader =
+#include "shade.glsl.frag.opt.spv"
+    ;
+
+// The number of times the full screen triangle is drawn every frame, unless
+// overdraw=<N> was given.
+const uint32_t kDefaultOverdraw = 4;
+
+// The frames of every compiler that are measured, after the warmup frames,
+// which let the frames in flight and the GPU times of the previous compiler
+// drain.
+const uint32_t kDefaultFramesPerConfig = 120;
+const uint32_t kWarmupFrames = 30;
+
+const std::initializer_list<const char*> kNoExtensions = {};
+const std::initializer_list<const char*> kStatisticsInstanceExtensions = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
+const std::initializer_list<const char*> kStatisticsDeviceExtensions = {
+    VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME};
+
+// Pipeline executable statistics need
+// VK_KHR_pipeline_executable_properties, unless
+// -sample-option=statistics=0.
+bool CaptureStatistics(const entry::EntryData* data) {
+  const char* option = data->sample_option("statistics");
+  return !option || strtoul(option, nullptr, 10) != 0;
+}
+
+VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR
+    pipeline_executable_features = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR,
+        nullptr,  // pNext
+        VK_TRUE,  // pipelineExecutableInfo
+};
+
+sample_application::SampleOptions BenchmarkOptions(
+    const entry::EntryData* data) {
+  sample_application::SampleOptions options;
+  options.EnableGpuProfiler(1);
+  if (CaptureStatistics(data)) {
+    options.AddDeviceExtensionStructure(&pipeline_executable_features);
+  }
+  return options;
+}
+
+struct ShaderCompilerBenchmarkFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+};
+
+// This builds the same pipeline from the SPIR-V of every shader compiler of
+// ShaderCollection that the build had, draws a full screen procedural
+// pattern with each of them in turn, and logs their GPU times and pipeline
+// executable statistics side by side.
+class ShaderCompilerBenchmark
+    : public sample_application::Sample<ShaderCompilerBenchmarkFrameData> {
+ public:
+  ShaderCompilerBenchmark(const entry::EntryData* data)
+      : data_(data),
+        Sample<ShaderCompilerBenchmarkFrameData>(
+            data->allocator(), data, 1, 64, 1, 1, BenchmarkOptions(data), {0},
+            CaptureStatistics(data) ? kStatisticsInstanceExtensions
+                                    : kNoExtensions,
+            CaptureStatistics(data) ? kStatisticsDeviceExtensions
+                                    : kNoExtensions),
+        configs_(data->allocator()),
+        overdraw_(kDefaultOverdraw),
+        frames_per_config_(kDefaultFramesPerConfig),
+        config_index_(0),
+        config_frame_(0),
+        done_(false),
+        gpu_time_(0.0),
+        num_gpu_times_(0),
+        best_config_(0),
+        best_gpu_time_(-1.0) {
+    const char* frames_option = data->sample_option("frames_per_config");
+    if (frames_option) {
+      frames_per_config_ =
+          static_cast<uint32_t>(strtoul(frames_option, nullptr, 10));
+    }
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+    const char* overdraw_option = data->sample_option("overdraw");
+    if (overdraw_option) {
+      overdraw_ = static_cast<uint32_t>(strtoul(overdraw_option, nullptr, 10));
+    }
+    if (overdraw_ == 0) {
+      overdraw_ = 1;
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(), app()->CreatePipelineLayout({{}}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    const char* compiler_option = data_->sample_option("compiler");
+    for (size_t i = 0; i < vulkan::ShaderCollection::kNumCompilers; ++i) {
+      const char* compiler = vulkan::ShaderCollection::compiler_name(i);
+      if (compiler_option && strcmp(compiler_option, compiler) != 0) {
+        continue;
+      }
+      vulkan::ShaderCollection shaders(
+          data_->logger(), compiler, glslc_glsl_vertex_shader,
+          glslc_glsl_fragment_shader, glslc_hlsl_vertex_shader,
+          glslc_hlsl_fragment_shader, dxc_hlsl_vertex_shader,
+          dxc_hlsl_fragment_shader, &optimized_glsl_vertex_shader,
+          &optimized_glsl_fragment_shader);
+      if (!shaders.available()) {
+        app()->GetLogger()->LogInfo("BENCHMARK: compiler: ", compiler,
+                                    " is skipped, it was not built");
+        continue;
+      }
+      configs_.push_back(Config());
+      Config& config = configs_.back();
+      config.compiler = compiler;
+      config.spirv_words = shaders.vertexShaderWordCount() +
+                           shaders.fragmentShaderWordCount();
+      config.pipeline = CreatePipeline(&shaders);
+      if (CaptureStatistics(data_)) {
+        LogStatistics(config);
+      }
+    }
+    if (configs_.empty()) {
+      app()->GetLogger()->LogError("Unknown or unbuilt compiler ",
+                                   compiler_option);
+      done_ = true;
+    }
+  }
+
+  virtual void InitializeFrameData(
+      ShaderCompilerBenchmarkFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    ::VkImageView raw_view = color_view(frame_data);
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {}
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      ShaderCompilerBenchmarkFrameData* frame_data) override {
+    const Config& config = configs_[config_index_];
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    const uint32_t zone =
+        gpu_profiler()->BeginZone(&cmdBuffer, config.compiler, false);
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *config.pipeline);
+    cmdBuffer->vkCmdDraw(cmdBuffer, 3, overdraw_, 0, 0);
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, zone);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (config_frame_ >= kWarmupFrames) {
+      // The GPU time is the one of the last frame that finished.
+      const float gpu_time = gpu_profiler()->GetLastZoneTime(config.compiler);
+      if (gpu_time >= 0.0f) {
+        gpu_time_ += gpu_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      const double average =
+          num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0;
+      app()->GetLogger()->LogInfo(
+          "BENCHMARK: compiler: ", config.compiler,
+          " spirv_words: ", config.spirv_words, " overdraw: ", overdraw_,
+          " gpu: ", average, "ms");
+      if (average >= 0.0 &&
+          (best_gpu_time_ < 0.0 || average < best_gpu_time_)) {
+        best_config_ = config_index_;
+        best_gpu_time_ = average;
+      }
+      config_frame_ = 0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (++config_index_ == configs_.size()) {
+        if (best_gpu_time_ >= 0.0) {
+          app()->GetLogger()->LogInfo(
+              "BENCHMARK_BEST: compiler: ", configs_[best_config_].compiler,
+              " gpu: ", best_gpu_time_, "ms");
+        }
+        done_ = true;
+        config_index_ = 0;
+      }
+    }
+  }
+
+  // Returns true once every compiler has been measured.
+  bool benchmark_done() const { return done_; }
+
+ private:
+  // The pipeline of one compiler.
+  struct Config {
+    // The name of the compiler in ShaderCollection, in the sample options
+    // and the results, and the name of its GPU zone.
+    const char* compiler;
+    // The size of the SPIR-V of both shaders.
+    uint32_t spirv_words;
+    containers::unique_ptr<vulkan::VulkanGraphicsPipeline> pipeline;
+  };
+
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreatePipeline(
+      vulkan::ShaderCollection* shaders) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                        shaders->vertexShader(),
+                        shaders->vertexShaderWordCount());
+    pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                        shaders->fragmentShader(),
+                        shaders->fragmentShaderWordCount());
+    pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline->SetViewport(viewport());
+    pipeline->SetScissor(scissor());
+    pipeline->SetSamples(num_samples());
+    pipeline->AddAttachment();
+    if (CaptureStatistics(data_)) {
+      pipeline->flags() = VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR;
+    }
+    pipeline->Commit();
+    return pipeline;
+  }
+
+  // Logs a SHADER_STATS: line for every statistic of every executable of
+  // the pipeline of |config|.
+  void LogStatistics(const Config& config) {
+    vulkan::VkDevice& device = app()->device();
+    logging::Logger* log = app()->GetLogger();
+    VkPipelineInfoKHR pipeline_info{VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR,
+                                    nullptr, *config.pipeline};
+    uint32_t executable_count = 0;
+    device->vkGetPipelineExecutablePropertiesKHR(device, &pipeline_info,
+                                                 &executable_count, nullptr);
+    containers::vector<VkPipelineExecutablePropertiesKHR> executables(
+        executable_count,
+        {VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR, nullptr},
+        data_->allocator());
+    device->vkGetPipelineExecutablePropertiesKHR(
+        device, &pipeline_info, &executable_count, executables.data());
+
+    for (uint32_t i = 0; i < executable_count; ++i) {
+      VkPipelineExecutableInfoKHR executable_info{
+          VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR, nullptr,
+          *config.pipeline, i};
+      uint32_t statistic_count = 0;
+      device->vkGetPipelineExecutableStatisticsKHR(device, &executable_info,
+                                                   &statistic_count, nullptr);
+      containers::vector<VkPipelineExecutableStatisticKHR> statistics(
+          statistic_count,
+          {VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR, nullptr},
+          data_->allocator());
+      device->vkGetPipelineExecutableStatisticsKHR(
+          device, &executable_info, &statistic_count, statistics.data());
+
+      for (const auto& s : statistics) {
+        switch (s.format) {
+          case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
+            log->LogInfo("SHADER_STATS: compiler: ", config.compiler,
+                         " executable: ", executables[i].name,
+                         " statistic: ", s.name, " value: ", s.value.b32);
+            break;
+          case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+            log->LogInfo("SHADER_STATS: compiler: ", config.compiler,
+                         " executable: ", executables[i].name,
+                         " statistic: ", s.name, " value: ", s.value.i64);
+            break;
+          case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+            log->LogInfo("SHADER_STATS: compiler: ", config.compiler,
+                         " executable: ", executables[i].name,
+                         " statistic: ", s.name, " value: ", s.value.u64);
+            break;
+          case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR:
+            log->LogInfo("SHADER_STATS: compiler: ", config.compiler,
+                         " executable: ", executables[i].name,
+                         " statistic: ", s.name, " value: ", s.value.f64);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+
+  // The compilers that are measured, one after the other, in the order of
+  // ShaderCollection::compiler_name().
+  containers::vector<Config> configs_;
+  uint32_t overdraw_;
+  uint32_t frames_per_config_;
+  size_t config_index_;
+  uint32_t config_frame_;
+  bool done_;
+  // The sum of the GPU times of the measured frames of the current
+  // compiler, in milliseconds.
+  double gpu_time_;
+  uint32_t num_gpu_times_;
+  // The compiler with the lowest average GPU time so far.
+  size_t best_config_;
+  double best_gpu_time_;
+};
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  ShaderCompilerBenchmark sample(data);
+  if (!sample.is_valid()) {
+    data->logger()->LogInfo(
+        "The device does not support VK_KHR_pipeline_executable_properties, "
+        "run with -sample-option=statistics=0");
+    return -1;
+  }
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing() &&
+         !sample.benchmark_done()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
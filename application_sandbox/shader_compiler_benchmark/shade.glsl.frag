@@ -0,0 +1,34 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// A procedural pattern with a loop and enough arithmetic for the compilers
+// to make a difference, the same as shade.hlsl.frag.
+const int kIterations = 24;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    vec2 p = gl_FragCoord.xy * 0.004;
+    vec3 color = vec3(0.0);
+    for (int i = 0; i < kIterations; ++i) {
+        float f = float(i);
+        p = vec2(p.x * p.x - p.y * p.y, 2.0 * p.x * p.y) * 0.5 +
+            vec2(sin(p.y + f), cos(p.x - f)) * 0.5;
+        color += 0.5 + 0.5 * cos(vec3(0.0, 2.0, 4.0) + length(p) + f * 0.1);
+    }
+    out_color = vec4(color / float(kIterations), 1.0);
+}
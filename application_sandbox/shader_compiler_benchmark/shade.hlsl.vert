@@ -0,0 +1,21 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A triangle that covers the whole framebuffer, without vertex buffers, the
+// same as shade.glsl.vert.
+float4 main(uint vertex_id : SV_VertexID) : SV_POSITION {
+  float2 uv = float2((vertex_id << 1) & 2, vertex_id & 2);
+  return float4(uv * 2.0 - 1.0, 0.5, 1.0);
+}
@@ -16,6 +16,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/occupancy_estimator.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
@@ -137,6 +138,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -196,6 +199,22 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     app()->GetLogger()->LogInfo(
         "VGPRs are allocated in groups of this size: ",
         shader_core_properties.vgprAllocationGranularity);
+
+    // What the limits mean for the occupancy of shaders with as many VGPRs.
+    vulkan::OccupancyEstimator estimator(app()->instance(),
+                                         app()->device().physical_device());
+    const uint32_t kVgprCounts[] = {16, 24, 32, 48, 64, 96, 128, 256};
+    for (uint32_t vgprs : kVgprCounts) {
+      const vulkan::ShaderResources resources = {
+          vgprs,  // vgprs
+          0,      // sgprs
+          0       // lds_bytes
+      };
+      app()->GetLogger()->LogInfo(
+          "Wavefronts per SIMD with ", vgprs,
+          " VGPRs: ", estimator.WavefrontsPerSimd(resources),
+          " (occupancy ", estimator.Occupancy(resources), ")");
+    }
   }
 
   virtual void InitializeFrameData(
@@ -306,10 +325,6 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
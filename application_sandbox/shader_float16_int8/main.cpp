@@ -16,6 +16,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/structure_chain.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
@@ -39,23 +40,9 @@ uint32_t fragment_shader[] =
 #include "shader_float16_int8.frag.spv"
     ;
 
-static VkPhysicalDeviceShaderFloat16Int8FeaturesKHR
-    float_sixteen_int_eight_feature{
-        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR,
-        nullptr,  // pNext;
-        true,     // shaderFloat16;
-        true,     // shaderInt8;
-    };
-
-static VkPhysicalDevice8BitStorageFeaturesKHR eight_bit_storage_feature{
-    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES_KHR,
-    &float_sixteen_int_eight_feature,  // pNext;
-    true,     // storageBuffer8BitAccess;
-    true,     // uniformAndStorageBuffer8BitAccess;
-    false     // storagePushConstant8;
-};
-
-static void* device_extension_list = &eight_bit_storage_feature;
+using DeviceFeatures =
+    vulkan::StructureChain<VkPhysicalDevice8BitStorageFeaturesKHR,
+                           VkPhysicalDeviceShaderFloat16Int8FeaturesKHR>;
 
 struct CubeFrameData {
   containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
@@ -67,13 +54,13 @@ struct CubeFrameData {
 // for host, and device buffer sizes.
 class CubeSample : public sample_application::Sample<CubeFrameData> {
  public:
-  CubeSample(const entry::EntryData* data)
+  CubeSample(const entry::EntryData* data, DeviceFeatures* device_features)
       : data_(data),
         Sample<CubeFrameData>(
             data->allocator(), data, 1, 512, 1, 1,
             sample_application::SampleOptions()
                 .EnableMultisampling()
-                .AddDeviceExtensionStructure(device_extension_list),
+                .AddDeviceExtensionStructure(device_features->head()),
             {0}, {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
             {VK_KHR_STORAGE_BUFFER_STORAGE_CLASS_EXTENSION_NAME,
              VK_KHR_8BIT_STORAGE_EXTENSION_NAME,
@@ -167,6 +154,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     color_data_ = containers::make_unique<vulkan::BufferFrameData<ColorData>>(
         data_->allocator(), app(), num_swapchain_images,
@@ -300,9 +289,6 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
     color_data_->UpdateBuffer(queue, frame_index);
 
     VkSubmitInfo init_submit_info{
@@ -351,7 +337,16 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
 
 int main_entry(const entry::EntryData* data) {
   data->logger()->LogInfo("Application Startup");
-  CubeSample sample(data);
+  DeviceFeatures device_features;
+  auto& eight_bit_storage =
+      device_features.get<VkPhysicalDevice8BitStorageFeaturesKHR>();
+  eight_bit_storage.storageBuffer8BitAccess = VK_TRUE;
+  eight_bit_storage.uniformAndStorageBuffer8BitAccess = VK_TRUE;
+  auto& float16_int8 =
+      device_features.get<VkPhysicalDeviceShaderFloat16Int8FeaturesKHR>();
+  float16_int8.shaderFloat16 = VK_TRUE;
+  float16_int8.shaderInt8 = VK_TRUE;
+  CubeSample sample(data, &device_features);
   sample.Initialize();
 
   while (!sample.should_exit() && !data->WindowClosing()) {
@@ -39,8 +39,13 @@ uint32_t cube_fragment_shader[] =
 #include "cube.frag.spv"
     ;
 
+// Every frame only renders one horizontal band of the shared image, the one
+// below the band of the last frame, so that the updates race the scanout
+// down the screen.
+const uint32_t kNumBands = 4;
+
 struct CubeFrameData {
-  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
+  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffers_[kNumBands];
   containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
   containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
 };
@@ -53,11 +58,13 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
       : data_(data),
         Sample<CubeFrameData>(
             data->allocator(), data, 1, 512, 1, 1,
-            sample_application::SampleOptions().EnableSharedPresentation(), {0},
+            sample_application::SampleOptions().EnableLowLatencyPresentation(),
+            {0},
             {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
              VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME},
             {VK_KHR_SHARED_PRESENTABLE_IMAGE_EXTENSION_NAME}),
-        cube_(data->allocator(), data->logger(), cube_data) {}
+        cube_(data->allocator(), data->logger(), cube_data),
+        next_band_(0) {}
   virtual void InitializeApplicationData(
       vulkan::VkCommandBuffer* initialization_buffer,
       size_t num_swapchain_images) override {
@@ -127,6 +134,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     cube_pipeline_->SetInputStreams(&cube_);
     cube_pipeline_->SetViewport(viewport());
     cube_pipeline_->SetScissor(scissor());
+    // Each band is scissored to itself.
+    cube_pipeline_->AddDynamicState(VK_DYNAMIC_STATE_SCISSOR);
     cube_pipeline_->SetSamples(num_samples());
     cube_pipeline_->AddAttachment();
     cube_pipeline_->Commit();
@@ -138,6 +147,8 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -152,10 +163,6 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   virtual void InitializeFrameData(
       CubeFrameData* frame_data, vulkan::VkCommandBuffer* initialization_buffer,
       size_t frame_index) override {
-    frame_data->command_buffer_ =
-        containers::make_unique<vulkan::VkCommandBuffer>(
-            data_->allocator(), app()->GetCommandBuffer());
-
     frame_data->cube_descriptor_set_ =
         containers::make_unique<vulkan::DescriptorSet>(
             data_->allocator(),
@@ -212,40 +219,52 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
         data_->allocator(),
         vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
 
-    (*frame_data->command_buffer_)
-        ->vkBeginCommandBuffer((*frame_data->command_buffer_),
-                               &sample_application::kBeginCommandBuffer);
-    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
-
     VkClearValue clear;
     vulkan::MemoryClear(&clear);
 
-    VkRenderPassBeginInfo pass_begin = {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        nullptr,                                   // pNext
-        *render_pass_,                             // renderPass
-        *frame_data->framebuffer_,                 // framebuffer
-        {{0, 0},
-         {app()->swapchain().width(),
-          app()->swapchain().height()}},  // renderArea
-        1,                                // clearValueCount
-        &clear                            // clears
-    };
-
-    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
-                                    VK_SUBPASS_CONTENTS_INLINE);
-
-    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *cube_pipeline_);
-    cmdBuffer->vkCmdBindDescriptorSets(
-        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
-        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
-    cube_.Draw(&cmdBuffer);
-    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
-
-    (*frame_data->command_buffer_)
-        ->vkEndCommandBuffer(*frame_data->command_buffer_);
+    const uint32_t band_height = app()->swapchain().height() / kNumBands;
+    for (uint32_t i = 0; i < kNumBands; ++i) {
+      // The load op only clears the render area, the other bands keep what
+      // the earlier frames rendered.
+      const int32_t band_y = static_cast<int32_t>(i * band_height);
+      const VkRect2D band = {
+          {0, band_y},
+          {app()->swapchain().width(),
+           i + 1 == kNumBands ? app()->swapchain().height() - band_y
+                              : band_height}};
+
+      frame_data->command_buffers_[i] =
+          containers::make_unique<vulkan::VkCommandBuffer>(
+              data_->allocator(), app()->GetCommandBuffer());
+      vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffers_[i]);
+      cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                      &sample_application::kBeginCommandBuffer);
+
+      VkRenderPassBeginInfo pass_begin = {
+          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+          nullptr,                                   // pNext
+          *render_pass_,                             // renderPass
+          *frame_data->framebuffer_,                 // framebuffer
+          band,                                      // renderArea
+          1,                                         // clearValueCount
+          &clear                                     // clears
+      };
+
+      cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                      VK_SUBPASS_CONTENTS_INLINE);
+
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *cube_pipeline_);
+      cmdBuffer->vkCmdSetScissor(cmdBuffer, 0, 1, &band);
+      cmdBuffer->vkCmdBindDescriptorSets(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+          &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
+      cube_.Draw(&cmdBuffer);
+      cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+
+      cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+    }
   }
 
   virtual void Update(float time_since_last_render) override {
@@ -257,10 +276,6 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       CubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
@@ -268,7 +283,7 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
         nullptr,                        // pWaitSemaphores
         nullptr,                        // pWaitDstStageMask,
         1,                              // commandBufferCount
-        &(frame_data->command_buffer_->get_command_buffer()),
+        &(frame_data->command_buffers_[next_band_]->get_command_buffer()),
         0,       // signalSemaphoreCount
         nullptr  // pSignalSemaphores
     };
@@ -276,6 +291,7 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
     app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
                                          &init_submit_info,
                                          static_cast<VkFence>(VK_NULL_HANDLE));
+    next_band_ = (next_band_ + 1) % kNumBands;
   }
 
  private:
@@ -296,6 +312,7 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
 
   containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
   containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+  uint32_t next_band_;
 };
 
 int main_entry(const entry::EntryData* data) {
@@ -0,0 +1,441 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/frame_time_recorder.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t sparse_bind_work_shader[] =
+#include "sparse_bind_work.comp.spv"
+    ;
+
+namespace {
+// This must match local_size_x in sparse_bind_work.comp.
+const uint32_t kWorkGroupSize = 64;
+const uint32_t kWorkGroups = 256;
+const uint32_t kDefaultWorkIterations = 1 << 20;
+
+// The number of pages of every measurement, and how many of them every
+// vkQueueBindSparse call binds. Both are limited by the max_pages option.
+const uint32_t kPageCounts[] = {16, 256, 4096};
+const uint32_t kBatchSizes[] = {1, 16, 256, 4096};
+const uint32_t kDefaultMaxPages = 4096;
+// The batch size of the binds that run next to the work.
+const uint32_t kConcurrentBatchSize = 16;
+// Every measurement is repeated this many times.
+const uint32_t kNumRuns = 20;
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+VkPhysicalDeviceFeatures SparseBindingFeatures() {
+  VkPhysicalDeviceFeatures features = {0};
+  features.sparseBinding = VK_TRUE;
+  return features;
+}
+
+// Measures how long vkQueueBindSparse takes to bind and unbind pages of a
+// sparse buffer, for different numbers of pages and of pages per call, and
+// how binding slows down compute work that runs at the same time.
+class SparseBindBenchmark {
+ public:
+  SparseBindBenchmark(const entry::EntryData* data,
+                      vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        max_pages_(data->sample_option_uint("max_pages", kDefaultMaxPages)),
+        work_iterations_(data->sample_option_uint("work_iterations",
+                                                  kDefaultWorkIterations)),
+        page_size_(0),
+        timestamp_mask_(0),
+        bind_fence_(vulkan::CreateFence(&app->device())),
+        work_fence_(vulkan::CreateFence(&app->device())),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        memory_(VK_NULL_HANDLE, nullptr, &app->device()),
+        sparse_buffer_(VK_NULL_HANDLE, nullptr, &app->device()),
+        binds_(data->allocator()) {
+    vulkan::VkDevice& device = app->device();
+    logging::Logger* log = data->logger();
+
+    // A sparse buffer of max_pages_ pages, with a single allocation behind it
+    // that every page has a fixed place in.
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        VK_BUFFER_CREATE_SPARSE_BINDING_BIT,   // flags
+        0,                                     // size
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,    // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr                                // pQueueFamilyIndices
+    };
+    // The page size is the alignment of the buffer, which does not depend
+    // on its size.
+    VkMemoryRequirements requirements;
+    {
+      create_info.size = 1;
+      ::VkBuffer buffer;
+      LOG_ASSERT(==, log, VK_SUCCESS,
+                 device->vkCreateBuffer(device, &create_info, nullptr,
+                                        &buffer));
+      device->vkGetBufferMemoryRequirements(device, buffer, &requirements);
+      device->vkDestroyBuffer(device, buffer, nullptr);
+    }
+    page_size_ = requirements.alignment;
+    create_info.size = page_size_ * max_pages_;
+    ::VkBuffer buffer;
+    LOG_ASSERT(==, log, VK_SUCCESS,
+               device->vkCreateBuffer(device, &create_info, nullptr, &buffer));
+    sparse_buffer_.reset(buffer);
+    device->vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
+        nullptr,                                 // pNext
+        requirements.size,                       // allocationSize
+        vulkan::GetMemoryIndex(&device, log, requirements.memoryTypeBits,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        // memoryTypeIndex
+    };
+    ::VkDeviceMemory memory;
+    LOG_ASSERT(==, log, VK_SUCCESS,
+               device->vkAllocateMemory(device, &allocate_info, nullptr,
+                                        &memory));
+    memory_.reset(memory);
+
+    binds_.reserve(max_pages_);
+    for (uint32_t i = 0; i < max_pages_; ++i) {
+      binds_.push_back({
+          page_size_ * i,  // resourceOffset
+          page_size_,      // size
+          VK_NULL_HANDLE,  // memory
+          page_size_ * i,  // memoryOffset
+          0                // flags
+      });
+    }
+
+    // The work that runs next to the binds has resources of its own.
+    binding_ = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(uint32_t)              // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(), app->CreatePipelineLayout({{binding_}}, {range}));
+    pipeline_ = containers::make_unique<vulkan::VulkanComputePipeline>(
+        data->allocator(),
+        app->CreateComputePipeline(
+            pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                sizeof(sparse_bind_work_shader), sparse_bind_work_shader},
+            "main"));
+    work_buffer_ = app->CreateAndBindDefaultExclusiveDeviceBuffer(
+        kWorkGroups * kWorkGroupSize * sizeof(float),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    work_set_ = containers::make_unique<vulkan::DescriptorSet>(
+        data->allocator(), app->AllocateDescriptorSet({binding_}));
+    VkDescriptorBufferInfo buffer_info = {
+        *work_buffer_,  // buffer
+        0,              // offset
+        VK_WHOLE_SIZE,  // range
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *work_set_,                              // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        1,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        &buffer_info,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    device->vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+  }
+
+  void Run() {
+    data_->logger()->LogInfo("SPARSE: page_size: ", page_size_,
+                             " max_pages: ", max_pages_);
+    for (uint32_t pages : kPageCounts) {
+      if (pages > max_pages_) {
+        continue;
+      }
+      for (uint32_t batch : kBatchSizes) {
+        if (batch > pages) {
+          continue;
+        }
+        vulkan::FrameTimeRecorder bind_times(data_->allocator(), kNumRuns);
+        vulkan::FrameTimeRecorder unbind_times(data_->allocator(), kNumRuns);
+        for (uint32_t run = 0; run < kNumRuns; ++run) {
+          bind_times.Record(Bind(pages, batch, true));
+          unbind_times.Record(Bind(pages, batch, false));
+        }
+        LogTimes("bind", pages, batch, bind_times);
+        LogTimes("unbind", pages, batch, unbind_times);
+      }
+    }
+    MeasureConcurrentWork();
+  }
+
+ private:
+  // Binds the first |pages| pages of the buffer, or unbinds them if |bind|
+  // is false, with |batch| pages per vkQueueBindSparse call. Returns the
+  // time from the first call until the fence of the last one is signaled,
+  // in seconds.
+  float Bind(uint32_t pages, uint32_t batch, bool bind) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->sparse_binding_queue();
+    for (uint32_t i = 0; i < pages; ++i) {
+      binds_[i].memory = bind ? static_cast<::VkDeviceMemory>(memory_)
+                              : static_cast<::VkDeviceMemory>(VK_NULL_HANDLE);
+    }
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t first = 0; first < pages; first += batch) {
+      VkSparseBufferMemoryBindInfo buffer_bind = {
+          sparse_buffer_,       // buffer
+          batch,                // bindCount
+          binds_.data() + first  // pBinds
+      };
+      VkBindSparseInfo bind_info = {
+          VK_STRUCTURE_TYPE_BIND_SPARSE_INFO,  // sType
+          nullptr,                             // pNext
+          0,                                   // waitSemaphoreCount
+          nullptr,                             // pWaitSemaphores
+          1,                                   // bufferBindCount
+          &buffer_bind,                        // pBufferBinds
+          0,                                   // imageOpaqueBindCount
+          nullptr,                             // pImageOpaqueBinds
+          0,                                   // imageBindCount
+          nullptr,                             // pImageBinds
+          0,                                   // signalSemaphoreCount
+          nullptr                              // pSignalSemaphores
+      };
+      const bool last = first + batch >= pages;
+      LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+                 queue->vkQueueBindSparse(
+                     queue, 1, &bind_info,
+                     last ? static_cast<::VkFence>(bind_fence_)
+                          : static_cast<::VkFence>(VK_NULL_HANDLE)));
+    }
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkWaitForFences(device, 1,
+                                       &bind_fence_.get_raw_object(), VK_TRUE,
+                                       0xFFFFFFFFFFFFFFFF));
+    const auto end = std::chrono::high_resolution_clock::now();
+    device->vkResetFences(device, 1, &bind_fence_.get_raw_object());
+    return std::chrono::duration<float>(end - start).count();
+  }
+
+  void LogTimes(const char* op, uint32_t pages, uint32_t batch,
+                const vulkan::FrameTimeRecorder& times) {
+    const vulkan::FrameTimeRecorder::Statistics stats =
+        times.ComputeStatistics(0.0f);
+    data_->logger()->LogInfo(
+        "SPARSE: op: ", op, " pages: ", pages, " batch: ", batch,
+        " calls: ", pages / batch, " min_ms: ", stats.min * 1000.0f,
+        " p50_ms: ", stats.p50 * 1000.0f, " p90_ms: ", stats.p90 * 1000.0f,
+        " pages_per_second: ", stats.p50 > 0.0f ? pages / stats.p50 : 0.0f);
+  }
+
+  // Runs the work on the render queue once, and returns its GPU time in
+  // milliseconds, or a negative number if it could not be measured. If
+  // |bind_seconds| is not nullptr, every page is bound and unbound again
+  // while the work runs, and it is set to the time that took.
+  double RunWork(float* bind_seconds) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+    cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             query_pool_, 0);
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline_);
+    cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *pipeline_layout_, 0, 1,
+                                 &work_set_->raw_set(), 0, nullptr);
+    cmd->vkCmdPushConstants(cmd, *pipeline_layout_,
+                            VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                            sizeof(work_iterations_), &work_iterations_);
+    cmd->vkCmdDispatch(cmd, kWorkGroups, 1, 1);
+    cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             query_pool_, 1);
+    cmd->vkEndCommandBuffer(cmd);
+
+    VkSubmitInfo submit_info = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask
+        1,                              // commandBufferCount
+        &cmd.get_command_buffer(),      // pCommandBuffers
+        0,                              // signalSemaphoreCount
+        nullptr                         // pSignalSemaphores
+    };
+    queue->vkQueueSubmit(queue, 1, &submit_info, work_fence_);
+    if (bind_seconds) {
+      *bind_seconds = Bind(max_pages_, kConcurrentBatchSize, true) +
+                      Bind(max_pages_, kConcurrentBatchSize, false);
+    }
+    device->vkWaitForFences(device, 1, &work_fence_.get_raw_object(), VK_TRUE,
+                            0xFFFFFFFFFFFFFFFF);
+    device->vkResetFences(device, 1, &work_fence_.get_raw_object());
+
+    uint64_t timestamps[2];
+    if (timestamp_mask_ == 0 ||
+        device->vkGetQueryPoolResults(
+            device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+      return -1.0;
+    }
+    return ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+           static_cast<double>(device.limits().timestampPeriod) / 1.0e6;
+  }
+
+  // Compares the GPU time of the work on its own with the time while pages
+  // are bound on the sparse binding queue, and the time of the binds with
+  // and without the work. If the sparse binding queue is the render queue,
+  // the binds wait for the work instead of running next to it.
+  void MeasureConcurrentWork() {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    timestamp_mask_ =
+        valid_bits == 0
+            ? 0
+            : valid_bits >= 64 ? ~uint64_t(0)
+                               : (uint64_t(1) << valid_bits) - 1;
+    if (valid_bits == 0) {
+      data_->logger()->LogError(
+          "The render queue does not support timestamps, the work is not "
+          "timed");
+    }
+    const uint32_t batch = std::min(kConcurrentBatchSize, max_pages_);
+
+    // The first run warms up the pipeline.
+    RunWork(nullptr);
+    double work_alone = -1.0;
+    double work_with_binds = -1.0;
+    float binds_alone = 0.0f;
+    float binds_with_work = 0.0f;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      const double alone = RunWork(nullptr);
+      float bind_seconds = 0.0f;
+      const double with_binds = RunWork(&bind_seconds);
+      const float binds = Bind(max_pages_, batch, true) +
+                          Bind(max_pages_, batch, false);
+      if (run == 0 || alone < work_alone) {
+        work_alone = alone;
+      }
+      if (run == 0 || with_binds < work_with_binds) {
+        work_with_binds = with_binds;
+      }
+      if (run == 0 || binds < binds_alone) {
+        binds_alone = binds;
+      }
+      if (run == 0 || bind_seconds < binds_with_work) {
+        binds_with_work = bind_seconds;
+      }
+    }
+    const bool same_queue =
+        &app_->sparse_binding_queue() == &app_->render_queue();
+    data_->logger()->LogInfo(
+        "SPARSE: concurrent_work: pages: ", max_pages_, " batch: ", batch,
+        " same_queue: ", same_queue ? 1 : 0, " work_ms_alone: ", work_alone,
+        " work_ms_with_binds: ", work_with_binds,
+        " bind_unbind_ms_alone: ", binds_alone * 1000.0f,
+        " bind_unbind_ms_with_work: ", binds_with_work * 1000.0f);
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t max_pages_;
+  uint32_t work_iterations_;
+  ::VkDeviceSize page_size_;
+  uint64_t timestamp_mask_;
+  vulkan::VkFence bind_fence_;
+  vulkan::VkFence work_fence_;
+  vulkan::VkQueryPool query_pool_;
+  // The buffer is destroyed before the memory.
+  vulkan::VkDeviceMemory memory_;
+  vulkan::VkBuffer sparse_buffer_;
+  // One bind per page, the memory is set for every call.
+  containers::vector<VkSparseMemoryBind> binds_;
+  VkDescriptorSetLayoutBinding binding_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> pipeline_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> work_buffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> work_set_;
+};
+}  // anonymous namespace
+
+// This sample measures the cost of vkQueueBindSparse on the sparse binding
+// queue, with the pages of a sparse buffer. It logs the time to bind and to
+// unbind every number of pages with every number of pages per call:
+//   SPARSE: op: <bind|unbind> pages: <n> batch: <n> calls: <n> min_ms: <ms>
+//       p50_ms: <ms> p90_ms: <ms> pages_per_second: <n>
+// and how binds and compute work on the render queue slow each other down:
+//   SPARSE: concurrent_work: pages: <n> batch: <n> same_queue: <0|1>
+//       work_ms_alone: <ms> work_ms_with_binds: <ms>
+//       bind_unbind_ms_alone: <ms> bind_unbind_ms_with_work: <ms>
+// -sample-option=max_pages=<n> limits the number of pages, and
+// work_iterations sets how long the work takes.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data, {},
+                                {}, SparseBindingFeatures(), 1024 * 1024,
+                                1024 * 1024, 1024 * 1024, 1024 * 1024, false,
+                                true);
+  SparseBindBenchmark benchmark(data, &app);
+  benchmark.Run();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
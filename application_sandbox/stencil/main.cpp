@@ -170,7 +170,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     cube_pipeline_->SetScissor(scissor());
     cube_pipeline_->SetSamples(num_samples());
     cube_pipeline_->AddAttachment();
-    cube_pipeline_->Commit();
+    cube_pipeline_->CommitAsync(app()->pipeline_compiler());
 
     // Initialize floor shaders
     floor_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
@@ -196,7 +196,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     floor_pipeline_->DepthStencilState().front.compareOp = VK_COMPARE_OP_ALWAYS;
     floor_pipeline_->DepthStencilState().front.passOp = VK_STENCIL_OP_REPLACE;
 
-    floor_pipeline_->Commit();
+    floor_pipeline_->CommitAsync(app()->pipeline_compiler());
 
     // Initialize mirror pipeline
     mirror_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
@@ -237,7 +237,7 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     // Disable depth test, so the reflection can be shown on the floor.
     mirror_pipeline_->DepthStencilState().depthTestEnable = VK_FALSE;
 
-    mirror_pipeline_->Commit();
+    mirror_pipeline_->CommitAsync(app()->pipeline_compiler());
 
     // Transformation data for viewing and cube/floor rotation.
     camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
@@ -247,6 +247,8 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -420,10 +422,6 @@ class StencilSample : public sample_application::Sample<StencilFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       StencilFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
@@ -0,0 +1,464 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/frame_time_recorder.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace {
+const uint32_t kDefaultSamples = 1000;
+// The number of command buffers that the batching tests submit at once. The
+// semaphore tests need two of them.
+const uint32_t kDefaultBatchSize = 16;
+const uint32_t kMinBatchSize = 2;
+// The number of bytes every small command buffer fills.
+const VkDeviceSize kFillSize = 256;
+// Samples that take longer than this are counted as over budget, in seconds.
+const float kLatencyBudget = 0.001f;
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    0,                                            // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+const VkPipelineStageFlags kWaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+VkSubmitInfo EmptySubmitInfo() {
+  return {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      0,                              // commandBufferCount
+      nullptr,                        // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+}
+
+// Measures how long it takes the host to submit work to a queue, and how
+// long it takes until the host or another submission sees that the work is
+// done, for the different ways of waiting. Every test is run many times, and
+// the distribution of the times is logged.
+class SubmitLatency {
+ public:
+  typedef float (SubmitLatency::*TestFunction)();
+
+  struct TestInfo {
+    // The name of the test in the sample options and the results.
+    const char* name;
+    // Whether the test needs the async compute queue.
+    bool cross_queue;
+    // Runs the test once, and returns the measured time in seconds.
+    TestFunction function;
+  };
+
+  SubmitLatency(const entry::EntryData* data, vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        compute_queue_(app->async_compute_queue()),
+        num_samples_(data->sample_option_uint("samples", kDefaultSamples)),
+        batch_size_(std::max(
+            kMinBatchSize,
+            data->sample_option_uint("batch_size", kDefaultBatchSize))),
+        fence_(vulkan::CreateFence(&app->device())),
+        binary_semaphore_(vulkan::CreateSemaphore(&app->device())),
+        timeline_semaphore_(
+            vulkan::CreateTimelineSemaphore(&app->device(), 0)),
+        timeline_value_(0),
+        render_commands_(data->allocator()),
+        compute_commands_(data->allocator()) {
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        kFillSize * batch_size_,               // size
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr                                // pQueueFamilyIndices
+    };
+    buffer_ = app->CreateAndBindDeviceBuffer(&create_info);
+
+    // Every command buffer of a batch fills its own range of the buffer, so
+    // the command buffers of a batch do not depend on each other.
+    render_commands_.reserve(batch_size_);
+    for (uint32_t i = 0; i < batch_size_; ++i) {
+      render_commands_.push_back(
+          RecordFill(app->render_queue().index(), kFillSize * i));
+    }
+    if (compute_queue_) {
+      compute_commands_.push_back(RecordFill(compute_queue_->index(), 0));
+    }
+  }
+
+  void Run(const char* only_test) {
+    const TestInfo tests[] = {
+        {"submit_empty", false, &SubmitLatency::SubmitEmpty},
+        {"fence_empty", false, &SubmitLatency::FenceEmpty},
+        {"fence_small", false, &SubmitLatency::FenceSmall},
+        {"timeline_host_wait", false, &SubmitLatency::TimelineHostWait},
+        {"timeline_host_signal", false, &SubmitLatency::TimelineHostSignal},
+        {"batch_separate_submits", false,
+         &SubmitLatency::BatchSeparateSubmits},
+        {"batch_submit_infos", false, &SubmitLatency::BatchSubmitInfos},
+        {"batch_command_buffers", false,
+         &SubmitLatency::BatchCommandBuffers},
+        {"binary_same_queue", false, &SubmitLatency::BinarySameQueue},
+        {"timeline_same_queue", false, &SubmitLatency::TimelineSameQueue},
+        {"binary_cross_queue", true, &SubmitLatency::BinaryCrossQueue},
+        {"timeline_cross_queue", true, &SubmitLatency::TimelineCrossQueue},
+    };
+
+    for (const TestInfo& test : tests) {
+      if (only_test && strcmp(only_test, test.name) != 0) {
+        continue;
+      }
+      if (test.cross_queue && !compute_queue_) {
+        data_->logger()->LogInfo("LATENCY: test: ", test.name,
+                                 " skipped, there is no async compute queue");
+        continue;
+      }
+      vulkan::FrameTimeRecorder recorder(data_->allocator(), num_samples_);
+      // The first run is not recorded, it may include one-time work in the
+      // driver.
+      (this->*test.function)();
+      for (uint32_t i = 0; i < num_samples_; ++i) {
+        recorder.Record((this->*test.function)());
+      }
+      const std::string prefix = std::string("LATENCY: test: ") + test.name;
+      recorder.LogStatistics(prefix.c_str(), kLatencyBudget,
+                             data_->logger());
+    }
+  }
+
+ private:
+  typedef std::chrono::high_resolution_clock Clock;
+
+  static float Seconds(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<float>(end - start).count();
+  }
+
+  vulkan::VkCommandBuffer RecordFill(uint32_t queue_family,
+                                     VkDeviceSize offset) {
+    vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue_family);
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    cmd->vkCmdFillBuffer(cmd, *buffer_, buffer_->offset() + offset,
+                         kFillSize, 0);
+    cmd->vkEndCommandBuffer(cmd);
+    return cmd;
+  }
+
+  void Submit(vulkan::VkQueue* queue, uint32_t count,
+              const VkSubmitInfo* submits, ::VkFence fence) {
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               (*queue)->vkQueueSubmit(*queue, count, submits, fence));
+  }
+
+  void WaitForFence() {
+    vulkan::VkDevice& device = app_->device();
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkWaitForFences(device, 1, &fence_.get_raw_object(),
+                                       VK_TRUE, 0xFFFFFFFFFFFFFFFF));
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkResetFences(device, 1, &fence_.get_raw_object()));
+  }
+
+  // The host time of a vkQueueSubmit without any command buffers.
+  float SubmitEmpty() {
+    const VkSubmitInfo submit = EmptySubmitInfo();
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), 1, &submit, fence_);
+    const Clock::time_point end = Clock::now();
+    WaitForFence();
+    return Seconds(start, end);
+  }
+
+  // The time from a vkQueueSubmit without any command buffers until
+  // vkWaitForFences returns.
+  float FenceEmpty() {
+    const VkSubmitInfo submit = EmptySubmitInfo();
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), 1, &submit, fence_);
+    WaitForFence();
+    return Seconds(start, Clock::now());
+  }
+
+  // The time from a vkQueueSubmit of a small command buffer until
+  // vkWaitForFences returns.
+  float FenceSmall() {
+    VkSubmitInfo submit = EmptySubmitInfo();
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &render_commands_[0].get_command_buffer();
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), 1, &submit, fence_);
+    WaitForFence();
+    return Seconds(start, Clock::now());
+  }
+
+  // The time from a vkQueueSubmit of a small command buffer that signals the
+  // timeline semaphore until vkWaitSemaphoresKHR returns.
+  float TimelineHostWait() {
+    const uint64_t value = ++timeline_value_;
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info = {
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,  // sType
+        nullptr,                                               // pNext
+        0,        // waitSemaphoreValueCount
+        nullptr,  // pWaitSemaphoreValues
+        1,        // signalSemaphoreValueCount
+        &value    // pSignalSemaphoreValues
+    };
+    VkSubmitInfo submit = EmptySubmitInfo();
+    submit.pNext = &timeline_info;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &render_commands_[0].get_command_buffer();
+    submit.signalSemaphoreCount = 1;
+    submit.pSignalSemaphores = &timeline_semaphore_.get_raw_object();
+    VkSemaphoreWaitInfoKHR wait_info = {
+        VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        1,                                          // semaphoreCount
+        &timeline_semaphore_.get_raw_object(),      // pSemaphores
+        &value                                      // pValues
+    };
+    vulkan::VkDevice& device = app_->device();
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), 1, &submit, VK_NULL_HANDLE);
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkWaitSemaphoresKHR(device, &wait_info,
+                                           0xFFFFFFFFFFFFFFFF));
+    return Seconds(start, Clock::now());
+  }
+
+  // The time from vkSignalSemaphoreKHR on the host, releasing a submission
+  // that already waits for the timeline semaphore, until vkWaitForFences
+  // for that submission returns.
+  float TimelineHostSignal() {
+    const uint64_t value = ++timeline_value_;
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info = {
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,  // sType
+        nullptr,                                               // pNext
+        1,        // waitSemaphoreValueCount
+        &value,   // pWaitSemaphoreValues
+        0,        // signalSemaphoreValueCount
+        nullptr   // pSignalSemaphoreValues
+    };
+    VkSubmitInfo submit = EmptySubmitInfo();
+    submit.pNext = &timeline_info;
+    submit.waitSemaphoreCount = 1;
+    submit.pWaitSemaphores = &timeline_semaphore_.get_raw_object();
+    submit.pWaitDstStageMask = &kWaitStage;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &render_commands_[0].get_command_buffer();
+    Submit(&app_->render_queue(), 1, &submit, fence_);
+
+    VkSemaphoreSignalInfoKHR signal_info = {
+        VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO_KHR,  // sType
+        nullptr,                                      // pNext
+        timeline_semaphore_,                          // semaphore
+        value                                         // value
+    };
+    vulkan::VkDevice& device = app_->device();
+    const Clock::time_point start = Clock::now();
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkSignalSemaphoreKHR(device, &signal_info));
+    WaitForFence();
+    return Seconds(start, Clock::now());
+  }
+
+  // The host time of submitting batch_size_ small command buffers with one
+  // vkQueueSubmit each.
+  float BatchSeparateSubmits() {
+    VkSubmitInfo submit = EmptySubmitInfo();
+    submit.commandBufferCount = 1;
+    const Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < batch_size_; ++i) {
+      submit.pCommandBuffers = &render_commands_[i].get_command_buffer();
+      Submit(&app_->render_queue(), 1, &submit,
+             i + 1 == batch_size_ ? static_cast<::VkFence>(fence_)
+                                  : VK_NULL_HANDLE);
+    }
+    const Clock::time_point end = Clock::now();
+    WaitForFence();
+    return Seconds(start, end);
+  }
+
+  // The host time of submitting batch_size_ small command buffers with a
+  // single vkQueueSubmit, with one VkSubmitInfo each.
+  float BatchSubmitInfos() {
+    containers::vector<VkSubmitInfo> submits(batch_size_, EmptySubmitInfo(),
+                                             data_->allocator());
+    for (uint32_t i = 0; i < batch_size_; ++i) {
+      submits[i].commandBufferCount = 1;
+      submits[i].pCommandBuffers = &render_commands_[i].get_command_buffer();
+    }
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), batch_size_, submits.data(), fence_);
+    const Clock::time_point end = Clock::now();
+    WaitForFence();
+    return Seconds(start, end);
+  }
+
+  // The host time of submitting batch_size_ small command buffers with a
+  // single VkSubmitInfo.
+  float BatchCommandBuffers() {
+    containers::vector<::VkCommandBuffer> commands(data_->allocator());
+    commands.reserve(batch_size_);
+    for (uint32_t i = 0; i < batch_size_; ++i) {
+      commands.push_back(render_commands_[i].get_command_buffer());
+    }
+    VkSubmitInfo submit = EmptySubmitInfo();
+    submit.commandBufferCount = batch_size_;
+    submit.pCommandBuffers = commands.data();
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), 1, &submit, fence_);
+    const Clock::time_point end = Clock::now();
+    WaitForFence();
+    return Seconds(start, end);
+  }
+
+  // The time from a submission that signals a binary semaphore until
+  // vkWaitForFences returns for a submission to |queue| that waits for it.
+  float BinarySemaphore(vulkan::VkQueue* queue,
+                        vulkan::VkCommandBuffer* wait_commands) {
+    VkSubmitInfo signal_submit = EmptySubmitInfo();
+    signal_submit.commandBufferCount = 1;
+    signal_submit.pCommandBuffers = &render_commands_[0].get_command_buffer();
+    signal_submit.signalSemaphoreCount = 1;
+    signal_submit.pSignalSemaphores = &binary_semaphore_.get_raw_object();
+    VkSubmitInfo wait_submit = EmptySubmitInfo();
+    wait_submit.waitSemaphoreCount = 1;
+    wait_submit.pWaitSemaphores = &binary_semaphore_.get_raw_object();
+    wait_submit.pWaitDstStageMask = &kWaitStage;
+    wait_submit.commandBufferCount = 1;
+    wait_submit.pCommandBuffers = &wait_commands->get_command_buffer();
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), 1, &signal_submit, VK_NULL_HANDLE);
+    Submit(queue, 1, &wait_submit, fence_);
+    WaitForFence();
+    return Seconds(start, Clock::now());
+  }
+
+  // The same as BinarySemaphore, with the timeline semaphore.
+  float TimelineSemaphore(vulkan::VkQueue* queue,
+                          vulkan::VkCommandBuffer* wait_commands) {
+    const uint64_t value = ++timeline_value_;
+    VkTimelineSemaphoreSubmitInfoKHR signal_info = {
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,  // sType
+        nullptr,                                               // pNext
+        0,        // waitSemaphoreValueCount
+        nullptr,  // pWaitSemaphoreValues
+        1,        // signalSemaphoreValueCount
+        &value    // pSignalSemaphoreValues
+    };
+    VkTimelineSemaphoreSubmitInfoKHR wait_info = {
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,  // sType
+        nullptr,                                               // pNext
+        1,        // waitSemaphoreValueCount
+        &value,   // pWaitSemaphoreValues
+        0,        // signalSemaphoreValueCount
+        nullptr   // pSignalSemaphoreValues
+    };
+    VkSubmitInfo signal_submit = EmptySubmitInfo();
+    signal_submit.pNext = &signal_info;
+    signal_submit.commandBufferCount = 1;
+    signal_submit.pCommandBuffers = &render_commands_[0].get_command_buffer();
+    signal_submit.signalSemaphoreCount = 1;
+    signal_submit.pSignalSemaphores = &timeline_semaphore_.get_raw_object();
+    VkSubmitInfo wait_submit = EmptySubmitInfo();
+    wait_submit.pNext = &wait_info;
+    wait_submit.waitSemaphoreCount = 1;
+    wait_submit.pWaitSemaphores = &timeline_semaphore_.get_raw_object();
+    wait_submit.pWaitDstStageMask = &kWaitStage;
+    wait_submit.commandBufferCount = 1;
+    wait_submit.pCommandBuffers = &wait_commands->get_command_buffer();
+    const Clock::time_point start = Clock::now();
+    Submit(&app_->render_queue(), 1, &signal_submit, VK_NULL_HANDLE);
+    Submit(queue, 1, &wait_submit, fence_);
+    WaitForFence();
+    return Seconds(start, Clock::now());
+  }
+
+  // The waiting submissions on the render queue use the second command
+  // buffer, since the first one is still pending in the signaling one.
+  float BinarySameQueue() {
+    return BinarySemaphore(&app_->render_queue(), &render_commands_.back());
+  }
+
+  float TimelineSameQueue() {
+    return TimelineSemaphore(&app_->render_queue(), &render_commands_.back());
+  }
+
+  float BinaryCrossQueue() {
+    return BinarySemaphore(compute_queue_, &compute_commands_[0]);
+  }
+
+  float TimelineCrossQueue() {
+    return TimelineSemaphore(compute_queue_, &compute_commands_[0]);
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  vulkan::VkQueue* compute_queue_;
+  const uint32_t num_samples_;
+  const uint32_t batch_size_;
+  vulkan::VkFence fence_;
+  vulkan::VkSemaphore binary_semaphore_;
+  vulkan::VkSemaphore timeline_semaphore_;
+  uint64_t timeline_value_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> buffer_;
+  // batch_size_ command buffers for the render queue, that each fill
+  // kFillSize bytes of buffer_.
+  containers::vector<vulkan::VkCommandBuffer> render_commands_;
+  // One command buffer for the async compute queue, if there is one.
+  containers::vector<vulkan::VkCommandBuffer> compute_commands_;
+};
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+      nullptr,  // pNext
+      VK_TRUE   // timelineSemaphore
+  };
+
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data,
+      {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+      {VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME}, {0}, 1024 * 1024,
+      1024 * 1024, 1024 * 1024, 1024 * 1024, true, false, false, 0, false,
+      false, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, false, false, nullptr, true,
+      false, &timeline_semaphore_features);
+  SubmitLatency latency(data, &app);
+  latency.Run(data->sample_option("test"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
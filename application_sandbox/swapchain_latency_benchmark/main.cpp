@@ -0,0 +1,627 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "support/trace/trace.h"
+#include "vulkan_helpers/frame_pacer.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <vector>
+
+namespace {
+// The frames of every configuration that are measured, after the warmup
+// frames, which fill the swapchain and the frames in flight, and let the
+// display report back the first presents.
+const uint32_t kDefaultFramesPerConfig = 240;
+const uint32_t kWarmupFrames = 30;
+// The number of full screen clears that every frame makes, so that the GPU
+// has some work to queue up.
+const uint32_t kDefaultGpuLoad = 16;
+
+// The GPU zone of every frame, for the latency without display timing.
+const char kFrameZone[] = "frame";
+// The number of the most recent input times that are kept until the GPU
+// reports the frames back. More than any number of frames in flight.
+const uint32_t kMaxPendingFrames = 16;
+
+// The configurations that are swept, unless the command-line restricts
+// them. FIFO comes first, every surface has to support it.
+const uint32_t kSwapchainImages[] = {2, 3, 4};
+const char* const kPresentModes[] = {"fifo", "fifo_relaxed", "mailbox",
+                                     "immediate"};
+const uint32_t kFramesInFlight[] = {1, 2, 3};
+
+// How the latency from the input of a frame is measured.
+enum LatencySource {
+  // To when the display showed the frame, with VK_GOOGLE_display_timing.
+  kLatencyDisplayTiming,
+  // To when the GPU finished the frame, with VK_EXT_calibrated_timestamps.
+  // This leaves out the wait for the display.
+  kLatencyCalibratedTimestamps,
+  // Only the throughput is measured.
+  kLatencyNone,
+};
+
+const char* LatencySourceName(LatencySource source) {
+  switch (source) {
+    case kLatencyDisplayTiming:
+      return "display";
+    case kLatencyCalibratedTimestamps:
+      return "gpu";
+    default:
+      return "none";
+  }
+}
+
+const std::initializer_list<const char*> kNoExtensions = {};
+const std::initializer_list<const char*> kDisplayTimingExtensions = {
+    VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME};
+const std::initializer_list<const char*> kCalibratedTimestampsExtensions = {
+    VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME};
+// Submit ahead needs timeline semaphores.
+const std::initializer_list<const char*> kSubmitAheadInstanceExtensions = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
+const std::initializer_list<const char*> kTimelineExtensions = {
+    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME};
+const std::initializer_list<const char*> kTimelineDisplayTimingExtensions = {
+    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+    VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME};
+const std::initializer_list<const char*>
+    kTimelineCalibratedTimestampsExtensions = {
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+        VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME};
+
+const std::initializer_list<const char*>& DeviceExtensions(
+    LatencySource source, bool submit_ahead) {
+  switch (source) {
+    case kLatencyDisplayTiming:
+      return submit_ahead ? kTimelineDisplayTimingExtensions
+                          : kDisplayTimingExtensions;
+    case kLatencyCalibratedTimestamps:
+      return submit_ahead ? kTimelineCalibratedTimestampsExtensions
+                          : kCalibratedTimestampsExtensions;
+    default:
+      return submit_ahead ? kTimelineExtensions : kNoExtensions;
+  }
+}
+
+struct Config {
+  uint32_t swapchain_images;
+  const char* present_mode;
+  uint32_t frames_in_flight;
+  // Reads the input after the frame was submitted, see
+  // SampleOptions::EnableSubmitAhead.
+  bool submit_ahead;
+};
+
+struct ConfigResult {
+  Config config;
+  // The number of swapchain images that the surface gave us.
+  uint32_t actual_swapchain_images;
+  double frames_per_second;
+  double frame_time_ms;
+  // The average latency from the input of a frame, or a negative latency
+  // if it was not measured.
+  double latency_ms;
+  LatencySource latency_source;
+};
+
+sample_application::SampleOptions BenchmarkOptions(const Config& config,
+                                                   LatencySource source) {
+  sample_application::SampleOptions options;
+  options.SetSwapchainImages(config.swapchain_images)
+      .SetPresentMode(config.present_mode)
+      .SetFramesInFlight(config.frames_in_flight)
+      .EnableGpuProfiler(1);
+  if (config.submit_ahead) {
+    // The clears only write the color attachment.
+    options.EnableSubmitAhead(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  }
+  if (source == kLatencyDisplayTiming) {
+    // Only measured, the presents are shown as soon as the mode allows.
+    options.EnableDisplayTiming(0);
+  }
+  return options;
+}
+
+struct SwapchainLatencyFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+};
+
+// This renders every frame with a number of full screen clears into the
+// swapchain, with one configuration of swapchain images, present mode,
+// frames in flight and submit ahead. It measures the frames per second, and
+// the latency from the start of the Update() of every frame, or its
+// LateUpdate() with submit ahead, to when the display showed it, or to when
+// the GPU finished it.
+class SwapchainLatencyBenchmark
+    : public sample_application::Sample<SwapchainLatencyFrameData> {
+ public:
+  SwapchainLatencyBenchmark(const entry::EntryData* data, const Config& config,
+                            LatencySource source, uint32_t frames_per_config,
+                            uint32_t gpu_load)
+      : data_(data),
+        Sample<SwapchainLatencyFrameData>(
+            data->allocator(), data, 1, 1, 1, 1,
+            BenchmarkOptions(config, source), {0},
+            config.submit_ahead ? kSubmitAheadInstanceExtensions
+                                : kNoExtensions,
+            DeviceExtensions(source, config.submit_ahead)),
+        source_(source),
+        frames_per_config_(frames_per_config),
+        gpu_load_(gpu_load),
+        frame_number_(0),
+        last_frame_end_ns_(0),
+        input_times_{},
+        measure_begin_ns_(0),
+        total_latency_ns_(0),
+        num_latencies_(0),
+        pacer_statistics_{},
+        done_(false),
+        result_{} {
+    result_.config = config;
+    result_.latency_ms = -1.0;
+    result_.latency_source = source;
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    result_.actual_swapchain_images =
+        static_cast<uint32_t>(num_swapchain_images);
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                VK_SAMPLE_COUNT_1_BIT,                     // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+  }
+
+  virtual void InitializeFrameData(
+      SwapchainLatencyFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    ::VkImageView raw_view = color_view(frame_data);
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    // This is where the frame would read its input.
+    if (!result_.config.submit_ahead) {
+      input_times_[frame_number_ % kMaxPendingFrames] =
+          trace::NowNanoseconds();
+    }
+  }
+
+  virtual void LateUpdate(size_t frame_index,
+                          SwapchainLatencyFrameData* frame_data) override {
+    // Render() already counted this frame.
+    input_times_[(frame_number_ - 1) % kMaxPendingFrames] =
+        trace::NowNanoseconds();
+  }
+
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      SwapchainLatencyFrameData* frame_data) override {
+    if (source_ == kLatencyCalibratedTimestamps) {
+      RecordGpuLatency();
+    }
+    const VkExtent2D extent = {app()->swapchain().width(),
+                               app()->swapchain().height()};
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    // Every frame has another color, so that dropped and repeated frames
+    // can be seen.
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+    clear.color.float32[0] = (frame_number_ % 3) == 0 ? 1.0f : 0.0f;
+    clear.color.float32[1] = (frame_number_ % 3) == 1 ? 1.0f : 0.0f;
+    clear.color.float32[2] = (frame_number_ % 3) == 2 ? 1.0f : 0.0f;
+    clear.color.float32[3] = 1.0f;
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0}, extent},                          // renderArea
+        1,                                         // clearValueCount
+        &clear                                     // clears
+    };
+    const uint32_t frame_zone =
+        gpu_profiler()->BeginZone(&cmdBuffer, kFrameZone, false);
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    const VkClearAttachment clear_attachment = {
+        VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+        0,                          // colorAttachment
+        clear,                      // clearValue
+    };
+    const VkClearRect clear_rect = {
+        {{0, 0}, extent},  // rect
+        0,                 // baseArrayLayer
+        1,                 // layerCount
+    };
+    for (uint32_t i = 0; i < gpu_load_; ++i) {
+      cmdBuffer->vkCmdClearAttachments(cmdBuffer, 1, &clear_attachment, 1,
+                                       &clear_rect);
+    }
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, frame_zone);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+    // With submit ahead, this has to be in the submission of the frame.
+    AddFrameCommandBuffer(&cmdBuffer);
+
+    if (frame_number_ == kWarmupFrames) {
+      measure_begin_ns_ = trace::NowNanoseconds();
+      if (frame_pacer()) {
+        pacer_statistics_ = frame_pacer()->statistics();
+      }
+    }
+    if (++frame_number_ == frames_per_config_) {
+      FinishMeasurement();
+    }
+  }
+
+  // Returns true once the configuration has been measured.
+  bool benchmark_done() const { return done_; }
+  const ConfigResult& result() const { return result_; }
+
+ private:
+  // Adds up the latency of the frame that the GPU profiler read back last,
+  // the last one that used the frame slot of this one.
+  void RecordGpuLatency() {
+    const int64_t end_ns =
+        gpu_profiler()->GetLastZoneEndNanoseconds(kFrameZone);
+    if (end_ns == 0 || end_ns == last_frame_end_ns_) {
+      return;
+    }
+    last_frame_end_ns_ = end_ns;
+    const uint64_t frames_in_flight = this->frames_in_flight();
+    if (frame_number_ < kWarmupFrames + frames_in_flight) {
+      return;
+    }
+    const int64_t input_ns =
+        input_times_[(frame_number_ - frames_in_flight) % kMaxPendingFrames];
+    if (end_ns >= input_ns) {
+      total_latency_ns_ += static_cast<uint64_t>(end_ns - input_ns);
+      ++num_latencies_;
+    }
+  }
+
+  void FinishMeasurement() {
+    const uint32_t num_frames = frames_per_config_ - kWarmupFrames;
+    const double seconds =
+        (trace::NowNanoseconds() - measure_begin_ns_) / 1000000000.0;
+    result_.frames_per_second = seconds > 0.0 ? num_frames / seconds : 0.0;
+    result_.frame_time_ms = seconds * 1000.0 / num_frames;
+    if (source_ == kLatencyDisplayTiming && frame_pacer()) {
+      // The presents that the display reported back while this
+      // configuration was measured, which lag behind the frames by a few.
+      const vulkan::FramePacer::Statistics& statistics =
+          frame_pacer()->statistics();
+      const uint64_t num_latencies = statistics.num_input_latencies -
+                                     pacer_statistics_.num_input_latencies;
+      if (num_latencies > 0) {
+        result_.latency_ms = (statistics.total_input_latency_ns -
+                              pacer_statistics_.total_input_latency_ns) *
+                             1e-6 / num_latencies;
+      }
+    } else if (num_latencies_ > 0) {
+      result_.latency_ms = total_latency_ns_ * 1e-6 / num_latencies_;
+    }
+    done_ = true;
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  LatencySource source_;
+  uint32_t frames_per_config_;
+  uint32_t gpu_load_;
+  uint64_t frame_number_;
+  // The end of the last frame that RecordGpuLatency() saw, on the CPU clock.
+  int64_t last_frame_end_ns_;
+  // When Update() ran for every frame, by the frame number modulo
+  // kMaxPendingFrames.
+  int64_t input_times_[kMaxPendingFrames];
+  int64_t measure_begin_ns_;
+  // The sum of the latencies to the end of the GPU work of the frames.
+  uint64_t total_latency_ns_;
+  uint64_t num_latencies_;
+  // The statistics of the frame pacer when the measurement started.
+  vulkan::FramePacer::Statistics pacer_statistics_;
+  bool done_;
+  ConfigResult result_;
+};
+
+// Returns true if the surface of |application| can present with the mode
+// called |name|. Headless, there is nothing to present to, so any mode is
+// as good as the others.
+bool SupportsPresentMode(vulkan::VulkanApplication* application,
+                         const char* name) {
+  VkPresentModeKHR mode;
+  if (!vulkan::GetPresentModeFromName(name, &mode)) {
+    return false;
+  }
+  if (application->headless()) {
+    return true;
+  }
+  containers::vector<VkPresentModeKHR> modes(application->GetAllocator());
+  uint32_t num_modes = 0;
+  application->instance()->vkGetPhysicalDeviceSurfacePresentModesKHR(
+      application->device().physical_device(), application->surface(),
+      &num_modes, nullptr);
+  modes.resize(num_modes);
+  application->instance()->vkGetPhysicalDeviceSurfacePresentModesKHR(
+      application->device().physical_device(), application->surface(),
+      &num_modes, modes.data());
+  return std::find(modes.begin(), modes.end(), mode) != modes.end();
+}
+
+// Every configuration, restricted to the ones that -swapchain-images,
+// -present-mode and -max-frame-latency ask for, without submit ahead, with
+// it, or both.
+std::vector<Config> Configs(const entry::EntryData* data) {
+  const char* submit_ahead = data->sample_option("submit_ahead");
+  const bool both = submit_ahead && strcmp(submit_ahead, "both") == 0;
+  const bool with_submit_ahead =
+      both || (submit_ahead && strcmp(submit_ahead, "0") != 0);
+  const bool without_submit_ahead = both || !with_submit_ahead;
+  std::vector<Config> configs;
+  for (const char* present_mode : kPresentModes) {
+    if (data->present_mode() && strcmp(data->present_mode(), present_mode)) {
+      continue;
+    }
+    for (uint32_t images : kSwapchainImages) {
+      if (data->swapchain_images() && data->swapchain_images() != images) {
+        continue;
+      }
+      for (uint32_t frames_in_flight : kFramesInFlight) {
+        if (frames_in_flight > images ||
+            (data->max_frame_latency() &&
+             data->max_frame_latency() != frames_in_flight)) {
+          continue;
+        }
+        if (without_submit_ahead) {
+          configs.push_back(
+              Config{images, present_mode, frames_in_flight, false});
+        }
+        if (with_submit_ahead) {
+          configs.push_back(
+              Config{images, present_mode, frames_in_flight, true});
+        }
+      }
+    }
+  }
+  return configs;
+}
+
+uint32_t OptionValue(const entry::EntryData* data, const char* name,
+                     uint32_t default_value) {
+  const char* option = data->sample_option(name);
+  return option ? static_cast<uint32_t>(strtoul(option, nullptr, 10))
+                : default_value;
+}
+
+void LogResult(logging::Logger* log, const char* prefix,
+               const ConfigResult& result) {
+  log->LogInfo(prefix, " images=", result.actual_swapchain_images,
+               " present_mode=", result.config.present_mode,
+               " frames_in_flight=", result.config.frames_in_flight,
+               " fps=", result.frames_per_second,
+               " frame_ms=", result.frame_time_ms,
+               " latency_ms=", result.latency_ms,
+               " latency_to=", LatencySourceName(result.latency_source),
+               " submit_ahead=", result.config.submit_ahead ? 1 : 0);
+}
+}  // anonymous namespace
+
+// Measures every configuration in turn, each with a Sample of its own, and
+// logs a table of the results and the configurations with the lowest
+// latency and the highest throughput.
+//   -sample-option=frames_per_config=<n>  the frames of every
+//                                         configuration, the first 30 are
+//                                         not measured.
+//   -sample-option=gpu_load=<n>           the full screen clears per frame.
+//   -sample-option=submit_ahead=<1|both>  measures with submit ahead, or
+//                                         both with and without it.
+//   -sample-option=results=<file>         writes the table to <file>, as CSV.
+int main_entry(const entry::EntryData* data) {
+  logging::Logger* log = data->logger();
+  log->LogInfo("Application Startup");
+
+  const uint32_t frames_per_config = std::max(
+      OptionValue(data, "frames_per_config", kDefaultFramesPerConfig),
+      kWarmupFrames + 1);
+  const uint32_t gpu_load = OptionValue(data, "gpu_load", kDefaultGpuLoad);
+
+  // The latency is measured in the best way that the device can, which is
+  // found out with the first configuration.
+  bool source_known = false;
+  LatencySource source = kLatencyDisplayTiming;
+  std::vector<ConfigResult> results;
+  for (const Config& config : Configs(data)) {
+    if (data->WindowClosing()) {
+      break;
+    }
+    containers::unique_ptr<SwapchainLatencyBenchmark> sample;
+    while (true) {
+      // Only one of them can have a surface for the window at a time.
+      sample.reset();
+      sample = containers::make_unique<SwapchainLatencyBenchmark>(
+          data->allocator(), data, config, source, frames_per_config,
+          gpu_load);
+      if (sample->is_valid() || source_known || source == kLatencyNone) {
+        break;
+      }
+      source = static_cast<LatencySource>(source + 1);
+    }
+    if (!source_known) {
+      log->LogInfo("SWAPCHAIN_LATENCY: the latency is measured to ",
+                   LatencySourceName(source));
+      source_known = true;
+    }
+    if (!sample->is_valid() && config.submit_ahead) {
+      log->LogInfo("SWAPCHAIN_LATENCY: submit_ahead is skipped, the device "
+                   "has no timeline semaphores");
+      continue;
+    }
+    if (!sample->is_valid()) {
+      log->LogError("The device can not run the benchmark");
+      return -1;
+    }
+    if (!SupportsPresentMode(sample->app(), config.present_mode)) {
+      log->LogInfo("SWAPCHAIN_LATENCY: ", config.present_mode,
+                   " is skipped, the surface does not support it");
+      continue;
+    }
+    const uint32_t actual_images =
+        static_cast<uint32_t>(sample->app()->swapchain_images().size());
+    if (actual_images != config.swapchain_images) {
+      log->LogInfo("SWAPCHAIN_LATENCY: images=", config.swapchain_images,
+                   " is skipped, the surface gave ", actual_images);
+      continue;
+    }
+    sample->Initialize();
+    while (!sample->should_exit() && !data->WindowClosing() &&
+           !sample->benchmark_done()) {
+      sample->ProcessFrame();
+    }
+    sample->WaitIdle();
+    if (sample->benchmark_done()) {
+      // Do not modify this line, scripts may look for it in the output.
+      LogResult(log, "SWAPCHAIN_LATENCY:", sample->result());
+      results.push_back(sample->result());
+    }
+  }
+
+  if (results.empty()) {
+    log->LogError("No configuration was measured");
+    return -1;
+  }
+
+  // The best latency, and the best latency that keeps at least 95% of the
+  // best throughput, which is usually the one to pick.
+  const ConfigResult* best_latency = nullptr;
+  const ConfigResult* best_throughput = nullptr;
+  for (const ConfigResult& result : results) {
+    if (!best_throughput ||
+        result.frames_per_second > best_throughput->frames_per_second) {
+      best_throughput = &result;
+    }
+  }
+  const ConfigResult* best_balanced = nullptr;
+  for (const ConfigResult& result : results) {
+    if (result.latency_ms < 0.0) {
+      continue;
+    }
+    if (!best_latency || result.latency_ms < best_latency->latency_ms) {
+      best_latency = &result;
+    }
+    if (result.frames_per_second >=
+            0.95 * best_throughput->frames_per_second &&
+        (!best_balanced || result.latency_ms < best_balanced->latency_ms)) {
+      best_balanced = &result;
+    }
+  }
+
+  log->LogInfo(
+      "SWAPCHAIN_LATENCY: images present_mode frames_in_flight fps frame_ms "
+      "latency_ms submit_ahead");
+  for (const ConfigResult& result : results) {
+    log->LogInfo("SWAPCHAIN_LATENCY: ", result.actual_swapchain_images, " ",
+                 result.config.present_mode, " ",
+                 result.config.frames_in_flight, " ",
+                 result.frames_per_second, " ", result.frame_time_ms, " ",
+                 result.latency_ms, " ", result.config.submit_ahead ? 1 : 0);
+  }
+  if (best_latency) {
+    LogResult(log, "SWAPCHAIN_LATENCY: best_latency:", *best_latency);
+  }
+  LogResult(log, "SWAPCHAIN_LATENCY: best_throughput:", *best_throughput);
+  if (best_balanced) {
+    LogResult(log, "SWAPCHAIN_LATENCY: best_balanced:", *best_balanced);
+  }
+
+  const char* results_file = data->sample_option("results");
+  if (results_file) {
+    std::ofstream out_file(results_file);
+    out_file << "images,present_mode,frames_in_flight,fps,frame_ms,"
+                "latency_ms,latency_to,submit_ahead\n";
+    for (const ConfigResult& result : results) {
+      out_file << result.actual_swapchain_images << ","
+               << result.config.present_mode << ","
+               << result.config.frames_in_flight << ","
+               << result.frames_per_second << "," << result.frame_time_ms
+               << "," << result.latency_ms << ","
+               << LatencySourceName(result.latency_source) << ","
+               << (result.config.submit_ahead ? 1 : 0) << "\n";
+    }
+    LOG_ASSERT(==, log, false, out_file.bad());
+    log->LogInfo("Wrote the results to \"", results_file, "\"");
+  }
+
+  log->LogInfo("Application Shutdown");
+  return 0;
+}
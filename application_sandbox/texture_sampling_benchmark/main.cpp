@@ -0,0 +1,743 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_texture.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+uint32_t fullscreen_vertex_shader[] =
+#include "fullscreen.vert.spv"
+    ;
+
+uint32_t sample_fragment_shader[] =
+#include "sample.frag.spv"
+    ;
+
+namespace {
+// The width and height of the textures, unless size=<N> was given.
+const uint32_t kDefaultTextureSize = 2048;
+// The lookups of every pixel, unless taps=<N> was given.
+const uint32_t kDefaultTaps = 4;
+// Every pixel covers this many texels of the largest mip level in y, and
+// one in x.
+const float kFootprint = 4.0f;
+
+// The frames of every configuration that are measured, after the warmup
+// frames, which let the frames in flight and the GPU times of the previous
+// configuration drain.
+const uint32_t kDefaultFramesPerConfig = 120;
+const uint32_t kWarmupFrames = 30;
+
+const char* const kSampleZone = "sample";
+
+struct FormatInfo {
+  VkFormat format;
+  // The name of the format in the sample options and the results.
+  const char* name;
+  // The width and height of a block of texels, 1 if the format is not
+  // compressed, and the bytes of a block.
+  uint32_t block_size;
+  uint32_t block_bytes;
+  // The value of the compressed option that the format needs, or nullptr.
+  const char* compression;
+};
+
+const FormatInfo kFormats[] = {
+    {VK_FORMAT_R8G8B8A8_UNORM, "rgba8", 1, 4, nullptr},
+    {VK_FORMAT_R8_UNORM, "r8", 1, 1, nullptr},
+    {VK_FORMAT_R16G16B16A16_SFLOAT, "rgba16f", 1, 8, nullptr},
+    {VK_FORMAT_BC1_RGBA_UNORM_BLOCK, "bc1", 4, 8, "bc"},
+    {VK_FORMAT_ASTC_4x4_UNORM_BLOCK, "astc4x4", 4, 16, "astc"},
+};
+const size_t kNumFormats = sizeof(kFormats) / sizeof(kFormats[0]);
+
+struct FilterInfo {
+  // The name of the filter in the sample options and the results.
+  const char* name;
+  VkFilter filter;
+  VkSamplerMipmapMode mipmap_mode;
+  // The maxAnisotropy of the sampler, anisotropic filtering is off if this
+  // is 0.
+  float anisotropy;
+  // If true, the sampler returns the minimum of the texels that it filters,
+  // rather than their weighted average.
+  bool minmax;
+};
+
+const FilterInfo kFilters[] = {
+    {"nearest", VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, 0.0f,
+     false},
+    {"linear", VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST, 0.0f, false},
+    {"trilinear", VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, 0.0f,
+     false},
+    {"aniso2", VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, 2.0f, false},
+    {"aniso4", VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, 4.0f, false},
+    {"aniso8", VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, 8.0f, false},
+    {"aniso16", VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, 16.0f,
+     false},
+    {"minmax", VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, 0.0f, true},
+};
+const size_t kNumFilters = sizeof(kFilters) / sizeof(kFilters[0]);
+
+// The names of the access patterns in the sample options and the results,
+// coherent lookups are next to the ones of the neighbouring pixels, random
+// ones are anywhere in the texture.
+const char* const kPatterns[] = {"coherent", "random"};
+const size_t kNumPatterns = sizeof(kPatterns) / sizeof(kPatterns[0]);
+
+// Returns the sample option |name|, or |default_value| if it was not given.
+uint32_t UintOption(const entry::EntryData* data, const char* name,
+                    uint32_t default_value) {
+  const char* option = data->sample_option(name);
+  return option ? static_cast<uint32_t>(strtoul(option, nullptr, 10))
+                : default_value;
+}
+
+// The compressed formats need features that not every device has, so they
+// are only measured with compressed=<bc|astc|all>.
+bool UseCompression(const entry::EntryData* data, const char* compression) {
+  const char* option = data->sample_option("compressed");
+  return option &&
+         (strcmp(option, "all") == 0 || strcmp(option, compression) == 0);
+}
+
+// The anisotropic filters need samplerAnisotropy, unless anisotropy=0.
+bool UseAnisotropy(const entry::EntryData* data) {
+  return UintOption(data, "anisotropy", 1) != 0;
+}
+
+// The minmax filter needs VK_EXT_sampler_filter_minmax, unless minmax=0.
+bool UseMinmax(const entry::EntryData* data) {
+  return UintOption(data, "minmax", 1) != 0;
+}
+
+uint32_t TextureSize(const entry::EntryData* data) {
+  const uint32_t size = UintOption(data, "size", kDefaultTextureSize);
+  return size == 0 ? 1 : size;
+}
+
+// Every texture, and its staging buffer, fits into 16 bytes a texel over
+// all of the formats, and a third more for the smaller mip levels.
+uint32_t TextureArenaMB(const entry::EntryData* data) {
+  const uint64_t size = TextureSize(data);
+  return static_cast<uint32_t>((size * size * 16 * 4 / 3) >> 20) + 16;
+}
+
+VkPhysicalDeviceFeatures RequestedFeatures(const entry::EntryData* data) {
+  VkPhysicalDeviceFeatures features = {0};
+  features.samplerAnisotropy = UseAnisotropy(data);
+  features.textureCompressionBC = UseCompression(data, "bc");
+  features.textureCompressionASTC_LDR = UseCompression(data, "astc");
+  return features;
+}
+
+const std::initializer_list<const char*> kNoExtensions = {};
+const std::initializer_list<const char*> kMinmaxInstanceExtensions = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
+const std::initializer_list<const char*> kMinmaxDeviceExtensions = {
+    VK_EXT_SAMPLER_FILTER_MINMAX_EXTENSION_NAME};
+
+// The push constants of sample.frag.
+struct SampleData {
+  float pixel_size[2];
+  uint32_t taps;
+  uint32_t random_taps;
+};
+
+// One texture, sampled with one filter, in one pattern.
+struct BenchmarkConfig {
+  size_t texture_index;
+  size_t filter_index;
+  size_t pattern_index;
+};
+
+struct TextureSamplingBenchmarkFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+};
+
+// This samples a large texture with every lookup of every pixel of the
+// swapchain, in every format, with every filter, and in every access
+// pattern, and logs the GPU time and the lookups per second of each.
+class TextureSamplingBenchmark
+    : public sample_application::Sample<TextureSamplingBenchmarkFrameData> {
+ public:
+  TextureSamplingBenchmark(const entry::EntryData* data)
+      : data_(data),
+        Sample<TextureSamplingBenchmarkFrameData>(
+            data->allocator(), data, TextureArenaMB(data),
+            TextureArenaMB(data), 1, 1,
+            sample_application::SampleOptions().EnableGpuProfiler(1),
+            RequestedFeatures(data),
+            UseMinmax(data) ? kMinmaxInstanceExtensions : kNoExtensions,
+            UseMinmax(data) ? kMinmaxDeviceExtensions : kNoExtensions),
+        textures_(data->allocator()),
+        staging_buffers_(data->allocator()),
+        configs_(data->allocator()),
+        texture_size_(TextureSize(data)),
+        taps_(UintOption(data, "taps", kDefaultTaps)),
+        frames_per_config_(
+            UintOption(data, "frames_per_config", kDefaultFramesPerConfig)),
+        config_index_(0),
+        config_frame_(0),
+        done_(false),
+        gpu_time_(0.0),
+        num_gpu_times_(0) {
+    if (taps_ == 0) {
+      taps_ = 1;
+    }
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    image_binding_ = {
+        0,                                 // binding
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,  // descriptorType
+        1,                                 // descriptorCount
+        VK_SHADER_STAGE_FRAGMENT_BIT,      // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    sampler_binding_ = {
+        0,                             // binding
+        VK_DESCRIPTOR_TYPE_SAMPLER,    // descriptorType
+        1,                             // descriptorCount
+        VK_SHADER_STAGE_FRAGMENT_BIT,  // stageFlags
+        nullptr                        // pImmutableSamplers
+    };
+    VkPushConstantRange sample_range = {
+        VK_SHADER_STAGE_FRAGMENT_BIT,  // stageFlags
+        0,                             // offset
+        sizeof(SampleData)             // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{image_binding_}, {sampler_binding_}},
+                                    {sample_range}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                         fullscreen_vertex_shader);
+    pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                         sample_fragment_shader);
+    pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline_->SetViewport(viewport());
+    pipeline_->SetScissor(scissor());
+    pipeline_->SetSamples(num_samples());
+    pipeline_->AddAttachment();
+    pipeline_->Commit();
+
+    CreateSamplers();
+
+    const char* format_option = data_->sample_option("format");
+    for (size_t i = 0; i < kNumFormats; ++i) {
+      const FormatInfo& format = kFormats[i];
+      if (format_option && strcmp(format_option, format.name) != 0) {
+        continue;
+      }
+      if (format.compression &&
+          !UseCompression(data_, format.compression)) {
+        app()->GetLogger()->LogInfo("TEXTURE: format: ", format.name,
+                                    " is skipped, it needs compressed=",
+                                    format.compression);
+        continue;
+      }
+      VkFormatProperties properties;
+      app()->instance()->vkGetPhysicalDeviceFormatProperties(
+          app()->device().physical_device(), format.format, &properties);
+      if (!(properties.optimalTilingFeatures &
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        app()->GetLogger()->LogInfo("TEXTURE: format: ", format.name,
+                                    " is skipped, it can not be sampled");
+        continue;
+      }
+      textures_.push_back(
+          CreateTexture(format, properties.optimalTilingFeatures));
+      AddConfigs(textures_.size() - 1);
+    }
+    if (configs_.empty()) {
+      app()->GetLogger()->LogError(
+          "No format, filter and pattern can be measured");
+      done_ = true;
+      return;
+    }
+
+    // Every texture is filled with noise, which neither favours the
+    // texture caches nor any compression of the texture memory.
+    for (size_t i = 0; i < textures_.size(); ++i) {
+      Upload(initialization_buffer, &textures_[i]);
+    }
+  }
+
+  virtual void InitializeFrameData(
+      TextureSamplingBenchmarkFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    ::VkImageView raw_view = color_view(frame_data);
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void InitializationComplete() override { staging_buffers_.clear(); }
+
+  virtual void Update(float time_since_last_render) override {}
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      TextureSamplingBenchmarkFrameData* frame_data) override {
+    const BenchmarkConfig& config = configs_[config_index_];
+    const Texture& texture = textures_[config.texture_index];
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    const uint32_t zone =
+        gpu_profiler()->BeginZone(&cmdBuffer, kSampleZone, false);
+
+    // Every pixel is written, so the swapchain image is not cleared.
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        0,                                // clearValueCount
+        nullptr                           // clears
+    };
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *pipeline_);
+    const ::VkDescriptorSet sets[2] = {
+        texture.descriptor_set->raw_set(),
+        sampler_sets_[config.filter_index]->raw_set()};
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 2, sets, 0, nullptr);
+    const SampleData sample_data = {
+        {1.0f / texture_size_, kFootprint / texture_size_},  // pixel_size
+        taps_,                                               // taps
+        static_cast<uint32_t>(config.pattern_index)          // random_taps
+    };
+    cmdBuffer->vkCmdPushConstants(cmdBuffer,
+                                  ::VkPipelineLayout(*pipeline_layout_),
+                                  VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                  sizeof(sample_data), &sample_data);
+    cmdBuffer->vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, zone);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (config_frame_ >= kWarmupFrames) {
+      // The GPU time is the one of the last frame that finished.
+      const float gpu_time = gpu_profiler()->GetLastZoneTime(kSampleZone);
+      if (gpu_time >= 0.0f) {
+        gpu_time_ += gpu_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      LogResults(config);
+      config_frame_ = 0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (++config_index_ == configs_.size()) {
+        done_ = true;
+        config_index_ = 0;
+      }
+    }
+  }
+
+  // Returns true once every configuration has been measured.
+  bool benchmark_done() const { return done_; }
+
+ private:
+  // A texture in one format, with a full mip chain.
+  struct Texture {
+    const FormatInfo* format;
+    VkFormatFeatureFlags features;
+    uint32_t mip_levels;
+    containers::unique_ptr<vulkan::VulkanApplication::Image> image;
+    containers::unique_ptr<vulkan::VkImageView> view;
+    containers::unique_ptr<vulkan::DescriptorSet> descriptor_set;
+  };
+
+  // Creates the sampler of every filter, and a descriptor set for it.
+  void CreateSamplers() {
+    for (size_t i = 0; i < kNumFilters; ++i) {
+      const FilterInfo& filter = kFilters[i];
+      if ((filter.anisotropy > 0.0f && !UseAnisotropy(data_)) ||
+          (filter.minmax && !UseMinmax(data_))) {
+        continue;
+      }
+      VkSamplerReductionModeCreateInfoEXT reduction_mode{
+          VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO_EXT,
+          nullptr,                           // pNext
+          VK_SAMPLER_REDUCTION_MODE_MIN_EXT  // reductionMode
+      };
+      VkSamplerCreateInfo create_info = vulkan::GetSamplerCreateInfo(
+          filter.filter, filter.filter, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+          VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+          filter.minmax ? &reduction_mode : nullptr);
+      create_info.mipmapMode = filter.mipmap_mode;
+      if (filter.anisotropy > 0.0f) {
+        create_info.anisotropyEnable = VK_TRUE;
+        create_info.maxAnisotropy = filter.anisotropy;
+      }
+      samplers_[i] = app()->GetSampler(create_info);
+
+      sampler_sets_[i] = containers::make_unique<vulkan::DescriptorSet>(
+          data_->allocator(), app()->AllocateDescriptorSet({sampler_binding_}));
+      VkDescriptorImageInfo sampler_info = {
+          samplers_[i],               // sampler
+          VK_NULL_HANDLE,             // imageView
+          VK_IMAGE_LAYOUT_UNDEFINED,  // imageLayout
+      };
+      VkWriteDescriptorSet write = {
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+          nullptr,                                 // pNext
+          *sampler_sets_[i],                       // dstSet
+          0,                                       // dstbinding
+          0,                                       // dstArrayElement
+          1,                                       // descriptorCount
+          VK_DESCRIPTOR_TYPE_SAMPLER,              // descriptorType
+          &sampler_info,                           // pImageInfo
+          nullptr,                                 // pBufferInfo
+          nullptr,                                 // pTexelBufferView
+      };
+      app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
+                                              nullptr);
+    }
+  }
+
+  Texture CreateTexture(const FormatInfo& format,
+                        VkFormatFeatureFlags features) {
+    Texture texture;
+    texture.format = &format;
+    texture.features = features;
+    texture.mip_levels =
+        vulkan::VulkanTexture::GetMipLevelCount(texture_size_, texture_size_);
+
+    VkImageCreateInfo image_create_info = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        format.format,                        // format
+        {texture_size_, texture_size_, 1},    // extent
+        texture.mip_levels,                   // mipLevels
+        1,                                    // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                // samples
+        VK_IMAGE_TILING_OPTIMAL,              // tiling
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,       // sharingMode
+        0,                               // queueFamilyIndexCount
+        nullptr,                         // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,       // initialLayout
+    };
+    texture.image = app()->CreateAndBindImage(&image_create_info);
+    texture.view = app()->CreateImageView(
+        texture.image.get(), VK_IMAGE_VIEW_TYPE_2D,
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mip_levels, 0, 1});
+
+    texture.descriptor_set = containers::make_unique<vulkan::DescriptorSet>(
+        data_->allocator(), app()->AllocateDescriptorSet({image_binding_}));
+    VkDescriptorImageInfo image_info = {
+        VK_NULL_HANDLE,                            // sampler
+        *texture.view,                             // imageView
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *texture.descriptor_set,                 // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        1,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,        // descriptorType
+        &image_info,                             // pImageInfo
+        nullptr,                                 // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
+                                            nullptr);
+    return texture;
+  }
+
+  // Adds the configurations of the texture |index| that the sample options
+  // ask for, and that its format and the device can filter.
+  void AddConfigs(size_t index) {
+    const Texture& texture = textures_[index];
+    const char* filter_option = data_->sample_option("filter");
+    const char* pattern_option = data_->sample_option("pattern");
+    for (size_t i = 0; i < kNumFilters; ++i) {
+      const FilterInfo& filter = kFilters[i];
+      if ((filter_option && strcmp(filter_option, filter.name) != 0) ||
+          !samplers_[i]) {
+        continue;
+      }
+      const char* reason = nullptr;
+      if (filter.filter == VK_FILTER_LINEAR &&
+          !(texture.features &
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+        reason = "the format can not be filtered linearly";
+      } else if (filter.minmax &&
+                 !(texture.features &
+                   VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_MINMAX_BIT_EXT)) {
+        reason = "the format can not be filtered with minmax";
+      } else if (filter.anisotropy >
+                 app()->device().limits().maxSamplerAnisotropy) {
+        reason = "the device does not have that much anisotropy";
+      }
+      if (reason) {
+        app()->GetLogger()->LogInfo("TEXTURE: format: ", texture.format->name,
+                                    " filter: ", filter.name,
+                                    " is skipped, ", reason);
+        continue;
+      }
+      for (size_t pattern = 0; pattern < kNumPatterns; ++pattern) {
+        if (pattern_option && strcmp(pattern_option, kPatterns[pattern]) != 0) {
+          continue;
+        }
+        configs_.push_back({index, i, pattern});
+      }
+    }
+  }
+
+  // Writes noise to every mip level of |texture| through a staging buffer,
+  // and records the copy of it into |cmd|, after which the texture can be
+  // sampled by fragment shaders.
+  void Upload(vulkan::VkCommandBuffer* cmd, Texture* texture) {
+    const FormatInfo& format = *texture->format;
+    containers::vector<VkBufferImageCopy> regions(data_->allocator());
+    VkDeviceSize size = 0;
+    for (uint32_t level = 0; level < texture->mip_levels; ++level) {
+      const uint32_t extent =
+          texture_size_ >> level ? texture_size_ >> level : 1;
+      const uint32_t blocks =
+          (extent + format.block_size - 1) / format.block_size;
+      regions.push_back({
+          size,                                      // bufferOffset
+          0,                                         // bufferRowLength
+          0,                                         // bufferImageHeight
+          {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},  // imageSubresource
+          {0, 0, 0},                                 // imageOffset
+          {extent, extent, 1},                       // imageExtent
+      });
+      // Every level starts at a multiple of 16 bytes, which is a multiple
+      // of every block size.
+      size += (static_cast<VkDeviceSize>(blocks) * blocks * format.block_bytes +
+               15) &
+              ~static_cast<VkDeviceSize>(15);
+    }
+
+    staging_buffers_.push_back(app()->CreateAndBindDefaultExclusiveHostBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT));
+    vulkan::VulkanApplication::Buffer* staging = staging_buffers_.back().get();
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(staging->base_address());
+    uint32_t state = 0x9E3779B9u;
+    for (VkDeviceSize i = 0; i < size; ++i) {
+      // xorshift32
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      bytes[i] = static_cast<uint8_t>(state >> 24);
+    }
+    if (format.format == VK_FORMAT_ASTC_4x4_UNORM_BLOCK) {
+      // Random bits are mostly reserved ASTC encodings, which decode to the
+      // error color. Every block is made a valid void-extent block instead,
+      // with one color that stays random.
+      for (VkDeviceSize i = 0; i + 16 <= size; i += 16) {
+        bytes[i] = 0xFC;
+        bytes[i + 1] = 0xFD;
+        memset(bytes + i + 2, 0xFF, 6);
+      }
+    }
+    staging->flush();
+
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        0,                                       // srcAccessMask
+        VK_ACCESS_TRANSFER_WRITE_BIT,            // dstAccessMask
+        VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,    // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        *texture->image,                         // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mip_levels, 0,
+         1},  // subresourceRange
+    };
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    cmdBuffer->vkCmdCopyBufferToImage(
+        cmdBuffer, *staging, *texture->image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    cmdBuffer->vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                    0, nullptr, 0, nullptr, 1, &barrier);
+  }
+
+  // Logs the results of the frames of |config| that were measured.
+  void LogResults(const BenchmarkConfig& config) {
+    const Texture& texture = textures_[config.texture_index];
+    const double average =
+        num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0;
+    // Every lookup counts as one texel, however many texels the filter
+    // reads for it.
+    const double texels = static_cast<double>(app()->swapchain().width()) *
+                          app()->swapchain().height() * taps_;
+    app()->GetLogger()->LogInfo(
+        "TEXTURE: format: ", texture.format->name,
+        " filter: ", kFilters[config.filter_index].name,
+        " pattern: ", kPatterns[config.pattern_index], " size: ", texture_size_,
+        " texture_MB: ", texture.image->size() / (1024.0 * 1024.0),
+        " gpu: ", average, "ms gtexels_per_s: ",
+        average > 0.0 ? texels / (average * 1e6) : -1.0);
+  }
+
+  const entry::EntryData* data_;
+  VkDescriptorSetLayoutBinding image_binding_;
+  VkDescriptorSetLayoutBinding sampler_binding_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> pipeline_;
+  // In the order of kFilters, null for the filters that are not measured.
+  vulkan::SamplerCache::Handle samplers_[kNumFilters];
+  containers::unique_ptr<vulkan::DescriptorSet> sampler_sets_[kNumFilters];
+
+  containers::vector<Texture> textures_;
+  // Only alive until the textures have been copied to the device.
+  containers::vector<
+      containers::unique_ptr<vulkan::VulkanApplication::Buffer>>
+      staging_buffers_;
+
+  // The configurations that are measured, one after the other.
+  containers::vector<BenchmarkConfig> configs_;
+  uint32_t texture_size_;
+  uint32_t taps_;
+  uint32_t frames_per_config_;
+  size_t config_index_;
+  uint32_t config_frame_;
+  bool done_;
+  // The sum of the GPU times of the measured frames of the current
+  // configuration, in milliseconds.
+  double gpu_time_;
+  uint32_t num_gpu_times_;
+};
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  TextureSamplingBenchmark sample(data);
+  if (!sample.is_valid()) {
+    data->logger()->LogInfo(
+        "The device does not support the requested features, run with "
+        "-sample-option=anisotropy=0, -sample-option=minmax=0, or without "
+        "-sample-option=compressed");
+    return -1;
+  }
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing() &&
+         !sample.benchmark_done()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
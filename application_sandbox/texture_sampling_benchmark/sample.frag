@@ -0,0 +1,63 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+layout(location = 0) out vec4 out_color;
+
+layout(set = 0, binding = 0) uniform texture2D sampled_texture;
+layout(set = 1, binding = 0) uniform sampler texture_sampler;
+
+layout(push_constant) uniform sample_data {
+    // The size of a pixel in texture coordinates. Every pixel covers more
+    // texels in y than in x, so that anisotropic filters have work to do.
+    vec2 pixel_size;
+    // The number of lookups of every pixel.
+    uint taps;
+    // If not 0, every lookup goes to a random place in the texture, rather
+    // than next to the lookups of the neighbouring pixels.
+    uint random_taps;
+};
+
+uint hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+void main() {
+    // Both patterns use the same gradients, so that they read the same mip
+    // levels and only differ in how close their lookups are.
+    vec2 dx = vec2(pixel_size.x, 0.0);
+    vec2 dy = vec2(0.0, pixel_size.y);
+    vec2 uv = gl_FragCoord.xy * pixel_size;
+    uint seed = uint(gl_FragCoord.y) * 8192u + uint(gl_FragCoord.x);
+    vec4 sum = vec4(0.0);
+    for (uint i = 0u; i < taps; ++i) {
+        vec2 tap_uv;
+        if (random_taps != 0u) {
+            seed = hash(seed + i);
+            tap_uv = vec2(seed & 0xFFFFu, seed >> 16) / 65536.0;
+        } else {
+            tap_uv = uv + float(i) * 0.5 * dx;
+        }
+        sum += textureGrad(sampler2D(sampled_texture, texture_sampler), tap_uv,
+                           dx, dy);
+    }
+    out_color = sum / float(taps);
+}
@@ -16,6 +16,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/upload_batch.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 #include "vulkan_helpers/vulkan_texture.h"
@@ -59,15 +60,23 @@ class TexturedCubeSample
  public:
   TexturedCubeSample(const entry::EntryData* data)
       : data_(data),
-        Sample<TexturedCubeFrameData>(data->allocator(), data, 1, 512, 1, 1,
-                                      sample_application::SampleOptions()),
-        cube_(data->allocator(), data->logger(), cube_data),
-        texture_(data->allocator(), data->logger(), texture_data) {}
+        Sample<TexturedCubeFrameData>(
+            data->allocator(), data, 1, 512, 1, 1,
+            sample_application::SampleOptions().EnableBatchedSubmits()),
+        cube_(data->allocator(), data->logger(), cube_data,
+              vulkan::kModelLayoutQuantizedAttributes),
+        texture_(data->allocator(), data->logger(), texture_data) {
+    texture_.AddCompressedAlternative(simple_texture::texture_bc1);
+    texture_.AddCompressedAlternative(simple_texture::texture_etc2);
+  }
   virtual void InitializeApplicationData(
       vulkan::VkCommandBuffer* initialization_buffer,
       size_t num_swapchain_images) override {
-    cube_.InitializeData(app(), initialization_buffer);
-    texture_.InitializeData(app(), initialization_buffer);
+    vulkan::UploadBatch upload_batch(app());
+    upload_batch.AddModel(&cube_);
+    upload_batch.AddTexture(&texture_, VK_IMAGE_USAGE_SAMPLED_BIT, 0, nullptr,
+                            true);
+    upload_staging_buffer_ = upload_batch.Record(initialization_buffer);
 
     cube_descriptor_set_layouts_[0] = {
         0,                                  // binding
@@ -98,10 +107,8 @@ class TexturedCubeSample
         nullptr                            // pImmutableSamplers
     };
 
-    sampler_ = containers::make_unique<vulkan::VkSampler>(
-        data_->allocator(),
-        vulkan::CreateSampler(&app()->device(), VK_FILTER_LINEAR,
-                              VK_FILTER_LINEAR));
+    sampler_ = app()->GetSampler(
+        vulkan::GetSamplerCreateInfo(VK_FILTER_LINEAR, VK_FILTER_LINEAR));
 
     pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
         data_->allocator(),
@@ -113,39 +120,36 @@ class TexturedCubeSample
     VkAttachmentReference color_attachment = {
         0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
 
-    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
-        data_->allocator(),
-        app()->CreateRenderPass(
-            {{
-                0,                                         // flags
-                render_format(),                           // format
-                num_samples(),                             // samples
-                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
-                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
-                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
-                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
-            }},  // AttachmentDescriptions
-            {{
-                0,                                // flags
-                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
-                0,                                // inputAttachmentCount
-                nullptr,                          // pInputAttachments
-                1,                                // colorAttachmentCount
-                &color_attachment,                // colorAttachment
-                nullptr,                          // pResolveAttachments
-                nullptr,                          // pDepthStencilAttachment
-                0,                                // preserveAttachmentCount
-                nullptr                           // pPreserveAttachments
-            }},                                   // SubpassDescriptions
-            {}                                    // SubpassDependencies
-            ));
+    render_pass_ = app()->GetRenderPass(
+        {{
+            0,                                         // flags
+            render_format(),                           // format
+            num_samples(),                             // samples
+            VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+            VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+            VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+        }},  // AttachmentDescriptions
+        {{
+            0,                                // flags
+            VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+            0,                                // inputAttachmentCount
+            nullptr,                          // pInputAttachments
+            1,                                // colorAttachmentCount
+            &color_attachment,                // colorAttachment
+            nullptr,                          // pResolveAttachments
+            nullptr,                          // pDepthStencilAttachment
+            0,                                // preserveAttachmentCount
+            nullptr                           // pPreserveAttachments
+        }},                                   // SubpassDescriptions
+        {}                                    // SubpassDependencies
+    );
 
     cube_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
         data_->allocator(),
-        app()->CreateGraphicsPipeline(pipeline_layout_.get(),
-                                      render_pass_.get(), 0));
+        app()->CreateGraphicsPipeline(pipeline_layout_.get(), render_pass_, 0));
     cube_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
                               textured_cube_vertex_shader);
     cube_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
@@ -158,13 +162,20 @@ class TexturedCubeSample
     cube_pipeline_->AddAttachment();
     cube_pipeline_->Commit();
 
+    // The camera never changes, so it only has to be written once per frame.
     camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
         data_->allocator(), app(), num_swapchain_images,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 0, 0,
+        vulkan::kBufferFrameDataExplicitDirty);
 
+    // The model changes every frame, so write it straight into the uniform
+    // buffer.
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 0, 0,
+        vulkan::kBufferFrameDataDirect);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -177,7 +188,7 @@ class TexturedCubeSample
   }
 
   virtual void InitializationComplete() override {
-    texture_.InitializationComplete();
+    upload_staging_buffer_.reset();
   }
 
   virtual void InitializeFrameData(
@@ -209,7 +220,7 @@ class TexturedCubeSample
         }};
 
     VkDescriptorImageInfo sampler_info = {
-        *sampler_,                 // sampler
+        sampler_,                  // sampler
         VK_NULL_HANDLE,            // imageView
         VK_IMAGE_LAYOUT_UNDEFINED  //  imageLayout
     };
@@ -268,7 +279,7 @@ class TexturedCubeSample
         VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
         nullptr,                                    // pNext
         0,                                          // flags
-        *render_pass_,                              // renderPass
+        render_pass_,                               // renderPass
         1,                                          // attachmentCount
         &raw_view,                                  // attachments
         app()->swapchain().width(),                 // width
@@ -294,7 +305,7 @@ class TexturedCubeSample
     VkRenderPassBeginInfo pass_begin = {
         VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
         nullptr,                                   // pNext
-        *render_pass_,                             // renderPass
+        render_pass_,                              // renderPass
         *frame_data->framebuffer_,                 // framebuffer
         {{0, 0},
          {app()->swapchain().width(),
@@ -328,25 +339,7 @@ class TexturedCubeSample
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       TexturedCubeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
-    VkSubmitInfo init_submit_info{
-        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
-        nullptr,                        // pNext
-        0,                              // waitSemaphoreCount
-        nullptr,                        // pWaitSemaphores
-        nullptr,                        // pWaitDstStageMask,
-        1,                              // commandBufferCount
-        &(frame_data->command_buffer_->get_command_buffer()),
-        0,       // signalSemaphoreCount
-        nullptr  // pSignalSemaphores
-    };
-
-    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
-                                         &init_submit_info,
-                                         static_cast<VkFence>(VK_NULL_HANDLE));
+    AddFrameCommandBuffer(frame_data->command_buffer_.get());
   }
 
  private:
@@ -361,11 +354,13 @@ class TexturedCubeSample
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
-  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  vulkan::RenderPassCache::Handle render_pass_;
   VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[4];
   vulkan::VulkanModel cube_;
   vulkan::VulkanTexture texture_;
-  containers::unique_ptr<vulkan::VkSampler> sampler_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer>
+      upload_staging_buffer_;
+  vulkan::SamplerCache::Handle sampler_;
 
   containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
   containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
@@ -0,0 +1,31 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// The G-buffer of a procedural surface. The locations must match the
+// attachments of the G-buffer subpass in main.cpp.
+layout(location = 0) out vec4 out_albedo;
+layout(location = 1) out vec4 out_normal;
+layout(location = 2) out vec4 out_material;
+
+void main() {
+    vec2 position = gl_FragCoord.xy / 64.0;
+    vec2 wave = sin(position * 6.2831853);
+    out_albedo = vec4(0.5 + 0.5 * wave.x, 0.5 + 0.5 * wave.y,
+                      fract(position.x + position.y), 1.0);
+    out_normal = vec4(normalize(vec3(wave * 0.5, 1.0)), 0.0);
+    out_material = vec4(fract(position * 0.25), 0.5, 1.0);
+}
@@ -0,0 +1,41 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shades a texel of the G-buffer with a grid of point lights. Both lighting
+// shaders define load_albedo, load_normal and load_material before they
+// include this.
+
+layout(location = 0) out vec4 out_color;
+
+const int kNumLights = 16;
+
+void main() {
+    vec4 albedo = load_albedo();
+    vec3 normal = load_normal().xyz;
+    vec4 material = load_material();
+    vec3 position = vec3(gl_FragCoord.xy, 0.0);
+    vec3 color = vec3(0.0);
+    for (int i = 0; i < kNumLights; ++i) {
+        vec3 light = vec3(float(i % 4) * 512.0, float(i / 4) * 256.0, 128.0);
+        vec3 direction = light - position;
+        float attenuation = 1.0 / (1.0 + dot(direction, direction) * 1.0e-5);
+        vec3 l = normalize(direction);
+        vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));
+        float diffuse = max(dot(normal, l), 0.0);
+        float specular = pow(max(dot(normal, h), 0.0), 1.0 + material.x * 63.0);
+        color += attenuation * (albedo.rgb * diffuse + material.y * specular);
+    }
+    out_color = vec4(color, albedo.a);
+}
@@ -0,0 +1,30 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Reads the G-buffer that a render pass before stored, from memory.
+layout(set = 0, binding = 0) uniform sampler2D albedo;
+layout(set = 0, binding = 1) uniform sampler2D normal;
+layout(set = 0, binding = 2) uniform sampler2D material;
+
+vec4 load_albedo() { return texelFetch(albedo, ivec2(gl_FragCoord.xy), 0); }
+vec4 load_normal() { return texelFetch(normal, ivec2(gl_FragCoord.xy), 0); }
+vec4 load_material() {
+    return texelFetch(material, ivec2(gl_FragCoord.xy), 0);
+}
+
+#include "lighting_common.glsl"
@@ -0,0 +1,32 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Reads the G-buffer from the subpass before, which can keep it in tile
+// memory.
+layout(input_attachment_index = 0, set = 0, binding = 0)
+    uniform subpassInput albedo;
+layout(input_attachment_index = 1, set = 0, binding = 1)
+    uniform subpassInput normal;
+layout(input_attachment_index = 2, set = 0, binding = 2)
+    uniform subpassInput material;
+
+vec4 load_albedo() { return subpassLoad(albedo); }
+vec4 load_normal() { return subpassLoad(normal); }
+vec4 load_material() { return subpassLoad(material); }
+
+#include "lighting_common.glsl"
@@ -0,0 +1,796 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t fullscreen_vert[] =
+#include "fullscreen.vert.spv"
+    ;
+
+uint32_t gbuffer_frag[] =
+#include "gbuffer.frag.spv"
+    ;
+
+uint32_t lighting_subpass_frag[] =
+#include "lighting_subpass.frag.spv"
+    ;
+
+uint32_t lighting_sampled_frag[] =
+#include "lighting_sampled.frag.spv"
+    ;
+
+namespace {
+const uint32_t kDefaultWidth = 1920;
+const uint32_t kDefaultHeight = 1080;
+const uint32_t kDefaultFrames = 16;
+// Every variant is measured this many times, and the fastest run is kept.
+const uint32_t kNumRuns = 5;
+
+// The attachments of a frame. The G-buffer colors are also the bindings of
+// the lighting shaders, and the locations of gbuffer.frag.
+enum Attachment {
+  kAlbedo,
+  kNormal,
+  kMaterial,
+  kDepth,
+  kOutput,
+  kNumAttachments
+};
+const uint32_t kNumGBufferColors = 3;
+
+const VkFormat kFormats[kNumAttachments] = {
+    VK_FORMAT_R8G8B8A8_UNORM,       // kAlbedo
+    VK_FORMAT_R16G16B16A16_SFLOAT,  // kNormal
+    VK_FORMAT_R8G8B8A8_UNORM,       // kMaterial
+    VK_FORMAT_D16_UNORM,            // kDepth
+    VK_FORMAT_R8G8B8A8_UNORM,       // kOutput
+};
+// The size of a texel of every attachment, in bytes.
+const uint32_t kTexelSizes[kNumAttachments] = {4, 8, 4, 2, 4};
+
+// How the G-buffer is produced and consumed.
+struct Variant {
+  // The name of the variant in the sample options and the results.
+  const char* name;
+  // If true, the G-buffer and the lighting are two subpasses of one render
+  // pass, and the lighting reads input attachments. Otherwise they are two
+  // render passes, and the lighting samples the stored G-buffer.
+  bool subpasses;
+  // If true, the G-buffer and the depth buffer are transient attachments,
+  // in lazily allocated memory where there is any.
+  bool transient;
+  // The load and store ops of the G-buffer and the depth buffer.
+  VkAttachmentLoadOp load_op;
+  VkAttachmentStoreOp store_op;
+};
+
+const Variant kVariants[] = {
+    {"subpass_transient", true, true, VK_ATTACHMENT_LOAD_OP_CLEAR,
+     VK_ATTACHMENT_STORE_OP_DONT_CARE},
+    {"subpass_transient_dont_care", true, true,
+     VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE},
+    {"subpass_store", true, false, VK_ATTACHMENT_LOAD_OP_CLEAR,
+     VK_ATTACHMENT_STORE_OP_STORE},
+    {"subpass_load_store", true, false, VK_ATTACHMENT_LOAD_OP_LOAD,
+     VK_ATTACHMENT_STORE_OP_STORE},
+    {"separate_clear", false, false, VK_ATTACHMENT_LOAD_OP_CLEAR,
+     VK_ATTACHMENT_STORE_OP_STORE},
+    {"separate_dont_care", false, false, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+     VK_ATTACHMENT_STORE_OP_STORE},
+    {"separate_load", false, false, VK_ATTACHMENT_LOAD_OP_LOAD,
+     VK_ATTACHMENT_STORE_OP_STORE},
+};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+const char* LoadOpName(VkAttachmentLoadOp op) {
+  switch (op) {
+    case VK_ATTACHMENT_LOAD_OP_LOAD:
+      return "load";
+    case VK_ATTACHMENT_LOAD_OP_CLEAR:
+      return "clear";
+    default:
+      return "dont_care";
+  }
+}
+
+const char* StoreOpName(VkAttachmentStoreOp op) {
+  return op == VK_ATTACHMENT_STORE_OP_STORE ? "store" : "dont_care";
+}
+
+VkAttachmentDescription AttachmentDescription(VkFormat format,
+                                              VkAttachmentLoadOp load_op,
+                                              VkAttachmentStoreOp store_op,
+                                              VkImageLayout initial_layout,
+                                              VkImageLayout final_layout) {
+  return {
+      0,                                 // flags
+      format,                            // format
+      VK_SAMPLE_COUNT_1_BIT,             // samples
+      load_op,                           // loadOp
+      store_op,                          // storeOp
+      VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+      VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+      initial_layout,                    // initialLayout
+      final_layout                       // finalLayout
+  };
+}
+
+// The G-buffer of a frame waits for the frame before to be done with it,
+// and the output of a frame for the output of the frame before.
+const VkSubpassDependency kGBufferFrameDependency = {
+    VK_SUBPASS_EXTERNAL,  // srcSubpass
+    0,                    // dstSubpass
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,  // srcStageMask
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,  // srcAccessMask
+    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,  // dstAccessMask
+    0                                                  // dependencyFlags
+};
+const VkSubpassDependency kOutputFrameDependency = {
+    VK_SUBPASS_EXTERNAL,                            // srcSubpass
+    0,                                              // dstSubpass
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,           // srcAccessMask
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,           // dstAccessMask
+    0                                               // dependencyFlags
+};
+
+// Renders a G-buffer and lights it, with every variant, and measures the
+// GPU time of a frame.
+class TileMemoryBenchmark {
+ public:
+  TileMemoryBenchmark(const entry::EntryData* data,
+                      vulkan::VulkanApplication* app)
+      : data_(data),
+        app_(app),
+        width_(data->sample_option_uint("width", kDefaultWidth)),
+        height_(data->sample_option_uint("height", kDefaultHeight)),
+        frames_(data->sample_option_uint("frames", kDefaultFrames)),
+        timestamp_mask_(0),
+        lazily_allocated_memory_(false),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        sampler_(vulkan::CreateSampler(&app->device(), VK_FILTER_NEAREST,
+                                       VK_FILTER_NEAREST)) {
+    vulkan::VkDevice& device = app->device();
+    width_ = std::min(width_, device.limits().maxFramebufferWidth);
+    height_ = std::min(height_, device.limits().maxFramebufferHeight);
+
+    const VkPhysicalDeviceMemoryProperties& properties =
+        device.physical_device_memory_properties();
+    for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+      if (properties.memoryTypes[i].propertyFlags &
+          VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+        lazily_allocated_memory_ = true;
+      }
+    }
+
+    for (uint32_t i = 0; i < kNumGBufferColors; ++i) {
+      input_bindings_[i] = {
+          i,                                    // binding
+          VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,  // descriptorType
+          1,                                    // descriptorCount
+          VK_SHADER_STAGE_FRAGMENT_BIT,         // stageFlags
+          nullptr                               // pImmutableSamplers
+      };
+      sampled_bindings_[i] = {
+          i,                                          // binding
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+          nullptr                                     // pImmutableSamplers
+      };
+    }
+    gbuffer_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(), app->CreatePipelineLayout({{}}));
+    input_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout(
+            {{input_bindings_[0], input_bindings_[1], input_bindings_[2]}}));
+    sampled_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout({{sampled_bindings_[0],
+                                    sampled_bindings_[1],
+                                    sampled_bindings_[2]}}));
+  }
+
+  // Measures every variant, or only the one named |only|, and logs the
+  // results.
+  void Run(const char* only) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    data_->logger()->LogInfo("TILE_MEMORY: width: ", width_,
+                             " height: ", height_, " frames: ", frames_,
+                             " lazily_allocated_memory: ",
+                             lazily_allocated_memory_ ? 1 : 0);
+    for (const Variant& variant : kVariants) {
+      if (only && strcmp(only, variant.name) != 0) {
+        continue;
+      }
+      const double ns = Measure(variant);
+      data_->logger()->LogInfo(
+          "TILE_MEMORY: variant: ", variant.name,
+          " subpasses: ", variant.subpasses ? 1 : 0,
+          " transient: ", variant.transient ? 1 : 0,
+          " load: ", LoadOpName(variant.load_op),
+          " store: ", StoreOpName(variant.store_op),
+          " ms_per_frame: ", ns < 0.0 ? -1.0 : ns / frames_ / 1.0e6,
+          " estimated_mb_per_frame: ",
+          EstimatedBytesPerFrame(variant) / (1024.0 * 1024.0));
+    }
+  }
+
+ private:
+  // Everything that a frame of a variant is rendered with.
+  struct Frame {
+    containers::unique_ptr<vulkan::VulkanApplication::Image>
+        images[kNumAttachments];
+    containers::unique_ptr<vulkan::VkImageView> views[kNumAttachments];
+    // With subpasses, only the first render pass and framebuffer are used.
+    containers::unique_ptr<vulkan::VkRenderPass> render_passes[2];
+    containers::unique_ptr<vulkan::VkFramebuffer> framebuffers[2];
+    containers::unique_ptr<vulkan::VulkanGraphicsPipeline> gbuffer_pipeline;
+    containers::unique_ptr<vulkan::VulkanGraphicsPipeline> lighting_pipeline;
+    containers::unique_ptr<vulkan::DescriptorSet> set;
+  };
+
+  // The layout that the G-buffer attachment |attachment| is in in between
+  // frames.
+  static VkImageLayout RestingLayout(const Variant& variant,
+                                     uint32_t attachment) {
+    if (attachment == kDepth) {
+      return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+    return variant.subpasses ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                             : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+
+  // The bytes that the load and store ops, the sampled G-buffer and the
+  // output of a frame move to and from memory, if none of the attachments
+  // are compressed. A tiled GPU that keeps the G-buffer in tile memory only
+  // writes the output.
+  double EstimatedBytesPerFrame(const Variant& variant) const {
+    const double texels = static_cast<double>(width_) * height_;
+    uint32_t bytes_per_texel = kTexelSizes[kOutput];
+    for (uint32_t i = 0; i < kOutput; ++i) {
+      uint32_t accesses = 0;
+      if (variant.load_op == VK_ATTACHMENT_LOAD_OP_LOAD) {
+        ++accesses;
+      }
+      if (variant.store_op == VK_ATTACHMENT_STORE_OP_STORE) {
+        ++accesses;
+      }
+      if (!variant.subpasses && i != kDepth) {
+        ++accesses;
+      }
+      bytes_per_texel += kTexelSizes[i] * accesses;
+    }
+    return texels * bytes_per_texel;
+  }
+
+  // Creates the attachments of |variant| and their views.
+  void CreateImages(const Variant& variant, Frame* frame) {
+    for (uint32_t i = 0; i < kNumAttachments; ++i) {
+      VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+      if (i == kDepth) {
+        usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+      } else if (i != kOutput) {
+        usage |= variant.subpasses ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
+                                   : VK_IMAGE_USAGE_SAMPLED_BIT;
+      }
+      if (variant.transient && i != kOutput) {
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      }
+      VkImageCreateInfo image_create_info{
+          VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+          nullptr,                              // pNext
+          0,                                    // flags
+          VK_IMAGE_TYPE_2D,                     // imageType
+          kFormats[i],                          // format
+          {width_, height_, 1},                 // extent
+          1,                                    // mipLevels
+          1,                                    // arrayLayers
+          VK_SAMPLE_COUNT_1_BIT,                // samples
+          VK_IMAGE_TILING_OPTIMAL,              // tiling
+          usage,                                // usage
+          VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+          0,                                    // queueFamilyIndexCount
+          nullptr,                              // pQueueFamilyIndices
+          VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+      };
+      frame->images[i] = app_->CreateAndBindImage(&image_create_info);
+      frame->views[i] = app_->CreateImageView(
+          frame->images[i].get(), VK_IMAGE_VIEW_TYPE_2D,
+          {static_cast<VkImageAspectFlags>(i == kDepth
+                                               ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                               : VK_IMAGE_ASPECT_COLOR_BIT),
+           0, 1, 0, 1});
+    }
+  }
+
+  // Creates the render passes of |variant|, and the pipelines and the
+  // framebuffers for them.
+  void CreateRenderPasses(const Variant& variant, Frame* frame) {
+    VkAttachmentDescription descriptions[kNumAttachments];
+    for (uint32_t i = 0; i < kOutput; ++i) {
+      const VkImageLayout resting = RestingLayout(variant, i);
+      descriptions[i] = AttachmentDescription(
+          kFormats[i], variant.load_op, variant.store_op,
+          variant.load_op == VK_ATTACHMENT_LOAD_OP_LOAD
+              ? resting
+              : VK_IMAGE_LAYOUT_UNDEFINED,
+          resting);
+    }
+    // The lighting writes every texel of the output.
+    descriptions[kOutput] = AttachmentDescription(
+        kFormats[kOutput], VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    VkAttachmentReference gbuffer_references[kNumGBufferColors];
+    VkAttachmentReference input_references[kNumGBufferColors];
+    for (uint32_t i = 0; i < kNumGBufferColors; ++i) {
+      gbuffer_references[i] = {i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+      input_references[i] = {i, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    }
+    VkAttachmentReference depth_reference = {
+        kDepth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference output_reference = {
+        variant.subpasses ? static_cast<uint32_t>(kOutput) : 0u,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription gbuffer_subpass = {
+        0,                                // flags
+        VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+        0,                                // inputAttachmentCount
+        nullptr,                          // pInputAttachments
+        kNumGBufferColors,                // colorAttachmentCount
+        gbuffer_references,               // pColorAttachments
+        nullptr,                          // pResolveAttachments
+        &depth_reference,                 // pDepthStencilAttachment
+        0,                                // preserveAttachmentCount
+        nullptr                           // pPreserveAttachments
+    };
+    // With subpasses, the lighting reads the G-buffer as input attachments.
+    const uint32_t num_inputs = variant.subpasses ? kNumGBufferColors : 0;
+    VkSubpassDescription lighting_subpass = {
+        0,                                // flags
+        VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+        num_inputs,                       // inputAttachmentCount
+        input_references,                 // pInputAttachments
+        1,                                // colorAttachmentCount
+        &output_reference,                // pColorAttachments
+        nullptr,                          // pResolveAttachments
+        nullptr,                          // pDepthStencilAttachment
+        0,                                // preserveAttachmentCount
+        nullptr                           // pPreserveAttachments
+    };
+
+    vulkan::VkRenderPass* passes[2];
+    if (variant.subpasses) {
+      // The lighting of a texel only reads the G-buffer of the same texel,
+      // so the G-buffer can stay in tile memory.
+      VkSubpassDependency gbuffer_to_lighting = {
+          0,                                              // srcSubpass
+          1,                                              // dstSubpass
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,          // dstStageMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,           // srcAccessMask
+          VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,            // dstAccessMask
+          VK_DEPENDENCY_BY_REGION_BIT                     // dependencyFlags
+      };
+      VkSubpassDependency output_dependency = kOutputFrameDependency;
+      output_dependency.dstSubpass = 1;
+      frame->render_passes[0] = containers::make_unique<vulkan::VkRenderPass>(
+          data_->allocator(),
+          app_->CreateRenderPass(
+              {
+                  descriptions[kAlbedo],    // kAlbedo
+                  descriptions[kNormal],    // kNormal
+                  descriptions[kMaterial],  // kMaterial
+                  descriptions[kDepth],     // kDepth
+                  descriptions[kOutput],    // kOutput
+              },
+              {
+                  gbuffer_subpass,   // G-buffer
+                  lighting_subpass,  // Lighting
+              },
+              {
+                  kGBufferFrameDependency,
+                  output_dependency,
+                  gbuffer_to_lighting,
+              }));
+      passes[0] = frame->render_passes[0].get();
+      passes[1] = frame->render_passes[0].get();
+    } else {
+      // The lighting samples the G-buffer once the G-buffer pass is done.
+      VkSubpassDependency gbuffer_to_lighting = {
+          0,                                              // srcSubpass
+          VK_SUBPASS_EXTERNAL,                            // dstSubpass
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,          // dstStageMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,           // srcAccessMask
+          VK_ACCESS_SHADER_READ_BIT,                      // dstAccessMask
+          0                                               // dependencyFlags
+      };
+      frame->render_passes[0] = containers::make_unique<vulkan::VkRenderPass>(
+          data_->allocator(),
+          app_->CreateRenderPass(
+              {
+                  descriptions[kAlbedo],    // kAlbedo
+                  descriptions[kNormal],    // kNormal
+                  descriptions[kMaterial],  // kMaterial
+                  descriptions[kDepth],     // kDepth
+              },
+              {
+                  gbuffer_subpass,  // G-buffer
+              },
+              {
+                  kGBufferFrameDependency,
+                  gbuffer_to_lighting,
+              }));
+      frame->render_passes[1] = containers::make_unique<vulkan::VkRenderPass>(
+          data_->allocator(),
+          app_->CreateRenderPass(
+              {
+                  descriptions[kOutput],  // kOutput
+              },
+              {
+                  lighting_subpass,  // Lighting
+              },
+              {
+                  kOutputFrameDependency,
+              }));
+      passes[0] = frame->render_passes[0].get();
+      passes[1] = frame->render_passes[1].get();
+    }
+
+    frame->gbuffer_pipeline =
+        containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+            data_->allocator(),
+            app_->CreateGraphicsPipeline(gbuffer_layout_.get(), passes[0], 0));
+    frame->lighting_pipeline =
+        containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+            data_->allocator(),
+            app_->CreateGraphicsPipeline(
+                variant.subpasses ? input_layout_.get()
+                                  : sampled_layout_.get(),
+                passes[1], variant.subpasses ? 1 : 0));
+    const VkViewport viewport = {
+        0.0f,                         // x
+        0.0f,                         // y
+        static_cast<float>(width_),   // width
+        static_cast<float>(height_),  // height
+        0.0f,                         // minDepth
+        1.0f                          // maxDepth
+    };
+    const VkRect2D scissor = {{0, 0}, {width_, height_}};
+    vulkan::VulkanGraphicsPipeline* pipelines[2] = {
+        frame->gbuffer_pipeline.get(), frame->lighting_pipeline.get()};
+    for (vulkan::VulkanGraphicsPipeline* pipeline : pipelines) {
+      pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main", fullscreen_vert);
+      pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+      pipeline->SetCullMode(VK_CULL_MODE_NONE);
+      pipeline->SetViewport(viewport);
+      pipeline->SetScissor(scissor);
+      pipeline->SetSamples(VK_SAMPLE_COUNT_1_BIT);
+    }
+    frame->gbuffer_pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                       gbuffer_frag);
+    // With LOAD, the depth buffer holds the depth of the frame before, which
+    // must not hide this one.
+    frame->gbuffer_pipeline->DepthStencilState().depthCompareOp =
+        VK_COMPARE_OP_ALWAYS;
+    for (uint32_t i = 0; i < kNumGBufferColors; ++i) {
+      frame->gbuffer_pipeline->AddAttachment();
+    }
+    frame->gbuffer_pipeline->Commit();
+    if (variant.subpasses) {
+      frame->lighting_pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                          lighting_subpass_frag);
+    } else {
+      frame->lighting_pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                                          lighting_sampled_frag);
+    }
+    frame->lighting_pipeline->AddAttachment();
+    frame->lighting_pipeline->Commit();
+
+    vulkan::VkDevice& device = app_->device();
+    // Without subpasses, the G-buffer pass has every attachment but the
+    // output.
+    ::VkImageView views[kNumAttachments] = {
+        *frame->views[kAlbedo], *frame->views[kNormal],
+        *frame->views[kMaterial], *frame->views[kDepth],
+        *frame->views[kOutput]};
+    const uint32_t num_attachments =
+        variant.subpasses ? kNumAttachments : kOutput;
+    VkFramebufferCreateInfo framebuffer_create_info = {
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *passes[0],                                 // renderPass
+        num_attachments,                            // attachmentCount
+        views,                                      // pAttachments
+        width_,                                     // width
+        height_,                                    // height
+        1                                           // layers
+    };
+    const uint32_t num_framebuffers = variant.subpasses ? 1 : 2;
+    for (uint32_t i = 0; i < num_framebuffers; ++i) {
+      if (i == 1) {
+        framebuffer_create_info.renderPass = *passes[1];
+        framebuffer_create_info.attachmentCount = 1;
+        framebuffer_create_info.pAttachments =
+            &frame->views[kOutput]->get_raw_object();
+      }
+      ::VkFramebuffer raw_framebuffer;
+      LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+                 device->vkCreateFramebuffer(device, &framebuffer_create_info,
+                                             nullptr, &raw_framebuffer));
+      frame->framebuffers[i] = containers::make_unique<vulkan::VkFramebuffer>(
+          data_->allocator(),
+          vulkan::VkFramebuffer(raw_framebuffer, nullptr, &device));
+    }
+  }
+
+  // Creates the set that the lighting reads the G-buffer through.
+  void CreateDescriptorSet(const Variant& variant, Frame* frame) {
+    const VkDescriptorSetLayoutBinding* bindings =
+        variant.subpasses ? input_bindings_ : sampled_bindings_;
+    frame->set = containers::make_unique<vulkan::DescriptorSet>(
+        data_->allocator(),
+        app_->AllocateDescriptorSet({bindings[0], bindings[1], bindings[2]}));
+    // Input attachments have no sampler.
+    const ::VkSampler sampler = variant.subpasses
+                                    ? static_cast<::VkSampler>(VK_NULL_HANDLE)
+                                    : static_cast<::VkSampler>(sampler_);
+    VkDescriptorImageInfo image_infos[kNumGBufferColors];
+    VkWriteDescriptorSet writes[kNumGBufferColors];
+    for (uint32_t i = 0; i < kNumGBufferColors; ++i) {
+      image_infos[i] = {
+          sampler,                                   // sampler
+          *frame->views[i],                          // imageView
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+      };
+      writes[i] = {
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+          nullptr,                                 // pNext
+          *frame->set,                             // dstSet
+          i,                                       // dstbinding
+          0,                                       // dstArrayElement
+          1,                                       // descriptorCount
+          bindings[i].descriptorType,              // descriptorType
+          &image_infos[i],                         // pImageInfo
+          nullptr,                                 // pBufferInfo
+          nullptr,                                 // pTexelBufferView
+      };
+    }
+    app_->device()->vkUpdateDescriptorSets(app_->device(), kNumGBufferColors,
+                                           writes, 0, nullptr);
+  }
+
+  // Moves the G-buffer and the depth buffer to the layouts that they are
+  // in in between frames, so that the first frame can load them.
+  void InitializeLayouts(vulkan::VkCommandBuffer* cmd, const Variant& variant,
+                         const Frame& frame) {
+    VkImageMemoryBarrier barriers[kOutput];
+    for (uint32_t i = 0; i < kOutput; ++i) {
+      const VkImageLayout layout = RestingLayout(variant, i);
+      barriers[i] = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+          nullptr,                                 // pNext
+          0,                                       // srcAccessMask
+          static_cast<VkAccessFlags>(
+              i == kDepth ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                          : layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                ? VK_ACCESS_SHADER_READ_BIT
+                                : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT),
+          // dstAccessMask
+          VK_IMAGE_LAYOUT_UNDEFINED,  // oldLayout
+          layout,                     // newLayout
+          VK_QUEUE_FAMILY_IGNORED,    // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,    // dstQueueFamilyIndex
+          *frame.images[i],           // image
+          {static_cast<VkImageAspectFlags>(i == kDepth
+                                               ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                               : VK_IMAGE_ASPECT_COLOR_BIT),
+           0, 1, 0, 1}  // subresourceRange
+      };
+    }
+    (*cmd)->vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+                                 nullptr, 0, nullptr, kOutput, barriers);
+  }
+
+  // Records the G-buffer pass and the lighting of one frame.
+  void RecordFrame(vulkan::VkCommandBuffer* cmd, const Variant& variant,
+                   const Frame& frame) {
+    VkClearValue clear_values[kNumAttachments];
+    for (uint32_t i = 0; i < kNumAttachments; ++i) {
+      clear_values[i].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    }
+    clear_values[kDepth].depthStencil = {1.0f, 0};
+    const uint32_t num_clear_values =
+        variant.subpasses ? kNumAttachments : kOutput;
+    VkRenderPassBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *frame.render_passes[0],                   // renderPass
+        *frame.framebuffers[0],                    // framebuffer
+        {{0, 0}, {width_, height_}},               // renderArea
+        num_clear_values,                          // clearValueCount
+        clear_values                               // pClearValues
+    };
+    (*cmd)->vkCmdBeginRenderPass(*cmd, &begin_info,
+                                 VK_SUBPASS_CONTENTS_INLINE);
+    (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              *frame.gbuffer_pipeline);
+    (*cmd)->vkCmdDraw(*cmd, 3, 1, 0, 0);
+    if (variant.subpasses) {
+      (*cmd)->vkCmdNextSubpass(*cmd, VK_SUBPASS_CONTENTS_INLINE);
+    } else {
+      (*cmd)->vkCmdEndRenderPass(*cmd);
+      begin_info.renderPass = *frame.render_passes[1];
+      begin_info.framebuffer = *frame.framebuffers[1];
+      begin_info.clearValueCount = 0;
+      begin_info.pClearValues = nullptr;
+      (*cmd)->vkCmdBeginRenderPass(*cmd, &begin_info,
+                                   VK_SUBPASS_CONTENTS_INLINE);
+    }
+    (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              *frame.lighting_pipeline);
+    (*cmd)->vkCmdBindDescriptorSets(
+        *cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        variant.subpasses ? *input_layout_ : *sampled_layout_, 0, 1,
+        &frame.set->raw_set(), 0, nullptr);
+    (*cmd)->vkCmdDraw(*cmd, 3, 1, 0, 0);
+    (*cmd)->vkCmdEndRenderPass(*cmd);
+  }
+
+  // Returns the fastest of kNumRuns runs of frames_ frames of |variant|, in
+  // nanoseconds, or a negative number if it could not be measured.
+  double Measure(const Variant& variant) {
+    Frame frame;
+    CreateImages(variant, &frame);
+    CreateRenderPasses(variant, &frame);
+    CreateDescriptorSet(variant, &frame);
+
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      InitializeLayouts(&cmd, variant, frame);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               query_pool_, 0);
+      for (uint32_t i = 0; i < frames_; ++i) {
+        RecordFrame(&cmd, variant, frame);
+      }
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      cmd->vkEndCommandBuffer(cmd);
+
+      VkSubmitInfo submit_info = {
+          VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+          nullptr,                        // pNext
+          0,                              // waitSemaphoreCount
+          nullptr,                        // pWaitSemaphores
+          nullptr,                        // pWaitDstStageMask
+          1,                              // commandBufferCount
+          &cmd.get_command_buffer(),      // pCommandBuffers
+          0,                              // signalSemaphoreCount
+          nullptr                         // pSignalSemaphores
+      };
+      queue->vkQueueSubmit(queue, 1, &submit_info, ::VkFence(0));
+      queue->vkQueueWaitIdle(queue);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    return best;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t frames_;
+  uint64_t timestamp_mask_;
+  bool lazily_allocated_memory_;
+  vulkan::VkQueryPool query_pool_;
+  vulkan::VkSampler sampler_;
+  VkDescriptorSetLayoutBinding input_bindings_[kNumGBufferColors];
+  VkDescriptorSetLayoutBinding sampled_bindings_[kNumGBufferColors];
+  containers::unique_ptr<vulkan::PipelineLayout> gbuffer_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> input_layout_;
+  containers::unique_ptr<vulkan::PipelineLayout> sampled_layout_;
+};
+}  // anonymous namespace
+
+// This sample renders a G-buffer and lights it, either as two subpasses of
+// one render pass that read input attachments, or as two render passes
+// where the lighting samples the stored G-buffer, with transient attachments
+// and different load and store ops. For every variant it logs:
+//   TILE_MEMORY: variant: <name> subpasses: <0|1> transient: <0|1>
+//       load: <op> store: <op> ms_per_frame: <ms>
+//       estimated_mb_per_frame: <mb>
+// where estimated_mb_per_frame is what the load and store ops and the
+// sampling would move to and from memory without compression.
+// -sample-option=variant=<name> only measures one variant, and width,
+// height and frames set the size and the number of frames of every run.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data);
+  TileMemoryBenchmark benchmark(data, &app);
+  benchmark.Run(data->sample_option("variant"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -397,7 +397,7 @@ int main_entry(const entry::EntryData* data) {
     auto current_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> elapsed_time = current_time - last_frame_time;
     last_frame_time = current_time;
-    float fdt = data->fixed_timestep() ? 0.1f : elapsed_time.count();
+    float fdt = data->FrameTime(elapsed_time.count());
     float speed = fdt;
     uint32_t image_i;
 
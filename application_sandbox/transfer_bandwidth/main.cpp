@@ -0,0 +1,657 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <functional>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t compute_copy_shader[] =
+#include "compute_copy.comp.spv"
+    ;
+
+namespace {
+// This must match the local_size_x of compute_copy.comp.
+const uint32_t kComputeCopyGroupSize = 256;
+// The smallest maxComputeWorkGroupCount[0] that a device may have. The
+// shader loops over whatever the dispatch does not cover.
+const uint32_t kMaxComputeCopyGroups = 65535;
+
+const VkDeviceSize kMiB = 1024 * 1024;
+const VkDeviceSize kMinSize = 4 * 1024;
+const VkDeviceSize kDefaultMaxSize = 1024 * kMiB;
+// Every size is repeated until about this many bytes are moved in one
+// submission, so that the small sizes are not just the cost of a timestamp.
+const VkDeviceSize kBytesPerMeasurement = 256 * kMiB;
+const uint32_t kMaxRepeats = 256;
+
+// The queue types that a test can run on.
+enum QueueType {
+  kGraphicsQueue = 1 << 0,
+  kComputeQueue = 1 << 1,
+  kTransferQueue = 1 << 2,
+};
+
+struct QueueInfo {
+  const char* name;
+  QueueType type;
+  vulkan::VkQueue* queue;
+};
+
+enum Test {
+  kCopyBuffer,
+  kUpload,
+  kDownload,
+  kFillBuffer,
+  kCopyBufferToImage,
+  kBlitImage,
+  kComputeCopy,
+  kNumTests,
+};
+
+struct TestInfo {
+  const char* name;
+  // A mask of QueueType. vkCmdFillBuffer is only allowed on transfer
+  // queues with VK_KHR_maintenance1, and vkCmdBlitImage and compute copies
+  // need a queue that supports graphics or compute work.
+  uint32_t queue_types;
+  // True if the test is repeated for every format and tiling.
+  bool uses_images;
+};
+
+const TestInfo kTests[kNumTests] = {
+    {"copy_buffer", kGraphicsQueue | kComputeQueue | kTransferQueue, false},
+    {"upload", kGraphicsQueue | kComputeQueue | kTransferQueue, false},
+    {"download", kGraphicsQueue | kComputeQueue | kTransferQueue, false},
+    {"fill_buffer", kGraphicsQueue | kComputeQueue, false},
+    {"copy_buffer_to_image", kGraphicsQueue | kComputeQueue | kTransferQueue,
+     true},
+    {"blit_image", kGraphicsQueue, true},
+    {"compute_copy", kGraphicsQueue | kComputeQueue, false},
+};
+
+struct FormatInfo {
+  const char* name;
+  VkFormat format;
+  uint32_t texel_size;
+};
+
+const FormatInfo kFormats[] = {
+    {"r8", VK_FORMAT_R8_UNORM, 1},
+    {"rgba8", VK_FORMAT_R8G8B8A8_UNORM, 4},
+    {"rgba16f", VK_FORMAT_R16G16B16A16_SFLOAT, 8},
+    {"rgba32f", VK_FORMAT_R32G32B32A32_SFLOAT, 16},
+};
+
+struct TilingInfo {
+  const char* name;
+  VkImageTiling tiling;
+};
+
+const TilingInfo kTilings[] = {
+    {"optimal", VK_IMAGE_TILING_OPTIMAL},
+    {"linear", VK_IMAGE_TILING_LINEAR},
+};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+void Submit(vulkan::VkQueue* queue, vulkan::VkCommandBuffer* cmd) {
+  VkSubmitInfo submit_info = {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,      // sType
+      nullptr,                            // pNext
+      0,                                  // waitSemaphoreCount
+      nullptr,                            // pWaitSemaphores
+      nullptr,                            // pWaitDstStageMask
+      1,                                  // commandBufferCount
+      &cmd->get_command_buffer(),         // pCommandBuffers
+      0,                                  // signalSemaphoreCount
+      nullptr                             // pSignalSemaphores
+  };
+  (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+  (*queue)->vkQueueWaitIdle(*queue);
+}
+
+// Times the commands that |record| records, with a pair of timestamps.
+class Timer {
+ public:
+  explicit Timer(vulkan::VulkanApplication* app)
+      : app_(app),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })) {}
+
+  // Records |prepare|, and |record| once to warm up, outside of the
+  // timestamps, and then |record| |repeats| times in between them. Returns
+  // the time of the repeats in seconds, or a negative number if it could not
+  // be measured. |queue| is idle afterwards.
+  double Time(const QueueInfo& queue, uint32_t repeats,
+              const std::function<void(vulkan::VkCommandBuffer*)>& prepare,
+              const std::function<void(vulkan::VkCommandBuffer*)>& record) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        app_->GetAllocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[queue.queue->index()].timestampValidBits;
+    if (valid_bits == 0) {
+      return -1.0;
+    }
+    const uint64_t mask =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    // vkCmdResetQueryPool can not be recorded for transfer queues, so the
+    // pool is always reset on the render queue.
+    vulkan::VkCommandBuffer reset_cmd =
+        app_->GetCommandBuffer(app_->render_queue().index());
+    reset_cmd->vkBeginCommandBuffer(reset_cmd, &kBeginInfo);
+    reset_cmd->vkCmdResetQueryPool(reset_cmd, query_pool_, 0, 2);
+    reset_cmd->vkEndCommandBuffer(reset_cmd);
+    Submit(&app_->render_queue(), &reset_cmd);
+
+    vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.queue->index());
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    if (prepare) {
+      prepare(&cmd);
+    }
+    record(&cmd);
+    const VkAccessFlags all_memory =
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    VkMemoryBarrier barrier{
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        all_memory,                        // srcAccessMask
+        all_memory,                        // dstAccessMask
+    };
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                              VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                              &barrier, 0, nullptr, 0, nullptr);
+    cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             query_pool_, 0);
+    // There are no barriers in between the repeats. They all write the same
+    // memory, but its contents do not matter, and a barrier would measure
+    // the latency of the command rather than the bandwidth.
+    for (uint32_t i = 0; i < repeats; ++i) {
+      record(&cmd);
+    }
+    cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             query_pool_, 1);
+    cmd->vkEndCommandBuffer(cmd);
+    Submit(queue.queue, &cmd);
+
+    uint64_t timestamps[2];
+    if (app_->device()->vkGetQueryPoolResults(
+            app_->device(), query_pool_, 0, 2, sizeof(timestamps), timestamps,
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+      return -1.0;
+    }
+    const uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+    return ticks * app_->device().limits().timestampPeriod / 1000000000.0;
+  }
+
+ private:
+  vulkan::VulkanApplication* app_;
+  vulkan::VkQueryPool query_pool_;
+};
+
+uint32_t RepeatsForSize(VkDeviceSize size) {
+  VkDeviceSize repeats = kBytesPerMeasurement / size;
+  if (repeats < 1) {
+    return 1;
+  }
+  return repeats > kMaxRepeats ? kMaxRepeats : static_cast<uint32_t>(repeats);
+}
+
+// Returns the largest power of two that is not larger than |value|.
+VkDeviceSize RoundDownToPowerOfTwo(VkDeviceSize value) {
+  VkDeviceSize result = 1;
+  while (result <= value / 2) {
+    result *= 2;
+  }
+  return result;
+}
+
+// Returns the extent of a 2D image with |num_texels| texels, which must be a
+// power of two, that is as close to square as possible.
+VkExtent3D ImageExtent(VkDeviceSize num_texels) {
+  uint32_t log2 = 0;
+  while ((VkDeviceSize(1) << (log2 + 1)) <= num_texels) {
+    ++log2;
+  }
+  return {1u << ((log2 + 1) / 2), 1u << (log2 / 2), 1};
+}
+
+// Creates an image of |format| and |tiling| with the given extent, or returns
+// nullptr if the device does not support it.
+containers::unique_ptr<vulkan::VulkanApplication::Image> CreateImage(
+    vulkan::VulkanApplication* app, const FormatInfo& format,
+    VkImageTiling tiling, VkImageUsageFlags usage, const VkExtent3D& extent,
+    bool blit) {
+  VkFormatProperties format_properties;
+  app->instance()->vkGetPhysicalDeviceFormatProperties(
+      app->device().physical_device(), format.format, &format_properties);
+  const VkFormatFeatureFlags features =
+      tiling == VK_IMAGE_TILING_LINEAR
+          ? format_properties.linearTilingFeatures
+          : format_properties.optimalTilingFeatures;
+  const VkFormatFeatureFlags blit_features =
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+  if (blit && (features & blit_features) != blit_features) {
+    return nullptr;
+  }
+
+  VkImageFormatProperties image_properties;
+  if (app->instance()->vkGetPhysicalDeviceImageFormatProperties(
+          app->device().physical_device(), format.format, VK_IMAGE_TYPE_2D,
+          tiling, usage, 0, &image_properties) != VK_SUCCESS) {
+    return nullptr;
+  }
+  if (extent.width > image_properties.maxExtent.width ||
+      extent.height > image_properties.maxExtent.height ||
+      VkDeviceSize(extent.width) * extent.height * format.texel_size >
+          image_properties.maxResourceSize) {
+    return nullptr;
+  }
+
+  VkImageCreateInfo image_create_info{
+      VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+      nullptr,                              // pNext
+      0,                                    // flags
+      VK_IMAGE_TYPE_2D,                     // imageType
+      format.format,                        // format
+      extent,                               // extent
+      1,                                    // mipLevels
+      1,                                    // arrayLayers
+      VK_SAMPLE_COUNT_1_BIT,                // samples
+      tiling,                               // tiling
+      usage,                                // usage
+      VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+      0,                                    // queueFamilyIndexCount
+      nullptr,                              // pQueueFamilyIndices
+      VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+  };
+  return app->CreateAndBindImage(&image_create_info);
+}
+
+void TransitionImage(vulkan::VkCommandBuffer* cmd, ::VkImage image,
+                     VkImageLayout layout, VkAccessFlags access) {
+  VkImageMemoryBarrier barrier{
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+      nullptr,                                 // pNext
+      0,                                       // srcAccessMask
+      access,                                  // dstAccessMask
+      VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+      layout,                                  // newLayout
+      VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+      VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+      image,                                   // image
+      {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}  // subresourceRange
+  };
+  (*cmd)->vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                               0, nullptr, 1, &barrier);
+}
+
+// Returns true if |option| is not given, or names |name|.
+bool Selected(const char* option, const char* name) {
+  return option == nullptr || strcmp(option, name) == 0;
+}
+}  // anonymous namespace
+
+// This sample measures the bandwidth of the transfer commands, and of a
+// compute shader that copies a buffer, for sizes from 1 GiB down to 4 KiB.
+// Every test is run on the graphics, async compute and transfer queues that
+// it is allowed on, and the image tests for a few formats and both tilings.
+// The results are logged as:
+//   BANDWIDTH: test: <test> queue: <queue> size: <bytes> [format: <format>
+//   tiling: <tiling>] GB/s: <bandwidth>
+// which together are a fingerprint of the memory system of the device.
+// -sample-option=max_size=<MiB> lowers the largest size, and
+// -sample-option=test=<test> and -sample-option=queue=<queue> run only one
+// test or queue.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  // The arenas grow as the buffers and images are created, so they start
+  // out small.
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data, {}, {}, {0}, 1024 * 1024,
+      1024 * 1024, 1024 * 1024, 1024 * 1024, true, false, false, 0, false,
+      false, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, false, false, nullptr, false,
+      false, nullptr, vulkan::ArenaStrategy::kOrderedFreeList, true);
+  vulkan::VkDevice& device = app.device();
+  const VkPhysicalDeviceLimits& limits = device.limits();
+
+  // There are two device buffers, a host buffer, and up to two images of the
+  // largest size, so the largest size is at most a quarter of the largest
+  // device local heap.
+  VkDeviceSize max_size = kDefaultMaxSize;
+  const char* max_size_option = data->sample_option("max_size");
+  if (max_size_option) {
+    max_size = strtoull(max_size_option, nullptr, 10) * kMiB;
+  }
+  const VkPhysicalDeviceMemoryProperties& memory_properties =
+      device.physical_device_memory_properties();
+  VkDeviceSize largest_heap = 0;
+  for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+    if ((memory_properties.memoryHeaps[i].flags &
+         VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+        memory_properties.memoryHeaps[i].size > largest_heap) {
+      largest_heap = memory_properties.memoryHeaps[i].size;
+    }
+  }
+  if (max_size > largest_heap / 4) {
+    max_size = largest_heap / 4;
+  }
+  max_size = RoundDownToPowerOfTwo(max_size);
+  if (max_size < kMinSize) {
+    max_size = kMinSize;
+  }
+  const char* test_option = data->sample_option("test");
+  const char* queue_option = data->sample_option("queue");
+
+  containers::vector<QueueInfo> queues(data->allocator());
+  queues.push_back({"graphics", kGraphicsQueue, &app.render_queue()});
+  if (app.async_compute_queue()) {
+    queues.push_back({"compute", kComputeQueue, app.async_compute_queue()});
+  }
+  if (app.transfer_queue()) {
+    queues.push_back({"transfer", kTransferQueue, app.transfer_queue()});
+  }
+
+  const VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  // The buffers are used on every queue without ownership transfers, since
+  // what they hold does not matter.
+  auto source_buffer =
+      app.CreateAndBindDefaultExclusiveDeviceBuffer(max_size, usage);
+  auto destination_buffer =
+      app.CreateAndBindDefaultExclusiveDeviceBuffer(max_size, usage);
+  auto host_buffer = app.CreateAndBindDefaultExclusiveHostBuffer(
+      max_size,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+  VkDescriptorSetLayoutBinding bindings[2] = {
+      {
+          0,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      },
+      {
+          1,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      }};
+  VkPushConstantRange count_range{
+      VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+      0,                            // offset
+      sizeof(uint32_t)              // size
+  };
+  auto compute_descriptor_set = containers::make_unique<vulkan::DescriptorSet>(
+      data->allocator(), app.AllocateDescriptorSet({bindings[0], bindings[1]}));
+  auto compute_pipeline_layout =
+      containers::make_unique<vulkan::PipelineLayout>(
+          data->allocator(),
+          app.CreatePipelineLayout({{bindings[0], bindings[1]}},
+                                   {count_range}));
+  auto compute_pipeline =
+      containers::make_unique<vulkan::VulkanComputePipeline>(
+          data->allocator(),
+          app.CreateComputePipeline(
+              compute_pipeline_layout.get(),
+              VkShaderModuleCreateInfo{
+                  VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                  sizeof(compute_copy_shader), compute_copy_shader},
+              "main"));
+
+  Timer timer(&app);
+  auto log_result = [&](const char* test, const QueueInfo& queue,
+                        VkDeviceSize size, uint32_t repeats, double seconds,
+                        const FormatInfo* format, const TilingInfo* tiling) {
+    if (seconds <= 0.0) {
+      data->logger()->LogInfo("BANDWIDTH: test: ", test, " queue: ",
+                              queue.name, " size: ", size,
+                              " could not be measured");
+      return;
+    }
+    const double gb_per_second = size * repeats / seconds / 1000000000.0;
+    if (format) {
+      data->logger()->LogInfo("BANDWIDTH: test: ", test, " queue: ",
+                              queue.name, " size: ", size, " format: ",
+                              format->name, " tiling: ", tiling->name,
+                              " GB/s: ", gb_per_second);
+    } else {
+      data->logger()->LogInfo("BANDWIDTH: test: ", test, " queue: ",
+                              queue.name, " size: ", size,
+                              " GB/s: ", gb_per_second);
+    }
+  };
+
+  for (uint32_t t = 0; t < kNumTests; ++t) {
+    const TestInfo& test = kTests[t];
+    if (!Selected(test_option, test.name)) {
+      continue;
+    }
+    for (const QueueInfo& queue : queues) {
+      if (!(test.queue_types & queue.type) ||
+          !Selected(queue_option, queue.name)) {
+        continue;
+      }
+      // The sizes go from largest to smallest, so that the memory of the
+      // images of one size can be reused by the next.
+      for (VkDeviceSize size = max_size; size >= kMinSize; size /= 4) {
+        const uint32_t repeats = RepeatsForSize(size);
+        VkBufferCopy region{0, 0, size};
+        switch (static_cast<Test>(t)) {
+          case kCopyBuffer:
+            log_result(test.name, queue, size, repeats,
+                       timer.Time(queue, repeats, nullptr,
+                                  [&](vulkan::VkCommandBuffer* cmd) {
+                                    (*cmd)->vkCmdCopyBuffer(
+                                        *cmd, *source_buffer,
+                                        *destination_buffer, 1, &region);
+                                  }),
+                       nullptr, nullptr);
+            break;
+          case kUpload:
+            log_result(test.name, queue, size, repeats,
+                       timer.Time(queue, repeats, nullptr,
+                                  [&](vulkan::VkCommandBuffer* cmd) {
+                                    (*cmd)->vkCmdCopyBuffer(
+                                        *cmd, *host_buffer,
+                                        *destination_buffer, 1, &region);
+                                  }),
+                       nullptr, nullptr);
+            break;
+          case kDownload:
+            log_result(test.name, queue, size, repeats,
+                       timer.Time(queue, repeats, nullptr,
+                                  [&](vulkan::VkCommandBuffer* cmd) {
+                                    (*cmd)->vkCmdCopyBuffer(
+                                        *cmd, *source_buffer, *host_buffer, 1,
+                                        &region);
+                                  }),
+                       nullptr, nullptr);
+            break;
+          case kFillBuffer:
+            log_result(test.name, queue, size, repeats,
+                       timer.Time(queue, repeats, nullptr,
+                                  [&](vulkan::VkCommandBuffer* cmd) {
+                                    (*cmd)->vkCmdFillBuffer(
+                                        *cmd, *destination_buffer, 0, size,
+                                        0x3f800000);
+                                  }),
+                       nullptr, nullptr);
+            break;
+          case kComputeCopy: {
+            if (size > limits.maxStorageBufferRange) {
+              continue;
+            }
+            VkDescriptorBufferInfo buffer_infos[2] = {
+                {*source_buffer, 0, size}, {*destination_buffer, 0, size}};
+            VkWriteDescriptorSet write{
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+                nullptr,                                 // pNext
+                *compute_descriptor_set,                 // dstSet
+                0,                                       // dstBinding
+                0,                                       // dstArrayElement
+                1,                                       // descriptorCount
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+                nullptr,                                 // pImageInfo
+                &buffer_infos[0],                        // pBufferInfo
+                nullptr,                                 // pTexelBufferView
+            };
+            VkWriteDescriptorSet writes[2] = {write, write};
+            writes[1].dstBinding = 1;
+            writes[1].pBufferInfo = &buffer_infos[1];
+            device->vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+
+            // Every invocation copies a uvec4 at a time.
+            const uint32_t count = static_cast<uint32_t>(size / 16);
+            uint32_t groups =
+                (count + kComputeCopyGroupSize - 1) / kComputeCopyGroupSize;
+            if (groups > kMaxComputeCopyGroups) {
+              groups = kMaxComputeCopyGroups;
+            }
+            log_result(
+                test.name, queue, size, repeats,
+                timer.Time(
+                    queue, repeats,
+                    [&](vulkan::VkCommandBuffer* cmd) {
+                      (*cmd)->vkCmdBindPipeline(
+                          *cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          *compute_pipeline);
+                      (*cmd)->vkCmdBindDescriptorSets(
+                          *cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          *compute_pipeline_layout, 0, 1,
+                          &compute_descriptor_set->raw_set(), 0, nullptr);
+                      (*cmd)->vkCmdPushConstants(
+                          *cmd, *compute_pipeline_layout,
+                          VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(count),
+                          &count);
+                    },
+                    [&](vulkan::VkCommandBuffer* cmd) {
+                      (*cmd)->vkCmdDispatch(*cmd, groups, 1, 1);
+                    }),
+                nullptr, nullptr);
+            break;
+          }
+          case kCopyBufferToImage:
+          case kBlitImage: {
+            const bool blit = t == kBlitImage;
+            for (const FormatInfo& format : kFormats) {
+              for (const TilingInfo& tiling : kTilings) {
+                // The images have a power of two number of texels, so
+                // every row is tightly packed in the buffer.
+                const VkDeviceSize num_texels =
+                    RoundDownToPowerOfTwo(size / format.texel_size);
+                const VkDeviceSize image_size = num_texels * format.texel_size;
+                const VkExtent3D extent = ImageExtent(num_texels);
+                const VkImageUsageFlags image_usage =
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+                auto destination_image = CreateImage(
+                    &app, format, tiling.tiling, image_usage, extent, blit);
+                if (!destination_image) {
+                  continue;
+                }
+                containers::unique_ptr<vulkan::VulkanApplication::Image>
+                    source_image;
+                if (blit) {
+                  source_image = CreateImage(&app, format, tiling.tiling,
+                                             image_usage, extent, blit);
+                  if (!source_image) {
+                    continue;
+                  }
+                }
+                const VkImageSubresourceLayers layers{
+                    VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+                const VkBufferImageCopy copy{
+                    0,          // bufferOffset
+                    0,          // bufferRowLength
+                    0,          // bufferImageHeight
+                    layers,     // imageSubresource
+                    {0, 0, 0},  // imageOffset
+                    extent      // imageExtent
+                };
+                const VkOffset3D end{static_cast<int32_t>(extent.width),
+                                     static_cast<int32_t>(extent.height), 1};
+                const VkImageBlit blit_region{
+                    layers,                  // srcSubresource
+                    {{0, 0, 0}, end},        // srcOffsets
+                    layers,                  // dstSubresource
+                    {{0, 0, 0}, end},        // dstOffsets
+                };
+                const double seconds = timer.Time(
+                    queue, repeats,
+                    [&](vulkan::VkCommandBuffer* cmd) {
+                      TransitionImage(cmd, *destination_image,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                      VK_ACCESS_TRANSFER_WRITE_BIT);
+                      if (blit) {
+                        TransitionImage(cmd, *source_image,
+                                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                        VK_ACCESS_TRANSFER_READ_BIT);
+                      }
+                    },
+                    [&](vulkan::VkCommandBuffer* cmd) {
+                      if (blit) {
+                        (*cmd)->vkCmdBlitImage(
+                            *cmd, *source_image,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            *destination_image,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                            &blit_region, VK_FILTER_NEAREST);
+                      } else {
+                        (*cmd)->vkCmdCopyBufferToImage(
+                            *cmd, *source_buffer, *destination_image,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+                      }
+                    });
+                log_result(test.name, queue, image_size, repeats, seconds,
+                           &format, &tiling);
+              }
+            }
+            break;
+          }
+          case kNumTests:
+            break;
+        }
+      }
+    }
+  }
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -333,94 +333,140 @@ class TransformFeedbackSample
     aspect_buffer_->UpdateBuffer(&app()->render_queue(), frame_index);
     vertex_buffer_->UpdateBuffer(&app()->render_queue(), 0);
 
-    // Write that buffer into the descriptor sets.
-    VkDescriptorBufferInfo buffer_infos[1] = {
-        {
-            aspect_buffer_->get_buffer(),                       // buffer
-            aspect_buffer_->get_offset_for_frame(frame_index),  // offset
-            aspect_buffer_->size(),                             // range
-        }};
-
-    VkWriteDescriptorSet writes[1]{
-        {
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
-            nullptr,                                 // pNext
-            *data->particle_descriptor_set_,         // dstSet
-            0,                                       // dstbinding
-            0,                                       // dstArrayElement
-            1,                                       // descriptorCount
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
-            nullptr,                                 // pImageInfo
-            &buffer_infos[0],                        // pBufferInfo
-            nullptr,                                 // pTexelBufferView
-        }
-    };
-
-    app()->device()->vkUpdateDescriptorSets(app()->device(), 1, writes, 0,
-                                            nullptr);
-
-    VkClearValue clear;
-    vulkan::MemoryClear(&clear);
-    clear.color.float32[3] = 1.0f;
-
-    // Record our command-buffer for transform feedback
-    (*data->transform_feedback_command_buffer_)
-        ->vkResetCommandBuffer((*data->transform_feedback_command_buffer_), 0);
-    (*data->transform_feedback_command_buffer_)
-        ->vkBeginCommandBuffer((*data->transform_feedback_command_buffer_),
-                               &sample_application::kBeginCommandBuffer);
-    vulkan::VkCommandBuffer& transform_feedback_cmd_buffer =
-        (*data->transform_feedback_command_buffer_);
-
-    VkRenderPassBeginInfo transform_feedback_pass_begin = {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        nullptr,                                   // pNext
-        *transform_feedback_render_pass_,          // renderPass
-        *data->transform_feedback_framebuffer_,    // framebuffer
-        {{0, 0},
-         {app()->swapchain().width(),
-          app()->swapchain().height()}},  // renderArea
-        0,                                // clearValueCount
-        &clear                            // clears
-    };
-
-    transform_feedback_cmd_buffer->vkCmdBeginRenderPass(
-        transform_feedback_cmd_buffer, &transform_feedback_pass_begin,
-                                    VK_SUBPASS_CONTENTS_INLINE);
-
-	VkBuffer tf_buffer = (*transform_feedback_buffer_.get());
-    VkDeviceSize offsets[1] = {0};
-    transform_feedback_cmd_buffer->vkCmdBindTransformFeedbackBuffersEXT(
-        transform_feedback_cmd_buffer, 0, 1, &tf_buffer, offsets, nullptr);
-
-    transform_feedback_cmd_buffer->vkCmdBeginTransformFeedbackEXT(
-        transform_feedback_cmd_buffer, 0, 0, nullptr, nullptr);
-
-    transform_feedback_cmd_buffer->vkCmdBindPipeline(
-        transform_feedback_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *transform_feedback_pipeline_);
-
-    transform_feedback_cmd_buffer->vkCmdBindDescriptorSets(
-        transform_feedback_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ::VkPipelineLayout(*transform_feedback_pipeline_layout_), 0, 1,
-        &data->particle_descriptor_set_->raw_set(), 0, nullptr);
-
-    ::VkBuffer vertex_buffers[1] = {vertex_buffer_->get_buffer()};
-    ::VkDeviceSize vertex_offsets[1] = {0};
-    transform_feedback_cmd_buffer->vkCmdBindVertexBuffers(
-        transform_feedback_cmd_buffer, 0, 1, vertex_buffers, vertex_offsets);
-
-    transform_feedback_cmd_buffer->vkCmdDraw(transform_feedback_cmd_buffer,
-                                             TOTAL_PARTICLES, 1, 0, 0);
-
-    transform_feedback_cmd_buffer->vkCmdEndTransformFeedbackEXT(
-        transform_feedback_cmd_buffer, 0, 0, nullptr, nullptr);
-
-    transform_feedback_cmd_buffer->vkCmdEndRenderPass(
-        transform_feedback_cmd_buffer);
-
-    (*data->transform_feedback_command_buffer_)
-        ->vkEndCommandBuffer(*data->transform_feedback_command_buffer_);
+    // The descriptor sets and command buffers of a frame never change, so
+    // they are only recorded the first time each frame is rendered.
+    if (!IsStaticFrameRecorded(frame_index, 0)) {
+      // Write that buffer into the descriptor sets.
+      VkDescriptorBufferInfo buffer_infos[1] = {
+          {
+              aspect_buffer_->get_buffer(),                       // buffer
+              aspect_buffer_->get_offset_for_frame(frame_index),  // offset
+              aspect_buffer_->size(),                             // range
+          }};
+
+      VkWriteDescriptorSet writes[1]{
+          {
+              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+              nullptr,                                 // pNext
+              *data->particle_descriptor_set_,         // dstSet
+              0,                                       // dstbinding
+              0,                                       // dstArrayElement
+              1,                                       // descriptorCount
+              VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+              nullptr,                                 // pImageInfo
+              &buffer_infos[0],                        // pBufferInfo
+              nullptr,                                 // pTexelBufferView
+          }
+      };
+
+      app()->device()->vkUpdateDescriptorSets(app()->device(), 1, writes, 0,
+                                              nullptr);
+
+      VkClearValue clear;
+      vulkan::MemoryClear(&clear);
+      clear.color.float32[3] = 1.0f;
+
+      // Record our command-buffer for transform feedback
+      (*data->transform_feedback_command_buffer_)
+          ->vkResetCommandBuffer((*data->transform_feedback_command_buffer_),
+                                 0);
+      (*data->transform_feedback_command_buffer_)
+          ->vkBeginCommandBuffer((*data->transform_feedback_command_buffer_),
+                                 &sample_application::kBeginCommandBuffer);
+      vulkan::VkCommandBuffer& transform_feedback_cmd_buffer =
+          (*data->transform_feedback_command_buffer_);
+
+      VkRenderPassBeginInfo transform_feedback_pass_begin = {
+          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+          nullptr,                                   // pNext
+          *transform_feedback_render_pass_,          // renderPass
+          *data->transform_feedback_framebuffer_,    // framebuffer
+          {{0, 0},
+           {app()->swapchain().width(),
+            app()->swapchain().height()}},  // renderArea
+          0,                                // clearValueCount
+          &clear                            // clears
+      };
+
+      transform_feedback_cmd_buffer->vkCmdBeginRenderPass(
+          transform_feedback_cmd_buffer, &transform_feedback_pass_begin,
+                                      VK_SUBPASS_CONTENTS_INLINE);
+
+  	VkBuffer tf_buffer = (*transform_feedback_buffer_.get());
+      VkDeviceSize offsets[1] = {0};
+      transform_feedback_cmd_buffer->vkCmdBindTransformFeedbackBuffersEXT(
+          transform_feedback_cmd_buffer, 0, 1, &tf_buffer, offsets, nullptr);
+
+      transform_feedback_cmd_buffer->vkCmdBeginTransformFeedbackEXT(
+          transform_feedback_cmd_buffer, 0, 0, nullptr, nullptr);
+
+      transform_feedback_cmd_buffer->vkCmdBindPipeline(
+          transform_feedback_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *transform_feedback_pipeline_);
+
+      transform_feedback_cmd_buffer->vkCmdBindDescriptorSets(
+          transform_feedback_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          ::VkPipelineLayout(*transform_feedback_pipeline_layout_), 0, 1,
+          &data->particle_descriptor_set_->raw_set(), 0, nullptr);
+
+      ::VkBuffer vertex_buffers[1] = {vertex_buffer_->get_buffer()};
+      ::VkDeviceSize vertex_offsets[1] = {0};
+      transform_feedback_cmd_buffer->vkCmdBindVertexBuffers(
+          transform_feedback_cmd_buffer, 0, 1, vertex_buffers, vertex_offsets);
+
+      transform_feedback_cmd_buffer->vkCmdDraw(transform_feedback_cmd_buffer,
+                                               TOTAL_PARTICLES, 1, 0, 0);
+
+      transform_feedback_cmd_buffer->vkCmdEndTransformFeedbackEXT(
+          transform_feedback_cmd_buffer, 0, 0, nullptr, nullptr);
+
+      transform_feedback_cmd_buffer->vkCmdEndRenderPass(
+          transform_feedback_cmd_buffer);
+
+      (*data->transform_feedback_command_buffer_)
+          ->vkEndCommandBuffer(*data->transform_feedback_command_buffer_);
+
+      // Record our command-buffer for rendering this frame
+      (*data->draw_command_buffer_)
+          ->vkResetCommandBuffer((*data->draw_command_buffer_), 0);
+      (*data->draw_command_buffer_)
+          ->vkBeginCommandBuffer((*data->draw_command_buffer_),
+                                 &sample_application::kBeginCommandBuffer);
+      vulkan::VkCommandBuffer& cmdBuffer = (*data->draw_command_buffer_);
+
+      // The rest of the normal drawing.
+      VkRenderPassBeginInfo pass_begin = {
+          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+          nullptr,                                   // pNext
+          *render_pass_,                             // renderPass
+          *data->framebuffer_,                       // framebuffer
+          {{0, 0},
+           {app()->swapchain().width(),
+            app()->swapchain().height()}},  // renderArea
+          1,                                // clearValueCount
+          &clear                            // clears
+      };
+
+      cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                      VK_SUBPASS_CONTENTS_INLINE);
+
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *particle_pipeline_);
+
+      cmdBuffer->vkCmdBindDescriptorSets(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+          &data->particle_descriptor_set_->raw_set(), 0, nullptr);
+
+      cmdBuffer->vkCmdBindVertexBuffers(cmdBuffer, 0, 1, vertex_buffers,
+                                        vertex_offsets);
+      cmdBuffer->vkCmdDraw(cmdBuffer, TOTAL_PARTICLES, 1, 0, 0);
+
+      cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+
+      (*data->draw_command_buffer_)
+          ->vkEndCommandBuffer(*data->draw_command_buffer_);
+    }
 
     VkSubmitInfo transform_feedback_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
@@ -439,47 +485,6 @@ class TransformFeedbackSample
                                          &transform_feedback_submit_info,
                                          static_cast<VkFence>(VK_NULL_HANDLE));
 
-    // Record our command-buffer for rendering this frame
-    (*data->draw_command_buffer_)
-        ->vkResetCommandBuffer((*data->draw_command_buffer_), 0);
-    (*data->draw_command_buffer_)
-        ->vkBeginCommandBuffer((*data->draw_command_buffer_),
-                               &sample_application::kBeginCommandBuffer);
-    vulkan::VkCommandBuffer& cmdBuffer = (*data->draw_command_buffer_);
-
-    // The rest of the normal drawing.
-    VkRenderPassBeginInfo pass_begin = {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
-        nullptr,                                   // pNext
-        *render_pass_,                             // renderPass
-        *data->framebuffer_,                       // framebuffer
-        {{0, 0},
-         {app()->swapchain().width(),
-          app()->swapchain().height()}},  // renderArea
-        1,                                // clearValueCount
-        &clear                            // clears
-    };
-
-    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
-                                    VK_SUBPASS_CONTENTS_INLINE);
-
-    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 *particle_pipeline_);
-
-    cmdBuffer->vkCmdBindDescriptorSets(
-        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
-        &data->particle_descriptor_set_->raw_set(), 0, nullptr);
-
-    cmdBuffer->vkCmdBindVertexBuffers(cmdBuffer, 0, 1, vertex_buffers,
-                                      vertex_offsets);
-    cmdBuffer->vkCmdDraw(cmdBuffer, TOTAL_PARTICLES, 1, 0, 0);
-
-    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
-
-    (*data->draw_command_buffer_)
-        ->vkEndCommandBuffer(*data->draw_command_buffer_);
-
     VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
 
     VkSubmitInfo init_submit_info{
@@ -0,0 +1,684 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/structure_chain.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector3 = mathfu::Vector<float, 3>;
+
+namespace cube_model {
+#include "cube.obj.h"
+}
+namespace prism_model {
+#include "prism.obj.h"
+}
+namespace torus_knot_model {
+#include "torus_knot.obj.h"
+}
+const auto& cube_data = cube_model::model;
+const auto& prism_data = prism_model::model;
+const auto& torus_knot_data = torus_knot_model::model;
+
+uint32_t vertex_input_vertex_shader[] =
+#include "vertex_input.vert.spv"
+    ;
+
+uint32_t vertex_pulling_vertex_shader[] =
+#include "vertex_pulling.vert.spv"
+    ;
+
+uint32_t vertex_pulling_fragment_shader[] =
+#include "vertex_pulling.frag.spv"
+    ;
+
+// The ways in which the vertices reach the vertex shader.
+enum class VertexPath {
+  // Vertex input, with the bindings and attributes of the layout of the
+  // model.
+  kVertexInput,
+  // No vertex input, the vertex shader reads the vertex buffer through its
+  // device address, which it gets in push constants.
+  kVertexPulling,
+};
+
+struct VertexPathInfo {
+  VertexPath path;
+  // The VulkanModelLayoutFlags of the models of the path.
+  uint32_t layout_flags;
+  // The name of the path in the sample options, and of its GPU zone.
+  const char* name;
+};
+
+const VertexPathInfo kVertexPaths[] = {
+    {VertexPath::kVertexInput, 0, "planar"},
+    {VertexPath::kVertexInput, vulkan::kModelLayoutInterleaved,
+     "interleaved"},
+    {VertexPath::kVertexInput,
+     vulkan::kModelLayoutQuantizedAttributes |
+         vulkan::kModelLayoutQuantizedPositions,
+     "quantized"},
+    {VertexPath::kVertexPulling, vulkan::kModelLayoutDeviceAddress,
+     "vertex_pulling"},
+};
+const size_t kNumVertexPaths = sizeof(kVertexPaths) / sizeof(kVertexPaths[0]);
+
+// The names of the standard models in the sample options.
+const char* const kModelNames[] = {"cube", "prism", "torus_knot"};
+const size_t kNumModels = sizeof(kModelNames) / sizeof(kModelNames[0]);
+
+// The number of instances of the model that are drawn, unless
+// instances=<N> was given.
+const uint32_t kDefaultInstances = 1000;
+
+// The frames of every configuration that are measured, after the warmup
+// frames, which let the frames in flight and the GPU times of the previous
+// configuration drain.
+const uint32_t kDefaultFramesPerConfig = 120;
+const uint32_t kWarmupFrames = 30;
+
+// The storage buffer data of every instance, the position of its center,
+// and its scale.
+struct ObjectData {
+  float position[3];
+  float scale;
+};
+
+// The push constants of vertex_pulling.vert.
+struct PullingData {
+  ::VkDeviceAddress vertices;
+  uint32_t num_vertices;
+};
+
+// One model, drawn with one path.
+struct BenchmarkConfig {
+  size_t model_index;
+  size_t path_index;
+};
+
+using DeviceFeatures =
+    vulkan::StructureChain<VkPhysicalDeviceBufferDeviceAddressFeaturesKHR>;
+
+struct VertexPullingBenchmarkFrameData {
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> descriptor_set_;
+};
+
+// This draws a grid of instances of every standard model, with vertex input
+// from planar, interleaved and quantized vertex buffers, and with the vertex
+// shader pulling its vertices through the device address of the vertex
+// buffer, and logs the GPU time and vertex throughput of every path. All of
+// the paths use the same index buffer, and draw exactly the same thing.
+class VertexPullingBenchmark
+    : public sample_application::Sample<VertexPullingBenchmarkFrameData> {
+ public:
+  VertexPullingBenchmark(const entry::EntryData* data,
+                         DeviceFeatures* device_features)
+      : data_(data),
+        Sample<VertexPullingBenchmarkFrameData>(
+            data->allocator(), data, 1, 512, 128, 1,
+            sample_application::SampleOptions()
+                .EnableGpuProfiler(1)
+                .AddDeviceExtensionStructure(device_features->head()),
+            {0}, {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+            {VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME}),
+        configs_(data->allocator()),
+        num_instances_(kDefaultInstances),
+        frames_per_config_(kDefaultFramesPerConfig),
+        config_index_(0),
+        config_frame_(0),
+        done_(false),
+        gpu_time_(0.0),
+        num_gpu_times_(0) {
+    const char* frames_option = data->sample_option("frames_per_config");
+    if (frames_option) {
+      frames_per_config_ =
+          static_cast<uint32_t>(strtoul(frames_option, nullptr, 10));
+    }
+    if (frames_per_config_ <= kWarmupFrames) {
+      frames_per_config_ = kWarmupFrames + 1;
+    }
+    const char* instances_option = data->sample_option("instances");
+    if (instances_option) {
+      num_instances_ =
+          static_cast<uint32_t>(strtoul(instances_option, nullptr, 10));
+    }
+    if (num_instances_ == 0) {
+      num_instances_ = 1;
+    }
+
+    // Every path has its own copy of every model, in the layout of the
+    // path.
+    for (size_t i = 0; i < kNumVertexPaths; ++i) {
+      const uint32_t flags = kVertexPaths[i].layout_flags;
+      models_[i][0] = containers::make_unique<vulkan::VulkanModel>(
+          data->allocator(), data->allocator(), data->logger(), cube_data,
+          flags);
+      models_[i][1] = containers::make_unique<vulkan::VulkanModel>(
+          data->allocator(), data->allocator(), data->logger(), prism_data,
+          flags);
+      models_[i][2] = containers::make_unique<vulkan::VulkanModel>(
+          data->allocator(), data->allocator(), data->logger(),
+          torus_knot_data, flags);
+    }
+
+    const char* model_option = data->sample_option("model");
+    const char* path_option = data->sample_option("path");
+    for (size_t model = 0; model < kNumModels; ++model) {
+      if (model_option && strcmp(model_option, kModelNames[model]) != 0) {
+        continue;
+      }
+      for (size_t i = 0; i < kNumVertexPaths; ++i) {
+        if (path_option && strcmp(path_option, kVertexPaths[i].name) != 0) {
+          continue;
+        }
+        configs_.push_back({model, i});
+      }
+    }
+    if (configs_.empty()) {
+      data->logger()->LogError("Unknown model ", model_option, " or path ",
+                               path_option);
+      for (size_t i = 0; i < kNumVertexPaths; ++i) {
+        configs_.push_back({0, i});
+      }
+    }
+  }
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    for (auto& path_models : models_) {
+      for (auto& model : path_models) {
+        model->InitializeData(app(), initialization_buffer);
+      }
+    }
+
+    // The instances never change, so they are copied to the device once.
+    const VkDeviceSize object_size = num_instances_ * sizeof(ObjectData);
+    staging_buffer_ = app()->CreateAndBindDefaultExclusiveHostBuffer(
+        object_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    object_buffer_ = app()->CreateAndBindDefaultExclusiveDeviceBuffer(
+        object_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    LayOutObjects(initialization_buffer);
+
+    for (uint32_t i = 0; i < 3; ++i) {
+      descriptor_set_layouts_[i] = {
+          i,  // binding
+          i < 2 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_VERTEX_BIT,                 // stageFlags
+          nullptr                                     // pImmutableSamplers
+      };
+    }
+    // Only the pulling path uses the push constants, but both pipelines
+    // have the same layout.
+    VkPushConstantRange pulling_range = {
+        VK_SHADER_STAGE_VERTEX_BIT,  // stageFlags
+        0,                           // offset
+        sizeof(PullingData)          // size
+    };
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{descriptor_set_layouts_[0],
+                                      descriptor_set_layouts_[1],
+                                      descriptor_set_layouts_[2]}},
+                                    {pulling_range}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stenilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stenilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    // Every standard model has the same vertex input in the same layout,
+    // so one pipeline per path draws all of them. The quantized formats are
+    // only known once the models have been initialized.
+    for (size_t i = 0; i < kNumVertexPaths; ++i) {
+      pipelines_[i] =
+          kVertexPaths[i].path == VertexPath::kVertexInput
+              ? CreatePipeline(vertex_input_vertex_shader, models_[i][0].get())
+              : CreatePipeline(vertex_pulling_vertex_shader, nullptr);
+    }
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(Vector3{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+
+    // Every instance rotates around its own center.
+    model_data_->data().transform = Mat44::Identity();
+    SetPositionTransform(*models_[0][0]);
+  }
+
+  virtual void InitializeFrameData(
+      VertexPullingBenchmarkFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({descriptor_set_layouts_[0],
+                                          descriptor_set_layouts_[1],
+                                          descriptor_set_layouts_[2]}));
+
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            model_data_->get_buffer(),                       // buffer
+            model_data_->get_offset_for_frame(frame_index),  // offset
+            model_data_->size(),                             // range
+        },
+        {
+            *object_buffer_,  // buffer
+            0,                // offset
+            VK_WHOLE_SIZE,    // range
+        }};
+
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->descriptor_set_,            // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->descriptor_set_,            // dstSet
+            2,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos + 2,                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 2, writes, 0,
+                                            nullptr);
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void InitializationComplete() override {
+    for (auto& path_models : models_) {
+      for (auto& model : path_models) {
+        model->InitializationComplete();
+      }
+    }
+    staging_buffer_.reset();
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    model_data_->data().transform =
+        model_data_->data().transform *
+        Mat44::FromRotationMatrix(
+            Mat44::RotationX(3.14f * time_since_last_render) *
+            Mat44::RotationY(3.14f * time_since_last_render * 0.5f));
+  }
+  virtual void UpdateFrameBuffers(
+      size_t frame_index,
+      VertexPullingBenchmarkFrameData* frame_data) override {
+    const BenchmarkConfig& config = configs_[config_index_];
+    SetPositionTransform(*models_[config.path_index][config.model_index]);
+
+    // Update our uniform buffers.
+    camera_data_->UpdateBuffer(buffer_update_batch(), &app()->render_queue(),
+                               frame_index);
+    model_data_->UpdateBuffer(buffer_update_batch(), &app()->render_queue(),
+                              frame_index);
+  }
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      VertexPullingBenchmarkFrameData* frame_data) override {
+    const BenchmarkConfig& config = configs_[config_index_];
+    vulkan::VulkanModel* model =
+        models_[config.path_index][config.model_index].get();
+    const VertexPath path = kVertexPaths[config.path_index].path;
+
+    // Recycled from the last time this frame was rendered.
+    vulkan::VkCommandBuffer& cmdBuffer = *app()->GetFrameCommandBuffer();
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    const uint32_t zone = gpu_profiler()->BeginZone(
+        &cmdBuffer, kVertexPaths[config.path_index].name, false);
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *pipelines_[config.path_index]);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->descriptor_set_->raw_set(), 0, nullptr);
+
+    switch (path) {
+      case VertexPath::kVertexInput:
+        model->BindVertexAndIndexBuffers(&cmdBuffer);
+        break;
+      case VertexPath::kVertexPulling: {
+        // The vertex buffer is never bound, the address is all that the
+        // shader needs.
+        const PullingData pulling_data = {
+            model->GetVertexAddress(app()),               // vertices
+            static_cast<uint32_t>(model->NumVertices()),  // num_vertices
+        };
+        cmdBuffer->vkCmdPushConstants(
+            cmdBuffer, ::VkPipelineLayout(*pipeline_layout_),
+            VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pulling_data),
+            &pulling_data);
+        model->BindIndexBuffer(&cmdBuffer);
+        break;
+      }
+    }
+    cmdBuffer->vkCmdDrawIndexed(cmdBuffer,
+                                static_cast<uint32_t>(model->NumIndices()),
+                                num_instances_, 0, 0, 0);
+
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    gpu_profiler()->EndZone(&cmdBuffer, zone);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &cmdBuffer.get_command_buffer(),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    if (config_frame_ >= kWarmupFrames) {
+      // The GPU time is the one of the last frame that finished.
+      const float gpu_time =
+          gpu_profiler()->GetLastZoneTime(kVertexPaths[config.path_index].name);
+      if (gpu_time >= 0.0f) {
+        gpu_time_ += gpu_time * 1000.0;
+        ++num_gpu_times_;
+      }
+    }
+    if (++config_frame_ == frames_per_config_) {
+      const double average =
+          num_gpu_times_ > 0 ? gpu_time_ / num_gpu_times_ : -1.0;
+      // Every index is counted as a vertex, which is what the vertex
+      // shader runs for at most.
+      const double vertices =
+          static_cast<double>(model->NumIndices()) * num_instances_;
+      app()->GetLogger()->LogInfo(
+          "BENCHMARK: model: ", kModelNames[config.model_index],
+          " instances: ", num_instances_,
+          " path: ", kVertexPaths[config.path_index].name,
+          " vertex_bytes: ", model->vertex_stride(), " gpu: ", average,
+          "ms mvertices_per_s: ",
+          average > 0.0 ? vertices / (average * 1000.0) : -1.0);
+      config_frame_ = 0;
+      gpu_time_ = 0.0;
+      num_gpu_times_ = 0;
+      if (++config_index_ == configs_.size()) {
+        done_ = true;
+        config_index_ = 0;
+      }
+    }
+  }
+
+  // Returns true once every configuration has been measured.
+  bool benchmark_done() const { return done_; }
+
+ private:
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  struct ModelData {
+    Mat44 transform;
+    // The position_scale() and position_bias() of the model that is drawn,
+    // in xyz.
+    float position_scale[4];
+    float position_bias[4];
+  };
+
+  // Makes the shaders turn the positions of |model| back into the positions
+  // of the model, which only changes them with quantized positions.
+  void SetPositionTransform(const vulkan::VulkanModel& model) {
+    ModelData& data = model_data_->data();
+    for (size_t i = 0; i < 3; ++i) {
+      data.position_scale[i] = model.position_scale()[i];
+      data.position_bias[i] = model.position_bias()[i];
+    }
+    data.position_scale[3] = 1.0f;
+    data.position_bias[3] = 0.0f;
+  }
+
+  // Creates the pipeline of one path. |model| gives the vertex input, there
+  // is none if it is nullptr.
+  template <int N>
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreatePipeline(
+      uint32_t (&vertex_shader)[N], vulkan::VulkanModel* model) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main", vertex_shader);
+    pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                        vertex_pulling_fragment_shader);
+    pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    if (model) {
+      pipeline->SetInputStreams(model);
+    }
+    pipeline->SetViewport(viewport());
+    pipeline->SetScissor(scissor());
+    pipeline->SetSamples(num_samples());
+    pipeline->AddAttachment();
+    pipeline->Commit();
+    return pipeline;
+  }
+
+  // Writes a square grid of instances in front of the camera to the staging
+  // buffer, and records the copy of them to the device into |cmd|.
+  void LayOutObjects(vulkan::VkCommandBuffer* cmd) {
+    const uint32_t side = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(num_instances_))));
+    const float spacing = 4.0f / side;
+    const float scale = 0.35f * spacing;
+    ObjectData* objects =
+        reinterpret_cast<ObjectData*>(staging_buffer_->base_address());
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+      objects[i] = {
+          {(i % side - (side - 1) * 0.5f) * spacing,
+           (i / side - (side - 1) * 0.5f) * spacing, -3.0f},  // position
+          scale                                               // scale
+      };
+    }
+    staging_buffer_->flush();
+
+    vulkan::VkCommandBuffer& cmdBuffer = *cmd;
+    VkBufferCopy object_copy = {
+        0,                                   // srcOffset
+        0,                                   // dstOffset
+        num_instances_ * sizeof(ObjectData)  // size
+    };
+    cmdBuffer->vkCmdCopyBuffer(cmdBuffer, *staging_buffer_, *object_buffer_, 1,
+                               &object_copy);
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,                // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *object_buffer_,                          // buffer
+        0,                                        // offset
+        VK_WHOLE_SIZE,                            // size
+    };
+    cmdBuffer->QueueBufferBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                                  barrier);
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  // In the order of kVertexPaths.
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline>
+      pipelines_[kNumVertexPaths];
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding descriptor_set_layouts_[3];
+  // In the order of kVertexPaths, and then of kModelNames.
+  containers::unique_ptr<vulkan::VulkanModel> models_[kNumVertexPaths]
+                                                     [kNumModels];
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+
+  // Only alive until the instances have been copied to object_buffer_.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> staging_buffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> object_buffer_;
+
+  // The configurations that are measured, one after the other.
+  containers::vector<BenchmarkConfig> configs_;
+  uint32_t num_instances_;
+  uint32_t frames_per_config_;
+  size_t config_index_;
+  uint32_t config_frame_;
+  bool done_;
+  // The sum of the GPU times of the measured frames of the current
+  // configuration, in milliseconds.
+  double gpu_time_;
+  uint32_t num_gpu_times_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  DeviceFeatures device_features;
+  device_features.get<VkPhysicalDeviceBufferDeviceAddressFeaturesKHR>()
+      .bufferDeviceAddress = VK_TRUE;
+  VertexPullingBenchmark sample(data, &device_features);
+  if (!sample.is_valid() || !sample.app()->HasBufferDeviceAddress()) {
+    data->logger()->LogInfo(
+        "The device does not support VK_KHR_buffer_device_address");
+    return -1;
+  }
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing() &&
+         !sample.benchmark_done()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,43 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The data that every path uses to place every instance.
+
+layout (location = 1) out vec2 texcoord;
+
+layout (binding = 0, set = 0) uniform camera_data {
+    layout(column_major) mat4x4 projection;
+};
+
+layout (binding = 1, set = 0) uniform model_data {
+    layout(column_major) mat4x4 transform;
+    // These turn quantized positions back into the positions of the model.
+    vec4 position_scale;
+    vec4 position_bias;
+};
+
+layout (binding = 2, set = 0, std430) readonly buffer object_data {
+    // xyz is the center of the instance, w its scale.
+    vec4 objects[];
+};
+
+void place_instance(vec4 position, vec2 vertex_texcoord) {
+    vec4 object = objects[gl_InstanceIndex];
+    vec4 model_position =
+        vec4(position.xyz * position_scale.xyz + position_bias.xyz, 1.0);
+    vec3 transformed = (transform * model_position).xyz;
+    gl_Position = projection * vec4(transformed * object.w + object.xyz, 1.0);
+    texcoord = vertex_texcoord;
+}
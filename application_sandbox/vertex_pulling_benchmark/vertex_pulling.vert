@@ -0,0 +1,42 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_EXT_buffer_reference : require
+#include "object_data.glsl"
+
+// The planar vertex data of a VulkanModel: all of the positions, then all
+// of the texture coordinates, then all of the normals.
+layout (buffer_reference, std430, buffer_reference_align = 4)
+    readonly buffer vertex_data {
+    float values[];
+};
+
+layout (push_constant) uniform model_vertices {
+    vertex_data vertices;
+    uint num_vertices;
+};
+
+// There is no vertex input, every vertex is read through the address of the
+// vertex buffer with its index.
+void main() {
+    uint position_index = 3 * uint(gl_VertexIndex);
+    uint texcoord_index = 3 * num_vertices + 2 * uint(gl_VertexIndex);
+    place_instance(vec4(vertices.values[position_index],
+                        vertices.values[position_index + 1],
+                        vertices.values[position_index + 2], 1.0),
+                   vec2(vertices.values[texcoord_index],
+                        vertices.values[texcoord_index + 1]));
+}
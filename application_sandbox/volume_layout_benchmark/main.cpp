@@ -0,0 +1,683 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t volume_3d_shader[] =
+#include "volume_3d.comp.spv"
+    ;
+
+uint32_t volume_array_shader[] =
+#include "volume_array.comp.spv"
+    ;
+
+namespace {
+// The volumes go from kMinSize to the max_size option voxels along every
+// side, doubling every time.
+const uint32_t kMinSize = 64;
+const uint32_t kDefaultMaxSize = 256;
+// The size of the image that the volume is ray marched into.
+const uint32_t kTargetSize = 512;
+// This must match the local size in volume_march.glsl.
+const uint32_t kGroupSize = 8;
+// Every upload and ray march is measured this many times, and the fastest
+// run is kept.
+const uint32_t kNumRuns = 5;
+
+const VkFormat kVolumeFormat = VK_FORMAT_R8_UNORM;
+
+enum Layout {
+  // A 3D image, filtered by the sampler.
+  kImage3D,
+  // A 2D array image with a layer per slice, that the shader interpolates
+  // between.
+  kArray2D,
+  // A sparse resident 3D image, of which only the bricks that are not
+  // empty are bound and uploaded.
+  kSparse3D,
+  kNumLayouts,
+};
+
+const char* const kLayoutNames[kNumLayouts] = {"image_3d", "array_2d",
+                                               "sparse_3d"};
+
+// This must match march_data in volume_march.glsl.
+struct MarchData {
+  uint32_t size;
+};
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+VkPhysicalDeviceFeatures SparseFeatures(bool sparse) {
+  VkPhysicalDeviceFeatures features = {0};
+  features.sparseBinding = sparse;
+  features.sparseResidencyImage3D = sparse;
+  return features;
+}
+
+// Returns the density of the voxel at |x|, |y|, |z| of a volume with
+// |size| voxels along every side: a spherical shell, which leaves the
+// corners and the center of the volume empty.
+uint8_t Density(uint32_t x, uint32_t y, uint32_t z, uint32_t size) {
+  const float dx = (x + 0.5f) / size - 0.5f;
+  const float dy = (y + 0.5f) / size - 0.5f;
+  const float dz = (z + 0.5f) / size - 0.5f;
+  const float radius = std::sqrt(dx * dx + dy * dy + dz * dz);
+  const float shell = 1.0f - std::fabs(radius - 0.3f) / 0.15f;
+  return static_cast<uint8_t>(std::max(shell, 0.0f) * 255.0f);
+}
+
+void SubmitAndWait(vulkan::VkQueue* queue, vulkan::VkCommandBuffer* cmd) {
+  VkSubmitInfo submit_info = {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &cmd->get_command_buffer(),     // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+  (*queue)->vkQueueWaitIdle(*queue);
+}
+
+void ImageBarrier(vulkan::VkCommandBuffer* cmd, ::VkImage image,
+                  uint32_t num_layers, VkImageLayout old_layout,
+                  VkImageLayout new_layout, VkPipelineStageFlags src,
+                  VkAccessFlags src_access, VkPipelineStageFlags dst,
+                  VkAccessFlags dst_access) {
+  VkImageMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+      nullptr,                                 // pNext
+      src_access,                              // srcAccessMask
+      dst_access,                              // dstAccessMask
+      old_layout,                              // oldLayout
+      new_layout,                              // newLayout
+      VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+      VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+      image,                                   // image
+      {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, num_layers},  // subresourceRange
+  };
+  (*cmd)->vkCmdPipelineBarrier(*cmd, src, dst, 0, 0, nullptr, 0, nullptr, 1,
+                               &barrier);
+}
+
+// Measures how fast volumes of every size are uploaded, and how fast they
+// are ray marched, in every layout. Every layout of a size is uploaded
+// from the same data, and marched with the same rays.
+class VolumeLayoutBenchmark {
+ public:
+  VolumeLayoutBenchmark(const entry::EntryData* data,
+                        vulkan::VulkanApplication* app, bool sparse)
+      : data_(data),
+        app_(app),
+        max_size_(kMinSize),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })),
+        sampler_(vulkan::CreateSampler(&app->device(), VK_FILTER_LINEAR,
+                                       VK_FILTER_LINEAR)),
+        sparse_(sparse),
+        non_resident_strict_(false) {
+    vulkan::VkDevice& device = app->device();
+    const uint32_t max_size =
+        data->sample_option_uint("max_size", kDefaultMaxSize);
+    while (max_size_ * 2 <= max_size &&
+           max_size_ * 2 <= device.limits().maxImageDimension3D) {
+      max_size_ *= 2;
+    }
+
+    if (sparse_) {
+      // The empty bricks only read as zero with residencyNonResidentStrict.
+      VkPhysicalDeviceProperties properties;
+      app->instance()->vkGetPhysicalDeviceProperties(device.physical_device(),
+                                                     &properties);
+      non_resident_strict_ =
+          properties.sparseProperties.residencyNonResidentStrict != VK_FALSE;
+      uint32_t num_formats = 0;
+      app->instance()->vkGetPhysicalDeviceSparseImageFormatProperties(
+          device.physical_device(), kVolumeFormat, VK_IMAGE_TYPE_3D,
+          VK_SAMPLE_COUNT_1_BIT,
+          VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+          VK_IMAGE_TILING_OPTIMAL, &num_formats, nullptr);
+      sparse_ = num_formats > 0;
+    }
+
+    bindings_[0] = {
+        0,                                          // binding
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+        1,                                          // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+        nullptr                                     // pImmutableSamplers
+    };
+    bindings_[1] = {
+        1,                                 // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  // descriptorType
+        1,                                 // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,       // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(MarchData)             // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data->allocator(),
+        app->CreatePipelineLayout({{bindings_[0], bindings_[1]}}, {range}));
+    volume_3d_pipeline_ =
+        containers::make_unique<vulkan::VulkanComputePipeline>(
+            data->allocator(),
+            app->CreateComputePipeline(
+                pipeline_layout_.get(),
+                VkShaderModuleCreateInfo{
+                    VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                    sizeof(volume_3d_shader), volume_3d_shader},
+                "main"));
+    volume_array_pipeline_ =
+        containers::make_unique<vulkan::VulkanComputePipeline>(
+            data->allocator(),
+            app->CreateComputePipeline(
+                pipeline_layout_.get(),
+                VkShaderModuleCreateInfo{
+                    VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                    sizeof(volume_array_shader), volume_array_shader},
+                "main"));
+
+    VkImageCreateInfo target_create_info = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        VK_FORMAT_R8G8B8A8_UNORM,             // format
+        {kTargetSize, kTargetSize, 1},        // extent
+        1,                                    // mipLevels
+        1,                                    // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                // samples
+        VK_IMAGE_TILING_OPTIMAL,              // tiling
+        VK_IMAGE_USAGE_STORAGE_BIT,           // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    target_ = app->CreateAndBindImage(&target_create_info);
+    target_view_ =
+        app->CreateImageView(target_.get(), VK_IMAGE_VIEW_TYPE_2D,
+                             {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+
+    // Every size is uploaded from the start of the same staging buffer.
+    staging_ = app->CreateAndBindDefaultExclusiveHostBuffer(
+        VkDeviceSize(max_size_) * max_size_ * max_size_,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+    vulkan::VkCommandBuffer cmd =
+        app->GetCommandBuffer(app->render_queue().index());
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    ImageBarrier(&cmd, *target_, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                 VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_SHADER_WRITE_BIT);
+    cmd->vkEndCommandBuffer(cmd);
+    SubmitAndWait(&app->render_queue(), &cmd);
+  }
+
+  // Measures every layout, or only the one named |only_layout|, for every
+  // size, and logs the results, and the fastest layout to ray march for
+  // every size.
+  void Run(const char* only_layout) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+    if (!sparse_) {
+      data_->logger()->LogInfo(
+          "VOLUME: the sparse_3d layout is skipped, the device has no "
+          "sparse residency for 3D images");
+    } else if (!non_resident_strict_) {
+      data_->logger()->LogInfo(
+          "VOLUME: empty bricks of sparse_3d read undefined values, the "
+          "device does not have residencyNonResidentStrict");
+    }
+
+    for (uint32_t size = kMinSize; size <= max_size_; size *= 2) {
+      uint8_t* voxels = reinterpret_cast<uint8_t*>(staging_->base_address());
+      for (uint32_t z = 0; z < size; ++z) {
+        for (uint32_t y = 0; y < size; ++y) {
+          for (uint32_t x = 0; x < size; ++x) {
+            *voxels++ = Density(x, y, z, size);
+          }
+        }
+      }
+      staging_->flush();
+
+      const char* best_layout = nullptr;
+      double best_march_ms = -1.0;
+      for (uint32_t layout = 0; layout < kNumLayouts; ++layout) {
+        if ((only_layout && strcmp(only_layout, kLayoutNames[layout]) != 0) ||
+            (layout == kSparse3D && !sparse_)) {
+          continue;
+        }
+        if (layout == kArray2D &&
+            size > app_->device().limits().maxImageArrayLayers) {
+          data_->logger()->LogInfo("VOLUME: layout: ", kLayoutNames[layout],
+                                   " size: ", size,
+                                   " is skipped, it has too many layers");
+          continue;
+        }
+        const double march_ms = Measure(static_cast<Layout>(layout), size);
+        if (march_ms > 0.0 &&
+            (best_march_ms < 0.0 || march_ms < best_march_ms)) {
+          best_layout = kLayoutNames[layout];
+          best_march_ms = march_ms;
+        }
+      }
+      if (best_layout) {
+        data_->logger()->LogInfo("VOLUME_BEST: size: ", size,
+                                 " layout: ", best_layout,
+                                 " march_ms: ", best_march_ms);
+      }
+    }
+  }
+
+ private:
+  // A volume in one of the layouts.
+  struct Volume {
+    // One of these is the image.
+    containers::unique_ptr<vulkan::VulkanApplication::Image> image;
+    containers::unique_ptr<vulkan::VulkanApplication::StreamingSparseImage>
+        sparse_image;
+    ::VkImage raw_image;
+    uint32_t num_layers;
+    containers::unique_ptr<vulkan::VkImageView> view;
+    containers::unique_ptr<vulkan::DescriptorSet> set;
+    // The memory that is bound to the image.
+    VkDeviceSize memory;
+    // The copies of the upload, and how many bytes they copy.
+    containers::vector<VkBufferImageCopy> regions;
+    VkDeviceSize upload_bytes;
+    // The number of bricks that are bound, and the number of all of them,
+    // for sparse_3d.
+    size_t resident_bricks;
+    size_t num_bricks;
+  };
+
+  // Creates the volume of |size| voxels along every side in |layout|, and
+  // logs how fast it is uploaded and ray marched. Returns the time of the
+  // fastest ray march in milliseconds, or a negative number if it could not
+  // be measured.
+  double Measure(Layout layout, uint32_t size) {
+    Volume volume = {
+        containers::unique_ptr<vulkan::VulkanApplication::Image>(),  // image
+        containers::unique_ptr<
+            vulkan::VulkanApplication::StreamingSparseImage>(),  // sparse
+        VK_NULL_HANDLE,                                   // raw_image
+        layout == kArray2D ? size : 1,                    // num_layers
+        containers::unique_ptr<vulkan::VkImageView>(),    // view
+        containers::unique_ptr<vulkan::DescriptorSet>(),  // set
+        0,                                                // memory
+        containers::vector<VkBufferImageCopy>(data_->allocator()),  // regions
+        0,  // upload_bytes
+        0,  // resident_bricks
+        0,  // num_bricks
+    };
+    CreateVolume(layout, size, &volume);
+
+    const VkPipelineStageFlags transfer = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    // Every upload starts from an undefined image, so that every run does
+    // the same work.
+    const double upload_ns = BestTime([&](vulkan::VkCommandBuffer* cmd) {
+      ImageBarrier(cmd, volume.raw_image, volume.num_layers,
+                   VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, compute,
+                   0, transfer, VK_ACCESS_TRANSFER_WRITE_BIT);
+      (*cmd)->vkCmdCopyBufferToImage(
+          *cmd, *staging_, volume.raw_image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          static_cast<uint32_t>(volume.regions.size()),
+          volume.regions.data());
+      ImageBarrier(cmd, volume.raw_image, volume.num_layers,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transfer,
+                   VK_ACCESS_TRANSFER_WRITE_BIT, compute,
+                   VK_ACCESS_SHADER_READ_BIT);
+    });
+
+    vulkan::VulkanComputePipeline* pipeline = layout == kArray2D
+                                                  ? volume_array_pipeline_.get()
+                                                  : volume_3d_pipeline_.get();
+    const MarchData march_data = {size};
+    const uint32_t groups = (kTargetSize + kGroupSize - 1) / kGroupSize;
+    const double march_ns = BestTime([&](vulkan::VkCommandBuffer* cmd) {
+      (*cmd)->vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                *pipeline);
+      (*cmd)->vkCmdBindDescriptorSets(*cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                      *pipeline_layout_, 0, 1,
+                                      &volume.set->raw_set(), 0, nullptr);
+      (*cmd)->vkCmdPushConstants(*cmd, *pipeline_layout_,
+                                 VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                 sizeof(march_data), &march_data);
+      (*cmd)->vkCmdDispatch(*cmd, groups, groups, 1);
+    });
+
+    if (upload_ns <= 0.0 || march_ns <= 0.0) {
+      data_->logger()->LogError("VOLUME: layout: ", kLayoutNames[layout],
+                                " size: ", size, " could not be measured");
+      return -1.0;
+    }
+    if (layout == kSparse3D) {
+      data_->logger()->LogInfo(
+          "VOLUME: layout: ", kLayoutNames[layout], " size: ", size,
+          " memory_MB: ", volume.memory / (1024.0 * 1024.0),
+          " upload_ms: ", upload_ns / 1e6,
+          " upload_GB/s: ", volume.upload_bytes / upload_ns,
+          " march_ms: ", march_ns / 1e6,
+          " resident_bricks: ", volume.resident_bricks, "/",
+          volume.num_bricks);
+    } else {
+      // Bytes per nanosecond are GB/s.
+      data_->logger()->LogInfo(
+          "VOLUME: layout: ", kLayoutNames[layout], " size: ", size,
+          " memory_MB: ", volume.memory / (1024.0 * 1024.0),
+          " upload_ms: ", upload_ns / 1e6,
+          " upload_GB/s: ", volume.upload_bytes / upload_ns,
+          " march_ms: ", march_ns / 1e6);
+    }
+    return march_ns / 1e6;
+  }
+
+  // Creates the image of |volume|, its view, its descriptor set, and the
+  // copies that upload it from the staging buffer.
+  void CreateVolume(Layout layout, uint32_t size, Volume* volume) {
+    vulkan::VkDevice& device = app_->device();
+    VkImageCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        layout == kArray2D ? VK_IMAGE_TYPE_2D
+                           : VK_IMAGE_TYPE_3D,  // imageType
+        kVolumeFormat,                          // format
+        {size, size, layout == kArray2D ? 1 : size},  // extent
+        1,                                            // mipLevels
+        volume->num_layers,                           // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                        // samples
+        VK_IMAGE_TILING_OPTIMAL,                      // tiling
+        VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    const VkBufferImageCopy whole_volume = {
+        0,                                                // bufferOffset
+        size,                                             // bufferRowLength
+        size,                                             // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, volume->num_layers},  // subresource
+        {0, 0, 0},                                        // imageOffset
+        create_info.extent,                               // imageExtent
+    };
+
+    if (layout == kSparse3D) {
+      // The budget fits every brick.
+      volume->sparse_image = app_->CreateStreamingSparseImage(
+          &create_info, 2 * VkDeviceSize(size) * size * size, 1);
+      vulkan::VulkanApplication::StreamingSparseImage* image =
+          volume->sparse_image.get();
+      volume->raw_image = *image;
+      if (image->num_paged_levels() == 0) {
+        // All of the volume is in the mip tail.
+        volume->regions.push_back(whole_volume);
+      } else {
+        const VkExtent3D brick = image->page_extent();
+        containers::vector<bool> occupied(data_->allocator());
+        const uint32_t bricks_x = (size + brick.width - 1) / brick.width;
+        const uint32_t bricks_y = (size + brick.height - 1) / brick.height;
+        const uint32_t bricks_z = (size + brick.depth - 1) / brick.depth;
+        volume->num_bricks = size_t(bricks_x) * bricks_y * bricks_z;
+        occupied.resize(volume->num_bricks, false);
+        const uint8_t* voxels =
+            reinterpret_cast<const uint8_t*>(staging_->base_address());
+        for (uint32_t z = 0; z < size; ++z) {
+          for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+              if (*voxels++ != 0) {
+                occupied[(z / brick.depth * bricks_y + y / brick.height) *
+                             bricks_x +
+                         x / brick.width] = true;
+              }
+            }
+          }
+        }
+        for (uint32_t z = 0; z < bricks_z; ++z) {
+          for (uint32_t y = 0; y < bricks_y; ++y) {
+            for (uint32_t x = 0; x < bricks_x; ++x) {
+              if (occupied[(z * bricks_y + y) * bricks_x + x]) {
+                image->RequestVolume(
+                    0,
+                    {static_cast<int32_t>(x * brick.width),
+                     static_cast<int32_t>(y * brick.height),
+                     static_cast<int32_t>(z * brick.depth)},
+                    brick);
+              }
+            }
+          }
+        }
+        containers::vector<VkSparseImageMemoryBind> bound(data_->allocator());
+        image->UpdateResidency(VK_NULL_HANDLE, &bound);
+        volume->resident_bricks = bound.size();
+        // Only the bricks that are bound are uploaded.
+        for (const VkSparseImageMemoryBind& bind : bound) {
+          VkBufferImageCopy region = whole_volume;
+          region.bufferOffset =
+              (VkDeviceSize(bind.offset.z) * size + bind.offset.y) * size +
+              bind.offset.x;
+          region.imageOffset = bind.offset;
+          region.imageExtent = bind.extent;
+          volume->regions.push_back(region);
+        }
+      }
+      volume->memory = image->size();
+    } else {
+      volume->image = app_->CreateAndBindImage(&create_info);
+      volume->raw_image = *volume->image;
+      volume->memory = volume->image->size();
+      volume->regions.push_back(whole_volume);
+    }
+    for (const VkBufferImageCopy& region : volume->regions) {
+      volume->upload_bytes += VkDeviceSize(region.imageExtent.width) *
+                              region.imageExtent.height *
+                              region.imageExtent.depth *
+                              region.imageSubresource.layerCount;
+    }
+
+    VkImageViewCreateInfo view_create_info = {
+        VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
+        nullptr,                                   // pNext
+        0,                                         // flags
+        volume->raw_image,                         // image
+        layout == kArray2D ? VK_IMAGE_VIEW_TYPE_2D_ARRAY
+                           : VK_IMAGE_VIEW_TYPE_3D,  // viewType
+        kVolumeFormat,                               // format
+        {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
+         VK_COMPONENT_SWIZZLE_A},  // components
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0,
+         volume->num_layers},  // subresourceRange
+    };
+    ::VkImageView raw_view;
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkCreateImageView(device, &view_create_info, nullptr,
+                                         &raw_view));
+    volume->view = containers::make_unique<vulkan::VkImageView>(
+        data_->allocator(), vulkan::VkImageView(raw_view, nullptr, &device));
+
+    volume->set = containers::make_unique<vulkan::DescriptorSet>(
+        data_->allocator(),
+        app_->AllocateDescriptorSet({bindings_[0], bindings_[1]}));
+    VkDescriptorImageInfo image_infos[2] = {
+        {
+            sampler_,                                  // sampler
+            *volume->view,                             // imageView
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+        },
+        {
+            VK_NULL_HANDLE,           // sampler
+            *target_view_,            // imageView
+            VK_IMAGE_LAYOUT_GENERAL,  // imageLayout
+        }};
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+            nullptr,                                    // pNext
+            *volume->set,                               // dstSet
+            0,                                          // dstbinding
+            0,                                          // dstArrayElement
+            1,                                          // descriptorCount
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+            image_infos,                                // pImageInfo
+            nullptr,                                    // pBufferInfo
+            nullptr,                                    // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *volume->set,                            // dstSet
+            1,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,        // descriptorType
+            image_infos + 1,                         // pImageInfo
+            nullptr,                                 // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+    device->vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+  }
+
+  // Returns the GPU time in nanoseconds of the fastest of kNumRuns runs of
+  // the commands that |record| records, or a negative number if it could
+  // not be measured.
+  template <typename Record>
+  double BestTime(const Record& record) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 0);
+      record(&cmd);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      cmd->vkEndCommandBuffer(cmd);
+      SubmitAndWait(&queue, &cmd);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    return best;
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  uint32_t max_size_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+  vulkan::VkSampler sampler_;
+  // Whether sparse_3d is measured.
+  bool sparse_;
+  bool non_resident_strict_;
+  VkDescriptorSetLayoutBinding bindings_[2];
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline> volume_3d_pipeline_;
+  containers::unique_ptr<vulkan::VulkanComputePipeline>
+      volume_array_pipeline_;
+  containers::unique_ptr<vulkan::VulkanApplication::Image> target_;
+  containers::unique_ptr<vulkan::VkImageView> target_view_;
+  // The voxels of the current size, which every layout is uploaded from.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> staging_;
+};
+}  // anonymous namespace
+
+// This sample measures how fast volumes are uploaded and ray marched as 3D
+// images, as 2D array images that the shader interpolates between the
+// layers of, and as sparse 3D images of which only the bricks that are not
+// empty are bound. It logs one line per layout and size, and the fastest
+// layout to ray march per size:
+//   VOLUME: layout: <layout> size: <n> memory_MB: <size of the image>
+//       upload_ms: <time> upload_GB/s: <bandwidth> march_ms: <time>
+//   VOLUME_BEST: size: <n> layout: <layout> march_ms: <time>
+// -sample-option=layout=<layout> only measures that one, max_size sets the
+// largest size, and sparse=0 skips sparse_3d, which needs the
+// sparseResidencyImage3D feature.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  const char* sparse_option = data->sample_option("sparse");
+  const bool sparse = !sparse_option || strcmp(sparse_option, "0") != 0;
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data, {}, {}, SparseFeatures(sparse),
+      64 * 1024 * 1024, 256 * 1024 * 1024, 1024 * 1024, 1024 * 1024, false,
+      sparse);
+  VolumeLayoutBenchmark benchmark(data, &app, sparse);
+  benchmark.Run(data->sample_option("layout"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
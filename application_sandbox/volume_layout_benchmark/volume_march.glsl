@@ -0,0 +1,63 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The ray march that every layout shares. One invocation marches the ray of
+// one pixel of the target through the unit cube, one voxel at a time, and
+// composites the density front to back.
+// The includer defines density() after it includes this file.
+
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+layout (binding = 1, set = 0, rgba8) writeonly uniform image2D target;
+
+// This must match MarchData in main.cpp.
+layout (push_constant) uniform march_data {
+    // The number of voxels along every side of the volume.
+    uint size;
+};
+
+// Returns the density of the volume at |position|, from 0 to 1 in all of
+// x, y and z.
+float density(vec3 position);
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 target_size = imageSize(target);
+    if (any(greaterThanEqual(pixel, target_size))) {
+        return;
+    }
+    // The camera looks at the front face of the volume, which fills the
+    // target.
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(target_size);
+    vec3 origin = vec3(0.5, 0.5, -1.0);
+    vec3 direction = normalize(vec3(uv - 0.5, 1.0));
+    vec3 inverse = 1.0 / direction;
+    vec3 t0 = -origin * inverse;
+    vec3 t1 = (vec3(1.0) - origin) * inverse;
+    vec3 near = min(t0, t1);
+    vec3 far = max(t0, t1);
+    float start = max(max(near.x, near.y), near.z);
+    float end = min(min(far.x, far.y), far.z);
+
+    float step_length = 1.0 / float(size);
+    vec4 color = vec4(0.0);
+    for (float t = start + 0.5 * step_length; t < end && color.a < 0.99;
+         t += step_length) {
+        float value = density(origin + t * direction);
+        float alpha = 1.0 - exp(-8.0 * value * step_length);
+        color += (1.0 - color.a) * alpha * vec4(vec3(value), 1.0);
+    }
+    imageStore(target, pixel, color);
+}
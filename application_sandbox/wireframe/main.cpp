@@ -55,6 +55,7 @@ class WireframeSample : public sample_application::Sample<WireframeFrameData> {
         Sample<WireframeFrameData>(data->allocator(), data, 1, 512, 1, 1,
                                    sample_application::SampleOptions()
                                        .EnableDepthBuffer()
+                                       .EnableTransientAttachments()
                                        .EnableMultisampling(),
                                    requested_features),
         torus_(data->allocator(), data->logger(), torus_data) {}
@@ -96,7 +97,7 @@ class WireframeSample : public sample_application::Sample<WireframeFrameData> {
                  depth_format(),                    // format
                  num_samples(),                     // samples
                  VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
-                 VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
+                 depth_store_op(),                  // storeOp
                  VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stenilLoadOp
                  VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stenilStoreOp
                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // initialLayout
@@ -154,6 +155,8 @@ class WireframeSample : public sample_application::Sample<WireframeFrameData> {
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -279,10 +282,6 @@ class WireframeSample : public sample_application::Sample<WireframeFrameData> {
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       WireframeFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     VkSubmitInfo init_submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
         nullptr,                        // pNext
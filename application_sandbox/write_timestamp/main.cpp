@@ -16,6 +16,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/query_allocator.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 
@@ -76,13 +77,11 @@ class WriteTimestampSample
       size_t num_swapchain_images) override {
     num_frames_ = static_cast<uint32_t>(num_swapchain_images);
 
-    // Create a occlusion query pool that contains a query for each frame.
-    query_pool_ = containers::make_unique<vulkan::VkQueryPool>(
-        data_->allocator(),
-        vulkan::CreateQueryPool(
-            &app()->device(),
-            {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, nullptr, 0,
-             VK_QUERY_TYPE_TIMESTAMP, uint32_t(num_swapchain_images), 0}));
+    // Allocate a timestamp query for each frame.
+    query_allocator_ = containers::make_unique<vulkan::QueryAllocator>(
+        data_->allocator(), app(), false);
+    timestamps_ = query_allocator_->Allocate(VK_QUERY_TYPE_TIMESTAMP,
+                                             uint32_t(num_swapchain_images));
 
     // Create a buffer to store the query results for each frame, and to be
     // used in the fragment shader.
@@ -188,6 +187,8 @@ class WriteTimestampSample
     model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
         data_->allocator(), app(), num_swapchain_images,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    UpdateBufferEveryFrame(camera_data_.get());
+    UpdateBufferEveryFrame(model_data_.get());
 
     float aspect =
         (float)app()->swapchain().width() / (float)app()->swapchain().height();
@@ -338,12 +339,12 @@ class WriteTimestampSample
         cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 1,
         &to_use_query_results, 0, nullptr);
-    cmdBuffer->vkCmdResetQueryPool(cmdBuffer, *query_pool_,
-                                   static_cast<uint32_t>(frame_index), 1);
+    query_allocator_->RecordReset(&cmdBuffer, timestamps_,
+                                  static_cast<uint32_t>(frame_index), 1);
 
-    cmdBuffer->vkCmdWriteTimestamp(cmdBuffer,
-                                   VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-                                   *query_pool_, frame_index);
+    cmdBuffer->vkCmdWriteTimestamp(
+        cmdBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, timestamps_.pool,
+        timestamps_.query(static_cast<uint32_t>(frame_index)));
 
     cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
                                     VK_SUBPASS_CONTENTS_INLINE);
@@ -371,15 +372,10 @@ class WriteTimestampSample
   }
   virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
                       WriteTimestampFrameData* frame_data) override {
-    // Update our uniform buffers.
-    camera_data_->UpdateBuffer(queue, frame_index);
-    model_data_->UpdateBuffer(queue, frame_index);
-
     uint64_t time_stamp = 0;
-    app()->device()->vkGetQueryPoolResults(
-        app()->device(), *query_pool_, static_cast<uint32_t>(frame_index), 1u,
-        sizeof(uint64_t), &time_stamp, sizeof(uint64_t),
-        VK_QUERY_RESULT_64_BIT);
+    query_allocator_->GetResults(timestamps_, &time_stamp, sizeof(uint64_t),
+                                 VK_QUERY_RESULT_64_BIT,
+                                 static_cast<uint32_t>(frame_index), 1);
 
     // Trim the time stamp value to an uint32.
     timestamp_data_->data().value = uint32_t(time_stamp);
@@ -422,7 +418,8 @@ class WriteTimestampSample
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> torus_pipeline_;
   containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
-  containers::unique_ptr<vulkan::VkQueryPool> query_pool_;
+  containers::unique_ptr<vulkan::QueryAllocator> query_allocator_;
+  vulkan::QueryRange timestamps_;
   VkDescriptorSetLayoutBinding torus_descriptor_set_layouts_[3];
   vulkan::VulkanModel torus_;
 
@@ -0,0 +1,614 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/image_diff.h"
+#include "vulkan_helpers/multiplanar_consumer.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+uint32_t ycbcr_sampler_shader[] =
+#include "multiplanar/ycbcr_sampler.comp.spv"
+    ;
+
+uint32_t ycbcr_planes_shader[] =
+#include "multiplanar/ycbcr_planes.comp.spv"
+    ;
+
+uint32_t image_diff_shader[] =
+#include "image_diff/image_diff.comp.spv"
+    ;
+
+namespace {
+using vulkan::MultiplanarConsumer;
+
+struct Resolution {
+  // The name of the resolution in the sample options and the results.
+  const char* name;
+  uint32_t width;
+  uint32_t height;
+};
+
+const Resolution kResolutions[] = {
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+};
+
+const char* const kPathNames[] = {"sampler", "planes"};
+
+// Every conversion is measured this many times, and the fastest run is
+// kept.
+const uint32_t kNumRuns = 10;
+
+// The results of both paths may differ by this much in every channel, since
+// the sampler may convert with less precision than the shader.
+const uint8_t kTolerance[4] = {2, 2, 2, 0};
+
+#ifdef _WIN32
+const VkExternalMemoryHandleTypeFlagBits kHandleType =
+    VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+#elif __linux__
+const VkExternalMemoryHandleTypeFlagBits kHandleType =
+    VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+#endif
+
+const VkCommandBufferBeginInfo kBeginInfo = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+    nullptr,                                      // pNext
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+    nullptr                                       // pInheritanceInfo
+};
+
+VkPhysicalDeviceSamplerYcbcrConversionFeatures ycbcr_features = {
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES_KHR,
+    nullptr,  // pNext
+    VK_TRUE   // samplerYcbcrConversion
+};
+
+void SubmitAndWait(vulkan::VkQueue* queue, vulkan::VkCommandBuffer* cmd) {
+  VkSubmitInfo submit_info = {
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &cmd->get_command_buffer(),     // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+  (*queue)->vkQueueWaitIdle(*queue);
+}
+
+// A 4:2:0 image that stands in for the frames of a video decoder. Every
+// plane of a disjoint image has an allocation of its own.
+struct Source {
+  explicit Source(containers::Allocator* allocator) : memory(allocator) {}
+  // The memory that the image is bound to, and if it is imported, the
+  // memory that it was exported from, which a decoder would own.
+  containers::vector<containers::unique_ptr<vulkan::VkDeviceMemory>> memory;
+  containers::unique_ptr<vulkan::VkImage> image;
+  bool disjoint;
+  bool imported;
+};
+
+// Measures how long it takes to convert one 4:2:0 frame to RGBA, with a
+// VkSamplerYcbcrConversion and with a compute shader that reads the planes,
+// at 1080p and 4K. The planes are bound to memory that is imported from
+// another allocation, the way that a decoder shares its frames, and neither
+// path copies them. Both results are compared on the GPU.
+class YcbcrConversionBenchmark {
+ public:
+  YcbcrConversionBenchmark(const entry::EntryData* data,
+                           vulkan::VulkanApplication* app, VkFormat format)
+      : data_(data),
+        app_(app),
+        format_(format),
+        timestamp_mask_(0),
+        query_pool_(vulkan::CreateQueryPool(
+            &app->device(),
+            {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                nullptr,                                   // pNext
+                0,                                         // flags
+                VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                2,                                         // queryCount
+                0                                          // pipelineStatistics
+            })) {}
+
+  // Measures both paths at every resolution, or only the ones named
+  // |only_path| and |only_resolution|, and logs the results.
+  void Run(const char* only_path, const char* only_resolution) {
+    auto queue_family_properties = vulkan::GetQueueFamilyProperties(
+        data_->allocator(), app_->instance(),
+        app_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[app_->render_queue().index()]
+            .timestampValidBits;
+    if (valid_bits == 0) {
+      data_->logger()->LogError("The queue does not support timestamps");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    for (const Resolution& resolution : kResolutions) {
+      if (only_resolution && strcmp(only_resolution, resolution.name) != 0) {
+        continue;
+      }
+      containers::unique_ptr<Source> sources[2];
+      containers::unique_ptr<MultiplanarConsumer> consumers[2];
+      for (uint32_t i = 0; i < 2; ++i) {
+        const MultiplanarConsumer::Path path =
+            static_cast<MultiplanarConsumer::Path>(i);
+        if (only_path && strcmp(only_path, kPathNames[path]) != 0) {
+          continue;
+        }
+        if (!MultiplanarConsumer::Supported(app_, path, format_,
+                                            VK_IMAGE_TILING_OPTIMAL, false)) {
+          data_->logger()->LogInfo("MULTIPLANAR: path: ", kPathNames[path],
+                                   " is not supported for the format");
+          continue;
+        }
+        sources[path] = CreateSource(
+            path, resolution,
+            MultiplanarConsumer::Supported(app_, path, format_,
+                                           VK_IMAGE_TILING_OPTIMAL, true));
+        Fill(sources[path].get(), resolution);
+        uint32_t* shader = path == MultiplanarConsumer::kSampler
+                               ? ycbcr_sampler_shader
+                               : ycbcr_planes_shader;
+        const size_t shader_words =
+            path == MultiplanarConsumer::kSampler
+                ? sizeof(ycbcr_sampler_shader) / sizeof(uint32_t)
+                : sizeof(ycbcr_planes_shader) / sizeof(uint32_t);
+        consumers[path] = containers::make_unique<MultiplanarConsumer>(
+            data_->allocator(), app_, path, format_, resolution.width,
+            resolution.height, shader, shader_words);
+        consumers[path]->AddSource(*sources[path]->image);
+
+        const double ns = Measure(consumers[path].get());
+        if (ns <= 0.0) {
+          continue;
+        }
+        const double pixels =
+            static_cast<double>(resolution.width) * resolution.height;
+        data_->logger()->LogInfo(
+            "MULTIPLANAR: path: ", kPathNames[path],
+            " resolution: ", resolution.name,
+            " disjoint: ", sources[path]->disjoint ? 1 : 0,
+            " imported: ", sources[path]->imported ? 1 : 0,
+            " ms: ", ns / 1000000.0, " Mpixels/s: ", pixels * 1000.0 / ns);
+      }
+      if (consumers[MultiplanarConsumer::kSampler] &&
+          consumers[MultiplanarConsumer::kPlanes]) {
+        Compare(consumers[MultiplanarConsumer::kSampler].get(),
+                consumers[MultiplanarConsumer::kPlanes].get(), resolution);
+      }
+    }
+  }
+
+ private:
+  // Returns true if images with |flags| and |usage| can be bound to
+  // imported memory that is not dedicated to them.
+  bool CanImport(VkImageCreateFlags flags, VkImageUsageFlags usage) {
+    VkPhysicalDeviceExternalImageFormatInfo external_info = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,  // sType
+        nullptr,                                                       // pNext
+        kHandleType,  // handleType
+    };
+    VkPhysicalDeviceImageFormatInfo2 format_info = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,  // sType
+        &external_info,                                         // pNext
+        format_,                                                // format
+        VK_IMAGE_TYPE_2D,                                       // type
+        VK_IMAGE_TILING_OPTIMAL,                                // tiling
+        usage,                                                  // usage
+        flags,                                                  // flags
+    };
+    VkExternalImageFormatProperties external_properties = {
+        VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES,  // sType
+        nullptr,                                             // pNext
+        {},  // externalMemoryProperties
+    };
+    VkImageFormatProperties2 properties = {
+        VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,  // sType
+        &external_properties,                         // pNext
+        {},                                           // imageFormatProperties
+    };
+    if (app_->instance()->vkGetPhysicalDeviceImageFormatProperties2(
+            app_->device().physical_device(), &format_info, &properties) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    const VkExternalMemoryFeatureFlags features =
+        external_properties.externalMemoryProperties.externalMemoryFeatures;
+    const VkExternalMemoryFeatureFlags required =
+        VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT |
+        VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT;
+    return (features & required) == required &&
+           !(features & VK_EXTERNAL_MEMORY_FEATURE_DEDICATED_ONLY_BIT);
+  }
+
+  // Allocates |size| bytes of memory type |memory_index|, with |next| on
+  // the allocate info, that |source| keeps.
+  ::VkDeviceMemory Allocate(Source* source, VkDeviceSize size,
+                            uint32_t memory_index, const void* next) {
+    vulkan::VkDevice& device = app_->device();
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
+        next,                                    // pNext
+        size,                                    // allocationSize
+        memory_index,                            // memoryTypeIndex
+    };
+    ::VkDeviceMemory memory;
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkAllocateMemory(device, &allocate_info, nullptr,
+                                        &memory));
+    source->memory.push_back(containers::make_unique<vulkan::VkDeviceMemory>(
+        data_->allocator(), vulkan::VkDeviceMemory(memory, nullptr, &device)));
+    return memory;
+  }
+
+  // Allocates exportable memory, the way that a decoder allocates its
+  // frames, and returns the memory that imports it.
+  ::VkDeviceMemory Import(Source* source, VkDeviceSize size,
+                          uint32_t memory_index) {
+    vulkan::VkDevice& device = app_->device();
+    VkExportMemoryAllocateInfo export_info = {
+        VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,  // sType
+        nullptr,                                        // pNext
+        static_cast<VkExternalMemoryHandleTypeFlags>(kHandleType),
+    };
+    ::VkDeviceMemory exported =
+        Allocate(source, size, memory_index, &export_info);
+#ifdef _WIN32
+    VkMemoryGetWin32HandleInfoKHR get_handle_info = {
+        VK_STRUCTURE_TYPE_MEMORY_GET_WIN32_HANDLE_INFO_KHR,  // sType
+        nullptr,                                             // pNext
+        exported,                                            // memory
+        kHandleType,                                         // handleType
+    };
+    HANDLE handle;
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkGetMemoryWin32HandleKHR(device, &get_handle_info,
+                                                 &handle));
+    VkImportMemoryWin32HandleInfoKHR import_info = {
+        VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR,  // sType
+        nullptr,                                                // pNext
+        kHandleType,                                            // handleType
+        handle,                                                 // handle
+        nullptr,                                                // name
+    };
+    ::VkDeviceMemory imported =
+        Allocate(source, size, memory_index, &import_info);
+    // Importing a Win32 handle does not take its ownership.
+    CloseHandle(handle);
+#elif __linux__
+    VkMemoryGetFdInfoKHR get_fd_info = {
+        VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,  // sType
+        nullptr,                                   // pNext
+        exported,                                  // memory
+        kHandleType,                               // handleType
+    };
+    int fd;
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkGetMemoryFdKHR(device, &get_fd_info, &fd));
+    // The imported memory owns the file descriptor.
+    VkImportMemoryFdInfoKHR import_info = {
+        VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,  // sType
+        nullptr,                                      // pNext
+        kHandleType,                                  // handleType
+        fd,                                           // fd
+    };
+    ::VkDeviceMemory imported =
+        Allocate(source, size, memory_index, &import_info);
+#endif
+    return imported;
+  }
+
+  // Creates a source image for |path|, with a device-local allocation for
+  // every plane if it is |disjoint|, that is imported if the device can
+  // import memory for it.
+  containers::unique_ptr<Source> CreateSource(MultiplanarConsumer::Path path,
+                                              const Resolution& resolution,
+                                              bool disjoint) {
+    vulkan::VkDevice& device = app_->device();
+    auto source = containers::make_unique<Source>(data_->allocator(),
+                                                  data_->allocator());
+    const VkImageCreateFlags flags =
+        MultiplanarConsumer::ImageCreateFlags(path) |
+        (disjoint ? VK_IMAGE_CREATE_DISJOINT_BIT : 0);
+    const VkImageUsageFlags usage =
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    source->disjoint = disjoint;
+    source->imported = CanImport(flags, usage);
+
+    VkExternalMemoryImageCreateInfo external_info = {
+        VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,  // sType
+        nullptr,                                              // pNext
+        static_cast<VkExternalMemoryHandleTypeFlags>(kHandleType),
+    };
+    VkImageCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,          // sType
+        source->imported ? &external_info : nullptr,  // pNext
+        flags,                                        // flags
+        VK_IMAGE_TYPE_2D,                             // imageType
+        format_,                                      // format
+        {resolution.width, resolution.height, 1},     // extent
+        1,                                            // mipLevels
+        1,                                            // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                        // samples
+        VK_IMAGE_TILING_OPTIMAL,                      // tiling
+        usage,                                        // usage
+        VK_SHARING_MODE_EXCLUSIVE,                    // sharingMode
+        0,                                            // queueFamilyIndexCount
+        nullptr,                                      // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,                    // initialLayout
+    };
+    ::VkImage image;
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkCreateImage(device, &create_info, nullptr, &image));
+    source->image = containers::make_unique<vulkan::VkImage>(
+        data_->allocator(), vulkan::VkImage(image, nullptr, &device));
+
+    const uint32_t num_bindings =
+        disjoint ? MultiplanarConsumer::NumPlanes(format_) : 1;
+    VkBindImagePlaneMemoryInfo plane_infos[3];
+    VkBindImageMemoryInfo bind_infos[3];
+    for (uint32_t i = 0; i < num_bindings; ++i) {
+      const VkImageAspectFlagBits aspect =
+          static_cast<VkImageAspectFlagBits>(VK_IMAGE_ASPECT_PLANE_0_BIT << i);
+      VkImagePlaneMemoryRequirementsInfo plane_requirements_info = {
+          VK_STRUCTURE_TYPE_IMAGE_PLANE_MEMORY_REQUIREMENTS_INFO,  // sType
+          nullptr,                                                 // pNext
+          aspect,  // planeAspect
+      };
+      VkImageMemoryRequirementsInfo2 requirements_info = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,  // sType
+          disjoint ? &plane_requirements_info : nullptr,       // pNext
+          image,                                               // image
+      };
+      VkMemoryRequirements2 requirements = {
+          VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,  // sType
+          nullptr,                                  // pNext
+          {},                                       // memoryRequirements
+      };
+      device->vkGetImageMemoryRequirements2KHR(device, &requirements_info,
+                                               &requirements);
+      const uint32_t memory_index = vulkan::GetMemoryIndex(
+          &device, data_->logger(),
+          requirements.memoryRequirements.memoryTypeBits,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      const VkDeviceSize size = requirements.memoryRequirements.size;
+      plane_infos[i] = {
+          VK_STRUCTURE_TYPE_BIND_IMAGE_PLANE_MEMORY_INFO,  // sType
+          nullptr,                                         // pNext
+          aspect,                                          // planeAspect
+      };
+      bind_infos[i] = {
+          VK_STRUCTURE_TYPE_BIND_IMAGE_MEMORY_INFO,  // sType
+          disjoint ? &plane_infos[i] : nullptr,      // pNext
+          image,                                     // image
+          source->imported ? Import(source.get(), size, memory_index)
+                           : Allocate(source.get(), size, memory_index,
+                                      nullptr),  // memory
+          0,                                     // memoryOffset
+      };
+    }
+    LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+               device->vkBindImageMemory2KHR(device, num_bindings,
+                                             bind_infos));
+    return source;
+  }
+
+  // Writes a test pattern to the planes of |source|, and leaves it in
+  // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. This stands in for the
+  // decoder writing the frame, and is not measured.
+  void Fill(Source* source, const Resolution& resolution) {
+    const uint32_t width = resolution.width;
+    const uint32_t height = resolution.height;
+    const uint32_t num_planes = MultiplanarConsumer::NumPlanes(format_);
+    const VkDeviceSize luma_size = VkDeviceSize(width) * height;
+    const VkDeviceSize chroma_size = luma_size / 4;
+    auto staging = app_->CreateAndBindDefaultExclusiveHostBuffer(
+        luma_size + 2 * chroma_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    uint8_t* luma = reinterpret_cast<uint8_t*>(staging->base_address());
+    uint8_t* chroma = luma + luma_size;
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        luma[y * width + x] =
+            static_cast<uint8_t>(16 + ((x * 7 + y * 3) & 0xff) * 219 / 255);
+      }
+    }
+    for (uint32_t y = 0; y < height / 2; ++y) {
+      for (uint32_t x = 0; x < width / 2; ++x) {
+        const uint8_t cb = static_cast<uint8_t>(16 + x * 224 / (width / 2));
+        const uint8_t cr = static_cast<uint8_t>(16 + y * 224 / (height / 2));
+        const size_t index = y * (width / 2) + x;
+        if (num_planes == 2) {
+          chroma[2 * index] = cb;
+          chroma[2 * index + 1] = cr;
+        } else {
+          chroma[index] = cb;
+          chroma[chroma_size + index] = cr;
+        }
+      }
+    }
+    staging->flush();
+
+    VkBufferImageCopy regions[3];
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < num_planes; ++i) {
+      const uint32_t plane_width = i == 0 ? width : width / 2;
+      const uint32_t plane_height = i == 0 ? height : height / 2;
+      regions[i] = {
+          offset,  // bufferOffset
+          0,       // bufferRowLength
+          0,       // bufferImageHeight
+          {static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_PLANE_0_BIT << i),
+           0, 0, 1},                       // imageSubresource
+          {0, 0, 0},                       // imageOffset
+          {plane_width, plane_height, 1},  // imageExtent
+      };
+      offset += i == 0 ? luma_size : chroma_size * (4 - num_planes);
+    }
+
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,   // sType
+        nullptr,                                  // pNext
+        0,                                        // srcAccessMask
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // dstAccessMask
+        VK_IMAGE_LAYOUT_UNDEFINED,                // oldLayout
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,     // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *source->image,                           // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},  // subresourceRange
+    };
+    vulkan::VkCommandBuffer cmd =
+        app_->GetCommandBuffer(app_->render_queue().index());
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                              0, nullptr, 1, &barrier);
+    cmd->vkCmdCopyBufferToImage(cmd, *staging, *source->image,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                num_planes, regions);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                              nullptr, 0, nullptr, 1, &barrier);
+    cmd->vkEndCommandBuffer(cmd);
+    SubmitAndWait(&app_->render_queue(), &cmd);
+  }
+
+  // Returns the GPU time of the fastest of kNumRuns conversions of the
+  // only source of |consumer|, in nanoseconds, or a negative number if it
+  // could not be measured.
+  double Measure(MultiplanarConsumer* consumer) {
+    vulkan::VkDevice& device = app_->device();
+    vulkan::VkQueue& queue = app_->render_queue();
+    double best = -1.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run) {
+      vulkan::VkCommandBuffer cmd = app_->GetCommandBuffer(queue.index());
+      cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+      cmd->vkCmdResetQueryPool(cmd, query_pool_, 0, 2);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 0);
+      consumer->Convert(&cmd, 0);
+      cmd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               query_pool_, 1);
+      cmd->vkEndCommandBuffer(cmd);
+      SubmitAndWait(&queue, &cmd);
+
+      uint64_t timestamps[2];
+      if (device->vkGetQueryPoolResults(
+              device, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+              sizeof(uint64_t),
+              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      const double ns = ((timestamps[1] - timestamps[0]) & timestamp_mask_) *
+                        static_cast<double>(device.limits().timestampPeriod);
+      if (best < 0.0 || ns < best) {
+        best = ns;
+      }
+    }
+    return best;
+  }
+
+  // Compares the results of both paths, and logs how far apart they are.
+  void Compare(MultiplanarConsumer* sampler, MultiplanarConsumer* planes,
+               const Resolution& resolution) {
+    vulkan::GpuImageDiff diff(app_, resolution.width, resolution.height, 1,
+                              image_diff_shader);
+    const size_t comparison = diff.AddComparison(
+        planes->output_view(), VK_IMAGE_LAYOUT_GENERAL,
+        sampler->output_view(), VK_IMAGE_LAYOUT_GENERAL);
+    vulkan::VkCommandBuffer cmd =
+        app_->GetCommandBuffer(app_->render_queue().index());
+    cmd->vkBeginCommandBuffer(cmd, &kBeginInfo);
+    diff.Compare(&cmd, comparison, 0, kTolerance, false);
+    cmd->vkEndCommandBuffer(cmd);
+    SubmitAndWait(&app_->render_queue(), &cmd);
+    const vulkan::GpuImageDiff::Result result = diff.result(0);
+    data_->logger()->LogInfo(
+        "MULTIPLANAR_DIFF: resolution: ", resolution.name,
+        " different_pixels: ", result.num_different_pixels,
+        " max_difference: ", result.max_difference[0], " ",
+        result.max_difference[1], " ", result.max_difference[2]);
+  }
+
+  const entry::EntryData* data_;
+  vulkan::VulkanApplication* app_;
+  VkFormat format_;
+  uint64_t timestamp_mask_;
+  vulkan::VkQueryPool query_pool_;
+};
+}  // anonymous namespace
+
+// This sample measures the conversion of 4:2:0 frames to RGBA through a
+// VkSamplerYcbcrConversion and through a compute shader that reads the
+// planes, at 1080p and 4K. It logs one line per path and resolution, and
+// how far apart the results of both paths are:
+//   MULTIPLANAR: path: <path> resolution: <resolution> disjoint: <0|1>
+//       imported: <0|1> ms: <time> Mpixels/s: <rate>
+//   MULTIPLANAR_DIFF: resolution: <resolution> different_pixels: <n>
+//       max_difference: <r> <g> <b>
+// -sample-option=path=<path> and resolution=<resolution> only measure
+// those, and format=yuv420 converts 3 plane images instead of NV12.
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  const char* format_option = data->sample_option("format");
+  const VkFormat format =
+      format_option && strcmp(format_option, "yuv420") == 0
+          ? VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM
+          : VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+
+  vulkan::VulkanApplication app(
+      data->allocator(), data->logger(), data,
+      {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+       VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME},
+      {VK_KHR_MAINTENANCE1_EXTENSION_NAME, VK_KHR_BIND_MEMORY_2_EXTENSION_NAME,
+       VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+       VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME,
+       VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+#ifdef _WIN32
+       VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME
+#elif __linux__
+       VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME
+#endif
+      },
+      {0}, 16 * 1024 * 1024, 64 * 1024 * 1024, 1024 * 1024, 1024 * 1024,
+      false, false, false, 0, false, false, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+      false, false, nullptr, false, false, &ycbcr_features);
+  YcbcrConversionBenchmark benchmark(data, &app, format);
+  benchmark.Run(data->sample_option("path"),
+                data->sample_option("resolution"));
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
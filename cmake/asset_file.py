@@ -0,0 +1,194 @@
+# Copyright 2017 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Writes binary asset files, as read by vulkan_helpers/asset_file.h.
+
+The file is laid out as:
+ struct { uint32_t magic, version, num_sections, reserved; } header;
+ struct {
+   uint32_t tag;
+   uint32_t compression;
+   uint64_t offset;
+   uint64_t size;
+   uint64_t uncompressed_size;
+ } sections[num_sections];
+ The data of every section, each aligned to SECTION_ALIGNMENT bytes.
+
+All values are little-endian.
+"""
+
+import struct
+
+MAGIC = 0x46415456  # "VTAF"
+VERSION = 1
+SECTION_ALIGNMENT = 16
+
+VERTEX_DATA = 0x58545256  # "VRTX"
+INDEX_DATA = 0x58444e49  # "INDX"
+INDEX_DATA_16 = 0x36315849  # "IX16"
+TEXTURE_INFO = 0x464e4954  # "TINF"
+TEXTURE_DATA = 0x41544454  # "TDTA"
+
+UNCOMPRESSED = 0
+RUN_LENGTH = 1
+CHUNKED_LZ4 = 2
+
+# The sections that GpuDecompressor can decode straight into device memory,
+# and that are chunked LZ4 compressed with gpu_compress.
+GPU_SECTIONS = (VERTEX_DATA, INDEX_DATA, INDEX_DATA_16, TEXTURE_DATA)
+# The number of uncompressed bytes of every chunk, which is what one
+# invocation of the decompression shader decodes.
+LZ4_CHUNK_SIZE = 16384
+
+
+def run_length_encode(data):
+    """PackBits-style encoding: a control byte c < 128 is followed by c + 1
+    literal bytes, a control byte c >= 128 by one byte repeated c - 126
+    times."""
+    out = bytearray()
+    literals = bytearray()
+    i = 0
+    while i < len(data):
+        run = 1
+        while (i + run < len(data) and run < 129 and
+               data[i + run] == data[i]):
+            run += 1
+        if run >= 2:
+            if literals:
+                out.append(len(literals) - 1)
+                out.extend(literals)
+                literals = bytearray()
+            out.append(run + 126)
+            out.append(data[i])
+            i += run
+        else:
+            literals.append(data[i])
+            if len(literals) == 128:
+                out.append(127)
+                out.extend(literals)
+                literals = bytearray()
+            i += 1
+    if literals:
+        out.append(len(literals) - 1)
+        out.extend(literals)
+    return bytes(out)
+
+
+def lz4_encode(data):
+    """Encodes |data| as one LZ4 block, greedily matching the last position
+    of every 4 byte sequence. The last 5 bytes are always literals, and no
+    match starts in the last 12 bytes, as the LZ4 block format requires."""
+    out = bytearray()
+    last_position = {}
+    size = len(data)
+    match_limit = size - 12
+    anchor = 0
+    i = 0
+
+    def write_length(value):
+        while value >= 255:
+            out.append(255)
+            value -= 255
+        out.append(value)
+
+    while i < match_limit:
+        key = bytes(data[i:i + 4])
+        candidate = last_position.get(key)
+        last_position[key] = i
+        if candidate is None or i - candidate > 65535:
+            i += 1
+            continue
+        length = 4
+        while (i + length < size - 5 and
+               data[candidate + length] == data[i + length]):
+            length += 1
+        literals = i - anchor
+        token_literals = min(literals, 15)
+        token_match = min(length - 4, 15)
+        out.append((token_literals << 4) | token_match)
+        if literals >= 15:
+            write_length(literals - 15)
+        out.extend(data[anchor:i])
+        out.extend(struct.pack('<H', i - candidate))
+        if length - 4 >= 15:
+            write_length(length - 4 - 15)
+        i += length
+        anchor = i
+    literals = size - anchor
+    out.append(min(literals, 15) << 4)
+    if literals >= 15:
+        write_length(literals - 15)
+    out.extend(data[anchor:])
+    return bytes(out)
+
+
+def chunked_lz4_encode(data):
+    """Splits |data| into LZ4_CHUNK_SIZE chunks that are LZ4 encoded on their
+    own, after a table of
+     struct { uint32_t num_chunks, chunk_size; } header;
+     uint32_t chunk_offsets[num_chunks + 1];
+    where the offsets are from the start of the table."""
+    chunks = [lz4_encode(data[i:i + LZ4_CHUNK_SIZE])
+              for i in range(0, len(data), LZ4_CHUNK_SIZE)]
+    offset = 8 + 4 * (len(chunks) + 1)
+    offsets = [offset]
+    for chunk in chunks:
+        offset += len(chunk)
+        offsets.append(offset)
+    out = bytearray(struct.pack('<II', len(chunks), LZ4_CHUNK_SIZE))
+    out.extend(struct.pack('<' + 'I' * len(offsets), *offsets))
+    for chunk in chunks:
+        out.extend(chunk)
+    return bytes(out)
+
+
+def write_asset_file(filename, sections, compress, gpu_compress=False):
+    """Writes |sections|, a list of (tag, bytes) to |filename|.
+    If |compress| is true, every section that gets smaller is run-length
+    encoded. If |gpu_compress| is true, the GPU_SECTIONS that get smaller are
+    chunked LZ4 encoded instead, to be decoded by GpuDecompressor."""
+    encoded = []
+    for tag, data in sections:
+        data = bytes(data)
+        compression = UNCOMPRESSED
+        stored = data
+        if gpu_compress and tag in GPU_SECTIONS:
+            lz4 = chunked_lz4_encode(bytearray(data))
+            if len(lz4) < len(data):
+                compression = CHUNKED_LZ4
+                stored = lz4
+        elif compress:
+            rle = run_length_encode(bytearray(data))
+            if len(rle) < len(data):
+                compression = RUN_LENGTH
+                stored = rle
+        encoded.append((tag, compression, stored, len(data)))
+
+    def align(value):
+        return (value + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1)
+
+    offset = align(16 + 32 * len(encoded))
+    table = bytearray(struct.pack('<IIII', MAGIC, VERSION, len(encoded), 0))
+    body = bytearray()
+    for tag, compression, stored, uncompressed_size in encoded:
+        table.extend(struct.pack('<IIQQQ', tag, compression, offset,
+                                 len(stored), uncompressed_size))
+        padded = align(len(stored))
+        body.extend(stored)
+        body.extend(b'\0' * (padded - len(stored)))
+        offset += padded
+    table.extend(b'\0' * (align(len(table)) - len(table)))
+    with open(filename, 'wb') as f:
+        f.write(table)
+        f.write(body)
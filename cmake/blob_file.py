@@ -0,0 +1,101 @@
+# Copyright 2017 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+"""Writes the data of a generated header as a binary blob, which the header
+embeds with .incbin, instead of as an initializer list.
+
+The compiler then only parses the declaration of the struct, however large
+the data is. The blob holds the bytes of the struct exactly as the compiler
+lays it out, so the header still declares a const struct with the same
+members as before, and everything that uses them keeps working. The header
+static_asserts that the sizes match.
+
+Only the GNU assembler syntax is written, for the ELF and Mach-O targets
+that GCC and Clang build for.
+"""
+
+import os
+import re
+import struct
+
+
+class BlobWriter(object):
+    """Lays out the members of a struct the way the compiler does, for a
+    target with |pointer_size| byte size_t."""
+
+    def __init__(self, pointer_size):
+        self.pointer_size = pointer_size
+        self.data = bytearray()
+        self.alignment = 1
+
+    def align(self, alignment):
+        self.alignment = max(self.alignment, alignment)
+        self.data.extend(b'\0' * (-len(self.data) % alignment))
+
+    def size_t(self, value):
+        self.align(self.pointer_size)
+        self.data.extend(struct.pack(
+            '<Q' if self.pointer_size == 8 else '<I', value))
+
+    def array(self, value_format, values):
+        """Adds an array of values with the given struct format, e.g. 'f'"""
+        self.align(struct.calcsize(value_format))
+        self.data.extend(struct.pack('<' + value_format * len(values),
+                                     *values))
+
+    def raw(self, data, alignment):
+        """Adds bytes that are already laid out, e.g. an array of structs"""
+        self.align(alignment)
+        self.data.extend(data)
+
+    def finish(self):
+        """Returns the bytes, with the padding at the end of the struct"""
+        self.align(self.alignment)
+        return self.data
+
+
+def symbol_name(filename, name):
+    """Returns the name of the symbol of a blob, which only has to be unique
+    in the translation units that include the header"""
+    base = re.sub(r'[^a-zA-Z0-9_]', '_', os.path.basename(filename))
+    return 'vta_blob_' + base + '_' + name
+
+
+def write_blob(f, header_name, name, members, data):
+    """Writes the blob of the variable |name|, a const struct with the given
+    member declarations, next to the header, and its declaration to the
+    header |f|."""
+    blob_name = header_name + '.' + name + '.bin'
+    with open(blob_name, 'wb') as blob:
+        blob.write(data)
+    path = os.path.abspath(blob_name).replace('\\', '/')
+    symbol = symbol_name(header_name, name)
+    f.write('#if defined(__APPLE__)\n')
+    f.write('__asm__(".pushsection __TEXT,__const\\n"\n')
+    f.write('        ".balign 16\\n"\n')
+    f.write('        "_' + symbol + ':\\n"\n')
+    f.write('#else\n')
+    f.write('__asm__(".pushsection .rodata\\n"\n')
+    f.write('        ".balign 16\\n"\n')
+    f.write('        "' + symbol + ':\\n"\n')
+    f.write('#endif\n')
+    f.write('        ".incbin \\"' + path + '\\"\\n"\n')
+    f.write('        ".popsection\\n");\n')
+    f.write('extern "C" const struct {\n')
+    f.write(members)
+    f.write('} ' + symbol + ';\n')
+    f.write('static const auto& ' + name + ' = ' + symbol + ';\n')
+    f.write('static_assert(sizeof(' + symbol + ') == ' + str(len(data)) +
+            ', "The blob of ' + name + ' has the wrong layout");\n')
@@ -53,6 +53,8 @@ set(NON_CONFIGURABLE_ANDROID_SOURCES
   ${VulkanTestApplications_SOURCE_DIR}/cmake/android_project_template/app/src/main/res/mipmap-xxxhdpi/ic_launcher.png)
 
 set(CMAKE_GLSL_COMPILER "glslc" CACHE STRING "Which glsl compiler to use")
+set(CMAKE_SPIRV_OPT "" CACHE STRING
+    "The spirv-opt that optimizes the shaders of OPTIMIZED shader libraries")
 
 SET(DEFAULT_WINDOW_WIDTH ${DEFAULT_WINDOW_WIDTH} CACHE INT
     "Default window width for platforms that have resizable windows")
@@ -196,6 +198,29 @@ function(compile_hlsl_using_dxc shader output_file result)
   set(${result} ${dxc_hlsl_filename} PARENT_SCOPE)
 endfunction(compile_hlsl_using_dxc)
 
+# Compiles the given GLSL shader through glslc, and optimizes the SPIR-V with
+# spirv-opt -O, into <shader>.opt.spv.
+# The name of the resulting file is also written to the 'result' variable.
+function(compile_glsl_using_spirv_opt shader output_file result)
+  get_filename_component(input_file ${shader} ABSOLUTE)
+  string(REGEX REPLACE "\\.spv$" ".opt.spv" opt_filename ${output_file})
+  if (NOT CMAKE_SPIRV_OPT)
+    # Create an empty .spv file as placeholder so the C++ code compiles.
+    file(WRITE ${opt_filename} "{}")
+  else()
+  add_custom_command (
+    OUTPUT ${opt_filename}
+    WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+    COMMENT "Compiling optimized SPIR-V binary using spirv-opt: ${shader}"
+    DEPENDS ${shader} ${FILE_DEPS} ${VulkanTestApplications_SOURCE_DIR}/tools/spirv_c_mfmt.py
+    COMMAND ${CMAKE_GLSL_COMPILER} -o ${opt_filename}.bin -c ${input_file} ${ADDITIONAL_ARGS}
+    COMMAND ${CMAKE_SPIRV_OPT} -O -o ${opt_filename}.opt.bin ${opt_filename}.bin
+    COMMAND ${PYTHON_EXECUTABLE} ${VulkanTestApplications_SOURCE_DIR}/tools/spirv_c_mfmt.py ${opt_filename}.opt.bin --output-file=${opt_filename}
+  )
+  endif()
+  set(${result} ${opt_filename} PARENT_SCOPE)
+endfunction(compile_glsl_using_spirv_opt)
+
 # Android studio generates VERY deep paths. This causes builds on windows to fail,
 # because CMake is not set up to handle deep paths.
 # If we are building APKS, then shorten all paths
@@ -410,8 +435,17 @@ function(add_vulkan_shared_library target)
   _add_vulkan_library(${target} TYPE SHARED ${ARGN})
 endfunction(add_vulkan_shared_library)
 
+# Outside of Windows, the data of the headers generated for model and texture
+# SOURCES is embedded from binary blobs (<header>.<name>.bin) with .incbin,
+# rather than written as initializer lists for the compiler to parse.
+if (NOT WIN32)
+  set(BLOB_ARGS --blob --pointer-size ${CMAKE_SIZEOF_VOID_P})
+endif()
+
 function(add_model_library target)
-  cmake_parse_arguments(LIB "" "TYPE" "SOURCES" ${ARGN})
+  # Models in BINARY are written as run-length encoded binary asset files
+  # (<model>.vtaf) instead of headers, to be loaded with vulkan::AssetFile.
+  cmake_parse_arguments(LIB "" "TYPE" "SOURCES;BINARY" ${ARGN})
   if (BUILD_APKS)
     add_custom_target(${target})
     set(ABSOLUTE_SOURCES)
@@ -428,17 +462,42 @@ function(add_model_library target)
       file(RELATIVE_PATH rel_pos ${CMAKE_CURRENT_SOURCE_DIR} ${model})
       set(output_file ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h)
       get_filename_component(output_file ${output_file} ABSOLUTE)
-      list(APPEND output_files ${output_file})
+      set(blob_files)
+      if (BLOB_ARGS)
+        set(blob_files ${output_file}.model.bin)
+      endif()
+      list(APPEND output_files ${output_file} ${blob_files})
 
       add_custom_command(
-        OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h
+        OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h ${blob_files}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
         COMMENT "Compiling Model ${model}"
         DEPENDS ${model}
           ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/asset_file.py
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/blob_file.py
+        COMMAND ${PYTHON_EXECUTABLE}
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
+            ${model} -o ${output_file} ${BLOB_ARGS}
+      )
+    endforeach()
+    foreach(model ${LIB_BINARY})
+      get_filename_component(model ${model} ABSOLUTE)
+      file(RELATIVE_PATH rel_pos ${CMAKE_CURRENT_SOURCE_DIR} ${model})
+      set(output_file ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.vtaf)
+      get_filename_component(output_file ${output_file} ABSOLUTE)
+      list(APPEND output_files ${output_file})
+
+      add_custom_command(
+        OUTPUT ${output_file}
+        WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+        COMMENT "Compiling binary model ${model}"
+        DEPENDS ${model}
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/asset_file.py
         COMMAND ${PYTHON_EXECUTABLE}
           ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
-            ${model} -o ${output_file}
+            ${model} -o ${output_file} --binary --compress
       )
     endforeach()
     add_custom_target(${target}
@@ -451,8 +510,26 @@ function(add_model_library target)
   endif()
 endfunction()
 
+# Writes ${spirv_file}.layout.h, the checks of C++ structs against the
+# structs of the compiled shader, see vulkan_helpers/shader_layout.h.
+function(add_shader_layout_checks spirv_file)
+  add_custom_command (
+    OUTPUT ${spirv_file}.layout.h
+    COMMENT "Writing layout checks for ${spirv_file}"
+    DEPENDS ${spirv_file}
+      ${VulkanTestApplications_SOURCE_DIR}/tools/shader_layout_check.py
+      ${VulkanTestApplications_SOURCE_DIR}/tools/struct_offsets.py
+    COMMAND ${PYTHON_EXECUTABLE}
+      ${VulkanTestApplications_SOURCE_DIR}/tools/shader_layout_check.py
+      --output ${spirv_file}.layout.h ${spirv_file}
+  )
+endfunction(add_shader_layout_checks)
+
 function(add_shader_library target)
-  cmake_parse_arguments(LIB "" "" "SOURCES;SHADER_DEPS" ${ARGN})
+  # OPTIMIZED also compiles every GLSL shader into <shader>.opt.spv, optimized
+  # with CMAKE_SPIRV_OPT, or into an empty placeholder without it.
+  cmake_parse_arguments(LIB "LAYOUT_CHECKS;OPTIMIZED" "TARGET_ENV"
+    "SOURCES;SHADER_DEPS" ${ARGN})
   if (BUILD_APKS)
     add_custom_target(${target})
     set(ABSOLUTE_SOURCES)
@@ -491,6 +568,9 @@ function(add_shader_library target)
         include(${output_file}.d.cmake)
 
         set(ADDITIONAL_ARGS "")
+        if (LIB_TARGET_ENV)
+          list(APPEND ADDITIONAL_ARGS "--target-env=${LIB_TARGET_ENV}")
+        endif()
         if (LIB_SHADER_DEPS)
           foreach(DEP ${LIB_SHADER_DEPS})
             if(NOT TARGET ${DEP})
@@ -516,6 +596,14 @@ function(add_shader_library target)
           # Compile GLSL shaders through glslc
           compile_glsl_using_glslc(${shader} ${output_file})
           list(APPEND output_files ${output_file})
+          if (LIB_OPTIMIZED)
+            compile_glsl_using_spirv_opt(${shader} ${output_file} result)
+            list(APPEND output_files ${result})
+          endif()
+          if (LIB_LAYOUT_CHECKS)
+            add_shader_layout_checks(${output_file})
+            list(APPEND output_files ${output_file}.layout.h)
+          endif()
         endif()
       endif()
     endforeach()
@@ -532,12 +620,16 @@ function(add_shader_library target)
   endif()
 endfunction()
 
+# Textures listed under COMPRESSED are also written as block-compressed
+# copies, see convert_img_to_c.py.
 function(add_texture_library target)
-  cmake_parse_arguments(LIB "" "TYPE" "SOURCES" ${ARGN})
+  # Textures in BINARY are written as run-length encoded binary asset files
+  # (<texture>.vtaf) instead of headers, to be loaded with vulkan::AssetFile.
+  cmake_parse_arguments(LIB "" "TYPE" "SOURCES;COMPRESSED;BINARY" ${ARGN})
   if (BUILD_APKS)
     add_custom_target(${target})
     set(ABSOLUTE_SOURCES)
-    foreach(SOURCE ${LIB_SOURCES})
+    foreach(SOURCE ${LIB_SOURCES} ${LIB_COMPRESSED})
       get_filename_component(TEMP ${SOURCE} ABSOLUTE)
       list(APPEND ABSOLUTE_SOURCES ${TEMP})
     endforeach()
@@ -545,22 +637,56 @@ function(add_texture_library target)
     set_target_properties(${target} PROPERTIES LIB_DEPS "")
   else()
     set(output_files)
-    foreach(texture ${LIB_SOURCES})
+    foreach(texture ${LIB_SOURCES} ${LIB_COMPRESSED})
+      set(compress_args)
+      list(FIND LIB_COMPRESSED ${texture} compressed_index)
+      if (NOT compressed_index EQUAL -1)
+        set(compress_args --compressed)
+      endif()
       get_filename_component(texture ${texture} ABSOLUTE)
       file(RELATIVE_PATH rel_pos ${CMAKE_CURRENT_SOURCE_DIR} ${texture})
       set(output_file ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h)
       get_filename_component(output_file ${output_file} ABSOLUTE)
-      list(APPEND output_files ${output_file})
+      set(blob_files)
+      if (BLOB_ARGS)
+        set(blob_files ${output_file}.texture.bin)
+        if (compress_args)
+          list(APPEND blob_files ${output_file}.texture_bc1.bin
+            ${output_file}.texture_etc2.bin)
+        endif()
+      endif()
+      list(APPEND output_files ${output_file} ${blob_files})
 
       add_custom_command(
-        OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h
+        OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h ${blob_files}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
         COMMENT "Compiling texture ${texture}"
         DEPENDS ${texture}
           ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_img_to_c.py
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/asset_file.py
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/blob_file.py
+        COMMAND ${PYTHON_EXECUTABLE}
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_img_to_c.py
+            ${texture} -o ${output_file} ${compress_args} ${BLOB_ARGS}
+      )
+    endforeach()
+    foreach(texture ${LIB_BINARY})
+      get_filename_component(texture ${texture} ABSOLUTE)
+      file(RELATIVE_PATH rel_pos ${CMAKE_CURRENT_SOURCE_DIR} ${texture})
+      set(output_file ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.vtaf)
+      get_filename_component(output_file ${output_file} ABSOLUTE)
+      list(APPEND output_files ${output_file})
+
+      add_custom_command(
+        OUTPUT ${output_file}
+        WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+        COMMENT "Compiling binary texture ${texture}"
+        DEPENDS ${texture}
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_img_to_c.py
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/asset_file.py
         COMMAND ${PYTHON_EXECUTABLE}
           ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_img_to_c.py
-            ${texture} -o ${output_file}
+            ${texture} -o ${output_file} --binary --compress
       )
     endforeach()
     add_custom_target(${target}
@@ -26,13 +26,267 @@ struct {
  {{data_0}, {data_1}, {data_2} ...}
 };
 
+With --compressed, block-compressed copies of the image are written after it,
+one per format in COMPRESSED_FORMATS, of the form
+struct {
+ VkFormat format;
+ size_t width;
+ size_t height;
+ size_t block_width;
+ size_t block_height;
+ size_t block_size;
+ uint8_t data[num_bytes];
+} texture_<name> = { ... };
+The blocks hold the texels in the same order as the uncompressed data.
+
+With --blob the header declares the same structs, but their data is written
+to <output>.<name>.bin, which the header embeds (see blob_file.py), so that
+the compiler does not have to parse it.
+
+With --binary a binary asset file (see asset_file.py) is written instead,
+with a TINF section holding {uint32_t format, width, height, reserved} and a
+TDTA section holding the same texels as the data member above.
 """
 
 import argparse
+import struct
 import sys
 import re
 from PIL import Image
 
+import asset_file
+import blob_file
+
+
+# The modifier tables of ETC1, which ETC2 decoders also use for blocks in
+# individual mode.
+ETC1_MODIFIERS = [
+    [2, 8], [5, 17], [9, 29], [13, 42],
+    [18, 60], [24, 80], [33, 106], [47, 183],
+]
+
+
+def clamp_byte(value):
+    return max(0, min(255, value))
+
+
+def encode_bc1_block(texels):
+    """Encodes 16 (r, g, b) texels, in row-major order, as a BC1 block."""
+    lo = [min(t[c] for t in texels) for c in range(3)]
+    hi = [max(t[c] for t in texels) for c in range(3)]
+
+    def to_565(c):
+        return ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3)
+
+    def from_565(v):
+        r = (v >> 11) & 0x1F
+        g = (v >> 5) & 0x3F
+        b = v & 0x1F
+        return [(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)]
+
+    color0 = to_565(hi)
+    color1 = to_565(lo)
+    indices = 0
+    if color0 != color1:
+        # color0 > color1 selects the opaque four color mode.
+        if color0 < color1:
+            color0, color1 = color1, color0
+        c0 = from_565(color0)
+        c1 = from_565(color1)
+        palette = [
+            c0, c1,
+            [(2 * c0[i] + c1[i]) // 3 for i in range(3)],
+            [(c0[i] + 2 * c1[i]) // 3 for i in range(3)],
+        ]
+        for i, t in enumerate(texels):
+            errors = [sum((t[c] - p[c]) ** 2 for c in range(3))
+                      for p in palette]
+            indices |= errors.index(min(errors)) << (2 * i)
+    return bytearray([
+        color0 & 0xFF, color0 >> 8, color1 & 0xFF, color1 >> 8,
+        indices & 0xFF, (indices >> 8) & 0xFF,
+        (indices >> 16) & 0xFF, (indices >> 24) & 0xFF])
+
+
+def encode_etc_subblock(texels):
+    """Returns (error, base_color, table, modifier_indices) for the best
+    individual mode encoding of the given (r, g, b) texels."""
+    average = [sum(t[c] for t in texels) // len(texels) for c in range(3)]
+    base4 = [(c * 15 + 127) // 255 for c in average]
+    base = [(c << 4) | c for c in base4]
+    best = None
+    for table in range(8):
+        small, large = ETC1_MODIFIERS[table]
+        # In the order of the index values, msb:lsb.
+        modifiers = [small, large, -small, -large]
+        error = 0
+        selected = []
+        for t in texels:
+            errors = [sum((t[c] - clamp_byte(base[c] + m)) ** 2
+                          for c in range(3)) for m in modifiers]
+            index = errors.index(min(errors))
+            error += errors[index]
+            selected.append(index)
+        if best is None or error < best[0]:
+            best = (error, base4, table, selected)
+    return best
+
+
+def encode_etc2_block(texels):
+    """Encodes 16 (r, g, b) texels, in row-major order, as an ETC2 RGB block.
+    Only the individual mode of ETC1 is used, which ETC2 decodes the same."""
+    best = None
+    for flip in range(2):
+        if flip:
+            # Two 4x2 sub-blocks, one above the other.
+            groups = [[(x, y) for y in range(0, 2) for x in range(4)],
+                      [(x, y) for y in range(2, 4) for x in range(4)]]
+        else:
+            # Two 2x4 sub-blocks, side by side.
+            groups = [[(x, y) for y in range(4) for x in range(0, 2)],
+                      [(x, y) for y in range(4) for x in range(2, 4)]]
+        encoded = [encode_etc_subblock([texels[y * 4 + x] for (x, y) in g])
+                   for g in groups]
+        error = encoded[0][0] + encoded[1][0]
+        if best is None or error < best[0]:
+            best = (error, flip, groups, encoded)
+    _, flip, groups, encoded = best
+    (_, base1, table1, sel1), (_, base2, table2, sel2) = encoded
+    high = ((base1[0] << 28) | (base2[0] << 24) | (base1[1] << 20) |
+            (base2[1] << 16) | (base1[2] << 12) | (base2[2] << 8) |
+            (table1 << 5) | (table2 << 2) | flip)
+    msbs = 0
+    lsbs = 0
+    for group, selected in zip(groups, [sel1, sel2]):
+        for (x, y), index in zip(group, selected):
+            # Texels are numbered down each column.
+            bit = x * 4 + y
+            msbs |= (index >> 1) << bit
+            lsbs |= (index & 1) << bit
+    low = (msbs << 16) | lsbs
+    return bytearray([(high >> s) & 0xFF for s in (24, 16, 8, 0)] +
+                     [(low >> s) & 0xFF for s in (24, 16, 8, 0)])
+
+
+# The name, format and block encoder of every compressed copy that is written
+# with --compressed. VulkanTexture picks the first one that the device
+# supports.
+COMPRESSED_FORMATS = [
+    ("bc1", "VK_FORMAT_BC1_RGB_UNORM_BLOCK", encode_bc1_block),
+    ("etc2", "VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK", encode_etc2_block),
+]
+
+
+def write_compressed(f, image, blob_header=None, pointer_size=8):
+    """Writes every format in COMPRESSED_FORMATS for |image|. If
+    |blob_header| is not None, it is the name of the header |f|, and the
+    data is written as blobs next to it."""
+    width, height = image.size
+    rgb = image.convert("RGB")
+
+    def texel(u, v):
+        # The uncompressed data is written column by column, so the texel at
+        # (u, v) of the flat data comes from this pixel.
+        u = min(u, width - 1)
+        v = min(v, height - 1)
+        i = v * width + u
+        return rgb.getpixel((i // height, i % height))
+
+    blocks_x = (width + 3) // 4
+    blocks_y = (height + 3) // 4
+    for name, vulkan_format, encode in COMPRESSED_FORMATS:
+        data = bytearray()
+        for by in range(blocks_y):
+            for bx in range(blocks_x):
+                data += encode([texel(bx * 4 + x, by * 4 + y)
+                                for y in range(4) for x in range(4)])
+        members = (" VkFormat format;\n" +
+                   " size_t width;\n" +
+                   " size_t height;\n" +
+                   " size_t block_width;\n" +
+                   " size_t block_height;\n" +
+                   " size_t block_size;\n" +
+                   " uint8_t data[" + str(len(data)) + "];\n")
+        if blob_header:
+            blob = blob_file.BlobWriter(pointer_size)
+            blob.array('I', [VULKAN_FORMAT_VALUES[vulkan_format]])
+            for value in (width, height, 4, 4, 8):
+                blob.size_t(value)
+            blob.raw(data, 1)
+            blob_file.write_blob(f, blob_header, "texture_" + name, members,
+                                 blob.finish())
+            continue
+        f.write("const struct {\n")
+        f.write(members)
+        f.write("} texture_" + name + " = {\n")
+        f.write("   " + vulkan_format + ",\n")
+        f.write("   " + str(width) + ",\n")
+        f.write("   " + str(height) + ",\n")
+        f.write("   4,\n   4,\n   8,\n")
+        f.write("   {\n")
+        for i in range(0, len(data), 16):
+            if i != 0:
+                f.write(",\n")
+            f.write("       " + ", ".join(str(b) for b in data[i:i + 16]))
+        f.write("\n   }\n")
+        f.write("};\n")
+
+
+# The numeric values of the VkFormats in vulkan_types below.
+VULKAN_FORMAT_VALUES = {
+    "VK_FORMAT_R8_UNORM": 9,
+    "VK_FORMAT_R8G8B8A8_UNORM": 37,
+    # There is no VK_FORMAT_R32_UNORM, R32_UINT holds the same bits.
+    "VK_FORMAT_R32_UNORM": 98,
+    "VK_FORMAT_R32_SFLOAT": 100,
+    "VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM": 1000156002,
+    "VK_FORMAT_BC1_RGB_UNORM_BLOCK": 131,
+    "VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK": 147,
+}
+
+
+def texel_data(image):
+    """Returns the texels of |image|, laid out the same way as in the
+    header."""
+    data = bytearray()
+    if image.mode == "YCbCr":
+        images = image.split()
+        for i in range(0, min(len(images), 3)):
+            plane = images[(i + 2) % 3]
+            if i != 0:
+                plane = plane.resize(
+                    (int(plane.width / 2), int(plane.height / 2)))
+            for j in range(0, plane.size[0]):
+                for k in range(0, plane.size[1]):
+                    data.append(plane.getpixel((j, k)))
+        # The header declares two bytes per texel for multiplanar images.
+        data.extend(b'\0' * (image.size[0] * image.size[1] * 2 - len(data)))
+    else:
+        for i in range(0, image.size[0]):
+            for j in range(0, image.size[1]):
+                pixel = image.getpixel((i, j))
+                if image.mode == "I":
+                    data.extend(struct.pack('<I', pixel))
+                elif image.mode == "F":
+                    data.extend(struct.pack('<f', pixel))
+                elif isinstance(pixel, tuple):
+                    # RGB is expanded to RGBA, with an alpha of 0 like the
+                    # header.
+                    data.extend(bytearray(pixel) + b'\0' * (4 - len(pixel)))
+                else:
+                    data.append(pixel)
+    return data
+
+
+def write_binary(filename, image, vulkan_format, compress, gpu_compress):
+    """Writes |image| as a binary asset file."""
+    data = texel_data(image)
+    info = struct.pack('<IIII', VULKAN_FORMAT_VALUES[vulkan_format],
+                       image.size[0], image.size[1], 0)
+    asset_file.write_asset_file(
+        filename, [(asset_file.TEXTURE_INFO, info),
+                   (asset_file.TEXTURE_DATA, data)], compress, gpu_compress)
+
 
 def main():
     parser = argparse.ArgumentParser(
@@ -43,9 +297,28 @@ def main():
         '-o', default="", help='output filename (Defaults to input.<ext>.h)')
     parser.add_argument(
         '--verbose', action='store_true', help='enable verbose output')
+    parser.add_argument(
+        '--compressed', action='store_true',
+        help='also write block-compressed copies of the image')
+    parser.add_argument(
+        '--binary', action='store_true',
+        help='write a binary asset file (Defaults to input.<ext>.vtaf)')
+    parser.add_argument(
+        '--compress', action='store_true',
+        help='run-length encode the sections of a binary asset file')
+    parser.add_argument(
+        '--gpu-compress', action='store_true',
+        help='chunked LZ4 encode the texels of a binary asset file, to be '
+        'decoded on the GPU')
+    parser.add_argument(
+        '--blob', action='store_true',
+        help='embed the data of the header from binary blobs')
+    parser.add_argument(
+        '--pointer-size', type=int, default=8,
+        help='the size of size_t on the target, for --blob')
     args = parser.parse_args()
     if not args.o:
-        args.o = args.img + ".h"
+        args.o = args.img + (".vtaf" if args.binary else ".h")
 
     data_types = {
         "1": "uint8_t",
@@ -76,6 +349,37 @@ def main():
         if (".jpg" in args.img):
             image.mode = "YCbCr"
 
+        if args.binary:
+            write_binary(args.o, image, vulkan_types[image.mode],
+                         args.compress, args.gpu_compress)
+            return 0
+
+        if args.blob:
+            data = texel_data(image)
+            num_texels = image.size[0] * image.size[1]
+            if image.mode == "YCbCr":
+                num_texels *= 2
+            members = (" VkFormat format;\n" +
+                       " size_t width;\n" +
+                       " size_t height;\n" +
+                       " " + data_types[image.mode] +
+                       " data[" + str(num_texels) + "];\n")
+            blob = blob_file.BlobWriter(args.pointer_size)
+            blob.array('I', [VULKAN_FORMAT_VALUES[vulkan_types[image.mode]]])
+            blob.size_t(image.size[0])
+            blob.size_t(image.size[1])
+            blob.raw(data, 4 if image.mode in ("I", "F") else 1)
+            with open(args.o, "w") as f:
+                blob_file.write_blob(f, args.o, "texture", members,
+                                     blob.finish())
+                if args.compressed:
+                    if image.mode == "YCbCr":
+                        print("Multiplanar images can not be compressed")
+                        return -1
+                    write_compressed(f, Image.open(args.img), args.o,
+                                     args.pointer_size)
+            return 0
+
         with open(args.o, "w") as f:
             f.write("const struct {\n")
             f.write(" VkFormat format;\n")
@@ -134,6 +438,11 @@ def main():
                             f.write(str(pixel))
             f.write("\n   }\n")
             f.write("};\n")
+            if args.compressed:
+                if image.mode == "YCbCr":
+                    print("Multiplanar images can not be compressed")
+                    return -1
+                write_compressed(f, Image.open(args.img))
     except IOError as err:
         print(err)
         return -1
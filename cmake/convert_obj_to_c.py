@@ -20,23 +20,190 @@ struct {
  float uv[num_vertices*2];
  float normals[num_vertices*3];
  size_t num_indices;
- uint32_t indices[num_indices];
+ uint16_t indices[num_indices];
+ size_t num_clusters;
+ float cluster_bounds[num_clusters*8];
+ uint32_t cluster_ranges[num_clusters*2];
 } model = {
  "num_vertices",
  {"vertex0.x", "vertex0.y", "vertex0.z", "vertex1.x", "vertex1.y", ...},
  {"vertex0.u", "vertex0.v", "vertex1.u", "vertex1.v", ...},
  {"vertex0.nx", "vertex0.ny", "vertex0.nz", "vertex1.nx", ...},
  "num_indices",
- {"index0", "index1", "index2", "index3" ... }
+ {"index0", "index1", "index2", "index3" ... },
+ "num_clusters",
+ {"cluster0.center.x", "cluster0.center.y", "cluster0.center.z",
+  "cluster0.radius", "cluster0.cone_axis.x", "cluster0.cone_axis.y",
+  "cluster0.cone_axis.z", "cluster0.cone_cutoff", "cluster1.center.x", ...},
+ {"cluster0.first_index", "cluster0.index_count", "cluster1.first_index", ...}
 };
 
-The result is an indexed vertex-list
+The result is an indexed vertex-list.
+Unless --no-optimize is given, the triangles are reordered for the
+post-transform vertex cache, and the vertices are then reordered in the
+order that they are first used. If there are no more than 65536 vertices
+the indices are uint16_t, otherwise they are uint32_t.
+
+The triangles are split into clusters of up to CLUSTER_TRIANGLES consecutive
+triangles, which can be culled on their own. Every cluster has a bounding
+sphere, and a cone around the normals of its triangles. If
+  dot(center - eye, cone_axis) >= cone_cutoff * length(center - eye) + radius
+then every triangle in the cluster faces away from the eye. A cone_cutoff
+greater than 1 means the cluster can never be culled that way.
+
+With --blob the header declares the same struct, but its data is written to
+<output>.model.bin, which the header embeds (see blob_file.py), so that the
+compiler does not have to parse it.
+
+With --binary a binary asset file (see asset_file.py) is written instead,
+with a VRTX section holding the positions, texture coordinates and normals
+in the same order as above, and an IX16 or INDX section holding the 16 or
+32 bit indices.
 """
 
 import argparse
+import math
+import struct
 import sys
 import re
 
+import asset_file
+import blob_file
+
+# The number of vertices that the vertex cache is assumed to hold. Most
+# hardware holds at least this many.
+VERTEX_CACHE_SIZE = 16
+
+# The largest number of triangles in a cluster.
+CLUSTER_TRIANGLES = 64
+
+
+def optimize_vertex_cache(indices, num_vertices, cache_size):
+    """Reorders the triangles in |indices| with Tipsify
+    (Sander, Nehab and Barczak, 2007), so that vertices are reused while
+    they are still in a FIFO cache of |cache_size| entries."""
+    num_triangles = len(indices) // 3
+    vertex_triangles = [[] for _ in range(num_vertices)]
+    for triangle in range(num_triangles):
+        for index in indices[triangle * 3:triangle * 3 + 3]:
+            vertex_triangles[index].append(triangle)
+    live = [len(triangles) for triangles in vertex_triangles]
+    cache_time = [-cache_size - 1] * num_vertices
+    emitted = [False] * num_triangles
+    dead_end = []
+    output = []
+    time = 0
+    cursor = 0
+    fanning = 0
+    while fanning >= 0:
+        candidates = []
+        for triangle in vertex_triangles[fanning]:
+            if emitted[triangle]:
+                continue
+            emitted[triangle] = True
+            for index in indices[triangle * 3:triangle * 3 + 3]:
+                output.append(index)
+                dead_end.append(index)
+                candidates.append(index)
+                live[index] -= 1
+                if time - cache_time[index] > cache_size:
+                    cache_time[index] = time
+                    time += 1
+
+        # Prefer the candidate that is still in the cache, and will stay in
+        # it while its remaining triangles are emitted, that entered the
+        # cache earliest.
+        fanning = -1
+        best_priority = -1
+        for index in candidates:
+            if live[index] <= 0:
+                continue
+            priority = 0
+            if time - cache_time[index] + 2 * live[index] <= cache_size:
+                priority = time - cache_time[index]
+            if priority > best_priority:
+                best_priority = priority
+                fanning = index
+        if fanning >= 0:
+            continue
+        while dead_end:
+            index = dead_end.pop()
+            if live[index] > 0:
+                fanning = index
+                break
+        if fanning >= 0:
+            continue
+        while cursor < num_vertices:
+            if live[cursor] > 0:
+                fanning = cursor
+                break
+            cursor += 1
+    return output
+
+
+def optimize_vertex_fetch(vertices, indices):
+    """Reorders |vertices| in the order that |indices| first uses them, so
+    that vertex fetches walk through memory linearly. Returns the new
+    vertices and indices."""
+    remap = [-1] * len(vertices)
+    new_vertices = []
+    new_indices = []
+    for index in indices:
+        if remap[index] < 0:
+            remap[index] = len(new_vertices)
+            new_vertices.append(vertices[index])
+        new_indices.append(remap[index])
+    # Vertices that are never used are kept, at the end.
+    for index, vertex in enumerate(vertices):
+        if remap[index] < 0:
+            new_vertices.append(vertex)
+    return new_vertices, new_indices
+
+
+def build_clusters(vertices, indices, cluster_triangles):
+    """Splits the triangles in |indices| into runs of up to
+    |cluster_triangles| triangles. Returns a list of
+    (bounds, first_index, index_count) where bounds is the center, radius,
+    cone axis and cone cutoff of the cluster."""
+    clusters = []
+    for first_index in range(0, len(indices), cluster_triangles * 3):
+        cluster_indices = indices[first_index:
+                                  first_index + cluster_triangles * 3]
+        points = [vertices[index][0] for index in cluster_indices]
+        low = [min(point[axis] for point in points) for axis in range(3)]
+        high = [max(point[axis] for point in points) for axis in range(3)]
+        center = [(low[axis] + high[axis]) * 0.5 for axis in range(3)]
+        radius = max(math.sqrt(sum((point[axis] - center[axis]) ** 2
+                                   for axis in range(3)))
+                     for point in points)
+
+        # The normal of a triangle is the average of its vertex normals,
+        # so that it points the same way as the shading normals.
+        normals = []
+        for triangle in range(0, len(cluster_indices), 3):
+            normal = [sum(vertices[index][2][axis]
+                          for index in cluster_indices[triangle:triangle + 3])
+                      for axis in range(3)]
+            length = math.sqrt(sum(value * value for value in normal))
+            if length > 0:
+                normals.append([value / length for value in normal])
+        axis = [sum(normal[i] for normal in normals) for i in range(3)]
+        length = math.sqrt(sum(value * value for value in axis))
+        cutoff = 2.0
+        if normals and length > 1e-6:
+            axis = [value / length for value in axis]
+            min_dot = min(sum(normal[i] * axis[i] for i in range(3))
+                          for normal in normals)
+            if min_dot > 0:
+                # The cone is back-facing once the view direction is within
+                # 90 degrees minus the cone angle of the axis.
+                cutoff = math.sqrt(1.0 - min_dot * min_dot)
+        else:
+            axis = [0.0, 0.0, 1.0]
+        clusters.append((center + [radius] + axis + [cutoff], first_index,
+                         len(cluster_indices)))
+    return clusters
+
 
 def main():
     parser = argparse.ArgumentParser(
@@ -46,9 +213,28 @@ def main():
         '-o', default="", help='output filename (Defaults to input.obj.h)')
     parser.add_argument(
         '--verbose', action='store_true', help='enable verbose output')
+    parser.add_argument(
+        '--binary', action='store_true',
+        help='write a binary asset file (Defaults to input.obj.vtaf)')
+    parser.add_argument(
+        '--compress', action='store_true',
+        help='run-length encode the sections of a binary asset file')
+    parser.add_argument(
+        '--gpu-compress', action='store_true',
+        help='chunked LZ4 encode the vertices and indices of a binary asset '
+        'file, to be decoded on the GPU')
+    parser.add_argument(
+        '--no-optimize', action='store_true',
+        help='keep the vertices and triangles in the order of the .obj file')
+    parser.add_argument(
+        '--blob', action='store_true',
+        help='embed the data of the header from a binary blob')
+    parser.add_argument(
+        '--pointer-size', type=int, default=8,
+        help='the size of size_t on the target, for --blob')
     args = parser.parse_args()
     if not args.o:
-        args.o = args.obj + ".h"
+        args.o = args.obj + (".vtaf" if args.binary else ".h")
 
     positions = []
     tex_coords = []
@@ -131,15 +317,61 @@ def main():
                         else:
                             vertices.append(cfv)
                             indices.append(len(vertices) - 1)
+        if not args.no_optimize:
+            indices = optimize_vertex_cache(indices, len(vertices),
+                                            VERTEX_CACHE_SIZE)
+            vertices, indices = optimize_vertex_fetch(vertices, indices)
+        index_type = 'uint16_t' if len(vertices) <= 65536 else 'uint32_t'
+        if args.binary:
+            vertex_data = bytearray()
+            for element in range(3):
+                for vertex in vertices:
+                    vertex_data.extend(
+                        struct.pack('<' + 'f' * len(vertex[element]),
+                                    *vertex[element]))
+            if index_type == 'uint16_t':
+                index_tag = asset_file.INDEX_DATA_16
+                index_data = struct.pack('<' + 'H' * len(indices), *indices)
+            else:
+                index_tag = asset_file.INDEX_DATA
+                index_data = struct.pack('<' + 'I' * len(indices), *indices)
+            asset_file.write_asset_file(
+                args.o, [(asset_file.VERTEX_DATA, vertex_data),
+                         (index_tag, index_data)], args.compress,
+                args.gpu_compress)
+            return 0
+        num_vertices = len(vertices)
+        clusters = build_clusters(vertices, indices, CLUSTER_TRIANGLES)
+        members = (
+            "    size_t num_vertices;\n" +
+            "    float positions[" + str(num_vertices * 3) + "];\n" +
+            "    float uv[" + str(num_vertices * 2) + "];\n" +
+            "    float normals[" + str(num_vertices * 3) + "];\n" +
+            "    size_t num_indices;\n" +
+            "    " + index_type + " indices[" + str(len(indices)) + "];\n" +
+            "    size_t num_clusters;\n" +
+            "    float cluster_bounds[" + str(len(clusters) * 8) + "];\n" +
+            "    uint32_t cluster_ranges[" + str(len(clusters) * 2) + "];\n")
+        if args.blob:
+            blob = blob_file.BlobWriter(args.pointer_size)
+            blob.size_t(num_vertices)
+            for element in range(3):
+                blob.array('f', [value for vertex in vertices
+                                 for value in vertex[element]])
+            blob.size_t(len(indices))
+            blob.array('H' if index_type == 'uint16_t' else 'I', indices)
+            blob.size_t(len(clusters))
+            blob.array('f', [value for bounds, _, _ in clusters
+                             for value in bounds])
+            blob.array('I', [value for _, first_index, index_count in clusters
+                             for value in (first_index, index_count)])
+            with open(args.o, "w") as f:
+                blob_file.write_blob(f, args.o, "model", members,
+                                     blob.finish())
+            return 0
         with open(args.o, "w") as f:
-            num_vertices = len(vertices)
             f.write("const struct {\n")
-            f.write("    size_t num_vertices;\n")
-            f.write("    float positions[" + str(num_vertices * 3) + "];\n")
-            f.write("    float uv[" + str(num_vertices * 2) + "];\n")
-            f.write("    float normals[" + str(num_vertices * 3) + "];\n")
-            f.write("    size_t num_indices;\n")
-            f.write("    uint32_t indices[" + str(len(indices)) + "];\n")
+            f.write(members)
             f.write("} model = {\n")
             f.write(str(len(vertices)) + ",\n")
             f.write("/*positions*/      {")
@@ -176,6 +408,15 @@ def main():
                     f.write(", ")
                 f.write(str(index))
                 first_element = False
+            f.write("},\n")
+            f.write(str(len(clusters)) + ",\n")
+            f.write("/*cluster_bounds*/ {")
+            f.write(", ".join(", ".join(str(value) + "f" for value in bounds)
+                              for bounds, _, _ in clusters))
+            f.write("},\n")
+            f.write("/*cluster_ranges*/ {")
+            f.write(", ".join(str(first_index) + ", " + str(index_count)
+                              for _, first_index, index_count in clusters))
             f.write("}\n")
             f.write("};\n")
             f.write("#ifndef _WIN32\n")
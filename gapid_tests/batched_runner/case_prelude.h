@@ -0,0 +1,50 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPID_TESTS_BATCHED_RUNNER_CASE_PRELUDE_H_
+#define GAPID_TESTS_BATCHED_RUNNER_CASE_PRELUDE_H_
+
+// gapid_batched_tests includes the sources of every test inside a namespace
+// of its own, so that the tests keep their main_entry, shader arrays and
+// helper functions apart. Every header that a test includes has to be
+// included here first, outside of that namespace, so that its include guard
+// turns the include inside the namespace into nothing. A test that
+// includes a header that is not here fails to compile in the runner only.
+
+#include "gapid_tests/batched_runner/test_application.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/known_device_infos.h"
+#include "vulkan_helpers/structs.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/instance_wrapper.h"
+#include "vulkan_wrapper/library_wrapper.h"
+#include "vulkan_wrapper/queue_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#endif  // GAPID_TESTS_BATCHED_RUNNER_CASE_PRELUDE_H_
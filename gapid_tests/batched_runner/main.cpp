@@ -0,0 +1,140 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gapid_tests/batched_runner/test_application.h"
+#include "gapid_tests/batched_runner/test_cases.h"
+#include "support/entry/entry.h"
+#include "support/log/log.h"
+#include "support/trace/trace.h"
+#include "vulkan_wrapper/library_wrapper.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Returns true if |name| contains one of the colon separated |filters|, or
+// if there are no filters. Sample options are separated by commas already.
+bool MatchesFilters(const char* name, const char* filters) {
+  if (!filters || !*filters) {
+    return true;
+  }
+  const std::string all_filters(filters);
+  size_t begin = 0;
+  while (begin <= all_filters.size()) {
+    size_t end = all_filters.find(':', begin);
+    if (end == std::string::npos) {
+      end = all_filters.size();
+    }
+    const std::string filter = all_filters.substr(begin, end - begin);
+    if (!filter.empty() && strstr(name, filter.c_str())) {
+      return true;
+    }
+    begin = end + 1;
+  }
+  return false;
+}
+
+struct CaseResult {
+  const char* name;
+  int return_value;
+  double milliseconds;
+  bool shared;
+};
+
+}  // anonymous namespace
+
+// Runs the gapid tests one after the other in this process.
+//   -sample-option=cases=<a>:<b>   only runs the tests whose names contain
+//                                  one of the filters.
+//   -sample-option=share_device=0  gives every test its own device, even the
+//                                  ones that use TestApplication.
+//   -sample-option=results=<file>  writes the result and duration of every
+//                                  test to <file>, as CSV.
+// Returns 0 if every test returned 0.
+int main_entry(const entry::EntryData* data) {
+  logging::Logger* log = data->logger();
+  log->LogInfo("Application Startup");
+
+  // Every test loads the Vulkan library, keeping it loaded here means that it
+  // is only loaded once, and the tests only pay for their instances.
+  vulkan::LibraryWrapper library(data->allocator(), log, data->null_driver());
+
+  const char* share_device = data->sample_option("share_device");
+  gapid_tests::SharedApplication& shared = gapid_tests::shared_application();
+  shared.enabled = !share_device || strcmp(share_device, "0") != 0;
+
+  const char* filters = data->sample_option("cases");
+  std::vector<CaseResult> results;
+  uint32_t num_failed = 0;
+  for (size_t i = 0; i < gapid_tests::kNumTestCases; ++i) {
+    const gapid_tests::TestCase& test_case = gapid_tests::kTestCases[i];
+    if (!MatchesFilters(test_case.name, filters)) {
+      continue;
+    }
+    // Do not modify this line, scripts may look for it in the output. If a
+    // test crashes, the last one of these is the test that crashed.
+    log->LogInfo("CASE: ", test_case.name);
+    const uint64_t num_shared_uses = shared.num_uses;
+    const int64_t begin_ns = trace::NowNanoseconds();
+    int return_value = 0;
+    {
+      trace::Zone zone(test_case.name);
+      return_value = test_case.main_entry(data);
+    }
+    const bool shared_used = shared.num_uses != num_shared_uses;
+    if (shared_used) {
+      // Nothing that this test submitted may still run during the next.
+      shared.application->device()->vkDeviceWaitIdle(
+          shared.application->device());
+    }
+    const double milliseconds =
+        static_cast<double>(trace::NowNanoseconds() - begin_ns) / 1.0e6;
+    if (return_value != 0 && shared_used) {
+      // The test may have left the device in any state, the next test gets
+      // a new one.
+      shared.application.reset();
+    }
+    if (return_value != 0) {
+      ++num_failed;
+    }
+    // Do not modify this line, scripts may look for it in the output.
+    log->LogInfo("CASE RETURN: ", test_case.name, " ", return_value, " ",
+                 milliseconds, "ms");
+    results.push_back(
+        CaseResult{test_case.name, return_value, milliseconds, shared_used});
+  }
+  shared.application.reset();
+  shared.enabled = false;
+
+  const char* results_file = data->sample_option("results");
+  if (results_file) {
+    std::ofstream out_file(results_file);
+    out_file << "name,return_value,milliseconds,shared_device\n";
+    for (const CaseResult& result : results) {
+      out_file << result.name << "," << result.return_value << ","
+               << result.milliseconds << "," << (result.shared ? 1 : 0)
+               << "\n";
+    }
+    LOG_ASSERT(==, log, false, out_file.bad());
+    log->LogInfo("Wrote test results to \"", results_file, "\"");
+  }
+
+  log->LogInfo("Ran ", results.size(), " tests, ", num_failed, " failed");
+  log->LogInfo("Application Shutdown");
+  return num_failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,82 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPID_TESTS_BATCHED_RUNNER_TEST_APPLICATION_H_
+#define GAPID_TESTS_BATCHED_RUNNER_TEST_APPLICATION_H_
+
+#include "support/containers/unique_ptr.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+
+namespace gapid_tests {
+
+// The application that gapid_batched_tests shares between the tests that
+// use TestApplication. While |enabled| is false, every TestApplication
+// creates its own.
+struct SharedApplication {
+  bool enabled = false;
+  containers::unique_ptr<vulkan::VulkanApplication> application;
+  // The number of TestApplications that used |application| so far.
+  uint64_t num_uses = 0;
+};
+
+inline SharedApplication& shared_application() {
+  static SharedApplication shared;
+  return shared;
+}
+
+// A test that only creates objects on the device and destroys them again
+// before it returns may use a TestApplication instead of a
+// VulkanApplication of its own, e.g.
+//   gapid_tests::TestApplication test_application(data);
+//   vulkan::VulkanApplication& application = *test_application;
+// As its own executable the test is unchanged, it gets a VulkanApplication
+// with the default arguments. In gapid_batched_tests, it gets the instance
+// and device that every such test shares instead, so a trace of the batched
+// run does not have the calls that create them.
+class TestApplication {
+ public:
+  explicit TestApplication(const entry::EntryData* data) {
+    SharedApplication& shared = shared_application();
+    if (!shared.enabled) {
+      owned_application_ = containers::make_unique<vulkan::VulkanApplication>(
+          data->allocator(), data->allocator(), data->logger(), data);
+      application_ = owned_application_.get();
+      return;
+    }
+    if (!shared.application) {
+      shared.application = containers::make_unique<vulkan::VulkanApplication>(
+          data->allocator(), data->allocator(), data->logger(), data);
+    }
+    application_ = shared.application.get();
+    ++shared.num_uses;
+  }
+
+  TestApplication(const TestApplication&) = delete;
+  TestApplication& operator=(const TestApplication&) = delete;
+
+  vulkan::VulkanApplication& operator*() const { return *application_; }
+  vulkan::VulkanApplication* operator->() const { return application_; }
+
+ private:
+  vulkan::VulkanApplication* application_;
+  containers::unique_ptr<vulkan::VulkanApplication> owned_application_;
+};
+
+}  // namespace gapid_tests
+
+#endif  // GAPID_TESTS_BATCHED_RUNNER_TEST_APPLICATION_H_
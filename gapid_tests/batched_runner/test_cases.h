@@ -0,0 +1,41 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPID_TESTS_BATCHED_RUNNER_TEST_CASES_H_
+#define GAPID_TESTS_BATCHED_RUNNER_TEST_CASES_H_
+
+#include <cstddef>
+
+namespace entry {
+class EntryData;
+}
+
+namespace gapid_tests {
+
+// One gapid test, linked into gapid_batched_tests. |main_entry| is the
+// main_entry of the test.
+struct TestCase {
+  const char* name;
+  int (*main_entry)(const entry::EntryData* data);
+};
+
+// Every test that add_gapid_test added, in the order that it added them.
+// These are generated by gapid_tests/batched_runner/CMakeLists.txt.
+extern const TestCase kTestCases[];
+extern const size_t kNumTestCases;
+
+}  // namespace gapid_tests
+
+#endif  // GAPID_TESTS_BATCHED_RUNNER_TEST_CASES_H_
@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "gapid_tests/batched_runner/test_application.h"
 #include "support/entry/entry.h"
 #include "support/log/log.h"
 #include "vulkan_helpers/vulkan_application.h"
@@ -22,8 +23,8 @@
 int main_entry(const entry::EntryData* data) {
   data->logger()->LogInfo("Application Startup");
 
-  vulkan::VulkanApplication application(data->allocator(), data->logger(),
-                                        data);
+  gapid_tests::TestApplication test_application(data);
+  vulkan::VulkanApplication& application = *test_application;
   {
     // Fill a buffer first with data: 0x12345678, size: VK_WHOLE_SIZE and
     // offset: 0, then fill it again with data: 0xabcdabcd, size: 256 and
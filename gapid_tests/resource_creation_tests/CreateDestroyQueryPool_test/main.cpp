@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "gapid_tests/batched_runner/test_application.h"
 #include "support/entry/entry.h"
 #include "support/log/log.h"
 #include "vulkan_helpers/helper_functions.h"
@@ -21,8 +22,8 @@
 
 int main_entry(const entry::EntryData* data) {
   data->logger()->LogInfo("Application Startup");
-  vulkan::VulkanApplication application(data->allocator(), data->logger(),
-                                        data);
+  gapid_tests::TestApplication test_application(data);
+  vulkan::VulkanApplication& application = *test_application;
 
   {
     // 1. A query pool with queryCount of value 1, queryType of value
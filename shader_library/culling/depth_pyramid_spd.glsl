@@ -0,0 +1,222 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Builds a whole min/max depth pyramid in one dispatch. Every workgroup
+// reduces a 64x64 tile of the depth image to the first kLevelsPerGroup
+// levels, and the last workgroup to finish reduces the rest. Every texel of
+// a level holds the nearest and the farthest depth, in r and g, of the 2x2
+// texels that it covers in the level before. The size of a level is rounded
+// up, so the last texels of an odd sized level cover just one column or
+// row.
+//
+// Shaders that include this define reduce_levels() to combine the level 1
+// texels of a workgroup to level kLevelsPerGroup - 1.
+
+// These must match DepthPyramid in vulkan_helpers/depth_pyramid.h.
+layout (local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+const uint kMaxLevels = 13;
+const uint kLevelsPerGroup = 6;
+
+layout (binding = 0, set = 0) uniform sampler2D source;
+
+// Every level of the pyramid. The levels that the pyramid does not have are
+// bound to its last one.
+layout (binding = 1, set = 0, rg32f) coherent uniform image2D
+    levels[kMaxLevels];
+
+// The number of workgroups that are done with their tile. The last one to
+// finish sets it to 0 again.
+layout (binding = 2, set = 0, std430) coherent buffer counter_data {
+    uint counter;
+};
+
+layout (push_constant) uniform pyramid_data {
+    ivec2 source_size;
+    uint num_levels;
+    uint num_groups;
+};
+
+// The value of a texel that covers nothing.
+const vec2 kEmpty = vec2(3.402823e38, -3.402823e38);
+
+vec2 combine(vec2 a, vec2 b) {
+    return vec2(min(a.x, b.x), max(a.y, b.y));
+}
+
+ivec2 level_size(uint level) {
+    ivec2 size = (source_size + ivec2(1)) / 2;
+    for (uint i = 0u; i < level; ++i) {
+        size = max((size + ivec2(1)) / 2, ivec2(1));
+    }
+    return size;
+}
+
+// Storage images can only be indexed with constants without the
+// shaderStorageImageArrayDynamicIndexing feature.
+void store_level(uint level, ivec2 texel, vec2 value) {
+    vec4 data = vec4(value, 0.0, 0.0);
+    switch (level) {
+        case 0: imageStore(levels[0], texel, data); break;
+        case 1: imageStore(levels[1], texel, data); break;
+        case 2: imageStore(levels[2], texel, data); break;
+        case 3: imageStore(levels[3], texel, data); break;
+        case 4: imageStore(levels[4], texel, data); break;
+        case 5: imageStore(levels[5], texel, data); break;
+        case 6: imageStore(levels[6], texel, data); break;
+        case 7: imageStore(levels[7], texel, data); break;
+        case 8: imageStore(levels[8], texel, data); break;
+        case 9: imageStore(levels[9], texel, data); break;
+        case 10: imageStore(levels[10], texel, data); break;
+        case 11: imageStore(levels[11], texel, data); break;
+        case 12: imageStore(levels[12], texel, data); break;
+    }
+}
+
+vec2 load_level(uint level, ivec2 texel) {
+    switch (level) {
+        case 0: return imageLoad(levels[0], texel).rg;
+        case 1: return imageLoad(levels[1], texel).rg;
+        case 2: return imageLoad(levels[2], texel).rg;
+        case 3: return imageLoad(levels[3], texel).rg;
+        case 4: return imageLoad(levels[4], texel).rg;
+        case 5: return imageLoad(levels[5], texel).rg;
+        case 6: return imageLoad(levels[6], texel).rg;
+        case 7: return imageLoad(levels[7], texel).rg;
+        case 8: return imageLoad(levels[8], texel).rg;
+        case 9: return imageLoad(levels[9], texel).rg;
+        case 10: return imageLoad(levels[10], texel).rg;
+        case 11: return imageLoad(levels[11], texel).rg;
+        case 12: return imageLoad(levels[12], texel).rg;
+    }
+    return kEmpty;
+}
+
+// Stores |value| as the texel of |level| at |texel|, if the pyramid has it.
+void store_if_inside(uint level, ivec2 texel, vec2 value) {
+    if (level < num_levels &&
+        all(lessThan(texel, level_size(level)))) {
+        store_level(level, texel, value);
+    }
+}
+
+// The invocations of a workgroup are laid out in Morton order over the
+// 16x16 level 1 texels of its tile, so that every 4^n consecutive
+// invocations cover a square of level 1 texels, which is one texel of
+// level n + 1.
+uvec2 morton_position(uint index) {
+    uvec2 position = uvec2(index, index >> 1) & uvec2(0x55u);
+    position = (position | (position >> 1)) & uvec2(0x33u);
+    position = (position | (position >> 2)) & uvec2(0x0fu);
+    return position;
+}
+
+// The texel of |level| that the cluster of invocations starting at |index|
+// writes, for clusters of 4^(level - 1) invocations.
+ivec2 cluster_texel(uint level, uint index) {
+    uint tile = 32u >> level;
+    return ivec2(gl_WorkGroupID.xy * tile +
+                 morton_position(index >> (2u * (level - 1u))));
+}
+
+shared vec2 partials[gl_WorkGroupSize.x];
+shared bool is_last_group;
+
+// Combines the texels of |first_level| - 1 in partials, one in every
+// 4^(first_level - 2) invocations, up to level kLevelsPerGroup - 1.
+void reduce_in_shared_memory(uint first_level) {
+    uint index = gl_LocalInvocationIndex;
+    for (uint level = first_level; level < kLevelsPerGroup; ++level) {
+        uint stride = 1u << (2u * (level - 2u));
+        if (index % (stride * 4u) == 0u) {
+            vec2 value = combine(
+                combine(partials[index], partials[index + stride]),
+                combine(partials[index + 2u * stride],
+                        partials[index + 3u * stride]));
+            partials[index] = value;
+            store_if_inside(level, cluster_texel(level, index), value);
+        }
+        barrier();
+    }
+}
+
+void reduce_levels(vec2 value);
+
+void main() {
+    uint index = gl_LocalInvocationIndex;
+    ivec2 texel1 = ivec2(gl_WorkGroupID.xy * 16u + morton_position(index));
+    ivec2 size0 = level_size(0u);
+    ivec2 last = source_size - ivec2(1);
+
+    // Every invocation reduces 4x4 depth texels to 2x2 texels of level 0,
+    // and those to one texel of level 1.
+    vec2 value = kEmpty;
+    for (int y = 0; y < 2; ++y) {
+        for (int x = 0; x < 2; ++x) {
+            ivec2 texel0 = texel1 * 2 + ivec2(x, y);
+            if (any(greaterThanEqual(texel0, size0))) {
+                continue;
+            }
+            ivec2 base = texel0 * 2;
+            float d0 = texelFetch(source, min(base, last), 0).r;
+            float d1 = texelFetch(source, min(base + ivec2(1, 0), last), 0).r;
+            float d2 = texelFetch(source, min(base + ivec2(0, 1), last), 0).r;
+            float d3 = texelFetch(source, min(base + ivec2(1, 1), last), 0).r;
+            vec2 texel_value = vec2(min(min(d0, d1), min(d2, d3)),
+                                    max(max(d0, d1), max(d2, d3)));
+            store_level(0u, texel0, texel_value);
+            value = combine(value, texel_value);
+        }
+    }
+    store_if_inside(1u, texel1, value);
+    reduce_levels(value);
+
+    if (num_levels <= kLevelsPerGroup) {
+        return;
+    }
+    // The last workgroup reads the tiles of all the others.
+    memoryBarrierImage();
+    barrier();
+    if (index == 0u) {
+        is_last_group = atomicAdd(counter, 1u) == num_groups - 1u;
+    }
+    barrier();
+    if (!is_last_group) {
+        return;
+    }
+    for (uint level = kLevelsPerGroup; level < num_levels; ++level) {
+        ivec2 size = level_size(level);
+        ivec2 previous_last = level_size(level - 1u) - ivec2(1);
+        for (uint i = index; i < uint(size.x * size.y);
+             i += gl_WorkGroupSize.x) {
+            ivec2 texel = ivec2(i % uint(size.x), i / uint(size.x));
+            ivec2 base = texel * 2;
+            vec2 texel_value = combine(
+                combine(load_level(level - 1u, min(base, previous_last)),
+                        load_level(level - 1u,
+                                   min(base + ivec2(1, 0), previous_last))),
+                combine(load_level(level - 1u,
+                                   min(base + ivec2(0, 1), previous_last)),
+                        load_level(level - 1u,
+                                   min(base + ivec2(1, 1), previous_last))));
+            store_level(level, texel, texel_value);
+        }
+        memoryBarrierImage();
+        barrier();
+    }
+    if (index == 0u) {
+        counter = 0u;
+    }
+}
@@ -0,0 +1,73 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Lets the workgroups of a dispatch that vulkan::DispatchBatch recorded
+// find the small dispatch that they belong to. The includer defines
+// DISPATCH_BATCH_BINDING before it includes this file. The dispatch of
+// every workgroup is bound there in set 0, and the small dispatches at the
+// binding after it.
+//
+// The batch is rounded up to a 2D dispatch, so a shader returns early where
+// batch_group_valid() is false, before it reads anything else of the batch.
+
+// This must match DispatchBatch::Dispatch in
+// vulkan_helpers/dispatch_batch.h.
+struct batched_dispatch {
+    // The first workgroup of the dispatch in the batch.
+    uint first_group;
+    uint group_count;
+    // The parameters that the dispatch was added with.
+    uint param0;
+    uint param1;
+};
+
+layout (binding = DISPATCH_BATCH_BINDING, set = 0, std430)
+    readonly buffer dispatch_batch_groups {
+    uint batch_group_dispatches[];
+};
+
+layout (binding = DISPATCH_BATCH_BINDING + 1, set = 0, std430)
+    readonly buffer dispatch_batch_dispatches {
+    uint batch_num_groups;
+    uint batch_padding[3];
+    batched_dispatch batch_dispatches[];
+};
+
+// Returns the index of this workgroup in the whole batch.
+uint batch_group_index() {
+    return gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+}
+
+// Returns false for the workgroups that only round the batch up.
+bool batch_group_valid() {
+    return batch_group_index() < batch_num_groups;
+}
+
+// Returns the index of the small dispatch of this workgroup, in the order
+// in which they were added to the batch.
+uint batch_dispatch_index() {
+    return batch_group_dispatches[batch_group_index()];
+}
+
+// Returns the small dispatch of this workgroup.
+batched_dispatch batch_dispatch() {
+    return batch_dispatches[batch_dispatch_index()];
+}
+
+// Returns the index of this workgroup in its small dispatch, which is what
+// gl_WorkGroupID.x would be if it had been dispatched on its own.
+uint batch_group_id() {
+    return batch_group_index() - batch_dispatch().first_group;
+}
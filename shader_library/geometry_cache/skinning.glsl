@@ -0,0 +1,35 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Linear blend skinning with up to 4 joints for every vertex. The includer
+// defines JOINT_BINDING, the binding of the joint matrices in set 0, before
+// it includes this file.
+
+// This must match GeometryCache::kMaxJoints in
+// vulkan_helpers/geometry_cache.h.
+#define MAX_JOINTS 32
+
+layout (binding = JOINT_BINDING, set = 0) uniform joint_data {
+    layout(column_major) mat4x4 joints[MAX_JOINTS];
+};
+
+// Returns the matrix that moves a vertex with |joint_indices| and
+// |weights| from bind space to its animated place.
+mat4x4 skin_matrix(uvec4 joint_indices, vec4 weights) {
+    return joints[joint_indices.x] * weights.x +
+           joints[joint_indices.y] * weights.y +
+           joints[joint_indices.z] * weights.z +
+           joints[joint_indices.w] * weights.w;
+}
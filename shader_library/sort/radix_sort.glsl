@@ -0,0 +1,62 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A stable LSD radix sort of 32-bit keys with 32-bit values, 8 bits per
+// pass. Every pass counts the digits of every tile of kTileSize keys, see
+// radix_sort_count.comp, turns the counts into the offset of every tile in
+// every bucket, see radix_sort_scan.comp, and moves every key and its value
+// to its offset, in the order in which the keys were, see
+// radix_sort_scatter.glsl. vulkan::RadixSort in vulkan_helpers/radix_sort.h
+// records the passes.
+
+// These must match RadixSort.
+layout (local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+const uint kNumBuckets = 256;
+const uint kKeysPerInvocation = 4;
+const uint kTileSize = 256 * kKeysPerInvocation;
+
+layout (binding = 0, set = 0, std430) readonly buffer keys_in_data {
+    uint keys_in[];
+};
+
+layout (binding = 1, set = 0, std430) readonly buffer values_in_data {
+    uint values_in[];
+};
+
+layout (binding = 2, set = 0, std430) writeonly buffer keys_out_data {
+    uint keys_out[];
+};
+
+layout (binding = 3, set = 0, std430) writeonly buffer values_out_data {
+    uint values_out[];
+};
+
+// The number of keys of every bucket in every tile, tile by tile. The scan
+// turns them into the offset of every tile in its bucket, and appends the
+// offset of every bucket.
+layout (binding = 4, set = 0, std430) buffer counts_data {
+    uint counts[];
+};
+
+layout (push_constant) uniform sort_data {
+    uint num_keys;
+    // The lowest bit of the digit of this pass.
+    uint shift;
+    uint num_tiles;
+};
+
+uint digit(uint key) {
+    return (key >> shift) & (kNumBuckets - 1u);
+}
@@ -0,0 +1,58 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Every workgroup moves the keys of its tile to their buckets, in rounds of
+// one key per invocation. Shaders that include this define, after
+// sort/radix_sort.glsl:
+//   uint round_slot();
+// which returns the key of the round that this invocation takes, and
+//   uint rank_in_round(uint key_digit, bool valid);
+// which returns how many of the valid keys of the round that are in slots
+// before this one have the same digit. Every invocation calls it in every
+// round, and only the ranks of valid keys are used.
+
+// Where the next key of every bucket goes, and how many keys of every
+// bucket the current round has.
+shared uint bucket_offsets[kNumBuckets];
+shared uint round_counts[kNumBuckets];
+
+void main() {
+    uint bucket = gl_LocalInvocationID.x;
+    bucket_offsets[bucket] = counts[num_tiles * kNumBuckets + bucket] +
+                             counts[gl_WorkGroupID.x * kNumBuckets + bucket];
+    round_counts[bucket] = 0u;
+    barrier();
+    uint first = gl_WorkGroupID.x * kTileSize;
+    for (uint i = 0; i < kKeysPerInvocation; ++i) {
+        uint index = first + i * gl_WorkGroupSize.x + round_slot();
+        bool valid = index < num_keys;
+        uint key = valid ? keys_in[index] : 0u;
+        uint key_digit = digit(key);
+        uint rank = rank_in_round(key_digit, valid);
+        if (valid) {
+            atomicAdd(round_counts[key_digit], 1u);
+        }
+        barrier();
+        if (valid) {
+            uint destination = bucket_offsets[key_digit] + rank;
+            keys_out[destination] = key;
+            values_out[destination] = values_in[index];
+        }
+        barrier();
+        bucket_offsets[bucket] += round_counts[bucket];
+        round_counts[bucket] = 0u;
+        barrier();
+    }
+}
@@ -34,6 +34,8 @@ struct Allocator {
   T* construct(Args&&... args) {
     // We assume that the maximum natural alignment for anything
     // is 16 bytes. This will handle all SSE types.
+    static_assert(alignof(T) <= 16,
+                  "Over-aligned types have to come from a PoolAllocator.");
     T* t =
         reinterpret_cast<T*>(16 + static_cast<char*>(malloc(sizeof(T) + 16)));
     size_t* s = reinterpret_cast<size_t*>(reinterpret_cast<char*>(t) - 16);
@@ -0,0 +1,125 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_AUDIT_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_AUDIT_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define AUDIT_ALLOCATOR_BACKTRACE
+#endif
+
+namespace containers {
+
+// AuditAllocator forwards every allocation to another allocator, and counts
+// them. While it is capturing, it also keeps the call stacks of the first
+// allocations, so that code which allocates when it should not can be found.
+// Capturing a stack does not allocate from any Allocator. Stacks are only
+// captured where execinfo.h is available, elsewhere only the address that
+// malloc() returns to is kept.
+class AuditAllocator : public Allocator {
+ public:
+  static const size_t kMaxCapturedAllocations = 8;
+  static const size_t kMaxCapturedFrames = 16;
+
+  struct CapturedAllocation {
+    size_t size;
+    size_t num_frames;
+    void* frames[kMaxCapturedFrames];
+  };
+
+  explicit AuditAllocator(Allocator* parent)
+      : parent_(parent),
+        num_allocations_(0),
+        capturing_(false),
+        num_captured_(0) {
+    for (size_t i = 0; i < kMaxCapturedAllocations; ++i) {
+      captured_ready_[i].store(false);
+    }
+  }
+
+  void* malloc(size_t size) override {
+    num_allocations_.fetch_add(1, std::memory_order_relaxed);
+    if (capturing_.load(std::memory_order_relaxed)) {
+      Capture(size);
+    }
+    return parent_->malloc(size);
+  }
+
+  void free(void* memory, size_t size) override { parent_->free(memory, size); }
+
+  // The allocations so far, from every thread.
+  uint64_t num_allocations() const {
+    return num_allocations_.load(std::memory_order_relaxed);
+  }
+
+  // Starts or stops keeping the call stacks of allocations.
+  void set_capturing(bool capturing) {
+    capturing_.store(capturing, std::memory_order_relaxed);
+  }
+
+  // Copies the first allocations that were captured since the last call to
+  // |captured|, which has room for kMaxCapturedAllocations, and returns how
+  // many were copied. Allocations that are still being captured by another
+  // thread are skipped.
+  size_t TakeCaptured(CapturedAllocation* captured) {
+    const size_t num_captured = num_captured_.exchange(0);
+    size_t num_copied = 0;
+    for (size_t i = 0; i < kMaxCapturedAllocations && i < num_captured; ++i) {
+      if (captured_ready_[i].exchange(false, std::memory_order_acquire)) {
+        captured[num_copied++] = captured_[i];
+      }
+    }
+    return num_copied;
+  }
+
+ private:
+  void Capture(size_t size) {
+    const size_t index = num_captured_.fetch_add(1);
+    if (index >= kMaxCapturedAllocations) {
+      return;
+    }
+    CapturedAllocation& captured = captured_[index];
+    captured.size = size;
+#if defined(AUDIT_ALLOCATOR_BACKTRACE)
+    const int num_frames =
+        backtrace(captured.frames, static_cast<int>(kMaxCapturedFrames));
+    captured.num_frames = num_frames > 0 ? static_cast<size_t>(num_frames) : 0;
+#elif defined(__GNUC__)
+    captured.frames[0] = __builtin_return_address(0);
+    captured.num_frames = 1;
+#else
+    captured.num_frames = 0;
+#endif
+    captured_ready_[index].store(true, std::memory_order_release);
+  }
+
+  Allocator* parent_;
+  std::atomic<uint64_t> num_allocations_;
+  std::atomic<bool> capturing_;
+  std::atomic<size_t> num_captured_;
+  CapturedAllocation captured_[kMaxCapturedAllocations];
+  std::atomic<bool> captured_ready_[kMaxCapturedAllocations];
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_AUDIT_ALLOCATOR_H_
@@ -0,0 +1,321 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_FLAT_HASH_MAP_H_
+#define SUPPORT_CONTAINERS_FLAT_HASH_MAP_H_
+
+#include <assert.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <tuple>
+#include <utility>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// flat_hash_map is a hash map that keeps its elements in one array, instead
+// of one allocation per element like containers::unordered_map, so a lookup
+// only touches a few neighbouring slots. Collisions are resolved by linear
+// probing, the hash is spread over the slots by Fibonacci hashing, so
+// std::hash for integers, which is often the identity, works well. The
+// array is grown to keep it at most 7/8 full, and erasing shifts the
+// following elements back instead of leaving tombstones.
+//
+// Unlike std::unordered_map, inserting may move every element, and erasing
+// may move the elements after the erased one, which invalidates iterators
+// and pointers to them. Elements are std::pair<Key, T>.
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class flat_hash_map {
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+
+  template <typename Map, typename Value>
+  class iterator_base {
+   public:
+    iterator_base() : map_(nullptr), index_(0) {}
+    // Allows an iterator to be converted to a const_iterator.
+    template <typename OtherMap, typename OtherValue>
+    iterator_base(const iterator_base<OtherMap, OtherValue>& other)
+        : map_(other.map_), index_(other.index_) {}
+
+    Value& operator*() const { return map_->slots_[index_]; }
+    Value* operator->() const { return &map_->slots_[index_]; }
+
+    iterator_base& operator++() {
+      index_ = map_->NextOccupied(index_ + 1);
+      return *this;
+    }
+
+    bool operator==(const iterator_base& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const iterator_base& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    friend class flat_hash_map;
+    template <typename, typename>
+    friend class iterator_base;
+    iterator_base(Map* map, size_t index) : map_(map), index_(index) {}
+
+    Map* map_;
+    size_t index_;
+  };
+
+  using iterator = iterator_base<flat_hash_map, value_type>;
+  using const_iterator = iterator_base<const flat_hash_map, const value_type>;
+
+  explicit flat_hash_map(Allocator* allocator)
+      : allocator_(allocator),
+        slots_(nullptr),
+        occupied_(nullptr),
+        capacity_(0),
+        size_(0),
+        shift_(64) {}
+
+  flat_hash_map(flat_hash_map&& other)
+      : allocator_(other.allocator_),
+        slots_(other.slots_),
+        occupied_(other.occupied_),
+        capacity_(other.capacity_),
+        size_(other.size_),
+        shift_(other.shift_) {
+    other.slots_ = nullptr;
+    other.occupied_ = nullptr;
+    other.capacity_ = 0;
+    other.size_ = 0;
+    other.shift_ = 64;
+  }
+
+  ~flat_hash_map() {
+    clear();
+    Release();
+  }
+
+  flat_hash_map(const flat_hash_map&) = delete;
+  flat_hash_map& operator=(const flat_hash_map&) = delete;
+
+  iterator begin() { return iterator(this, NextOccupied(0)); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator begin() const {
+    return const_iterator(this, NextOccupied(0));
+  }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator find(const Key& key) { return iterator(this, Find(key)); }
+  const_iterator find(const Key& key) const {
+    return const_iterator(this, Find(key));
+  }
+  size_t count(const Key& key) const { return Find(key) != capacity_; }
+
+  // Constructs the value from |args| if |key| is not in the map yet.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+    size_t index = Find(key);
+    if (index != capacity_) {
+      return std::make_pair(iterator(this, index), false);
+    }
+    if ((size_ + 1) * 8 > capacity_ * 7) {
+      Rehash(capacity_ == 0 ? kMinCapacity : capacity_ * 2);
+    }
+    index = Probe(key);
+    ::new (static_cast<void*>(&slots_[index]))
+        value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                   std::forward_as_tuple(std::forward<Args>(args)...));
+    occupied_[index] = true;
+    ++size_;
+    return std::make_pair(iterator(this, index), true);
+  }
+
+  T& operator[](const Key& key) { return emplace(key).first->second; }
+
+  // |key| must be in the map, otherwise this crashes.
+  T& at(const Key& key) { return slots_[FindExisting(key)].second; }
+  const T& at(const Key& key) const {
+    return slots_[FindExisting(key)].second;
+  }
+
+  // Unlike std::unordered_map, this does not return the next iterator, since
+  // a later element may have moved into the erased slot.
+  void erase(const_iterator it) { EraseIndex(it.index_); }
+
+  size_t erase(const Key& key) {
+    const size_t index = Find(key);
+    if (index == capacity_) {
+      return 0;
+    }
+    EraseIndex(index);
+    return 1;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (occupied_[i]) {
+        slots_[i].~value_type();
+        occupied_[i] = false;
+      }
+    }
+    size_ = 0;
+  }
+
+  // Makes room for |size| elements without growing.
+  void reserve(size_t size) {
+    size_t capacity = capacity_ == 0 ? kMinCapacity : capacity_;
+    while (size * 8 > capacity * 7) {
+      capacity *= 2;
+    }
+    if (capacity != capacity_) {
+      Rehash(capacity);
+    }
+  }
+
+ private:
+  static const size_t kMinCapacity = 8;
+
+  // The slot that |key| would be in, if nothing collided with it.
+  size_t IdealIndex(const Key& key) const {
+    return static_cast<size_t>(
+        (static_cast<uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ull) >>
+        shift_);
+  }
+
+  // Returns the slot of |key|, or capacity_ if it is not in the map.
+  size_t Find(const Key& key) const {
+    if (size_ == 0) {
+      return capacity_;
+    }
+    const size_t mask = capacity_ - 1;
+    for (size_t i = IdealIndex(key);; i = (i + 1) & mask) {
+      if (!occupied_[i]) {
+        return capacity_;
+      }
+      if (KeyEqual()(slots_[i].first, key)) {
+        return i;
+      }
+    }
+  }
+
+  // Like Find, but crashes instead of returning capacity_ if |key| is not in
+  // the map, even in release builds.
+  size_t FindExisting(const Key& key) const {
+    const size_t index = Find(key);
+    assert(index != capacity_ && "flat_hash_map::at() of a missing key");
+    if (index == capacity_) {
+      std::abort();
+    }
+    return index;
+  }
+
+  // Returns the first free slot for |key|, which is not in the map.
+  size_t Probe(const Key& key) const {
+    const size_t mask = capacity_ - 1;
+    size_t i = IdealIndex(key);
+    while (occupied_[i]) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  size_t NextOccupied(size_t index) const {
+    while (index < capacity_ && !occupied_[index]) {
+      ++index;
+    }
+    return index;
+  }
+
+  void EraseIndex(size_t index) {
+    const size_t mask = capacity_ - 1;
+    slots_[index].~value_type();
+    // Moves back every following element that would otherwise no longer be
+    // found from its ideal slot, until a free slot ends the run.
+    size_t hole = index;
+    for (size_t i = (hole + 1) & mask; occupied_[i]; i = (i + 1) & mask) {
+      const size_t ideal = IdealIndex(slots_[i].first);
+      // The element can fill the hole if its ideal slot is not in the
+      // circular range (hole, i].
+      if (((i - ideal) & mask) >= ((i - hole) & mask)) {
+        ::new (static_cast<void*>(&slots_[hole]))
+            value_type(std::move(slots_[i]));
+        slots_[i].~value_type();
+        hole = i;
+      }
+    }
+    occupied_[hole] = false;
+    --size_;
+  }
+
+  void Rehash(size_t capacity) {
+    value_type* old_slots = slots_;
+    bool* old_occupied = occupied_;
+    const size_t old_capacity = capacity_;
+
+    slots_ = static_cast<value_type*>(
+        allocator_->malloc(sizeof(value_type) * capacity));
+    occupied_ = static_cast<bool*>(allocator_->malloc(sizeof(bool) * capacity));
+    for (size_t i = 0; i < capacity; ++i) {
+      occupied_[i] = false;
+    }
+    capacity_ = capacity;
+    shift_ = 64;
+    for (size_t c = capacity; c > 1; c /= 2) {
+      --shift_;
+    }
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (old_occupied[i]) {
+        const size_t index = Probe(old_slots[i].first);
+        ::new (static_cast<void*>(&slots_[index]))
+            value_type(std::move(old_slots[i]));
+        occupied_[index] = true;
+        old_slots[i].~value_type();
+      }
+    }
+    if (old_slots) {
+      allocator_->free(old_slots, sizeof(value_type) * old_capacity);
+      allocator_->free(old_occupied, sizeof(bool) * old_capacity);
+    }
+  }
+
+  void Release() {
+    if (slots_) {
+      allocator_->free(slots_, sizeof(value_type) * capacity_);
+      allocator_->free(occupied_, sizeof(bool) * capacity_);
+    }
+  }
+
+  Allocator* allocator_;
+  value_type* slots_;
+  bool* occupied_;
+  size_t capacity_;
+  size_t size_;
+  // 64 - log2(capacity_), so that the top bits of the hash pick the slot.
+  uint32_t shift_;
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_FLAT_HASH_MAP_H_
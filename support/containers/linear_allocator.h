@@ -0,0 +1,118 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_LINEAR_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_LINEAR_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// LinearAllocator hands out memory from one block by bumping an offset, and
+// takes it all back at once in Reset(). Freeing memory from the block does
+// nothing, unless it was the last allocation. Allocations that do not fit
+// into the block come from the fallback allocator instead, and are freed to
+// it. Reset() grows the block to fit everything that was allocated since the
+// last Reset(), so that only the first uses overflow.
+//
+// This is meant for temporaries that only live for one frame, everything
+// that was allocated from the block must be gone when Reset() is called.
+// It is not thread safe.
+struct LinearAllocator : public Allocator {
+  LinearAllocator(Allocator* fallback, size_t capacity)
+      : fallback_(fallback),
+        block_(nullptr),
+        capacity_(0),
+        offset_(0),
+        requested_(0),
+        num_overflows_(0) {
+    Grow(capacity);
+  }
+
+  ~LinearAllocator() {
+    if (block_) {
+      fallback_->free(block_, capacity_);
+    }
+  }
+
+  LinearAllocator(const LinearAllocator&) = delete;
+  LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+  void* malloc(size_t size) override {
+    size = Align(size);
+    requested_ += size;
+    if (size <= capacity_ - offset_) {
+      void* memory = block_ + offset_;
+      offset_ += size;
+      return memory;
+    }
+    ++num_overflows_;
+    return fallback_->malloc(size);
+  }
+
+  void free(void* memory, size_t size) override {
+    char* c = static_cast<char*>(memory);
+    size = Align(size);
+    if (c >= block_ && c < block_ + capacity_) {
+      // The last allocation can simply be handed out again.
+      if (c + size == block_ + offset_) {
+        offset_ -= size;
+      }
+      return;
+    }
+    fallback_->free(memory, size);
+  }
+
+  // Takes back all of the memory of the block.
+  void Reset() {
+    if (requested_ > capacity_) {
+      Grow(requested_);
+    }
+    offset_ = 0;
+    requested_ = 0;
+  }
+
+  size_t capacity() const { return capacity_; }
+  // The number of allocations that did not fit into the block.
+  uint64_t num_overflows() const { return num_overflows_; }
+
+ private:
+  // Everything is aligned to 16 bytes, like Allocator::construct expects.
+  static size_t Align(size_t size) { return (size + 15) & ~size_t(15); }
+
+  void Grow(size_t capacity) {
+    if (block_) {
+      fallback_->free(block_, capacity_);
+    }
+    capacity_ = Align(capacity);
+    block_ = static_cast<char*>(fallback_->malloc(capacity_));
+  }
+
+  Allocator* fallback_;
+  char* block_;
+  size_t capacity_;
+  size_t offset_;
+  // The bytes that were asked for since the last Reset, including the ones
+  // that overflowed.
+  size_t requested_;
+  uint64_t num_overflows_;
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_LINEAR_ALLOCATOR_H_
@@ -0,0 +1,149 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_MPMC_QUEUE_H_
+#define SUPPORT_CONTAINERS_MPMC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// mpmc_queue is a bounded lock-free ring buffer that any number of threads
+// can push to and pop from. Every slot has a sequence number that says
+// whether it is ready to be written or read in the current lap around the
+// ring, so a thread only ever has to win a compare and swap on the index,
+// and never waits for another one. try_push fails when the queue is full,
+// and try_pop when it is empty. The capacity is rounded up to a power of
+// two.
+template <typename T>
+class mpmc_queue {
+ public:
+  mpmc_queue(Allocator* allocator, size_t capacity)
+      : allocator_(allocator),
+        capacity_(RoundUp(capacity)),
+        mask_(capacity_ - 1),
+        cells_(static_cast<Cell*>(
+            allocator_->malloc(sizeof(Cell) * capacity_))) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      ::new (static_cast<void*>(&cells_[i].sequence)) std::atomic<size_t>(i);
+    }
+    enqueue_position_.store(0, std::memory_order_relaxed);
+    dequeue_position_.store(0, std::memory_order_relaxed);
+  }
+
+  ~mpmc_queue() {
+    T value;
+    while (try_pop(&value)) {
+    }
+    allocator_->free(cells_, sizeof(Cell) * capacity_);
+  }
+
+  mpmc_queue(const mpmc_queue&) = delete;
+  mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+  // Returns false if the queue is full.
+  template <typename U>
+  bool try_push(U&& value) {
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    ::new (static_cast<void*>(&cell->storage)) T(std::forward<U>(value));
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest element to |value|, and returns false if the queue is
+  // empty.
+  bool try_pop(T* value) {
+    size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence) -
+                                  static_cast<intptr_t>(position + 1);
+      if (difference == 0) {
+        if (dequeue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = dequeue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    T* element = reinterpret_cast<T*>(&cell->storage);
+    *value = std::move(*element);
+    element->~T();
+    // The slot can be written again in the next lap.
+    cell->sequence.store(position + capacity_, std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+  // Keeps the indices that producers and consumers write on separate cache
+  // lines.
+  static const size_t kCacheLineSize = 64;
+
+  static size_t RoundUp(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+      rounded *= 2;
+    }
+    return rounded;
+  }
+
+  Allocator* allocator_;
+  const size_t capacity_;
+  const size_t mask_;
+  Cell* cells_;
+  char padding0_[kCacheLineSize];
+  std::atomic<size_t> enqueue_position_;
+  char padding1_[kCacheLineSize];
+  std::atomic<size_t> dequeue_position_;
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_MPMC_QUEUE_H_
@@ -0,0 +1,171 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_POOL_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_POOL_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// PoolAllocator serves small allocations from power of two size classes,
+// which are carved out of larger chunks from the parent allocator. Since
+// free() is told the size, the size class does not have to be stored with
+// the memory, so a pooled block has no header at all. Allocations that are
+// larger than the largest size class go straight to the parent.
+//
+// A block of size class s is aligned to the smaller of s and kMaxAlignment,
+// so memory for any T with alignof(T) <= kMaxAlignment is aligned correctly
+// when sizeof(T) bytes are asked for, e.g. by containers::make_unique.
+// construct() and destroy() hide the ones of Allocator, and do not add a
+// header either.
+//
+// Freed blocks are kept for the next allocation of their size class, chunks
+// are only given back to the parent when the pool is destroyed. This is
+// thread safe.
+class PoolAllocator : public Allocator {
+ public:
+  // The size classes are kMinBlockSize << i.
+  static const size_t kNumSizeClasses = 7;
+  static const size_t kMinBlockSize = 16;
+  static const size_t kMaxBlockSize = kMinBlockSize << (kNumSizeClasses - 1);
+  static const size_t kMaxAlignment = 64;
+  static const size_t kChunkSize = 16 * 1024;
+
+  PoolAllocator(Allocator* parent) : parent_(parent), chunks_(nullptr) {
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+      free_lists_[i] = nullptr;
+    }
+  }
+
+  ~PoolAllocator() {
+    while (chunks_) {
+      Chunk* next = chunks_->next;
+      parent_->free(chunks_->base, kChunkAllocationSize);
+      chunks_ = next;
+    }
+  }
+
+  PoolAllocator(const PoolAllocator&) = delete;
+  PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+  void* malloc(size_t size) override {
+    const int32_t size_class = GetSizeClass(size);
+    if (size_class < 0) {
+      return parent_->malloc(size);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_lists_[size_class]) {
+      Refill(size_class);
+    }
+    Block* block = free_lists_[size_class];
+    free_lists_[size_class] = block->next;
+    return block;
+  }
+
+  void free(void* memory, size_t size) override {
+    const int32_t size_class = GetSizeClass(size);
+    if (size_class < 0) {
+      parent_->free(memory, size);
+      return;
+    }
+    Block* block = static_cast<Block*>(memory);
+    std::lock_guard<std::mutex> lock(mutex_);
+    block->next = free_lists_[size_class];
+    free_lists_[size_class] = block;
+  }
+
+  // Constructs one T from this pool, while passing down args to the
+  // constructor. Unlike Allocator::construct, this takes alignof(T) into
+  // account, and does not put a header in front of the object.
+  template <typename T, typename... Args>
+  T* construct(Args&&... args) {
+    static_assert(alignof(T) <= kMaxAlignment,
+                  "The type is aligned more than the pool supports.");
+    return ::new (malloc(sizeof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // Destroys a T that was constructed by construct(). |t| has to be of the
+  // exact type that was constructed.
+  template <typename T>
+  void destroy(T* t) {
+    t->~T();
+    free(t, sizeof(T));
+  }
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  // The chunk bookkeeping lives in the padding in front of the aligned
+  // memory.
+  struct Chunk {
+    void* base;
+    Chunk* next;
+  };
+  static const size_t kChunkAllocationSize =
+      kChunkSize + sizeof(Chunk) + kMaxAlignment - 1;
+
+  // Returns the smallest size class that fits |size|, or -1 if none does.
+  static int32_t GetSizeClass(size_t size) {
+    size_t class_size = kMinBlockSize;
+    for (int32_t i = 0; i < static_cast<int32_t>(kNumSizeClasses); ++i) {
+      if (size <= class_size) {
+        return i;
+      }
+      class_size *= 2;
+    }
+    return -1;
+  }
+
+  // Splits a new chunk into blocks of |size_class|. mutex_ has to be held.
+  void Refill(int32_t size_class) {
+    char* base = static_cast<char*>(parent_->malloc(kChunkAllocationSize));
+    char* memory = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(base) + sizeof(Chunk) + kMaxAlignment -
+         1) &
+        ~static_cast<uintptr_t>(kMaxAlignment - 1));
+    Chunk* chunk = reinterpret_cast<Chunk*>(memory - sizeof(Chunk));
+    chunk->base = base;
+    chunk->next = chunks_;
+    chunks_ = chunk;
+
+    const size_t block_size = kMinBlockSize << size_class;
+    // Push the blocks in reverse, so that they are handed out in order.
+    for (size_t offset = kChunkSize; offset >= block_size;
+         offset -= block_size) {
+      Block* block = reinterpret_cast<Block*>(memory + offset - block_size);
+      block->next = free_lists_[size_class];
+      free_lists_[size_class] = block;
+    }
+  }
+
+  Allocator* parent_;
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  Chunk* chunks_;
+  Block* free_lists_[kNumSizeClasses];
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_POOL_ALLOCATOR_H_
@@ -0,0 +1,247 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_SMALL_VECTOR_H_
+#define SUPPORT_CONTAINERS_SMALL_VECTOR_H_
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// small_vector is a vector that keeps up to N elements inline, and only
+// allocates from its allocator once it grows beyond that. It is meant for
+// the short arrays that are handed to Vulkan calls, e.g. the semaphores of a
+// submission, or the pool sizes of a descriptor set, which almost never
+// have more than a few elements.
+//
+// Unlike containers::vector, moving a small_vector moves its elements when
+// they are inline, so pointers into it do not stay valid.
+template <typename T, size_t N>
+class small_vector {
+ public:
+  using value_type = T;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  explicit small_vector(Allocator* allocator)
+      : allocator_(allocator),
+        data_(inline_data()),
+        size_(0),
+        capacity_(N) {}
+
+  small_vector(std::initializer_list<T> values, Allocator* allocator)
+      : small_vector(allocator) {
+    append(values.begin(), values.end());
+  }
+
+  small_vector(size_t count, const T& value, Allocator* allocator)
+      : small_vector(allocator) {
+    resize(count, value);
+  }
+
+  template <typename It, typename = typename std::enable_if<
+                             !std::is_integral<It>::value>::type>
+  small_vector(It first, It last, Allocator* allocator)
+      : small_vector(allocator) {
+    append(first, last);
+  }
+
+  small_vector(const small_vector& other) : small_vector(other.allocator_) {
+    append(other.begin(), other.end());
+  }
+
+  small_vector(small_vector&& other) : small_vector(other.allocator_) {
+    take(&other);
+  }
+
+  ~small_vector() {
+    clear();
+    release();
+  }
+
+  small_vector& operator=(const small_vector& other) {
+    if (this != &other) {
+      clear();
+      append(other.begin(), other.end());
+    }
+    return *this;
+  }
+
+  small_vector& operator=(small_vector&& other) {
+    if (this != &other) {
+      clear();
+      release();
+      data_ = inline_data();
+      capacity_ = N;
+      allocator_ = other.allocator_;
+      take(&other);
+    }
+    return *this;
+  }
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  T& operator[](size_t i) { return data_[i]; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  T& front() { return data_[0]; }
+  const T& front() const { return data_[0]; }
+  T& back() { return data_[size_ - 1]; }
+  const T& back() const { return data_[size_ - 1]; }
+
+  void push_back(const T& value) {
+    if (size_ == capacity_) {
+      // |value| may be one of the elements that are about to move.
+      T copy(value);
+      grow(size_ + 1);
+      ::new (static_cast<void*>(data_ + size_)) T(std::move(copy));
+    } else {
+      ::new (static_cast<void*>(data_ + size_)) T(value);
+    }
+    ++size_;
+  }
+
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+      T value(std::forward<Args>(args)...);
+      grow(size_ + 1);
+      ::new (static_cast<void*>(data_ + size_)) T(std::move(value));
+    } else {
+      ::new (static_cast<void*>(data_ + size_)) T(std::forward<Args>(args)...);
+    }
+    return data_[size_++];
+  }
+
+  void pop_back() { data_[--size_].~T(); }
+
+  void clear() {
+    for (size_t i = 0; i < size_; ++i) {
+      data_[i].~T();
+    }
+    size_ = 0;
+  }
+
+  void reserve(size_t capacity) {
+    if (capacity > capacity_) {
+      grow(capacity);
+    }
+  }
+
+  void resize(size_t size) {
+    reserve(size);
+    while (size_ > size) {
+      pop_back();
+    }
+    for (; size_ < size; ++size_) {
+      ::new (static_cast<void*>(data_ + size_)) T();
+    }
+  }
+
+  void resize(size_t size, const T& value) {
+    reserve(size);
+    while (size_ > size) {
+      pop_back();
+    }
+    for (; size_ < size; ++size_) {
+      ::new (static_cast<void*>(data_ + size_)) T(value);
+    }
+  }
+
+  template <typename It>
+  void append(It first, It last) {
+    reserve(size_ + std::distance(first, last));
+    for (; first != last; ++first, ++size_) {
+      ::new (static_cast<void*>(data_ + size_)) T(*first);
+    }
+  }
+
+ private:
+  using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  T* inline_data() { return reinterpret_cast<T*>(inline_); }
+  bool is_inline() const {
+    return data_ == reinterpret_cast<const T*>(inline_);
+  }
+
+  // Moves the elements to an allocation that fits at least |capacity|.
+  void grow(size_t capacity) {
+    if (capacity < capacity_ * 2) {
+      capacity = capacity_ * 2;
+    }
+    T* data = static_cast<T*>(allocator_->malloc(sizeof(T) * capacity));
+    for (size_t i = 0; i < size_; ++i) {
+      ::new (static_cast<void*>(data + i)) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+    release();
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  // Gives back the allocation, if there is one. The elements have to be
+  // destroyed or moved already.
+  void release() {
+    if (!is_inline()) {
+      allocator_->free(data_, sizeof(T) * capacity_);
+    }
+  }
+
+  // Takes the elements of |other|, which is left empty. This has to be
+  // empty and inline.
+  void take(small_vector* other) {
+    if (other->is_inline()) {
+      for (size_t i = 0; i < other->size_; ++i) {
+        ::new (static_cast<void*>(data_ + i)) T(std::move(other->data_[i]));
+      }
+      size_ = other->size_;
+      other->clear();
+      return;
+    }
+    data_ = other->data_;
+    size_ = other->size_;
+    capacity_ = other->capacity_;
+    other->data_ = other->inline_data();
+    other->size_ = 0;
+    other->capacity_ = N;
+  }
+
+  Allocator* allocator_;
+  T* data_;
+  size_t size_;
+  size_t capacity_;
+  Storage inline_[N];
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_SMALL_VECTOR_H_
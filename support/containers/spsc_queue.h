@@ -0,0 +1,131 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_SPSC_QUEUE_H_
+#define SUPPORT_CONTAINERS_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// spsc_queue is a bounded lock-free ring buffer for exactly one thread that
+// pushes, and one thread that pops. Neither of them ever waits for the
+// other, try_push fails when the queue is full, and try_pop when it is
+// empty. The capacity is rounded up to a power of two.
+template <typename T>
+class spsc_queue {
+ public:
+  spsc_queue(Allocator* allocator, size_t capacity)
+      : allocator_(allocator),
+        capacity_(RoundUp(capacity)),
+        mask_(capacity_ - 1),
+        slots_(static_cast<Slot*>(
+            allocator_->malloc(sizeof(Slot) * capacity_))),
+        cached_tail_(0),
+        cached_head_(0) {
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+
+  ~spsc_queue() {
+    T value;
+    while (try_pop(&value)) {
+    }
+    allocator_->free(slots_, sizeof(Slot) * capacity_);
+  }
+
+  spsc_queue(const spsc_queue&) = delete;
+  spsc_queue& operator=(const spsc_queue&) = delete;
+
+  // Only called by the producer. Returns false if the queue is full.
+  template <typename U>
+  bool try_push(U&& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == capacity_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == capacity_) {
+        return false;
+      }
+    }
+    ::new (static_cast<void*>(&slots_[tail & mask_])) T(std::forward<U>(value));
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only called by the consumer. Returns the oldest element without
+  // removing it, or nullptr if the queue is empty.
+  T* peek() {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return nullptr;
+      }
+    }
+    return reinterpret_cast<T*>(&slots_[head & mask_]);
+  }
+
+  // Only called by the consumer. Moves the oldest element to |value|, and
+  // returns false if the queue is empty.
+  bool try_pop(T* value) {
+    T* front = peek();
+    if (!front) {
+      return false;
+    }
+    *value = std::move(*front);
+    front->~T();
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+  // Keeps the indices that the two threads write on separate cache lines.
+  static const size_t kCacheLineSize = 64;
+
+  static size_t RoundUp(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+      rounded *= 2;
+    }
+    return rounded;
+  }
+
+  Allocator* allocator_;
+  const size_t capacity_;
+  const size_t mask_;
+  Slot* slots_;
+  char padding0_[kCacheLineSize];
+  // Written by the consumer.
+  std::atomic<size_t> head_;
+  size_t cached_tail_;
+  char padding1_[kCacheLineSize];
+  // Written by the producer.
+  std::atomic<size_t> tail_;
+  size_t cached_head_;
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_SPSC_QUEUE_H_
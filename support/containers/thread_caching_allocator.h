@@ -0,0 +1,377 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_THREAD_CACHING_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_THREAD_CACHING_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// ThreadCachingAllocator is a root allocator that tracks the same numbers as
+// LeakCheckAllocator, without any thread touching memory that another thread
+// writes on the hot path. Small allocations come from size class free lists
+// that every thread keeps for itself, and are carved out of larger chunks.
+// A thread only takes the shared lock when one of its free lists runs empty
+// or grows too long. Every thread counts its own allocations, and the counts
+// are only added up when they are asked for.
+//
+// Memory may be freed by a different thread than the one that allocated it.
+// Chunks are only given back to the system when the allocator is destroyed.
+// Every thread caches for at most one ThreadCachingAllocator at a time, the
+// others fall back to the shared lock on that thread.
+class ThreadCachingAllocator : public Allocator {
+ public:
+  // The size classes are kMinBlockSize << i.
+  static const size_t kNumSizeClasses = 8;
+  static const size_t kMinBlockSize = 16;
+  static const size_t kChunkSize = 64 * 1024;
+  // The most free blocks that a thread keeps in one size class, and how
+  // many it moves to or from the shared lists at once.
+  static const size_t kMaxCachedBlocks = 256;
+  static const size_t kBatchSize = 32;
+
+  ThreadCachingAllocator()
+      : chunks_(nullptr),
+        chunk_offset_(kChunkSize),
+        caches_(nullptr),
+        retired_allocated_bytes_(0),
+        retired_freed_bytes_(0),
+        retired_allocations_(0) {
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+      shared_free_lists_[i] = nullptr;
+    }
+  }
+
+  ~ThreadCachingAllocator() {
+    {
+      std::lock_guard<std::mutex> lock(CacheMutex());
+      for (ThreadCache* cache = caches_; cache; cache = cache->next) {
+        // The blocks in the cache belong to the chunks that are freed below.
+        // The thread picks the cache up again for the next allocator.
+        cache->owner = nullptr;
+        cache->Clear();
+      }
+    }
+    while (chunks_) {
+      Block* next = chunks_->next;
+      ::free(chunks_);
+      chunks_ = next;
+    }
+  }
+
+  ThreadCachingAllocator(const ThreadCachingAllocator&) = delete;
+  ThreadCachingAllocator& operator=(const ThreadCachingAllocator&) = delete;
+
+  void* malloc(size_t size) override {
+    ThreadCache* cache = GetCache();
+    const int32_t size_class = GetSizeClass(size);
+    if (!cache) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_allocated_bytes_ += size;
+        retired_allocations_ += 1;
+      }
+      return size_class < 0 ? ::malloc(size) : AllocateShared(size_class);
+    }
+    cache->Count(&cache->allocated_bytes, size);
+    cache->Count(&cache->num_allocations, 1);
+    if (size_class < 0) {
+      return ::malloc(size);
+    }
+    Block* block = cache->free_lists[size_class];
+    if (!block) {
+      Refill(cache, size_class);
+      block = cache->free_lists[size_class];
+    }
+    cache->free_lists[size_class] = block->next;
+    --cache->num_free[size_class];
+    return block;
+  }
+
+  void free(void* memory, size_t size) override {
+    ThreadCache* cache = GetCache();
+    const int32_t size_class = GetSizeClass(size);
+    if (!cache) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_freed_bytes_ += size;
+      }
+      if (size_class < 0) {
+        ::free(memory);
+      } else {
+        FreeShared(static_cast<Block*>(memory), size_class);
+      }
+      return;
+    }
+    cache->Count(&cache->freed_bytes, size);
+    if (size_class < 0) {
+      ::free(memory);
+      return;
+    }
+    Block* block = static_cast<Block*>(memory);
+    block->next = cache->free_lists[size_class];
+    cache->free_lists[size_class] = block;
+    if (++cache->num_free[size_class] > kMaxCachedBlocks) {
+      Drain(cache, size_class, kBatchSize);
+    }
+  }
+
+  // These add up the counts of every thread, so they are not free, and they
+  // are not guaranteed to be in sync with each other while other threads
+  // allocate.
+  uint64_t currently_allocated_bytes() {
+    uint64_t allocated_bytes;
+    uint64_t freed_bytes;
+    uint64_t num_allocations;
+    GetTotals(&allocated_bytes, &freed_bytes, &num_allocations);
+    return allocated_bytes - freed_bytes;
+  }
+  uint64_t total_allocated_bytes() {
+    uint64_t allocated_bytes;
+    uint64_t freed_bytes;
+    uint64_t num_allocations;
+    GetTotals(&allocated_bytes, &freed_bytes, &num_allocations);
+    return allocated_bytes;
+  }
+  uint64_t total_number_of_allocations() {
+    uint64_t allocated_bytes;
+    uint64_t freed_bytes;
+    uint64_t num_allocations;
+    GetTotals(&allocated_bytes, &freed_bytes, &num_allocations);
+    return num_allocations;
+  }
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  // The free lists and counts of one thread. Only that thread changes them,
+  // the counts are atomic so that other threads can add them up.
+  struct ThreadCache {
+    ThreadCache()
+        : owner(nullptr),
+          next(nullptr),
+          allocated_bytes(0),
+          freed_bytes(0),
+          num_allocations(0) {
+      Clear();
+    }
+
+    void Clear() {
+      for (size_t i = 0; i < kNumSizeClasses; ++i) {
+        free_lists[i] = nullptr;
+        num_free[i] = 0;
+      }
+    }
+
+    // Only this thread writes |counter|, so it does not need an atomic
+    // read-modify-write.
+    static void Count(std::atomic<uint64_t>* counter, uint64_t value) {
+      counter->store(counter->load(std::memory_order_relaxed) + value,
+                     std::memory_order_relaxed);
+    }
+
+    // Only changed with CacheMutex() held.
+    std::atomic<ThreadCachingAllocator*> owner;
+    ThreadCache* next;
+    Block* free_lists[kNumSizeClasses];
+    size_t num_free[kNumSizeClasses];
+    std::atomic<uint64_t> allocated_bytes;
+    std::atomic<uint64_t> freed_bytes;
+    std::atomic<uint64_t> num_allocations;
+  };
+
+  // Owns the cache of a thread, and hands it back to its allocator when the
+  // thread exits.
+  struct ThreadCacheHolder {
+    ThreadCacheHolder() : cache(nullptr) {}
+    ~ThreadCacheHolder() {
+      if (!cache) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(CacheMutex());
+        ThreadCachingAllocator* owner = cache->owner.load();
+        if (owner) {
+          owner->Retire(cache);
+        }
+      }
+      delete cache;
+    }
+    ThreadCache* cache;
+  };
+
+  // Guards the owner of every cache, and the list of caches of every
+  // allocator. It has to outlive the allocators and the threads.
+  static std::mutex& CacheMutex() {
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+  }
+
+  static int32_t GetSizeClass(size_t size) {
+    size_t block_size = kMinBlockSize;
+    for (int32_t i = 0; i < static_cast<int32_t>(kNumSizeClasses); ++i) {
+      if (size <= block_size) {
+        return i;
+      }
+      block_size *= 2;
+    }
+    return -1;
+  }
+
+  // Returns the cache of this thread, if it caches for this allocator.
+  ThreadCache* GetCache() {
+    static thread_local ThreadCacheHolder holder;
+    ThreadCache* cache = holder.cache;
+    if (cache && cache->owner.load(std::memory_order_relaxed) == this) {
+      return cache;
+    }
+    std::lock_guard<std::mutex> lock(CacheMutex());
+    if (!cache) {
+      holder.cache = cache = new ThreadCache();
+    }
+    if (cache->owner == this) {
+      return cache;
+    }
+    if (cache->owner) {
+      return nullptr;
+    }
+    cache->owner = this;
+    cache->allocated_bytes.store(0, std::memory_order_relaxed);
+    cache->freed_bytes.store(0, std::memory_order_relaxed);
+    cache->num_allocations.store(0, std::memory_order_relaxed);
+    cache->next = caches_;
+    caches_ = cache;
+    return cache;
+  }
+
+  // Takes the blocks and counts of a cache whose thread exits. CacheMutex()
+  // must be held.
+  void Retire(ThreadCache* cache) {
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+      Drain(cache, i, cache->num_free[i]);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      retired_allocated_bytes_ += cache->allocated_bytes.load();
+      retired_freed_bytes_ += cache->freed_bytes.load();
+      retired_allocations_ += cache->num_allocations.load();
+    }
+    for (ThreadCache** c = &caches_; *c; c = &(*c)->next) {
+      if (*c == cache) {
+        *c = cache->next;
+        break;
+      }
+    }
+    cache->owner = nullptr;
+  }
+
+  void GetTotals(uint64_t* allocated_bytes, uint64_t* freed_bytes,
+                 uint64_t* num_allocations) {
+    std::lock_guard<std::mutex> cache_lock(CacheMutex());
+    std::lock_guard<std::mutex> lock(mutex_);
+    *allocated_bytes = retired_allocated_bytes_;
+    *freed_bytes = retired_freed_bytes_;
+    *num_allocations = retired_allocations_;
+    for (ThreadCache* cache = caches_; cache; cache = cache->next) {
+      *allocated_bytes += cache->allocated_bytes.load();
+      *freed_bytes += cache->freed_bytes.load();
+      *num_allocations += cache->num_allocations.load();
+    }
+  }
+
+  // Moves up to kBatchSize blocks of |size_class| into the cache, from the
+  // shared free list or a chunk.
+  void Refill(ThreadCache* cache, size_t size_class) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < kBatchSize; ++i) {
+      Block* block = TakeShared(size_class);
+      block->next = cache->free_lists[size_class];
+      cache->free_lists[size_class] = block;
+      ++cache->num_free[size_class];
+    }
+  }
+
+  // Moves |count| blocks of |size_class| from the cache to the shared free
+  // list.
+  void Drain(ThreadCache* cache, size_t size_class, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < count; ++i) {
+      Block* block = cache->free_lists[size_class];
+      cache->free_lists[size_class] = block->next;
+      block->next = shared_free_lists_[size_class];
+      shared_free_lists_[size_class] = block;
+    }
+    cache->num_free[size_class] -= count;
+  }
+
+  void* AllocateShared(size_t size_class) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return TakeShared(size_class);
+  }
+
+  void FreeShared(Block* block, size_t size_class) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    block->next = shared_free_lists_[size_class];
+    shared_free_lists_[size_class] = block;
+  }
+
+  // Returns a block of |size_class|. mutex_ must be held.
+  Block* TakeShared(size_t size_class) {
+    Block* block = shared_free_lists_[size_class];
+    if (block) {
+      shared_free_lists_[size_class] = block->next;
+      return block;
+    }
+    const size_t block_size = kMinBlockSize << size_class;
+    if (chunk_offset_ + block_size > kChunkSize) {
+      // The first block of every chunk links the chunks together.
+      Block* chunk = static_cast<Block*>(::malloc(kChunkSize));
+      chunk->next = chunks_;
+      chunks_ = chunk;
+      chunk_offset_ = kMinBlockSize;
+    }
+    block = reinterpret_cast<Block*>(reinterpret_cast<char*>(chunks_) +
+                                     chunk_offset_);
+    chunk_offset_ += block_size;
+    return block;
+  }
+
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  Block* shared_free_lists_[kNumSizeClasses];
+  Block* chunks_;
+  // Where the next block is carved out of the newest chunk.
+  size_t chunk_offset_;
+  // Guarded by CacheMutex(), the caches of the threads that use this.
+  ThreadCache* caches_;
+  // Guarded by mutex_, the counts of the threads that exited, and of the
+  // allocations that were not cached.
+  uint64_t retired_allocated_bytes_;
+  uint64_t retired_freed_bytes_;
+  uint64_t retired_allocations_;
+};
+
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_THREAD_CACHING_ALLOCATOR_H_
@@ -18,17 +18,21 @@
 #include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <mutex>
 #include <thread>
 
+#include "support/containers/thread_caching_allocator.h"
 #include "support/entry/entry_config.h"
 #include "support/log/log.h"
 
 #if defined __ANDROID__
 #include <android/window.h>
 #include <android_native_app_glue.h>
+#include <dlfcn.h>
+#include <jni.h>
 #include <sys/system_properties.h>
 #include <unistd.h>
 #elif defined __linux__
@@ -50,7 +54,25 @@ EntryData::EntryData(containers::Allocator* allocator, uint32_t width,
                      bool separate_present, int64_t output_frame_index,
                      const char* output_frame_file, const char* shader_compiler,
                      bool validation, const char* load_pipeline_cache,
-                     const char* write_pipeline_cache
+                     const char* write_pipeline_cache,
+                     const char* write_memory_stats,
+                     const char* present_mode, uint32_t max_frame_latency,
+                     uint32_t swapchain_images, bool headless,
+                     uint32_t headless_frames,
+                     const char* stats_file, uint32_t benchmark_frames,
+                     uint32_t warmup_frames, const char* trace_file,
+                     const char* pipeline_cache_prefix, bool count_api_calls,
+                     bool driver_allocation_stats,
+                     const std::vector<std::string>& sample_options,
+                     uint32_t capture_first_frame, uint32_t capture_last_frame,
+                     bool capture_raw, const char* device_selection,
+                     const char* shader_stats, const char* record_session,
+                     const char* replay_session, const char* host_heap_size,
+                     const char* image_heap_size,
+                     const char* device_heap_size,
+                     const char* coherent_heap_size,
+                     const char* heap_sizes_from, bool null_driver,
+                     const char* fence_wait, uint32_t audit_allocations
 #if defined __ANDROID__
                      ,
                      android_app* app
@@ -64,15 +86,56 @@ EntryData::EntryData(containers::Allocator* allocator, uint32_t width,
       output_frame_file_(output_frame_file),
       shader_compiler_(shader_compiler),
       validation_(validation),
+      audit_allocations_(audit_allocations),
+      audit_allocator_(allocator),
       log_(logging::GetLogger(allocator)),
-      allocator_(allocator),
+      allocator_(audit_allocations != kAllocationAuditOff ? &audit_allocator_
+                                                          : allocator),
       load_pipeline_cache_(load_pipeline_cache ? load_pipeline_cache : ""),
-      write_pipeline_cache_(write_pipeline_cache ? write_pipeline_cache : "")
+      write_pipeline_cache_(write_pipeline_cache ? write_pipeline_cache : ""),
+      write_memory_stats_(write_memory_stats ? write_memory_stats : ""),
+      present_mode_(present_mode ? present_mode : ""),
+      max_frame_latency_(max_frame_latency),
+      swapchain_images_(swapchain_images),
+      headless_(headless),
+      headless_frames_(headless_frames),
+      stats_file_(stats_file ? stats_file : ""),
+      benchmark_frames_(benchmark_frames),
+      warmup_frames_(warmup_frames),
+      trace_file_(trace_file ? trace_file : ""),
+      pipeline_cache_prefix_(pipeline_cache_prefix ? pipeline_cache_prefix
+                                                   : ""),
+      count_api_calls_(count_api_calls),
+      driver_allocation_stats_(driver_allocation_stats),
+      sample_options_(sample_options),
+      capture_first_frame_(capture_first_frame),
+      capture_last_frame_(capture_last_frame),
+      capture_raw_(capture_raw),
+      device_selection_(device_selection ? device_selection : ""),
+      shader_stats_(shader_stats ? shader_stats : ""),
+      session_(record_session, replay_session, log_.get()),
+      host_heap_size_(host_heap_size ? host_heap_size : ""),
+      image_heap_size_(image_heap_size ? image_heap_size : ""),
+      device_heap_size_(device_heap_size ? device_heap_size : ""),
+      coherent_heap_size_(coherent_heap_size ? coherent_heap_size : ""),
+      heap_sizes_from_(heap_sizes_from ? heap_sizes_from : ""),
+      null_driver_(null_driver),
+      fence_wait_(fence_wait ? fence_wait : ""),
+#if defined __ANDROID__
+      thermal_headroom_target_(
+          static_cast<float>(ANDROID_THERMAL_HEADROOM_TARGET))
+#else
+      thermal_headroom_target_(0.0f)
+#endif
 #if defined __ANDROID__
       ,
       native_window_handle_(app->window),
       os_version_(""),
-      window_closing_(false)
+      window_closing_(false),
+      thermal_manager_(nullptr),
+      release_thermal_manager_(nullptr),
+      get_thermal_status_(nullptr),
+      get_thermal_headroom_(nullptr)
 #elif defined _WIN32
       ,
       native_hinstance_(0),
@@ -92,7 +155,82 @@ EntryData::EntryData(containers::Allocator* allocator, uint32_t width,
   int os_version_length =
       __system_property_get("ro.build.version.release", os_version_c_str);
   os_version_ = os_version_length != 0 ? os_version_c_str : "";
+
+  // libandroid is always loaded, this only finds it.
+  void* android_library = dlopen("libandroid.so", RTLD_NOW | RTLD_NOLOAD);
+  if (android_library) {
+    auto acquire_thermal_manager = reinterpret_cast<AThermalManager* (*)()>(
+        dlsym(android_library, "AThermal_acquireManager"));
+    release_thermal_manager_ = reinterpret_cast<void (*)(AThermalManager*)>(
+        dlsym(android_library, "AThermal_releaseManager"));
+    get_thermal_status_ = reinterpret_cast<int (*)(AThermalManager*)>(
+        dlsym(android_library, "AThermal_getCurrentThermalStatus"));
+    get_thermal_headroom_ = reinterpret_cast<float (*)(AThermalManager*, int)>(
+        dlsym(android_library, "AThermal_getThermalHeadroom"));
+    if (acquire_thermal_manager && release_thermal_manager_ &&
+        get_thermal_status_) {
+      thermal_manager_ = acquire_thermal_manager();
+    }
+    dlclose(android_library);
+  }
+#endif
+}
+
+const char* EntryData::sample_option(const char* name) const {
+  const size_t length = strlen(name);
+  for (auto it = sample_options_.rbegin(); it != sample_options_.rend(); ++it) {
+    if (it->compare(0, length, name) == 0 && it->size() > length &&
+        (*it)[length] == '=') {
+      return it->c_str() + length + 1;
+    }
+  }
+  return nullptr;
+}
+
+uint32_t EntryData::sample_option_uint(const char* name,
+                                       uint32_t default_value) const {
+  const char* option = sample_option(name);
+  if (!option) {
+    return default_value;
+  }
+  const uint32_t value = static_cast<uint32_t>(strtoul(option, nullptr, 10));
+  return value > 0 ? value : default_value;
+}
+
+bool ListHas(const char* list, const char* item) {
+  const size_t length = strlen(item);
+  while (list) {
+    const char* end = strchr(list, ',');
+    const size_t item_length = end ? end - list : strlen(list);
+    if (item_length == length && strncmp(list, item, length) == 0) {
+      return true;
+    }
+    list = end ? end + 1 : nullptr;
+  }
+  return false;
+}
+
+int32_t EntryData::thermal_status() const {
+#if defined __ANDROID__
+  if (thermal_manager_) {
+    return get_thermal_status_(thermal_manager_);
+  }
+#endif
+  return -1;
+}
+
+float EntryData::thermal_headroom(int32_t forecast_seconds) const {
+#if defined __ANDROID__
+  if (thermal_manager_ && get_thermal_headroom_) {
+    // It is NaN if the headroom could not be forecast, or if it was asked
+    // for too often.
+    const float headroom =
+        get_thermal_headroom_(thermal_manager_, forecast_seconds);
+    return headroom == headroom ? headroom : -1.0f;
+  }
 #endif
+  (void)forecast_seconds;
+  return -1.0f;
 }
 
 #ifdef __ggp__
@@ -102,8 +240,13 @@ static std::atomic<bool> k_stream_started(false);
 
 void EntryData::NotifyReady() const {}
 
-// Returns true when window is to be closed.
+// Returns true when window is to be closed, or when the session that is
+// replayed was.
 bool EntryData::WindowClosing() const {
+  return session_.Event("window_closing", PollWindowClosing());
+}
+
+bool EntryData::PollWindowClosing() const {
 #if defined __ANDROID__
   return window_closing_;
 #elif defined __ggp__
@@ -150,6 +293,38 @@ struct CommandLineArgs {
   bool validation;
   const char* load_pipeline_cache;
   const char* write_pipeline_cache;
+  const char* write_memory_stats;
+  const char* present_mode;
+  uint32_t max_frame_latency;
+  uint32_t swapchain_images;
+  bool headless;
+  uint32_t headless_frames;
+  const char* stats_file;
+  uint32_t benchmark_frames;
+  uint32_t warmup_frames;
+  const char* trace_file;
+  // <dir>/<application name>, if -pipeline-cache-dir was given.
+  std::string pipeline_cache_prefix;
+  bool count_api_calls;
+  bool driver_allocation_stats;
+  // Every -sample-option argument, as it was given.
+  std::vector<std::string> sample_options;
+  // The first and last frame of -output-frames, or 0 if it was not given.
+  uint32_t output_frames_first;
+  uint32_t output_frames_last;
+  bool output_raw;
+  const char* device_selection;
+  const char* shader_stats;
+  const char* record_session;
+  const char* replay_session;
+  const char* host_heap_size;
+  const char* image_heap_size;
+  const char* device_heap_size;
+  const char* coherent_heap_size;
+  const char* heap_sizes_from;
+  bool null_driver;
+  const char* fence_wait;
+  uint32_t audit_allocations;
 };
 
 void print_usage(const char** argv) {
@@ -159,9 +334,36 @@ void print_usage(const char** argv) {
   std::cerr << "  -h=<height>                   Set the integer height of the application in pixels" << std::endl;
   std::cerr << "  -fixed                        Simulates the application with a fixed timestep" << std::endl;
   std::cerr << "  -separate-present             Prefers a separate present queue" << std::endl;
+  std::cerr << "  -device=<policy>              Chooses the GPU: discrete, memory, an index, <vendor>:<device> in hex, or a vendor name" << std::endl;
   std::cerr << "  -output-frame=<frame>         Dumps the given frame to a file an exits" << std::endl;
+  std::cerr << "  -output-frames=<first>-<last> Captures the given frames of a Sample in the background, one PNG file each, and exits" << std::endl;
+  std::cerr << "  -output-raw                   Writes the frames of -output-frames as raw pixels instead of PNG" << std::endl;
   std::cerr << "  -load-pipeline-cache=<file>   Loads and uses a pipeline cache from the given location" << std::endl;
   std::cerr << "  -write-pipeline-cache=<file>  Writes the applicaitons pipeline cache to the given location" << std::endl;
+  std::cerr << "  -write-memory-stats=<file>    Writes the memory statistics of every heap as JSON to the given location on exit" << std::endl;
+  std::cerr << "  -present-mode=<mode>          Presents with fifo, fifo_relaxed, mailbox or immediate, if the surface supports it" << std::endl;
+  std::cerr << "  -max-frame-latency=<frames>   Limits the number of frames that can be queued on the GPU" << std::endl;
+  std::cerr << "  -swapchain-images=<images>    Asks for a swapchain with the given number of images, within what the surface allows" << std::endl;
+  std::cerr << "  -headless[=<frames>]          Renders to offscreen images without a window, and exits after the given number of frames" << std::endl;
+  std::cerr << "  -stats-file=<file>            Writes frame time statistics to the given location on exit, as JSON if it ends in .json, CSV otherwise" << std::endl;
+  std::cerr << "  -benchmark-frames=<frames>    Measures the given number of frames with a fixed timestep, prints a summary and exits" << std::endl;
+  std::cerr << "  -warmup-frames=<frames>       Sets the number of frames to render before measuring with -benchmark-frames" << std::endl;
+  std::cerr << "  -trace-file=<file>            Writes a Chrome trace-event JSON file of the CPU and GPU zones to the given location on exit" << std::endl;
+  std::cerr << "  -pipeline-cache-dir=<dir>     Loads and saves the pipeline cache for this application and device in the given directory" << std::endl;
+  std::cerr << "  -count-api-calls              Counts the draw, bind, barrier, submit, descriptor update, create and destroy calls of every frame, and logs them on exit" << std::endl;
+  std::cerr << "  -driver-allocation-stats      Counts the host memory that the driver allocates for command pools per allocation scope, pools it while recording, and logs it on exit" << std::endl;
+  std::cerr << "  -audit-allocations[=fatal]    Logs every frame after the warmup frames that allocates host memory or creates Vulkan objects, and where, or crashes on the first one" << std::endl;
+  std::cerr << "  -shader-stats=<file>          Writes the register counts, spills and instruction counts of every pipeline as JSON to the given location on exit" << std::endl;
+  std::cerr << "  -host-heap-mb=<MB|x<factor>>  Sets the size of the host visible heap, or scales the size that the application asks for" << std::endl;
+  std::cerr << "  -image-heap-mb=<MB|x<factor>> Sets or scales the size of the device image heap" << std::endl;
+  std::cerr << "  -device-heap-mb=<MB|x<factor>> Sets or scales the size of the device buffer heap" << std::endl;
+  std::cerr << "  -coherent-heap-mb=<MB|x<factor>> Sets or scales the size of the host coherent heap" << std::endl;
+  std::cerr << "  -heap-sizes-from=<file>       Sizes the heaps from the high water marks in a file of -write-memory-stats" << std::endl;
+  std::cerr << "  -null-driver                  Runs without Vulkan, every call returns right away, to measure the CPU time of the framework alone" << std::endl;
+  std::cerr << "  -fence-wait=<policy>[:<us>]   Waits for the GPU by blocking (block), spinning for up to <us> first (spin), or blocking <us> at a time (poll)" << std::endl;
+  std::cerr << "  -record-session=<file>        Records the frame times, GPU timings and window events of every frame to the given location" << std::endl;
+  std::cerr << "  -replay-session=<file>        Replays the frame times, GPU timings and window events of a recorded session" << std::endl;
+  std::cerr << "  -sample-option=<name>=<value> Sets an option that only some samples have, see their READMEs, can be given more than once" << std::endl;
   std::cerr << "  -shader-compiler=<string>     Sets the shader compiler to the given one, if the sample could use multiple" << std::endl;
   std::cerr << "  -validation                   Turns on the validation layers if available" << std::endl;
   std::cerr << "  -output-file                  Sets the output file for the output-frame argument" << std::endl;
@@ -181,6 +383,34 @@ void parse_args(CommandLineArgs* args, int argc, const char** argv) {
   args->validation = false;
   args->load_pipeline_cache = nullptr;
   args->write_pipeline_cache = nullptr;
+  args->write_memory_stats = nullptr;
+  args->present_mode = nullptr;
+  args->max_frame_latency = 0;
+  args->swapchain_images = 0;
+  args->headless = false;
+  args->headless_frames = 0;
+  args->stats_file = nullptr;
+  args->benchmark_frames = 0;
+  args->warmup_frames = 0;
+  args->trace_file = nullptr;
+  args->count_api_calls = false;
+  args->driver_allocation_stats = false;
+  args->sample_options.clear();
+  args->output_frames_first = 0;
+  args->output_frames_last = 0;
+  args->output_raw = false;
+  args->device_selection = nullptr;
+  args->shader_stats = nullptr;
+  args->record_session = nullptr;
+  args->replay_session = nullptr;
+  args->host_heap_size = nullptr;
+  args->image_heap_size = nullptr;
+  args->device_heap_size = nullptr;
+  args->coherent_heap_size = nullptr;
+  args->heap_sizes_from = nullptr;
+  args->null_driver = false;
+  args->fence_wait = nullptr;
+  args->audit_allocations = entry::kAllocationAuditOff;
 
   for (int i = 1; i < argc; ++i) {
     if (strncmp(argv[i], "-w=", 3) == 0) {
@@ -193,10 +423,86 @@ void parse_args(CommandLineArgs* args, int argc, const char** argv) {
       args->prefer_separate_present = true;
     } else if (strncmp(argv[i], "-output-frame=", 14) == 0) {
       args->output_frame = atoi(argv[i] + 14);
+    } else if (strncmp(argv[i], "-output-frames=", 15) == 0) {
+      // Either a single frame, or an inclusive range of them.
+      const char* last = strchr(argv[i] + 15, '-');
+      args->output_frames_first = atoi(argv[i] + 15);
+      args->output_frames_last =
+          last ? atoi(last + 1) : args->output_frames_first;
+    } else if (strcmp(argv[i], "-output-raw") == 0) {
+      args->output_raw = true;
+    } else if (strncmp(argv[i], "-device=", 8) == 0) {
+      args->device_selection = argv[i] + 8;
     } else if (strncmp(argv[i], "-load-pipeline-cache=", 21) == 0) {
       args->load_pipeline_cache = argv[i] + 21;
     } else if (strncmp(argv[i], "-write-pipeline-cache=", 22) == 0) {
       args->write_pipeline_cache = argv[i] + 22;
+    } else if (strncmp(argv[i], "-write-memory-stats=", 20) == 0) {
+      args->write_memory_stats = argv[i] + 20;
+    } else if (strncmp(argv[i], "-present-mode=", 14) == 0) {
+      args->present_mode = argv[i] + 14;
+    } else if (strncmp(argv[i], "-max-frame-latency=", 19) == 0) {
+      args->max_frame_latency = atoi(argv[i] + 19);
+    } else if (strncmp(argv[i], "-swapchain-images=", 18) == 0) {
+      args->swapchain_images = atoi(argv[i] + 18);
+    } else if (strncmp(argv[i], "-headless=", 10) == 0) {
+      args->headless = true;
+      args->headless_frames = atoi(argv[i] + 10);
+    } else if (strcmp(argv[i], "-headless") == 0) {
+      args->headless = true;
+    } else if (strncmp(argv[i], "-stats-file=", 12) == 0) {
+      args->stats_file = argv[i] + 12;
+    } else if (strncmp(argv[i], "-benchmark-frames=", 18) == 0) {
+      args->benchmark_frames = atoi(argv[i] + 18);
+      // Benchmark runs have to render the same frames every time.
+      args->fixed_timestep = true;
+    } else if (strncmp(argv[i], "-warmup-frames=", 15) == 0) {
+      args->warmup_frames = atoi(argv[i] + 15);
+    } else if (strncmp(argv[i], "-trace-file=", 12) == 0) {
+      args->trace_file = argv[i] + 12;
+    } else if (strncmp(argv[i], "-pipeline-cache-dir=", 20) == 0) {
+      // One cache per application, named after the executable.
+      const char* name = argv[0];
+      for (const char* c = argv[0]; *c; ++c) {
+        if (*c == '/' || *c == '\\') {
+          name = c + 1;
+        }
+      }
+      args->pipeline_cache_prefix = std::string(argv[i] + 20) + "/" + name;
+    } else if (strcmp(argv[i], "-count-api-calls") == 0) {
+      args->count_api_calls = true;
+    } else if (strcmp(argv[i], "-driver-allocation-stats") == 0) {
+      args->driver_allocation_stats = true;
+    } else if (strcmp(argv[i], "-audit-allocations") == 0) {
+      args->audit_allocations = entry::kAllocationAuditLog;
+    } else if (strcmp(argv[i], "-audit-allocations=fatal") == 0) {
+      args->audit_allocations = entry::kAllocationAuditFatal;
+    } else if (strncmp(argv[i], "-shader-stats=", 14) == 0) {
+      args->shader_stats = argv[i] + 14;
+    } else if (strncmp(argv[i], "-record-session=", 16) == 0) {
+      args->record_session = argv[i] + 16;
+    } else if (strncmp(argv[i], "-replay-session=", 16) == 0) {
+      args->replay_session = argv[i] + 16;
+    } else if (strncmp(argv[i], "-host-heap-mb=", 14) == 0) {
+      args->host_heap_size = argv[i] + 14;
+    } else if (strncmp(argv[i], "-image-heap-mb=", 15) == 0) {
+      args->image_heap_size = argv[i] + 15;
+    } else if (strncmp(argv[i], "-device-heap-mb=", 16) == 0) {
+      args->device_heap_size = argv[i] + 16;
+    } else if (strncmp(argv[i], "-coherent-heap-mb=", 18) == 0) {
+      args->coherent_heap_size = argv[i] + 18;
+    } else if (strncmp(argv[i], "-heap-sizes-from=", 17) == 0) {
+      args->heap_sizes_from = argv[i] + 17;
+    } else if (strcmp(argv[i], "-null-driver") == 0) {
+      // There is nothing to present to.
+      args->null_driver = true;
+      args->headless = true;
+    } else if (strncmp(argv[i], "-fence-wait=", 12) == 0) {
+      args->fence_wait = argv[i] + 12;
+    } else if (strncmp(argv[i], "-sample-option=", 15) == 0) {
+      // Values may contain commas, e.g. lists, so every argument is kept
+      // whole.
+      args->sample_options.push_back(argv[i] + 15);
     } else if (strncmp(argv[i], "-validation", 11) == 0) {
       args->validation = true;
     } else if (strncmp(argv[i], "-output-file=", 13) == 0) {
@@ -246,6 +552,37 @@ void HandleAppCommand(android_app* app, int32_t cmd) {
   }
 };
 
+// Asks for the sustained performance mode of the window through JNI, since
+// there is no native API for it. Returns false if the window does not have
+// it, which it only has on Android 7 and up.
+bool EnableSustainedPerformanceMode(android_app* app) {
+  JavaVM* vm = app->activity->vm;
+  JNIEnv* env = nullptr;
+  if (vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+    return false;
+  }
+  jobject activity = app->activity->clazz;
+  jclass activity_class = env->GetObjectClass(activity);
+  jmethodID get_window = env->GetMethodID(activity_class, "getWindow",
+                                          "()Landroid/view/Window;");
+  jobject window = env->CallObjectMethod(activity, get_window);
+  jclass window_class = env->GetObjectClass(window);
+  jmethodID set_mode = env->GetMethodID(
+      window_class, "setSustainedPerformanceMode", "(Z)V");
+  bool enabled = false;
+  if (set_mode) {
+    env->CallVoidMethod(window, set_mode, JNI_TRUE);
+    enabled = !env->ExceptionCheck();
+  }
+  // GetMethodID throws if there is no such method.
+  env->ExceptionClear();
+  env->DeleteLocalRef(window_class);
+  env->DeleteLocalRef(window);
+  env->DeleteLocalRef(activity_class);
+  vm->DetachCurrentThread();
+  return enabled;
+}
+
 // This method is called by android_native_app_glue. This is the main entry
 // point for any native android activity.
 void android_main(android_app* app) {
@@ -271,20 +608,33 @@ void android_main(android_app* app) {
     int32_t height = output_frame >= 0 ? DEFAULT_WINDOW_HEIGHT
                                        : ANativeWindow_getHeight(app->window);
 
-    containers::LeakCheckAllocator root_allocator;
+    containers::ThreadCachingAllocator root_allocator;
     {
       entry::EntryData entry_data(&root_allocator, static_cast<uint32_t>(width),
                                   static_cast<uint32_t>(height), FIXED_TIMESTEP,
                                   PREFER_SEPARATE_PRESENT, output_frame,
                                   output_file, shader_compiler, false, nullptr,
-                                  nullptr, app);
+                                  nullptr, nullptr, nullptr, 0, 0, false, 0,
+                                  nullptr, 0, 0, nullptr, nullptr, false,
+                                  false, nullptr, 0, 0, false, nullptr,
+                                  nullptr, nullptr, nullptr, nullptr,
+                                  nullptr, nullptr, nullptr, nullptr, false,
+                                  nullptr, entry::kAllocationAuditOff, app);
       data.entry_data = &entry_data;
+      if (ANDROID_SUSTAINED_PERFORMANCE) {
+        if (EnableSustainedPerformanceMode(app)) {
+          entry_data.logger()->LogInfo("Enabled sustained performance mode");
+        } else {
+          entry_data.logger()->LogError(
+              "Sustained performance mode is not supported");
+        }
+      }
       int return_value = main_entry(&entry_data);
       // Do not modify this line, scripts may look for it in the output.
       entry_data.logger()->LogInfo("RETURN: ", return_value);
       ANativeActivity_finish(app->activity);
     }
-    assert(root_allocator.currently_allocated_bytes_.load() == 0);
+    assert(root_allocator.currently_allocated_bytes() == 0);
   });
 
   app->userData = &data;
@@ -359,14 +709,26 @@ int main(int argc, const char** argv) {
   while (args.wait_for_debugger)
     ;
   int return_value = 0;
-  containers::LeakCheckAllocator root_allocator;
+  containers::ThreadCachingAllocator root_allocator;
   {
     entry::EntryData entry_data(
         &root_allocator, args.window_width, args.window_height,
         args.fixed_timestep, args.prefer_separate_present, args.output_frame,
         args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
-    if (args.output_frame == -1) {
+        args.load_pipeline_cache, args.write_pipeline_cache,
+        args.write_memory_stats, args.present_mode, args.max_frame_latency,
+        args.swapchain_images, args.headless, args.headless_frames,
+        args.stats_file, args.benchmark_frames, args.warmup_frames,
+        args.trace_file,
+        args.pipeline_cache_prefix.c_str(), args.count_api_calls,
+        args.driver_allocation_stats, args.sample_options,
+        args.output_frames_first, args.output_frames_last, args.output_raw,
+        args.device_selection, args.shader_stats, args.record_session,
+        args.replay_session, args.host_heap_size, args.image_heap_size,
+        args.device_heap_size, args.coherent_heap_size,
+        args.heap_sizes_from, args.null_driver, args.fence_wait,
+        args.audit_allocations);
+    if (args.output_frame == -1 && !args.headless) {
       bool window_created = entry_data.CreateWindow();
       if (!window_created) {
         entry_data.logger()->LogError("Window creation failed");
@@ -394,7 +756,7 @@ int main(int argc, const char** argv) {
     // Indicate that ggp should shutdown.
     ggp::StopStream();
   }
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  assert(root_allocator.currently_allocated_bytes() == 0);
   return return_value;
 }
 
@@ -469,14 +831,26 @@ int main(int argc, const char** argv) {
     ;
 
   int return_value = 0;
-  containers::LeakCheckAllocator root_allocator;
+  containers::ThreadCachingAllocator root_allocator;
   {
     entry::EntryData entry_data(
         &root_allocator, args.window_width, args.window_height,
         args.fixed_timestep, args.prefer_separate_present, args.output_frame,
         args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
-    if (args.output_frame == -1) {
+        args.load_pipeline_cache, args.write_pipeline_cache,
+        args.write_memory_stats, args.present_mode, args.max_frame_latency,
+        args.swapchain_images, args.headless, args.headless_frames,
+        args.stats_file, args.benchmark_frames, args.warmup_frames,
+        args.trace_file,
+        args.pipeline_cache_prefix.c_str(), args.count_api_calls,
+        args.driver_allocation_stats, args.sample_options,
+        args.output_frames_first, args.output_frames_last, args.output_raw,
+        args.device_selection, args.shader_stats, args.record_session,
+        args.replay_session, args.host_heap_size, args.image_heap_size,
+        args.device_heap_size, args.coherent_heap_size,
+        args.heap_sizes_from, args.null_driver, args.fence_wait,
+        args.audit_allocations);
+    if (args.output_frame == -1 && !args.headless) {
       bool window_created = entry_data.CreateWindow();
       if (!window_created) {
         entry_data.logger()->LogError("Window creation failed");
@@ -488,7 +862,7 @@ int main(int argc, const char** argv) {
     });
     main_thread.join();
   }
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  assert(root_allocator.currently_allocated_bytes() == 0);
   return return_value;
 }
 
@@ -581,14 +955,25 @@ int main(int argc, const char** argv) {
       SetEnvironmentVariableA("VK_LAYER_PATH", lp.c_str());
     }
   }
-  containers::LeakCheckAllocator root_allocator;
+  containers::ThreadCachingAllocator root_allocator;
   entry::EntryData entry_data(
       &root_allocator, args.window_width, args.window_height,
       args.fixed_timestep, args.prefer_separate_present, args.output_frame,
       args.output_file, args.shader_compiler, args.validation,
-      args.load_pipeline_cache, args.write_pipeline_cache);
+      args.load_pipeline_cache, args.write_pipeline_cache,
+      args.write_memory_stats, args.present_mode, args.max_frame_latency,
+      args.swapchain_images, args.headless, args.headless_frames,
+      args.stats_file, args.benchmark_frames, args.warmup_frames,
+      args.trace_file,
+      args.pipeline_cache_prefix.c_str(), args.count_api_calls,
+      args.driver_allocation_stats, args.sample_options,
+      args.output_frames_first, args.output_frames_last, args.output_raw,
+      args.device_selection, args.shader_stats, args.record_session,
+      args.replay_session, args.host_heap_size, args.image_heap_size,
+      args.device_heap_size, args.coherent_heap_size, args.heap_sizes_from,
+      args.null_driver, args.fence_wait, args.audit_allocations);
 
-  if (args.output_frame == -1) {
+  if (args.output_frame == -1 && !args.headless) {
     bool window_created = entry_data.CreateWindowWin32();
     if (!window_created) {
       entry_data.logger()->LogError("Window creation failed");
@@ -608,7 +993,7 @@ int main(int argc, const char** argv) {
   }
 
   main_thread.join();
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  assert(root_allocator.currently_allocated_bytes() == 0);
   return return_value;
 }
 #endif
@@ -629,13 +1014,24 @@ int main(int argc, const char** argv) {
   parse_args(&args, argc, argv);
   while (args.wait_for_debugger)
     ;
-  containers::LeakCheckAllocator root_allocator;
+  containers::ThreadCachingAllocator root_allocator;
   entry::EntryData entry_data(
       &root_allocator, args.window_width, args.window_height,
       args.fixed_timestep, args.prefer_separate_present, args.output_frame,
       args.output_file, args.shader_compiler, args.validation,
-      args.load_pipeline_cache, args.write_pipeline_cache);
-  if (args.output_frame == -1) {
+      args.load_pipeline_cache, args.write_pipeline_cache,
+      args.write_memory_stats, args.present_mode, args.max_frame_latency,
+      args.swapchain_images, args.headless, args.headless_frames,
+      args.stats_file, args.benchmark_frames, args.warmup_frames,
+      args.trace_file,
+      args.pipeline_cache_prefix.c_str(), args.count_api_calls,
+      args.driver_allocation_stats, args.sample_options,
+      args.output_frames_first, args.output_frames_last, args.output_raw,
+      args.device_selection, args.shader_stats, args.record_session,
+      args.replay_session, args.host_heap_size, args.image_heap_size,
+      args.device_heap_size, args.coherent_heap_size, args.heap_sizes_from,
+      args.null_driver, args.fence_wait, args.audit_allocations);
+  if (args.output_frame == -1 && !args.headless) {
     bool window_created = entry_data.CreateWindow();
     if (!window_created) {
       entry_data.logger()->LogError("Window creation failed");
@@ -649,7 +1045,7 @@ int main(int argc, const char** argv) {
   });
   RunMacOS();
 
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  assert(root_allocator.currently_allocated_bytes() == 0);
   return ret;
 }
 }
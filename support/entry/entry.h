@@ -18,14 +18,19 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "support/containers/allocator.h"
+#include "support/containers/audit_allocator.h"
 #include "support/containers/unique_ptr.h"
+#include "support/entry/session.h"
 #include "support/log/log.h"
 
 #if defined __ANDROID__
 struct android_app;
 struct ANativeWindow;
+struct AThermalManager;
 #elif defined __ggp__
 #define VK_USE_PLATFORM_GGP 1
 #include <ggp/ggp.h>
@@ -53,6 +58,15 @@ struct dummy {
 static internal::dummy __attribute__((used)) test_dummy;
 #endif
 
+// How -audit-allocations reports the allocations of steady-state frames.
+enum AllocationAuditMode : uint32_t {
+  kAllocationAuditOff = 0,
+  // Every frame that allocates is logged, with where it allocated.
+  kAllocationAuditLog = 1,
+  // Like kAllocationAuditLog, but the first frame that allocates crashes.
+  kAllocationAuditFatal = 2,
+};
+
 // EntryData contains the information about the window and application options
 // like fixed time step etc. On Windows and Linux it is used to create a
 // window and cache the handles of the window for display.
@@ -71,7 +85,23 @@ class EntryData {
             int64_t output_frame_index, const char* output_frame_file,
             const char* shader_compiler, bool validation,
             const char* load_pipeline_cache,
-            const char* write_pipeline_cache
+            const char* write_pipeline_cache,
+            const char* write_memory_stats, const char* present_mode,
+            uint32_t max_frame_latency, uint32_t swapchain_images,
+            bool headless, uint32_t headless_frames,
+            const char* stats_file, uint32_t benchmark_frames,
+            uint32_t warmup_frames, const char* trace_file,
+            const char* pipeline_cache_prefix, bool count_api_calls,
+            bool driver_allocation_stats,
+            const std::vector<std::string>& sample_options,
+            uint32_t capture_first_frame, uint32_t capture_last_frame,
+            bool capture_raw, const char* device_selection,
+            const char* shader_stats, const char* record_session,
+            const char* replay_session, const char* host_heap_size,
+            const char* image_heap_size, const char* device_heap_size,
+            const char* coherent_heap_size, const char* heap_sizes_from,
+            bool null_driver, const char* fence_wait,
+            uint32_t audit_allocations
 #if defined __ANDROID__
             ,
             android_app* app
@@ -81,6 +111,9 @@ class EntryData {
   // dtor of EntryData
   ~EntryData() {
 #if defined __ANDROID__
+    if (thermal_manager_) {
+      release_thermal_manager_(thermal_manager_);
+    }
 #elif defined _WIN32
     if (native_window_handle_) {
       DestroyWindow(native_window_handle_);
@@ -138,8 +171,147 @@ class EntryData {
   const char* write_pipeline_cache() const {
     return write_pipeline_cache_.empty()? nullptr: write_pipeline_cache_.c_str();
   }
+  const char* write_memory_stats() const {
+    return write_memory_stats_.empty() ? nullptr : write_memory_stats_.c_str();
+  }
+  // The present mode that was asked for on the command line, one of "fifo",
+  // "fifo_relaxed", "mailbox" or "immediate", or nullptr if none was.
+  const char* present_mode() const {
+    return present_mode_.empty() ? nullptr : present_mode_.c_str();
+  }
+  // The number of frames that may be queued on the GPU at once, or 0 if the
+  // application should pick.
+  uint32_t max_frame_latency() const { return max_frame_latency_; }
+  // The number of swapchain images that was asked for, or 0 if the
+  // application should pick. The surface limits it either way.
+  uint32_t swapchain_images() const { return swapchain_images_; }
+  // If true there is no window, and applications render to offscreen images
+  // instead of a swapchain.
+  bool headless() const { return headless_; }
+  // The number of frames to render in headless mode before exiting, or 0 to
+  // keep rendering.
+  uint32_t headless_frames() const { return headless_frames_; }
+  // The file to write frame time statistics to on exit, or nullptr.
+  const char* stats_file() const {
+    return stats_file_.empty() ? nullptr : stats_file_.c_str();
+  }
+  // The number of frames to measure in benchmark mode before exiting, or 0
+  // if this is not a benchmark run.
+  uint32_t benchmark_frames() const { return benchmark_frames_; }
+  // The number of frames to render, and not measure, before the benchmark
+  // frames.
+  uint32_t warmup_frames() const { return warmup_frames_; }
+  // The file to write a Chrome trace of the CPU and GPU zones to on exit,
+  // or nullptr.
+  const char* trace_file() const {
+    return trace_file_.empty() ? nullptr : trace_file_.c_str();
+  }
+  // The path prefix that pipeline caches are automatically loaded from and
+  // saved to, one file per device and driver, or nullptr.
+  const char* pipeline_cache_prefix() const {
+    return pipeline_cache_prefix_.empty() ? nullptr
+                                          : pipeline_cache_prefix_.c_str();
+  }
+  // If true, the calls of an application to the device are counted every
+  // frame, and logged on exit.
+  bool count_api_calls() const { return count_api_calls_; }
+  // If true, the host memory that the driver allocates for the command pools
+  // of an application is counted, and logged on exit.
+  bool driver_allocation_stats() const { return driver_allocation_stats_; }
+  // One of AllocationAuditMode, from -audit-allocations.
+  uint32_t audit_allocations() const { return audit_allocations_; }
+  // The allocator that allocator() forwards to while it counts the
+  // allocations, or nullptr without -audit-allocations.
+  containers::AuditAllocator* audit_allocator() const {
+    return audit_allocations_ != kAllocationAuditOff ? &audit_allocator_
+                                                    : nullptr;
+  }
+  // Returns the value that was given with -sample-option=<name>=<value>, or
+  // nullptr. Which options there are, and what they mean, is up to every
+  // sample. If the same name was given more than once, the last one wins.
+  const char* sample_option(const char* name) const;
+  // Returns -sample-option=<name>=<value> as a number, or |default_value|
+  // if it was not given, or is not a number greater than 0.
+  uint32_t sample_option_uint(const char* name, uint32_t default_value) const;
+  // The first and last frame, counting from 1, that a Sample captures in the
+  // background with -output-frames, or 0 if there are none.
+  uint32_t capture_first_frame() const { return capture_first_frame_; }
+  uint32_t capture_last_frame() const { return capture_last_frame_; }
+  // If true, the captured frames are written as raw pixels instead of PNG.
+  bool capture_raw() const { return capture_raw_; }
+  // How the physical device is chosen, as given with -device, or nullptr to
+  // take the first suitable one. See GetPhysicalDevicesInSelectionOrder in
+  // vulkan_helpers/helper_functions.h.
+  const char* device_selection() const {
+    return device_selection_.empty() ? nullptr : device_selection_.c_str();
+  }
+  // The file to write the shader statistics of every pipeline to on exit,
+  // or nullptr.
+  const char* shader_stats() const {
+    return shader_stats_.empty() ? nullptr : shader_stats_.c_str();
+  }
+  // The sizes of the host, device image, device buffer and coherent heaps
+  // as they were given with -host-heap-mb, -image-heap-mb, -device-heap-mb
+  // and -coherent-heap-mb, either a number of MB or x<factor> to scale the
+  // size that the application asks for, or nullptr.
+  const char* host_heap_size() const {
+    return host_heap_size_.empty() ? nullptr : host_heap_size_.c_str();
+  }
+  const char* image_heap_size() const {
+    return image_heap_size_.empty() ? nullptr : image_heap_size_.c_str();
+  }
+  const char* device_heap_size() const {
+    return device_heap_size_.empty() ? nullptr : device_heap_size_.c_str();
+  }
+  const char* coherent_heap_size() const {
+    return coherent_heap_size_.empty() ? nullptr
+                                       : coherent_heap_size_.c_str();
+  }
+  // The file of -write-memory-stats of an earlier run that the heaps that
+  // are not given are sized from, or nullptr.
+  const char* heap_sizes_from() const {
+    return heap_sizes_from_.empty() ? nullptr : heap_sizes_from_.c_str();
+  }
+  // If true, Vulkan is not loaded, and every call goes to the null driver of
+  // vulkan_wrapper/null_driver.h instead, which does no work. It implies
+  // headless().
+  bool null_driver() const { return null_driver_; }
+  // How the CPU waits for the GPU, from -fence-wait, see
+  // vulkan::FenceWaiter::ParsePolicy, or nullptr to block.
+  const char* fence_wait() const {
+    return fence_wait_.empty() ? nullptr : fence_wait_.c_str();
+  }
+  // The thermal status of the device, from 0 for none to 6 for shutdown like
+  // the ATHERMAL_STATUS_* values of Android, or -1 if it is not known. It is
+  // only known on Android 11 and up.
+  int32_t thermal_status() const;
+  // The thermal headroom that is forecast in |forecast_seconds|, where 1 is
+  // where the device throttles severely, or -1 if it is not known. It is only
+  // known on Android 12 and up, and should not be asked for more than once
+  // a second.
+  float thermal_headroom(int32_t forecast_seconds) const;
+  // The thermal headroom that a Sample caps its frame rate to stay under, or
+  // 0 to never cap it. This is the ANDROID_THERMAL_HEADROOM_TARGET CMake
+  // option on Android, and 0 everywhere else.
+  float thermal_headroom_target() const { return thermal_headroom_target_; }
+  // Starts the next frame of the session, and returns the time to update
+  // it with: the recorded one with -replay-session, 0.1s with a fixed
+  // timestep, or |elapsed| otherwise. It is recorded with -record-session.
+  float FrameTime(float elapsed) const {
+    session_.BeginFrame();
+    return session_.Value("frame_time", fixed_timestep_ ? 0.1f : elapsed);
+  }
+  // Returns the recorded |name| of the current frame of the session with
+  // -replay-session, or |measured|, for the other measurements that change
+  // what a frame does. It is recorded with -record-session.
+  float SessionValue(const char* name, float measured) const {
+    return session_.Value(name, measured);
+  }
 
  private:
+  // Returns true when the window itself is to be closed.
+  bool PollWindowClosing() const;
+
   bool fixed_timestep_;
   bool prefer_separate_present_;
   uint32_t width_;
@@ -148,15 +320,56 @@ class EntryData {
   const char* output_frame_file_;
   const char* shader_compiler_;
   const bool validation_;
+  uint32_t audit_allocations_;
+  // Only used with -audit-allocations, the logger allocates from the
+  // allocator that it wraps.
+  mutable containers::AuditAllocator audit_allocator_;
   containers::unique_ptr<logging::Logger> log_;
   containers::Allocator* allocator_;
   std::string load_pipeline_cache_;
   std::string write_pipeline_cache_;
+  std::string write_memory_stats_;
+  std::string present_mode_;
+  uint32_t max_frame_latency_;
+  uint32_t swapchain_images_;
+  bool headless_;
+  uint32_t headless_frames_;
+  std::string stats_file_;
+  uint32_t benchmark_frames_;
+  uint32_t warmup_frames_;
+  std::string trace_file_;
+  std::string pipeline_cache_prefix_;
+  bool count_api_calls_;
+  bool driver_allocation_stats_;
+  // Every -sample-option as <name>=<value>.
+  std::vector<std::string> sample_options_;
+  uint32_t capture_first_frame_;
+  uint32_t capture_last_frame_;
+  bool capture_raw_;
+  std::string device_selection_;
+  std::string shader_stats_;
+  // Only changed by the sample thread.
+  mutable Session session_;
+  std::string host_heap_size_;
+  std::string image_heap_size_;
+  std::string device_heap_size_;
+  std::string coherent_heap_size_;
+  std::string heap_sizes_from_;
+  bool null_driver_;
+  std::string fence_wait_;
+  float thermal_headroom_target_;
 
 #if defined __ANDROID__
   ANativeWindow* native_window_handle_;
   std::string os_version_;
   bool window_closing_;
+  // The functions of libandroid for the thermal state, which are resolved
+  // at runtime since they are newer than the API level that is built for.
+  // The manager is nullptr if they are not there.
+  AThermalManager* thermal_manager_;
+  void (*release_thermal_manager_)(AThermalManager*);
+  int (*get_thermal_status_)(AThermalManager*);
+  float (*get_thermal_headroom_)(AThermalManager*, int);
 #elif defined _WIN32
   HINSTANCE native_hinstance_;
   HWND native_window_handle_;
@@ -170,6 +383,10 @@ class EntryData {
   void* native_window_handle_;
 #endif
 };
+
+// Returns true if the comma separated |list|, e.g. the value of a
+// -sample-option, has |item| in it.
+bool ListHas(const char* list, const char* item);
 }  // namespace entry
 // This is the entry-point that every application should define.
 int main_entry(const entry::EntryData* data);
@@ -0,0 +1,102 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/entry/session.h"
+
+#include <iomanip>
+#include <limits>
+
+namespace entry {
+
+Session::Session(const char* record_file, const char* replay_file,
+                 logging::Logger* log)
+    : replaying_(false), next_entry_(0), last_frame_(0), frame_(0) {
+  if (replay_file) {
+    std::ifstream file(replay_file);
+    if (!file) {
+      log->LogError("Could not open the session ", replay_file,
+                    ", it is not replayed");
+    } else {
+      Entry entry;
+      while (file >> entry.frame >> entry.name >> entry.value) {
+        if (entry.frame < last_frame_) {
+          log->LogError("The session ", replay_file,
+                        " is not in the order of its frames");
+          entries_.clear();
+          break;
+        }
+        last_frame_ = entry.frame;
+        entries_.push_back(entry);
+      }
+      replaying_ = !entries_.empty();
+      if (replaying_) {
+        log->LogInfo("Replaying ", last_frame_, " frames from ",
+                     replay_file);
+      }
+    }
+  }
+  if (record_file) {
+    record_.open(record_file);
+    if (!record_) {
+      log->LogError("Could not open the session ", record_file,
+                    ", it is not recorded");
+    } else {
+      // Enough digits that every float reads back the same.
+      record_ << std::setprecision(std::numeric_limits<float>::max_digits10);
+    }
+  }
+}
+
+float Session::Value(const char* name, float measured) {
+  const Entry* entry = Find(name);
+  const float value = entry ? entry->value : measured;
+  Record(name, value);
+  return value;
+}
+
+bool Session::Event(const char* name, bool happened) {
+  if (replaying_ && (frame_ > last_frame_ || Find(name))) {
+    happened = true;
+  }
+  if (happened) {
+    Record(name, 1.0f);
+  }
+  return happened;
+}
+
+const Session::Entry* Session::Find(const char* name) {
+  if (!replaying_) {
+    return nullptr;
+  }
+  while (next_entry_ < entries_.size() &&
+         entries_[next_entry_].frame < frame_) {
+    ++next_entry_;
+  }
+  for (size_t i = next_entry_;
+       i < entries_.size() && entries_[i].frame == frame_; ++i) {
+    if (entries_[i].name == name) {
+      return &entries_[i];
+    }
+  }
+  return nullptr;
+}
+
+void Session::Record(const char* name, float value) {
+  if (record_.is_open()) {
+    record_ << frame_ << " " << name << " " << value << "\n";
+  }
+}
+
+}  // namespace entry
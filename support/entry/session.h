@@ -0,0 +1,86 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_ENTRY_SESSION_H_
+#define SUPPORT_ENTRY_SESSION_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "support/log/log.h"
+
+namespace entry {
+
+// Session records the inputs of a run that change from one run to the next,
+// such as frame times, GPU timings and window events, and plays them back
+// in a later run, so that both runs do the same work.
+//
+// Every input is a named value of a frame. The frames are counted by
+// BeginFrame(), so a replay must ask for the same values in the same frames
+// as the recording did. A session file has one line per value, with the
+// frame, the name and the value, separated by spaces.
+class Session {
+ public:
+  // |record_file| and |replay_file| may be nullptr. If both are given, the
+  // values that are played back are recorded again.
+  Session(const char* record_file, const char* replay_file,
+          logging::Logger* log);
+
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  bool recording() const { return record_.is_open(); }
+  bool replaying() const { return replaying_; }
+
+  // Starts the next frame.
+  void BeginFrame() { ++frame_; }
+
+  // Returns the value of |name| in the current frame. While replaying, that
+  // is the recorded value, or |measured| if none was recorded. The value
+  // that is returned is recorded.
+  float Value(const char* name, float measured);
+
+  // Returns true if the event |name| happened in the current frame, either
+  // because it |happened| now or because it was recorded. Once a replay has
+  // run past the last recorded frame, every event happens. Only events that
+  // happen are recorded.
+  bool Event(const char* name, bool happened);
+
+ private:
+  struct Entry {
+    uint64_t frame;
+    std::string name;
+    float value;
+  };
+
+  // Returns the recorded entry of |name| in the current frame, or nullptr.
+  const Entry* Find(const char* name);
+  void Record(const char* name, float value);
+
+  std::ofstream record_;
+  bool replaying_;
+  // The entries that are played back, in the order of their frames.
+  std::vector<Entry> entries_;
+  // The first entry that is not of an earlier frame than the current one.
+  size_t next_entry_;
+  uint64_t last_frame_;
+  uint64_t frame_;
+};
+
+}  // namespace entry
+
+#endif  // SUPPORT_ENTRY_SESSION_H_
@@ -0,0 +1,161 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/jobs/job_system.h"
+
+#include <utility>
+
+namespace jobs {
+namespace {
+// The job system that the current thread is a worker of, and the index of
+// its queue.
+thread_local JobSystem* t_system = nullptr;
+thread_local size_t t_queue = 0;
+}  // anonymous namespace
+
+void TaskGroup::Run(std::function<void()> function) {
+  if (!system_) {
+    function();
+    return;
+  }
+  num_pending_.fetch_add(1, std::memory_order_relaxed);
+  system_->Push(system_->job_pool_.construct<JobSystem::Job>(
+      std::move(function), this));
+}
+
+void TaskGroup::Wait() {
+  while (num_pending_.load(std::memory_order_acquire) != 0) {
+    // Rather than blocking, help with whatever is queued, which is most
+    // likely a job of this group.
+    if (!system_->RunOne()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+JobSystem::JobSystem(containers::Allocator* allocator, size_t num_threads)
+    : job_pool_(allocator),
+      queues_(allocator),
+      workers_(allocator),
+      num_queued_(0),
+      num_sleeping_(0),
+      exiting_(false) {
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  const size_t num_workers = num_threads > 1 ? num_threads - 1 : 0;
+  queues_.reserve(num_workers + 1);
+  for (size_t i = 0; i < num_workers + 1; ++i) {
+    queues_.push_back(containers::make_unique<Queue>(allocator, allocator));
+  }
+  workers_.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&JobSystem::WorkerThread, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    exiting_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t JobSystem::CurrentQueue() const {
+  return t_system == this ? t_queue : queues_.size() - 1;
+}
+
+void JobSystem::Push(Job* job) {
+  Queue& queue = *queues_[CurrentQueue()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(job);
+  }
+  num_queued_.fetch_add(1);
+  // A worker increments num_sleeping_ before it checks num_queued_ for the
+  // last time, so either it sees this job, or this sees it sleeping.
+  if (num_sleeping_.load() > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    wake_.notify_one();
+  }
+}
+
+JobSystem::Job* JobSystem::Take(size_t queue) {
+  if (num_queued_.load(std::memory_order_relaxed) == 0) {
+    return nullptr;
+  }
+  Job* job = nullptr;
+  {
+    Queue& own = *queues_[queue];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty()) {
+      job = own.jobs.back();
+      own.jobs.pop_back();
+    }
+  }
+  for (size_t i = 1; !job && i < queues_.size(); ++i) {
+    Queue& victim = *queues_[(queue + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = victim.jobs.front();
+      victim.jobs.pop_front();
+    }
+  }
+  if (job) {
+    num_queued_.fetch_sub(1);
+  }
+  return job;
+}
+
+bool JobSystem::RunOne() {
+  Job* job = Take(CurrentQueue());
+  if (!job) {
+    return false;
+  }
+  Execute(job);
+  return true;
+}
+
+void JobSystem::Execute(Job* job) {
+  job->function();
+  TaskGroup* group = job->group;
+  // The job, and whatever its function captured, is gone before the group
+  // can see it finish.
+  job_pool_.destroy(job);
+  group->num_pending_.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::WorkerThread(size_t index) {
+  t_system = this;
+  t_queue = index;
+  while (true) {
+    if (RunOne()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    if (exiting_) {
+      return;
+    }
+    num_sleeping_.fetch_add(1);
+    wake_.wait(lock, [this]() { return exiting_ || num_queued_.load() > 0; });
+    num_sleeping_.fetch_sub(1);
+  }
+}
+
+}  // namespace jobs
@@ -0,0 +1,172 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_JOBS_JOB_SYSTEM_H_
+#define SUPPORT_JOBS_JOB_SYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "support/containers/allocator.h"
+#include "support/containers/deque.h"
+#include "support/containers/pool_allocator.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+
+namespace jobs {
+
+class JobSystem;
+
+// A TaskGroup is a set of jobs that are waited for together. Run() forks a
+// job, and Wait() joins all of them. The thread that waits runs queued
+// jobs itself until the group is done, so groups may be nested, and jobs
+// may wait for groups of their own. A TaskGroup without a JobSystem runs
+// every job right away, in Run().
+class TaskGroup {
+ public:
+  TaskGroup(JobSystem* system) : system_(system), num_pending_(0) {}
+  ~TaskGroup() { Wait(); }
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  // Queues |function| to run on any thread of the job system.
+  void Run(std::function<void()> function);
+  // Returns once every job of this group has run.
+  void Wait();
+
+ private:
+  friend class JobSystem;
+  JobSystem* system_;
+  std::atomic<uint32_t> num_pending_;
+};
+
+// JobSystem runs jobs on a fixed set of worker threads. Every worker has its
+// own deque, it runs the jobs that it queued itself newest first, and steals
+// the oldest ones from the other deques when it runs out. Jobs that are
+// queued from any other thread go to a shared deque. Workers sleep while
+// there is nothing to do.
+//
+// The job bookkeeping comes from a pool in the given allocator. A job whose
+// function captures more than std::function stores inline is still
+// allocated by std::function itself.
+class JobSystem {
+ public:
+  // |num_threads| counts the thread that waits for the jobs, which helps
+  // running them, so num_threads - 1 workers are started. If it is 0, it is
+  // the hardware concurrency.
+  JobSystem(containers::Allocator* allocator, size_t num_threads = 0);
+  // Every TaskGroup has to be waited for before this is destroyed.
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // The number of threads that run jobs, including the one that waits.
+  size_t num_threads() const { return workers_.size() + 1; }
+
+  // Calls |function(chunk_begin, chunk_end)| for chunks of [begin, end)
+  // that are at least |grain_size| long, in parallel, and returns once all
+  // of them are done.
+  template <typename F>
+  void ParallelFor(size_t begin, size_t end, size_t grain_size,
+                   const F& function) {
+    if (end <= begin) {
+      return;
+    }
+    if (grain_size == 0) {
+      grain_size = 1;
+    }
+    // A few chunks per thread, so that stealing can even out uneven work.
+    Range<F> range = {&function, begin, end, 0};
+    range.chunk_size = (end - begin) / (num_threads() * kChunksPerThread);
+    if (range.chunk_size < grain_size) {
+      range.chunk_size = grain_size;
+    }
+    const size_t num_chunks =
+        (end - begin + range.chunk_size - 1) / range.chunk_size;
+    TaskGroup group(this);
+    // Only a pointer and an index are captured, so that the std::function
+    // does not have to allocate.
+    for (size_t i = 1; i < num_chunks; ++i) {
+      group.Run([&range, i]() { range.Run(i); });
+    }
+    // The first chunk runs right here.
+    range.Run(0);
+    group.Wait();
+  }
+
+ private:
+  friend class TaskGroup;
+  static const size_t kChunksPerThread = 4;
+
+  template <typename F>
+  struct Range {
+    void Run(size_t chunk) const {
+      const size_t chunk_begin = begin + chunk * chunk_size;
+      const size_t chunk_end =
+          end - chunk_begin > chunk_size ? chunk_begin + chunk_size : end;
+      (*function)(chunk_begin, chunk_end);
+    }
+    const F* function;
+    size_t begin;
+    size_t end;
+    size_t chunk_size;
+  };
+
+  struct Job {
+    Job(std::function<void()>&& function, TaskGroup* group)
+        : function(std::move(function)), group(group) {}
+    std::function<void()> function;
+    TaskGroup* group;
+  };
+
+  struct Queue {
+    Queue(containers::Allocator* allocator) : jobs(allocator) {}
+    std::mutex mutex;
+    containers::deque<Job*> jobs;
+  };
+
+  void Push(Job* job);
+  // Takes the newest job of |queue|, or the oldest one of any other queue.
+  Job* Take(size_t queue);
+  // Runs one queued job, if there is one, and returns whether there was.
+  bool RunOne();
+  void Execute(Job* job);
+  void WorkerThread(size_t index);
+  // The queue that the calling thread pushes to.
+  size_t CurrentQueue() const;
+
+  containers::PoolAllocator job_pool_;
+  // One queue per worker, followed by the one that other threads push to.
+  containers::vector<containers::unique_ptr<Queue>> queues_;
+  containers::vector<std::thread> workers_;
+  // The number of jobs in all queues.
+  std::atomic<size_t> num_queued_;
+  std::atomic<size_t> num_sleeping_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  // Guarded by sleep_mutex_.
+  bool exiting_;
+};
+
+}  // namespace jobs
+
+#endif  // SUPPORT_JOBS_JOB_SYSTEM_H_
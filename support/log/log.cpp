@@ -14,7 +14,13 @@
  */
 
 #include "support/log/log.h"
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "support/containers/mpmc_queue.h"
 
 namespace logging {
 #if defined __ANDROID__
@@ -88,7 +94,109 @@ class InternalLogger : public Logger {
 };
 #endif
 
+namespace {
+// AsyncLogger copies info messages into a lock-free ring, which a background
+// thread writes out, so that logging does not block the thread that logs.
+// Errors, messages that are too long for a record, and messages that do
+// not fit into the ring any more are written right away, after everything
+// that is still queued, so that nothing is reordered, or lost in a crash.
+class AsyncLogger : public InternalLogger {
+ public:
+  AsyncLogger(containers::Allocator* allocator)
+      : records_(allocator, kNumRecords), pending_(false), exit_(false) {
+    thread_ = std::thread(&AsyncLogger::Drain, this);
+  }
+
+  ~AsyncLogger() {
+    exit_.store(true);
+    Wake();
+    thread_.join();
+    Flush();
+  }
+
+  void LogErrorString(const char* str) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WriteQueued();
+    InternalLogger::LogErrorString(str);
+    InternalLogger::Flush();
+  }
+
+  void LogInfoString(const char* str) override {
+    const size_t length = strlen(str);
+    if (length < kRecordSize) {
+      Record record;
+      memcpy(record.text, str, length + 1);
+      if (records_.try_push(record)) {
+        // Only the first record since the thread last woke up has to wake
+        // it, the others are written along with it.
+        if (!pending_.exchange(true)) {
+          Wake();
+        }
+        return;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    WriteQueued();
+    InternalLogger::LogInfoString(str);
+  }
+
+  void Flush() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WriteQueued();
+    InternalLogger::Flush();
+  }
+
+ private:
+  static const size_t kRecordSize = 256;
+  static const size_t kNumRecords = 1024;
+
+  struct Record {
+    char text[kRecordSize];
+  };
+
+  // Writes everything that is queued. mutex_ has to be held, so that
+  // records are written in order.
+  void WriteQueued() {
+    Record record;
+    while (records_.try_pop(&record)) {
+      InternalLogger::LogInfoString(record.text);
+    }
+  }
+
+  // Wakes up the thread. Taking wake_mutex_ makes sure that it is either
+  // waiting already, or still has to check pending_ and exit_.
+  void Wake() {
+    { std::lock_guard<std::mutex> lock(wake_mutex_); }
+    wake_.notify_one();
+  }
+
+  // Sleeps until something is queued, rather than polling, so that the
+  // thread does not add any load while the application is measured.
+  void Drain() {
+    while (!exit_.load()) {
+      {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_.wait(lock, [this] { return pending_.load() || exit_.load(); });
+      }
+      pending_.exchange(false);
+      std::lock_guard<std::mutex> lock(mutex_);
+      WriteQueued();
+    }
+  }
+
+  containers::mpmc_queue<Record> records_;
+  // Held while anything is written out.
+  std::mutex mutex_;
+  // Set when a record is queued while the thread may be asleep.
+  std::atomic<bool> pending_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::atomic<bool> exit_;
+  std::thread thread_;
+};
+}  // anonymous namespace
+
 containers::unique_ptr<Logger> GetLogger(containers::Allocator* allocator) {
-  return containers::make_unique<InternalLogger>(allocator);
+  return containers::make_unique<AsyncLogger>(allocator, allocator);
 }
 }  // namespace logging
\ No newline at end of file
@@ -22,6 +22,22 @@
 
 #include "support/containers/unique_ptr.h"
 #include "support/containers/vector.h"
+
+// The levels of log messages. Messages below LOG_MIN_LEVEL are removed at
+// compile time, their arguments are not even formatted. Release builds only
+// keep info messages and errors by default.
+#define LOG_LEVEL_VERBOSE 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_ERROR 2
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_VERBOSE
+#endif
+#endif
+
 namespace logging {
 
 // Tests the result of "res op exp" and if the result is not "true"
@@ -79,10 +95,24 @@ class Logger {
   // Logs a set of values to the info stream of the logger.
   template <typename... Args>
   void LogInfo(Args... args) {
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+    std::ostringstream str;
+    LogHelper(&str, args...);
+    str << "\n";
+    LogInfoString(str.str().c_str());
+#endif
+  }
+
+  // Logs a set of values to the info stream of the logger, for messages
+  // that are only interesting while debugging, e.g. on hot paths.
+  template <typename... Args>
+  void LogVerbose(Args... args) {
+#if LOG_MIN_LEVEL <= LOG_LEVEL_VERBOSE
     std::ostringstream str;
     LogHelper(&str, args...);
     str << "\n";
     LogInfoString(str.str().c_str());
+#endif
   }
 
  private:
@@ -125,7 +155,9 @@ class Logger {
   virtual void Flush() {}
 };
 
-// Returns a platform-specific logger.
+// Returns a platform-specific logger. Info messages are written by a
+// background thread, and errors right away, after everything that was
+// logged before them.
 containers::unique_ptr<Logger> GetLogger(containers::Allocator* allocator);
 }  // namespace logging
 
@@ -0,0 +1,53 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MATH_BATCH_H_
+#define _MATH_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "math_common.h"
+
+// Kernels that update many transforms at once on the CPU. They use SSE on
+// x86 and NEON on ARM, and plain C++ everywhere else. Points and spheres
+// are passed as structures of arrays, one array per component, so that four
+// of them are processed per instruction. None of the arrays have to be
+// aligned, and the outputs may point straight into mapped memory.
+
+// Writes lhs * rhs[i] for every i, column-major, to |out|, with
+// |out_stride| bytes from the start of one matrix to the next. This is
+// e.g. sizeof(Mat44) for an array of matrices in a storage buffer, or the
+// dynamic offset alignment for per-object uniform buffers.
+void BatchMultiplyMatrices(const Mat44& lhs, const Mat44* rhs, size_t count,
+                           void* out, size_t out_stride);
+
+// Transforms the points (x[i], y[i], z[i], 1) by |matrix|, and writes the
+// x, y and z of the results, without dividing by w. The outputs may be the
+// same arrays as the inputs.
+void BatchTransformPoints(const Mat44& matrix, const float* x, const float* y,
+                          const float* z, size_t count, float* out_x,
+                          float* out_y, float* out_z);
+
+// Tests the spheres around (x[i], y[i], z[i]) with |radius[i]| against
+// the 6 planes of a frustum, where (a, b, c, d) is a plane with
+// a * x + b * y + c * z + d >= 0 on the inside. Writes the indices of the
+// spheres that are at least partly inside to |visible|, in order, and
+// returns how many there are. |visible| has to have room for |count|.
+size_t BatchCullSpheres(const Vector4 planes[6], const float* x,
+                        const float* y, const float* z, const float* radius,
+                        size_t count, uint32_t* visible);
+
+#endif  // _MATH_BATCH_H_
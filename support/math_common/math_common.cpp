@@ -13,4 +13,203 @@
  * limitations under the License.
  */
 
-// Intentionally empty, just used so CMake generates a library.
\ No newline at end of file
+#include "include/math_batch.h"
+
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MATH_BATCH_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MATH_BATCH_NEON
+#endif
+
+namespace {
+// A minimal set of 4-wide float operations, so that every kernel is only
+// written once.
+#if defined(MATH_BATCH_SSE)
+using Float4 = __m128;
+inline Float4 Load(const float* f) { return _mm_loadu_ps(f); }
+inline void Store(float* f, Float4 v) { _mm_storeu_ps(f, v); }
+inline Float4 Splat(float f) { return _mm_set1_ps(f); }
+inline Float4 Add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+inline Float4 MulAdd(Float4 a, Float4 b, Float4 c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+inline Float4 Negate(Float4 a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+// Returns a bit per lane, that is set if a >= b.
+inline uint32_t GreaterEqualMask(Float4 a, Float4 b) {
+  return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(a, b)));
+}
+#elif defined(MATH_BATCH_NEON)
+using Float4 = float32x4_t;
+inline Float4 Load(const float* f) { return vld1q_f32(f); }
+inline void Store(float* f, Float4 v) { vst1q_f32(f, v); }
+inline Float4 Splat(float f) { return vdupq_n_f32(f); }
+inline Float4 Add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+inline Float4 MulAdd(Float4 a, Float4 b, Float4 c) {
+  return vmlaq_f32(c, a, b);
+}
+inline Float4 Negate(Float4 a) { return vnegq_f32(a); }
+inline uint32_t GreaterEqualMask(Float4 a, Float4 b) {
+  uint32_t lanes[4];
+  vst1q_u32(lanes, vcgeq_f32(a, b));
+  return (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+}
+#else
+struct Float4 {
+  float v[4];
+};
+inline Float4 Load(const float* f) { return Float4{{f[0], f[1], f[2], f[3]}}; }
+inline void Store(float* f, Float4 v) { memcpy(f, v.v, sizeof(v.v)); }
+inline Float4 Splat(float f) { return Float4{{f, f, f, f}}; }
+inline Float4 Add(Float4 a, Float4 b) {
+  return Float4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2],
+                 a.v[3] + b.v[3]}};
+}
+inline Float4 Mul(Float4 a, Float4 b) {
+  return Float4{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2],
+                 a.v[3] * b.v[3]}};
+}
+inline Float4 MulAdd(Float4 a, Float4 b, Float4 c) { return Add(Mul(a, b), c); }
+inline Float4 Negate(Float4 a) {
+  return Float4{{-a.v[0], -a.v[1], -a.v[2], -a.v[3]}};
+}
+inline uint32_t GreaterEqualMask(Float4 a, Float4 b) {
+  return (a.v[0] >= b.v[0] ? 1 : 0) | (a.v[1] >= b.v[1] ? 2 : 0) |
+         (a.v[2] >= b.v[2] ? 4 : 0) | (a.v[3] >= b.v[3] ? 8 : 0);
+}
+#endif
+
+// Copies |matrix| to 16 floats, column-major.
+inline void ToColumnMajor(const Mat44& matrix, float* out) {
+  for (int column = 0; column < 4; ++column) {
+    for (int row = 0; row < 4; ++row) {
+      out[column * 4 + row] = matrix(row, column);
+    }
+  }
+}
+
+// Copies |count| < 4 floats from |in|, and pads them with the last one, so
+// that the tail of an array can go through the same 4-wide code.
+inline void LoadTail(const float* in, size_t count, float* out) {
+  for (size_t i = 0; i < 4; ++i) {
+    out[i] = in[i < count ? i : count - 1];
+  }
+}
+}  // anonymous namespace
+
+void BatchMultiplyMatrices(const Mat44& lhs, const Mat44* rhs, size_t count,
+                           void* out, size_t out_stride) {
+  float l[16];
+  ToColumnMajor(lhs, l);
+  const Float4 l0 = Load(l);
+  const Float4 l1 = Load(l + 4);
+  const Float4 l2 = Load(l + 8);
+  const Float4 l3 = Load(l + 12);
+  char* dst = static_cast<char*>(out);
+  for (size_t i = 0; i < count; ++i, dst += out_stride) {
+    float r[16];
+    ToColumnMajor(rhs[i], r);
+    float* result = reinterpret_cast<float*>(dst);
+    // Every column of the result is a combination of the columns of lhs.
+    for (size_t column = 0; column < 4; ++column) {
+      const float* c = r + column * 4;
+      Float4 v = Mul(l0, Splat(c[0]));
+      v = MulAdd(l1, Splat(c[1]), v);
+      v = MulAdd(l2, Splat(c[2]), v);
+      v = MulAdd(l3, Splat(c[3]), v);
+      Store(result + column * 4, v);
+    }
+  }
+}
+
+void BatchTransformPoints(const Mat44& matrix, const float* x, const float* y,
+                          const float* z, size_t count, float* out_x,
+                          float* out_y, float* out_z) {
+  Float4 m[3][4];
+  for (int row = 0; row < 3; ++row) {
+    for (int column = 0; column < 4; ++column) {
+      m[row][column] = Splat(matrix(row, column));
+    }
+  }
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const Float4 px = Load(x + i);
+    const Float4 py = Load(y + i);
+    const Float4 pz = Load(z + i);
+    // All of the inputs are loaded before anything is stored, so the
+    // outputs may alias them.
+    Float4 results[3];
+    for (int row = 0; row < 3; ++row) {
+      Float4 v = MulAdd(m[row][0], px, m[row][3]);
+      v = MulAdd(m[row][1], py, v);
+      results[row] = MulAdd(m[row][2], pz, v);
+    }
+    Store(out_x + i, results[0]);
+    Store(out_y + i, results[1]);
+    Store(out_z + i, results[2]);
+  }
+  for (; i < count; ++i) {
+    const float px = x[i];
+    const float py = y[i];
+    const float pz = z[i];
+    out_x[i] = matrix(0, 0) * px + matrix(0, 1) * py + matrix(0, 2) * pz +
+               matrix(0, 3);
+    out_y[i] = matrix(1, 0) * px + matrix(1, 1) * py + matrix(1, 2) * pz +
+               matrix(1, 3);
+    out_z[i] = matrix(2, 0) * px + matrix(2, 1) * py + matrix(2, 2) * pz +
+               matrix(2, 3);
+  }
+}
+
+size_t BatchCullSpheres(const Vector4 planes[6], const float* x,
+                        const float* y, const float* z, const float* radius,
+                        size_t count, uint32_t* visible) {
+  Float4 p[6][4];
+  for (int plane = 0; plane < 6; ++plane) {
+    for (int component = 0; component < 4; ++component) {
+      p[plane][component] = Splat(planes[plane][component]);
+    }
+  }
+  size_t num_visible = 0;
+  for (size_t i = 0; i < count; i += 4) {
+    const size_t lanes = count - i < 4 ? count - i : 4;
+    Float4 cx, cy, cz, r;
+    if (lanes == 4) {
+      cx = Load(x + i);
+      cy = Load(y + i);
+      cz = Load(z + i);
+      r = Load(radius + i);
+    } else {
+      float tail[4];
+      LoadTail(x + i, lanes, tail);
+      cx = Load(tail);
+      LoadTail(y + i, lanes, tail);
+      cy = Load(tail);
+      LoadTail(z + i, lanes, tail);
+      cz = Load(tail);
+      LoadTail(radius + i, lanes, tail);
+      r = Load(tail);
+    }
+    const Float4 negative_radius = Negate(r);
+    uint32_t inside = 0xF;
+    for (int plane = 0; plane < 6 && inside; ++plane) {
+      Float4 distance = MulAdd(p[plane][0], cx, p[plane][3]);
+      distance = MulAdd(p[plane][1], cy, distance);
+      distance = MulAdd(p[plane][2], cz, distance);
+      inside &= GreaterEqualMask(distance, negative_radius);
+    }
+    inside &= (1u << lanes) - 1;
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      if (inside & (1u << lane)) {
+        visible[num_visible++] = static_cast<uint32_t>(i + lane);
+      }
+    }
+  }
+  return num_visible;
+}
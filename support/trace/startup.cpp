@@ -0,0 +1,83 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/trace/startup.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace trace {
+namespace {
+// Phases after this many different names are not timed.
+const size_t kMaxPhases = 32;
+
+struct Phase {
+  const char* name;
+  uint32_t count;
+  int64_t total_ns;
+};
+
+// The start of the process, as close as static initialization gets to it.
+const int64_t g_process_start_ns = NowNanoseconds();
+std::atomic<bool> g_in_startup(true);
+// Guards g_phases and g_num_phases.
+std::mutex g_phase_mutex;
+Phase g_phases[kMaxPhases];
+size_t g_num_phases = 0;
+}  // anonymous namespace
+
+void AddStartupPhase(const char* name, int64_t begin_ns, int64_t end_ns) {
+  if (!in_startup()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(g_phase_mutex);
+  size_t i = 0;
+  while (i < g_num_phases && strcmp(g_phases[i].name, name) != 0) {
+    ++i;
+  }
+  if (i == g_num_phases) {
+    if (g_num_phases == kMaxPhases) {
+      return;
+    }
+    g_phases[g_num_phases++] = {
+        name,  // name
+        0,     // count
+        0      // total_ns
+    };
+  }
+  g_phases[i].count += 1;
+  g_phases[i].total_ns += end_ns - begin_ns;
+}
+
+bool in_startup() { return g_in_startup.load(std::memory_order_relaxed); }
+
+void EndStartup(logging::Logger* log) {
+  if (!g_in_startup.exchange(false)) {
+    return;
+  }
+  const int64_t first_frame_ns = NowNanoseconds() - g_process_start_ns;
+  std::lock_guard<std::mutex> lock(g_phase_mutex);
+  // Do not modify these lines, scripts may look for them in the output.
+  for (size_t i = 0; i < g_num_phases; ++i) {
+    const Phase& phase = g_phases[i];
+    log->LogInfo("STARTUP: ", phase.name, " ", phase.total_ns / 1.0e6,
+                 " ms (", phase.count, "x)");
+  }
+  log->LogInfo("STARTUP: Time to first frame ", first_frame_ns / 1.0e6,
+               " ms");
+}
+
+}  // namespace trace
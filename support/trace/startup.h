@@ -0,0 +1,72 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_TRACE_STARTUP_H_
+#define SUPPORT_TRACE_STARTUP_H_
+
+#include <cstdint>
+
+#include "support/log/log.h"
+#include "support/trace/trace.h"
+
+// Measures where the time between the start of the process and its first
+// frame goes. Every phase of bring-up is timed with STARTUP_PHASE, and the
+// times of phases with the same name are summed up, e.g. for every pipeline
+// that is created. Once the first frame is out, EndStartup() logs every
+// phase and the time to the first frame, and stops timing phases.
+//
+// Phases may nest, and run on several threads at once, so their times do
+// not add up to the time to the first frame.
+namespace trace {
+
+// Adds a phase |name| from |begin_ns| to |end_ns|, in the clock of
+// NowNanoseconds(), unless startup has already ended. |name| must be a
+// string literal.
+void AddStartupPhase(const char* name, int64_t begin_ns, int64_t end_ns);
+
+// Returns true until EndStartup() is called.
+bool in_startup();
+
+// Logs the time of every startup phase, and the time from the start of the
+// process to now, the first time it is called. Later calls do nothing.
+void EndStartup(logging::Logger* log);
+
+// Times a startup phase from its construction until it is destroyed, which
+// is also recorded as a zone.
+class StartupPhase {
+ public:
+  explicit StartupPhase(const char* name)
+      : name_(in_startup() || enabled() ? name : nullptr),
+        begin_ns_(name_ ? NowNanoseconds() : 0) {}
+  ~StartupPhase() {
+    if (name_) {
+      const int64_t end_ns = NowNanoseconds();
+      AddStartupPhase(name_, begin_ns_, end_ns);
+      AddZone(name_, begin_ns_, end_ns);
+    }
+  }
+
+ private:
+  const char* name_;
+  int64_t begin_ns_;
+};
+
+}  // namespace trace
+
+// Times the rest of the enclosing scope as the startup phase |name|.
+#define STARTUP_PHASE(name) \
+  ::trace::StartupPhase TRACE_CONCAT(startup_phase_, __LINE__)(name)
+
+#endif  // SUPPORT_TRACE_STARTUP_H_
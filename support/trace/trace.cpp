@@ -0,0 +1,166 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/trace/trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+namespace trace {
+namespace {
+// Once a thread has recorded this many events, its oldest ones are
+// overwritten.
+const size_t kEventsPerThread = 1 << 16;
+// Threads that start recording after this many have are not traced.
+const size_t kMaxThreads = 64;
+
+struct Event {
+  const char* name;
+  uint32_t track;
+  int64_t begin_ns;
+  int64_t end_ns;
+};
+
+// Only the owning thread writes to a ThreadBuffer, Stop() reads it.
+struct ThreadBuffer {
+  uint32_t thread_id;
+  std::atomic<uint64_t> num_written;
+  Event events[kEventsPerThread];
+};
+
+std::atomic<bool> g_enabled(false);
+// Incremented by every Start(), so that threads notice that the buffer they
+// had belongs to an earlier recording.
+std::atomic<uint32_t> g_generation(0);
+containers::Allocator* g_allocator = nullptr;
+// Guards g_buffers and g_num_buffers.
+std::mutex g_mutex;
+ThreadBuffer* g_buffers[kMaxThreads];
+size_t g_num_buffers = 0;
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+thread_local uint32_t t_generation = 0;
+
+// Returns the buffer of the calling thread, or nullptr if there are too
+// many threads.
+ThreadBuffer* GetThreadBuffer() {
+  const uint32_t generation = g_generation.load(std::memory_order_acquire);
+  if (t_generation == generation) {
+    return t_buffer;
+  }
+  std::lock_guard<std::mutex> lock(g_mutex);
+  t_generation = generation;
+  t_buffer = nullptr;
+  if (g_allocator && g_num_buffers < kMaxThreads) {
+    t_buffer = g_allocator->construct<ThreadBuffer>();
+    t_buffer->thread_id = static_cast<uint32_t>(g_num_buffers);
+    t_buffer->num_written.store(0);
+    g_buffers[g_num_buffers++] = t_buffer;
+  }
+  return t_buffer;
+}
+
+void Record(const char* name, uint32_t track, int64_t begin_ns,
+            int64_t end_ns) {
+  if (!g_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  ThreadBuffer* buffer = GetThreadBuffer();
+  if (!buffer) {
+    return;
+  }
+  const uint64_t index = buffer->num_written.load(std::memory_order_relaxed);
+  buffer->events[index % kEventsPerThread] = {
+      name,      // name
+      track,     // track
+      begin_ns,  // begin_ns
+      end_ns     // end_ns
+  };
+  buffer->num_written.store(index + 1, std::memory_order_release);
+}
+}  // anonymous namespace
+
+void Start(containers::Allocator* allocator) {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_allocator = allocator;
+  g_generation.fetch_add(1, std::memory_order_release);
+  g_enabled.store(true);
+}
+
+void Stop(const char* location, logging::Logger* log) {
+  g_enabled.store(false);
+  std::lock_guard<std::mutex> lock(g_mutex);
+  if (location) {
+    std::ofstream out_file(location);
+    out_file << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+    bool first = true;
+    bool has_gpu_track = false;
+    for (size_t i = 0; i < g_num_buffers; ++i) {
+      const ThreadBuffer* buffer = g_buffers[i];
+      const uint64_t num_written =
+          buffer->num_written.load(std::memory_order_acquire);
+      const uint64_t begin =
+          num_written > kEventsPerThread ? num_written - kEventsPerThread : 0;
+      for (uint64_t j = begin; j < num_written; ++j) {
+        const Event& event = buffer->events[j % kEventsPerThread];
+        const uint32_t tid =
+            event.track != 0 ? event.track : buffer->thread_id;
+        has_gpu_track |= event.track == kGpuTrack;
+        out_file << (first ? "\n" : ",\n") << "  {\"name\": \"" << event.name
+                 << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << tid
+                 << ", \"ts\": " << event.begin_ns / 1000.0
+                 << ", \"dur\": " << (event.end_ns - event.begin_ns) / 1000.0
+                 << "}";
+        first = false;
+      }
+    }
+    if (has_gpu_track) {
+      out_file << (first ? "\n" : ",\n")
+               << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+                  "\"tid\": "
+               << kGpuTrack << ", \"args\": {\"name\": \"GPU\"}}";
+    }
+    out_file << "\n]}\n";
+    LOG_ASSERT(==, log, false, out_file.bad());
+    log->LogInfo("Wrote trace to \"", location, "\"");
+  }
+  for (size_t i = 0; i < g_num_buffers; ++i) {
+    g_allocator->destroy(g_buffers[i]);
+  }
+  g_num_buffers = 0;
+  g_allocator = nullptr;
+}
+
+bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+int64_t NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void AddZone(const char* name, int64_t begin_ns, int64_t end_ns) {
+  Record(name, 0, begin_ns, end_ns);
+}
+
+void AddZoneOnTrack(const char* name, uint32_t track, int64_t begin_ns,
+                    int64_t end_ns) {
+  Record(name, track, begin_ns, end_ns);
+}
+
+}  // namespace trace
@@ -0,0 +1,79 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_TRACE_TRACE_H_
+#define SUPPORT_TRACE_TRACE_H_
+
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+#include "support/log/log.h"
+
+// A process-wide recorder of timed zones, written out in the Chrome
+// trace-event JSON format that chrome://tracing and Perfetto load.
+// Every thread records into its own fixed ring of events, so recording a
+// zone never takes a lock or allocates, apart from the first zone of each
+// thread. Zone names must be string literals, or otherwise outlive Stop().
+namespace trace {
+
+// The track that GPU zones are shown on, instead of a thread.
+const uint32_t kGpuTrack = 0x10000;
+
+// Starts recording. The per-thread rings are allocated from |allocator|.
+void Start(containers::Allocator* allocator);
+// Stops recording, writes everything that was recorded to |location| unless
+// it is nullptr, and frees the rings. No other thread may record zones
+// while this runs.
+void Stop(const char* location, logging::Logger* log);
+// Returns true between Start() and Stop().
+bool enabled();
+
+// Returns the current time of std::chrono::steady_clock in nanoseconds,
+// the clock that all zones are in.
+int64_t NowNanoseconds();
+
+// Records a zone on the calling thread.
+void AddZone(const char* name, int64_t begin_ns, int64_t end_ns);
+// Records a zone on |track|, e.g. kGpuTrack, from the calling thread.
+void AddZoneOnTrack(const char* name, uint32_t track, int64_t begin_ns,
+                    int64_t end_ns);
+
+// Records a zone on the calling thread from its construction until it is
+// destroyed.
+class Zone {
+ public:
+  explicit Zone(const char* name)
+      : name_(enabled() ? name : nullptr),
+        begin_ns_(name_ ? NowNanoseconds() : 0) {}
+  ~Zone() {
+    if (name_) {
+      AddZone(name_, begin_ns_, NowNanoseconds());
+    }
+  }
+
+ private:
+  const char* name_;
+  int64_t begin_ns_;
+};
+
+}  // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Records the rest of the enclosing scope as the zone |name|.
+#define TRACE_ZONE(name) \
+  ::trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+
+#endif  // SUPPORT_TRACE_TRACE_H_
@@ -23,6 +23,22 @@ from threading import Thread
 from Queue import Queue, Empty
 
 
+def device_environment(program_args):
+    '''Returns the environment for the commands that talk to the device of
+    program_args.
+
+    If program_args has a .serial member that is not None, adb and gapit
+    only talk to the device with that serial, otherwise they use the default
+    device, and None is returned.
+    '''
+    serial = getattr(program_args, 'serial', None)
+    if serial is None:
+        return None
+    env = os.environ.copy()
+    env['ANDROID_SERIAL'] = serial
+    return env
+
+
 def adb(params, program_args):
     '''Runs a single command through ADB.
 
@@ -38,12 +54,13 @@ def adb(params, program_args):
     '''
     args = ['adb']
     args.extend(params)
+    env = device_environment(program_args)
     if program_args.verbose:
         print args
-        subprocess.check_call(args)
+        subprocess.check_call(args, env=env)
     else:
         subprocess.check_call(
-            args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            args, stdout=subprocess.PIPE, stderr=subprocess.PIPE, env=env)
 
 
 def adb_stream(params, program_args):
@@ -62,7 +79,8 @@ def adb_stream(params, program_args):
     args.extend(params)
     if program_args.verbose:
         print args
-    return subprocess.Popen(args, stdout=subprocess.PIPE)
+    return subprocess.Popen(args, stdout=subprocess.PIPE,
+                            env=device_environment(program_args))
 
 
 def install_apk(apk_info, program_args):
@@ -0,0 +1,102 @@
+#!/usr/bin/python
+# Copyright 2017 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+'''This measures the Vulkan calls of every frame of a trace, and checks
+them against budgets.
+
+A frame is every call up to, and including, a vkQueuePresentKHR. The first
+frames of a trace create everything that the sample needs, so only the
+frames after them, the steady state, are measured, and the most that any
+of those frames used is what is checked.
+'''
+
+import json
+import os
+
+from gapit_trace_reader import get_trace_index, TraceReader
+
+VK_WHOLE_SIZE = 0xffffffffffffffff
+
+# What is measured for every frame, and checked against the budgets.
+# calls: every Vulkan command
+# submits: the VkSubmitInfos of every vkQueueSubmit
+# maps: the calls of vkMapMemory
+# upload_bytes: the data of vkCmdUpdateBuffer, and the size of the memory
+#   of vkMapMemory, unless the whole memory is mapped
+STATS = ['calls', 'submits', 'maps', 'upload_bytes']
+
+
+def parse_int(value):
+    '''Returns the integer of a parameter, or 0 if it is not one'''
+    try:
+        return int(value, 0)
+    except (TypeError, ValueError):
+        return 0
+
+
+def frame_stats(capture_name):
+    '''Returns a dictionary of STATS for every frame of the trace'''
+    frames = []
+    frame = dict.fromkeys(STATS, 0)
+    for atom in TraceReader(get_trace_index(capture_name)):
+        # Skips the commands of gapii, e.g. switchThread.
+        if not atom.name.startswith('vk'):
+            continue
+        frame['calls'] += 1
+        if atom.name == 'vkQueueSubmit':
+            frame['submits'] += parse_int(atom.parameters.get('submitCount'))
+        elif atom.name == 'vkCmdUpdateBuffer':
+            frame['upload_bytes'] += parse_int(
+                atom.parameters.get('dataSize'))
+        elif atom.name == 'vkMapMemory':
+            frame['maps'] += 1
+            size = parse_int(atom.parameters.get('size'))
+            if size != VK_WHOLE_SIZE:
+                frame['upload_bytes'] += size
+        elif atom.name == 'vkQueuePresentKHR':
+            frames.append(frame)
+            frame = dict.fromkeys(STATS, 0)
+    return frames
+
+
+def steady_state(frames, warmup_frames):
+    '''Returns the most of every stat that a frame after the first
+    warmup_frames used, or None if there are no such frames'''
+    steady = frames[warmup_frames:]
+    if not steady:
+        return None
+    return dict((stat, max(frame[stat] for frame in steady))
+                for stat in STATS)
+
+
+def over_budget(measured, budget):
+    '''Returns a message for every stat that is over its budget'''
+    return ['{} per frame grew from {} to {}'.format(
+        stat, budget[stat], measured[stat])
+        for stat in STATS if stat in budget and measured[stat] > budget[stat]]
+
+
+def load_budgets(filename):
+    '''Returns the budgets of every sample, by the name of the sample'''
+    if not os.path.isfile(filename):
+        return {}
+    with open(filename, 'r') as f:
+        return json.load(f)
+
+
+def save_budgets(filename, budgets):
+    '''Writes the budgets of every sample'''
+    with open(filename, 'w') as f:
+        json.dump(budgets, f, indent=2, sort_keys=True, separators=(',', ': '))
+        f.write('\n')
@@ -16,15 +16,18 @@
 
 This runs a given APK on the connected Android device. It makes assumptions
 about log output and package names that means it is only useful
-for this repository
+for this repository. Given several APKs and devices, the APKs are shared
+out between the devices and run concurrently.
 '''
 
 import argparse
+import copy
 import os
 import subprocess
 import sys
 
 import android
+import test_scheduler
 
 
 def run_on_single_apk(apk, args):
@@ -40,20 +43,48 @@ def run_on_single_apk(apk, args):
     android.adb(['shell', 'am', 'force-stop', apk_info.package_name], args)
     if not args.keep:
         android.adb(['uninstall', apk_info.package_name], args)
-    sys.exit(return_value)
+    return return_value
 
 
 def main():
     parser = argparse.ArgumentParser(
         description='Run a .apk file on an android device')
-    parser.add_argument('apk', help='apk to run')
+    parser.add_argument('apk', nargs='+', help='apks to run')
     parser.add_argument(
         '--keep', action='store_true', help='do not uninstall on completion')
     parser.add_argument(
         '--verbose', action='store_true', help='enable verbose output')
+    parser.add_argument(
+        '--devices',
+        help='comma separated serials of the devices to run on, or "all" '
+        'for every attached device')
+    parser.add_argument(
+        '--durations-file',
+        help='json file with the durations of earlier runs, which is updated')
     args = parser.parse_args()
-    run_on_single_apk(args.apk, args)
+
+    devices = test_scheduler.parse_devices(args.devices, False, 1)
+    history = test_scheduler.DurationHistory(args.durations_file)
+    return_values = {}
+
+    def run(apk, serial):
+        device_args = copy.copy(args)
+        device_args.serial = serial
+        return run_on_single_apk(apk, device_args)
+
+    def done(apk, return_value):
+        return_values[apk] = return_value
+        if len(args.apk) > 1:
+            print '{}: {}'.format(apk, return_value)
+
+    test_scheduler.run_sharded(args.apk, devices, history, run, done)
+    history.save()
+    # A single apk returns its own return value, several the number of them
+    # that failed.
+    if len(args.apk) == 1:
+        return return_values[args.apk[0]]
+    return len([v for v in return_values.values() if v != 0])
 
 
 if __name__ == '__main__':
-    main()
+    sys.exit(main())
@@ -25,6 +25,8 @@ import sys
 
 from gapit_tester import run_on_single_apk
 from gapit_tester import RunArgs
+import api_call_budgets
+import test_scheduler
 
 SUCCESS = 0
 FAILURE = 1
@@ -54,6 +56,23 @@ class TestManager(object):
         self.failed_tests = []
         self.warned_tests = []
         self.skipped_tests = []
+        self.capture_frames = 10
+        # The budgets of every sample, or None to compare the replay
+        # instead, and what every sample measured.
+        self.call_budgets = None
+        self.measured_calls = {}
+        self.warmup_frames = 0
+
+    def enable_call_budgets(self, budgets, frames, warmup_frames):
+        '''Checks the Vulkan calls of every frame of every sample against
+        budgets instead of the replay. frames frames are measured, after
+        warmup_frames frames that are not. Only whole runs are measured.'''
+        self.call_budgets = budgets
+        self.capture_frames = warmup_frames + frames
+        self.warmup_frames = warmup_frames
+        for test_name in list(self.tests):
+            if self.tests[test_name].mid_execution:
+                del self.tests[test_name]
 
     def gather_all_tests(self, include_regex, exclude_regex):
         '''Finds all tests in the samples.txt file.'''
@@ -80,9 +99,12 @@ class TestManager(object):
         """Adds a test case to the manager from the given apk"""
         self.tests[test_name] = Test(test_executable, mid_execution)
 
-    def run_apk(self, verbose, test_name, apk_name, capture_name, mid_execution):
+    def run_apk(self, verbose, test_name, apk_name, capture_name, mid_execution,
+                serial):
         args = RunArgs()
-        additional_args = ["-observe-frames", "1", "-capture-frames", "10"]
+        args.set_serial(serial)
+        additional_args = ["-observe-frames", "1", "-capture-frames",
+                           str(self.capture_frames)]
         if mid_execution:
             additional_args.extend(["-start-at-frame", "100"])
 
@@ -122,7 +144,8 @@ class TestManager(object):
             # TODO: Test with 1000 x 1000 on latest Nvidia driver again.
             gapit_args.extend(['-additionalargs', '-w=1024 -h=1024'])
             gapit_args.extend([
-                "-observe-frames", "1", "-capture-frames", "10"])
+                "-observe-frames", "1", "-capture-frames",
+                str(self.capture_frames)])
             if mid_execution:
                 gapit_args.extend(["-start-at-frame", "100"])
             if verbose:
@@ -139,7 +162,9 @@ class TestManager(object):
         print "[ " + "DONE".center(10) + " ] " + test_name
         return (SUCCESS, "")
 
-    def run_test(self, test_name, verbose, host, temp_directory):
+    def run_test(self, test_name, verbose, host, temp_directory, serial=None):
+        '''Runs the given test, on the android device with the given serial,
+        or the default one if it is None.'''
         capture_name = os.path.join(
             temp_directory, test_name + ".gfxtrace")
         if host:
@@ -151,10 +176,12 @@ class TestManager(object):
             success, error = self.run_apk(verbose, test_name, os.path.join(
                 self.root_directory, self.tests[
                     test_name].executable + ".apk"), capture_name,
-                self.tests[test_name].mid_execution)
+                self.tests[test_name].mid_execution, serial)
         if not success == SUCCESS:
             return (success, error)
         print "[ " + "RUN".ljust(10) + " ] " + test_name
+        if self.call_budgets is not None:
+            return self.check_call_budget(test_name, capture_name)
 
         video_flags = ["gapit", "video", "-out",
                        os.path.join(temp_directory, test_name + ".mp4"),
@@ -181,12 +208,41 @@ class TestManager(object):
         print "[ " + "OK".rjust(10) + " ] " + test_name
         return SUCCESS, ""
 
-    def run_all_tests(self, temp_directory):
-        """Runs all of the tests"""
-        for test in sorted(self.tests):
-            self.accumulate_result(
-                test, self.run_test(test, self.verbose, self.host,
-                                    temp_directory))
+    def check_call_budget(self, test_name, capture_name):
+        '''Measures the steady state frames of the trace, and checks them
+        against the budget of the sample.'''
+        measured = api_call_budgets.steady_state(
+            api_call_budgets.frame_stats(capture_name), self.warmup_frames)
+        if measured is None:
+            print "[ " + "FAILED".rjust(10) + " ] " + test_name
+            return (FAILURE, "The trace has no frames after the warmup")
+        self.measured_calls[test_name] = measured
+        print "     " + ", ".join(
+            "{}: {}".format(stat, measured[stat])
+            for stat in api_call_budgets.STATS)
+        if test_name not in self.call_budgets:
+            print "[ " + "WARNING".rjust(10) + " ] " + test_name
+            print "     There is no budget for " + test_name
+            return (WARNING, "")
+        errors = api_call_budgets.over_budget(
+            measured, self.call_budgets[test_name])
+        if errors:
+            print "[ " + "FAILED".rjust(10) + " ] " + test_name
+            error_msg = "\n".join(errors)
+            print error_msg
+            return (FAILURE, error_msg)
+        print "[ " + "OK".rjust(10) + " ] " + test_name
+        return SUCCESS, ""
+
+    def run_all_tests(self, temp_directory, devices, history):
+        '''Runs all of the tests, sharded across the devices, see
+        test_scheduler.run_sharded.'''
+        def run(test, device):
+            return self.run_test(test, self.verbose, self.host,
+                                 temp_directory, None if self.host else device)
+
+        test_scheduler.run_sharded(
+            sorted(self.tests), devices, history, run, self.accumulate_result)
 
     def accumulate_result(self, test_name, result):
         """Tracks the results for the given test"""
@@ -252,6 +308,47 @@ associated binaries. It will build its tests from there.
         "--keep",
         action="store_true",
         help="Do not delete output files")
+    parser.add_argument(
+        "--devices",
+        help="Comma separated serials of the android devices to run on, or "
+        "\"all\" for every attached device. The tests are shared out between "
+        "them and run concurrently")
+    parser.add_argument(
+        "--jobs",
+        type=int,
+        default=1,
+        help="With --host, the number of tests that run concurrently")
+    parser.add_argument(
+        "--durations-file",
+        help="Json file with the durations of earlier runs, which balances "
+        "the tests between the devices, and is updated. Defaults to "
+        "trace_replay_durations.json in the test directory")
+    parser.add_argument(
+        "--check-call-budgets",
+        action="store_true",
+        help="Instead of the replay, check the Vulkan calls and the uploads "
+        "of every frame of every sample against its budget")
+    parser.add_argument(
+        "--update-call-budgets",
+        action="store_true",
+        help="With --check-call-budgets, write what every sample measured "
+        "as its budget")
+    parser.add_argument(
+        "--call-budgets-file",
+        default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                             "..", "application_sandbox",
+                             "api_call_budgets.json"),
+        help="The budgets of every sample")
+    parser.add_argument(
+        "--budget-frames",
+        type=int,
+        default=10,
+        help="The number of frames that are checked against the budgets")
+    parser.add_argument(
+        "--warmup-frames",
+        type=int,
+        default=5,
+        help="The number of frames before the ones that are checked")
     args = parser.parse_args()
 
     test_directory = os.getcwd()
@@ -260,14 +357,28 @@ associated binaries. It will build its tests from there.
     manager = TestManager(
         test_directory, args.verbose, args.host)
     manager.gather_all_tests(args.include, args.exclude)
+    if args.check_call_budgets:
+        manager.enable_call_budgets(
+            api_call_budgets.load_budgets(args.call_budgets_file),
+            args.budget_frames, args.warmup_frames)
 
     if args.list_tests:
         manager.print_test_names(sys.stdout)
         return 0
     else:
+        devices = test_scheduler.parse_devices(
+            args.devices, args.host, args.jobs)
+        history = test_scheduler.DurationHistory(
+            args.durations_file or
+            os.path.join(test_directory, "trace_replay_durations.json"))
         temp_directory = tempfile.mkdtemp("", "GAPID_VIDEO-")
         print "Running tests in {}".format(temp_directory)
-        manager.run_all_tests(temp_directory)
+        manager.run_all_tests(temp_directory, devices, history)
+        history.save()
+        if args.check_call_budgets and args.update_call_budgets:
+            budgets = dict(manager.call_budgets)
+            budgets.update(manager.measured_calls)
+            api_call_budgets.save_budgets(args.call_budgets_file, budgets)
         if not args.keep:
             shutil.rmtree(temp_directory)
         return manager.print_summary_and_return_code()
@@ -29,8 +29,10 @@ from distutils.version import StrictVersion
 
 from gapit_tester import run_on_single_apk
 from gapit_tester import RunArgs
+import test_scheduler
 from gapit_trace_reader import get_device_and_architecture_info_from_trace_file
-from gapit_trace_reader import parse_trace_file, NamedAttributeError
+from gapit_trace_reader import get_trace_index, NamedAttributeError
+from gapit_trace_reader import TraceReader
 
 SUCCESS = 0
 FAILURE = 1
@@ -191,15 +193,11 @@ class GapitTest(object):
         not be found'''
         if self.verbose:
             print "Finding next {}".format(call_name)
-        try:
-            while True:
-                atom = self.atom_generator.next()
-                if atom.name == call_name:
-                    return (atom, "")
-                if self.verbose:
-                    print "Skipping {}".format(atom.name)
-        except StopIteration:
-            return (None, "Could not find atom of type " + call_name)
+        # The atoms in between are skipped without being parsed.
+        atom = self.atom_generator.next_of(call_name)
+        if atom:
+            return (atom, "")
+        return (None, "Could not find atom of type " + call_name)
 
     def nth_call_of(self, call_name, index):
         '''Consumes atoms until the nth call of the given type is found,
@@ -294,11 +292,12 @@ class GapitTest(object):
             return False
         return True
 
-    def run_apk(self, verbose, apk_name, capture_name):
+    def run_apk(self, verbose, apk_name, capture_name, serial):
         args = RunArgs()
         if verbose:
             args.set_verbose()
         args.set_output(capture_name)
+        args.set_serial(serial)
         setattr(args, "verbose", verbose)
         setattr(args, "keep", False)
         setattr(args, "output", [capture_name])
@@ -335,8 +334,9 @@ class GapitTest(object):
         print "[ " + "DONE".center(10) + " ] " + host_name
         return (SUCCESS, "")
 
-    def run_test(self, verbose, host, capture_directory):
-        '''Runs this test case. Returns a tuple,
+    def run_test(self, verbose, host, capture_directory, serial=None):
+        '''Runs this test case, on the android device with the given serial,
+            or the default one if it is None. Returns a tuple,
             (FAILURE|SUCCESS|WARNING, message) on completion.'''
 
         program_name = getattr(self, "gapit_test_name")
@@ -350,7 +350,7 @@ class GapitTest(object):
             # only do it once.
             if not host:
                 success, error = self.run_apk(
-                    verbose, program_name + ".apk", capture_name)
+                    verbose, program_name + ".apk", capture_name, serial)
             else:
                 success, error = self.run_host(
                     verbose, program_name, capture_name)
@@ -361,13 +361,12 @@ class GapitTest(object):
             capture_name)
         if self.architecture is None:
             return (FAILURE, "Failed to obtain device architecture info from trace")
-        self.atom_generator = parse_trace_file(capture_name)
+        self.atom_generator = TraceReader(get_trace_index(capture_name))
 
         def clear_atoms(status, message):
-            # Empty out all of the atoms in the generator, this way gapit can be
-            # killed.
-            for x in self.atom_generator:
-                pass
+            # The dump is shared by every test of the trace, so the atoms
+            # that were not read are just left unparsed.
+            self.atom_generator.close()
             return (status, message)
         print "[ " + "RUN".ljust(10) + " ] " + test_name
         try:
@@ -487,13 +486,24 @@ class TestManager(object):
             self.tests[program_name] = []
         self.tests[program_name].append((test_name, test))
 
-    def run_all_tests(self, temp_directory):
-        """Runs all of the tests"""
-        for apk in sorted(self.tests.keys()):
+    def run_all_tests(self, temp_directory, devices, history):
+        '''Runs all of the tests, sharded by apk across the devices, see
+        test_scheduler.run_sharded. All of the tests of an apk run on the
+        same device, since they share its trace.'''
+        def run(apk, device):
+            results = []
             for test in sorted(self.tests[apk], key=lambda x: x[0]):
-                self.accumulate_result(
-                    test[0], test[1].run_test(self.verbose, self.host,
-                                              temp_directory))
+                results.append((test[0], test[1].run_test(
+                    self.verbose, self.host, temp_directory,
+                    None if self.host else device)))
+            return results
+
+        def done(apk, results):
+            for test_name, result in results:
+                self.accumulate_result(test_name, result)
+
+        test_scheduler.run_sharded(
+            sorted(self.tests.keys()), devices, history, run, done)
 
     def accumulate_result(self, test_name, result):
         """Tracks the results for the given test"""
@@ -562,6 +572,21 @@ from a build.
         "--exclude",
         default="^$",
         help="Exclude tests that match this regular expression")
+    parser.add_argument(
+        "--devices",
+        help="Comma separated serials of the android devices to run on, or "
+        "\"all\" for every attached device. The tests are shared out between "
+        "them and run concurrently")
+    parser.add_argument(
+        "--jobs",
+        type=int,
+        default=1,
+        help="With --host, the number of tests that run concurrently")
+    parser.add_argument(
+        "--durations-file",
+        help="Json file with the durations of earlier runs, which balances "
+        "the tests between the devices, and is updated. Defaults to "
+        "gapit_test_durations.json in the test directory")
     args = parser.parse_args()
 
     test_directory = os.getcwd()
@@ -575,10 +600,16 @@ from a build.
         manager.print_test_names(sys.stdout)
         return 0
     else:
-        test_directory = tempfile.mkdtemp("", "GAPID-")
-        print "Running tests in {}".format(test_directory)
-        manager.run_all_tests(test_directory)
-        shutil.rmtree(test_directory)
+        devices = test_scheduler.parse_devices(
+            args.devices, args.host, args.jobs)
+        history = test_scheduler.DurationHistory(
+            args.durations_file or
+            os.path.join(test_directory, "gapit_test_durations.json"))
+        temp_directory = tempfile.mkdtemp("", "GAPID-")
+        print "Running tests in {}".format(temp_directory)
+        manager.run_all_tests(temp_directory, devices, history)
+        history.save()
+        shutil.rmtree(temp_directory)
         return manager.print_summary_and_return_code()
 
 
@@ -31,6 +31,7 @@ class RunArgs(object):
         self.output = None
         self.keep = False
         self.additional_params = []
+        self.serial = None
 
     def set_verbose(self):
         """Sets the verbose flag to true"""
@@ -48,10 +49,15 @@ class RunArgs(object):
         """Sets additional params to gapit"""
         self.additional_params = params
 
+    def set_serial(self, serial):
+        """Sets the serial of the android device to run on"""
+        self.serial = serial
+
     verbose = False
     output = None
     keep = False
     additional_params = []
+    serial = None
 
 
 def run_on_single_apk(apk, args):
@@ -76,12 +82,13 @@ def run_on_single_apk(apk, args):
     if args.verbose:
         print gapit_args
 
+    env = android.device_environment(args)
     if args.verbose:
-        gapit = subprocess.Popen(gapit_args)
+        gapit = subprocess.Popen(gapit_args, env=env)
     else:
         null_file = open(os.devnull, 'w')
         gapit = subprocess.Popen(
-            gapit_args, stdout=null_file, stderr=null_file)
+            gapit_args, stdout=null_file, stderr=null_file, env=env)
 
     return_value = android.watch_process(True, args, gapit)
     android.adb(['shell', 'am', 'force-stop', apk_info.package_name], args)
@@ -16,6 +16,7 @@
 """This contains functions for parsing a trace file using gapit dump."""
 
 import argparse
+import bisect
 import json
 import os
 import re
@@ -29,14 +30,29 @@ class Observation(object):
     '''A single observation.
 
     Contains the start, end and id of the observation as well as
-    the memory that was actually observed.'''
+    the memory that was actually observed. The memory can be given as the
+    hex string of the dump, which is only decoded once it is read, so that
+    the observations of atoms that no test looks at stay cheap.'''
 
     def __init__(self, observation_type, memory_start, memory_end, memory_id, data):
         self.type = observation_type
-        self.contents = data
         self.memory_start = memory_start
         self.memory_end = memory_end
         self.memory_id = memory_id
+        if isinstance(data, str):
+            self.hex_contents = data
+            self.decoded_contents = None
+        else:
+            self.hex_contents = None
+            self.decoded_contents = data
+
+    @property
+    def contents(self):
+        """ Returns the bytes of the observation, decoding them if needed"""
+        if self.decoded_contents is None:
+            self.decoded_contents = parse_memory_line(self.hex_contents)
+            self.hex_contents = None
+        return self.decoded_contents
 
     def __str__(self):
         val = "   {} : [{:016x} - {:016x}]\n{}".format(
@@ -381,11 +397,11 @@ def parse_observation(observation_type, start, end, line, atom):
     if observation_type == "R":
         atom.add_read_observation(
             int(start_match.group(1), 16), int(end_match.group(1), 16),
-                start_pool, parse_memory_line(line))
+                start_pool, line)
     else:
         atom.add_write_observation(
             int(start_match.group(1), 16), int(end_match.group(1), 16),
-                start_pool, parse_memory_line(line))
+                start_pool, line)
 
 
 def parse_memory_line(line):
@@ -404,6 +420,20 @@ NEW_ATOM = 2
 # MEMORY is the state we are in when we have finished reading the ATOM
 # and now we have to read all of the memory
 MEMORY = 3
+# OBSERVATION is the state we are in when we have read the range of an
+# observation, and the next line is its memory
+OBSERVATION = 4
+
+ATOM_LINE = re.compile(r'\[\d+\] ([a-zA-Z0-9]*)\(')
+OBSERVATION_LINE = re.compile(
+    r'\s*(R|W): \[((?:0x)?[0-9a-f]+) - ((?:0x)?[0-9a-f]+)\]')
+
+
+def is_valid_line(line):
+    ''' Returns false for the empty and log lines of gapit's output '''
+    if line == '\n' or line == '\r\n':
+        return False
+    return not re.match(r'\d\d?:\d\d?:\d\d?\.\d*.* <gapi\w>', line)
 
 
 def next_line(proc):
@@ -411,13 +441,66 @@ def next_line(proc):
 
     while True:
         line = proc.stdout.readline()
-        if line == '\n':
+        if not is_valid_line(line):
             continue
-        if line == '\r\n':
+        return line.strip("\r\n").strip()
+
+
+def valid_lines(stream, offset=0):
+    '''Yields (offset, line) for every valid line of the stream, where offset
+    is where the line starts, counting from the given offset.'''
+    for line in iter(stream.readline, ''):
+        line_offset = offset
+        offset += len(line)
+        if not is_valid_line(line):
             continue
-        if re.match(r'\d\d?:\d\d?:\d\d?\.\d*.* <gapi\w>', line):
+        line = line.strip("\r\n").strip()
+        # The pipe of gapit ends at the first blank line.
+        if line == '':
+            return
+        yield (line_offset, line)
+
+
+def parse_atoms(lines, state=FIRST_LINE):
+    '''Parses the (offset, line) pairs of a gapit dump, and yields every atom,
+    with its offset set to where its line started.
+
+    If the first line is known to be the line of an atom, state should be
+    NEW_ATOM, otherwise the lines up to the first atom are skipped.
+    '''
+    # Every atom has 3 parts:
+    # The first several lines are the number/name/parameters
+    # The second line is information about the read/write locations
+    # The subsequent lines are the memory contents of those read/write locations
+    #   IMPORTANT: These memory contents are what is present AFTER the
+    #              call is made, not before. So you cannot get information
+    #              about what the memory was before a call.
+    atom = None
+    observation = None
+    for offset, line in lines:
+        if state == FIRST_LINE:
+            # Only atom lines starts with an index number, and the first atom
+            # always has index value 0, so the string starts with '0' is the
+            # first atom line.
+            if not line.startswith('[0]'):
+                continue
+        elif state == OBSERVATION:
+            parse_observation(observation.group(1), observation.group(2),
+                              observation.group(3), line, atom)
+            state = MEMORY
             continue
-        return line.strip("\r\n").strip()
+        elif state == MEMORY:
+            observation = OBSERVATION_LINE.match(line)
+            if observation:
+                state = OBSERVATION
+                continue
+        if atom:
+            yield atom
+        atom = parse_atom_line(line)
+        atom.offset = offset
+        state = MEMORY
+    if atom:
+        yield atom
 
 
 def get_device_and_architecture_info_from_trace_file(filename):
@@ -490,51 +573,114 @@ def parse_trace_file(filename):
         ['gapit', '-log-level', 'Fatal', 'dump',
             '-observations-data', '-raw', filename],
         stdout=subprocess.PIPE, stderr=open(os.devnull, 'wb'))
-
-    # This parsing routine is basically a state machine
-    # The very first several lines of the process is un-necessary
-    # Every atom has 3 parts:
-    # The first several lines are the number/name/parameters
-    # The second line is information about the read/write locations
-    # The subsequent lines are the memory contents of those read/write locations
-    #   IMPORTANT: These memory contents are what is present AFTER the
-    #              call is made, not before. So you cannot get information
-    #              about what the memory was before a call.
-    num_read_observations = 0
-    num_write_observations = 0
-    current_memory_observation = 0
-    current_state = FIRST_LINE
-    atom = None
-    # readline keeps the newline on the end so EOF is when readline returns
-    # an empty string
-    line = next_line(proc)
-    while line != '':
-        if current_state == FIRST_LINE:
-            # Only atom lines starts with an index number, and the first atom
-            # always has index value 0, so the string starts with '0' is the
-            # first atom line.
-            if line.startswith('[0]'):
-                current_state = NEW_ATOM
-                continue
-        elif current_state == NEW_ATOM:
-            if atom:
-                yield atom
-            atom = parse_atom_line(line)
-            current_state = MEMORY
-        elif current_state == MEMORY:
-            match = re.match(
-                r'\s*(R|W): \[((?:0x)?[0-9a-f]+) - ((?:0x)?[0-9a-f]+)\]', line)
-            match_empty = re.match(r'\s*(R|W): \[0 - 0\]', line)
-            if not match:
-                current_state = NEW_ATOM
-                continue
-            line = next_line(proc)
-            parse_observation(
-                match.group(1), match.group(2), match.group(3), line, atom)
-        line = next_line(proc)
-    if atom:
+    for atom in parse_atoms(valid_lines(proc.stdout)):
         yield atom
     proc.kill()
+
+
+class TraceIndex(object):
+
+    '''The gapit dump of a trace file, with the offset of every atom by the
+    name of its command.
+
+    The dump is only made once, next to the trace file, and is re-made when
+    the trace file is newer than it. Only the offsets are kept in memory, so
+    that TraceReader can seek to the atoms that are needed, and parses
+    nothing else.'''
+
+    def __init__(self, filename):
+        self.dump_name = filename + '.dump'
+        if (not os.path.isfile(self.dump_name) or
+                os.path.getmtime(self.dump_name) < os.path.getmtime(filename)):
+            temp_name = self.dump_name + '.tmp'
+            with open(temp_name, 'wb') as dump:
+                subprocess.call(
+                    ['gapit', '-log-level', 'Fatal', 'dump',
+                        '-observations-data', '-raw', filename],
+                    stdout=dump, stderr=open(os.devnull, 'wb'))
+            os.rename(temp_name, self.dump_name)
+        self.offsets = {}
+        offset = 0
+        with open(self.dump_name, 'rb') as dump:
+            for line in dump:
+                match = ATOM_LINE.match(line)
+                if match:
+                    self.offsets.setdefault(match.group(1), []).append(offset)
+                offset += len(line)
+
+    def count(self, call_name):
+        """Returns the number of atoms of the given command"""
+        return len(self.offsets.get(call_name, []))
+
+    def next_offset_of(self, call_name, offset):
+        """Returns the offset of the first atom of the given command after
+        the given offset, or None if there is none"""
+        offsets = self.offsets.get(call_name, [])
+        i = bisect.bisect_right(offsets, offset)
+        if i == len(offsets):
+            return None
+        return offsets[i]
+
+
+TRACE_INDICES = {}
+
+
+def get_trace_index(filename):
+    '''Returns the TraceIndex of the given trace file, which is shared by
+    every test of the trace'''
+    mtime = os.path.getmtime(filename)
+    entry = TRACE_INDICES.get(filename)
+    if entry is None or entry[0] != mtime:
+        entry = (mtime, TraceIndex(filename))
+        TRACE_INDICES[filename] = entry
+    return entry[1]
+
+
+class TraceReader(object):
+
+    '''Reads the atoms of a TraceIndex in order, in bounded memory.
+
+    Iterating over it returns every atom, like parse_trace_file.
+    next_of seeks to the next atom of a command without parsing the atoms in
+    between.'''
+
+    def __init__(self, index):
+        self.index = index
+        self.dump = open(index.dump_name, 'rb')
+        # The offset of the last atom that was returned.
+        self.position = -1
+        self.atoms = parse_atoms(valid_lines(self.dump))
+
+    def __iter__(self):
+        return self
+
+    def next(self):
+        """Returns the next atom, raises StopIteration after the last one"""
+        atom = next(self.atoms)
+        self.position = atom.offset
+        return atom
+
+    __next__ = next
+
+    def next_of(self, call_name):
+        """Returns the next atom of the given command, skipping every other
+        one, or None if there is none"""
+        if self.dump.closed:
+            return None
+        offset = self.index.next_offset_of(call_name, self.position)
+        if offset is None:
+            self.close()
+            return None
+        self.dump.seek(offset)
+        self.atoms = parse_atoms(valid_lines(self.dump, offset), NEW_ATOM)
+        return self.next()
+
+    def close(self):
+        """Stops reading, every later read returns no atom"""
+        self.dump.close()
+        self.atoms = iter(())
+
+
 import time
 
 
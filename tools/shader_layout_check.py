@@ -0,0 +1,353 @@
+#!/usr/bin/python
+# Copyright 2017 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Writes compile-time checks of C++ structs against the structs of a shader.
+
+The input is a SPIR-V module, either binary or as the C initializer list that
+glslc -mfmt=c writes. For every struct of the module with named members, the
+output header defines CHECK_<STRUCT NAME>_LAYOUT(type), see
+vulkan_helpers/shader_layout.h, which checks that every member of |type| is at
+the offset that the SPIR-V member is decorated with.
+
+Each macro is preceded by the size of the struct in the shader, and the size
+it would have with the std140, std430 and scalar layouts, which shows how much
+a block shrinks with another layout.
+
+Executing this file with --test will run its tests.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+from struct_offsets import align_to_next
+
+SPIRV_MAGIC = 0x07230203
+
+OP_NAME = 5
+OP_MEMBER_NAME = 6
+OP_TYPE_BOOL = 20
+OP_TYPE_INT = 21
+OP_TYPE_FLOAT = 22
+OP_TYPE_VECTOR = 23
+OP_TYPE_MATRIX = 24
+OP_TYPE_ARRAY = 28
+OP_TYPE_RUNTIME_ARRAY = 29
+OP_TYPE_STRUCT = 30
+OP_CONSTANT = 43
+OP_DECORATE = 71
+OP_MEMBER_DECORATE = 72
+
+DECORATION_ROW_MAJOR = 4
+DECORATION_ARRAY_STRIDE = 6
+DECORATION_MATRIX_STRIDE = 7
+DECORATION_BUILT_IN = 11
+DECORATION_OFFSET = 35
+
+STD140, STD430, SCALAR = range(3)
+LAYOUT_NAMES = {STD140: "std140", STD430: "std430", SCALAR: "scalar"}
+
+
+def read_words(data):
+    """Returns the words of |data|, a binary SPIR-V module, or the text of a
+    C initializer list of its words."""
+    if len(data) >= 4 and struct.unpack("<I", data[:4])[0] == SPIRV_MAGIC:
+        return list(struct.unpack("<%dI" % (len(data) // 4),
+                                  data[:len(data) // 4 * 4]))
+    words = [int(word, 16) for word in
+             re.findall(r"0x[0-9a-fA-F]+", data.decode("latin-1"))]
+    assert words and words[0] == SPIRV_MAGIC, "not a SPIR-V module"
+    return words
+
+
+def decode_string(words):
+    """Decodes the nul terminated literal string at the start of |words|."""
+    chars = []
+    for word in words:
+        for i in range(4):
+            char = (word >> (8 * i)) & 0xff
+            if char == 0:
+                return "".join(chars)
+            chars.append(chr(char))
+    return "".join(chars)
+
+
+class Module(object):
+
+    """The types, names and layout decorations of a SPIR-V module."""
+
+    def __init__(self, words):
+        self.names = {}
+        self.member_names = {}
+        self.types = {}
+        self.constants = {}
+        self.array_strides = {}
+        self.member_decorations = {}
+        self.built_ins = set()
+        self.structs = []
+        i = 5
+        while i < len(words):
+            count = words[i] >> 16
+            opcode = words[i] & 0xffff
+            assert count > 0, "invalid SPIR-V instruction"
+            self.add_instruction(opcode, words[i + 1:i + count])
+            i += count
+
+    def add_instruction(self, opcode, operands):
+        if opcode == OP_NAME:
+            self.names[operands[0]] = decode_string(operands[1:])
+        elif opcode == OP_MEMBER_NAME:
+            self.member_names[(operands[0], operands[1])] = decode_string(
+                operands[2:])
+        elif opcode in (OP_TYPE_BOOL, OP_TYPE_INT, OP_TYPE_FLOAT):
+            # Booleans cannot be in blocks, only their size matters here.
+            width = operands[1] if opcode != OP_TYPE_BOOL else 32
+            self.types[operands[0]] = ("scalar", width // 8)
+        elif opcode in (OP_TYPE_VECTOR, OP_TYPE_MATRIX):
+            kind = "vector" if opcode == OP_TYPE_VECTOR else "matrix"
+            self.types[operands[0]] = (kind, operands[1], operands[2])
+        elif opcode == OP_TYPE_ARRAY:
+            self.types[operands[0]] = ("array", operands[1], operands[2])
+        elif opcode == OP_TYPE_RUNTIME_ARRAY:
+            self.types[operands[0]] = ("array", operands[1], None)
+        elif opcode == OP_TYPE_STRUCT:
+            self.types[operands[0]] = ("struct", operands[1:])
+            self.structs.append(operands[0])
+        elif opcode == OP_CONSTANT:
+            self.constants[operands[1]] = operands[2]
+        elif opcode == OP_DECORATE:
+            if operands[1] == DECORATION_ARRAY_STRIDE:
+                self.array_strides[operands[0]] = operands[2]
+        elif opcode == OP_MEMBER_DECORATE:
+            key = (operands[0], operands[1])
+            self.member_decorations.setdefault(key, {})[operands[2]] = (
+                operands[3] if len(operands) > 3 else True)
+            if operands[2] == DECORATION_BUILT_IN:
+                self.built_ins.add(operands[0])
+
+    def member_decoration(self, struct_id, member, decoration):
+        return self.member_decorations.get((struct_id, member), {}).get(
+            decoration)
+
+    def size_in_module(self, type_id, matrix_stride=None):
+        """Returns the number of bytes that |type_id| spans with the strides
+        and offsets of the module, or None for runtime arrays."""
+        ty = self.types[type_id]
+        if ty[0] == "scalar":
+            return ty[1]
+        if ty[0] == "vector":
+            return self.size_in_module(ty[1]) * ty[2]
+        if ty[0] == "matrix":
+            column_size = self.size_in_module(ty[1])
+            if matrix_stride is None:
+                return column_size * ty[2]
+            return matrix_stride * (ty[2] - 1) + column_size
+        if ty[0] == "array":
+            if ty[2] is None:
+                return None
+            element_size = self.size_in_module(ty[1], matrix_stride)
+            stride = self.array_strides.get(type_id, element_size)
+            return stride * (self.constants[ty[2]] - 1) + element_size
+        size = 0
+        for member, member_type in enumerate(ty[1]):
+            offset = self.member_decoration(type_id, member, DECORATION_OFFSET)
+            member_size = self.size_in_module(
+                member_type,
+                self.member_decoration(type_id, member,
+                                       DECORATION_MATRIX_STRIDE))
+            if offset is None or member_size is None:
+                return None
+            size = max(size, offset + member_size)
+        return size
+
+    def layout(self, type_id, layout, row_major=False):
+        """Returns the size and alignment of |type_id| with |layout|, with
+        runtime arrays counted as one element."""
+        ty = self.types[type_id]
+        if ty[0] == "scalar":
+            return ty[1], ty[1]
+        if ty[0] == "vector":
+            component = self.types[ty[1]][1]
+            if layout == SCALAR:
+                return component * ty[2], component
+            return component * ty[2], component * (2 if ty[2] == 2 else 4)
+        if ty[0] == "matrix":
+            column_type = self.types[ty[1]]
+            columns, rows = ty[2], column_type[2]
+            if row_major:
+                columns, rows = rows, columns
+            component = self.types[column_type[1]][1]
+            vector = ("vector", column_type[1], rows)
+            return self.array_layout(vector, columns, layout, component)
+        if ty[0] == "array":
+            length = (1 if ty[2] is None else self.constants[ty[2]])
+            size, alignment = self.layout(ty[1], layout, row_major)
+            return self.array_layout(None, length, layout, None,
+                                     (size, alignment))
+        size = 0
+        alignment = 1
+        for member, member_type in enumerate(ty[1]):
+            member_size, member_alignment = self.layout(
+                member_type, layout,
+                self.member_decoration(type_id, member,
+                                       DECORATION_ROW_MAJOR) is not None)
+            size = align_to_next(size, member_alignment) + member_size
+            alignment = max(alignment, member_alignment)
+        if layout == STD140:
+            alignment = align_to_next(alignment, 16)
+        if layout != SCALAR:
+            size = align_to_next(size, alignment)
+        return size, alignment
+
+    def array_layout(self, vector, length, layout, component,
+                     element=None):
+        """Returns the size and alignment of |length| elements, either
+        vectors of |component| bytes described by |vector|, or of the
+        given |element| size and alignment."""
+        if element is None:
+            count = vector[2]
+            if layout == SCALAR:
+                element = (component * count, component)
+            else:
+                element = (component * count,
+                           component * (2 if count == 2 else 4))
+        size, alignment = element
+        if layout == STD140:
+            alignment = align_to_next(alignment, 16)
+        stride = align_to_next(size, alignment)
+        return stride * length, alignment
+
+
+def macro_name(name):
+    return "CHECK_" + re.sub(r"[^A-Z0-9]", "_", name.upper()) + "_LAYOUT"
+
+
+def write_checks(module, source_name):
+    """Returns the text of the header with the checks for |module|."""
+    lines = [
+        "// Generated by tools/shader_layout_check.py from %s." % source_name,
+        "// Do not edit.",
+        "",
+        "#include \"vulkan_helpers/shader_layout.h\"",
+    ]
+    element_strides = {}
+    for type_id, ty in module.types.items():
+        if ty[0] == "array" and type_id in module.array_strides:
+            element_strides.setdefault(ty[1], module.array_strides[type_id])
+    written = set()
+    for struct_id in module.structs:
+        name = module.names.get(struct_id)
+        members = module.types[struct_id][1]
+        member_names = [module.member_names.get((struct_id, i))
+                        for i in range(len(members))]
+        offsets = [module.member_decoration(struct_id, i, DECORATION_OFFSET)
+                   for i in range(len(members))]
+        if (not name or struct_id in module.built_ins or
+                None in member_names or None in offsets):
+            continue
+        macro = macro_name(name)
+        if macro in written:
+            continue
+        written.add(macro)
+        size = module.size_in_module(struct_id)
+        sizes = ", ".join(
+            "%d with %s" % (module.layout(struct_id, layout)[0],
+                            LAYOUT_NAMES[layout])
+            for layout in (STD140, STD430, SCALAR))
+        checks = ["VULKAN_CHECK_MEMBER_OFFSET(type, %s, %d)" %
+                  (member_name, offset)
+                  for member_name, offset in zip(member_names, offsets)]
+        if struct_id in element_strides:
+            checks.append("VULKAN_CHECK_SIZE(type, %d)" %
+                          element_strides[struct_id])
+        elif size is not None:
+            checks.append("VULKAN_CHECK_MIN_SIZE(type, %d)" % size)
+        lines.append("")
+        lines.append("// %s: %s bytes in the shader, %s." %
+                     (name, "?" if size is None else size, sizes))
+        body = ["#define %s(type)" % macro] + ["  " + check + ";"
+                                               for check in checks]
+        body[-1] = body[-1][:-1]
+        width = max(len(line) for line in body[:-1])
+        lines.extend(line.ljust(width) + " \\" for line in body[:-1])
+        lines.append(body[-1])
+    return "\n".join(lines) + "\n"
+
+
+def test():
+    """Checks the layouts of a module with a vec3 block in every layout."""
+    def string_words(text):
+        data = text.encode("latin-1") + b"\0" * (4 - len(text) % 4)
+        return list(struct.unpack("<%dI" % (len(data) // 4), data))
+
+    def instruction(opcode, operands):
+        return [((len(operands) + 1) << 16) | opcode] + operands
+
+    words = [SPIRV_MAGIC, 0x00010000, 0, 20, 0]
+    words += instruction(OP_NAME, [10] + string_words("color_data"))
+    words += instruction(OP_MEMBER_NAME, [10, 0] + string_words("color1"))
+    words += instruction(OP_MEMBER_NAME, [10, 1] + string_words("color2"))
+    words += instruction(OP_MEMBER_NAME, [10, 2] + string_words("scale"))
+    words += instruction(OP_MEMBER_DECORATE, [10, 0, DECORATION_OFFSET, 0])
+    words += instruction(OP_MEMBER_DECORATE, [10, 1, DECORATION_OFFSET, 12])
+    words += instruction(OP_MEMBER_DECORATE, [10, 2, DECORATION_OFFSET, 24])
+    words += instruction(OP_TYPE_FLOAT, [1, 32])
+    words += instruction(OP_TYPE_VECTOR, [2, 1, 3])
+    words += instruction(OP_TYPE_STRUCT, [10, 2, 2, 1])
+
+    success = True
+    module = Module(words)
+    expected = {STD140: (32, 16), STD430: (32, 16), SCALAR: (28, 4)}
+    for layout, size_alignment in expected.items():
+        result = module.layout(10, layout)
+        if result != size_alignment:
+            print("[FAILED] %s: %s, expected %s" %
+                  (LAYOUT_NAMES[layout], result, size_alignment))
+            success = False
+    if module.size_in_module(10) != 28:
+        print("[FAILED] size in module: %s" % module.size_in_module(10))
+        success = False
+    header = write_checks(module, "test.spv")
+    for check in ("#define CHECK_COLOR_DATA_LAYOUT(type)",
+                  "VULKAN_CHECK_MEMBER_OFFSET(type, color2, 12);",
+                  "VULKAN_CHECK_MIN_SIZE(type, 28)"):
+        if check not in header:
+            print("[FAILED] %s is not in the header" % check)
+            success = False
+    print("[%s] shader_layout_check" % ("SUCCESS" if success else "FAILED"))
+    return success
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--test", action="store_true",
+                        help="Runs the tests of this file")
+    parser.add_argument("--output", help="The header to write")
+    parser.add_argument("input", nargs="?", help="The SPIR-V module")
+    args = parser.parse_args()
+    if args.test:
+        return 0 if test() else -1
+    if not args.input or not args.output:
+        parser.error("an input and --output are needed")
+    with open(args.input, "rb") as input_file:
+        module = Module(read_words(input_file.read()))
+    header = write_checks(module, args.input.replace("\\", "/").split("/")[-1])
+    with open(args.output, "w") as output_file:
+        output_file.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
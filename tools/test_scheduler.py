@@ -0,0 +1,167 @@
+#!/usr/bin/python
+# Copyright 2017 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+'''This runs tests concurrently, one at a time on every device.
+
+Every device gets its own thread, and every thread takes the next test from
+a queue that is ordered by how long the tests took in earlier runs, longest
+first, so that all of the devices finish at roughly the same time.
+'''
+
+import json
+import os
+import subprocess
+import threading
+import time
+from Queue import Queue, Empty
+
+# The expected duration, in seconds, of a test that never ran before.
+DEFAULT_DURATION = 60.0
+
+
+def attached_android_devices():
+    '''Returns the serial of every android device that adb can use'''
+    output = subprocess.check_output(['adb', 'devices'])
+    serials = []
+    for line in output.splitlines()[1:]:
+        fields = line.split()
+        if len(fields) == 2 and fields[1] == 'device':
+            serials.append(fields[0])
+    return serials
+
+
+def parse_devices(devices, host, jobs):
+    '''Returns the list of devices to run on.
+
+    For android, devices is a comma separated list of adb serials, or "all"
+    for every attached device, or None for the default device of adb, which
+    is returned as None.
+    On the host the samples always run on the first GPU, so the devices are
+    jobs slots, named host0, host1, ... that run on it concurrently.
+    '''
+    if host:
+        if jobs <= 1:
+            return [None]
+        return ['host' + str(i) for i in range(jobs)]
+    if devices is None:
+        return [None]
+    if devices == 'all':
+        serials = attached_android_devices()
+        if not serials:
+            raise RuntimeError('No android devices are attached')
+        return serials
+    return [serial for serial in devices.split(',') if serial]
+
+
+class DurationHistory(object):
+
+    """The durations of the tests in earlier runs, kept in a json file."""
+
+    def __init__(self, filename):
+        self.filename = filename
+        self.durations = {}
+        self.lock = threading.Lock()
+        if filename and os.path.isfile(filename):
+            try:
+                with open(filename, 'r') as f:
+                    self.durations = json.load(f)
+            except ValueError:
+                print 'Warning: Ignoring the invalid durations in ' + filename
+
+    def expected(self, name):
+        """Returns how long the test is expected to take, in seconds"""
+        return self.durations.get(name, DEFAULT_DURATION)
+
+    def record(self, name, seconds):
+        """Records how long the test took in this run"""
+        with self.lock:
+            self.durations[name] = seconds
+
+    def save(self):
+        """Writes all of the durations back to the file"""
+        if not self.filename:
+            return
+        temp_name = self.filename + '.tmp'
+        with open(temp_name, 'w') as f:
+            json.dump(self.durations, f, indent=2, sort_keys=True)
+        os.rename(temp_name, self.filename)
+
+
+def wait_for(queue):
+    '''Returns the next item of the queue, and still lets KeyboardInterrupt
+    through while it waits'''
+    while True:
+        try:
+            return queue.get(True, 1)
+        except Empty:
+            continue
+
+
+def run_sharded(names, devices, history, run, done):
+    '''Runs every test of names once, on one of the devices.
+
+    Arguments:
+        names: the names of the tests, also the keys of their durations
+        devices: the devices to run on, see parse_devices
+        history: a DurationHistory, which gets the durations of this run
+        run: run(name, device) runs one test on the given device
+        done: done(name, result) is called with what run returned, on the
+          thread that called run_sharded, in the order the tests finished
+
+    Every device only runs one test at a time, so that tests can not get in
+    each other's way. With a single device, the tests run in the order of
+    names, on the calling thread.
+    '''
+    if len(devices) == 1:
+        for name in names:
+            start = time.time()
+            result = run(name, devices[0])
+            history.record(name, time.time() - start)
+            done(name, result)
+        return
+
+    tests = Queue()
+    for name in sorted(names, key=history.expected, reverse=True):
+        tests.put(name)
+    results = Queue()
+
+    def work(device):
+        while True:
+            try:
+                name = tests.get_nowait()
+            except Empty:
+                return
+            start = time.time()
+            try:
+                result = run(name, device)
+            except Exception as error:
+                results.put((name, None, error))
+                continue
+            history.record(name, time.time() - start)
+            results.put((name, result, None))
+
+    threads = [threading.Thread(target=work, args=(device,))
+               for device in devices]
+    for thread in threads:
+        thread.daemon = True
+        thread.start()
+    for _ in names:
+        name, result, error = wait_for(results)
+        if error is not None:
+            for thread in threads:
+                thread.join()
+            raise error
+        done(name, result)
+    for thread in threads:
+        thread.join()
@@ -0,0 +1,195 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_ALLOCATION_AUDIT_H
+#define VULKAN_HELPERS_ALLOCATION_AUDIT_H
+
+#include "support/containers/audit_allocator.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/api_call_stats.h"
+#include "vulkan_helpers/host_allocation_callbacks.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace vulkan {
+
+// AllocationAudit checks that frames in the steady state do not allocate.
+// Once per frame it compares the allocations of the AuditAllocator, the
+// create and allocate calls that ApiCallStats counted, and the allocations
+// of the driver through HostAllocationCallbacks with those of the frame
+// before, and logs every frame in which any of them changed, with the call
+// stacks of the first container allocations. If |fatal| is true, the first
+// such frame crashes instead of only being logged.
+//
+// |api_call_stats| and |driver_allocations| may be nullptr.
+class AllocationAudit {
+ public:
+  AllocationAudit(containers::AuditAllocator* allocator,
+                  const ApiCallStats* api_call_stats,
+                  const HostAllocationCallbacks* driver_allocations,
+                  bool fatal, logging::Logger* log)
+      : allocator_(allocator),
+        api_call_stats_(api_call_stats),
+        driver_allocations_(driver_allocations),
+        fatal_(fatal),
+        log_(log),
+        checking_(false),
+        num_allocations_(0),
+        num_driver_allocations_(0),
+        num_checked_frames_(0),
+        num_allocating_frames_(0) {
+    Snapshot();
+  }
+
+  ~AllocationAudit() { allocator_->set_capturing(false); }
+
+  // Checks the frame |frame| that just ended, after ApiCallStats ended or
+  // discarded it, if the frame before was |measured| too. The frames that
+  // are not measured, such as the warmup frames, may allocate.
+  void CheckFrame(bool measured, uint64_t frame) {
+    if (checking_) {
+      Check(frame);
+    }
+    checking_ = measured;
+    allocator_->set_capturing(measured);
+    // Drop what was captured while logging, or before the frames were
+    // measured.
+    containers::AuditAllocator::CapturedAllocation
+        captured[containers::AuditAllocator::kMaxCapturedAllocations];
+    allocator_->TakeCaptured(captured);
+    Snapshot();
+  }
+
+  // Logs how many of the checked frames allocated.
+  void LogSummary(const char* prefix) const {
+    log_->LogInfo(prefix, " checked_frames=", num_checked_frames_,
+                  " allocating_frames=", num_allocating_frames_);
+  }
+
+ private:
+  void Check(uint64_t frame) {
+    ++num_checked_frames_;
+    const uint64_t allocations =
+        allocator_->num_allocations() - num_allocations_;
+    const uint64_t driver_allocations =
+        CountDriverAllocations() - num_driver_allocations_;
+    uint64_t creates = 0;
+    if (api_call_stats_) {
+      for (size_t i = 0; i < api_call_stats_->num_functions(); ++i) {
+        if (IsCreateFunction(api_call_stats_->function_name(i))) {
+          creates += api_call_stats_->last_frame_count(i);
+        }
+      }
+    }
+    if (allocations == 0 && driver_allocations == 0 && creates == 0) {
+      return;
+    }
+    ++num_allocating_frames_;
+    // Do not modify this line, scripts may look for it in the output.
+    log_->LogError("ALLOCATION_AUDIT: frame ", frame,
+                   " allocations=", allocations,
+                   " driver_allocations=", driver_allocations,
+                   " creates=", creates);
+    if (api_call_stats_) {
+      for (size_t i = 0; i < api_call_stats_->num_functions(); ++i) {
+        const char* name = api_call_stats_->function_name(i);
+        const uint64_t count = api_call_stats_->last_frame_count(i);
+        if (count > 0 && IsCreateFunction(name)) {
+          log_->LogError("  ", name, " x", count);
+        }
+      }
+    }
+    containers::AuditAllocator::CapturedAllocation
+        captured[containers::AuditAllocator::kMaxCapturedAllocations];
+    const size_t num_captured = allocator_->TakeCaptured(captured);
+    for (size_t i = 0; i < num_captured; ++i) {
+      LogCaptured(captured[i]);
+    }
+    if (fatal_) {
+      LOG_ASSERT(==, log_, 0u, allocations + driver_allocations + creates);
+    }
+  }
+
+  void LogCaptured(
+      const containers::AuditAllocator::CapturedAllocation& captured) {
+    log_->LogError("  allocation of ", captured.size, " bytes from:");
+#if defined(AUDIT_ALLOCATOR_BACKTRACE)
+    // backtrace_symbols allocates with ::malloc, not with any Allocator.
+    char** symbols = backtrace_symbols(const_cast<void**>(captured.frames),
+                                       static_cast<int>(captured.num_frames));
+    if (symbols) {
+      for (size_t i = 0; i < captured.num_frames; ++i) {
+        log_->LogError("    ", symbols[i]);
+      }
+      ::free(symbols);
+      return;
+    }
+#endif
+    for (size_t i = 0; i < captured.num_frames; ++i) {
+      log_->LogError("    ", captured.frames[i]);
+    }
+  }
+
+  // The functions that create objects or allocate memory from the driver.
+  // Descriptor sets come from pools that were created up front, so
+  // allocating them is not counted.
+  static bool IsCreateFunction(const char* name) {
+    return strncmp(name, "vkCreate", 8) == 0 ||
+           strcmp(name, "vkAllocateMemory") == 0 ||
+           strcmp(name, "vkAllocateCommandBuffers") == 0;
+  }
+
+  // The allocations of the driver that were not served from the pool of
+  // HostAllocationCallbacks, over all scopes.
+  uint64_t CountDriverAllocations() const {
+    if (!driver_allocations_) {
+      return 0;
+    }
+    uint64_t count = 0;
+    for (size_t i = 0; i < HostAllocationCallbacks::kNumScopes; ++i) {
+      const HostAllocationCallbacks::ScopeStatistics& statistics =
+          driver_allocations_->statistics(
+              static_cast<VkSystemAllocationScope>(i));
+      count += statistics.num_allocations.load() -
+               statistics.num_pooled.load() +
+               statistics.num_reallocations.load();
+    }
+    return count;
+  }
+
+  void Snapshot() {
+    num_allocations_ = allocator_->num_allocations();
+    num_driver_allocations_ = CountDriverAllocations();
+  }
+
+  containers::AuditAllocator* allocator_;
+  const ApiCallStats* api_call_stats_;
+  const HostAllocationCallbacks* driver_allocations_;
+  const bool fatal_;
+  logging::Logger* log_;
+  // Whether the frame that is being recorded gets checked.
+  bool checking_;
+  // The counts at the end of the last frame.
+  uint64_t num_allocations_;
+  uint64_t num_driver_allocations_;
+  uint64_t num_checked_frames_;
+  uint64_t num_allocating_frames_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_ALLOCATION_AUDIT_H
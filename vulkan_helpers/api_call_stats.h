@@ -0,0 +1,109 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_API_CALL_STATS_H
+#define VULKAN_HELPERS_API_CALL_STATS_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// ApiCallStats counts the calls to the draw, dispatch, bind, barrier, submit,
+// descriptor update, create and destroy functions of a device, per frame.
+// The device counts calls for as long as this exists.
+//
+// Calls are counted from all threads, so the calls of the worker threads of
+// a frame are only taken into account once they are done recording it.
+class ApiCallStats {
+ public:
+  ApiCallStats(containers::Allocator* allocator, VkDevice* device)
+      : device_(device),
+        totals_(allocator),
+        max_per_frame_(allocator),
+        last_frame_(allocator),
+        num_frames_(0) {
+    totals_.resize((*device_)->num_call_counters(), 0);
+    max_per_frame_.resize((*device_)->num_call_counters(), 0);
+    last_frame_.resize((*device_)->num_call_counters(), 0);
+    (*device_)->set_counting_calls(true);
+  }
+
+  ~ApiCallStats() { (*device_)->set_counting_calls(false); }
+
+  // Adds the calls since the last EndFrame or DiscardFrame as one frame.
+  void EndFrame() {
+    for (size_t i = 0; i < totals_.size(); ++i) {
+      const uint64_t count = (*device_)->TakeCallCount(i);
+      totals_[i] += count;
+      last_frame_[i] = count;
+      if (count > max_per_frame_[i]) {
+        max_per_frame_[i] = count;
+      }
+    }
+    ++num_frames_;
+  }
+
+  // Drops the calls since the last EndFrame or DiscardFrame, e.g. those of
+  // the first frames, which also create everything.
+  void DiscardFrame() {
+    for (size_t i = 0; i < totals_.size(); ++i) {
+      last_frame_[i] = (*device_)->TakeCallCount(i);
+    }
+  }
+
+  uint64_t num_frames() const { return num_frames_; }
+
+  // The counted functions, and their calls in the last frame that was ended
+  // or discarded.
+  size_t num_functions() const { return last_frame_.size(); }
+  const char* function_name(size_t i) const {
+    return (*device_)->call_counter_function_name(i);
+  }
+  uint64_t last_frame_count(size_t i) const { return last_frame_[i]; }
+
+  // Logs one line per function that was called in any of the frames, with
+  // the mean and maximum number of calls per frame.
+  void LogStatistics(const char* prefix, logging::Logger* log) const {
+    if (num_frames_ == 0) {
+      return;
+    }
+    for (size_t i = 0; i < totals_.size(); ++i) {
+      if (totals_[i] == 0) {
+        continue;
+      }
+      log->LogInfo(prefix, " ", (*device_)->call_counter_function_name(i),
+                   " mean=",
+                   static_cast<double>(totals_[i]) / num_frames_,
+                   " max=", max_per_frame_[i]);
+    }
+  }
+
+ private:
+  VkDevice* device_;
+  // The calls to each counted function of the device, over all frames and
+  // in the frame that called it the most.
+  containers::vector<uint64_t> totals_;
+  containers::vector<uint64_t> max_per_frame_;
+  containers::vector<uint64_t> last_frame_;
+  uint64_t num_frames_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_API_CALL_STATS_H
@@ -0,0 +1,536 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/asset_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vulkan {
+namespace {
+// Decodes |size| bytes of run-length encoded |src| into exactly
+// |dst_size| bytes of |dst|. Returns false if the data is malformed.
+bool DecodeRunLength(const uint8_t* src, size_t size, uint8_t* dst,
+                     size_t dst_size) {
+  size_t read = 0;
+  size_t written = 0;
+  while (read < size) {
+    uint8_t control = src[read++];
+    if (control < 128) {
+      size_t count = size_t(control) + 1;
+      if (read + count > size || written + count > dst_size) {
+        return false;
+      }
+      memcpy(dst + written, src + read, count);
+      read += count;
+      written += count;
+    } else {
+      size_t count = size_t(control) - 126;
+      if (read + 1 > size || written + count > dst_size) {
+        return false;
+      }
+      memset(dst + written, src[read++], count);
+      written += count;
+    }
+  }
+  return written == dst_size;
+}
+
+// Appends |size| bytes of |src| to |dst|, in the encoding that
+// DecodeRunLength reads. This matches run_length_encode of asset_file.py.
+void EncodeRunLength(const uint8_t* src, size_t size,
+                     std::vector<uint8_t>* dst) {
+  size_t literals_begin = 0;
+  size_t num_literals = 0;
+  auto flush_literals = [&]() {
+    if (num_literals > 0) {
+      dst->push_back(static_cast<uint8_t>(num_literals - 1));
+      dst->insert(dst->end(), src + literals_begin,
+                  src + literals_begin + num_literals);
+      num_literals = 0;
+    }
+  };
+  size_t i = 0;
+  while (i < size) {
+    size_t run = 1;
+    while (i + run < size && run < 129 && src[i + run] == src[i]) {
+      ++run;
+    }
+    if (run >= 2) {
+      flush_literals();
+      dst->push_back(static_cast<uint8_t>(run + 126));
+      dst->push_back(src[i]);
+      i += run;
+    } else {
+      if (num_literals == 0) {
+        literals_begin = i;
+      }
+      ++num_literals;
+      ++i;
+      if (num_literals == 128) {
+        flush_literals();
+      }
+    }
+  }
+  flush_literals();
+}
+
+// Decodes the LZ4 block of |size| bytes at |src| into exactly |dst_size|
+// bytes of |dst|. Returns false if the data is malformed.
+bool DecodeLz4(const uint8_t* src, size_t size, uint8_t* dst,
+               size_t dst_size) {
+  size_t read = 0;
+  size_t written = 0;
+  // Adds the bytes of an extended length to |*length|.
+  auto read_length = [&](size_t* length) {
+    uint8_t byte;
+    do {
+      if (read >= size) {
+        return false;
+      }
+      byte = src[read++];
+      *length += byte;
+    } while (byte == 255);
+    return true;
+  };
+  while (read < size) {
+    const uint8_t token = src[read++];
+    size_t literals = token >> 4;
+    if (literals == 15 && !read_length(&literals)) {
+      return false;
+    }
+    if (read + literals > size || written + literals > dst_size) {
+      return false;
+    }
+    memcpy(dst + written, src + read, literals);
+    read += literals;
+    written += literals;
+    if (read == size) {
+      break;
+    }
+    if (read + 2 > size) {
+      return false;
+    }
+    const size_t offset = size_t(src[read]) | (size_t(src[read + 1]) << 8);
+    read += 2;
+    size_t length = token & 15;
+    if (length == 15 && !read_length(&length)) {
+      return false;
+    }
+    length += 4;
+    if (offset == 0 || offset > written || written + length > dst_size) {
+      return false;
+    }
+    // The match may overlap the bytes that it writes.
+    for (size_t i = 0; i < length; ++i, ++written) {
+      dst[written] = dst[written - offset];
+    }
+  }
+  return written == dst_size;
+}
+
+// Appends the bytes of an LZ4 length beyond what fits in the token.
+void AppendLz4Length(size_t value, std::vector<uint8_t>* dst) {
+  while (value >= 255) {
+    dst->push_back(255);
+    value -= 255;
+  }
+  dst->push_back(static_cast<uint8_t>(value));
+}
+
+// Appends |size| bytes of |src| to |dst| as one LZ4 block. Like lz4_encode
+// of asset_file.py, every 4 byte sequence is matched greedily against the
+// last position it was seen at, but positions are kept in a small hash
+// table, so the output is not always the same.
+void EncodeLz4(const uint8_t* src, size_t size, std::vector<uint8_t>* dst) {
+  const uint32_t kHashBits = 12;
+  const size_t kNoPosition = ~size_t(0);
+  size_t last_position[1 << kHashBits];
+  std::fill(last_position, last_position + (1 << kHashBits), kNoPosition);
+  size_t anchor = 0;
+  size_t i = 0;
+  // No match may start in the last 12 bytes, and the last 5 bytes are
+  // always literals.
+  while (i + 12 < size) {
+    uint32_t sequence;
+    memcpy(&sequence, src + i, sizeof(sequence));
+    const uint32_t hash = (sequence * 2654435761u) >> (32 - kHashBits);
+    const size_t candidate = last_position[hash];
+    last_position[hash] = i;
+    if (candidate == kNoPosition || i - candidate > 65535 ||
+        memcmp(src + candidate, src + i, 4) != 0) {
+      ++i;
+      continue;
+    }
+    size_t length = 4;
+    while (i + length + 5 < size && src[candidate + length] == src[i + length]) {
+      ++length;
+    }
+    const size_t literals = i - anchor;
+    dst->push_back(static_cast<uint8_t>((std::min<size_t>(literals, 15) << 4) |
+                                        std::min<size_t>(length - 4, 15)));
+    if (literals >= 15) {
+      AppendLz4Length(literals - 15, dst);
+    }
+    dst->insert(dst->end(), src + anchor, src + i);
+    const size_t offset = i - candidate;
+    dst->push_back(static_cast<uint8_t>(offset & 0xFF));
+    dst->push_back(static_cast<uint8_t>(offset >> 8));
+    if (length - 4 >= 15) {
+      AppendLz4Length(length - 4 - 15, dst);
+    }
+    i += length;
+    anchor = i;
+  }
+  const size_t literals = size - anchor;
+  dst->push_back(static_cast<uint8_t>(std::min<size_t>(literals, 15) << 4));
+  if (literals >= 15) {
+    AppendLz4Length(literals - 15, dst);
+  }
+  dst->insert(dst->end(), src + anchor, src + size);
+}
+
+void AppendUint32(uint32_t value, std::vector<uint8_t>* dst) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  dst->insert(dst->end(), bytes, bytes + sizeof(value));
+}
+
+// Appends |size| bytes of |src| to |dst| in kAssetChunkedLz4.
+void EncodeChunkedLz4(const uint8_t* src, size_t size,
+                      std::vector<uint8_t>* dst) {
+  const size_t start = dst->size();
+  const uint32_t num_chunks = static_cast<uint32_t>(
+      (size + kAssetLz4ChunkSize - 1) / kAssetLz4ChunkSize);
+  AppendUint32(num_chunks, dst);
+  AppendUint32(kAssetLz4ChunkSize, dst);
+  // The offsets are filled in once every chunk has been encoded.
+  const size_t offsets = dst->size();
+  dst->resize(offsets + (num_chunks + 1) * sizeof(uint32_t));
+  for (uint32_t i = 0; i <= num_chunks; ++i) {
+    const uint32_t offset = static_cast<uint32_t>(dst->size() - start);
+    memcpy(dst->data() + offsets + i * sizeof(uint32_t), &offset,
+           sizeof(offset));
+    if (i < num_chunks) {
+      const size_t begin = size_t(i) * kAssetLz4ChunkSize;
+      EncodeLz4(src + begin, std::min<size_t>(kAssetLz4ChunkSize, size - begin),
+                dst);
+    }
+  }
+}
+
+// Decodes the kAssetChunkedLz4 data of |size| bytes at |src| into exactly
+// |dst_size| bytes of |dst|. Returns false if the data is malformed.
+bool DecodeChunkedLz4(const uint8_t* src, size_t size, uint8_t* dst,
+                      size_t dst_size) {
+  uint32_t header[2];
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(header, src, sizeof(header));
+  const uint32_t num_chunks = header[0];
+  const size_t chunk_size = header[1];
+  if (chunk_size == 0 ||
+      (dst_size + chunk_size - 1) / chunk_size != num_chunks ||
+      (size - sizeof(header)) / sizeof(uint32_t) < size_t(num_chunks) + 1) {
+    return false;
+  }
+  for (uint32_t i = 0; i < num_chunks; ++i) {
+    uint32_t offsets[2];
+    memcpy(offsets, src + sizeof(header) + i * sizeof(uint32_t),
+           sizeof(offsets));
+    const size_t begin = size_t(i) * chunk_size;
+    if (offsets[0] > offsets[1] || offsets[1] > size ||
+        !DecodeLz4(src + offsets[0], offsets[1] - offsets[0], dst + begin,
+                   std::min(chunk_size, dst_size - begin))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t AlignToSection(size_t value) {
+  return (value + kAssetSectionAlignment - 1) & ~(kAssetSectionAlignment - 1);
+}
+}  // anonymous namespace
+
+void EncodeAssetFile(uint32_t tag, const void* data, size_t size,
+                     bool compress, std::vector<uint8_t>* out,
+                     AssetCompression compression) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  const size_t data_offset =
+      AlignToSection(sizeof(AssetFileHeader) + sizeof(AssetSection));
+  out->assign(data_offset, 0);
+
+  AssetSection section = {
+      tag,                 // tag
+      kAssetUncompressed,  // compression
+      data_offset,         // offset
+      size,                // size
+      size                 // uncompressed_size
+  };
+  if (compress && compression != kAssetUncompressed) {
+    if (compression == kAssetChunkedLz4) {
+      EncodeChunkedLz4(bytes, size, out);
+    } else {
+      EncodeRunLength(bytes, size, out);
+    }
+    const size_t encoded_size = out->size() - data_offset;
+    if (encoded_size < size) {
+      section.compression = compression;
+      section.size = encoded_size;
+    } else {
+      out->resize(data_offset);
+    }
+  }
+  if (section.compression == kAssetUncompressed) {
+    out->insert(out->end(), bytes, bytes + size);
+  }
+  out->resize(AlignToSection(out->size()), 0);
+
+  const AssetFileHeader header = {
+      kAssetFileMagic,    // magic
+      kAssetFileVersion,  // version
+      1,                  // num_sections
+      0                   // reserved
+  };
+  memcpy(out->data(), &header, sizeof(header));
+  memcpy(out->data() + sizeof(header), &section, sizeof(section));
+}
+
+AssetFile::AssetFile(containers::Allocator* allocator, logging::Logger* logger,
+                     const char* filename, bool defer_chunked_lz4)
+    : log_(logger),
+      defer_chunked_lz4_(defer_chunked_lz4),
+      mapping_(nullptr),
+      mapping_size_(0),
+#if defined _WIN32
+      file_handle_(INVALID_HANDLE_VALUE),
+      mapping_handle_(nullptr),
+#endif
+      decompressed_(allocator),
+      decompressed_offsets_(allocator) {
+#if defined _WIN32
+  file_handle_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    log_->LogError("Could not open asset file ", filename);
+    return;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0) {
+    log_->LogError("Could not get the size of asset file ", filename);
+    Unmap();
+    return;
+  }
+  mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY,
+                                       0, 0, nullptr);
+  if (mapping_handle_ == nullptr) {
+    log_->LogError("Could not map asset file ", filename);
+    Unmap();
+    return;
+  }
+  mapping_ = static_cast<const uint8_t*>(
+      MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  mapping_size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    log_->LogError("Could not open asset file ", filename);
+    return;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    log_->LogError("Could not get the size of asset file ", filename);
+    close(fd);
+    return;
+  }
+  void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size),
+                       PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive on its own.
+  close(fd);
+  if (mapping != MAP_FAILED) {
+    mapping_ = static_cast<const uint8_t*>(mapping);
+    mapping_size_ = static_cast<size_t>(file_stat.st_size);
+  }
+#endif
+  if (mapping_ == nullptr) {
+    log_->LogError("Could not map asset file ", filename);
+    Unmap();
+    return;
+  }
+  if (!Validate()) {
+    log_->LogError("Invalid asset file ", filename);
+    Unmap();
+  }
+}
+
+AssetFile::~AssetFile() { Unmap(); }
+
+void AssetFile::Unmap() {
+#if defined _WIN32
+  if (mapping_ != nullptr) {
+    UnmapViewOfFile(mapping_);
+  }
+  if (mapping_handle_ != nullptr) {
+    CloseHandle(mapping_handle_);
+    mapping_handle_ = nullptr;
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+    file_handle_ = INVALID_HANDLE_VALUE;
+  }
+#else
+  if (mapping_ != nullptr) {
+    munmap(const_cast<uint8_t*>(mapping_), mapping_size_);
+  }
+#endif
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  decompressed_.clear();
+  decompressed_offsets_.clear();
+}
+
+bool AssetFile::Validate() {
+  if (mapping_size_ < sizeof(AssetFileHeader)) {
+    return false;
+  }
+  const AssetFileHeader* header =
+      reinterpret_cast<const AssetFileHeader*>(mapping_);
+  if (header->magic != kAssetFileMagic ||
+      header->version != kAssetFileVersion) {
+    return false;
+  }
+  if (header->num_sections >
+      (mapping_size_ - sizeof(AssetFileHeader)) / sizeof(AssetSection)) {
+    return false;
+  }
+  const AssetSection* sections =
+      reinterpret_cast<const AssetSection*>(header + 1);
+
+  // Every section has to be aligned and inside of the file. Work out where
+  // each compressed section goes while we are at it.
+  size_t decompressed_size = 0;
+  for (uint32_t i = 0; i < header->num_sections; ++i) {
+    const AssetSection& section = sections[i];
+    if (section.offset % kAssetSectionAlignment != 0 ||
+        section.offset > mapping_size_ ||
+        section.size > mapping_size_ - section.offset) {
+      return false;
+    }
+    decompressed_offsets_.push_back(decompressed_size);
+    if (section.compression == kAssetUncompressed) {
+      if (section.size != section.uncompressed_size) {
+        return false;
+      }
+    } else if (section.compression == kAssetChunkedLz4 &&
+               defer_chunked_lz4_) {
+      // Left for the GPU.
+    } else if (section.compression == kAssetRunLength ||
+               section.compression == kAssetChunkedLz4) {
+      decompressed_size += static_cast<size_t>(
+          (section.uncompressed_size + kAssetSectionAlignment - 1) &
+          ~uint64_t(kAssetSectionAlignment - 1));
+    } else {
+      return false;
+    }
+  }
+
+  // A single allocation for everything means that the decompressed data
+  // never moves.
+  decompressed_.resize(decompressed_size);
+  for (uint32_t i = 0; i < header->num_sections; ++i) {
+    const AssetSection& section = sections[i];
+    if (section.compression == kAssetRunLength &&
+        !DecodeRunLength(mapping_ + section.offset,
+                         static_cast<size_t>(section.size),
+                         decompressed_.data() + decompressed_offsets_[i],
+                         static_cast<size_t>(section.uncompressed_size))) {
+      return false;
+    }
+    if (section.compression == kAssetChunkedLz4 && !defer_chunked_lz4_ &&
+        !DecodeChunkedLz4(mapping_ + section.offset,
+                          static_cast<size_t>(section.size),
+                          decompressed_.data() + decompressed_offsets_[i],
+                          static_cast<size_t>(section.uncompressed_size))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const AssetSection* AssetFile::FindSection(uint32_t tag) const {
+  if (!is_valid()) {
+    return nullptr;
+  }
+  const AssetFileHeader* header =
+      reinterpret_cast<const AssetFileHeader*>(mapping_);
+  const AssetSection* sections =
+      reinterpret_cast<const AssetSection*>(header + 1);
+  for (uint32_t i = 0; i < header->num_sections; ++i) {
+    if (sections[i].tag == tag) {
+      return &sections[i];
+    }
+  }
+  return nullptr;
+}
+
+const uint8_t* AssetFile::section(uint32_t tag) const {
+  const AssetSection* section = FindSection(tag);
+  LOG_ASSERT(!=, log_, static_cast<const AssetSection*>(nullptr), section);
+  if (section->compression == kAssetUncompressed) {
+    return mapping_ + section->offset;
+  }
+  LOG_ASSERT(==, log_, false,
+             section->compression == kAssetChunkedLz4 && defer_chunked_lz4_);
+  const AssetSection* sections = reinterpret_cast<const AssetSection*>(
+      reinterpret_cast<const AssetFileHeader*>(mapping_) + 1);
+  return decompressed_.data() + decompressed_offsets_[section - sections];
+}
+
+size_t AssetFile::section_size(uint32_t tag) const {
+  const AssetSection* section = FindSection(tag);
+  LOG_ASSERT(!=, log_, static_cast<const AssetSection*>(nullptr), section);
+  return static_cast<size_t>(section->uncompressed_size);
+}
+
+AssetCompression AssetFile::section_compression(uint32_t tag) const {
+  const AssetSection* section = FindSection(tag);
+  LOG_ASSERT(!=, log_, static_cast<const AssetSection*>(nullptr), section);
+  return static_cast<AssetCompression>(section->compression);
+}
+
+const uint8_t* AssetFile::stored_section(uint32_t tag) const {
+  const AssetSection* section = FindSection(tag);
+  LOG_ASSERT(!=, log_, static_cast<const AssetSection*>(nullptr), section);
+  return mapping_ + section->offset;
+}
+
+size_t AssetFile::stored_size(uint32_t tag) const {
+  const AssetSection* section = FindSection(tag);
+  LOG_ASSERT(!=, log_, static_cast<const AssetSection*>(nullptr), section);
+  return static_cast<size_t>(section->size);
+}
+
+}  // namespace vulkan
@@ -0,0 +1,170 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_ASSET_FILE_H_
+#define VULKAN_HELPERS_ASSET_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "support/containers/allocator.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+
+namespace vulkan {
+
+// Binary asset files are written by convert_obj_to_c.py --binary and
+// convert_img_to_c.py --binary. All values are little-endian.
+// The file is laid out as:
+//   AssetFileHeader
+//   AssetSection[num_sections]
+//   The data for every section, each starting on a kAssetSectionAlignment
+//   boundary.
+const uint32_t kAssetFileMagic = 0x46415456;  // "VTAF"
+const uint32_t kAssetFileVersion = 1;
+const size_t kAssetSectionAlignment = 16;
+
+// The tags of the sections that the vulkan helpers know about.
+// Models have a kAssetVertexData section that holds all of the positions,
+// then all of the texture coordinates, then all of the normals, and either a
+// kAssetIndexData section of uint32_t indices, or a kAssetIndexData16
+// section of uint16_t indices.
+// Textures have a kAssetTextureInfo section that holds an AssetTextureInfo,
+// and a kAssetTextureData section holding the texels.
+// Pipeline caches on disk have a kAssetPipelineCache section that holds the
+// data of vkGetPipelineCacheData, and pipeline corpora have a
+// kAssetPipelineCorpus section that is read by PipelineCorpus.
+const uint32_t kAssetVertexData = 0x58545256;      // "VRTX"
+const uint32_t kAssetIndexData = 0x58444e49;       // "INDX"
+const uint32_t kAssetIndexData16 = 0x36315849;     // "IX16"
+const uint32_t kAssetTextureInfo = 0x464e4954;     // "TINF"
+const uint32_t kAssetTextureData = 0x41544454;     // "TDTA"
+const uint32_t kAssetPipelineCache = 0x48434350;   // "PCCH"
+const uint32_t kAssetPipelineCorpus = 0x524f4350;  // "PCOR"
+
+enum AssetCompression : uint32_t {
+  kAssetUncompressed = 0,
+  // PackBits-style run-length encoding. A control byte c < 128 is followed
+  // by c + 1 literal bytes, a control byte c >= 128 is followed by a single
+  // byte that is repeated c - 126 times.
+  kAssetRunLength = 1,
+  // Independent LZ4 blocks of kAssetLz4ChunkSize uncompressed bytes each,
+  // the last one possibly shorter, after a table of
+  //   uint32_t num_chunks;
+  //   uint32_t chunk_size;
+  //   uint32_t chunk_offsets[num_chunks + 1];
+  // where the offsets are from the start of the section. Every chunk can be
+  // decoded on its own, so GpuDecompressor decodes one per invocation.
+  kAssetChunkedLz4 = 2,
+};
+
+// The number of uncompressed bytes of every kAssetChunkedLz4 chunk. This
+// must match LZ4_CHUNK_SIZE in asset_file.py.
+const uint32_t kAssetLz4ChunkSize = 16384;
+
+struct AssetFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_sections;
+  uint32_t reserved;
+};
+
+struct AssetSection {
+  uint32_t tag;
+  uint32_t compression;
+  // The offset of the data from the start of the file.
+  uint64_t offset;
+  // The number of bytes of data in the file.
+  uint64_t size;
+  // The number of bytes once the data is decompressed.
+  uint64_t uncompressed_size;
+};
+
+struct AssetTextureInfo {
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t reserved;
+};
+
+// Replaces |out| with an asset file that holds a single section of |size|
+// bytes of |data|, the same way as asset_file.py writes them. If |compress|
+// is true, the section is encoded with |compression| if that makes it
+// smaller.
+void EncodeAssetFile(uint32_t tag, const void* data, size_t size,
+                     bool compress, std::vector<uint8_t>* out,
+                     AssetCompression compression = kAssetRunLength);
+
+// AssetFile maps a binary asset file into memory. Uncompressed sections are
+// used straight from the mapping, so they can be copied directly into
+// staging memory. Compressed sections are decompressed once, when the file is
+// opened. Anything that uses the data of an AssetFile must not outlive it.
+class AssetFile {
+ public:
+  // Maps |filename| into memory. If the file can not be opened, or is not a
+  // valid asset file, an error is logged and is_valid() returns false.
+  // If |defer_chunked_lz4| is true, kAssetChunkedLz4 sections are left
+  // compressed for GpuDecompressor, and only stored_section() may be used
+  // for them.
+  AssetFile(containers::Allocator* allocator, logging::Logger* logger,
+            const char* filename, bool defer_chunked_lz4 = false);
+  ~AssetFile();
+
+  AssetFile(const AssetFile&) = delete;
+  AssetFile& operator=(const AssetFile&) = delete;
+
+  bool is_valid() const { return mapping_ != nullptr; }
+  // Returns whether kAssetChunkedLz4 sections were left compressed.
+  bool defers_chunked_lz4() const { return defer_chunked_lz4_; }
+
+  bool has_section(uint32_t tag) const { return FindSection(tag) != nullptr; }
+  // Returns the decompressed data of the section with the given tag. It is an
+  // error to ask for a section that does not exist.
+  const uint8_t* section(uint32_t tag) const;
+  // Returns the decompressed size of the section with the given tag.
+  size_t section_size(uint32_t tag) const;
+
+  // Returns how the section with the given tag is stored in the file.
+  AssetCompression section_compression(uint32_t tag) const;
+  // Returns the data of the section with the given tag as it is stored in
+  // the file, which is compressed unless the section is
+  // kAssetUncompressed.
+  const uint8_t* stored_section(uint32_t tag) const;
+  // Returns the number of bytes of stored_section().
+  size_t stored_size(uint32_t tag) const;
+
+ private:
+  const AssetSection* FindSection(uint32_t tag) const;
+  bool Validate();
+  void Unmap();
+
+  logging::Logger* log_;
+  bool defer_chunked_lz4_;
+  const uint8_t* mapping_;
+  size_t mapping_size_;
+#if defined _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#endif
+  // The decompressed contents of every compressed section, one after the
+  // other. decompressed_offsets_ has one entry per section.
+  containers::vector<uint8_t> decompressed_;
+  containers::vector<size_t> decompressed_offsets_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_ASSET_FILE_H_
@@ -0,0 +1,255 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_BINDLESS_TABLE_H
+#define VULKAN_HELPERS_BINDLESS_TABLE_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+#include <cstdint>
+#include <mutex>
+
+namespace vulkan {
+
+// BindlessTable is one large descriptor set that holds every sampled image,
+// storage buffer and sampler that an application registers with it, so
+// that it only has to be bound once per command buffer. Resources are
+// referred to by the index that they were added at, which shaders use to
+// index the arrays of the set, e.g. with indices from push constants:
+//   layout(set = N, binding = 0) uniform texture2D images[];
+//   layout(set = N, binding = 1) buffer Buffers { ... } buffers[];
+//   layout(set = N, binding = 2) uniform sampler samplers[];
+//
+// The set is created with VK_EXT_descriptor_indexing as update-after-bind
+// and partially bound, so resources can be added while it is bound, and
+// slots that are not in use are never read. The device must have been
+// created with runtimeDescriptorArray, descriptorBindingPartiallyBound,
+// descriptorBindingUpdateUnusedWhilePending,
+// descriptorBindingSampledImageUpdateAfterBind and
+// descriptorBindingStorageBufferUpdateAfterBind.
+//
+// The indices of removed resources are reused, so a resource may only be
+// removed once the GPU is done with every command buffer that used it. It
+// may be used from any thread.
+class BindlessTable {
+ public:
+  enum Binding : uint32_t {
+    kSampledImages = 0,
+    kStorageBuffers = 1,
+    kSamplers = 2,
+    kNumBindings = 3
+  };
+
+  BindlessTable(containers::Allocator* allocator, VkDevice* device,
+                uint32_t num_images, uint32_t num_buffers,
+                uint32_t num_samplers)
+      : device_(device),
+        layout_(VK_NULL_HANDLE, nullptr, device),
+        pool_(VK_NULL_HANDLE, nullptr, device),
+        set_(VK_NULL_HANDLE),
+        slots_{Slots(allocator), Slots(allocator), Slots(allocator)} {
+    const uint32_t capacities[kNumBindings] = {num_images, num_buffers,
+                                               num_samplers};
+    const VkDescriptorType types[kNumBindings] = {
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_SAMPLER};
+    VkDescriptorSetLayoutBinding bindings[kNumBindings];
+    VkDescriptorBindingFlagsEXT binding_flags[kNumBindings];
+    VkDescriptorPoolSize pool_sizes[kNumBindings];
+    for (uint32_t i = 0; i < kNumBindings; ++i) {
+      slots_[i].capacity = capacities[i];
+      bindings[i] = {
+          i,                    // binding
+          types[i],             // descriptorType
+          capacities[i],        // descriptorCount
+          VK_SHADER_STAGE_ALL,  // stageFlags
+          nullptr               // pImmutableSamplers
+      };
+      binding_flags[i] =
+          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+          VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+      pool_sizes[i] = {types[i], capacities[i]};
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+        nullptr,        // pNext
+        kNumBindings,   // bindingCount
+        binding_flags,  // pBindingFlags
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,  // sType
+        &flags_info,                                          // pNext
+        // flags
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+        kNumBindings,  // bindingCount
+        bindings,      // pBindings
+    };
+    ::VkDescriptorSetLayout layout;
+    LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+               (*device_)->vkCreateDescriptorSetLayout(*device_, &layout_info,
+                                                       nullptr, &layout));
+    layout_.initialize(layout);
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,        // sType
+        nullptr,                                              // pNext
+        VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,  // flags
+        1,                                                    // maxSets
+        kNumBindings,                                         // poolSizeCount
+        pool_sizes                                            // pPoolSizes
+    };
+    ::VkDescriptorPool pool;
+    LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+               (*device_)->vkCreateDescriptorPool(*device_, &pool_info,
+                                                  nullptr, &pool));
+    pool_.initialize(pool);
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,  // sType
+        nullptr,                                         // pNext
+        pool,                                            // descriptorPool
+        1,                                               // descriptorSetCount
+        &layout                                          // pSetLayouts
+    };
+    LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+               (*device_)->vkAllocateDescriptorSets(*device_, &alloc_info,
+                                                    &set_));
+  }
+
+  // Adds |view| to the table, and returns the index of it in the sampled
+  // images.
+  uint32_t AddImage(::VkImageView view,
+                    VkImageLayout layout =
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    VkDescriptorImageInfo info = {
+        VK_NULL_HANDLE,  // sampler
+        view,            // imageView
+        layout           // imageLayout
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint32_t index = Allocate(kSampledImages);
+    Update(kSampledImages, index, &info, nullptr);
+    return index;
+  }
+
+  // Adds the |range| bytes at |offset| of |buffer| to the table, and
+  // returns the index of them in the storage buffers.
+  uint32_t AddBuffer(::VkBuffer buffer, ::VkDeviceSize offset = 0,
+                     ::VkDeviceSize range = VK_WHOLE_SIZE) {
+    VkDescriptorBufferInfo info = {
+        buffer,  // buffer
+        offset,  // offset
+        range    // range
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint32_t index = Allocate(kStorageBuffers);
+    Update(kStorageBuffers, index, nullptr, &info);
+    return index;
+  }
+
+  // Adds |sampler| to the table, and returns the index of it in the
+  // samplers.
+  uint32_t AddSampler(::VkSampler sampler) {
+    VkDescriptorImageInfo info = {
+        sampler,                   // sampler
+        VK_NULL_HANDLE,            // imageView
+        VK_IMAGE_LAYOUT_UNDEFINED  // imageLayout
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint32_t index = Allocate(kSamplers);
+    Update(kSamplers, index, &info, nullptr);
+    return index;
+  }
+
+  // Frees |index| of |binding| to be reused by a later resource. The
+  // descriptor is left as it is until then.
+  void Remove(Binding binding, uint32_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LOG_ASSERT(<, device_->GetLogger(), index, slots_[binding].next);
+    slots_[binding].free.push_back(index);
+  }
+
+  // Binds the table as set |set| of |layout|.
+  void Bind(VkCommandBuffer* command_buffer, VkPipelineBindPoint bind_point,
+            ::VkPipelineLayout layout, uint32_t set) const {
+    (*command_buffer)
+        ->vkCmdBindDescriptorSets(*command_buffer, bind_point, layout, set, 1,
+                                  &set_, 0, nullptr);
+  }
+
+  ::VkDescriptorSetLayout layout() const { return layout_.get_raw_object(); }
+  ::VkDescriptorSet set() const { return set_; }
+
+ private:
+  struct Slots {
+    Slots(containers::Allocator* allocator)
+        : capacity(0), next(0), free(allocator) {}
+    uint32_t capacity;
+    // Every index from here on has never been used.
+    uint32_t next;
+    containers::vector<uint32_t> free;
+  };
+
+  uint32_t Allocate(Binding binding) {
+    Slots& slots = slots_[binding];
+    if (!slots.free.empty()) {
+      const uint32_t index = slots.free.back();
+      slots.free.pop_back();
+      return index;
+    }
+    LOG_ASSERT(<, device_->GetLogger(), slots.next, slots.capacity);
+    return slots.next++;
+  }
+
+  void Update(Binding binding, uint32_t index,
+              const VkDescriptorImageInfo* image_info,
+              const VkDescriptorBufferInfo* buffer_info) {
+    const VkDescriptorType types[kNumBindings] = {
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_SAMPLER};
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        set_,                                    // dstSet
+        binding,                                 // dstBinding
+        index,                                   // dstArrayElement
+        1,                                       // descriptorCount
+        types[binding],                          // descriptorType
+        image_info,                              // pImageInfo
+        buffer_info,                             // pBufferInfo
+        nullptr                                  // pTexelBufferView
+    };
+    (*device_)->vkUpdateDescriptorSets(*device_, 1, &write, 0, nullptr);
+  }
+
+  VkDevice* device_;
+  VkDescriptorSetLayout layout_;
+  VkDescriptorPool pool_;
+  // Freed with pool_.
+  ::VkDescriptorSet set_;
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  Slots slots_[kNumBindings];
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_BINDLESS_TABLE_H
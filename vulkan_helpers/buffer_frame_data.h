@@ -16,17 +16,150 @@
 #ifndef VULKAN_HELPERS_BUFFER_FRAME_DATA_H
 #define VULKAN_HELPERS_BUFFER_FRAME_DATA_H
 
+#include "vulkan_helpers/host_copy.h"
 #include "vulkan_helpers/vulkan_application.h"
 
+#include <algorithm>
+
 namespace vulkan {
 
 const size_t kMaxOffsetAlignment = 256;
 
+// Flags that change how a BufferFrameData gets its data to the device.
+enum BufferFrameDataFlags : uint32_t {
+  // UpdateBuffer only writes the data for a frame if Mark() was called since
+  // the data for that frame was last written, instead of comparing the data
+  // against the last value written for that frame.
+  kBufferFrameDataExplicitDirty = 1 << 0,
+  // The data is written straight into a persistently mapped buffer that the
+  // device reads from (device-local if possible), so UpdateBuffer does not
+  // need a staging copy or a queue submission. Mapped device-local memory is
+  // slow to read from the host, so unless kBufferFrameDataExplicitDirty is
+  // also given, the data is written on every UpdateBuffer.
+  kBufferFrameDataDirect = 1 << 1,
+};
+
 // Rounds to the given power_of_2
-size_t RoundUp(size_t to_round, size_t power_of_2_to_round) {
+inline size_t RoundUp(size_t to_round, size_t power_of_2_to_round) {
   return (to_round + power_of_2_to_round - 1) & ~(power_of_2_to_round - 1);
 }
 
+// Returns the alignment that the data of each frame of a buffer with |usage|
+// needs on |device|, so that it can be bound at any frame's offset, and
+// flushed by itself. This is kMaxOffsetAlignment if the device has no limits.
+inline size_t GetFrameDataAlignment(const VkDevice& device,
+                                    VkBufferUsageFlags usage) {
+  const VkPhysicalDeviceLimits& limits = device.limits();
+  if (limits.nonCoherentAtomSize == 0) {
+    return kMaxOffsetAlignment;
+  }
+  // Every one of these is a power of 2.
+  size_t alignment = static_cast<size_t>(limits.nonCoherentAtomSize);
+  if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+    alignment = std::max(
+        alignment, static_cast<size_t>(limits.minUniformBufferOffsetAlignment));
+  }
+  if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+    alignment = std::max(
+        alignment, static_cast<size_t>(limits.minStorageBufferOffsetAlignment));
+  }
+  if (usage & (VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT |
+               VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT)) {
+    alignment = std::max(
+        alignment, static_cast<size_t>(limits.minTexelBufferOffsetAlignment));
+  }
+  return alignment;
+}
+
+// BufferUpdateBatch collects the copies that BufferFrameData::UpdateBuffer
+// would otherwise submit one at a time, and records all of the copies for a
+// frame into a single command buffer, with one barrier before and one
+// barrier after all of them.
+class BufferUpdateBatch {
+ public:
+  // |buffered_data_count| is the number of frames that may be in flight at
+  // once. Typically this is one per swapchain image.
+  BufferUpdateBatch(VulkanApplication* application, size_t buffered_data_count,
+                    uint32_t queue_family_index = 0)
+      : command_buffers_(application->GetAllocator()),
+        copies_(application->GetAllocator()),
+        current_frame_(0),
+        dst_access_(0) {
+    for (size_t i = 0; i < buffered_data_count; ++i) {
+      command_buffers_.push_back(
+          application->GetCommandBuffer(queue_family_index));
+    }
+  }
+
+  // Starts collecting the copies for |frame_index|. The command buffer of the
+  // last use of |frame_index| must have finished executing.
+  void BeginFrame(size_t frame_index) {
+    current_frame_ = frame_index;
+    copies_.clear();
+    dst_access_ = 0;
+  }
+
+  // Adds a copy of |region| from |src| to |dst|, which is read with
+  // |dst_access| afterwards.
+  void AddCopy(::VkBuffer src, ::VkBuffer dst, const VkBufferCopy& region,
+               VkAccessFlags dst_access) {
+    copies_.push_back({src, dst, region});
+    dst_access_ |= dst_access;
+  }
+
+  // Records every copy added since BeginFrame into the command buffer for
+  // the frame, and returns it, or returns nullptr if there is nothing to
+  // copy.
+  VkCommandBuffer* End() {
+    if (copies_.empty()) {
+      return nullptr;
+    }
+    VkCommandBuffer& command_buffer = command_buffers_[current_frame_];
+    VkCommandBufferBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+        nullptr,                                      // pNext
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+        nullptr                                       // pInheritanceInfo
+    };
+    command_buffer->vkBeginCommandBuffer(command_buffer, &begin_info);
+    VkMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        VK_ACCESS_HOST_WRITE_BIT,          // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT        // dstAccessMask
+    };
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_HOST_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+        nullptr);
+    for (const auto& copy : copies_) {
+      command_buffer->vkCmdCopyBuffer(command_buffer, copy.src, copy.dst, 1,
+                                      &copy.region);
+    }
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dst_access_;
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0,
+        nullptr);
+    command_buffer->vkEndCommandBuffer(command_buffer);
+    copies_.clear();
+    return &command_buffer;
+  }
+
+ private:
+  struct Copy {
+    ::VkBuffer src;
+    ::VkBuffer dst;
+    VkBufferCopy region;
+  };
+
+  containers::vector<VkCommandBuffer> command_buffers_;
+  containers::vector<Copy> copies_;
+  size_t current_frame_;
+  VkAccessFlags dst_access_;
+};
+
 template <typename T>
 class BufferFrameData {
   // BufferFrameData is a class that wraps some amount of data for multi-frame
@@ -35,25 +168,37 @@ class BufferFrameData {
   // when it is appropriate.
   // T can be any type that can be bitwise copied. The data will be mapped
   // byte for byte into a uniform buffer, so it it must have the proper
-  // alignment as defined in SPIR-V.
+  // alignment as defined in SPIR-V. For blocks with the scalar layout, T can
+  // use the types of shader_layout.h, and the layout of T can be checked
+  // against the shader at compile time, see there.
  public:
   // |buffered_data_count| is the number of buffered frames the uniform data
   // should produce. Typcially this is one per swapchain image. |usage| is the
   // VkBufferUsageFlags used for the underlying VkBuffer(s) that stores the
   // uniform data. Note that VK_BUFFER_USAGE_TRANSFER_DST_BIT will be added
   // along with |usage| to guarantee data can be copied to the underlying
-  // VkBuffer(s).
+  // VkBuffer(s). |flags| is a combination of BufferFrameDataFlags.
   BufferFrameData(VulkanApplication* application, size_t buffered_data_count,
-                  VkBufferUsageFlags usage, uint32_t device_mask = 0, uint32_t queue_family_index = 0)
+                  VkBufferUsageFlags usage, uint32_t device_mask = 0, uint32_t queue_family_index = 0,
+                  uint32_t flags = 0)
       : application_(application),
-        uninitialized_(application->GetAllocator()),
+        dirty_(application->GetAllocator()),
+        written_(application->GetAllocator()),
         update_commands_(application->GetAllocator()),
         device_mask_(device_mask),
-        queue_family_index_(queue_family_index) {
+        queue_family_index_(queue_family_index),
+        flags_(flags),
+        dst_access_(VK_ACCESS_UNIFORM_READ_BIT),
+        alignment_(GetFrameDataAlignment(application->device(), usage)) {
+    if ((usage & VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT) != 0) {
+      dst_access_ |= VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT;
+    }
     uint32_t dm = device_mask;
-    uninitialized_.insert(uninitialized_.begin(), buffered_data_count, true);
-    const size_t aligned_data_size =
-        RoundUp(sizeof(set_value_), kMaxOffsetAlignment);
+    dirty_.insert(dirty_.begin(), buffered_data_count, true);
+    if (!(flags & (kBufferFrameDataExplicitDirty | kBufferFrameDataDirect))) {
+      written_.resize(buffered_data_count * size());
+    }
+    const size_t aligned_data_size = this->aligned_data_size();
 
     uint32_t indices[VK_MAX_DEVICE_GROUP_SIZE];
 
@@ -82,11 +227,19 @@ class BufferFrameData {
         VK_SHARING_MODE_EXCLUSIVE,
         1,
         &queue_family_index_};
+    if (flags_ & kBufferFrameDataDirect) {
+      // The device reads the data straight from this buffer, so there is
+      // nothing to copy and no command buffers to record.
+      buffer_ = application_->CreateAndBindUploadBuffer(
+          &create_info, set == 0 ? nullptr : &indices[0]);
+      return;
+    }
     buffer_ = application_->CreateAndBindDeviceBuffer(
         &create_info, set == 0 ? nullptr : &indices[0]);
 
     create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    host_buffer_ = application_->CreateAndBindHostBuffer(
+    // This is written by the host every frame.
+    host_buffer_ = application_->CreateAndBindUploadBuffer(
         &create_info, set == 0 ? nullptr : &indices[0]);
 
     VkCommandBufferBeginInfo begin_info = {
@@ -125,10 +278,7 @@ class BufferFrameData {
           update_commands_.back(), *host_buffer_, *buffer_, 1, &region);
 
       barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-      barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
-      if ((usage & VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT) != 0) {
-        barrier.dstAccessMask |= VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT;
-      }
+      barrier.dstAccessMask = dst_access_;
       barrier.buffer = *buffer_;
       update_commands_.back()->vkCmdPipelineBarrier(
           update_commands_.back(), VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -141,20 +291,18 @@ class BufferFrameData {
 
   T& data() { return set_value_; }
 
+  // Marks the data as changed, so that the next UpdateBuffer for every frame
+  // writes it. Only needed with kBufferFrameDataExplicitDirty.
+  void Mark() { dirty_.assign(dirty_.size(), true); }
+
   // Enqueues an update operation on the queue if needed, to ensure
   // that the buffer is correct for the given index.
+  // With kBufferFrameDataDirect the data is written to the buffer directly,
+  // and nothing is submitted to |update_queue|. The buffer for
+  // |buffer_index| must not be in use by the device.
   void UpdateBuffer(VkQueue* update_queue, size_t buffer_index,
                     uint32_t kDeviceMask = 0, bool force = false) {
-    const size_t offset = get_offset_for_frame(buffer_index);
-    bool equal =
-        memcmp(&set_value_, host_buffer_->base_address() + offset, size()) == 0;
-    if (force || !equal || uninitialized_[buffer_index]) {
-      // If the data for this frame is not what was previously recorded into
-      // the buffer, then copy the data into the buffer and update it.
-      uninitialized_[buffer_index] = false;
-      memcpy(host_buffer_->base_address() + offset, &set_value_, size());
-      host_buffer_->flush(offset, aligned_data_size());
-
+    if (WriteData(buffer_index, force) && !(flags_ & kBufferFrameDataDirect)) {
       VkDeviceGroupSubmitInfo group_submit_info = {
           VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO,
           nullptr,
@@ -181,35 +329,103 @@ class BufferFrameData {
     }
   }
 
+  // Like UpdateBuffer above, but adds the copy to |batch| instead of
+  // submitting it, so that it executes once the command buffer returned by
+  // the batch's End() does. Data with a device mask is still submitted on
+  // its own to |update_queue|.
+  void UpdateBuffer(BufferUpdateBatch* batch, VkQueue* update_queue,
+                    size_t buffer_index, bool force = false) {
+    if (device_mask_ != 0) {
+      UpdateBuffer(update_queue, buffer_index, 0, force);
+      return;
+    }
+    if (WriteData(buffer_index, force) && !(flags_ & kBufferFrameDataDirect)) {
+      const size_t offset = get_offset_for_frame(buffer_index);
+      batch->AddCopy(*host_buffer_, *buffer_, {offset, offset, size()},
+                     dst_access_);
+    }
+  }
+
   // Returns the Uniform buffer backing the uniform data.
   ::VkBuffer get_buffer() const { return *buffer_; }
   // Returns the offset in the buffer for each frame.
   size_t get_offset_for_frame(size_t buffer_index) const {
     return aligned_data_size() * buffer_index;
   }
+  // Returns the dynamic offset that selects the data of |buffer_index| from
+  // a dynamic descriptor written with get_dynamic_descriptor_info(), so that
+  // one descriptor set serves every frame.
+  uint32_t get_dynamic_offset(size_t buffer_index) const {
+    return static_cast<uint32_t>(get_offset_for_frame(buffer_index));
+  }
+  // Returns the buffer info of a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+  // or VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC descriptor of the data.
+  VkDescriptorBufferInfo get_dynamic_descriptor_info() const {
+    return {
+        *buffer_,  // buffer
+        0,         // offset
+        size()     // range
+    };
+  }
   // Returns the size of the data used for each frame.
   size_t size() const { return sizeof(set_value_); }
 
   // Returns the aligned size of the data for each frame.
-  size_t aligned_data_size() const {
-    return RoundUp(size(), kMaxOffsetAlignment);
-  }
+  size_t aligned_data_size() const { return RoundUp(size(), alignment_); }
 
  private:
+  // Writes the data for |buffer_index| into the host-visible buffer if it has
+  // changed, or if |force| is true. Returns true if it was written.
+  bool WriteData(size_t buffer_index, bool force) {
+    const size_t offset = get_offset_for_frame(buffer_index);
+    VulkanApplication::Buffer* write_buffer =
+        (flags_ & kBufferFrameDataDirect) ? buffer_.get() : host_buffer_.get();
+    uint8_t* written =
+        written_.empty() ? nullptr : written_.data() + buffer_index * size();
+    bool changed = force || dirty_[buffer_index];
+    if (!changed && !(flags_ & kBufferFrameDataExplicitDirty)) {
+      changed = (flags_ & kBufferFrameDataDirect) ||
+                memcmp(&set_value_, written, size()) != 0;
+    }
+    if (!changed) {
+      return false;
+    }
+    // If the data for this frame is not what was previously recorded into
+    // the buffer, then copy the data into the buffer.
+    dirty_[buffer_index] = false;
+    if (written) {
+      memcpy(written, &set_value_, size());
+    }
+    StreamToMappedMemory(write_buffer->base_address() + offset, &set_value_,
+                         size());
+    write_buffer->flush(offset, aligned_data_size());
+    return true;
+  }
+
   VulkanApplication* application_;
-  containers::vector<bool> uninitialized_;
+  // True for every frame whose buffer has to be written on the next update.
+  containers::vector<bool> dirty_;
+  // A copy of what was last written for every frame, which UpdateBuffer
+  // compares against, as mapped memory is usually write-combined and very
+  // slow to read. Empty if the data is never compared.
+  containers::vector<uint8_t> written_;
   // This is the actual host piece of data that can be updated by the user.
   T set_value_;
   // This is the gpu-side buffer that contains the uniforms.
   containers::unique_ptr<VulkanApplication::Buffer> buffer_;
   // This is the host-side buffer that contains the data that can be copied to
-  // the uniforms.
+  // the uniforms. It is not used with kBufferFrameDataDirect.
   containers::unique_ptr<VulkanApplication::Buffer> host_buffer_;
   // These command-buffers contain the command needed to update the
   // device-buffer from the host buffer.
   containers::vector<VkCommandBuffer> update_commands_;
   uint32_t device_mask_;
   uint32_t queue_family_index_;
+  uint32_t flags_;
+  // How the device reads the buffer after it is updated.
+  VkAccessFlags dst_access_;
+  // The alignment of the data of every frame in the buffer.
+  size_t alignment_;
 };
 }  // namespace vulkan
 
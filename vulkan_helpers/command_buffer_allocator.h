@@ -0,0 +1,167 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_COMMAND_BUFFER_ALLOCATOR_H
+#define VULKAN_HELPERS_COMMAND_BUFFER_ALLOCATOR_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+#include <cstdint>
+#include <mutex>
+
+namespace vulkan {
+
+// CommandBufferAllocator hands out command buffers that only live for one
+// frame. Every frame has its own transient command pool for every queue
+// family, and all of the command buffers of a frame are reclaimed at once by
+// resetting its pools the next time that frame begins. The command buffers
+// themselves are kept, and handed out again, so once every frame has been
+// through its busiest use nothing is allocated or freed anymore.
+//
+// BeginFrame(i) must only be called once the GPU is done with everything
+// that was submitted for the previous use of frame i.
+//
+// If |callbacks| is not nullptr, the driver allocates its host memory for the
+// pools with them, and they have to outlive this.
+class CommandBufferAllocator {
+ public:
+  CommandBufferAllocator(containers::Allocator* allocator, VkDevice* device,
+                         const VkAllocationCallbacks* callbacks = nullptr)
+      : allocator_(allocator),
+        device_(device),
+        callbacks_(callbacks),
+        pools_(allocator),
+        current_frame_(0),
+        num_allocated_(0) {}
+
+  // Returns a command buffer of |level| for |queue_family_index| in the
+  // initial state. It belongs to the current frame, must not be freed, and
+  // is only valid until BeginFrame is next called for that frame.
+  VkCommandBuffer* Allocate(
+      uint32_t queue_family_index = 0,
+      VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FramePool* pool = GetPool(current_frame_, queue_family_index);
+    const bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    auto& command_buffers =
+        primary ? pool->primary_buffers : pool->secondary_buffers;
+    size_t& num_used = primary ? pool->num_primary : pool->num_secondary;
+    if (num_used == command_buffers.size()) {
+      command_buffers.push_back(containers::make_unique<VkCommandBuffer>(
+          allocator_, CreateCommandBuffer(&pool->pool, level, device_)));
+      ++num_allocated_;
+    }
+    return command_buffers[num_used++].get();
+  }
+
+  // Reclaims every command buffer that was handed out the last time
+  // |frame_index| began, and makes it the frame that new command buffers
+  // belong to.
+  void BeginFrame(size_t frame_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_frame_ = frame_index;
+    for (auto& pool : pools_) {
+      if (pool->frame != frame_index ||
+          pool->num_primary + pool->num_secondary == 0) {
+        continue;
+      }
+      (*device_)->vkResetCommandPool(*device_, pool->pool, 0);
+      pool->num_primary = 0;
+      pool->num_secondary = 0;
+    }
+  }
+
+  // The number of command buffers that were allocated.
+  size_t num_allocated() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_allocated_;
+  }
+
+ private:
+  // The command pool of one queue family for one frame, and the command
+  // buffers that were allocated from it so far.
+  struct FramePool {
+    FramePool(containers::Allocator* allocator, VkDevice* device,
+              const VkAllocationCallbacks* callbacks, size_t frame,
+              uint32_t queue_family_index)
+        : frame(frame),
+          queue_family_index(queue_family_index),
+          pool(CreatePool(device, callbacks, queue_family_index)),
+          primary_buffers(allocator),
+          secondary_buffers(allocator),
+          num_primary(0),
+          num_secondary(0) {}
+
+    static VkCommandPool CreatePool(VkDevice* device,
+                                    const VkAllocationCallbacks* callbacks,
+                                    uint32_t queue_family_index) {
+      VkCommandPoolCreateInfo info = {
+          VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,  // sType
+          nullptr,                                     // pNext
+          VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,        // flags
+          queue_family_index                           // queueFamilyIndex
+      };
+      ::VkCommandPool raw_pool;
+      LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
+                 (*device)->vkCreateCommandPool(*device, &info, callbacks,
+                                                &raw_pool));
+      return VkCommandPool(raw_pool, callbacks, device);
+    }
+
+    size_t frame;
+    uint32_t queue_family_index;
+    // The command buffers have to be freed before their pool.
+    VkCommandPool pool;
+    containers::vector<containers::unique_ptr<VkCommandBuffer>>
+        primary_buffers;
+    containers::vector<containers::unique_ptr<VkCommandBuffer>>
+        secondary_buffers;
+    // The number of command buffers of each level that are in use.
+    size_t num_primary;
+    size_t num_secondary;
+  };
+
+  FramePool* GetPool(size_t frame, uint32_t queue_family_index) {
+    for (auto& pool : pools_) {
+      if (pool->frame == frame &&
+          pool->queue_family_index == queue_family_index) {
+        return pool.get();
+      }
+    }
+    pools_.push_back(containers::make_unique<FramePool>(
+        allocator_, allocator_, device_, callbacks_, frame,
+        queue_family_index));
+    return pools_.back().get();
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  const VkAllocationCallbacks* callbacks_;
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  containers::vector<containers::unique_ptr<FramePool>> pools_;
+  size_t current_frame_;
+  size_t num_allocated_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_COMMAND_BUFFER_ALLOCATOR_H
@@ -0,0 +1,153 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_CONDITIONAL_PREDICATES_H
+#define VULKAN_HELPERS_CONDITIONAL_PREDICATES_H
+
+#include "support/containers/unique_ptr.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// ConditionalPredicates is a buffer of one 32 bit predicate per object, that
+// shaders write and that VK_EXT_conditional_rendering reads, so that the
+// draws and dispatches of an object are skipped on the GPU, without the CPU
+// ever reading back whether the object was needed. The device must have
+// been created with VK_EXT_conditional_rendering.
+//
+// Every frame records, outside of a render pass:
+//   predicates.Clear(&cmd, 0);
+//   // A dispatch that writes the predicates.
+//   predicates.WaitForShaders(&cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+// or GpuCulling::Cull(), which does all of that for its instances,
+// and then, anywhere in that command buffer:
+//   predicates.Begin(&cmd, object);
+//   // The draws or dispatches of object.
+//   predicates.End(&cmd);
+//
+// A predicate that is not 0 lets the work between Begin() and End() run.
+class ConditionalPredicates {
+ public:
+  ConditionalPredicates(VulkanApplication* application,
+                        uint32_t num_predicates)
+      : application_(application),
+        num_predicates_(num_predicates) {
+    buffer_ = application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+        num_predicates_ * sizeof(uint32_t),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT);
+  }
+
+  // Records setting every predicate to |value|, and makes that visible to
+  // the shaders that write the rest of them. The conditional rendering of
+  // the previous frame is done with the buffer before it is written again.
+  void Clear(VkCommandBuffer* cmd, uint32_t value) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    VkBufferMemoryBarrier before =
+        Barrier(0, VK_ACCESS_TRANSFER_WRITE_BIT);
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer,
+        VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &before, 0,
+        nullptr);
+    cmdBuffer->vkCmdFillBuffer(cmdBuffer, *buffer_, 0, VK_WHOLE_SIZE, value);
+    VkBufferMemoryBarrier after =
+        Barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 1, &after, 0, nullptr);
+  }
+
+  // Records a barrier that makes the predicates that were written by
+  // shaders in |shader_stages| visible to Begin(). This must be recorded
+  // outside of a render pass.
+  void WaitForShaders(VkCommandBuffer* cmd,
+                      VkPipelineStageFlags shader_stages) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    VkBufferMemoryBarrier barrier =
+        Barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT);
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, shader_stages,
+        VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT, 0, 0, nullptr, 1,
+        &barrier, 0, nullptr);
+  }
+
+  // Records the start of the work that only runs if the predicate |index|
+  // is not 0, or, if |inverted|, only if it is 0. Every Begin() needs an
+  // End() in the same command buffer, and in the same subpass if it was
+  // recorded in one. Conditional rendering does not nest.
+  void Begin(VkCommandBuffer* cmd, uint32_t index, bool inverted = false) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    LOG_ASSERT(<, application_->GetLogger(), index, num_predicates_);
+    VkConditionalRenderingBeginInfoEXT begin_info{
+        VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT,  // sType
+        nullptr,                                                 // pNext
+        *buffer_,                                                // buffer
+        index * sizeof(uint32_t),                                // offset
+        static_cast<VkConditionalRenderingFlagsEXT>(
+            inverted ? VK_CONDITIONAL_RENDERING_INVERTED_BIT_EXT
+                     : 0),  // flags
+    };
+    cmdBuffer->vkCmdBeginConditionalRenderingEXT(cmdBuffer, &begin_info);
+  }
+
+  void End(VkCommandBuffer* cmd) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    cmdBuffer->vkCmdEndConditionalRenderingEXT(cmdBuffer);
+  }
+
+  // The predicates, for the descriptors of the shaders that write them.
+  VkDescriptorBufferInfo descriptor_info() const {
+    return {
+        *buffer_,       // buffer
+        0,              // offset
+        VK_WHOLE_SIZE,  // range
+    };
+  }
+  ::VkBuffer buffer() const { return *buffer_; }
+  uint32_t num_predicates() const { return num_predicates_; }
+
+ private:
+  VkBufferMemoryBarrier Barrier(VkAccessFlags src_access,
+                                VkAccessFlags dst_access) const {
+    return {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        src_access,                               // srcAccessMask
+        dst_access,                               // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *buffer_,                                 // buffer
+        0,                                        // offset
+        VK_WHOLE_SIZE,                            // size
+    };
+  }
+
+  VulkanApplication* application_;
+  uint32_t num_predicates_;
+  containers::unique_ptr<VulkanApplication::Buffer> buffer_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_CONDITIONAL_PREDICATES_H
@@ -0,0 +1,122 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DEBUG_LABELS_H
+#define VULKAN_HELPERS_DEBUG_LABELS_H
+
+#include "support/trace/trace.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/queue_wrapper.h"
+
+#include <cstdint>
+
+// Object names and labels from VK_EXT_debug_utils, so that captures and
+// vendor tools show the framework's objects and profiler zones by name.
+// Every function takes whether the instance was created with the extension,
+// see VulkanApplication::use_debug_utils(), and does nothing otherwise.
+// Building with -DVULKAN_DEBUG_LABELS=0 removes them entirely.
+#ifndef VULKAN_DEBUG_LABELS
+#define VULKAN_DEBUG_LABELS 1
+#endif
+
+namespace vulkan {
+
+// Names the object |handle| of |type|. |name| is copied by the driver.
+inline void SetObjectName(DeviceFunctions* functions, ::VkDevice device,
+                          bool enabled, VkObjectType type, uint64_t handle,
+                          const char* name) {
+#if VULKAN_DEBUG_LABELS
+  if (enabled) {
+    VkDebugUtilsObjectNameInfoEXT name_info{
+        VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,  // sType
+        nullptr,                                             // pNext
+        type,                                                // objectType
+        handle,                                              // objectHandle
+        name                                                 // pObjectName
+    };
+    functions->vkSetDebugUtilsObjectNameEXT(device, &name_info);
+  }
+#endif
+}
+
+// Opens the label |name| in |cmd|, which EndCmdLabel closes.
+inline void BeginCmdLabel(VkCommandBuffer* cmd, bool enabled,
+                          const char* name) {
+#if VULKAN_DEBUG_LABELS
+  if (enabled) {
+    VkDebugUtilsLabelEXT label{
+        VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,  // sType
+        nullptr,                                  // pNext
+        name,                                     // pLabelName
+        {0.0f, 0.0f, 0.0f, 0.0f}                  // color
+    };
+    (*cmd)->vkCmdBeginDebugUtilsLabelEXT(*cmd, &label);
+  }
+#endif
+}
+
+inline void EndCmdLabel(VkCommandBuffer* cmd, bool enabled) {
+#if VULKAN_DEBUG_LABELS
+  if (enabled) {
+    (*cmd)->vkCmdEndDebugUtilsLabelEXT(*cmd);
+  }
+#endif
+}
+
+// Opens the label |name| on |queue|, which EndQueueLabel closes. Everything
+// submitted to |queue| in between is inside the label.
+inline void BeginQueueLabel(VkQueue* queue, bool enabled, const char* name) {
+#if VULKAN_DEBUG_LABELS
+  if (enabled) {
+    VkDebugUtilsLabelEXT label{
+        VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,  // sType
+        nullptr,                                  // pNext
+        name,                                     // pLabelName
+        {0.0f, 0.0f, 0.0f, 0.0f}                  // color
+    };
+    (*queue)->vkQueueBeginDebugUtilsLabelEXT(*queue, &label);
+  }
+#endif
+}
+
+inline void EndQueueLabel(VkQueue* queue, bool enabled) {
+#if VULKAN_DEBUG_LABELS
+  if (enabled) {
+    (*queue)->vkQueueEndDebugUtilsLabelEXT(*queue);
+  }
+#endif
+}
+
+// Records a CPU zone like TRACE_ZONE, and puts what is submitted to |queue|
+// during its lifetime into a queue label of the same name, so the submits
+// line up with the CPU zone in a capture.
+class QueueZone {
+ public:
+  QueueZone(VkQueue* queue, bool enabled, const char* name)
+      : zone_(name), queue_(queue), enabled_(enabled) {
+    BeginQueueLabel(queue_, enabled_, name);
+  }
+  ~QueueZone() { EndQueueLabel(queue_, enabled_); }
+
+ private:
+  trace::Zone zone_;
+  VkQueue* queue_;
+  bool enabled_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DEBUG_LABELS_H
@@ -0,0 +1,116 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DEFERRED_DELETION_QUEUE_H
+#define VULKAN_HELPERS_DEFERRED_DELETION_QUEUE_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace vulkan {
+
+// DeferredDeletionQueue keeps objects that are no longer needed, but may
+// still be in use by frames in flight, until the GPU is done with them.
+// Anything that cleans up when it is destroyed can be deleted through it,
+// e.g. a BufferPointer or ImagePointer, which also give their memory back to
+// their arena, or a VkSubObject wrapper held by value. An object that is
+// deleted while frame i is current is destroyed the next time frame i
+// begins.
+//
+// BeginFrame(i) must only be called once the GPU is done with everything
+// that was submitted for the previous use of frame i, and everything that
+// was submitted before it on the same queue.
+class DeferredDeletionQueue {
+ public:
+  DeferredDeletionQueue(containers::Allocator* allocator)
+      : allocator_(allocator), entries_(allocator), current_frame_(0) {}
+
+  // Takes ownership of |object|, and destroys it once the current frame is
+  // done on the GPU. |object| has to be an rvalue, e.g. std::move(buffer).
+  template <typename T>
+  void Delete(T&& object) {
+    static_assert(!std::is_lvalue_reference<T>::value,
+                  "The object has to be moved into the queue.");
+    containers::unique_ptr<Deletable> deletable =
+        containers::make_unique<Holder<T>>(allocator_, std::move(object));
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back(Entry{current_frame_, std::move(deletable)});
+  }
+
+  // Destroys everything that was deleted the last time |frame_index| was
+  // current, and makes it the current frame.
+  void BeginFrame(size_t frame_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_frame_ = frame_index;
+    // Objects are destroyed in the order that they were deleted in, so that
+    // e.g. a view is destroyed before its image.
+    size_t num_kept = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      if (entries_[i].frame == frame_index) {
+        entries_[i].object.reset();
+      } else {
+        if (i != num_kept) {
+          entries_[num_kept] = std::move(entries_[i]);
+        }
+        ++num_kept;
+      }
+    }
+    entries_.resize(num_kept);
+  }
+
+  // Destroys everything right away. The GPU has to be idle.
+  void Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+  }
+
+  // The number of objects that have not been destroyed yet.
+  size_t num_pending() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  struct Deletable {
+    virtual ~Deletable() {}
+  };
+
+  template <typename T>
+  struct Holder : public Deletable {
+    Holder(T&& object) : object(std::move(object)) {}
+    T object;
+  };
+
+  struct Entry {
+    // The frame that was current when the object was deleted.
+    size_t frame;
+    containers::unique_ptr<Deletable> object;
+  };
+
+  containers::Allocator* allocator_;
+  std::mutex mutex_;
+  // Guarded by mutex_, in the order that the objects were deleted in.
+  containers::vector<Entry> entries_;
+  size_t current_frame_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DEFERRED_DELETION_QUEUE_H
@@ -0,0 +1,518 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DEPTH_PYRAMID_H
+#define VULKAN_HELPERS_DEPTH_PYRAMID_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/structure_chain.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace vulkan {
+
+// DepthPyramid builds a hierarchical min/max depth pyramid from a depth
+// image in a single compute dispatch. Every texel of a level holds the
+// nearest and the farthest depth, in r and g, of the 2x2 texels that it
+// covers in the level before, and the first level is half the size of the
+// depth image. The pyramid can be sampled by a culling stage, see view(),
+// and a low resolution level of it can be read back to the host through a
+// ring of buffers, for occlusion decisions on the CPU that never wait for
+// the GPU.
+//
+// The shader is shader_library/culling/depth_pyramid_spd.comp, or
+// culling/depth_pyramid_spd_subgroup.comp from shader_library_subgroup if
+// SubgroupsSupported(), which the application adds to its SHADERS, e.g.
+//   uint32_t pyramid_shader[] =
+//   #include "culling/depth_pyramid_spd.comp.spv"
+//       ;
+//
+// Every frame records, outside of a render pass, after the depth was
+// rendered:
+//   pyramid.Build(&cmd, depth_index, frame_index);
+// and once the fence of that frame has been waited on, a later frame may
+// read pyramid.readback(frame_index).
+class DepthPyramid {
+ public:
+  // These must match culling/depth_pyramid_spd.glsl.
+  static const uint32_t kGroupSize = 256;
+  static const uint32_t kMaxLevels = 13;
+  // Every workgroup reduces this many depth texels in both dimensions.
+  static const uint32_t kDepthTileSize = 64;
+  // Build() records no readback with this slot.
+  static const size_t kNoReadback = ~size_t(0);
+
+  // The depth images that the pyramid is built from are |depth_width| by
+  // |depth_height|, at most 8192 in both. If |num_readback_slots| is not 0,
+  // the first level that is at most |max_readback_size| in both dimensions
+  // can be read back, with one host buffer for every slot.
+  template <size_t N>
+  DepthPyramid(VulkanApplication* application, uint32_t depth_width,
+               uint32_t depth_height, uint32_t (&shader)[N],
+               size_t num_readback_slots = 0, uint32_t max_readback_size = 64)
+      : DepthPyramid(application, depth_width, depth_height, shader, N,
+                     num_readback_slots, max_readback_size) {}
+
+  DepthPyramid(VulkanApplication* application, uint32_t depth_width,
+               uint32_t depth_height, uint32_t* shader, size_t shader_words,
+               size_t num_readback_slots = 0, uint32_t max_readback_size = 64)
+      : application_(application),
+        depth_width_(depth_width),
+        depth_height_(depth_height),
+        num_levels_(1),
+        readback_level_(0),
+        counter_initialized_(false),
+        level_views_(application->GetAllocator()),
+        depth_sources_(application->GetAllocator()),
+        readback_buffers_(application->GetAllocator()) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    uint32_t width = (depth_width_ + 1) / 2;
+    uint32_t height = (depth_height_ + 1) / 2;
+    width_ = width;
+    height_ = height;
+    readback_width_ = width;
+    readback_height_ = height;
+    while (width > 1 || height > 1) {
+      width = (width + 1) / 2;
+      height = (height + 1) / 2;
+      ++num_levels_;
+      if (readback_width_ > max_readback_size ||
+          readback_height_ > max_readback_size) {
+        readback_width_ = width;
+        readback_height_ = height;
+        ++readback_level_;
+      }
+    }
+    LOG_ASSERT(<=, application_->GetLogger(), num_levels_, kMaxLevels);
+    // The levels are rounded up, but mip levels round down, so the image
+    // is a power of two large, and only the size of every level is used.
+    uint32_t image_width = 1;
+    uint32_t image_height = 1;
+    while (image_width < width_) {
+      image_width *= 2;
+    }
+    while (image_height < height_) {
+      image_height *= 2;
+    }
+
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        VK_FORMAT_R32G32_SFLOAT,              // format
+        {
+            image_width,   // width
+            image_height,  // height
+            1,             // depth
+        },                 // extent
+        num_levels_,  // mipLevels
+        1,            // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,    // samples
+        VK_IMAGE_TILING_OPTIMAL,  // tiling
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    pyramid_ = application_->CreateAndBindImage(&image_create_info);
+    pyramid_view_ = application_->CreateImageView(
+        pyramid_.get(), VK_IMAGE_VIEW_TYPE_2D,
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, num_levels_, 0, 1});
+    for (uint32_t i = 0; i < num_levels_; ++i) {
+      level_views_.push_back(application_->CreateImageView(
+          pyramid_.get(), VK_IMAGE_VIEW_TYPE_2D,
+          {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1}));
+    }
+    // Only texelFetch reads the depth through the sampler.
+    sampler_ = containers::make_unique<VkSampler>(
+        allocator, CreateSampler(&application_->device(), VK_FILTER_NEAREST,
+                                 VK_FILTER_NEAREST));
+    counter_ = application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+        sizeof(uint32_t),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    bindings_[0] = {
+        0,                                          // binding
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+        1,                                          // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+        nullptr                                     // pImmutableSamplers
+    };
+    bindings_[1] = {
+        1,                                 // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  // descriptorType
+        kMaxLevels,                        // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,       // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    bindings_[2] = {
+        2,                                  // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(PyramidData)           // size
+    };
+    pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator,
+        application_->CreatePipelineLayout(
+            {{bindings_[0], bindings_[1], bindings_[2]}}, {range}));
+    pipeline_ = containers::make_unique<VulkanComputePipeline>(
+        allocator, application_->CreateComputePipeline(
+                       pipeline_layout_.get(),
+                       VkShaderModuleCreateInfo{
+                           VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                           nullptr, 0, shader_words * sizeof(uint32_t),
+                           shader},
+                       "main"));
+
+    for (size_t i = 0; i < num_readback_slots; ++i) {
+      readback_buffers_.push_back(
+          application_->CreateAndBindDefaultExclusiveHostBuffer(
+              readback_width_ * readback_height_ * 2 * sizeof(float),
+              VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+    }
+  }
+
+  // Adds a depth image that the pyramid can be built from, e.g. the depth
+  // buffer of one frame, and returns its index for Build(). The image needs
+  // VK_IMAGE_USAGE_SAMPLED_BIT, and |view| must only have the depth aspect.
+  size_t AddDepthSource(::VkImage image, ::VkImageView view) {
+    depth_sources_.push_back(DepthSource());
+    DepthSource& source = depth_sources_.back();
+    source.image = image;
+    source.set = containers::make_unique<DescriptorSet>(
+        application_->GetAllocator(),
+        application_->AllocateDescriptorSet(
+            {bindings_[0], bindings_[1], bindings_[2]}));
+    VkDescriptorImageInfo image_infos[1 + kMaxLevels];
+    image_infos[0] = {
+        *sampler_,                                        // sampler
+        view,                                             // imageView
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,  // imageLayout
+    };
+    // The levels that the pyramid does not have are never written, but
+    // every descriptor of the array has to be valid.
+    for (uint32_t i = 0; i < kMaxLevels; ++i) {
+      image_infos[1 + i] = {
+          VK_NULL_HANDLE,                               // sampler
+          *level_views_[std::min(i, num_levels_ - 1)],  // imageView
+          VK_IMAGE_LAYOUT_GENERAL,                      // imageLayout
+      };
+    }
+    VkDescriptorBufferInfo buffer_info = {
+        *counter_,      // buffer
+        0,              // offset
+        VK_WHOLE_SIZE,  // range
+    };
+    VkWriteDescriptorSet writes[3] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+            nullptr,                                    // pNext
+            *source.set,                                // dstSet
+            0,                                          // dstbinding
+            0,                                          // dstArrayElement
+            1,                                          // descriptorCount
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+            image_infos,                                // pImageInfo
+            nullptr,                                    // pBufferInfo
+            nullptr,                                    // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *source.set,                             // dstSet
+            1,                                       // dstbinding
+            0,                                       // dstArrayElement
+            kMaxLevels,                              // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,        // descriptorType
+            image_infos + 1,                         // pImageInfo
+            nullptr,                                 // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *source.set,                             // dstSet
+            2,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            &buffer_info,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 3,
+                                                   writes, 0, nullptr);
+    return depth_sources_.size() - 1;
+  }
+
+  // Returns true if the device can run
+  // culling/depth_pyramid_spd_subgroup.comp: a Vulkan 1.1 device with
+  // clustered subgroup operations in compute shaders, and subgroups of at
+  // least 16 invocations. The instance needs
+  // VK_KHR_get_physical_device_properties2.
+  static bool SubgroupsSupported(VulkanApplication* application) {
+    StructureChain<VkPhysicalDeviceProperties2,
+                   VkPhysicalDeviceSubgroupProperties>
+        properties;
+    application->instance()->vkGetPhysicalDeviceProperties2KHR(
+        application->device().physical_device(), properties.head());
+    const VkPhysicalDeviceSubgroupProperties& subgroup_properties =
+        properties.get<VkPhysicalDeviceSubgroupProperties>();
+    const VkSubgroupFeatureFlags operations =
+        VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_CLUSTERED_BIT;
+    return properties.head()->properties.apiVersion >= VK_API_VERSION_1_1 &&
+           (subgroup_properties.supportedStages &
+            VK_SHADER_STAGE_COMPUTE_BIT) &&
+           (subgroup_properties.supportedOperations & operations) ==
+               operations &&
+           subgroup_properties.subgroupSize >= 16;
+  }
+
+  // Records the reduction of the depth source |depth_index| to the
+  // pyramid. The depth image must be in
+  // VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, which it is in again
+  // afterwards. Unless |readback_slot| is kNoReadback, the readback level
+  // is also copied to that slot. This must be recorded outside of a render
+  // pass, and the frames that build the pyramid must be submitted to the
+  // same queue.
+  void Build(VkCommandBuffer* cmd, size_t depth_index,
+             size_t readback_slot = kNoReadback) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    const DepthSource& source = depth_sources_[depth_index];
+
+    if (!counter_initialized_) {
+      cmdBuffer->vkCmdFillBuffer(cmdBuffer, *counter_, 0, sizeof(uint32_t),
+                                 0);
+      VkMemoryBarrier counter_barrier = {
+          VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+          nullptr,                           // pNext
+          VK_ACCESS_TRANSFER_WRITE_BIT,      // srcAccessMask
+          VK_ACCESS_SHADER_READ_BIT |
+              VK_ACCESS_SHADER_WRITE_BIT,  // dstAccessMask
+      };
+      cmdBuffer->vkCmdPipelineBarrier(
+          cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &counter_barrier, 0,
+          nullptr, 0, nullptr);
+      counter_initialized_ = true;
+    }
+
+    VkImageMemoryBarrier start_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,            // sType
+            nullptr,                                           // pNext
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,      // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT,                         // dstAccessMask
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // oldLayout
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,   // newLayout
+            VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+            source.image,             // image
+            {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1},  // subresourceRange
+        },
+        {
+            // The previous contents of the pyramid were only needed by the
+            // stages that read it before this.
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+            nullptr,                                 // pNext
+            0,                                       // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT,  // dstAccessMask
+            VK_IMAGE_LAYOUT_UNDEFINED,       // oldLayout
+            VK_IMAGE_LAYOUT_GENERAL,    // newLayout
+            VK_QUEUE_FAMILY_IGNORED,    // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,    // dstQueueFamilyIndex
+            *pyramid_,                  // image
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, num_levels_, 0,
+             1},  // subresourceRange
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer,
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | kReaderStages |
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2,
+        start_barriers);
+
+    const uint32_t groups_x =
+        (depth_width_ + kDepthTileSize - 1) / kDepthTileSize;
+    const uint32_t groups_y =
+        (depth_height_ + kDepthTileSize - 1) / kDepthTileSize;
+    PyramidData data = {
+        {static_cast<int32_t>(depth_width_),
+         static_cast<int32_t>(depth_height_)},  // source_size
+        num_levels_,                            // num_levels
+        groups_x * groups_y,                    // num_groups
+    };
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1, &source.set->raw_set(), 0,
+        nullptr);
+    cmdBuffer->vkCmdPushConstants(
+        cmdBuffer, ::VkPipelineLayout(*pipeline_layout_),
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(data), &data);
+    cmdBuffer->vkCmdDispatch(cmdBuffer, groups_x, groups_y, 1);
+
+    // The pyramid is read by the culling, and copied for the readback.
+    VkImageMemoryBarrier end_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+            nullptr,                                 // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,              // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_TRANSFER_READ_BIT,  // dstAccessMask
+            VK_IMAGE_LAYOUT_GENERAL,  // oldLayout
+            VK_IMAGE_LAYOUT_GENERAL,  // newLayout
+            VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+            *pyramid_,                // image
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, num_levels_, 0,
+             1},  // subresourceRange
+        },
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+            nullptr,                                 // pNext
+            0,                                       // srcAccessMask
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,  // dstAccessMask
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,   // oldLayout
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // newLayout
+            VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+            source.image,             // image
+            {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1},  // subresourceRange
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        kReaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 2, end_barriers);
+
+    if (readback_slot == kNoReadback) {
+      return;
+    }
+    VkBufferImageCopy region = {
+        0,  // bufferOffset
+        0,  // bufferRowLength
+        0,  // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, readback_level_, 0,
+         1},                                     // imageSubresource
+        {0, 0, 0},                               // imageOffset
+        {readback_width_, readback_height_, 1},  // imageExtent
+    };
+    cmdBuffer->vkCmdCopyImageToBuffer(cmdBuffer, *pyramid_,
+                                      VK_IMAGE_LAYOUT_GENERAL,
+                                      *readback_buffers_[readback_slot], 1,
+                                      &region);
+    VkMemoryBarrier host_barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,      // srcAccessMask
+        VK_ACCESS_HOST_READ_BIT,           // dstAccessMask
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &host_barrier, 0, nullptr, 0, nullptr);
+  }
+
+  // Returns the nearest and farthest depth of every texel of the readback
+  // level that was copied to |slot|, readback_width() by readback_height()
+  // pairs in rows. The commands that copied it must have finished, e.g.
+  // because the fence of their frame was waited on.
+  const float* readback(size_t slot) {
+    readback_buffers_[slot]->invalidate();
+    return reinterpret_cast<const float*>(
+        readback_buffers_[slot]->base_address());
+  }
+
+  // All of the levels, in VK_IMAGE_LAYOUT_GENERAL, and a sampler for
+  // texelFetch, for the stages that test against the pyramid.
+  ::VkImageView view() const { return *pyramid_view_; }
+  ::VkSampler sampler() const { return *sampler_; }
+  VkImageLayout layout() const { return VK_IMAGE_LAYOUT_GENERAL; }
+
+  uint32_t num_levels() const { return num_levels_; }
+  // The size of the first level.
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  uint32_t readback_level() const { return readback_level_; }
+  uint32_t readback_width() const { return readback_width_; }
+  uint32_t readback_height() const { return readback_height_; }
+
+ private:
+  // The stages that may read the pyramid between two Build()s.
+  static const VkPipelineStageFlags kReaderStages =
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+  // This must match pyramid_data in culling/depth_pyramid_spd.glsl.
+  struct PyramidData {
+    int32_t source_size[2];
+    uint32_t num_levels;
+    uint32_t num_groups;
+  };
+
+  struct DepthSource {
+    ::VkImage image;
+    containers::unique_ptr<DescriptorSet> set;
+  };
+
+  VulkanApplication* application_;
+  uint32_t depth_width_;
+  uint32_t depth_height_;
+  // The size of the first level of the pyramid.
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t num_levels_;
+  uint32_t readback_level_;
+  uint32_t readback_width_;
+  uint32_t readback_height_;
+  // Whether the counter of finished workgroups was set to 0.
+  bool counter_initialized_;
+
+  VkDescriptorSetLayoutBinding bindings_[3];
+  containers::unique_ptr<PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> pipeline_;
+  containers::unique_ptr<VulkanApplication::Image> pyramid_;
+  // All of the levels, for the culling, and every level on its own, for
+  // the shader.
+  containers::unique_ptr<VkImageView> pyramid_view_;
+  containers::vector<containers::unique_ptr<VkImageView>> level_views_;
+  containers::unique_ptr<VkSampler> sampler_;
+  containers::unique_ptr<VulkanApplication::Buffer> counter_;
+  containers::vector<DepthSource> depth_sources_;
+  containers::vector<containers::unique_ptr<VulkanApplication::Buffer>>
+      readback_buffers_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DEPTH_PYRAMID_H
@@ -0,0 +1,330 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DESCRIPTOR_ALLOCATOR_H
+#define VULKAN_HELPERS_DESCRIPTOR_ALLOCATOR_H
+
+#include "support/containers/flat_hash_map.h"
+#include "support/containers/small_vector.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+
+namespace vulkan {
+
+// DescriptorAllocator hands out descriptor sets from shared pools, instead
+// of creating a pool for every set. Sets are bucketed by the number of
+// descriptors of each type that they hold, and every bucket is a chain of
+// pools that grows, each pool twice the size of the last, once the pools
+// it has are full.
+//
+// Persistent sets are freed back to their pool when they are destroyed.
+// Transient sets are owned by the frame they were allocated in, and are
+// all reclaimed at once by resetting their pools the next time that frame
+// begins. BeginFrame(i) must only be called once the GPU is done with
+// everything that was submitted for the previous use of frame i.
+class DescriptorAllocator {
+ private:
+  // The first pool of a bucket holds this many sets, and every pool after
+  // it twice as many as the one before, up to kMaxSetsPerPool.
+  static const uint32_t kInitialSetsPerPool = 16;
+  static const uint32_t kMaxSetsPerPool = 1024;
+  static const size_t kPersistentFrame = ~size_t(0);
+  // Sets rarely use more descriptor types than this, so their pool sizes
+  // are gathered without allocating.
+  static const size_t kInlinePoolSizes = 4;
+
+  struct Pool {
+    VkDescriptorPool pool;
+    uint32_t num_sets;
+    // The number of sets that can still be allocated from the pool. Every
+    // set of a bucket is the same size, so this also bounds the number of
+    // descriptors that are used, without relying on the driver to report
+    // VK_ERROR_OUT_OF_POOL_MEMORY.
+    uint32_t num_free;
+  };
+
+  struct Bucket {
+    Bucket(containers::Allocator* allocator, size_t frame)
+        : sizes(allocator),
+          pools(allocator),
+          frame(frame),
+          current(0),
+          next_pool_sets(kInitialSetsPerPool) {}
+    // The descriptors of a single set, sorted by type.
+    containers::vector<VkDescriptorPoolSize> sizes;
+    containers::vector<Pool> pools;
+    // The frame that owns the sets of this bucket, or kPersistentFrame.
+    size_t frame;
+    // The first pool that may have room for another set.
+    size_t current;
+    uint32_t next_pool_sets;
+  };
+
+ public:
+  // A persistent descriptor set, that is freed when it is destroyed.
+  class Set {
+   public:
+    Set()
+        : allocator_(nullptr),
+          set_(VK_NULL_HANDLE),
+          bucket_(nullptr),
+          pool_index_(0) {}
+    Set(Set&& other)
+        : allocator_(other.allocator_),
+          set_(other.set_),
+          bucket_(other.bucket_),
+          pool_index_(other.pool_index_) {
+      other.set_ = VK_NULL_HANDLE;
+    }
+    ~Set() {
+      if (set_ != VK_NULL_HANDLE) {
+        allocator_->Free(set_, bucket_, pool_index_);
+      }
+    }
+
+    operator ::VkDescriptorSet() const { return set_; }
+    const ::VkDescriptorSet& raw_set() const { return set_; }
+    ::VkDescriptorPool pool() const {
+      return bucket_->pools[pool_index_].pool.get_raw_object();
+    }
+
+   private:
+    friend class DescriptorAllocator;
+    Set(DescriptorAllocator* allocator, ::VkDescriptorSet set, Bucket* bucket,
+        size_t pool_index)
+        : allocator_(allocator),
+          set_(set),
+          bucket_(bucket),
+          pool_index_(pool_index) {}
+
+    DescriptorAllocator* allocator_;
+    ::VkDescriptorSet set_;
+    Bucket* bucket_;
+    size_t pool_index_;
+  };
+
+  DescriptorAllocator(containers::Allocator* allocator, VkDevice* device)
+      : allocator_(allocator),
+        device_(device),
+        buckets_(allocator),
+        bucket_map_(allocator),
+        current_frame_(0),
+        num_pools_(0) {}
+
+  // Allocates a set with |layout|, which was created from |bindings|.
+  Set Allocate(::VkDescriptorSetLayout layout,
+               std::initializer_list<VkDescriptorSetLayoutBinding> bindings) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Bucket* bucket = GetBucket(bindings, kPersistentFrame);
+    size_t pool_index = 0;
+    ::VkDescriptorSet set = AllocateFromBucket(bucket, layout, &pool_index);
+    return Set(this, set, bucket, pool_index);
+  }
+
+  // Allocates a set with |layout|, which was created from |bindings|, that
+  // belongs to the current frame. It must not be freed, and is only valid
+  // until BeginFrame is next called for the current frame.
+  ::VkDescriptorSet AllocateTransient(
+      ::VkDescriptorSetLayout layout,
+      std::initializer_list<VkDescriptorSetLayoutBinding> bindings) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Bucket* bucket = GetBucket(bindings, current_frame_);
+    size_t pool_index = 0;
+    return AllocateFromBucket(bucket, layout, &pool_index);
+  }
+
+  // Reclaims every transient set that was allocated the last time
+  // |frame_index| began, and makes it the frame that new transient sets
+  // belong to.
+  void BeginFrame(size_t frame_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_frame_ = frame_index;
+    for (auto& bucket : buckets_) {
+      if (bucket->frame != frame_index) {
+        continue;
+      }
+      for (auto& pool : bucket->pools) {
+        if (pool.num_free != pool.num_sets) {
+          (*device_)->vkResetDescriptorPool(*device_, pool.pool, 0);
+          pool.num_free = pool.num_sets;
+        }
+      }
+      bucket->current = 0;
+    }
+  }
+
+  // The number of pools that were created.
+  size_t num_pools() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_pools_;
+  }
+
+ private:
+  // Returns the bucket for sets with |bindings| that belong to |frame|,
+  // creating it if needed.
+  Bucket* GetBucket(
+      std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
+      size_t frame) {
+    containers::small_vector<VkDescriptorPoolSize, kInlinePoolSizes> sizes(
+        allocator_);
+    for (const auto& binding : bindings) {
+      auto it =
+          std::find_if(sizes.begin(), sizes.end(),
+                       [&binding](const VkDescriptorPoolSize& size) {
+                         return size.type == binding.descriptorType;
+                       });
+      if (it == sizes.end()) {
+        sizes.push_back({binding.descriptorType, binding.descriptorCount});
+      } else {
+        it->descriptorCount += binding.descriptorCount;
+      }
+    }
+    std::sort(sizes.begin(), sizes.end(),
+              [](const VkDescriptorPoolSize& a, const VkDescriptorPoolSize& b) {
+                return a.type < b.type;
+              });
+
+    // 64 bit FNV-1a over the frame and sizes.
+    uint64_t hash = (0xcbf29ce484222325ull ^ frame) * 0x100000001b3ull;
+    for (const auto& size : sizes) {
+      hash = (hash ^ size.type) * 0x100000001b3ull;
+      hash = (hash ^ size.descriptorCount) * 0x100000001b3ull;
+    }
+
+    auto candidates = bucket_map_.find(hash);
+    if (candidates == bucket_map_.end()) {
+      candidates =
+          bucket_map_
+              .emplace(hash, containers::vector<Bucket*>(allocator_))
+              .first;
+    }
+    for (Bucket* bucket : candidates->second) {
+      if (bucket->frame == frame && bucket->sizes.size() == sizes.size() &&
+          std::equal(sizes.begin(), sizes.end(), bucket->sizes.begin(),
+                     [](const VkDescriptorPoolSize& a,
+                        const VkDescriptorPoolSize& b) {
+                       return a.type == b.type &&
+                              a.descriptorCount == b.descriptorCount;
+                     })) {
+        return bucket;
+      }
+    }
+    buckets_.push_back(
+        containers::make_unique<Bucket>(allocator_, allocator_, frame));
+    Bucket* bucket = buckets_.back().get();
+    bucket->sizes.assign(sizes.begin(), sizes.end());
+    candidates->second.push_back(bucket);
+    return bucket;
+  }
+
+  ::VkDescriptorSet AllocateFromBucket(Bucket* bucket,
+                                       ::VkDescriptorSetLayout layout,
+                                       size_t* pool_index) {
+    VkDescriptorSetAllocateInfo alloc_info{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,  // sType
+        nullptr,                                         // pNext
+        VK_NULL_HANDLE,                                  // descriptorPool
+        1,                                               // descriptorSetCount
+        &layout                                          // pSetLayouts
+    };
+    while (true) {
+      while (bucket->current < bucket->pools.size() &&
+             bucket->pools[bucket->current].num_free == 0) {
+        ++bucket->current;
+      }
+      if (bucket->current == bucket->pools.size()) {
+        AddPool(bucket);
+      }
+      Pool& pool = bucket->pools[bucket->current];
+      alloc_info.descriptorPool = pool.pool;
+      ::VkDescriptorSet set = VK_NULL_HANDLE;
+      VkResult result =
+          (*device_)->vkAllocateDescriptorSets(*device_, &alloc_info, &set);
+      if (result == VK_SUCCESS) {
+        --pool.num_free;
+        *pool_index = bucket->current;
+        return set;
+      }
+      // Freed sets can leave a pool too fragmented for another one.
+      LOG_ASSERT(==, device_->GetLogger(), true,
+                 result == VK_ERROR_OUT_OF_POOL_MEMORY ||
+                     result == VK_ERROR_FRAGMENTED_POOL);
+      pool.num_free = 0;
+    }
+  }
+
+  void AddPool(Bucket* bucket) {
+    const uint32_t num_sets = bucket->next_pool_sets;
+    bucket->next_pool_sets =
+        num_sets * 2 < kMaxSetsPerPool ? num_sets * 2 : kMaxSetsPerPool;
+    containers::small_vector<VkDescriptorPoolSize, kInlinePoolSizes> sizes(
+        bucket->sizes.begin(), bucket->sizes.end(), allocator_);
+    for (auto& size : sizes) {
+      size.descriptorCount *= num_sets;
+    }
+    VkDescriptorPoolCreateInfo create_info{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,  // sType
+        nullptr,                                        // pNext
+        bucket->frame == kPersistentFrame
+            ? VkDescriptorPoolCreateFlags(
+                  VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+            : VkDescriptorPoolCreateFlags(0),  // flags
+        num_sets,                              // maxSets
+        static_cast<uint32_t>(sizes.size()),   // poolSizeCount
+        sizes.data()                           // pPoolSizes
+    };
+    ::VkDescriptorPool pool;
+    LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+               (*device_)->vkCreateDescriptorPool(*device_, &create_info,
+                                                  nullptr, &pool));
+    bucket->pools.push_back({
+        VkDescriptorPool(pool, nullptr, device_),  // pool
+        num_sets,                                  // num_sets
+        num_sets                                   // num_free
+    });
+    ++num_pools_;
+  }
+
+  void Free(::VkDescriptorSet set, Bucket* bucket, size_t pool_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Pool& pool = bucket->pools[pool_index];
+    (*device_)->vkFreeDescriptorSets(*device_, pool.pool, 1, &set);
+    // The pool has room again.
+    ++pool.num_free;
+    bucket->current = std::min(bucket->current, pool_index);
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  std::mutex mutex_;
+  // Everything below is guarded by mutex_.
+  containers::vector<containers::unique_ptr<Bucket>> buckets_;
+  // Buckets keyed by a hash of their frame and sizes.
+  containers::flat_hash_map<uint64_t, containers::vector<Bucket*>> bucket_map_;
+  size_t current_frame_;
+  size_t num_pools_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DESCRIPTOR_ALLOCATOR_H
@@ -0,0 +1,247 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DESCRIPTOR_WRITER_H
+#define VULKAN_HELPERS_DESCRIPTOR_WRITER_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// DescriptorWriter updates every descriptor of a set of one layout with a
+// single driver call. It is built once from the bindings of the layout, and
+// then fed with a packed host struct that holds one descriptor info for
+// every descriptor, in the order of the bindings: a VkDescriptorImageInfo
+// for samplers, images and input attachments, a VkDescriptorBufferInfo for
+// buffers and a ::VkBufferView for texel buffers.
+//
+// With VK_KHR_descriptor_update_template this is a descriptor update
+// template, otherwise the writes are built up front and only pointed at the
+// struct for every update, so a writer must not be used from several threads
+// at once. The same writes can be pushed into a command buffer instead, for
+// sets whose layout was created with
+// VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR.
+//
+// Example, for a uniform buffer at binding 0 and a sampler at binding 1:
+//   struct Descriptors {
+//     VkDescriptorBufferInfo uniforms;
+//     VkDescriptorImageInfo sampler;
+//   };
+//   writer.Write(set, Descriptors{...});
+class DescriptorWriter {
+ public:
+  DescriptorWriter(containers::Allocator* allocator, VkDevice* device,
+                   ::VkDescriptorSetLayout layout,
+                   const containers::vector<VkDescriptorSetLayoutBinding>&
+                       bindings,
+                   bool use_template)
+      : device_(device),
+        template_(VK_NULL_HANDLE, nullptr, device),
+        writes_(allocator),
+        offsets_(allocator),
+        size_(0) {
+    containers::vector<VkDescriptorUpdateTemplateEntry> entries(allocator);
+    for (const auto& binding : bindings) {
+      if (binding.descriptorCount == 0) {
+        continue;
+      }
+      size_t info_size = 0;
+      size_t info_alignment = 0;
+      GetInfoSize(binding.descriptorType, &info_size, &info_alignment);
+      size_ = (size_ + info_alignment - 1) / info_alignment * info_alignment;
+      entries.push_back({
+          binding.binding,          // dstBinding
+          0,                        // dstArrayElement
+          binding.descriptorCount,  // descriptorCount
+          binding.descriptorType,   // descriptorType
+          size_,                    // offset
+          info_size                 // stride
+      });
+      size_ += info_size * binding.descriptorCount;
+    }
+
+    if (use_template) {
+      VkDescriptorUpdateTemplateCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,  // sType
+          nullptr,                                                   // pNext
+          0,                                                         // flags
+          static_cast<uint32_t>(
+              entries.size()),  // descriptorUpdateEntryCount
+          entries.data(),       // pDescriptorUpdateEntries
+          VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,  // templateType
+          layout,                           // descriptorSetLayout
+          VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+          VK_NULL_HANDLE,                   // pipelineLayout
+          0,                                // set
+      };
+      ::VkDescriptorUpdateTemplate update_template;
+      LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+                 (*device_)->vkCreateDescriptorUpdateTemplateKHR(
+                     *device_, &create_info, nullptr, &update_template));
+      template_.initialize(update_template);
+    }
+
+    writes_.reserve(entries.size());
+    offsets_.reserve(entries.size());
+    for (const auto& entry : entries) {
+      writes_.push_back({
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+          nullptr,                                 // pNext
+          VK_NULL_HANDLE,                          // dstSet
+          entry.dstBinding,                        // dstBinding
+          0,                                       // dstArrayElement
+          entry.descriptorCount,                   // descriptorCount
+          entry.descriptorType,                    // descriptorType
+          nullptr,                                 // pImageInfo
+          nullptr,                                 // pBufferInfo
+          nullptr                                  // pTexelBufferView
+      });
+      offsets_.push_back(entry.offset);
+    }
+  }
+
+  DescriptorWriter(DescriptorWriter&& other) = default;
+
+  // The size of the host struct that every update is read from.
+  size_t size() const { return size_; }
+
+  // Writes every descriptor of |set| from the |size| bytes at |data|.
+  void Write(::VkDescriptorSet set, const void* data, size_t size) {
+    LOG_ASSERT(==, device_->GetLogger(), size_, size);
+    if (template_.get_raw_object() != VK_NULL_HANDLE) {
+      (*device_)->vkUpdateDescriptorSetWithTemplateKHR(*device_, set,
+                                                       template_, data);
+      return;
+    }
+    PointWrites(set, data);
+    (*device_)->vkUpdateDescriptorSets(*device_,
+                                       static_cast<uint32_t>(writes_.size()),
+                                       writes_.data(), 0, nullptr);
+  }
+
+  // Writes every descriptor of |set| from |data|, which has to be laid out
+  // as described above.
+  template <typename T>
+  void Write(::VkDescriptorSet set, const T& data) {
+    Write(set, &data, sizeof(T));
+  }
+
+  // Pushes every descriptor from the |size| bytes at |data| into
+  // |command_buffer|, as set |set| of |layout|. The device must have been
+  // created with VK_KHR_push_descriptor. No descriptor set is allocated.
+  void Push(VkCommandBuffer* command_buffer, VkPipelineBindPoint bind_point,
+            ::VkPipelineLayout layout, uint32_t set, const void* data,
+            size_t size) {
+    LOG_ASSERT(==, device_->GetLogger(), size_, size);
+    PointWrites(VK_NULL_HANDLE, data);
+    (*command_buffer)
+        ->vkCmdPushDescriptorSetKHR(*command_buffer, bind_point, layout, set,
+                                    static_cast<uint32_t>(writes_.size()),
+                                    writes_.data());
+  }
+
+  template <typename T>
+  void Push(VkCommandBuffer* command_buffer, VkPipelineBindPoint bind_point,
+            ::VkPipelineLayout layout, uint32_t set, const T& data) {
+    Push(command_buffer, bind_point, layout, set, &data, sizeof(T));
+  }
+
+ private:
+  enum Kind { kImageInfo, kBufferInfo, kTexelBufferView };
+
+  // Points the writes at |set| and the infos in |data|.
+  void PointWrites(::VkDescriptorSet set, const void* data) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < writes_.size(); ++i) {
+      VkWriteDescriptorSet& write = writes_[i];
+      const uint8_t* info = bytes + offsets_[i];
+      write.dstSet = set;
+      switch (InfoKind(write.descriptorType)) {
+        case kImageInfo:
+          write.pImageInfo =
+              reinterpret_cast<const VkDescriptorImageInfo*>(info);
+          break;
+        case kBufferInfo:
+          write.pBufferInfo =
+              reinterpret_cast<const VkDescriptorBufferInfo*>(info);
+          break;
+        case kTexelBufferView:
+          write.pTexelBufferView =
+              reinterpret_cast<const ::VkBufferView*>(info);
+          break;
+      }
+    }
+  }
+
+  Kind InfoKind(VkDescriptorType type) const {
+    switch (type) {
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        return kImageInfo;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        return kBufferInfo;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        return kTexelBufferView;
+      default:
+        LOG_CRASH(device_->GetLogger(),
+                  "Unsupported descriptor type for a DescriptorWriter");
+        return kBufferInfo;
+    }
+  }
+
+  void GetInfoSize(VkDescriptorType type, size_t* size,
+                   size_t* alignment) const {
+    switch (InfoKind(type)) {
+      case kImageInfo:
+        *size = sizeof(VkDescriptorImageInfo);
+        *alignment = alignof(VkDescriptorImageInfo);
+        break;
+      case kBufferInfo:
+        *size = sizeof(VkDescriptorBufferInfo);
+        *alignment = alignof(VkDescriptorBufferInfo);
+        break;
+      case kTexelBufferView:
+        *size = sizeof(::VkBufferView);
+        *alignment = alignof(::VkBufferView);
+        break;
+    }
+  }
+
+  VkDevice* device_;
+  // VK_NULL_HANDLE if the writes below are used for updates instead.
+  VkDescriptorUpdateTemplate template_;
+  // Only dstSet and the info pointers change between updates, or pushes.
+  containers::vector<VkWriteDescriptorSet> writes_;
+  // The offset in the host struct of the infos of every write.
+  containers::vector<size_t> offsets_;
+  size_t size_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DESCRIPTOR_WRITER_H
@@ -0,0 +1,200 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DISPATCH_BATCH_H_
+#define VULKAN_HELPERS_DISPATCH_BATCH_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace vulkan {
+
+// DispatchBatch runs many small dispatches of one compute pipeline as a
+// single vkCmdDispatch. A table that the host writes holds the small
+// dispatch of every workgroup of the batch, and the shader looks up which
+// one it runs, and its workgroup in it, through
+// shader_library/dispatch/dispatch_batch.glsl. This saves the overhead of
+// every vkCmdDispatch, and lets the workgroups of small dispatches fill the
+// whole GPU, but the dispatches must not depend on each other, since their
+// workgroups may run in any order and at the same time. Every small
+// dispatch only has workgroups in x.
+//
+// The tables are host buffers in one of |num_slots| slots, e.g. one for
+// every frame in flight. Every frame records:
+//   batch.Add(group_count, param0, param1);  // For every small dispatch.
+//   cmd->vkCmdBindPipeline(...);
+//   cmd->vkCmdBindDescriptorSets(...);  // Set 0 has the slot's tables.
+//   batch.Record(&cmd, frame_index);
+// and a slot must not be recorded again before the GPU is done with it.
+class DispatchBatch {
+ public:
+  // This must match batched_dispatch in dispatch/dispatch_batch.glsl.
+  struct Dispatch {
+    uint32_t first_group;
+    uint32_t group_count;
+    uint32_t param0;
+    uint32_t param1;
+  };
+
+  // A batch has at most |max_groups| workgroups of at most |max_dispatches|
+  // small dispatches.
+  DispatchBatch(VulkanApplication* application, uint32_t max_groups,
+                uint32_t max_dispatches, size_t num_slots = 1)
+      : application_(application),
+        max_groups_(max_groups),
+        max_dispatches_(max_dispatches),
+        num_groups_(0),
+        dispatches_(application->GetAllocator()),
+        group_tables_(application->GetAllocator()),
+        dispatch_tables_(application->GetAllocator()) {
+    dispatches_.reserve(max_dispatches_);
+    for (size_t i = 0; i < num_slots; ++i) {
+      group_tables_.push_back(
+          application_->CreateAndBindDefaultExclusiveHostBuffer(
+              max_groups_ * sizeof(uint32_t),
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+      dispatch_tables_.push_back(
+          application_->CreateAndBindDefaultExclusiveHostBuffer(
+              sizeof(TableHeader) + max_dispatches_ * sizeof(Dispatch),
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+    }
+  }
+
+  // Returns the bindings of the tables at |binding| and the binding after
+  // it, for the descriptor set layout of the pipeline. |binding| must be
+  // the DISPATCH_BATCH_BINDING of the shader.
+  static void GetBindings(uint32_t binding,
+                          VkDescriptorSetLayoutBinding (&bindings)[2]) {
+    for (uint32_t i = 0; i < 2; ++i) {
+      bindings[i] = {
+          binding + i,                        // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+  }
+
+  // Writes the tables of |slot| to |binding| and the binding after it of
+  // |set|.
+  void WriteDescriptors(::VkDescriptorSet set, uint32_t binding,
+                        size_t slot) {
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {*group_tables_[slot], 0, VK_WHOLE_SIZE},
+        {*dispatch_tables_[slot], 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        set,                                     // dstSet
+        binding,                                 // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 1,
+                                                   &write, 0, nullptr);
+  }
+
+  // Adds a small dispatch of |group_count| workgroups, that the shader can
+  // tell apart from the others by |param0| and |param1|, and returns its
+  // index in the batch.
+  uint32_t Add(uint32_t group_count, uint32_t param0 = 0,
+               uint32_t param1 = 0) {
+    LOG_ASSERT(<, application_->GetLogger(), dispatches_.size(),
+               max_dispatches_);
+    LOG_ASSERT(<=, application_->GetLogger(), num_groups_ + group_count,
+               max_groups_);
+    dispatches_.push_back({num_groups_, group_count, param0, param1});
+    num_groups_ += group_count;
+    return static_cast<uint32_t>(dispatches_.size() - 1);
+  }
+
+  // Writes the tables of the dispatches that were added since the last
+  // Record() to |slot|, and records one vkCmdDispatch of all of them. The
+  // pipeline, and a descriptor set with the tables of |slot|, must be bound
+  // already. The batch is empty afterwards, and nothing is recorded if it
+  // was empty before.
+  void Record(VkCommandBuffer* cmd, size_t slot) {
+    if (num_groups_ == 0) {
+      return;
+    }
+    uint32_t* groups =
+        reinterpret_cast<uint32_t*>(group_tables_[slot]->base_address());
+    for (uint32_t i = 0; i < dispatches_.size(); ++i) {
+      const Dispatch& dispatch = dispatches_[i];
+      std::fill(groups + dispatch.first_group,
+                groups + dispatch.first_group + dispatch.group_count, i);
+    }
+    char* dispatches = dispatch_tables_[slot]->base_address();
+    TableHeader header = {num_groups_, {0, 0, 0}};
+    memcpy(dispatches, &header, sizeof(header));
+    memcpy(dispatches + sizeof(header), dispatches_.data(),
+           dispatches_.size() * sizeof(Dispatch));
+    group_tables_[slot]->flush();
+    dispatch_tables_[slot]->flush();
+
+    // Batches with more workgroups than a dispatch may have in x are
+    // rounded up to rows of them.
+    const uint32_t max_x =
+        application_->device().limits().maxComputeWorkGroupCount[0];
+    const uint32_t x = std::min(num_groups_, max_x);
+    const uint32_t y = (num_groups_ + x - 1) / x;
+    (*cmd)->vkCmdDispatch(*cmd, x, y, 1);
+
+    dispatches_.clear();
+    num_groups_ = 0;
+  }
+
+  // The workgroups and the small dispatches that were added since the last
+  // Record().
+  uint32_t num_groups() const { return num_groups_; }
+  uint32_t num_dispatches() const {
+    return static_cast<uint32_t>(dispatches_.size());
+  }
+
+ private:
+  // This must match the start of dispatch_batch_dispatches in
+  // dispatch/dispatch_batch.glsl.
+  struct TableHeader {
+    uint32_t num_groups;
+    uint32_t padding[3];
+  };
+
+  VulkanApplication* application_;
+  uint32_t max_groups_;
+  uint32_t max_dispatches_;
+  uint32_t num_groups_;
+  containers::vector<Dispatch> dispatches_;
+  // The small dispatch of every workgroup, for every slot.
+  containers::vector<containers::unique_ptr<VulkanApplication::Buffer>>
+      group_tables_;
+  // The header and the small dispatches, for every slot.
+  containers::vector<containers::unique_ptr<VulkanApplication::Buffer>>
+      dispatch_tables_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DISPATCH_BATCH_H_
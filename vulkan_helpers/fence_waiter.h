@@ -0,0 +1,179 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_FENCE_WAITER_H
+#define VULKAN_HELPERS_FENCE_WAITER_H
+
+#include "support/log/log.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace vulkan {
+
+// FenceWaiter waits for fences and timeline semaphore values on the CPU, and
+// returns how long every wait took. Blocking in the driver lets the thread
+// sleep, but the wakeup after the GPU has signaled can take a while, which
+// shows up as jitter in the frame times. Spinning for a while before
+// blocking, or blocking with short timeouts, trades CPU time for a quicker
+// response.
+class FenceWaiter {
+ public:
+  enum class Policy {
+    // Blocks in the driver until the wait is done.
+    kBlock,
+    // Polls the status without blocking for up to the interval, and blocks
+    // once it has passed.
+    kSpin,
+    // Blocks for at most the interval at a time, until the wait is done.
+    kPoll,
+  };
+
+  static const uint64_t kDefaultSpinIntervalNs = 1000000;
+  static const uint64_t kDefaultPollIntervalNs = 100000;
+
+  // Parses a policy of -fence-wait: "block", "spin" or "poll", optionally
+  // followed by ":<microseconds>" for the interval. Returns false if |name|
+  // is none of them.
+  static bool ParsePolicy(const char* name, Policy* policy,
+                          uint64_t* interval_ns) {
+    const char* colon = strchr(name, ':');
+    const size_t length = colon ? colon - name : strlen(name);
+    if (length == 5 && strncmp(name, "block", 5) == 0) {
+      *policy = Policy::kBlock;
+      *interval_ns = 0;
+    } else if (length == 4 && strncmp(name, "spin", 4) == 0) {
+      *policy = Policy::kSpin;
+      *interval_ns = kDefaultSpinIntervalNs;
+    } else if (length == 4 && strncmp(name, "poll", 4) == 0) {
+      *policy = Policy::kPoll;
+      *interval_ns = kDefaultPollIntervalNs;
+    } else {
+      return false;
+    }
+    if (colon) {
+      *interval_ns = strtoull(colon + 1, nullptr, 10) * 1000;
+    }
+    // Polling with no timeout would never block at all.
+    if (*policy == Policy::kPoll && *interval_ns == 0) {
+      *interval_ns = 1;
+    }
+    return true;
+  }
+
+  static const char* PolicyName(Policy policy) {
+    switch (policy) {
+      case Policy::kBlock:
+        return "block";
+      case Policy::kSpin:
+        return "spin";
+      case Policy::kPoll:
+        return "poll";
+    }
+    return "";
+  }
+
+  FenceWaiter(VkDevice* device, Policy policy, uint64_t interval_ns)
+      : device_(device), policy_(policy), interval_ns_(interval_ns) {}
+
+  // Waits until |fence| is signaled, and returns how long that took in
+  // seconds.
+  float WaitForFence(::VkFence fence) {
+    return Wait(
+        [this, fence]() {
+          return (*device_)->vkGetFenceStatus(*device_, fence) == VK_SUCCESS;
+        },
+        [this, &fence](uint64_t timeout_ns) {
+          return (*device_)->vkWaitForFences(*device_, 1, &fence, VK_FALSE,
+                                             timeout_ns);
+        });
+  }
+
+  // Waits until |timeline| has reached |value|, and returns how long that
+  // took in seconds. The device must have VK_KHR_timeline_semaphore.
+  float WaitForSemaphoreValue(::VkSemaphore timeline, uint64_t value) {
+    VkSemaphoreWaitInfoKHR wait_info{
+        VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        1,                                          // semaphoreCount
+        &timeline,                                  // pSemaphores
+        &value                                      // pValues
+    };
+    return Wait(
+        [this, timeline, value]() {
+          uint64_t current = 0;
+          return (*device_)->vkGetSemaphoreCounterValueKHR(
+                     *device_, timeline, &current) == VK_SUCCESS &&
+                 current >= value;
+        },
+        [this, &wait_info](uint64_t timeout_ns) {
+          return (*device_)->vkWaitSemaphoresKHR(*device_, &wait_info,
+                                                 timeout_ns);
+        });
+  }
+
+  Policy policy() const { return policy_; }
+  uint64_t interval_ns() const { return interval_ns_; }
+
+ private:
+  // |signaled| returns true once the wait is done, without blocking.
+  // |wait| blocks for at most the given timeout, and returns VK_SUCCESS once
+  // the wait is done, or VK_TIMEOUT.
+  template <typename IsSignaled, typename BlockFor>
+  float Wait(const IsSignaled& signaled, const BlockFor& wait) {
+    const auto start = std::chrono::steady_clock::now();
+    switch (policy_) {
+      case Policy::kBlock:
+        LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+                   wait(0xFFFFFFFFFFFFFFFF));
+        break;
+      case Policy::kSpin: {
+        const std::chrono::nanoseconds interval(interval_ns_);
+        bool done = signaled();
+        while (!done && std::chrono::steady_clock::now() - start < interval) {
+          done = signaled();
+        }
+        if (!done) {
+          LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+                     wait(0xFFFFFFFFFFFFFFFF));
+        }
+        break;
+      }
+      case Policy::kPoll: {
+        VkResult result = wait(interval_ns_);
+        while (result == VK_TIMEOUT) {
+          result = wait(interval_ns_);
+        }
+        LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS, result);
+        break;
+      }
+    }
+    return std::chrono::duration<float>(std::chrono::steady_clock::now() -
+                                        start)
+        .count();
+  }
+
+  VkDevice* device_;
+  Policy policy_;
+  uint64_t interval_ns_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_FENCE_WAITER_H
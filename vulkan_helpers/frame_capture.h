@@ -0,0 +1,420 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_FRAME_CAPTURE_H
+#define VULKAN_HELPERS_FRAME_CAPTURE_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/jobs/job_system.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace vulkan {
+
+// FrameCapture copies frames into a ring of readback buffers, and writes
+// every frame to a file of its own from worker threads, so that capturing a
+// sequence of frames barely slows down the frames that are being measured.
+// A frame only waits if every buffer of the ring is still being written.
+//
+// Frames are written as 8-bit RGB PNG files, or as the raw pixels of the
+// image. There is no deflate implementation in the tree, so the image data
+// of the PNG files is stored in uncompressed deflate blocks, and the work
+// that is spread over the threads is the frames.
+//
+// CompleteFrames(tag) must only be called once the commands that Capture()
+// recorded with |tag| have finished on the GPU, e.g. after waiting on the
+// fence of the frame slot that |tag| numbers.
+class FrameCapture {
+ public:
+  // Frame N is written to |file_name| with _N inserted before its extension,
+  // which becomes .png, or .raw if |raw| is true. The ring has one buffer for
+  // each of the |num_frames_in_flight| and each of the |num_threads| workers.
+  // |format| must have 4 bytes per pixel, only 8-bit RGBA and BGRA formats
+  // can be written as PNG.
+  FrameCapture(VulkanApplication* application, uint32_t width,
+               uint32_t height, VkFormat format, const char* file_name,
+               bool raw, size_t num_frames_in_flight, size_t num_threads)
+      : application_(application),
+        width_(width),
+        height_(height),
+        raw_(raw),
+        bgra_(format == VK_FORMAT_B8G8R8A8_UNORM ||
+              format == VK_FORMAT_B8G8R8A8_SRGB),
+        slots_(application->GetAllocator()),
+        job_system_(application->GetAllocator(), num_threads + 1),
+        group_(&job_system_),
+        num_written_(0),
+        failed_(false),
+        finished_(false) {
+    if (!raw_ && !bgra_ && format != VK_FORMAT_R8G8B8A8_UNORM &&
+        format != VK_FORMAT_R8G8B8A8_SRGB) {
+      application_->GetLogger()->LogInfo(
+          "The swapchain format can not be written as PNG, writing raw "
+          "frames instead");
+      raw_ = true;
+    }
+    const std::string name(file_name);
+    const size_t slash = name.find_last_of("/\\");
+    const size_t dot = name.rfind('.');
+    const bool has_extension =
+        dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    file_prefix_ = has_extension ? name.substr(0, dot) : name;
+
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        VkDeviceSize(width_) * height_ * 4,    // size
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr                                // pQueueFamilyIndices
+    };
+    slots_.resize(num_frames_in_flight + num_threads);
+    for (Slot& slot : slots_) {
+      slot.buffer = application_->CreateAndBindReadbackBuffer(&create_info);
+      slot.state = kFree;
+      slot.frame = 0;
+      slot.tag = 0;
+    }
+  }
+
+  ~FrameCapture() { Finish(); }
+
+  // Records commands into |cmd| that copy |image|, which is in |layout| and
+  // is left in it. The frame is written as frame |frame| once
+  // CompleteFrames(|tag|) is called. This waits for a free buffer, if every
+  // one of them is still being written.
+  void Capture(VkCommandBuffer* cmd, ::VkImage image, VkImageLayout layout,
+               uint32_t frame, size_t tag) {
+    Slot* slot = AcquireSlot();
+    VkCommandBuffer& cmdBuffer = *cmd;
+    const VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1,
+                                           0, 1};
+
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        0,                                       // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT,             // dstAccessMask
+        layout,                                  // oldLayout
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,    // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        image,                                   // image
+        range                                    // subresourceRange
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    const VkBufferImageCopy region = {
+        slot->buffer->offset(),                 // bufferOffset
+        0,                                      // bufferRowLength
+        0,                                      // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},   // imageSubresource
+        {0, 0, 0},                              // imageOffset
+        {width_, height_, 1}                    // imageExtent
+    };
+    cmdBuffer->vkCmdCopyImageToBuffer(cmdBuffer, image,
+                                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                      *slot->buffer, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = layout;
+    const VkBufferMemoryBarrier buffer_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        VK_ACCESS_HOST_READ_BIT,                  // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *slot->buffer,                            // buffer
+        slot->buffer->offset(),                   // offset
+        slot->buffer->size()                      // size
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 1, &buffer_barrier, 1, &barrier);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot->state = kRecorded;
+    slot->frame = frame;
+    slot->tag = tag;
+  }
+
+  // Hands the frames that were captured with |tag| to the workers.
+  void CompleteFrames(size_t tag) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Slot& slot : slots_) {
+      if (slot.state == kRecorded && slot.tag == tag) {
+        StartWriting(&slot);
+      }
+    }
+  }
+
+  // Waits for the device to be idle, and for every captured frame to be
+  // written, and logs how many were.
+  void Finish() {
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    application_->device()->vkDeviceWaitIdle(application_->device());
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (Slot& slot : slots_) {
+        if (slot.state == kRecorded) {
+          StartWriting(&slot);
+        }
+      }
+    }
+    group_.Wait();
+    if (failed_) {
+      application_->GetLogger()->LogError("Could not write all of the frames");
+    }
+    application_->GetLogger()->LogInfo("Captured <", num_written_.load(),
+                                       "> frames to ", file_prefix_, "_*",
+                                       raw_ ? ".raw" : ".png");
+  }
+
+ private:
+  enum SlotState {
+    // The buffer can be used for the next frame.
+    kFree,
+    // The copy has been recorded, but may not have finished.
+    kRecorded,
+    // A worker is writing the frame.
+    kWriting,
+  };
+
+  struct Slot {
+    containers::unique_ptr<VulkanApplication::Buffer> buffer;
+    SlotState state;
+    uint32_t frame;
+    size_t tag;
+  };
+
+  Slot* AcquireSlot() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      bool writing = false;
+      for (Slot& slot : slots_) {
+        if (slot.state == kFree) {
+          return &slot;
+        }
+        writing |= slot.state == kWriting;
+      }
+      // Otherwise no buffer would ever become free.
+      LOG_ASSERT(==, application_->GetLogger(), true, writing);
+      slot_freed_.wait(lock);
+    }
+  }
+
+  // Must be called with mutex_ held.
+  void StartWriting(Slot* slot) {
+    slot->buffer->invalidate();
+    slot->state = kWriting;
+    group_.Run([this, slot]() {
+      Write(slot);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot->state = kFree;
+      }
+      slot_freed_.notify_one();
+    });
+  }
+
+  // Runs on a worker thread.
+  void Write(Slot* slot) {
+    char frame_suffix[16];
+    snprintf(frame_suffix, sizeof(frame_suffix), "_%06u", slot->frame);
+    const std::string name =
+        file_prefix_ + frame_suffix + (raw_ ? ".raw" : ".png");
+    std::ofstream file(name, std::ofstream::out | std::ofstream::binary);
+    const char* pixels = slot->buffer->base_address();
+    if (raw_) {
+      file.write(pixels, slot->buffer->size());
+    } else {
+      WritePng(&file, reinterpret_cast<const uint8_t*>(pixels));
+    }
+    file.close();
+    if (file.fail()) {
+      failed_ = true;
+    } else {
+      ++num_written_;
+    }
+  }
+
+  // The PNG chunk that is being written, and the CRC of its type and data.
+  struct PngChunk {
+    PngChunk(std::ofstream* file, const char* type, uint32_t length)
+        : file(file), crc(0xFFFFFFFF) {
+      WriteBigEndian(file, length);
+      Write(reinterpret_cast<const uint8_t*>(type), 4);
+    }
+    void Write(const uint8_t* data, size_t size) {
+      const uint32_t* table = CrcTable();
+      for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+      }
+      file->write(reinterpret_cast<const char*>(data), size);
+    }
+    void Write32(uint32_t value) {
+      const uint8_t bytes[4] = {
+          uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8),
+          uint8_t(value)};
+      Write(bytes, 4);
+    }
+    void End() { WriteBigEndian(file, crc ^ 0xFFFFFFFF); }
+
+    std::ofstream* file;
+    uint32_t crc;
+  };
+
+  static void WriteBigEndian(std::ofstream* file, uint32_t value) {
+    const char bytes[4] = {char(value >> 24), char(value >> 16),
+                           char(value >> 8), char(value)};
+    file->write(bytes, 4);
+  }
+
+  static const uint32_t* CrcTable() {
+    static const struct Table {
+      Table() {
+        for (uint32_t n = 0; n < 256; ++n) {
+          uint32_t c = n;
+          for (uint32_t k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+          }
+          values[n] = c;
+        }
+      }
+      uint32_t values[256];
+    } table;
+    return table.values;
+  }
+
+  void WritePng(std::ofstream* file, const uint8_t* pixels) const {
+    static const uint8_t kSignature[8] = {0x89, 'P',  'N',  'G',
+                                          '\r', '\n', 0x1A, '\n'};
+    // Deflate blocks that are stored, rather than compressed, hold at most
+    // this many bytes.
+    static const uint32_t kMaxStoredBlock = 65535;
+    static const uint32_t kAdlerModulus = 65521;
+    file->write(reinterpret_cast<const char*>(kSignature), 8);
+
+    PngChunk header(file, "IHDR", 13);
+    header.Write32(width_);
+    header.Write32(height_);
+    // 8 bits per channel, RGB, and the default compression, filter and
+    // interlace methods.
+    const uint8_t format[5] = {8, 2, 0, 0, 0};
+    header.Write(format, 5);
+    header.End();
+
+    // Every row starts with its filter type, 0 for none.
+    const uint32_t row_size = 1 + width_ * 3;
+    const uint32_t data_size = row_size * height_;
+    const uint32_t num_blocks =
+        (data_size + kMaxStoredBlock - 1) / kMaxStoredBlock;
+    PngChunk data(file, "IDAT", 2 + num_blocks * 5 + data_size + 4);
+    // The zlib header, for a 32K window without a preset dictionary.
+    const uint8_t zlib_header[2] = {0x78, 0x01};
+    data.Write(zlib_header, 2);
+
+    containers::vector<uint8_t> row(row_size, 0,
+                                    application_->GetAllocator());
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    uint32_t block_left = 0;
+    uint32_t data_left = data_size;
+    const uint32_t red = bgra_ ? 2 : 0;
+    const uint32_t blue = bgra_ ? 0 : 2;
+    for (uint32_t y = 0; y < height_; ++y) {
+      const uint8_t* src = pixels + size_t(y) * width_ * 4;
+      for (uint32_t x = 0; x < width_; ++x) {
+        row[1 + x * 3] = src[x * 4 + red];
+        row[2 + x * 3] = src[x * 4 + 1];
+        row[3 + x * 3] = src[x * 4 + blue];
+      }
+      for (uint32_t i = 0; i < row_size; ++i) {
+        adler_a += row[i];
+        adler_b += adler_a;
+        // The sums are reduced before they can overflow, which takes 5552
+        // bytes.
+        if ((i & 4095) == 4095) {
+          adler_a %= kAdlerModulus;
+          adler_b %= kAdlerModulus;
+        }
+      }
+      adler_a %= kAdlerModulus;
+      adler_b %= kAdlerModulus;
+
+      for (uint32_t written = 0; written < row_size;) {
+        if (block_left == 0) {
+          block_left = std::min(data_left, kMaxStoredBlock);
+          const uint8_t block_header[5] = {
+              uint8_t(block_left == data_left ? 1 : 0),  // BFINAL, stored
+              uint8_t(block_left), uint8_t(block_left >> 8),
+              uint8_t(~block_left), uint8_t(~block_left >> 8)};
+          data.Write(block_header, 5);
+        }
+        const uint32_t size = std::min(row_size - written, block_left);
+        data.Write(row.data() + written, size);
+        written += size;
+        block_left -= size;
+        data_left -= size;
+      }
+    }
+    data.Write32((adler_b << 16) | adler_a);
+    data.End();
+
+    PngChunk end(file, "IEND", 0);
+    end.End();
+  }
+
+  VulkanApplication* application_;
+  uint32_t width_;
+  uint32_t height_;
+  bool raw_;
+  bool bgra_;
+  std::string file_prefix_;
+  containers::vector<Slot> slots_;
+  // Guards the state of the slots.
+  std::mutex mutex_;
+  std::condition_variable slot_freed_;
+  jobs::JobSystem job_system_;
+  jobs::TaskGroup group_;
+  std::atomic<uint32_t> num_written_;
+  std::atomic<bool> failed_;
+  bool finished_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_FRAME_CAPTURE_H
@@ -0,0 +1,238 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_FRAME_PACER_H
+#define VULKAN_HELPERS_FRAME_PACER_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace vulkan {
+
+// FramePacer schedules the presents of one swapchain with
+// VK_GOOGLE_display_timing. Every frame is asked to be shown a whole number
+// of refresh cycles after it is presented, the refresh multiplier. It starts
+// at the target refresh divisor, grows by one for every group of late
+// presents, and shrinks again, never below the divisor, once 3 seconds
+// worth of presents in a row could have been shown a cycle earlier.
+//
+// Every present that the display reports back is also counted as late,
+// early or on time, for judging smoothness rather than throughput, and its
+// latency from vkQueuePresentKHR to the display is added up, as is its
+// latency from the input that the frame was rendered for, if known.
+//
+// With a refresh divisor of 0 the presents are not scheduled at all, they
+// are shown as soon as the present mode allows, and only their latencies
+// are measured.
+class FramePacer {
+ public:
+  struct Statistics {
+    uint64_t num_late;
+    uint64_t num_early;
+    uint64_t num_on_time;
+    // The sum of the times from GetPresentTime() to when the display showed
+    // the present, over num_latencies presents.
+    uint64_t total_latency_ns;
+    uint64_t num_latencies;
+    // The sum of the times from the input times given to GetPresentTime()
+    // to when the display showed the present, over num_input_latencies
+    // presents.
+    uint64_t total_input_latency_ns;
+    uint64_t num_input_latencies;
+  };
+
+  // A present is early if it could have been shown at least this many
+  // nanoseconds sooner, with at least this much margin.
+  static const uint64_t kEarlyThresholdNs = 8000000;
+  // The number of the most recent presents whose times from
+  // GetPresentTime() are kept until the display reports them back.
+  static const uint32_t kMaxPendingPresents = 64;
+
+  // |refresh_divisor| is the number of refresh cycles every frame should be
+  // shown for, e.g. 2 for 30 frames per second on a 60Hz display, or 0 to
+  // only measure the presents.
+  FramePacer(VulkanApplication* application, uint32_t refresh_divisor)
+      : application_(application),
+        past_(application->GetAllocator()),
+        measure_only_(refresh_divisor == 0),
+        refresh_divisor_(refresh_divisor > 0 ? refresh_divisor : 1),
+        refresh_multiplier_(refresh_divisor_),
+        refresh_duration_(0),
+        early_frame_count_(0),
+        last_late_present_id_(0),
+        next_present_id_(1),
+        statistics_{},
+        present_times_{},
+        input_times_{} {}
+
+  // Reads back the timing of the presents that were shown since the last
+  // call, and adjusts the refresh multiplier. Call once per frame, before
+  // GetPresentTime().
+  void BeginFrame() {
+    VkRefreshCycleDurationGOOGLE refresh_cycle = {};
+    if (application_->instance()->vkGetRefreshCycleDurationGOOGLE(
+            application_->device(), application_->swapchain(),
+            &refresh_cycle) != VK_SUCCESS ||
+        refresh_cycle.refreshDuration == 0) {
+      return;
+    }
+    refresh_duration_ = refresh_cycle.refreshDuration;
+
+    uint32_t count = 0;
+    application_->instance()->vkGetPastPresentationTimingGOOGLE(
+        application_->device(), application_->swapchain(), &count, nullptr);
+    if (count == 0) {
+      return;
+    }
+    if (past_.size() < count) {
+      past_.resize(count);
+    }
+    application_->instance()->vkGetPastPresentationTimingGOOGLE(
+        application_->device(), application_->swapchain(), &count,
+        past_.data());
+
+    bool increase_refresh_multiplier = false;
+    for (uint32_t i = 0; i < count; ++i) {
+      const VkPastPresentationTimingGOOGLE& past = past_[i];
+      const bool pending =
+          next_present_id_ - past.presentID <= kMaxPendingPresents;
+      const uint64_t present_time =
+          present_times_[past.presentID % kMaxPendingPresents];
+      if (pending && past.actualPresentTime >= present_time) {
+        statistics_.total_latency_ns += past.actualPresentTime - present_time;
+        ++statistics_.num_latencies;
+      }
+      const uint64_t input_time =
+          input_times_[past.presentID % kMaxPendingPresents];
+      if (pending && input_time != 0 && past.actualPresentTime >= input_time) {
+        statistics_.total_input_latency_ns +=
+            past.actualPresentTime - input_time;
+        ++statistics_.num_input_latencies;
+      }
+      if (measure_only_) {
+        // Nothing asked for a present time, so none of them is late.
+        continue;
+      }
+      if (past.actualPresentTime >
+          past.desiredPresentTime + refresh_duration_) {
+        ++statistics_.num_late;
+        early_frame_count_ = 0;
+        // Everything that was presented before the first late present was
+        // noticed was scheduled with the old multiplier, so a group of late
+        // presents only increases it once.
+        if (last_late_present_id_ < past.presentID) {
+          increase_refresh_multiplier = true;
+          last_late_present_id_ = next_present_id_ - 1;
+        }
+      } else if (past.earliestPresentTime >= past.actualPresentTime) {
+        // It was shown as soon as it could have been.
+        ++statistics_.num_on_time;
+      } else if (past.actualPresentTime - past.earliestPresentTime >=
+                     kEarlyThresholdNs &&
+                 past.presentMargin >= kEarlyThresholdNs) {
+        ++statistics_.num_early;
+        increase_refresh_multiplier = false;
+        const uint64_t early_frame_count_limit =
+            3000000000ull / (refresh_duration_ * refresh_multiplier_);
+        if (++early_frame_count_ >= early_frame_count_limit) {
+          early_frame_count_ = 0;
+          if (refresh_multiplier_ > refresh_divisor_) {
+            --refresh_multiplier_;
+          }
+        }
+      } else {
+        ++statistics_.num_on_time;
+        increase_refresh_multiplier = false;
+        early_frame_count_ = 0;
+      }
+    }
+    if (increase_refresh_multiplier) {
+      ++refresh_multiplier_;
+    }
+  }
+
+  // Fills in the present time of a frame that is about to be presented,
+  // and gives it the next present ID. The times of VK_GOOGLE_display_timing
+  // are in CLOCK_MONOTONIC, which steady_clock is based on.
+  // |input_time_ns| is the steady_clock time of the input that the frame
+  // was rendered for, or 0 if it is not known.
+  void GetPresentTime(VkPresentTimeGOOGLE* present_time,
+                      uint64_t input_time_ns = 0) {
+    const uint64_t now_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+    present_times_[next_present_id_ % kMaxPendingPresents] = now_ns;
+    input_times_[next_present_id_ % kMaxPendingPresents] = input_time_ns;
+    present_time->presentID = next_present_id_++;
+    present_time->desiredPresentTime =
+        refresh_duration_ == 0 || measure_only_
+            ? 0
+            : now_ns + refresh_duration_ * refresh_multiplier_;
+  }
+
+  uint32_t refresh_multiplier() const { return refresh_multiplier_; }
+  // The duration of a refresh cycle in nanoseconds, or 0 if unknown.
+  uint64_t refresh_duration() const { return refresh_duration_; }
+  const Statistics& statistics() const { return statistics_; }
+
+  // Logs the statistics as a single line of space separated key=value
+  // pairs after |prefix|, for scripts to pick up.
+  void LogStatistics(const char* prefix, logging::Logger* log) const {
+    log->LogInfo(prefix, " late=", statistics_.num_late,
+                 " early=", statistics_.num_early,
+                 " on_time=", statistics_.num_on_time, " latency_ms=",
+                 statistics_.num_latencies > 0
+                     ? statistics_.total_latency_ns * 1e-6 /
+                           statistics_.num_latencies
+                     : 0.0,
+                 " input_latency_ms=",
+                 statistics_.num_input_latencies > 0
+                     ? statistics_.total_input_latency_ns * 1e-6 /
+                           statistics_.num_input_latencies
+                     : 0.0,
+                 " refresh_ns=", refresh_duration_,
+                 " refresh_divisor=", refresh_divisor_,
+                 " refresh_multiplier=", refresh_multiplier_);
+  }
+
+ private:
+  VulkanApplication* application_;
+  // Scratch space for the past presentation timings, it only ever grows.
+  containers::vector<VkPastPresentationTimingGOOGLE> past_;
+  bool measure_only_;
+  uint32_t refresh_divisor_;
+  uint32_t refresh_multiplier_;
+  // The duration of a refresh cycle in nanoseconds, or 0 if unknown.
+  uint64_t refresh_duration_;
+  uint64_t early_frame_count_;
+  uint32_t last_late_present_id_;
+  uint32_t next_present_id_;
+  Statistics statistics_;
+  // When the present with every ID was queued, by the ID modulo
+  // kMaxPendingPresents.
+  uint64_t present_times_[kMaxPendingPresents];
+  // The input times that were given for the present with every ID, by the
+  // ID modulo kMaxPendingPresents.
+  uint64_t input_times_[kMaxPendingPresents];
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_FRAME_PACER_H
@@ -0,0 +1,169 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_FRAME_TIME_RECORDER_H
+#define VULKAN_HELPERS_FRAME_TIME_RECORDER_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace vulkan {
+
+// FrameTimeRecorder keeps the times of the most recent frames in a fixed
+// ring that is allocated once, so recording a frame never allocates.
+// The statistics are only computed when asked for, typically once at exit.
+class FrameTimeRecorder {
+ public:
+  struct Statistics {
+    // The number of frames the statistics cover, at most the capacity.
+    size_t num_frames;
+    // The total number of frames that were ever recorded.
+    uint64_t num_recorded;
+    // All times are in seconds.
+    float min;
+    float mean;
+    float max;
+    float p50;
+    float p90;
+    float p99;
+    float p999;
+    // The number of frames that took longer than the budget.
+    size_t num_over_budget;
+  };
+
+  // |capacity| is the number of frames that are kept, once it is reached
+  // every new frame replaces the oldest one.
+  FrameTimeRecorder(containers::Allocator* allocator, size_t capacity)
+      : times_(capacity, 0.0f, allocator),
+        allocator_(allocator),
+        next_(0),
+        num_recorded_(0) {}
+
+  void Record(float seconds) {
+    if (times_.empty()) {
+      return;
+    }
+    times_[next_] = seconds;
+    next_ = (next_ + 1) % times_.size();
+    ++num_recorded_;
+  }
+
+  uint64_t num_recorded() const { return num_recorded_; }
+
+  // Computes the statistics of the frames that are in the ring. A frame is
+  // over budget if it took longer than |budget| seconds.
+  Statistics ComputeStatistics(float budget) const {
+    Statistics stats = {};
+    stats.num_recorded = num_recorded_;
+    stats.num_frames = static_cast<size_t>(
+        std::min<uint64_t>(num_recorded_, times_.size()));
+    if (stats.num_frames == 0) {
+      return stats;
+    }
+    containers::vector<float> sorted(times_.begin(),
+                                     times_.begin() + stats.num_frames,
+                                     allocator_);
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (float time : sorted) {
+      total += time;
+      if (time > budget) {
+        ++stats.num_over_budget;
+      }
+    }
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    stats.mean = static_cast<float>(total / sorted.size());
+    stats.p50 = Percentile(sorted, 0.5);
+    stats.p90 = Percentile(sorted, 0.9);
+    stats.p99 = Percentile(sorted, 0.99);
+    stats.p999 = Percentile(sorted, 0.999);
+    return stats;
+  }
+
+  // Writes the statistics to |location|, as JSON if it ends in ".json" and
+  // as a CSV header and row otherwise. All times are in milliseconds.
+  void WriteStatistics(const char* location, float budget,
+                       logging::Logger* log) const {
+    const Statistics s = ComputeStatistics(budget);
+    const size_t length = strlen(location);
+    const bool json =
+        length >= 5 && strcmp(location + length - 5, ".json") == 0;
+    std::ofstream out_file(location);
+    if (json) {
+      out_file << "{\n  \"num_frames\": " << s.num_frames
+               << ",\n  \"num_recorded\": " << s.num_recorded
+               << ",\n  \"budget_ms\": " << budget * 1000.0f
+               << ",\n  \"min_ms\": " << s.min * 1000.0f
+               << ",\n  \"mean_ms\": " << s.mean * 1000.0f
+               << ",\n  \"p50_ms\": " << s.p50 * 1000.0f
+               << ",\n  \"p90_ms\": " << s.p90 * 1000.0f
+               << ",\n  \"p99_ms\": " << s.p99 * 1000.0f
+               << ",\n  \"p99.9_ms\": " << s.p999 * 1000.0f
+               << ",\n  \"max_ms\": " << s.max * 1000.0f
+               << ",\n  \"num_over_budget\": " << s.num_over_budget
+               << "\n}\n";
+    } else {
+      out_file << "num_frames,num_recorded,budget_ms,min_ms,mean_ms,p50_ms,"
+                  "p90_ms,p99_ms,p99.9_ms,max_ms,num_over_budget\n"
+               << s.num_frames << "," << s.num_recorded << ","
+               << budget * 1000.0f << "," << s.min * 1000.0f << ","
+               << s.mean * 1000.0f << "," << s.p50 * 1000.0f << ","
+               << s.p90 * 1000.0f << "," << s.p99 * 1000.0f << ","
+               << s.p999 * 1000.0f << "," << s.max * 1000.0f << ","
+               << s.num_over_budget << "\n";
+    }
+    LOG_ASSERT(==, log, false, out_file.bad());
+    log->LogInfo("Wrote frame time stats to \"", location, "\"");
+  }
+
+  // Logs the statistics as a single line of space separated key=value
+  // pairs after |prefix|, for scripts to pick up. Times are in milliseconds.
+  void LogStatistics(const char* prefix, float budget,
+                     logging::Logger* log) const {
+    const Statistics s = ComputeStatistics(budget);
+    log->LogInfo(prefix, " frames=", s.num_frames,
+                 " mean_ms=", s.mean * 1000.0f, " min_ms=", s.min * 1000.0f,
+                 " p50_ms=", s.p50 * 1000.0f, " p90_ms=", s.p90 * 1000.0f,
+                 " p99_ms=", s.p99 * 1000.0f, " p99.9_ms=", s.p999 * 1000.0f,
+                 " max_ms=", s.max * 1000.0f,
+                 " over_budget=", s.num_over_budget);
+  }
+
+ private:
+  // Returns the nearest-rank percentile |p| of the non-empty |sorted|.
+  static float Percentile(const containers::vector<float>& sorted, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    if (rank > 0) {
+      --rank;
+    }
+    return sorted[std::min(rank, sorted.size() - 1)];
+  }
+
+  containers::vector<float> times_;
+  containers::Allocator* allocator_;
+  // The index in times_ that the next frame is written to.
+  size_t next_;
+  uint64_t num_recorded_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_FRAME_TIME_RECORDER_H
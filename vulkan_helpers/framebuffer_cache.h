@@ -0,0 +1,304 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_FRAMEBUFFER_CACHE_H
+#define VULKAN_HELPERS_FRAMEBUFFER_CACHE_H
+
+#include "support/containers/flat_hash_map.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace vulkan {
+
+// FramebufferCache shares one ::VkFramebuffer between everything that
+// renders with the same render pass to attachments of the same kind.
+// With imageless framebuffers (VK_KHR_imageless_framebuffer), framebuffers
+// are keyed by the format, usage and extent of their attachments, so a
+// single one serves every swapchain image, and the views are only given to
+// vkCmdBeginRenderPass, see GetAttachmentBeginInfo(). Without them, the
+// views are part of the key. Framebuffers are destroyed once the last
+// handle to them is released. It may be used from any thread.
+class FramebufferCache {
+ public:
+  // An attachment of a framebuffer. Only |view| is used without imageless
+  // framebuffers, and everything but |view| with them, which has to
+  // describe the image that is rendered to.
+  struct Attachment {
+    ::VkImageView view;
+    // The format of the view.
+    VkFormat format;
+    VkImageUsageFlags usage;
+    VkImageCreateFlags flags;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layer_count;
+    // The VkImageFormatListCreateInfoKHR that the image was created with.
+    // If it had none, the format of the view is its only format.
+    uint32_t num_view_formats;
+    const VkFormat* view_formats;
+  };
+
+ private:
+  struct Entry {
+    Entry(containers::Allocator* allocator, uint64_t hash)
+        : key(allocator),
+          hash(hash),
+          framebuffer(VK_NULL_HANDLE),
+          references(1) {}
+    containers::vector<uint64_t> key;
+    uint64_t hash;
+    ::VkFramebuffer framebuffer;
+    // Guarded by the mutex of the cache.
+    uint32_t references;
+  };
+
+ public:
+  // A reference counted handle to a framebuffer of the cache.
+  class Handle {
+   public:
+    Handle() : cache_(nullptr), entry_(nullptr) {}
+    Handle(const Handle& other) : cache_(other.cache_), entry_(other.entry_) {
+      if (entry_) {
+        cache_->AddReference(entry_);
+      }
+    }
+    Handle(Handle&& other) : cache_(other.cache_), entry_(other.entry_) {
+      other.cache_ = nullptr;
+      other.entry_ = nullptr;
+    }
+    Handle& operator=(Handle other) {
+      std::swap(cache_, other.cache_);
+      std::swap(entry_, other.entry_);
+      return *this;
+    }
+    ~Handle() {
+      if (entry_) {
+        cache_->Release(entry_);
+      }
+    }
+
+    operator ::VkFramebuffer() const {
+      return entry_ ? entry_->framebuffer : VK_NULL_HANDLE;
+    }
+
+   private:
+    friend class FramebufferCache;
+    Handle(FramebufferCache* cache, Entry* entry)
+        : cache_(cache), entry_(entry) {}
+
+    FramebufferCache* cache_;
+    Entry* entry_;
+  };
+
+  FramebufferCache(containers::Allocator* allocator, VkDevice* device,
+                   bool imageless)
+      : allocator_(allocator),
+        device_(device),
+        imageless_(imageless),
+        entries_(allocator),
+        num_created_(0) {}
+
+  ~FramebufferCache() {
+    // Handles should not outlive the cache, but the framebuffers of any
+    // that do are not leaked.
+    for (auto& entry : entries_) {
+      (*device_)->vkDestroyFramebuffer(*device_, entry.second->framebuffer,
+                                       nullptr);
+    }
+  }
+
+  // Returns true if the framebuffers are imageless, the views then have to
+  // be given to vkCmdBeginRenderPass.
+  bool imageless() const { return imageless_; }
+
+  // Returns a handle to a framebuffer of |render_pass|, of the given
+  // extent, for |attachments|, creating it if no handle to it is alive.
+  Handle Get(::VkRenderPass render_pass, const Attachment* attachments,
+             uint32_t num_attachments, uint32_t width, uint32_t height,
+             uint32_t layers = 1) {
+    containers::vector<uint64_t> key(allocator_);
+    key.reserve(4 + num_attachments * (imageless_ ? 6 : 1));
+    key.push_back(reinterpret_cast<uint64_t>(render_pass));
+    key.push_back(width);
+    key.push_back(height);
+    key.push_back(layers);
+    for (uint32_t i = 0; i < num_attachments; ++i) {
+      const Attachment& attachment = attachments[i];
+      if (!imageless_) {
+        key.push_back(reinterpret_cast<uint64_t>(attachment.view));
+        continue;
+      }
+      key.push_back(attachment.format);
+      key.push_back(attachment.usage);
+      key.push_back(attachment.flags);
+      key.push_back((static_cast<uint64_t>(attachment.width) << 32) |
+                    attachment.height);
+      key.push_back(attachment.layer_count);
+      key.push_back(attachment.num_view_formats);
+      for (uint32_t j = 0; j < attachment.num_view_formats; ++j) {
+        key.push_back(attachment.view_formats[j]);
+      }
+    }
+
+    const uint64_t hash = Hash(key);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(hash);
+    if (it != entries_.end()) {
+      Entry* entry = it->second.get();
+      if (entry->key == key) {
+        ++entry->references;
+        return Handle(this, entry);
+      }
+      // A collision, the framebuffer that is already cached is kept.
+      return Handle(this, CreateEntry(render_pass, attachments,
+                                      num_attachments, width, height,
+                                      layers, 0));
+    }
+    Entry* entry = CreateEntry(render_pass, attachments, num_attachments,
+                               width, height, layers, hash);
+    entry->key = std::move(key);
+    entries_[hash] = containers::unique_ptr<Entry>(
+        entry, containers::UniqueDeleter(allocator_, sizeof(Entry)));
+    return Handle(this, entry);
+  }
+
+  // Fills |info| with |views| and |next|, and returns it, if the
+  // framebuffers are imageless, so that it can be the pNext of the
+  // VkRenderPassBeginInfo. Returns |next| otherwise, the views are then
+  // already in the framebuffer.
+  const void* GetAttachmentBeginInfo(VkRenderPassAttachmentBeginInfoKHR* info,
+                                     const ::VkImageView* views,
+                                     uint32_t num_views,
+                                     const void* next = nullptr) const {
+    if (!imageless_) {
+      return next;
+    }
+    *info = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO_KHR,  // sType
+        next,                                                     // pNext
+        num_views,  // attachmentCount
+        views       // pAttachments
+    };
+    return info;
+  }
+
+  // The number of framebuffers that were created so far.
+  uint64_t num_created() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_created_;
+  }
+
+ private:
+  // 64 bit FNV-1a over the words of the key.
+  static uint64_t Hash(const containers::vector<uint64_t>& key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t word : key) {
+      hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  // Must be called with mutex_ held.
+  Entry* CreateEntry(::VkRenderPass render_pass, const Attachment* attachments,
+                     uint32_t num_attachments, uint32_t width,
+                     uint32_t height, uint32_t layers, uint64_t hash) {
+    Entry* entry = allocator_->construct<Entry>(allocator_, hash);
+    containers::vector<::VkImageView> views(allocator_);
+    containers::vector<VkFramebufferAttachmentImageInfoKHR> image_infos(
+        allocator_);
+    views.reserve(num_attachments);
+    image_infos.reserve(num_attachments);
+    for (uint32_t i = 0; i < num_attachments; ++i) {
+      const Attachment& attachment = attachments[i];
+      views.push_back(attachment.view);
+      image_infos.push_back({
+          VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO_KHR,  // sType
+          nullptr,                                                  // pNext
+          attachment.flags,                                         // flags
+          attachment.usage,                                         // usage
+          attachment.width,                                         // width
+          attachment.height,                                        // height
+          attachment.layer_count,  // layerCount
+          attachment.num_view_formats > 0 ? attachment.num_view_formats
+                                          : 1u,  // viewFormatCount
+          attachment.num_view_formats > 0
+              ? attachment.view_formats
+              : &attachment.format,  // pViewFormats
+      });
+    }
+    VkFramebufferAttachmentsCreateInfoKHR attachments_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO_KHR,  // sType
+        nullptr,                                                    // pNext
+        num_attachments,     // attachmentImageInfoCount
+        image_infos.data(),  // pAttachmentImageInfos
+    };
+    VkFramebufferCreateInfo create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        imageless_ ? &attachments_create_info : nullptr,  // pNext
+        imageless_ ? static_cast<VkFramebufferCreateFlags>(
+                         VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT_KHR)
+                   : 0u,                       // flags
+        render_pass,                           // renderPass
+        num_attachments,                       // attachmentCount
+        imageless_ ? nullptr : views.data(),  // pAttachments
+        width,                                 // width
+        height,                                // height
+        layers                                 // layers
+    };
+    LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+               (*device_)->vkCreateFramebuffer(*device_, &create_info, nullptr,
+                                               &entry->framebuffer));
+    ++num_created_;
+    return entry;
+  }
+
+  void AddReference(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++entry->references;
+  }
+
+  // Entries that are not in entries_ are owned by their handles.
+  void Release(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--entry->references != 0) {
+      return;
+    }
+    (*device_)->vkDestroyFramebuffer(*device_, entry->framebuffer, nullptr);
+    auto it = entries_.find(entry->hash);
+    if (it != entries_.end() && it->second.get() == entry) {
+      entries_.erase(it);
+    } else {
+      allocator_->destroy(entry);
+    }
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  const bool imageless_;
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  containers::flat_hash_map<uint64_t, containers::unique_ptr<Entry>> entries_;
+  uint64_t num_created_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_FRAMEBUFFER_CACHE_H
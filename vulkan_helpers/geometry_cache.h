@@ -0,0 +1,253 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_GEOMETRY_CACHE_H
+#define VULKAN_HELPERS_GEOMETRY_CACHE_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// GeometryCache skins the vertices of a mesh once per frame in a compute
+// dispatch, into a cache buffer that every pass of the frame, e.g. a depth
+// pre-pass, the shadows and the main pass, then binds as its vertex buffer
+// instead of skinning the vertices again in its vertex shader.
+//
+// The shader is shader_library/geometry_cache/skin_vertices.comp, which the
+// application adds to its SHADERS, e.g.
+//   uint32_t skin_shader[] =
+//   #include "geometry_cache/skin_vertices.comp.spv"
+//       ;
+//
+// Every cache has its own buffer, so one is added for every frame that can
+// be in flight:
+//   size_t cache = geometry_cache.AddCache(vertices, joints);
+// and every frame records, outside of a render pass, before its passes:
+//   geometry_cache.Update(&cmd, cache);
+// and then in every pass, with a pipeline that has AddCachedInputStream():
+//   geometry_cache.BindVertexBuffer(&cmd, cache, 0);
+class GeometryCache {
+ public:
+  // These must match geometry_cache/skin_vertices.comp and
+  // geometry_cache/skinning.glsl.
+  static const uint32_t kGroupSize = 64;
+  static const uint32_t kMaxJoints = 32;
+
+  // The vertices that are skinned, with up to 4 joints each. The weights of
+  // a vertex add up to 1.
+  struct SkinnedVertex {
+    float position[4];
+    float normal[4];
+    uint32_t joint_indices[4];
+    float weights[4];
+  };
+
+  // The skinned vertices in the cache. w is 1 for the position, and 0 for
+  // the normal.
+  struct CachedVertex {
+    float position[4];
+    float normal[4];
+  };
+
+  // The mesh has |num_vertices| vertices.
+  template <size_t N>
+  GeometryCache(VulkanApplication* application, uint32_t num_vertices,
+                uint32_t (&shader)[N])
+      : GeometryCache(application, num_vertices, shader, N) {}
+
+  GeometryCache(VulkanApplication* application, uint32_t num_vertices,
+                uint32_t* shader, size_t shader_words)
+      : application_(application),
+        num_vertices_(num_vertices),
+        caches_(application->GetAllocator()) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    for (uint32_t i = 0; i < 3; ++i) {
+      bindings_[i] = {
+          i,  // binding
+          i < 2 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+          nullptr                                     // pImmutableSamplers
+      };
+    }
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(uint32_t)              // size
+    };
+    pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator,
+        application_->CreatePipelineLayout(
+            {{bindings_[0], bindings_[1], bindings_[2]}}, {range}));
+    pipeline_ = containers::make_unique<VulkanComputePipeline>(
+        allocator, application_->CreateComputePipeline(
+                       pipeline_layout_.get(),
+                       VkShaderModuleCreateInfo{
+                           VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                           nullptr, 0, shader_words * sizeof(uint32_t),
+                           shader},
+                       "main"));
+  }
+
+  // Adds a cache of the SkinnedVertex array in |vertices|, skinned with the
+  // kMaxJoints column major 4x4 matrices in the uniform buffer range
+  // |joints|, and returns its index.
+  // The buffer of |vertices| needs VK_BUFFER_USAGE_STORAGE_BUFFER_BIT.
+  size_t AddCache(const VkDescriptorBufferInfo& vertices,
+                  const VkDescriptorBufferInfo& joints) {
+    caches_.push_back(Cache());
+    Cache& cache = caches_.back();
+    cache.buffer = application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+        num_vertices_ * sizeof(CachedVertex),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    cache.set = containers::make_unique<DescriptorSet>(
+        application_->GetAllocator(),
+        application_->AllocateDescriptorSet(
+            {bindings_[0], bindings_[1], bindings_[2]}));
+
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        vertices,
+        {
+            *cache.buffer,  // buffer
+            0,              // offset
+            VK_WHOLE_SIZE,  // range
+        },
+        joints};
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *cache.set,                              // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *cache.set,                              // dstSet
+            2,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos + 2,                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 2,
+                                                   writes, 0, nullptr);
+    return caches_.size() - 1;
+  }
+
+  // Records the skinning of the vertices into the cache |index|, which the
+  // vertex input of the commands after it can read. This must be recorded
+  // outside of a render pass, and after the joints were written.
+  void Update(VkCommandBuffer* cmd, size_t index) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    const Cache& cache = caches_[index];
+
+    // The passes that read the cache before this only need to be done.
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0,
+        nullptr);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1, &cache.set->raw_set(), 0,
+        nullptr);
+    cmdBuffer->vkCmdPushConstants(
+        cmdBuffer, ::VkPipelineLayout(*pipeline_layout_),
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(num_vertices_), &num_vertices_);
+    cmdBuffer->vkCmdDispatch(
+        cmdBuffer, (num_vertices_ + kGroupSize - 1) / kGroupSize, 1, 1);
+
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,      // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *cache.buffer,                            // buffer
+        0,                                        // offset
+        VK_WHOLE_SIZE,                            // size
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0,
+        nullptr);
+  }
+
+  // Binds the cache |index| as the vertex buffer |binding|.
+  void BindVertexBuffer(VkCommandBuffer* cmd, size_t index,
+                        uint32_t binding) const {
+    ::VkBuffer buffer = *caches_[index].buffer;
+    ::VkDeviceSize offset = 0;
+    (*cmd)->vkCmdBindVertexBuffers(*cmd, binding, 1, &buffer, &offset);
+  }
+
+  // Adds the vertex input of the cache to |pipeline|, with the position in
+  // location 0 and the normal in location 1.
+  static void AddCachedInputStream(VulkanGraphicsPipeline* pipeline) {
+    pipeline->AddInputStream(
+        sizeof(CachedVertex), VK_VERTEX_INPUT_RATE_VERTEX,
+        {{0, VK_FORMAT_R32G32B32A32_SFLOAT, 0},
+         {1, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(float) * 4}});
+  }
+
+  // Adds the vertex input of the SkinnedVertex array to |pipeline|, for
+  // vertex shaders that skin the vertices themselves, with the members of
+  // SkinnedVertex in locations 0 to 3.
+  static void AddSkinnedInputStream(VulkanGraphicsPipeline* pipeline) {
+    pipeline->AddInputStream(
+        sizeof(SkinnedVertex), VK_VERTEX_INPUT_RATE_VERTEX,
+        {{0, VK_FORMAT_R32G32B32A32_SFLOAT, 0},
+         {1, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(float) * 4},
+         {2, VK_FORMAT_R32G32B32A32_UINT, sizeof(float) * 8},
+         {3, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(float) * 12}});
+  }
+
+  uint32_t num_vertices() const { return num_vertices_; }
+
+ private:
+  struct Cache {
+    containers::unique_ptr<VulkanApplication::Buffer> buffer;
+    containers::unique_ptr<DescriptorSet> set;
+  };
+
+  VulkanApplication* application_;
+  uint32_t num_vertices_;
+  VkDescriptorSetLayoutBinding bindings_[3];
+  containers::unique_ptr<PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> pipeline_;
+  containers::vector<Cache> caches_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_GEOMETRY_CACHE_H
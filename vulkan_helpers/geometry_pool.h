@@ -0,0 +1,327 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_GEOMETRY_POOL_H
+#define VULKAN_HELPERS_GEOMETRY_POOL_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/host_copy.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace vulkan {
+
+// GeometryPool packs the vertices and indices of many VulkanModels into one
+// shared vertex buffer and one shared index buffer, so that they are bound
+// once per pass and every model is drawn with its own first index and
+// vertex offset. The indices of all of the models are stored as 32 bit.
+//
+// DrawAll() draws every model with a single vkCmdDrawIndexedIndirect. The
+// VkDrawIndexedIndirectCommands of DrawCommand() can also be written to a
+// buffer of the application, such as the instance draws of GpuCulling, so
+// that one vkCmdDrawIndexedIndirectCountKHR covers every model. Drawing more
+// than one model with an indirect draw needs the multiDrawIndirect feature.
+//
+// All of the models must have the same layout flags. With
+// kModelLayoutQuantizedPositions, every model keeps its own position_scale()
+// and position_bias().
+class GeometryPool {
+ public:
+  // Where a model is in the shared buffers.
+  struct Mesh {
+    uint32_t first_index;
+    uint32_t num_indices;
+    int32_t vertex_offset;
+    uint32_t num_vertices;
+  };
+
+  explicit GeometryPool(VulkanApplication* application)
+      : application_(application),
+        models_(application->GetAllocator()),
+        meshes_(application->GetAllocator()),
+        num_vertices_(0),
+        num_indices_(0),
+        staging_buffers_(application->GetAllocator()) {}
+
+  // Adds |model| to the pool, and returns the index of its mesh. The data of
+  // the model is only read by InitializeData(), so it has to stay valid
+  // until then. The model does not get buffers of its own, and must not be
+  // initialized or drawn itself.
+  uint32_t AddModel(VulkanModel* model) {
+    logging::Logger* log = application_->GetLogger();
+    if (model->layout_flags_ & kModelLayoutInterleaved) {
+      model->PackVertices(application_);
+    }
+    if (!models_.empty()) {
+      LOG_ASSERT(==, log, models_.front()->layout_flags_,
+                 model->layout_flags_);
+      LOG_ASSERT(==, log, models_.front()->vertex_stride_,
+                 model->vertex_stride_);
+    }
+    models_.push_back(model);
+    meshes_.push_back({
+        static_cast<uint32_t>(num_indices_),          // first_index
+        static_cast<uint32_t>(model->num_indices_),   // num_indices
+        static_cast<int32_t>(num_vertices_),          // vertex_offset
+        static_cast<uint32_t>(model->num_vertices_),  // num_vertices
+    });
+    num_vertices_ += model->num_vertices_;
+    num_indices_ += model->num_indices_;
+    return static_cast<uint32_t>(meshes_.size() - 1);
+  }
+
+  // Creates the shared buffers, and the buffer of DrawAll(), and records
+  // the copies of the data of every model into |cmd|. The data is copied
+  // through host-visible staging buffers, which are kept until
+  // InitializationComplete() is called.
+  void InitializeData(VkCommandBuffer* cmd) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    LOG_ASSERT(!=, application_->GetLogger(), 0u, meshes_.size());
+    staging_buffers_.clear();
+    const bool interleaved =
+        (models_.front()->layout_flags_ & kModelLayoutInterleaved) != 0;
+
+    // Planar models are stored as all of the positions, then all of the
+    // texture coordinates, then all of the normals, so that a vertex offset
+    // applies to every binding.
+    size_t vertex_data_size = 0;
+    for (const VulkanModel* model : models_) {
+      vertex_data_size += model->vertex_data_size_;
+    }
+    containers::vector<uint8_t> vertices(vertex_data_size, 0, allocator);
+    containers::vector<uint32_t> indices(num_indices_, 0, allocator);
+    size_t vertex_offset = 0;
+    for (size_t i = 0; i < models_.size(); ++i) {
+      const VulkanModel* model = models_[i];
+      const Mesh& mesh = meshes_[i];
+      if (interleaved) {
+        memcpy(vertices.data() + vertex_offset, model->upload_vertices_,
+               model->vertex_data_size_);
+        vertex_offset += model->vertex_data_size_;
+      } else {
+        const size_t first = static_cast<size_t>(mesh.vertex_offset);
+        memcpy(vertices.data() + first * POSITION_SIZE, model->positions_,
+               mesh.num_vertices * POSITION_SIZE);
+        memcpy(vertices.data() + num_vertices_ * POSITION_SIZE +
+                   first * TEXCOORD_SIZE,
+               model->texture_coords_, mesh.num_vertices * TEXCOORD_SIZE);
+        memcpy(vertices.data() +
+                   num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE) +
+                   first * NORMAL_SIZE,
+               model->normals_, mesh.num_vertices * NORMAL_SIZE);
+      }
+      if (model->index_type_ == VK_INDEX_TYPE_UINT16) {
+        const uint16_t* model_indices =
+            static_cast<const uint16_t*>(model->indices_);
+        for (uint32_t j = 0; j < mesh.num_indices; ++j) {
+          indices[mesh.first_index + j] = model_indices[j];
+        }
+      } else {
+        memcpy(indices.data() + mesh.first_index, model->indices_,
+               mesh.num_indices * INDEX_SIZE);
+      }
+    }
+
+    containers::vector<VkDrawIndexedIndirectCommand> draws(allocator);
+    draws.reserve(meshes_.size());
+    for (uint32_t i = 0; i < meshes_.size(); ++i) {
+      draws.push_back(DrawCommand(i, 1, i));
+    }
+
+    vertex_buffer_ = CreateBuffer(vertex_data_size,
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    index_buffer_ = CreateBuffer(indices.size() * INDEX_SIZE,
+                                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    draw_buffer_ =
+        CreateBuffer(draws.size() * sizeof(VkDrawIndexedIndirectCommand),
+                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    StageData(cmd, vertex_buffer_.get(), vertices.data(), vertex_data_size);
+    StageData(cmd, index_buffer_.get(),
+              reinterpret_cast<const uint8_t*>(indices.data()),
+              indices.size() * INDEX_SIZE);
+    StageData(cmd, draw_buffer_.get(),
+              reinterpret_cast<const uint8_t*>(draws.data()),
+              draws.size() * sizeof(VkDrawIndexedIndirectCommand));
+
+    // The barriers are queued, so that they are merged with the ones of
+    // other uploads.
+    QueueBarrier(cmd, *vertex_buffer_, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    QueueBarrier(cmd, *index_buffer_, VK_ACCESS_INDEX_READ_BIT,
+                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    QueueBarrier(cmd, *draw_buffer_, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+  }
+
+  // When the command buffer given to InitializeData has finished executing,
+  // call this method to release the staging buffers.
+  void InitializationComplete() { staging_buffers_.clear(); }
+
+  // Adds the vertex assembly state of the models, which is the same as the
+  // one of every one of them, see VulkanModel::GetAssemblyInfo.
+  void GetAssemblyInfo(
+      containers::vector<VkVertexInputBindingDescription>* input_bindings,
+      containers::vector<VkVertexInputAttributeDescription>*
+          vertex_attribute_descriptions) {
+    models_.front()->GetAssemblyInfo(input_bindings,
+                                     vertex_attribute_descriptions);
+  }
+
+  // Binds the shared vertex and index buffers. Every model can be drawn
+  // until other vertex or index buffers are bound.
+  void Bind(VkCommandBuffer* cmd) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    ::VkBuffer buffers[3] = {*vertex_buffer_, *vertex_buffer_,
+                             *vertex_buffer_};
+    ::VkDeviceSize offsets[3] = {
+        0, num_vertices_ * POSITION_SIZE,
+        num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE)};
+    const uint32_t binding_count =
+        (models_.front()->layout_flags_ & kModelLayoutInterleaved) ? 1 : 3;
+    cmdBuffer->vkCmdBindVertexBuffers(cmdBuffer, 0, binding_count, buffers,
+                                      offsets);
+    cmdBuffer->vkCmdBindIndexBuffer(cmdBuffer, *index_buffer_, 0,
+                                    VK_INDEX_TYPE_UINT32);
+  }
+
+  size_t num_meshes() const { return meshes_.size(); }
+  const Mesh& mesh(uint32_t index) const { return meshes_[index]; }
+
+  // Returns the command that draws |instance_count| instances of the mesh
+  // |index|, starting at |first_instance|.
+  VkDrawIndexedIndirectCommand DrawCommand(uint32_t index,
+                                           uint32_t instance_count = 1,
+                                           uint32_t first_instance = 0) const {
+    const Mesh& draw_mesh = meshes_[index];
+    return {
+        draw_mesh.num_indices,    // indexCount
+        instance_count,           // instanceCount
+        draw_mesh.first_index,    // firstIndex
+        draw_mesh.vertex_offset,  // vertexOffset
+        first_instance            // firstInstance
+    };
+  }
+
+  // Draws the mesh |index|. Bind() must have been recorded before.
+  void Draw(VkCommandBuffer* cmd, uint32_t index,
+            uint32_t instance_count = 1, uint32_t first_instance = 0) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    const Mesh& draw_mesh = meshes_[index];
+    cmdBuffer->vkCmdDrawIndexed(cmdBuffer, draw_mesh.num_indices,
+                                instance_count, draw_mesh.first_index,
+                                draw_mesh.vertex_offset, first_instance);
+  }
+
+  // Draws every mesh once with a single indirect draw, mesh i with instance
+  // i, so that shaders can find the data of every mesh with
+  // gl_InstanceIndex. Bind() must have been recorded before.
+  void DrawAll(VkCommandBuffer* cmd) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    cmdBuffer->vkCmdDrawIndexedIndirect(
+        cmdBuffer, *draw_buffer_, 0, static_cast<uint32_t>(meshes_.size()),
+        static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+  }
+
+ private:
+  containers::unique_ptr<VulkanApplication::Buffer> CreateBuffer(
+      size_t size, VkBufferUsageFlags usage) {
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,      // sType
+        nullptr,                                   // pNext
+        0,                                         // flags
+        size,                                      // size
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,                 // sharingMode
+        0,                                         // queueFamilyIndexCount
+        nullptr                                    // pQueueFamilyIndices
+    };
+    return application_->CreateAndBindDeviceBuffer(&create_info);
+  }
+
+  // Copies |size| bytes of |data| into new staging buffers, and records the
+  // copies from them into |dst|.
+  void StageData(VkCommandBuffer* cmd, VulkanApplication::Buffer* dst,
+                 const uint8_t* data, size_t size) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    for (size_t offset = 0; offset < size; offset += MAX_MODEL_STAGING_SIZE) {
+      const size_t chunk_size = size - offset < MAX_MODEL_STAGING_SIZE
+                                    ? size - offset
+                                    : MAX_MODEL_STAGING_SIZE;
+      VkBufferCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // flags
+          chunk_size,                            // size
+          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // usage
+          VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+          0,                                     // queueFamilyIndexCount
+          nullptr                                // pQueueFamilyIndices
+      };
+      staging_buffers_.push_back(
+          application_->CreateAndBindHostBuffer(&create_info));
+      VulkanApplication::Buffer* staging = staging_buffers_.back().get();
+      CopyToMappedMemory(application_->job_system(), staging->base_address(),
+                         data + offset, chunk_size);
+      staging->flush();
+
+      VkBufferCopy region = {
+          staging->offset(),       // srcOffset
+          dst->offset() + offset,  // dstOffset
+          chunk_size,              // size
+      };
+      cmdBuffer->vkCmdCopyBuffer(cmdBuffer, *staging, *dst, 1, &region);
+    }
+  }
+
+  // Queues the barrier that makes the copies to |buffer| visible to
+  // |dst_access| in |dst_stage|.
+  void QueueBarrier(VkCommandBuffer* cmd, ::VkBuffer buffer,
+                    VkAccessFlags dst_access, VkPipelineStageFlags dst_stage) {
+    const VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        dst_access,                               // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        buffer,                                   // buffer
+        0,                                        // offset
+        VK_WHOLE_SIZE,                            // size
+    };
+    cmd->QueueBufferBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage,
+                            barrier);
+  }
+
+  VulkanApplication* application_;
+  containers::vector<VulkanModel*> models_;
+  containers::vector<Mesh> meshes_;
+  size_t num_vertices_;
+  size_t num_indices_;
+  containers::unique_ptr<VulkanApplication::Buffer> vertex_buffer_;
+  containers::unique_ptr<VulkanApplication::Buffer> index_buffer_;
+  // One command for every mesh, for DrawAll().
+  containers::unique_ptr<VulkanApplication::Buffer> draw_buffer_;
+  containers::vector<containers::unique_ptr<VulkanApplication::Buffer>>
+      staging_buffers_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_GEOMETRY_POOL_H
@@ -0,0 +1,768 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_GPU_CULLING_H
+#define VULKAN_HELPERS_GPU_CULLING_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/conditional_predicates.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace vulkan {
+
+// GpuCulling decides on the GPU which instances are drawn. Every frame,
+// Cull() tests the bounding sphere of every instance against the view
+// frustum, and optionally against a hierarchical depth pyramid that
+// BuildDepthPyramid() made from the depth of the previous frame, and writes
+// the VkDrawIndexedIndirectCommand of every instance that passes to a
+// compacted list, together with their count. Draw() then draws that list
+// with vkCmdDrawIndexedIndirectCountKHR, so the device must have been
+// created with VK_KHR_draw_indirect_count and the multiDrawIndirect
+// feature.
+//
+// The shaders are shader_library/culling/cull_instances.comp and
+// culling/depth_pyramid.comp, which the application compiles by adding
+// shader_library to its SHADERS, e.g.
+//   uint32_t cull_shader[] =
+//   #include "culling/cull_instances.comp.spv"
+//       ;
+//
+// Every frame records, outside of a render pass:
+//   culling.Cull(&cmd, view_projection, num_instances, true);
+//   // The render pass, with culling.Draw(&cmd) in it.
+//   culling.BuildDepthPyramid(&cmd, depth_index, view_projection);
+//
+// The instances that were hidden in the previous frame are tested against
+// where that frame's depth was, so an instance that comes into view behind
+// a moving occluder shows up one frame late.
+//
+// With SetPredicates(), Cull() also writes whether every instance is drawn
+// to a ConditionalPredicates, so that other work for the instance, e.g. its
+// shadow or effect passes, is skipped on the GPU too.
+//
+// The buffers and the pyramid are shared by all frames in flight. The
+// barriers that are recorded order the frames on the GPU, so every frame
+// has to be submitted to the same queue.
+class GpuCulling {
+ public:
+  // This must match local_size_x of culling/cull_instances.comp.
+  static const uint32_t kCullGroupSize = 64;
+  // This must match local_size_x and local_size_y of
+  // culling/depth_pyramid.comp.
+  static const uint32_t kPyramidGroupSize = 8;
+
+  // Up to |max_instances| are culled at once. The depth images that the
+  // pyramid is built from are |depth_width| by |depth_height|.
+  template <size_t C, size_t P>
+  GpuCulling(VulkanApplication* application, uint32_t max_instances,
+             uint32_t depth_width, uint32_t depth_height,
+             uint32_t (&cull_shader)[C], uint32_t (&pyramid_shader)[P])
+      : GpuCulling(application, max_instances, depth_width, depth_height,
+                   cull_shader, C, pyramid_shader, P) {}
+
+  GpuCulling(VulkanApplication* application, uint32_t max_instances,
+             uint32_t depth_width, uint32_t depth_height,
+             uint32_t* cull_shader, size_t cull_shader_words,
+             uint32_t* pyramid_shader, size_t pyramid_shader_words)
+      : application_(application),
+        max_instances_(max_instances),
+        depth_width_(depth_width),
+        depth_height_(depth_height),
+        num_levels_(1),
+        pyramid_initialized_(false),
+        pyramid_valid_(false),
+        predicates_(nullptr),
+        level_views_(application->GetAllocator()),
+        level_sets_(application->GetAllocator()),
+        depth_sources_(application->GetAllocator()) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    memset(pyramid_view_projection_, 0, sizeof(pyramid_view_projection_));
+    VkPhysicalDeviceProperties properties;
+    application_->instance()->vkGetPhysicalDeviceProperties(
+        application_->device().physical_device(), &properties);
+    max_draws_ =
+        std::min(max_instances_, properties.limits.maxDrawIndirectCount);
+
+    // The first level is half the size of the depth image, rounded up, and
+    // every other level half the size of the one before, down to 1x1.
+    uint32_t width = (depth_width_ + 1) / 2;
+    uint32_t height = (depth_height_ + 1) / 2;
+    pyramid_width_ = width;
+    pyramid_height_ = height;
+    while (width > 1 || height > 1) {
+      width = (width + 1) / 2;
+      height = (height + 1) / 2;
+      ++num_levels_;
+    }
+
+    uniform_buffer_ = application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+        sizeof(CullData),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    draw_buffer_ = application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+        max_instances_ * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    count_buffer_ = application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+        sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    // Bound instead of the predicates until SetPredicates(), and never
+    // written.
+    no_predicates_buffer_ =
+        application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+            sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        VK_FORMAT_R32_SFLOAT,                 // format
+        {
+            pyramid_width_,   // width
+            pyramid_height_,  // height
+            1,                // depth
+        },                    // extent
+        num_levels_,          // mipLevels
+        1,                    // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,    // samples
+        VK_IMAGE_TILING_OPTIMAL,  // tiling
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
+        0,                          // queueFamilyIndexCount
+        nullptr,                    // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,  // initialLayout
+    };
+    pyramid_ = application_->CreateAndBindImage(&image_create_info);
+    pyramid_view_ = application_->CreateImageView(
+        pyramid_.get(), VK_IMAGE_VIEW_TYPE_2D,
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, num_levels_, 0, 1});
+    for (uint32_t i = 0; i < num_levels_; ++i) {
+      level_views_.push_back(application_->CreateImageView(
+          pyramid_.get(), VK_IMAGE_VIEW_TYPE_2D,
+          {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1}));
+    }
+    // Only texelFetch reads through the sampler.
+    sampler_ = containers::make_unique<VkSampler>(
+        allocator, CreateSampler(&application_->device(), VK_FILTER_NEAREST,
+                                 VK_FILTER_NEAREST));
+
+    // The cull shader reads its uniforms, the instances and the pyramid,
+    // and writes the draws, their count and the predicates.
+    for (uint32_t i = 0; i < 7; ++i) {
+      cull_bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    cull_bindings_[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cull_bindings_[5].descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    cull_pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator,
+        application_->CreatePipelineLayout(
+            {{cull_bindings_[0], cull_bindings_[1], cull_bindings_[2],
+              cull_bindings_[3], cull_bindings_[4], cull_bindings_[5],
+              cull_bindings_[6]}}));
+    cull_pipeline_ = containers::make_unique<VulkanComputePipeline>(
+        allocator, application_->CreateComputePipeline(
+                       cull_pipeline_layout_.get(),
+                       VkShaderModuleCreateInfo{
+                           VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                           nullptr, 0, cull_shader_words * sizeof(uint32_t),
+                           cull_shader},
+                       "main"));
+    cull_set_ = containers::make_unique<DescriptorSet>(
+        allocator, application_->AllocateDescriptorSet(
+                       {cull_bindings_[0], cull_bindings_[1], cull_bindings_[2],
+                        cull_bindings_[3], cull_bindings_[4],
+                        cull_bindings_[5], cull_bindings_[6]}));
+
+    pyramid_bindings_[0] = {
+        0,                                          // binding
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+        1,                                          // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+        nullptr                                     // pImmutableSamplers
+    };
+    pyramid_bindings_[1] = {
+        1,                                 // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  // descriptorType
+        1,                                 // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,       // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    VkPushConstantRange level_range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(LevelData)             // size
+    };
+    pyramid_pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator,
+        application_->CreatePipelineLayout(
+            {{pyramid_bindings_[0], pyramid_bindings_[1]}}, {level_range}));
+    pyramid_pipeline_ = containers::make_unique<VulkanComputePipeline>(
+        allocator, application_->CreateComputePipeline(
+                       pyramid_pipeline_layout_.get(),
+                       VkShaderModuleCreateInfo{
+                           VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                           nullptr, 0, pyramid_shader_words * sizeof(uint32_t),
+                           pyramid_shader},
+                       "main"));
+
+    // Every level but the first one reduces the level before it.
+    for (uint32_t i = 1; i < num_levels_; ++i) {
+      level_sets_.push_back(CreatePyramidSet(
+          *level_views_[i - 1], VK_IMAGE_LAYOUT_GENERAL, *level_views_[i]));
+    }
+
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        {
+            *uniform_buffer_,  // buffer
+            0,                 // offset
+            VK_WHOLE_SIZE,     // range
+        },
+        {
+            *draw_buffer_,  // buffer
+            0,              // offset
+            VK_WHOLE_SIZE,  // range
+        },
+        {
+            *count_buffer_,  // buffer
+            0,               // offset
+            VK_WHOLE_SIZE,   // range
+        }};
+    VkDescriptorImageInfo pyramid_info = {
+        *sampler_,                // sampler
+        *pyramid_view_,           // imageView
+        VK_IMAGE_LAYOUT_GENERAL,  // imageLayout
+    };
+    VkWriteDescriptorSet writes[3] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *cull_set_,                              // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *cull_set_,                              // dstSet
+            3,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            buffer_infos + 1,                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+            nullptr,                                    // pNext
+            *cull_set_,                                 // dstSet
+            5,                                          // dstbinding
+            0,                                          // dstArrayElement
+            1,                                          // descriptorCount
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+            &pyramid_info,                              // pImageInfo
+            nullptr,                                    // pBufferInfo
+            nullptr,                                    // pTexelBufferView
+        }};
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 3,
+                                                   writes, 0, nullptr);
+    SetPredicates(nullptr);
+  }
+
+  // Sets the buffers with the bounding sphere of every instance, as a vec4
+  // of the world space center and the radius, and with the
+  // VkDrawIndexedIndirectCommand that draws every instance. They must be
+  // readable by compute shaders when Cull() runs. This must not be called
+  // while the GPU may still cull with the previous buffers.
+  void SetInstances(const VkDescriptorBufferInfo& bounds,
+                    const VkDescriptorBufferInfo& draws) {
+    VkDescriptorBufferInfo buffer_infos[2] = {bounds, draws};
+    VkWriteDescriptorSet write{
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *cull_set_,                              // dstSet
+        1,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 1,
+                                                   &write, 0, nullptr);
+  }
+
+  // Sets the predicates that Cull() writes from now on, 1 for every one of
+  // its instances that is drawn and 0 for every other one, or stops writing
+  // them if |predicates| is nullptr. Only the first |num_instances|
+  // predicates are written. Cull() makes them visible to
+  // ConditionalPredicates::Begin(), and the previous frame's conditional
+  // rendering must have been recorded after the previous Cull(), so that it
+  // is done before they are written again. There must be a predicate for
+  // every instance. This must not be called while the GPU may still cull
+  // with the previous predicates.
+  void SetPredicates(ConditionalPredicates* predicates) {
+    if (predicates) {
+      LOG_ASSERT(>=, application_->GetLogger(), predicates->num_predicates(),
+                 max_instances_);
+    }
+    predicates_ = predicates;
+    VkDescriptorBufferInfo buffer_info =
+        predicates ? predicates->descriptor_info()
+                   : VkDescriptorBufferInfo{
+                         *no_predicates_buffer_,  // buffer
+                         0,                       // offset
+                         VK_WHOLE_SIZE,           // range
+                     };
+    VkWriteDescriptorSet write{
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *cull_set_,                              // dstSet
+        6,                                       // dstbinding
+        0,                                       // dstArrayElement
+        1,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        &buffer_info,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 1,
+                                                   &write, 0, nullptr);
+  }
+
+  // Adds a depth image that the pyramid can be built from, e.g. the depth
+  // buffer of one frame, and returns its index for BuildDepthPyramid(). The
+  // image needs VK_IMAGE_USAGE_SAMPLED_BIT, and |view| must only have the
+  // depth aspect.
+  size_t AddDepthSource(::VkImage image, ::VkImageView view) {
+    depth_sources_.push_back(DepthSource());
+    DepthSource& source = depth_sources_.back();
+    source.image = image;
+    source.set = CreatePyramidSet(
+        view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        *level_views_[0]);
+    return depth_sources_.size() - 1;
+  }
+
+  // Records the culling of the first |num_instances| instances against the
+  // frustum of |view_projection|, 16 floats in column major order, like a
+  // mathfu::Matrix<float, 4, 4>. If |occlusion| is true, and a pyramid was
+  // built, the instances that were hidden by its depth are culled too. This
+  // must be recorded outside of a render pass.
+  void Cull(VkCommandBuffer* cmd, const float* view_projection,
+            uint32_t num_instances, bool occlusion) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    LOG_ASSERT(<=, application_->GetLogger(), num_instances, max_instances_);
+
+    CullData data;
+    memcpy(data.view_projection, view_projection,
+           sizeof(data.view_projection));
+    memcpy(data.pyramid_view_projection, pyramid_view_projection_,
+           sizeof(data.pyramid_view_projection));
+    data.depth_size[0] = static_cast<float>(depth_width_);
+    data.depth_size[1] = static_cast<float>(depth_height_);
+    data.num_instances = num_instances;
+    data.occlusion = occlusion && pyramid_valid_ ? 1 : 0;
+    data.write_predicates = predicates_ ? 1 : 0;
+
+    // The culling, the draws and the conditional rendering of the previous
+    // frame are done with the buffers before they are written again.
+    VkPipelineStageFlags previous_stages =
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (predicates_) {
+      previous_stages |= VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT;
+    }
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, previous_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+        nullptr, 0, nullptr, 0, nullptr);
+    if (!pyramid_initialized_) {
+      // The pyramid is bound even while it is not read.
+      InitializePyramidLayout(&cmdBuffer);
+    }
+    cmdBuffer->vkCmdUpdateBuffer(cmdBuffer, *uniform_buffer_, 0, sizeof(data),
+                                 &data);
+    cmdBuffer->vkCmdFillBuffer(cmdBuffer, *count_buffer_, 0, sizeof(uint32_t),
+                               0);
+    VkBufferMemoryBarrier cull_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+            VK_ACCESS_UNIFORM_READ_BIT,               // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *uniform_buffer_,                         // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT,  // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,         // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,         // dstQueueFamilyIndex
+            *count_buffer_,                  // buffer
+            0,                               // offset
+            VK_WHOLE_SIZE,                   // size
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 2, cull_barriers,
+        0, nullptr);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *cull_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*cull_pipeline_layout_), 0, 1, &cull_set_->raw_set(),
+        0, nullptr);
+    cmdBuffer->vkCmdDispatch(
+        cmdBuffer, (num_instances + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+    VkBufferMemoryBarrier draw_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *draw_buffer_,                            // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *count_buffer_,                           // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 2, draw_barriers,
+        0, nullptr);
+    if (predicates_) {
+      predicates_->WaitForShaders(&cmdBuffer,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+  }
+
+  // Records the draws that the last Cull() wrote. The pipeline, and the
+  // vertex and index buffers, must already be bound.
+  void Draw(VkCommandBuffer* cmd) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    cmdBuffer->vkCmdDrawIndexedIndirectCountKHR(
+        cmdBuffer, *draw_buffer_, 0, *count_buffer_, 0, max_draws_,
+        static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+  }
+
+  // Records the reduction of the depth source |depth_index| to the pyramid
+  // that the next Cull() tests against. The depth image must have been
+  // rendered with |view_projection|, and must be in
+  // VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, which it is in again
+  // afterwards. This must be recorded outside of a render pass.
+  void BuildDepthPyramid(VkCommandBuffer* cmd, size_t depth_index,
+                         const float* view_projection) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    const DepthSource& source = depth_sources_[depth_index];
+
+    VkImageMemoryBarrier start_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,            // sType
+            nullptr,                                           // pNext
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,      // srcAccessMask
+            VK_ACCESS_SHADER_READ_BIT,                         // dstAccessMask
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // oldLayout
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,   // newLayout
+            VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+            source.image,             // image
+            {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1},  // subresourceRange
+        },
+        {
+            // The previous contents of the pyramid were only needed by the
+            // culling before this.
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+            nullptr,                                 // pNext
+            0,                                       // srcAccessMask
+            VK_ACCESS_SHADER_WRITE_BIT,              // dstAccessMask
+            VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+            VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+            VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+            *pyramid_,                               // image
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, num_levels_, 0,
+             1},  // subresourceRange
+        }};
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer,
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2,
+        start_barriers);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *pyramid_pipeline_);
+    LevelData level = {
+        {static_cast<int32_t>(depth_width_),
+         static_cast<int32_t>(depth_height_)},  // source_size
+        {static_cast<int32_t>(pyramid_width_),
+         static_cast<int32_t>(pyramid_height_)},  // destination_size
+    };
+    for (uint32_t i = 0; i < num_levels_; ++i) {
+      const DescriptorSet& set = i == 0 ? *source.set : *level_sets_[i - 1];
+      cmdBuffer->vkCmdBindDescriptorSets(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+          ::VkPipelineLayout(*pyramid_pipeline_layout_), 0, 1, &set.raw_set(),
+          0, nullptr);
+      cmdBuffer->vkCmdPushConstants(
+          cmdBuffer, ::VkPipelineLayout(*pyramid_pipeline_layout_),
+          VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(level), &level);
+      cmdBuffer->vkCmdDispatch(
+          cmdBuffer,
+          (level.destination_size[0] + kPyramidGroupSize - 1) /
+              kPyramidGroupSize,
+          (level.destination_size[1] + kPyramidGroupSize - 1) /
+              kPyramidGroupSize,
+          1);
+
+      // The level is read by the next one, and the last ones by Cull().
+      VkImageMemoryBarrier level_barrier = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+          nullptr,                                 // pNext
+          VK_ACCESS_SHADER_WRITE_BIT,              // srcAccessMask
+          VK_ACCESS_SHADER_READ_BIT,               // dstAccessMask
+          VK_IMAGE_LAYOUT_GENERAL,                 // oldLayout
+          VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+          VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+          *pyramid_,                               // image
+          {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1},  // subresourceRange
+      };
+      cmdBuffer->vkCmdPipelineBarrier(
+          cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+          &level_barrier);
+
+      level.source_size[0] = level.destination_size[0];
+      level.source_size[1] = level.destination_size[1];
+      level.destination_size[0] = (level.destination_size[0] + 1) / 2;
+      level.destination_size[1] = (level.destination_size[1] + 1) / 2;
+    }
+
+    VkImageMemoryBarrier end_barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,           // sType
+        nullptr,                                          // pNext
+        0,                                                // srcAccessMask
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,  // dstAccessMask
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,   // oldLayout
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // newLayout
+        VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+        source.image,             // image
+        {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1},  // subresourceRange
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &end_barrier);
+
+    memcpy(pyramid_view_projection_, view_projection,
+           sizeof(pyramid_view_projection_));
+    pyramid_initialized_ = true;
+    pyramid_valid_ = true;
+  }
+
+  // Stops occlusion culling until the next BuildDepthPyramid(), e.g. when
+  // the depth of the previous frame has nothing to do with the next one.
+  void InvalidateDepthPyramid() { pyramid_valid_ = false; }
+
+  // The compacted draws, and their count, that the last Cull() wrote.
+  ::VkBuffer draw_buffer() const { return *draw_buffer_; }
+  ::VkBuffer count_buffer() const { return *count_buffer_; }
+  // The largest number of draws that Draw() draws, the number of instances,
+  // unless the device has a lower maxDrawIndirectCount.
+  uint32_t max_draws() const { return max_draws_; }
+  uint32_t num_pyramid_levels() const { return num_levels_; }
+
+ private:
+  // This must match cull_data in culling/cull_instances.comp.
+  struct CullData {
+    float view_projection[16];
+    float pyramid_view_projection[16];
+    float depth_size[2];
+    uint32_t num_instances;
+    uint32_t occlusion;
+    uint32_t write_predicates;
+  };
+
+  // This must match level_data in culling/depth_pyramid.comp.
+  struct LevelData {
+    int32_t source_size[2];
+    int32_t destination_size[2];
+  };
+
+  struct DepthSource {
+    ::VkImage image;
+    // Reduces the image to the first level of the pyramid.
+    containers::unique_ptr<DescriptorSet> set;
+  };
+
+  // Moves the pyramid to the layout that its descriptors have.
+  void InitializePyramidLayout(VkCommandBuffer* cmd) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        0,                                       // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,               // dstAccessMask
+        VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+        VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        *pyramid_,                               // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, num_levels_, 0,
+         1},  // subresourceRange
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &barrier);
+    pyramid_initialized_ = true;
+  }
+
+  containers::unique_ptr<DescriptorSet> CreatePyramidSet(
+      ::VkImageView source, VkImageLayout source_layout,
+      ::VkImageView destination) {
+    auto set = containers::make_unique<DescriptorSet>(
+        application_->GetAllocator(),
+        application_->AllocateDescriptorSet(
+            {pyramid_bindings_[0], pyramid_bindings_[1]}));
+    VkDescriptorImageInfo image_infos[2] = {
+        {
+            *sampler_,      // sampler
+            source,         // imageView
+            source_layout,  // imageLayout
+        },
+        {
+            VK_NULL_HANDLE,           // sampler
+            destination,              // imageView
+            VK_IMAGE_LAYOUT_GENERAL,  // imageLayout
+        }};
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+            nullptr,                                    // pNext
+            *set,                                       // dstSet
+            0,                                          // dstbinding
+            0,                                          // dstArrayElement
+            1,                                          // descriptorCount
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+            image_infos,                                // pImageInfo
+            nullptr,                                    // pBufferInfo
+            nullptr,                                    // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *set,                                    // dstSet
+            1,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,        // descriptorType
+            image_infos + 1,                         // pImageInfo
+            nullptr,                                 // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 2,
+                                                   writes, 0, nullptr);
+    return set;
+  }
+
+  VulkanApplication* application_;
+  uint32_t max_instances_;
+  uint32_t max_draws_;
+  uint32_t depth_width_;
+  uint32_t depth_height_;
+  // The size of the first level of the pyramid.
+  uint32_t pyramid_width_;
+  uint32_t pyramid_height_;
+  uint32_t num_levels_;
+  // Whether the pyramid left VK_IMAGE_LAYOUT_UNDEFINED.
+  bool pyramid_initialized_;
+  // Whether a pyramid was built since the last InvalidateDepthPyramid(),
+  // and the view projection of the depth that it was built from.
+  bool pyramid_valid_;
+  float pyramid_view_projection_[16];
+  // The predicates that Cull() writes, if any.
+  ConditionalPredicates* predicates_;
+
+  VkDescriptorSetLayoutBinding cull_bindings_[7];
+  VkDescriptorSetLayoutBinding pyramid_bindings_[2];
+  containers::unique_ptr<PipelineLayout> cull_pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> cull_pipeline_;
+  containers::unique_ptr<PipelineLayout> pyramid_pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> pyramid_pipeline_;
+  containers::unique_ptr<DescriptorSet> cull_set_;
+
+  containers::unique_ptr<VulkanApplication::Buffer> uniform_buffer_;
+  containers::unique_ptr<VulkanApplication::Buffer> draw_buffer_;
+  containers::unique_ptr<VulkanApplication::Buffer> count_buffer_;
+  containers::unique_ptr<VulkanApplication::Buffer> no_predicates_buffer_;
+
+  containers::unique_ptr<VulkanApplication::Image> pyramid_;
+  // All of the levels, for Cull(), and every level on its own, for
+  // BuildDepthPyramid().
+  containers::unique_ptr<VkImageView> pyramid_view_;
+  containers::vector<containers::unique_ptr<VkImageView>> level_views_;
+  containers::unique_ptr<VkSampler> sampler_;
+  // The sets that reduce every level after the first one.
+  containers::vector<containers::unique_ptr<DescriptorSet>> level_sets_;
+  containers::vector<DepthSource> depth_sources_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_GPU_CULLING_H
@@ -0,0 +1,392 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_GPU_DECOMPRESSOR_H_
+#define VULKAN_HELPERS_GPU_DECOMPRESSOR_H_
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/asset_file.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/host_copy.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace vulkan {
+
+// GpuDecompressor loads the sections of binary asset files into
+// device-local buffers and images, decoding kAssetChunkedLz4 sections with a
+// compute shader, so the CPU only copies the compressed bytes into staging
+// memory. The files should be opened with |defer_chunked_lz4|, otherwise
+// AssetFile has already decoded them and their decoded data is copied
+// instead, as is the data of every other section.
+//
+// The work is recorded on the async compute queue if the application has
+// one, and on the render queue otherwise. Resources that are created for
+// another queue family than the render queue's are shared concurrently with
+// the render queue family, so no ownership transfer is needed.
+//
+// The shader is decompress/lz4_decompress.comp, which the application adds
+// to its SHADERS, e.g.
+//   uint32_t lz4_decompress_shader[] =
+//   #include "decompress/lz4_decompress.comp.spv"
+//       ;
+//
+// Typical use at load time is
+//   auto vertices = decompressor.DecompressBuffer(
+//       file, kAssetVertexData, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+//   auto texture = decompressor.DecompressTexture(texture_file);
+//   uint64_t upload = decompressor.Submit();
+// after which the resources may be used once
+// application->IsUploadComplete(upload) returns true.
+class GpuDecompressor {
+ public:
+  // This must match decompress/lz4_decompress.comp.
+  static const uint32_t kGroupSize = 64;
+
+  template <size_t N>
+  GpuDecompressor(VulkanApplication* application, uint32_t (&shader)[N])
+      : GpuDecompressor(application, shader, N) {}
+
+  GpuDecompressor(VulkanApplication* application, uint32_t* shader,
+                  size_t shader_words)
+      : application_(application),
+        queue_(application->async_compute_queue()
+                   ? application->async_compute_queue()
+                   : &application->render_queue()),
+        command_buffer_(nullptr),
+        jobs_(application->GetAllocator()),
+        in_flight_(application->GetAllocator()) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    queue_families_[0] = queue_->index();
+    queue_families_[1] = application_->render_queue().index();
+    for (uint32_t i = 0; i < 2; ++i) {
+      bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(DecompressData)        // size
+    };
+    pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator, application_->CreatePipelineLayout(
+                       {{bindings_[0], bindings_[1]}}, {range}));
+    pipeline_ = containers::make_unique<VulkanComputePipeline>(
+        allocator,
+        application_->CreateComputePipeline(
+            pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                shader_words * sizeof(uint32_t), shader},
+            "main"));
+  }
+
+  // Returns a device-local buffer with |usage| that holds the decompressed
+  // section |tag| of |file| once the next Submit() has completed.
+  containers::unique_ptr<VulkanApplication::Buffer> DecompressBuffer(
+      const AssetFile& file, uint32_t tag, VkBufferUsageFlags usage) {
+    const size_t size = file.section_size(tag);
+    VkBufferCreateInfo create_info = BufferCreateInfo(
+        RoundUp(size), usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    auto buffer = application_->CreateAndBindDeviceBuffer(&create_info);
+    RecordDecompress(file, tag, buffer.get());
+    return buffer;
+  }
+
+  // Returns a 2D image with a single level, with |usage| and the format and
+  // extent of the kAssetTextureInfo section of |file|, that holds its
+  // kAssetTextureData, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL once the
+  // next Submit() has completed.
+  containers::unique_ptr<VulkanApplication::Image> DecompressTexture(
+      const AssetFile& file,
+      VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT) {
+    const AssetTextureInfo* info = reinterpret_cast<const AssetTextureInfo*>(
+        file.section(kAssetTextureInfo));
+    const bool concurrent = queue_families_[0] != queue_families_[1];
+    VkImageCreateInfo create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        static_cast<VkFormat>(info->format),  // format
+        {
+            info->width,   // width
+            info->height,  // height
+            1,             // depth
+        },
+        1,                                        // mipLevels
+        1,                                        // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                    // samples
+        VK_IMAGE_TILING_OPTIMAL,                  // tiling
+        usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT,  // usage
+        concurrent ? VK_SHARING_MODE_CONCURRENT
+                   : VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
+        concurrent ? 2u : 0u,                    // queueFamilyIndexCount
+        concurrent ? queue_families_ : nullptr,  // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,               // initialLayout
+    };
+    auto image = application_->CreateAndBindImage(&create_info);
+
+    // The texels are decoded into a buffer first, as images can not be
+    // written to byte by byte.
+    const size_t size = file.section_size(kAssetTextureData);
+    VkBufferCreateInfo scratch_create_info = BufferCreateInfo(
+        RoundUp(size), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    auto scratch = application_->CreateAndBindDeviceBuffer(&scratch_create_info);
+    RecordDecompress(file, kAssetTextureData, scratch.get());
+
+    VkCommandBuffer& cmd = *command_buffer_;
+    VkMemoryBarrier decoded_barrier{
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        VK_ACCESS_SHADER_WRITE_BIT |
+            VK_ACCESS_TRANSFER_WRITE_BIT,  // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT        // dstAccessMask
+    };
+    VkImageMemoryBarrier image_barrier{
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        0,                                       // srcAccessMask
+        VK_ACCESS_TRANSFER_WRITE_BIT,            // dstAccessMask
+        VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,    // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        *image,                                  // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}  // subresourceRange
+    };
+    cmd->vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &decoded_barrier, 0, nullptr, 1,
+        &image_barrier);
+    VkBufferImageCopy region{
+        0,                                       // bufferOffset
+        0,                                       // bufferRowLength
+        0,                                       // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},    // imageSubresource
+        {0, 0, 0},                               // imageOffset
+        {info->width, info->height, 1}           // imageExtent
+    };
+    cmd->vkCmdCopyBufferToImage(cmd, *scratch, *image,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                &region);
+    image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    image_barrier.dstAccessMask = 0;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    cmd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                              nullptr, 0, nullptr, 1, &image_barrier);
+    jobs_.back().scratch = std::move(scratch);
+    return image;
+  }
+
+  // Submits everything that was recorded since the last Submit(), and
+  // returns a value for VulkanApplication::IsUploadComplete, or 0 if there
+  // was nothing to submit. The staging memory is released once the submit
+  // has completed, the next time Submit() or ReleaseCompleted() is called.
+  uint64_t Submit() {
+    ReleaseCompleted();
+    if (!command_buffer_) {
+      return 0;
+    }
+    VkCommandBuffer& cmd = *command_buffer_;
+    if (queue_families_[0] == queue_families_[1]) {
+      // Later commands on the render queue read the resources.
+      VkMemoryBarrier end_barrier{
+          VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+          nullptr,                           // pNext
+          VK_ACCESS_SHADER_WRITE_BIT |
+              VK_ACCESS_TRANSFER_WRITE_BIT,     // srcAccessMask
+          VulkanApplication::kAllReadBits       // dstAccessMask
+      };
+      cmd->vkCmdPipelineBarrier(
+          cmd,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+              VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &end_barrier, 0, nullptr,
+          0, nullptr);
+    }
+    cmd->vkEndCommandBuffer(cmd);
+    const uint64_t upload = application_->SubmitUpload(
+        std::move(*command_buffer_), nullptr, queue_);
+    command_buffer_.reset();
+    for (Job& job : jobs_) {
+      job.upload = upload;
+      in_flight_.push_back(std::move(job));
+    }
+    jobs_.clear();
+    return upload;
+  }
+
+  // Releases the staging memory of every submit that has completed.
+  void ReleaseCompleted() {
+    size_t num_completed = 0;
+    while (num_completed < in_flight_.size() &&
+           application_->IsUploadComplete(in_flight_[num_completed].upload)) {
+      ++num_completed;
+    }
+    in_flight_.erase(in_flight_.begin(), in_flight_.begin() + num_completed);
+  }
+
+ private:
+  // This must match decompress_data in decompress/lz4_decompress.comp.
+  struct DecompressData {
+    uint32_t decompressed_size;
+  };
+
+  // What one section needs until its submit has completed.
+  struct Job {
+    containers::unique_ptr<VulkanApplication::Buffer> staging;
+    // Only for textures.
+    containers::unique_ptr<VulkanApplication::Buffer> scratch;
+    containers::unique_ptr<DescriptorSet> set;
+    uint64_t upload;
+  };
+
+  // The decoding shader reads and writes whole words.
+  static size_t RoundUp(size_t size) {
+    return (size + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+  }
+
+  VkBufferCreateInfo BufferCreateInfo(size_t size, VkBufferUsageFlags usage) {
+    const bool concurrent = queue_families_[0] != queue_families_[1];
+    return {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        size,                                  // size
+        usage,                                 // usage
+        concurrent ? VK_SHARING_MODE_CONCURRENT
+                   : VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
+        concurrent ? 2u : 0u,                    // queueFamilyIndexCount
+        concurrent ? queue_families_ : nullptr,  // pQueueFamilyIndices
+    };
+  }
+
+  // Copies the section |tag| of |file| as it is stored into staging memory,
+  // and records the commands that write it, decompressed, to the start of
+  // |dst|.
+  void RecordDecompress(const AssetFile& file, uint32_t tag,
+                        VulkanApplication::Buffer* dst) {
+    if (!command_buffer_) {
+      command_buffer_ = containers::make_unique<VkCommandBuffer>(
+          application_->GetAllocator(),
+          application_->GetQueueCommandBuffer(*queue_));
+      VkCommandBufferBeginInfo begin_info{
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+      (*command_buffer_)->vkBeginCommandBuffer(*command_buffer_, &begin_info);
+    }
+    VkCommandBuffer& cmd = *command_buffer_;
+    // Sections that AssetFile already decoded are copied as they are.
+    const bool on_gpu = file.defers_chunked_lz4() &&
+                        file.section_compression(tag) == kAssetChunkedLz4;
+    const uint8_t* data =
+        on_gpu ? file.stored_section(tag) : file.section(tag);
+    const size_t size =
+        on_gpu ? file.stored_size(tag) : file.section_size(tag);
+
+    jobs_.push_back(Job{nullptr, nullptr, nullptr, 0});
+    Job& job = jobs_.back();
+    VkBufferCreateInfo create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        RoundUp(size),                         // size
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr,                               // pQueueFamilyIndices
+    };
+    job.staging = application_->CreateAndBindHostBuffer(&create_info);
+    CopyToMappedMemory(application_->job_system(),
+                       job.staging->base_address(), data, size);
+    job.staging->flush();
+
+    if (!on_gpu) {
+      VkBufferCopy region{0, 0, size};
+      cmd->vkCmdCopyBuffer(cmd, *job.staging, *dst, 1, &region);
+      return;
+    }
+
+    job.set = containers::make_unique<DescriptorSet>(
+        application_->GetAllocator(),
+        application_->AllocateDescriptorSet({bindings_[0], bindings_[1]}));
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {*job.staging, 0, VK_WHOLE_SIZE},
+        {*dst, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *job.set,                                // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 1,
+                                                   &write, 0, nullptr);
+
+    uint32_t num_chunks;
+    memcpy(&num_chunks, data, sizeof(num_chunks));
+    DecompressData decompress_data = {
+        static_cast<uint32_t>(file.section_size(tag))  // decompressed_size
+    };
+    cmd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline_);
+    cmd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+                                 &job.set->raw_set(), 0, nullptr);
+    cmd->vkCmdPushConstants(cmd, ::VkPipelineLayout(*pipeline_layout_),
+                            VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                            sizeof(decompress_data), &decompress_data);
+    cmd->vkCmdDispatch(cmd, (num_chunks + kGroupSize - 1) / kGroupSize, 1, 1);
+  }
+
+  VulkanApplication* application_;
+  VkQueue* queue_;
+  // The family of queue_, and the render queue family.
+  uint32_t queue_families_[2];
+  VkDescriptorSetLayoutBinding bindings_[2];
+  containers::unique_ptr<PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> pipeline_;
+  // nullptr until something is recorded after a Submit().
+  containers::unique_ptr<VkCommandBuffer> command_buffer_;
+  // Recorded, but not submitted yet.
+  containers::vector<Job> jobs_;
+  // Submitted, in the order of their uploads.
+  containers::vector<Job> in_flight_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_GPU_DECOMPRESSOR_H_
@@ -0,0 +1,707 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_GPU_PROFILER_H
+#define VULKAN_HELPERS_GPU_PROFILER_H
+
+#include "support/containers/string.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/trace/trace.h"
+#include "vulkan_helpers/debug_labels.h"
+#include "vulkan_helpers/frame_time_recorder.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/performance_counters.h"
+#include "vulkan_helpers/query_allocator.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+namespace vulkan {
+
+// GpuProfiler measures named zones of command buffers with timestamp
+// queries. Every frame has its own query pool, so the results of a frame are
+// read back without stalling the next time that frame is started, and are
+// aggregated per zone name.
+//
+// BeginFrame(i) must only be called once every command buffer that wrote
+// timestamps for the previous use of frame i has finished on the GPU, i.e.
+// after waiting on that frame's fence.
+//
+// With VK_EXT_calibrated_timestamps, the device clock is also calibrated
+// against std::chrono::steady_clock every kCalibrationInterval frames, so
+// GPU timestamps can be converted to CPU time, see ToCpuNanoseconds(). The
+// rate of the device clock is corrected from the drift between
+// calibrations, instead of trusting timestampPeriod.
+//
+// With pipeline statistics, zones also count the shader invocations and
+// clipped primitives of their commands. Only one pipeline statistics query
+// may be active at a time, so of nested zones only the outermost one gets
+// them. A zone with statistics must begin and end in the same subpass, or
+// both outside of a render pass, and if it contains vkCmdExecuteCommands
+// the device needs the inheritedQueries feature.
+//
+// With performance counters (VK_KHR_performance_query), the outermost zones
+// also count the hardware counters that PerformanceCounters chooses, with
+// queries from a QueryAllocator. If the counters need more than one pass,
+// only frames whose command buffers were submitted once per pass get them,
+// see BeginCounterPass().
+//
+// With VK_EXT_debug_utils, every zone is also a command buffer label of the
+// same name, so captures and vendor tools show the same zones.
+class GpuProfiler {
+ public:
+  // The number of measurements of every zone that the statistics cover.
+  static const size_t kMaxRecordedZoneTimes = 4096;
+  // The number of frames between two calibrations.
+  static const uint32_t kCalibrationInterval = 60;
+  // The number of pipeline statistics that every zone counts.
+  static const uint32_t kNumStatistics = 5;
+
+  // If |host_query_reset| is true, the device must have been created with
+  // the hostQueryReset feature, and the pools are reset from the host.
+  // Otherwise the first BeginZone of every frame resets the pool of the
+  // frame, so it must not be inside a render pass.
+  // If |calibrated_timestamps| is true, the device must have been created
+  // with VK_EXT_calibrated_timestamps. Calibration is still only used if
+  // the device can calibrate against CLOCK_MONOTONIC, which steady_clock
+  // is based on.
+  // If |pipeline_statistics| is true, the device must have been created with
+  // the pipelineStatisticsQuery feature.
+  // If |performance_counters| is true, the device must have been created
+  // with VK_KHR_performance_query and the performanceCounterQueryPools
+  // feature, and the counters are those of the render queue family.
+  GpuProfiler(VulkanApplication* application, size_t num_frames,
+              uint32_t max_zones_per_frame, bool host_query_reset,
+              bool calibrated_timestamps = false,
+              bool pipeline_statistics = false,
+              bool performance_counters = false)
+      : application_(application),
+        frames_(application->GetAllocator()),
+        zones_(application->GetAllocator()),
+        results_(2 * max_zones_per_frame, 0, application->GetAllocator()),
+        statistics_results_(
+            pipeline_statistics ? kNumStatistics * max_zones_per_frame : 0, 0,
+            application->GetAllocator()),
+        counter_results_(application->GetAllocator()),
+        max_zones_per_frame_(max_zones_per_frame),
+        host_query_reset_(host_query_reset),
+        pipeline_statistics_(pipeline_statistics),
+        debug_labels_(application->use_debug_utils()),
+        current_frame_(0),
+        calibrated_(false),
+        frames_since_calibration_(0),
+        gpu_reference_(0),
+        cpu_reference_ns_(0),
+        ns_per_tick_(0.0),
+        max_deviation_ns_(0),
+        submit_latency_(application->GetAllocator(), kMaxRecordedZoneTimes) {
+    VkPhysicalDeviceProperties properties;
+    application_->instance()->vkGetPhysicalDeviceProperties(
+        application_->device().physical_device(), &properties);
+    timestamp_period_ = properties.limits.timestampPeriod;
+    uint32_t queue_family_index = application_->render_queue().index();
+    auto queue_family_properties = GetQueueFamilyProperties(
+        application_->GetAllocator(), application_->instance(),
+        application_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[queue_family_index].timestampValidBits;
+    LOG_ASSERT(>, application_->GetLogger(), valid_bits, 0u);
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+    ns_per_tick_ = timestamp_period_;
+
+    if (calibrated_timestamps) {
+      bool has_device = false;
+      bool has_monotonic = false;
+      uint32_t num_domains = 0;
+      application_->instance()->vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(
+          application_->device().physical_device(), &num_domains, nullptr);
+      containers::vector<VkTimeDomainEXT> domains(
+          num_domains, VK_TIME_DOMAIN_DEVICE_EXT,
+          application_->GetAllocator());
+      application_->instance()->vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(
+          application_->device().physical_device(), &num_domains,
+          domains.data());
+      for (VkTimeDomainEXT domain : domains) {
+        has_device |= domain == VK_TIME_DOMAIN_DEVICE_EXT;
+        has_monotonic |= domain == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+      }
+      if (has_device && has_monotonic) {
+        Calibrate();
+      } else {
+        application_->GetLogger()->LogInfo(
+            "The device can not calibrate its timestamps against "
+            "CLOCK_MONOTONIC, GPU times stay in the device domain");
+      }
+    }
+
+    if (performance_counters) {
+      counters_ = containers::make_unique<PerformanceCounters>(
+          application_->GetAllocator(), application_, queue_family_index);
+      if (counters_->num_counters() == 0) {
+        counters_.reset();
+      } else {
+        query_allocator_ = containers::make_unique<QueryAllocator>(
+            application_->GetAllocator(), application_, host_query_reset_);
+        counter_results_.resize(
+            counters_->num_counters() * max_zones_per_frame_);
+      }
+    }
+
+    for (size_t i = 0; i < num_frames; ++i) {
+      frames_.push_back(containers::make_unique<Frame>(
+          application_->GetAllocator(), application_, max_zones_per_frame_,
+          pipeline_statistics_));
+      if (counters_) {
+        // The queries are reset when they are allocated with host query
+        // reset.
+        frames_.back()->counter_queries = query_allocator_->Allocate(
+            VK_QUERY_TYPE_PERFORMANCE_QUERY_KHR, max_zones_per_frame_, 0,
+            counters_->create_info());
+      }
+      if (host_query_reset_) {
+        ResetOnHost(frames_.back().get());
+      }
+    }
+  }
+
+  // Reads back the zones that were written the last time |frame_index| was
+  // started, and makes |frame_index| the frame that new zones belong to.
+  void BeginFrame(size_t frame_index) {
+    LOG_ASSERT(<, application_->GetLogger(), frame_index, frames_.size());
+    current_frame_ = frame_index;
+    if (calibrated_ && ++frames_since_calibration_ >= kCalibrationInterval) {
+      Calibrate();
+    }
+    Frame* frame = frames_[frame_index].get();
+    const uint32_t num_queries = 2 * frame->num_zones;
+    if (num_queries > 0 &&
+        application_->device()->vkGetQueryPoolResults(
+            application_->device(), frame->pool, 0, num_queries,
+            num_queries * sizeof(uint64_t), results_.data(), sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      int64_t first_begin_ns = INT64_MAX;
+      for (uint32_t i = 0; i < frame->num_zones; ++i) {
+        const uint64_t ticks =
+            (results_[2 * i + 1] - results_[2 * i]) & timestamp_mask_;
+        Zone* zone = GetZone(frame->names[i]);
+        zone->last_time =
+            static_cast<float>(ticks * ns_per_tick_ / 1000000000.0);
+        zone->times.Record(zone->last_time);
+        if (calibrated_) {
+          const int64_t begin_ns = ToCpuNanoseconds(results_[2 * i]);
+          first_begin_ns = std::min(first_begin_ns, begin_ns);
+          zone->last_end_ns = ToCpuNanoseconds(results_[2 * i + 1]);
+          // Without calibration GPU zones can not be put on the CPU
+          // timeline of the trace.
+          trace::AddZoneOnTrack(frame->names[i], trace::kGpuTrack, begin_ns,
+                                zone->last_end_ns);
+        }
+      }
+      if (calibrated_ && frame->submit_ns != 0) {
+        submit_latency_.Record(
+            static_cast<float>((first_begin_ns - frame->submit_ns) /
+                               1000000000.0));
+      }
+    }
+    const uint32_t num_statistics = frame->num_statistics;
+    if (num_statistics > 0 &&
+        application_->device()->vkGetQueryPoolResults(
+            application_->device(), *frame->statistics_pool, 0,
+            num_statistics,
+            num_statistics * kNumStatistics * sizeof(uint64_t),
+            statistics_results_.data(), kNumStatistics * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      for (uint32_t i = 0; i < frame->num_zones; ++i) {
+        const uint32_t query = frame->statistics_queries[i];
+        if (query == kNoQuery) {
+          continue;
+        }
+        Zone* zone = GetZone(frame->names[i]);
+        for (uint32_t j = 0; j < kNumStatistics; ++j) {
+          zone->statistics[j] +=
+              statistics_results_[query * kNumStatistics + j];
+        }
+        ++zone->num_statistics;
+      }
+    }
+    const uint32_t num_counter_queries = frame->num_counter_queries;
+    if (num_counter_queries > 0 && frame->counters_complete &&
+        query_allocator_->GetResults(
+            frame->counter_queries, counter_results_.data(),
+            counters_->result_stride(), 0, 0,
+            num_counter_queries) == VK_SUCCESS) {
+      const uint32_t num_counters = counters_->num_counters();
+      for (uint32_t i = 0; i < frame->num_zones; ++i) {
+        const uint32_t query = frame->counter_queries_of_zones[i];
+        if (query == kNoQuery) {
+          continue;
+        }
+        Zone* zone = GetZone(frame->names[i]);
+        for (uint32_t j = 0; j < num_counters; ++j) {
+          zone->counters[j] += counters_->Value(
+              j, counter_results_[query * num_counters + j]);
+        }
+        ++zone->num_counters;
+      }
+    }
+    frame->submit_ns = 0;
+    frame->num_zones = 0;
+    frame->num_statistics = 0;
+    frame->statistics_active = false;
+    frame->num_counter_queries = 0;
+    frame->counters_active = false;
+    frame->counters_complete = false;
+    frame->names.clear();
+    frame->statistics_queries.clear();
+    frame->counter_queries_of_zones.clear();
+    if (host_query_reset_) {
+      ResetOnHost(frame);
+    } else {
+      frame->needs_reset = true;
+    }
+  }
+
+  // Writes the starting timestamp of the zone |name| into |cmd|, and
+  // returns the zone to pass to EndZone. |name| must stay valid until the
+  // next BeginFrame of this frame. Returns 0xFFFFFFFF, which EndZone
+  // only closes the debug label of, once the frame has max_zones_per_frame
+  // zones. The label may span primary command buffers of one submit, like
+  // the timestamps.
+  // Unless |statistics| is false, EndZone has to be recorded into the same
+  // command buffer, as neither pipeline statistics nor performance counters
+  // can span command buffers.
+  uint32_t BeginZone(VkCommandBuffer* cmd, const char* name,
+                     bool statistics = true) {
+    Frame* frame = frames_[current_frame_].get();
+    if (frame->needs_reset) {
+      (*cmd)->vkCmdResetQueryPool(*cmd, frame->pool, 0,
+                                  2 * max_zones_per_frame_);
+      if (frame->statistics_pool) {
+        (*cmd)->vkCmdResetQueryPool(*cmd, *frame->statistics_pool, 0,
+                                    max_zones_per_frame_);
+      }
+      if (counters_) {
+        query_allocator_->RecordReset(cmd, frame->counter_queries);
+      }
+      frame->needs_reset = false;
+    }
+    BeginCmdLabel(cmd, debug_labels_, name);
+    if (frame->num_zones == max_zones_per_frame_) {
+      return 0xFFFFFFFF;
+    }
+    const uint32_t zone = frame->num_zones++;
+    frame->names.push_back(name);
+    (*cmd)->vkCmdWriteTimestamp(*cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                frame->pool, 2 * zone);
+    uint32_t statistics_query = kNoQuery;
+    if (statistics && frame->statistics_pool && !frame->statistics_active) {
+      statistics_query = frame->num_statistics++;
+      frame->statistics_active = true;
+      (*cmd)->vkCmdBeginQuery(*cmd, *frame->statistics_pool, statistics_query,
+                              0);
+    }
+    frame->statistics_queries.push_back(statistics_query);
+    uint32_t counter_query = kNoQuery;
+    if (statistics && counters_ && !frame->counters_active) {
+      counter_query = frame->num_counter_queries++;
+      frame->counters_active = true;
+      (*cmd)->vkCmdBeginQuery(*cmd, frame->counter_queries.pool,
+                              frame->counter_queries.query(counter_query), 0);
+    }
+    frame->counter_queries_of_zones.push_back(counter_query);
+    return zone;
+  }
+
+  // Writes the ending timestamp of |zone| into |cmd|.
+  void EndZone(VkCommandBuffer* cmd, uint32_t zone) {
+    if (zone == 0xFFFFFFFF) {
+      EndCmdLabel(cmd, debug_labels_);
+      return;
+    }
+    Frame* frame = frames_[current_frame_].get();
+    const uint32_t statistics_query = frame->statistics_queries[zone];
+    if (statistics_query != kNoQuery) {
+      (*cmd)->vkCmdEndQuery(*cmd, *frame->statistics_pool, statistics_query);
+      frame->statistics_active = false;
+    }
+    const uint32_t counter_query = frame->counter_queries_of_zones[zone];
+    if (counter_query != kNoQuery) {
+      (*cmd)->vkCmdEndQuery(*cmd, frame->counter_queries.pool,
+                            frame->counter_queries.query(counter_query));
+      frame->counters_active = false;
+    }
+    (*cmd)->vkCmdWriteTimestamp(*cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                frame->pool, 2 * zone + 1);
+    EndCmdLabel(cmd, debug_labels_);
+  }
+
+  // Remembers the CPU time at which the command buffers of the current
+  // frame were submitted. With calibrated timestamps, the time from then
+  // until its first zone started on the GPU is measured as well.
+  // With performance counters that need a single pass, the counters of the
+  // frame are then complete.
+  void MarkSubmit() {
+    Frame* frame = frames_[current_frame_].get();
+    frame->submit_ns = CpuNanoseconds();
+    frame->counters_complete = num_counter_passes() == 1;
+  }
+
+  // Returns the number of passes that the performance counters need, or 0
+  // without them.
+  uint32_t num_counter_passes() const {
+    return counters_ ? counters_->num_passes() : 0;
+  }
+
+  // Returns true if the command buffers of a frame can be submitted again
+  // for the other passes of the performance counters, which needs host
+  // query reset, as the other queries have to be reset between the passes.
+  bool can_replay_counter_passes() const {
+    return num_counter_passes() > 1 && host_query_reset_;
+  }
+
+  // Prepares the current frame, which has already been submitted, for
+  // submitting its command buffers again with
+  // PerformanceCounters::PassSubmitInfo(|pass|). Every submit of the frame
+  // must have finished. The counters keep counting, the other queries
+  // measure the new submit. Only if can_replay_counter_passes().
+  VkPerformanceQuerySubmitInfoKHR BeginCounterPass(uint32_t pass) {
+    LOG_ASSERT(==, application_->GetLogger(), true,
+               can_replay_counter_passes());
+    Frame* frame = frames_[current_frame_].get();
+    application_->device()->vkResetQueryPoolEXT(
+        application_->device(), frame->pool, 0, 2 * max_zones_per_frame_);
+    if (frame->statistics_pool) {
+      application_->device()->vkResetQueryPoolEXT(
+          application_->device(), *frame->statistics_pool, 0,
+          max_zones_per_frame_);
+    }
+    frame->counters_complete = pass + 1 == num_counter_passes();
+    return counters_->PassSubmitInfo(pass);
+  }
+
+  // Returns the most recent time of the zone |name| in seconds, or a
+  // negative time if it has not been measured yet.
+  float GetLastZoneTime(const char* name) const {
+    for (const auto& zone : zones_) {
+      if (strcmp(zone->label.c_str() + strlen("GPU_ZONE:"), name) == 0) {
+        return zone->last_time;
+      }
+    }
+    return -1.0f;
+  }
+
+  // Returns the steady_clock time in nanoseconds at which the most recent
+  // measurement of the zone |name| ended on the GPU, or 0 if it has not been
+  // measured yet or the timestamps are not calibrated.
+  int64_t GetLastZoneEndNanoseconds(const char* name) const {
+    for (const auto& zone : zones_) {
+      if (strcmp(zone->label.c_str() + strlen("GPU_ZONE:"), name) == 0) {
+        return zone->last_end_ns;
+      }
+    }
+    return 0;
+  }
+
+  // Returns true if zones count pipeline statistics.
+  bool pipeline_statistics() const { return pipeline_statistics_; }
+
+  // Returns true if ToCpuNanoseconds() can be used.
+  bool calibrated() const { return calibrated_; }
+
+  // Converts the device timestamp |ticks| to nanoseconds on the
+  // steady_clock of the CPU, i.e. the same domain as CpuNanoseconds().
+  int64_t ToCpuNanoseconds(uint64_t ticks) const {
+    // The difference has to be sign extended from timestamp_mask_, ticks
+    // may be from before the last calibration.
+    uint64_t difference = (ticks - gpu_reference_) & timestamp_mask_;
+    int64_t signed_difference = static_cast<int64_t>(difference);
+    if (timestamp_mask_ != ~uint64_t(0) && difference > timestamp_mask_ / 2) {
+      signed_difference -= static_cast<int64_t>(timestamp_mask_) + 1;
+    }
+    return cpu_reference_ns_ +
+           static_cast<int64_t>(signed_difference * ns_per_tick_);
+  }
+
+  // Returns the current time of steady_clock in nanoseconds.
+  static int64_t CpuNanoseconds() { return trace::NowNanoseconds(); }
+
+  // Logs the statistics of every zone, one line per zone, in the format of
+  // FrameTimeRecorder::LogStatistics, and the submit to execute latency if
+  // the timestamps are calibrated. Zones with pipeline statistics get a
+  // second line with the mean of every statistic per measurement, and zones
+  // with performance counters a GPU_COUNTERS: line with the mean of every
+  // counter.
+  void LogStatistics(logging::Logger* log) const {
+    for (const auto& zone : zones_) {
+      zone->times.LogStatistics(zone->label.c_str(), 0.0f, log);
+      const uint64_t n = zone->num_statistics;
+      if (n > 0) {
+        log->LogInfo("GPU_STATS:", zone->label.c_str() + strlen("GPU_ZONE:"),
+                     " samples=", n,
+                     " vertex_invocations=", zone->statistics[0] / n,
+                     " clipping_invocations=", zone->statistics[1] / n,
+                     " clipping_primitives=", zone->statistics[2] / n,
+                     " fragment_invocations=", zone->statistics[3] / n,
+                     " compute_invocations=", zone->statistics[4] / n);
+      }
+      if (zone->num_counters > 0) {
+        log->LogInfo("GPU_COUNTERS:",
+                     zone->label.c_str() + strlen("GPU_ZONE:"),
+                     " samples=", zone->num_counters);
+        for (uint32_t i = 0; i < counters_->num_counters(); ++i) {
+          log->LogInfo("GPU_COUNTERS:",
+                       zone->label.c_str() + strlen("GPU_ZONE:"), " ",
+                       counters_->name(i), "=",
+                       zone->counters[i] / zone->num_counters);
+        }
+      }
+    }
+    if (calibrated_) {
+      submit_latency_.LogStatistics("GPU_SUBMIT_LATENCY:", 0.0f, log);
+      log->LogInfo("GPU_CLOCK: ns_per_tick=", ns_per_tick_,
+                   " timestamp_period=", timestamp_period_,
+                   " max_deviation_ns=", max_deviation_ns_);
+    }
+  }
+
+ private:
+  // The statistics query of a zone that has none.
+  static const uint32_t kNoQuery = 0xFFFFFFFF;
+  // In the order of their bits, which is the order of the results.
+  static const VkQueryPipelineStatisticFlags kStatisticFlags =
+      VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+  // The query pools of one frame, and the zones that were written to them.
+  struct Frame {
+    Frame(VulkanApplication* application, uint32_t max_zones,
+          bool pipeline_statistics)
+        : pool(CreateQueryPool(
+              &application->device(),
+              {
+                  VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                  nullptr,                                   // pNext
+                  0,                                         // flags
+                  VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+                  2 * max_zones,                             // queryCount
+                  0  // pipelineStatistics
+              })),
+          names(application->GetAllocator()),
+          statistics_queries(application->GetAllocator()),
+          num_zones(0),
+          num_statistics(0),
+          statistics_active(false),
+          counter_queries{},
+          counter_queries_of_zones(application->GetAllocator()),
+          num_counter_queries(0),
+          counters_active(false),
+          counters_complete(false),
+          needs_reset(true),
+          submit_ns(0) {
+      names.reserve(max_zones);
+      statistics_queries.reserve(max_zones);
+      counter_queries_of_zones.reserve(max_zones);
+      if (pipeline_statistics) {
+        statistics_pool = containers::make_unique<VkQueryPool>(
+            application->GetAllocator(),
+            CreateQueryPool(
+                &application->device(),
+                {
+                    VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                    nullptr,                                   // pNext
+                    0,                                         // flags
+                    VK_QUERY_TYPE_PIPELINE_STATISTICS,         // queryType
+                    max_zones,                                 // queryCount
+                    kStatisticFlags  // pipelineStatistics
+                }));
+      }
+    }
+
+    VkQueryPool pool;
+    // nullptr unless there are pipeline statistics.
+    containers::unique_ptr<VkQueryPool> statistics_pool;
+    containers::vector<const char*> names;
+    // The statistics query of every zone, or kNoQuery.
+    containers::vector<uint32_t> statistics_queries;
+    uint32_t num_zones;
+    uint32_t num_statistics;
+    // True while a zone with a statistics query has not ended.
+    bool statistics_active;
+    // Only allocated with performance counters.
+    QueryRange counter_queries;
+    // The performance query of every zone, or kNoQuery.
+    containers::vector<uint32_t> counter_queries_of_zones;
+    uint32_t num_counter_queries;
+    // True while a zone with a performance query has not ended.
+    bool counters_active;
+    // True once the command buffers were submitted for every pass.
+    bool counters_complete;
+    bool needs_reset;
+    // The CPU time of the frame's submit, or 0.
+    int64_t submit_ns;
+  };
+
+  // The accumulated times and statistics of every zone with the same name.
+  struct Zone {
+    Zone(containers::Allocator* allocator, const char* name)
+        : label("GPU_ZONE:", allocator),
+          times(allocator, kMaxRecordedZoneTimes),
+          last_time(-1.0f),
+          last_end_ns(0),
+          statistics{},
+          num_statistics(0),
+          counters{},
+          num_counters(0) {
+      label.append(name);
+    }
+    containers::string label;
+    FrameTimeRecorder times;
+    float last_time;
+    // With calibrated timestamps, when the most recent measurement ended on
+    // the CPU clock, 0 otherwise.
+    int64_t last_end_ns;
+    // The sums of every pipeline statistic, over num_statistics
+    // measurements.
+    uint64_t statistics[kNumStatistics];
+    uint64_t num_statistics;
+    // The sums of every performance counter, over num_counters
+    // measurements.
+    double counters[PerformanceCounters::kMaxCounters];
+    uint64_t num_counters;
+  };
+
+  // Samples the device clock and CLOCK_MONOTONIC at the same time, and
+  // corrects the rate of the device clock from how far both advanced since
+  // the last calibration.
+  void Calibrate() {
+    frames_since_calibration_ = 0;
+    VkCalibratedTimestampInfoEXT infos[2] = {
+        {
+            VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,  // sType
+            nullptr,                                          // pNext
+            VK_TIME_DOMAIN_DEVICE_EXT                         // timeDomain
+        },
+        {
+            VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,  // sType
+            nullptr,                                          // pNext
+            VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT                // timeDomain
+        }};
+    uint64_t timestamps[2];
+    uint64_t max_deviation;
+    if (application_->device()->vkGetCalibratedTimestampsEXT(
+            application_->device(), 2, infos, timestamps, &max_deviation) !=
+        VK_SUCCESS) {
+      return;
+    }
+    const int64_t cpu_ns = static_cast<int64_t>(timestamps[1]);
+    if (calibrated_) {
+      const uint64_t gpu_elapsed =
+          (timestamps[0] - gpu_reference_) & timestamp_mask_;
+      const int64_t cpu_elapsed = cpu_ns - cpu_reference_ns_;
+      // Over short intervals the deviation of the samples dominates.
+      if (gpu_elapsed > 0 &&
+          cpu_elapsed > 100 * static_cast<int64_t>(max_deviation)) {
+        const double measured = static_cast<double>(cpu_elapsed) / gpu_elapsed;
+        ns_per_tick_ = ns_per_tick_ * 0.9 + measured * 0.1;
+      }
+    }
+    gpu_reference_ = timestamps[0];
+    cpu_reference_ns_ = cpu_ns;
+    max_deviation_ns_ = max_deviation;
+    calibrated_ = true;
+  }
+
+  void ResetOnHost(Frame* frame) {
+    application_->device()->vkResetQueryPoolEXT(
+        application_->device(), frame->pool, 0, 2 * max_zones_per_frame_);
+    if (frame->statistics_pool) {
+      application_->device()->vkResetQueryPoolEXT(
+          application_->device(), *frame->statistics_pool, 0,
+          max_zones_per_frame_);
+    }
+    if (counters_) {
+      query_allocator_->ResetOnHost(frame->counter_queries);
+    }
+    frame->needs_reset = false;
+  }
+
+  Zone* GetZone(const char* name) {
+    for (auto& zone : zones_) {
+      if (strcmp(zone->label.c_str() + strlen("GPU_ZONE:"), name) == 0) {
+        return zone.get();
+      }
+    }
+    zones_.push_back(containers::make_unique<Zone>(
+        application_->GetAllocator(), application_->GetAllocator(), name));
+    return zones_.back().get();
+  }
+
+  VulkanApplication* application_;
+  containers::vector<containers::unique_ptr<Frame>> frames_;
+  containers::vector<containers::unique_ptr<Zone>> zones_;
+  // Scratch space for the results of one frame.
+  containers::vector<uint64_t> results_;
+  containers::vector<uint64_t> statistics_results_;
+  // nullptr without performance counters, or if the device has none.
+  containers::unique_ptr<PerformanceCounters> counters_;
+  containers::unique_ptr<QueryAllocator> query_allocator_;
+  containers::vector<VkPerformanceCounterResultKHR> counter_results_;
+  uint32_t max_zones_per_frame_;
+  bool host_query_reset_;
+  bool pipeline_statistics_;
+  // True if zones are also debug utils labels.
+  bool debug_labels_;
+  size_t current_frame_;
+  // Nanoseconds per timestamp tick.
+  float timestamp_period_;
+  uint64_t timestamp_mask_;
+  // The calibration. A device timestamp of gpu_reference_ happened at
+  // cpu_reference_ns_, and the device clock advances by ns_per_tick_
+  // nanoseconds per tick.
+  bool calibrated_;
+  uint32_t frames_since_calibration_;
+  uint64_t gpu_reference_;
+  int64_t cpu_reference_ns_;
+  double ns_per_tick_;
+  uint64_t max_deviation_ns_;
+  FrameTimeRecorder submit_latency_;
+};
+
+// Measures the commands recorded into |cmd| during its lifetime as a zone of
+// |profiler|.
+class GpuZone {
+ public:
+  GpuZone(GpuProfiler* profiler, VkCommandBuffer* cmd, const char* name)
+      : profiler_(profiler),
+        cmd_(cmd),
+        zone_(profiler->BeginZone(cmd, name)) {}
+  ~GpuZone() { profiler_->EndZone(cmd_, zone_); }
+
+ private:
+  GpuProfiler* profiler_;
+  VkCommandBuffer* cmd_;
+  uint32_t zone_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_GPU_PROFILER_H
@@ -16,12 +16,20 @@
 #include "vulkan_helpers/helper_functions.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <tuple>
 #include <fstream>
+#include <functional>
+#include <string>
 
 #include "support/containers/vector.h"
 #include "support/log/log.h"
+#include "support/trace/startup.h"
+#include "vulkan_helpers/asset_file.h"
+#include "vulkan_helpers/known_device_infos.h"
+#include "vulkan_helpers/structure_chain.h"
 
 namespace vulkan {
 VkInstance CreateEmptyInstance(containers::Allocator* allocator,
@@ -107,6 +115,7 @@ VkInstance CreateVerisonedInstanceForApplicaiton(
     containers::Allocator* allocator, LibraryWrapper* wrapper,
     const entry::EntryData* data, uint32_t version,
     const std::initializer_list<const char*> instance_extensions) {
+  STARTUP_PHASE("CreateInstance");
   // Similar to CreateDefaultInstance, but turns on the virtual swapchain
   // if the requested by entry_data.
 
@@ -206,6 +215,184 @@ containers::vector<VkPhysicalDevice> GetPhysicalDevices(
   return std::move(physical_devices);
 }
 
+namespace {
+// Returns the total size of the device-local heaps of |device|.
+VkDeviceSize GetDeviceLocalMemorySize(VkInstance& instance,
+                                      ::VkPhysicalDevice device) {
+  VkPhysicalDeviceMemoryProperties properties;
+  instance->vkGetPhysicalDeviceMemoryProperties(device, &properties);
+  VkDeviceSize size = 0;
+  for (uint32_t i = 0; i < properties.memoryHeapCount; ++i) {
+    if (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      size += properties.memoryHeaps[i].size;
+    }
+  }
+  return size;
+}
+
+// Lower is better: discrete GPUs first, then integrated, virtual and any
+// other kind of device.
+uint32_t GetDeviceTypeRank(VkPhysicalDeviceType type) {
+  switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return 0;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return 1;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+const char* GetDeviceTypeName(VkPhysicalDeviceType type) {
+  switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return "discrete GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return "integrated GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return "virtual GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return "CPU";
+    default:
+      return "other device";
+  }
+}
+
+// Parses "<vendor id>:<device id>" in hex, or the name of a known device or
+// vendor, into |info|. Returns false if |device_selection| is neither.
+bool ParseDeviceInfo(const char* device_selection, DeviceInfo* info) {
+  if (const DeviceInfo* known = FindKnownDeviceInfo(device_selection)) {
+    *info = *known;
+    return true;
+  }
+  char* end = nullptr;
+  info->vendor_id = strtoul(device_selection, &end, 16);
+  if (end == device_selection || *end != ':') {
+    return false;
+  }
+  const char* device_id = end + 1;
+  info->device_id = strtoul(device_id, &end, 16);
+  return end != device_id && *end == '\0';
+}
+
+// Returns |devices| sorted by |keys|, with |better|(a, b) returning true if
+// the key a should come before the key b. The sort is stable, so that devices
+// that are equally good are still tried in the order of the driver.
+template <typename T, typename Compare>
+containers::vector<VkPhysicalDevice> SortPhysicalDevices(
+    containers::Allocator* allocator,
+    const containers::vector<VkPhysicalDevice>& devices,
+    const containers::vector<T>& keys, Compare better) {
+  containers::vector<size_t> order(allocator);
+  for (size_t i = 0; i < devices.size(); ++i) {
+    order.push_back(i);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return better(keys[a], keys[b]);
+  });
+  containers::vector<VkPhysicalDevice> sorted(allocator);
+  for (size_t i : order) {
+    sorted.push_back(devices[i]);
+  }
+  return std::move(sorted);
+}
+
+// Returns true if |device_selection| is a non-negative decimal number, and
+// stores it in |index|.
+bool ParseDeviceIndex(const char* device_selection, uint32_t* index) {
+  char* end = nullptr;
+  *index = strtoul(device_selection, &end, 10);
+  return end != device_selection && *end == '\0';
+}
+}  // anonymous namespace
+
+containers::vector<VkPhysicalDevice> GetPhysicalDevicesInSelectionOrder(
+    containers::Allocator* allocator, VkInstance& instance,
+    const char* device_selection) {
+  containers::vector<VkPhysicalDevice> physical_devices =
+      GetPhysicalDevices(allocator, instance);
+  if (!device_selection || !*device_selection) {
+    return std::move(physical_devices);
+  }
+
+  uint32_t index = 0;
+  DeviceInfo info = {0, 0};
+  if (strcmp(device_selection, "discrete") == 0) {
+    containers::vector<uint32_t> ranks(allocator);
+    for (auto device : physical_devices) {
+      VkPhysicalDeviceProperties properties;
+      instance->vkGetPhysicalDeviceProperties(device, &properties);
+      ranks.push_back(GetDeviceTypeRank(properties.deviceType));
+    }
+    return SortPhysicalDevices(allocator, physical_devices, ranks,
+                               std::less<uint32_t>());
+  } else if (strcmp(device_selection, "memory") == 0) {
+    containers::vector<VkDeviceSize> sizes(allocator);
+    for (auto device : physical_devices) {
+      sizes.push_back(GetDeviceLocalMemorySize(instance, device));
+    }
+    return SortPhysicalDevices(allocator, physical_devices, sizes,
+                               std::greater<VkDeviceSize>());
+  } else if (ParseDeviceIndex(device_selection, &index)) {
+    if (index >= physical_devices.size()) {
+      instance.GetLogger()->LogError("There is no physical device ", index,
+                                     ", there are only ",
+                                     physical_devices.size());
+      LOG_CRASH(instance.GetLogger(), "Invalid -device");
+    }
+    containers::vector<VkPhysicalDevice> selected(allocator);
+    selected.push_back(physical_devices[index]);
+    return std::move(selected);
+  } else if (ParseDeviceInfo(device_selection, &info)) {
+    containers::vector<VkPhysicalDevice> selected(allocator);
+    for (auto device : physical_devices) {
+      VkPhysicalDeviceProperties properties;
+      instance->vkGetPhysicalDeviceProperties(device, &properties);
+      if (properties.vendorID == info.vendor_id &&
+          (info.device_id == 0 || properties.deviceID == info.device_id)) {
+        selected.push_back(device);
+      }
+    }
+    if (selected.empty()) {
+      instance.GetLogger()->LogError("No physical device matches -device=",
+                                     device_selection);
+      LOG_CRASH(instance.GetLogger(), "Invalid -device");
+    }
+    return std::move(selected);
+  }
+  instance.GetLogger()->LogError("Unknown device selection -device=",
+                                 device_selection);
+  LOG_CRASH(instance.GetLogger(), "Invalid -device");
+  return std::move(physical_devices);
+}
+
+void LogPhysicalDeviceSelection(VkInstance& instance,
+                                ::VkPhysicalDevice device,
+                                const char* device_selection) {
+  VkPhysicalDeviceProperties properties;
+  instance->vkGetPhysicalDeviceProperties(device, &properties);
+  const VkDeviceSize memory_size = GetDeviceLocalMemorySize(instance, device);
+  const char* reason = "it is the first suitable device";
+  if (device_selection && strcmp(device_selection, "discrete") == 0) {
+    reason = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
+                 ? "it is the first suitable discrete GPU"
+                 : "there is no suitable discrete GPU";
+  } else if (device_selection && strcmp(device_selection, "memory") == 0) {
+    reason = "it is the suitable device with the most device-local memory";
+  } else if (device_selection && *device_selection) {
+    reason = "it was selected with -device";
+  }
+  char ids[24];
+  snprintf(ids, sizeof(ids), "%04x:%04x", properties.vendorID,
+           properties.deviceID);
+  instance.GetLogger()->LogInfo(
+      "Using physical device ", properties.deviceName, " (",
+      GetDeviceTypeName(properties.deviceType), " ", ids, ", ",
+      memory_size >> 20, " MiB of device-local memory), because ", reason);
+}
+
 containers::vector<VkQueueFamilyProperties> GetQueueFamilyProperties(
     containers::Allocator* allocator, VkInstance& instance,
     ::VkPhysicalDevice device) {
@@ -279,26 +466,53 @@ uint32_t GetAsyncComputeQueueFamilyIndex(containers::Allocator* allocator,
   return ~0u;
 }
 
+// Returns the index of the first queue family that supports transfers but
+// neither graphics nor compute, which usually maps to a dedicated DMA engine.
+// Returns ~0u if there is no such queue family.
+uint32_t GetTransferQueueFamilyIndex(containers::Allocator* allocator,
+                                     VkInstance& instance,
+                                     ::VkPhysicalDevice device) {
+  auto properties = GetQueueFamilyProperties(allocator, instance, device);
+  for (uint32_t i = 0; i < properties.size(); ++i) {
+    if (properties[i].queueCount > 0 &&
+        HasQueueFlags(properties[i], VK_QUEUE_TRANSFER_BIT) &&
+        (properties[i].queueFlags &
+         (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0) {
+      return i;
+    }
+  }
+  return ~0u;
+}
+
 VkDevice CreateDefaultDevice(containers::Allocator* allocator,
                              VkInstance& instance,
-                             bool require_graphics_compute_queue) {
+                             bool require_graphics_compute_queue,
+                             const char* device_selection) {
   containers::vector<VkPhysicalDevice> physical_devices =
-      GetPhysicalDevices(allocator, instance);
+      GetPhysicalDevicesInSelectionOrder(allocator, instance,
+                                         device_selection);
   float priority = 1.f;
 
-  VkPhysicalDevice physical_device = physical_devices.front();
+  VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+  uint32_t queue_family_index = ~0u;
+  for (auto device : physical_devices) {
+    queue_family_index =
+        require_graphics_compute_queue
+            ? GetGraphicsAndComputeQueueFamily(allocator, instance, device,
+                                               false)
+            : GetQueueFamily(allocator, instance, device,
+                             VK_QUEUE_GRAPHICS_BIT);
+    if (queue_family_index != ~0u) {
+      physical_device = device;
+      break;
+    }
+  }
+  LOG_ASSERT(!=, instance.GetLogger(), queue_family_index, ~0u);
+  LogPhysicalDeviceSelection(instance, physical_device, device_selection);
 
   VkPhysicalDeviceProperties properties;
   instance->vkGetPhysicalDeviceProperties(physical_device, &properties);
 
-  const uint32_t queue_family_index =
-      require_graphics_compute_queue
-          ? GetGraphicsAndComputeQueueFamily(allocator, instance,
-                                             physical_device, false)
-          : GetQueueFamily(allocator, instance, physical_device,
-                           VK_QUEUE_GRAPHICS_BIT);
-  LOG_ASSERT(!=, instance.GetLogger(), queue_family_index, ~0u);
-
   VkDeviceQueueCreateInfo queue_info{
       /* sType = */ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
       /* pNext = */ nullptr,
@@ -468,9 +682,12 @@ VkDevice CreateDeviceForSwapchain(
     const VkPhysicalDeviceFeatures& features,
     bool try_to_find_separate_present_queue,
     uint32_t* async_compute_queue_index, uint32_t* sparse_binding_queue_index,
-    bool use_host_query_reset, void* device_next) {
+    bool use_host_query_reset, void* device_next,
+    uint32_t* transfer_queue_index, const char* device_selection,
+    uint32_t* num_async_compute_queues) {
   containers::vector<VkPhysicalDevice> physical_devices =
-      GetPhysicalDevices(allocator, *instance);
+      GetPhysicalDevicesInSelectionOrder(allocator, *instance,
+                                         device_selection);
   float priority = 1.f;
   containers::vector<float> additional_priorities(allocator);
   additional_priorities.push_back(1.0f);
@@ -518,12 +735,17 @@ VkDevice CreateDeviceForSwapchain(
     uint32_t backup_present_queue_family_index = 0xFFFFFFFF;
     for (; present_queue_family_index < properties.size();
          ++present_queue_family_index) {
-      VkBool32 supports_swapchain = false;
-      LOG_EXPECT(==, instance->GetLogger(),
-                 (*instance)->vkGetPhysicalDeviceSurfaceSupportKHR(
-                     device, present_queue_family_index, *surface,
-                     &supports_swapchain),
-                 VK_SUCCESS);
+      // Without a surface, offscreen images are "presented" from the
+      // graphics queue.
+      VkBool32 supports_swapchain =
+          present_queue_family_index == graphics_queue_family_index;
+      if (surface->get_raw_object() != VK_NULL_HANDLE) {
+        LOG_EXPECT(==, instance->GetLogger(),
+                   (*instance)->vkGetPhysicalDeviceSurfaceSupportKHR(
+                       device, present_queue_family_index, *surface,
+                       &supports_swapchain),
+                   VK_SUCCESS);
+      }
       if (supports_swapchain) {
         if (!try_to_find_separate_present_queue) {
           break;
@@ -547,7 +769,7 @@ VkDevice CreateDeviceForSwapchain(
     }
 
     containers::vector<QueueCreateInfo> queue_create_infos(allocator);
-    queue_create_infos.reserve(4);
+    queue_create_infos.reserve(5);
 
     queue_create_infos.emplace_back(QueueCreateInfo(
         allocator, graphics_queue_family_index,
@@ -562,20 +784,38 @@ VkDevice CreateDeviceForSwapchain(
     if (async_compute_queue_index != nullptr) {
       *async_compute_queue_index =
           GetAsyncComputeQueueFamilyIndex(allocator, *instance, device);
+      const uint32_t num_requested =
+          num_async_compute_queues && *num_async_compute_queues > 1
+              ? *num_async_compute_queues
+              : 1;
+      uint32_t num_created = 0;
       if (*async_compute_queue_index != 0xFFFFFFFF) {
-        bool added = false;
+        QueueCreateInfo* compute_info = nullptr;
         for (auto& qi : queue_create_infos) {
           if (qi.queue_family_index == *async_compute_queue_index) {
-            qi.AddQueue(0.5f);
-            added = true;
+            compute_info = &qi;
             break;
           }
         }
-        if (!added) {
+        if (!compute_info) {
           queue_create_infos.emplace_back(
               QueueCreateInfo(allocator, *async_compute_queue_index, 0));
-          queue_create_infos.back().AddQueue(0.5f);
+          compute_info = &queue_create_infos.back();
+        }
+        // As many queues as were asked for, and the family has left.
+        const uint32_t family_count =
+            properties[*async_compute_queue_index].queueCount;
+        while (num_created < num_requested &&
+               compute_info->queue_count < family_count) {
+          compute_info->AddQueue(0.5f);
+          ++num_created;
         }
+        if (num_created == 0) {
+          *async_compute_queue_index = 0xFFFFFFFF;
+        }
+      }
+      if (num_async_compute_queues) {
+        *num_async_compute_queues = num_created;
       }
     }
     if (sparse_binding_queue_index != nullptr) {
@@ -597,6 +837,25 @@ VkDevice CreateDeviceForSwapchain(
         }
       }
     }
+    if (transfer_queue_index != nullptr) {
+      *transfer_queue_index =
+          GetTransferQueueFamilyIndex(allocator, *instance, device);
+      if (*transfer_queue_index != 0xFFFFFFFF) {
+        for (auto& qi : queue_create_infos) {
+          if (qi.queue_family_index == *transfer_queue_index) {
+            // Only use a transfer queue that is not shared with another
+            // queue.
+            *transfer_queue_index = 0xFFFFFFFF;
+            break;
+          }
+        }
+      }
+      if (*transfer_queue_index != 0xFFFFFFFF) {
+        queue_create_infos.emplace_back(
+            QueueCreateInfo(allocator, *transfer_queue_index, 0));
+        queue_create_infos.back().AddQueue(1.0f);
+      }
+    }
 
     const char* forced_extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
     containers::vector<const char*> enabled_extensions(allocator);
@@ -608,18 +867,23 @@ VkDevice CreateDeviceForSwapchain(
     }
 
     containers::vector<VkDeviceQueueCreateInfo> raw_queue_infos(allocator);
-    raw_queue_infos.reserve(4);
+    raw_queue_infos.reserve(5);
     for (const auto& qi : queue_create_infos) {
       raw_queue_infos.emplace_back(qi.GetVkDeviceQueueCreateInfo());
     }
 
-    VkPhysicalDeviceHostQueryResetFeaturesEXT host_query_reset_feature{
-        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES_EXT,
-        device_next, use_host_query_reset};
-
-    VkPhysicalDeviceFloatControlsPropertiesKHR float_control_properties{
+    // Every device is created with these, in front of |device_next|.
+    StructureChain<VkPhysicalDeviceProtectedMemoryFeatures,
+                   VkPhysicalDeviceFloatControlsPropertiesKHR,
+                   VkPhysicalDeviceHostQueryResetFeaturesEXT>
+        device_structures(device_next);
+    device_structures.get<VkPhysicalDeviceProtectedMemoryFeatures>()
+        .protectedMemory = use_protected_memory;
+    device_structures.get<VkPhysicalDeviceHostQueryResetFeaturesEXT>()
+        .hostQueryReset = use_host_query_reset;
+    device_structures.Set(VkPhysicalDeviceFloatControlsPropertiesKHR{
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FLOAT_CONTROLS_PROPERTIES_KHR,
-        &host_query_reset_feature,  // pNext
+        nullptr,  // pNext
         VkShaderFloatControlsIndependenceKHR::
             VK_SHADER_FLOAT_CONTROLS_INDEPENDENCE_ALL_KHR,  // denormBehaviorIndependence;
         VkShaderFloatControlsIndependenceKHR::
@@ -639,17 +903,13 @@ VkDevice CreateDeviceForSwapchain(
         1,  //  shaderRoundingModeRTZFloat16;
         1,  //  shaderRoundingModeRTZFloat32;
         1,  //  shaderRoundingModeRTZFloat64;
-    };
-
-    VkPhysicalDeviceProtectedMemoryFeatures protected_memory_feature{
-        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROTECTED_MEMORY_FEATURES,
-        &float_control_properties, use_protected_memory};
+    });
 
     VkPhysicalDeviceFeatures empty_features = {0};
 
     VkDeviceCreateInfo info{
         VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,           // stype
-        &protected_memory_feature,                      // pNext
+        device_structures.head(),                       // pNext
         0,                                              // flags
         static_cast<uint32_t>(raw_queue_infos.size()),  // queueCreateInfoCount
         raw_queue_infos.data(),                         // pQueueCreateInfos
@@ -668,6 +928,7 @@ VkDevice CreateDeviceForSwapchain(
                                            &raw_device),
                VK_SUCCESS);
 
+    LogPhysicalDeviceSelection(*instance, physical_device, device_selection);
     instance->GetLogger()->LogInfo("Enabled Device Extensions: ");
     for (auto& extension : enabled_extensions) {
       instance->GetLogger()->LogInfo("    ", extension);
@@ -734,12 +995,17 @@ containers::vector<QueueCreateInfo> GetAcceptableQueues(
   uint32_t backup_present_queue_family_index = 0xFFFFFFFF;
   for (; present_queue_family_index < properties.size();
        ++present_queue_family_index) {
-    VkBool32 supports_swapchain = false;
-    LOG_EXPECT(==, instance->GetLogger(),
-               (*instance)->vkGetPhysicalDeviceSurfaceSupportKHR(
-                   physical_device, present_queue_family_index, *surface,
-                   &supports_swapchain),
-               VK_SUCCESS);
+    // Without a surface, offscreen images are "presented" from the graphics
+    // queue.
+    VkBool32 supports_swapchain =
+        present_queue_family_index == graphics_queue_family_index;
+    if (surface->get_raw_object() != VK_NULL_HANDLE) {
+      LOG_EXPECT(==, instance->GetLogger(),
+                 (*instance)->vkGetPhysicalDeviceSurfaceSupportKHR(
+                     physical_device, present_queue_family_index, *surface,
+                     &supports_swapchain),
+                 VK_SUCCESS);
+    }
     if (supports_swapchain) {
       if (!try_to_find_separate_present_queue) {
         break;
@@ -941,8 +1207,11 @@ VkDevice CreateDeviceGroupForSwapchain(
       *sparse_binding_queue_index = sparse_binding_queue_indices[0];
     }
 
-    return vulkan::VkDevice(allocator, raw_device, nullptr, instance, nullptr,
-                            group.physicalDevices[0],
+    VkPhysicalDeviceProperties properties;
+    (*instance)->vkGetPhysicalDeviceProperties(group.physicalDevices[0],
+                                               &properties);
+    return vulkan::VkDevice(allocator, raw_device, nullptr, instance,
+                            &properties, group.physicalDevices[0],
                             group.physicalDeviceCount);
   }
   instance->GetLogger()->LogError(
@@ -953,10 +1222,10 @@ VkDevice CreateDeviceGroupForSwapchain(
                           &throwaway_properties, VK_NULL_HANDLE);
 }
 
-VkCommandPool CreateDefaultCommandPool(containers::Allocator* allocator,
-                                       VkDevice& device,
-                                       bool use_protected_memory,
-                                       uint32_t queueFamilyIndex) {
+VkCommandPool CreateDefaultCommandPool(
+    containers::Allocator* allocator, VkDevice& device,
+    bool use_protected_memory, uint32_t queueFamilyIndex,
+    const VkAllocationCallbacks* callbacks) {
   VkCommandPoolCreateInfo info = {
       /* sType = */ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
       /* pNext = */ nullptr,
@@ -970,15 +1239,19 @@ VkCommandPool CreateDefaultCommandPool(containers::Allocator* allocator,
   if (device.is_valid()) {
     LOG_ASSERT(
         ==, device.GetLogger(),
-        device->vkCreateCommandPool(device, &info, nullptr, &raw_command_pool),
+        device->vkCreateCommandPool(device, &info, callbacks,
+                                    &raw_command_pool),
         VK_SUCCESS);
   }
-  return vulkan::VkCommandPool(raw_command_pool, nullptr, &device);
+  return vulkan::VkCommandPool(raw_command_pool, callbacks, &device);
 }
 
 VkSurfaceKHR CreateDefaultSurface(VkInstance* instance,
                                   const entry::EntryData* data) {
-  ::VkSurfaceKHR surface;
+  ::VkSurfaceKHR surface = VK_NULL_HANDLE;
+  if (data->headless()) {
+    return VkSurfaceKHR(surface, nullptr, instance);
+  }
 #if defined __ANDROID__
   VkAndroidSurfaceCreateInfoKHR create_info{
       VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR, 0, 0,
@@ -1041,21 +1314,56 @@ VkCommandBuffer CreateCommandBuffer(VkCommandPool* pool,
   return vulkan::VkCommandBuffer(raw_command_buffer, pool, device);
 }
 
+bool GetPresentModeFromName(const char* name, VkPresentModeKHR* mode) {
+  const struct {
+    const char* name;
+    VkPresentModeKHR mode;
+  } kPresentModes[] = {
+      {"fifo", VK_PRESENT_MODE_FIFO_KHR},
+      {"fifo_relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+      {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
+      {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR},
+  };
+  for (const auto& present_mode : kPresentModes) {
+    if (strcmp(name, present_mode.name) == 0) {
+      *mode = present_mode.mode;
+      return true;
+    }
+  }
+  return false;
+}
+
 VkSwapchainKHR CreateDefaultSwapchain(
     VkInstance* instance, VkDevice* device, VkSurfaceKHR* surface,
     containers::Allocator* allocator, uint32_t graphics_queue_index,
     uint32_t present_queue_index, const entry::EntryData* data,
     VkColorSpaceKHR swapchain_color_space, bool use_shared_presentation,
     VkSwapchainCreateFlagsKHR flags, bool use_10bit_hdr,
-    const void* extensions) {
+    const void* extensions, ::VkSwapchainKHR old_swapchain,
+    uint32_t num_images_override, const char* present_mode_override,
+    VkSharingMode sharing_mode) {
+  STARTUP_PHASE("CreateSwapchain");
+  const uint32_t requested_images =
+      num_images_override > 0 ? num_images_override : data->swapchain_images();
+  const char* requested_present_mode =
+      present_mode_override ? present_mode_override : data->present_mode();
   ::VkSwapchainKHR swapchain = VK_NULL_HANDLE;
   VkExtent2D image_extent = {0, 0};
+  // Like the images that VulkanApplication renders to in headless mode.
+  VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT;
   containers::vector<VkSurfaceFormatKHR> surface_formats(allocator);
   surface_formats.resize(1);
 
-  if (device->is_valid()) {
-    const bool has_multiple_queues =
-        present_queue_index != graphics_queue_index;
+  if (data->headless()) {
+    // The application renders to images it creates itself instead.
+    image_extent = VkExtent2D{data->width(), data->height()};
+    surface_formats[0].format = VK_FORMAT_B8G8R8A8_UNORM;
+  } else if (device->is_valid()) {
+    const bool concurrent =
+        present_queue_index != graphics_queue_index &&
+        sharing_mode == VK_SHARING_MODE_CONCURRENT;
     const uint32_t queues[2] = {graphics_queue_index, present_queue_index};
     VkSurfaceCapabilitiesKHR surface_caps;
     LOG_ASSERT(==, instance->GetLogger(),
@@ -1127,6 +1435,26 @@ VkSwapchainKHR CreateDefaultSwapchain(
                    present_modes.data()),
                VK_SUCCESS);
 
+    VkPresentModeKHR present_mode = present_modes.front();
+    if (use_shared_presentation) {
+      present_mode = VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR;
+    } else if (requested_present_mode) {
+      VkPresentModeKHR requested_mode;
+      if (!GetPresentModeFromName(requested_present_mode, &requested_mode)) {
+        instance->GetLogger()->LogError("Unknown present mode ",
+                                        requested_present_mode);
+      } else if (std::find(present_modes.begin(), present_modes.end(),
+                           requested_mode) == present_modes.end()) {
+        // FIFO is the only mode that every surface has to support.
+        instance->GetLogger()->LogError("Present mode ",
+                                        requested_present_mode,
+                                        " is not supported, using fifo");
+        present_mode = VK_PRESENT_MODE_FIFO_KHR;
+      } else {
+        present_mode = requested_mode;
+      }
+    }
+
     uint32_t chosenAlpha =
         static_cast<uint32_t>(surface_caps.supportedCompositeAlpha);
     LOG_ASSERT(!=, instance->GetLogger(), 0,
@@ -1143,36 +1471,58 @@ VkSwapchainKHR CreateDefaultSwapchain(
 
     uint32_t maxSwapchains =
         std::max(surface_caps.maxImageCount, surface_caps.minImageCount + 1);
+    // One more image than the surface needs, unless a number was asked for.
+    // A maxImageCount of 0 means there is no limit.
+    uint32_t num_images = std::min(surface_caps.minImageCount + 1,
+                                   maxSwapchains);
+    if (requested_images > 0) {
+      num_images = std::max(requested_images, surface_caps.minImageCount);
+      if (surface_caps.maxImageCount > 0) {
+        num_images = std::min(num_images, surface_caps.maxImageCount);
+      }
+      if (num_images != requested_images) {
+        instance->GetLogger()->LogInfo("The surface does not allow ",
+                                       requested_images,
+                                       " swapchain images, asking for ",
+                                       num_images);
+      }
+    }
 
     if (use_10bit_hdr) {
       surface_formats[0].format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
       surface_formats[0].colorSpace = VK_COLOR_SPACE_HDR10_ST2084_EXT;
     }
 
+    // Frames are copied out of the swapchain images to capture them, where
+    // the surface allows it.
+    image_usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+        (surface_caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
     VkSwapchainCreateInfoKHR swapchainCreateInfo{
         VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,  // sType
         extensions,                                   // pNext
         flags,                                        // flags
         *surface,                                     // surface
-        std::min(surface_caps.minImageCount + 1,
-                 maxSwapchains),        // minImageCount
+        // A shared presentable image is the only image of its swapchain.
+        use_shared_presentation
+            ? 1u
+            : num_images,               // minImageCount
         surface_formats[0].format,      // surfaceFormat
         surface_formats[0].colorSpace,  // colorSpace
         image_extent,                   // imageExtent
         1,                              // imageArrayLayers
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-            VK_IMAGE_USAGE_TRANSFER_DST_BIT,  // imageUsage
-        has_multiple_queues ? VK_SHARING_MODE_CONCURRENT
-                            : VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
-        has_multiple_queues ? 2u : 0u,
-        has_multiple_queues ? queues : nullptr,  // pQueueFamilyIndices
-        surface_caps.currentTransform,           // preTransform,
+        image_usage,                    // imageUsage
+        concurrent ? VK_SHARING_MODE_CONCURRENT
+                   : VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
+        concurrent ? 2u : 0u,
+        concurrent ? queues : nullptr,  // pQueueFamilyIndices
+        surface_caps.currentTransform,  // preTransform,
         static_cast<VkCompositeAlphaFlagBitsKHR>(
             chosenAlpha),  // compositeAlpha
-        use_shared_presentation ? VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR
-                                : present_modes.front(),  // presentModes
-        false,                                            // clipped
-        VK_NULL_HANDLE                                    // oldSwapchain
+        present_mode,   // presentModes
+        false,          // clipped
+        old_swapchain   // oldSwapchain
     };
 
     LOG_ASSERT(==, instance->GetLogger(),
@@ -1182,7 +1532,8 @@ VkSwapchainKHR CreateDefaultSwapchain(
   }
 
   return VkSwapchainKHR(swapchain, nullptr, device, image_extent.width,
-                        image_extent.height, 1u, surface_formats[0].format);
+                        image_extent.height, 1u, surface_formats[0].format,
+                        image_usage);
 }
 
 VkImage CreateDefault2DColorImage(VkDevice* device, uint32_t width,
@@ -1233,7 +1584,7 @@ VkSampler CreateDefaultSampler(VkDevice* device) {
       /* compareEnable = */ false,
       /* compareOp = */ VK_COMPARE_OP_NEVER,
       /* minLod = */ 0.f,
-      /* maxLod = */ 0.f,
+      /* maxLod = */ VK_LOD_CLAMP_NONE,
       /* borderColor = */ VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
       /* unnormalizedCoordinates = */ false,
   };
@@ -1244,11 +1595,13 @@ VkSampler CreateDefaultSampler(VkDevice* device) {
   return vulkan::VkSampler(raw_sampler, nullptr, device);
 }
 
-VkSampler CreateSampler(VkDevice* device, VkFilter minFilter,
-                        VkFilter magFilter, VkSamplerAddressMode addressModeU,
-                        VkSamplerAddressMode addressModeV,
-                        VkSamplerAddressMode addressModeW, void* extension) {
-  VkSamplerCreateInfo info{
+VkSamplerCreateInfo GetSamplerCreateInfo(VkFilter minFilter,
+                                         VkFilter magFilter,
+                                         VkSamplerAddressMode addressModeU,
+                                         VkSamplerAddressMode addressModeV,
+                                         VkSamplerAddressMode addressModeW,
+                                         void* extension) {
+  return {
       /* sType = */ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
       /* pNext = */ extension,
       /* flags = */ 0,
@@ -1264,10 +1617,20 @@ VkSampler CreateSampler(VkDevice* device, VkFilter minFilter,
       /* compareEnable = */ false,
       /* compareOp = */ VK_COMPARE_OP_NEVER,
       /* minLod = */ 0.f,
-      /* maxLod = */ 0.f,
+      // Sampler Y'CbCr conversion is only used with single-level images.
+      /* maxLod = */ extension ? 0.f : VK_LOD_CLAMP_NONE,
       /* borderColor = */ VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
       /* unnormalizedCoordinates = */ false,
   };
+}
+
+VkSampler CreateSampler(VkDevice* device, VkFilter minFilter,
+                        VkFilter magFilter, VkSamplerAddressMode addressModeU,
+                        VkSamplerAddressMode addressModeV,
+                        VkSamplerAddressMode addressModeW, void* extension) {
+  VkSamplerCreateInfo info =
+      GetSamplerCreateInfo(minFilter, magFilter, addressModeU, addressModeV,
+                           addressModeW, extension);
   ::VkSampler raw_sampler;
   LOG_ASSERT(==, device->GetLogger(),
              (*device)->vkCreateSampler(*device, &info, nullptr, &raw_sampler),
@@ -1279,18 +1642,10 @@ VkDescriptorSetLayout CreateDescriptorSetLayout(
     containers::Allocator* allocator, VkDevice* device,
     std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
     VkDescriptorSetLayoutCreateFlags flags) {
-  containers::vector<VkDescriptorSetLayoutBinding> contiguous_bindings(
-      allocator);
-  contiguous_bindings.resize(bindings.size());
-  auto binding = bindings.begin();
-  for (size_t i = 0; i < bindings.size(); ++i, ++binding) {
-    contiguous_bindings[i] = *binding;
-  }
-
+  // The bindings of an initializer_list are already contiguous.
   VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info{
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, flags,
-      static_cast<uint32_t>(contiguous_bindings.size()),
-      contiguous_bindings.data()};
+      static_cast<uint32_t>(bindings.size()), bindings.begin()};
 
   ::VkDescriptorSetLayout layout;
   LOG_ASSERT(
@@ -1300,23 +1655,101 @@ VkDescriptorSetLayout CreateDescriptorSetLayout(
   return VkDescriptorSetLayout(layout, nullptr, device);
 }
 
-// Creates a default pipeline cache, it does not load anything from disk.
+std::string GetPipelineCachePath(VkDevice* device, const char* prefix) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string path = prefix;
+  path += "_" + std::to_string(device->vendor_id()) + "_" +
+          std::to_string(device->device_id()) + "_" +
+          std::to_string(device->driver_version()) + "_";
+  for (size_t i = 0; i < VK_UUID_SIZE; ++i) {
+    path += kHexDigits[device->pipeline_cache_uuid()[i] >> 4];
+    path += kHexDigits[device->pipeline_cache_uuid()[i] & 0xF];
+  }
+  path += ".pipeline_cache";
+  return path;
+}
+
+std::string GetPipelineCorpusPath(const char* prefix) {
+  return std::string(prefix) + ".pipeline_corpus";
+}
+
+namespace {
+// Returns true if there is a file at |location| that can be read. AssetFile
+// logs an error for missing files, which is expected for the automatic
+// cache.
+bool PipelineCacheFileExists(const char* location) {
+  return std::ifstream(location, std::ios::binary).is_open();
+}
+
+// Returns true if |data| starts with a VkPipelineCacheHeaderVersionOne
+// header that was written for the same device and driver as |device|.
+// Drivers are supposed to reject other caches themselves, but not all of
+// them do.
+bool IsPipelineCacheCompatible(VkDevice* device, const uint8_t* data,
+                               size_t size) {
+  // headerSize, headerVersion, vendorID, deviceID and pipelineCacheUUID.
+  const size_t kHeaderSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (size < kHeaderSize) {
+    return false;
+  }
+  uint32_t header[4];
+  memcpy(header, data, sizeof(header));
+  return header[0] >= kHeaderSize &&
+         header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header[2] == device->vendor_id() &&
+         header[3] == device->device_id() &&
+         memcmp(data + sizeof(header), device->pipeline_cache_uuid(),
+                VK_UUID_SIZE) == 0;
+}
+}  // anonymous namespace
+
+// Creates a default pipeline cache, it is initialized from
+// -load-pipeline-cache or -pipeline-cache-dir if either was given.
 VkPipelineCache CreateDefaultPipelineCache(VkDevice* device, const entry::EntryData* entry_data) {
-  ::VkPipelineCache cache = VK_NULL_HANDLE;
-  void* initial_data = nullptr;
+  VkPipelineCache cache(VK_NULL_HANDLE, nullptr, device);
+  LoadDefaultPipelineCache(device, entry_data, &cache);
+  return cache;
+}
+
+void LoadDefaultPipelineCache(VkDevice* device,
+                              const entry::EntryData* entry_data,
+                              VkPipelineCache* cache) {
+  STARTUP_PHASE("CreatePipelineCache");
+  ::VkPipelineCache raw_cache = VK_NULL_HANDLE;
+  const void* initial_data = nullptr;
   size_t initial_size = 0;
-  std::vector<char> buffer;
+  // The file stays mapped until the cache is created. An uncompressed cache
+  // is handed to the driver straight from the mapping.
+  containers::unique_ptr<AssetFile> file;
+  std::string location;
   if (entry_data->load_pipeline_cache()) {
-    std::ifstream in_file(entry_data->load_pipeline_cache(), std::ios::binary | std::ios::ate);
-    initial_size = in_file.tellg();
-    in_file.seekg(0, std::ios::beg);
-    buffer.resize(initial_size);
-    in_file.read(buffer.data(), initial_size);
-    LOG_ASSERT(==, entry_data->logger(), false, in_file.bad());
-    initial_data = buffer.data();
-
-    entry_data->logger()->LogInfo("Loaded pipeline cache from \"",
-      entry_data->load_pipeline_cache(), "\" [", initial_size, "] bytes");
+    location = entry_data->load_pipeline_cache();
+  } else if (entry_data->pipeline_cache_prefix()) {
+    location =
+        GetPipelineCachePath(device, entry_data->pipeline_cache_prefix());
+  }
+  if (!location.empty() && !PipelineCacheFileExists(location.c_str())) {
+    entry_data->logger()->LogInfo("No pipeline cache at \"", location, "\"");
+  } else if (!location.empty()) {
+    file = containers::make_unique<AssetFile>(
+        entry_data->allocator(), entry_data->allocator(),
+        entry_data->logger(), location.c_str());
+    if (!file->is_valid() || !file->has_section(kAssetPipelineCache)) {
+      entry_data->logger()->LogInfo("Ignoring pipeline cache \"", location,
+                                    "\", it is not a pipeline cache file");
+    } else if (!IsPipelineCacheCompatible(
+                   device, file->section(kAssetPipelineCache),
+                   file->section_size(kAssetPipelineCache))) {
+      entry_data->logger()->LogInfo("Ignoring pipeline cache \"", location,
+                                    "\", it was written for a different "
+                                    "device or driver");
+    } else {
+      initial_size = file->section_size(kAssetPipelineCache);
+      initial_data = file->section(kAssetPipelineCache);
+      entry_data->logger()->LogInfo("Loaded pipeline cache from \"",
+                                    location, "\" [", initial_size,
+                                    "] bytes");
+    }
   }
 
   VkPipelineCacheCreateInfo create_info{
@@ -1329,14 +1762,41 @@ VkPipelineCache CreateDefaultPipelineCache(VkDevice* device, const entry::EntryD
   if (device->is_valid()) {
     LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
                (*device)->vkCreatePipelineCache(*device, &create_info, nullptr,
-                                                &cache));
+                                                &raw_cache));
   }
-  return VkPipelineCache(cache, nullptr, device);
+  cache->initialize(raw_cache);
 }
 
-// Writes the given pipeline cache to the given location on disk.
+bool WriteFileAtomically(logging::Logger* log, const char* location,
+                         const void* data, size_t size) {
+  const std::string temporary_location = std::string(location) + ".tmp";
+  {
+    std::ofstream out_file(temporary_location, std::ios::binary);
+    out_file.write(static_cast<const char*>(data),
+                   static_cast<std::streamsize>(size));
+    out_file.close();
+    if (!out_file) {
+      log->LogError("Could not write \"", temporary_location, "\"");
+      std::remove(temporary_location.c_str());
+      return false;
+    }
+  }
+#if defined _WIN32
+  // rename() does not replace existing files on Windows.
+  std::remove(location);
+#endif
+  if (std::rename(temporary_location.c_str(), location) != 0) {
+    log->LogError("Could not move \"", temporary_location, "\" to \"",
+                  location, "\"");
+    std::remove(temporary_location.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Writes the given pipeline cache to the given location on disk, as a
+// run-length encoded asset file.
 void WritePipelineCache(VkDevice* device, VkPipelineCache* cache, const char* location) {
-   device->GetLogger()->LogInfo("Wrote pipeline cache to \"", location, "\"");
   std::vector<char> buffer;
   size_t size = 0;
   LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
@@ -1344,9 +1804,14 @@ void WritePipelineCache(VkDevice* device, VkPipelineCache* cache, const char* lo
   buffer.resize(size);
   LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
     (*device)->vkGetPipelineCacheData(*device, *cache, &size, buffer.data()));
-  std::ofstream out_file(location, std::ios::binary);
-  out_file.write(buffer.data(), size);
-  LOG_ASSERT(==, device->GetLogger(), false, out_file.bad());
+  std::vector<uint8_t> file;
+  EncodeAssetFile(kAssetPipelineCache, buffer.data(), size, true, &file);
+  if (WriteFileAtomically(device->GetLogger(), location, file.data(),
+                          file.size())) {
+    device->GetLogger()->LogInfo("Wrote pipeline cache to \"", location,
+                                 "\" [", size, "] bytes, [", file.size(),
+                                 "] on disk");
+  }
 }
 
 VkQueryPool CreateQueryPool(VkDevice* device,
@@ -1458,19 +1923,9 @@ void RecordImageLayoutTransition(
       image,                    // image
       subresource_range,        // subresourceRange
   };
-  (*cmd_buffer)
-      ->vkCmdPipelineBarrier(
-          *cmd_buffer,                         // commandBuffer
-          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,  // srcStageMask
-          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,  // dstStageMask
-          0,                                   // dependencyFlags
-          0,                                   // memoryBarrierCount
-          nullptr,                             // pMemoryBarriers
-          0,                                   // bufferMemoryBarrierCount
-          nullptr,                             // pBufferMemoryBarriers
-          1,                                   // imageMemoryBarrierCount
-          &image_memory_barrier                // pImageMemoryBarriers
-      );
+  cmd_buffer->QueueImageBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                image_memory_barrier);
 }
 
 namespace {
@@ -1526,4 +1981,65 @@ size_t GetImageExtentSizeInBytes(const VkExtent3D& extent, VkFormat format) {
   size_t h = size_t(RoundUpTo(extent.height, tb_height_size));
   return w * h * element_size;
 }
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const uint32_t float_exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+  if (float_exponent == 0xff) {
+    // Infinities stay infinities, and NaNs stay NaNs.
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  }
+  const int32_t exponent = static_cast<int32_t>(float_exponent) - 127 + 15;
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  uint32_t shift = 13;
+  uint32_t half = 0;
+  if (exponent <= 0) {
+    // The result is a denormal, or rounds to 0.
+    if (exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000;
+    shift = static_cast<uint32_t>(14 - exponent);
+    half = mantissa >> shift;
+  } else {
+    half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> shift);
+  }
+  // Carrying out of the mantissa correctly bumps the exponent.
+  const uint32_t remainder = mantissa & ((1u << shift) - 1);
+  const uint32_t halfway = 1u << (shift - 1);
+  if (remainder > halfway || (remainder == halfway && (half & 1))) {
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+float HalfToFloat(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  uint32_t bits = 0;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  } else if (mantissa != 0) {
+    // Denormals become normal floats.
+    uint32_t float_exponent = 127 - 15 + 1;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      --float_exponent;
+    }
+    bits = sign | (float_exponent << 23) | ((mantissa & 0x3ff) << 13);
+  } else {
+    bits = sign;
+  }
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
 }  // namespace vulkan
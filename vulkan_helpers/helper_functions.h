@@ -17,6 +17,7 @@
 #define VULKAN_HELPERS_HELPER_FUNCTIONS_H_
 
 #include <cstring>
+#include <string>
 #include <tuple>
 
 #include "support/containers/vector.h"
@@ -71,6 +72,26 @@ VkInstance Create11InstanceForApplication(
 containers::vector<VkPhysicalDevice> GetPhysicalDevices(
     containers::Allocator* allocator, VkInstance& instance);
 
+// Returns the physical devices of |instance| in the order in which they
+// should be tried, according to |device_selection|, which is one of:
+//   nullptr or "": the order of vkEnumeratePhysicalDevices.
+//   "discrete": discrete GPUs first, then integrated and virtual ones.
+//   "memory": the devices with the most device-local memory first.
+//   "<index>": only the device with the given index.
+//   "<vendor id>:<device id>" in hex, or the name of a device or vendor in
+//   known_device_infos.cpp: only the matching devices. A device ID of 0
+//   matches every device of the vendor.
+// Crashes if |device_selection| is invalid or no device matches it.
+containers::vector<VkPhysicalDevice> GetPhysicalDevicesInSelectionOrder(
+    containers::Allocator* allocator, VkInstance& instance,
+    const char* device_selection);
+
+// Logs the name, type, IDs and memory of the physical |device|, and why it
+// was chosen for |device_selection|.
+void LogPhysicalDeviceSelection(VkInstance& instance,
+                                ::VkPhysicalDevice device,
+                                const char* device_selection);
+
 // Gets all queue family properties for the given physical |device| from the
 // given |instance|. Queue family properties will be returned in a vector
 // allocated from the given |allocator|.
@@ -97,19 +118,24 @@ uint32_t GetQueueFamily(containers::Allocator* allocator, VkInstance& instance,
 // and compute capabilities. Vulkan functions that are resolved through the
 // create device will be stored in the space allocated by the given |allocator|.
 // The |allocator| must continue to exist until the device is destroyed.
+// The first physical device that has such a queue, in the order of
+// |device_selection| (see GetPhysicalDevicesInSelectionOrder), is used.
 VkDevice CreateDefaultDevice(containers::Allocator* allocator,
                              VkInstance& instance,
-                             bool require_graphics_compute_queue = false);
+                             bool require_graphics_compute_queue = false,
+                             const char* device_selection = nullptr);
 
 // Creates a command pool with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
-// set.
-VkCommandPool CreateDefaultCommandPool(containers::Allocator* allocator,
-                                       VkDevice& device,
-                                       bool use_protected_memory,
-                                       uint32_t queueFamilyIndex = 0);
+// set. The driver allocates its host memory for the pool and its command
+// buffers with |callbacks|, if they are not nullptr.
+VkCommandPool CreateDefaultCommandPool(
+    containers::Allocator* allocator, VkDevice& device,
+    bool use_protected_memory, uint32_t queueFamilyIndex = 0,
+    const VkAllocationCallbacks* callbacks = nullptr);
 
 // Creates a surface to render into the the default window
 // provided in entry_data.
+// In headless mode there is no window, and the surface is VK_NULL_HANDLE.
 VkSurfaceKHR CreateDefaultSurface(VkInstance* instance,
                                   const entry::EntryData* entry_data);
 
@@ -125,6 +151,15 @@ VkSurfaceKHR CreateDefaultSurface(VkInstance* instance,
 // async_compute_queue_index with the queue family of the compute queue.
 // If no async compute queue could be created, *async_compute_queue_index
 // will be 0xFFFFFFFF
+// If num_async_compute_queues is not nullptr, up to that many async compute
+// queues are created, as many as the queue family has left, and it is set to
+// the number that were.
+// If transfer_queue_index is not nullptr, then the device will also be
+// created with a queue from a transfer-only queue family if there is one,
+// and *transfer_queue_index is set to that family. Otherwise it will be
+// 0xFFFFFFFF.
+// The physical devices are tried in the order of |device_selection|, see
+// GetPhysicalDevicesInSelectionOrder.
 // Note: They may be the same or different.
 VkDevice CreateDeviceForSwapchain(
     containers::Allocator* allocator, VkInstance* instance,
@@ -135,7 +170,10 @@ VkDevice CreateDeviceForSwapchain(
     bool try_to_find_separate_present_queue = false,
     uint32_t* aync_compute_queue_index = nullptr,
     uint32_t* sparse_binding_queue_index = nullptr,
-    bool use_host_query_reset = false, void* device_next = nullptr);
+    bool use_host_query_reset = false, void* device_next = nullptr,
+    uint32_t* transfer_queue_index = nullptr,
+    const char* device_selection = nullptr,
+    uint32_t* num_async_compute_queues = nullptr);
 
 // Creates a device capable of presenting to the given surface.
 // The device is created with the given extensions.
@@ -172,16 +210,40 @@ VkCommandBuffer CreateCommandBuffer(VkCommandPool* pool,
                                     VkCommandBufferLevel level,
                                     VkDevice* device);
 
+// Sets |mode| to the present mode called |name|, one of "fifo",
+// "fifo_relaxed", "mailbox" or "immediate". Returns false if there is no
+// such mode.
+bool GetPresentModeFromName(const char* name, VkPresentModeKHR* mode);
+
 // Creates a swapchain with a default layout and number of images.
 // It will be able to be rendered to from graphics_queue_index,
 // and it will be presentable on present_queue_index.
+// In headless mode no swapchain is created, the returned VkSwapchainKHR is
+// VK_NULL_HANDLE and only describes the size and format of the images that
+// stand in for it.
+// The present mode is the one from data->present_mode() if the surface
+// supports it, FIFO if it does not, and the first one the surface reports
+// if no mode was asked for. The swapchain has data->swapchain_images()
+// images, clamped to what the surface allows, or one more than the surface
+// needs if no number was asked for.
+// If |old_swapchain| is not VK_NULL_HANDLE, it is retired by the new
+// swapchain, which may reuse its resources.
+// A non-zero |num_images_override| and a non-null |present_mode_override|
+// take the place of the ones from the command-line.
+// If the queue families differ, the images are shared between them with
+// |sharing_mode|. Exclusive images have to be transferred between the
+// families before and after rendering.
 VkSwapchainKHR CreateDefaultSwapchain(
     VkInstance* instance, VkDevice* device, VkSurfaceKHR* surface,
     containers::Allocator* allocator, uint32_t present_queue_index,
     uint32_t graphics_queue_index, const entry::EntryData* data,
     VkColorSpaceKHR swapchain_color_space = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
     bool use_shared_presentation = false, VkSwapchainCreateFlagsKHR flags = 0,
-    bool use_10bit_hdr = false, const void* extensions = nullptr);
+    bool use_10bit_hdr = false, const void* extensions = nullptr,
+    ::VkSwapchainKHR old_swapchain = VK_NULL_HANDLE,
+    uint32_t num_images_override = 0,
+    const char* present_mode_override = nullptr,
+    VkSharingMode sharing_mode = VK_SHARING_MODE_CONCURRENT);
 
 // Returns a uint32_t with only the lowest bit set.
 uint32_t inline GetLSB(uint32_t val) { return ((val - 1) ^ val) & val; }
@@ -196,12 +258,14 @@ VkImage CreateDefault2DColorImage(VkDevice* device, uint32_t width,
 
 // Creates a default sampler with normalized coordinates. magFilter, minFilter,
 // and mipmap are all using nearest mode. Addressing modes for U, V, and W
-// coordinates are all clamp-to-edge. mipLodBias, minLod, and maxLod are all 0.
+// coordinates are all clamp-to-edge. mipLodBias and minLod are 0, and maxLod
+// is VK_LOD_CLAMP_NONE so that every mip level can be sampled.
 // anisotropy and compare is disabled.
 VkSampler CreateDefaultSampler(VkDevice* device);
 
 // Creates a default sampler as above, but with the specified minFilter,
-// magFilter, addressModes, and extension.
+// magFilter, addressModes, and extension. If an extension is given, maxLod is
+// 0.
 VkSampler CreateSampler(
     VkDevice* device, VkFilter minFilter, VkFilter magFilter,
     VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
@@ -209,6 +273,15 @@ VkSampler CreateSampler(
     VkSamplerAddressMode addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
     void* extension = nullptr);
 
+// Returns the create info that CreateSampler creates its sampler from, for
+// VulkanApplication::GetSampler.
+VkSamplerCreateInfo GetSamplerCreateInfo(
+    VkFilter minFilter, VkFilter magFilter,
+    VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    VkSamplerAddressMode addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    VkSamplerAddressMode addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    void* extension = nullptr);
+
 // Creates a DescriptorSetLayout with the given set of layouts.
 VkDescriptorSetLayout CreateDescriptorSetLayout(
     containers::Allocator* allocator, VkDevice* device,
@@ -264,11 +337,40 @@ VkQueue inline GetQueue(VkDevice* device, uint32_t queue_family_index,
   return VkQueue(queue, device, queue_family_index);
 }
 
-// Creates a default pipeline cache, it does not load anything from disk.
+// Returns the file that the pipeline cache of |device| is automatically
+// saved to for the path |prefix|. It is unique to the vendor, device,
+// driver version and pipeline cache UUID, so that caches from other drivers
+// are never loaded.
+std::string GetPipelineCachePath(VkDevice* device, const char* prefix);
+
+// Returns the file that the pipeline corpus is saved to for the path
+// |prefix|. The corpus only holds SPIR-V and pipeline state, so unlike the
+// cache it is shared between devices and drivers.
+std::string GetPipelineCorpusPath(const char* prefix);
+
+// Creates a default pipeline cache. It is initialized from the file given
+// with -load-pipeline-cache, or else from the automatic cache file if
+// -pipeline-cache-dir was given, unless the file was written for a
+// different device or driver.
 VkPipelineCache CreateDefaultPipelineCache(VkDevice* device,
     const entry::EntryData* entry_data);
 
-// Writes the given pipeline cache to the given file.
+// Creates the same pipeline cache as CreateDefaultPipelineCache, and hands
+// it to |cache|, which must not hold one yet. This may run on another
+// thread, while the device is used for something else.
+void LoadDefaultPipelineCache(VkDevice* device,
+                              const entry::EntryData* entry_data,
+                              VkPipelineCache* cache);
+
+// Writes |size| bytes of |data| to a temporary file next to |location|, and
+// then moves it over |location|, so that an interrupted run never leaves a
+// truncated file behind. Failures are logged to |log|, and return false.
+bool WriteFileAtomically(logging::Logger* log, const char* location,
+                         const void* data, size_t size);
+
+// Writes the given pipeline cache to the given file, as a run-length
+// encoded asset file that CreateDefaultPipelineCache maps back in. The file
+// is replaced atomically, failures are logged but not fatal.
 void WritePipelineCache(VkDevice* device, VkPipelineCache* cache,
     const char* location);
 
@@ -310,10 +412,50 @@ uint32_t inline GetMemoryIndex(VkDevice* device, logging::Logger* log,
   return memory_index;
 }
 
+// Given a bitmask of required_index_bits, returns the memory index from the
+// given device that supports all of the required_property_flags and as many
+// of the preferred_property_flags as possible. Of the indices that match
+// equally well, the first one is returned.
+// Will assert if one could not be found.
+uint32_t inline GetPreferredMemoryIndex(
+    VkDevice* device, logging::Logger* log, uint32_t required_index_bits,
+    VkMemoryPropertyFlags required_property_flags,
+    VkMemoryPropertyFlags preferred_property_flags) {
+  const VkPhysicalDeviceMemoryProperties& properties =
+      device->physical_device_memory_properties();
+  LOG_ASSERT(<=, log, properties.memoryTypeCount, uint32_t(32));
+  uint32_t best_index = properties.memoryTypeCount;
+  uint32_t best_score = 0;
+  for (uint32_t memory_index = 0; memory_index < properties.memoryTypeCount;
+       ++memory_index) {
+    if (!(required_index_bits & (1 << memory_index))) {
+      continue;
+    }
+    const VkMemoryPropertyFlags flags =
+        properties.memoryTypes[memory_index].propertyFlags;
+    if ((flags & required_property_flags) != required_property_flags) {
+      continue;
+    }
+    uint32_t score = 0;
+    for (VkMemoryPropertyFlags preferred = flags & preferred_property_flags;
+         preferred != 0; preferred &= preferred - 1) {
+      ++score;
+    }
+    if (best_index == properties.memoryTypeCount || score > best_score) {
+      best_index = memory_index;
+      best_score = score;
+    }
+  }
+  LOG_ASSERT(!=, log, best_index, properties.memoryTypeCount);
+  return best_index;
+}
+
 // Records a pipeline barrier to the given command buffer |cmd_buf| to change
 // the layout of the given |image| with the specified |subresource_range| from
 // |old_layout| with access mask |src_access_mask| to |new_layout| with access
 // mask |dst_access_mask| through the given command buffer |cmd_buffer|.
+// The barrier is queued, and merged with the other queued barriers before the
+// next command.
 void RecordImageLayoutTransition(
     ::VkImage image, const VkImageSubresourceRange& subresource_range,
     VkImageLayout old_layout, VkAccessFlags src_access_mask,
@@ -391,6 +533,12 @@ inline VkEvent CreateEvent(VkDevice* device) {
 // format is not recognized.
 size_t GetImageExtentSizeInBytes(const VkExtent3D& extent, VkFormat format);
 
+// Converts |value| to a half float, rounding to the nearest even value.
+uint16_t FloatToHalf(float value);
+
+// Converts the half float |value| to a float, which is exact.
+float HalfToFloat(uint16_t value);
+
 // Returns true if all the request features are supported by the given physical
 // device, otherwise returns false. The supported features are returned from
 // Vulkan command vkGetPhysicalDeviceFeatures, the command is resolved by the
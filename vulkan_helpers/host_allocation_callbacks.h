@@ -0,0 +1,321 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_HOST_ALLOCATION_CALLBACKS_H
+#define VULKAN_HELPERS_HOST_ALLOCATION_CALLBACKS_H
+
+#include "support/containers/allocator.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/vulkan_header_wrapper.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+namespace vulkan {
+
+// HostAllocationCallbacks routes the host memory allocations of the driver
+// to a containers::Allocator, and counts them per VkSystemAllocationScope.
+// Pass callbacks() as the pAllocator of the objects to measure, and to their
+// destruction, e.g. through a VkSubObject.
+//
+// If |pool_command_scope| is true, allocations of
+// VK_SYSTEM_ALLOCATION_SCOPE_COMMAND, which drivers make while commands are
+// recorded, are served from per size class free lists instead, and freed
+// blocks are kept for the next allocation of their size class. They are
+// only given back to the allocator when this is destroyed.
+//
+// This has to outlive every object that was created with its callbacks.
+class HostAllocationCallbacks {
+ public:
+  // The number of VkSystemAllocationScopes.
+  static const size_t kNumScopes = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+  struct ScopeStatistics {
+    std::atomic<uint64_t> num_allocations;
+    std::atomic<uint64_t> num_reallocations;
+    std::atomic<uint64_t> num_frees;
+    // Allocations that were served from the free lists.
+    std::atomic<uint64_t> num_pooled;
+    // The bytes that the driver asked for and did not free yet, and the
+    // most there ever were.
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> peak_bytes;
+    // The bytes that the driver allocated itself, and notified us of.
+    std::atomic<uint64_t> internal_bytes;
+  };
+
+  HostAllocationCallbacks(containers::Allocator* allocator,
+                          bool pool_command_scope)
+      : allocator_(allocator), pool_command_scope_(pool_command_scope) {
+    callbacks_.pUserData = this;
+    callbacks_.pfnAllocation = &Allocation;
+    callbacks_.pfnReallocation = &Reallocation;
+    callbacks_.pfnFree = &Free;
+    callbacks_.pfnInternalAllocation = &InternalAllocation;
+    callbacks_.pfnInternalFree = &InternalFree;
+    for (size_t i = 0; i < kNumScopes; ++i) {
+      ScopeStatistics& statistics = statistics_[i];
+      statistics.num_allocations.store(0);
+      statistics.num_reallocations.store(0);
+      statistics.num_frees.store(0);
+      statistics.num_pooled.store(0);
+      statistics.bytes.store(0);
+      statistics.peak_bytes.store(0);
+      statistics.internal_bytes.store(0);
+    }
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+      free_lists_[i] = nullptr;
+    }
+  }
+
+  ~HostAllocationCallbacks() {
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+      while (free_lists_[i]) {
+        Header* header = GetHeader(free_lists_[i]);
+        free_lists_[i] = header->next_free;
+        allocator_->free(header->base, header->total_size);
+      }
+    }
+  }
+
+  HostAllocationCallbacks(const HostAllocationCallbacks&) = delete;
+  HostAllocationCallbacks& operator=(const HostAllocationCallbacks&) = delete;
+
+  const VkAllocationCallbacks* callbacks() const { return &callbacks_; }
+
+  const ScopeStatistics& statistics(VkSystemAllocationScope scope) const {
+    return statistics_[scope];
+  }
+
+  // Logs one line for every scope that the driver allocated memory in.
+  void LogStatistics(const char* prefix, logging::Logger* log) const {
+    static const char* const kScopeNames[kNumScopes] = {
+        "command", "object", "cache", "device", "instance"};
+    for (size_t i = 0; i < kNumScopes; ++i) {
+      const ScopeStatistics& statistics = statistics_[i];
+      if (statistics.num_allocations.load() == 0 &&
+          statistics.internal_bytes.load() == 0) {
+        continue;
+      }
+      log->LogInfo(prefix, " scope=", kScopeNames[i],
+                   " allocations=", statistics.num_allocations.load(),
+                   " reallocations=", statistics.num_reallocations.load(),
+                   " frees=", statistics.num_frees.load(),
+                   " pooled=", statistics.num_pooled.load(),
+                   " bytes=", statistics.bytes.load(),
+                   " peak_bytes=", statistics.peak_bytes.load(),
+                   " internal_bytes=", statistics.internal_bytes.load());
+    }
+  }
+
+ private:
+  // Every block starts with a header, right before the memory that the
+  // driver gets, which is aligned to at least kMinAlignment.
+  struct Header {
+    // What was allocated from allocator_.
+    void* base;
+    size_t total_size;
+    // What the driver asked for.
+    size_t size;
+    uint32_t scope;
+    // The size class of a pooled block, or -1.
+    int32_t size_class;
+    // The next block in the free list of a pooled block that is free.
+    void* next_free;
+  };
+  static const size_t kMinAlignment = 16;
+  static const size_t kHeaderSize = 48;
+  static_assert(sizeof(Header) <= kHeaderSize,
+                "The header does not fit in front of the memory.");
+  // The size classes of the pooled blocks are kMinPooledSize << i, and all of
+  // them are aligned to kPooledAlignment.
+  static const size_t kNumSizeClasses = 11;
+  static const size_t kMinPooledSize = 64;
+  static const size_t kPooledAlignment = 64;
+
+  static Header* GetHeader(void* memory) {
+    return reinterpret_cast<Header*>(static_cast<char*>(memory) -
+                                     kHeaderSize);
+  }
+
+  // Returns the smallest size class that fits |size|, or -1 if none does.
+  static int32_t GetSizeClass(size_t size) {
+    size_t class_size = kMinPooledSize;
+    for (int32_t i = 0; i < static_cast<int32_t>(kNumSizeClasses); ++i) {
+      if (size <= class_size) {
+        return i;
+      }
+      class_size *= 2;
+    }
+    return -1;
+  }
+
+  void* Allocate(size_t size, size_t alignment,
+                 VkSystemAllocationScope scope) {
+    if (size == 0) {
+      return nullptr;
+    }
+    if (alignment < kMinAlignment) {
+      alignment = kMinAlignment;
+    }
+    int32_t size_class = -1;
+    if (pool_command_scope_ && scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND &&
+        alignment <= kPooledAlignment) {
+      size_class = GetSizeClass(size);
+    }
+
+    void* memory = nullptr;
+    if (size_class >= 0) {
+      alignment = kPooledAlignment;
+      std::lock_guard<std::mutex> lock(free_lists_mutex_);
+      memory = free_lists_[size_class];
+      if (memory) {
+        free_lists_[size_class] = GetHeader(memory)->next_free;
+      }
+    }
+    if (memory) {
+      statistics_[scope].num_pooled.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      const size_t capacity =
+          size_class >= 0 ? kMinPooledSize << size_class : size;
+      const size_t total_size = capacity + alignment + kHeaderSize;
+      char* base = static_cast<char*>(allocator_->malloc(total_size));
+      if (!base) {
+        return nullptr;
+      }
+      memory = reinterpret_cast<void*>(
+          (reinterpret_cast<uintptr_t>(base) + kHeaderSize + alignment - 1) &
+          ~static_cast<uintptr_t>(alignment - 1));
+      Header* header = GetHeader(memory);
+      header->base = base;
+      header->total_size = total_size;
+      header->size_class = size_class;
+    }
+    Header* header = GetHeader(memory);
+    header->size = size;
+    header->scope = scope;
+    header->next_free = nullptr;
+
+    ScopeStatistics& statistics = statistics_[scope];
+    statistics.num_allocations.fetch_add(1, std::memory_order_relaxed);
+    AddBytes(&statistics, size);
+    return memory;
+  }
+
+  void* Reallocate(void* original, size_t size, size_t alignment,
+                   VkSystemAllocationScope scope) {
+    if (!original) {
+      return Allocate(size, alignment, scope);
+    }
+    if (size == 0) {
+      Release(original);
+      return nullptr;
+    }
+    Header* header = GetHeader(original);
+    statistics_[header->scope].num_reallocations.fetch_add(
+        1, std::memory_order_relaxed);
+    // A pooled block may already be large enough.
+    if (header->size_class >= 0 && header->scope == scope &&
+        size <= kMinPooledSize << header->size_class) {
+      statistics_[scope].bytes.fetch_sub(header->size,
+                                         std::memory_order_relaxed);
+      AddBytes(&statistics_[scope], size);
+      header->size = size;
+      return original;
+    }
+    void* memory = Allocate(size, alignment, scope);
+    if (!memory) {
+      return nullptr;
+    }
+    memcpy(memory, original, header->size < size ? header->size : size);
+    Release(original);
+    return memory;
+  }
+
+  void Release(void* memory) {
+    if (!memory) {
+      return;
+    }
+    Header* header = GetHeader(memory);
+    ScopeStatistics& statistics = statistics_[header->scope];
+    statistics.num_frees.fetch_add(1, std::memory_order_relaxed);
+    statistics.bytes.fetch_sub(header->size, std::memory_order_relaxed);
+    if (header->size_class >= 0) {
+      std::lock_guard<std::mutex> lock(free_lists_mutex_);
+      header->next_free = free_lists_[header->size_class];
+      free_lists_[header->size_class] = memory;
+      return;
+    }
+    allocator_->free(header->base, header->total_size);
+  }
+
+  static void AddBytes(ScopeStatistics* statistics, size_t size) {
+    const uint64_t bytes =
+        statistics->bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = statistics->peak_bytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !statistics->peak_bytes.compare_exchange_weak(
+                               peak, bytes, std::memory_order_relaxed)) {
+    }
+  }
+
+  static VKAPI_ATTR void* VKAPI_CALL Allocation(
+      void* user_data, size_t size, size_t alignment,
+      VkSystemAllocationScope scope) {
+    return static_cast<HostAllocationCallbacks*>(user_data)->Allocate(
+        size, alignment, scope);
+  }
+
+  static VKAPI_ATTR void* VKAPI_CALL Reallocation(
+      void* user_data, void* original, size_t size, size_t alignment,
+      VkSystemAllocationScope scope) {
+    return static_cast<HostAllocationCallbacks*>(user_data)->Reallocate(
+        original, size, alignment, scope);
+  }
+
+  static VKAPI_ATTR void VKAPI_CALL Free(void* user_data, void* memory) {
+    static_cast<HostAllocationCallbacks*>(user_data)->Release(memory);
+  }
+
+  static VKAPI_ATTR void VKAPI_CALL InternalAllocation(
+      void* user_data, size_t size, VkInternalAllocationType,
+      VkSystemAllocationScope scope) {
+    static_cast<HostAllocationCallbacks*>(user_data)
+        ->statistics_[scope]
+        .internal_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  static VKAPI_ATTR void VKAPI_CALL InternalFree(
+      void* user_data, size_t size, VkInternalAllocationType,
+      VkSystemAllocationScope scope) {
+    static_cast<HostAllocationCallbacks*>(user_data)
+        ->statistics_[scope]
+        .internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+  }
+
+  containers::Allocator* allocator_;
+  const bool pool_command_scope_;
+  VkAllocationCallbacks callbacks_;
+  ScopeStatistics statistics_[kNumScopes];
+  std::mutex free_lists_mutex_;
+  // Guarded by free_lists_mutex_, the free pooled blocks of every size
+  // class, linked through their headers.
+  void* free_lists_[kNumSizeClasses];
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_HOST_ALLOCATION_CALLBACKS_H
@@ -0,0 +1,134 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/host_copy.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HOST_COPY_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HOST_COPY_NEON
+#endif
+
+namespace {
+// The size of a cache line, and so of the bursts that write-combining
+// buffers write out.
+const size_t kLineSize = 64;
+// How much every job copies at least. Smaller parts cost more to hand out
+// than they save.
+const size_t kParallelCopyGrain = 1024 * 1024;
+
+// Copies |num_lines| lines to |dst|, which is kLineSize aligned.
+#if defined(HOST_COPY_SSE2)
+inline void CopyLines(uint8_t* dst, const uint8_t* src, size_t num_lines) {
+  for (size_t i = 0; i < num_lines; ++i, dst += kLineSize, src += kLineSize) {
+    const __m128i* s = reinterpret_cast<const __m128i*>(src);
+    __m128i* d = reinterpret_cast<__m128i*>(dst);
+    const __m128i a = _mm_loadu_si128(s);
+    const __m128i b = _mm_loadu_si128(s + 1);
+    const __m128i c = _mm_loadu_si128(s + 2);
+    const __m128i e = _mm_loadu_si128(s + 3);
+    _mm_stream_si128(d, a);
+    _mm_stream_si128(d + 1, b);
+    _mm_stream_si128(d + 2, c);
+    _mm_stream_si128(d + 3, e);
+  }
+}
+// Non-temporal stores are weakly ordered, they have to be visible before
+// anything is submitted that reads them.
+inline void FenceStores() { _mm_sfence(); }
+#elif defined(HOST_COPY_NEON)
+// NEON has no non-temporal stores in its intrinsics, but writing whole
+// lines in order is what lets write-combining merge them.
+inline void CopyLines(uint8_t* dst, const uint8_t* src, size_t num_lines) {
+  for (size_t i = 0; i < num_lines; ++i, dst += kLineSize, src += kLineSize) {
+    const uint8x16_t a = vld1q_u8(src);
+    const uint8x16_t b = vld1q_u8(src + 16);
+    const uint8x16_t c = vld1q_u8(src + 32);
+    const uint8x16_t e = vld1q_u8(src + 48);
+    vst1q_u8(dst, a);
+    vst1q_u8(dst + 16, b);
+    vst1q_u8(dst + 32, c);
+    vst1q_u8(dst + 48, e);
+  }
+}
+inline void FenceStores() {}
+#else
+inline void CopyLines(uint8_t* dst, const uint8_t* src, size_t num_lines) {
+  memcpy(dst, src, num_lines * kLineSize);
+}
+inline void FenceStores() {}
+#endif
+
+// Copies everything but fences nothing, so that the parts of a parallel
+// copy only fence once.
+void CopyUnfenced(uint8_t* dst, const uint8_t* src, size_t size) {
+  // The partial lines at both ends are written with plain stores.
+  const size_t head =
+      (kLineSize - reinterpret_cast<uintptr_t>(dst) % kLineSize) % kLineSize;
+  if (size < head + kLineSize) {
+    memcpy(dst, src, size);
+    return;
+  }
+  memcpy(dst, src, head);
+  const size_t num_lines = (size - head) / kLineSize;
+  CopyLines(dst + head, src + head, num_lines);
+  const size_t done = head + num_lines * kLineSize;
+  memcpy(dst + done, src + done, size - done);
+}
+}  // anonymous namespace
+
+namespace vulkan {
+
+void StreamToMappedMemory(void* dst, const void* src, size_t size) {
+  CopyUnfenced(static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src),
+               size);
+  FenceStores();
+}
+
+void CopyToMappedMemory(jobs::JobSystem* job_system, void* dst,
+                        const void* src, size_t size) {
+  if (!job_system || job_system->num_threads() == 1 ||
+      size < 2 * kParallelCopyGrain) {
+    StreamToMappedMemory(dst, src, size);
+    return;
+  }
+  uint8_t* d = static_cast<uint8_t*>(dst);
+  const uint8_t* s = static_cast<const uint8_t*>(src);
+  // The parts are split on the lines of |dst|, so that no line is written
+  // by two threads.
+  const size_t head =
+      (kLineSize - reinterpret_cast<uintptr_t>(dst) % kLineSize) % kLineSize;
+  const size_t num_lines = (size - head + kLineSize - 1) / kLineSize;
+  auto line_offset = [head, size](size_t line) {
+    const size_t offset = line ? head + line * kLineSize : 0;
+    return offset < size ? offset : size;
+  };
+  job_system->ParallelFor(
+      0, num_lines, kParallelCopyGrain / kLineSize,
+      [d, s, &line_offset](size_t begin, size_t end) {
+        const size_t offset = line_offset(begin);
+        CopyUnfenced(d + offset, s + offset, line_offset(end) - offset);
+        // Every thread fences its own stores.
+        FenceStores();
+      });
+}
+
+}  // namespace vulkan
@@ -0,0 +1,44 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_HOST_COPY_H
+#define VULKAN_HELPERS_HOST_COPY_H
+
+#include "support/jobs/job_system.h"
+
+#include <cstddef>
+
+namespace vulkan {
+
+// Copies |size| bytes from |src| to |dst|, where |dst| is mapped device
+// memory. Host-visible memory that is not HOST_CACHED is usually mapped
+// write-combined, where reads are uncached and partial cache lines are
+// written back one at a time, so the copy only writes |dst|, in whole
+// cache lines, with non-temporal stores where the CPU has them. That also
+// keeps data that is only ever read by the device out of the caches. The
+// stores are fenced before this returns, so |dst| can be flushed and
+// submitted right after.
+void StreamToMappedMemory(void* dst, const void* src, size_t size);
+
+// Like StreamToMappedMemory, but copies of more than a few MiB are split
+// across |job_system|, as one core can not keep up with the bandwidth of
+// the memory. |job_system| may be nullptr, the copy is then done on the
+// calling thread.
+void CopyToMappedMemory(jobs::JobSystem* job_system, void* dst,
+                        const void* src, size_t size);
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_HOST_COPY_H
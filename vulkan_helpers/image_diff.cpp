@@ -0,0 +1,248 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/image_diff.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_DIFF_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMAGE_DIFF_NEON
+#endif
+
+namespace {
+// The operations on 16 bytes, i.e. 4 pixels, that the comparison needs, so
+// that it is only written once.
+#if defined(IMAGE_DIFF_SSE2)
+using Byte16 = __m128i;
+inline Byte16 Load(const uint8_t* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+inline void Store(uint8_t* p, Byte16 v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+inline Byte16 AbsDiff(Byte16 a, Byte16 b) {
+  return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+inline Byte16 Max(Byte16 a, Byte16 b) { return _mm_max_epu8(a, b); }
+// Every byte of a - b, or 0 where b is larger.
+inline Byte16 SubSaturate(Byte16 a, Byte16 b) { return _mm_subs_epu8(a, b); }
+// Returns a bit per pixel, that is set if any of its bytes is not 0.
+inline uint32_t NonZeroPixels(Byte16 v) {
+  const int zero = _mm_movemask_ps(
+      _mm_castsi128_ps(_mm_cmpeq_epi32(v, _mm_setzero_si128())));
+  return ~static_cast<uint32_t>(zero) & 0xF;
+}
+#elif defined(IMAGE_DIFF_NEON)
+using Byte16 = uint8x16_t;
+inline Byte16 Load(const uint8_t* p) { return vld1q_u8(p); }
+inline void Store(uint8_t* p, Byte16 v) { vst1q_u8(p, v); }
+inline Byte16 AbsDiff(Byte16 a, Byte16 b) { return vabdq_u8(a, b); }
+inline Byte16 Max(Byte16 a, Byte16 b) { return vmaxq_u8(a, b); }
+inline Byte16 SubSaturate(Byte16 a, Byte16 b) { return vqsubq_u8(a, b); }
+inline uint32_t NonZeroPixels(Byte16 v) {
+  const uint32x4_t pixels = vreinterpretq_u32_u8(v);
+  uint32_t lanes[4];
+  vst1q_u32(lanes, vtstq_u32(pixels, pixels));
+  return (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+}
+#else
+struct Byte16 {
+  uint8_t v[16];
+};
+inline Byte16 Load(const uint8_t* p) {
+  Byte16 r;
+  memcpy(r.v, p, sizeof(r.v));
+  return r;
+}
+inline void Store(uint8_t* p, Byte16 v) { memcpy(p, v.v, sizeof(v.v)); }
+inline Byte16 AbsDiff(Byte16 a, Byte16 b) {
+  Byte16 r;
+  for (size_t i = 0; i < 16; ++i) {
+    r.v[i] = static_cast<uint8_t>(a.v[i] > b.v[i] ? a.v[i] - b.v[i]
+                                                  : b.v[i] - a.v[i]);
+  }
+  return r;
+}
+inline Byte16 Max(Byte16 a, Byte16 b) {
+  Byte16 r;
+  for (size_t i = 0; i < 16; ++i) {
+    r.v[i] = std::max(a.v[i], b.v[i]);
+  }
+  return r;
+}
+inline Byte16 SubSaturate(Byte16 a, Byte16 b) {
+  Byte16 r;
+  for (size_t i = 0; i < 16; ++i) {
+    r.v[i] = static_cast<uint8_t>(a.v[i] > b.v[i] ? a.v[i] - b.v[i] : 0);
+  }
+  return r;
+}
+inline uint32_t NonZeroPixels(Byte16 v) {
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    uint32_t pixel;
+    memcpy(&pixel, v.v + 4 * i, sizeof(pixel));
+    mask |= pixel ? 1u << i : 0u;
+  }
+  return mask;
+}
+#endif
+
+inline uint32_t CountBits4(uint32_t mask) {
+  return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + (mask >> 3);
+}
+
+// This must match the heatmap of image_diff/image_diff.comp.
+inline void WriteHeatmapPixel(uint8_t* pixel, uint8_t difference,
+                              bool different) {
+  if (different) {
+    pixel[0] = static_cast<uint8_t>(128 + difference / 2);
+    pixel[1] = 0;
+    pixel[2] = 0;
+  } else {
+    pixel[0] = difference;
+    pixel[1] = difference;
+    pixel[2] = difference;
+  }
+  pixel[3] = 255;
+}
+
+inline uint32_t Luma(const uint8_t* pixel) {
+  return (77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8;
+}
+
+const uint32_t kSsimBlockSize = 8;
+}  // anonymous namespace
+
+namespace vulkan {
+
+ImageDiffResult CompareImages(const uint8_t* actual, const uint8_t* expected,
+                              uint32_t width, uint32_t height,
+                              size_t row_pitch, const uint8_t tolerance[4],
+                              uint8_t* heatmap) {
+  ImageDiffResult result = {};
+  result.num_pixels = static_cast<uint64_t>(width) * height;
+  uint8_t tolerances[16];
+  for (size_t i = 0; i < 16; ++i) {
+    tolerances[i] = tolerance[i % 4];
+  }
+  const Byte16 tolerance16 = Load(tolerances);
+  Byte16 max16 = AbsDiff(tolerance16, tolerance16);
+  const uint32_t vector_width = width & ~3u;
+
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t* a = actual + y * row_pitch;
+    const uint8_t* e = expected + y * row_pitch;
+    uint8_t* h = heatmap ? heatmap + static_cast<size_t>(y) * width * 4
+                         : nullptr;
+    uint32_t x = 0;
+    for (; x < vector_width; x += 4) {
+      const Byte16 difference = AbsDiff(Load(a + 4 * x), Load(e + 4 * x));
+      max16 = Max(max16, difference);
+      const uint32_t different =
+          NonZeroPixels(SubSaturate(difference, tolerance16));
+      result.num_different_pixels += CountBits4(different);
+      if (h) {
+        uint8_t differences[16];
+        Store(differences, difference);
+        for (uint32_t i = 0; i < 4; ++i) {
+          const uint8_t* d = differences + 4 * i;
+          WriteHeatmapPixel(h + 4 * (x + i),
+                            std::max(std::max(d[0], d[1]),
+                                     std::max(d[2], d[3])),
+                            (different >> i) & 1);
+        }
+      }
+    }
+    // The last pixels of rows that are not a multiple of 4 wide.
+    for (; x < width; ++x) {
+      uint8_t largest = 0;
+      bool different = false;
+      for (uint32_t c = 0; c < 4; ++c) {
+        const uint8_t av = a[4 * x + c];
+        const uint8_t ev = e[4 * x + c];
+        const uint8_t d = static_cast<uint8_t>(av > ev ? av - ev : ev - av);
+        result.max_difference[c] = std::max(result.max_difference[c], d);
+        largest = std::max(largest, d);
+        different = different || d > tolerance[c];
+      }
+      result.num_different_pixels += different ? 1 : 0;
+      if (h) {
+        WriteHeatmapPixel(h + 4 * x, largest, different);
+      }
+    }
+  }
+  uint8_t maxima[16];
+  Store(maxima, max16);
+  for (size_t i = 0; i < 16; ++i) {
+    result.max_difference[i % 4] =
+        std::max(result.max_difference[i % 4], maxima[i]);
+  }
+
+  // The usual constants for 8-bit values, (0.01 * 255)^2 and
+  // (0.03 * 255)^2.
+  const double c1 = 6.5025;
+  const double c2 = 58.5225;
+  double ssim_sum = 0.0;
+  uint64_t num_blocks = 0;
+  result.min_ssim = 1.0f;
+  for (uint32_t by = 0; by < height; by += kSsimBlockSize) {
+    const uint32_t block_height = std::min(kSsimBlockSize, height - by);
+    for (uint32_t bx = 0; bx < width; bx += kSsimBlockSize) {
+      const uint32_t block_width = std::min(kSsimBlockSize, width - bx);
+      uint32_t sum_a = 0;
+      uint32_t sum_e = 0;
+      uint32_t sum_aa = 0;
+      uint32_t sum_ee = 0;
+      uint32_t sum_ae = 0;
+      for (uint32_t y = by; y < by + block_height; ++y) {
+        const uint8_t* a = actual + y * row_pitch;
+        const uint8_t* e = expected + y * row_pitch;
+        for (uint32_t x = bx; x < bx + block_width; ++x) {
+          const uint32_t la = Luma(a + 4 * x);
+          const uint32_t le = Luma(e + 4 * x);
+          sum_a += la;
+          sum_e += le;
+          sum_aa += la * la;
+          sum_ee += le * le;
+          sum_ae += la * le;
+        }
+      }
+      const double n = static_cast<double>(block_width * block_height);
+      const double mean_a = sum_a / n;
+      const double mean_e = sum_e / n;
+      const double var_a = sum_aa / n - mean_a * mean_a;
+      const double var_e = sum_ee / n - mean_e * mean_e;
+      const double covariance = sum_ae / n - mean_a * mean_e;
+      const double ssim =
+          ((2.0 * mean_a * mean_e + c1) * (2.0 * covariance + c2)) /
+          ((mean_a * mean_a + mean_e * mean_e + c1) * (var_a + var_e + c2));
+      ssim_sum += ssim;
+      ++num_blocks;
+      result.min_ssim = std::min(result.min_ssim, static_cast<float>(ssim));
+    }
+  }
+  result.ssim =
+      num_blocks ? static_cast<float>(ssim_sum / num_blocks) : 1.0f;
+  return result;
+}
+
+}  // namespace vulkan
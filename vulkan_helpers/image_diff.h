@@ -0,0 +1,422 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_IMAGE_DIFF_H
+#define VULKAN_HELPERS_IMAGE_DIFF_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace vulkan {
+
+// How far an image is from the image that it is expected to be.
+struct ImageDiffResult {
+  uint64_t num_pixels;
+  // The pixels with at least one channel that differs by more than its
+  // tolerance.
+  uint64_t num_different_pixels;
+  // The largest difference of every channel.
+  uint8_t max_difference[4];
+  // The structural similarity of the luma of the images, from -1 to 1,
+  // where 1 is identical. It is computed on separate 8x8 blocks instead of a
+  // sliding window, which is enough to tell noise from missing geometry.
+  // |ssim| is the mean of the blocks and |min_ssim| the worst one.
+  float ssim;
+  float min_ssim;
+
+  // Whether at most |max_different_pixels| differ, and no block is less
+  // similar than |min_block_ssim|.
+  bool Matches(uint64_t max_different_pixels, float min_block_ssim) const {
+    return num_different_pixels <= max_different_pixels &&
+           min_ssim >= min_block_ssim;
+  }
+};
+
+// Compares two |width| by |height| images with 4 8-bit channels per pixel,
+// e.g. VK_FORMAT_R8G8B8A8_UNORM data from
+// VulkanApplication::DumpImageLayersData, where every row starts
+// |row_pitch| bytes after the one before. Channel i of a pixel differs if
+// it is more than |tolerance[i]| away from the expected one. The luma of
+// the SSIM assumes that the channels are in RGBA order.
+//
+// If |heatmap| is not nullptr, it gets width * height tightly packed RGBA
+// pixels: black where the images are identical, grey, as bright as the
+// largest difference of the pixel, where they are within the tolerance,
+// and red where they are not.
+ImageDiffResult CompareImages(const uint8_t* actual, const uint8_t* expected,
+                              uint32_t width, uint32_t height,
+                              size_t row_pitch, const uint8_t tolerance[4],
+                              uint8_t* heatmap);
+
+// GpuImageDiff compares images on the GPU, so that every frame of a run can
+// be checked against its expected image without reading it back, or writing
+// anything to disk. Only the number of different pixels, the largest
+// difference of every channel and the sum of the largest difference of
+// every pixel are copied back, and optionally a heatmap, like the one of
+// CompareImages(), is written to heatmap_image().
+//
+// The shader is shader_library/image_diff/image_diff.comp, which the
+// application compiles by adding shader_library to its SHADERS, e.g.
+//   uint32_t diff_shader[] =
+//   #include "image_diff/image_diff.comp.spv"
+//       ;
+//
+// Every pair of images that is compared is added once with
+// AddComparison(), and every frame records, outside of a render pass:
+//   diff.Compare(&cmd, comparison, frame_index, tolerance, false);
+// and once the frame's fence has signaled, reads diff.result(frame_index).
+//
+// The heatmap is shared by all comparisons, and the barriers that are
+// recorded order them on the GPU, so every comparison has to be submitted
+// to the same queue.
+class GpuImageDiff {
+ public:
+  // This must match local_size_x and local_size_y of
+  // image_diff/image_diff.comp.
+  static const uint32_t kGroupSize = 8;
+
+  // The results that the GPU copies back for every slot.
+  struct Result {
+    uint32_t num_different_pixels;
+    uint32_t max_difference[4];
+    // The sum, over every pixel, of its largest channel difference.
+    uint32_t sum_difference;
+  };
+
+  // Images of |width| by |height| are compared, and the results of up to
+  // |num_slots| comparisons, e.g. one per frame in flight, are kept at a
+  // time.
+  template <size_t S>
+  GpuImageDiff(VulkanApplication* application, uint32_t width,
+               uint32_t height, uint32_t num_slots, uint32_t (&shader)[S])
+      : GpuImageDiff(application, width, height, num_slots, shader, S) {}
+
+  GpuImageDiff(VulkanApplication* application, uint32_t width,
+               uint32_t height, uint32_t num_slots, uint32_t* shader,
+               size_t shader_words)
+      : application_(application),
+        width_(width),
+        height_(height),
+        num_slots_(num_slots),
+        heatmap_initialized_(false),
+        sets_(application->GetAllocator()) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,          // sType
+        nullptr,                                       // pNext
+        0,                                             // flags
+        sizeof(Result) * num_slots_,                   // size
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,        // usage
+        VK_SHARING_MODE_EXCLUSIVE,                     // sharingMode
+        0,                                             // queueFamilyIndexCount
+        nullptr                                        // pQueueFamilyIndices
+    };
+    results_ = application_->CreateAndBindReadbackBuffer(&create_info);
+
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        VK_FORMAT_R8G8B8A8_UNORM,             // format
+        {
+            width_,   // width
+            height_,  // height
+            1,        // depth
+        },            // extent
+        1,            // mipLevels
+        1,            // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,    // samples
+        VK_IMAGE_TILING_OPTIMAL,  // tiling
+        VK_IMAGE_USAGE_STORAGE_BIT |
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    heatmap_ = application_->CreateAndBindImage(&image_create_info);
+    heatmap_view_ = application_->CreateImageView(
+        heatmap_.get(), VK_IMAGE_VIEW_TYPE_2D,
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+    // Only texelFetch reads through the sampler.
+    sampler_ = containers::make_unique<VkSampler>(
+        allocator, CreateSampler(&application_->device(), VK_FILTER_NEAREST,
+                                 VK_FILTER_NEAREST));
+
+    // The actual and the expected image, the heatmap and the results.
+    for (uint32_t i = 0; i < 4; ++i) {
+      bindings_[i] = {
+          i,                                          // binding
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+          nullptr                                     // pImmutableSamplers
+      };
+    }
+    bindings_[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings_[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    VkPushConstantRange push_range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(DiffData)              // size
+    };
+    pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator,
+        application_->CreatePipelineLayout(
+            {{bindings_[0], bindings_[1], bindings_[2], bindings_[3]}},
+            {push_range}));
+    pipeline_ = containers::make_unique<VulkanComputePipeline>(
+        allocator, application_->CreateComputePipeline(
+                       pipeline_layout_.get(),
+                       VkShaderModuleCreateInfo{
+                           VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                           nullptr, 0, shader_words * sizeof(uint32_t),
+                           shader},
+                       "main"));
+  }
+
+  // Adds a pair of images to compare, and returns its index for Compare().
+  // Both views must be width by height, of a format with up to 4 8-bit
+  // unsigned normalized channels, and their images need
+  // VK_IMAGE_USAGE_SAMPLED_BIT. Whenever they are compared, they must be in
+  // |actual_layout| and |expected_layout|, and their contents must be
+  // visible to compute shaders.
+  size_t AddComparison(::VkImageView actual, VkImageLayout actual_layout,
+                       ::VkImageView expected,
+                       VkImageLayout expected_layout) {
+    sets_.push_back(containers::make_unique<DescriptorSet>(
+        application_->GetAllocator(),
+        application_->AllocateDescriptorSet(
+            {bindings_[0], bindings_[1], bindings_[2], bindings_[3]})));
+    const DescriptorSet& set = *sets_.back();
+    VkDescriptorImageInfo image_infos[3] = {
+        {
+            *sampler_,      // sampler
+            actual,         // imageView
+            actual_layout,  // imageLayout
+        },
+        {
+            *sampler_,        // sampler
+            expected,         // imageView
+            expected_layout,  // imageLayout
+        },
+        {
+            VK_NULL_HANDLE,           // sampler
+            *heatmap_view_,           // imageView
+            VK_IMAGE_LAYOUT_GENERAL,  // imageLayout
+        }};
+    VkDescriptorBufferInfo buffer_info = {
+        *results_,           // buffer
+        results_->offset(),  // offset
+        results_->size(),    // range
+    };
+    VkWriteDescriptorSet writes[3] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+            nullptr,                                    // pNext
+            set,                                        // dstSet
+            0,                                          // dstbinding
+            0,                                          // dstArrayElement
+            2,                                          // descriptorCount
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+            image_infos,                                // pImageInfo
+            nullptr,                                    // pBufferInfo
+            nullptr,                                    // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            set,                                     // dstSet
+            2,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,        // descriptorType
+            image_infos + 2,                         // pImageInfo
+            nullptr,                                 // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            set,                                     // dstSet
+            3,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            &buffer_info,                            // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+    application_->device()->vkUpdateDescriptorSets(application_->device(), 3,
+                                                   writes, 0, nullptr);
+    return sets_.size() - 1;
+  }
+
+  // Records the comparison of the images of |comparison| into |slot|, with
+  // the per channel |tolerance|. If |write_heatmap| is true, the heatmap is
+  // written too, and left in VK_IMAGE_LAYOUT_GENERAL, visible to transfers,
+  // e.g. for VulkanApplication::DumpImageLayersData. This must be recorded
+  // outside of a render pass, and result(slot) must not be read until the
+  // command buffer has finished.
+  void Compare(VkCommandBuffer* cmd, size_t comparison, uint32_t slot,
+               const uint8_t tolerance[4], bool write_heatmap) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    LOG_ASSERT(<, application_->GetLogger(), comparison, sets_.size());
+    LOG_ASSERT(<, application_->GetLogger(), slot, num_slots_);
+    const ::VkDeviceSize slot_offset =
+        results_->offset() + sizeof(Result) * slot;
+
+    // The host is done with the slot, since it waited for the command
+    // buffer that wrote it last.
+    cmdBuffer->vkCmdFillBuffer(cmdBuffer, *results_, slot_offset,
+                               sizeof(Result), 0);
+    VkBufferMemoryBarrier clear_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT |
+            VK_ACCESS_SHADER_WRITE_BIT,  // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,         // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,         // dstQueueFamilyIndex
+        *results_,                       // buffer
+        slot_offset,                     // offset
+        sizeof(Result),                  // size
+    };
+    // The heatmap is only written once every earlier read of it, and every
+    // earlier comparison that wrote it, is done.
+    VkImageMemoryBarrier heatmap_barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,              // srcAccessMask
+        VK_ACCESS_SHADER_WRITE_BIT,              // dstAccessMask
+        heatmap_initialized_ ? VK_IMAGE_LAYOUT_GENERAL
+                             : VK_IMAGE_LAYOUT_UNDEFINED,  // oldLayout
+        VK_IMAGE_LAYOUT_GENERAL,                           // newLayout
+        VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+        *heatmap_,                // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},  // subresourceRange
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+        &clear_barrier, write_heatmap || !heatmap_initialized_ ? 1 : 0,
+        &heatmap_barrier);
+    // The heatmap is bound even while it is not written.
+    heatmap_initialized_ = true;
+
+    DiffData data = {
+        {static_cast<int32_t>(width_),
+         static_cast<int32_t>(height_)},  // size
+        {tolerance[0], tolerance[1], tolerance[2],
+         tolerance[3]},                   // tolerance
+        slot,                             // slot
+        write_heatmap ? 1u : 0u,          // write_heatmap
+    };
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &sets_[comparison]->raw_set(), 0, nullptr);
+    cmdBuffer->vkCmdPushConstants(
+        cmdBuffer, ::VkPipelineLayout(*pipeline_layout_),
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(data), &data);
+    cmdBuffer->vkCmdDispatch(cmdBuffer,
+                             (width_ + kGroupSize - 1) / kGroupSize,
+                             (height_ + kGroupSize - 1) / kGroupSize, 1);
+
+    VkBufferMemoryBarrier result_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,               // srcAccessMask
+        VK_ACCESS_HOST_READ_BIT,                  // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *results_,                                // buffer
+        slot_offset,                              // offset
+        sizeof(Result),                           // size
+    };
+    VkImageMemoryBarrier read_barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        VK_ACCESS_SHADER_WRITE_BIT,              // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT,             // dstAccessMask
+        VK_IMAGE_LAYOUT_GENERAL,                 // oldLayout
+        VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        *heatmap_,                               // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},  // subresourceRange
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+        nullptr, 1, &result_barrier, write_heatmap ? 1 : 0, &read_barrier);
+  }
+
+  // The results of the last comparison into |slot|, once the command buffer
+  // that recorded it has finished.
+  Result result(uint32_t slot) {
+    LOG_ASSERT(<, application_->GetLogger(), slot, num_slots_);
+    results_->invalidate();
+    Result result;
+    memcpy(&result, results_->base_address() + sizeof(Result) * slot,
+           sizeof(result));
+    return result;
+  }
+
+  // The heatmap of the last comparison that wrote one.
+  VulkanApplication::Image* heatmap_image() const { return heatmap_.get(); }
+
+ private:
+  // This must match diff_data in image_diff/image_diff.comp.
+  struct DiffData {
+    int32_t size[2];
+    uint32_t tolerance[4];
+    uint32_t slot;
+    uint32_t write_heatmap;
+  };
+
+  VulkanApplication* application_;
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t num_slots_;
+  // Whether the heatmap left VK_IMAGE_LAYOUT_UNDEFINED.
+  bool heatmap_initialized_;
+
+  VkDescriptorSetLayoutBinding bindings_[4];
+  containers::unique_ptr<PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> pipeline_;
+  // The images of every comparison, the heatmap and the results.
+  containers::vector<containers::unique_ptr<DescriptorSet>> sets_;
+
+  containers::unique_ptr<VulkanApplication::Buffer> results_;
+  containers::unique_ptr<VulkanApplication::Image> heatmap_;
+  containers::unique_ptr<VkImageView> heatmap_view_;
+  containers::unique_ptr<VkSampler> sampler_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_IMAGE_DIFF_H
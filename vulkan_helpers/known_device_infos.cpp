@@ -15,8 +15,38 @@
 
 #include "vulkan_helpers/known_device_infos.h"
 
+#include <cstring>
+
 namespace vulkan {
 const DeviceInfo PixelC{0x10DE, 0x92BA03D7};
 const DeviceInfo NvidiaK2200{0x10DE, 0x13BA};
 const DeviceInfo Nvidia965M{0x10DE, 0x1427};
+
+namespace {
+struct NamedDeviceInfo {
+  const char* name;
+  DeviceInfo info;
+};
+
+const NamedDeviceInfo kNamedDeviceInfos[] = {
+    {"pixelc", PixelC},
+    {"k2200", NvidiaK2200},
+    {"965m", Nvidia965M},
+    {"amd", {0x1002, 0}},
+    {"arm", {0x13B5, 0}},
+    {"imgtec", {0x1010, 0}},
+    {"intel", {0x8086, 0}},
+    {"nvidia", {0x10DE, 0}},
+    {"qualcomm", {0x5143, 0}},
+};
+}  // anonymous namespace
+
+const DeviceInfo* FindKnownDeviceInfo(const char* name) {
+  for (const auto& named : kNamedDeviceInfos) {
+    if (strcmp(named.name, name) == 0) {
+      return &named.info;
+    }
+  }
+  return nullptr;
+}
 }  // namespace vulkan
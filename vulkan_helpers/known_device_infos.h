@@ -31,6 +31,10 @@ struct DeviceInfo {
 extern const DeviceInfo PixelC;
 extern const DeviceInfo NvidiaK2200;
 extern const DeviceInfo Nvidia965M;
+
+// Returns the device above, or the vendor, with the given name, e.g.
+// "k2200" or "nvidia", or nullptr. Vendors have a device_id of 0.
+const DeviceInfo* FindKnownDeviceInfo(const char* name);
 }
 
 namespace {
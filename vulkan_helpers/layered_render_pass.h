@@ -0,0 +1,386 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_LAYERED_RENDER_PASS_H_
+#define VULKAN_HELPERS_LAYERED_RENDER_PASS_H_
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/structure_chain.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace vulkan {
+
+// LayeredRenderPass renders one scene into every layer of a color and a
+// depth array image, e.g. the two eyes of a stereo pair or the six faces of
+// a cubemap, in one of three ways:
+//  - kMultiview begins one render pass with a view mask of every layer
+//    (VK_KHR_multiview). A draw is recorded once, and the vertex shader
+//    picks the transform of the view from gl_ViewIndex (GL_EXT_multiview).
+//  - kLayered is the fallback for devices without multiview. It begins one
+//    render pass with a framebuffer of every layer. A draw has an instance
+//    per view, and the vertex shader writes gl_Layer from gl_InstanceIndex,
+//    like viewport_index does with gl_ViewportIndex. The device needs
+//    VK_EXT_shader_viewport_index_layer.
+//  - kSeparate begins one render pass per layer, and the application draws
+//    the scene into each of them, which is what the others save.
+// The layers are left in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL.
+class LayeredRenderPass {
+ public:
+  enum class Mode { kSeparate, kMultiview, kLayered };
+
+  static const char* ModeName(Mode mode) {
+    switch (mode) {
+      case Mode::kSeparate:
+        return "separate";
+      case Mode::kMultiview:
+        return "multiview";
+      case Mode::kLayered:
+        return "layered";
+    }
+    return "unknown";
+  }
+
+  // Returns true if every name of the comma separated |names| is the
+  // ModeName of a mode. Otherwise sets |unknown| to the first one that is
+  // not, so that an application can reject it, rather than silently render
+  // with fewer modes than it was asked for.
+  static bool ModeNamesValid(const char* names, std::string* unknown) {
+    const Mode modes[] = {Mode::kSeparate, Mode::kMultiview, Mode::kLayered};
+    while (names) {
+      const char* end = strchr(names, ',');
+      const size_t length = end ? end - names : strlen(names);
+      bool known = false;
+      for (Mode mode : modes) {
+        const char* name = ModeName(mode);
+        known = known ||
+                (strlen(name) == length && strncmp(names, name, length) == 0);
+      }
+      if (!known) {
+        *unknown = std::string(names, length);
+        return false;
+      }
+      names = end ? end + 1 : nullptr;
+    }
+    return true;
+  }
+
+  // Returns true if the render passes of the device can have |num_views|
+  // views. The device needs VK_KHR_multiview, and the instance
+  // VK_KHR_get_physical_device_properties2. The multiview feature is
+  // required by the extension, but the application must still enable it
+  // with a VkPhysicalDeviceMultiviewFeatures in the pNext of the device.
+  static bool MultiviewSupported(VulkanApplication* application,
+                                 uint32_t num_views) {
+    StructureChain<VkPhysicalDeviceProperties2,
+                   VkPhysicalDeviceMultiviewProperties>
+        properties;
+    application->instance()->vkGetPhysicalDeviceProperties2KHR(
+        application->device().physical_device(), properties.head());
+    return properties.get<VkPhysicalDeviceMultiviewProperties>()
+               .maxMultiviewViewCount >= num_views;
+  }
+
+  // Returns the cheapest mode that the application enabled the extensions
+  // of: kMultiview if |multiview_enabled| and the device supports
+  // |num_views| views, otherwise kLayered if |layered_enabled|, otherwise
+  // kSeparate.
+  static Mode ChooseMode(VulkanApplication* application, uint32_t num_views,
+                         bool multiview_enabled, bool layered_enabled) {
+    if (multiview_enabled && MultiviewSupported(application, num_views)) {
+      return Mode::kMultiview;
+    }
+    return layered_enabled ? Mode::kLayered : Mode::kSeparate;
+  }
+
+  // Creates |num_views| layers of |width| by |height|, and the render
+  // passes and framebuffers of |mode| that clear and render into them.
+  LayeredRenderPass(VulkanApplication* application, Mode mode,
+                    uint32_t num_views, uint32_t width, uint32_t height,
+                    VkFormat color_format, VkFormat depth_format)
+      : application_(application),
+        mode_(mode),
+        num_views_(num_views),
+        width_(width),
+        height_(height),
+        views_(application->GetAllocator()),
+        framebuffers_(application->GetAllocator()) {
+    LOG_ASSERT(>, application_->GetLogger(), num_views_, 0u);
+    LOG_ASSERT(<=, application_->GetLogger(), num_views_, 32u);
+    color_image_ = CreateImage(
+        color_format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                          VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    depth_image_ =
+        CreateImage(depth_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    if (mode_ == Mode::kMultiview) {
+      CreateMultiviewRenderPass(color_format, depth_format);
+    } else {
+      CreateRenderPass(color_format, depth_format);
+    }
+
+    if (mode_ == Mode::kSeparate) {
+      // Every pass renders into a framebuffer of one layer.
+      for (uint32_t i = 0; i < num_views_; ++i) {
+        CreateFramebuffer(VK_IMAGE_VIEW_TYPE_2D, i, 1, 1);
+      }
+    } else {
+      // A multiview framebuffer has one layer, the view mask selects the
+      // layers of the views. A layered one has all of them.
+      CreateFramebuffer(VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, num_views_,
+                        mode_ == Mode::kLayered ? num_views_ : 1);
+    }
+  }
+
+  Mode mode() const { return mode_; }
+  uint32_t num_views() const { return num_views_; }
+
+  // The render passes that render every view: one per view for kSeparate,
+  // otherwise one.
+  uint32_t num_passes() const {
+    return mode_ == Mode::kSeparate ? num_views_ : 1;
+  }
+
+  // The instances that a draw of |instances| per view needs in a pass. In
+  // kLayered the view of an instance is gl_InstanceIndex % num_views(), so
+  // that the instances of one view are gl_InstanceIndex / num_views().
+  uint32_t instance_count(uint32_t instances) const {
+    return mode_ == Mode::kLayered ? instances * num_views_ : instances;
+  }
+
+  // The render pass that the pipelines of every pass are created with.
+  VkRenderPass& render_pass() { return *render_pass_; }
+  VulkanApplication::Image* color_image() { return color_image_.get(); }
+
+  // Begins pass |pass| of num_passes(), which clears its views to
+  // |clear_color| and a depth of 1. For kSeparate, |pass| is the view, and
+  // the application gives it to its shaders.
+  void Begin(VkCommandBuffer* cmd, uint32_t pass,
+             const VkClearColorValue& clear_color) {
+    LOG_ASSERT(<, application_->GetLogger(), pass, num_passes());
+    VkClearValue clear_values[2];
+    clear_values[0].color = clear_color;
+    clear_values[1].depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *framebuffers_[pass],                      // framebuffer
+        {{0, 0}, {width_, height_}},               // renderArea
+        2,                                         // clearValueCount
+        clear_values                               // pClearValues
+    };
+    (*cmd)->vkCmdBeginRenderPass(*cmd, &begin_info,
+                                 VK_SUBPASS_CONTENTS_INLINE);
+  }
+
+  void End(VkCommandBuffer* cmd) { (*cmd)->vkCmdEndRenderPass(*cmd); }
+
+ private:
+  static const VkImageLayout kDepthLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  containers::unique_ptr<VulkanApplication::Image> CreateImage(
+      VkFormat format, VkImageUsageFlags usage) {
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        format,                               // format
+        {width_, height_, 1},                 // extent
+        1,                                    // mipLevels
+        num_views_,                           // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                // samples
+        VK_IMAGE_TILING_OPTIMAL,              // tiling
+        usage,                                // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    return application_->CreateAndBindImage(&image_create_info);
+  }
+
+  void CreateRenderPass(VkFormat color_format, VkFormat depth_format) {
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depth_attachment = {1, kDepthLayout};
+    render_pass_ = containers::make_unique<VkRenderPass>(
+        application_->GetAllocator(),
+        application_->CreateRenderPass(
+            {{
+                 0,                                        // flags
+                 color_format,                             // format
+                 VK_SAMPLE_COUNT_1_BIT,                    // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,              // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,             // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,          // stencilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,         // stencilStoreOp
+                 VK_IMAGE_LAYOUT_UNDEFINED,                // initialLayout
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // finalLayout
+             },
+             {
+                 0,                                 // flags
+                 depth_format,                      // format
+                 VK_SAMPLE_COUNT_1_BIT,             // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+                 VK_IMAGE_LAYOUT_UNDEFINED,         // initialLayout
+                 kDepthLayout                       // finalLayout
+             }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                &depth_attachment,                // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+  }
+
+  // The same render pass as CreateRenderPass, with a view mask of every
+  // layer. The views see one scene from nearby positions, so they are
+  // correlated, which lets the implementation share work between them.
+  void CreateMultiviewRenderPass(VkFormat color_format,
+                                 VkFormat depth_format) {
+    const uint32_t view_mask =
+        num_views_ == 32 ? ~0u : (1u << num_views_) - 1;
+    VkAttachmentReference2KHR color_attachment = {
+        VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2_KHR,  // sType
+        nullptr,                                       // pNext
+        0,                                             // attachment
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,      // layout
+        VK_IMAGE_ASPECT_COLOR_BIT                      // aspectMask
+    };
+    VkAttachmentReference2KHR depth_attachment = {
+        VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2_KHR,  // sType
+        nullptr,                                       // pNext
+        1,                                             // attachment
+        kDepthLayout,                                  // layout
+        VK_IMAGE_ASPECT_DEPTH_BIT                      // aspectMask
+    };
+    render_pass_ = containers::make_unique<VkRenderPass>(
+        application_->GetAllocator(),
+        application_->CreateRenderPass2(
+            {{
+                 VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2_KHR,  // sType
+                 nullptr,                                         // pNext
+                 0,                                               // flags
+                 color_format,                                    // format
+                 VK_SAMPLE_COUNT_1_BIT,                           // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,                     // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,                    // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+                 VK_IMAGE_LAYOUT_UNDEFINED,         // initialLayout
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // finalLayout
+             },
+             {
+                 VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2_KHR,  // sType
+                 nullptr,                                         // pNext
+                 0,                                               // flags
+                 depth_format,                                    // format
+                 VK_SAMPLE_COUNT_1_BIT,                           // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,                     // loadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,                // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+                 VK_IMAGE_LAYOUT_UNDEFINED,         // initialLayout
+                 kDepthLayout                       // finalLayout
+             }},  // AttachmentDescriptions
+            {{
+                VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2_KHR,  // sType
+                nullptr,                                      // pNext
+                0,                                            // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                view_mask,                        // viewMask
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                &depth_attachment,                // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {},                                   // SubpassDependencies
+            1,                                    // correlatedViewMaskCount
+            &view_mask                            // pCorrelatedViewMasks
+            ));
+  }
+
+  // Creates views of |layer_count| layers of the color and depth images
+  // from |base_layer|, and a framebuffer of them with |framebuffer_layers|.
+  void CreateFramebuffer(VkImageViewType view_type, uint32_t base_layer,
+                         uint32_t layer_count, uint32_t framebuffer_layers) {
+    views_.push_back(application_->CreateImageView(
+        color_image_.get(), view_type,
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, base_layer, layer_count}));
+    ::VkImageView raw_views[2];
+    raw_views[0] = *views_.back();
+    views_.push_back(application_->CreateImageView(
+        depth_image_.get(), view_type,
+        {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, base_layer, layer_count}));
+    raw_views[1] = *views_.back();
+
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        2,                                          // attachmentCount
+        raw_views,                                  // attachments
+        width_,                                     // width
+        height_,                                    // height
+        framebuffer_layers                          // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
+               application_->device()->vkCreateFramebuffer(
+                   application_->device(), &framebuffer_create_info, nullptr,
+                   &raw_framebuffer));
+    framebuffers_.push_back(containers::make_unique<VkFramebuffer>(
+        application_->GetAllocator(),
+        VkFramebuffer(raw_framebuffer, nullptr, &application_->device())));
+  }
+
+  VulkanApplication* application_;
+  Mode mode_;
+  uint32_t num_views_;
+  uint32_t width_;
+  uint32_t height_;
+  containers::unique_ptr<VulkanApplication::Image> color_image_;
+  containers::unique_ptr<VulkanApplication::Image> depth_image_;
+  containers::unique_ptr<VkRenderPass> render_pass_;
+  containers::vector<containers::unique_ptr<VkImageView>> views_;
+  containers::vector<containers::unique_ptr<VkFramebuffer>> framebuffers_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_LAYERED_RENDER_PASS_H_
@@ -0,0 +1,446 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_MULTIPLANAR_CONSUMER_H
+#define VULKAN_HELPERS_MULTIPLANAR_CONSUMER_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/specialization_constants.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// MultiplanarConsumer converts 8-bit 4:2:0 multi-planar images, such as the
+// frames of a video decoder, to an RGBA image in one compute dispatch, in
+// one of two ways:
+//  - kSampler samples the image through a VkSamplerYcbcrConversion, so the
+//    sampler reconstructs the chroma and converts to RGB.
+//  - kPlanes reads every plane through a view of its own, and converts in
+//    the shader.
+// Both convert from BT.709 with narrow range, with the chroma at the
+// midpoint and filtered linearly, so they agree up to rounding. Neither
+// copies the planes, so they can stay in whatever memory they were bound
+// to, e.g. memory imported from the decoder.
+//
+// The shaders are shader_library/multiplanar/ycbcr_sampler.comp and
+// multiplanar/ycbcr_planes.comp, one for each path, which the application
+// compiles by adding shader_library to its SHADERS, e.g.
+//   uint32_t planes_shader[] =
+//   #include "multiplanar/ycbcr_planes.comp.spv"
+//       ;
+//
+// Every source image is added once with AddSource(), and every frame
+// records, outside of a render pass:
+//   consumer.Convert(&cmd, source);
+// after which output() holds the frame in RGBA.
+class MultiplanarConsumer {
+ public:
+  enum Path {
+    kSampler,
+    kPlanes,
+  };
+
+  // This must match local_size_x and local_size_y of both shaders.
+  static const uint32_t kGroupSize = 8;
+
+  // Converts images of |format|, VK_FORMAT_G8_B8R8_2PLANE_420_UNORM or
+  // VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM, of |width| by |height|, with
+  // |shader| for |path|. The device needs the samplerYcbcrConversion
+  // feature of VK_KHR_sampler_ycbcr_conversion for both paths, see
+  // Supported().
+  template <size_t N>
+  MultiplanarConsumer(VulkanApplication* application, Path path,
+                      VkFormat format, uint32_t width, uint32_t height,
+                      uint32_t (&shader)[N])
+      : MultiplanarConsumer(application, path, format, width, height, shader,
+                            N) {}
+
+  MultiplanarConsumer(VulkanApplication* application, Path path,
+                      VkFormat format, uint32_t width, uint32_t height,
+                      uint32_t* shader, size_t shader_words)
+      : application_(application),
+        path_(path),
+        format_(format),
+        width_(width),
+        height_(height),
+        views_(application->GetAllocator()),
+        sets_(application->GetAllocator()) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    VkDevice& device = application_->device();
+    LOG_ASSERT(!=, application_->GetLogger(), 0u, NumPlanes(format_));
+
+    VkSamplerYcbcrConversionInfo conversion_info = {
+        VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO,  // sType
+        nullptr,                                          // pNext
+        VK_NULL_HANDLE,                                   // conversion
+    };
+    if (path_ == kSampler) {
+      VkSamplerYcbcrConversionCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,  // sType
+          nullptr,                                                 // pNext
+          format_,                                                 // format
+          VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709,  // ycbcrModel
+          VK_SAMPLER_YCBCR_RANGE_ITU_NARROW,            // ycbcrRange
+          {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+           VK_COMPONENT_SWIZZLE_IDENTITY,
+           VK_COMPONENT_SWIZZLE_IDENTITY},  // components
+          VK_CHROMA_LOCATION_MIDPOINT,      // xChromaOffset
+          VK_CHROMA_LOCATION_MIDPOINT,      // yChromaOffset
+          VK_FILTER_LINEAR,                 // chromaFilter
+          VK_FALSE,                         // forceExplicitReconstruction
+      };
+      ::VkSamplerYcbcrConversion conversion;
+      LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
+                 device->vkCreateSamplerYcbcrConversionKHR(
+                     device, &create_info, nullptr, &conversion));
+      conversion_ = containers::make_unique<VkSamplerYcbcrConversion>(
+          allocator, VkSamplerYcbcrConversion(conversion, nullptr, &device));
+      conversion_info.conversion = conversion;
+    }
+    // Samplers with a conversion have to clamp to the edge, and the planes
+    // are sampled the same way.
+    sampler_ = containers::make_unique<VkSampler>(
+        allocator,
+        CreateSampler(&device, VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+                      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                      VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                      path_ == kSampler ? &conversion_info : nullptr));
+
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        VK_FORMAT_R8G8B8A8_UNORM,             // format
+        {
+            width_,   // width
+            height_,  // height
+            1,        // depth
+        },            // extent
+        1,            // mipLevels
+        1,            // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,    // samples
+        VK_IMAGE_TILING_OPTIMAL,  // tiling
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    output_ = application_->CreateAndBindImage(&image_create_info);
+    output_view_ = application_->CreateImageView(
+        output_.get(), VK_IMAGE_VIEW_TYPE_2D,
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+
+    // The sampler path only has the source and the output, the planes path
+    // has a binding for every plane and the output.
+    for (uint32_t i = 0; i < 3; ++i) {
+      bindings_[i] = {
+          i,                                          // binding
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+          1,                                          // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,                // stageFlags
+          path_ == kSampler ? &sampler_->get_raw_object()
+                            : nullptr  // pImmutableSamplers
+      };
+    }
+    bindings_[3] = {
+        3,                                 // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  // descriptorType
+        1,                                 // descriptorCount
+        VK_SHADER_STAGE_COMPUTE_BIT,       // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    if (path_ == kSampler) {
+      bindings_[1] = bindings_[3];
+      num_bindings_ = 2;
+    } else {
+      num_bindings_ = 4;
+    }
+    pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator, CreatePipelineLayout());
+    SpecializationConstants constants(allocator);
+    constants.Set(0, NumPlanes(format_));
+    pipeline_ = containers::make_unique<VulkanComputePipeline>(
+        allocator, application_->CreateComputePipeline(
+                       pipeline_layout_.get(),
+                       VkShaderModuleCreateInfo{
+                           VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                           nullptr, 0, shader_words * sizeof(uint32_t),
+                           shader},
+                       "main", constants));
+  }
+
+  // Returns the number of planes of |format|, or 0 if it can not be
+  // converted.
+  static uint32_t NumPlanes(VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_G8_B8R8_2PLANE_420_UNORM:
+        return 2;
+      case VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM:
+        return 3;
+      default:
+        return 0;
+    }
+  }
+
+  // Returns the flags that the source images of |path| need on top of
+  // VK_IMAGE_CREATE_DISJOINT_BIT, if they are disjoint. The views of the
+  // planes need VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT, which may keep the
+  // driver from compressing the image, so the sampler path does without.
+  static VkImageCreateFlags ImageCreateFlags(Path path) {
+    return path == kPlanes ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0;
+  }
+
+  // Returns true if |path| can convert images of |format| with |tiling|,
+  // and |disjoint| ones if it is true.
+  static bool Supported(VulkanApplication* application, Path path,
+                        VkFormat format, VkImageTiling tiling,
+                        bool disjoint) {
+    if (NumPlanes(format) == 0) {
+      return false;
+    }
+    const VkFormatFeatureFlags features = Features(application, format, tiling);
+    if (disjoint && !(features & VK_FORMAT_FEATURE_DISJOINT_BIT)) {
+      return false;
+    }
+    if (path == kSampler) {
+      const VkFormatFeatureFlags required =
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+          VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT;
+      return (features & required) == required;
+    }
+    const VkFormatFeatureFlags required =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    for (uint32_t i = 0; i < NumPlanes(format); ++i) {
+      if ((Features(application, PlaneFormat(format, i), tiling) &
+           required) != required) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Adds a source image of the format and size of the consumer, and
+  // returns its index for Convert(). The image needs
+  // VK_IMAGE_USAGE_SAMPLED_BIT and ImageCreateFlags(), and whenever it is
+  // converted, it must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, with
+  // its contents visible to compute shaders.
+  size_t AddSource(::VkImage image) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    VkDevice& device = application_->device();
+    VkSamplerYcbcrConversionInfo conversion_info = {
+        VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO,  // sType
+        nullptr,                                          // pNext
+        conversion_ ? conversion_->get_raw_object()
+                    : VK_NULL_HANDLE,  // conversion
+    };
+    VkImageViewCreateInfo view_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
+        nullptr,                                   // pNext
+        0,                                         // flags
+        image,                                     // image
+        VK_IMAGE_VIEW_TYPE_2D,                     // viewType
+        format_,                                   // format
+        {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+         VK_COMPONENT_SWIZZLE_IDENTITY,
+         VK_COMPONENT_SWIZZLE_IDENTITY},          // components
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},  // subresourceRange
+    };
+    const uint32_t num_views = path_ == kSampler ? 1 : NumPlanes(format_);
+    if (path_ == kSampler) {
+      view_create_info.pNext = &conversion_info;
+    }
+    VkDescriptorImageInfo image_infos[4];
+    for (uint32_t i = 0; i < num_views; ++i) {
+      if (path_ == kPlanes) {
+        view_create_info.format = PlaneFormat(format_, i);
+        view_create_info.subresourceRange.aspectMask =
+            VK_IMAGE_ASPECT_PLANE_0_BIT << i;
+      }
+      ::VkImageView view;
+      LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
+                 device->vkCreateImageView(device, &view_create_info,
+                                           nullptr, &view));
+      views_.push_back(containers::make_unique<VkImageView>(
+          allocator, VkImageView(view, nullptr, &device)));
+      image_infos[i] = {
+          *sampler_,                                 // sampler
+          view,                                      // imageView
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
+      };
+    }
+    // The Cr binding of 2 plane images is never read, but it has to be
+    // valid.
+    for (uint32_t i = num_views; i < num_bindings_ - 1; ++i) {
+      image_infos[i] = image_infos[num_views - 1];
+    }
+    image_infos[num_bindings_ - 1] = {
+        VK_NULL_HANDLE,           // sampler
+        *output_view_,            // imageView
+        VK_IMAGE_LAYOUT_GENERAL,  // imageLayout
+    };
+
+    sets_.push_back(containers::make_unique<DescriptorSet>(
+        allocator, AllocateDescriptorSet()));
+    ::VkDescriptorSet set = sets_.back()->raw_set();
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+            nullptr,                                    // pNext
+            set,                                        // dstSet
+            0,                                          // dstbinding
+            0,                                          // dstArrayElement
+            num_bindings_ - 1,                          // descriptorCount
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+            image_infos,                                // pImageInfo
+            nullptr,                                    // pBufferInfo
+            nullptr,                                    // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            set,                                     // dstSet
+            bindings_[num_bindings_ - 1].binding,    // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,        // descriptorType
+            image_infos + num_bindings_ - 1,         // pImageInfo
+            nullptr,                                 // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+    device->vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    return sets_.size() - 1;
+  }
+
+  // Records the conversion of the source |source| to output(), which is
+  // left in VK_IMAGE_LAYOUT_GENERAL, visible to shaders and transfers. This
+  // must be recorded outside of a render pass, and every conversion must be
+  // submitted to the same queue.
+  void Convert(VkCommandBuffer* cmd, size_t source) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    // The previous frame is not needed anymore, once everything that read
+    // it is done.
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        0,                                       // srcAccessMask
+        VK_ACCESS_SHADER_WRITE_BIT,              // dstAccessMask
+        VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+        VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        *output_,                                // image
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},  // subresourceRange
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, kReaderStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+        nullptr, 0, nullptr, 1, &barrier);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &sets_[source]->raw_set(), 0, nullptr);
+    cmdBuffer->vkCmdDispatch(cmdBuffer,
+                             (width_ + kGroupSize - 1) / kGroupSize,
+                             (height_ + kGroupSize - 1) / kGroupSize, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, kReaderStages, 0, 0,
+        nullptr, 0, nullptr, 1, &barrier);
+  }
+
+  Path path() const { return path_; }
+  // The RGBA result of the last conversion.
+  VulkanApplication::Image* output() const { return output_.get(); }
+  ::VkImageView output_view() const { return *output_view_; }
+
+ private:
+  // The stages that may read the output between two conversions.
+  static const VkPipelineStageFlags kReaderStages =
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+  // Returns the format of a view of plane |plane| of |format|.
+  static VkFormat PlaneFormat(VkFormat format, uint32_t plane) {
+    return plane == 1 && format == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM
+               ? VK_FORMAT_R8G8_UNORM
+               : VK_FORMAT_R8_UNORM;
+  }
+
+  static VkFormatFeatureFlags Features(VulkanApplication* application,
+                                       VkFormat format,
+                                       VkImageTiling tiling) {
+    VkFormatProperties properties;
+    application->instance()->vkGetPhysicalDeviceFormatProperties(
+        application->device().physical_device(), format, &properties);
+    return tiling == VK_IMAGE_TILING_LINEAR
+               ? properties.linearTilingFeatures
+               : properties.optimalTilingFeatures;
+  }
+
+  PipelineLayout CreatePipelineLayout() {
+    if (num_bindings_ == 2) {
+      return application_->CreatePipelineLayout({{bindings_[0], bindings_[1]}});
+    }
+    return application_->CreatePipelineLayout(
+        {{bindings_[0], bindings_[1], bindings_[2], bindings_[3]}});
+  }
+
+  DescriptorSet AllocateDescriptorSet() {
+    if (num_bindings_ == 2) {
+      return application_->AllocateDescriptorSet({bindings_[0], bindings_[1]});
+    }
+    return application_->AllocateDescriptorSet(
+        {bindings_[0], bindings_[1], bindings_[2], bindings_[3]});
+  }
+
+  VulkanApplication* application_;
+  Path path_;
+  VkFormat format_;
+  uint32_t width_;
+  uint32_t height_;
+  // Only the sampler path has a conversion, which the sampler is created
+  // with, so it is destroyed after the sampler.
+  containers::unique_ptr<VkSamplerYcbcrConversion> conversion_;
+  containers::unique_ptr<VkSampler> sampler_;
+  containers::unique_ptr<VulkanApplication::Image> output_;
+  containers::unique_ptr<VkImageView> output_view_;
+  VkDescriptorSetLayoutBinding bindings_[4];
+  uint32_t num_bindings_;
+  containers::unique_ptr<PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> pipeline_;
+  // The views of every source, one per plane for the planes path.
+  containers::vector<containers::unique_ptr<VkImageView>> views_;
+  containers::vector<containers::unique_ptr<DescriptorSet>> sets_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_MULTIPLANAR_CONSUMER_H
@@ -0,0 +1,209 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_OBJECT_CACHE_H
+#define VULKAN_HELPERS_OBJECT_CACHE_H
+
+#include "support/containers/flat_hash_map.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+namespace vulkan {
+
+// ObjectCache shares one |T| between everything that creates it from the
+// same description. Subclasses turn the create info of the object into a
+// key of 64 bit words, and objects are destroyed with Traits::Destroy once
+// the last handle to them is released. It may be used from any thread.
+template <typename T, typename Traits>
+class ObjectCache {
+ private:
+  struct Entry {
+    Entry(containers::Allocator* allocator, uint64_t hash)
+        : key(allocator), hash(hash), object(VK_NULL_HANDLE), references(1) {}
+    containers::vector<uint64_t> key;
+    uint64_t hash;
+    T object;
+    // Guarded by the mutex of the cache.
+    uint32_t references;
+  };
+
+ public:
+  // A reference counted handle to an object of the cache.
+  class Handle {
+   public:
+    Handle() : cache_(nullptr), entry_(nullptr) {}
+    Handle(const Handle& other) : cache_(other.cache_), entry_(other.entry_) {
+      if (entry_) {
+        cache_->AddReference(entry_);
+      }
+    }
+    Handle(Handle&& other) : cache_(other.cache_), entry_(other.entry_) {
+      other.cache_ = nullptr;
+      other.entry_ = nullptr;
+    }
+    Handle& operator=(Handle other) {
+      std::swap(cache_, other.cache_);
+      std::swap(entry_, other.entry_);
+      return *this;
+    }
+    ~Handle() {
+      if (entry_) {
+        cache_->Release(entry_);
+      }
+    }
+
+    operator T() const { return entry_ ? entry_->object : VK_NULL_HANDLE; }
+
+   private:
+    friend class ObjectCache;
+    Handle(ObjectCache* cache, Entry* entry) : cache_(cache), entry_(entry) {}
+
+    ObjectCache* cache_;
+    Entry* entry_;
+  };
+
+  ObjectCache(containers::Allocator* allocator, VkDevice* device)
+      : allocator_(allocator),
+        device_(device),
+        entries_(allocator),
+        max_objects_(0),
+        num_alive_(0),
+        num_created_(0) {}
+
+  ~ObjectCache() {
+    // Handles should not outlive the cache, but the objects of any that
+    // do are not leaked.
+    for (auto& entry : entries_) {
+      Traits::Destroy(device_, entry.second->object);
+    }
+  }
+
+  // Limits how many objects may be alive at once, 0 means no limit. It is
+  // an error to need more.
+  void set_max_objects(uint32_t max_objects) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_objects_ = max_objects;
+  }
+
+  // The number of objects that were created so far.
+  uint64_t num_created() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_created_;
+  }
+
+  // The number of objects that are alive.
+  uint32_t num_alive() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_alive_;
+  }
+
+ protected:
+  // Returns a handle to the object of |key|, calling |create|, which has
+  // to return a new T, if no handle to it is alive. If |cacheable| is
+  // false the description could not be put into |key|, and the object is
+  // never shared.
+  template <typename Create>
+  Handle GetOrCreate(containers::vector<uint64_t> key, bool cacheable,
+                     const Create& create) {
+    const uint64_t hash = cacheable ? Hash(key) : 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cacheable) {
+      auto it = entries_.find(hash);
+      if (it != entries_.end()) {
+        Entry* entry = it->second.get();
+        if (entry->key == key) {
+          ++entry->references;
+          return Handle(this, entry);
+        }
+        // A collision, the object that is already cached is kept.
+        cacheable = false;
+      }
+    }
+    if (max_objects_ != 0 && num_alive_ >= max_objects_) {
+      device_->GetLogger()->LogError("Cannot have more than ", max_objects_,
+                                     " objects alive");
+      LOG_CRASH(device_->GetLogger(), "Too many objects in the cache");
+    }
+    Entry* entry = allocator_->construct<Entry>(allocator_, hash);
+    entry->object = create();
+    ++num_alive_;
+    ++num_created_;
+    if (cacheable) {
+      entry->key = std::move(key);
+      entries_[hash] = containers::unique_ptr<Entry>(
+          entry, containers::UniqueDeleter(allocator_, sizeof(Entry)));
+    }
+    return Handle(this, entry);
+  }
+
+  // Returns the bits of |value|, so that floats can be part of a key.
+  static uint64_t FloatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+
+ private:
+  // 64 bit FNV-1a over the words of the key.
+  static uint64_t Hash(const containers::vector<uint64_t>& key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t word : key) {
+      hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  void AddReference(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++entry->references;
+  }
+
+  // Entries that are not in entries_ are owned by their handles.
+  void Release(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--entry->references != 0) {
+      return;
+    }
+    Traits::Destroy(device_, entry->object);
+    --num_alive_;
+    auto it = entries_.find(entry->hash);
+    if (it != entries_.end() && it->second.get() == entry) {
+      entries_.erase(it);
+    } else {
+      allocator_->destroy(entry);
+    }
+  }
+
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  containers::flat_hash_map<uint64_t, containers::unique_ptr<Entry>> entries_;
+  uint32_t max_objects_;
+  uint32_t num_alive_;
+  uint64_t num_created_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_OBJECT_CACHE_H
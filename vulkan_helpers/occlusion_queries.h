@@ -0,0 +1,262 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_OCCLUSION_QUERIES_H
+#define VULKAN_HELPERS_OCCLUSION_QUERIES_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// OcclusionQueries counts the samples that pass the depth and stencil tests
+// for the draws of every object, and hands the counts to the CPU without
+// ever waiting for them. Every frame has its own query pool, and copies its
+// results with vkCmdCopyQueryPoolResults into its own persistently mapped
+// buffer, which is only read the next time that frame is started, once the
+// GPU is done with it. The result of an object is therefore as old as the
+// number of frames in flight, which is fine for decisions like the level of
+// detail of the object, but not for whether it is drawn at all this frame.
+//
+// Every frame records:
+//   queries.BeginFrame(frame_index, &cmd);  // Outside of a render pass.
+//   // In the render pass, for every object that is tested:
+//   uint32_t query = queries.Begin(&cmd, object);
+//   // The draws of the object.
+//   queries.End(&cmd, query);
+//   queries.CopyResults(&cmd);  // Outside of a render pass.
+//
+// BeginFrame(i) must only be called once every command buffer that used
+// frame i before has finished on the GPU, i.e. after waiting on that
+// frame's fence.
+class OcclusionQueries {
+ public:
+  // The samples of an object that no result is available for yet.
+  static const uint64_t kUnknownSamples = ~uint64_t(0);
+  // Returned by Begin() once a frame has max_queries_per_frame queries, and
+  // ignored by End().
+  static const uint32_t kNoQuery = 0xFFFFFFFF;
+
+  // The objects are numbered from 0 to |num_objects| - 1, and every frame
+  // tests up to |max_queries_per_frame| of them.
+  // If |host_query_reset| is true, the device must have been created with
+  // the hostQueryReset feature, and the pools are reset from the host.
+  // Otherwise BeginFrame() records the reset of the frame's pool.
+  // If |precise| is true, the device must have been created with the
+  // occlusionQueryPrecise feature, and the results are exact sample counts
+  // instead of only being 0 or not.
+  OcclusionQueries(VulkanApplication* application, size_t num_frames,
+                   uint32_t num_objects, uint32_t max_queries_per_frame,
+                   bool host_query_reset, bool precise = false)
+      : application_(application),
+        frames_(application->GetAllocator()),
+        samples_(num_objects, ~uint64_t(0), application->GetAllocator()),
+        result_frames_(num_objects, 0, application->GetAllocator()),
+        max_queries_per_frame_(max_queries_per_frame),
+        host_query_reset_(host_query_reset),
+        precise_(precise),
+        current_frame_(0),
+        frame_number_(0) {
+    for (size_t i = 0; i < num_frames; ++i) {
+      frames_.push_back(containers::make_unique<Frame>(
+          application_->GetAllocator(), application_, max_queries_per_frame_));
+      if (host_query_reset_) {
+        ResetOnHost(frames_.back().get());
+      }
+    }
+  }
+
+  // Takes the results that frame |frame_index| copied the last time it was
+  // used, and makes |frame_index| the frame that new queries belong to.
+  // Without host query reset, the reset of the frame's pool is recorded
+  // into |cmd|, which must not be in a render pass. With host query reset,
+  // |cmd| may be nullptr.
+  void BeginFrame(size_t frame_index, VkCommandBuffer* cmd) {
+    LOG_ASSERT(<, application_->GetLogger(), frame_index, frames_.size());
+    current_frame_ = frame_index;
+    ++frame_number_;
+    Frame* frame = frames_[frame_index].get();
+    if (frame->copied) {
+      frame->results->invalidate();
+      const uint64_t* results =
+          reinterpret_cast<const uint64_t*>(frame->results->base_address());
+      for (uint32_t i = 0; i < frame->num_queries; ++i) {
+        // Every result is followed by whether it is available. It is not if
+        // the query was never ended, e.g. because its render pass was not
+        // submitted.
+        if (results[2 * i + 1] == 0) {
+          continue;
+        }
+        const uint32_t object = frame->objects[i];
+        samples_[object] = results[2 * i];
+        result_frames_[object] = frame->frame_number;
+      }
+    }
+    frame->num_queries = 0;
+    frame->objects.clear();
+    frame->copied = false;
+    frame->frame_number = frame_number_;
+    if (host_query_reset_) {
+      ResetOnHost(frame);
+    } else {
+      (*cmd)->vkCmdResetQueryPool(*cmd, frame->pool, 0,
+                                  max_queries_per_frame_);
+    }
+  }
+
+  // Starts counting the samples of |object| in |cmd|, and returns the query
+  // to pass to End(), which must be recorded in the same subpass. Queries
+  // of the same pool can not be nested. Returns kNoQuery once the frame has
+  // max_queries_per_frame queries.
+  uint32_t Begin(VkCommandBuffer* cmd, uint32_t object) {
+    LOG_ASSERT(<, application_->GetLogger(), object,
+               static_cast<uint32_t>(samples_.size()));
+    Frame* frame = frames_[current_frame_].get();
+    if (frame->num_queries == max_queries_per_frame_) {
+      return kNoQuery;
+    }
+    const uint32_t query = frame->num_queries++;
+    frame->objects.push_back(object);
+    (*cmd)->vkCmdBeginQuery(
+        *cmd, frame->pool, query,
+        precise_ ? static_cast<VkQueryControlFlags>(
+                       VK_QUERY_CONTROL_PRECISE_BIT)
+                 : 0);
+    return query;
+  }
+
+  void End(VkCommandBuffer* cmd, uint32_t query) {
+    if (query == kNoQuery) {
+      return;
+    }
+    (*cmd)->vkCmdEndQuery(*cmd, frames_[current_frame_]->pool, query);
+  }
+
+  // Records the copy of the results of every query of the frame into its
+  // buffer, without waiting for them, and makes the copy visible to the
+  // host. This must be recorded outside of a render pass, after the last
+  // End() of the frame.
+  void CopyResults(VkCommandBuffer* cmd) {
+    VkCommandBuffer& cmdBuffer = *cmd;
+    Frame* frame = frames_[current_frame_].get();
+    if (frame->num_queries == 0) {
+      return;
+    }
+    cmdBuffer->vkCmdCopyQueryPoolResults(
+        cmdBuffer, frame->pool, 0, frame->num_queries, *frame->results,
+        frame->results->offset(), 2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        VK_ACCESS_HOST_READ_BIT,                  // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *frame->results,                          // buffer
+        frame->results->offset(),                 // offset
+        frame->results->size(),                   // size
+    };
+    cmdBuffer->vkCmdPipelineBarrier(
+        cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    frame->copied = true;
+  }
+
+  // The samples of |object| in the newest result that is available, or
+  // kUnknownSamples if it was never tested.
+  uint64_t samples(uint32_t object) const { return samples_[object]; }
+  // Whether any sample of |object| passed in the newest result, and true
+  // if it was never tested, so objects are never hidden without a reason.
+  bool visible(uint32_t object) const { return samples_[object] != 0; }
+  // The number of frames that were started since the newest result of
+  // |object| was recorded, or 0 if it was never tested.
+  uint64_t result_age(uint32_t object) const {
+    return samples_[object] == kUnknownSamples
+               ? 0
+               : frame_number_ - result_frames_[object];
+  }
+
+ private:
+  // The query pool of one frame, the objects that were tested in it, and
+  // the buffer that its results are copied to.
+  struct Frame {
+    Frame(VulkanApplication* application, uint32_t max_queries)
+        : pool(CreateQueryPool(
+              &application->device(),
+              {
+                  VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                  nullptr,                                   // pNext
+                  0,                                         // flags
+                  VK_QUERY_TYPE_OCCLUSION,                   // queryType
+                  max_queries,                               // queryCount
+                  0  // pipelineStatistics
+              })),
+          objects(application->GetAllocator()),
+          num_queries(0),
+          copied(false),
+          frame_number(0) {
+      objects.reserve(max_queries);
+      // Every query has its result and its availability.
+      VkBufferCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // flags
+          2 * sizeof(uint64_t) * max_queries,    // size
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
+          VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+          0,                                     // queueFamilyIndexCount
+          nullptr                                // pQueueFamilyIndices
+      };
+      results = application->CreateAndBindReadbackBuffer(&create_info);
+    }
+
+    VkQueryPool pool;
+    containers::unique_ptr<VulkanApplication::Buffer> results;
+    // The object of every query.
+    containers::vector<uint32_t> objects;
+    uint32_t num_queries;
+    // Whether the results were copied since the frame was started.
+    bool copied;
+    // The frame_number_ of when the frame was started.
+    uint64_t frame_number;
+  };
+
+  void ResetOnHost(Frame* frame) {
+    application_->device()->vkResetQueryPoolEXT(
+        application_->device(), frame->pool, 0, max_queries_per_frame_);
+  }
+
+  VulkanApplication* application_;
+  containers::vector<containers::unique_ptr<Frame>> frames_;
+  // The newest result of every object, and the frame_number_ of the frame
+  // that it was recorded in.
+  containers::vector<uint64_t> samples_;
+  containers::vector<uint64_t> result_frames_;
+  uint32_t max_queries_per_frame_;
+  bool host_query_reset_;
+  bool precise_;
+  size_t current_frame_;
+  // The number of frames that were started.
+  uint64_t frame_number_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_OCCLUSION_QUERIES_H
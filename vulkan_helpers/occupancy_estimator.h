@@ -0,0 +1,146 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_OCCUPANCY_ESTIMATOR_H
+#define VULKAN_HELPERS_OCCUPANCY_ESTIMATOR_H
+
+#include "vulkan_wrapper/instance_wrapper.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace vulkan {
+
+// The registers and shared memory that one wavefront of a compiled shader
+// uses, as the driver reports them.
+struct ShaderResources {
+  uint32_t vgprs;
+  uint32_t sgprs;
+  // The shared memory of one workgroup, 0 for graphics shaders.
+  uint32_t lds_bytes;
+};
+
+// OccupancyEstimator computes the theoretical occupancy of a shader, the
+// fraction of the wavefront slots of a SIMD that can be filled at once,
+// from the limits of VkPhysicalDeviceShaderCorePropertiesAMD. Registers are
+// allocated per wavefront in steps of their allocation granularity, and the
+// shared memory of a compute unit is divided between its workgroups.
+//
+// The properties are only reported by devices with
+// VK_AMD_shader_core_properties, otherwise valid() is false.
+class OccupancyEstimator {
+ public:
+  // The shared memory of one compute unit, which the shader core properties
+  // do not report.
+  static const uint32_t kLdsBytesPerComputeUnit = 64 * 1024;
+
+  OccupancyEstimator(VkInstance& instance, ::VkPhysicalDevice physical_device)
+      : properties_{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CORE_PROPERTIES_AMD,
+            nullptr} {
+    auto get_properties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+        instance.get_wrapper()->getProcAddr(instance,
+                                            "vkGetPhysicalDeviceProperties2"));
+    if (!get_properties2) {
+      get_properties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+          instance.get_wrapper()->getProcAddr(
+              instance, "vkGetPhysicalDeviceProperties2KHR"));
+    }
+    VkPhysicalDeviceProperties2 properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,  // sType
+        &properties_,                                    // pNext
+        {}                                               // properties
+    };
+    if (get_properties2) {
+      get_properties2(physical_device, &properties);
+    }
+  }
+
+  // True if the device reported its shader core properties.
+  bool valid() const {
+    return properties_.wavefrontsPerSimd != 0 &&
+           properties_.wavefrontSize != 0 &&
+           properties_.simdPerComputeUnit != 0;
+  }
+
+  uint32_t wavefront_size() const { return properties_.wavefrontSize; }
+
+  // Returns the number of wavefronts of a shader that fit on one SIMD at
+  // once. The shared memory only limits compute shaders, whose
+  // |workgroup_size| is given.
+  uint32_t WavefrontsPerSimd(const ShaderResources& resources,
+                             uint32_t workgroup_size = 0) const {
+    if (!valid()) {
+      return 0;
+    }
+    uint32_t waves = properties_.wavefrontsPerSimd;
+    if (resources.vgprs > 0) {
+      waves = std::min(
+          waves, properties_.vgprsPerSimd /
+                     Allocation(resources.vgprs, properties_.minVgprAllocation,
+                                properties_.vgprAllocationGranularity));
+    }
+    if (resources.sgprs > 0) {
+      waves = std::min(
+          waves, properties_.sgprsPerSimd /
+                     Allocation(resources.sgprs, properties_.minSgprAllocation,
+                                properties_.sgprAllocationGranularity));
+    }
+    if (workgroup_size > 0) {
+      const uint32_t waves_per_workgroup =
+          (workgroup_size + properties_.wavefrontSize - 1) /
+          properties_.wavefrontSize;
+      // A workgroup has to fit on one compute unit.
+      if (waves_per_workgroup >
+          properties_.wavefrontsPerSimd * properties_.simdPerComputeUnit) {
+        return 0;
+      }
+      if (resources.lds_bytes > 0) {
+        const uint32_t workgroups =
+            kLdsBytesPerComputeUnit / resources.lds_bytes;
+        waves = std::min(waves, workgroups * waves_per_workgroup /
+                                    properties_.simdPerComputeUnit);
+      }
+    }
+    return waves;
+  }
+
+  // Returns WavefrontsPerSimd() as a fraction of the wavefront slots of a
+  // SIMD, or 0 if the estimate is not valid().
+  float Occupancy(const ShaderResources& resources,
+                  uint32_t workgroup_size = 0) const {
+    if (!valid()) {
+      return 0.0f;
+    }
+    return static_cast<float>(WavefrontsPerSimd(resources, workgroup_size)) /
+           properties_.wavefrontsPerSimd;
+  }
+
+ private:
+  // Returns the registers that are allocated for |used| registers.
+  static uint32_t Allocation(uint32_t used, uint32_t minimum,
+                             uint32_t granularity) {
+    if (granularity > 0) {
+      used = (used + granularity - 1) / granularity * granularity;
+    }
+    return std::max(std::max(used, minimum), 1u);
+  }
+
+  VkPhysicalDeviceShaderCorePropertiesAMD properties_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_OCCUPANCY_ESTIMATOR_H
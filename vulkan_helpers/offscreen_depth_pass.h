@@ -0,0 +1,394 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_OFFSCREEN_DEPTH_PASS_H_
+#define VULKAN_HELPERS_OFFSCREEN_DEPTH_PASS_H_
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/layered_render_pass.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// OffscreenDepthPass renders depth only into the layers of a depth array
+// image that is later sampled, e.g. the cascades of a shadow map, or the
+// faces of a point light's shadow cube. It is rendered separately from the
+// swapchain image of a frame:
+//  - the image has a resolution of its own, and is bound from an arena of
+//    its own, see VulkanApplication::CreateImageArena,
+//  - every frame in flight has a command buffer of its own that Record()
+//    records every pass into, and that the application submits before the
+//    work that samples the image.
+// The layers are rendered with the modes of LayeredRenderPass: one pass per
+// layer, one multiview pass, or one pass that picks the layer of a draw
+// with gl_Layer. After every pass the layers are in kSampledLayout, and the
+// depth writes are visible to fragment shaders that run after the pass on
+// the same queue.
+class OffscreenDepthPass {
+ public:
+  using Mode = LayeredRenderPass::Mode;
+
+  // The layout that the layers are left in, and are sampled in.
+  static const VkImageLayout kSampledLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  // Creates |num_layers| layers of |width| by |height| in |depth_format|,
+  // the render passes and framebuffers of |mode| that clear and render into
+  // them, and a command buffer for each of |num_frames| frames.
+  OffscreenDepthPass(VulkanApplication* application, Mode mode,
+                     uint32_t num_layers, uint32_t width, uint32_t height,
+                     VkFormat depth_format, uint32_t num_frames = 1)
+      : application_(application),
+        mode_(mode),
+        num_layers_(num_layers),
+        width_(width),
+        height_(height),
+        // Enough for 32 bit depth, the arena grows if the format needs
+        // more.
+        arena_(application->CreateImageArena(
+            ::VkDeviceSize(width) * height * num_layers * 4,
+            "offscreen_depth")),
+        views_(application->GetAllocator()),
+        framebuffers_(application->GetAllocator()),
+        command_buffers_(application->GetAllocator()) {
+    LOG_ASSERT(>, application_->GetLogger(), num_layers_, 0u);
+    LOG_ASSERT(<=, application_->GetLogger(), num_layers_, 32u);
+    LOG_ASSERT(>, application_->GetLogger(), num_frames, 0u);
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        depth_format,                         // format
+        {width_, height_, 1},                 // extent
+        1,                                    // mipLevels
+        num_layers_,                          // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                // samples
+        VK_IMAGE_TILING_OPTIMAL,              // tiling
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,       // sharingMode
+        0,                               // queueFamilyIndexCount
+        nullptr,                         // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,       // initialLayout
+    };
+    depth_image_ =
+        application_->CreateAndBindImage(arena_.get(), &image_create_info);
+    sampled_view_ = application_->CreateImageView(
+        depth_image_.get(), VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, num_layers_});
+
+    if (mode_ == Mode::kMultiview) {
+      CreateMultiviewRenderPass(depth_format);
+    } else {
+      CreateRenderPass(depth_format);
+    }
+
+    if (mode_ == Mode::kSeparate) {
+      // Every pass renders into a framebuffer of one layer.
+      for (uint32_t i = 0; i < num_layers_; ++i) {
+        CreateFramebuffer(VK_IMAGE_VIEW_TYPE_2D, i, 1, 1);
+      }
+    } else {
+      // A multiview framebuffer has one layer, the view mask selects the
+      // layers of the views. A layered one has all of them.
+      CreateFramebuffer(VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, num_layers_,
+                        mode_ == Mode::kLayered ? num_layers_ : 1);
+    }
+
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      command_buffers_.push_back(containers::make_unique<VkCommandBuffer>(
+          application_->GetAllocator(), application_->GetCommandBuffer()));
+    }
+  }
+
+  Mode mode() const { return mode_; }
+  uint32_t num_layers() const { return num_layers_; }
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+
+  // The render passes that render every layer: one per layer for
+  // kSeparate, otherwise one.
+  uint32_t num_passes() const {
+    return mode_ == Mode::kSeparate ? num_layers_ : 1;
+  }
+
+  // The instances that a draw of |instances| per layer needs in a pass, see
+  // LayeredRenderPass::instance_count.
+  uint32_t instance_count(uint32_t instances) const {
+    return mode_ == Mode::kLayered ? instances * num_layers_ : instances;
+  }
+
+  // The render pass that the pipelines of every pass are created with.
+  VkRenderPass& render_pass() { return *render_pass_; }
+  VulkanApplication::Image* depth_image() { return depth_image_.get(); }
+  // A view of every layer, to sample them in kSampledLayout.
+  VkImageView& sampled_view() { return *sampled_view_; }
+  VulkanArena* arena() { return arena_.get(); }
+
+  // Sets the viewport and scissor of |pipeline| to the resolution of the
+  // layers, and its depth bias to |constant_bias| and |slope_bias|. With
+  // |depth_clamp|, geometry in front of the near plane is clamped to it
+  // instead of clipped, so casters between a light and the near plane of
+  // a cascade still cast shadows, which needs the depthClamp feature.
+  void ConfigurePipeline(VulkanGraphicsPipeline* pipeline,
+                         float constant_bias, float slope_bias,
+                         bool depth_clamp) const {
+    pipeline->SetViewport({
+        0.0f,                         // x
+        0.0f,                         // y
+        static_cast<float>(width_),   // width
+        static_cast<float>(height_),  // height
+        0.0f,                         // minDepth
+        1.0f                          // maxDepth
+    });
+    pipeline->SetScissor({{0, 0}, {width_, height_}});
+    pipeline->EnableDepthBias(constant_bias, slope_bias, 0.0f);
+    pipeline->SetDepthClampEnable(depth_clamp ? VK_TRUE : VK_FALSE);
+  }
+
+  // Records pass |pass| of num_passes() into |cmd|: begins it, which clears
+  // its layers to a depth of 1, calls draw_pass(cmd, pass), and ends it. For
+  // kSeparate, |pass| is the layer, and the application gives it to its
+  // shaders.
+  template <typename DrawPass>
+  void RecordPass(VkCommandBuffer* cmd, uint32_t pass, DrawPass draw_pass) {
+    LOG_ASSERT(<, application_->GetLogger(), pass, num_passes());
+    VkClearValue clear_value;
+    clear_value.depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *framebuffers_[pass],                      // framebuffer
+        {{0, 0}, {width_, height_}},               // renderArea
+        1,                                         // clearValueCount
+        &clear_value                               // pClearValues
+    };
+    (*cmd)->vkCmdBeginRenderPass(*cmd, &begin_info,
+                                 VK_SUBPASS_CONTENTS_INLINE);
+    draw_pass(cmd, pass);
+    (*cmd)->vkCmdEndRenderPass(*cmd);
+  }
+
+  // Records every pass, with RecordPass, into the command buffer of
+  // |frame|, and returns it ready to be submitted.
+  template <typename DrawPass>
+  VkCommandBuffer& Record(size_t frame, DrawPass draw_pass) {
+    LOG_ASSERT(<, application_->GetLogger(), frame, command_buffers_.size());
+    VkCommandBuffer& cmd = *command_buffers_[frame];
+    VkCommandBufferBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+        nullptr,                                      // pNext
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+        nullptr                                       // pInheritanceInfo
+    };
+    cmd->vkBeginCommandBuffer(cmd, &begin_info);
+    for (uint32_t i = 0; i < num_passes(); ++i) {
+      RecordPass(&cmd, i, draw_pass);
+    }
+    cmd->vkEndCommandBuffer(cmd);
+    return cmd;
+  }
+
+ private:
+  static const VkImageLayout kDepthLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  static const VkPipelineStageFlags kDepthStages =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+  void CreateRenderPass(VkFormat depth_format) {
+    VkAttachmentReference depth_attachment = {0, kDepthLayout};
+    render_pass_ = containers::make_unique<VkRenderPass>(
+        application_->GetAllocator(),
+        application_->CreateRenderPass(
+            {{
+                0,                                 // flags
+                depth_format,                      // format
+                VK_SAMPLE_COUNT_1_BIT,             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+                VK_IMAGE_LAYOUT_UNDEFINED,         // initialLayout
+                kSampledLayout                     // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                0,                                // colorAttachmentCount
+                nullptr,                          // colorAttachment
+                nullptr,                          // pResolveAttachments
+                &depth_attachment,                // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {{
+                 // The previous frame may still sample the layers.
+                 VK_SUBPASS_EXTERNAL,                     // srcSubpass
+                 0,                                       // dstSubpass
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,   // srcStageMask
+                 kDepthStages,                            // dstStageMask
+                 0,                                       // srcAccessMask
+                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                 // dstAccessMask
+                 0  // dependencyFlags
+             },
+             {
+                 // The depth is sampled after the pass.
+                 0,                                      // srcSubpass
+                 VK_SUBPASS_EXTERNAL,                    // dstSubpass
+                 kDepthStages,                           // srcStageMask
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,  // dstStageMask
+                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                 // srcAccessMask
+                 VK_ACCESS_SHADER_READ_BIT,  // dstAccessMask
+                 0                           // dependencyFlags
+             }}  // SubpassDependencies
+            ));
+  }
+
+  // The same render pass as CreateRenderPass, with a view mask of every
+  // layer. Cascades see one scene from one light, so they are correlated.
+  void CreateMultiviewRenderPass(VkFormat depth_format) {
+    const uint32_t view_mask =
+        num_layers_ == 32 ? ~0u : (1u << num_layers_) - 1;
+    VkAttachmentReference2KHR depth_attachment = {
+        VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2_KHR,  // sType
+        nullptr,                                       // pNext
+        0,                                             // attachment
+        kDepthLayout,                                  // layout
+        VK_IMAGE_ASPECT_DEPTH_BIT                      // aspectMask
+    };
+    render_pass_ = containers::make_unique<VkRenderPass>(
+        application_->GetAllocator(),
+        application_->CreateRenderPass2(
+            {{
+                VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2_KHR,  // sType
+                nullptr,                                         // pNext
+                0,                                               // flags
+                depth_format,                                    // format
+                VK_SAMPLE_COUNT_1_BIT,                           // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,                     // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,                    // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+                VK_IMAGE_LAYOUT_UNDEFINED,         // initialLayout
+                kSampledLayout                     // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2_KHR,  // sType
+                nullptr,                                      // pNext
+                0,                                            // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                view_mask,                        // viewMask
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                0,                                // colorAttachmentCount
+                nullptr,                          // colorAttachment
+                nullptr,                          // pResolveAttachments
+                &depth_attachment,                // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {{
+                 VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2_KHR,  // sType
+                 nullptr,                                     // pNext
+                 VK_SUBPASS_EXTERNAL,                         // srcSubpass
+                 0,                                           // dstSubpass
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,  // srcStageMask
+                 kDepthStages,                           // dstStageMask
+                 0,                                      // srcAccessMask
+                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                 // dstAccessMask
+                 0,  // dependencyFlags
+                 0   // viewOffset
+             },
+             {
+                 VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2_KHR,  // sType
+                 nullptr,                                     // pNext
+                 0,                                           // srcSubpass
+                 VK_SUBPASS_EXTERNAL,                         // dstSubpass
+                 kDepthStages,                                // srcStageMask
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,       // dstStageMask
+                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                 // srcAccessMask
+                 VK_ACCESS_SHADER_READ_BIT,  // dstAccessMask
+                 0,                          // dependencyFlags
+                 0                           // viewOffset
+             }},  // SubpassDependencies
+            1,    // correlatedViewMaskCount
+            &view_mask  // pCorrelatedViewMasks
+            ));
+  }
+
+  // Creates a view of |layer_count| layers of the depth image from
+  // |base_layer|, and a framebuffer of it with |framebuffer_layers|.
+  void CreateFramebuffer(VkImageViewType view_type, uint32_t base_layer,
+                         uint32_t layer_count, uint32_t framebuffer_layers) {
+    views_.push_back(application_->CreateImageView(
+        depth_image_.get(), view_type,
+        {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, base_layer, layer_count}));
+    ::VkImageView raw_view = *views_.back();
+
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        width_,                                     // width
+        height_,                                    // height
+        framebuffer_layers                          // layers
+    };
+    ::VkFramebuffer raw_framebuffer;
+    LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
+               application_->device()->vkCreateFramebuffer(
+                   application_->device(), &framebuffer_create_info, nullptr,
+                   &raw_framebuffer));
+    framebuffers_.push_back(containers::make_unique<VkFramebuffer>(
+        application_->GetAllocator(),
+        VkFramebuffer(raw_framebuffer, nullptr, &application_->device())));
+  }
+
+  VulkanApplication* application_;
+  Mode mode_;
+  uint32_t num_layers_;
+  uint32_t width_;
+  uint32_t height_;
+  // Declared before the image, so that the image is destroyed first.
+  containers::unique_ptr<VulkanArena> arena_;
+  containers::unique_ptr<VulkanApplication::Image> depth_image_;
+  containers::unique_ptr<VkImageView> sampled_view_;
+  containers::unique_ptr<VkRenderPass> render_pass_;
+  containers::vector<containers::unique_ptr<VkImageView>> views_;
+  containers::vector<containers::unique_ptr<VkFramebuffer>> framebuffers_;
+  containers::vector<containers::unique_ptr<VkCommandBuffer>>
+      command_buffers_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_OFFSCREEN_DEPTH_PASS_H_
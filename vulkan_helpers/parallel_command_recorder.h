@@ -0,0 +1,253 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_PARALLEL_COMMAND_RECORDER_H
+#define VULKAN_HELPERS_PARALLEL_COMMAND_RECORDER_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace vulkan {
+
+// ParallelCommandRecorder records secondary command buffers on a pool of
+// worker threads, and executes them from a primary command buffer.
+// Every worker has its own transient command pool for every frame, so the
+// workers never share a pool, and all of the command buffers of a frame are
+// reclaimed at once by resetting its pools.
+//
+// BeginFrame(i) must only be called once every command buffer that was
+// recorded for the previous use of frame i has finished on the GPU, i.e.
+// after waiting on that frame's fence.
+class ParallelCommandRecorder {
+ public:
+  using RecordFunction = std::function<void(size_t task, VkCommandBuffer* cmd)>;
+
+  ParallelCommandRecorder(VulkanApplication* application, size_t num_threads,
+                          size_t num_frames, uint32_t queue_family_index)
+      : application_(application),
+        contexts_(application->GetAllocator()),
+        threads_(application->GetAllocator()),
+        num_threads_(num_threads),
+        current_frame_(0),
+        record_(nullptr),
+        inheritance_(nullptr),
+        recorded_(nullptr),
+        num_tasks_(0),
+        next_task_(0),
+        num_busy_(0),
+        generation_(0),
+        exiting_(false) {
+    LOG_ASSERT(>, application_->GetLogger(), num_threads_, 0u);
+    for (size_t i = 0; i < num_threads_ * num_frames; ++i) {
+      contexts_.push_back(containers::make_unique<Context>(
+          application_->GetAllocator(), application_, queue_family_index));
+    }
+    for (size_t i = 0; i < num_threads_; ++i) {
+      threads_.push_back(std::thread([this, i]() { WorkerThread(i); }));
+    }
+  }
+
+  ~ParallelCommandRecorder() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exiting_ = true;
+    }
+    start_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t num_threads() const { return num_threads_; }
+
+  // Resets the command pools of |frame_index|, and makes it the frame that
+  // new command buffers are recorded for.
+  void BeginFrame(size_t frame_index) {
+    LOG_ASSERT(<, application_->GetLogger(), frame_index * num_threads_,
+               contexts_.size());
+    current_frame_ = frame_index;
+    for (size_t i = 0; i < num_threads_; ++i) {
+      contexts_[current_frame_ * num_threads_ + i]->Reset();
+    }
+  }
+
+  // Calls |record| once for every task in [0, num_tasks) on the worker
+  // threads. Each call gets its own secondary command buffer, which is
+  // already begun with |inheritance| and is ended once |record| returns. If
+  // inheritance.renderPass is not VK_NULL_HANDLE, the command buffers
+  // continue that render pass. Their commands are then executed from
+  // |primary| in task order, so |primary| must be inside the render pass, if
+  // there is one, begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+  // |record| must only touch state that is not shared between tasks.
+  void Record(VkCommandBuffer* primary,
+              const VkCommandBufferInheritanceInfo& inheritance,
+              size_t num_tasks, const RecordFunction& record) {
+    if (num_tasks == 0) {
+      return;
+    }
+    containers::vector<::VkCommandBuffer> recorded(
+        num_tasks, static_cast<::VkCommandBuffer>(VK_NULL_HANDLE),
+        application_->GetAllocator());
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      record_ = &record;
+      inheritance_ = &inheritance;
+      recorded_ = &recorded;
+      num_tasks_ = num_tasks;
+      next_task_ = 0;
+      num_busy_ = num_threads_;
+      ++generation_;
+      start_.notify_all();
+      done_.wait(lock, [this]() { return num_busy_ == 0; });
+      record_ = nullptr;
+      inheritance_ = nullptr;
+      recorded_ = nullptr;
+    }
+    (*primary)->vkCmdExecuteCommands(*primary,
+                                     static_cast<uint32_t>(recorded.size()),
+                                     recorded.data());
+  }
+
+ private:
+  // The command pool of one worker for one frame, and the command buffers
+  // that were allocated from it so far.
+  struct Context {
+    Context(VulkanApplication* application, uint32_t queue_family_index)
+        : device_(&application->device()),
+          pool_(CreatePool(device_,
+                           application->host_allocation_callbacks(),
+                           queue_family_index)),
+          command_buffers_(application->GetAllocator()),
+          num_used_(0) {}
+
+    static VkCommandPool CreatePool(VkDevice* device,
+                                    const VkAllocationCallbacks* callbacks,
+                                    uint32_t queue_family_index) {
+      VkCommandPoolCreateInfo info = {
+          VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,  // sType
+          nullptr,                                     // pNext
+          VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,        // flags
+          queue_family_index                           // queueFamilyIndex
+      };
+      ::VkCommandPool raw_pool;
+      LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
+                 (*device)->vkCreateCommandPool(*device, &info, callbacks,
+                                                &raw_pool));
+      return VkCommandPool(raw_pool, callbacks, device);
+    }
+
+    // Makes every command buffer of the pool available again.
+    void Reset() {
+      (*device_)->vkResetCommandPool(*device_, pool_, 0);
+      num_used_ = 0;
+    }
+
+    // Returns a secondary command buffer in the initial state.
+    VkCommandBuffer* Get() {
+      if (num_used_ == command_buffers_.size()) {
+        command_buffers_.push_back(CreateCommandBuffer(
+            &pool_, VK_COMMAND_BUFFER_LEVEL_SECONDARY, device_));
+      }
+      return &command_buffers_[num_used_++];
+    }
+
+    VkDevice* device_;
+    // The command buffers have to be freed before their pool.
+    VkCommandPool pool_;
+    containers::vector<VkCommandBuffer> command_buffers_;
+    size_t num_used_;
+  };
+
+  void WorkerThread(size_t thread_index) {
+    uint64_t generation = 0;
+    while (true) {
+      const RecordFunction* record;
+      const VkCommandBufferInheritanceInfo* inheritance;
+      containers::vector<::VkCommandBuffer>* recorded;
+      size_t num_tasks;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [this, generation]() {
+          return exiting_ || generation_ != generation;
+        });
+        if (exiting_) {
+          return;
+        }
+        generation = generation_;
+        record = record_;
+        inheritance = inheritance_;
+        recorded = recorded_;
+        num_tasks = num_tasks_;
+      }
+
+      Context* context =
+          contexts_[current_frame_ * num_threads_ + thread_index].get();
+      VkCommandBufferBeginInfo begin_info = {
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+          nullptr,                                      // pNext
+          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+          inheritance                                   // pInheritanceInfo
+      };
+      if (inheritance->renderPass != VK_NULL_HANDLE) {
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+      }
+      for (size_t task = next_task_++; task < num_tasks; task = next_task_++) {
+        VkCommandBuffer* cmd = context->Get();
+        (*cmd)->vkBeginCommandBuffer(*cmd, &begin_info);
+        (*record)(task, cmd);
+        (*cmd)->vkEndCommandBuffer(*cmd);
+        (*recorded)[task] = cmd->get_command_buffer();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--num_busy_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  VulkanApplication* application_;
+  // num_threads_ contexts for every frame, frame by frame.
+  containers::vector<containers::unique_ptr<Context>> contexts_;
+  containers::vector<std::thread> threads_;
+  size_t num_threads_;
+  size_t current_frame_;
+
+  // The work of the current Record call, guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const RecordFunction* record_;
+  const VkCommandBufferInheritanceInfo* inheritance_;
+  containers::vector<::VkCommandBuffer>* recorded_;
+  size_t num_tasks_;
+  // Workers take tasks from here without holding mutex_.
+  std::atomic<size_t> next_task_;
+  size_t num_busy_;
+  uint64_t generation_;
+  bool exiting_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_PARALLEL_COMMAND_RECORDER_H
@@ -0,0 +1,233 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_PERFORMANCE_COUNTERS_H
+#define VULKAN_HELPERS_PERFORMANCE_COUNTERS_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cctype>
+#include <cstdint>
+
+namespace vulkan {
+
+// PerformanceCounters chooses hardware counters of a queue family with
+// VK_KHR_performance_query, and holds the profiling lock for as long as it
+// exists, so that command buffers with performance queries can be recorded
+// and submitted at any time.
+//
+// By default the counters are the ones that measure percentages, such as
+// cache hit rates and ALU utilization, and bytes, such as memory traffic.
+// Only counters of VK_PERFORMANCE_COUNTER_SCOPE_COMMAND_KHR are chosen, so
+// that their queries may begin and end anywhere in a command buffer.
+//
+// If the device can not count all of them at once, the commands that are
+// measured have to be submitted num_passes() times, once with every
+// PassSubmitInfo(), before the results are available.
+//
+// The device must have been created with VK_KHR_performance_query and the
+// performanceCounterQueryPools feature.
+class PerformanceCounters {
+ public:
+  // The most counters that are chosen.
+  static const uint32_t kMaxCounters = 16;
+
+  // If |num_names| is not 0, the counters are the ones of which the name
+  // contains any of |names|, ignoring case, instead.
+  PerformanceCounters(VulkanApplication* application,
+                      uint32_t queue_family_index,
+                      const char* const* names = nullptr,
+                      uint32_t num_names = 0)
+      : application_(application),
+        counters_(application->GetAllocator()),
+        descriptions_(application->GetAllocator()),
+        indices_(application->GetAllocator()),
+        num_passes_(0),
+        locked_(false) {
+    create_info_ = {
+        VK_STRUCTURE_TYPE_QUERY_POOL_PERFORMANCE_CREATE_INFO_KHR,  // sType
+        nullptr,                                                   // pNext
+        queue_family_index,  // queueFamilyIndex
+        0,                   // counterIndexCount
+        nullptr              // pCounterIndices
+    };
+    VkInstance& instance = application_->instance();
+    ::VkPhysicalDevice physical_device =
+        application_->device().physical_device();
+    uint32_t num_counters = 0;
+    instance
+        ->vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR(
+            physical_device, queue_family_index, &num_counters, nullptr,
+            nullptr);
+    counters_.resize(num_counters,
+                     {VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_KHR, nullptr});
+    descriptions_.resize(
+        num_counters,
+        {VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_DESCRIPTION_KHR, nullptr});
+    instance
+        ->vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR(
+            physical_device, queue_family_index, &num_counters,
+            counters_.data(), descriptions_.data());
+
+    for (uint32_t i = 0; i < num_counters && indices_.size() < kMaxCounters;
+         ++i) {
+      if (counters_[i].scope != VK_PERFORMANCE_COUNTER_SCOPE_COMMAND_KHR) {
+        continue;
+      }
+      bool chosen = false;
+      if (num_names == 0) {
+        chosen =
+            counters_[i].unit == VK_PERFORMANCE_COUNTER_UNIT_PERCENTAGE_KHR ||
+            counters_[i].unit == VK_PERFORMANCE_COUNTER_UNIT_BYTES_KHR ||
+            counters_[i].unit ==
+                VK_PERFORMANCE_COUNTER_UNIT_BYTES_PER_SECOND_KHR;
+      }
+      for (uint32_t j = 0; j < num_names && !chosen; ++j) {
+        chosen = Contains(descriptions_[i].name, names[j]);
+      }
+      if (chosen) {
+        indices_.push_back(i);
+      }
+    }
+    if (indices_.empty()) {
+      application_->GetLogger()->LogInfo(
+          "The queue family has none of the performance counters");
+      return;
+    }
+    create_info_.counterIndexCount = static_cast<uint32_t>(indices_.size());
+    create_info_.pCounterIndices = indices_.data();
+    instance->vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR(
+        physical_device, &create_info_, &num_passes_);
+
+    VkAcquireProfilingLockInfoKHR lock_info = {
+        VK_STRUCTURE_TYPE_ACQUIRE_PROFILING_LOCK_INFO_KHR,  // sType
+        nullptr,                                            // pNext
+        0,                                                  // flags
+        UINT64_MAX                                          // timeout
+    };
+    if (application_->device()->vkAcquireProfilingLockKHR(
+            application_->device(), &lock_info) != VK_SUCCESS) {
+      application_->GetLogger()->LogError(
+          "Could not acquire the profiling lock, performance counters are "
+          "disabled");
+      indices_.clear();
+      create_info_.counterIndexCount = 0;
+      create_info_.pCounterIndices = nullptr;
+      num_passes_ = 0;
+      return;
+    }
+    locked_ = true;
+    for (uint32_t index : indices_) {
+      application_->GetLogger()->LogInfo(
+          "Performance counter: ", descriptions_[index].name, " (",
+          descriptions_[index].category, ")");
+    }
+    application_->GetLogger()->LogInfo(
+        "The performance counters need ", num_passes_, " passes");
+  }
+
+  ~PerformanceCounters() {
+    if (locked_) {
+      application_->device()->vkReleaseProfilingLockKHR(
+          application_->device());
+    }
+  }
+
+  // The number of counters that are counted, 0 if the device has none of
+  // them.
+  uint32_t num_counters() const {
+    return static_cast<uint32_t>(indices_.size());
+  }
+
+  // The number of times that the measured commands have to be submitted.
+  uint32_t num_passes() const { return num_passes_; }
+
+  // The name of the |i|th counter.
+  const char* name(uint32_t i) const {
+    return descriptions_[indices_[i]].name;
+  }
+
+  // The pNext of the VkQueryPoolCreateInfo of the performance queries.
+  const VkQueryPoolPerformanceCreateInfoKHR* create_info() const {
+    return &create_info_;
+  }
+
+  // The size of the results of one query.
+  size_t result_stride() const {
+    return indices_.size() * sizeof(VkPerformanceCounterResultKHR);
+  }
+
+  // Returns the |i|th counter of |result| as a double, whatever its
+  // storage.
+  double Value(uint32_t i, const VkPerformanceCounterResultKHR& result) const {
+    switch (counters_[indices_[i]].storage) {
+      case VK_PERFORMANCE_COUNTER_STORAGE_INT32_KHR:
+        return result.int32;
+      case VK_PERFORMANCE_COUNTER_STORAGE_INT64_KHR:
+        return static_cast<double>(result.int64);
+      case VK_PERFORMANCE_COUNTER_STORAGE_UINT32_KHR:
+        return result.uint32;
+      case VK_PERFORMANCE_COUNTER_STORAGE_UINT64_KHR:
+        return static_cast<double>(result.uint64);
+      case VK_PERFORMANCE_COUNTER_STORAGE_FLOAT32_KHR:
+        return result.float32;
+      default:
+        return result.float64;
+    }
+  }
+
+  // Returns the pNext of a VkSubmitInfo for |pass|, in front of |next|.
+  // Submits without it count pass 0.
+  VkPerformanceQuerySubmitInfoKHR PassSubmitInfo(
+      uint32_t pass, const void* next = nullptr) const {
+    return {
+        VK_STRUCTURE_TYPE_PERFORMANCE_QUERY_SUBMIT_INFO_KHR,  // sType
+        next,                                                 // pNext
+        pass  // counterPassIndex
+    };
+  }
+
+ private:
+  // Returns true if |text| contains |part|, ignoring case.
+  static bool Contains(const char* text, const char* part) {
+    for (; *text; ++text) {
+      size_t i = 0;
+      while (part[i] && text[i] &&
+             tolower(static_cast<unsigned char>(text[i])) ==
+                 tolower(static_cast<unsigned char>(part[i]))) {
+        ++i;
+      }
+      if (!part[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  VulkanApplication* application_;
+  containers::vector<VkPerformanceCounterKHR> counters_;
+  containers::vector<VkPerformanceCounterDescriptionKHR> descriptions_;
+  // The indices of the chosen counters in counters_.
+  containers::vector<uint32_t> indices_;
+  VkQueryPoolPerformanceCreateInfoKHR create_info_;
+  uint32_t num_passes_;
+  bool locked_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_PERFORMANCE_COUNTERS_H
@@ -0,0 +1,172 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_PIPELINE_COMPILER_H
+#define VULKAN_HELPERS_PIPELINE_COMPILER_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace vulkan {
+
+// PipelineCompiler runs pipeline creation on a pool of worker threads, so
+// that the pipelines of an application are compiled in parallel. Pipeline
+// caches are internally synchronized, but drivers serialize on that lock, so
+// jobs can use current_worker() to pick a cache of their own.
+class PipelineCompiler {
+ private:
+  struct Job {
+    Job(std::function<void()>&& function)
+        : function(std::move(function)), done(false) {}
+    std::function<void()> function;
+    bool done;
+  };
+
+ public:
+  // A handle to one job, that can be waited on. It stays valid until the
+  // compiler is destroyed.
+  class Handle {
+   public:
+    Handle() : compiler_(nullptr), job_(nullptr) {}
+
+    // Returns once the job has run. Does nothing for a default
+    // constructed handle.
+    void Wait() const {
+      if (compiler_) {
+        compiler_->Wait(job_);
+      }
+    }
+
+   private:
+    friend class PipelineCompiler;
+    Handle(PipelineCompiler* compiler, Job* job)
+        : compiler_(compiler), job_(job) {}
+
+    PipelineCompiler* compiler_;
+    Job* job_;
+  };
+
+  // If |num_threads| is 0, one worker is started per hardware thread.
+  PipelineCompiler(containers::Allocator* allocator, size_t num_threads = 0)
+      : allocator_(allocator),
+        jobs_(allocator),
+        threads_(allocator),
+        next_job_(0),
+        num_unfinished_(0),
+        exiting_(false) {
+    if (num_threads == 0) {
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads_.push_back(std::thread([this, i]() { WorkerThread(i); }));
+    }
+  }
+
+  ~PipelineCompiler() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exiting_ = true;
+    }
+    start_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Runs |job| on one of the worker threads.
+  Handle Submit(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(
+        containers::make_unique<Job>(allocator_, std::move(job)));
+    ++num_unfinished_;
+    start_.notify_one();
+    return Handle(this, jobs_.back().get());
+  }
+
+  // Returns once every job that was submitted so far has run.
+  void WaitAll() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return num_unfinished_ == 0; });
+  }
+
+  size_t num_threads() const { return threads_.size(); }
+
+  // Returns the index of the worker thread of this compiler that calls it,
+  // which is less than num_threads(), or kNotAWorker on any other thread.
+  size_t current_worker() const {
+    if (worker_owner() != this) {
+      return kNotAWorker;
+    }
+    return worker_index();
+  }
+  static const size_t kNotAWorker = ~size_t(0);
+
+ private:
+  static const PipelineCompiler*& worker_owner() {
+    static thread_local const PipelineCompiler* owner = nullptr;
+    return owner;
+  }
+  static size_t& worker_index() {
+    static thread_local size_t index = kNotAWorker;
+    return index;
+  }
+
+  void Wait(const Job* job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [job]() { return job->done; });
+  }
+
+  void WorkerThread(size_t index) {
+    worker_owner() = this;
+    worker_index() = index;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      start_.wait(lock,
+                  [this]() { return exiting_ || next_job_ < jobs_.size(); });
+      if (next_job_ == jobs_.size()) {
+        return;
+      }
+      Job* job = jobs_[next_job_++].get();
+      lock.unlock();
+      job->function();
+      lock.lock();
+      job->done = true;
+      --num_unfinished_;
+      done_.notify_all();
+    }
+  }
+
+  containers::Allocator* allocator_;
+  // Every job that was ever submitted, in order. Guarded by mutex_.
+  containers::vector<containers::unique_ptr<Job>> jobs_;
+  containers::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  // The index in jobs_ of the next job to run.
+  size_t next_job_;
+  size_t num_unfinished_;
+  bool exiting_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_PIPELINE_COMPILER_H
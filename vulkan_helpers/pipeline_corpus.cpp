@@ -0,0 +1,1022 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/pipeline_corpus.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include "support/log/log.h"
+#include "vulkan_helpers/asset_file.h"
+#include "vulkan_helpers/helper_functions.h"
+
+namespace vulkan {
+namespace {
+const uint32_t kCorpusVersion = 1;
+const uint32_t kGraphicsPipeline = 0;
+const uint32_t kComputePipeline = 1;
+// The flags that pipelines are pre-warmed with. Derivatives are created on
+// their own, since their parents are not recorded, and the capture flags of
+// -shader-stats only matter to the run that asked for them.
+const VkPipelineCreateFlags kReplayedFlags =
+    VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT |
+    VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+
+// 64 bit FNV-1a, the same hash as the one of ShaderModuleCache when it is
+// given the bytes of the code.
+uint64_t Hash(const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Appends values to serialized corpus data. Only types without padding or
+// pointers may be added.
+class CorpusWriter {
+ public:
+  explicit CorpusWriter(containers::vector<uint8_t>* data) : data_(data) {}
+
+  template <typename T>
+  void Add(const T& value) {
+    AddBytes(&value, sizeof(T));
+  }
+
+  // Adds |count| followed by the values.
+  template <typename T>
+  void AddArray(const T* values, size_t count) {
+    Add(static_cast<uint64_t>(count));
+    if (count) {
+      AddBytes(values, sizeof(T) * count);
+    }
+  }
+
+  void AddString(const char* string) { AddArray(string, strlen(string)); }
+
+  // Adds whether |state| is there, and returns it.
+  template <typename T>
+  bool AddOptional(const T* state) {
+    Add(static_cast<uint32_t>(state != nullptr));
+    return state != nullptr;
+  }
+
+ private:
+  void AddBytes(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    data_->insert(data_->end(), bytes, bytes + size);
+  }
+
+  containers::vector<uint8_t>* data_;
+};
+
+// Reads what CorpusWriter wrote. Once a read runs past the end of the data,
+// every read after it fails, and ok() returns false.
+class CorpusReader {
+ public:
+  CorpusReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), offset_(0), ok_(true) {}
+
+  template <typename T>
+  void Get(T* value) {
+    GetBytes(value, sizeof(T));
+  }
+
+  template <typename T>
+  T Get() {
+    T value;
+    Get(&value);
+    return value;
+  }
+
+  template <typename T>
+  void GetArray(containers::vector<T>* values) {
+    const uint64_t count = Get<uint64_t>();
+    if (!ok_ || count > (size_ - offset_) / sizeof(T)) {
+      ok_ = false;
+      values->clear();
+      return;
+    }
+    values->resize(static_cast<size_t>(count));
+    if (count) {
+      GetBytes(values->data(), sizeof(T) * values->size());
+    }
+  }
+
+  void GetString(containers::vector<char>* string) {
+    GetArray(string);
+    string->push_back('\0');
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  void GetBytes(void* data, size_t size) {
+    if (!ok_ || size > size_ - offset_) {
+      ok_ = false;
+      memset(data, 0, size);
+      return;
+    }
+    memcpy(data, data_ + offset_, size);
+    offset_ += size;
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_;
+  bool ok_;
+};
+
+void WriteRenderPass(const VkRenderPassCreateInfo& create_info,
+                     containers::vector<uint8_t>* data) {
+  CorpusWriter writer(data);
+  writer.Add(create_info.flags);
+  writer.AddArray(create_info.pAttachments, create_info.attachmentCount);
+  writer.Add(static_cast<uint64_t>(create_info.subpassCount));
+  for (uint32_t i = 0; i < create_info.subpassCount; ++i) {
+    const VkSubpassDescription& subpass = create_info.pSubpasses[i];
+    writer.Add(subpass.flags);
+    writer.Add(subpass.pipelineBindPoint);
+    writer.AddArray(subpass.pInputAttachments, subpass.inputAttachmentCount);
+    writer.AddArray(subpass.pColorAttachments, subpass.colorAttachmentCount);
+    writer.AddArray(subpass.pResolveAttachments,
+                    subpass.pResolveAttachments ? subpass.colorAttachmentCount
+                                                : 0);
+    writer.AddArray(subpass.pDepthStencilAttachment,
+                    subpass.pDepthStencilAttachment ? 1 : 0);
+    writer.AddArray(subpass.pPreserveAttachments,
+                    subpass.preserveAttachmentCount);
+  }
+  writer.AddArray(create_info.pDependencies, create_info.dependencyCount);
+}
+
+void WriteStage(CorpusWriter* writer,
+                const VkPipelineShaderStageCreateInfo& stage,
+                uint64_t shader_hash) {
+  writer->Add(stage.flags);
+  writer->Add(stage.stage);
+  writer->Add(shader_hash);
+  writer->AddString(stage.pName);
+  const VkSpecializationInfo* specialization = stage.pSpecializationInfo;
+  if (writer->AddOptional(specialization)) {
+    writer->Add(static_cast<uint64_t>(specialization->mapEntryCount));
+    for (uint32_t i = 0; i < specialization->mapEntryCount; ++i) {
+      const VkSpecializationMapEntry& entry = specialization->pMapEntries[i];
+      writer->Add(entry.constantID);
+      writer->Add(entry.offset);
+      writer->Add(static_cast<uint64_t>(entry.size));
+    }
+    writer->AddArray(static_cast<const uint8_t*>(specialization->pData),
+                     specialization->dataSize);
+  }
+}
+
+// Creates the pipelines of a corpus again. Everything that a pipeline is
+// created with only lives until the next one, other than the shader
+// modules, which are shared by many pipelines.
+class PipelineReplayer {
+ public:
+  PipelineReplayer(containers::Allocator* allocator, VkDevice* device,
+                   const containers::unordered_map<
+                       uint64_t, containers::vector<uint32_t>>& shaders)
+      : allocator_(allocator),
+        device_(device),
+        shaders_(shaders),
+        modules_(allocator),
+        set_layouts_(allocator),
+        layout_(VK_NULL_HANDLE),
+        render_pass_(VK_NULL_HANDLE),
+        stages_(allocator) {}
+
+  ~PipelineReplayer() {
+    DestroyObjects();
+    for (auto& module : modules_) {
+      (*device_)->vkDestroyShaderModule(*device_, module.second, nullptr);
+    }
+  }
+
+  // Creates the pipeline of |data| into |cache|, and destroys it again.
+  // Returns false if the data is invalid, or the pipeline could not be
+  // created.
+  bool Replay(const containers::vector<uint8_t>& data,
+              ::VkPipelineCache cache) {
+    CorpusReader reader(data.data(), data.size());
+    const uint32_t kind = reader.Get<uint32_t>();
+    bool created = false;
+    if (kind == kGraphicsPipeline) {
+      created = ReplayGraphics(&reader, cache);
+    } else if (kind == kComputePipeline) {
+      created = ReplayCompute(&reader, cache);
+    }
+    DestroyObjects();
+    return created;
+  }
+
+ private:
+  struct Stage {
+    explicit Stage(containers::Allocator* allocator)
+        : name(allocator), map_entries(allocator), data(allocator) {}
+    VkPipelineShaderStageCreateInfo create_info;
+    VkSpecializationInfo specialization;
+    containers::vector<char> name;
+    containers::vector<VkSpecializationMapEntry> map_entries;
+    containers::vector<uint8_t> data;
+  };
+
+  struct Subpass {
+    explicit Subpass(containers::Allocator* allocator)
+        : inputs(allocator),
+          colors(allocator),
+          resolves(allocator),
+          depth_stencil(allocator),
+          preserves(allocator) {}
+    containers::vector<VkAttachmentReference> inputs;
+    containers::vector<VkAttachmentReference> colors;
+    containers::vector<VkAttachmentReference> resolves;
+    containers::vector<VkAttachmentReference> depth_stencil;
+    containers::vector<uint32_t> preserves;
+  };
+
+  void DestroyObjects() {
+    if (render_pass_ != VK_NULL_HANDLE) {
+      (*device_)->vkDestroyRenderPass(*device_, render_pass_, nullptr);
+      render_pass_ = VK_NULL_HANDLE;
+    }
+    if (layout_ != VK_NULL_HANDLE) {
+      (*device_)->vkDestroyPipelineLayout(*device_, layout_, nullptr);
+      layout_ = VK_NULL_HANDLE;
+    }
+    for (::VkDescriptorSetLayout set_layout : set_layouts_) {
+      (*device_)->vkDestroyDescriptorSetLayout(*device_, set_layout, nullptr);
+    }
+    set_layouts_.clear();
+    stages_.clear();
+  }
+
+  // Returns the module of the shader with |hash|, or VK_NULL_HANDLE if the
+  // corpus does not have its code.
+  ::VkShaderModule GetModule(uint64_t hash) {
+    auto it = modules_.find(hash);
+    if (it != modules_.end()) {
+      return it->second;
+    }
+    auto code = shaders_.find(hash);
+    if (code == shaders_.end()) {
+      return VK_NULL_HANDLE;
+    }
+    VkShaderModuleCreateInfo create_info{
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,  // sType
+        nullptr,                                      // pNext
+        0,                                            // flags
+        code->second.size() * sizeof(uint32_t),       // codeSize
+        code->second.data()                           // pCode
+    };
+    ::VkShaderModule module = VK_NULL_HANDLE;
+    if ((*device_)->vkCreateShaderModule(*device_, &create_info, nullptr,
+                                         &module) != VK_SUCCESS) {
+      return VK_NULL_HANDLE;
+    }
+    modules_[hash] = module;
+    return module;
+  }
+
+  bool ReadRenderPass(CorpusReader* outer) {
+    containers::vector<uint8_t> data(allocator_);
+    outer->GetArray(&data);
+    CorpusReader reader(data.data(), data.size());
+    VkRenderPassCreateInfo create_info{
+        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        0,                                          // attachmentCount
+        nullptr,                                    // pAttachments
+        0,                                          // subpassCount
+        nullptr,                                    // pSubpasses
+        0,                                          // dependencyCount
+        nullptr,                                    // pDependencies
+    };
+    reader.Get(&create_info.flags);
+    containers::vector<VkAttachmentDescription> attachments(allocator_);
+    reader.GetArray(&attachments);
+    const uint64_t num_subpasses = reader.Get<uint64_t>();
+    if (!reader.ok() || num_subpasses > data.size()) {
+      return false;
+    }
+    containers::vector<Subpass> subpasses(allocator_);
+    subpasses.reserve(static_cast<size_t>(num_subpasses));
+    containers::vector<VkSubpassDescription> descriptions(allocator_);
+    for (uint64_t i = 0; i < num_subpasses; ++i) {
+      subpasses.emplace_back(allocator_);
+      Subpass& subpass = subpasses.back();
+      VkSubpassDescription description = {};
+      reader.Get(&description.flags);
+      reader.Get(&description.pipelineBindPoint);
+      reader.GetArray(&subpass.inputs);
+      reader.GetArray(&subpass.colors);
+      reader.GetArray(&subpass.resolves);
+      reader.GetArray(&subpass.depth_stencil);
+      reader.GetArray(&subpass.preserves);
+      description.inputAttachmentCount =
+          static_cast<uint32_t>(subpass.inputs.size());
+      description.pInputAttachments = subpass.inputs.data();
+      description.colorAttachmentCount =
+          static_cast<uint32_t>(subpass.colors.size());
+      description.pColorAttachments = subpass.colors.data();
+      description.pResolveAttachments =
+          subpass.resolves.empty() ? nullptr : subpass.resolves.data();
+      description.pDepthStencilAttachment =
+          subpass.depth_stencil.empty() ? nullptr
+                                        : subpass.depth_stencil.data();
+      description.preserveAttachmentCount =
+          static_cast<uint32_t>(subpass.preserves.size());
+      description.pPreserveAttachments = subpass.preserves.data();
+      descriptions.push_back(description);
+    }
+    containers::vector<VkSubpassDependency> dependencies(allocator_);
+    reader.GetArray(&dependencies);
+    if (!reader.ok()) {
+      return false;
+    }
+    create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+    create_info.pAttachments = attachments.data();
+    create_info.subpassCount = static_cast<uint32_t>(descriptions.size());
+    create_info.pSubpasses = descriptions.data();
+    create_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    create_info.pDependencies = dependencies.data();
+    return (*device_)->vkCreateRenderPass(*device_, &create_info, nullptr,
+                                          &render_pass_) == VK_SUCCESS;
+  }
+
+  bool ReadLayout(CorpusReader* outer) {
+    containers::vector<uint8_t> data(allocator_);
+    outer->GetArray(&data);
+    CorpusReader reader(data.data(), data.size());
+    const uint64_t num_sets = reader.Get<uint64_t>();
+    if (!reader.ok() || num_sets > data.size()) {
+      return false;
+    }
+    containers::vector<VkDescriptorSetLayoutBinding> bindings(allocator_);
+    for (uint64_t i = 0; i < num_sets; ++i) {
+      VkDescriptorSetLayoutCreateInfo create_info{
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,  // sType
+          nullptr,                                              // pNext
+          0,                                                    // flags
+          0,                                                    // bindingCount
+          nullptr                                               // pBindings
+      };
+      reader.Get(&create_info.flags);
+      const uint64_t num_bindings = reader.Get<uint64_t>();
+      if (!reader.ok() || num_bindings > data.size()) {
+        return false;
+      }
+      bindings.clear();
+      for (uint64_t j = 0; j < num_bindings; ++j) {
+        VkDescriptorSetLayoutBinding binding = {};
+        reader.Get(&binding.binding);
+        reader.Get(&binding.descriptorType);
+        reader.Get(&binding.descriptorCount);
+        reader.Get(&binding.stageFlags);
+        bindings.push_back(binding);
+      }
+      if (!reader.ok()) {
+        return false;
+      }
+      create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+      create_info.pBindings = bindings.data();
+      ::VkDescriptorSetLayout set_layout;
+      if ((*device_)->vkCreateDescriptorSetLayout(
+              *device_, &create_info, nullptr, &set_layout) != VK_SUCCESS) {
+        return false;
+      }
+      set_layouts_.push_back(set_layout);
+    }
+    containers::vector<VkPushConstantRange> ranges(allocator_);
+    reader.GetArray(&ranges);
+    if (!reader.ok()) {
+      return false;
+    }
+    VkPipelineLayoutCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,  // sType
+        nullptr,                                        // pNext
+        0,                                              // flags
+        static_cast<uint32_t>(set_layouts_.size()),     // setLayoutCount
+        set_layouts_.data(),                            // pSetLayouts
+        static_cast<uint32_t>(ranges.size()),  // pushConstantRangeCount
+        ranges.data(),                         // pPushConstantRanges
+    };
+    return (*device_)->vkCreatePipelineLayout(*device_, &create_info, nullptr,
+                                              &layout_) == VK_SUCCESS;
+  }
+
+  bool ReadStage(CorpusReader* reader) {
+    stages_.emplace_back(allocator_);
+    Stage& stage = stages_.back();
+    stage.create_info = {
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+        nullptr,                                              // pNext
+        0,                                                    // flags
+        VK_SHADER_STAGE_VERTEX_BIT,                           // stage
+        VK_NULL_HANDLE,                                       // module
+        nullptr,                                              // pName
+        nullptr  // pSpecializationInfo
+    };
+    reader->Get(&stage.create_info.flags);
+    reader->Get(&stage.create_info.stage);
+    const uint64_t shader_hash = reader->Get<uint64_t>();
+    reader->GetString(&stage.name);
+    if (reader->Get<uint32_t>()) {
+      const uint64_t num_entries = reader->Get<uint64_t>();
+      for (uint64_t i = 0; reader->ok() && i < num_entries; ++i) {
+        VkSpecializationMapEntry entry;
+        reader->Get(&entry.constantID);
+        reader->Get(&entry.offset);
+        entry.size = static_cast<size_t>(reader->Get<uint64_t>());
+        stage.map_entries.push_back(entry);
+      }
+      reader->GetArray(&stage.data);
+      stage.specialization = {
+          static_cast<uint32_t>(stage.map_entries.size()),  // mapEntryCount
+          stage.map_entries.data(),                         // pMapEntries
+          stage.data.size(),                                // dataSize
+          stage.data.data()                                 // pData
+      };
+      stage.create_info.pSpecializationInfo = &stage.specialization;
+    }
+    stage.create_info.pName = stage.name.data();
+    if (!reader->ok()) {
+      return false;
+    }
+    stage.create_info.module = GetModule(shader_hash);
+    return stage.create_info.module != VK_NULL_HANDLE;
+  }
+
+  bool ReplayGraphics(CorpusReader* reader, ::VkPipelineCache cache) {
+    const VkPipelineCreateFlags flags = reader->Get<VkPipelineCreateFlags>();
+    if (!ReadRenderPass(reader)) {
+      return false;
+    }
+    const uint32_t subpass = reader->Get<uint32_t>();
+    if (!ReadLayout(reader)) {
+      return false;
+    }
+    const uint64_t num_stages = reader->Get<uint64_t>();
+    if (!reader->ok() || num_stages > 8) {
+      return false;
+    }
+    stages_.reserve(static_cast<size_t>(num_stages));
+    for (uint64_t i = 0; i < num_stages; ++i) {
+      if (!ReadStage(reader)) {
+        return false;
+      }
+    }
+    containers::vector<VkPipelineShaderStageCreateInfo> stages(allocator_);
+    for (const Stage& stage : stages_) {
+      stages.push_back(stage.create_info);
+    }
+
+    VkGraphicsPipelineCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.flags = flags;
+    create_info.stageCount = static_cast<uint32_t>(stages.size());
+    create_info.pStages = stages.data();
+    create_info.layout = layout_;
+    create_info.renderPass = render_pass_;
+    create_info.subpass = subpass;
+    create_info.basePipelineIndex = -1;
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    containers::vector<VkVertexInputBindingDescription> vertex_bindings(
+        allocator_);
+    containers::vector<VkVertexInputAttributeDescription> vertex_attributes(
+        allocator_);
+    if (reader->Get<uint32_t>()) {
+      vertex_input.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+      reader->GetArray(&vertex_bindings);
+      reader->GetArray(&vertex_attributes);
+      vertex_input.vertexBindingDescriptionCount =
+          static_cast<uint32_t>(vertex_bindings.size());
+      vertex_input.pVertexBindingDescriptions = vertex_bindings.data();
+      vertex_input.vertexAttributeDescriptionCount =
+          static_cast<uint32_t>(vertex_attributes.size());
+      vertex_input.pVertexAttributeDescriptions = vertex_attributes.data();
+      create_info.pVertexInputState = &vertex_input;
+    }
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    if (reader->Get<uint32_t>()) {
+      input_assembly.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+      reader->Get(&input_assembly.topology);
+      reader->Get(&input_assembly.primitiveRestartEnable);
+      create_info.pInputAssemblyState = &input_assembly;
+    }
+
+    VkPipelineTessellationStateCreateInfo tessellation = {};
+    if (reader->Get<uint32_t>()) {
+      tessellation.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
+      reader->Get(&tessellation.patchControlPoints);
+      create_info.pTessellationState = &tessellation;
+    }
+
+    VkPipelineViewportStateCreateInfo viewport = {};
+    containers::vector<VkViewport> viewports(allocator_);
+    containers::vector<VkRect2D> scissors(allocator_);
+    if (reader->Get<uint32_t>()) {
+      viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+      reader->Get(&viewport.viewportCount);
+      reader->Get(&viewport.scissorCount);
+      reader->GetArray(&viewports);
+      reader->GetArray(&scissors);
+      viewport.pViewports = viewports.empty() ? nullptr : viewports.data();
+      viewport.pScissors = scissors.empty() ? nullptr : scissors.data();
+      create_info.pViewportState = &viewport;
+    }
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    if (reader->Get<uint32_t>()) {
+      rasterization.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+      reader->Get(&rasterization.depthClampEnable);
+      reader->Get(&rasterization.rasterizerDiscardEnable);
+      reader->Get(&rasterization.polygonMode);
+      reader->Get(&rasterization.cullMode);
+      reader->Get(&rasterization.frontFace);
+      reader->Get(&rasterization.depthBiasEnable);
+      reader->Get(&rasterization.depthBiasConstantFactor);
+      reader->Get(&rasterization.depthBiasClamp);
+      reader->Get(&rasterization.depthBiasSlopeFactor);
+      reader->Get(&rasterization.lineWidth);
+      create_info.pRasterizationState = &rasterization;
+    }
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    containers::vector<VkSampleMask> sample_mask(allocator_);
+    if (reader->Get<uint32_t>()) {
+      multisample.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+      reader->Get(&multisample.rasterizationSamples);
+      reader->Get(&multisample.sampleShadingEnable);
+      reader->Get(&multisample.minSampleShading);
+      reader->GetArray(&sample_mask);
+      reader->Get(&multisample.alphaToCoverageEnable);
+      reader->Get(&multisample.alphaToOneEnable);
+      multisample.pSampleMask =
+          sample_mask.empty() ? nullptr : sample_mask.data();
+      create_info.pMultisampleState = &multisample;
+    }
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    if (reader->Get<uint32_t>()) {
+      depth_stencil.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+      reader->Get(&depth_stencil.depthTestEnable);
+      reader->Get(&depth_stencil.depthWriteEnable);
+      reader->Get(&depth_stencil.depthCompareOp);
+      reader->Get(&depth_stencil.depthBoundsTestEnable);
+      reader->Get(&depth_stencil.stencilTestEnable);
+      reader->Get(&depth_stencil.front);
+      reader->Get(&depth_stencil.back);
+      reader->Get(&depth_stencil.minDepthBounds);
+      reader->Get(&depth_stencil.maxDepthBounds);
+      create_info.pDepthStencilState = &depth_stencil;
+    }
+
+    VkPipelineColorBlendStateCreateInfo color_blend = {};
+    containers::vector<VkPipelineColorBlendAttachmentState> blend_attachments(
+        allocator_);
+    if (reader->Get<uint32_t>()) {
+      color_blend.sType =
+          VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+      reader->Get(&color_blend.logicOpEnable);
+      reader->Get(&color_blend.logicOp);
+      reader->GetArray(&blend_attachments);
+      reader->Get(&color_blend.blendConstants);
+      color_blend.attachmentCount =
+          static_cast<uint32_t>(blend_attachments.size());
+      color_blend.pAttachments = blend_attachments.data();
+      create_info.pColorBlendState = &color_blend;
+    }
+
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    containers::vector<VkDynamicState> dynamic_states(allocator_);
+    if (reader->Get<uint32_t>()) {
+      dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+      reader->GetArray(&dynamic_states);
+      dynamic.dynamicStateCount =
+          static_cast<uint32_t>(dynamic_states.size());
+      dynamic.pDynamicStates = dynamic_states.data();
+      create_info.pDynamicState = &dynamic;
+    }
+
+    if (!reader->ok()) {
+      return false;
+    }
+    ::VkPipeline pipeline;
+    if ((*device_)->vkCreateGraphicsPipelines(*device_, cache, 1, &create_info,
+                                              nullptr, &pipeline) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    (*device_)->vkDestroyPipeline(*device_, pipeline, nullptr);
+    return true;
+  }
+
+  bool ReplayCompute(CorpusReader* reader, ::VkPipelineCache cache) {
+    const VkPipelineCreateFlags flags = reader->Get<VkPipelineCreateFlags>();
+    if (!ReadLayout(reader) || !ReadStage(reader)) {
+      return false;
+    }
+    VkComputePipelineCreateInfo create_info{
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,  // sType
+        nullptr,                                         // pNext
+        flags,                                           // flags
+        stages_.back().create_info,                      // stage
+        layout_,                                         // layout
+        VK_NULL_HANDLE,                                  // basePipelineHandle
+        -1,                                              // basePipelineIndex
+    };
+    ::VkPipeline pipeline;
+    if ((*device_)->vkCreateComputePipelines(*device_, cache, 1, &create_info,
+                                             nullptr, &pipeline) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    (*device_)->vkDestroyPipeline(*device_, pipeline, nullptr);
+    return true;
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  const containers::unordered_map<uint64_t, containers::vector<uint32_t>>&
+      shaders_;
+  containers::unordered_map<uint64_t, ::VkShaderModule> modules_;
+  // The objects of the pipeline that is being created.
+  containers::vector<::VkDescriptorSetLayout> set_layouts_;
+  ::VkPipelineLayout layout_;
+  ::VkRenderPass render_pass_;
+  containers::vector<Stage> stages_;
+};
+}  // anonymous namespace
+
+PipelineCorpus::PipelineCorpus(containers::Allocator* allocator,
+                               VkDevice* device)
+    : allocator_(allocator),
+      device_(device),
+      render_passes_(allocator),
+      layouts_(allocator),
+      loaded_(allocator),
+      recorded_(allocator),
+      stop_prewarm_(false) {}
+
+PipelineCorpus::~PipelineCorpus() { StopPrewarm(); }
+
+void PipelineCorpus::AddRenderPass(::VkRenderPass render_pass,
+                                   const VkRenderPassCreateInfo& create_info) {
+  if (create_info.pNext) {
+    ForgetRenderPass(render_pass);
+    return;
+  }
+  containers::vector<uint8_t> data(allocator_);
+  WriteRenderPass(create_info, &data);
+  std::lock_guard<std::mutex> lock(mutex_);
+  render_passes_.erase(render_pass);
+  render_passes_.emplace(render_pass, std::move(data));
+}
+
+void PipelineCorpus::ForgetRenderPass(::VkRenderPass render_pass) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  render_passes_.erase(render_pass);
+}
+
+void PipelineCorpus::AddPipelineLayout(
+    ::VkPipelineLayout layout, const SetBindings& set_bindings,
+    const containers::vector<VkDescriptorSetLayoutCreateFlags>& set_flags,
+    std::initializer_list<VkPushConstantRange> ranges) {
+  containers::vector<uint8_t> data(allocator_);
+  CorpusWriter writer(&data);
+  writer.Add(static_cast<uint64_t>(set_bindings.size()));
+  for (size_t i = 0; i < set_bindings.size(); ++i) {
+    writer.Add(set_flags[i]);
+    writer.Add(static_cast<uint64_t>(set_bindings[i].size()));
+    for (const VkDescriptorSetLayoutBinding& binding : set_bindings[i]) {
+      // The samplers would have to be described as well.
+      if (binding.pImmutableSamplers) {
+        ForgetPipelineLayout(layout);
+        return;
+      }
+      writer.Add(binding.binding);
+      writer.Add(binding.descriptorType);
+      writer.Add(binding.descriptorCount);
+      writer.Add(binding.stageFlags);
+    }
+  }
+  writer.AddArray(ranges.begin(), ranges.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  layouts_.erase(layout);
+  layouts_.emplace(layout, std::move(data));
+}
+
+void PipelineCorpus::ForgetPipelineLayout(::VkPipelineLayout layout) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  layouts_.erase(layout);
+}
+
+uint64_t PipelineCorpus::AddShader(const ShaderModuleCache::Handle& module) {
+  const uint64_t hash =
+      Hash(module.code(), module.num_words() * sizeof(uint32_t));
+  if (recorded_.shaders.find(hash) == recorded_.shaders.end()) {
+    recorded_.shaders.emplace(
+        hash, containers::vector<uint32_t>(
+                  module.code(), module.code() + module.num_words(),
+                  allocator_));
+  }
+  return hash;
+}
+
+void PipelineCorpus::AddPipeline(containers::vector<uint8_t>* data) {
+  const uint64_t hash = Hash(data->data(), data->size());
+  if (recorded_.pipelines.find(hash) == recorded_.pipelines.end()) {
+    recorded_.pipelines.emplace(hash, std::move(*data));
+  }
+}
+
+void PipelineCorpus::RecordGraphicsPipeline(
+    const VkGraphicsPipelineCreateInfo& create_info,
+    const ShaderModuleCache::Handle* modules) {
+  for (uint32_t i = 0; i < create_info.stageCount; ++i) {
+    if (!modules[i].code()) {
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto render_pass = render_passes_.find(create_info.renderPass);
+  auto layout = layouts_.find(create_info.layout);
+  if (render_pass == render_passes_.end() || layout == layouts_.end()) {
+    return;
+  }
+  containers::vector<uint8_t> data(allocator_);
+  CorpusWriter writer(&data);
+  writer.Add(kGraphicsPipeline);
+  writer.Add(create_info.flags & kReplayedFlags);
+  writer.AddArray(render_pass->second.data(), render_pass->second.size());
+  writer.Add(create_info.subpass);
+  writer.AddArray(layout->second.data(), layout->second.size());
+  writer.Add(static_cast<uint64_t>(create_info.stageCount));
+  for (uint32_t i = 0; i < create_info.stageCount; ++i) {
+    WriteStage(&writer, create_info.pStages[i], AddShader(modules[i]));
+  }
+
+  if (writer.AddOptional(create_info.pVertexInputState)) {
+    const VkPipelineVertexInputStateCreateInfo& state =
+        *create_info.pVertexInputState;
+    writer.AddArray(state.pVertexBindingDescriptions,
+                    state.vertexBindingDescriptionCount);
+    writer.AddArray(state.pVertexAttributeDescriptions,
+                    state.vertexAttributeDescriptionCount);
+  }
+  if (writer.AddOptional(create_info.pInputAssemblyState)) {
+    writer.Add(create_info.pInputAssemblyState->topology);
+    writer.Add(create_info.pInputAssemblyState->primitiveRestartEnable);
+  }
+  if (writer.AddOptional(create_info.pTessellationState)) {
+    writer.Add(create_info.pTessellationState->patchControlPoints);
+  }
+  if (writer.AddOptional(create_info.pViewportState)) {
+    const VkPipelineViewportStateCreateInfo& state =
+        *create_info.pViewportState;
+    writer.Add(state.viewportCount);
+    writer.Add(state.scissorCount);
+    writer.AddArray(state.pViewports,
+                    state.pViewports ? state.viewportCount : 0);
+    writer.AddArray(state.pScissors, state.pScissors ? state.scissorCount : 0);
+  }
+  if (writer.AddOptional(create_info.pRasterizationState)) {
+    const VkPipelineRasterizationStateCreateInfo& state =
+        *create_info.pRasterizationState;
+    writer.Add(state.depthClampEnable);
+    writer.Add(state.rasterizerDiscardEnable);
+    writer.Add(state.polygonMode);
+    writer.Add(state.cullMode);
+    writer.Add(state.frontFace);
+    writer.Add(state.depthBiasEnable);
+    writer.Add(state.depthBiasConstantFactor);
+    writer.Add(state.depthBiasClamp);
+    writer.Add(state.depthBiasSlopeFactor);
+    writer.Add(state.lineWidth);
+  }
+  if (writer.AddOptional(create_info.pMultisampleState)) {
+    const VkPipelineMultisampleStateCreateInfo& state =
+        *create_info.pMultisampleState;
+    writer.Add(state.rasterizationSamples);
+    writer.Add(state.sampleShadingEnable);
+    writer.Add(state.minSampleShading);
+    writer.AddArray(state.pSampleMask,
+                    state.pSampleMask
+                        ? (state.rasterizationSamples + 31) / 32
+                        : 0);
+    writer.Add(state.alphaToCoverageEnable);
+    writer.Add(state.alphaToOneEnable);
+  }
+  if (writer.AddOptional(create_info.pDepthStencilState)) {
+    const VkPipelineDepthStencilStateCreateInfo& state =
+        *create_info.pDepthStencilState;
+    writer.Add(state.depthTestEnable);
+    writer.Add(state.depthWriteEnable);
+    writer.Add(state.depthCompareOp);
+    writer.Add(state.depthBoundsTestEnable);
+    writer.Add(state.stencilTestEnable);
+    writer.Add(state.front);
+    writer.Add(state.back);
+    writer.Add(state.minDepthBounds);
+    writer.Add(state.maxDepthBounds);
+  }
+  if (writer.AddOptional(create_info.pColorBlendState)) {
+    const VkPipelineColorBlendStateCreateInfo& state =
+        *create_info.pColorBlendState;
+    writer.Add(state.logicOpEnable);
+    writer.Add(state.logicOp);
+    writer.AddArray(state.pAttachments, state.attachmentCount);
+    writer.Add(state.blendConstants);
+  }
+  if (writer.AddOptional(create_info.pDynamicState)) {
+    writer.AddArray(create_info.pDynamicState->pDynamicStates,
+                    create_info.pDynamicState->dynamicStateCount);
+  }
+  AddPipeline(&data);
+}
+
+void PipelineCorpus::RecordComputePipeline(
+    const VkComputePipelineCreateInfo& create_info,
+    const ShaderModuleCache::Handle& module) {
+  if (!module.code()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto layout = layouts_.find(create_info.layout);
+  if (layout == layouts_.end()) {
+    return;
+  }
+  containers::vector<uint8_t> data(allocator_);
+  CorpusWriter writer(&data);
+  writer.Add(kComputePipeline);
+  writer.Add(create_info.flags & kReplayedFlags);
+  writer.AddArray(layout->second.data(), layout->second.size());
+  WriteStage(&writer, create_info.stage, AddShader(module));
+  AddPipeline(&data);
+}
+
+bool PipelineCorpus::Load(const char* filename) {
+  logging::Logger* log = device_->GetLogger();
+  if (!std::ifstream(filename, std::ios::binary).is_open()) {
+    log->LogInfo("No pipeline corpus at \"", filename, "\"");
+    return false;
+  }
+  AssetFile file(allocator_, log, filename);
+  if (!file.is_valid() || !file.has_section(kAssetPipelineCorpus)) {
+    log->LogInfo("Ignoring pipeline corpus \"", filename,
+                 "\", it is not a pipeline corpus file");
+    return false;
+  }
+  CorpusReader reader(file.section(kAssetPipelineCorpus),
+                      file.section_size(kAssetPipelineCorpus));
+  Corpus corpus(allocator_);
+  bool valid = reader.Get<uint32_t>() == kCorpusVersion;
+  const uint64_t num_shaders = reader.Get<uint64_t>();
+  for (uint64_t i = 0; valid && reader.ok() && i < num_shaders; ++i) {
+    const uint64_t hash = reader.Get<uint64_t>();
+    containers::vector<uint32_t> code(allocator_);
+    reader.GetArray(&code);
+    corpus.shaders.emplace(hash, std::move(code));
+  }
+  const uint64_t num_pipelines = reader.Get<uint64_t>();
+  for (uint64_t i = 0; valid && reader.ok() && i < num_pipelines; ++i) {
+    containers::vector<uint8_t> data(allocator_);
+    reader.GetArray(&data);
+    const uint64_t hash = Hash(data.data(), data.size());
+    corpus.pipelines.emplace(hash, std::move(data));
+  }
+  if (!valid || !reader.ok()) {
+    log->LogInfo("Ignoring pipeline corpus \"", filename,
+                 "\", it is truncated or from another version");
+    return false;
+  }
+  loaded_.shaders.swap(corpus.shaders);
+  loaded_.pipelines.swap(corpus.pipelines);
+  log->LogInfo("Loaded [", loaded_.pipelines.size(),
+               "] pipelines from pipeline corpus \"", filename, "\"");
+  return true;
+}
+
+void PipelineCorpus::Write(const char* filename) {
+  // Pre-warming reads loaded_, which is written out as well.
+  StopPrewarm();
+  std::lock_guard<std::mutex> lock(mutex_);
+  containers::vector<uint8_t> data(allocator_);
+  CorpusWriter writer(&data);
+  writer.Add(kCorpusVersion);
+
+  size_t num_shaders = loaded_.shaders.size();
+  for (const auto& shader : recorded_.shaders) {
+    num_shaders += loaded_.shaders.count(shader.first) ? 0 : 1;
+  }
+  writer.Add(static_cast<uint64_t>(num_shaders));
+  for (const auto& shader : loaded_.shaders) {
+    writer.Add(shader.first);
+    writer.AddArray(shader.second.data(), shader.second.size());
+  }
+  for (const auto& shader : recorded_.shaders) {
+    if (!loaded_.shaders.count(shader.first)) {
+      writer.Add(shader.first);
+      writer.AddArray(shader.second.data(), shader.second.size());
+    }
+  }
+
+  size_t num_pipelines = loaded_.pipelines.size();
+  for (const auto& pipeline : recorded_.pipelines) {
+    num_pipelines += loaded_.pipelines.count(pipeline.first) ? 0 : 1;
+  }
+  writer.Add(static_cast<uint64_t>(num_pipelines));
+  for (const auto& pipeline : loaded_.pipelines) {
+    writer.AddArray(pipeline.second.data(), pipeline.second.size());
+  }
+  for (const auto& pipeline : recorded_.pipelines) {
+    if (!loaded_.pipelines.count(pipeline.first)) {
+      writer.AddArray(pipeline.second.data(), pipeline.second.size());
+    }
+  }
+
+  std::vector<uint8_t> file;
+  EncodeAssetFile(kAssetPipelineCorpus, data.data(), data.size(), true,
+                  &file);
+  if (WriteFileAtomically(device_->GetLogger(), filename, file.data(),
+                          file.size())) {
+    device_->GetLogger()->LogInfo("Wrote [", num_pipelines,
+                                  "] pipelines to pipeline corpus \"",
+                                  filename, "\"");
+  }
+}
+
+void PipelineCorpus::StartPrewarm(::VkPipelineCache cache) {
+  if (loaded_.pipelines.empty() || prewarm_thread_.joinable()) {
+    return;
+  }
+  stop_prewarm_ = false;
+  prewarm_thread_ = std::thread([this, cache]() { Prewarm(cache); });
+}
+
+void PipelineCorpus::StopPrewarm() {
+  stop_prewarm_ = true;
+  if (prewarm_thread_.joinable()) {
+    prewarm_thread_.join();
+  }
+}
+
+void PipelineCorpus::Prewarm(::VkPipelineCache cache) {
+  const auto start = std::chrono::steady_clock::now();
+  PipelineReplayer replayer(allocator_, device_, loaded_.shaders);
+  size_t num_created = 0;
+  size_t num_skipped = 0;
+  size_t num_failed = 0;
+  for (const auto& pipeline : loaded_.pipelines) {
+    if (stop_prewarm_) {
+      break;
+    }
+    {
+      // The application created it already.
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (recorded_.pipelines.count(pipeline.first)) {
+        ++num_skipped;
+        continue;
+      }
+    }
+    if (replayer.Replay(pipeline.second, cache)) {
+      ++num_created;
+    } else {
+      ++num_failed;
+    }
+  }
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  device_->GetLogger()->LogInfo(
+      "Pre-warmed [", num_created, "] pipelines from the pipeline corpus in [",
+      elapsed.count(), "] ms, [", num_skipped, "] were already created, [",
+      num_failed, "] failed");
+}
+
+}  // namespace vulkan
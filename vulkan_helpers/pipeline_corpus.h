@@ -0,0 +1,126 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_PIPELINE_CORPUS_H
+#define VULKAN_HELPERS_PIPELINE_CORPUS_H
+
+#include "support/containers/unordered_map.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/shader_module_cache.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+
+namespace vulkan {
+
+// PipelineCorpus records the state of every pipeline that an application
+// creates, with the SPIR-V of its shaders keyed by their hashes, so that a
+// later run can create all of them into its pipeline cache in the
+// background before they are needed. The first use of a pipeline is then a
+// cache hit instead of a compile in the middle of a frame.
+//
+// Pipelines refer to their layout and render pass by handle, so those are
+// described to the corpus when they are created. Pipelines with extension
+// structures, and layouts or render passes that can not be described, e.g.
+// with immutable samplers or from VkRenderPassCreateInfo2, are not
+// recorded. Recording may happen on any thread.
+class PipelineCorpus {
+ public:
+  PipelineCorpus(containers::Allocator* allocator, VkDevice* device);
+  // Stops pre-warming, if it is still running.
+  ~PipelineCorpus();
+
+  PipelineCorpus(const PipelineCorpus&) = delete;
+  PipelineCorpus& operator=(const PipelineCorpus&) = delete;
+
+  // The bindings of every set of a pipeline layout.
+  using SetBindings =
+      containers::vector<containers::vector<VkDescriptorSetLayoutBinding>>;
+
+  // Describes the render pass and pipeline layout that |render_pass| and
+  // |layout| were created from. Forgetting them means that the pipelines
+  // that use them are not recorded.
+  void AddRenderPass(::VkRenderPass render_pass,
+                     const VkRenderPassCreateInfo& create_info);
+  void ForgetRenderPass(::VkRenderPass render_pass);
+  void AddPipelineLayout(
+      ::VkPipelineLayout layout, const SetBindings& set_bindings,
+      const containers::vector<VkDescriptorSetLayoutCreateFlags>& set_flags,
+      std::initializer_list<VkPushConstantRange> ranges);
+  void ForgetPipelineLayout(::VkPipelineLayout layout);
+
+  // Records a pipeline that was created from |create_info|. |modules| are
+  // the modules of create_info.pStages, in the same order. The pNext chain
+  // of |create_info| is ignored.
+  void RecordGraphicsPipeline(const VkGraphicsPipelineCreateInfo& create_info,
+                              const ShaderModuleCache::Handle* modules);
+  void RecordComputePipeline(const VkComputePipelineCreateInfo& create_info,
+                             const ShaderModuleCache::Handle& module);
+
+  // Loads the pipelines of an earlier run from |filename|. A missing or
+  // invalid file leaves the corpus empty. Returns false in that case.
+  bool Load(const char* filename);
+  // Writes every pipeline that was loaded or recorded to |filename|. The
+  // file is replaced atomically, failures are logged but not fatal.
+  void Write(const char* filename);
+
+  // Starts creating every loaded pipeline that was not recorded yet in this
+  // run into |cache|, on a thread of its own. Each one is destroyed right
+  // away, only the cache keeps the result.
+  void StartPrewarm(::VkPipelineCache cache);
+  // Stops pre-warming after the pipeline that is being created, and waits
+  // for its thread.
+  void StopPrewarm();
+
+ private:
+  struct Corpus {
+    explicit Corpus(containers::Allocator* allocator)
+        : shaders(allocator), pipelines(allocator) {}
+    // The SPIR-V of every shader, by its hash.
+    containers::unordered_map<uint64_t, containers::vector<uint32_t>> shaders;
+    // The serialized pipelines, by the hash of their data.
+    containers::unordered_map<uint64_t, containers::vector<uint8_t>>
+        pipelines;
+  };
+
+  // Adds the code of |module| to recorded_ and returns its hash.
+  uint64_t AddShader(const ShaderModuleCache::Handle& module);
+  void AddPipeline(containers::vector<uint8_t>* data);
+  void Prewarm(::VkPipelineCache cache);
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  std::mutex mutex_;
+  // The descriptions of the render passes and layouts that are alive.
+  // Guarded by mutex_.
+  containers::unordered_map<::VkRenderPass, containers::vector<uint8_t>>
+      render_passes_;
+  containers::unordered_map<::VkPipelineLayout, containers::vector<uint8_t>>
+      layouts_;
+  // What was read by Load. It does not change once pre-warming started.
+  Corpus loaded_;
+  // What this run created. Guarded by mutex_.
+  Corpus recorded_;
+  std::thread prewarm_thread_;
+  std::atomic<bool> stop_prewarm_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_PIPELINE_CORPUS_H
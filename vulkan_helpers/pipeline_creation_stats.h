@@ -0,0 +1,234 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_PIPELINE_CREATION_STATS_H
+#define VULKAN_HELPERS_PIPELINE_CREATION_STATS_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/vulkan_header_wrapper.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+
+namespace vulkan {
+
+// PipelineCreationStats collects the VK_EXT_pipeline_creation_feedback
+// results of every pipeline that an application creates, so that the total
+// compile time and the pipeline cache hit rate can be reported on exit.
+// Pipelines may be recorded from any thread.
+class PipelineCreationStats {
+ public:
+  // The most stages that are recorded for one pipeline, the rest are only
+  // part of the duration of the pipeline.
+  static const uint32_t kMaxStages = 6;
+
+  struct Stage {
+    VkShaderStageFlagBits stage;
+    // 0 if the driver did not report the stage.
+    uint64_t duration_ns;
+    bool cache_hit;
+  };
+
+  struct Pipeline {
+    // "graphics" or "compute".
+    const char* kind;
+    // The order that the pipeline was recorded in.
+    uint32_t index;
+    // False if the driver did not report the pipeline, it is then left out
+    // of the times and the hit rate.
+    bool valid;
+    uint64_t duration_ns;
+    bool cache_hit;
+    uint32_t num_stages;
+    Stage stages[kMaxStages];
+  };
+
+  // Feedback holds the feedback structures of one pipeline creation. If the
+  // pNext chain of the pipeline already asks for feedback, that is read
+  // back instead, since the structure may only be in the chain once.
+  class Feedback {
+   public:
+    Feedback(containers::Allocator* allocator, const void* next,
+             uint32_t num_stages)
+        : stage_feedback_(allocator), create_info_(nullptr) {
+      for (const VkBaseInStructure* s =
+               static_cast<const VkBaseInStructure*>(next);
+           s; s = s->pNext) {
+        if (s->sType ==
+            VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT) {
+          create_info_ =
+              reinterpret_cast<const VkPipelineCreationFeedbackCreateInfoEXT*>(
+                  s);
+          break;
+        }
+      }
+      own_create_info_ = {
+          VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+          next,            // pNext
+          &own_feedback_,  // pPipelineCreationFeedback
+          num_stages,      // pipelineStageCreationFeedbackCount
+          nullptr          // pPipelineStageCreationFeedbacks
+      };
+      own_feedback_ = {};
+      if (!create_info_) {
+        stage_feedback_.resize(num_stages, VkPipelineCreationFeedbackEXT{});
+        own_create_info_.pPipelineStageCreationFeedbacks =
+            stage_feedback_.data();
+      }
+    }
+
+    // The pNext chain to create the pipeline with.
+    const void* next() const {
+      return create_info_ ? own_create_info_.pNext : &own_create_info_;
+    }
+
+    // Adds the feedback of the created pipeline, with the given stages, to
+    // |stats|.
+    void Record(PipelineCreationStats* stats, const char* kind,
+                const VkPipelineShaderStageCreateInfo* stages,
+                uint32_t num_stages) const {
+      const VkPipelineCreationFeedbackCreateInfoEXT* info =
+          create_info_ ? create_info_ : &own_create_info_;
+      stats->Record(kind, stages,
+                    std::min(num_stages,
+                             info->pipelineStageCreationFeedbackCount),
+                    *info->pPipelineCreationFeedback,
+                    info->pPipelineStageCreationFeedbacks);
+    }
+
+   private:
+    containers::vector<VkPipelineCreationFeedbackEXT> stage_feedback_;
+    VkPipelineCreationFeedbackEXT own_feedback_;
+    VkPipelineCreationFeedbackCreateInfoEXT own_create_info_;
+    // The structure that was already in the chain, if any.
+    const VkPipelineCreationFeedbackCreateInfoEXT* create_info_;
+  };
+
+  PipelineCreationStats(containers::Allocator* allocator)
+      : allocator_(allocator), pipelines_(allocator) {}
+
+  // Records one pipeline. Pipelines whose feedback is not valid are counted,
+  // but do not add to the times or the hit rate.
+  void Record(const char* kind, const VkPipelineShaderStageCreateInfo* stages,
+              uint32_t num_stages,
+              const VkPipelineCreationFeedbackEXT& feedback,
+              const VkPipelineCreationFeedbackEXT* stage_feedback) {
+    Pipeline pipeline = {};
+    pipeline.kind = kind;
+    pipeline.valid = IsValid(feedback);
+    if (pipeline.valid) {
+      pipeline.duration_ns = feedback.duration;
+      pipeline.cache_hit = IsCacheHit(feedback);
+    }
+    pipeline.num_stages = num_stages < kMaxStages ? num_stages : kMaxStages;
+    for (uint32_t i = 0; i < pipeline.num_stages; ++i) {
+      Stage& stage = pipeline.stages[i];
+      stage.stage = stages[i].stage;
+      if (IsValid(stage_feedback[i])) {
+        stage.duration_ns = stage_feedback[i].duration;
+        stage.cache_hit = IsCacheHit(stage_feedback[i]);
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    pipeline.index = static_cast<uint32_t>(pipelines_.size());
+    pipelines_.push_back(pipeline);
+  }
+
+  // Logs the total compile time and cache hit rate as a single line of
+  // space separated key=value pairs after "PIPELINES:", followed by one
+  // "PIPELINE:" line for each of the |num_slowest| slowest pipelines.
+  void LogSummary(logging::Logger* log, size_t num_slowest = 5) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total_ns = 0;
+    size_t num_valid = 0;
+    size_t num_hits = 0;
+    for (const Pipeline& pipeline : pipelines_) {
+      total_ns += pipeline.duration_ns;
+      num_valid += pipeline.valid ? 1 : 0;
+      num_hits += pipeline.cache_hit ? 1 : 0;
+    }
+    log->LogInfo("PIPELINES: count=", pipelines_.size(),
+                 " with_feedback=", num_valid,
+                 " total_ms=", total_ns / 1000000.0,
+                 " cache_hits=", num_hits, " hit_rate=",
+                 num_valid == 0 ? 0.0 : double(num_hits) / num_valid);
+
+    containers::vector<const Pipeline*> sorted(allocator_);
+    for (const Pipeline& pipeline : pipelines_) {
+      if (pipeline.valid) {
+        sorted.push_back(&pipeline);
+      }
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Pipeline* a, const Pipeline* b) {
+                return a->duration_ns > b->duration_ns;
+              });
+    for (size_t i = 0; i < sorted.size() && i < num_slowest; ++i) {
+      const Pipeline& pipeline = *sorted[i];
+      std::ostringstream stages;
+      for (uint32_t j = 0; j < pipeline.num_stages; ++j) {
+        const Stage& stage = pipeline.stages[j];
+        stages << " " << StageName(stage.stage)
+               << "_ms=" << stage.duration_ns / 1000000.0 << " "
+               << StageName(stage.stage) << "_hit=" << stage.cache_hit;
+      }
+      log->LogInfo("PIPELINE: ", pipeline.kind, "_", pipeline.index,
+                   " ms=", pipeline.duration_ns / 1000000.0,
+                   " hit=", pipeline.cache_hit, stages.str());
+    }
+  }
+
+ private:
+  static bool IsValid(const VkPipelineCreationFeedbackEXT& feedback) {
+    return (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) != 0;
+  }
+
+  static bool IsCacheHit(const VkPipelineCreationFeedbackEXT& feedback) {
+    const VkPipelineCreationFeedbackFlagsEXT kCacheHit =
+        VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT;
+    return (feedback.flags & kCacheHit) != 0;
+  }
+
+  static const char* StageName(VkShaderStageFlagBits stage) {
+    switch (stage) {
+      case VK_SHADER_STAGE_VERTEX_BIT:
+        return "vertex";
+      case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+        return "tess_control";
+      case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+        return "tess_evaluation";
+      case VK_SHADER_STAGE_GEOMETRY_BIT:
+        return "geometry";
+      case VK_SHADER_STAGE_FRAGMENT_BIT:
+        return "fragment";
+      case VK_SHADER_STAGE_COMPUTE_BIT:
+        return "compute";
+      default:
+        return "other";
+    }
+  }
+
+  containers::Allocator* allocator_;
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  containers::vector<Pipeline> pipelines_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_PIPELINE_CREATION_STATS_H
@@ -0,0 +1,194 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_PIPELINE_OBJECT_CACHE_H
+#define VULKAN_HELPERS_PIPELINE_OBJECT_CACHE_H
+
+#include "support/containers/flat_hash_map.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+
+namespace vulkan {
+
+// PipelineObjectCache shares one ::VkPipeline between all pipelines that are
+// created from the same state. The state is described by a key of bytes
+// that the caller serializes, and pipelines are destroyed once the last
+// handle to them is released. It may be used from any thread, a pipeline
+// that is being created by one thread is waited for by the others.
+class PipelineObjectCache {
+ private:
+  struct Entry {
+    Entry(containers::Allocator* allocator, uint64_t hash)
+        : key(allocator),
+          hash(hash),
+          pipeline(VK_NULL_HANDLE),
+          references(1),
+          ready(false) {}
+    containers::vector<uint8_t> key;
+    uint64_t hash;
+    ::VkPipeline pipeline;
+    // Guarded by the mutex of the cache.
+    uint32_t references;
+    bool ready;
+  };
+
+ public:
+  // A reference counted handle to a pipeline of the cache.
+  class Handle {
+   public:
+    Handle() : cache_(nullptr), entry_(nullptr) {}
+    Handle(const Handle& other) : cache_(other.cache_), entry_(other.entry_) {
+      if (entry_) {
+        cache_->AddReference(entry_);
+      }
+    }
+    Handle(Handle&& other) : cache_(other.cache_), entry_(other.entry_) {
+      other.cache_ = nullptr;
+      other.entry_ = nullptr;
+    }
+    Handle& operator=(Handle other) {
+      std::swap(cache_, other.cache_);
+      std::swap(entry_, other.entry_);
+      return *this;
+    }
+    ~Handle() {
+      if (entry_) {
+        cache_->Release(entry_);
+      }
+    }
+
+    operator ::VkPipeline() const {
+      return entry_ ? entry_->pipeline : VK_NULL_HANDLE;
+    }
+
+   private:
+    friend class PipelineObjectCache;
+    Handle(PipelineObjectCache* cache, Entry* entry)
+        : cache_(cache), entry_(entry) {}
+
+    PipelineObjectCache* cache_;
+    Entry* entry_;
+  };
+
+  PipelineObjectCache(containers::Allocator* allocator, VkDevice* device)
+      : allocator_(allocator),
+        device_(device),
+        entries_(allocator),
+        num_hits_(0) {}
+
+  ~PipelineObjectCache() {
+    // Handles should not outlive the cache, but the pipelines of any that
+    // do are not leaked.
+    for (auto& entry : entries_) {
+      (*device_)->vkDestroyPipeline(*device_, entry.second->pipeline,
+                                    nullptr);
+    }
+  }
+
+  // Returns a handle to the pipeline for |key|, calling |create| to create
+  // it if no handle to it is alive.
+  Handle Get(const containers::vector<uint8_t>& key,
+             const std::function<::VkPipeline()>& create) {
+    const uint64_t hash = Hash(key);
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = entries_.find(hash);
+    if (it != entries_.end()) {
+      Entry* entry = it->second.get();
+      if (entry->key != key) {
+        // A collision, the pipeline that is already cached is kept.
+        lock.unlock();
+        return CreateUncached(create);
+      }
+      ++entry->references;
+      ++num_hits_;
+      ready_.wait(lock, [entry]() { return entry->ready; });
+      return Handle(this, entry);
+    }
+    Entry* entry = allocator_->construct<Entry>(allocator_, hash);
+    entry->key = key;
+    entries_[hash] = containers::unique_ptr<Entry>(
+        entry, containers::UniqueDeleter(allocator_, sizeof(Entry)));
+    lock.unlock();
+
+    ::VkPipeline pipeline = create();
+    lock.lock();
+    entry->pipeline = pipeline;
+    entry->ready = true;
+    ready_.notify_all();
+    return Handle(this, entry);
+  }
+
+  // Returns a handle to a pipeline that is not shared.
+  Handle CreateUncached(const std::function<::VkPipeline()>& create) {
+    Entry* entry = allocator_->construct<Entry>(allocator_, 0);
+    entry->pipeline = create();
+    entry->ready = true;
+    return Handle(this, entry);
+  }
+
+  // The number of pipelines that were shared instead of created.
+  uint64_t num_hits() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_hits_;
+  }
+
+ private:
+  // 64 bit FNV-1a over the bytes of the key.
+  static uint64_t Hash(const containers::vector<uint8_t>& key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint8_t byte : key) {
+      hash = (hash ^ byte) * 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  void AddReference(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++entry->references;
+  }
+
+  void Release(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--entry->references != 0) {
+      return;
+    }
+    (*device_)->vkDestroyPipeline(*device_, entry->pipeline, nullptr);
+    auto it = entries_.find(entry->hash);
+    if (it != entries_.end() && it->second.get() == entry) {
+      entries_.erase(it);
+    } else {
+      allocator_->destroy(entry);
+    }
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  // Guarded by mutex_.
+  containers::flat_hash_map<uint64_t, containers::unique_ptr<Entry>> entries_;
+  uint64_t num_hits_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_PIPELINE_OBJECT_CACHE_H
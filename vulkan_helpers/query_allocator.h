@@ -0,0 +1,262 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_QUERY_ALLOCATOR_H
+#define VULKAN_HELPERS_QUERY_ALLOCATOR_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace vulkan {
+
+// A range of consecutive queries of one query pool.
+struct QueryRange {
+  ::VkQueryPool pool;
+  uint32_t first_query;
+  uint32_t num_queries;
+
+  // Returns the index in |pool| of the |i|th query of the range.
+  uint32_t query(uint32_t i) const { return first_query + i; }
+};
+
+// QueryAllocator hands out ranges of queries from a few large query pools,
+// one set of pools for every query type, instead of a pool for every user.
+// The results of a whole range are read with a single
+// vkGetQueryPoolResults, or copied with a single vkCmdCopyQueryPoolResults.
+//
+// If |host_query_reset| is true, the device must have been created with the
+// hostQueryReset feature. New pools, and ranges that are freed, are then
+// reset from the host, so every range that Allocate() returns is ready to
+// be used. Otherwise the range has to be reset with RecordReset() before
+// each use, outside of a render pass.
+class QueryAllocator {
+ public:
+  // Every pool holds at least |queries_per_pool| queries.
+  QueryAllocator(VulkanApplication* application, bool host_query_reset,
+                 uint32_t queries_per_pool = 1024)
+      : application_(application),
+        pools_(application->GetAllocator()),
+        host_query_reset_(host_query_reset),
+        queries_per_pool_(queries_per_pool) {}
+
+  // Returns |num_queries| consecutive queries of |type|. Pipeline statistics
+  // queries only share pools with the same |pipeline_statistics|, and
+  // performance queries only with the same |performance| counters.
+  QueryRange Allocate(
+      VkQueryType type, uint32_t num_queries,
+      VkQueryPipelineStatisticFlags pipeline_statistics = 0,
+      const VkQueryPoolPerformanceCreateInfoKHR* performance = nullptr) {
+    for (auto& pool : pools_) {
+      if (!pool->Matches(type, pipeline_statistics, performance)) {
+        continue;
+      }
+      // First fit, the free ranges are sorted by their first query.
+      for (size_t i = 0; i < pool->free_ranges.size(); ++i) {
+        FreeRange& free_range = pool->free_ranges[i];
+        if (free_range.num_queries < num_queries) {
+          continue;
+        }
+        QueryRange range{pool->pool, free_range.first_query, num_queries};
+        free_range.first_query += num_queries;
+        free_range.num_queries -= num_queries;
+        if (free_range.num_queries == 0) {
+          pool->free_ranges.erase(pool->free_ranges.begin() + i);
+        }
+        return range;
+      }
+    }
+
+    const uint32_t pool_size =
+        num_queries > queries_per_pool_ ? num_queries : queries_per_pool_;
+    pools_.push_back(containers::make_unique<Pool>(
+        application_->GetAllocator(), application_, type, pool_size,
+        pipeline_statistics, performance));
+    Pool* pool = pools_.back().get();
+    if (host_query_reset_) {
+      application_->device()->vkResetQueryPoolEXT(application_->device(),
+                                                  pool->pool, 0, pool_size);
+    }
+    if (pool_size > num_queries) {
+      pool->free_ranges.push_back(
+          FreeRange{num_queries, pool_size - num_queries});
+    }
+    return QueryRange{pool->pool, 0, num_queries};
+  }
+
+  // Gives |range| back to its pool. The device must be done with it. With
+  // host query reset, the range is reset here.
+  void Free(const QueryRange& range) {
+    if (host_query_reset_) {
+      application_->device()->vkResetQueryPoolEXT(
+          application_->device(), range.pool, range.first_query,
+          range.num_queries);
+    }
+    for (auto& pool : pools_) {
+      if (pool->pool != range.pool) {
+        continue;
+      }
+      containers::vector<FreeRange>& free_ranges = pool->free_ranges;
+      size_t i = 0;
+      while (i < free_ranges.size() &&
+             free_ranges[i].first_query < range.first_query) {
+        ++i;
+      }
+      free_ranges.insert(free_ranges.begin() + i,
+                         FreeRange{range.first_query, range.num_queries});
+      // Merge with the neighbouring free ranges.
+      if (i + 1 < free_ranges.size() &&
+          free_ranges[i].first_query + free_ranges[i].num_queries ==
+              free_ranges[i + 1].first_query) {
+        free_ranges[i].num_queries += free_ranges[i + 1].num_queries;
+        free_ranges.erase(free_ranges.begin() + i + 1);
+      }
+      if (i > 0 && free_ranges[i - 1].first_query +
+                           free_ranges[i - 1].num_queries ==
+                       free_ranges[i].first_query) {
+        free_ranges[i - 1].num_queries += free_ranges[i].num_queries;
+        free_ranges.erase(free_ranges.begin() + i);
+      }
+      return;
+    }
+    LOG_CRASH(application_->GetLogger(),
+              "The query range was not allocated from this allocator");
+  }
+
+  // Records the reset of |num_queries| queries of |range|, starting at
+  // |first|, into |cmd|, which must not be in a render pass.
+  void RecordReset(VkCommandBuffer* cmd, const QueryRange& range,
+                   uint32_t first = 0, uint32_t num_queries = ~0u) const {
+    (*cmd)->vkCmdResetQueryPool(*cmd, range.pool, range.query(first),
+                                Clamp(range, first, num_queries));
+  }
+
+  // Resets |num_queries| queries of |range|, starting at |first|, from the
+  // host. The device must be done with them.
+  void ResetOnHost(const QueryRange& range, uint32_t first = 0,
+                   uint32_t num_queries = ~0u) const {
+    LOG_ASSERT(==, application_->GetLogger(), true, host_query_reset_);
+    application_->device()->vkResetQueryPoolEXT(
+        application_->device(), range.pool, range.query(first),
+        Clamp(range, first, num_queries));
+  }
+
+  // Reads the results of |num_queries| queries of |range|, starting at
+  // |first|, with a single vkGetQueryPoolResults. |results| must hold
+  // |stride| bytes for every query.
+  VkResult GetResults(const QueryRange& range, void* results,
+                      ::VkDeviceSize stride, VkQueryResultFlags flags,
+                      uint32_t first = 0, uint32_t num_queries = ~0u) const {
+    num_queries = Clamp(range, first, num_queries);
+    return application_->device()->vkGetQueryPoolResults(
+        application_->device(), range.pool, range.query(first), num_queries,
+        static_cast<size_t>(stride * num_queries), results, stride, flags);
+  }
+
+  // Records the copy of the results of |num_queries| queries of |range|,
+  // starting at |first|, to |buffer| at |offset| into |cmd|, with a single
+  // vkCmdCopyQueryPoolResults.
+  void RecordCopyResults(VkCommandBuffer* cmd, const QueryRange& range,
+                         ::VkBuffer buffer, ::VkDeviceSize offset,
+                         ::VkDeviceSize stride, VkQueryResultFlags flags,
+                         uint32_t first = 0,
+                         uint32_t num_queries = ~0u) const {
+    (*cmd)->vkCmdCopyQueryPoolResults(*cmd, range.pool, range.query(first),
+                                      Clamp(range, first, num_queries), buffer,
+                                      offset, stride, flags);
+  }
+
+  // Returns the number of query pools that were created.
+  size_t num_pools() const { return pools_.size(); }
+
+ private:
+  struct FreeRange {
+    uint32_t first_query;
+    uint32_t num_queries;
+  };
+
+  struct Pool {
+    Pool(VulkanApplication* application, VkQueryType type,
+         uint32_t num_queries,
+         VkQueryPipelineStatisticFlags pipeline_statistics,
+         const VkQueryPoolPerformanceCreateInfoKHR* performance)
+        : pool(CreateQueryPool(
+              &application->device(),
+              {
+                  VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+                  performance,                               // pNext
+                  0,                                         // flags
+                  type,                                      // queryType
+                  num_queries,                               // queryCount
+                  pipeline_statistics  // pipelineStatistics
+              })),
+          type(type),
+          pipeline_statistics(pipeline_statistics),
+          queue_family_index(performance ? performance->queueFamilyIndex : 0),
+          counter_indices(application->GetAllocator()),
+          free_ranges(application->GetAllocator()) {
+      if (performance) {
+        counter_indices.assign(
+            performance->pCounterIndices,
+            performance->pCounterIndices + performance->counterIndexCount);
+      }
+    }
+
+    bool Matches(VkQueryType query_type,
+                 VkQueryPipelineStatisticFlags statistics,
+                 const VkQueryPoolPerformanceCreateInfoKHR* performance) const {
+      if (type != query_type || pipeline_statistics != statistics) {
+        return false;
+      }
+      if (!performance) {
+        return counter_indices.empty();
+      }
+      return queue_family_index == performance->queueFamilyIndex &&
+             counter_indices.size() == performance->counterIndexCount &&
+             std::equal(counter_indices.begin(), counter_indices.end(),
+                        performance->pCounterIndices);
+    }
+
+    VkQueryPool pool;
+    VkQueryType type;
+    VkQueryPipelineStatisticFlags pipeline_statistics;
+    // The counters of performance query pools.
+    uint32_t queue_family_index;
+    containers::vector<uint32_t> counter_indices;
+    // Sorted by their first query, and never adjacent to each other.
+    containers::vector<FreeRange> free_ranges;
+  };
+
+  // Returns how many of the queries of |range| from |first| on are covered
+  // by |num_queries|.
+  static uint32_t Clamp(const QueryRange& range, uint32_t first,
+                        uint32_t num_queries) {
+    const uint32_t left = range.num_queries - first;
+    return num_queries < left ? num_queries : left;
+  }
+
+  VulkanApplication* application_;
+  containers::vector<containers::unique_ptr<Pool>> pools_;
+  bool host_query_reset_;
+  uint32_t queries_per_pool_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_QUERY_ALLOCATOR_H
@@ -0,0 +1,273 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_RADIX_SORT_H_
+#define VULKAN_HELPERS_RADIX_SORT_H_
+
+#include "support/containers/unique_ptr.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/structure_chain.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cstdint>
+
+namespace vulkan {
+
+// RadixSort sorts 32-bit keys, each with a 32-bit value, on the GPU. It is a
+// stable LSD radix sort with 8 bits per pass, and every pass is a count, a
+// scan and a scatter dispatch, see shader_library/sort/radix_sort.glsl.
+// Keys that are floats sort as unsigned integers if they are not negative.
+//
+// The shaders are sort/radix_sort_count.comp, sort/radix_sort_scan.comp and
+// either sort/radix_sort_scatter.comp, or
+// sort/radix_sort_scatter_subgroup.comp from shader_library_subgroup if
+// SubgroupsSupported(), which the application adds to its SHADERS, e.g.
+//   uint32_t sort_count_shader[] =
+//   #include "sort/radix_sort_count.comp.spv"
+//       ;
+//
+// The application writes the keys and the values to keys() and values(),
+// e.g. from a compute shader, and records
+//   sort.Sort(&cmd, num_keys);
+// after which keys() and values() are sorted by key. The buffers are shared
+// by all frames, so every frame has to be sorted on the same queue.
+class RadixSort {
+ public:
+  // These must match sort/radix_sort.glsl.
+  static const uint32_t kGroupSize = 256;
+  static const uint32_t kNumBuckets = 256;
+  static const uint32_t kTileSize = 1024;
+  static const uint32_t kBitsPerPass = 8;
+  static const uint32_t kNumPasses = 32 / kBitsPerPass;
+
+  // Up to |max_keys| keys can be sorted at once.
+  template <size_t C, size_t S, size_t P>
+  RadixSort(VulkanApplication* application, uint32_t max_keys,
+            uint32_t (&count_shader)[C], uint32_t (&scan_shader)[S],
+            uint32_t (&scatter_shader)[P])
+      : RadixSort(application, max_keys, count_shader, C, scan_shader, S,
+                  scatter_shader, P) {}
+
+  RadixSort(VulkanApplication* application, uint32_t max_keys,
+            uint32_t* count_shader, size_t count_shader_words,
+            uint32_t* scan_shader, size_t scan_shader_words,
+            uint32_t* scatter_shader, size_t scatter_shader_words)
+      : application_(application), max_keys_(max_keys) {
+    containers::Allocator* allocator = application_->GetAllocator();
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    const VkDeviceSize size = max_keys_ * sizeof(uint32_t);
+    for (size_t i = 0; i < 2; ++i) {
+      keys_[i] =
+          application_->CreateAndBindDefaultExclusiveDeviceBuffer(size, usage);
+      values_[i] =
+          application_->CreateAndBindDefaultExclusiveDeviceBuffer(size, usage);
+    }
+    // The counts of every tile, and the offsets of the buckets after them.
+    const uint32_t max_tiles = (max_keys_ + kTileSize - 1) / kTileSize;
+    counts_ = application_->CreateAndBindDefaultExclusiveDeviceBuffer(
+        (max_tiles + 1) * kNumBuckets * sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    for (uint32_t i = 0; i < 5; ++i) {
+      bindings_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+    VkPushConstantRange range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,  // stageFlags
+        0,                            // offset
+        sizeof(SortData)              // size
+    };
+    pipeline_layout_ = containers::make_unique<PipelineLayout>(
+        allocator, application_->CreatePipelineLayout(
+                       {{bindings_[0], bindings_[1], bindings_[2],
+                         bindings_[3], bindings_[4]}},
+                       {range}));
+    count_pipeline_ = CreatePipeline(count_shader, count_shader_words);
+    scan_pipeline_ = CreatePipeline(scan_shader, scan_shader_words);
+    scatter_pipeline_ = CreatePipeline(scatter_shader, scatter_shader_words);
+
+    // The even passes move the keys from the first buffers to the second
+    // ones, and the odd passes move them back.
+    for (size_t i = 0; i < 2; ++i) {
+      sets_[i] = containers::make_unique<DescriptorSet>(
+          allocator,
+          application_->AllocateDescriptorSet({bindings_[0], bindings_[1],
+                                               bindings_[2], bindings_[3],
+                                               bindings_[4]}));
+      VkDescriptorBufferInfo buffer_infos[5] = {
+          {*keys_[i], 0, VK_WHOLE_SIZE},
+          {*values_[i], 0, VK_WHOLE_SIZE},
+          {*keys_[1 - i], 0, VK_WHOLE_SIZE},
+          {*values_[1 - i], 0, VK_WHOLE_SIZE},
+          {*counts_, 0, VK_WHOLE_SIZE},
+      };
+      VkWriteDescriptorSet write = {
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+          nullptr,                                 // pNext
+          *sets_[i],                               // dstSet
+          0,                                       // dstbinding
+          0,                                       // dstArrayElement
+          5,                                       // descriptorCount
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+          nullptr,                                 // pImageInfo
+          buffer_infos,                            // pBufferInfo
+          nullptr,                                 // pTexelBufferView
+      };
+      application_->device()->vkUpdateDescriptorSets(application_->device(),
+                                                     1, &write, 0, nullptr);
+    }
+  }
+
+  // Returns true if the device can run
+  // sort/radix_sort_scatter_subgroup.comp: a Vulkan 1.1 device with
+  // subgroup ballots in compute shaders, and subgroups of at least 32
+  // invocations. The instance needs VK_KHR_get_physical_device_properties2.
+  static bool SubgroupsSupported(VulkanApplication* application) {
+    StructureChain<VkPhysicalDeviceProperties2,
+                   VkPhysicalDeviceSubgroupProperties>
+        properties;
+    application->instance()->vkGetPhysicalDeviceProperties2KHR(
+        application->device().physical_device(), properties.head());
+    const VkPhysicalDeviceSubgroupProperties& subgroup_properties =
+        properties.get<VkPhysicalDeviceSubgroupProperties>();
+    const VkSubgroupFeatureFlags operations =
+        VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    return properties.head()->properties.apiVersion >= VK_API_VERSION_1_1 &&
+           (subgroup_properties.supportedStages &
+            VK_SHADER_STAGE_COMPUTE_BIT) &&
+           (subgroup_properties.supportedOperations & operations) ==
+               operations &&
+           subgroup_properties.subgroupSize >= 32 &&
+           subgroup_properties.subgroupSize <= kGroupSize;
+  }
+
+  // The keys and values that Sort() sorts. Writes to them have to be made
+  // available to compute shaders before Sort() is recorded, which the
+  // barrier at the start of Sort() does for compute shader and transfer
+  // writes.
+  VulkanApplication::Buffer* keys() const { return keys_[0].get(); }
+  VulkanApplication::Buffer* values() const { return values_[0].get(); }
+
+  // Records the sort of the first |num_keys| keys and values. This must be
+  // recorded outside of a render pass. Afterwards, the sorted keys and
+  // values are visible to compute shaders.
+  void Sort(VkCommandBuffer* cmd, uint32_t num_keys) {
+    LOG_ASSERT(<=, application_->GetLogger(), num_keys, max_keys_);
+    VkCommandBuffer& cmdBuffer = *cmd;
+    Barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    if (num_keys == 0) {
+      return;
+    }
+    const uint32_t num_tiles = (num_keys + kTileSize - 1) / kTileSize;
+    for (uint32_t pass = 0; pass < kNumPasses; ++pass) {
+      SortData data = {
+          num_keys,              // num_keys
+          pass * kBitsPerPass,   // shift
+          num_tiles,             // num_tiles
+      };
+      cmdBuffer->vkCmdBindDescriptorSets(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+          ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+          &sets_[pass % 2]->raw_set(), 0, nullptr);
+      cmdBuffer->vkCmdPushConstants(
+          cmdBuffer, ::VkPipelineLayout(*pipeline_layout_),
+          VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(data), &data);
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *count_pipeline_);
+      cmdBuffer->vkCmdDispatch(cmdBuffer, num_tiles, 1, 1);
+      Barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT);
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *scan_pipeline_);
+      cmdBuffer->vkCmdDispatch(cmdBuffer, 1, 1, 1);
+      Barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT);
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   *scatter_pipeline_);
+      cmdBuffer->vkCmdDispatch(cmdBuffer, num_tiles, 1, 1);
+      Barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT);
+    }
+  }
+
+  uint32_t max_keys() const { return max_keys_; }
+
+ private:
+  // An even number of passes leaves the result in the first buffers.
+  static_assert(kNumPasses % 2 == 0, "The sort must end in keys_[0]");
+
+  // This must match sort_data in sort/radix_sort.glsl.
+  struct SortData {
+    uint32_t num_keys;
+    uint32_t shift;
+    uint32_t num_tiles;
+  };
+
+  containers::unique_ptr<VulkanComputePipeline> CreatePipeline(
+      uint32_t* shader, size_t shader_words) {
+    return containers::make_unique<VulkanComputePipeline>(
+        application_->GetAllocator(),
+        application_->CreateComputePipeline(
+            pipeline_layout_.get(),
+            VkShaderModuleCreateInfo{
+                VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+                shader_words * sizeof(uint32_t), shader},
+            "main"));
+  }
+
+  // Makes the writes of |src_stages| visible to the compute shaders that
+  // follow.
+  void Barrier(VkCommandBuffer* cmd, VkPipelineStageFlags src_stages,
+               VkAccessFlags src_access) {
+    VkMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+        nullptr,                           // pNext
+        src_access,                        // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT |
+            VK_ACCESS_SHADER_WRITE_BIT  // dstAccessMask
+    };
+    (*cmd)->vkCmdPipelineBarrier(*cmd, src_stages,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                 &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  VulkanApplication* application_;
+  uint32_t max_keys_;
+  // The keys and values, and the ones that every other pass moves them to.
+  containers::unique_ptr<VulkanApplication::Buffer> keys_[2];
+  containers::unique_ptr<VulkanApplication::Buffer> values_[2];
+  containers::unique_ptr<VulkanApplication::Buffer> counts_;
+  VkDescriptorSetLayoutBinding bindings_[5];
+  containers::unique_ptr<PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<VulkanComputePipeline> count_pipeline_;
+  containers::unique_ptr<VulkanComputePipeline> scan_pipeline_;
+  containers::unique_ptr<VulkanComputePipeline> scatter_pipeline_;
+  // sets_[0] sorts from the first buffers into the second ones, sets_[1]
+  // the other way around.
+  containers::unique_ptr<DescriptorSet> sets_[2];
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_RADIX_SORT_H_
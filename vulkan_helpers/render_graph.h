@@ -0,0 +1,599 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_RENDER_GRAPH_H
+#define VULKAN_HELPERS_RENDER_GRAPH_H
+
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+namespace vulkan {
+
+// RenderGraph records a list of passes, each of which declares the images and
+// buffers that it reads and writes, and places the barriers and image layout
+// transitions in between them. Only the barriers that are needed are
+// recorded: reads that follow reads in the same layout need none, and all of
+// the barriers in front of one pass are merged into one vkCmdPipelineBarrier.
+//
+// Resources are either imported, e.g. the swapchain images or a
+// VulkanApplication::Image, or transient. Transient resources are created by
+// the graph, and only live for one execution of it. Transient resources that
+// are not in use at the same time share their memory.
+//
+// Passes run in the order that they were added, on a graphics queue. The
+// render passes that they begin should leave their attachments in the layout
+// that they were declared with, i.e. use the same initialLayout and
+// finalLayout.
+//
+// Example:
+//   RenderGraph graph(app);
+//   auto color = graph.CreateImage(color_create_info);
+//   auto backbuffer = graph.ImportImage(
+//       swapchain_image, range, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+//       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+//   graph.AddPass("scene", [&](VkCommandBuffer* cmd) { ... })
+//       .Write(color, RenderGraph::kColorAttachment);
+//   graph.AddPass("blit", [&](VkCommandBuffer* cmd) {
+//     ... graph.image(color) ...
+//   })
+//       .Read(color, RenderGraph::kTransferRead)
+//       .Write(backbuffer, RenderGraph::kTransferWrite);
+//   graph.Compile();
+//   graph.Execute(&command_buffer);
+class RenderGraph {
+ public:
+  typedef uint32_t Resource;
+
+  // How a pass uses a resource.
+  enum Usage {
+    kColorAttachment,
+    kDepthStencilAttachment,
+    kInputAttachment,
+    // Sampled images, and buffers read from shaders.
+    kShaderRead,
+    // Storage images and buffers, which may be written.
+    kShaderWrite,
+    kUniformRead,
+    kVertexInput,
+    kIndirectRead,
+    kTransferRead,
+    kTransferWrite,
+  };
+
+  class Pass {
+   public:
+    Pass& Read(Resource resource, Usage usage) {
+      LOG_ASSERT(==, log_, false, IsWrite(usage));
+      accesses_.push_back({resource, usage});
+      return *this;
+    }
+    Pass& Write(Resource resource, Usage usage) {
+      LOG_ASSERT(==, log_, true, IsWrite(usage));
+      accesses_.push_back({resource, usage});
+      return *this;
+    }
+
+   private:
+    friend class RenderGraph;
+    struct Access {
+      Resource resource;
+      Usage usage;
+    };
+    Pass(containers::Allocator* allocator, logging::Logger* log,
+         const char* name, std::function<void(VkCommandBuffer*)> record)
+        : log_(log),
+          name_(name),
+          record_(std::move(record)),
+          accesses_(allocator) {}
+
+    logging::Logger* log_;
+    const char* name_;
+    std::function<void(VkCommandBuffer*)> record_;
+    containers::vector<Access> accesses_;
+  };
+
+  RenderGraph(VulkanApplication* application)
+      : application_(application),
+        allocator_(application->GetAllocator()),
+        passes_(allocator_),
+        resources_(allocator_),
+        blocks_(allocator_),
+        images_(allocator_),
+        buffers_(allocator_),
+        compiled_(false) {}
+
+  // Imports |image|, which is in |initial_layout| when the graph is
+  // executed, and is left in |final_layout| afterwards.
+  Resource ImportImage(::VkImage image, const VkImageSubresourceRange& range,
+                       VkImageLayout initial_layout,
+                       VkImageLayout final_layout) {
+    ResourceData data = NewResource(true);
+    data.image = image;
+    data.range = range;
+    data.initial_layout = initial_layout;
+    data.final_layout = final_layout;
+    return AddResource(data);
+  }
+
+  Resource ImportBuffer(::VkBuffer buffer) {
+    ResourceData data = NewResource(false);
+    data.buffer = buffer;
+    return AddResource(data);
+  }
+
+  // Adds a transient image, which is created by Compile. Its contents are
+  // undefined at the start of every execution.
+  Resource CreateImage(const VkImageCreateInfo& create_info) {
+    ResourceData data = NewResource(true);
+    data.transient = true;
+    data.image_create_info = create_info;
+    data.range = {
+        AspectOf(create_info.format),  // aspectMask
+        0,                             // baseMipLevel
+        create_info.mipLevels,         // levelCount
+        0,                             // baseArrayLayer
+        create_info.arrayLayers,       // layerCount
+    };
+    return AddResource(data);
+  }
+
+  // Adds a transient buffer, which is created by Compile.
+  Resource CreateBuffer(const VkBufferCreateInfo& create_info) {
+    ResourceData data = NewResource(false);
+    data.transient = true;
+    data.buffer_create_info = create_info;
+    return AddResource(data);
+  }
+
+  // Adds a pass that records its commands with |record|. The returned pass
+  // is only valid until the next pass is added.
+  Pass& AddPass(const char* name,
+                std::function<void(VkCommandBuffer*)> record) {
+    LOG_ASSERT(==, log(), false, compiled_);
+    passes_.push_back(Pass(allocator_, log(), name, std::move(record)));
+    return passes_.back();
+  }
+
+  // Creates the transient resources, and the memory that they share. Passes
+  // and resources can not be added afterwards.
+  void Compile() {
+    LOG_ASSERT(==, log(), false, compiled_);
+    compiled_ = true;
+    for (uint32_t i = 0; i < passes_.size(); ++i) {
+      for (const auto& access : passes_[i].accesses_) {
+        ResourceData& data = resources_[access.resource];
+        data.first_pass = std::min(data.first_pass, i);
+        data.last_pass = std::max(data.last_pass, i);
+      }
+    }
+
+    VkDevice& device = application_->device();
+    containers::vector<Resource> transients(allocator_);
+    for (Resource i = 0; i < resources_.size(); ++i) {
+      ResourceData& data = resources_[i];
+      if (!data.transient || data.first_pass > data.last_pass) {
+        continue;
+      }
+      if (data.is_image) {
+        ::VkImage image;
+        LOG_ASSERT(==, log(), VK_SUCCESS,
+                   device->vkCreateImage(device, &data.image_create_info,
+                                         nullptr, &image));
+        images_.push_back(
+            containers::make_unique<VkImage>(allocator_, image, nullptr,
+                                             &device));
+        data.image = image;
+        device->vkGetImageMemoryRequirements(device, image,
+                                             &data.requirements);
+      } else {
+        ::VkBuffer buffer;
+        LOG_ASSERT(==, log(), VK_SUCCESS,
+                   device->vkCreateBuffer(device, &data.buffer_create_info,
+                                          nullptr, &buffer));
+        buffers_.push_back(
+            containers::make_unique<VkBuffer>(allocator_, buffer, nullptr,
+                                              &device));
+        data.buffer = buffer;
+        device->vkGetBufferMemoryRequirements(device, buffer,
+                                              &data.requirements);
+      }
+      transients.push_back(i);
+    }
+
+    // The largest resources are placed first, so that every block is as
+    // large as the first resource in it.
+    std::sort(transients.begin(), transients.end(),
+              [this](Resource a, Resource b) {
+                return resources_[a].requirements.size >
+                       resources_[b].requirements.size;
+              });
+    ::VkDeviceSize unaliased_size = 0;
+    for (Resource resource : transients) {
+      ResourceData& data = resources_[resource];
+      unaliased_size += data.requirements.size;
+      for (uint32_t i = 0; i < blocks_.size(); ++i) {
+        if (CanAlias(blocks_[i], resource)) {
+          data.block = i;
+          break;
+        }
+      }
+      if (data.block == kNone) {
+        data.block = static_cast<uint32_t>(blocks_.size());
+        blocks_.push_back(Block(allocator_));
+        blocks_.back().size = data.requirements.size;
+        blocks_.back().memory_type_bits = data.requirements.memoryTypeBits;
+      }
+      Block& block = blocks_[data.block];
+      block.memory_type_bits &= data.requirements.memoryTypeBits;
+      block.resources.push_back(resource);
+    }
+
+    ::VkDeviceSize total_size = 0;
+    for (Block& block : blocks_) {
+      block.memory = containers::make_unique<VkDeviceMemory>(
+          allocator_,
+          AllocateDeviceMemory(
+              &device,
+              GetMemoryIndex(&device, log(), block.memory_type_bits,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+              block.size));
+      total_size += block.size;
+      for (Resource resource : block.resources) {
+        const ResourceData& data = resources_[resource];
+        if (data.is_image) {
+          LOG_ASSERT(==, log(), VK_SUCCESS,
+                     device->vkBindImageMemory(device, data.image,
+                                               *block.memory, 0));
+        } else {
+          LOG_ASSERT(==, log(), VK_SUCCESS,
+                     device->vkBindBufferMemory(device, data.buffer,
+                                                *block.memory, 0));
+        }
+      }
+    }
+    log()->LogInfo("RENDER_GRAPH: passes=", passes_.size(),
+                   " transients=", transients.size(),
+                   " blocks=", blocks_.size(), " bytes=", total_size,
+                   " unaliased_bytes=", unaliased_size);
+  }
+
+  // Records every pass into |command_buffer|, with the barriers that they
+  // need, and transitions the imported images to their final layouts.
+  void Execute(VkCommandBuffer* command_buffer) {
+    LOG_ASSERT(==, log(), true, compiled_);
+    for (ResourceData& data : resources_) {
+      data.state = State();
+      data.state.layout =
+          data.transient ? VK_IMAGE_LAYOUT_UNDEFINED : data.initial_layout;
+    }
+    for (Block& block : blocks_) {
+      block.state = State();
+    }
+
+    for (uint32_t i = 0; i < passes_.size(); ++i) {
+      for (const auto& access : passes_[i].accesses_) {
+        AddBarrier(command_buffer, access.resource, i, access.usage);
+      }
+      // The queued barriers are flushed by the first command of the pass.
+      passes_[i].record_(command_buffer);
+    }
+
+    for (ResourceData& data : resources_) {
+      if (!data.is_image || data.transient ||
+          data.state.layout == data.final_layout) {
+        continue;
+      }
+      command_buffer->QueueImageBarrier(
+          SourceStages(data.state), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+          ImageBarrier(data, data.state.write_access, 0, data.final_layout));
+      data.state.layout = data.final_layout;
+    }
+    command_buffer->FlushBarriers();
+  }
+
+  // The image or buffer of |resource|. Transient ones exist once the graph
+  // is compiled.
+  ::VkImage image(Resource resource) const {
+    return resources_[resource].image;
+  }
+  ::VkBuffer buffer(Resource resource) const {
+    return resources_[resource].buffer;
+  }
+
+ private:
+  static const uint32_t kNone = ~0u;
+
+  struct UsageInfo {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    // For images.
+    VkImageLayout layout;
+  };
+
+  // The synchronization state of a resource or block within one execution.
+  struct State {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // The stages and accesses of the last write.
+    VkPipelineStageFlags write_stages = 0;
+    VkAccessFlags write_access = 0;
+    // The stages that read since the last write.
+    VkPipelineStageFlags read_stages = 0;
+    // The stages and accesses that the last write is visible to.
+    VkPipelineStageFlags visible_stages = 0;
+    VkAccessFlags visible_access = 0;
+  };
+
+  struct ResourceData {
+    bool is_image;
+    bool transient;
+    ::VkImage image;
+    ::VkBuffer buffer;
+    VkImageSubresourceRange range;
+    VkImageLayout initial_layout;
+    VkImageLayout final_layout;
+    VkImageCreateInfo image_create_info;
+    VkBufferCreateInfo buffer_create_info;
+    VkMemoryRequirements requirements;
+    uint32_t first_pass;
+    uint32_t last_pass;
+    uint32_t block;
+    State state;
+  };
+
+  // Memory that is shared by transient resources whose passes do not
+  // overlap.
+  struct Block {
+    Block(containers::Allocator* allocator) : resources(allocator) {}
+    ::VkDeviceSize size = 0;
+    uint32_t memory_type_bits = 0;
+    containers::vector<Resource> resources;
+    containers::unique_ptr<VkDeviceMemory> memory;
+    // The state of the resource that used the block last.
+    State state;
+  };
+
+  static bool IsWrite(Usage usage) {
+    switch (usage) {
+      case kColorAttachment:
+      case kDepthStencilAttachment:
+      case kShaderWrite:
+      case kTransferWrite:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  static UsageInfo Info(Usage usage) {
+    const VkPipelineStageFlags kShaderStages =
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    switch (usage) {
+      case kColorAttachment:
+        return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+      case kDepthStencilAttachment:
+        return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+      case kInputAttachment:
+        return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+      case kShaderRead:
+        return {kShaderStages, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+      case kShaderWrite:
+        return {kShaderStages,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL};
+      case kUniformRead:
+        return {kShaderStages, VK_ACCESS_UNIFORM_READ_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED};
+      case kVertexInput:
+        return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED};
+      case kIndirectRead:
+        return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+      case kTransferRead:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+      case kTransferWrite:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+    }
+    return {VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, VK_IMAGE_LAYOUT_GENERAL};
+  }
+
+  static VkImageAspectFlags AspectOf(VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_D16_UNORM:
+      case VK_FORMAT_X8_D24_UNORM_PACK32:
+      case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+      case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+      case VK_FORMAT_D16_UNORM_S8_UINT:
+      case VK_FORMAT_D24_UNORM_S8_UINT:
+      case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+      default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+  }
+
+  // The stages that have to finish before |state| can be changed.
+  static VkPipelineStageFlags SourceStages(const State& state) {
+    const VkPipelineStageFlags stages = state.write_stages | state.read_stages;
+    return stages ? stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  }
+
+  logging::Logger* log() { return application_->GetLogger(); }
+
+  ResourceData NewResource(bool is_image) {
+    LOG_ASSERT(==, log(), false, compiled_);
+    ResourceData data = {};
+    data.is_image = is_image;
+    data.first_pass = kNone;
+    data.last_pass = 0;
+    data.block = kNone;
+    return data;
+  }
+
+  Resource AddResource(const ResourceData& data) {
+    resources_.push_back(data);
+    return static_cast<Resource>(resources_.size() - 1);
+  }
+
+  bool Overlaps(const ResourceData& a, const ResourceData& b) const {
+    return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+  }
+
+  bool CanAlias(const Block& block, Resource resource) const {
+    const ResourceData& data = resources_[resource];
+    // Everything is bound at offset 0, which suits any alignment.
+    if (data.requirements.size > block.size ||
+        (block.memory_type_bits & data.requirements.memoryTypeBits) == 0) {
+      return false;
+    }
+    for (Resource other : block.resources) {
+      if (Overlaps(data, resources_[other])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  VkImageMemoryBarrier ImageBarrier(const ResourceData& data,
+                                    VkAccessFlags src_access,
+                                    VkAccessFlags dst_access,
+                                    VkImageLayout new_layout) const {
+    return {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        src_access,                              // srcAccessMask
+        dst_access,                              // dstAccessMask
+        data.state.layout,                       // oldLayout
+        new_layout,                              // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        data.image,                              // image
+        data.range,                              // subresourceRange
+    };
+  }
+
+  // Queues the barrier that |pass| needs before it uses |resource| with
+  // |usage|, if any, and updates the state of the resource.
+  void AddBarrier(VkCommandBuffer* command_buffer, Resource resource,
+                  uint32_t pass, Usage usage) {
+    ResourceData& data = resources_[resource];
+    State& state = data.state;
+    const UsageInfo info = Info(usage);
+    const bool write = IsWrite(usage);
+
+    // The first use of an aliased resource waits for whatever used its
+    // memory before it, and discards the contents.
+    if (data.transient && pass == data.first_pass) {
+      state = blocks_[data.block].state;
+      state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+      state.visible_stages = 0;
+      state.visible_access = 0;
+    }
+
+    const bool transition = data.is_image && state.layout != info.layout;
+    bool barrier = transition;
+    if (write) {
+      // Writes wait for earlier reads and writes.
+      barrier |= (state.write_stages | state.read_stages) != 0;
+    } else {
+      // Reads wait for the last write, unless it is visible to them already.
+      barrier |= state.write_stages != 0 &&
+                 ((info.stages & ~state.visible_stages) != 0 ||
+                  (info.access & ~state.visible_access) != 0);
+    }
+
+    if (barrier) {
+      if (data.is_image) {
+        command_buffer->QueueImageBarrier(
+            SourceStages(state), info.stages,
+            ImageBarrier(data, state.write_access, info.access, info.layout));
+      } else {
+        command_buffer->QueueBufferBarrier(
+            SourceStages(state), info.stages,
+            {
+                VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+                nullptr,                                  // pNext
+                state.write_access,                       // srcAccessMask
+                info.access,                              // dstAccessMask
+                VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+                VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+                data.buffer,              // buffer
+                0,                        // offset
+                VK_WHOLE_SIZE,            // size
+            });
+      }
+    }
+
+    if (write || transition) {
+      // A layout transition is a write as well, which only the stages of
+      // this use are synchronized with.
+      state.write_stages = info.stages;
+      state.write_access = write ? info.access : 0;
+      state.read_stages = write ? 0 : info.stages;
+      state.visible_stages = info.stages;
+      state.visible_access = info.access;
+    } else {
+      state.read_stages |= info.stages;
+      if (barrier) {
+        state.visible_stages |= info.stages;
+        state.visible_access |= info.access;
+      }
+    }
+    state.layout = data.is_image ? info.layout : state.layout;
+    if (data.transient) {
+      blocks_[data.block].state = state;
+    }
+  }
+
+  VulkanApplication* application_;
+  containers::Allocator* allocator_;
+  containers::vector<Pass> passes_;
+  containers::vector<ResourceData> resources_;
+  containers::vector<Block> blocks_;
+  // The transient images and buffers.
+  containers::vector<containers::unique_ptr<VkImage>> images_;
+  containers::vector<containers::unique_ptr<VkBuffer>> buffers_;
+  bool compiled_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_RENDER_GRAPH_H
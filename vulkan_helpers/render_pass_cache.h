@@ -0,0 +1,209 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_RENDER_PASS_CACHE_H
+#define VULKAN_HELPERS_RENDER_PASS_CACHE_H
+
+#include "support/log/log.h"
+#include "vulkan_helpers/object_cache.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+namespace vulkan {
+
+struct RenderPassTraits {
+  static void Destroy(VkDevice* device, ::VkRenderPass render_pass) {
+    (*device)->vkDestroyRenderPass(*device, render_pass, nullptr);
+  }
+};
+
+// RenderPassCache shares one ::VkRenderPass between everything that renders
+// with the same attachments, subpasses and dependencies. As identical render
+// passes then have the same handle, so do the pipelines and framebuffers
+// that are cached for them. Render passes with pNext structures are never
+// shared.
+class RenderPassCache : public ObjectCache<::VkRenderPass, RenderPassTraits> {
+ public:
+  RenderPassCache(containers::Allocator* allocator, VkDevice* device)
+      : ObjectCache(allocator, device) {}
+
+  // Returns a handle to a render pass created from |create_info|, creating
+  // it if no handle to an identical one is alive.
+  Handle Get(const VkRenderPassCreateInfo& create_info) {
+    containers::vector<uint64_t> key(allocator_);
+    bool cacheable = create_info.pNext == nullptr;
+    key.push_back(VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO);
+    key.push_back(create_info.flags);
+    key.push_back(create_info.attachmentCount);
+    for (uint32_t i = 0; i < create_info.attachmentCount; ++i) {
+      const VkAttachmentDescription& attachment =
+          create_info.pAttachments[i];
+      key.push_back(attachment.flags);
+      key.push_back(attachment.format);
+      key.push_back(attachment.samples);
+      key.push_back(attachment.loadOp);
+      key.push_back(attachment.storeOp);
+      key.push_back(attachment.stencilLoadOp);
+      key.push_back(attachment.stencilStoreOp);
+      key.push_back(attachment.initialLayout);
+      key.push_back(attachment.finalLayout);
+    }
+    key.push_back(create_info.subpassCount);
+    for (uint32_t i = 0; i < create_info.subpassCount; ++i) {
+      const VkSubpassDescription& subpass = create_info.pSubpasses[i];
+      key.push_back(subpass.flags);
+      key.push_back(subpass.pipelineBindPoint);
+      AddReferences(&key, subpass.inputAttachmentCount,
+                    subpass.pInputAttachments);
+      AddReferences(&key, subpass.colorAttachmentCount,
+                    subpass.pColorAttachments);
+      AddReferences(&key,
+                    subpass.pResolveAttachments ? subpass.colorAttachmentCount
+                                                : 0,
+                    subpass.pResolveAttachments);
+      AddReferences(&key, subpass.pDepthStencilAttachment ? 1 : 0,
+                    subpass.pDepthStencilAttachment);
+      AddIndices(&key, subpass.preserveAttachmentCount,
+                 subpass.pPreserveAttachments);
+    }
+    key.push_back(create_info.dependencyCount);
+    for (uint32_t i = 0; i < create_info.dependencyCount; ++i) {
+      const VkSubpassDependency& dependency = create_info.pDependencies[i];
+      key.push_back(dependency.srcSubpass);
+      key.push_back(dependency.dstSubpass);
+      key.push_back(dependency.srcStageMask);
+      key.push_back(dependency.dstStageMask);
+      key.push_back(dependency.srcAccessMask);
+      key.push_back(dependency.dstAccessMask);
+      key.push_back(dependency.dependencyFlags);
+    }
+
+    return GetOrCreate(std::move(key), cacheable, [this, &create_info]() {
+      ::VkRenderPass render_pass;
+      LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+                 (*device_)->vkCreateRenderPass(*device_, &create_info,
+                                                nullptr, &render_pass));
+      return render_pass;
+    });
+  }
+
+  // Like the above, for render passes created with
+  // VK_KHR_create_renderpass2.
+  Handle Get(const VkRenderPassCreateInfo2KHR& create_info) {
+    containers::vector<uint64_t> key(allocator_);
+    bool cacheable = create_info.pNext == nullptr;
+    key.push_back(VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2_KHR);
+    key.push_back(create_info.flags);
+    key.push_back(create_info.attachmentCount);
+    for (uint32_t i = 0; i < create_info.attachmentCount; ++i) {
+      const VkAttachmentDescription2KHR& attachment =
+          create_info.pAttachments[i];
+      cacheable = cacheable && attachment.pNext == nullptr;
+      key.push_back(attachment.flags);
+      key.push_back(attachment.format);
+      key.push_back(attachment.samples);
+      key.push_back(attachment.loadOp);
+      key.push_back(attachment.storeOp);
+      key.push_back(attachment.stencilLoadOp);
+      key.push_back(attachment.stencilStoreOp);
+      key.push_back(attachment.initialLayout);
+      key.push_back(attachment.finalLayout);
+    }
+    key.push_back(create_info.subpassCount);
+    for (uint32_t i = 0; i < create_info.subpassCount; ++i) {
+      const VkSubpassDescription2KHR& subpass = create_info.pSubpasses[i];
+      cacheable = cacheable && subpass.pNext == nullptr;
+      key.push_back(subpass.flags);
+      key.push_back(subpass.pipelineBindPoint);
+      key.push_back(subpass.viewMask);
+      cacheable = AddReferences(&key, subpass.inputAttachmentCount,
+                                subpass.pInputAttachments) &&
+                  cacheable;
+      cacheable = AddReferences(&key, subpass.colorAttachmentCount,
+                                subpass.pColorAttachments) &&
+                  cacheable;
+      cacheable =
+          AddReferences(&key,
+                        subpass.pResolveAttachments
+                            ? subpass.colorAttachmentCount
+                            : 0,
+                        subpass.pResolveAttachments) &&
+          cacheable;
+      cacheable = AddReferences(&key, subpass.pDepthStencilAttachment ? 1 : 0,
+                                subpass.pDepthStencilAttachment) &&
+                  cacheable;
+      AddIndices(&key, subpass.preserveAttachmentCount,
+                 subpass.pPreserveAttachments);
+    }
+    key.push_back(create_info.dependencyCount);
+    for (uint32_t i = 0; i < create_info.dependencyCount; ++i) {
+      const VkSubpassDependency2KHR& dependency = create_info.pDependencies[i];
+      cacheable = cacheable && dependency.pNext == nullptr;
+      key.push_back(dependency.srcSubpass);
+      key.push_back(dependency.dstSubpass);
+      key.push_back(dependency.srcStageMask);
+      key.push_back(dependency.dstStageMask);
+      key.push_back(dependency.srcAccessMask);
+      key.push_back(dependency.dstAccessMask);
+      key.push_back(dependency.dependencyFlags);
+      key.push_back(static_cast<uint32_t>(dependency.viewOffset));
+    }
+    AddIndices(&key, create_info.correlatedViewMaskCount,
+               create_info.pCorrelatedViewMasks);
+
+    return GetOrCreate(std::move(key), cacheable, [this, &create_info]() {
+      ::VkRenderPass render_pass;
+      LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+                 (*device_)->vkCreateRenderPass2KHR(*device_, &create_info,
+                                                    nullptr, &render_pass));
+      return render_pass;
+    });
+  }
+
+ private:
+  static void AddReferences(containers::vector<uint64_t>* key, uint32_t count,
+                            const VkAttachmentReference* references) {
+    key->push_back(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      key->push_back(references[i].attachment);
+      key->push_back(references[i].layout);
+    }
+  }
+
+  // Returns false if any of |references| has a pNext structure.
+  static bool AddReferences(containers::vector<uint64_t>* key, uint32_t count,
+                            const VkAttachmentReference2KHR* references) {
+    bool cacheable = true;
+    key->push_back(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      cacheable = cacheable && references[i].pNext == nullptr;
+      key->push_back(references[i].attachment);
+      key->push_back(references[i].layout);
+      key->push_back(references[i].aspectMask);
+    }
+    return cacheable;
+  }
+
+  static void AddIndices(containers::vector<uint64_t>* key, uint32_t count,
+                         const uint32_t* indices) {
+    key->push_back(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      key->push_back(indices[i]);
+    }
+  }
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_RENDER_PASS_CACHE_H
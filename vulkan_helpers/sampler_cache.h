@@ -0,0 +1,96 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_SAMPLER_CACHE_H
+#define VULKAN_HELPERS_SAMPLER_CACHE_H
+
+#include "support/log/log.h"
+#include "vulkan_helpers/object_cache.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+namespace vulkan {
+
+struct SamplerTraits {
+  static void Destroy(VkDevice* device, ::VkSampler sampler) {
+    (*device)->vkDestroySampler(*device, sampler, nullptr);
+  }
+};
+
+// SamplerCache shares one ::VkSampler between everything that samples with
+// the same state. Devices may only have maxSamplerAllocationCount samplers
+// at once, which the cache can be limited to with set_max_objects().
+// Samplers with a pNext structure that is not known here are never shared.
+class SamplerCache : public ObjectCache<::VkSampler, SamplerTraits> {
+ public:
+  SamplerCache(containers::Allocator* allocator, VkDevice* device)
+      : ObjectCache(allocator, device) {}
+
+  // Returns a handle to a sampler created from |create_info|, creating it
+  // if no handle to an identical one is alive.
+  Handle Get(const VkSamplerCreateInfo& create_info) {
+    containers::vector<uint64_t> key(allocator_);
+    key.reserve(20);
+    key.push_back(create_info.flags);
+    key.push_back(create_info.magFilter);
+    key.push_back(create_info.minFilter);
+    key.push_back(create_info.mipmapMode);
+    key.push_back(create_info.addressModeU);
+    key.push_back(create_info.addressModeV);
+    key.push_back(create_info.addressModeW);
+    key.push_back(FloatBits(create_info.mipLodBias));
+    key.push_back(create_info.anisotropyEnable);
+    key.push_back(FloatBits(create_info.maxAnisotropy));
+    key.push_back(create_info.compareEnable);
+    key.push_back(create_info.compareOp);
+    key.push_back(FloatBits(create_info.minLod));
+    key.push_back(FloatBits(create_info.maxLod));
+    key.push_back(create_info.borderColor);
+    key.push_back(create_info.unnormalizedCoordinates);
+
+    bool cacheable = true;
+    for (auto next = static_cast<const VkBaseInStructure*>(create_info.pNext);
+         next && cacheable; next = next->pNext) {
+      key.push_back(next->sType);
+      switch (next->sType) {
+        case VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO_EXT:
+          key.push_back(
+              reinterpret_cast<const VkSamplerReductionModeCreateInfoEXT*>(
+                  next)
+                  ->reductionMode);
+          break;
+        case VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO:
+          key.push_back(reinterpret_cast<uint64_t>(
+              reinterpret_cast<const VkSamplerYcbcrConversionInfo*>(next)
+                  ->conversion));
+          break;
+        default:
+          cacheable = false;
+          break;
+      }
+    }
+
+    return GetOrCreate(std::move(key), cacheable, [this, &create_info]() {
+      ::VkSampler sampler;
+      LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+                 (*device_)->vkCreateSampler(*device_, &create_info, nullptr,
+                                             &sampler));
+      return sampler;
+    });
+  }
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_SAMPLER_CACHE_H
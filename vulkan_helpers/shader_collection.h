@@ -24,20 +24,51 @@ namespace vulkan {
 // GLSL shaders compiled to SPIR-V through glslc
 // HLSL shaders compiled to SPIR-V through glslc
 // HLSL shaders compiled to SPIR-V through DXC
+// GLSL shaders compiled to SPIR-V through glslc and optimized with spirv-opt
 // The class can return appropriate shaders based on the given 'shader_compiler'
-// configuration: shader-compiler={dxc-hlsl, glslc-glsl, glslc-hlsl}
+// configuration: shader-compiler={dxc-hlsl, glslc-glsl, glslc-hlsl,
+// glslc-glsl-opt}
+// The DXC and spirv-opt shaders are empty when the build did not have those
+// tools, and the collection is then not available().
 class ShaderCollection {
  public:
   using u32vec = std::vector<uint32_t>;
+
+  // All of the shader compilers, in the order of the constructor arguments.
+  static const size_t kNumCompilers = 4;
+  static const char* compiler_name(size_t index) {
+    static const char* const kCompilers[kNumCompilers] = {
+        "glslc-glsl", "glslc-hlsl", "dxc-hlsl", "glslc-glsl-opt"};
+    return kCompilers[index];
+  }
+
+  // The glslc-glsl-opt shaders are the <shader>.opt.spv of an OPTIMIZED
+  // shader library, they may only be left out if it is never asked for.
   ShaderCollection(logging::Logger* log, const char* shader_compiler,
                    u32vec& glslc_glsl_vertex_shader,
                    u32vec& glslc_glsl_fragment_shader,
                    u32vec& glslc_hlsl_vertex_shader,
                    u32vec& glslc_hlsl_fragment_shader,
                    u32vec& dxc_hlsl_vertex_shader,
-                   u32vec& dxc_hlsl_fragment_shader) {
+                   u32vec& dxc_hlsl_fragment_shader,
+                   u32vec* optimized_glsl_vertex_shader = nullptr,
+                   u32vec* optimized_glsl_fragment_shader = nullptr)
+      : vertex_shader(nullptr),
+        fragment_shader(nullptr),
+        vertex_shader_word_count(0),
+        fragment_shader_word_count(0) {
     // Find out the shader compiler
-    if (strncmp(shader_compiler, "glslc-glsl", 10) == 0) {
+    if (strcmp(shader_compiler, "glslc-glsl-opt") == 0) {
+      LOG_ASSERT(!=, log, optimized_glsl_vertex_shader,
+                 static_cast<u32vec*>(nullptr));
+      LOG_ASSERT(!=, log, optimized_glsl_fragment_shader,
+                 static_cast<u32vec*>(nullptr));
+      vertex_shader = optimized_glsl_vertex_shader->data();
+      fragment_shader = optimized_glsl_fragment_shader->data();
+      vertex_shader_word_count = (uint32_t)optimized_glsl_vertex_shader->size();
+      fragment_shader_word_count =
+          (uint32_t)optimized_glsl_fragment_shader->size();
+    } else if (strncmp(shader_compiler, "glslc-glsl", 10) == 0) {
       vertex_shader = glslc_glsl_vertex_shader.data();
       fragment_shader = glslc_glsl_fragment_shader.data();
       vertex_shader_word_count = (uint32_t)glslc_glsl_vertex_shader.size();
@@ -54,9 +85,13 @@ class ShaderCollection {
       fragment_shader_word_count = (uint32_t)dxc_hlsl_fragment_shader.size();
     } else {
       LOG_ASSERT(==, log, shader_compiler,
-                 "glslc-glsl or glslc-hlsl or dxc-hlsl");
+                 "glslc-glsl or glslc-hlsl or dxc-hlsl or glslc-glsl-opt");
     }
   }
+  // Returns false if the shaders of the compiler were not built.
+  bool available() const {
+    return vertex_shader_word_count > 0 && fragment_shader_word_count > 0;
+  }
   uint32_t* vertexShader() { return vertex_shader; }
   uint32_t* fragmentShader() { return fragment_shader; }
   uint32_t vertexShaderWordCount() { return vertex_shader_word_count; }
@@ -0,0 +1,118 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_SHADER_LAYOUT_H
+#define VULKAN_HELPERS_SHADER_LAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Types and checks for the C++ side of uniform and storage blocks.
+//
+// Blocks declared with the scalar layout of VK_EXT_scalar_block_layout
+// align every member only to the size of its components, so a vec3 takes
+// 12 bytes instead of the 16 of std140 and std430. Padded vector types,
+// such as mathfu::Vector<float, 3> with SIMD, no longer match this layout;
+// the Scalar* types below do.
+//
+// The layouts are checked at compile time with the headers that
+// tools/shader_layout_check.py writes for every shader of a shader library
+// built with LAYOUT_CHECKS. For every struct of the shader, the header of
+// "foo.vert.spv" ("foo.vert.spv.layout.h") defines
+// CHECK_<STRUCT NAME>_LAYOUT(type), which fails to compile unless every
+// member of |type| has the name and offset of the SPIR-V member, and
+// |type| is large enough for the block.
+
+// Fails to compile unless |member| of |type| is at |offset| bytes.
+#define VULKAN_CHECK_MEMBER_OFFSET(type, member, offset)        \
+  static_assert(offsetof(type, member) == (offset),             \
+                #type "::" #member " is not at offset " #offset \
+                      " as in the shader")
+
+// Fails to compile unless |type| is exactly |size| bytes, which is needed
+// for structs that are the elements of arrays.
+#define VULKAN_CHECK_SIZE(type, size) \
+  static_assert(sizeof(type) == (size), #type " is not " #size " bytes")
+
+// Fails to compile unless |type| is at least |size| bytes.
+#define VULKAN_CHECK_MIN_SIZE(type, size) \
+  static_assert(sizeof(type) >= (size),   \
+                #type " is smaller than " #size " bytes")
+
+namespace vulkan {
+
+// A vector of |N| components of |T| without any padding, as the scalar
+// layout stores it.
+template <typename T, int N>
+struct ScalarVector {
+  ScalarVector() {}
+  // Copies the first N components of |v|, anything with operator[], such as
+  // a mathfu::Vector<T, N>.
+  template <typename V>
+  ScalarVector(const V& v) {
+    for (int i = 0; i < N; ++i) {
+      data[i] = v[i];
+    }
+  }
+
+  T& operator[](int i) { return data[i]; }
+  const T& operator[](int i) const { return data[i]; }
+
+  T data[N];
+};
+
+// A column major matrix of |C| columns of |R| components of |T|. The
+// columns are |R| components apart, which has to be the MatrixStride of
+// the member in the shader.
+template <typename T, int C, int R>
+struct ScalarMatrix {
+  ScalarMatrix() {}
+  // Copies |m|, anything with operator()(row, column), such as a
+  // mathfu::Matrix<T, R, C>.
+  template <typename M>
+  ScalarMatrix(const M& m) {
+    for (int c = 0; c < C; ++c) {
+      for (int r = 0; r < R; ++r) {
+        columns[c][r] = m(r, c);
+      }
+    }
+  }
+
+  ScalarVector<T, R>& operator[](int c) { return columns[c]; }
+  const ScalarVector<T, R>& operator[](int c) const { return columns[c]; }
+
+  ScalarVector<T, R> columns[C];
+};
+
+using ScalarVec2 = ScalarVector<float, 2>;
+using ScalarVec3 = ScalarVector<float, 3>;
+using ScalarVec4 = ScalarVector<float, 4>;
+using ScalarIVec2 = ScalarVector<int32_t, 2>;
+using ScalarIVec3 = ScalarVector<int32_t, 3>;
+using ScalarIVec4 = ScalarVector<int32_t, 4>;
+using ScalarUVec2 = ScalarVector<uint32_t, 2>;
+using ScalarUVec3 = ScalarVector<uint32_t, 3>;
+using ScalarUVec4 = ScalarVector<uint32_t, 4>;
+using ScalarMat3 = ScalarMatrix<float, 3, 3>;
+using ScalarMat4 = ScalarMatrix<float, 4, 4>;
+
+static_assert(sizeof(ScalarVec3) == 12 && alignof(ScalarVec3) == 4,
+              "ScalarVec3 must be 3 tightly packed floats");
+static_assert(sizeof(ScalarMat3) == 36 && alignof(ScalarMat3) == 4,
+              "ScalarMat3 must be 9 tightly packed floats");
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_SHADER_LAYOUT_H
@@ -0,0 +1,198 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_SHADER_MODULE_CACHE_H
+#define VULKAN_HELPERS_SHADER_MODULE_CACHE_H
+
+#include "support/containers/flat_hash_map.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+namespace vulkan {
+
+// ShaderModuleCache shares one ::VkShaderModule between everything that is
+// created from the same SPIR-V, so that the driver only parses it once.
+// Modules are keyed by a hash of their code, and are destroyed once the
+// last handle to them is released. It may be used from any thread.
+class ShaderModuleCache {
+ private:
+  struct Entry {
+    Entry(containers::Allocator* allocator, const uint32_t* code,
+          size_t num_words, uint64_t hash)
+        : code(code, code + num_words, allocator),
+          hash(hash),
+          module(VK_NULL_HANDLE),
+          references(0) {}
+    // A copy of the code, to tell hash collisions apart.
+    containers::vector<uint32_t> code;
+    uint64_t hash;
+    ::VkShaderModule module;
+    // Guarded by the mutex of the cache.
+    uint32_t references;
+  };
+
+ public:
+  // A reference counted handle to a shader module of the cache.
+  class Handle {
+   public:
+    Handle() : cache_(nullptr), entry_(nullptr) {}
+    Handle(const Handle& other) : cache_(other.cache_), entry_(other.entry_) {
+      if (entry_) {
+        cache_->AddReference(entry_);
+      }
+    }
+    Handle(Handle&& other) : cache_(other.cache_), entry_(other.entry_) {
+      other.cache_ = nullptr;
+      other.entry_ = nullptr;
+    }
+    Handle& operator=(Handle other) {
+      std::swap(cache_, other.cache_);
+      std::swap(entry_, other.entry_);
+      return *this;
+    }
+    ~Handle() {
+      if (entry_) {
+        cache_->Release(entry_);
+      }
+    }
+
+    operator ::VkShaderModule() const {
+      return entry_ ? entry_->module : VK_NULL_HANDLE;
+    }
+
+    // The SPIR-V that the module was created from, empty for a null handle.
+    const uint32_t* code() const {
+      return entry_ ? entry_->code.data() : nullptr;
+    }
+    size_t num_words() const { return entry_ ? entry_->code.size() : 0; }
+
+   private:
+    friend class ShaderModuleCache;
+    Handle(ShaderModuleCache* cache, Entry* entry)
+        : cache_(cache), entry_(entry) {}
+
+    ShaderModuleCache* cache_;
+    Entry* entry_;
+  };
+
+  ShaderModuleCache(containers::Allocator* allocator, VkDevice* device)
+      : allocator_(allocator), device_(device), entries_(allocator) {}
+
+  ~ShaderModuleCache() {
+    // Handles should not outlive the cache, but the modules of any that do
+    // are not leaked.
+    for (auto& entry : entries_) {
+      (*device_)->vkDestroyShaderModule(*device_, entry.second->module,
+                                        nullptr);
+    }
+  }
+
+  // Returns a handle to the shader module of the given SPIR-V, creating it
+  // if no handle to it is alive.
+  Handle Get(const uint32_t* code, size_t num_words) {
+    const uint64_t hash = Hash(code, num_words);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(hash);
+    if (it != entries_.end()) {
+      Entry* entry = it->second.get();
+      if (entry->code.size() == num_words &&
+          memcmp(entry->code.data(), code, num_words * sizeof(uint32_t)) ==
+              0) {
+        ++entry->references;
+        return Handle(this, entry);
+      }
+      // A collision, the module that is already cached is kept.
+      return CreateUncached(code, num_words, hash);
+    }
+    Entry* entry = CreateEntry(code, num_words, hash);
+    entries_[hash] = containers::unique_ptr<Entry>(
+        entry, containers::UniqueDeleter(allocator_, sizeof(Entry)));
+    return Handle(this, entry);
+  }
+
+  // The number of distinct modules that are alive.
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  // 64 bit FNV-1a over the words of the code.
+  static uint64_t Hash(const uint32_t* code, size_t num_words) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < num_words; ++i) {
+      hash = (hash ^ code[i]) * 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  Entry* CreateEntry(const uint32_t* code, size_t num_words, uint64_t hash) {
+    Entry* entry = allocator_->construct<Entry>(allocator_, code, num_words,
+                                                hash);
+    VkShaderModuleCreateInfo create_info{
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,  // sType
+        nullptr,                                      // pNext
+        0,                                            // flags
+        num_words * sizeof(uint32_t),                 // codeSize
+        code                                          // pCode
+    };
+    LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+               (*device_)->vkCreateShaderModule(*device_, &create_info,
+                                                nullptr, &entry->module));
+    entry->references = 1;
+    return entry;
+  }
+
+  // Entries that are not in entries_ are owned by their handles.
+  Handle CreateUncached(const uint32_t* code, size_t num_words,
+                        uint64_t hash) {
+    return Handle(this, CreateEntry(code, num_words, hash));
+  }
+
+  void AddReference(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++entry->references;
+  }
+
+  void Release(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--entry->references != 0) {
+      return;
+    }
+    (*device_)->vkDestroyShaderModule(*device_, entry->module, nullptr);
+    auto it = entries_.find(entry->hash);
+    if (it != entries_.end() && it->second.get() == entry) {
+      entries_.erase(it);
+    } else {
+      allocator_->destroy(entry);
+    }
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  containers::flat_hash_map<uint64_t, containers::unique_ptr<Entry>> entries_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_SHADER_MODULE_CACHE_H
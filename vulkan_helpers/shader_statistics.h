@@ -0,0 +1,321 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_SHADER_STATISTICS_H
+#define VULKAN_HELPERS_SHADER_STATISTICS_H
+
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/occupancy_estimator.h"
+#include "vulkan_wrapper/device_wrapper.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace vulkan {
+
+// ShaderStatistics collects what the driver reports about the compiled
+// shaders of every pipeline that an application creates, such as register
+// counts, spills and instruction counts, and writes them to one JSON file on
+// exit, so that the reports of two builds can be compared.
+//
+// With VK_KHR_pipeline_executable_properties, pipelines have to be created
+// with create_flags(), and every statistic of every executable is reported.
+// Otherwise, with VK_AMD_shader_info, the register and memory usage of every
+// stage is reported. Pipelines may be recorded from any thread.
+//
+// On devices with VK_AMD_shader_core_properties, the theoretical occupancy
+// of every executable is estimated from its registers, see
+// OccupancyEstimator, and pipelines with an executable below
+// |low_occupancy| are flagged, and logged on exit. The registers of
+// VK_KHR_pipeline_executable_properties are taken from the statistics named
+// "VGPRs" and "SGPRs", as the AMD drivers name them.
+class ShaderStatistics {
+ public:
+  enum class Source { kPipelineExecutableProperties, kAmdShaderInfo };
+
+  ShaderStatistics(containers::Allocator* allocator, VkInstance* instance,
+                   VkDevice* device, Source source,
+                   float low_occupancy = 0.25f)
+      : allocator_(allocator),
+        device_(device),
+        source_(source),
+        estimator_(*instance, device->physical_device()),
+        low_occupancy_(low_occupancy),
+        pipelines_(allocator),
+        low_occupancy_pipelines_(allocator) {}
+
+  const OccupancyEstimator& estimator() const { return estimator_; }
+
+  // The flags that pipelines have to be created with, in addition to their
+  // own.
+  VkPipelineCreateFlags create_flags() const {
+    return source_ == Source::kPipelineExecutableProperties
+               ? VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR
+               : 0;
+  }
+
+  // Records the statistics of |pipeline|, which was created with the given
+  // stages. |kind| is "graphics" or "compute".
+  void Record(const char* kind, ::VkPipeline pipeline,
+              const VkPipelineShaderStageCreateInfo* stages,
+              uint32_t num_stages) {
+    std::ostringstream executables;
+    // Stays above 1 if no executable could be estimated.
+    float min_occupancy = 2.0f;
+    if (source_ == Source::kPipelineExecutableProperties) {
+      WriteExecutables(pipeline, &executables, &min_occupancy);
+    } else {
+      WriteShaderInfo(pipeline, stages, num_stages, &executables,
+                      &min_occupancy);
+    }
+    const bool low = min_occupancy < low_occupancy_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream entry;
+    entry << "    {\"kind\": \"" << kind << "\", \"index\": "
+          << pipelines_.size();
+    if (min_occupancy <= 1.0f) {
+      entry << ", \"occupancy\": " << min_occupancy
+            << ", \"low_occupancy\": " << (low ? "true" : "false");
+    }
+    entry << ", \"executables\": [" << executables.str() << "\n    ]}";
+    if (low) {
+      std::ostringstream name;
+      name << kind << "_" << pipelines_.size() << " occupancy="
+           << min_occupancy;
+      low_occupancy_pipelines_.push_back(name.str());
+    }
+    pipelines_.push_back(entry.str());
+  }
+
+  // Writes every pipeline that was recorded to |location| as JSON.
+  void Write(const char* location, logging::Logger* log) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ofstream out_file(location);
+    out_file << "{\n  \"pipelines\": [";
+    for (size_t i = 0; i < pipelines_.size(); ++i) {
+      out_file << (i == 0 ? "\n" : ",\n") << pipelines_[i];
+    }
+    out_file << "\n  ]\n}\n";
+    LOG_ASSERT(==, log, false, out_file.bad());
+    log->LogInfo("Wrote the shader statistics of ", pipelines_.size(),
+                 " pipelines to \"", location, "\"");
+    for (const std::string& pipeline : low_occupancy_pipelines_) {
+      log->LogInfo("LOW_OCCUPANCY: ", pipeline);
+    }
+  }
+
+ private:
+  void WriteExecutables(::VkPipeline pipeline, std::ostringstream* out,
+                        float* min_occupancy) {
+    VkPipelineInfoKHR pipeline_info{
+        VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR,  // sType
+        nullptr,                              // pNext
+        pipeline                              // pipeline
+    };
+    uint32_t num_executables = 0;
+    (*device_)->vkGetPipelineExecutablePropertiesKHR(
+        *device_, &pipeline_info, &num_executables, nullptr);
+    containers::vector<VkPipelineExecutablePropertiesKHR> properties(
+        num_executables,
+        {VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR, nullptr},
+        allocator_);
+    (*device_)->vkGetPipelineExecutablePropertiesKHR(
+        *device_, &pipeline_info, &num_executables, properties.data());
+
+    for (uint32_t i = 0; i < num_executables; ++i) {
+      VkPipelineExecutableInfoKHR executable_info{
+          VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR,  // sType
+          nullptr,                                         // pNext
+          pipeline,                                        // pipeline
+          i                                                // executableIndex
+      };
+      uint32_t num_statistics = 0;
+      (*device_)->vkGetPipelineExecutableStatisticsKHR(
+          *device_, &executable_info, &num_statistics, nullptr);
+      containers::vector<VkPipelineExecutableStatisticKHR> statistics(
+          num_statistics,
+          {VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR, nullptr},
+          allocator_);
+      (*device_)->vkGetPipelineExecutableStatisticsKHR(
+          *device_, &executable_info, &num_statistics, statistics.data());
+
+      *out << (i == 0 ? "\n" : ",\n") << "      {\"name\": ";
+      WriteString(properties[i].name, out);
+      *out << ", \"stages\": \"" << StageNames(properties[i].stages)
+           << "\", \"subgroup_size\": " << properties[i].subgroupSize
+           << ", \"statistics\": {";
+      ShaderResources resources = {};
+      for (uint32_t j = 0; j < num_statistics; ++j) {
+        const VkPipelineExecutableStatisticKHR& statistic = statistics[j];
+        if (statistic.format ==
+            VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR) {
+          if (Equals(statistic.name, "vgprs")) {
+            resources.vgprs = static_cast<uint32_t>(statistic.value.u64);
+          } else if (Equals(statistic.name, "sgprs")) {
+            resources.sgprs = static_cast<uint32_t>(statistic.value.u64);
+          }
+        }
+        *out << (j == 0 ? "" : ", ");
+        WriteString(statistic.name, out);
+        *out << ": ";
+        switch (statistic.format) {
+          case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
+            *out << (statistic.value.b32 ? "true" : "false");
+            break;
+          case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+            *out << statistic.value.i64;
+            break;
+          case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+            *out << statistic.value.u64;
+            break;
+          default:
+            *out << statistic.value.f64;
+            break;
+        }
+      }
+      *out << "}";
+      if (resources.vgprs > 0) {
+        WriteOccupancy(resources, 0, out, min_occupancy);
+      }
+      *out << "}";
+    }
+  }
+
+  void WriteShaderInfo(::VkPipeline pipeline,
+                       const VkPipelineShaderStageCreateInfo* stages,
+                       uint32_t num_stages, std::ostringstream* out,
+                       float* min_occupancy) {
+    bool first = true;
+    for (uint32_t i = 0; i < num_stages; ++i) {
+      VkShaderStatisticsInfoAMD info = {};
+      size_t size = sizeof(info);
+      if ((*device_)->vkGetShaderInfoAMD(
+              *device_, pipeline, stages[i].stage,
+              VK_SHADER_INFO_TYPE_STATISTICS_AMD, &size, &info) !=
+          VK_SUCCESS) {
+        continue;
+      }
+      *out << (first ? "\n" : ",\n") << "      {\"name\": \""
+           << StageNames(stages[i].stage) << "\", \"stages\": \""
+           << StageNames(stages[i].stage) << "\", \"statistics\": {"
+           << "\"vgprs\": " << info.resourceUsage.numUsedVgprs
+           << ", \"sgprs\": " << info.resourceUsage.numUsedSgprs
+           << ", \"available_vgprs\": " << info.numAvailableVgprs
+           << ", \"available_sgprs\": " << info.numAvailableSgprs
+           << ", \"physical_vgprs\": " << info.numPhysicalVgprs
+           << ", \"physical_sgprs\": " << info.numPhysicalSgprs
+           << ", \"lds_bytes\": " << info.resourceUsage.ldsUsageSizeInBytes
+           << ", \"scratch_bytes\": "
+           << info.resourceUsage.scratchMemUsageInBytes << "}";
+      ShaderResources resources = {
+          info.resourceUsage.numUsedVgprs,  // vgprs
+          info.resourceUsage.numUsedSgprs,  // sgprs
+          static_cast<uint32_t>(
+              info.resourceUsage.ldsUsageSizeInBytes)  // lds_bytes
+      };
+      const uint32_t workgroup_size =
+          stages[i].stage == VK_SHADER_STAGE_COMPUTE_BIT
+              ? info.computeWorkGroupSize[0] * info.computeWorkGroupSize[1] *
+                    info.computeWorkGroupSize[2]
+              : 0;
+      WriteOccupancy(resources, workgroup_size, out, min_occupancy);
+      *out << "}";
+      first = false;
+    }
+  }
+
+  // Writes the occupancy of |resources| as a member of an executable, and
+  // lowers |min_occupancy| to it.
+  void WriteOccupancy(const ShaderResources& resources,
+                      uint32_t workgroup_size, std::ostringstream* out,
+                      float* min_occupancy) const {
+    if (!estimator_.valid()) {
+      return;
+    }
+    const float occupancy = estimator_.Occupancy(resources, workgroup_size);
+    *out << ", \"waves_per_simd\": "
+         << estimator_.WavefrontsPerSimd(resources, workgroup_size)
+         << ", \"occupancy\": " << occupancy;
+    *min_occupancy = std::min(*min_occupancy, occupancy);
+  }
+
+  // Returns true if |a| and |b| are equal, ignoring case.
+  static bool Equals(const char* a, const char* b) {
+    for (; *a && *b; ++a, ++b) {
+      if (tolower(static_cast<unsigned char>(*a)) !=
+          tolower(static_cast<unsigned char>(*b))) {
+        return false;
+      }
+    }
+    return *a == *b;
+  }
+
+  // Writes |string| as a JSON string.
+  static void WriteString(const char* string, std::ostringstream* out) {
+    *out << "\"";
+    for (const char* c = string; *c; ++c) {
+      if (*c == '"' || *c == '\\') {
+        *out << "\\" << *c;
+      } else if (static_cast<unsigned char>(*c) >= 0x20) {
+        *out << *c;
+      }
+    }
+    *out << "\"";
+  }
+
+  // Returns the names of |stages|, separated by "|".
+  static std::string StageNames(VkShaderStageFlags stages) {
+    static const struct {
+      VkShaderStageFlagBits stage;
+      const char* name;
+    } kNames[] = {
+        {VK_SHADER_STAGE_VERTEX_BIT, "vertex"},
+        {VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, "tess_control"},
+        {VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, "tess_evaluation"},
+        {VK_SHADER_STAGE_GEOMETRY_BIT, "geometry"},
+        {VK_SHADER_STAGE_FRAGMENT_BIT, "fragment"},
+        {VK_SHADER_STAGE_COMPUTE_BIT, "compute"},
+    };
+    std::string names;
+    for (const auto& name : kNames) {
+      if (stages & name.stage) {
+        names += names.empty() ? "" : "|";
+        names += name.name;
+      }
+    }
+    return names.empty() ? "other" : names;
+  }
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  Source source_;
+  OccupancyEstimator estimator_;
+  float low_occupancy_;
+  std::mutex mutex_;
+  // The JSON of every pipeline, guarded by mutex_.
+  containers::vector<std::string> pipelines_;
+  // Guarded by mutex_.
+  containers::vector<std::string> low_occupancy_pipelines_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_SHADER_STATISTICS_H
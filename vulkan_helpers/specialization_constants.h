@@ -0,0 +1,86 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_SPECIALIZATION_CONSTANTS_H
+#define VULKAN_HELPERS_SPECIALIZATION_CONSTANTS_H
+
+#include "support/containers/vector.h"
+#include "vulkan_helpers/vulkan_header_wrapper.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace vulkan {
+
+// SpecializationConstants maps the constant_id of specialization constants
+// in a shader to their values, so that one SPIR-V module can be created as
+// several pipelines, e.g. with a workgroup size that suits the device.
+//
+// Example:
+//   SpecializationConstants constants(allocator);
+//   constants.Set(0, subgroup_size);  // layout(local_size_x_id = 0) in;
+//   constants.Set<VkBool32>(1, VK_TRUE);
+class SpecializationConstants {
+ public:
+  SpecializationConstants(containers::Allocator* allocator)
+      : entries_(allocator), data_(allocator) {}
+
+  // Sets the constant |constant_id| to |value|. The type has to match the
+  // type of the constant in the shader, use VkBool32 for bool constants.
+  template <typename T>
+  void Set(uint32_t constant_id, const T& value) {
+    for (auto& entry : entries_) {
+      if (entry.constantID == constant_id && entry.size == sizeof(T)) {
+        memcpy(data_.data() + entry.offset, &value, sizeof(T));
+        return;
+      }
+    }
+    const uint32_t offset = static_cast<uint32_t>(data_.size());
+    data_.resize(offset + sizeof(T));
+    memcpy(data_.data() + offset, &value, sizeof(T));
+    entries_.push_back({
+        constant_id,  // constantID
+        offset,       // offset
+        sizeof(T)     // size
+    });
+  }
+
+  bool empty() const { return entries_.empty(); }
+
+  // Returns the specialization info to create a shader stage with, or
+  // nullptr if no constants are set. It stays valid until this is changed,
+  // moved or destroyed.
+  const VkSpecializationInfo* info() {
+    if (entries_.empty()) {
+      return nullptr;
+    }
+    info_ = {
+        static_cast<uint32_t>(entries_.size()),  // mapEntryCount
+        entries_.data(),                         // pMapEntries
+        data_.size(),                            // dataSize
+        data_.data()                             // pData
+    };
+    return &info_;
+  }
+
+ private:
+  containers::vector<VkSpecializationMapEntry> entries_;
+  containers::vector<uint8_t> data_;
+  VkSpecializationInfo info_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_SPECIALIZATION_CONSTANTS_H
@@ -0,0 +1,172 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_STRUCTURE_CHAIN_H
+#define VULKAN_HELPERS_STRUCTURE_CHAIN_H
+
+#include "vulkan_wrapper/instance_wrapper.h"
+
+namespace vulkan {
+
+// StructureType<T>::value is the sType of the Vulkan structure T. Only the
+// structures that are chained somewhere have one, others can be added with
+// VULKAN_STRUCTURE_TYPE.
+template <typename T>
+struct StructureType;
+
+#define VULKAN_STRUCTURE_TYPE(T, S)          \
+  template <>                                \
+  struct StructureType<T> {                  \
+    static const VkStructureType value = S; \
+  }
+
+VULKAN_STRUCTURE_TYPE(VkPhysicalDeviceFeatures2,
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2);
+VULKAN_STRUCTURE_TYPE(VkPhysicalDeviceProperties2,
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2);
+VULKAN_STRUCTURE_TYPE(VkPhysicalDeviceSubgroupProperties,
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceConservativeRasterizationPropertiesEXT,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONSERVATIVE_RASTERIZATION_PROPERTIES_EXT);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceFloatControlsPropertiesKHR,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FLOAT_CONTROLS_PROPERTIES_KHR);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceProtectedMemoryFeatures,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROTECTED_MEMORY_FEATURES);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceHostQueryResetFeaturesEXT,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES_EXT);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDevice8BitStorageFeaturesKHR,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES_KHR);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceShaderFloat16Int8FeaturesKHR,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceVulkanMemoryModelFeaturesKHR,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_MEMORY_MODEL_FEATURES_KHR);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceShaderAtomicInt64FeaturesKHR,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES_KHR);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceBufferDeviceAddressFeaturesKHR,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR);
+VULKAN_STRUCTURE_TYPE(VkPhysicalDeviceMultiviewProperties,
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES);
+VULKAN_STRUCTURE_TYPE(
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR,
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR);
+VULKAN_STRUCTURE_TYPE(
+    VkPipelineRasterizationConservativeStateCreateInfoEXT,
+    VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_CONSERVATIVE_STATE_CREATE_INFO_EXT);
+VULKAN_STRUCTURE_TYPE(
+    VkPipelineRasterizationDepthClipStateCreateInfoEXT,
+    VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_DEPTH_CLIP_STATE_CREATE_INFO_EXT);
+VULKAN_STRUCTURE_TYPE(
+    VkPipelineSampleLocationsStateCreateInfoEXT,
+    VK_STRUCTURE_TYPE_PIPELINE_SAMPLE_LOCATIONS_STATE_CREATE_INFO_EXT);
+
+namespace internal {
+// One structure of a StructureChain, followed by the rest of them.
+template <typename... Ts>
+struct ChainLink;
+
+template <typename T>
+struct ChainLink<T> {
+  ChainLink() : value() {}
+  void Link(const void* next) {
+    value.sType = StructureType<T>::value;
+    value.pNext = const_cast<void*>(next);
+  }
+  T value;
+};
+
+template <typename T, typename U, typename... Ts>
+struct ChainLink<T, U, Ts...> {
+  ChainLink() : value(), rest() {}
+  void Link(const void* next) {
+    value.sType = StructureType<T>::value;
+    value.pNext = &rest.value;
+    rest.Link(next);
+  }
+  T value;
+  ChainLink<U, Ts...> rest;
+};
+
+// Finds the first structure of type T in a ChainLink.
+template <typename T, typename Link>
+struct ChainGet;
+
+template <typename T, typename... Ts>
+struct ChainGet<T, ChainLink<T, Ts...>> {
+  static T* Get(ChainLink<T, Ts...>* link) { return &link->value; }
+};
+
+template <typename T, typename U, typename... Ts>
+struct ChainGet<T, ChainLink<U, Ts...>> {
+  static T* Get(ChainLink<U, Ts...>* link) {
+    return ChainGet<T, ChainLink<Ts...>>::Get(&link->rest);
+  }
+};
+}  // namespace internal
+
+// StructureChain holds the Vulkan structures T and Ts, zero initialized, in
+// one block of storage, with their sTypes set and every pNext pointing at the
+// structure after it. The pNext of the last one is |next|, so that a chain
+// can be put in front of the structures of an application. Finding a
+// structure by its type is resolved at compile time, and asking for a type
+// that is not in the chain does not compile.
+//
+// The chain points into itself, so it can not be copied.
+template <typename T, typename... Ts>
+class StructureChain {
+ public:
+  explicit StructureChain(const void* next = nullptr) { links_.Link(next); }
+
+  StructureChain(const StructureChain&) = delete;
+  StructureChain& operator=(const StructureChain&) = delete;
+
+  // Returns the first structure of type U.
+  template <typename U>
+  U& get() {
+    return *internal::ChainGet<U, internal::ChainLink<T, Ts...>>::Get(&links_);
+  }
+
+  // Copies |value| into the first structure of type U, but keeps the sType
+  // and pNext of the chain.
+  template <typename U>
+  void Set(const U& value) {
+    U& structure = get<U>();
+    auto next = structure.pNext;
+    structure = value;
+    structure.sType = StructureType<U>::value;
+    structure.pNext = next;
+  }
+
+  // The first structure, which is where the chain starts.
+  T* head() { return &links_.value; }
+
+ private:
+  internal::ChainLink<T, Ts...> links_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_STRUCTURE_CHAIN_H
@@ -0,0 +1,131 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_THERMAL_LIMITER_H
+#define VULKAN_HELPERS_THERMAL_LIMITER_H
+
+#include "support/entry/entry.h"
+#include "support/log/log.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace vulkan {
+
+// ThermalLimiter samples the thermal status and headroom of the device once
+// a second, and logs them every 10 samples, so that long runs show when the
+// device started to throttle.
+//
+// If the entry data has a thermal headroom target, it also caps the frame
+// rate: while the headroom that is forecast is above the target, the minimum
+// frame time grows by a tenth of the average frame time, and while it is well
+// below the target, it shrinks by a tenth again until the frame rate is no
+// longer capped.
+class ThermalLimiter {
+ public:
+  // How far ahead the headroom is forecast.
+  static const int32_t kForecastSeconds = 10;
+  // How many samples are taken between two logged lines.
+  static const uint32_t kSamplesPerLog = 10;
+
+  ThermalLimiter(const entry::EntryData* data, logging::Logger* log)
+      : data_(data),
+        log_(log),
+        target_(data->thermal_headroom_target()),
+        status_(data->thermal_status()),
+        max_status_(status_),
+        headroom_(data->thermal_headroom(kForecastSeconds)),
+        min_frame_time_(0.0f),
+        time_since_sample_(0.0f),
+        frame_time_sum_(0.0f),
+        work_time_sum_(0.0f),
+        num_frames_(0),
+        num_samples_(0),
+        average_frame_time_(0.0f) {}
+
+  // Records a frame that took |frame_seconds| in total, |slept_seconds| of
+  // which were spent waiting for the minimum frame time, and samples the
+  // thermal state once a second has passed since the last sample.
+  void EndFrame(float frame_seconds, float slept_seconds) {
+    time_since_sample_ += frame_seconds;
+    frame_time_sum_ += frame_seconds;
+    work_time_sum_ += std::max(frame_seconds - slept_seconds, 0.0f);
+    ++num_frames_;
+    if (time_since_sample_ < 1.0f) {
+      return;
+    }
+    average_frame_time_ = frame_time_sum_ / num_frames_;
+    const float average_work_time = work_time_sum_ / num_frames_;
+    time_since_sample_ = 0.0f;
+    frame_time_sum_ = 0.0f;
+    work_time_sum_ = 0.0f;
+    num_frames_ = 0;
+
+    status_ = data_->thermal_status();
+    max_status_ = std::max(max_status_, status_);
+    headroom_ = data_->thermal_headroom(kForecastSeconds);
+
+    if (target_ > 0.0f && headroom_ >= 0.0f) {
+      if (headroom_ > target_) {
+        min_frame_time_ =
+            std::max(min_frame_time_, average_frame_time_) * 1.1f;
+      } else if (headroom_ < target_ * 0.9f && min_frame_time_ > 0.0f) {
+        min_frame_time_ *= 0.9f;
+        // The frames would not wait anymore anyway.
+        if (min_frame_time_ <= average_work_time) {
+          min_frame_time_ = 0.0f;
+        }
+      }
+    }
+
+    if (++num_samples_ % kSamplesPerLog == 0) {
+      LogStatistics("THERMAL:", log_);
+    }
+  }
+
+  // The time in seconds that every frame should at least take, or 0 if the
+  // frame rate is not capped.
+  float min_frame_time() const { return min_frame_time_; }
+
+  // Logs the thermal state as a single line of space separated key=value
+  // pairs after |prefix|, for scripts to pick up. The headroom is -1 if the
+  // device does not forecast it.
+  void LogStatistics(const char* prefix, logging::Logger* log) const {
+    log->LogInfo(prefix, " status=", status_, " max_status=", max_status_,
+                 " headroom=", headroom_, " target=", target_,
+                 " min_frame_ms=", min_frame_time_ * 1000.0f,
+                 " frame_ms=", average_frame_time_ * 1000.0f);
+  }
+
+ private:
+  const entry::EntryData* data_;
+  logging::Logger* log_;
+  float target_;
+  int32_t status_;
+  int32_t max_status_;
+  float headroom_;
+  float min_frame_time_;
+  float time_since_sample_;
+  float frame_time_sum_;
+  float work_time_sum_;
+  uint32_t num_frames_;
+  uint32_t num_samples_;
+  // The average frame time over the second before the last sample.
+  float average_frame_time_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_THERMAL_LIMITER_H
@@ -0,0 +1,145 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_TRANSIENT_RING_BUFFER_H
+#define VULKAN_HELPERS_TRANSIENT_RING_BUFFER_H
+
+#include "support/containers/vector.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace vulkan {
+
+// The maximum value for nonCoherentAtomSize from the vulkan spec.
+const ::VkDeviceSize kTransientRingAtomSize = 256;
+
+// A single allocation out of a TransientRingBuffer. It is only valid until
+// the frame it was allocated in has finished on the GPU.
+struct TransientAllocation {
+  ::VkBuffer buffer;
+  ::VkDeviceSize offset;
+  ::VkDeviceSize size;
+  // The host-visible address of the allocation.
+  char* data;
+};
+
+// TransientRingBuffer hands out short-lived host-visible memory, such as
+// staging data that is only needed for the frame that uses it.
+// All of the memory lives in one buffer that is created from the
+// host-visible (or host-coherent) arena once. Allocating is a pointer bump,
+// and all of the allocations that were made for a frame are reclaimed at
+// once, the next time that frame is started.
+//
+// BeginFrame(i) must only be called once every command that was submitted
+// for the previous use of frame i has finished on the GPU, i.e. after
+// waiting on that frame's fence. Since all frames are submitted to the same
+// queue, that also means every frame submitted before it has finished.
+class TransientRingBuffer {
+ public:
+  // |size| is the total number of bytes in the ring, shared between all
+  // |num_frames| frames. If |coherent| is true the memory comes from the
+  // host-coherent arena, and does not need to be flushed.
+  TransientRingBuffer(VulkanApplication* application, ::VkDeviceSize size,
+                      VkBufferUsageFlags usage, size_t num_frames,
+                      bool coherent = false)
+      : frame_ends_(application->GetAllocator()),
+        size_(RoundUpTo(size, kTransientRingAtomSize)),
+        head_(0),
+        tail_(0),
+        current_frame_(0),
+        log_(application->GetLogger()) {
+    frame_ends_.insert(frame_ends_.begin(), num_frames, 0);
+    buffer_ =
+        coherent ? application->CreateAndBindDefaultExclusiveCoherentBuffer(
+                       size_, usage)
+                 : application->CreateAndBindDefaultExclusiveHostBuffer(
+                       size_, usage);
+  }
+
+  // Releases all of the memory that was allocated the last time
+  // |frame_index| was started, and makes |frame_index| the frame that new
+  // allocations belong to.
+  void BeginFrame(size_t frame_index) {
+    LOG_ASSERT(<, log_, frame_index, frame_ends_.size());
+    // frame_ends_ only ever grows, so never move the tail backwards for a
+    // frame that is older than one that was already reclaimed.
+    if (frame_ends_[frame_index] > tail_) {
+      tail_ = frame_ends_[frame_index];
+    }
+    current_frame_ = frame_index;
+    frame_ends_[current_frame_] = head_;
+  }
+
+  // Returns |size| bytes, aligned to |alignment|, that stay valid until the
+  // current frame is started again.
+  TransientAllocation Allocate(
+      ::VkDeviceSize size, ::VkDeviceSize alignment = kTransientRingAtomSize) {
+    LOG_ASSERT(==, log_, ::VkDeviceSize(0), alignment & (alignment - 1));
+    // Keep every allocation on a nonCoherentAtomSize boundary so that it can
+    // be flushed on its own.
+    alignment = alignment > kTransientRingAtomSize ? alignment
+                                                   : kTransientRingAtomSize;
+    size = RoundUpTo(size, kTransientRingAtomSize);
+    LOG_ASSERT(<=, log_, size, size_);
+
+    ::VkDeviceSize offset = RoundUpTo(head_ % size_, alignment);
+    ::VkDeviceSize start = head_ - (head_ % size_) + offset;
+    if (offset + size > size_) {
+      // This does not fit before the end of the buffer, so wrap around and
+      // waste the remainder.
+      start = head_ - (head_ % size_) + size_;
+      offset = 0;
+    }
+    // Fail if this would overwrite memory that the GPU may still be using.
+    LOG_ASSERT(<=, log_, start + size - tail_, size_);
+
+    head_ = start + size;
+    frame_ends_[current_frame_] = head_;
+    return TransientAllocation{*buffer_, offset, size,
+                               buffer_->base_address() + offset};
+  }
+
+  // Makes host writes to |allocation| visible to the device.
+  void Flush(const TransientAllocation& allocation) {
+    buffer_->flush(allocation.offset, allocation.size);
+  }
+
+  ::VkBuffer buffer() const { return *buffer_; }
+  ::VkDeviceSize size() const { return size_; }
+  // Returns the number of bytes that may still be in use by the GPU.
+  ::VkDeviceSize bytes_in_flight() const { return head_ - tail_; }
+
+ private:
+  static ::VkDeviceSize RoundUpTo(::VkDeviceSize value,
+                                  ::VkDeviceSize power_of_2) {
+    return (value + power_of_2 - 1) & ~(power_of_2 - 1);
+  }
+
+  BufferPointer buffer_;
+  // head_, tail_ and frame_ends_ are positions in a stream of bytes that
+  // only ever grows. The offset into buffer_ is the position modulo size_.
+  // The position one past the last allocation made for each frame.
+  containers::vector<::VkDeviceSize> frame_ends_;
+  ::VkDeviceSize size_;
+  // The position where the next allocation will start.
+  ::VkDeviceSize head_;
+  // Everything before this position is no longer used by the GPU.
+  ::VkDeviceSize tail_;
+  size_t current_frame_;
+  logging::Logger* log_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_TRANSIENT_RING_BUFFER_H
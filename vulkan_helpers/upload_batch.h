@@ -0,0 +1,309 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_UPLOAD_BATCH_H_
+#define VULKAN_HELPERS_UPLOAD_BATCH_H_
+
+#include <cstring>
+
+#include "support/containers/vector.h"
+#include "vulkan_helpers/host_copy.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+#include "vulkan_helpers/vulkan_texture.h"
+
+namespace vulkan {
+
+// Every upload in a batch starts on this boundary in the staging buffer.
+// This is enough for the texel block size of every format that
+// convert_img_to_c.py writes.
+const ::VkDeviceSize kUploadBatchAlignment = 16;
+
+// UploadBatch collects the data of several models, textures and buffers, and
+// uploads all of it through a single staging buffer. All of the copies
+// share one barrier before them, and one barrier after them, instead of each
+// object recording its own.
+//
+// The resources of every object are created when it is added, but the data
+// is only read when the batch is recorded, so it has to stay valid until
+// then.
+class UploadBatch {
+ public:
+  explicit UploadBatch(VulkanApplication* application)
+      : application_(application),
+        models_(application->GetAllocator()),
+        textures_(application->GetAllocator()),
+        buffers_(application->GetAllocator()),
+        size_(0) {}
+
+  // Creates the vertex and index buffers of |model|, and adds its data to
+  // the batch. Once the batch has completed, the buffers are ready for
+  // vertex input.
+  void AddModel(VulkanModel* model) {
+    model->CreateBuffers(application_);
+    ::VkDeviceSize vertex_offset = Reserve(model->vertex_data_size_);
+    ::VkDeviceSize index_offset = Reserve(model->index_data_size_);
+    models_.push_back({model, vertex_offset, index_offset});
+  }
+
+  // Creates the image of |texture| like VulkanTexture::InitializeData does,
+  // and adds its data to the batch. Once the batch has completed, the image
+  // is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+  void AddTexture(VulkanTexture* texture,
+                  VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+                  VkImageCreateFlags flags = 0, void* pNext = nullptr,
+                  bool generate_mips = false) {
+    // Streaming textures upload their pages in UpdateResidency instead.
+    LOG_ASSERT(==, application_->GetLogger(), 0u, texture->streaming_budget_);
+    texture->CreateImage(application_, usage, flags, pNext, generate_mips);
+    textures_.push_back({texture, Reserve(texture->upload_data_size_)});
+  }
+
+  // Adds a copy of |size| bytes of |data| to |offset| in |buffer|, which must
+  // have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT. Once the batch
+  // has completed, the write is visible to |dst_access| in |dst_stages|.
+  void AddBuffer(VulkanApplication::Buffer* buffer, ::VkDeviceSize offset,
+                 const void* data, size_t size, VkAccessFlags dst_access,
+                 VkPipelineStageFlags dst_stages) {
+    buffers_.push_back(
+        {buffer, offset, data, size, dst_access, dst_stages, Reserve(size)});
+  }
+
+  // Copies the data of everything in the batch into one staging buffer, and
+  // records all of the copies into |command_buffer|. Returns the staging
+  // buffer, which has to be kept alive until |command_buffer| has finished
+  // executing. The batch is empty afterwards.
+  containers::unique_ptr<VulkanApplication::Buffer> Record(
+      VkCommandBuffer* command_buffer) {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    containers::Allocator* allocator = application_->GetAllocator();
+
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        size_,                                 // size
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr                                // pQueueFamilyIndices
+    };
+    containers::unique_ptr<VulkanApplication::Buffer> staging =
+        application_->CreateAndBindUploadBuffer(&create_info);
+    char* base = staging->base_address();
+    jobs::JobSystem* job_system = application_->job_system();
+    for (const auto& model : models_) {
+      CopyToMappedMemory(job_system, base + model.vertex_offset,
+                         model.model->upload_vertices_,
+                         model.model->vertex_data_size_);
+      CopyToMappedMemory(job_system, base + model.index_offset,
+                         model.model->indices_,
+                         model.model->index_data_size_);
+    }
+    for (const auto& texture : textures_) {
+      CopyToMappedMemory(job_system, base + texture.offset,
+                         texture.texture->upload_data_,
+                         texture.texture->upload_data_size_);
+    }
+    for (const auto& buffer : buffers_) {
+      CopyToMappedMemory(job_system, base + buffer.staging_offset,
+                         buffer.data, buffer.size);
+    }
+    staging->flush();
+
+    // One barrier moves every image into TRANSFER_DST_OPTIMAL, and makes the
+    // host writes visible to the copies.
+    containers::vector<VkImageMemoryBarrier> image_barriers(allocator);
+    for (const auto& texture : textures_) {
+      image_barriers.push_back(texture.texture->GetUploadBarrier());
+    }
+    VkBufferMemoryBarrier staging_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_HOST_WRITE_BIT,                 // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT,              // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *staging,                                 // buffer
+        0,                                        // offset
+        size_,                                    // size
+    };
+    (*command_buffer)
+        ->vkCmdPipelineBarrier(
+            *command_buffer, VK_PIPELINE_STAGE_HOST_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &staging_barrier,
+            static_cast<uint32_t>(image_barriers.size()),
+            image_barriers.empty() ? nullptr : image_barriers.data());
+
+    for (const auto& model : models_) {
+      VkBufferCopy vertex_region = {model.vertex_offset, 0,
+                                    model.model->vertex_data_size_};
+      (*command_buffer)
+          ->vkCmdCopyBuffer(*command_buffer, *staging,
+                            *model.model->vertexBuffer_, 1, &vertex_region);
+      VkBufferCopy index_region = {model.index_offset, 0,
+                                   model.model->index_data_size_};
+      (*command_buffer)
+          ->vkCmdCopyBuffer(*command_buffer, *staging,
+                            *model.model->indexBuffer_, 1, &index_region);
+    }
+
+    // All of the copies into the same buffer are merged into one command.
+    containers::vector<bool> copied(buffers_.size(), false, allocator);
+    containers::vector<VkBufferCopy> regions(allocator);
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      if (copied[i]) {
+        continue;
+      }
+      regions.clear();
+      for (size_t j = i; j < buffers_.size(); ++j) {
+        if (buffers_[j].buffer == buffers_[i].buffer) {
+          regions.push_back({buffers_[j].staging_offset, buffers_[j].offset,
+                             buffers_[j].size});
+          copied[j] = true;
+        }
+      }
+      (*command_buffer)
+          ->vkCmdCopyBuffer(*command_buffer, *staging, *buffers_[i].buffer,
+                            static_cast<uint32_t>(regions.size()),
+                            regions.data());
+    }
+
+    for (const auto& texture : textures_) {
+      VkBufferImageCopy image_regions[3];
+      uint32_t num_regions =
+          texture.texture->GetCopyRegions(texture.offset, image_regions);
+      (*command_buffer)
+          ->vkCmdCopyBufferToImage(*command_buffer, *staging,
+                                   texture.texture->image(),
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   num_regions, image_regions);
+    }
+    for (const auto& texture : textures_) {
+      texture.texture->GenerateMips(command_buffer,
+                                    texture.texture->mip_filter_);
+    }
+
+    // One barrier makes every write visible to whatever reads it.
+    containers::vector<VkBufferMemoryBarrier> buffer_barriers(allocator);
+    VkPipelineStageFlags dst_stages = 0;
+    for (const auto& model : models_) {
+      VkBufferMemoryBarrier model_barriers[2];
+      model.model->GetFinalBarriers(model_barriers);
+      buffer_barriers.push_back(model_barriers[0]);
+      buffer_barriers.push_back(model_barriers[1]);
+      dst_stages |= model.model->GetFinalStages();
+    }
+    for (const auto& buffer : buffers_) {
+      buffer_barriers.push_back({
+          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+          nullptr,                                  // pNext
+          VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+          buffer.dst_access,                        // dstAccessMask
+          VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+          *buffer.buffer,                           // buffer
+          buffer.offset,                            // offset
+          buffer.size,                              // size
+      });
+      dst_stages |= buffer.dst_stages;
+    }
+    image_barriers.clear();
+    for (const auto& texture : textures_) {
+      VkImageMemoryBarrier texture_barriers[2];
+      uint32_t num_barriers =
+          texture.texture->GetFinalBarriers(texture_barriers);
+      image_barriers.insert(image_barriers.end(), texture_barriers,
+                            texture_barriers + num_barriers);
+      dst_stages |= VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+    }
+    if (dst_stages == 0) {
+      dst_stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+    (*command_buffer)
+        ->vkCmdPipelineBarrier(
+            *command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stages, 0, 0,
+            nullptr, static_cast<uint32_t>(buffer_barriers.size()),
+            buffer_barriers.empty() ? nullptr : buffer_barriers.data(),
+            static_cast<uint32_t>(image_barriers.size()),
+            image_barriers.empty() ? nullptr : image_barriers.data());
+
+    models_.clear();
+    textures_.clear();
+    buffers_.clear();
+    size_ = 0;
+    return staging;
+  }
+
+  // Records the batch into a new command buffer, and submits it to the
+  // render queue. Returns a value that can be given to
+  // VulkanApplication::IsUploadComplete. The staging memory is released once
+  // the upload has completed, by VulkanApplication::ReleaseCompletedUploads.
+  uint64_t Submit() {
+    VkCommandBuffer command_buffer = application_->GetCommandBuffer();
+    VkCommandBufferBeginInfo begin_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+    command_buffer->vkBeginCommandBuffer(command_buffer, &begin_info);
+    containers::unique_ptr<VulkanApplication::Buffer> staging =
+        Record(&command_buffer);
+    command_buffer->vkEndCommandBuffer(command_buffer);
+    return application_->SubmitUpload(std::move(command_buffer),
+                                      std::move(staging));
+  }
+
+  // Returns the number of bytes of staging memory the batch needs so far.
+  ::VkDeviceSize size() const { return size_; }
+
+ private:
+  struct ModelUpload {
+    VulkanModel* model;
+    ::VkDeviceSize vertex_offset;
+    ::VkDeviceSize index_offset;
+  };
+  struct TextureUpload {
+    VulkanTexture* texture;
+    ::VkDeviceSize offset;
+  };
+  struct BufferUpload {
+    VulkanApplication::Buffer* buffer;
+    ::VkDeviceSize offset;
+    const void* data;
+    size_t size;
+    VkAccessFlags dst_access;
+    VkPipelineStageFlags dst_stages;
+    ::VkDeviceSize staging_offset;
+  };
+
+  // Returns the offset in the staging buffer of |size| new bytes.
+  ::VkDeviceSize Reserve(::VkDeviceSize size) {
+    ::VkDeviceSize offset =
+        (size_ + kUploadBatchAlignment - 1) & ~(kUploadBatchAlignment - 1);
+    size_ = offset + size;
+    return offset;
+  }
+
+  VulkanApplication* application_;
+  containers::vector<ModelUpload> models_;
+  containers::vector<TextureUpload> textures_;
+  containers::vector<BufferUpload> buffers_;
+  ::VkDeviceSize size_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_UPLOAD_BATCH_H_
@@ -16,10 +16,18 @@
 #include "vulkan_helpers/vulkan_application.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <string>
 #include <tuple>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "support/containers/small_vector.h"
 #include "support/containers/unordered_map.h"
+#include "support/trace/startup.h"
 #include "vulkan_helpers/helper_functions.h"
 #include "vulkan_helpers/vulkan_model.h"
 
@@ -27,32 +35,223 @@ typedef void(VKAPI_PTR* PFN_vkSetSwapchainCallback)(
     VkSwapchainKHR, void(void*, uint8_t*, size_t), void*);
 
 namespace vulkan {
-VkDescriptorPool DescriptorSet::CreateDescriptorPool(
+// These linked-list nodes are ordered by offset into their block.
+// the first node has a prev of nullptr, and the last node has a next of
+// nullptr.
+struct AllocationToken {
+  AllocationToken* next;
+  AllocationToken* prev;
+  ::VkDeviceSize allocationSize;
+  ::VkDeviceSize offset;
+  // Location into the map of unused chunks. This is only valid when
+  // in_use == false.
+  containers::ordered_multimap<::VkDeviceSize, AllocationToken*>::iterator
+      map_location;
+  bool in_use;
+  // The block of device memory that this token lives in.
+  ArenaBlock* block;
+  // Links in the TLSF bucket of unused chunks. These are only valid when
+  // in_use == false, and the arena uses ArenaStrategy::kTLSF.
+  AllocationToken* next_free;
+  AllocationToken* prev_free;
+  // The number of bytes at the front of an in-use token that were skipped to
+  // satisfy its alignment.
+  ::VkDeviceSize padding;
+};
+
+// A single ::VkDeviceMemory allocation owned by a VulkanArena.
+struct ArenaBlock {
+  ::VkDeviceMemory memory;
+  ::VkDeviceSize size;
+  // The host-visible address of this block, or nullptr if it is not mapped.
+  char* base_address;
+  // The first token (by offset) in this block.
+  AllocationToken* first_token;
+  // The position of this block in its arena. Blocks are only ever released
+  // from the end, so this never changes.
+  size_t index;
+  // True if this block holds a single dedicated allocation, and is not part
+  // of the arena's list of blocks.
+  bool dedicated;
+  // A buffer that spans all of the memory of this block, or VK_NULL_HANDLE if
+  // the arena was not asked to create one.
+  ::VkBuffer buffer;
+};
+
+namespace {
+// The number of AllocationTokens that a VulkanArena allocates from the host
+// at once.
+const size_t kTokensPerSlab = 64;
+}  // anonymous namespace
+
+DescriptorSet::DescriptorSet(
     containers::Allocator* allocator, VkDevice* device,
-    std::initializer_list<VkDescriptorSetLayoutBinding> bindings) {
-  containers::unordered_map<uint32_t, uint32_t> counts(allocator);
-  for (auto binding : bindings) {
-    counts[static_cast<uint32_t>(binding.descriptorType)] +=
-        binding.descriptorCount;
+    DescriptorAllocator* descriptor_allocator,
+    std::initializer_list<VkDescriptorSetLayoutBinding> bindings)
+    : layout_(CreateDescriptorSetLayout(allocator, device, bindings)),
+      set_(descriptor_allocator->Allocate(layout_.get_raw_object(),
+                                          bindings)),
+      bindings_(bindings.begin(), bindings.end(), allocator) {}
+
+namespace {
+// Returns true if |extensions| contains |name|.
+bool HasExtension(const std::initializer_list<const char*>& extensions,
+                  const char* name) {
+  for (const char* extension : extensions) {
+    if (strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if |extensions| contains everything that is needed to query
+// for, and make, dedicated allocations.
+bool HasDedicatedAllocationExtensions(
+    const std::initializer_list<const char*>& extensions) {
+  return HasExtension(extensions, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME) &&
+         HasExtension(extensions,
+                      VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+}
+
+// Returns true if |extensions| contains VK_KHR_imageless_framebuffer, and
+// the feature is enabled in the pNext chain |device_next| of the device.
+bool HasImagelessFramebuffers(
+    const std::initializer_list<const char*>& extensions,
+    const void* device_next) {
+  if (!HasExtension(extensions, VK_KHR_IMAGELESS_FRAMEBUFFER_EXTENSION_NAME)) {
+    return false;
+  }
+  for (auto next = static_cast<const VkBaseInStructure*>(device_next); next;
+       next = next->pNext) {
+    if (next->sType ==
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES_KHR) {
+      return reinterpret_cast<
+                 const VkPhysicalDeviceImagelessFramebufferFeaturesKHR*>(next)
+                 ->imagelessFramebuffer == VK_TRUE;
+    }
   }
+  return false;
+}
 
-  containers::vector<VkDescriptorPoolSize> pool_sizes(allocator);
-  pool_sizes.reserve(counts.size());
-  for (auto p : counts) {
-    pool_sizes.push_back({static_cast<VkDescriptorType>(p.first), p.second});
+// Returns true if |extensions| contains
+// VK_KHR_pipeline_executable_properties, and the pipelineExecutableInfo
+// feature is enabled in the pNext chain |device_next| of the device.
+bool HasPipelineExecutableInfo(
+    const std::initializer_list<const char*>& extensions,
+    const void* device_next) {
+  if (!HasExtension(extensions,
+                    VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME)) {
+    return false;
+  }
+  for (auto next = static_cast<const VkBaseInStructure*>(device_next); next;
+       next = next->pNext) {
+    if (next->sType ==
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR) {
+      using Features = VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR;
+      return reinterpret_cast<const Features*>(next)->pipelineExecutableInfo ==
+             VK_TRUE;
+    }
   }
+  return false;
+}
 
-  return vulkan::CreateDescriptorPool(
-      device, static_cast<uint32_t>(pool_sizes.size()), pool_sizes.data(), 1);
+// Returns true if |extensions| contains VK_KHR_buffer_device_address, and
+// the bufferDeviceAddress feature is enabled in the pNext chain
+// |device_next| of the device.
+bool BufferDeviceAddressEnabled(
+    const std::initializer_list<const char*>& extensions,
+    const void* device_next) {
+  if (!HasExtension(extensions,
+                    VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME)) {
+    return false;
+  }
+  for (auto next = static_cast<const VkBaseInStructure*>(device_next); next;
+       next = next->pNext) {
+    if (next->sType ==
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR) {
+      return reinterpret_cast<
+                 const VkPhysicalDeviceBufferDeviceAddressFeaturesKHR*>(next)
+                 ->bufferDeviceAddress == VK_TRUE;
+    }
+  }
+  return false;
 }
 
-DescriptorSet::DescriptorSet(
-    containers::Allocator* allocator, VkDevice* device,
-    std::initializer_list<VkDescriptorSetLayoutBinding> bindings)
-    : pool_(CreateDescriptorPool(allocator, device, bindings)),
-      layout_(CreateDescriptorSetLayout(allocator, device, bindings)),
-      set_(AllocateDescriptorSet(device, pool_.get_raw_object(),
-                                 layout_.get_raw_object())) {}
+// The names of the heaps in the files of -write-memory-stats, in the order
+// of ConfigureHeapSizes.
+const char* const kConfigurableHeaps[4] = {"host", "device_image",
+                                           "device_buffer", "coherent"};
+
+// Reads the high water mark of every one of kConfigurableHeaps from
+// |location|, which was written by -write-memory-stats, into |marks|. The
+// heaps of more than one device keep their largest mark, and heaps that are
+// not in the file keep 0.
+bool ReadHighWaterMarks(const char* location, uint64_t* marks) {
+  std::ifstream file(location);
+  if (!file) {
+    return false;
+  }
+  const char kHeap[] = "\"heap\": \"";
+  const char kHighWaterMark[] = "\"high_water_mark\": ";
+  std::string line;
+  while (std::getline(file, line)) {
+    const size_t heap = line.find(kHeap);
+    const size_t mark = line.find(kHighWaterMark);
+    if (heap == std::string::npos || mark == std::string::npos) {
+      continue;
+    }
+    const size_t name = heap + sizeof(kHeap) - 1;
+    const size_t name_end = line.find('"', name);
+    const uint64_t value = strtoull(
+        line.c_str() + mark + sizeof(kHighWaterMark) - 1, nullptr, 10);
+    for (size_t i = 0; i < 4; ++i) {
+      if (line.compare(name, name_end - name, kConfigurableHeaps[i]) == 0) {
+        marks[i] = std::max(marks[i], value);
+      }
+    }
+  }
+  return true;
+}
+
+// Overrides the sizes of the host, device image, device buffer and coherent
+// heaps that the application asked for, in that order, with the options of
+// |entry_data|. A size is either a number of MB or x<factor>, which scales
+// the size of the application. Heaps without one are sized from the high
+// water marks of -heap-sizes-from, with a quarter on top, if it is given.
+void ConfigureHeapSizes(const entry::EntryData* entry_data,
+                        logging::Logger* log, uint32_t* sizes[4]) {
+  const char* options[4] = {
+      entry_data->host_heap_size(), entry_data->image_heap_size(),
+      entry_data->device_heap_size(), entry_data->coherent_heap_size()};
+  uint64_t marks[4] = {};
+  const bool has_marks =
+      entry_data->heap_sizes_from() &&
+      ReadHighWaterMarks(entry_data->heap_sizes_from(), marks);
+  if (entry_data->heap_sizes_from() && !has_marks) {
+    log->LogError("Could not read the memory stats ",
+                  entry_data->heap_sizes_from());
+  }
+  const uint64_t kMB = 1024 * 1024;
+  for (size_t i = 0; i < 4; ++i) {
+    uint64_t size = *sizes[i];
+    if (options[i] && options[i][0] == 'x') {
+      size = static_cast<uint64_t>(*sizes[i] * atof(options[i] + 1));
+    } else if (options[i]) {
+      size = strtoull(options[i], nullptr, 10) * kMB;
+    } else if (has_marks && marks[i] > 0) {
+      size = (marks[i] + marks[i] / 4 + kMB - 1) / kMB * kMB;
+    } else {
+      continue;
+    }
+    // The arenas are sized in 32 bits.
+    size = std::min<uint64_t>(size, 0xFFFFFFFFu);
+    log->LogInfo("The ", kConfigurableHeaps[i], " heap is ", size,
+                 " bytes instead of ", *sizes[i]);
+    *sizes[i] = static_cast<uint32_t>(size);
+  }
+}
+}  // anonymous namespace
 
 VulkanApplication::VulkanApplication(
     containers::Allocator* allocator, logging::Logger* log,
@@ -67,17 +266,40 @@ VulkanApplication::VulkanApplication(
     bool use_host_query_reset, VkColorSpaceKHR swapchain_color_space,
     bool use_shared_presentation, bool use_mutable_swapchain_format,
     const void* swapchain_extensions, bool use_vulkan_1_1, bool use_10bit_hdr,
-    void* device_next)
+    void* device_next, ArenaStrategy arena_strategy, bool use_transfer_queue,
+    jobs::JobSystem* job_system, uint32_t num_async_compute_queues,
+    uint32_t swapchain_images, const char* present_mode,
+    VkSharingMode swapchain_sharing_mode)
     : allocator_(allocator),
+      object_pool_(allocator_),
       log_(log),
       entry_data_(entry_data),
       swapchain_images_(allocator_),
+      async_compute_queues_(allocator_),
       render_queue_(nullptr),
       present_queue_(nullptr),
       render_queue_index_(0u),
       present_queue_index_(0u),
+      num_async_compute_queues_(num_async_compute_queues),
+      transfer_queue_index_(0xFFFFFFFF),
       use_protected_memory_(use_protected_memory),
-      library_wrapper_(allocator_, log_),
+      use_dedicated_allocations_(
+          HasDedicatedAllocationExtensions(device_extensions)),
+      use_memory_budget_(
+          HasExtension(device_extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)),
+      use_descriptor_update_templates_(HasExtension(
+          device_extensions, VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME)),
+      use_descriptor_indexing_(HasExtension(
+          device_extensions, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)),
+      use_buffer_device_address_(
+          BufferDeviceAddressEnabled(device_extensions, device_next)),
+      use_debug_utils_(VULKAN_DEBUG_LABELS &&
+                       HasExtension(instance_extensions,
+                                    VK_EXT_DEBUG_UTILS_EXTENSION_NAME)),
+      arena_strategy_(arena_strategy),
+      buffer_image_granularity_(1),
+      job_system_(job_system),
+      library_wrapper_(allocator_, log_, entry_data->null_driver()),
       instance_(!use_vulkan_1_1 ? CreateInstanceForApplication(
                                       allocator_, &library_wrapper_,
                                       entry_data_, instance_extensions)
@@ -88,10 +310,13 @@ VulkanApplication::VulkanApplication(
       device_(!use_device_group
                   ? CreateDevice(device_extensions, features,
                                  use_async_compute_queue, use_sparse_binding,
-                                 use_host_query_reset, device_next)
+                                 use_host_query_reset, device_next,
+                                 use_transfer_queue)
                   : CreateDeviceGroup(device_extensions, features,
                                       use_async_compute_queue,
                                       use_sparse_binding, device_next)),
+      pipeline_cache_(VK_NULL_HANDLE, nullptr, &device_),
+      bring_up_jobs_(StartBringUpJobs()),
       swapchain_(CreateDefaultSwapchain(
           &instance_, &device_, &surface_, allocator_, render_queue_index_,
           present_queue_index_, entry_data_, swapchain_color_space,
@@ -99,18 +324,91 @@ VulkanApplication::VulkanApplication(
           use_mutable_swapchain_format
               ? VK_SWAPCHAIN_CREATE_MUTABLE_FORMAT_BIT_KHR
               : 0,
-          use_10bit_hdr, swapchain_extensions)),
+          use_10bit_hdr, swapchain_extensions, VK_NULL_HANDLE,
+          swapchain_images, present_mode, swapchain_sharing_mode)),
+      swapchain_color_space_(swapchain_color_space),
+      use_shared_presentation_(use_shared_presentation),
+      swapchain_flags_(use_mutable_swapchain_format
+                           ? VK_SWAPCHAIN_CREATE_MUTABLE_FORMAT_BIT_KHR
+                           : 0),
+      use_10bit_hdr_(use_10bit_hdr),
+      swapchain_extensions_(swapchain_extensions),
+      requested_swapchain_images_(swapchain_images),
+      requested_present_mode_(present_mode),
+      swapchain_sharing_mode_(swapchain_sharing_mode),
+      host_allocation_callbacks_(
+          entry_data->driver_allocation_stats() ||
+                  entry_data->audit_allocations() != entry::kAllocationAuditOff
+              ? containers::make_unique<HostAllocationCallbacks>(
+                    allocator_, allocator_, true)
+              : nullptr),
       command_pools_(allocator_),
-      pipeline_cache_(CreateDefaultPipelineCache(&device_, entry_data)),
+      queue_command_pools_(allocator_),
+      command_buffer_allocator_(allocator_, &device_,
+                                host_allocation_callbacks()),
+      shader_module_cache_(allocator_, &device_),
+      pipeline_object_cache_(allocator_, &device_),
+      framebuffer_cache_(allocator_, &device_,
+                         HasImagelessFramebuffers(device_extensions,
+                                                  device_next)),
+      render_pass_cache_(allocator_, &device_),
+      sampler_cache_(allocator_, &device_),
+      descriptor_allocator_(allocator_, &device_),
+      worker_pipeline_caches_(allocator_),
       host_accessible_heap_(allocator_),
       coherent_heap_(allocator_),
       device_peer_memory_heaps_(allocator_),
+      shared_buffer_arenas_(allocator_),
+      pending_uploads_(allocator_),
+      next_upload_value_(1),
+      completed_upload_value_(0),
+      pending_readbacks_(allocator_),
+      managed_images_(allocator_),
+      residency_frame_(0),
+      residency_retire_delay_(1),
+      num_image_evictions_(0),
+      headless_images_(allocator_),
+      deferred_deletion_queue_(allocator_),
       should_exit_(false) {
   if (!device_.is_valid()) {
     return;
   }
 
-  if (entry_data->output_frame_index() >= 1) {
+  if (HasExtension(device_extensions,
+                   VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)) {
+    pipeline_creation_stats_ =
+        containers::make_unique<PipelineCreationStats>(allocator_, allocator_);
+  }
+
+  if (entry_data->pipeline_cache_prefix()) {
+    pipeline_corpus_ =
+        containers::make_unique<PipelineCorpus>(allocator_, allocator_,
+                                                &device_);
+    bring_up_jobs_->Run([this]() {
+      pipeline_corpus_->Load(
+          GetPipelineCorpusPath(entry_data_->pipeline_cache_prefix())
+              .c_str());
+    });
+  }
+
+  if (entry_data->shader_stats()) {
+    if (HasPipelineExecutableInfo(device_extensions, device_next)) {
+      shader_statistics_ = containers::make_unique<ShaderStatistics>(
+          allocator_, allocator_, &instance_, &device_,
+          ShaderStatistics::Source::kPipelineExecutableProperties);
+    } else if (HasExtension(device_extensions,
+                            VK_AMD_SHADER_INFO_EXTENSION_NAME)) {
+      shader_statistics_ = containers::make_unique<ShaderStatistics>(
+          allocator_, allocator_, &instance_, &device_,
+          ShaderStatistics::Source::kAmdShaderInfo);
+    } else {
+      log_->LogError(
+          "-shader-stats needs VK_KHR_pipeline_executable_properties with "
+          "the pipelineExecutableInfo feature, or VK_AMD_shader_info");
+    }
+  }
+
+  if (entry_data->output_frame_index() >= 1 && !entry_data->headless()) {
     PFN_vkSetSwapchainCallback set_callback =
         reinterpret_cast<PFN_vkSetSwapchainCallback>(
             device_.getProcAddrFunction()(device_, "vkSetSwapchainCallback"));
@@ -152,8 +450,10 @@ VulkanApplication::VulkanApplication(
     set_callback(swapchain_, &cb_data::fn, cb);
   }
 
-  vulkan::LoadContainer(log_, device_->vkGetSwapchainImagesKHR,
-                        &swapchain_images_, device_, swapchain_);
+  if (!entry_data->headless()) {
+    vulkan::LoadContainer(log_, device_->vkGetSwapchainImagesKHR,
+                          &swapchain_images_, device_, swapchain_);
+  }
   // Relevant spec sections for determining what memory we will be allowed
   // to use for our buffer allocations.
   //  The memoryTypeBits member is identical for all VkBuffer objects created
@@ -175,6 +475,44 @@ VulkanApplication::VulkanApplication(
   // Furthermore for both types, we will have ZERO flags
   // set (we do not want to do sparse binding.)
 
+  uint32_t* heap_sizes[4] = {&host_buffer_size, &device_image_size,
+                             &device_buffer_size, &coherent_buffer_size};
+  ConfigureHeapSizes(entry_data_, log_, heap_sizes);
+
+  // If the driver reports a memory budget, then none of the arenas start out
+  // larger than what is left of the budget of their heap.
+  ::VkDeviceSize heap_headroom[VK_MAX_MEMORY_HEAPS] = {};
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget;
+  const bool has_budget = GetMemoryBudget(&budget);
+  if (has_budget) {
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; ++i) {
+      heap_headroom[i] = budget.heapBudget[i] > budget.heapUsage[i]
+                             ? budget.heapBudget[i] - budget.heapUsage[i]
+                             : 0;
+    }
+  }
+  auto clamp_to_budget = [this, has_budget, &heap_headroom](
+                             uint32_t memory_index,
+                             ::VkDeviceSize size) -> ::VkDeviceSize {
+    if (!has_budget) {
+      return size;
+    }
+    const uint32_t heap = device_.physical_device_memory_properties()
+                              .memoryTypes[memory_index]
+                              .heapIndex;
+    if (heap_headroom[heap] == 0) {
+      // Let the arena fall back on shrinking its allocation.
+      return size;
+    }
+    if (size > heap_headroom[heap]) {
+      log_->LogInfo("Memory budget of heap ", heap, " limits arena from ",
+                    size, " to ", heap_headroom[heap], " bytes");
+      size = heap_headroom[heap];
+    }
+    heap_headroom[heap] -= size;
+    return size;
+  };
+
   // containers::unique_ptr<VulkanArena>* device_memories[3] = {
   //&host_accessible_heap_, &device_only_buffer_heap_, &coherent_heap_};
   containers::vector<containers::unique_ptr<VulkanArena>*> device_memories[3] =
@@ -206,6 +544,19 @@ VulkanApplication::VulkanApplication(
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
           (use_protected_memory_ ? VK_MEMORY_PROPERTY_PROTECTED_BIT : 0u),
       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+  // Every arena allocates its first block of device memory right away, which
+  // can take a while, so the arenas are only described here, and created in
+  // parallel once all of them are known.
+  struct ArenaRequest {
+    containers::unique_ptr<VulkanArena>* arena;
+    ::VkDeviceSize size;
+    uint32_t memory_index;
+    bool map;
+    uint32_t device_mask;
+    bool device_address;
+  };
+  containers::vector<ArenaRequest> arena_requests(allocator_);
+
   bool m_gpu = device_.num_devices() > 1;
   for (size_t j = 0; j < device_.num_devices(); ++j) {
     for (size_t i = 0; i < 3; ++i) {
@@ -247,9 +598,12 @@ VulkanApplication::VulkanApplication(
 
       uint32_t memory_index = GetMemoryIndex(
           &device_, log_, requirements.memoryTypeBits, property_flags[i]);
-      *device_memories[i][j] = containers::make_unique<VulkanArena>(
-          allocator_, allocator_, log_, device_memory_sizes[i], memory_index,
-          &device_, host_mapped, m_gpu ? device_mask : 0);
+      arena_requests.push_back(
+          {device_memories[i][j],
+           clamp_to_budget(memory_index, device_memory_sizes[i]), memory_index,
+           host_mapped, m_gpu ? device_mask : 0,
+           // Only device buffers are read through their addresses.
+           i == 1 && use_buffer_device_address_});
     }
   }
 
@@ -316,13 +670,15 @@ VulkanApplication::VulkanApplication(
     LOG_ASSERT(!=, log, memory_index1, 0xFFFFFFFF);
     // For now we only handle 2 devices.
 
-    device_peer_memory_heaps_.push_back(containers::make_unique<VulkanArena>(
-        allocator_, allocator_, log_, device_peer_memory_size, memory_index0,
-        &device_, false));
-
-    device_peer_memory_heaps_.push_back(containers::make_unique<VulkanArena>(
-        allocator_, allocator_, log_, device_peer_memory_size, memory_index1,
-        &device_, false));
+    device_peer_memory_heaps_.resize(2);
+    arena_requests.push_back(
+        {&device_peer_memory_heaps_[0],
+         clamp_to_budget(memory_index0, device_peer_memory_size),
+         memory_index0, false, 0, false});
+    arena_requests.push_back(
+        {&device_peer_memory_heaps_[1],
+         clamp_to_budget(memory_index1, device_peer_memory_size),
+         memory_index1, false, 0, false});
   }
 
   // Same idea as above, but for image memory.
@@ -367,15 +723,93 @@ VulkanApplication::VulkanApplication(
     uint32_t memory_index =
         GetMemoryIndex(&device_, log_, requirements.memoryTypeBits,
                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    device_only_image_heap_ = containers::make_unique<VulkanArena>(
-        allocator_, allocator_, log_, device_image_size, memory_index, &device_,
-        false);
+    arena_requests.push_back({&device_only_image_heap_,
+                              clamp_to_budget(memory_index, device_image_size),
+                              memory_index, false, 0, false});
+
+    VkPhysicalDeviceProperties properties;
+    instance_->vkGetPhysicalDeviceProperties(device_.physical_device(),
+                                             &properties);
+    buffer_image_granularity_ = properties.limits.bufferImageGranularity;
+    sampler_cache_.set_max_objects(
+        properties.limits.maxSamplerAllocationCount);
+  }
+
+  for (const ArenaRequest& request : arena_requests) {
+    const ArenaRequest* r = &request;
+    bring_up_jobs_->Run([this, r]() {
+      *r->arena = containers::make_unique<VulkanArena>(
+          allocator_, allocator_, log_, r->size, r->memory_index, &device_,
+          r->map, r->device_mask, arena_strategy_, 0, r->device_address);
+    });
+  }
+  // The pipeline cache, and the arenas, are ready after this.
+  bring_up_jobs_->Wait();
+  bring_up_jobs_.reset();
+  if (use_debug_utils_) {
+    for (const NamedArena& arena : GetArenas()) {
+      arena.arena->set_debug_name(arena.name);
+    }
+  }
+
+  if (entry_data->headless()) {
+    // Without a swapchain, render to images of the same size and format that
+    // the swapchain would have had.
+    const size_t kNumHeadlessImages = 3;
+    VkImageCreateInfo image_create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        swapchain_.format(),                  // format
+        {
+            // extent
+            swapchain_.width(),   // width
+            swapchain_.height(),  // height
+            1,                    // depth
+        },
+        1,                      // mipLevels
+        1,                      // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,  // samples
+        VK_IMAGE_TILING_OPTIMAL,  // tiling
+        swapchain_.usage(),                   // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    for (size_t i = 0; i < kNumHeadlessImages; ++i) {
+      headless_images_.push_back(CreateAndBindImage(&image_create_info));
+      swapchain_images_.push_back(*headless_images_.back());
+    }
+  }
+  NameSwapchainImages();
+
+  // Keep the arenas from growing past the budget that is left now that they
+  // have been created.
+  PollMemoryBudget();
+}
+
+containers::unique_ptr<jobs::TaskGroup> VulkanApplication::StartBringUpJobs() {
+  // Since this is called by the constructor be careful not to
+  // use any data other than what has already been initialized.
+  // allocator_, entry_data_, job_system_, device_, pipeline_cache_
+  auto group =
+      containers::make_unique<jobs::TaskGroup>(allocator_, job_system_);
+  if (device_.is_valid()) {
+    // Reading the pipeline cache from disk, and creating it, only need the
+    // device, so that overlaps with creating the swapchain.
+    group->Run([this]() {
+      LoadDefaultPipelineCache(&device_, entry_data_, &pipeline_cache_);
+    });
   }
+  return group;
 }
 
 VkDevice VulkanApplication::SetupDevice(VkDevice device,
                                         bool create_async_compute_queue,
-                                        bool use_sparse_binding) {
+                                        bool use_sparse_binding,
+                                        bool create_transfer_queue) {
   if (device.is_valid()) {
     if (render_queue_index_ == present_queue_index_) {
       render_queue_concrete_ = containers::make_unique<VkQueue>(
@@ -391,10 +825,24 @@ VkDevice VulkanApplication::SetupDevice(VkDevice device,
       present_queue_ = present_queue_concrete_.get();
     }
     if (create_async_compute_queue && compute_queue_index_ != 0xFFFFFFFF) {
-      async_compute_queue_concrete_ = containers::make_unique<VkQueue>(
-          allocator_,
-          GetQueue(&device, compute_queue_index_,
-                   compute_queue_index_ == render_queue_index_ ? 1 : 0));
+      // The compute queues come after the render and present queues of
+      // their family.
+      uint32_t first_queue = 0;
+      if (compute_queue_index_ == render_queue_index_) {
+        ++first_queue;
+      }
+      if (compute_queue_index_ == present_queue_index_ &&
+          present_queue_index_ != render_queue_index_) {
+        ++first_queue;
+      }
+      for (uint32_t i = 0; i < num_async_compute_queues_; ++i) {
+        async_compute_queues_.push_back(containers::make_unique<VkQueue>(
+            allocator_,
+            GetQueue(&device, compute_queue_index_, first_queue + i)));
+      }
+      log_->LogInfo("### Got ", num_async_compute_queues_,
+                    " async compute queues from queue family ",
+                    compute_queue_index_);
     }
     if (use_sparse_binding && sparse_binding_queue_index_ != 0xFFFFFFFF) {
       log_->LogInfo("### Requesting sparse binding queue");
@@ -402,8 +850,9 @@ VkDevice VulkanApplication::SetupDevice(VkDevice device,
         sparse_binding_queue_ = render_queue_;
       } else if (sparse_binding_queue_index_ == present_queue_index_) {
         sparse_binding_queue_ = present_queue_;
-      } else if (sparse_binding_queue_index_ == compute_queue_index_) {
-        sparse_binding_queue_ = async_compute_queue_concrete_.get();
+      } else if (!async_compute_queues_.empty() &&
+                 sparse_binding_queue_index_ == compute_queue_index_) {
+        sparse_binding_queue_ = async_compute_queues_.front().get();
       } else {
         sparse_binding_queue_concrete_ = containers::make_unique<VkQueue>(
             allocator_, GetQueue(&device, sparse_binding_queue_index_, 0));
@@ -412,6 +861,12 @@ VkDevice VulkanApplication::SetupDevice(VkDevice device,
       log_->LogInfo("### Got sparse binding queue: ",
                     sparse_binding_queue_->get_raw_object());
     }
+    if (create_transfer_queue && transfer_queue_index_ != 0xFFFFFFFF) {
+      transfer_queue_concrete_ = containers::make_unique<VkQueue>(
+          allocator_, GetQueue(&device, transfer_queue_index_, 0));
+      log_->LogInfo("### Got transfer queue from queue family ",
+                    transfer_queue_index_);
+    }
   }
   return std::move(device);
 }
@@ -420,6 +875,9 @@ VkDevice VulkanApplication::CreateDeviceGroup(
     const std::initializer_list<const char*> extensions,
     const VkPhysicalDeviceFeatures& features, bool create_async_compute_queue,
     bool use_sparse_binding, void* device_next) {
+  STARTUP_PHASE("CreateDevice");
+  // Device groups only get a single async compute queue.
+  num_async_compute_queues_ = 1;
   vulkan::VkDevice device(vulkan::CreateDeviceGroupForSwapchain(
       allocator_, &instance_, &surface_, &render_queue_index_,
       &present_queue_index_, extensions, features,
@@ -434,11 +892,13 @@ VkDevice VulkanApplication::CreateDeviceGroup(
 VkDevice VulkanApplication::CreateDevice(
     const std::initializer_list<const char*> extensions,
     const VkPhysicalDeviceFeatures& features, bool create_async_compute_queue,
-    bool use_sparse_binding, bool use_host_query_reset, void* device_next) {
+    bool use_sparse_binding, bool use_host_query_reset, void* device_next,
+    bool create_transfer_queue) {
   // Since this is called by the constructor be careful not to
   // use any data other than what has already been initialized.
   // allocator_, log_, entry_data_, library_wrapper_, instance_,
   // surface_
+  STARTUP_PHASE("CreateDevice");
 
   vulkan::VkDevice device(vulkan::CreateDeviceForSwapchain(
       allocator_, &instance_, &surface_, &render_queue_index_,
@@ -446,16 +906,182 @@ VkDevice VulkanApplication::CreateDevice(
       entry_data_->prefer_separate_present(),
       create_async_compute_queue ? &compute_queue_index_ : nullptr,
       use_sparse_binding ? &sparse_binding_queue_index_ : nullptr,
-      use_host_query_reset, device_next));
+      use_host_query_reset, device_next,
+      create_transfer_queue ? &transfer_queue_index_ : nullptr,
+      entry_data_->device_selection(),
+      create_async_compute_queue ? &num_async_compute_queues_ : nullptr));
 
   return SetupDevice(std::move(device), create_async_compute_queue,
-                     use_sparse_binding);
+                     use_sparse_binding, create_transfer_queue);
+}
+
+VkCommandPool& VulkanApplication::GetQueueCommandPool(VkQueue& queue) {
+  std::lock_guard<std::mutex> lock(queue_command_pools_mutex_);
+  auto it = queue_command_pools_.find(queue.get_raw_object());
+  if (it == queue_command_pools_.end()) {
+    it = queue_command_pools_
+             .emplace(queue.get_raw_object(),
+                      CreateDefaultCommandPool(
+                          allocator_, device_, use_protected_memory_,
+                          queue.index(), host_allocation_callbacks()))
+             .first;
+  }
+  return it->second;
+}
+
+VulkanApplication::~VulkanApplication() {
+  // Frames may still be using the objects that were deleted last.
+  if (deferred_deletion_queue_.num_pending() > 0 && device_.is_valid()) {
+    device_->vkDeviceWaitIdle(device_);
+    deferred_deletion_queue_.Flush();
+  }
+  // The staging memory of the uploads that are still in flight can not be
+  // released before the GPU is done with it.
+  for (auto& upload : pending_uploads_) {
+    ::VkFence fence = upload->fence;
+    device_->vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+  pending_uploads_.clear();
+  // Readbacks whose fence never signaled can not be completed.
+  pending_readbacks_.clear();
+  if (entry_data_->write_memory_stats()) {
+    WriteMemoryStats(entry_data_->write_memory_stats());
+  }
+  if (pipeline_creation_stats_) {
+    WaitForPipelines();
+    pipeline_creation_stats_->LogSummary(log_);
+  }
+  if (shader_statistics_) {
+    WaitForPipelines();
+    shader_statistics_->Write(entry_data_->shader_stats(), log_);
+  }
+  if (entry_data_->driver_allocation_stats()) {
+    // Do not modify this line, scripts may look for it in the output.
+    host_allocation_callbacks_->LogStatistics("DRIVER_ALLOCATIONS:", log_);
+  }
+  // Pipelines that were created after initialization only make it into the
+  // automatic cache, which is saved on exit.
+  if (entry_data_->pipeline_cache_prefix() && device_.is_valid()) {
+    MergePipelineCaches();
+    WritePipelineCache(
+        &device_, &pipeline_cache_,
+        GetPipelineCachePath(&device_, entry_data_->pipeline_cache_prefix())
+            .c_str());
+    pipeline_corpus_->Write(
+        GetPipelineCorpusPath(entry_data_->pipeline_cache_prefix()).c_str());
+  }
 }
 
 void VulkanApplication::InitializationComplete() {
+  WaitForPipelines();
   if (entry_data_->write_pipeline_cache()) {
+    MergePipelineCaches();
     WritePipelineCache(&device_, &pipeline_cache_, entry_data_->write_pipeline_cache());
   }
+  // The first frames render while the pipelines of the last run are created
+  // into the cache, so that the ones they create late are cache hits.
+  if (pipeline_corpus_) {
+    pipeline_corpus_->StartPrewarm(pipeline_cache_);
+  }
+}
+
+void VulkanApplication::CreateWorkerPipelineCaches() {
+  if (!device_.is_valid()) {
+    return;
+  }
+  // Every worker starts out with what was loaded from disk, the caches are
+  // only merged back when they are written.
+  size_t size = 0;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             device_->vkGetPipelineCacheData(device_, pipeline_cache_, &size,
+                                             nullptr));
+  containers::vector<char> data(allocator_);
+  data.resize(size);
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             device_->vkGetPipelineCacheData(device_, pipeline_cache_, &size,
+                                             data.data()));
+  VkPipelineCacheCreateInfo create_info{
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,  // sType
+      nullptr,                                       // pNext
+      0,                                             // flags
+      size,                                          // initialDataSize
+      data.data()                                    // pInitialData
+  };
+  for (size_t i = 0; i < pipeline_compiler_->num_threads(); ++i) {
+    ::VkPipelineCache cache;
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_->vkCreatePipelineCache(device_, &create_info, nullptr,
+                                              &cache));
+    worker_pipeline_caches_.push_back(
+        containers::make_unique<VkPipelineCache>(allocator_, cache, nullptr,
+                                                 &device_));
+  }
+}
+
+::VkPipelineCache VulkanApplication::thread_pipeline_cache() {
+  if (pipeline_compiler_) {
+    const size_t worker = pipeline_compiler_->current_worker();
+    if (worker < worker_pipeline_caches_.size()) {
+      return *worker_pipeline_caches_[worker];
+    }
+  }
+  return pipeline_cache_;
+}
+
+void VulkanApplication::MergePipelineCaches() {
+  WaitForPipelines();
+  // The destination of vkMergePipelineCaches is externally synchronized.
+  if (pipeline_corpus_) {
+    pipeline_corpus_->StopPrewarm();
+  }
+  if (worker_pipeline_caches_.empty()) {
+    return;
+  }
+  containers::vector<::VkPipelineCache> caches(allocator_);
+  for (auto& cache : worker_pipeline_caches_) {
+    caches.push_back(*cache);
+  }
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             device_->vkMergePipelineCaches(
+                 device_, pipeline_cache_,
+                 static_cast<uint32_t>(caches.size()), caches.data()));
+}
+
+bool VulkanApplication::RecreateSwapchain() {
+  if (headless()) {
+    return false;
+  }
+  VkSurfaceCapabilitiesKHR surface_caps;
+  LOG_ASSERT(==, log_,
+             instance_->vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+                 device_.physical_device(), surface_, &surface_caps),
+             VK_SUCCESS);
+  if (surface_caps.currentExtent.width == 0 ||
+      surface_caps.currentExtent.height == 0) {
+    return false;
+  }
+  // The old swapchain is only destroyed once the new one has retired it.
+  swapchain_ = CreateDefaultSwapchain(
+      &instance_, &device_, &surface_, allocator_, render_queue_index_,
+      present_queue_index_, entry_data_, swapchain_color_space_,
+      use_shared_presentation_, swapchain_flags_, use_10bit_hdr_,
+      swapchain_extensions_, swapchain_, requested_swapchain_images_,
+      requested_present_mode_, swapchain_sharing_mode_);
+  vulkan::LoadContainer(log_, device_->vkGetSwapchainImagesKHR,
+                        &swapchain_images_, device_, swapchain_);
+  NameSwapchainImages();
+  return true;
+}
+
+void VulkanApplication::NameSwapchainImages() {
+  if (!use_debug_utils_) {
+    return;
+  }
+  for (size_t i = 0; i < swapchain_images_.size(); ++i) {
+    const std::string name = "swapchain_image_" + std::to_string(i);
+    SetObjectName(VK_OBJECT_TYPE_IMAGE, uint64_t(swapchain_images_[i]),
+                  name.c_str());
+  }
 }
 
 containers::unique_ptr<VulkanApplication::Image>
@@ -465,15 +1091,61 @@ VulkanApplication::CreateAndBindImage(const VkImageCreateInfo* create_info,
   LOG_ASSERT(==, log_,
              device_->vkCreateImage(device_, create_info, nullptr, &image),
              VK_SUCCESS);
-  VkMemoryRequirements requirements;
-  device_->vkGetImageMemoryRequirements(device_, image, &requirements);
-
   ::VkDeviceMemory memory;
   ::VkDeviceSize offset;
 
-  AllocationToken* token = device_only_image_heap_->AllocateMemory(
-      requirements.size, requirements.alignment, &memory, &offset, nullptr);
+  VulkanArena* heap;
+  AllocationToken* token =
+      AllocateImageMemory(image, create_info, &heap, &memory, &offset);
+  return BindImage(image, heap, token, memory, offset, create_info,
+                   device_indices);
+}
+
+containers::unique_ptr<VulkanArena> VulkanApplication::CreateImageArena(
+    ::VkDeviceSize block_size, const char* debug_name) {
+  auto arena = containers::make_unique<VulkanArena>(
+      allocator_, allocator_, log_, block_size,
+      device_only_image_heap_->memory_type_index(), &device_, false, 0,
+      arena_strategy_);
+  if (debug_name && use_debug_utils_) {
+    arena->set_debug_name(debug_name);
+  }
+  return arena;
+}
+
+containers::unique_ptr<VulkanApplication::Image>
+VulkanApplication::CreateAndBindImage(VulkanArena* arena,
+                                      const VkImageCreateInfo* create_info,
+                                      const uint32_t* device_indices) {
+  ::VkImage image;
+  LOG_ASSERT(==, log_,
+             device_->vkCreateImage(device_, create_info, nullptr, &image),
+             VK_SUCCESS);
+  VkMemoryRequirements requirements;
+  bool prefers_dedicated;
+  GetImageMemoryRequirements(image, &requirements, &prefers_dedicated);
+  // The arena only has one memory type, the image has to be able to live in
+  // it.
+  LOG_ASSERT(!=, log_, 0u,
+             requirements.memoryTypeBits & (1u << arena->memory_type_index()));
+  ::VkDeviceMemory memory;
+  ::VkDeviceSize offset;
+  AllocationToken* token =
+      prefers_dedicated
+          ? arena->AllocateDedicatedMemory(
+                requirements.size, image,
+                static_cast<::VkBuffer>(VK_NULL_HANDLE), &memory, &offset,
+                nullptr)
+          : arena->AllocateMemory(requirements.size, requirements.alignment,
+                                  &memory, &offset, nullptr);
+  return BindImage(image, arena, token, memory, offset, create_info,
+                   device_indices);
+}
 
+containers::unique_ptr<VulkanApplication::Image> VulkanApplication::BindImage(
+    ::VkImage image, VulkanArena* heap, AllocationToken* token,
+    ::VkDeviceMemory memory, ::VkDeviceSize offset,
+    const VkImageCreateInfo* create_info, const uint32_t* device_indices) {
   if (device_.num_devices() > 1) {
     uint32_t indices[VK_MAX_DEVICE_GROUP_SIZE];
     // If device_indices is set, then we use that.
@@ -500,12 +1172,283 @@ VulkanApplication::CreateAndBindImage(const VkImageCreateInfo* create_info,
 
   // We have to do it this way because Image is private and friended,
   // so we cannot go through make_unique.
-  Image* img = new (allocator_->malloc(sizeof(Image)))
-      Image(device_only_image_heap_.get(), token,
-            VkImage(image, nullptr, &device_), create_info->format);
+  Image* img = new (object_pool_.malloc(sizeof(Image)))
+      Image(heap, token, VkImage(image, nullptr, &device_),
+            create_info->format, create_info);
 
   return containers::unique_ptr<Image>(
-      img, containers::UniqueDeleter(allocator_, sizeof(Image)));
+      img, containers::UniqueDeleter(&object_pool_, sizeof(Image)));
+}
+
+containers::vector<VulkanApplication::NamedArena>
+VulkanApplication::GetArenas() {
+  containers::vector<NamedArena> arenas(allocator_);
+  for (size_t i = 0; i < host_accessible_heap_.size(); ++i) {
+    arenas.push_back({"host", static_cast<uint32_t>(i),
+                      host_accessible_heap_[i].get()});
+  }
+  for (size_t i = 0; i < coherent_heap_.size(); ++i) {
+    arenas.push_back(
+        {"coherent", static_cast<uint32_t>(i), coherent_heap_[i].get()});
+  }
+  if (device_only_buffer_heap_) {
+    arenas.push_back({"device_buffer", 0, device_only_buffer_heap_.get()});
+  }
+  if (device_only_image_heap_) {
+    arenas.push_back({"device_image", 0, device_only_image_heap_.get()});
+  }
+  {
+    std::lock_guard<std::mutex> lock(lazy_heaps_mutex_);
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
+      if (device_only_linear_image_heaps_[i]) {
+        arenas.push_back({"device_linear_image", 0,
+                          device_only_linear_image_heaps_[i].get()});
+      }
+    }
+    if (device_transient_image_heap_) {
+      arenas.push_back({"device_transient_image", 0,
+                        device_transient_image_heap_.get()});
+    }
+    if (readback_heap_) {
+      arenas.push_back({"readback", 0, readback_heap_.get()});
+    }
+    if (upload_heap_) {
+      arenas.push_back({"upload", 0, upload_heap_.get()});
+    }
+  }
+  for (size_t i = 0; i < device_peer_memory_heaps_.size(); ++i) {
+    arenas.push_back({"peer", static_cast<uint32_t>(i),
+                      device_peer_memory_heaps_[i].get()});
+  }
+  std::lock_guard<std::mutex> lock(shared_buffer_arenas_mutex_);
+  for (auto& shared : shared_buffer_arenas_) {
+    arenas.push_back({"shared", 0, shared.second.arena.get()});
+  }
+  return arenas;
+}
+
+containers::vector<VulkanApplication::HeapStats>
+VulkanApplication::GetMemoryStats() {
+  containers::vector<HeapStats> stats(allocator_);
+  for (const NamedArena& arena : GetArenas()) {
+    stats.push_back({arena.name, arena.device_index, arena.arena->GetStats()});
+  }
+  return stats;
+}
+
+void VulkanApplication::WriteMemoryStats(const char* location) {
+  std::ofstream out_file(location);
+  out_file << "{\n  \"heaps\": [";
+  bool first = true;
+  for (const HeapStats& heap : GetMemoryStats()) {
+    const ArenaStats& s = heap.stats;
+    out_file << (first ? "\n" : ",\n") << "    {\"heap\": \"" << heap.heap
+             << "\", \"device_index\": " << heap.device_index
+             << ", \"total_bytes\": " << s.total_bytes
+             << ", \"used_bytes\": " << s.used_bytes
+             << ", \"free_bytes\": " << s.free_bytes
+             << ", \"largest_free_block\": " << s.largest_free_block
+             << ", \"num_free_blocks\": " << s.num_free_blocks
+             << ", \"padding_bytes\": " << s.padding_bytes
+             << ", \"dedicated_bytes\": " << s.dedicated_bytes
+             << ", \"high_water_mark\": " << s.high_water_mark
+             << ", \"num_allocations\": " << s.num_allocations
+             << ", \"num_frees\": " << s.num_frees
+             << ", \"num_blocks\": " << s.num_blocks
+             << ", \"num_pooled_tokens\": " << s.num_pooled_tokens << "}";
+    first = false;
+  }
+  out_file << "\n  ]\n}\n";
+  LOG_ASSERT(==, log_, false, out_file.bad());
+  log_->LogInfo("Wrote memory stats to \"", location, "\"");
+}
+
+bool VulkanApplication::GetMemoryBudget(
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT* budget) {
+  if (!use_memory_budget_) {
+    return false;
+  }
+  *budget = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+             nullptr};
+  VkPhysicalDeviceMemoryProperties2 memory_properties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+      budget  // pNext
+  };
+  instance_->vkGetPhysicalDeviceMemoryProperties2(device_.physical_device(),
+                                                  &memory_properties);
+  return true;
+}
+
+void VulkanApplication::PollMemoryBudget() {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget;
+  if (!GetMemoryBudget(&budget)) {
+    return;
+  }
+  containers::vector<NamedArena> arenas = GetArenas();
+  // The arenas that share a heap split what is left of its budget evenly.
+  uint32_t arenas_per_heap[VK_MAX_MEMORY_HEAPS] = {};
+  for (const NamedArena& named_arena : arenas) {
+    arenas_per_heap[named_arena.arena->heap_index()]++;
+  }
+  for (const NamedArena& named_arena : arenas) {
+    VulkanArena* arena = named_arena.arena;
+    const uint32_t heap = arena->heap_index();
+    const ::VkDeviceSize headroom =
+        budget.heapBudget[heap] > budget.heapUsage[heap]
+            ? budget.heapBudget[heap] - budget.heapUsage[heap]
+            : 0;
+    arena->set_growth_limit(arena->total_size() +
+                            headroom / arenas_per_heap[heap]);
+  }
+}
+
+void VulkanApplication::GetImageMemoryRequirements(
+    ::VkImage image, VkMemoryRequirements* requirements,
+    bool* prefers_dedicated) {
+  if (!use_dedicated_allocations_) {
+    device_->vkGetImageMemoryRequirements(device_, image, requirements);
+    *prefers_dedicated = false;
+    return;
+  }
+  VkMemoryDedicatedRequirements dedicated_requirements{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,  // sType
+      nullptr,                                          // pNext
+      VK_FALSE,  // prefersDedicatedAllocation
+      VK_FALSE,  // requiresDedicatedAllocation
+  };
+  VkMemoryRequirements2 requirements2{
+      VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicated_requirements, {}};
+  VkImageMemoryRequirementsInfo2 requirements_info{
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR, nullptr, image};
+  device_->vkGetImageMemoryRequirements2KHR(device_, &requirements_info,
+                                            &requirements2);
+  *requirements = requirements2.memoryRequirements;
+  *prefers_dedicated =
+      dedicated_requirements.prefersDedicatedAllocation == VK_TRUE ||
+      dedicated_requirements.requiresDedicatedAllocation == VK_TRUE;
+}
+
+namespace {
+// The size of each block of the arena for linear images, these are rare.
+const ::VkDeviceSize kLinearImageBlockSize = 1024 * 1024;
+// The size of each block of the arena for transient attachments. Lazily
+// allocated memory is only committed once it is actually used, so this can
+// comfortably hold a few full-screen attachments.
+const ::VkDeviceSize kTransientImageBlockSize = 16 * 1024 * 1024;
+// The number of resources of each kind that the bindless table holds.
+const uint32_t kBindlessImages = 4096;
+const uint32_t kBindlessBuffers = 4096;
+const uint32_t kBindlessSamplers = 64;
+
+// Sets |memory_index| to the first of |memory_type_bits| that is lazily
+// allocated, and returns true. Returns false if there is none.
+bool GetLazilyAllocatedMemoryIndex(VkDevice* device, uint32_t memory_type_bits,
+                                   uint32_t* memory_index) {
+  const VkPhysicalDeviceMemoryProperties& properties =
+      device->physical_device_memory_properties();
+  for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+    if ((memory_type_bits & (1u << i)) &&
+        (properties.memoryTypes[i].propertyFlags &
+         VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+      *memory_index = i;
+      return true;
+    }
+  }
+  return false;
+}
+}  // anonymous namespace
+
+BindlessTable* VulkanApplication::bindless_table() {
+  std::lock_guard<std::mutex> lock(bindless_table_mutex_);
+  if (!bindless_table_) {
+    LOG_ASSERT(==, log_, true, use_descriptor_indexing_);
+    bindless_table_ = containers::make_unique<BindlessTable>(
+        allocator_, allocator_, &device_, kBindlessImages, kBindlessBuffers,
+        kBindlessSamplers);
+  }
+  return bindless_table_.get();
+}
+
+VulkanArena* VulkanApplication::GetTransientImageArena(
+    uint32_t memory_type_bits) {
+  std::lock_guard<std::mutex> lock(lazy_heaps_mutex_);
+  if (!device_transient_image_heap_) {
+    uint32_t memory_index;
+    if (!GetLazilyAllocatedMemoryIndex(&device_, memory_type_bits,
+                                       &memory_index)) {
+      return nullptr;
+    }
+    device_transient_image_heap_ = containers::make_unique<VulkanArena>(
+        allocator_, allocator_, log_, kTransientImageBlockSize, memory_index,
+        &device_, false, 0, arena_strategy_);
+    if (use_debug_utils_) {
+      device_transient_image_heap_->set_debug_name("device_transient_image");
+    }
+  }
+  if ((memory_type_bits &
+       (1u << device_transient_image_heap_->memory_type_index())) == 0) {
+    return nullptr;
+  }
+  return device_transient_image_heap_.get();
+}
+
+VulkanArena* VulkanApplication::GetLinearImageArena(
+    uint32_t memory_type_bits) {
+  const uint32_t memory_index = GetMemoryIndex(
+      &device_, log_, memory_type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  std::lock_guard<std::mutex> lock(lazy_heaps_mutex_);
+  // Linear images may need different memory types, e.g. for different
+  // formats, so every memory type gets an arena of its own.
+  containers::unique_ptr<VulkanArena>& heap =
+      device_only_linear_image_heaps_[memory_index];
+  if (!heap) {
+    heap = containers::make_unique<VulkanArena>(
+        allocator_, allocator_, log_, kLinearImageBlockSize, memory_index,
+        &device_, false, 0, arena_strategy_);
+    if (use_debug_utils_) {
+      heap->set_debug_name("device_linear_image");
+    }
+  }
+  return heap.get();
+}
+
+AllocationToken* VulkanApplication::AllocateImageMemory(
+    ::VkImage image, const VkImageCreateInfo* create_info, VulkanArena** heap,
+    ::VkDeviceMemory* memory, ::VkDeviceSize* offset) {
+  VkMemoryRequirements requirements;
+  bool prefers_dedicated;
+  GetImageMemoryRequirements(image, &requirements, &prefers_dedicated);
+  // Linear and optimal images that are closer than bufferImageGranularity
+  // alias each other. Rather than padding every image to the granularity,
+  // linear images get memory of their own, so optimal images stay packed.
+  *heap = create_info->tiling == VK_IMAGE_TILING_LINEAR &&
+                  buffer_image_granularity_ > 1
+              ? GetLinearImageArena(requirements.memoryTypeBits)
+              : device_only_image_heap_.get();
+  if (create_info->usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+    // Transient attachments never have to leave tile memory on tiled GPUs,
+    // so back them with lazily allocated memory if there is any.
+    VulkanArena* transient_heap =
+        GetTransientImageArena(requirements.memoryTypeBits);
+    if (transient_heap) {
+      *heap = transient_heap;
+    }
+  }
+  if (prefers_dedicated) {
+    return (*heap)->AllocateDedicatedMemory(
+        requirements.size, image, static_cast<::VkBuffer>(VK_NULL_HANDLE),
+        memory, offset, nullptr);
+  }
+  AllocationToken* token = (*heap)->TryAllocateMemory(
+      requirements.size, requirements.alignment, memory, offset, nullptr);
+  // Make room by evicting images that have not been used in a while.
+  while (!token && EvictLeastRecentlyUsedImage(*heap)) {
+    token = (*heap)->TryAllocateMemory(requirements.size,
+                                       requirements.alignment, memory, offset,
+                                       nullptr);
+  }
+  LOG_ASSERT(!=, log_, static_cast<AllocationToken*>(nullptr), token);
+  return token;
 }
 
 containers::unique_ptr<VulkanApplication::SparseImage>
@@ -562,12 +1505,35 @@ VulkanApplication::CreateAndBindSparseImage(
 
   // We have to do it this way because Image is private and friended,
   // so we cannot go through make_unique.
-  SparseImage* img = new (allocator_->malloc(sizeof(SparseImage)))
+  SparseImage* img = new (object_pool_.malloc(sizeof(SparseImage)))
       SparseImage(device_only_image_heap_.get(), std::move(tokens),
                   VkImage(image, nullptr, &device_), create_info->format);
 
   return containers::unique_ptr<SparseImage>(
-      img, containers::UniqueDeleter(allocator_, sizeof(SparseImage)));
+      img, containers::UniqueDeleter(&object_pool_, sizeof(SparseImage)));
+}
+
+containers::unique_ptr<VulkanApplication::StreamingSparseImage>
+VulkanApplication::CreateStreamingSparseImage(
+    const VkImageCreateInfo* create_info, ::VkDeviceSize memory_budget,
+    uint32_t retire_delay) {
+  LOG_ASSERT(==, log_, sparse_binding_queue_ != nullptr, true);
+  VkImageCreateInfo info = *create_info;
+  info.flags |=
+      VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+  ::VkImage image;
+  LOG_ASSERT(==, log_, device_->vkCreateImage(device_, &info, nullptr, &image),
+             VK_SUCCESS);
+
+  // We have to do it this way because StreamingSparseImage is private and
+  // friended, so we cannot go through make_unique.
+  StreamingSparseImage* img =
+      new (object_pool_.malloc(sizeof(StreamingSparseImage)))
+          StreamingSparseImage(this, VkImage(image, nullptr, &device_),
+                               info.format, info, memory_budget, retire_delay);
+  return containers::unique_ptr<StreamingSparseImage>(
+      img,
+      containers::UniqueDeleter(&object_pool_, sizeof(StreamingSparseImage)));
 }
 
 containers::unique_ptr<VulkanApplication::Image>
@@ -579,6 +1545,7 @@ VulkanApplication::CreateAndBindMultiPlanarImage(
              VK_SUCCESS);
 
   AllocationToken* token;
+  VulkanArena* heap = device_only_image_heap_.get();
   if (create_info->flags & VK_IMAGE_CREATE_DISJOINT_BIT) {
     const unsigned maxPlaneCount = 3;
     unsigned planeCount = 0;
@@ -630,27 +1597,18 @@ VulkanApplication::CreateAndBindMultiPlanarImage(
     ::VkDeviceMemory memory;
     ::VkDeviceSize offset;
 
-    VkMemoryRequirements2 requirements{
-        VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, nullptr, {}};
-    VkImageMemoryRequirementsInfo2 requirementsInfo{
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR, nullptr, image};
-    device_->vkGetImageMemoryRequirements2KHR(device_, &requirementsInfo,
-                                              &requirements);
-
-    token = device_only_image_heap_->AllocateMemory(
-        requirements.memoryRequirements.size,
-        requirements.memoryRequirements.alignment, &memory, &offset, nullptr);
+    token = AllocateImageMemory(image, create_info, &heap, &memory, &offset);
     device_->vkBindImageMemory(device_, image, memory, offset);
   }
 
   // We have to do it this way because Image is private and friended,
   // so we cannot go through make_unique.
-  Image* img = new (allocator_->malloc(sizeof(Image)))
-      Image(device_only_image_heap_.get(), token,
-            VkImage(image, nullptr, &device_), create_info->format);
+  Image* img = new (object_pool_.malloc(sizeof(Image)))
+      Image(heap, token, VkImage(image, nullptr, &device_),
+            create_info->format);
 
   return containers::unique_ptr<Image>(
-      img, containers::UniqueDeleter(allocator_, sizeof(Image)));
+      img, containers::UniqueDeleter(&object_pool_, sizeof(Image)));
 }
 
 containers::unique_ptr<VkImageView> VulkanApplication::CreateImageView(
@@ -673,7 +1631,7 @@ containers::unique_ptr<VkImageView> VulkanApplication::CreateImageView(
       device_->vkCreateImageView(device_, &create_info, nullptr, &raw_view),
       VK_SUCCESS);
   return containers::make_unique<vulkan::VkImageView>(
-      allocator_, VkImageView(raw_view, nullptr, &device_));
+      &object_pool_, VkImageView(raw_view, nullptr, &device_));
 }
 
 containers::unique_ptr<VulkanApplication::Buffer>
@@ -715,12 +1673,12 @@ VulkanApplication::CreateAndBindBuffer(VulkanArena* heap,
     device_->vkBindBufferMemory(device_, buffer, memory, offset);
   }
 
-  Buffer* buff = new (allocator_->malloc(sizeof(Buffer))) Buffer(
+  Buffer* buff = new (object_pool_.malloc(sizeof(Buffer))) Buffer(
       heap, token, VkBuffer(buffer, nullptr, &device_), base_address, device_,
       memory, offset, requirements.size, &(device_->vkFlushMappedMemoryRanges),
-      &(device_->vkInvalidateMappedMemoryRanges));
+      &(device_->vkInvalidateMappedMemoryRanges), create_info);
   return containers::unique_ptr<Buffer>(
-      buff, containers::UniqueDeleter(allocator_, sizeof(Buffer)));
+      buff, containers::UniqueDeleter(&object_pool_, sizeof(Buffer)));
 }
 
 containers::unique_ptr<VulkanApplication::Buffer>
@@ -760,17 +1718,87 @@ VulkanApplication::CreateAndBindCoherentBuffer(
                              create_info, device_indices);
 }
 
-containers::unique_ptr<VulkanApplication::Buffer>
-VulkanApplication::CreateAndBindDefaultExclusiveHostBuffer(
-    VkDeviceSize size, VkBufferUsageFlags usages,
-    const uint32_t* device_indices) {
-  VkBufferCreateInfo create_info{
-      /* sType = */ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      /* pNext = */ nullptr,
-      /* flags = */ 0,
-      /* size = */ size,
-      /* usage = */ usages,
-      /* sharingMode = */ VK_SHARING_MODE_EXCLUSIVE,
+namespace {
+// The size of each block of the readback and upload arenas.
+const ::VkDeviceSize kHostAccessBlockSize = 1024 * 1024;
+}  // anonymous namespace
+
+VulkanArena* VulkanApplication::GetHostAccessArena(
+    HostAccessPattern pattern, const VkBufferCreateInfo* create_info) {
+  std::lock_guard<std::mutex> lock(lazy_heaps_mutex_);
+  containers::unique_ptr<VulkanArena>& heap =
+      pattern == kHostReadback ? readback_heap_ : upload_heap_;
+  if (!heap) {
+    // Create a tiny buffer so that we can determine what memory flags are
+    // required.
+    VkBufferCreateInfo probe_create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        1,                                     // size
+        create_info->usage,                    // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr,                               // pQueueFamilyIndices
+    };
+    ::VkBuffer buffer;
+    LOG_ASSERT(
+        ==, log_,
+        device_->vkCreateBuffer(device_, &probe_create_info, nullptr, &buffer),
+        VK_SUCCESS);
+    VkMemoryRequirements requirements;
+    device_->vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+    device_->vkDestroyBuffer(device_, buffer, nullptr);
+
+    // Host reads from write-combined memory are very slow, so readbacks want
+    // cached memory. Data that the host writes every frame is best placed
+    // directly in device-local memory, if the host can see any.
+    uint32_t memory_index = GetPreferredMemoryIndex(
+        &device_, log_, requirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        pattern == kHostReadback ? VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+                                 : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    heap = containers::make_unique<VulkanArena>(
+        allocator_, allocator_, log_, kHostAccessBlockSize, memory_index,
+        &device_, true, 0, arena_strategy_);
+    if (use_debug_utils_) {
+      heap->set_debug_name(pattern == kHostReadback ? "readback" : "upload");
+    }
+  }
+  return heap.get();
+}
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindReadbackBuffer(
+    const VkBufferCreateInfo* create_info, const uint32_t* device_indices) {
+  if (device_.num_devices() > 1) {
+    return CreateAndBindHostBuffer(create_info, device_indices);
+  }
+  return CreateAndBindBuffer(GetHostAccessArena(kHostReadback, create_info),
+                             create_info, device_indices);
+}
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindUploadBuffer(
+    const VkBufferCreateInfo* create_info, const uint32_t* device_indices) {
+  if (device_.num_devices() > 1) {
+    return CreateAndBindHostBuffer(create_info, device_indices);
+  }
+  return CreateAndBindBuffer(GetHostAccessArena(kHostUpload, create_info),
+                             create_info, device_indices);
+}
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindDefaultExclusiveHostBuffer(
+    VkDeviceSize size, VkBufferUsageFlags usages,
+    const uint32_t* device_indices) {
+  VkBufferCreateInfo create_info{
+      /* sType = */ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      /* pNext = */ nullptr,
+      /* flags = */ 0,
+      /* size = */ size,
+      /* usage = */ usages,
+      /* sharingMode = */ VK_SHARING_MODE_EXCLUSIVE,
       /* queueFamilyIndexCount = */ 0,
       /* pQueueFamilyIndices = */ nullptr,
   };
@@ -831,6 +1859,141 @@ VulkanApplication::CreateAndBindDefaultExclusiveDeviceBuffer(
   return CreateAndBindDeviceBuffer(&create_info, device_indices);
 }
 
+namespace {
+// Buffers that are larger than this always get a ::VkBuffer of their own.
+const ::VkDeviceSize kMaxSharedBufferSize = 64 * 1024;
+// The size of each block of memory, and so of each buffer, that small
+// buffers share.
+const ::VkDeviceSize kSharedBufferBlockSize = 1024 * 1024;
+}  // anonymous namespace
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindSharedBuffer(SharedBufferHeap heap,
+                                             VkDeviceSize size,
+                                             VkBufferUsageFlags usages) {
+  if (size > kMaxSharedBufferSize || device_.num_devices() > 1) {
+    switch (heap) {
+      case kSharedBufferHost:
+        return CreateAndBindDefaultExclusiveHostBuffer(size, usages);
+      case kSharedBufferCoherent:
+        return CreateAndBindDefaultExclusiveCoherentBuffer(size, usages);
+      case kSharedBufferDevice:
+        break;
+    }
+    return CreateAndBindDefaultExclusiveDeviceBuffer(size, usages);
+  }
+
+  SharedBufferArena* shared = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(shared_buffer_arenas_mutex_);
+    const uint64_t key = (static_cast<uint64_t>(heap) << 32) | usages;
+    auto it = shared_buffer_arenas_.find(key);
+    if (it == shared_buffer_arenas_.end()) {
+      const bool host_mapped = heap != kSharedBufferDevice;
+      const VkMemoryPropertyFlags property_flags[3] = {
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+      // Create a tiny buffer so that we can determine what memory flags are
+      // required for this usage.
+      VkBufferCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // flags
+          1,                                     // size
+          usages,                                // usage
+          VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+          0,                                     // queueFamilyIndexCount
+          nullptr,                               // pQueueFamilyIndices
+      };
+      ::VkBuffer buffer;
+      LOG_ASSERT(
+          ==, log_,
+          device_->vkCreateBuffer(device_, &create_info, nullptr, &buffer),
+          VK_SUCCESS);
+      VkMemoryRequirements requirements;
+      device_->vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+      device_->vkDestroyBuffer(device_, buffer, nullptr);
+      uint32_t memory_index = GetMemoryIndex(
+          &device_, log_, requirements.memoryTypeBits, property_flags[heap]);
+
+      // Every range has to be usable at its offset for every usage.
+      VkPhysicalDeviceProperties properties;
+      instance_->vkGetPhysicalDeviceProperties(device_.physical_device(),
+                                               &properties);
+      const VkPhysicalDeviceLimits& limits = properties.limits;
+      ::VkDeviceSize alignment = requirements.alignment;
+      if (usages & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        alignment =
+            std::max(alignment, limits.minUniformBufferOffsetAlignment);
+      }
+      if (usages & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        alignment =
+            std::max(alignment, limits.minStorageBufferOffsetAlignment);
+      }
+      if (usages & (VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT |
+                    VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT)) {
+        alignment = std::max(alignment, limits.minTexelBufferOffsetAlignment);
+      }
+      if (host_mapped) {
+        // Keep every range flushable on its own.
+        alignment = std::max(alignment, limits.nonCoherentAtomSize);
+      }
+
+      it = shared_buffer_arenas_
+               .emplace(key,
+                        SharedBufferArena{
+                            containers::make_unique<VulkanArena>(
+                                allocator_, allocator_, log_,
+                                kSharedBufferBlockSize, memory_index, &device_,
+                                host_mapped, 0, arena_strategy_, usages),
+                            alignment})
+               .first;
+      if (use_debug_utils_) {
+        it->second.arena->set_debug_name("shared");
+      }
+    }
+    // Elements of an unordered_map never move, so this stays valid after the
+    // lock is released.
+    shared = &it->second;
+  }
+
+  const ::VkDeviceSize aligned_size =
+      (size + shared->alignment - 1) & ~(shared->alignment - 1);
+  ::VkDeviceMemory memory;
+  ::VkDeviceSize offset;
+  char* base_address;
+  AllocationToken* token = shared->arena->AllocateMemory(
+      aligned_size, shared->alignment, &memory, &offset, &base_address);
+
+  Buffer* buff = new (object_pool_.malloc(sizeof(Buffer))) Buffer(
+      shared->arena.get(), token, VkBuffer(VK_NULL_HANDLE, nullptr, &device_),
+      base_address, device_, memory, offset, aligned_size,
+      &(device_->vkFlushMappedMemoryRanges),
+      &(device_->vkInvalidateMappedMemoryRanges), nullptr,
+      shared->arena->block_buffer(token));
+  return containers::unique_ptr<Buffer>(
+      buff, containers::UniqueDeleter(&object_pool_, sizeof(Buffer)));
+}
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindSharedHostBuffer(VkDeviceSize size,
+                                                 VkBufferUsageFlags usages) {
+  return CreateAndBindSharedBuffer(kSharedBufferHost, size, usages);
+}
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindSharedCoherentBuffer(
+    VkDeviceSize size, VkBufferUsageFlags usages) {
+  return CreateAndBindSharedBuffer(kSharedBufferCoherent, size, usages);
+}
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindSharedDeviceBuffer(VkDeviceSize size,
+                                                   VkBufferUsageFlags usages) {
+  return CreateAndBindSharedBuffer(kSharedBufferDevice, size, usages);
+}
+
 containers::unique_ptr<VkBufferView> VulkanApplication::CreateBufferView(
     ::VkBuffer buffer, VkFormat format, VkDeviceSize offset,
     VkDeviceSize range) {
@@ -849,7 +2012,60 @@ containers::unique_ptr<VkBufferView> VulkanApplication::CreateBufferView(
       device_->vkCreateBufferView(device_, &create_info, nullptr, &raw_view),
       VK_SUCCESS);
   return containers::make_unique<vulkan::VkBufferView>(
-      allocator_, VkBufferView(raw_view, nullptr, &device_));
+      &object_pool_, VkBufferView(raw_view, nullptr, &device_));
+}
+
+void VulkanApplication::RecordImageLayersCopy(
+    VkCommandBuffer* command_buffer, Image* img,
+    const VkImageSubresourceLayers& image_subresource,
+    const VkOffset3D& image_offset, const VkExtent3D& image_extent,
+    VkImageLayout initial_img_layout, Buffer* src_buffer) {
+  // Add a buffer barrier so that the flushed memory becomes visible to the
+  // device.
+  VkBufferMemoryBarrier buffer_barrier{
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      nullptr,
+      VK_ACCESS_HOST_WRITE_BIT,
+      VK_ACCESS_TRANSFER_READ_BIT,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      *src_buffer,
+      0,
+      src_buffer->size(),
+  };
+  // Add an image barrier to change the layout set its access bit to transfer
+  // write.
+  VkImageMemoryBarrier image_barrier{
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      nullptr,
+      0,  // Change to write access, no read-after-write risk.
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      initial_img_layout,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      *img,
+      // subresource range, only deal one mip level
+      {
+          image_subresource.aspectMask,
+          image_subresource.mipLevel,
+          1,
+          image_subresource.baseArrayLayer,
+          image_subresource.layerCount,
+      }};
+  command_buffer->QueueBufferBarrier(VK_PIPELINE_STAGE_HOST_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     buffer_barrier);
+  command_buffer->QueueImageBarrier(VK_PIPELINE_STAGE_HOST_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    image_barrier);
+  // Copy data to the image.
+  VkBufferImageCopy copy_info{
+      0, 0, 0, image_subresource, image_offset, image_extent};
+  (*command_buffer)
+      ->vkCmdCopyBufferToImage(*command_buffer, *src_buffer, *img,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                               &copy_info);
 }
 
 std::tuple<bool, VkCommandBuffer, BufferPointer>
@@ -876,9 +2092,11 @@ VulkanApplication::FillImageLayersData(
     return failure_return;
   }
 
-  containers::vector<::VkSemaphore> waits(wait_semaphores, allocator_);
-  containers::vector<::VkSemaphore> signals(signal_semaphores, allocator_);
-  containers::vector<VkPipelineStageFlags> wait_dst_stage_masks(
+  containers::small_vector<::VkSemaphore, 4> waits(wait_semaphores,
+                                                   allocator_);
+  containers::small_vector<::VkSemaphore, 4> signals(signal_semaphores,
+                                                     allocator_);
+  containers::small_vector<VkPipelineStageFlags, 4> wait_dst_stage_masks(
       waits.size(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, allocator_);
 
   // Prepare the buffer to be used for data copying.
@@ -893,7 +2111,8 @@ VulkanApplication::FillImageLayersData(
       nullptr,
   };
   BufferPointer src_buffer = CreateAndBindHostBuffer(&buf_create_info);
-  std::copy_n(data.begin(), data.size(), src_buffer->base_address());
+  CopyToMappedMemory(job_system_, src_buffer->base_address(), data.data(),
+                     data.size());
   src_buffer->flush();
 
   // Get a command buffer and add commands/barriers to it.
@@ -901,32 +2120,104 @@ VulkanApplication::FillImageLayersData(
   VkCommandBufferBeginInfo cmd_begin_info{
       VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr};
   command_buffer->vkBeginCommandBuffer(command_buffer, &cmd_begin_info);
-  // Add a buffer barrier so that the flushed memory becomes visible to the
-  // device.
-  VkBufferMemoryBarrier buffer_barrier{
-      VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+  RecordImageLayersCopy(&command_buffer, img, image_subresource, image_offset,
+                        image_extent, initial_img_layout, src_buffer.get());
+  // Add a global barrier at the end to make sure the data written to the
+  // image is available globally.
+  VkMemoryBarrier end_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                              VK_ACCESS_TRANSFER_WRITE_BIT, kAllReadBits};
+  command_buffer.QueueMemoryBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT,     // The data in image is produced at
+                                          // 'trasfer' stage
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  // The data should be available at
+                                          // the
+                                          // very begining for following
+                                          // commands.
+      end_barrier);
+
+  command_buffer->vkEndCommandBuffer(command_buffer);
+  // Submit the command buffer.
+  ::VkCommandBuffer raw_cmd_buf = command_buffer.get_command_buffer();
+  VkSubmitInfo submit_info{
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,               // sType
+      nullptr,                                     // pNext
+      uint32_t(waits.size()),                      // waitSemaphoreCount
+      waits.size() == 0 ? nullptr : waits.data(),  // pWaitSemaphores
+      waits.size() == 0 ? nullptr
+                        : wait_dst_stage_masks.data(),  // pWaitDstStageMask
+      1,                                                // commandBufferCount
+      &raw_cmd_buf,                                     // pCommandBuffers
+      uint32_t(signals.size()),                         // signalSemaphoreCount
+      signals.size() == 0 ? nullptr : signals.data()    // pSignalSemaphores
+  };
+  (*render_queue_)->vkQueueSubmit(render_queue(), 1, &submit_info, fence);
+  return std::make_tuple(true, std::move(command_buffer),
+                         std::move(src_buffer));
+}
+
+uint64_t VulkanApplication::FillImageLayersDataAsync(
+    Image* img, const VkImageSubresourceLayers& image_subresource,
+    const VkOffset3D& image_offset, const VkExtent3D& image_extent,
+    VkImageLayout initial_img_layout, const containers::vector<uint8_t>& data,
+    std::initializer_list<::VkSemaphore> wait_semaphores,
+    std::initializer_list<::VkSemaphore> signal_semaphores) {
+  ReleaseCompletedUploads();
+  if (!img) {
+    log_->LogError("FillImageLayersDataAsync(): The given *img is nullptr");
+    return 0;
+  }
+  size_t image_size = GetImageExtentSizeInBytes(image_extent, img->format()) *
+                      image_subresource.layerCount;
+  if (data.size() < image_size) {
+    log_->LogError(
+        "FillImageLayersDataAsync(): Not Enough data to fill the image "
+        "layers");
+    return 0;
+  }
+
+  VkQueue* queue = transfer_queue_concrete_ ? transfer_queue_concrete_.get()
+                                            : render_queue_;
+  uint32_t queue_index = transfer_queue_concrete_ ? transfer_queue_index_
+                                                  : render_queue_index_;
+  // Exclusively owned images have to be released by the transfer queue
+  // family and acquired by the render queue family before they can be used
+  // there.
+  const bool transfer_ownership =
+      queue_index != render_queue_index_ &&
+      img->create_info_.sharingMode == VK_SHARING_MODE_EXCLUSIVE;
+
+  containers::small_vector<::VkSemaphore, 4> waits(wait_semaphores,
+                                                   allocator_);
+  containers::small_vector<::VkSemaphore, 4> signals(signal_semaphores,
+                                                     allocator_);
+  containers::small_vector<VkPipelineStageFlags, 4> wait_dst_stage_masks(
+      waits.size(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, allocator_);
+
+  VkBufferCreateInfo buf_create_info{
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
       nullptr,
-      VK_ACCESS_HOST_WRITE_BIT,
-      VK_ACCESS_TRANSFER_READ_BIT,
-      VK_QUEUE_FAMILY_IGNORED,
-      VK_QUEUE_FAMILY_IGNORED,
-      *src_buffer,
       0,
       data.size(),
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_SHARING_MODE_EXCLUSIVE,
+      0,
+      nullptr,
   };
-  // Add an image barrier to change the layout set its access bit to transfer
-  // write.
-  VkImageMemoryBarrier image_barrier{
+  BufferPointer src_buffer = CreateAndBindHostBuffer(&buf_create_info);
+  CopyToMappedMemory(job_system_, src_buffer->base_address(), data.data(),
+                     data.size());
+  src_buffer->flush();
+
+  VkImageMemoryBarrier ownership_barrier{
       VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
       nullptr,
-      0,  // Change to write access, no read-after-write risk.
       VK_ACCESS_TRANSFER_WRITE_BIT,
-      initial_img_layout,
+      0,
       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      VK_QUEUE_FAMILY_IGNORED,
-      VK_QUEUE_FAMILY_IGNORED,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      queue_index,
+      render_queue_index_,
       *img,
-      // subresource range, only deal one mip level
       {
           image_subresource.aspectMask,
           image_subresource.mipLevel,
@@ -934,48 +2225,714 @@ VulkanApplication::FillImageLayersData(
           image_subresource.baseArrayLayer,
           image_subresource.layerCount,
       }};
+
+  VkCommandBuffer command_buffer = GetQueueCommandBuffer(*queue);
+  VkCommandBufferBeginInfo cmd_begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr};
+  command_buffer->vkBeginCommandBuffer(command_buffer, &cmd_begin_info);
+  RecordImageLayersCopy(&command_buffer, img, image_subresource, image_offset,
+                        image_extent, initial_img_layout, src_buffer.get());
+  if (transfer_ownership) {
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &ownership_barrier);
+  } else if (queue_index == render_queue_index_) {
+    VkMemoryBarrier end_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                                VK_ACCESS_TRANSFER_WRITE_BIT, kAllReadBits};
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &end_barrier, 0, nullptr, 0,
+        nullptr);
+  }
+  command_buffer->vkEndCommandBuffer(command_buffer);
+
+  VkFence fence = CreateFence(&device_);
+  VkSemaphore ownership_semaphore =
+      transfer_ownership
+          ? CreateSemaphore(&device_)
+          : VkSemaphore(static_cast<::VkSemaphore>(VK_NULL_HANDLE), nullptr,
+                        &device_);
+  VkCommandBuffer acquire_command_buffer =
+      transfer_ownership
+          ? GetCommandBuffer()
+          : VkCommandBuffer(static_cast<::VkCommandBuffer>(VK_NULL_HANDLE),
+                            &GetCommandPool(), &device_);
+
+  ::VkCommandBuffer raw_cmd_buf = command_buffer.get_command_buffer();
+  ::VkSemaphore raw_ownership_semaphore = ownership_semaphore;
+  VkSubmitInfo submit_info{
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,               // sType
+      nullptr,                                     // pNext
+      uint32_t(waits.size()),                      // waitSemaphoreCount
+      waits.size() == 0 ? nullptr : waits.data(),  // pWaitSemaphores
+      waits.size() == 0 ? nullptr
+                        : wait_dst_stage_masks.data(),  // pWaitDstStageMask
+      1,                                                // commandBufferCount
+      &raw_cmd_buf,                                     // pCommandBuffers
+      transfer_ownership ? 1u
+                         : uint32_t(signals.size()),  // signalSemaphoreCount
+      transfer_ownership ? &raw_ownership_semaphore
+                         : (signals.size() == 0
+                                ? nullptr
+                                : signals.data())  // pSignalSemaphores
+  };
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*queue)->vkQueueSubmit(
+                 *queue, 1, &submit_info,
+                 transfer_ownership ? ::VkFence(VK_NULL_HANDLE)
+                                    : ::VkFence(fence)));
+
+  if (transfer_ownership) {
+    // Acquire the image on the render queue once the copy is done.
+    acquire_command_buffer->vkBeginCommandBuffer(acquire_command_buffer,
+                                                 &cmd_begin_info);
+    ownership_barrier.srcAccessMask = 0;
+    ownership_barrier.dstAccessMask = kAllReadBits;
+    acquire_command_buffer->vkCmdPipelineBarrier(
+        acquire_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &ownership_barrier);
+    acquire_command_buffer->vkEndCommandBuffer(acquire_command_buffer);
+
+    ::VkCommandBuffer raw_acquire_cmd_buf =
+        acquire_command_buffer.get_command_buffer();
+    VkPipelineStageFlags acquire_wait_stage =
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo acquire_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        1,                              // waitSemaphoreCount
+        &raw_ownership_semaphore,       // pWaitSemaphores
+        &acquire_wait_stage,            // pWaitDstStageMask
+        1,                              // commandBufferCount
+        &raw_acquire_cmd_buf,           // pCommandBuffers
+        uint32_t(signals.size()),       // signalSemaphoreCount
+        signals.size() == 0 ? nullptr : signals.data()  // pSignalSemaphores
+    };
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               (*render_queue_)
+                   ->vkQueueSubmit(render_queue(), 1, &acquire_submit_info,
+                                   fence));
+  }
+
+  uint64_t value = next_upload_value_++;
+  pending_uploads_.push_back(containers::make_unique<PendingUpload>(
+      &object_pool_, value, std::move(fence), std::move(command_buffer),
+      std::move(acquire_command_buffer), std::move(ownership_semaphore),
+      std::move(src_buffer)));
+  return value;
+}
+
+uint64_t VulkanApplication::SubmitUpload(
+    VkCommandBuffer&& command_buffer,
+    containers::unique_ptr<Buffer>&& staging_buffer, VkQueue* queue) {
+  if (!queue) {
+    queue = render_queue_;
+  }
+  VkFence fence = CreateFence(&device_);
+  ::VkCommandBuffer raw_cmd_buf = command_buffer.get_command_buffer();
+  VkSubmitInfo submit_info{
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &raw_cmd_buf,                   // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*queue)->vkQueueSubmit(*queue, 1, &submit_info, fence));
+
+  uint64_t value = next_upload_value_++;
+  pending_uploads_.push_back(containers::make_unique<PendingUpload>(
+      &object_pool_, value, std::move(fence), std::move(command_buffer),
+      VkCommandBuffer(static_cast<::VkCommandBuffer>(VK_NULL_HANDLE),
+                      &GetCommandPool(), &device_),
+      VkSemaphore(static_cast<::VkSemaphore>(VK_NULL_HANDLE), nullptr,
+                  &device_),
+      std::move(staging_buffer)));
+  return value;
+}
+
+bool VulkanApplication::IsUploadComplete(uint64_t upload) {
+  ReleaseCompletedUploads();
+  return upload <= completed_upload_value_;
+}
+
+void VulkanApplication::ReleaseCompletedUploads() {
+  // Uploads may finish on either the transfer or the render queue, so they
+  // do not necessarily complete in the order that they were submitted.
+  pending_uploads_.erase(
+      std::remove_if(pending_uploads_.begin(), pending_uploads_.end(),
+                     [this](const containers::unique_ptr<PendingUpload>& u) {
+                       return device_->vkGetFenceStatus(device_, u->fence) ==
+                              VK_SUCCESS;
+                     }),
+      pending_uploads_.end());
+  // pending_uploads_ stays sorted, so everything before the oldest upload
+  // that is still in flight has completed.
+  completed_upload_value_ = pending_uploads_.empty()
+                                ? next_upload_value_ - 1
+                                : pending_uploads_.front()->value - 1;
+}
+
+namespace {
+// Returns true if |a| lives at a lower address in its arena than |b|.
+bool TokenIsBefore(const AllocationToken* a, const AllocationToken* b) {
+  if (a->block->index != b->block->index) {
+    return a->block->index < b->block->index;
+  }
+  return a->offset < b->offset;
+}
+
+// Returns all of the aspects of an image of the given |format|.
+VkImageAspectFlags GetFormatAspects(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+      return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+}  // anonymous namespace
+
+VulkanApplication::DefragmentationStats VulkanApplication::Defragment(
+    const containers::vector<Buffer*>& buffers,
+    const containers::vector<Image*>& images, VkImageLayout image_layout) {
+  DefragmentationStats stats = {0, 0, 0, 0};
+  if (device_.num_devices() > 1) {
+    log_->LogError("Defragment(): Device groups are not supported");
+    return stats;
+  }
+
+  // A resource that may be moved, and where it was moved to.
+  struct Move {
+    Buffer* buffer;
+    Image* image;
+    AllocationToken* old_token;
+    AllocationToken* new_token;
+    ::VkDeviceMemory memory;
+    ::VkDeviceSize offset;
+    char* base_address;
+    ::VkBuffer new_buffer;
+    ::VkImage new_image;
+  };
+  containers::vector<Move> moves(allocator_);
+  containers::vector<VulkanArena*> arenas(allocator_);
+  // The buffers that alias old and new buffer memory for the copies.
+  containers::vector<VkBuffer> alias_buffers(allocator_);
+  moves.reserve(buffers.size() + images.size());
+  alias_buffers.reserve(buffers.size() * 2);
+  auto add_arena = [&arenas](VulkanArena* arena) {
+    if (std::find(arenas.begin(), arenas.end(), arena) == arenas.end()) {
+      arenas.push_back(arena);
+    }
+  };
+  // Dedicated allocations own all of their memory, so there is nothing to
+  // gain from moving them.
+  for (Buffer* buffer : buffers) {
+    if (buffer->movable_ && !buffer->token_->block->dedicated) {
+      moves.push_back(Move{buffer, nullptr, buffer->token_, nullptr,
+                           VK_NULL_HANDLE, 0, nullptr, VK_NULL_HANDLE,
+                           VK_NULL_HANDLE});
+      add_arena(buffer->heap_);
+    }
+  }
+  for (Image* image : images) {
+    // Evicted images have no memory to move.
+    if (image->movable_ && image->token_ &&
+        !image->token_->block->dedicated) {
+      moves.push_back(Move{nullptr, image, image->token_, nullptr,
+                           VK_NULL_HANDLE, 0, nullptr, VK_NULL_HANDLE,
+                           VK_NULL_HANDLE});
+      add_arena(image->heap_);
+    }
+  }
+
+  ::VkDeviceSize size_before = 0;
+  for (VulkanArena* arena : arenas) {
+    size_before += arena->total_size();
+  }
+
+  // Move the resources at the highest addresses first, that is what lets the
+  // trailing blocks empty out.
+  std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) {
+    return TokenIsBefore(b.old_token, a.old_token);
+  });
+
+  VkCommandBuffer command_buffer = GetCommandBuffer();
+  VkCommandBufferBeginInfo cmd_begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+  command_buffer->vkBeginCommandBuffer(command_buffer, &cmd_begin_info);
+
+  // Make sure that all previous writes to the resources are visible to the
+  // copies.
+  VkMemoryBarrier start_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                                kAllWriteBits, VK_ACCESS_TRANSFER_READ_BIT};
   command_buffer->vkCmdPipelineBarrier(
-      command_buffer, VK_PIPELINE_STAGE_HOST_BIT,
-      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &buffer_barrier, 1,
-      &image_barrier);
-  // Copy data to the image.
-  VkBufferImageCopy copy_info{
-      0, 0, 0, image_subresource, image_offset, image_extent};
-  command_buffer->vkCmdCopyBufferToImage(command_buffer, *src_buffer, *img,
-                                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                         1, &copy_info);
-  // Add a global barrier at the end to make sure the data written to the
-  // image is available globally.
+      command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &start_barrier, 0, nullptr, 0,
+      nullptr);
+
+  for (Move& move : moves) {
+    if (move.buffer) {
+      Buffer* buffer = move.buffer;
+      VkBufferCreateInfo create_info = buffer->create_info_;
+      create_info.queueFamilyIndexCount = 0;
+      create_info.pQueueFamilyIndices = nullptr;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkCreateBuffer(device_, &create_info, nullptr,
+                                         &move.new_buffer));
+      VkMemoryRequirements requirements;
+      device_->vkGetBufferMemoryRequirements(device_, move.new_buffer,
+                                             &requirements);
+      move.new_token = buffer->heap_->AllocateMemoryBefore(
+          move.old_token, requirements.size, requirements.alignment,
+          &move.memory, &move.offset, &move.base_address);
+      if (!move.new_token) {
+        // There is no better place for this buffer.
+        device_->vkDestroyBuffer(device_, move.new_buffer, nullptr);
+        move.new_buffer = VK_NULL_HANDLE;
+        continue;
+      }
+      device_->vkBindBufferMemory(device_, move.new_buffer, move.memory,
+                                  move.offset);
+
+      // The buffer itself may not have been created with the transfer
+      // usages, so copy through transfer-only buffers that alias the old and
+      // new memory. Buffers are linear, so aliasing them is well defined.
+      VkBufferCreateInfo alias_info{
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // flags
+          create_info.size,                      // size
+          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // usage
+          VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+          0,                                     // queueFamilyIndexCount
+          nullptr                                // pQueueFamilyIndices
+      };
+      ::VkBuffer raw_src;
+      ::VkBuffer raw_dst;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkCreateBuffer(device_, &alias_info, nullptr,
+                                         &raw_src));
+      alias_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device_->vkCreateBuffer(device_, &alias_info, nullptr,
+                                         &raw_dst));
+      alias_buffers.push_back(VkBuffer(raw_src, nullptr, &device_));
+      alias_buffers.push_back(VkBuffer(raw_dst, nullptr, &device_));
+      device_->vkBindBufferMemory(device_, raw_src, buffer->memory_,
+                                  buffer->offset_);
+      device_->vkBindBufferMemory(device_, raw_dst, move.memory, move.offset);
+      VkBufferCopy region{0, 0, create_info.size};
+      command_buffer->vkCmdCopyBuffer(command_buffer, raw_src, raw_dst, 1,
+                                      &region);
+    } else {
+      Image* image = move.image;
+      VkImageCreateInfo create_info = image->create_info_;
+      create_info.queueFamilyIndexCount = 0;
+      create_info.pQueueFamilyIndices = nullptr;
+      create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      LOG_ASSERT(==, log_,
+                 device_->vkCreateImage(device_, &create_info, nullptr,
+                                        &move.new_image),
+                 VK_SUCCESS);
+      VkMemoryRequirements requirements;
+      device_->vkGetImageMemoryRequirements(device_, move.new_image,
+                                            &requirements);
+      move.new_token = image->heap_->AllocateMemoryBefore(
+          move.old_token, requirements.size, requirements.alignment,
+          &move.memory, &move.offset, nullptr);
+      if (!move.new_token) {
+        // There is no better place for this image.
+        device_->vkDestroyImage(device_, move.new_image, nullptr);
+        move.new_image = VK_NULL_HANDLE;
+        continue;
+      }
+      device_->vkBindImageMemory(device_, move.new_image, move.memory,
+                                 move.offset);
+
+      const VkImageSubresourceRange range{
+          GetFormatAspects(create_info.format), 0, create_info.mipLevels, 0,
+          create_info.arrayLayers};
+      if (image_layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        // The contents do not matter, so there is nothing to copy.
+        continue;
+      }
+      VkImageMemoryBarrier barriers[2] = {
+          {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, kAllWriteBits,
+           VK_ACCESS_TRANSFER_READ_BIT, image_layout,
+           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_QUEUE_FAMILY_IGNORED,
+           VK_QUEUE_FAMILY_IGNORED, *image, range},
+          {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, 0,
+           VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_QUEUE_FAMILY_IGNORED,
+           VK_QUEUE_FAMILY_IGNORED, move.new_image, range}};
+      command_buffer->vkCmdPipelineBarrier(
+          command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2,
+          barriers);
+
+      containers::vector<VkImageCopy> regions(allocator_);
+      regions.reserve(create_info.mipLevels);
+      for (uint32_t mip = 0; mip < create_info.mipLevels; ++mip) {
+        const VkImageSubresourceLayers layers{range.aspectMask, mip, 0,
+                                              create_info.arrayLayers};
+        const VkExtent3D extent{
+            std::max(create_info.extent.width >> mip, 1u),
+            std::max(create_info.extent.height >> mip, 1u),
+            std::max(create_info.extent.depth >> mip, 1u)};
+        regions.push_back(
+            VkImageCopy{layers, {0, 0, 0}, layers, {0, 0, 0}, extent});
+      }
+      command_buffer->vkCmdCopyImage(
+          command_buffer, *image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          move.new_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          static_cast<uint32_t>(regions.size()), regions.data());
+
+      // Put the new image into the layout that the old one was in.
+      VkImageMemoryBarrier end_barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                       nullptr,
+                                       VK_ACCESS_TRANSFER_WRITE_BIT,
+                                       kAllReadBits | kAllWriteBits,
+                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       image_layout,
+                                       VK_QUEUE_FAMILY_IGNORED,
+                                       VK_QUEUE_FAMILY_IGNORED,
+                                       move.new_image,
+                                       range};
+      command_buffer->vkCmdPipelineBarrier(
+          command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
+          &end_barrier);
+    }
+  }
+
+  VkMemoryBarrier end_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              kAllReadBits | kAllWriteBits};
+  command_buffer->vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &end_barrier, 0, nullptr, 0,
+      nullptr);
+  command_buffer->vkEndCommandBuffer(command_buffer);
+
+  VkFence fence = CreateFence(&device_);
+  ::VkCommandBuffer raw_cmd_buf = command_buffer.get_command_buffer();
+  VkSubmitInfo submit_info{
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &raw_cmd_buf,                   // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*render_queue_)
+                 ->vkQueueSubmit(render_queue(), 1, &submit_info,
+                                 fence.get_raw_object()));
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             device_->vkWaitForFences(device_, 1, &fence.get_raw_object(),
+                                      VK_TRUE, 0xFFFFFFFFFFFFFFFF));
+
+  // The copies are done, so the resources can now be switched over to
+  // their new memory, and the old memory can be returned to the arenas.
+  for (Move& move : moves) {
+    if (!move.new_token) {
+      continue;
+    }
+    stats.bytes_moved += move.new_token->allocationSize;
+    if (move.buffer) {
+      Buffer* buffer = move.buffer;
+      buffer->heap_->FreeMemory(move.old_token);
+      buffer->buffer_.reset(move.new_buffer);
+      buffer->token_ = move.new_token;
+      buffer->memory_ = move.memory;
+      buffer->offset_ = move.offset;
+      buffer->base_address_ = move.base_address;
+      stats.buffers_moved++;
+    } else {
+      Image* image = move.image;
+      image->heap_->FreeMemory(move.old_token);
+      image->image_.reset(move.new_image);
+      image->token_ = move.new_token;
+      stats.images_moved++;
+    }
+  }
+
+  ::VkDeviceSize size_after = 0;
+  for (VulkanArena* arena : arenas) {
+    size_after += arena->total_size();
+  }
+  stats.bytes_released = size_before - size_after;
+  log_->LogInfo("Defragment(): Moved ", stats.buffers_moved, " buffers and ",
+                stats.images_moved, " images (", stats.bytes_moved,
+                " bytes), released ", stats.bytes_released, " bytes");
+  return stats;
+}
+
+namespace {
+// Fills |regions| with copies of every mip level of an image created from
+// |create_info| to and from a buffer that holds them tightly packed, one
+// after the other, and returns the size of that buffer. Returns 0 if the
+// format of the image is not recognized.
+::VkDeviceSize GetPackedImageCopies(const VkImageCreateInfo& create_info,
+                                    containers::vector<VkBufferImageCopy>*
+                                        regions) {
+  // Every copy has to start at a multiple of both the texel block size and
+  // of 4 bytes.
+  const ::VkDeviceSize alignment =
+      std::get<0>(GetElementAndTexelBlockSize(create_info.format)) * 4;
+  if (alignment == 0) {
+    return 0;
+  }
+  ::VkDeviceSize size = 0;
+  regions->reserve(create_info.mipLevels);
+  for (uint32_t mip = 0; mip < create_info.mipLevels; ++mip) {
+    const VkExtent3D extent{std::max(create_info.extent.width >> mip, 1u),
+                            std::max(create_info.extent.height >> mip, 1u),
+                            std::max(create_info.extent.depth >> mip, 1u)};
+    regions->push_back(VkBufferImageCopy{
+        size,  // bufferOffset
+        0,     // bufferRowLength
+        0,     // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0,
+         create_info.arrayLayers},  // imageSubresource
+        {0, 0, 0},                  // imageOffset
+        extent                      // imageExtent
+    });
+    size += GetImageExtentSizeInBytes(extent, create_info.format) *
+            create_info.arrayLayers;
+    size = (size + alignment - 1) / alignment * alignment;
+  }
+  return size;
+}
+}  // anonymous namespace
+
+void VulkanApplication::ManageImageResidency(Image* image,
+                                             VkImageLayout layout) {
+  LOG_ASSERT(==, log_, true, image->movable_);
+  LOG_ASSERT(==, log_, 1u, device_.num_devices());
+  LOG_ASSERT(==, log_,
+             static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_COLOR_BIT),
+             GetFormatAspects(image->create_info_.format));
+  std::lock_guard<std::mutex> lock(residency_mutex_);
+  if (image->residency_manager_) {
+    return;
+  }
+  image->residency_manager_ = this;
+  image->resident_layout_ = layout;
+  image->last_use_frame_ = residency_frame_;
+  managed_images_.push_back(image);
+}
+
+void VulkanApplication::StopManagingResidency(Image* image) {
+  std::lock_guard<std::mutex> lock(residency_mutex_);
+  managed_images_.erase(
+      std::remove(managed_images_.begin(), managed_images_.end(), image),
+      managed_images_.end());
+}
+
+void VulkanApplication::BeginResidencyFrame(uint32_t retire_delay) {
+  std::lock_guard<std::mutex> lock(residency_mutex_);
+  ++residency_frame_;
+  residency_retire_delay_ = retire_delay;
+}
+
+bool VulkanApplication::MarkImageUsed(Image* image) {
+  {
+    std::lock_guard<std::mutex> lock(residency_mutex_);
+    image->last_use_frame_ = residency_frame_;
+    if (image->token_) {
+      return false;
+    }
+  }
+  RestoreImage(image);
+  return true;
+}
+
+bool VulkanApplication::EvictLeastRecentlyUsedImage(VulkanArena* heap) {
+  std::lock_guard<std::mutex> lock(residency_mutex_);
+  Image* image = nullptr;
+  for (Image* candidate : managed_images_) {
+    if (candidate->heap_ != heap || !candidate->token_ ||
+        candidate->last_use_frame_ + residency_retire_delay_ >
+            residency_frame_) {
+      continue;
+    }
+    if (!image || candidate->last_use_frame_ < image->last_use_frame_) {
+      image = candidate;
+    }
+  }
+  if (!image) {
+    return false;
+  }
+
+  const VkImageCreateInfo& create_info = image->create_info_;
+  containers::vector<VkBufferImageCopy> regions(allocator_);
+  const ::VkDeviceSize size = GetPackedImageCopies(create_info, &regions);
+  if (size == 0) {
+    log_->LogError("Cannot evict an image of format ", create_info.format);
+    return false;
+  }
+  VkBufferCreateInfo buffer_info{
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+      nullptr,                               // pNext
+      0,                                     // flags
+      size,                                  // size
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,  // usage
+      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+      0,                                     // queueFamilyIndexCount
+      nullptr                                // pQueueFamilyIndices
+  };
+  containers::unique_ptr<Buffer> contents =
+      CreateAndBindHostBuffer(&buffer_info);
+
+  VkCommandBuffer command_buffer = GetCommandBuffer();
+  VkCommandBufferBeginInfo cmd_begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+  command_buffer->vkBeginCommandBuffer(command_buffer, &cmd_begin_info);
+  const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                      create_info.mipLevels, 0,
+                                      create_info.arrayLayers};
+  VkImageMemoryBarrier image_barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                     nullptr,
+                                     kAllWriteBits,
+                                     VK_ACCESS_TRANSFER_READ_BIT,
+                                     image->resident_layout_,
+                                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                     VK_QUEUE_FAMILY_IGNORED,
+                                     VK_QUEUE_FAMILY_IGNORED,
+                                     *image,
+                                     range};
+  command_buffer->vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+      &image_barrier);
+  command_buffer->vkCmdCopyImageToBuffer(
+      command_buffer, *image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *contents,
+      static_cast<uint32_t>(regions.size()), regions.data());
+  // The contents are only ever read back by the copy in RestoreImage.
   VkMemoryBarrier end_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
-                              VK_ACCESS_TRANSFER_WRITE_BIT, kAllReadBits};
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_ACCESS_TRANSFER_READ_BIT};
   command_buffer->vkCmdPipelineBarrier(
-      command_buffer,
-      VK_PIPELINE_STAGE_TRANSFER_BIT,     // The data in image is produced at
-                                          // 'trasfer' stage
-      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  // The data should be available at
-                                          // the
-                                          // very begining for following
-                                          // commands.
-      0, 1, &end_barrier, 0, nullptr, 0, nullptr);
-
+      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &end_barrier, 0, nullptr, 0,
+      nullptr);
   command_buffer->vkEndCommandBuffer(command_buffer);
-  // Submit the command buffer.
+
+  VkFence fence = CreateFence(&device_);
   ::VkCommandBuffer raw_cmd_buf = command_buffer.get_command_buffer();
   VkSubmitInfo submit_info{
-      VK_STRUCTURE_TYPE_SUBMIT_INFO,               // sType
-      nullptr,                                     // pNext
-      uint32_t(waits.size()),                      // waitSemaphoreCount
-      waits.size() == 0 ? nullptr : waits.data(),  // pWaitSemaphores
-      waits.size() == 0 ? nullptr
-                        : wait_dst_stage_masks.data(),  // pWaitDstStageMask
-      1,                                                // commandBufferCount
-      &raw_cmd_buf,                                     // pCommandBuffers
-      uint32_t(signals.size()),                         // signalSemaphoreCount
-      signals.size() == 0 ? nullptr : signals.data()    // pSignalSemaphores
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask
+      1,                              // commandBufferCount
+      &raw_cmd_buf,                   // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
   };
-  (*render_queue_)->vkQueueSubmit(render_queue(), 1, &submit_info, fence);
-  return std::make_tuple(true, std::move(command_buffer),
-                         std::move(src_buffer));
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*render_queue_)
+                 ->vkQueueSubmit(render_queue(), 1, &submit_info,
+                                 fence.get_raw_object()));
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             device_->vkWaitForFences(device_, 1, &fence.get_raw_object(),
+                                      VK_TRUE, 0xFFFFFFFFFFFFFFFF));
+
+  // The fence also covers everything that was submitted to the render queue
+  // before, so nothing there uses the image anymore.
+  image->image_.reset(VK_NULL_HANDLE);
+  image->heap_->FreeMemory(image->token_);
+  image->token_ = nullptr;
+  image->evicted_contents_ = std::move(contents);
+  ++num_image_evictions_;
+  return true;
+}
+
+void VulkanApplication::RestoreImage(Image* image) {
+  VkImageCreateInfo create_info = image->create_info_;
+  create_info.queueFamilyIndexCount = 0;
+  create_info.pQueueFamilyIndices = nullptr;
+  create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  ::VkImage new_image;
+  LOG_ASSERT(==, log_,
+             device_->vkCreateImage(device_, &create_info, nullptr, &new_image),
+             VK_SUCCESS);
+  ::VkDeviceMemory memory;
+  ::VkDeviceSize offset;
+  VulkanArena* heap;
+  // This may evict other images to make room for this one.
+  AllocationToken* token =
+      AllocateImageMemory(new_image, &create_info, &heap, &memory, &offset);
+  device_->vkBindImageMemory(device_, new_image, memory, offset);
+
+  containers::vector<VkBufferImageCopy> regions(allocator_);
+  GetPackedImageCopies(create_info, &regions);
+  VkCommandBuffer command_buffer = GetCommandBuffer();
+  VkCommandBufferBeginInfo cmd_begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+  command_buffer->vkBeginCommandBuffer(command_buffer, &cmd_begin_info);
+  const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                      create_info.mipLevels, 0,
+                                      create_info.arrayLayers};
+  VkImageMemoryBarrier image_barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                     nullptr,
+                                     0,
+                                     VK_ACCESS_TRANSFER_WRITE_BIT,
+                                     VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_QUEUE_FAMILY_IGNORED,
+                                     VK_QUEUE_FAMILY_IGNORED,
+                                     new_image,
+                                     range};
+  command_buffer->vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+      &image_barrier);
+  command_buffer->vkCmdCopyBufferToImage(
+      command_buffer, *image->evicted_contents_, new_image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      static_cast<uint32_t>(regions.size()), regions.data());
+  // Everything that is submitted to the render queue after this sees the
+  // image as it was before it was evicted.
+  image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  image_barrier.dstAccessMask = kAllReadBits | kAllWriteBits;
+  image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  image_barrier.newLayout = image->resident_layout_;
+  command_buffer->vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
+      &image_barrier);
+  command_buffer->vkEndCommandBuffer(command_buffer);
+  SubmitUpload(std::move(command_buffer), std::move(image->evicted_contents_));
+
+  std::lock_guard<std::mutex> lock(residency_mutex_);
+  image->image_.reset(new_image);
+  image->heap_ = heap;
+  image->token_ = token;
 }
 
 const size_t MAX_UPDATE_SIZE = 65536;
@@ -1015,12 +2972,10 @@ void VulkanApplication::FillSmallBuffer(Buffer* buffer, const void* data,
       0,
       data_size};
 
-  (*command_buffer)
-      ->vkCmdPipelineBarrier(
-          *command_buffer,
-          VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
-          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0,
-          nullptr);
+  // Queued, so that the barriers of several fills are merged.
+  command_buffer->QueueBufferBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, barrier);
   if (device_mask != 0) {
     command_buffer->set_device_mask(old_device_mask);
   }
@@ -1038,7 +2993,7 @@ void VulkanApplication::FillHostVisibleBuffer(Buffer* buffer, const void* data,
   }
   const char* d = reinterpret_cast<const char*>(data);
   size_t size = buffer->size() < data_size ? buffer->size() : data_size;
-  memcpy(p + buffer_offset, d, size);
+  CopyToMappedMemory(job_system_, p + buffer_offset, d, size);
   buffer->flush();
   if (command_buffer) {
     VkBufferMemoryBarrier buf_barrier{
@@ -1060,50 +3015,11 @@ void VulkanApplication::FillHostVisibleBuffer(Buffer* buffer, const void* data,
   }
 }
 
-bool VulkanApplication::DumpImageLayersData(
-    Image* img, const VkImageSubresourceLayers& image_subresource,
+void VulkanApplication::RecordImageLayersReadback(
+    VkCommandBuffer* command_buffer, Image* img,
+    const VkImageSubresourceLayers& image_subresource,
     const VkOffset3D& image_offset, const VkExtent3D& image_extent,
-    VkImageLayout initial_img_layout, containers::vector<uint8_t>* data,
-    std::initializer_list<::VkSemaphore> wait_semaphores) {
-  if (!img) {
-    log_->LogError("DumpImageLayersData(): The given *img is nullptr");
-    return false;
-  }
-
-  containers::vector<::VkSemaphore> waits(wait_semaphores, allocator_);
-  containers::vector<VkPipelineStageFlags> wait_dst_stage_masks(
-      waits.size(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, allocator_);
-
-  // Prepare the dst buffer.
-  size_t image_size = GetImageExtentSizeInBytes(image_extent, img->format()) *
-                      image_subresource.layerCount;
-  if (image_size == 0) {
-    log_->LogError(
-        "DumpImageLayersData(): The size of the dump source image layers is "
-        "0, "
-        "this might be caused by an unrecognized image format");
-    return false;
-  }
-
-  data->reserve(image_size);
-  VkBufferCreateInfo buf_create_info = {
-      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
-      nullptr,                               // pNext
-      0,                                     // createFlags
-      image_size,                            // size
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
-      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
-      0,                                     // queueFamilyIndexCount
-      nullptr                                // pQueueFamilyIndices
-  };
-  vulkan::BufferPointer dst_buffer = CreateAndBindHostBuffer(&buf_create_info);
-
-  // Get a command buffer and add commands/barriers to it.
-  VkCommandBuffer command_buffer = GetCommandBuffer();
-  VkCommandBufferBeginInfo cmd_begin_info{
-      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr};
-  command_buffer->vkBeginCommandBuffer(command_buffer, &cmd_begin_info);
-
+    VkImageLayout initial_img_layout, Buffer* dst_buffer) {
   // Add a buffer barrier to set the access bit to transfer write.
   VkBufferMemoryBarrier buffer_barrier{
       VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
@@ -1114,7 +3030,7 @@ bool VulkanApplication::DumpImageLayersData(
       VK_QUEUE_FAMILY_IGNORED,
       *dst_buffer,
       0,
-      data->size(),
+      dst_buffer->size(),
   };
   // Add an image barrier to change the layout and set its access bit to
   // transfer read.
@@ -1136,24 +3052,76 @@ bool VulkanApplication::DumpImageLayersData(
           image_subresource.baseArrayLayer,
           image_subresource.layerCount,
       }};
-  command_buffer->vkCmdPipelineBarrier(
-      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+  (*command_buffer)->vkCmdPipelineBarrier(
+      *command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &buffer_barrier, 1,
       &image_barrier);
   // Copy data from the image.
   VkBufferImageCopy copy_info{
       0, 0, 0, image_subresource, image_offset, image_extent};
-  command_buffer->vkCmdCopyImageToBuffer(command_buffer, *img,
-                                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                         *dst_buffer, 1, &copy_info);
+  (*command_buffer)
+      ->vkCmdCopyImageToBuffer(*command_buffer, *img,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               *dst_buffer, 1, &copy_info);
 
   // Add a global barrier to make sure the data written to buffer is available
   // globally.
   VkMemoryBarrier end_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
                               VK_ACCESS_TRANSFER_WRITE_BIT, kAllReadBits};
-  command_buffer->vkCmdPipelineBarrier(
-      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+  (*command_buffer)->vkCmdPipelineBarrier(
+      *command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &end_barrier, 0, nullptr, 0, nullptr);
+}
+
+bool VulkanApplication::DumpImageLayersData(
+    Image* img, const VkImageSubresourceLayers& image_subresource,
+    const VkOffset3D& image_offset, const VkExtent3D& image_extent,
+    VkImageLayout initial_img_layout, containers::vector<uint8_t>* data,
+    std::initializer_list<::VkSemaphore> wait_semaphores) {
+  if (!img) {
+    log_->LogError("DumpImageLayersData(): The given *img is nullptr");
+    return false;
+  }
+
+  containers::small_vector<::VkSemaphore, 4> waits(wait_semaphores,
+                                                   allocator_);
+  containers::small_vector<VkPipelineStageFlags, 4> wait_dst_stage_masks(
+      waits.size(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, allocator_);
+
+  // Prepare the dst buffer.
+  size_t image_size = GetImageExtentSizeInBytes(image_extent, img->format()) *
+                      image_subresource.layerCount;
+  if (image_size == 0) {
+    log_->LogError(
+        "DumpImageLayersData(): The size of the dump source image layers is "
+        "0, "
+        "this might be caused by an unrecognized image format");
+    return false;
+  }
+
+  data->reserve(image_size);
+  VkBufferCreateInfo buf_create_info = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+      nullptr,                               // pNext
+      0,                                     // createFlags
+      image_size,                            // size
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
+      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+      0,                                     // queueFamilyIndexCount
+      nullptr                                // pQueueFamilyIndices
+  };
+  vulkan::BufferPointer dst_buffer =
+      CreateAndBindReadbackBuffer(&buf_create_info);
+
+  // Get a command buffer and add commands/barriers to it.
+  VkCommandBuffer command_buffer = GetCommandBuffer();
+  VkCommandBufferBeginInfo cmd_begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr};
+  command_buffer->vkBeginCommandBuffer(command_buffer, &cmd_begin_info);
+
+  RecordImageLayersReadback(&command_buffer, img, image_subresource,
+                            image_offset, image_extent, initial_img_layout,
+                            dst_buffer.get());
   command_buffer->vkEndCommandBuffer(command_buffer);
   // Submit the command buffer.
   ::VkCommandBuffer raw_cmd_buf = command_buffer.get_command_buffer();
@@ -1181,49 +3149,132 @@ bool VulkanApplication::DumpImageLayersData(
   return true;
 }
 
-// These linked-list nodes are ordered by offset into the heap.
-// the first node has a prev of nullptr, and the last node has a next of
-// nullptr.
-struct AllocationToken {
-  AllocationToken* next;
-  AllocationToken* prev;
-  ::VkDeviceSize allocationSize;
-  ::VkDeviceSize offset;
-  // Location into the map of unused chunks. This is only valid when
-  // in_use == false.
-  containers::ordered_multimap<::VkDeviceSize, AllocationToken*>::iterator
-      map_location;
-  bool in_use;
-};
+bool VulkanApplication::DumpImageLayersDataAsync(
+    Image* img, const VkImageSubresourceLayers& image_subresource,
+    const VkOffset3D& image_offset, const VkExtent3D& image_extent,
+    VkImageLayout initial_img_layout, VkImageLayout final_img_layout,
+    VkCommandBuffer* command_buffer, ::VkFence fence,
+    ReadbackCallback callback) {
+  if (!img) {
+    log_->LogError("DumpImageLayersDataAsync(): The given *img is nullptr");
+    return false;
+  }
+  size_t image_size = GetImageExtentSizeInBytes(image_extent, img->format()) *
+                      image_subresource.layerCount;
+  if (image_size == 0) {
+    log_->LogError(
+        "DumpImageLayersDataAsync(): The size of the dump source image layers "
+        "is 0, this might be caused by an unrecognized image format");
+    return false;
+  }
+
+  VkBufferCreateInfo buf_create_info = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+      nullptr,                               // pNext
+      0,                                     // createFlags
+      image_size,                            // size
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
+      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+      0,                                     // queueFamilyIndexCount
+      nullptr                                // pQueueFamilyIndices
+  };
+  BufferPointer dst_buffer = CreateAndBindReadbackBuffer(&buf_create_info);
+  RecordImageLayersReadback(command_buffer, img, image_subresource,
+                            image_offset, image_extent, initial_img_layout,
+                            dst_buffer.get());
+  if (final_img_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+    VkImageMemoryBarrier image_barrier{
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_TRANSFER_READ_BIT,
+        kAllReadBits | kAllWriteBits,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        final_img_layout,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        *img,
+        {
+            image_subresource.aspectMask,
+            image_subresource.mipLevel,
+            1,
+            image_subresource.baseArrayLayer,
+            image_subresource.layerCount,
+        }};
+    (*command_buffer)
+        ->vkCmdPipelineBarrier(*command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+                               nullptr, 0, nullptr, 1, &image_barrier);
+  }
+  pending_readbacks_.push_back(containers::make_unique<PendingReadback>(
+      &object_pool_, fence, image_size, std::move(dst_buffer),
+      std::move(callback)));
+  return true;
+}
+
+void VulkanApplication::PollImageReadbacks() {
+  // Callbacks are made in the order that the readbacks were recorded.
+  auto it = pending_readbacks_.begin();
+  for (; it != pending_readbacks_.end(); ++it) {
+    PendingReadback* readback = it->get();
+    if (device_->vkGetFenceStatus(device_, readback->fence) != VK_SUCCESS) {
+      break;
+    }
+    readback->buffer->invalidate();
+    readback->callback(
+        reinterpret_cast<const uint8_t*>(readback->buffer->base_address()),
+        readback->size);
+  }
+  pending_readbacks_.erase(pending_readbacks_.begin(), it);
+}
 
 VulkanArena::VulkanArena(containers::Allocator* allocator, logging::Logger* log,
                          ::VkDeviceSize buffer_size, uint32_t memory_type_index,
-                         VkDevice* device, bool map, uint32_t device_mask)
+                         VkDevice* device, bool map, uint32_t device_mask,
+                         ArenaStrategy strategy,
+                         VkBufferUsageFlags block_buffer_usage,
+                         bool device_address)
     : allocator_(allocator),
+      strategy_(strategy),
       freeblocks_(allocator_),
-      first_block_(nullptr),
-      base_address_(nullptr),
+      tlsf_first_level_bitmap_(0),
+      tlsf_second_level_bitmap_(),
+      tlsf_free_lists_(),
+      blocks_(allocator_),
+      token_slabs_(allocator_),
+      free_tokens_(nullptr),
       device_(*device),
-      unmap_memory_function_(nullptr),
-      memory_(VK_NULL_HANDLE, nullptr, device),
+      device_functions_(device->functions()),
+      memory_type_index_(memory_type_index),
+      map_(map),
+      device_mask_info_({VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr,
+                         VK_MEMORY_ALLOCATE_DEVICE_MASK_BIT, 0}),
+      block_size_(buffer_size),
+      total_size_(0),
+      growth_limit_(0),
+      heap_index_(0),
+      block_buffer_usage_(block_buffer_usage),
+      num_suballocations_(0),
+      num_dedicated_allocations_(0),
+      live_dedicated_allocations_(0),
+      num_frees_(0),
+      used_bytes_(0),
+      padding_bytes_(0),
+      dedicated_bytes_(0),
+      high_water_mark_(0),
+      debug_name_(nullptr),
       log_(log) {
-  void* pNext = nullptr;
-  VkMemoryAllocateFlagsInfo flags = {
-      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr,
-      VK_MEMORY_ALLOCATE_DEVICE_MASK_BIT, 0};
-
+  STARTUP_PHASE("CreateArena");
   uint32_t nDevices = 0;
   if (device->num_devices() > 1) {
-    pNext = &flags;
     if (device_mask == 0) {
       for (size_t i = 0; i < device->num_devices(); ++i) {
-        flags.deviceMask |= 1 << i;
+        device_mask_info_.deviceMask |= 1 << i;
         nDevices += 1;
       }
     } else {
       for (size_t i = 0; i < device->num_devices(); ++i) {
         if (device_mask & (1 << i)) {
-          flags.deviceMask |= 1 << i;
+          device_mask_info_.deviceMask |= 1 << i;
           nDevices += 1;
         }
       }
@@ -1233,82 +3284,359 @@ VulkanArena::VulkanArena(containers::Allocator* allocator, logging::Logger* log,
   // It is illegal to have map memory that is bound to
   // more than one GPU
   LOG_ASSERT(==, log, true, (!map || nDevices <= 1));
+  if (device_mask_info_.deviceMask == 0) {
+    device_mask_info_.flags = 0;
+  }
+  if (device_address) {
+    device_mask_info_.flags |= VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+  }
+
+  const auto& memory_properties = device->physical_device_memory_properties();
+  heap_index_ = memory_properties.memoryTypes[memory_type_index].heapIndex;
+  log->LogVerbose("Trying to allocate ", buffer_size,
+                  " bytes from heap that has ",
+                  memory_properties.memoryHeaps[heap_index_].size, " bytes.");
+
+  // Allocate the first block up front, so that the common case of an
+  // application that stays within its requested size only ever
+  // owns one block. block_size_ is the requested size, but the first block
+  // is allowed to shrink if the device cannot satisfy it.
+  ArenaBlock* first_block = AddBlock(0);
+  LOG_ASSERT(!=, log, static_cast<ArenaBlock*>(nullptr), first_block);
+  // If the first block had to shrink, that is a good indication of how
+  // large subsequent blocks can be.
+  block_size_ = first_block->size;
+}
+
+void VulkanArena::set_debug_name(const char* name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  debug_name_ = name;
+  for (ArenaBlock* block : blocks_) {
+    SetObjectName(device_functions_, device_, true,
+                  VK_OBJECT_TYPE_DEVICE_MEMORY,
+                  uint64_t(block->memory), debug_name_);
+  }
+}
+
+VulkanArena::~VulkanArena() {
+  // Dedicated allocations are not tracked in blocks_, so make sure they have
+  // all been freed as well.
+  LOG_ASSERT(==, log_, 0, live_dedicated_allocations_);
+  // Make sure that every block only has one token left, and that is is not in
+  // use. This will trigger if someone has not freed all the memory before the
+  // heap has been destroyed.
+  for (ArenaBlock* block : blocks_) {
+    LOG_ASSERT(==, log_, true, block->first_token->next == nullptr);
+    LOG_ASSERT(==, log_, false, block->first_token->in_use);
+    if (block->buffer != VK_NULL_HANDLE) {
+      device_functions_->vkDestroyBuffer(device_, block->buffer, nullptr);
+    }
+    if (block->base_address) {
+      device_functions_->vkUnmapMemory(device_, block->memory);
+    }
+    device_functions_->vkFreeMemory(device_, block->memory, nullptr);
+    DeleteToken(block->first_token);
+    allocator_->destroy(block);
+  }
+  for (AllocationToken* slab : token_slabs_) {
+    for (size_t i = 0; i < kTokensPerSlab; ++i) {
+      slab[i].~AllocationToken();
+    }
+    allocator_->free(slab, sizeof(AllocationToken) * kTokensPerSlab);
+  }
+}
+
+AllocationToken* VulkanArena::NewToken(const AllocationToken& value) {
+  if (!free_tokens_) {
+    // Tokens are never given back to the host until the arena is destroyed,
+    // so once the pool is large enough, splitting and merging ranges does not
+    // allocate anything.
+    AllocationToken* slab = static_cast<AllocationToken*>(
+        allocator_->malloc(sizeof(AllocationToken) * kTokensPerSlab));
+    token_slabs_.push_back(slab);
+    for (size_t i = 0; i < kTokensPerSlab; ++i) {
+      ::new (static_cast<void*>(&slab[i])) AllocationToken(value);
+      slab[i].next = free_tokens_;
+      free_tokens_ = &slab[i];
+    }
+  }
+  AllocationToken* token = free_tokens_;
+  free_tokens_ = token->next;
+  *token = value;
+  return token;
+}
+
+void VulkanArena::DeleteToken(AllocationToken* token) {
+  token->next = free_tokens_;
+  free_tokens_ = token;
+}
 
-  // Actually allocate the bytes for this heap.
+ArenaBlock* VulkanArena::AddBlock(::VkDeviceSize minimum_size) {
+  ::VkDeviceSize buffer_size =
+      block_size_ > minimum_size ? block_size_ : minimum_size;
+
+  if (growth_limit_ != 0 && !blocks_.empty()) {
+    // Stay within the memory budget, shrinking the new block if that is
+    // enough.
+    const ::VkDeviceSize available =
+        growth_limit_ > total_size_ ? growth_limit_ - total_size_ : 0;
+    if (available < minimum_size) {
+      log_->LogError("Growing the arena by ", minimum_size,
+                     " bytes would exceed its memory budget of ",
+                     growth_limit_, " bytes");
+      return nullptr;
+    }
+    buffer_size = buffer_size < available ? buffer_size : available;
+  }
+
+  // Actually allocate the bytes for this block.
   VkMemoryAllocateInfo allocate_info{
       VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
-      pNext,                                   // pNext
+      device_mask_info_.flags != 0 ? &device_mask_info_
+                                   : nullptr,  // pNext
       buffer_size,                             // allocationSize
-      memory_type_index};
+      memory_type_index_};
 
   VkResult res = VK_SUCCESS;
   ::VkDeviceMemory device_memory;
   VkDeviceSize original_size = buffer_size;
 
-  const auto& memory_properties = device->physical_device_memory_properties();
-
-  log->LogInfo("Trying to allocate ", buffer_size, " bytes from heap that has ",
-               memory_properties
-                   .memoryHeaps[memory_properties.memoryTypes[memory_type_index]
-                                    .heapIndex]
-                   .size,
-               " bytes.");
-
   do {
     if (res == VK_ERROR_OUT_OF_DEVICE_MEMORY ||
         res == VK_ERROR_OUT_OF_HOST_MEMORY) {
-      log->LogInfo("Could not allocate ", buffer_size,
-                   " bytes of "
-                   "device memory. Attempting to allocate ",
-                   static_cast<size_t>(buffer_size * 0.75), " bytes instead");
-      buffer_size =
+      VkDeviceSize next_size =
           static_cast<VkDeviceSize>(static_cast<float>(buffer_size) * 0.75f);
+      buffer_size = next_size > minimum_size ? next_size : minimum_size;
+      log_->LogInfo("Could not allocate ", allocate_info.allocationSize,
+                    " bytes of "
+                    "device memory. Attempting to allocate ",
+                    buffer_size, " bytes instead");
       allocate_info.allocationSize = buffer_size;
     }
 
-    res = (*device)->vkAllocateMemory(*device, &allocate_info, nullptr,
-                                      &device_memory);
-    // If we cannot even allocate 1/4 of the requested memory, it is time to
-    // fail.
+    res = device_functions_->vkAllocateMemory(device_, &allocate_info, nullptr,
+                                              &device_memory);
+    // If we cannot even allocate 1/4 of the requested memory, or we cannot
+    // shrink any further, it is time to fail.
   } while ((res == VK_ERROR_OUT_OF_DEVICE_MEMORY ||
             res == VK_ERROR_OUT_OF_HOST_MEMORY) &&
-           buffer_size > original_size / 4);
-  LOG_ASSERT(==, log, VK_SUCCESS, res);
-  memory_.initialize(device_memory);
-
-  // Create a new pointer that is the first block of memory. It contains
-  // all of the memory in the arena.
-  first_block_ = allocator_->construct<AllocationToken>(AllocationToken{
-      nullptr, nullptr, buffer_size, 0, freeblocks_.end(), false});
-
-  // Since this has not been used yet, add it to our freeblock_ map.
-  first_block_->map_location =
-      freeblocks_.insert(std::make_pair(buffer_size, first_block_));
+           buffer_size > original_size / 4 && buffer_size > minimum_size);
+  if (res != VK_SUCCESS) {
+    log_->LogError("Could not allocate a block of ", buffer_size,
+                   " bytes, the arena already holds ", total_size_, " bytes");
+    return nullptr;
+  }
 
-  if (map) {
+  char* base_address = nullptr;
+  if (map_) {
     // If we were asked to map this memory. (i.e. it is meant to be host
     // visible), then do it now.
-    LOG_ASSERT(
-        ==, log, VK_SUCCESS,
-        (*device)->vkMapMemory(*device, memory_, 0, buffer_size, 0,
-                               reinterpret_cast<void**>(&base_address_)));
-    // Store off the devices unmap memory function for the future, we only
-    // want to keep a reference to the raw device, and not the
-    // vulkan::VkDevice since vulkan::VkDevice is movable.
-    unmap_memory_function_ = &(*device)->vkUnmapMemory;
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_functions_->vkMapMemory(
+                   device_, device_memory, 0, buffer_size, 0,
+                   reinterpret_cast<void**>(&base_address)));
+  }
+
+  if (debug_name_) {
+    SetObjectName(device_functions_, device_, true,
+                  VK_OBJECT_TYPE_DEVICE_MEMORY, uint64_t(device_memory),
+                  debug_name_);
+  }
+
+  ArenaBlock* block = allocator_->construct<ArenaBlock>(
+      ArenaBlock{device_memory, buffer_size, base_address, nullptr,
+                 blocks_.size(), false, VK_NULL_HANDLE});
+
+  if (block_buffer_usage_ != 0) {
+    // Offsets into the memory of this block are then also offsets into this
+    // buffer.
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        buffer_size,                           // size
+        block_buffer_usage_,                   // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr,                               // pQueueFamilyIndices
+    };
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_functions_->vkCreateBuffer(device_, &create_info,
+                                                 nullptr, &block->buffer));
+    VkMemoryRequirements requirements;
+    device_functions_->vkGetBufferMemoryRequirements(device_, block->buffer,
+                                                     &requirements);
+    LOG_ASSERT(<=, log_, requirements.size, buffer_size);
+    LOG_ASSERT(!=, log_, 0u,
+               requirements.memoryTypeBits & (1u << memory_type_index_));
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_functions_->vkBindBufferMemory(device_, block->buffer,
+                                                     device_memory, 0));
+  }
+
+  // Create a new token that is the first token of the block. It contains
+  // all of the memory in the block.
+  block->first_token = NewToken(
+      AllocationToken{nullptr, nullptr, buffer_size, 0, freeblocks_.end(),
+                      false, block, nullptr, nullptr, 0});
+
+  // Since this has not been used yet, make it available for allocation.
+  InsertFreeToken(block->first_token);
+
+  blocks_.push_back(block);
+  total_size_ += buffer_size;
+  if (blocks_.size() > 1) {
+    log_->LogInfo("Arena grew by ", buffer_size, " bytes to ", total_size_,
+                  " bytes in ", blocks_.size(), " blocks");
+  }
+  return block;
+}
+
+void VulkanArena::ReleaseEmptyTrailingBlocks() {
+  auto empty = [](const ArenaBlock* block) {
+    return !block->first_token->in_use && block->first_token->next == nullptr;
+  };
+  // The last empty block is kept, so that a sample that allocates and frees
+  // across the end of a block every frame does not allocate and free device
+  // memory every frame.
+  while (blocks_.size() > 2 && empty(blocks_.back()) &&
+         empty(blocks_[blocks_.size() - 2])) {
+    ArenaBlock* block = blocks_.back();
+    AllocationToken* token = block->first_token;
+    RemoveFreeToken(token);
+    if (block->buffer != VK_NULL_HANDLE) {
+      device_functions_->vkDestroyBuffer(device_, block->buffer, nullptr);
+    }
+    if (block->base_address) {
+      device_functions_->vkUnmapMemory(device_, block->memory);
+    }
+    device_functions_->vkFreeMemory(device_, block->memory, nullptr);
+    total_size_ -= block->size;
+    DeleteToken(token);
+    allocator_->destroy(block);
+    blocks_.pop_back();
+  }
+}
+
+namespace {
+// Returns the index of the most significant set bit of |value|.
+// |value| must not be 0.
+uint32_t MostSignificantBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<uint32_t>(index);
+#else
+  return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+// Returns the index of the least significant set bit of |value|.
+// |value| must not be 0.
+uint32_t LeastSignificantBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+}  // anonymous namespace
+
+void VulkanArena::TLSFMapping(::VkDeviceSize size, uint32_t* first_level,
+                              uint32_t* second_level) {
+  // Sizes smaller than kTLSFSecondLevelCount all live in first level 0,
+  // with one byte per bucket.
+  if (size < kTLSFSecondLevelCount) {
+    *first_level = 0;
+    *second_level = static_cast<uint32_t>(size);
+    return;
+  }
+  const uint32_t msb = MostSignificantBit(size);
+  *second_level = static_cast<uint32_t>(size >> (msb - kTLSFSecondLevelLog2)) ^
+                  kTLSFSecondLevelCount;
+  *first_level = msb - kTLSFSecondLevelLog2 + 1;
+}
+
+void VulkanArena::InsertFreeToken(AllocationToken* token) {
+  if (strategy_ == ArenaStrategy::kOrderedFreeList) {
+    token->map_location =
+        freeblocks_.insert(std::make_pair(token->allocationSize, token));
+    return;
+  }
+  uint32_t fl, sl;
+  TLSFMapping(token->allocationSize, &fl, &sl);
+  AllocationToken*& head = tlsf_free_lists_[fl][sl];
+  token->prev_free = nullptr;
+  token->next_free = head;
+  if (head) {
+    head->prev_free = token;
+  }
+  head = token;
+  tlsf_first_level_bitmap_ |= uint64_t(1) << fl;
+  tlsf_second_level_bitmap_[fl] |= 1u << sl;
+}
+
+void VulkanArena::RemoveFreeToken(AllocationToken* token) {
+  if (strategy_ == ArenaStrategy::kOrderedFreeList) {
+    freeblocks_.erase(token->map_location);
+    return;
+  }
+  uint32_t fl, sl;
+  TLSFMapping(token->allocationSize, &fl, &sl);
+  if (token->next_free) {
+    token->next_free->prev_free = token->prev_free;
+  }
+  if (token->prev_free) {
+    token->prev_free->next_free = token->next_free;
+  } else {
+    tlsf_free_lists_[fl][sl] = token->next_free;
+    if (!token->next_free) {
+      // This bucket is now empty.
+      tlsf_second_level_bitmap_[fl] &= ~(1u << sl);
+      if (!tlsf_second_level_bitmap_[fl]) {
+        tlsf_first_level_bitmap_ &= ~(uint64_t(1) << fl);
+      }
+    }
   }
+  token->next_free = nullptr;
+  token->prev_free = nullptr;
 }
 
-VulkanArena::~VulkanArena() {
-  // Make sure that there is only one block left, and that is is not in use.
-  // This will trigger if someone has not freed all the memory before the
-  // heap has been destroyed.
-  LOG_ASSERT(==, log_, true, first_block_->next == nullptr);
-  LOG_ASSERT(==, log_, false, first_block_->in_use);
-  if (base_address_) {
-    (*unmap_memory_function_)(device_, memory_);
+AllocationToken* VulkanArena::FindFreeToken(::VkDeviceSize size) {
+  if (strategy_ == ArenaStrategy::kOrderedFreeList) {
+    auto it = freeblocks_.lower_bound(size);
+    return it == freeblocks_.end() ? nullptr : it->second;
+  }
+  // Round the size up to the next bucket boundary, so that every token in
+  // the bucket that we find is large enough.
+  if (size >= kTLSFSecondLevelCount) {
+    size += (::VkDeviceSize(1)
+             << (MostSignificantBit(size) - kTLSFSecondLevelLog2)) -
+            1;
+  }
+  uint32_t fl, sl;
+  TLSFMapping(size, &fl, &sl);
+  if (fl >= kTLSFFirstLevelCount) {
+    return nullptr;
   }
-  allocator_->destroy(first_block_);
+  // First look for a big enough bucket in the same power-of-two class.
+  uint32_t sl_map = tlsf_second_level_bitmap_[fl] & (~0u << sl);
+  if (!sl_map) {
+    // Otherwise take the smallest bucket of any larger class.
+    const uint64_t fl_map =
+        fl + 1 < kTLSFFirstLevelCount
+            ? tlsf_first_level_bitmap_ & (~uint64_t(0) << (fl + 1))
+            : 0;
+    if (!fl_map) {
+      return nullptr;
+    }
+    fl = LeastSignificantBit(fl_map);
+    sl_map = tlsf_second_level_bitmap_[fl];
+  }
+  sl = LeastSignificantBit(sl_map);
+  return tlsf_free_lists_[fl][sl];
 }
 
 // The maximum value for nonCoherentAtomSize from the vulkan spec.
@@ -1317,89 +3645,149 @@ VulkanArena::~VulkanArena() {
 // a description of why this must be used.
 static const ::VkDeviceSize kMaxNonCoherentAtomSize = 256;
 
-AllocationToken* VulkanArena::AllocateMemory(::VkDeviceSize size,
-                                             ::VkDeviceSize alignment,
-                                             ::VkDeviceMemory* memory,
-                                             ::VkDeviceSize* offset,
-                                             char** base_address) {
+void VulkanArena::ApplyMemoryRequirements(::VkDeviceSize* size,
+                                          ::VkDeviceSize* alignment) const {
   // If we are mapped memory, then no matter what alignment says, we
   // must also be aligned to kMaxNonCoherentAtomSize AND
   // for all intents and purposes our size must be a multiple of
   // kMaxNonCoherentAtomSize
-  if (base_address_) {
-    alignment = alignment > kMaxNonCoherentAtomSize ? alignment
-                                                    : kMaxNonCoherentAtomSize;
-    if ((size % kMaxNonCoherentAtomSize) != 0) {
-      size += (kMaxNonCoherentAtomSize - (size % kMaxNonCoherentAtomSize));
+  if (map_) {
+    *alignment = *alignment > kMaxNonCoherentAtomSize ? *alignment
+                                                      : kMaxNonCoherentAtomSize;
+    if ((*size % kMaxNonCoherentAtomSize) != 0) {
+      *size += (kMaxNonCoherentAtomSize - (*size % kMaxNonCoherentAtomSize));
     }
   }
 
-  // We use alignment - 1 quite a bit, so store it off here.
-  const ::VkDeviceSize align_m_1 = alignment - 1;
-  LOG_ASSERT(>, log_, alignment, 0);  // Alignment must be > 0
-  LOG_ASSERT(==, log_, !(alignment & (align_m_1)),
+  LOG_ASSERT(>, log_, *alignment, 0);  // Alignment must be > 0
+  LOG_ASSERT(==, log_, !(*alignment & (*alignment - 1)),
              true);  // Alignment must be power of 2.
+}
+
+AllocationToken* VulkanArena::AllocateMemory(::VkDeviceSize size,
+                                             ::VkDeviceSize alignment,
+                                             ::VkDeviceMemory* memory,
+                                             ::VkDeviceSize* offset,
+                                             char** base_address) {
+  AllocationToken* token =
+      TryAllocateMemory(size, alignment, memory, offset, base_address);
+  // Fail if we cannot get any more memory from the device.
+  LOG_ASSERT(!=, log_, static_cast<AllocationToken*>(nullptr), token);
+  return token;
+}
+
+AllocationToken* VulkanArena::TryAllocateMemory(::VkDeviceSize size,
+                                                ::VkDeviceSize alignment,
+                                                ::VkDeviceMemory* memory,
+                                                ::VkDeviceSize* offset,
+                                                char** base_address) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ApplyMemoryRequirements(&size, &alignment);
 
   // This is the maximum amount of memory we will potentially have to
   // allocate in order to satisfy the alignment.
-  ::VkDeviceSize to_allocate = size + align_m_1;
+  ::VkDeviceSize to_allocate = size + alignment - 1;
 
   // Find a block that contains at LEAST enough memory for our allocation.
-  auto it = freeblocks_.lower_bound(to_allocate);
-  // Fail if there is not even a single free-block that can hold our
-  // allocation.
-  LOG_ASSERT(==, log_, true, freeblocks_.end() != it);
+  AllocationToken* token = FindFreeToken(to_allocate);
+  if (!token) {
+    // Nothing fits in the memory we already have, so chain on another
+    // block. Every block starts at offset 0, which satisfies any alignment.
+    ArenaBlock* new_block = AddBlock(size);
+    if (!new_block) {
+      return nullptr;
+    }
+    token = new_block->first_token;
+  }
+
+  return AllocateFromFreeToken(token, size, alignment, memory, offset,
+                               base_address);
+}
+
+AllocationToken* VulkanArena::AllocateMemoryBefore(
+    const AllocationToken* limit, ::VkDeviceSize size, ::VkDeviceSize alignment,
+    ::VkDeviceMemory* memory, ::VkDeviceSize* offset, char** base_address) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ApplyMemoryRequirements(&size, &alignment);
+  const ::VkDeviceSize align_m_1 = alignment - 1;
+
+  // Walk every token in address order until we reach |limit|, and take the
+  // first free one that can hold the aligned allocation.
+  for (ArenaBlock* block : blocks_) {
+    for (AllocationToken* token = block->first_token; token;
+         token = token->next) {
+      if (token == limit) {
+        return nullptr;
+      }
+      if (token->in_use) {
+        continue;
+      }
+      ::VkDeviceSize aligned_offset =
+          (token->offset + align_m_1) & ~(align_m_1);
+      if (aligned_offset + size <= token->offset + token->allocationSize) {
+        return AllocateFromFreeToken(token, size, alignment, memory, offset,
+                                     base_address);
+      }
+    }
+  }
+  return nullptr;
+}
+
+AllocationToken* VulkanArena::AllocateFromFreeToken(
+    AllocationToken* token, ::VkDeviceSize size, ::VkDeviceSize alignment,
+    ::VkDeviceMemory* memory, ::VkDeviceSize* offset, char** base_address) {
+  // We use alignment - 1 quite a bit, so store it off here.
+  const ::VkDeviceSize align_m_1 = alignment - 1;
 
-  AllocationToken* token = it->second;
-  // Remove the block that we found from the freeblock map.
-  freeblocks_.erase(it);
+  ArenaBlock* block = token->block;
+  // Remove the block that we found from the free blocks.
+  RemoveFreeToken(token);
+  num_suballocations_++;
 
-  // total_offset is the offset from the base of the entire arena to the
-  // correctly aligned base inside of the given block.
+  // total_offset is the offset from the base of the entire block to the
+  // correctly aligned base inside of the given token.
   ::VkDeviceSize total_offset = (token->offset + (align_m_1)) & ~(align_m_1);
-  // offset_from_start is the offset from the start of the block to
+  // offset_from_start is the offset from the start of the token to
   // the alignment location.
   ::VkDeviceSize offset_from_start = total_offset - token->offset;
 
   // Our block may satisfy the alignment already, so only actually allocate
-  // the amount of memory we need.
-  // TODO(awoloszyn): If we find fragmentation to be a problem here, then
-  //   eventually actually allocate the total. If we do not do this,
-  //   then if we have (for example) a 128byte aligned block and we need
-  //   4K of memory, we wont be able to re-use this block for another 4K
-  //   allocation.
-  ::VkDeviceSize total_allocated =
-      to_allocate - (align_m_1 - offset_from_start);
+  // the amount of memory we need. The padding in front of the aligned
+  // location belongs to the new token, so that it is given back when the
+  // token is freed.
+  ::VkDeviceSize total_allocated = size + offset_from_start;
+  LOG_ASSERT(<=, log_, total_allocated, token->allocationSize);
+  used_bytes_ += total_allocated;
+  padding_bytes_ += offset_from_start;
+  if (used_bytes_ + dedicated_bytes_ > high_water_mark_) {
+    high_water_mark_ = used_bytes_ + dedicated_bytes_;
+  }
+
+  // Create a new block that contains the memory in question.
+  AllocationToken* new_token = NewToken(
+      AllocationToken{nullptr, token->prev, total_allocated, token->offset,
+                      freeblocks_.end(), true, block, nullptr, nullptr,
+                      offset_from_start});
 
   // Remove the memory from the block.
   // Push the block's base up by the allocated memory
   token->allocationSize -= total_allocated;
   token->offset += total_allocated;
 
-  // Create a new block that contains the memory in question.
-  AllocationToken* new_token = allocator_->construct<AllocationToken>(
-      AllocationToken{nullptr, token->prev, total_allocated, total_offset,
-                      freeblocks_.end(), true});
-
   if (token->allocationSize > 0) {
     // If there is still some space in this allocation, put it back, so we can
     // get more out of it later.
-    token->map_location =
-        freeblocks_.insert(std::make_pair(token->allocationSize, token));
+    InsertFreeToken(token);
 
     // Hook up all of our linked-list nodes.
     new_token->next = token;
     if (!token->prev) {
-      first_block_ = new_token;
+      block->first_token = new_token;
     } else {
       new_token->prev = token->prev;
       new_token->prev->next = new_token;
     }
     token->prev = new_token;
-    new_token->next = token;
-    if (first_block_ == token) {
-      first_block_ = new_token;
-    }
   } else {
     // token happens to now be an empty block. So let's not put it back.
     if (token->next) {
@@ -1409,40 +3797,162 @@ AllocationToken* VulkanArena::AllocateMemory(::VkDeviceSize size,
     if (token->prev) {
       token->prev->next = new_token;
     } else {
-      first_block_ = new_token;
+      block->first_token = new_token;
     }
 
-    allocator_->destroy(token);
+    DeleteToken(token);
   }
-  *memory = memory_;
+  *memory = block->memory;
   *offset = total_offset;
   if (base_address) {
-    *base_address = base_address_ ? base_address_ + total_offset : nullptr;
+    *base_address =
+        block->base_address ? block->base_address + total_offset : nullptr;
   }
   return new_token;
 }
 
+AllocationToken* VulkanArena::AllocateDedicatedMemory(
+    ::VkDeviceSize size, ::VkImage image, ::VkBuffer buffer,
+    ::VkDeviceMemory* memory, ::VkDeviceSize* offset, char** base_address) {
+  VkMemoryDedicatedAllocateInfo dedicated_info{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,  // sType
+      device_mask_info_.flags != 0 ? &device_mask_info_
+                                   : nullptr,  // pNext
+      image,                                   // image
+      buffer                                   // buffer
+  };
+  VkMemoryAllocateInfo allocate_info{
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
+      &dedicated_info,                         // pNext
+      size,                                    // allocationSize
+      memory_type_index_};
+
+  ::VkDeviceMemory device_memory;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             device_functions_->vkAllocateMemory(device_, &allocate_info,
+                                                 nullptr, &device_memory));
+  char* block_base_address = nullptr;
+  if (map_) {
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device_functions_->vkMapMemory(
+                   device_, device_memory, 0, size, 0,
+                   reinterpret_cast<void**>(&block_base_address)));
+  }
+
+  // Only the bookkeeping needs the lock, the device memory is our own.
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (debug_name_) {
+    SetObjectName(device_functions_, device_, true,
+                  VK_OBJECT_TYPE_DEVICE_MEMORY, uint64_t(device_memory),
+                  debug_name_);
+  }
+  ArenaBlock* block = allocator_->construct<ArenaBlock>(ArenaBlock{
+      device_memory, size, block_base_address, nullptr, 0, true,
+      VK_NULL_HANDLE});
+  block->first_token = NewToken(
+      AllocationToken{nullptr, nullptr, size, 0, freeblocks_.end(), true,
+                      block, nullptr, nullptr, 0});
+  num_dedicated_allocations_++;
+  live_dedicated_allocations_++;
+  dedicated_bytes_ += size;
+  if (used_bytes_ + dedicated_bytes_ > high_water_mark_) {
+    high_water_mark_ = used_bytes_ + dedicated_bytes_;
+  }
+
+  *memory = device_memory;
+  *offset = 0;
+  if (base_address) {
+    *base_address = block_base_address;
+  }
+  return block->first_token;
+}
+
+::VkDeviceSize VulkanArena::LargestFreeRange() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ::VkDeviceSize largest = 0;
+  for (const ArenaBlock* block : blocks_) {
+    for (const AllocationToken* token = block->first_token; token;
+         token = token->next) {
+      if (!token->in_use && token->allocationSize > largest) {
+        largest = token->allocationSize;
+      }
+    }
+  }
+  return largest;
+}
+
+::VkBuffer VulkanArena::block_buffer(const AllocationToken* token) const {
+  return token->block->buffer;
+}
+
+ArenaStats VulkanArena::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ArenaStats stats = {
+      total_size_,                                       // total_bytes
+      used_bytes_,                                       // used_bytes
+      total_size_ - used_bytes_,                         // free_bytes
+      0,                                                 // largest_free_block
+      0,                                                 // num_free_blocks
+      padding_bytes_,                                    // padding_bytes
+      dedicated_bytes_,                                  // dedicated_bytes
+      high_water_mark_,                                  // high_water_mark
+      num_suballocations_ + num_dedicated_allocations_,  // num_allocations
+      num_frees_,                                        // num_frees
+      blocks_.size(),                                    // num_blocks
+      token_slabs_.size() * kTokensPerSlab               // num_pooled_tokens
+  };
+  for (const ArenaBlock* block : blocks_) {
+    for (const AllocationToken* token = block->first_token; token;
+         token = token->next) {
+      if (token->in_use) {
+        continue;
+      }
+      stats.num_free_blocks++;
+      if (token->allocationSize > stats.largest_free_block) {
+        stats.largest_free_block = token->allocationSize;
+      }
+    }
+  }
+  return stats;
+}
+
 void VulkanArena::FreeMemory(AllocationToken* token) {
-  bool atAll = false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (token->block->dedicated) {
+    // This token owns all of its memory, so just give it back.
+    ArenaBlock* block = token->block;
+    if (block->base_address) {
+      device_functions_->vkUnmapMemory(device_, block->memory);
+    }
+    device_functions_->vkFreeMemory(device_, block->memory, nullptr);
+    dedicated_bytes_ -= block->size;
+    DeleteToken(token);
+    allocator_->destroy(block);
+    live_dedicated_allocations_--;
+    num_frees_++;
+    return;
+  }
+  used_bytes_ -= token->allocationSize;
+  padding_bytes_ -= token->padding;
+  token->padding = 0;
+  num_frees_++;
   // First try to coalesce this with its previous block.
   while (token->prev && !token->prev->in_use) {
-    atAll = true;
     // Take the previous token out of the map, and merge it with this one.
     AllocationToken* prev_token = token->prev;
+    // Remove the previous block from the free blocks before its size
+    // changes, we are about to merge with it.
+    RemoveFreeToken(prev_token);
     prev_token->allocationSize += token->allocationSize;
     prev_token->next = token->next;
     if (token->next) {
       token->next->prev = prev_token;
     }
-    // Remove the previous block from freeblocks_,
-    // we have now merged with it.
-    freeblocks_.erase(prev_token->map_location);
-    allocator_->destroy(token);
+    DeleteToken(token);
     token = prev_token;
   }
   // Now try to coalesce this with any subsequent blocks.
   while (token->next && !token->next->in_use) {
-    atAll = true;
     // Take the previous token out of the map, and merge it with this one.
     AllocationToken* next_token = token->next;
     token->allocationSize += next_token->allocationSize;
@@ -1450,24 +3960,30 @@ void VulkanArena::FreeMemory(AllocationToken* token) {
     if (token->next) {
       token->next->prev = token;
     }
-    // Remove the next block from freeblocks_,
+    // Remove the next block from the free blocks,
     // we have now merged with it.
-    freeblocks_.erase(next_token->map_location);
-    allocator_->destroy(next_token);
+    RemoveFreeToken(next_token);
+    DeleteToken(next_token);
   }
   // This block is no longer being used.
   token->in_use = false;
-  // Push it back into freeblocks_.
-  token->map_location =
-      freeblocks_.insert(std::make_pair(token->allocationSize, token));
+  // Push it back into the free blocks.
+  InsertFreeToken(token);
+
+  // If this emptied out a block, the ones after it may not be needed any
+  // more.
+  if (token->next == nullptr && token->prev == nullptr &&
+      token->block != blocks_.front()) {
+    ReleaseEmptyTrailingBlocks();
+  }
 }
 
 VulkanGraphicsPipeline::VulkanGraphicsPipeline(containers::Allocator* allocator,
                                                PipelineLayout* layout,
                                                VulkanApplication* application,
-                                               VkRenderPass* render_pass,
+                                               ::VkRenderPass render_pass,
                                                uint32_t subpass)
-    : render_pass_(*render_pass),
+    : render_pass_(render_pass),
       subpass_(subpass),
       application_(application),
       flags_(0),
@@ -1476,11 +3992,12 @@ VulkanGraphicsPipeline::VulkanGraphicsPipeline(containers::Allocator* allocator,
       vertex_binding_descriptions_(allocator),
       vertex_attribute_descriptions_(allocator),
       shader_modules_(allocator),
+      specializations_(allocator),
       attachments_(allocator),
       layout_(*layout),
-      pipeline_(VK_NULL_HANDLE, nullptr, &application->device()),
       contained_stages_(0),
-      pipeline_extensions_(nullptr) {
+      pipeline_extensions_(nullptr),
+      base_pipeline_(VK_NULL_HANDLE) {
   MemoryClear(&vertex_input_state_);
   MemoryClear(&input_assembly_state_);
   MemoryClear(&tessellation_state_);
@@ -1562,28 +4079,16 @@ void VulkanGraphicsPipeline::SetRasterizationExtension(const void* extension) {
   rasterization_state_.pNext = extension;
 }
 
-void VulkanGraphicsPipeline::AddShader(VkShaderStageFlagBits stage,
-                                       const char* entry, uint32_t* code,
-                                       uint32_t numCodeWords) {
+void VulkanGraphicsPipeline::AddShader(
+    VkShaderStageFlagBits stage, const char* entry, uint32_t* code,
+    uint32_t numCodeWords, const SpecializationConstants* constants) {
   LOG_ASSERT(==, application_->GetLogger(), 0,
              static_cast<uint32_t>(stage) & contained_stages_);
   LOG_ASSERT(==, application_->GetLogger(), stage,
              stage & VK_SHADER_STAGE_ALL_GRAPHICS);
   contained_stages_ |= stage;
-  VkShaderModuleCreateInfo create_info{
-      VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,  // sType
-      nullptr,                                      // pNext
-      0,                                            // flags
-      numCodeWords * 4,                             // codeSize
-      code                                          // pCode
-  };
-
-  ::VkShaderModule module;
-  LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
-             application_->device()->vkCreateShaderModule(
-                 application_->device(), &create_info, nullptr, &module));
   shader_modules_.push_back(
-      VkShaderModule(module, nullptr, &application_->device()));
+      application_->shader_module_cache().Get(code, numCodeWords));
 
   stages_.push_back({
       VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
@@ -1592,8 +4097,11 @@ void VulkanGraphicsPipeline::AddShader(VkShaderStageFlagBits stage,
       stage,                                                // stage
       shader_modules_.back(),                               // module
       entry,                                                // name
-      nullptr  // pSpecializationInfo
+      nullptr  // pSpecializationInfo, set in CreatePipeline
   });
+  specializations_.push_back(constants ? *constants
+                                       : SpecializationConstants(
+                                             application_->GetAllocator()));
 }
 
 void VulkanGraphicsPipeline::SetTopology(VkPrimitiveTopology topology,
@@ -1692,7 +4200,74 @@ void VulkanGraphicsPipeline::SetPipelineExtensions(
   pipeline_extensions_ = pipeline_extensions;
 }
 
-void VulkanGraphicsPipeline::Commit() {
+void VulkanGraphicsPipeline::Commit() { CreatePipeline(); }
+
+PipelineCompiler::Handle VulkanGraphicsPipeline::CommitAsync(
+    PipelineCompiler* compiler) {
+  compile_handle_ = compiler->Submit([this]() { CreatePipeline(); });
+  return compile_handle_;
+}
+
+void VulkanGraphicsPipeline::CommitWithDepthPrePass(
+    VulkanGraphicsPipeline* depth_pre_pass) {
+  LOG_ASSERT(==, application_->GetLogger(), VK_TRUE,
+             depth_stencil_state_.depthTestEnable);
+  VulkanGraphicsPipeline& pre_pass = *depth_pre_pass;
+  pre_pass.render_pass_ = render_pass_;
+  pre_pass.subpass_ = subpass_;
+  pre_pass.application_ = application_;
+  pre_pass.flags_ = flags_ | VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+  pre_pass.stages_.clear();
+  pre_pass.shader_modules_.clear();
+  pre_pass.specializations_.clear();
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    if (stages_[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+      continue;
+    }
+    pre_pass.stages_.push_back(stages_[i]);
+    pre_pass.shader_modules_.push_back(shader_modules_[i]);
+    pre_pass.specializations_.push_back(specializations_[i]);
+  }
+  pre_pass.contained_stages_ =
+      contained_stages_ & ~VK_SHADER_STAGE_FRAGMENT_BIT;
+  pre_pass.vertex_input_state_ = vertex_input_state_;
+  pre_pass.input_assembly_state_ = input_assembly_state_;
+  pre_pass.tessellation_state_ = tessellation_state_;
+  pre_pass.viewport_ = viewport_;
+  pre_pass.scissor_ = scissor_;
+  pre_pass.viewport_state_ = viewport_state_;
+  if (viewport_state_.pViewports == &viewport_) {
+    pre_pass.viewport_state_.pViewports = &pre_pass.viewport_;
+  }
+  if (viewport_state_.pScissors == &scissor_) {
+    pre_pass.viewport_state_.pScissors = &pre_pass.scissor_;
+  }
+  pre_pass.rasterization_state_ = rasterization_state_;
+  pre_pass.multisample_state_ = multisample_state_;
+  pre_pass.depth_stencil_state_ = depth_stencil_state_;
+  pre_pass.color_blend_state_ = color_blend_state_;
+  pre_pass.dynamic_state_ = dynamic_state_;
+  pre_pass.dynamic_states_ = dynamic_states_;
+  pre_pass.vertex_binding_descriptions_ = vertex_binding_descriptions_;
+  pre_pass.vertex_attribute_descriptions_ = vertex_attribute_descriptions_;
+  // The attachments stay in the subpass, but are not written.
+  pre_pass.attachments_ = attachments_;
+  for (auto& attachment : pre_pass.attachments_) {
+    attachment.blendEnable = VK_FALSE;
+    attachment.colorWriteMask = 0;
+  }
+  pre_pass.layout_ = layout_;
+  pre_pass.pipeline_extensions_ = pipeline_extensions_;
+
+  flags_ |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+  depth_stencil_state_.depthWriteEnable = VK_FALSE;
+  depth_stencil_state_.depthCompareOp = VK_COMPARE_OP_EQUAL;
+  CreatePipeline();
+  pre_pass.base_pipeline_ = pipeline_;
+  pre_pass.CreatePipeline();
+}
+
+void VulkanGraphicsPipeline::CreatePipeline() {
   vertex_input_state_.vertexBindingDescriptionCount =
       static_cast<uint32_t>(vertex_binding_descriptions_.size());
   vertex_input_state_.pVertexBindingDescriptions =
@@ -1716,14 +4291,26 @@ void VulkanGraphicsPipeline::Commit() {
     dynamic_state_.pDynamicStates = dynamic_states_.data();
   }
 
+  // The pipeline may have been moved since the shaders were added.
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    stages_[i].pSpecializationInfo = specializations_[i].info();
+  }
+
   color_blend_state_.attachmentCount =
       static_cast<uint32_t>(attachments_.size());
   color_blend_state_.pAttachments = attachments_.data();
 
+  PipelineCreationStats* stats = application_->pipeline_creation_stats();
+  PipelineCreationStats::Feedback feedback(
+      application_->GetAllocator(), pipeline_extensions_,
+      static_cast<uint32_t>(stages_.size()));
+  ShaderStatistics* shader_statistics = application_->shader_statistics();
+
   VkGraphicsPipelineCreateInfo create_info{
       VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,  // sType
-      pipeline_extensions_,                             // pNext
-      flags_,                                           // flags
+      stats ? feedback.next() : pipeline_extensions_,   // pNext
+      flags_ | (shader_statistics ? shader_statistics->create_flags()
+                                  : 0),  // flags
       static_cast<uint32_t>(stages_.size()),            // stageCount
       stages_.data(),                                   // pStage
       &vertex_input_state_,                             // pVertexInputState
@@ -1738,15 +4325,168 @@ void VulkanGraphicsPipeline::Commit() {
       layout_,                                          // layout
       render_pass_,                                     // renderPass
       subpass_,                                         // subpass
-      VK_NULL_HANDLE,                                   // basePipelineHandle
-      0                                                 // basePipelineIndex
+      base_pipeline_,                                   // basePipelineHandle
+      -1                                               // basePipelineIndex
   };
-  ::VkPipeline pipeline;
-  LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
-             application_->device()->vkCreateGraphicsPipelines(
-                 application_->device(), application_->pipeline_cache(), 1,
-                 &create_info, nullptr, &pipeline));
-  pipeline_.initialize(pipeline);
+  bool created = false;
+  auto create = [this, &create_info, &created]() {
+    STARTUP_PHASE("CreatePipeline");
+    ::VkPipeline pipeline;
+    LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
+               application_->device()->vkCreateGraphicsPipelines(
+                   application_->device(),
+                   application_->thread_pipeline_cache(), 1, &create_info,
+                   nullptr, &pipeline));
+    created = true;
+    return pipeline;
+  };
+  // Extension structures can not be compared, so pipelines with any are
+  // never shared.
+  if (pipeline_extensions_ || rasterization_state_.pNext) {
+    pipeline_ = application_->pipeline_object_cache().CreateUncached(create);
+  } else {
+    containers::vector<uint8_t> key(application_->GetAllocator());
+    SerializeState(&key);
+    pipeline_ = application_->pipeline_object_cache().Get(key, create);
+  }
+  if (stats && created) {
+    feedback.Record(stats, "graphics", stages_.data(),
+                    static_cast<uint32_t>(stages_.size()));
+  }
+  if (shader_statistics && created) {
+    shader_statistics->Record("graphics", pipeline_, stages_.data(),
+                              static_cast<uint32_t>(stages_.size()));
+  }
+  PipelineCorpus* corpus = application_->pipeline_corpus();
+  if (corpus && created && !pipeline_extensions_ &&
+      !rasterization_state_.pNext) {
+    corpus->RecordGraphicsPipeline(create_info, shader_modules_.data());
+  }
+}
+
+namespace {
+// Appends values to the key of a PipelineObjectCache. Only types without
+// padding may be added, since padding bytes are not initialized.
+class PipelineKeyWriter {
+ public:
+  explicit PipelineKeyWriter(containers::vector<uint8_t>* key) : key_(key) {}
+
+  template <typename T>
+  void Add(const T& value) {
+    AddBytes(&value, sizeof(T));
+  }
+
+  // Adds |count| followed by the values, so that arrays of different
+  // lengths never look the same.
+  template <typename T>
+  void AddArray(const T* values, size_t count) {
+    Add(static_cast<uint64_t>(count));
+    if (count) {
+      AddBytes(values, sizeof(T) * count);
+    }
+  }
+
+  void AddString(const char* string) { AddArray(string, strlen(string)); }
+
+ private:
+  void AddBytes(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    key_->insert(key_->end(), bytes, bytes + size);
+  }
+
+  containers::vector<uint8_t>* key_;
+};
+}  // anonymous namespace
+
+void VulkanGraphicsPipeline::SerializeState(
+    containers::vector<uint8_t>* key) const {
+  PipelineKeyWriter writer(key);
+  writer.Add(flags_);
+  writer.Add(base_pipeline_);
+
+  writer.Add(static_cast<uint64_t>(stages_.size()));
+  for (const auto& stage : stages_) {
+    writer.Add(stage.flags);
+    writer.Add(stage.stage);
+    writer.Add(stage.module);
+    writer.AddString(stage.pName);
+    const VkSpecializationInfo* specialization = stage.pSpecializationInfo;
+    if (specialization) {
+      writer.AddArray(specialization->pMapEntries,
+                      specialization->mapEntryCount);
+      writer.AddArray(static_cast<const uint8_t*>(specialization->pData),
+                      specialization->dataSize);
+    } else {
+      writer.AddArray(static_cast<const uint8_t*>(nullptr), 0);
+    }
+  }
+
+  writer.AddArray(vertex_binding_descriptions_.data(),
+                  vertex_binding_descriptions_.size());
+  writer.AddArray(vertex_attribute_descriptions_.data(),
+                  vertex_attribute_descriptions_.size());
+
+  writer.Add(input_assembly_state_.topology);
+  writer.Add(input_assembly_state_.primitiveRestartEnable);
+  if ((contained_stages_ & VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT) ||
+      (contained_stages_ & VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT)) {
+    writer.Add(tessellation_state_.patchControlPoints);
+  }
+
+  const auto is_dynamic = [this](VkDynamicState state) {
+    return std::find(dynamic_states_.begin(), dynamic_states_.end(), state) !=
+           dynamic_states_.end();
+  };
+  writer.Add(viewport_state_.viewportCount);
+  writer.Add(viewport_state_.scissorCount);
+  if (!is_dynamic(VK_DYNAMIC_STATE_VIEWPORT) && viewport_state_.pViewports) {
+    writer.AddArray(viewport_state_.pViewports,
+                    viewport_state_.viewportCount);
+  }
+  if (!is_dynamic(VK_DYNAMIC_STATE_SCISSOR) && viewport_state_.pScissors) {
+    writer.AddArray(viewport_state_.pScissors, viewport_state_.scissorCount);
+  }
+
+  writer.Add(rasterization_state_.depthClampEnable);
+  writer.Add(rasterization_state_.rasterizerDiscardEnable);
+  writer.Add(rasterization_state_.polygonMode);
+  writer.Add(rasterization_state_.cullMode);
+  writer.Add(rasterization_state_.frontFace);
+  writer.Add(rasterization_state_.depthBiasEnable);
+  writer.Add(rasterization_state_.depthBiasConstantFactor);
+  writer.Add(rasterization_state_.depthBiasClamp);
+  writer.Add(rasterization_state_.depthBiasSlopeFactor);
+  writer.Add(rasterization_state_.lineWidth);
+
+  writer.Add(multisample_state_.rasterizationSamples);
+  writer.Add(multisample_state_.sampleShadingEnable);
+  writer.Add(multisample_state_.minSampleShading);
+  writer.Add(multisample_state_.alphaToCoverageEnable);
+  writer.Add(multisample_state_.alphaToOneEnable);
+  if (multisample_state_.pSampleMask) {
+    writer.AddArray(multisample_state_.pSampleMask,
+                    (multisample_state_.rasterizationSamples + 31) / 32);
+  }
+
+  writer.Add(depth_stencil_state_.depthTestEnable);
+  writer.Add(depth_stencil_state_.depthWriteEnable);
+  writer.Add(depth_stencil_state_.depthCompareOp);
+  writer.Add(depth_stencil_state_.depthBoundsTestEnable);
+  writer.Add(depth_stencil_state_.stencilTestEnable);
+  writer.Add(depth_stencil_state_.front);
+  writer.Add(depth_stencil_state_.back);
+  writer.Add(depth_stencil_state_.minDepthBounds);
+  writer.Add(depth_stencil_state_.maxDepthBounds);
+
+  writer.Add(color_blend_state_.logicOpEnable);
+  writer.Add(color_blend_state_.logicOp);
+  writer.AddArray(attachments_.data(), attachments_.size());
+  writer.Add(color_blend_state_.blendConstants);
+
+  writer.AddArray(dynamic_states_.data(), dynamic_states_.size());
+  writer.Add(layout_);
+  writer.Add(render_pass_);
+  writer.Add(subpass_);
 }
 
 VulkanComputePipeline::VulkanComputePipeline(
@@ -1756,14 +4496,59 @@ VulkanComputePipeline::VulkanComputePipeline(
     const char* shader_entry, const VkSpecializationInfo* specialization_info)
     : application_(application),
       pipeline_(VK_NULL_HANDLE, nullptr, &application->device()),
-      shader_module_(VK_NULL_HANDLE, nullptr, &application->device()),
-      layout_(*layout) {
-  ::VkShaderModule raw_module;
-  LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
-             application_->device()->vkCreateShaderModule(
-                 application_->device(), &shader_module_create_info, nullptr,
-                 &raw_module));
-  shader_module_.initialize(raw_module);
+      layout_(*layout),
+      specialization_constants_(allocator) {
+  Create(shader_module_create_info, shader_entry, specialization_info);
+}
+
+VulkanComputePipeline::VulkanComputePipeline(
+    containers::Allocator* allocator, PipelineLayout* layout,
+    VulkanApplication* application, PipelineCompiler* compiler,
+    const VkShaderModuleCreateInfo& shader_module_create_info,
+    const char* shader_entry, const VkSpecializationInfo* specialization_info)
+    : application_(application),
+      pipeline_(VK_NULL_HANDLE, nullptr, &application->device()),
+      layout_(*layout),
+      specialization_constants_(allocator) {
+  // The create info itself is often a temporary.
+  const VkShaderModuleCreateInfo create_info = shader_module_create_info;
+  compile_handle_ = compiler->Submit(
+      [this, create_info, shader_entry, specialization_info]() {
+        Create(create_info, shader_entry, specialization_info);
+      });
+}
+
+VulkanComputePipeline::VulkanComputePipeline(
+    containers::Allocator* allocator, PipelineLayout* layout,
+    VulkanApplication* application, PipelineCompiler* compiler,
+    const VkShaderModuleCreateInfo& shader_module_create_info,
+    const char* shader_entry, const SpecializationConstants& constants)
+    : application_(application),
+      pipeline_(VK_NULL_HANDLE, nullptr, &application->device()),
+      layout_(*layout),
+      specialization_constants_(constants) {
+  if (!compiler) {
+    Create(shader_module_create_info, shader_entry,
+           specialization_constants_.info());
+    return;
+  }
+  const VkShaderModuleCreateInfo create_info = shader_module_create_info;
+  compile_handle_ = compiler->Submit([this, create_info, shader_entry]() {
+    Create(create_info, shader_entry, specialization_constants_.info());
+  });
+}
+
+void VulkanComputePipeline::Create(
+    const VkShaderModuleCreateInfo& shader_module_create_info,
+    const char* shader_entry, const VkSpecializationInfo* specialization_info) {
+  // Modules are shared through the cache, so they can not be created with
+  // extensions.
+  LOG_ASSERT(==, application_->GetLogger(),
+             static_cast<const void*>(nullptr),
+             shader_module_create_info.pNext);
+  shader_module_ = application_->shader_module_cache().Get(
+      shader_module_create_info.pCode,
+      shader_module_create_info.codeSize / sizeof(uint32_t));
   VkPipelineShaderStageCreateInfo shader_stage_create_info{
       VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
       nullptr,                                              // pNext
@@ -1774,22 +4559,48 @@ VulkanComputePipeline::VulkanComputePipeline(
       specialization_info  // pSpecializationInfo
   };
 
+  PipelineCreationStats* stats = application_->pipeline_creation_stats();
+  PipelineCreationStats::Feedback feedback(application_->GetAllocator(),
+                                           nullptr, 1);
+  ShaderStatistics* shader_statistics = application_->shader_statistics();
+
   VkComputePipelineCreateInfo pipeline_create_info{
       VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,  // sType
-      nullptr,                                         // pNext
-      0,                                               // flags
+      stats ? feedback.next() : nullptr,               // pNext
+      shader_statistics ? shader_statistics->create_flags() : 0,  // flags
       shader_stage_create_info,                        // stage
       layout_,                                         // layout
       VK_NULL_HANDLE,                                  // basePipelineHandle
       0,                                               // basePipelineIndex
   };
 
+  STARTUP_PHASE("CreatePipeline");
   ::VkPipeline pipeline;
   LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
              application_->device()->vkCreateComputePipelines(
-                 application_->device(), application_->pipeline_cache(), 1,
+                 application_->device(),
+                 application_->thread_pipeline_cache(), 1,
                  &pipeline_create_info, nullptr, &pipeline));
   pipeline_.initialize(pipeline);
+  if (stats) {
+    feedback.Record(stats, "compute", &shader_stage_create_info, 1);
+  }
+  if (shader_statistics) {
+    shader_statistics->Record("compute", pipeline, &shader_stage_create_info,
+                              1);
+  }
+  if (PipelineCorpus* corpus = application_->pipeline_corpus()) {
+    corpus->RecordComputePipeline(pipeline_create_info, shader_module_);
+  }
+}
+
+VulkanApplication::Image::~Image() {
+  if (residency_manager_) {
+    residency_manager_->StopManagingResidency(this);
+  }
+  if (token_) {
+    heap_->FreeMemory(token_);
+  }
 }
 
 ::VkDeviceSize VulkanApplication::Image::size() const {
@@ -1803,4 +4614,328 @@ VulkanComputePipeline::VulkanComputePipeline(
   }
   return r;
 }
+
+VulkanApplication::StreamingSparseImage::StreamingSparseImage(
+    VulkanApplication* application, VkImage&& image, VkFormat format,
+    const VkImageCreateInfo& create_info, ::VkDeviceSize memory_budget,
+    uint32_t retire_delay)
+    : ImageCore(std::move(image), format),
+      application_(application),
+      extent_(create_info.extent),
+      num_paged_levels_(create_info.mipLevels),
+      page_extent_{1, 1, 1},
+      page_size_(0),
+      max_resident_pages_(0),
+      num_resident_pages_(0),
+      retire_delay_(retire_delay),
+      update_(1),
+      level_first_page_(application->allocator_),
+      tokens_(application->allocator_),
+      last_requested_(application->allocator_),
+      retired_(application->allocator_),
+      mip_tail_tokens_(application->allocator_) {
+  containers::Allocator* allocator = application_->allocator_;
+  logging::Logger* log = application_->log_;
+  VkDevice& device = application_->device_;
+  VulkanArena* heap = application_->device_only_image_heap_.get();
+  const ::VkImage raw_image = *this;
+
+  VkMemoryRequirements requirements;
+  device->vkGetImageMemoryRequirements(device, raw_image, &requirements);
+  page_size_ = requirements.alignment;
+  max_resident_pages_ = static_cast<size_t>(memory_budget / page_size_);
+
+  uint32_t num_requirements = 0;
+  device->vkGetImageSparseMemoryRequirements(device, raw_image,
+                                             &num_requirements, nullptr);
+  containers::vector<VkSparseImageMemoryRequirements> sparse_requirements(
+      num_requirements, {}, allocator);
+  device->vkGetImageSparseMemoryRequirements(
+      device, raw_image, &num_requirements, sparse_requirements.data());
+
+  // The color aspect is split into pages. Its mip tail, and all of the
+  // metadata, are bound for the whole lifetime of the image.
+  containers::vector<VkSparseMemoryBind> binds(allocator);
+  bool found_color = false;
+  for (const auto& sparse_requirement : sparse_requirements) {
+    const VkSparseImageFormatProperties& properties =
+        sparse_requirement.formatProperties;
+    const bool metadata =
+        (properties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) != 0;
+    if (properties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) {
+      found_color = true;
+      page_extent_ = properties.imageGranularity;
+      if (sparse_requirement.imageMipTailFirstLod < num_paged_levels_) {
+        num_paged_levels_ = sparse_requirement.imageMipTailFirstLod;
+      }
+    }
+    if (!metadata &&
+        sparse_requirement.imageMipTailFirstLod >= create_info.mipLevels) {
+      continue;
+    }
+    const uint32_t num_tails =
+        (properties.flags & VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT)
+            ? 1
+            : create_info.arrayLayers;
+    for (uint32_t i = 0; i < num_tails; ++i) {
+      ::VkDeviceMemory memory;
+      ::VkDeviceSize offset;
+      mip_tail_tokens_.push_back(heap->AllocateMemory(
+          sparse_requirement.imageMipTailSize, requirements.alignment, &memory,
+          &offset, nullptr));
+      binds.push_back({
+          sparse_requirement.imageMipTailOffset +
+              i * sparse_requirement.imageMipTailStride,  // resourceOffset
+          sparse_requirement.imageMipTailSize,            // size
+          memory,                                         // memory
+          offset,                                         // memoryOffset
+          metadata ? static_cast<VkSparseMemoryBindFlags>(
+                         VK_SPARSE_MEMORY_BIND_METADATA_BIT)
+                   : 0u  // flags
+      });
+    }
+  }
+  LOG_ASSERT(==, log, true, found_color);
+
+  size_t num_pages = 0;
+  for (uint32_t level = 0; level < num_paged_levels_; ++level) {
+    level_first_page_.push_back(num_pages);
+    VkExtent3D pages = LevelPages(level);
+    num_pages += size_t(pages.width) * pages.height * pages.depth;
+  }
+  level_first_page_.push_back(num_pages);
+  tokens_.resize(num_pages, nullptr);
+  last_requested_.resize(num_pages, 0);
+
+  if (binds.empty()) {
+    return;
+  }
+  VkSparseImageOpaqueMemoryBindInfo opaque_img_bind_info{
+      raw_image, uint32_t(binds.size()), binds.data()};
+  VkBindSparseInfo bind_info{
+      VK_STRUCTURE_TYPE_BIND_SPARSE_INFO,  // sType
+      nullptr,                             // pNext
+      0u,                                  // waitSemaphoreCount
+      nullptr,                             // pWaitSemaphores
+      0u,                                  // bufferBindCount
+      nullptr,                             // pBufferBinds
+      1,                                   // imageOpaqueBindCount
+      &opaque_img_bind_info,               // pImageOpaqueBinds
+      0u,                                  // imageBindCount
+      nullptr,                             // pImageBinds
+      0u,                                  // signalSemaphoreCount
+      nullptr                              // pSignalSemaphores
+  };
+  VkQueue& queue = application_->sparse_binding_queue();
+  LOG_ASSERT(==, log, VK_SUCCESS,
+             queue->vkQueueBindSparse(queue, 1u, &bind_info,
+                                      ::VkFence(VK_NULL_HANDLE)));
+  queue->vkQueueWaitIdle(queue);
+}
+
+VulkanApplication::StreamingSparseImage::~StreamingSparseImage() {
+  VulkanArena* heap = application_->device_only_image_heap_.get();
+  for (AllocationToken* token : tokens_) {
+    if (token) {
+      heap->FreeMemory(token);
+    }
+  }
+  for (const auto& retired : retired_) {
+    heap->FreeMemory(retired.token);
+  }
+  for (AllocationToken* token : mip_tail_tokens_) {
+    heap->FreeMemory(token);
+  }
+}
+
+::VkDeviceSize VulkanApplication::StreamingSparseImage::size() const {
+  ::VkDeviceSize r = num_resident_pages_ * page_size_;
+  for (const auto& ti : mip_tail_tokens_) {
+    r += ti->allocationSize;
+  }
+  return r;
+}
+
+VkExtent3D VulkanApplication::StreamingSparseImage::LevelPages(
+    uint32_t mip_level) const {
+  uint32_t width = extent_.width >> mip_level;
+  uint32_t height = extent_.height >> mip_level;
+  uint32_t depth = extent_.depth >> mip_level;
+  width = width > 0 ? width : 1;
+  height = height > 0 ? height : 1;
+  depth = depth > 0 ? depth : 1;
+  return {(width + page_extent_.width - 1) / page_extent_.width,
+          (height + page_extent_.height - 1) / page_extent_.height,
+          (depth + page_extent_.depth - 1) / page_extent_.depth};
+}
+
+VkSparseImageMemoryBind VulkanApplication::StreamingSparseImage::PageBind(
+    size_t page, ::VkDeviceMemory memory, ::VkDeviceSize offset) const {
+  uint32_t level = 0;
+  while (page >= level_first_page_[level + 1]) {
+    ++level;
+  }
+  const VkExtent3D pages = LevelPages(level);
+  const uint32_t index = static_cast<uint32_t>(page - level_first_page_[level]);
+  const uint32_t slice_pages = pages.width * pages.height;
+  const uint32_t x = (index % slice_pages % pages.width) * page_extent_.width;
+  const uint32_t y = (index % slice_pages / pages.width) * page_extent_.height;
+  const uint32_t z = (index / slice_pages) * page_extent_.depth;
+  uint32_t width = extent_.width >> level;
+  uint32_t height = extent_.height >> level;
+  uint32_t depth = extent_.depth >> level;
+  width = width > 0 ? width : 1;
+  height = height > 0 ? height : 1;
+  depth = depth > 0 ? depth : 1;
+  // Pages on the right, bottom and back edges only cover the rest of the
+  // level.
+  return {
+      {VK_IMAGE_ASPECT_COLOR_BIT, level, 0},  // subresource
+      {static_cast<int32_t>(x), static_cast<int32_t>(y),
+       static_cast<int32_t>(z)},  // offset
+      {width - x < page_extent_.width ? width - x : page_extent_.width,
+       height - y < page_extent_.height ? height - y : page_extent_.height,
+       depth - z < page_extent_.depth ? depth - z
+                                      : page_extent_.depth},  // extent
+      memory,                                                 // memory
+      offset,                                                 // memoryOffset
+      0                                                       // flags
+  };
+}
+
+bool VulkanApplication::StreamingSparseImage::is_resident(uint32_t mip_level,
+                                                          uint32_t x,
+                                                          uint32_t y,
+                                                          uint32_t z) const {
+  if (mip_level >= num_paged_levels_) {
+    return true;
+  }
+  const VkExtent3D pages = LevelPages(mip_level);
+  return tokens_[level_first_page_[mip_level] +
+                 (z * pages.height + y) * pages.width + x] != nullptr;
+}
+
+void VulkanApplication::StreamingSparseImage::RequestRegion(
+    uint32_t mip_level, VkOffset2D offset, VkExtent2D extent) {
+  RequestVolume(mip_level, {offset.x, offset.y, 0},
+                {extent.width, extent.height, 1});
+}
+
+void VulkanApplication::StreamingSparseImage::RequestVolume(
+    uint32_t mip_level, VkOffset3D offset, VkExtent3D extent) {
+  if (mip_level >= num_paged_levels_) {
+    return;
+  }
+  const VkExtent3D pages = LevelPages(mip_level);
+  const uint32_t left = offset.x > 0 ? uint32_t(offset.x) : 0u;
+  const uint32_t top = offset.y > 0 ? uint32_t(offset.y) : 0u;
+  const uint32_t front = offset.z > 0 ? uint32_t(offset.z) : 0u;
+  const uint32_t right = uint32_t(offset.x + int32_t(extent.width));
+  const uint32_t bottom = uint32_t(offset.y + int32_t(extent.height));
+  const uint32_t back = uint32_t(offset.z + int32_t(extent.depth));
+  const uint32_t first_x = left / page_extent_.width;
+  const uint32_t first_y = top / page_extent_.height;
+  const uint32_t first_z = front / page_extent_.depth;
+  uint32_t end_x = (right + page_extent_.width - 1) / page_extent_.width;
+  uint32_t end_y = (bottom + page_extent_.height - 1) / page_extent_.height;
+  uint32_t end_z = (back + page_extent_.depth - 1) / page_extent_.depth;
+  end_x = end_x < pages.width ? end_x : pages.width;
+  end_y = end_y < pages.height ? end_y : pages.height;
+  end_z = end_z < pages.depth ? end_z : pages.depth;
+  for (uint32_t z = first_z; z < end_z; ++z) {
+    for (uint32_t y = first_y; y < end_y; ++y) {
+      for (uint32_t x = first_x; x < end_x; ++x) {
+        last_requested_[level_first_page_[mip_level] +
+                        (z * pages.height + y) * pages.width + x] = update_;
+      }
+    }
+  }
+}
+
+void VulkanApplication::StreamingSparseImage::UpdateResidency(
+    ::VkSemaphore signal_semaphore,
+    containers::vector<VkSparseImageMemoryBind>* bound_pages) {
+  containers::Allocator* allocator = application_->allocator_;
+  VulkanArena* heap = application_->device_only_image_heap_.get();
+
+  // The memory of pages that were unbound long enough ago can be reused.
+  size_t num_retired = 0;
+  for (const auto& retired : retired_) {
+    if (retired.update + retire_delay_ <= update_) {
+      heap->FreeMemory(retired.token);
+    } else {
+      retired_[num_retired++] = retired;
+    }
+  }
+  retired_.resize(num_retired);
+
+  containers::vector<size_t> wanted(allocator);
+  containers::vector<size_t> evictable(allocator);
+  for (size_t page = 0; page < tokens_.size(); ++page) {
+    const bool requested = last_requested_[page] == update_;
+    if (requested && tokens_[page] == nullptr) {
+      wanted.push_back(page);
+    } else if (!requested && tokens_[page] != nullptr) {
+      evictable.push_back(page);
+    }
+  }
+  std::sort(evictable.begin(), evictable.end(), [this](size_t a, size_t b) {
+    return last_requested_[a] < last_requested_[b];
+  });
+  size_t num_evicted = 0;
+  while (num_resident_pages_ - num_evicted + wanted.size() >
+             max_resident_pages_ &&
+         num_evicted < evictable.size()) {
+    ++num_evicted;
+  }
+  if (num_resident_pages_ - num_evicted + wanted.size() >
+      max_resident_pages_) {
+    wanted.resize(max_resident_pages_ - (num_resident_pages_ - num_evicted));
+  }
+
+  containers::vector<VkSparseImageMemoryBind> binds(allocator);
+  for (size_t i = 0; i < num_evicted; ++i) {
+    const size_t page = evictable[i];
+    binds.push_back(PageBind(page, VK_NULL_HANDLE, 0));
+    retired_.push_back({tokens_[page], update_});
+    tokens_[page] = nullptr;
+  }
+  for (size_t page : wanted) {
+    ::VkDeviceMemory memory;
+    ::VkDeviceSize offset;
+    tokens_[page] =
+        heap->AllocateMemory(page_size_, page_size_, &memory, &offset, nullptr);
+    binds.push_back(PageBind(page, memory, offset));
+    bound_pages->push_back(binds.back());
+  }
+  num_resident_pages_ = num_resident_pages_ - num_evicted + wanted.size();
+  ++update_;
+
+  if (binds.empty() && signal_semaphore == VK_NULL_HANDLE) {
+    return;
+  }
+  VkSparseImageMemoryBindInfo image_bind_info{
+      *this, uint32_t(binds.size()), binds.data()};
+  VkBindSparseInfo bind_info{
+      VK_STRUCTURE_TYPE_BIND_SPARSE_INFO,            // sType
+      nullptr,                                       // pNext
+      0u,                                            // waitSemaphoreCount
+      nullptr,                                       // pWaitSemaphores
+      0u,                                            // bufferBindCount
+      nullptr,                                       // pBufferBinds
+      0u,                                            // imageOpaqueBindCount
+      nullptr,                                       // pImageOpaqueBinds
+      binds.empty() ? 0u : 1u,                       // imageBindCount
+      &image_bind_info,                              // pImageBinds
+      signal_semaphore == VK_NULL_HANDLE ? 0u : 1u,  // signalSemaphoreCount
+      &signal_semaphore                              // pSignalSemaphores
+  };
+  VkQueue& queue = application_->sparse_binding_queue();
+  LOG_ASSERT(==, application_->log_, VK_SUCCESS,
+             queue->vkQueueBindSparse(queue, 1u, &bind_info,
+                                      ::VkFence(VK_NULL_HANDLE)));
+  if (signal_semaphore == VK_NULL_HANDLE) {
+    queue->vkQueueWaitIdle(queue);
+  }
+}
 }  // namespace vulkan
@@ -17,14 +17,36 @@
 #define VULKAN_HELPERS_VULKAN_APPLICATION
 
 #include <algorithm>
+#include <functional>
+#include <mutex>
 
 #include "support/containers/allocator.h"
 #include "support/containers/ordered_multimap.h"
+#include "support/containers/pool_allocator.h"
 #include "support/containers/unordered_map.h"
 #include "support/containers/vector.h"
 #include "support/entry/entry.h"
+#include "support/jobs/job_system.h"
 #include "support/log/log.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/bindless_table.h"
+#include "vulkan_helpers/command_buffer_allocator.h"
+#include "vulkan_helpers/debug_labels.h"
+#include "vulkan_helpers/deferred_deletion_queue.h"
+#include "vulkan_helpers/descriptor_allocator.h"
+#include "vulkan_helpers/descriptor_writer.h"
+#include "vulkan_helpers/framebuffer_cache.h"
+#include "vulkan_helpers/host_allocation_callbacks.h"
+#include "vulkan_helpers/host_copy.h"
+#include "vulkan_helpers/pipeline_compiler.h"
+#include "vulkan_helpers/pipeline_corpus.h"
+#include "vulkan_helpers/pipeline_creation_stats.h"
+#include "vulkan_helpers/pipeline_object_cache.h"
+#include "vulkan_helpers/render_pass_cache.h"
+#include "vulkan_helpers/sampler_cache.h"
+#include "vulkan_helpers/shader_module_cache.h"
+#include "vulkan_helpers/shader_statistics.h"
+#include "vulkan_helpers/specialization_constants.h"
 #include "vulkan_wrapper/command_buffer_wrapper.h"
 #include "vulkan_wrapper/device_wrapper.h"
 #include "vulkan_wrapper/instance_wrapper.h"
@@ -35,17 +57,68 @@
 namespace vulkan {
 struct VulkanModel;
 struct AllocationToken;
+struct ArenaBlock;
+
+// The algorithm that a VulkanArena uses to keep track of its free memory.
+enum class ArenaStrategy {
+  // Free ranges are kept in a map ordered by size. Allocating and freeing
+  // memory are O(log n) in the number of free ranges.
+  kOrderedFreeList,
+  // Two-level segregated fit. Free ranges are kept in size-class buckets that
+  // are found with bitmap lookups. Allocating and freeing memory are O(1).
+  kTLSF,
+};
+
+// A snapshot of how much of a VulkanArena is used, and how fragmented it is.
+struct ArenaStats {
+  // The number of bytes of device memory held in the blocks of the arena.
+  ::VkDeviceSize total_bytes;
+  // The number of bytes of the blocks that are allocated, including padding.
+  ::VkDeviceSize used_bytes;
+  ::VkDeviceSize free_bytes;
+  // The size of the largest contiguous range of free memory, and the number
+  // of free ranges.
+  ::VkDeviceSize largest_free_block;
+  uint64_t num_free_blocks;
+  // The number of used bytes that were only skipped to satisfy alignment.
+  ::VkDeviceSize padding_bytes;
+  // The number of bytes in dedicated allocations, which are not part of
+  // total_bytes.
+  ::VkDeviceSize dedicated_bytes;
+  // The largest that used_bytes + dedicated_bytes has ever been.
+  ::VkDeviceSize high_water_mark;
+  // The number of allocations and frees since the arena was created.
+  uint64_t num_allocations;
+  uint64_t num_frees;
+  uint64_t num_blocks;
+  // The number of AllocationTokens that the arena has taken from the host.
+  // This only grows while more ranges are live at once than ever before.
+  uint64_t num_pooled_tokens;
+};
 
 // This class represents a location in GPU memory for storing data.
 // You can suballocate memory from this region, and return memory to the
 // arena for future use.
+// The arena starts out with a single block of device memory of the size
+// it was created with. If an allocation does not fit in any existing block,
+// another block is allocated and chained onto the arena. Trailing blocks that
+// no longer contain any allocations are returned to the device.
+// All of the public methods of VulkanArena may be called concurrently from
+// multiple threads.
 class VulkanArena {
  public:
   // If map==true then the memory for this Arena is mapped to a host-visible
-  // address.
+  // address. |strategy| selects how free memory is tracked. If
+  // |block_buffer_usage| is not 0, every block of memory also gets a buffer
+  // with that usage that spans the whole block, see block_buffer(). If
+  // |device_address| is true, the memory is allocated so that buffers bound
+  // to it have device addresses, which needs VK_KHR_buffer_device_address.
   VulkanArena(containers::Allocator* allocator, logging::Logger* log,
               ::VkDeviceSize buffer_size, uint32_t memory_type_index,
-              VkDevice* device, bool map, uint32_t device_mask = 0);
+              VkDevice* device, bool map, uint32_t device_mask = 0,
+              ArenaStrategy strategy = ArenaStrategy::kOrderedFreeList,
+              VkBufferUsageFlags block_buffer_usage = 0,
+              bool device_address = false);
   ~VulkanArena();
 
   // Returns an AllocationToken for the memory of a given size and alignment.
@@ -56,18 +129,190 @@ class VulkanArena {
   AllocationToken* AllocateMemory(::VkDeviceSize size, ::VkDeviceSize alignment,
                                   ::VkDeviceMemory* memory,
                                   ::VkDeviceSize* offset, char** base_address);
+  // Like AllocateMemory, but returns nullptr instead of failing if the
+  // arena cannot grow to fit the allocation.
+  AllocationToken* TryAllocateMemory(::VkDeviceSize size,
+                                     ::VkDeviceSize alignment,
+                                     ::VkDeviceMemory* memory,
+                                     ::VkDeviceSize* offset,
+                                     char** base_address);
+
+  // Like AllocateMemory, but only succeeds if the memory can be found at a
+  // lower address than |limit|, which must have been allocated from this
+  // arena. Blocks count as lower than the blocks that were added after them.
+  // Never grows the arena, and returns nullptr if there is no such memory.
+  AllocationToken* AllocateMemoryBefore(const AllocationToken* limit,
+                                        ::VkDeviceSize size,
+                                        ::VkDeviceSize alignment,
+                                        ::VkDeviceMemory* memory,
+                                        ::VkDeviceSize* offset,
+                                        char** base_address);
+
+  // Allocates a ::VkDeviceMemory of its own for exactly one of |image| or
+  // |buffer|, through VK_KHR_dedicated_allocation, instead of suballocating
+  // it from a block. The memory has this arena's type and mapping, and
+  // is returned to the device when the token is freed.
+  AllocationToken* AllocateDedicatedMemory(::VkDeviceSize size, ::VkImage image,
+                                           ::VkBuffer buffer,
+                                           ::VkDeviceMemory* memory,
+                                           ::VkDeviceSize* offset,
+                                           char** base_address);
 
   // Frees the memory pointed to by the AllocationToken.
   void FreeMemory(AllocationToken* token);
 
+  // Returns the number of allocations that have been suballocated from the
+  // blocks of this arena.
+  uint64_t num_suballocations() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_suballocations_;
+  }
+  // Returns the number of allocations that have been given their own
+  // ::VkDeviceMemory with AllocateDedicatedMemory.
+  uint64_t num_dedicated_allocations() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_dedicated_allocations_;
+  }
+
+  // Returns the size of the largest contiguous range of free memory.
+  ::VkDeviceSize LargestFreeRange() const;
+
+  // Returns the current usage and fragmentation of this arena.
+  ArenaStats GetStats() const;
+
+  // Returns the number of blocks of device memory currently held by this
+  // arena.
+  size_t num_blocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blocks_.size();
+  }
+
+  // Returns the total number of bytes of device memory currently held by
+  // this arena.
+  ::VkDeviceSize total_size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_size_;
+  }
+
+  // Returns the index of the memory heap that this arena allocates from.
+  uint32_t heap_index() const { return heap_index_; }
+  // Returns the index of the memory type that this arena allocates from.
+  uint32_t memory_type_index() const { return memory_type_index_; }
+
+  // Returns the buffer that spans the block that |token| was allocated from.
+  // The offset of the allocation in that buffer is the same as its offset in
+  // the memory. Returns VK_NULL_HANDLE if this arena was not created with a
+  // |block_buffer_usage|, or if |token| is a dedicated allocation.
+  ::VkBuffer block_buffer(const AllocationToken* token) const;
+
+  // Limits the total number of bytes that this arena may grow to. Blocks
+  // that are already allocated are never given back because of this. A
+  // limit of 0 means that the arena may grow until the device runs out of
+  // memory.
+  void set_growth_limit(::VkDeviceSize limit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    growth_limit_ = limit;
+  }
+
+  // Names every ::VkDeviceMemory of this arena |name| with
+  // VK_EXT_debug_utils, including the ones it allocates later. |name| must
+  // outlive the arena. Only if the instance was created with the extension.
+  void set_debug_name(const char* name);
+
  private:
+  // Allocates a new block of device memory that can hold at least
+  // |minimum_size| bytes, and makes all of it available for allocation.
+  ArenaBlock* AddBlock(::VkDeviceSize minimum_size);
+  // Returns the memory of the trailing blocks that no longer contain any
+  // allocations to the device, except for the first of them, which is kept
+  // as a spare. The first block is always kept.
+  void ReleaseEmptyTrailingBlocks();
+
+  // Raises |size| and |alignment| to what this arena requires for every
+  // allocation.
+  void ApplyMemoryRequirements(::VkDeviceSize* size,
+                               ::VkDeviceSize* alignment) const;
+  // Carves an allocation of |size| bytes at |alignment| out of the free
+  // |token|, which must be large enough to hold it.
+  AllocationToken* AllocateFromFreeToken(AllocationToken* token,
+                                         ::VkDeviceSize size,
+                                         ::VkDeviceSize alignment,
+                                         ::VkDeviceMemory* memory,
+                                         ::VkDeviceSize* offset,
+                                         char** base_address);
+
+  // Makes the given unused token available for allocation.
+  void InsertFreeToken(AllocationToken* token);
+  // Removes the given unused token from the set of available tokens.
+  void RemoveFreeToken(AllocationToken* token);
+  // Returns an available token that holds at least |size| bytes, or nullptr
+  // if there is none. The token is not removed from the set of available
+  // tokens.
+  AllocationToken* FindFreeToken(::VkDeviceSize size);
+
+  // Returns a copy of |value| from the pool of tokens, growing the pool if
+  // it is empty.
+  AllocationToken* NewToken(const AllocationToken& value);
+  // Returns |token| to the pool of tokens.
+  void DeleteToken(AllocationToken* token);
+
+  // Each power-of-two size class is split into 2^kTLSFSecondLevelLog2
+  // linearly spaced buckets.
+  static const uint32_t kTLSFSecondLevelLog2 = 4;
+  static const uint32_t kTLSFSecondLevelCount = 1 << kTLSFSecondLevelLog2;
+  static const uint32_t kTLSFFirstLevelCount = 64;
+  // Returns the first and second level bucket index that a free token of
+  // |size| bytes lives in.
+  static void TLSFMapping(::VkDeviceSize size, uint32_t* first_level,
+                          uint32_t* second_level);
+
+  // Guards everything below. Only the public methods take it, the private
+  // ones expect it to already be held.
+  mutable std::mutex mutex_;
   containers::Allocator* allocator_;
+  ArenaStrategy strategy_;
+  // Only used with ArenaStrategy::kOrderedFreeList.
   containers::ordered_multimap<::VkDeviceSize, AllocationToken*> freeblocks_;
-  AllocationToken* first_block_;
-  char* base_address_;
+  // Only used with ArenaStrategy::kTLSF.
+  // Bit i is set if tlsf_second_level_bitmap_[i] is non-zero.
+  uint64_t tlsf_first_level_bitmap_;
+  // Bit j of tlsf_second_level_bitmap_[i] is set if tlsf_free_lists_[i][j]
+  // is non-empty.
+  uint32_t tlsf_second_level_bitmap_[kTLSFFirstLevelCount];
+  // Doubly linked lists of the free tokens in each bucket.
+  AllocationToken* tlsf_free_lists_[kTLSFFirstLevelCount]
+                                   [kTLSFSecondLevelCount];
+  containers::vector<ArenaBlock*> blocks_;
+  // Every slab of kTokensPerSlab tokens that has been allocated, and the
+  // tokens in them that are not in use, linked through next.
+  containers::vector<AllocationToken*> token_slabs_;
+  AllocationToken* free_tokens_;
   ::VkDevice device_;
-  LazyDeviceFunction<PFN_vkUnmapMemory>* unmap_memory_function_;
-  VkDeviceMemory memory_;
+  // We only keep a reference to the device functions, and not to the
+  // vulkan::VkDevice since vulkan::VkDevice is movable.
+  DeviceFunctions* device_functions_;
+  uint32_t memory_type_index_;
+  bool map_;
+  // The device mask and flags of every allocation, only used if
+  // device_mask_info_.flags != 0.
+  VkMemoryAllocateFlagsInfo device_mask_info_;
+  // The preferred size of any new block of memory.
+  ::VkDeviceSize block_size_;
+  ::VkDeviceSize total_size_;
+  ::VkDeviceSize growth_limit_;
+  uint32_t heap_index_;
+  VkBufferUsageFlags block_buffer_usage_;
+  uint64_t num_suballocations_;
+  uint64_t num_dedicated_allocations_;
+  // The number of dedicated allocations that have not been freed yet.
+  uint64_t live_dedicated_allocations_;
+  uint64_t num_frees_;
+  ::VkDeviceSize used_bytes_;
+  ::VkDeviceSize padding_bytes_;
+  ::VkDeviceSize dedicated_bytes_;
+  ::VkDeviceSize high_water_mark_;
+  // nullptr unless set_debug_name() was called.
+  const char* debug_name_;
   logging::Logger* log_;
 };
 
@@ -97,28 +342,33 @@ class VulkanGraphicsPipeline {
 
   VulkanGraphicsPipeline(containers::Allocator* allocator,
                          PipelineLayout* layout, VulkanApplication* application,
-                         VkRenderPass* render_pass, uint32_t subpass);
+                         ::VkRenderPass render_pass, uint32_t subpass);
   VulkanGraphicsPipeline(containers::Allocator* allocator)
       : stages_(allocator),
         dynamic_states_(allocator),
         vertex_binding_descriptions_(allocator),
         vertex_attribute_descriptions_(allocator),
         shader_modules_(allocator),
+        specializations_(allocator),
         attachments_(allocator),
-        pipeline_(VK_NULL_HANDLE, nullptr, nullptr),
         contained_stages_(0),
-        pipeline_extensions_(nullptr) {}
+        pipeline_extensions_(nullptr),
+        base_pipeline_(VK_NULL_HANDLE) {}
 
   VulkanGraphicsPipeline(VulkanGraphicsPipeline&& other) = default;
 
+  // If |constants| is not nullptr, the stage is specialized with a copy of
+  // it.
   template <int N>
   void AddShader(VkShaderStageFlagBits stage, const char* entry,
-                 uint32_t (&code)[N]) {
-    return AddShader(stage, entry, code, N);
+                 uint32_t (&code)[N],
+                 const SpecializationConstants* constants = nullptr) {
+    return AddShader(stage, entry, code, N, constants);
   }
 
   void AddShader(VkShaderStageFlagBits stage, const char* entry, uint32_t* code,
-                 uint32_t numCodeWords);
+                 uint32_t numCodeWords,
+                 const SpecializationConstants* constants = nullptr);
 
   // patch_size is unused unless there is a tessellation shader.
   void SetTopology(VkPrimitiveTopology topology, uint32_t patch_size = 0);
@@ -172,10 +422,33 @@ class VulkanGraphicsPipeline {
 
 	VkPipelineCreateFlags& flags() { return flags_; }
 
+  // Creates the pipeline. If the pipeline has no extensions, it shares the
+  // ::VkPipeline of any other pipeline of the application that was created
+  // with the same state, render pass and layout.
   void Commit();
+  // Like Commit, but creates the pipeline on a thread of |compiler|. The
+  // pipeline must not be used, moved or changed until Wait() returns, or
+  // the returned handle is waited on.
+  PipelineCompiler::Handle CommitAsync(PipelineCompiler* compiler);
+  // Like Commit, but as the main pass of a depth pre-pass: the pipeline
+  // tests for depth EQUAL to the depth buffer and does not write it, so the
+  // fragment shaders only run for visible fragments. |depth_pre_pass| is
+  // then created as a derivative of it, with the same state and stages but
+  // no fragment shader and no color writes, and the depth test and writes
+  // that this pipeline had. Both are used in the render pass and subpass of
+  // this pipeline, with the same geometry drawn with |depth_pre_pass|
+  // first. The vertex stages should declare gl_Position invariant, so that
+  // both compute the same depth.
+  void CommitWithDepthPrePass(VulkanGraphicsPipeline* depth_pre_pass);
+  // Waits for the pipeline of CommitAsync to be created.
+  void Wait() const { compile_handle_.Wait(); }
   operator ::VkPipeline() const { return pipeline_; }
 
  private:
+  void CreatePipeline();
+  // Appends everything that the pipeline is created from to |key|.
+  void SerializeState(containers::vector<uint8_t>* key) const;
+
   ::VkRenderPass render_pass_;
   uint32_t subpass_;
   VulkanApplication* application_;
@@ -197,12 +470,17 @@ class VulkanGraphicsPipeline {
       vertex_binding_descriptions_;
   containers::vector<VkVertexInputAttributeDescription>
       vertex_attribute_descriptions_;
-  containers::vector<VkShaderModule> shader_modules_;
+  containers::vector<ShaderModuleCache::Handle> shader_modules_;
+  // The specialization constants of each of stages_.
+  containers::vector<SpecializationConstants> specializations_;
   containers::vector<VkPipelineColorBlendAttachmentState> attachments_;
   ::VkPipelineLayout layout_;
-  VkPipeline pipeline_;
+  PipelineObjectCache::Handle pipeline_;
   uint32_t contained_stages_;
   const void* pipeline_extensions_;
+  // The parent of a derivative pipeline, or VK_NULL_HANDLE.
+  ::VkPipeline base_pipeline_;
+  PipelineCompiler::Handle compile_handle_;
 };
 
 // Customizable Compute pipeline state.
@@ -214,15 +492,40 @@ class VulkanComputePipeline {
       const VkShaderModuleCreateInfo& shader_module_create_info,
       const char* shader_entry,
       const VkSpecializationInfo* specialization_info = nullptr);
+  // Creates the shader module and pipeline on a thread of |compiler|. The
+  // code of the shader, |shader_entry| and |specialization_info| have to
+  // stay valid, and the pipeline must not be used or moved, until Wait()
+  // returns.
+  VulkanComputePipeline(
+      containers::Allocator* allocator, PipelineLayout* layout,
+      VulkanApplication* application, PipelineCompiler* compiler,
+      const VkShaderModuleCreateInfo& shader_module_create_info,
+      const char* shader_entry,
+      const VkSpecializationInfo* specialization_info = nullptr);
+  // Creates the pipeline specialized with a copy of |constants|, on a thread
+  // of |compiler| unless it is nullptr.
+  VulkanComputePipeline(
+      containers::Allocator* allocator, PipelineLayout* layout,
+      VulkanApplication* application, PipelineCompiler* compiler,
+      const VkShaderModuleCreateInfo& shader_module_create_info,
+      const char* shader_entry, const SpecializationConstants& constants);
   VulkanComputePipeline(VulkanComputePipeline&& other) = default;
 
+  // Waits for the pipeline to be created, if it is created asynchronously.
+  void Wait() const { compile_handle_.Wait(); }
   operator ::VkPipeline() const { return pipeline_; }
 
  private:
+  void Create(const VkShaderModuleCreateInfo& shader_module_create_info,
+              const char* shader_entry,
+              const VkSpecializationInfo* specialization_info);
+
   VulkanApplication* application_;
   VkPipeline pipeline_;
-  VkShaderModule shader_module_;
+  ShaderModuleCache::Handle shader_module_;
   ::VkPipelineLayout layout_;
+  SpecializationConstants specialization_constants_;
+  PipelineCompiler::Handle compile_handle_;
 };
 
 struct DescriptorSetLayoutBinding {
@@ -245,19 +548,32 @@ class PipelineLayout {
   operator ::VkPipelineLayout() const { return pipeline_layout_; }
 
  private:
+  // If |bindless_layout| is not VK_NULL_HANDLE, it is used for the set after
+  // |layouts|, without being owned by the pipeline layout.
   PipelineLayout(containers::Allocator* allocator, VkDevice* device,
                  std::initializer_list<DescriptorSetLayoutBinding> layouts,
-                 std::initializer_list<VkPushConstantRange> ranges = {})
+                 std::initializer_list<VkPushConstantRange> ranges = {},
+                 ::VkDescriptorSetLayout bindless_layout = VK_NULL_HANDLE)
       : pipeline_layout_(VK_NULL_HANDLE, nullptr, device),
-        descriptor_set_layouts_(allocator) {
+        descriptor_set_layouts_(allocator),
+        descriptor_set_bindings_(allocator),
+        descriptor_set_flags_(allocator) {
     containers::vector<::VkDescriptorSetLayout> raw_layouts(allocator);
     raw_layouts.reserve(layouts.size());
 
     descriptor_set_layouts_.reserve(layouts.size());
+    descriptor_set_bindings_.reserve(layouts.size());
     for (auto binding_list : layouts) {
       descriptor_set_layouts_.emplace_back(
           CreateDescriptorSetLayout(allocator, device, binding_list.bindings_, binding_list.flags_));
       raw_layouts.push_back(descriptor_set_layouts_.back());
+      descriptor_set_bindings_.emplace_back(binding_list.bindings_.begin(),
+                                            binding_list.bindings_.end(),
+                                            allocator);
+      descriptor_set_flags_.push_back(binding_list.flags_);
+    }
+    if (bindless_layout != VK_NULL_HANDLE) {
+      raw_layouts.push_back(bindless_layout);
     }
 
     containers::vector<VkPushConstantRange> push_constant_ranges(
@@ -282,6 +598,10 @@ class PipelineLayout {
   }
   friend class VulkanApplication;
   containers::vector<VkDescriptorSetLayout> descriptor_set_layouts_;
+  // The bindings that every descriptor set layout was created from.
+  containers::vector<containers::vector<VkDescriptorSetLayoutBinding>>
+      descriptor_set_bindings_;
+  containers::vector<VkDescriptorSetLayoutCreateFlags> descriptor_set_flags_;
   VkPipelineLayout pipeline_layout_;
 };
 
@@ -291,28 +611,24 @@ class DescriptorSet {
  public:
   operator ::VkDescriptorSet() const { return set_; }
 
-  const ::VkDescriptorSet& raw_set() const { return set_.get_raw_object(); }
-  ::VkDescriptorPool pool() const { return pool_.get_raw_object(); }
+  const ::VkDescriptorSet& raw_set() const { return set_.raw_set(); }
+  ::VkDescriptorPool pool() const { return set_.pool(); }
   ::VkDescriptorSetLayout layout() const { return layout_.get_raw_object(); }
 
  private:
   friend class VulkanApplication;
 
-  static VkDescriptorPool CreateDescriptorPool(
-      containers::Allocator* allocator, VkDevice* device,
-      std::initializer_list<VkDescriptorSetLayoutBinding> bindings);
-
   // Creates a descriptor set with one descriptor according to the given
-  // |binding|.
+  // |binding|. The set comes from one of the shared pools of
+  // |descriptor_allocator|.
   DescriptorSet(containers::Allocator* allocator, VkDevice* device,
+                DescriptorAllocator* descriptor_allocator,
                 std::initializer_list<VkDescriptorSetLayoutBinding> bindings);
 
-  // Pools is designed to amortize the cost of descriptor set allocation.
-  // But here we create a dedicated pool for each descriptor set. It suffers
-  // for performance, but is easy to write.
-  VkDescriptorPool pool_;
   VkDescriptorSetLayout layout_;
-  VkDescriptorSet set_;
+  DescriptorAllocator::Set set_;
+  // The bindings that layout_ was created from.
+  containers::vector<VkDescriptorSetLayoutBinding> bindings_;
 };
 
 // VulkanApplication holds all of the data needed for a typical single-threaded
@@ -328,6 +644,7 @@ class VulkanApplication {
         : image_(std::move(image)), format_(format) {}
 
    private:
+    friend class ::vulkan::VulkanApplication;
     VkImage image_;
     VkFormat format_;
   };
@@ -338,16 +655,52 @@ class VulkanApplication {
   // it was created.
   class Image : public ImageCore {
    public:
-    ~Image() { heap_->FreeMemory(token_); }
+    ~Image();
     ::VkDeviceSize size() const;
+    // Returns true if VulkanApplication::Defragment can move this image.
+    bool movable() const { return movable_; }
+    // Returns false while the image is evicted to host memory, see
+    // VulkanApplication::ManageImageResidency.
+    bool resident() const { return token_ != nullptr; }
+    // Returns the residency frame that the image was last used in, see
+    // VulkanApplication::MarkImageUsed.
+    uint64_t last_use_frame() const { return last_use_frame_; }
 
    private:
     friend class ::vulkan::VulkanApplication;
+    // If |create_info| is not nullptr, the image can be re-created from it
+    // when it is moved.
     Image(VulkanArena* heap, AllocationToken* token, VkImage&& image,
-          VkFormat format)
-        : ImageCore(std::move(image), format), heap_(heap), token_(token) {}
+          VkFormat format, const VkImageCreateInfo* create_info = nullptr)
+        : ImageCore(std::move(image), format),
+          heap_(heap),
+          token_(token),
+          create_info_(create_info ? *create_info : VkImageCreateInfo{}),
+          movable_(create_info && create_info->pNext == nullptr &&
+                   create_info->sharingMode == VK_SHARING_MODE_EXCLUSIVE &&
+                   (create_info->flags & (VK_IMAGE_CREATE_SPARSE_BINDING_BIT |
+                                          VK_IMAGE_CREATE_DISJOINT_BIT)) ==
+                       0 &&
+                   (create_info->usage & kImageTransferUsage) ==
+                       kImageTransferUsage),
+          residency_manager_(nullptr),
+          resident_layout_(VK_IMAGE_LAYOUT_UNDEFINED),
+          last_use_frame_(0) {}
+    // Images can only be moved if they can be copied from and to.
+    static const VkImageUsageFlags kImageTransferUsage =
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     VulkanArena* heap_;
+    // nullptr while the image is evicted.
     AllocationToken* token_;
+    VkImageCreateInfo create_info_;
+    bool movable_;
+    // Set by ManageImageResidency, and guarded by its residency_mutex_.
+    VulkanApplication* residency_manager_;
+    VkImageLayout resident_layout_;
+    uint64_t last_use_frame_;
+    // The contents of the image while it is evicted, tightly packed one mip
+    // level after the other.
+    containers::unique_ptr<Buffer> evicted_contents_;
   };
 
   // The SparseImage class holds onto a VkImage as well as the memories that
@@ -375,14 +728,105 @@ class VulkanApplication {
     containers::vector<AllocationToken*> tokens_;
   };
 
+  // The StreamingSparseImage class holds onto a sparse resident VkImage.
+  // Only the mip tail is bound when it is created. Pages, one sparse block
+  // of texels each, are bound as they are requested, and the least recently
+  // requested ones are unbound again to keep the image within its memory
+  // budget. Pages that are not resident read as zero if the device has
+  // residencyNonResidentStrict, and as undefined values otherwise. The pages
+  // of 3D images are bricks, which are also laid out in depth.
+  class StreamingSparseImage : public ImageCore {
+   public:
+    ~StreamingSparseImage();
+    // Returns the size of the memory that is currently bound to the image.
+    ::VkDeviceSize size() const;
+    // Returns the number of levels, starting from 0, that are made of
+    // pages. Every level from there on is in the always resident mip tail.
+    uint32_t num_paged_levels() const { return num_paged_levels_; }
+    const VkExtent3D& page_extent() const { return page_extent_; }
+    // Returns true if the page in column |x|, row |y| and slice |z| of
+    // |mip_level| is bound.
+    bool is_resident(uint32_t mip_level, uint32_t x, uint32_t y,
+                     uint32_t z = 0) const;
+
+    // Asks for every page of |mip_level| that overlaps the given region of
+    // texels to be resident after the next call to UpdateResidency.
+    void RequestRegion(uint32_t mip_level, VkOffset2D offset,
+                       VkExtent2D extent);
+    // Like RequestRegion, for the bricks of a 3D image.
+    void RequestVolume(uint32_t mip_level, VkOffset3D offset,
+                       VkExtent3D extent);
+    // Binds every requested page that is not resident yet, and unbinds the
+    // least recently requested pages that were not requested since the last
+    // update, if that is needed to stay within the budget. If there is not
+    // enough budget, some requests stay unbound.
+    // The binds are submitted to the sparse binding queue. If
+    // |signal_semaphore| is not VK_NULL_HANDLE, it is signaled once they
+    // are done, otherwise this waits for the queue to be idle.
+    // Pages that were bound are appended to |bound_pages|, so that their
+    // contents can be uploaded. The contents of new pages are undefined.
+    // The memory of unbound pages is only reused after |retire_delay|
+    // further updates, so that work which is still in flight does not read
+    // the contents of other pages.
+    void UpdateResidency(::VkSemaphore signal_semaphore,
+                         containers::vector<VkSparseImageMemoryBind>*
+                             bound_pages);
+
+   private:
+    friend class ::vulkan::VulkanApplication;
+    StreamingSparseImage(VulkanApplication* application, VkImage&& image,
+                         VkFormat format, const VkImageCreateInfo& create_info,
+                         ::VkDeviceSize memory_budget, uint32_t retire_delay);
+    // Returns the number of pages in each row, column and slice of
+    // |mip_level|.
+    VkExtent3D LevelPages(uint32_t mip_level) const;
+    // Returns the bind of |page| to |memory| at |offset|.
+    VkSparseImageMemoryBind PageBind(size_t page, ::VkDeviceMemory memory,
+                                     ::VkDeviceSize offset) const;
+
+    struct RetiredPage {
+      AllocationToken* token;
+      uint64_t update;
+    };
+
+    VulkanApplication* application_;
+    VkExtent3D extent_;
+    uint32_t num_paged_levels_;
+    VkExtent3D page_extent_;
+    ::VkDeviceSize page_size_;
+    size_t max_resident_pages_;
+    size_t num_resident_pages_;
+    uint32_t retire_delay_;
+    uint64_t update_;
+    // Every level that is made of pages starts at level_first_page_[level].
+    containers::vector<size_t> level_first_page_;
+    // One entry per page. tokens_ is nullptr for pages that are not bound,
+    // last_requested_ holds the update the page was last requested before.
+    containers::vector<AllocationToken*> tokens_;
+    containers::vector<uint64_t> last_requested_;
+    containers::vector<RetiredPage> retired_;
+    containers::vector<AllocationToken*> mip_tail_tokens_;
+  };
+
   // The buffer class holds onto a VkBuffer. If this buffer was created
   // in a host-visible heap, then the host-visible address can be
   // retreved using base_address().
   class Buffer {
    public:
-    operator ::VkBuffer() const { return buffer_; }
+    operator ::VkBuffer() const {
+      return shared_buffer_ != VK_NULL_HANDLE ? shared_buffer_
+                                              : static_cast<::VkBuffer>(buffer_);
+    }
     ~Buffer() { heap_->FreeMemory(token_); }
     ::VkDeviceSize size() const { return size_; }
+    // Returns the offset of this buffer in its ::VkBuffer. This is only
+    // non-zero for buffers that were created with one of the
+    // CreateAndBindShared*Buffer functions, which share a ::VkBuffer with
+    // other buffers. It must be added to every offset that is given to the
+    // device along with the ::VkBuffer.
+    ::VkDeviceSize offset() const { return buffer_offset_; }
+    // Returns true if VulkanApplication::Defragment can move this buffer.
+    bool movable() const { return movable_; }
 
     // Returns the base_address of the host-visible section of memory.
     // Returns nullptr if the host-visible memory is not available.
@@ -426,21 +870,34 @@ class VulkanApplication {
         ::VkDeviceSize offset, ::VkDeviceSize size,
         LazyDeviceFunction<PFN_vkFlushMappedMemoryRanges>* flush_memory_range,
         LazyDeviceFunction<PFN_vkInvalidateMappedMemoryRanges>*
-            invalidate_memory_range)
+            invalidate_memory_range,
+        const VkBufferCreateInfo* create_info = nullptr,
+        ::VkBuffer shared_buffer = VK_NULL_HANDLE)
         : base_address_(base_address),
           heap_(heap),
           token_(token),
           buffer_(std::move(buffer)),
+          shared_buffer_(shared_buffer),
+          buffer_offset_(shared_buffer != VK_NULL_HANDLE ? offset : 0),
           device_(device),
           memory_(memory),
           offset_(offset),
           size_(size),
           flush_memory_range_(flush_memory_range),
-          invalidate_memory_range_(invalidate_memory_range) {}
+          invalidate_memory_range_(invalidate_memory_range),
+          create_info_(create_info ? *create_info : VkBufferCreateInfo{}),
+          movable_(create_info && create_info->pNext == nullptr &&
+                   create_info->sharingMode == VK_SHARING_MODE_EXCLUSIVE &&
+                   (create_info->flags & VK_BUFFER_CREATE_SPARSE_BINDING_BIT) ==
+                       0) {}
     char* base_address_;
     VulkanArena* heap_;
     AllocationToken* token_;
+    // Holds VK_NULL_HANDLE if this buffer is a range of shared_buffer_, which
+    // belongs to the block of memory that it lives in.
     VkBuffer buffer_;
+    ::VkBuffer shared_buffer_;
+    ::VkDeviceSize buffer_offset_;
     ::VkDevice device_;
     ::VkDeviceMemory memory_;
     ::VkDeviceSize offset_;
@@ -448,14 +905,45 @@ class VulkanApplication {
     LazyDeviceFunction<PFN_vkFlushMappedMemoryRanges>* flush_memory_range_;
     LazyDeviceFunction<PFN_vkInvalidateMappedMemoryRanges>*
         invalidate_memory_range_;
+    // Only the parts that are needed to re-create the buffer when it is
+    // moved are valid, pNext and pQueueFamilyIndices are not.
+    VkBufferCreateInfo create_info_;
+    bool movable_;
+  };
+
+  // The result of a call to Defragment().
+  struct DefragmentationStats {
+    uint32_t buffers_moved;
+    uint32_t images_moved;
+    // The number of bytes that were copied to new locations.
+    ::VkDeviceSize bytes_moved;
+    // The number of bytes of device memory that were returned to the device
+    // because blocks of the arenas became empty.
+    ::VkDeviceSize bytes_released;
   };
 
   // On creation creates an instance, device, surface, swapchain, queues,
   // and command pool for the application.
-  // It also creates 3 memory arenas with the given sizes.
+  // It also creates 3 memory arenas with the given initial sizes. Each arena
+  // grows on demand if it runs out of memory. If the device is created with
+  // VK_EXT_memory_budget, the sizes are limited to the budget of each heap.
   //  One for host-visible buffers.
   //  One for device-only-accessible buffers.
   //  One for device-only images.
+  // All arenas track their free memory with |arena_strategy|.
+  // If |use_transfer_queue| is true, a queue from a transfer-only queue family
+  // is created when there is one, see FillImageLayersDataAsync.
+  // |swapchain_extensions| must stay valid for RecreateSwapchain().
+  // If |job_system| is not nullptr, the pipeline cache is loaded while the
+  // swapchain is created, and the arenas allocate their memory in parallel.
+  // With |use_async_compute_queue|, up to |num_async_compute_queues| compute
+  // queues are created, as many as the queue family has.
+  // A non-zero |swapchain_images| and a non-null |present_mode| take the place
+  // of -swapchain-images and -present-mode, see CreateDefaultSwapchain.
+  // |present_mode| must stay valid for RecreateSwapchain().
+  // If the present queue is of another queue family than the render queue,
+  // the swapchain images are shared between them with
+  // |swapchain_sharing_mode|.
   VulkanApplication(
       containers::Allocator* allocator, logging::Logger* log,
       const entry::EntryData* entry_data,
@@ -473,19 +961,56 @@ class VulkanApplication {
       bool use_shared_presentation = false,
       bool use_mutable_swapchain_format = false,
       const void* swapchain_extensions = nullptr, bool use_vulkan_1_1 = false,
-      bool use_10bit_hdr = false, void* device_next = nullptr);
+      bool use_10bit_hdr = false, void* device_next = nullptr,
+      ArenaStrategy arena_strategy = ArenaStrategy::kOrderedFreeList,
+      bool use_transfer_queue = false, jobs::JobSystem* job_system = nullptr,
+      uint32_t num_async_compute_queues = 1, uint32_t swapchain_images = 0,
+      const char* present_mode = nullptr,
+      VkSharingMode swapchain_sharing_mode = VK_SHARING_MODE_CONCURRENT);
+  // Writes out the memory statistics of every arena if requested on the
+  // command-line.
+  ~VulkanApplication();
 
   // Creates an image from the given create_info, and binds memory from the
-  // device-only image Arena.
+  // device-only image Arena. If the device was created with
+  // VK_KHR_dedicated_allocation and VK_KHR_get_memory_requirements2, and the
+  // driver prefers a dedicated allocation for the image, the image gets its
+  // own ::VkDeviceMemory instead.
   containers::unique_ptr<Image> CreateAndBindImage(
       const VkImageCreateInfo* create_info,
       const uint32_t* device_indices = nullptr);
+  // Creates an arena of device-only memory for images that is separate from
+  // the device-only image arena, and grows in blocks of |block_size|. It has
+  // the memory type of the device-only image arena. Offscreen targets that
+  // are bound from their own arena neither compete with the other images of
+  // the application for memory, nor fragment their arena.
+  // If |debug_name| is not nullptr and use_debug_utils(), the memory of the
+  // arena is named |debug_name|, which must outlive the arena.
+  containers::unique_ptr<VulkanArena> CreateImageArena(
+      ::VkDeviceSize block_size, const char* debug_name = nullptr);
+  // Like CreateAndBindImage, but binds memory from |arena|, which must have
+  // been created with CreateImageArena and must outlive the image. Images of
+  // such an arena are never evicted to make room in it.
+  containers::unique_ptr<Image> CreateAndBindImage(
+      VulkanArena* arena, const VkImageCreateInfo* create_info,
+      const uint32_t* device_indices = nullptr);
   // Creates an sparse bound image from the given create_info, and binds memory
   // from the device-only image arena. The size of the binding block is the
   // given |slice_size| roundup to the image's memory alignment.
   containers::unique_ptr<SparseImage> CreateAndBindSparseImage(
       const VkImageCreateInfo* create_info, size_t slice_size,
       const uint32_t* device_indices = nullptr);
+  // Creates a sparse resident image from the given create_info, which gets
+  // VK_IMAGE_CREATE_SPARSE_BINDING_BIT and
+  // VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT added to its flags. Only the mip
+  // tail is bound from the device-only image arena, and at most
+  // |memory_budget| bytes of pages are bound on top of it at any time. The
+  // device must have been created with the sparseResidencyImage2D feature,
+  // or sparseResidencyImage3D for 3D images.
+  // |retire_delay| should be the number of frames that can be in flight.
+  containers::unique_ptr<StreamingSparseImage> CreateStreamingSparseImage(
+      const VkImageCreateInfo* create_info, ::VkDeviceSize memory_budget,
+      uint32_t retire_delay);
   // Creates a multi-planar image from the given create_info, and binds memory
   // from the device-only image arena. Memory is allocated for each plane of the
   // image if it is disjoint.
@@ -507,6 +1032,17 @@ class VulkanApplication {
   containers::unique_ptr<Buffer> CreateAndBindCoherentBuffer(
       const VkBufferCreateInfo* create_info,
       const uint32_t* device_indices = nullptr);
+  // Creates a buffer from the given create_info in host-visible memory that
+  // the host reads back from, preferring host-cached memory. The buffer must
+  // be invalidated before it is read.
+  containers::unique_ptr<Buffer> CreateAndBindReadbackBuffer(
+      const VkBufferCreateInfo* create_info,
+      const uint32_t* device_indices = nullptr);
+  // Creates a buffer from the given create_info in host-visible memory that
+  // the host writes to often, preferring memory that is also device-local.
+  containers::unique_ptr<Buffer> CreateAndBindUploadBuffer(
+      const VkBufferCreateInfo* create_info,
+      const uint32_t* device_indices = nullptr);
   // Creates a buffer with the given size, usage flags from the host-visible
   // buffer Arena. The buffer is create with VkBufferCreateFlags set to 0,
   // VkSharingMode set to VK_SHARING_MODE_EXCLUSIVE.
@@ -525,6 +1061,22 @@ class VulkanApplication {
       const VkBufferCreateInfo* create_info,
       const uint32_t* device_indices = nullptr);
 
+  // These create a buffer of at most |size| bytes with the given usage flags
+  // from the host-visible, host-coherent or device-only memory. Small
+  // buffers do not get a ::VkBuffer of their own, but are a range of a large
+  // buffer that all small buffers with the same usage flags share, so
+  // Buffer::offset() has to be used whenever the buffer is given to the
+  // device. base_address(), flush() and invalidate() only cover the range of
+  // this buffer. Buffers that are too large, or that are created with device
+  // groups, get a ::VkBuffer of their own and an offset() of 0.
+  // These buffers are never moved by Defragment().
+  containers::unique_ptr<Buffer> CreateAndBindSharedHostBuffer(
+      VkDeviceSize size, VkBufferUsageFlags usages);
+  containers::unique_ptr<Buffer> CreateAndBindSharedCoherentBuffer(
+      VkDeviceSize size, VkBufferUsageFlags usages);
+  containers::unique_ptr<Buffer> CreateAndBindSharedDeviceBuffer(
+      VkDeviceSize size, VkBufferUsageFlags usages);
+
   // Creates a buffer from the given create_info, and bind memory
   // from the device-only peer buffer Arena. That is to say,
   // this memory can be copied into.
@@ -561,6 +1113,33 @@ class VulkanApplication {
       std::initializer_list<::VkSemaphore> wait_semaphores,
       std::initializer_list<::VkSemaphore> signal_semaphores, ::VkFence fence);
 
+  // Like FillImageLayersData, but does not give the command buffer or the
+  // staging buffer back to the caller. The copy is submitted to the transfer
+  // queue if there is one, and the render queue otherwise. If the image is
+  // exclusively owned, its ownership is moved back to the render queue
+  // family before |signal_semaphores| are signaled. Returns a value that
+  // can be given to IsUploadComplete, or 0 if the operation can not be done.
+  // The staging memory is released once the upload has completed, the next
+  // time ReleaseCompletedUploads is called.
+  uint64_t FillImageLayersDataAsync(
+      Image* img, const VkImageSubresourceLayers& image_subresource,
+      const VkOffset3D& image_offset, const VkExtent3D& image_extent,
+      VkImageLayout initial_img_layout, const containers::vector<uint8_t>& data,
+      std::initializer_list<::VkSemaphore> wait_semaphores,
+      std::initializer_list<::VkSemaphore> signal_semaphores);
+  // Returns true if the upload that returned |upload| from
+  // FillImageLayersDataAsync or SubmitUpload has completed on the GPU.
+  bool IsUploadComplete(uint64_t upload);
+  // Releases the command buffers and staging memory of every asynchronous
+  // upload that has completed on the GPU.
+  void ReleaseCompletedUploads();
+  // Submits |command_buffer| to |queue|, or the render queue if it is
+  // nullptr, and keeps it and |staging_buffer| alive until it has finished
+  // executing. Returns a value that can be given to IsUploadComplete.
+  uint64_t SubmitUpload(VkCommandBuffer&& command_buffer,
+                        containers::unique_ptr<Buffer>&& staging_buffer,
+                        VkQueue* queue = nullptr);
+
   // Fills a small buffer with the given data.
   // This inserts a series of calls to vkCmdUpdateBuffer into the given
   // command_buffer, so it is
@@ -592,6 +1171,101 @@ class VulkanApplication {
       VkImageLayout initial_img_layout, containers::vector<uint8_t>* data,
       std::initializer_list<::VkSemaphore> wait_semaphores);
 
+  // Called with the host-visible copy of the image layers that were given to
+  // DumpImageLayersDataAsync. |data| is only valid during the call.
+  using ReadbackCallback = std::function<void(const uint8_t* data, size_t size)>;
+  // Records commands into |command_buffer| that copy the specific layers of
+  // the given image into host-visible memory, and then change the layout of
+  // the image to |final_img_layout|. |command_buffer| must be submitted with
+  // |fence|. Once |fence| has signaled, the next call to PollImageReadbacks
+  // passes the data to |callback|, so PollImageReadbacks must be called
+  // after waiting for |fence| but before resetting it. Returns false if the
+  // copy could not be recorded.
+  bool DumpImageLayersDataAsync(
+      Image* img, const VkImageSubresourceLayers& image_subresource,
+      const VkOffset3D& image_offset, const VkExtent3D& image_extent,
+      VkImageLayout initial_img_layout, VkImageLayout final_img_layout,
+      VkCommandBuffer* command_buffer, ::VkFence fence,
+      ReadbackCallback callback);
+  // Calls the callback of every asynchronous readback whose fence has
+  // signaled, and releases its memory.
+  void PollImageReadbacks();
+
+  // If the device was created with VK_EXT_memory_budget, fills |budget| with
+  // the current budget and usage of every memory heap and returns true.
+  // Returns false otherwise.
+  bool GetMemoryBudget(VkPhysicalDeviceMemoryBudgetPropertiesEXT* budget);
+  // Re-reads the memory budget and limits how far each arena may grow to its
+  // share of what is left of the budget of its heap, so that the arenas stop
+  // growing before the driver has to start paging. Does nothing without
+  // VK_EXT_memory_budget. This is meant to be called periodically, the Sample
+  // framework calls it once per frame.
+  void PollMemoryBudget();
+
+  // The statistics of one of the arenas of this application. |heap| is one of
+  // "host", "coherent", "device_buffer", "device_image" or "peer", and
+  // |device_index| tells apart the per-device host, coherent and peer arenas.
+  struct HeapStats {
+    const char* heap;
+    uint32_t device_index;
+    ArenaStats stats;
+  };
+  // Returns the current statistics of every arena of this application.
+  containers::vector<HeapStats> GetMemoryStats();
+  // Writes the result of GetMemoryStats() to |location| as JSON. This is done
+  // automatically on destruction if -write-memory-stats=<file> was given.
+  void WriteMemoryStats(const char* location);
+
+  // Returns the number of images that were suballocated from the device-only
+  // image arena.
+  uint64_t num_image_suballocations() const {
+    return device_only_image_heap_->num_suballocations();
+  }
+  // Returns the number of images that were given a dedicated allocation.
+  uint64_t num_dedicated_image_allocations() const {
+    return device_only_image_heap_->num_dedicated_allocations();
+  }
+
+  // Compacts the arenas that the given buffers and images were allocated
+  // from. Every movable resource that fits at a lower address in its arena
+  // is re-created there, and its contents are copied over on the render
+  // queue. Once the copies have finished the old memory is freed, which
+  // coalesces the free space and releases blocks that became empty.
+  // None of the resources may be in use by the device, and all of the images
+  // must be in |image_layout|, which they are left in. Moving a resource
+  // replaces its ::VkBuffer or ::VkImage handle, so views, descriptor sets
+  // and framebuffers that refer to a moved resource must be re-created.
+  // Device groups are not supported.
+  DefragmentationStats Defragment(const containers::vector<Buffer*>& buffers,
+                                  const containers::vector<Image*>& images,
+                                  VkImageLayout image_layout);
+
+  // Lets |image| be evicted to host memory when the arena that it was
+  // allocated from runs out of memory, starting with the images that were
+  // least recently given to MarkImageUsed. PollMemoryBudget keeps the arenas
+  // within the VK_EXT_memory_budget of their heap, so images are evicted
+  // before the driver has to page. |image| must be movable(), have only a
+  // color aspect, and be in |layout| whenever it is not being used. Evicting
+  // and restoring an image replaces its ::VkImage handle, like Defragment.
+  // Device groups are not supported.
+  void ManageImageResidency(Image* image, VkImageLayout layout);
+  // Records that |image| is used in the current residency frame, so that it
+  // is not evicted until the frame has finished. If it was evicted, it is
+  // re-created, and its contents are uploaded back with SubmitUpload, which
+  // the render queue finishes before anything that is submitted after this
+  // call. Returns true in that case, views, descriptor sets and
+  // framebuffers that refer to |image| must then be re-created.
+  bool MarkImageUsed(Image* image);
+  // Starts a new residency frame. Images that were last used
+  // |retire_delay| or more frames ago are no longer in flight, and may be
+  // evicted. The Sample framework calls this once per frame.
+  void BeginResidencyFrame(uint32_t retire_delay);
+  // Returns the number of times that an image was evicted to host memory.
+  uint64_t num_image_evictions() {
+    std::lock_guard<std::mutex> lock(residency_mutex_);
+    return num_image_evictions_;
+  }
+
   // Creates and returns a new primary level CommandBuffer using the
   // Application's default VkCommandPool.
   VkCommandBuffer GetCommandBuffer(uint32_t queueFamilyIndex = 0) {
@@ -599,6 +1273,49 @@ class VulkanApplication {
                                VK_COMMAND_BUFFER_LEVEL_PRIMARY, &device_);
   }
 
+  // Returns a command buffer that belongs to the current frame of
+  // command_buffer_allocator(), instead of allocating a new one. It is
+  // reclaimed when that frame begins again, and must not be kept until then.
+  VkCommandBuffer* GetFrameCommandBuffer(
+      uint32_t queueFamilyIndex = 0,
+      VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
+    return command_buffer_allocator_.Allocate(queueFamilyIndex, level);
+  }
+
+  // Returns the per-frame pools of GetFrameCommandBuffer. The Sample begins
+  // a frame of it for every swapchain image.
+  CommandBufferAllocator& command_buffer_allocator() {
+    return command_buffer_allocator_;
+  }
+
+  // Destroys |object| once the frames in flight are done with it, instead of
+  // waiting for the device to be idle, e.g. a BufferPointer or ImagePointer
+  // that is replaced while the application runs. The Sample begins a frame
+  // of the queue for every swapchain image. Anything that is still queued
+  // when the application is destroyed is destroyed once the device is idle.
+  template <typename T>
+  void DeleteDeferred(T&& object) {
+    deferred_deletion_queue_.Delete(std::forward<T>(object));
+  }
+  DeferredDeletionQueue& deferred_deletion_queue() {
+    return deferred_deletion_queue_;
+  }
+
+  // With -driver-allocation-stats or -audit-allocations, the callbacks that
+  // the command pools of the application are created with, which count the
+  // host memory that the driver allocates for them, and pool it while
+  // commands are recorded. nullptr otherwise.
+  const VkAllocationCallbacks* host_allocation_callbacks() const {
+    return host_allocation_callbacks_ ? host_allocation_callbacks_->callbacks()
+                                      : nullptr;
+  }
+
+  // What the driver allocated through host_allocation_callbacks(), nullptr
+  // when there are none.
+  const HostAllocationCallbacks* host_allocation_statistics() const {
+    return host_allocation_callbacks_.get();
+  }
+
   // Creates and returns a new CommandBuffer with given command buffer level
   // using the Application's default VkCommandPool
   VkCommandBuffer GetCommandBuffer(VkCommandBufferLevel level,
@@ -633,25 +1350,21 @@ class VulkanApplication {
       std::initializer_list<::VkSemaphore> wait_semaphores,
       std::initializer_list<VkPipelineStageFlags> wait_stages,
       std::initializer_list<::VkSemaphore> signal_semaphores, ::VkFence fence) {
-    containers::vector<::VkSemaphore> wait_semaphores_vec(wait_semaphores,
-                                                          allocator_);
-    containers::vector<VkPipelineStageFlags> wait_stages_vec(wait_stages,
-                                                             allocator_);
-    containers::vector<::VkSemaphore> signal_semaphores_vec(signal_semaphores,
-                                                            allocator_);
     (*cmd_buf)->vkEndCommandBuffer(*cmd_buf);
 
+    // The initializer lists are contiguous already, and live until the
+    // submit returns, so nothing has to be copied.
     auto& q = *queue;
     VkSubmitInfo submit_info{
-        VK_STRUCTURE_TYPE_SUBMIT_INFO,         // sType
-        nullptr,                               // pNext
-        uint32_t(wait_semaphores_vec.size()),  // waitSemaphoreCount
-        wait_semaphores_vec.data(),            // pWaitSemaphores
-        wait_stages_vec.data(),                // pWaitDstStageMask,
-        1,                                     // commandBufferCount
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,      // sType
+        nullptr,                            // pNext
+        uint32_t(wait_semaphores.size()),   // waitSemaphoreCount
+        wait_semaphores.begin(),            // pWaitSemaphores
+        wait_stages.begin(),                // pWaitDstStageMask,
+        1,                                  // commandBufferCount
         &cmd_buf->get_command_buffer(),
-        uint32_t(signal_semaphores_vec.size()),  // signalSemaphoreCount
-        signal_semaphores_vec.data()             // pSignalSemaphores
+        uint32_t(signal_semaphores.size()),  // signalSemaphoreCount
+        signal_semaphores.begin()            // pSignalSemaphores
     };
 
     VkResult r = q->vkQueueSubmit(q, 1, &submit_info, fence);
@@ -677,15 +1390,45 @@ class VulkanApplication {
   // as the render queue.
   VkQueue& present_queue() { return *present_queue_; }
 
-  // Returns the async compute queue for this application.
+  // Returns the async compute queue with the given |index| for this
+  // application, see num_async_compute_queues().
   // If this application was not configured with an async compute queue,
   // or the async compute queue could not be created, returns nullptr.
-  VkQueue* async_compute_queue() { return async_compute_queue_concrete_.get(); }
+  VkQueue* async_compute_queue(uint32_t index = 0) {
+    return index < async_compute_queues_.size()
+               ? async_compute_queues_[index].get()
+               : nullptr;
+  }
+
+  // Returns the number of async compute queues that were created. They all
+  // belong to the same queue family.
+  uint32_t num_async_compute_queues() const {
+    return static_cast<uint32_t>(async_compute_queues_.size());
+  }
+
+  // Returns the transfer-only queue for this application.
+  // If this application was not configured with a transfer queue,
+  // or the device has no transfer-only queue family, returns nullptr.
+  VkQueue* transfer_queue() { return transfer_queue_concrete_.get(); }
 
   // Returns the Sparse binding queue. Note: It may be the same as the render
   // queue, present queue or, if applicable, the compute queue.
   VkQueue& sparse_binding_queue() { return *sparse_binding_queue_; }
 
+  // Returns the command pool of |queue|. Every queue has its own, so that
+  // the command buffers of different queues, e.g. for uploads on the
+  // transfer queue and for the async compute queues, can be recorded on
+  // different threads at the same time. A pool must still only be used by
+  // one thread at a time. This is thread-safe.
+  VkCommandPool& GetQueueCommandPool(VkQueue& queue);
+
+  // Creates and returns a new primary level command buffer from the command
+  // pool of |queue|.
+  VkCommandBuffer GetQueueCommandBuffer(VkQueue& queue) {
+    return CreateCommandBuffer(&GetQueueCommandPool(queue),
+                               VK_COMMAND_BUFFER_LEVEL_PRIMARY, &device_);
+  }
+
   // Returns the device that was created for this application.
   VkDevice& device() { return device_; }
   VkInstance& instance() { return instance_; }
@@ -695,6 +1438,80 @@ class VulkanApplication {
 
   VkPipelineCache& pipeline_cache() { return pipeline_cache_; }
 
+  // Returns the pipeline cache that pipelines are created with on the
+  // calling thread. Every worker of pipeline_compiler() has one of its own,
+  // which starts out with the contents of pipeline_cache(), so that parallel
+  // compiles do not contend on one cache. Any other thread gets
+  // pipeline_cache().
+  ::VkPipelineCache thread_pipeline_cache();
+
+  // Waits for the pipelines that are compiled asynchronously, and merges the
+  // caches of the workers into pipeline_cache(). This runs before the cache
+  // is written to disk.
+  void MergePipelineCaches();
+
+  // Returns the shader modules that pipelines are created from. Pipelines
+  // share the module of identical SPIR-V.
+  ShaderModuleCache& shader_module_cache() { return shader_module_cache_; }
+
+  // Returns the graphics pipelines of the application, that are shared
+  // between VulkanGraphicsPipelines with the same state.
+  PipelineObjectCache& pipeline_object_cache() {
+    return pipeline_object_cache_;
+  }
+
+  // Returns the framebuffers of the application, shared between render
+  // passes to the same kind of attachments. They are imageless if the
+  // device was created with VK_KHR_imageless_framebuffer, and with the
+  // imagelessFramebuffer feature in |device_next|.
+  FramebufferCache& framebuffer_cache() { return framebuffer_cache_; }
+
+  // Returns the render passes of the application, shared between
+  // GetRenderPass() and GetRenderPass2() calls with the same description.
+  RenderPassCache& render_pass_cache() { return render_pass_cache_; }
+
+  // Returns the samplers of the application, shared between GetSampler()
+  // calls with the same state. At most maxSamplerAllocationCount of them
+  // may be alive.
+  SamplerCache& sampler_cache() { return sampler_cache_; }
+
+  // Returns the worker threads that pipelines are compiled on with
+  // VulkanGraphicsPipeline::CommitAsync and CreateComputePipelineAsync. They
+  // are only started on first use.
+  PipelineCompiler* pipeline_compiler() {
+    if (!pipeline_compiler_) {
+      pipeline_compiler_ =
+          containers::make_unique<PipelineCompiler>(allocator_, allocator_);
+      CreateWorkerPipelineCaches();
+    }
+    return pipeline_compiler_.get();
+  }
+
+  // Returns the corpus that every pipeline of the application is recorded
+  // to, or nullptr without -pipeline-cache-dir. The pipelines of the last
+  // run are pre-warmed from it after InitializationComplete().
+  PipelineCorpus* pipeline_corpus() { return pipeline_corpus_.get(); }
+
+  // Returns the creation feedback of every pipeline that was created so far,
+  // or nullptr if the device was not created with
+  // VK_EXT_pipeline_creation_feedback.
+  PipelineCreationStats* pipeline_creation_stats() {
+    return pipeline_creation_stats_.get();
+  }
+
+  // Returns the shader statistics of every pipeline that was created so
+  // far, or nullptr without -shader-stats. They are written to the file of
+  // -shader-stats on exit.
+  ShaderStatistics* shader_statistics() { return shader_statistics_.get(); }
+
+  // Returns once every pipeline that is compiled asynchronously has been
+  // created.
+  void WaitForPipelines() {
+    if (pipeline_compiler_) {
+      pipeline_compiler_->WaitAll();
+    }
+  }
+
   logging::Logger* GetLogger() { return log_; }
 
   // Creates and returns a shader module from the given spirv code.
@@ -714,29 +1531,129 @@ class VulkanApplication {
     return VkShaderModule(module, nullptr, &device_);
   }
 
+  // Returns true if the instance was created with VK_EXT_debug_utils, and
+  // the framework names its objects and labels its profiler zones.
+  bool use_debug_utils() const { return use_debug_utils_; }
+
+  // Names |handle| of |type| if use_debug_utils().
+  void SetObjectName(VkObjectType type, uint64_t handle, const char* name) {
+    vulkan::SetObjectName(device_.functions(), device_, use_debug_utils_, type,
+                          handle, name);
+  }
+
   // Returns true if the Present queue is not the same as the present queue.
   bool HasSeparatePresentQueue() const {
     return present_queue_ != render_queue_;
   }
 
+  // Returns true if device buffers have device addresses. That is the case
+  // if the device was created with VK_KHR_buffer_device_address, and with
+  // the bufferDeviceAddress feature in |device_next|.
+  bool HasBufferDeviceAddress() const { return use_buffer_device_address_; }
+
+  // Returns the device address of |buffer|, which must be a device buffer
+  // created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR. The address
+  // stays the same for the lifetime of the buffer.
+  ::VkDeviceAddress GetBufferDeviceAddress(::VkBuffer buffer) {
+    LOG_ASSERT(==, log_, true, use_buffer_device_address_);
+    const VkBufferDeviceAddressInfoKHR info = {
+        VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR,  // sType
+        nullptr,                                           // pNext
+        buffer                                             // buffer
+    };
+    return device_->vkGetBufferDeviceAddressKHR(device_, &info);
+  }
+
   // Creates and returns a PipelineLayout from the given
   // DescriptorSetLayoutBindings
   PipelineLayout CreatePipelineLayout(
       std::initializer_list<DescriptorSetLayoutBinding>
           layouts,
       std::initializer_list<VkPushConstantRange> ranges = {}) {
-    return PipelineLayout(allocator_, &device_, layouts, ranges);
+    PipelineLayout layout(allocator_, &device_, layouts, ranges);
+    if (pipeline_corpus_) {
+      pipeline_corpus_->AddPipelineLayout(layout,
+                                          layout.descriptor_set_bindings_,
+                                          layout.descriptor_set_flags_, ranges);
+    }
+    return layout;
   }
 
+  // Creates a pipeline layout like CreatePipelineLayout, with the bindless
+  // table as the set after |layouts|.
+  PipelineLayout CreateBindlessPipelineLayout(
+      std::initializer_list<DescriptorSetLayoutBinding> layouts,
+      std::initializer_list<VkPushConstantRange> ranges = {}) {
+    PipelineLayout layout(allocator_, &device_, layouts, ranges,
+                          bindless_table()->layout());
+    // The bindless table is not described to the corpus.
+    if (pipeline_corpus_) {
+      pipeline_corpus_->ForgetPipelineLayout(layout);
+    }
+    return layout;
+  }
+
+  // Returns the table of sampled images, storage buffers and samplers that
+  // are indexed by shaders, creating it on first use. The device must have
+  // been created with VK_EXT_descriptor_indexing and the features that
+  // BindlessTable lists.
+  BindlessTable* bindless_table();
+
   // Allocates a descriptor set with one descriptor according to the given
   // |binding|.
   DescriptorSet AllocateDescriptorSet(
       std::initializer_list<VkDescriptorSetLayoutBinding> bindings) {
-    return DescriptorSet(allocator_, &device_, bindings);
+    return DescriptorSet(allocator_, &device_, &descriptor_allocator_,
+                         bindings);
+  }
+
+  // Returns the pools that descriptor sets are allocated from. Transient
+  // sets can be allocated from it directly, the Sample begins a frame of it
+  // for every swapchain image.
+  DescriptorAllocator& descriptor_allocator() { return descriptor_allocator_; }
+
+  // Creates a writer that updates a whole descriptor set with the layout of
+  // |set| in one call. It uses a descriptor update template if the device
+  // was created with VK_KHR_descriptor_update_template.
+  DescriptorWriter CreateDescriptorWriter(const DescriptorSet& set) {
+    return DescriptorWriter(allocator_, &device_, set.layout(), set.bindings_,
+                            use_descriptor_update_templates_);
+  }
+
+  // Creates a writer for descriptor sets with set layout |set| of |layout|.
+  // If that was created with
+  // VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR the writer is
+  // only meant to be pushed with, and never uses a template.
+  DescriptorWriter CreateDescriptorWriter(const PipelineLayout& layout,
+                                          uint32_t set) {
+    const bool is_push_set =
+        (layout.descriptor_set_flags_[set] &
+         VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) != 0;
+    return DescriptorWriter(
+        allocator_, &device_,
+        layout.descriptor_set_layouts_[set].get_raw_object(),
+        layout.descriptor_set_bindings_[set],
+        use_descriptor_update_templates_ && !is_push_set);
   }
 
   VkSwapchainKHR& swapchain() { return swapchain_; }
 
+  // Recreates the swapchain for the current extent of the surface, e.g.
+  // after the window was resized or rotated, with the old swapchain as its
+  // oldSwapchain, and reloads swapchain_images(). Nothing may still be
+  // using the old swapchain's images on the device. Returns false, and
+  // keeps the old swapchain, if the surface currently has no area, e.g.
+  // while it is minimized, or in headless mode.
+  bool RecreateSwapchain();
+
+  // Returns true if there is no surface or swapchain, and
+  // swapchain_images() are offscreen images owned by the application
+  // instead. Nothing is ever presented in that case.
+  bool headless() const { return entry_data_->headless(); }
+
+  // Returns the command line options that the application was started with.
+  const entry::EntryData* entry_data() const { return entry_data_; }
+
   containers::vector<::VkImage>& swapchain_images() {
     return swapchain_images_;
   }
@@ -769,12 +1686,81 @@ class VulkanApplication {
     LOG_ASSERT(==, log_, VK_SUCCESS,
                device_->vkCreateRenderPass(device_, &create_info, nullptr,
                                            &render_pass));
+    if (pipeline_corpus_) {
+      pipeline_corpus_->AddRenderPass(render_pass, create_info);
+    }
     return vulkan::VkRenderPass(render_pass, nullptr, &device_);
   }
 
+  // Like CreateRenderPass, but returns a handle to a render pass of
+  // render_pass_cache(), that is shared with every identical one.
+  RenderPassCache::Handle GetRenderPass(
+      std::initializer_list<VkAttachmentDescription> attachments,
+      std::initializer_list<VkSubpassDescription> subpasses,
+      std::initializer_list<VkSubpassDependency> dependencies) {
+    VkRenderPassCreateInfo create_info{
+        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        static_cast<uint32_t>(attachments.size()),  // attachmentCount
+        attachments.size() ? attachments.begin() : nullptr,  // pAttachments
+        static_cast<uint32_t>(subpasses.size()),            // subpassCount
+        subpasses.size() ? subpasses.begin() : nullptr,     // pSubpasses
+        static_cast<uint32_t>(dependencies.size()),  // dependencyCount
+        dependencies.size() ? dependencies.begin() : nullptr,  // pDependencies
+    };
+    RenderPassCache::Handle render_pass = render_pass_cache_.Get(create_info);
+    if (pipeline_corpus_) {
+      pipeline_corpus_->AddRenderPass(render_pass, create_info);
+    }
+    return render_pass;
+  }
+
+  // Like CreateRenderPass2, but returns a handle to a render pass of
+  // render_pass_cache(), that is shared with every identical one.
+  RenderPassCache::Handle GetRenderPass2(
+      std::initializer_list<VkAttachmentDescription2KHR> attachments,
+      std::initializer_list<VkSubpassDescription2KHR> subpasses,
+      std::initializer_list<VkSubpassDependency2KHR> dependencies,
+      uint32_t correlated_view_mask_count = 0,
+      const uint32_t* correlated_view_masks = nullptr) {
+    VkRenderPassCreateInfo2KHR create_info{
+        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2_KHR,  // sType
+        nullptr,                                          // pNext
+        0,                                                // flags
+        static_cast<uint32_t>(attachments.size()),  // attachmentCount
+        attachments.size() ? attachments.begin() : nullptr,  // pAttachments
+        static_cast<uint32_t>(subpasses.size()),            // subpassCount
+        subpasses.size() ? subpasses.begin() : nullptr,     // pSubpasses
+        static_cast<uint32_t>(dependencies.size()),  // dependencyCount
+        dependencies.size() ? dependencies.begin() : nullptr,  // pDependencies
+        correlated_view_mask_count,  // correlatedViewMaskCount
+        correlated_view_masks        // pCorrelatedViewMasks
+    };
+    RenderPassCache::Handle render_pass = render_pass_cache_.Get(create_info);
+    if (pipeline_corpus_) {
+      pipeline_corpus_->ForgetRenderPass(render_pass);
+    }
+    return render_pass;
+  }
+
+  // Returns a handle to a sampler of sampler_cache(), created from
+  // |create_info| if no identical one is alive.
+  SamplerCache::Handle GetSampler(const VkSamplerCreateInfo& create_info) {
+    return sampler_cache_.Get(create_info);
+  }
+
   VulkanGraphicsPipeline CreateGraphicsPipeline(PipelineLayout* layout,
                                                 VkRenderPass* render_pass,
                                                 uint32_t subpass_) {
+    return VulkanGraphicsPipeline(allocator_, layout, this, *render_pass,
+                                  subpass_);
+  }
+
+  // Like the above, for render passes of render_pass_cache().
+  VulkanGraphicsPipeline CreateGraphicsPipeline(
+      PipelineLayout* layout, const RenderPassCache::Handle& render_pass,
+      uint32_t subpass_) {
     return VulkanGraphicsPipeline(allocator_, layout, this, render_pass,
                                   subpass_);
   }
@@ -818,6 +1804,9 @@ class VulkanApplication {
     LOG_ASSERT(==, log_, VK_SUCCESS,
                device_->vkCreateRenderPass2KHR(device_, &create_info, nullptr,
                                                &render_pass));
+    if (pipeline_corpus_) {
+      pipeline_corpus_->ForgetRenderPass(render_pass);
+    }
     return vulkan::VkRenderPass(render_pass, nullptr, &device_);
   }
 
@@ -834,6 +1823,41 @@ class VulkanApplication {
                                  specialization_info);
   }
 
+  // Like CreateComputePipeline, but the pipeline is created on a thread of
+  // pipeline_compiler(), see VulkanComputePipeline for what has to outlive
+  // its creation.
+  containers::unique_ptr<VulkanComputePipeline> CreateComputePipelineAsync(
+      PipelineLayout* layout,
+      const VkShaderModuleCreateInfo& shader_module_create_info,
+      const char* shader_entry,
+      const VkSpecializationInfo* specialization_info = nullptr) {
+    return containers::make_unique<VulkanComputePipeline>(
+        allocator_, allocator_, layout, this, pipeline_compiler(),
+        shader_module_create_info, shader_entry, specialization_info);
+  }
+
+  // Like CreateComputePipeline, but the shader is specialized with
+  // |constants|.
+  VulkanComputePipeline CreateComputePipeline(
+      PipelineLayout* layout,
+      const VkShaderModuleCreateInfo& shader_module_create_info,
+      const char* shader_entry, const SpecializationConstants& constants) {
+    return VulkanComputePipeline(allocator_, layout, this, nullptr,
+                                 shader_module_create_info, shader_entry,
+                                 constants);
+  }
+
+  // Like CreateComputePipelineAsync, but the shader is specialized with
+  // |constants|, which is copied.
+  containers::unique_ptr<VulkanComputePipeline> CreateComputePipelineAsync(
+      PipelineLayout* layout,
+      const VkShaderModuleCreateInfo& shader_module_create_info,
+      const char* shader_entry, const SpecializationConstants& constants) {
+    return containers::make_unique<VulkanComputePipeline>(
+        allocator_, allocator_, layout, this, pipeline_compiler(),
+        shader_module_create_info, shader_entry, constants);
+  }
+
   bool should_exit() const { return should_exit_.load(); }
 
   static const VkAccessFlags kAllReadBits =
@@ -852,21 +1876,167 @@ class VulkanApplication {
 
   containers::Allocator* GetAllocator() { return allocator_; }
 
+  // Returns the job system that the application was created with, or
+  // nullptr. Large copies to mapped memory are split across it.
+  jobs::JobSystem* job_system() const { return job_system_; }
+
  private:
+  struct NamedArena {
+    const char* name;
+    uint32_t device_index;
+    VulkanArena* arena;
+  };
+  // Returns every arena that this application has created.
+  containers::vector<NamedArena> GetArenas();
+  // Names every one of swapchain_images() if use_debug_utils().
+  void NameSwapchainImages();
+  // Returns the memory requirements of |image|, and whether the driver would
+  // rather it had a dedicated allocation.
+  void GetImageMemoryRequirements(::VkImage image,
+                                  VkMemoryRequirements* requirements,
+                                  bool* prefers_dedicated);
+  // Allocates memory for |image|, which was created from |create_info|, from
+  // the device-only image arena that fits it, or as a dedicated allocation if
+  // the driver prefers that. Sets |heap| to the arena that the memory has to
+  // be freed to.
+  AllocationToken* AllocateImageMemory(::VkImage image,
+                                       const VkImageCreateInfo* create_info,
+                                       VulkanArena** heap,
+                                       ::VkDeviceMemory* memory,
+                                       ::VkDeviceSize* offset);
+  // Binds |memory| at |offset| to |image|, on every device of the group
+  // unless |device_indices| says otherwise, and returns the Image that frees
+  // |token| to |heap| again.
+  containers::unique_ptr<Image> BindImage(::VkImage image, VulkanArena* heap,
+                                          AllocationToken* token,
+                                          ::VkDeviceMemory memory,
+                                          ::VkDeviceSize offset,
+                                          const VkImageCreateInfo* create_info,
+                                          const uint32_t* device_indices);
+  // Evicts the least recently used image that is managed by
+  // ManageImageResidency, allocated from |heap|, and no longer in flight.
+  // Returns false if there is no such image.
+  bool EvictLeastRecentlyUsedImage(VulkanArena* heap);
+  // Re-creates |image| after it was evicted, and uploads its contents.
+  void RestoreImage(Image* image);
+  // Called when a managed |image| is destroyed.
+  void StopManagingResidency(Image* image);
+  // Returns the arena that linear images with |memory_type_bits| are
+  // allocated from. There is one for every memory type, created the first
+  // time that a linear image needs it.
+  VulkanArena* GetLinearImageArena(uint32_t memory_type_bits);
+  // Returns the lazily allocated arena that transient attachments are
+  // allocated from, creating it the first time from one of
+  // |memory_type_bits|. Returns nullptr if none of |memory_type_bits| is
+  // lazily allocated.
+  VulkanArena* GetTransientImageArena(uint32_t memory_type_bits);
+
   containers::unique_ptr<Buffer> CreateAndBindBuffer(
       VulkanArena* heap, const VkBufferCreateInfo* create_info,
       const uint32_t* device_indices);
 
+  // How the host accesses the memory of a buffer.
+  enum HostAccessPattern {
+    kHostReadback = 0,
+    kHostUpload = 1,
+  };
+  // Returns the arena for buffers like |create_info| that are accessed
+  // by the host with |pattern|, creating it the first time.
+  VulkanArena* GetHostAccessArena(HostAccessPattern pattern,
+                                  const VkBufferCreateInfo* create_info);
+
+  // The memory that a shared buffer is created in.
+  enum SharedBufferHeap {
+    kSharedBufferHost = 0,
+    kSharedBufferCoherent = 1,
+    kSharedBufferDevice = 2,
+  };
+  // An arena whose blocks each have a buffer with the same usage, which the
+  // small buffers that are allocated from it are ranges of.
+  struct SharedBufferArena {
+    containers::unique_ptr<VulkanArena> arena;
+    // The alignment that every range needs for its usage.
+    ::VkDeviceSize alignment;
+  };
+  containers::unique_ptr<Buffer> CreateAndBindSharedBuffer(
+      SharedBufferHeap heap, VkDeviceSize size, VkBufferUsageFlags usages);
+
   // Intended to be called by the constructor to create the device, since
   // VkDevice does not have a default constructor.
   VkDevice CreateDevice(const std::initializer_list<const char*> extensions,
                         const VkPhysicalDeviceFeatures& features,
                         bool create_async_compute_queue,
                         bool use_sparse_binding, bool use_host_query_reset,
-                        void* device_next);
+                        void* device_next, bool create_transfer_queue);
 
   VkDevice SetupDevice(VkDevice device, bool create_async_compute_queue,
-                       bool use_sparse_binding);
+                       bool use_sparse_binding,
+                       bool create_transfer_queue = false);
+
+  // Starts the bring-up jobs that only need the device, and returns the
+  // group that the constructor waits for.
+  containers::unique_ptr<jobs::TaskGroup> StartBringUpJobs();
+  // Creates one pipeline cache per worker of pipeline_compiler_, before any
+  // job is submitted to it.
+  void CreateWorkerPipelineCaches();
+
+  // Records the barriers and the copy that move |src_buffer| into the given
+  // layers of |img|, leaving it in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+  void RecordImageLayersCopy(VkCommandBuffer* command_buffer, Image* img,
+                             const VkImageSubresourceLayers& image_subresource,
+                             const VkOffset3D& image_offset,
+                             const VkExtent3D& image_extent,
+                             VkImageLayout initial_img_layout,
+                             Buffer* src_buffer);
+
+  // Records the barriers and the copy that move the given layers of |img|
+  // into |dst_buffer|, leaving |img| in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+  // and making the copy visible to the host.
+  void RecordImageLayersReadback(
+      VkCommandBuffer* command_buffer, Image* img,
+      const VkImageSubresourceLayers& image_subresource,
+      const VkOffset3D& image_offset, const VkExtent3D& image_extent,
+      VkImageLayout initial_img_layout, Buffer* dst_buffer);
+
+  // A readback recorded by DumpImageLayersDataAsync.
+  struct PendingReadback {
+    PendingReadback(::VkFence fence, size_t size,
+                    containers::unique_ptr<Buffer>&& buffer,
+                    ReadbackCallback&& callback)
+        : fence(fence),
+          size(size),
+          buffer(std::move(buffer)),
+          callback(std::move(callback)) {}
+    // Not owned.
+    ::VkFence fence;
+    size_t size;
+    containers::unique_ptr<Buffer> buffer;
+    ReadbackCallback callback;
+  };
+
+  // An upload started by FillImageLayersDataAsync or SubmitUpload, and
+  // everything it needs until |fence| is signaled.
+  struct PendingUpload {
+    PendingUpload(uint64_t value, VkFence&& fence,
+                  VkCommandBuffer&& transfer_command_buffer,
+                  VkCommandBuffer&& acquire_command_buffer,
+                  VkSemaphore&& ownership_semaphore,
+                  containers::unique_ptr<Buffer>&& staging_buffer)
+        : value(value),
+          fence(std::move(fence)),
+          transfer_command_buffer(std::move(transfer_command_buffer)),
+          acquire_command_buffer(std::move(acquire_command_buffer)),
+          ownership_semaphore(std::move(ownership_semaphore)),
+          staging_buffer(std::move(staging_buffer)) {}
+    uint64_t value;
+    VkFence fence;
+    VkCommandBuffer transfer_command_buffer;
+    // Only recorded if the image had to be moved back to the render queue
+    // family, otherwise this wraps VK_NULL_HANDLE.
+    VkCommandBuffer acquire_command_buffer;
+    VkSemaphore ownership_semaphore;
+    containers::unique_ptr<Buffer> staging_buffer;
+  };
 
   // Intended to be called by the constructor to create the device, since
   // VkDevice does not have a default constructor.
@@ -880,41 +2050,152 @@ class VulkanApplication {
       command_pools_.emplace(
           queueFamilyIndex,
           CreateDefaultCommandPool(allocator_, device_, use_protected_memory_,
-                                   queueFamilyIndex));
+                                   queueFamilyIndex,
+                                   host_allocation_callbacks()));
     }
     return command_pools_.at(queueFamilyIndex);
   }
 
   containers::Allocator* allocator_;
+  // The images, buffers, views and pending transfers that are handed out
+  // come from here. This is destroyed last, they must all be gone by then.
+  containers::PoolAllocator object_pool_;
   logging::Logger* log_;
   const entry::EntryData* entry_data_;
   containers::unique_ptr<VkQueue> render_queue_concrete_;
   containers::unique_ptr<VkQueue> present_queue_concrete_;
   containers::unique_ptr<VkQueue> sparse_binding_queue_concrete_;
-  containers::unique_ptr<VkQueue> async_compute_queue_concrete_;
+  containers::vector<containers::unique_ptr<VkQueue>> async_compute_queues_;
+  containers::unique_ptr<VkQueue> transfer_queue_concrete_;
   VkQueue* render_queue_;
   VkQueue* present_queue_;
   VkQueue* sparse_binding_queue_;
   uint32_t render_queue_index_;
   uint32_t present_queue_index_;
   uint32_t compute_queue_index_;
+  // The number of async compute queues that were asked for, and then that
+  // were created.
+  uint32_t num_async_compute_queues_;
   uint32_t sparse_binding_queue_index_;
+  uint32_t transfer_queue_index_;
   bool use_protected_memory_;
+  // True if the device was created with VK_KHR_dedicated_allocation and
+  // VK_KHR_get_memory_requirements2, so images that prefer it can get their
+  // own ::VkDeviceMemory.
+  bool use_dedicated_allocations_;
+  // True if the device was created with VK_EXT_memory_budget.
+  bool use_memory_budget_;
+  // True if the device was created with VK_KHR_descriptor_update_template.
+  bool use_descriptor_update_templates_;
+  // True if the device was created with VK_EXT_descriptor_indexing.
+  bool use_descriptor_indexing_;
+  // True if the device was created with VK_KHR_buffer_device_address, and
+  // the bufferDeviceAddress feature.
+  bool use_buffer_device_address_;
+  // True if the instance was created with VK_EXT_debug_utils.
+  bool use_debug_utils_;
+  ArenaStrategy arena_strategy_;
+  ::VkDeviceSize buffer_image_granularity_;
+  // May be nullptr, the bring-up jobs are then run right away.
+  jobs::JobSystem* job_system_;
 
   LibraryWrapper library_wrapper_;
   VkInstance instance_;
   VkSurfaceKHR surface_;
   VkDevice device_;
+  // Loaded by bring_up_jobs_ while the swapchain is created.
+  VkPipelineCache pipeline_cache_;
+  // The parts of bring-up that run in parallel, only alive during the
+  // constructor.
+  containers::unique_ptr<jobs::TaskGroup> bring_up_jobs_;
   VkSwapchainKHR swapchain_;
+  // What swapchain_ was created with, for RecreateSwapchain().
+  VkColorSpaceKHR swapchain_color_space_;
+  bool use_shared_presentation_;
+  VkSwapchainCreateFlagsKHR swapchain_flags_;
+  bool use_10bit_hdr_;
+  const void* swapchain_extensions_;
+  uint32_t requested_swapchain_images_;
+  const char* requested_present_mode_;
+  VkSharingMode swapchain_sharing_mode_;
+  // With -driver-allocation-stats or -audit-allocations, the callbacks of the
+  // command pools. They have to outlive the pools.
+  containers::unique_ptr<HostAllocationCallbacks> host_allocation_callbacks_;
   containers::unordered_map<uint32_t, VkCommandPool> command_pools_;
-  VkPipelineCache pipeline_cache_;
+  // The pools of GetQueueCommandPool, by queue.
+  containers::unordered_map<::VkQueue, VkCommandPool> queue_command_pools_;
+  std::mutex queue_command_pools_mutex_;
+  // Has to be destroyed before the device, like command_pools_.
+  CommandBufferAllocator command_buffer_allocator_;
+  ShaderModuleCache shader_module_cache_;
+  PipelineObjectCache pipeline_object_cache_;
+  FramebufferCache framebuffer_cache_;
+  RenderPassCache render_pass_cache_;
+  SamplerCache sampler_cache_;
+  DescriptorAllocator descriptor_allocator_;
+  // The caches of thread_pipeline_cache(), one per worker of
+  // pipeline_compiler_.
+  containers::vector<containers::unique_ptr<VkPipelineCache>>
+      worker_pipeline_caches_;
+  // Only created on first use. Its threads are joined before the pipeline
+  // caches are destroyed.
+  containers::unique_ptr<PipelineCompiler> pipeline_compiler_;
+  // Only created with -pipeline-cache-dir. It pre-warms pipeline_cache_ on a
+  // thread of its own, which is stopped before the cache is written.
+  containers::unique_ptr<PipelineCorpus> pipeline_corpus_;
+  // Only created if the device was created with
+  // VK_EXT_pipeline_creation_feedback.
+  containers::unique_ptr<PipelineCreationStats> pipeline_creation_stats_;
+  // Only created with -shader-stats, if the device was created with
+  // VK_KHR_pipeline_executable_properties or VK_AMD_shader_info.
+  containers::unique_ptr<ShaderStatistics> shader_statistics_;
   containers::vector<containers::unique_ptr<VulkanArena>> host_accessible_heap_;
   containers::vector<containers::unique_ptr<VulkanArena>> coherent_heap_;
   containers::unique_ptr<VulkanArena> device_only_image_heap_;
+  // One per memory type, only created once a linear image of that memory
+  // type is created on a device with a bufferImageGranularity larger than 1.
+  containers::unique_ptr<VulkanArena>
+      device_only_linear_image_heaps_[VK_MAX_MEMORY_TYPES];
+  // Only created once an image with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+  // is created on a device with lazily allocated memory.
+  containers::unique_ptr<VulkanArena> device_transient_image_heap_;
+  // Only created once the first readback or upload buffer is created.
+  containers::unique_ptr<VulkanArena> readback_heap_;
+  containers::unique_ptr<VulkanArena> upload_heap_;
+  // Guards device_only_linear_image_heaps_, device_transient_image_heap_,
+  // readback_heap_ and upload_heap_.
+  std::mutex lazy_heaps_mutex_;
   containers::unique_ptr<VulkanArena> device_only_buffer_heap_;
+  // Only created on first use.
+  containers::unique_ptr<BindlessTable> bindless_table_;
+  std::mutex bindless_table_mutex_;
   containers::vector<containers::unique_ptr<VulkanArena>>
       device_peer_memory_heaps_;
+  // Keyed on the SharedBufferHeap in the upper 32 bits, and the buffer usage
+  // in the lower 32 bits. Guarded by shared_buffer_arenas_mutex_.
+  containers::unordered_map<uint64_t, SharedBufferArena> shared_buffer_arenas_;
+  std::mutex shared_buffer_arenas_mutex_;
+  // Sorted by value, which is the order that they were submitted.
+  containers::vector<containers::unique_ptr<PendingUpload>> pending_uploads_;
+  uint64_t next_upload_value_;
+  // Every upload up to and including this value has completed.
+  uint64_t completed_upload_value_;
+  // In the order that they were recorded.
+  containers::vector<containers::unique_ptr<PendingReadback>>
+      pending_readbacks_;
+  // The images that ManageImageResidency was called for, and the current
+  // residency frame, guarded by residency_mutex_.
+  containers::vector<Image*> managed_images_;
+  uint64_t residency_frame_;
+  uint32_t residency_retire_delay_;
+  uint64_t num_image_evictions_;
+  std::mutex residency_mutex_;
   containers::vector<::VkImage> swapchain_images_;
+  // Stand in for the swapchain images in headless mode.
+  containers::vector<containers::unique_ptr<Image>> headless_images_;
+  // Destroyed before everything above, since the objects in it may need any
+  // of it.
+  DeferredDeletionQueue deferred_deletion_queue_;
   std::atomic<bool> should_exit_;
 };
 
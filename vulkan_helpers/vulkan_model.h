@@ -19,8 +19,11 @@
 #include "support/containers/allocator.h"
 #include "support/containers/vector.h"
 #include "support/log/log.h"
+#include "vulkan_helpers/asset_file.h"
+#include "vulkan_helpers/host_copy.h"
 #include "vulkan_helpers/vulkan_application.h"
 
+#include <cstring>
 #include <initializer_list>
 
 namespace vulkan {
@@ -29,99 +32,177 @@ const size_t TEXCOORD_SIZE = sizeof(float) * 2;
 const size_t NORMAL_SIZE = sizeof(float) * 3;
 
 const size_t INDEX_SIZE = sizeof(uint32_t);
+const size_t INDEX16_SIZE = sizeof(uint16_t);
+
+// The largest staging buffer that is used to upload model data. Larger
+// models are uploaded in several chunks.
+const size_t MAX_MODEL_STAGING_SIZE = 16 * 1024 * 1024;
+
+// Controls how a VulkanModel lays out its vertex data on the device. The
+// attributes are always delivered to the shader as floats, so the same
+// shaders work with every layout.
+enum VulkanModelLayoutFlags : uint32_t {
+  // All of the attributes of a vertex are interleaved in a single binding,
+  // rather than each attribute having a binding of its own.
+  kModelLayoutInterleaved = 1 << 0,
+  // Texture coordinates are stored as half floats, and normals as 10 bit
+  // normalized integers. Implies kModelLayoutInterleaved.
+  kModelLayoutQuantizedAttributes = 1 << 1,
+  // Positions are stored as 16 bit normalized integers, relative to the
+  // bounds of the model. The shader sees positions in [-1, 1], so
+  // position_scale() and position_bias() have to be applied by the caller,
+  // usually by folding them into the model matrix.
+  // Implies kModelLayoutInterleaved.
+  kModelLayoutQuantizedPositions = 1 << 2,
+  // The vertex buffer can also be read by vertex shaders through its device
+  // address, see GetVertexAddress(), so that they can pull their vertices
+  // instead of having vertex input. Needs VulkanApplication::
+  // HasBufferDeviceAddress().
+  kModelLayoutDeviceAddress = 1 << 3,
+};
 
 struct VulkanModel {
  public:
   // A standard VulkanModel object. It is expected to be used with the
   // output from convert_obj_to_c.py. That is, positions, texture_coords
   // and normals are expected to be sequential in memory.
+  // |layout_flags| is a combination of VulkanModelLayoutFlags.
   VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
               size_t num_vertices, const float* positions,
               const float* texture_coords, const float* normals,
-              size_t num_indices, const uint32_t* indices)
-      : allocator_(allocator),
-        logger_(logger),
-        positions_(positions),
-        texture_coords_(texture_coords),
-        normals_(normals),
-        indices_(indices),
-        num_vertices_(num_vertices),
-        num_indices_(num_indices),
-        vertex_data_size_(num_vertices *
-                          (POSITION_SIZE + TEXCOORD_SIZE + NORMAL_SIZE)),
-        index_data_size_(num_indices * INDEX_SIZE) {
-    // Make sure that vertices, indices and normals are contiguous in memory
-    // this simplifies everything. The standard model format guarantees this.
-    LOG_ASSERT(==, logger, texture_coords,
-               reinterpret_cast<const float*>(
-                   reinterpret_cast<const uint8_t*>(positions) +
-                   num_vertices * POSITION_SIZE));
-    LOG_ASSERT(==, logger, normals,
-               reinterpret_cast<const float*>(
-                   reinterpret_cast<const uint8_t*>(texture_coords) +
-                   num_vertices * TEXCOORD_SIZE));
-  }
+              size_t num_indices, const uint32_t* indices,
+              uint32_t layout_flags = 0)
+      : VulkanModel(allocator, logger, num_vertices, positions, texture_coords,
+                    normals, num_indices, indices, VK_INDEX_TYPE_UINT32,
+                    layout_flags) {}
+
+  // As above, but with 16 bit indices, as convert_obj_to_c.py writes for
+  // models with no more than 65536 vertices.
+  VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
+              size_t num_vertices, const float* positions,
+              const float* texture_coords, const float* normals,
+              size_t num_indices, const uint16_t* indices,
+              uint32_t layout_flags = 0)
+      : VulkanModel(allocator, logger, num_vertices, positions, texture_coords,
+                    normals, num_indices, indices, VK_INDEX_TYPE_UINT16,
+                    layout_flags) {}
 
   // Constructs a vulkan model from the output of the convert_obj_to_c.py
   // script.
   template <typename T>
   VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
-              const T& t)
+              const T& t, uint32_t layout_flags = 0)
       : VulkanModel(allocator, logger, t.num_vertices, t.positions, t.uv,
-                    t.normals, t.num_indices, t.indices) {}
+                    t.normals, t.num_indices, t.indices, layout_flags) {}
+
+  // Constructs a vulkan model from a binary asset file written by
+  // convert_obj_to_c.py --binary. The vertex and index data is used directly
+  // from |file|, so |file| must outlive this model.
+  VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
+              const AssetFile& file, uint32_t layout_flags = 0)
+      : VulkanModel(
+            allocator, logger, AssetVertexCount(file),
+            reinterpret_cast<const float*>(file.section(kAssetVertexData)),
+            reinterpret_cast<const float*>(file.section(kAssetVertexData) +
+                                           AssetVertexCount(file) *
+                                               POSITION_SIZE),
+            reinterpret_cast<const float*>(
+                file.section(kAssetVertexData) +
+                AssetVertexCount(file) * (POSITION_SIZE + TEXCOORD_SIZE)),
+            AssetIndexCount(file), AssetIndices(file), AssetIndexType(file),
+            layout_flags) {}
 
   // Creates the vertex and index buffers. Adds transfer commands to
   // CmdBuffer to populate the vertex and index buffers with data.
+  // The data is copied through host-visible staging buffers, which are kept
+  // until InitializationComplete() is called, or the model is released or
+  // re-initialized.
   // If this model has already been initialized, then this re-initializes it.
-  // TODO(awoloszyn):
-  // Currently all uploads are done with vkCmdUpdateBuffer. If many large models
-  // are created, then switch to a staging + data buffer.
   void InitializeData(vulkan::VulkanApplication* application,
                       vulkan::VkCommandBuffer* cmdBuffer) {
-    VkBufferCreateInfo create_info = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
-        nullptr,                               // pNext
-        0,                                     // flags
-        vertex_data_size_,                     // size
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,  // usage
-        VK_SHARING_MODE_EXCLUSIVE,
-        0,
-        nullptr};
-    vertexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
-    application->FillSmallBuffer(
-        vertexBuffer_.get(), static_cast<const void*>(positions_),
-        vertex_data_size_, 0, cmdBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    staging_buffers_.clear();
+    CreateBuffers(application);
+    StageData(application, cmdBuffer, vertexBuffer_.get(), upload_vertices_,
+              vertex_data_size_);
+    StageData(application, cmdBuffer, indexBuffer_.get(),
+              static_cast<const uint8_t*>(indices_), index_data_size_);
 
-    create_info.usage =
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    create_info.size = index_data_size_;
-
-    indexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
-
-    application->FillSmallBuffer(
-        indexBuffer_.get(), static_cast<const void*>(indices_),
-        index_data_size_, 0, cmdBuffer, VK_ACCESS_INDEX_READ_BIT);
+    // A single barrier makes all of the copies visible to vertex input. It
+    // is queued, so that the barriers of other models are merged into it.
+    VkBufferMemoryBarrier barriers[2];
+    GetFinalBarriers(barriers);
+    for (const auto& barrier : barriers) {
+      cmdBuffer->QueueBufferBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    GetFinalStages(), barrier);
+    }
   }
 
+  // When the command buffer given to InitializeData has finished executing,
+  // call this method to release the staging buffers.
+  void InitializationComplete() { staging_buffers_.clear(); }
+
   // Releases all resources held by this model.
   void ReleaseData() {
     vertexBuffer_.release();
     indexBuffer_.release();
+    staging_buffers_.clear();
   }
 
+  // With kModelLayoutQuantizedPositions, the position given to the shader
+  // has to be multiplied by position_scale() and then have position_bias()
+  // added to it to get the original position. Both are only valid once the
+  // model has been initialized. Otherwise the scale is 1 and the bias is 0.
+  const float* position_scale() const { return position_scale_; }
+  const float* position_bias() const { return position_bias_; }
+
+  // The bytes of vertex data of every vertex, over all of the bindings.
+  // With kModelLayoutQuantizedAttributes this is only valid once the model
+  // has been initialized.
+  uint32_t vertex_stride() const { return vertex_stride_; }
+
   struct InputStateAssemblyInfo {};
 
   // Adds the vertex assembly state to the given vectors
   // for this model to be used in a pipeline.
-  // The attributes for the vertices are bound to sequential binding numbers:
+  // The attributes for the vertices are bound to sequential binding numbers,
+  // or all to binding 0 if the model is interleaved:
   //    layout(location = 0) in vec3 positions_;
   //    layout(location = 1) in vec2 texture_coords_;
   //    layout(location = 2) in vec3 normals_;
+  // With kModelLayoutQuantizedAttributes this must be called after the model
+  // has been initialized.
   void GetAssemblyInfo(
       containers::vector<VkVertexInputBindingDescription>* input_bindings,
       containers::vector<VkVertexInputAttributeDescription>*
           vertex_attribute_descriptions) {
+    LOG_ASSERT(!=, logger_, VK_FORMAT_UNDEFINED, normal_format_);
+    if (layout_flags_ & kModelLayoutInterleaved) {
+      input_bindings->push_back({
+          0,                           // binding
+          vertex_stride_,              // stride
+          VK_VERTEX_INPUT_RATE_VERTEX  // inputRate
+      });
+      vertex_attribute_descriptions->push_back({
+          0,                 // location
+          0,                 // binding
+          position_format_,  // format
+          0,                 // offset
+      });
+      vertex_attribute_descriptions->push_back({
+          1,                 // location
+          0,                 // binding
+          texcoord_format_,  // format
+          texcoord_offset_,  // offset
+      });
+      vertex_attribute_descriptions->push_back({
+          2,               // location
+          0,               // binding
+          normal_format_,  // format
+          normal_offset_,  // offset
+      });
+      return;
+    }
+
     input_bindings->push_back({
         0,                           // binding
         POSITION_SIZE,               // stride
@@ -162,14 +243,7 @@ struct VulkanModel {
   // command-buffer. This binds the vertex and index buffers, and issues
   // the draw call.
   void Draw(vulkan::VkCommandBuffer* cmdBuffer) {
-    ::VkBuffer buffers[3] = {*vertexBuffer_, *vertexBuffer_, *vertexBuffer_};
-    ::VkDeviceSize offsets[3] = {
-        0, num_vertices_ * POSITION_SIZE,
-        num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE)};
-    (*cmdBuffer)->vkCmdBindVertexBuffers(*cmdBuffer, 0, 3, buffers, offsets);
-    (*cmdBuffer)
-        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0,
-                               VK_INDEX_TYPE_UINT32);
+    BindVertexAndIndexBuffers(cmdBuffer);
     (*cmdBuffer)
         ->vkCmdDrawIndexed(*cmdBuffer, static_cast<uint32_t>(num_indices_), 1,
                            0, 0, 0);
@@ -178,14 +252,7 @@ struct VulkanModel {
   // Draws an instanced version of this model.
   void DrawInstanced(vulkan::VkCommandBuffer* cmdBuffer,
                      uint32_t instance_count) {
-    ::VkBuffer buffers[3] = {*vertexBuffer_, *vertexBuffer_, *vertexBuffer_};
-    ::VkDeviceSize offsets[3] = {
-        0, num_vertices_ * POSITION_SIZE,
-        num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE)};
-    (*cmdBuffer)->vkCmdBindVertexBuffers(*cmdBuffer, 0, 3, buffers, offsets);
-    (*cmdBuffer)
-        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0,
-                               VK_INDEX_TYPE_UINT32);
+    BindVertexAndIndexBuffers(cmdBuffer);
     (*cmdBuffer)
         ->vkCmdDrawIndexed(*cmdBuffer, static_cast<uint32_t>(num_indices_),
                            instance_count, 0, 0, 0);
@@ -196,28 +263,369 @@ struct VulkanModel {
     ::VkDeviceSize offsets[3] = {
         0, num_vertices_ * POSITION_SIZE,
         num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE)};
-    (*cmdBuffer)->vkCmdBindVertexBuffers(*cmdBuffer, 0, 3, buffers, offsets);
+    const uint32_t binding_count =
+        (layout_flags_ & kModelLayoutInterleaved) ? 1 : 3;
     (*cmdBuffer)
-        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0,
-                               VK_INDEX_TYPE_UINT32);
+        ->vkCmdBindVertexBuffers(*cmdBuffer, 0, binding_count, buffers,
+                                 offsets);
+    (*cmdBuffer)
+        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0, index_type_);
+  }
+
+  // Only binds the index buffer, for pipelines that pull their vertices
+  // through GetVertexAddress().
+  void BindIndexBuffer(vulkan::VkCommandBuffer* cmdBuffer) {
+    (*cmdBuffer)
+        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0, index_type_);
   }
 
   size_t NumIndices() const { return num_indices_; }
+  size_t NumVertices() const { return num_vertices_; }
+  VkIndexType IndexType() const { return index_type_; }
+
+  // With kModelLayoutDeviceAddress, returns the device address of the
+  // vertex data. Unless the model is interleaved, that is all of the
+  // positions, then all of the texture coordinates, then all of the normals,
+  // as floats. Only valid once the model has been initialized.
+  ::VkDeviceAddress GetVertexAddress(vulkan::VulkanApplication* application) {
+    LOG_ASSERT(!=, logger_, 0u, layout_flags_ & kModelLayoutDeviceAddress);
+    return application->GetBufferDeviceAddress(*vertexBuffer_);
+  }
 
  private:
+  friend class GeometryPool;
+  friend class UploadBatch;
+
+  // The constructor that all of the others forward to. |indices| holds
+  // |num_indices| indices of |index_type|.
+  VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
+              size_t num_vertices, const float* positions,
+              const float* texture_coords, const float* normals,
+              size_t num_indices, const void* indices, VkIndexType index_type,
+              uint32_t layout_flags)
+      : allocator_(allocator),
+        logger_(logger),
+        positions_(positions),
+        texture_coords_(texture_coords),
+        normals_(normals),
+        indices_(indices),
+        num_vertices_(num_vertices),
+        num_indices_(num_indices),
+        vertex_data_size_(num_vertices *
+                          (POSITION_SIZE + TEXCOORD_SIZE + NORMAL_SIZE)),
+        index_type_(index_type),
+        index_data_size_(num_indices * (index_type == VK_INDEX_TYPE_UINT16
+                                            ? INDEX16_SIZE
+                                            : INDEX_SIZE)),
+        layout_flags_(layout_flags),
+        position_format_(VK_FORMAT_R32G32B32_SFLOAT),
+        texcoord_format_(VK_FORMAT_R32G32_SFLOAT),
+        normal_format_(VK_FORMAT_R32G32B32_SFLOAT),
+        texcoord_offset_(static_cast<uint32_t>(POSITION_SIZE)),
+        normal_offset_(static_cast<uint32_t>(POSITION_SIZE + TEXCOORD_SIZE)),
+        vertex_stride_(
+            static_cast<uint32_t>(POSITION_SIZE + TEXCOORD_SIZE + NORMAL_SIZE)),
+        position_scale_{1.0f, 1.0f, 1.0f},
+        position_bias_{0.0f, 0.0f, 0.0f},
+        packed_vertices_(allocator),
+        upload_vertices_(reinterpret_cast<const uint8_t*>(positions)),
+        staging_buffers_(allocator) {
+    // Make sure that vertices, indices and normals are contiguous in memory
+    // this simplifies everything. The standard model format guarantees this.
+    LOG_ASSERT(==, logger, texture_coords,
+               reinterpret_cast<const float*>(
+                   reinterpret_cast<const uint8_t*>(positions) +
+                   num_vertices * POSITION_SIZE));
+    LOG_ASSERT(==, logger, normals,
+               reinterpret_cast<const float*>(
+                   reinterpret_cast<const uint8_t*>(texture_coords) +
+                   num_vertices * TEXCOORD_SIZE));
+    if (layout_flags_ & (kModelLayoutQuantizedAttributes |
+                         kModelLayoutQuantizedPositions)) {
+      layout_flags_ |= kModelLayoutInterleaved;
+    }
+    if (layout_flags_ & kModelLayoutQuantizedPositions) {
+      position_format_ = VK_FORMAT_R16G16B16A16_SNORM;
+    }
+    if (layout_flags_ & kModelLayoutQuantizedAttributes) {
+      texcoord_format_ = VK_FORMAT_R16G16_SFLOAT;
+      // Which format the normals end up in depends on the device, so it is
+      // picked when the buffers are created.
+      normal_format_ = VK_FORMAT_UNDEFINED;
+    }
+  }
+
+
+  // Creates the device-local vertex and index buffers.
+  void CreateBuffers(vulkan::VulkanApplication* application) {
+    if (layout_flags_ & kModelLayoutInterleaved) {
+      PackVertices(application);
+    }
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        vertex_data_size_,                     // size
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,
+        0,
+        nullptr};
+    if (layout_flags_ & kModelLayoutDeviceAddress) {
+      create_info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR;
+    }
+    vertexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
+
+    create_info.usage =
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    create_info.size = index_data_size_;
+    indexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
+  }
+
+  // Writes the barriers that make transfer writes to the vertex and index
+  // buffers visible to vertex input, and to vertex shaders with
+  // kModelLayoutDeviceAddress, to |barriers|.
+  void GetFinalBarriers(VkBufferMemoryBarrier barriers[2]) {
+    const VkBufferMemoryBarrier final_barriers[2] = {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *vertexBuffer_,                           // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+            nullptr,                                  // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+            VK_ACCESS_INDEX_READ_BIT,                 // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+            *indexBuffer_,                            // buffer
+            0,                                        // offset
+            VK_WHOLE_SIZE,                            // size
+        }};
+    barriers[0] = final_barriers[0];
+    barriers[1] = final_barriers[1];
+    if (layout_flags_ & kModelLayoutDeviceAddress) {
+      barriers[0].dstAccessMask |= VK_ACCESS_SHADER_READ_BIT;
+    }
+  }
+
+  // Returns the stages that wait for the barriers of GetFinalBarriers.
+  VkPipelineStageFlags GetFinalStages() const {
+    return (layout_flags_ & kModelLayoutDeviceAddress)
+               ? VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                     VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+               : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  }
+
+  // Converts the planar vertex data into packed_vertices_, in the layout
+  // given by layout_flags_.
+  void PackVertices(vulkan::VulkanApplication* application) {
+    if (layout_flags_ & kModelLayoutQuantizedAttributes) {
+      // A2B10G10R10_SNORM_PACK32 is not required to be supported for vertex
+      // input, R16G16B16A16_SNORM is.
+      VkFormatProperties format_properties;
+      application->instance()->vkGetPhysicalDeviceFormatProperties(
+          application->device().physical_device(),
+          VK_FORMAT_A2B10G10R10_SNORM_PACK32, &format_properties);
+      normal_format_ = (format_properties.bufferFeatures &
+                        VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)
+                           ? VK_FORMAT_A2B10G10R10_SNORM_PACK32
+                           : VK_FORMAT_R16G16B16A16_SNORM;
+    }
+    const uint32_t position_size =
+        position_format_ == VK_FORMAT_R16G16B16A16_SNORM
+            ? sizeof(int16_t) * 4
+            : static_cast<uint32_t>(POSITION_SIZE);
+    const uint32_t texcoord_size =
+        texcoord_format_ == VK_FORMAT_R16G16_SFLOAT
+            ? sizeof(uint16_t) * 2
+            : static_cast<uint32_t>(TEXCOORD_SIZE);
+    const uint32_t normal_size =
+        normal_format_ == VK_FORMAT_A2B10G10R10_SNORM_PACK32
+            ? sizeof(uint32_t)
+            : normal_format_ == VK_FORMAT_R16G16B16A16_SNORM
+                  ? sizeof(int16_t) * 4
+                  : static_cast<uint32_t>(NORMAL_SIZE);
+    texcoord_offset_ = position_size;
+    normal_offset_ = position_size + texcoord_size;
+    vertex_stride_ = position_size + texcoord_size + normal_size;
+
+    if (layout_flags_ & kModelLayoutQuantizedPositions) {
+      // Map the bounds of the model onto [-1, 1] on every axis.
+      for (size_t axis = 0; axis < 3; ++axis) {
+        float min_value = num_vertices_ ? positions_[axis] : 0.0f;
+        float max_value = min_value;
+        for (size_t i = 0; i < num_vertices_; ++i) {
+          const float value = positions_[i * 3 + axis];
+          min_value = value < min_value ? value : min_value;
+          max_value = value > max_value ? value : max_value;
+        }
+        position_bias_[axis] = (min_value + max_value) * 0.5f;
+        position_scale_[axis] = (max_value - min_value) * 0.5f;
+        if (position_scale_[axis] == 0.0f) {
+          position_scale_[axis] = 1.0f;
+        }
+      }
+    }
+
+    vertex_data_size_ = num_vertices_ * vertex_stride_;
+    packed_vertices_.resize(vertex_data_size_);
+    for (size_t i = 0; i < num_vertices_; ++i) {
+      uint8_t* vertex = packed_vertices_.data() + i * vertex_stride_;
+      const float* position = positions_ + i * 3;
+      const float* texture_coord = texture_coords_ + i * 2;
+      const float* normal = normals_ + i * 3;
+
+      if (position_format_ == VK_FORMAT_R16G16B16A16_SNORM) {
+        int16_t packed[4];
+        for (size_t axis = 0; axis < 3; ++axis) {
+          packed[axis] = ToSnorm16((position[axis] - position_bias_[axis]) /
+                                   position_scale_[axis]);
+        }
+        packed[3] = ToSnorm16(1.0f);
+        memcpy(vertex, packed, sizeof(packed));
+      } else {
+        memcpy(vertex, position, POSITION_SIZE);
+      }
+
+      if (texcoord_format_ == VK_FORMAT_R16G16_SFLOAT) {
+        uint16_t packed[2] = {FloatToHalf(texture_coord[0]),
+                              FloatToHalf(texture_coord[1])};
+        memcpy(vertex + texcoord_offset_, packed, sizeof(packed));
+      } else {
+        memcpy(vertex + texcoord_offset_, texture_coord, TEXCOORD_SIZE);
+      }
+
+      if (normal_format_ == VK_FORMAT_A2B10G10R10_SNORM_PACK32) {
+        uint32_t packed = (ToSnorm10(normal[0]) << 0) |
+                          (ToSnorm10(normal[1]) << 10) |
+                          (ToSnorm10(normal[2]) << 20);
+        memcpy(vertex + normal_offset_, &packed, sizeof(packed));
+      } else if (normal_format_ == VK_FORMAT_R16G16B16A16_SNORM) {
+        int16_t packed[4] = {ToSnorm16(normal[0]), ToSnorm16(normal[1]),
+                             ToSnorm16(normal[2]), 0};
+        memcpy(vertex + normal_offset_, packed, sizeof(packed));
+      } else {
+        memcpy(vertex + normal_offset_, normal, NORMAL_SIZE);
+      }
+    }
+    upload_vertices_ = packed_vertices_.data();
+  }
+
+  static int16_t ToSnorm16(float value) {
+    value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+    return static_cast<int16_t>(value * 32767.0f +
+                                (value < 0.0f ? -0.5f : 0.5f));
+  }
+
+  // Returns |value| as a 10 bit normalized integer in the low bits.
+  static uint32_t ToSnorm10(float value) {
+    value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+    int32_t snorm =
+        static_cast<int32_t>(value * 511.0f + (value < 0.0f ? -0.5f : 0.5f));
+    return static_cast<uint32_t>(snorm) & 0x3ff;
+  }
+
+  static size_t AssetVertexCount(const AssetFile& file) {
+    return file.section_size(kAssetVertexData) /
+           (POSITION_SIZE + TEXCOORD_SIZE + NORMAL_SIZE);
+  }
+
+  // Binary models with no more than 65536 vertices have 16 bit indices.
+  static VkIndexType AssetIndexType(const AssetFile& file) {
+    return file.has_section(kAssetIndexData16) ? VK_INDEX_TYPE_UINT16
+                                               : VK_INDEX_TYPE_UINT32;
+  }
+  static const void* AssetIndices(const AssetFile& file) {
+    return file.section(AssetIndexType(file) == VK_INDEX_TYPE_UINT16
+                            ? kAssetIndexData16
+                            : kAssetIndexData);
+  }
+  static size_t AssetIndexCount(const AssetFile& file) {
+    return AssetIndexType(file) == VK_INDEX_TYPE_UINT16
+               ? file.section_size(kAssetIndexData16) / INDEX16_SIZE
+               : file.section_size(kAssetIndexData) / INDEX_SIZE;
+  }
+
+  // Copies |size| bytes of |data| into new staging buffers, and records the
+  // copies from them into |dst|.
+  void StageData(vulkan::VulkanApplication* application,
+                 vulkan::VkCommandBuffer* cmdBuffer,
+                 vulkan::VulkanApplication::Buffer* dst, const uint8_t* data,
+                 size_t size) {
+    for (size_t offset = 0; offset < size; offset += MAX_MODEL_STAGING_SIZE) {
+      size_t chunk_size = size - offset < MAX_MODEL_STAGING_SIZE
+                              ? size - offset
+                              : MAX_MODEL_STAGING_SIZE;
+      VkBufferCreateInfo create_info = {
+          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+          nullptr,                               // pNext
+          0,                                     // flags
+          chunk_size,                            // size
+          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // usage
+          VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+          0,                                     // queueFamilyIndexCount
+          nullptr                                // pQueueFamilyIndices
+      };
+      staging_buffers_.push_back(
+          application->CreateAndBindHostBuffer(&create_info));
+      vulkan::VulkanApplication::Buffer* staging =
+          staging_buffers_.back().get();
+      CopyToMappedMemory(application->job_system(), staging->base_address(),
+                         data + offset, chunk_size);
+      // Host writes that are flushed before the command buffer is submitted
+      // are visible to the copy without a barrier.
+      staging->flush();
+
+      VkBufferCopy region = {
+          staging->offset(),       // srcOffset
+          dst->offset() + offset,  // dstOffset
+          chunk_size,              // size
+      };
+      (*cmdBuffer)
+          ->vkCmdCopyBuffer(*cmdBuffer, *staging, *dst, 1, &region);
+    }
+  }
+
   const float* positions_;
   const float* texture_coords_;
   const float* normals_;
-  const uint32_t* indices_;
+  const void* indices_;
   size_t num_vertices_;
   size_t num_indices_;
   containers::Allocator* allocator_;
   logging::Logger* logger_;
-  const size_t vertex_data_size_;
+  size_t vertex_data_size_;
+  const VkIndexType index_type_;
   const size_t index_data_size_;
 
+  uint32_t layout_flags_;
+  VkFormat position_format_;
+  VkFormat texcoord_format_;
+  VkFormat normal_format_;
+  // Only used if the model is interleaved.
+  uint32_t texcoord_offset_;
+  uint32_t normal_offset_;
+  uint32_t vertex_stride_;
+  float position_scale_[3];
+  float position_bias_[3];
+  // The converted vertex data, if the model is not planar.
+  containers::vector<uint8_t> packed_vertices_;
+  // The data that is uploaded to vertexBuffer_.
+  const uint8_t* upload_vertices_;
+
   containers::unique_ptr<vulkan::VulkanApplication::Buffer> vertexBuffer_;
   containers::unique_ptr<vulkan::VulkanApplication::Buffer> indexBuffer_;
+  containers::vector<containers::unique_ptr<vulkan::VulkanApplication::Buffer>>
+      staging_buffers_;
 };
 
 }  // namespace vulkan
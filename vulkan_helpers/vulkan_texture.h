@@ -19,12 +19,13 @@
 #include "support/containers/allocator.h"
 #include "support/containers/vector.h"
 #include "support/log/log.h"
+#include "vulkan_helpers/asset_file.h"
+#include "vulkan_helpers/host_copy.h"
 #include "vulkan_helpers/vulkan_application.h"
 
 #include <initializer_list>
 
 namespace vulkan {
-// TODO(awoloszyn): Handle MIP chains.
 // TODO(awoloszyn): Handle Arrays.
 // TODO(awoloszyn): Handle cube-maps.
 struct VulkanTexture {
@@ -42,6 +43,7 @@ struct VulkanTexture {
       : allocator_(allocator),
         logger_(logger),
         format_(format),
+        uncompressed_format_(format),
         width_(width),
         height_(height),
         data_(data),
@@ -50,6 +52,14 @@ struct VulkanTexture {
         multiplanar_plane_count_(multiplanar_plane_count),
         downsampled_width_(downsampled_width),
         downsampled_height_(downsampled_height),
+        mip_levels_(1),
+        mip_filter_(VK_FILTER_LINEAR),
+        upload_data_(data),
+        upload_data_size_(data_size),
+        compressed_alternatives_(allocator),
+        streaming_budget_(0),
+        streaming_retire_delay_(0),
+        evictable_(false),
         image_(nullptr) {}
 
   // Constructs a vulkan model from the output of the convert_img_to_c.py
@@ -65,6 +75,76 @@ struct VulkanTexture {
                       sparse_binding_block_size, multiplanar_plane_count,
                       downsampled_width, downsampled_height) {}
 
+  // Constructs a vulkan texture from a binary asset file written by
+  // convert_img_to_c.py --binary. The texel data is used directly from
+  // |file|, so |file| must outlive this texture.
+  VulkanTexture(containers::Allocator* allocator, logging::Logger* logger,
+                const AssetFile& file, size_t sparse_binding_block_size = 0u,
+                size_t multiplanar_plane_count = 0u,
+                size_t downsampled_width = 0u,
+                size_t downsampled_height = 0u)
+      : VulkanTexture(allocator, logger,
+                      static_cast<VkFormat>(AssetInfo(file)->format),
+                      AssetInfo(file)->width, AssetInfo(file)->height,
+                      file.section(kAssetTextureData),
+                      file.section_size(kAssetTextureData),
+                      sparse_binding_block_size, multiplanar_plane_count,
+                      downsampled_width, downsampled_height) {}
+
+  // Adds a block-compressed copy of this texture, as written by
+  // convert_img_to_c.py --compressed. InitializeData uses the first copy
+  // whose format the device can sample from, and the uncompressed data if
+  // there is none.
+  template <typename T>
+  void AddCompressedAlternative(const T& t) {
+    LOG_ASSERT(==, logger_, static_cast<size_t>(t.width), width_);
+    LOG_ASSERT(==, logger_, static_cast<size_t>(t.height), height_);
+    LOG_ASSERT(==, logger_,
+               ((width_ + t.block_width - 1) / t.block_width) *
+                   ((height_ + t.block_height - 1) / t.block_height) *
+                   t.block_size,
+               sizeof(t.data));
+    compressed_alternatives_.push_back(
+        {t.format, static_cast<const void*>(t.data), sizeof(t.data)});
+  }
+
+  // Makes InitializeData create a sparse resident image instead, with a
+  // single level and without any compressed alternative. Only the pages
+  // that are asked for with RequestRegion are bound, and at most
+  // |memory_budget| bytes of them at a time. Their texels are uploaded by
+  // UpdateResidency. |retire_delay| is the number of calls to
+  // UpdateResidency after which the memory of an unbound page can be reused,
+  // and should be at least the number of frames in flight.
+  // This must be called before InitializeData, and the device must have been
+  // created with the sparseResidencyImage2D feature.
+  void EnableStreaming(VkDeviceSize memory_budget, uint32_t retire_delay) {
+    LOG_ASSERT(==, logger_, 0u, sparse_binding_block_size_);
+    LOG_ASSERT(==, logger_, false, IsFormatMultiplanar(format_));
+    LOG_ASSERT(!=, logger_, 0u, memory_budget);
+    streaming_budget_ = memory_budget;
+    streaming_retire_delay_ = retire_delay;
+  }
+
+  // Lets the application evict the image of this texture to host memory
+  // when it runs out of device memory, see
+  // VulkanApplication::ManageImageResidency. MarkUsed then has to be called
+  // every frame that the texture is used in. This must be called before
+  // InitializeData, and only applies to textures that are neither sparse
+  // nor multiplanar, and that are created without a pNext.
+  void EnableEviction() { evictable_ = true; }
+
+  // Records that the texture is used in the current frame, and restores its
+  // image if it was evicted. Returns true in that case, the image and its
+  // view have then been re-created, and descriptors that refer to the view
+  // have to be written again.
+  bool MarkUsed(vulkan::VulkanApplication* application) {
+    if (!evictable_ || !image_ || !application->MarkImageUsed(image_.get())) {
+      return false;
+    }
+    CreateView(application, nullptr);
+    return true;
+  }
+
   // Creates the image object.
   // Also creates a temporary buffer object for the upload data
   // If this image has already been initialized, then this re-initializes it.
@@ -72,25 +152,306 @@ struct VulkanTexture {
   // be safely deleted once the given command buffer has executed.
   // The image is transitioned into "VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL"
   // during the upload operation.
+  // If |generate_mips| is true, the full mip chain is created and filled
+  // on the GPU by blitting each level into the next. This is only done for
+  // textures that are neither sparse nor multiplanar, and whose format can
+  // be blitted; other textures only get a single level.
   void InitializeData(vulkan::VulkanApplication* application,
                       vulkan::VkCommandBuffer* cmdBuffer,
                       VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT,
-                      VkImageCreateFlags flags = 0,
-                      void* pNext = nullptr) {
+                      VkImageCreateFlags flags = 0, void* pNext = nullptr,
+                      bool generate_mips = false) {
+    CreateImage(application, usage, flags, pNext, generate_mips);
+    if (streaming_image_ != nullptr) {
+      // Nothing is resident yet, so there is nothing to upload.
+      VkImageMemoryBarrier barrier = GetUploadBarrier();
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      (*cmdBuffer)
+          ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+      return;
+    }
+
     VkBufferCreateInfo create_info = {
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
         nullptr,                               // pNext
         0,                                     // flags
-        data_size_,                            // size
+        upload_data_size_,                     // size
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // usage
         VK_SHARING_MODE_EXCLUSIVE,
         0,
         nullptr};
     upload_buffer_ = application->CreateAndBindHostBuffer(&create_info);
-    void* copy_base = upload_buffer_->base_address();
-    memcpy(copy_base, data_, data_size_);
+    CopyToMappedMemory(application->job_system(),
+                       upload_buffer_->base_address(), upload_data_,
+                       upload_data_size_);
     upload_buffer_->flush();
 
+    VkImageMemoryBarrier barrier = GetUploadBarrier();
+    VkBufferMemoryBarrier buffer_barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_HOST_WRITE_BIT,                 // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT,              // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *upload_buffer_,                          // buffer
+        0,                                        // offset
+        upload_data_size_,                        // size
+    };
+
+    (*cmdBuffer)
+        ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_HOST_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                               &buffer_barrier, 1, &barrier);
+
+    VkBufferImageCopy copy_params[3];
+    uint32_t num_copies = GetCopyRegions(0, copy_params);
+    (*cmdBuffer)
+        ->vkCmdCopyBufferToImage(*cmdBuffer, *upload_buffer_, image(),
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 num_copies, copy_params);
+    GenerateMips(cmdBuffer, mip_filter_);
+
+    VkImageMemoryBarrier final_barriers[2];
+    uint32_t num_final_barriers = GetFinalBarriers(final_barriers);
+    (*cmdBuffer)
+        ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, 0, 0,
+                               nullptr, 0, nullptr, num_final_barriers,
+                               final_barriers);
+  }
+
+  // Returns the number of levels in a full mip chain for an image of the
+  // given size.
+  static uint32_t GetMipLevelCount(size_t width, size_t height) {
+    size_t largest = width > height ? width : height;
+    uint32_t levels = 1;
+    while (largest > 1) {
+      largest >>= 1;
+      ++levels;
+    }
+    return levels;
+  }
+
+  // When the initialiation is complete, call this method, and the temporary
+  // buffer will be released.
+  void InitializationComplete() { upload_buffer_.reset(); }
+
+  // Asks for the pages of a streaming texture that overlap the given region
+  // of texels to be resident after the next call to UpdateResidency.
+  void RequestRegion(VkOffset2D offset, VkExtent2D extent) {
+    streaming_image_->RequestRegion(0, offset, extent);
+  }
+
+  // Binds the pages of a streaming texture that were requested since the
+  // last call, unbinding the least recently requested ones if the budget
+  // requires it, and records the upload of the texels of the newly bound
+  // pages into |cmdBuffer|. If |signal_semaphore| is not VK_NULL_HANDLE it
+  // is signaled once the binds are done, and |cmdBuffer| must be submitted
+  // to wait on it. Otherwise this waits for the binds to complete.
+  // Returns the temporary buffer used for the upload, which has to be kept
+  // alive until |cmdBuffer| has executed, or nullptr if no page was bound.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> UpdateResidency(
+      vulkan::VulkanApplication* application,
+      vulkan::VkCommandBuffer* cmdBuffer, ::VkSemaphore signal_semaphore) {
+    containers::vector<VkSparseImageMemoryBind> bound_pages(allocator_);
+    streaming_image_->UpdateResidency(signal_semaphore, &bound_pages);
+    if (bound_pages.empty()) {
+      return nullptr;
+    }
+
+    // Copies have to start at a multiple of both the texel size and 4.
+    const size_t texel_size = data_size_ / (width_ * height_);
+    const size_t alignment = texel_size * 4;
+    containers::vector<VkBufferImageCopy> copies(allocator_);
+    size_t size = 0;
+    for (const auto& page : bound_pages) {
+      size = (size + alignment - 1) / alignment * alignment;
+      copies.push_back({
+          size,                                  // bufferOffset
+          0,                                     // bufferRowLength
+          0,                                     // bufferImageHeight
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // imageSubresource
+          {page.offset.x, page.offset.y, 0},     // offset
+          page.extent                            // extent
+      });
+      size += page.extent.width * page.extent.height * texel_size;
+    }
+
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        size,                                  // size
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // usage
+        VK_SHARING_MODE_EXCLUSIVE,
+        0,
+        nullptr};
+    auto buffer = application->CreateAndBindUploadBuffer(&create_info);
+    char* base = buffer->base_address();
+    const char* data = static_cast<const char*>(data_);
+    for (const auto& copy : copies) {
+      const size_t row_size = copy.imageExtent.width * texel_size;
+      for (uint32_t row = 0; row < copy.imageExtent.height; ++row) {
+        StreamToMappedMemory(base + copy.bufferOffset + row * row_size,
+                             data + ((copy.imageOffset.y + row) * width_ +
+                                     copy.imageOffset.x) *
+                                        texel_size,
+                             row_size);
+      }
+    }
+    buffer->flush();
+
+    VkImageMemoryBarrier barrier = GetUploadBarrier();
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    (*cmdBuffer)
+        ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                               nullptr, 1, &barrier);
+    (*cmdBuffer)
+        ->vkCmdCopyBufferToImage(*cmdBuffer, *buffer, image(),
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 static_cast<uint32_t>(copies.size()),
+                                 copies.data());
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    (*cmdBuffer)
+        ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, 0, 0,
+                               nullptr, 0, nullptr, 1, &barrier);
+    return buffer;
+  }
+
+  ::VkImage image() const {
+    if (streaming_image_ != nullptr) {
+      return *streaming_image_;
+    }
+    return image_ != nullptr ? ::VkImage(*image_) : ::VkImage(*sparse_image_);
+  }
+  // Returns the streaming image, or nullptr if EnableStreaming was not
+  // called.
+  vulkan::VulkanApplication::StreamingSparseImage* streaming_image() const {
+    return streaming_image_.get();
+  }
+  ::VkImageView view() const { return *image_view_; }
+
+  // Return true if format is multiplanar
+  bool IsFormatMultiplanar(VkFormat format) {
+    return (format_ >= VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM &&
+            format_ <= VK_FORMAT_G8_B8_R8_3PLANE_444_UNORM) ||
+           (format_ >= VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_420_UNORM_3PACK16 &&
+            format_ <= VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_444_UNORM_3PACK16) ||
+           (format_ >= VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_420_UNORM_3PACK16 &&
+            format_ <= VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_444_UNORM_3PACK16) ||
+           (format_ >= VK_FORMAT_G16_B16_R16_3PLANE_420_UNORM &&
+            format_ <= VK_FORMAT_G16_B16_R16_3PLANE_444_UNORM);
+  }
+
+  // Return true if format downsamples width
+  bool FormatDownsamplesWidth(VkFormat format) {
+    return format_ == VK_FORMAT_G8B8G8R8_422_UNORM ||
+           format_ == VK_FORMAT_B8G8R8G8_422_UNORM ||
+           format_ == VK_FORMAT_G8_B8_R8_3PLANE_422_UNORM ||
+           format_ == VK_FORMAT_G8_B8R8_2PLANE_422_UNORM ||
+           format_ == VK_FORMAT_G10X6B10X6G10X6R10X6_422_UNORM_4PACK16 ||
+           format_ == VK_FORMAT_B10X6G10X6R10X6G10X6_422_UNORM_4PACK16 ||
+           format_ == VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_422_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G10X6_B10X6R10X6_2PLANE_422_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G12X4B12X4G12X4R12X4_422_UNORM_4PACK16 ||
+           format_ == VK_FORMAT_B12X4G12X4R12X4G12X4_422_UNORM_4PACK16 ||
+           format_ == VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_422_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G12X4_B12X4R12X4_2PLANE_422_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G16B16G16R16_422_UNORM ||
+           format_ == VK_FORMAT_B16G16R16G16_422_UNORM ||
+           format_ == VK_FORMAT_G16_B16_R16_3PLANE_422_UNORM ||
+           format_ == VK_FORMAT_G16_B16R16_2PLANE_422_UNORM;
+  }
+
+  // Return true if format downsamples width and height
+  bool FormatDownsamplesWidthAndHeight(VkFormat format) {
+    return format_ == VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM ||
+           format_ == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM ||
+           format_ == VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_420_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G10X6_B10X6R10X6_2PLANE_420_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_420_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G12X4_B12X4R12X4_2PLANE_420_UNORM_3PACK16 ||
+           format_ == VK_FORMAT_G16_B16_R16_3PLANE_420_UNORM ||
+           format_ == VK_FORMAT_G16_B16R16_2PLANE_420_UNORM;
+  }
+
+ private:
+  static const AssetTextureInfo* AssetInfo(const AssetFile& file) {
+    return reinterpret_cast<const AssetTextureInfo*>(
+        file.section(kAssetTextureInfo));
+  }
+
+  friend class UploadBatch;
+
+  // Picks the format to upload, and creates the image and its view. After
+  // this upload_data_ and upload_data_size_ hold the texels that have to be
+  // copied into the image, and mip_filter_ the filter to generate the mip
+  // levels with.
+  void CreateImage(vulkan::VulkanApplication* application,
+                   VkImageUsageFlags usage, VkImageCreateFlags flags,
+                   void* pNext, bool generate_mips) {
+    format_ = uncompressed_format_;
+    upload_data_ = data_;
+    upload_data_size_ = data_size_;
+    // Compressed formats can only be sampled from.
+    const VkImageUsageFlags compressed_usage = VK_IMAGE_USAGE_SAMPLED_BIT |
+                                               VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                               VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (sparse_binding_block_size_ == 0u && streaming_budget_ == 0u &&
+        (usage & ~compressed_usage) == 0) {
+      for (const auto& alternative : compressed_alternatives_) {
+        VkFormatProperties format_properties;
+        application->instance()->vkGetPhysicalDeviceFormatProperties(
+            application->device().physical_device(), alternative.format,
+            &format_properties);
+        if (format_properties.optimalTilingFeatures &
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) {
+          format_ = alternative.format;
+          upload_data_ = alternative.data;
+          upload_data_size_ = alternative.data_size;
+          break;
+        }
+      }
+    }
+
+    mip_levels_ = 1;
+    mip_filter_ = VK_FILTER_LINEAR;
+    if (generate_mips && sparse_binding_block_size_ == 0u &&
+        streaming_budget_ == 0u && !IsFormatMultiplanar(format_)) {
+      VkFormatProperties format_properties;
+      application->instance()->vkGetPhysicalDeviceFormatProperties(
+          application->device().physical_device(), format_,
+          &format_properties);
+      const VkFormatFeatureFlags blit_features =
+          VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+      if ((format_properties.optimalTilingFeatures & blit_features) ==
+          blit_features) {
+        mip_levels_ = GetMipLevelCount(width_, height_);
+        if (!(format_properties.optimalTilingFeatures &
+              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+          mip_filter_ = VK_FILTER_NEAREST;
+        }
+      } else {
+        logger_->LogInfo(
+            "Texture format can not be blitted, not generating mip levels");
+      }
+    }
+    if (mip_levels_ > 1 || evictable_) {
+      // Each level is blitted from the one above it, and evicted images are
+      // copied out.
+      usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
     VkImageCreateInfo image_create_info = {
         VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
         pNext,                                // pNext
@@ -99,7 +460,7 @@ struct VulkanTexture {
         format_,                              // format
         {static_cast<uint32_t>(width_), static_cast<uint32_t>(height_),
          1},                                      // Extent
-        1,                                        // mipLevels
+        mip_levels_,                              // mipLevels
         1,                                        // arrayLayers
         VK_SAMPLE_COUNT_1_BIT,                    // sampleCount
         VK_IMAGE_TILING_OPTIMAL,                  // tiling
@@ -109,7 +470,10 @@ struct VulkanTexture {
         nullptr,                                  // pQueueFamilyIndices
         VK_IMAGE_LAYOUT_UNDEFINED                 // initialLayout
     };
-    if (sparse_binding_block_size_ > 0u) {
+    if (streaming_budget_ > 0u) {
+      streaming_image_ = application->CreateStreamingSparseImage(
+          &image_create_info, streaming_budget_, streaming_retire_delay_);
+    } else if (sparse_binding_block_size_ > 0u) {
       image_create_info.flags =
           image_create_info.flags | VK_IMAGE_CREATE_SPARSE_BINDING_BIT;
       sparse_image_ = application->CreateAndBindSparseImage(&image_create_info,
@@ -151,8 +515,16 @@ struct VulkanTexture {
     }
     else {
       image_ = application->CreateAndBindImage(&image_create_info);
+      if (evictable_ && image_->movable()) {
+        application->ManageImageResidency(
+            image_.get(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      }
     }
+    CreateView(application, pNext);
+  }
 
+  // Creates the view of the image, with |pNext| in its create info.
+  void CreateView(vulkan::VulkanApplication* application, void* pNext) {
     VkImageViewCreateInfo view_create_info = {
         VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
         pNext,                                     // pNext
@@ -162,7 +534,7 @@ struct VulkanTexture {
         format_,                                   // format
         {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
          VK_COMPONENT_SWIZZLE_A},
-        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels_, 0, 1}};
 
     ::VkImageView raw_view;
     LOG_ASSERT(
@@ -172,7 +544,11 @@ struct VulkanTexture {
     image_view_ = containers::make_unique<vulkan::VkImageView>(
         allocator_,
         vulkan::VkImageView(raw_view, nullptr, &application->device()));
+  }
 
+  // Returns the barrier that moves every level of the image from
+  // UNDEFINED into TRANSFER_DST_OPTIMAL, for the upload.
+  VkImageMemoryBarrier GetUploadBarrier() {
     VkImageMemoryBarrier barrier = {
         VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
         nullptr,                                 // pNext
@@ -183,28 +559,18 @@ struct VulkanTexture {
         VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
         VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
         image(),                                 // image
-        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
-    VkBufferMemoryBarrier buffer_barrier = {
-        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
-        nullptr,                                  // pNext
-        VK_ACCESS_HOST_WRITE_BIT,                 // srcAccessMask
-        VK_ACCESS_TRANSFER_READ_BIT,              // dstAccessMask
-        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
-        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
-        *upload_buffer_,                          // buffer
-        0,                                        // offset
-        data_size_,                               // size
-    };
-
-    (*cmdBuffer)
-        ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_HOST_BIT,
-                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
-                               &buffer_barrier, 1, &barrier);
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels_, 0, 1}};
+    return barrier;
+  }
 
+  // Writes the copies from upload data at |buffer_offset| into the image to
+  // |regions|, and returns how many there are.
+  uint32_t GetCopyRegions(VkDeviceSize buffer_offset,
+                          VkBufferImageCopy regions[3]) {
     if (multiplanar_plane_count_ > 1) {
-      VkBufferImageCopy copy_params[3] = {
+      const VkBufferImageCopy copy_params[3] = {
           {
-              0,                                       // bufferOffset
+              buffer_offset,                           // bufferOffset
               0,                                       // bufferRowLength
               0,                                       // bufferImageHeight
               {VK_IMAGE_ASPECT_PLANE_0_BIT, 0, 0, 1},  // imageSubresource
@@ -213,7 +579,7 @@ struct VulkanTexture {
                1}  // extent
           },
           {
-              width_ * height_,                        // bufferOffset
+              buffer_offset + width_ * height_,        // bufferOffset
               0,                                       // bufferRowLength
               0,                                       // bufferImageHeight
               {VK_IMAGE_ASPECT_PLANE_1_BIT, 0, 0, 1},  // imageSubresource
@@ -222,7 +588,7 @@ struct VulkanTexture {
                static_cast<uint32_t>(downsampled_height_), 1}  // extent
           },
           {
-              width_ * height_ +
+              buffer_offset + width_ * height_ +
                   downsampled_width_ * downsampled_height_,  // bufferOffset
               0,                                             // bufferRowLength
               0,                                       // bufferImageHeight
@@ -233,91 +599,100 @@ struct VulkanTexture {
           },
       };
 
-      (*cmdBuffer)
-          ->vkCmdCopyBufferToImage(*cmdBuffer, *upload_buffer_, image(),
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                   multiplanar_plane_count_, copy_params);
-    } else {
-      VkBufferImageCopy copy_params = {
-          0,                                     // bufferOffset
-          0,                                     // bufferRowLength
-          0,                                     // bufferImageHeight
-          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // imageSubresource
-          {0, 0, 0},                             // offset
-          {static_cast<uint32_t>(width_), static_cast<uint32_t>(height_),
-           1}  // extent
-      };
-
-      (*cmdBuffer)
-          ->vkCmdCopyBufferToImage(*cmdBuffer, *upload_buffer_, image(),
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                                   &copy_params);
+      for (uint32_t i = 0; i < multiplanar_plane_count_; ++i) {
+        regions[i] = copy_params[i];
+      }
+      return static_cast<uint32_t>(multiplanar_plane_count_);
     }
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    (*cmdBuffer)
-        ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                               VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, 0, 0,
-                               nullptr, 0, nullptr, 1, &barrier);
+    const VkBufferImageCopy copy_params = {
+        buffer_offset,                         // bufferOffset
+        0,                                     // bufferRowLength
+        0,                                     // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // imageSubresource
+        {0, 0, 0},                             // offset
+        {static_cast<uint32_t>(width_), static_cast<uint32_t>(height_),
+         1}  // extent
+    };
+    regions[0] = copy_params;
+    return 1;
   }
 
-  // When the initialiation is complete, call this method, and the temporary
-  // buffer will be released.
-  void InitializationComplete() { upload_buffer_.reset(); }
-
-  ::VkImage image() const {
-    return image_ != nullptr ? ::VkImage(*image_) : ::VkImage(*sparse_image_);
+  // Writes the barriers that move the image from the state the upload left
+  // it in to SHADER_READ_ONLY_OPTIMAL to |final_barriers|, and returns how
+  // many there are.
+  uint32_t GetFinalBarriers(VkImageMemoryBarrier final_barriers[2]) {
+    // Every level but the last one was left in TRANSFER_SRC by GenerateMips.
+    VkImageMemoryBarrier barrier = GetUploadBarrier();
+    final_barriers[0] = barrier;
+    final_barriers[1] = barrier;
+    final_barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    final_barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    final_barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    final_barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    final_barriers[0].subresourceRange.baseMipLevel = mip_levels_ - 1;
+    final_barriers[0].subresourceRange.levelCount = 1;
+    final_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    final_barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    final_barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    final_barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    final_barriers[1].subresourceRange.baseMipLevel = 0;
+    final_barriers[1].subresourceRange.levelCount = mip_levels_ - 1;
+    return mip_levels_ > 1 ? 2 : 1;
   }
-  ::VkImageView view() const { return *image_view_; }
 
-  // Return true if format is multiplanar
-  bool IsFormatMultiplanar(VkFormat format) {
-    return (format_ >= VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM &&
-            format_ <= VK_FORMAT_G8_B8_R8_3PLANE_444_UNORM) ||
-           (format_ >= VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_420_UNORM_3PACK16 &&
-            format_ <= VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_444_UNORM_3PACK16) ||
-           (format_ >= VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_420_UNORM_3PACK16 &&
-            format_ <= VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_444_UNORM_3PACK16) ||
-           (format_ >= VK_FORMAT_G16_B16_R16_3PLANE_420_UNORM &&
-            format_ <= VK_FORMAT_G16_B16_R16_3PLANE_444_UNORM);
-  }
+  // A block-compressed copy of the texture.
+  struct CompressedAlternative {
+    VkFormat format;
+    const void* data;
+    size_t data_size;
+  };
 
-  // Return true if format downsamples width
-  bool FormatDownsamplesWidth(VkFormat format) {
-    return format_ == VK_FORMAT_G8B8G8R8_422_UNORM ||
-           format_ == VK_FORMAT_B8G8R8G8_422_UNORM ||
-           format_ == VK_FORMAT_G8_B8_R8_3PLANE_422_UNORM ||
-           format_ == VK_FORMAT_G8_B8R8_2PLANE_422_UNORM ||
-           format_ == VK_FORMAT_G10X6B10X6G10X6R10X6_422_UNORM_4PACK16 ||
-           format_ == VK_FORMAT_B10X6G10X6R10X6G10X6_422_UNORM_4PACK16 ||
-           format_ == VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_422_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G10X6_B10X6R10X6_2PLANE_422_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G12X4B12X4G12X4R12X4_422_UNORM_4PACK16 ||
-           format_ == VK_FORMAT_B12X4G12X4R12X4G12X4_422_UNORM_4PACK16 ||
-           format_ == VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_422_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G12X4_B12X4R12X4_2PLANE_422_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G16B16G16R16_422_UNORM ||
-           format_ == VK_FORMAT_B16G16R16G16_422_UNORM ||
-           format_ == VK_FORMAT_G16_B16_R16_3PLANE_422_UNORM ||
-           format_ == VK_FORMAT_G16_B16R16_2PLANE_422_UNORM;
-  }
+  // Fills mip levels 1 and up of the image by blitting every level into the
+  // next one with |filter|. Level 0 must be in TRANSFER_DST_OPTIMAL. Every
+  // level but the last one is left in TRANSFER_SRC_OPTIMAL, and the last one
+  // in TRANSFER_DST_OPTIMAL.
+  void GenerateMips(vulkan::VkCommandBuffer* cmdBuffer, VkFilter filter) {
+    int32_t width = static_cast<int32_t>(width_);
+    int32_t height = static_cast<int32_t>(height_);
+    for (uint32_t level = 1; level < mip_levels_; ++level) {
+      VkImageMemoryBarrier barrier = {
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+          nullptr,                                 // pNext
+          VK_ACCESS_TRANSFER_WRITE_BIT,            // srcAccessMask
+          VK_ACCESS_TRANSFER_READ_BIT,             // dstAccessMask
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,    // oldLayout
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,    // newLayout
+          VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+          image(),                                 // image
+          {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1, 0, 1}};
+      (*cmdBuffer)
+          ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                                 0, nullptr, 1, &barrier);
 
-  // Return true if format downsamples width and height
-  bool FormatDownsamplesWidthAndHeight(VkFormat format) {
-    return format_ == VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM ||
-           format_ == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM ||
-           format_ == VK_FORMAT_G10X6_B10X6_R10X6_3PLANE_420_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G10X6_B10X6R10X6_2PLANE_420_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G12X4_B12X4_R12X4_3PLANE_420_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G12X4_B12X4R12X4_2PLANE_420_UNORM_3PACK16 ||
-           format_ == VK_FORMAT_G16_B16_R16_3PLANE_420_UNORM ||
-           format_ == VK_FORMAT_G16_B16R16_2PLANE_420_UNORM;
+      int32_t next_width = width > 1 ? width / 2 : 1;
+      int32_t next_height = height > 1 ? height / 2 : 1;
+      VkImageBlit blit = {
+          {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},  // srcSubresource
+          {{0, 0, 0}, {width, height, 1}},               // srcOffsets
+          {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},      // dstSubresource
+          {{0, 0, 0}, {next_width, next_height, 1}},     // dstOffsets
+      };
+      (*cmdBuffer)
+          ->vkCmdBlitImage(*cmdBuffer, image(),
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image(),
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                           filter);
+      width = next_width;
+      height = next_height;
+    }
   }
 
- private:
+  // The format of the image, which is one of the compressed formats once
+  // InitializeData has picked one.
   VkFormat format_;
+  VkFormat uncompressed_format_;
   size_t width_;
   size_t height_;
   const void* data_;
@@ -328,10 +703,21 @@ struct VulkanTexture {
   size_t multiplanar_plane_count_;
   size_t downsampled_width_;
   size_t downsampled_height_;
+  uint32_t mip_levels_;
+  VkFilter mip_filter_;
+  // The data and size of the format that InitializeData picked.
+  const void* upload_data_;
+  size_t upload_data_size_;
+  containers::vector<CompressedAlternative> compressed_alternatives_;
+  VkDeviceSize streaming_budget_;
+  uint32_t streaming_retire_delay_;
+  bool evictable_;
 
   containers::unique_ptr<vulkan::VulkanApplication::Buffer> upload_buffer_;
   containers::unique_ptr<vulkan::VulkanApplication::Image> image_;
   containers::unique_ptr<vulkan::VulkanApplication::SparseImage> sparse_image_;
+  containers::unique_ptr<vulkan::VulkanApplication::StreamingSparseImage>
+      streaming_image_;
   containers::unique_ptr<vulkan::VkImageView> image_view_;
 };
 
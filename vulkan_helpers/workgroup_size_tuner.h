@@ -0,0 +1,275 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_WORKGROUP_SIZE_TUNER_H
+#define VULKAN_HELPERS_WORKGROUP_SIZE_TUNER_H
+
+#include "support/containers/vector.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/occupancy_estimator.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+
+namespace vulkan {
+
+// WorkgroupSizeTuner picks the local_size_x of a one dimensional compute
+// shader for the device. The candidates are multiples of the subgroup size
+// of the device, up to its workgroup limits, that divide the number of
+// invocations. Each one is timed with timestamp queries, and the fastest is
+// kept. With -pipeline-cache-dir, the result is stored next to the pipeline
+// cache, and later runs on the same device and driver load it instead of
+// tuning again.
+//
+// The shader should take its size from a specialization constant, e.g.
+//   layout(local_size_x = 128, local_size_x_id = 0) in;
+//
+// Example:
+//   WorkgroupSizeTuner tuner(app, "particle_update", 128, num_particles);
+//   if (!tuner.tuned()) {
+//     tuner.Tune(queue, [&](VkCommandBuffer* cmd, uint32_t local_size) {
+//       // Create a pipeline for local_size that outlives Tune, bind it,
+//       // and dispatch num_particles / local_size workgroups.
+//     });
+//   }
+//   uint32_t local_size = tuner.local_size();
+class WorkgroupSizeTuner {
+ public:
+  // The number of times that every candidate is timed, the fastest time
+  // counts.
+  static const uint32_t kNumRuns = 3;
+
+  // |name| identifies the shader in the stored result, and has to outlive
+  // the tuner. |default_size| is
+  // used until the shader is tuned, and if it can not be.
+  WorkgroupSizeTuner(VulkanApplication* application, const char* name,
+                     uint32_t default_size, uint32_t num_invocations)
+      : application_(application),
+        name_(name),
+        candidates_(application->GetAllocator()),
+        local_size_(default_size),
+        tuned_(false) {
+    const VkPhysicalDeviceLimits& limits = application_->device().limits();
+    uint32_t max_size = limits.maxComputeWorkGroupSize[0];
+    if (limits.maxComputeWorkGroupInvocations < max_size) {
+      max_size = limits.maxComputeWorkGroupInvocations;
+    }
+    const uint32_t subgroup_size = GetSubgroupSize();
+    for (uint32_t size = subgroup_size; size <= max_size; size *= 2) {
+      if (num_invocations % size == 0) {
+        candidates_.push_back(size);
+      }
+    }
+
+    const char* prefix = application_->entry_data()->pipeline_cache_prefix();
+    if (prefix && prefix[0] != '\0') {
+      path_ = GetPipelineCachePath(&application_->device(), prefix) + "." +
+              name + ".workgroup_size";
+      std::ifstream file(path_);
+      uint32_t size = 0;
+      // A stored size that is not one of the candidates, e.g. from another
+      // device, or for another number of invocations, is tuned again rather
+      // than used for a pipeline that the device can not run.
+      if (file >> size && std::find(candidates_.begin(), candidates_.end(),
+                                    size) != candidates_.end()) {
+        local_size_ = size;
+        tuned_ = true;
+      }
+    }
+  }
+
+  // True if local_size() was tuned, by this or an earlier run.
+  bool tuned() const { return tuned_; }
+  uint32_t local_size() const { return local_size_; }
+  const containers::vector<uint32_t>& candidates() const {
+    return candidates_;
+  }
+
+  // Drops the candidates with a lower theoretical occupancy than the best
+  // ones, for a shader that uses |resources| at every size, e.g. as
+  // VK_AMD_shader_info reports them for the default size, so that Tune()
+  // does not time sizes that can not fill the SIMDs as well. Does nothing if
+  // |estimator| is not valid.
+  void PruneCandidates(const OccupancyEstimator& estimator,
+                       const ShaderResources& resources) {
+    if (!estimator.valid()) {
+      return;
+    }
+    uint32_t best = 0;
+    for (uint32_t size : candidates_) {
+      best = std::max(best, estimator.WavefrontsPerSimd(resources, size));
+    }
+    size_t kept = 0;
+    for (uint32_t size : candidates_) {
+      if (estimator.WavefrontsPerSimd(resources, size) == best) {
+        candidates_[kept++] = size;
+      }
+    }
+    candidates_.resize(kept);
+  }
+
+  // Times every candidate on |queue|, and returns the fastest. |record|
+  // records the work of the shader with the given local size into the
+  // command buffer. Everything that it records has to stay valid until Tune
+  // returns. The queue is idle in between the candidates, and afterwards.
+  uint32_t Tune(
+      VkQueue* queue,
+      const std::function<void(VkCommandBuffer*, uint32_t)>& record) {
+    auto queue_family_properties = GetQueueFamilyProperties(
+        application_->GetAllocator(), application_->instance(),
+        application_->device().physical_device());
+    const uint32_t valid_bits =
+        queue_family_properties[queue->index()].timestampValidBits;
+    if (valid_bits == 0 || candidates_.empty()) {
+      return local_size_;
+    }
+    const uint64_t mask =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+    VkQueryPool pool = CreateQueryPool(
+        &application_->device(),
+        {
+            VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+            nullptr,                                   // pNext
+            0,                                         // flags
+            VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+            2,                                         // queryCount
+            0                                          // pipelineStatistics
+        });
+    VkCommandBuffer command_buffer =
+        application_->GetCommandBuffer(queue->index());
+
+    uint64_t best_ticks = ~uint64_t(0);
+    for (uint32_t size : candidates_) {
+      for (uint32_t run = 0; run < kNumRuns; ++run) {
+        command_buffer->vkBeginCommandBuffer(
+            command_buffer, &BeginInfo());
+        command_buffer->vkCmdResetQueryPool(command_buffer, pool, 0, 2);
+        command_buffer->vkCmdWriteTimestamp(
+            command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, 0);
+        record(&command_buffer, size);
+        command_buffer->vkCmdWriteTimestamp(
+            command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, 1);
+        command_buffer->vkEndCommandBuffer(command_buffer);
+
+        VkSubmitInfo submit_info = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+            nullptr,                        // pNext
+            0,                              // waitSemaphoreCount
+            nullptr,                        // pWaitSemaphores
+            nullptr,                        // pWaitDstStageMask
+            1,                              // commandBufferCount
+            &command_buffer.get_command_buffer(),  // pCommandBuffers
+            0,                                     // signalSemaphoreCount
+            nullptr                                // pSignalSemaphores
+        };
+        (*queue)->vkQueueSubmit(*queue, 1, &submit_info, ::VkFence(0));
+        (*queue)->vkQueueWaitIdle(*queue);
+
+        uint64_t timestamps[2];
+        if (application_->device()->vkGetQueryPoolResults(
+                application_->device(), pool, 0, 2, sizeof(timestamps),
+                timestamps, sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) !=
+            VK_SUCCESS) {
+          continue;
+        }
+        const uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+        if (ticks < best_ticks) {
+          best_ticks = ticks;
+          local_size_ = size;
+        }
+      }
+    }
+    if (best_ticks == ~uint64_t(0)) {
+      return local_size_;
+    }
+    tuned_ = true;
+    application_->GetLogger()->LogInfo(
+        "WORKGROUP_SIZE: ", name_, " local_size=", local_size_, " ms=",
+        best_ticks * application_->device().limits().timestampPeriod /
+            1000000.0);
+
+    if (!path_.empty()) {
+      std::ofstream file(path_);
+      if (!(file << local_size_ << "\n")) {
+        application_->GetLogger()->LogError("Could not write ", path_);
+      }
+    }
+    return local_size_;
+  }
+
+ private:
+  static const VkCommandBufferBeginInfo& BeginInfo() {
+    static const VkCommandBufferBeginInfo kBeginInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+        nullptr,                                      // pNext
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+        nullptr                                       // pInheritanceInfo
+    };
+    return kBeginInfo;
+  }
+
+  // Returns the subgroup size of the device, or 32 if it can not be queried.
+  // On AMD devices this is the wavefront size of
+  // VK_AMD_shader_core_properties as well.
+  uint32_t GetSubgroupSize() {
+    VkInstance& instance = application_->instance();
+    auto get_properties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+        instance.get_wrapper()->getProcAddr(instance,
+                                            "vkGetPhysicalDeviceProperties2"));
+    if (!get_properties2) {
+      get_properties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+          instance.get_wrapper()->getProcAddr(
+              instance, "vkGetPhysicalDeviceProperties2KHR"));
+    }
+    VkPhysicalDeviceSubgroupProperties subgroup_properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,  // sType
+        nullptr,                                                // pNext
+        0,                                                      // subgroupSize
+        0,                                                      // stages
+        0,                                                      // operations
+        VK_FALSE  // quadOperationsInAllStages
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,  // sType
+        &subgroup_properties,                            // pNext
+        {}                                               // properties
+    };
+    if (get_properties2) {
+      get_properties2(application_->device().physical_device(), &properties);
+    }
+    // Devices before Vulkan 1.1 leave the size at 0.
+    return subgroup_properties.subgroupSize != 0
+               ? subgroup_properties.subgroupSize
+               : 32;
+  }
+
+  VulkanApplication* application_;
+  const char* name_;
+  // Where the result is stored, empty if it is not.
+  std::string path_;
+  containers::vector<uint32_t> candidates_;
+  uint32_t local_size_;
+  bool tuned_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_WORKGROUP_SIZE_TUNER_H
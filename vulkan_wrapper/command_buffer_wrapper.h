@@ -29,15 +29,26 @@ namespace vulkan {
 // object. It provides lazily initialized function pointers for all of its
 // methods. It will automatically call VkFreeCommandBuffers when it goes out of
 // scope.
+//
+// Barriers can be queued with the Queue*Barrier methods instead of being
+// recorded right away. Queued barriers are merged into a single
+// vkCmdPipelineBarrier, with the stage masks of all of them, which is
+// recorded right before the next command that goes through this wrapper.
 class VkCommandBuffer {
  public:
+  // The most barriers of each kind that are queued, before they are flushed.
+  static const uint32_t kMaxQueuedBarriers = 8;
+
   VkCommandBuffer(VkCommandBuffer&& other)
       : command_buffer_(other.command_buffer_),
         pool_(other.pool_),
         device_(other.device_),
         log_(other.log_),
         destruction_function_(other.destruction_function_),
-        functions_(other.functions_) {
+        functions_(other.functions_),
+        device_mask_(other.device_mask_),
+        default_mask_(other.default_mask_),
+        queued_(other.queued_) {
     other.command_buffer_ = static_cast<::VkCommandBuffer>(VK_NULL_HANDLE);
   }
 
@@ -63,6 +74,8 @@ class VkCommandBuffer {
   logging::Logger* GetLogger() { return log_; }
 
   void set_device_mask(uint32_t device_mask) {
+    // Queued barriers belong to the devices of the old mask.
+    FlushBarriers();
     device_mask_ = device_mask;
     functions_->vkCmdSetDeviceMask(command_buffer_, device_mask);
   }
@@ -77,9 +90,73 @@ class VkCommandBuffer {
             VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO) {
       device_mask_ = dgcbbi->deviceMask;
     }
+    queued_.clear();
     functions_->vkBeginCommandBuffer(command_buffer_, begin_info);
   }
 
+  // Queues |barrier| from |src_stages| to |dst_stages|.
+  void QueueMemoryBarrier(VkPipelineStageFlags src_stages,
+                          VkPipelineStageFlags dst_stages,
+                          const VkMemoryBarrier& barrier,
+                          VkDependencyFlags dependency_flags = 0) {
+    PrepareQueue(dependency_flags, queued_.num_memory_barriers);
+    queued_.memory_barriers[queued_.num_memory_barriers++] = barrier;
+    queued_.src_stages |= src_stages;
+    queued_.dst_stages |= dst_stages;
+  }
+
+  // Queues |barrier| from |src_stages| to |dst_stages|. If a barrier for the
+  // same buffer is already queued, that one is flushed first.
+  void QueueBufferBarrier(VkPipelineStageFlags src_stages,
+                          VkPipelineStageFlags dst_stages,
+                          const VkBufferMemoryBarrier& barrier,
+                          VkDependencyFlags dependency_flags = 0) {
+    for (uint32_t i = 0; i < queued_.num_buffer_barriers; ++i) {
+      if (queued_.buffer_barriers[i].buffer == barrier.buffer) {
+        FlushBarriers();
+        break;
+      }
+    }
+    PrepareQueue(dependency_flags, queued_.num_buffer_barriers);
+    queued_.buffer_barriers[queued_.num_buffer_barriers++] = barrier;
+    queued_.src_stages |= src_stages;
+    queued_.dst_stages |= dst_stages;
+  }
+
+  // Queues |barrier| from |src_stages| to |dst_stages|. If a barrier for the
+  // same image is already queued, that one is flushed first, so that layout
+  // transitions of the image stay in order.
+  void QueueImageBarrier(VkPipelineStageFlags src_stages,
+                         VkPipelineStageFlags dst_stages,
+                         const VkImageMemoryBarrier& barrier,
+                         VkDependencyFlags dependency_flags = 0) {
+    for (uint32_t i = 0; i < queued_.num_image_barriers; ++i) {
+      if (queued_.image_barriers[i].image == barrier.image) {
+        FlushBarriers();
+        break;
+      }
+    }
+    PrepareQueue(dependency_flags, queued_.num_image_barriers);
+    queued_.image_barriers[queued_.num_image_barriers++] = barrier;
+    queued_.src_stages |= src_stages;
+    queued_.dst_stages |= dst_stages;
+  }
+
+  // Records all of the queued barriers as one vkCmdPipelineBarrier. This
+  // happens automatically before the next command.
+  void FlushBarriers() {
+    if (queued_.empty()) {
+      return;
+    }
+    functions_->vkCmdPipelineBarrier(
+        command_buffer_, queued_.src_stages, queued_.dst_stages,
+        queued_.dependency_flags, queued_.num_memory_barriers,
+        queued_.memory_barriers, queued_.num_buffer_barriers,
+        queued_.buffer_barriers, queued_.num_image_barriers,
+        queued_.image_barriers);
+    queued_.clear();
+  }
+
  private:
   ::VkCommandBuffer command_buffer_;
   ::VkCommandPool pool_;
@@ -91,11 +168,61 @@ class VkCommandBuffer {
   uint32_t device_mask_ = 0;
   uint32_t default_mask_ = 0;
 
+  struct QueuedBarriers {
+    bool empty() const {
+      return num_memory_barriers == 0 && num_buffer_barriers == 0 &&
+             num_image_barriers == 0;
+    }
+    void clear() {
+      src_stages = 0;
+      dst_stages = 0;
+      dependency_flags = 0;
+      num_memory_barriers = 0;
+      num_buffer_barriers = 0;
+      num_image_barriers = 0;
+    }
+
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    VkDependencyFlags dependency_flags = 0;
+    uint32_t num_memory_barriers = 0;
+    uint32_t num_buffer_barriers = 0;
+    uint32_t num_image_barriers = 0;
+    VkMemoryBarrier memory_barriers[kMaxQueuedBarriers];
+    VkBufferMemoryBarrier buffer_barriers[kMaxQueuedBarriers];
+    VkImageMemoryBarrier image_barriers[kMaxQueuedBarriers];
+  };
+
+  // Flushes the queued barriers if a barrier with |dependency_flags| can not
+  // be merged with them, or if |num_queued| of its kind are queued already.
+  void PrepareQueue(VkDependencyFlags dependency_flags, uint32_t num_queued) {
+    if (!queued_.empty() && (queued_.dependency_flags != dependency_flags ||
+                             num_queued == kMaxQueuedBarriers)) {
+      FlushBarriers();
+    }
+    queued_.dependency_flags = dependency_flags;
+  }
+
+  // Barriers that have not been recorded yet.
+  QueuedBarriers queued_;
+
  public:
   const ::VkCommandBuffer& get_command_buffer() const { return command_buffer_; }
   operator ::VkCommandBuffer() const { return command_buffer_; }
-  CommandBufferFunctions* operator->() { return functions_; }
-  CommandBufferFunctions& operator*() { return *functions_; }
+  // Every command is recorded through these, so they flush the queued
+  // barriers first.
+  CommandBufferFunctions* operator->() {
+    if (!queued_.empty()) {
+      FlushBarriers();
+    }
+    return functions_;
+  }
+  CommandBufferFunctions& operator*() {
+    if (!queued_.empty()) {
+      FlushBarriers();
+    }
+    return *functions_;
+  }
 };
 
 }  // namespace vulkan
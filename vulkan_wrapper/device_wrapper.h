@@ -38,8 +38,8 @@ class VkDevice {
   VkDevice(VkDevice&& other) = default;
   // This does not retain a reference to the VkInstance, or the
   // VkAllocationCallbacks object, it does take ownership of the device.
-  // If properties is not nullptr, then the device_id, vendor_id and
-  // driver_version will be copied out of it.
+  // If properties is not nullptr, then the device_id, vendor_id,
+  // driver_version, pipeline_cache_uuid and limits will be copied out of it.
   VkDevice(containers::Allocator* container_allocator, ::VkDevice device,
            VkAllocationCallbacks* allocator, VkInstance* instance,
            VkPhysicalDeviceProperties* properties = nullptr,
@@ -53,6 +53,8 @@ class VkDevice {
         vendor_id_(0),
         driver_version_(0),
         physical_device_memory_properties_({0}),
+        pipeline_cache_uuid_{0},
+        limits_({0}),
         num_devices_(num_devices) {
     if (has_allocator_) {
       allocator_ = *allocator;
@@ -67,10 +69,14 @@ class VkDevice {
       device_id_ = properties->deviceID;
       vendor_id_ = properties->vendorID;
       driver_version_ = properties->driverVersion;
+      memcpy(pipeline_cache_uuid_, properties->pipelineCacheUUID,
+             VK_UUID_SIZE);
+      limits_ = properties->limits;
     }
-    // Initialize the lazily resolved device functions.
+    // Resolve the device functions straight from the driver up front, so
+    // that the functions called while recording commands never have to be.
     functions_ = containers::make_unique<DeviceFunctions>(
-        container_allocator, device_, vkGetDeviceProcAddr, log_);
+        container_allocator, device_, vkGetDeviceProcAddr, log_, true);
     if (physical_device) {
       (*instance)->vkGetPhysicalDeviceMemoryProperties(
           physical_device, &physical_device_memory_properties_);
@@ -91,6 +97,9 @@ class VkDevice {
   uint32_t device_id() const { return device_id_; }
   uint32_t vendor_id() const { return vendor_id_; }
   uint32_t driver_version() const { return driver_version_; }
+  const uint8_t* pipeline_cache_uuid() const { return pipeline_cache_uuid_; }
+  // All zero if no properties were given.
+  const VkPhysicalDeviceLimits& limits() const { return limits_; }
   uint32_t num_devices() const { return num_devices_; }
 
   bool is_valid() { return device_ != VK_NULL_HANDLE; }
@@ -98,6 +107,10 @@ class VkDevice {
   logging::Logger* GetLogger() { return log_; }
 
   DeviceFunctions* functions() { return functions_.get(); }
+  // The callbacks that the device was created with, or nullptr.
+  const VkAllocationCallbacks* allocation_callbacks() const {
+    return has_allocator_ ? &allocator_ : nullptr;
+  }
   ::VkPhysicalDevice physical_device() const { return physical_device_; }
 
   const VkPhysicalDeviceMemoryProperties& physical_device_memory_properties()
@@ -115,7 +128,7 @@ class VkDevice {
   VkAllocationCallbacks allocator_;
   logging::Logger* log_;
   PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
-  // Lazily resolved Vulkan device functions.
+  // Vulkan device functions, resolved when the device is created.
   containers::unique_ptr<DeviceFunctions> functions_;
 
   uint32_t device_id_;
@@ -123,6 +136,8 @@ class VkDevice {
   uint32_t driver_version_;
   uint32_t num_devices_;
   VkPhysicalDeviceMemoryProperties physical_device_memory_properties_;
+  uint8_t pipeline_cache_uuid_[VK_UUID_SIZE];
+  VkPhysicalDeviceLimits limits_;
 
  public:
   PFN_vkVoidFunction getProcAddr(::VkDevice device, const char* function) {
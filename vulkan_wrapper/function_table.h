@@ -18,6 +18,10 @@
 
 #include "vulkan_wrapper/lazy_function.h"
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
 namespace vulkan {
 
 class InstanceFunctions;
@@ -26,10 +30,10 @@ using LazyInstanceFunction = LazyFunction<T, ::VkInstance, InstanceFunctions>;
 
 // InstanceFunctions contains a list of lazily resolved Vulkan instance
 // functions. All the lazily resolved functions are implemented through
-// LazyFunction template, GetLogger() and getProcAddr() methods are required to
-// conform the LazyFunction template. As this class is the source of lazily
-// resolved Vulkan functions, the instance of this class is non-movable and
-// non-copyable.
+// LazyFunction template, GetLogger(), getProcAddr(), resolve_eagerly(),
+// GetCallCounter() and counting_calls() methods are required to conform the
+// LazyFunction template. As this class is the source of lazily resolved Vulkan
+// functions, the instance of this class is non-movable and non-copyable.
 class InstanceFunctions {
  public:
   InstanceFunctions(const InstanceFunctions& other) = delete;
@@ -48,6 +52,8 @@ class InstanceFunctions {
         CONSTRUCT_LAZY_FUNCTION(vkCreateDevice),
         CONSTRUCT_LAZY_FUNCTION(vkEnumerateDeviceExtensionProperties),
         CONSTRUCT_LAZY_FUNCTION(vkEnumerateDeviceLayerProperties),
+        CONSTRUCT_LAZY_FUNCTION(
+            vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceFeatures),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceMemoryProperties),
@@ -55,6 +61,8 @@ class InstanceFunctions {
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceProperties),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceProperties2KHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties),
+        CONSTRUCT_LAZY_FUNCTION(
+            vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceFormatProperties),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties2),
@@ -111,6 +119,14 @@ class InstanceFunctions {
   PFN_vkVoidFunction getProcAddr(::VkInstance instance, const char* function) {
     return vkGetInstanceProcAddr_(instance, function);
   }
+  // Instance functions are resolved when they are first called, since many
+  // of them are only there on some platforms. This is required to conform
+  // LazyFunction template.
+  bool resolve_eagerly() const { return false; }
+  // Calls to instance functions are not counted. These are required to
+  // conform LazyFunction template.
+  std::atomic<uint64_t>* GetCallCounter(const char*) { return nullptr; }
+  bool counting_calls() const { return false; }
 
 #define LAZY_FUNCTION(function) LazyInstanceFunction<PFN_##function> function;
   LAZY_FUNCTION(vkDestroyInstance);
@@ -118,6 +134,8 @@ class InstanceFunctions {
   LAZY_FUNCTION(vkCreateDevice);
   LAZY_FUNCTION(vkEnumerateDeviceExtensionProperties);
   LAZY_FUNCTION(vkEnumerateDeviceLayerProperties);
+  LAZY_FUNCTION(
+      vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR);
   LAZY_FUNCTION(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT);
   LAZY_FUNCTION(vkGetPhysicalDeviceFeatures);
   LAZY_FUNCTION(vkGetPhysicalDeviceMemoryProperties);
@@ -125,6 +143,7 @@ class InstanceFunctions {
   LAZY_FUNCTION(vkGetPhysicalDeviceProperties);
   LAZY_FUNCTION(vkGetPhysicalDeviceProperties2KHR);
   LAZY_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties);
+  LAZY_FUNCTION(vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR);
   LAZY_FUNCTION(vkGetPhysicalDeviceFormatProperties);
   LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties);
   LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties2);
@@ -173,71 +192,9 @@ using LazyDeviceFunction = LazyFunction<T, ::VkDevice, DeviceFunctions>;
 // through it.
 struct CommandBufferFunctions {
  public:
-  CommandBufferFunctions(::VkDevice device, DeviceFunctions* device_functions)
-      :
-#define CONSTRUCT_LAZY_FUNCTION(function) \
-  function(device, #function, device_functions)
-        CONSTRUCT_LAZY_FUNCTION(vkBeginCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkEndCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkResetCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBufferToImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImageToBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdNextSubpass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginConditionalRenderingEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndConditionalRenderingEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginTransformFeedbackEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndTransformFeedbackEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindPipeline),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetLineWidth),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetBlendConstants),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBias),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBounds),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissor),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilCompareMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilReference),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilWriteMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewport),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindDescriptorSets),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindTransformFeedbackBuffersEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearColorImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearDepthStencilImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindIndexBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDraw),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexed),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDispatch),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDispatchIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBlitImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPushConstants),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdExecuteCommands),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResolveImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearAttachments),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdUpdateBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdFillBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResetQueryPool),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginQuery),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndQuery),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyQueryPoolResults),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDeviceMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirectCountKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdInsertDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPushDescriptorSetKHR)
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
+  // Defined after DeviceFunctions, which resolves the functions.
+  inline CommandBufferFunctions(::VkDevice device,
+                                DeviceFunctions* device_functions);
 
  public:
 #define LAZY_FUNCTION(function) LazyDeviceFunction<PFN_##function> function;
@@ -260,6 +217,7 @@ struct CommandBufferFunctions {
   LAZY_FUNCTION(vkCmdSetDepthBias);
   LAZY_FUNCTION(vkCmdSetDepthBounds);
   LAZY_FUNCTION(vkCmdSetScissor);
+  LAZY_FUNCTION(vkCmdSetSampleLocationsEXT);
   LAZY_FUNCTION(vkCmdSetStencilCompareMask);
   LAZY_FUNCTION(vkCmdSetStencilReference);
   LAZY_FUNCTION(vkCmdSetStencilWriteMask);
@@ -304,20 +262,8 @@ struct CommandBufferFunctions {
 
 struct QueueFunctions {
  public:
-  QueueFunctions(::VkDevice device, DeviceFunctions* device_functions)
-      :
-#define CONSTRUCT_LAZY_FUNCTION(function) \
-  function(device, #function, device_functions)
-        CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueWaitIdle),
-        CONSTRUCT_LAZY_FUNCTION(vkQueuePresentKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueBindSparse),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueBeginDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueEndDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueInsertDebugUtilsLabelEXT)
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
+  // Defined after DeviceFunctions, which resolves the functions.
+  inline QueueFunctions(::VkDevice device, DeviceFunctions* device_functions);
 
  public:
 #define LAZY_FUNCTION(function) LazyDeviceFunction<PFN_##function> function;
@@ -333,21 +279,38 @@ struct QueueFunctions {
 
 // DeviceFunctions contains a list of lazily resolved Vulkan device functions
 // and the functions of sub-device objects.All the lazily resolved functions
-// are implemented through LazyFunction template, GetLogger() and getProcAddr()
-// methods are required to conform the LazyFunction template. As this class is
-// the source of lazily resolved Vulkan functions, the instance of this class
-// is non-movable and non-copyable.
+// are implemented through LazyFunction template, GetLogger(), getProcAddr(),
+// resolve_eagerly(), GetCallCounter() and counting_calls() methods are
+// required to conform the LazyFunction template. As this class is the source
+// of lazily resolved Vulkan functions, the instance of this class is
+// non-movable and non-copyable.
 class DeviceFunctions {
  public:
+  // The most functions whose calls can be counted.
+  static const size_t kMaxCallCounters = 96;
+
   DeviceFunctions(const DeviceFunctions& other) = delete;
   DeviceFunctions(DeviceFunctions&& other) = delete;
   DeviceFunctions& operator=(const DeviceFunctions& other) = delete;
   DeviceFunctions& operator=(DeviceFunctions&& other) = delete;
 
+  // The number of calls to one function, see GetCallCounter.
+  struct CallCounter {
+    const char* function_name;
+    std::atomic<uint64_t> count;
+  };
+
+  // If |resolve_eagerly| is true, every function is resolved right away with
+  // vkGetDeviceProcAddr, so that calls made while recording never have to
+  // resolve them. Functions that the device does not have are still
+  // resolved, and fail, on their first call.
   DeviceFunctions(::VkDevice device, PFN_vkGetDeviceProcAddr get_proc_addr_func,
-                  logging::Logger* log)
+                  logging::Logger* log, bool resolve_eagerly = false)
       : log_(log),
         vkGetDeviceProcAddr_(get_proc_addr_func),
+        resolve_eagerly_(resolve_eagerly),
+        counting_calls_(false),
+        num_call_counters_(0),
         command_buffer_functions_(device, this),
         queue_functions_(device, this),
 #define CONSTRUCT_LAZY_FUNCTION(function) function(device, #function, this)
@@ -391,6 +354,7 @@ class DeviceFunctions {
         CONSTRUCT_LAZY_FUNCTION(vkGetShaderInfoAMD),
         CONSTRUCT_LAZY_FUNCTION(vkCreateSampler),
         CONSTRUCT_LAZY_FUNCTION(vkCreateSamplerYcbcrConversionKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkDestroySamplerYcbcrConversionKHR),
         CONSTRUCT_LAZY_FUNCTION(vkDestroySampler),
         CONSTRUCT_LAZY_FUNCTION(vkCreateBuffer),
         CONSTRUCT_LAZY_FUNCTION(vkDestroyBuffer),
@@ -423,6 +387,7 @@ class DeviceFunctions {
         CONSTRUCT_LAZY_FUNCTION(vkGetFenceStatus),
         CONSTRUCT_LAZY_FUNCTION(vkAcquireNextImageKHR),
         CONSTRUCT_LAZY_FUNCTION(vkAcquireNextImage2KHR),
+        CONSTRUCT_LAZY_FUNCTION(vkGetSwapchainStatusKHR),
         CONSTRUCT_LAZY_FUNCTION(vkDeviceWaitIdle),
         CONSTRUCT_LAZY_FUNCTION(vkCreateQueryPool),
         CONSTRUCT_LAZY_FUNCTION(vkDestroyQueryPool),
@@ -440,23 +405,31 @@ class DeviceFunctions {
         CONSTRUCT_LAZY_FUNCTION(vkDestroyDescriptorUpdateTemplateKHR),
         CONSTRUCT_LAZY_FUNCTION(vkUpdateDescriptorSetWithTemplateKHR),
         CONSTRUCT_LAZY_FUNCTION(vkResetQueryPoolEXT),
+        CONSTRUCT_LAZY_FUNCTION(vkAcquireProfilingLockKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkReleaseProfilingLockKHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetPipelineExecutablePropertiesKHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetPipelineExecutableStatisticsKHR),
         CONSTRUCT_LAZY_FUNCTION(
             vkGetPipelineExecutableInternalRepresentationsKHR),
         CONSTRUCT_LAZY_FUNCTION(vkSetHdrMetadataEXT),
         CONSTRUCT_LAZY_FUNCTION(vkWaitSemaphoresKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkSignalSemaphoreKHR)
+        CONSTRUCT_LAZY_FUNCTION(vkGetSemaphoreCounterValueKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkSignalSemaphoreKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkGetBufferDeviceAddressKHR)
 #if defined _WIN32
         ,
         CONSTRUCT_LAZY_FUNCTION(vkGetMemoryWin32HandleKHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetFenceWin32HandleKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkImportFenceWin32HandleKHR)
+        CONSTRUCT_LAZY_FUNCTION(vkImportFenceWin32HandleKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkGetSemaphoreWin32HandleKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkImportSemaphoreWin32HandleKHR)
 #elif __linux__
         ,
         CONSTRUCT_LAZY_FUNCTION(vkGetMemoryFdKHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetFenceFdKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkImportFenceFdKHR)
+        CONSTRUCT_LAZY_FUNCTION(vkImportFenceFdKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkGetSemaphoreFdKHR),
+        CONSTRUCT_LAZY_FUNCTION(vkImportSemaphoreFdKHR)
 #endif
 #undef CONSTRUCT_LAZY_FUNCTION
   {
@@ -466,6 +439,11 @@ class DeviceFunctions {
   logging::Logger* log_;
   // The function pointer to Vulkan vkGetDeviceProcAddr().
   PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr_;
+  // These have to be initialized before the functions below.
+  bool resolve_eagerly_;
+  std::atomic<bool> counting_calls_;
+  CallCounter call_counters_[kMaxCallCounters];
+  size_t num_call_counters_;
   // Functions of sub device objects.
   CommandBufferFunctions command_buffer_functions_;
   QueueFunctions queue_functions_;
@@ -478,6 +456,49 @@ class DeviceFunctions {
   PFN_vkVoidFunction getProcAddr(::VkDevice device, const char* function) {
     return vkGetDeviceProcAddr_(device, function);
   }
+  // Whether the functions are resolved when they are constructed. This is
+  // required to conform LazyFunction template.
+  bool resolve_eagerly() const { return resolve_eagerly_; }
+  // Returns the counter for the calls to |function|, or nullptr if they are
+  // not counted. Draws, dispatches, binds, barriers, submits, descriptor
+  // updates and object creation and destruction are counted. This is
+  // required to conform LazyFunction template.
+  std::atomic<uint64_t>* GetCallCounter(const char* function) {
+    static const char* const kCountedPrefixes[] = {
+        "vkCmdDraw",             "vkCmdDispatch",          "vkCmdBind",
+        "vkCmdPipelineBarrier",  "vkCmdPushDescriptorSet", "vkQueueSubmit",
+        "vkUpdateDescriptorSet", "vkCreate",               "vkDestroy",
+        "vkAllocate",            "vkFree"};
+    for (const char* prefix : kCountedPrefixes) {
+      if (strncmp(function, prefix, strlen(prefix)) == 0) {
+        LOG_ASSERT(<, log_, num_call_counters_, kMaxCallCounters);
+        CallCounter& counter = call_counters_[num_call_counters_++];
+        counter.function_name = function;
+        counter.count.store(0, std::memory_order_relaxed);
+        return &counter.count;
+      }
+    }
+    return nullptr;
+  }
+  // Whether calls are counted right now. This is required to conform
+  // LazyFunction template.
+  bool counting_calls() const {
+    return counting_calls_.load(std::memory_order_relaxed);
+  }
+  // Starts or stops counting the calls to the counted functions. Counting
+  // costs an atomic increment per call, so it is off by default.
+  void set_counting_calls(bool counting_calls) {
+    counting_calls_.store(counting_calls, std::memory_order_relaxed);
+  }
+  size_t num_call_counters() const { return num_call_counters_; }
+  const char* call_counter_function_name(size_t i) const {
+    return call_counters_[i].function_name;
+  }
+  // Returns the number of calls to the |i|th counted function since the last
+  // time this was called for it, and starts counting again from 0.
+  uint64_t TakeCallCount(size_t i) {
+    return call_counters_[i].count.exchange(0, std::memory_order_relaxed);
+  }
   // Access the command buffer functions.
   CommandBufferFunctions* command_buffer_functions() {
     return &command_buffer_functions_;
@@ -525,6 +546,7 @@ class DeviceFunctions {
   LAZY_FUNCTION(vkGetShaderInfoAMD);
   LAZY_FUNCTION(vkCreateSampler);
   LAZY_FUNCTION(vkCreateSamplerYcbcrConversionKHR);
+  LAZY_FUNCTION(vkDestroySamplerYcbcrConversionKHR);
   LAZY_FUNCTION(vkDestroySampler);
   LAZY_FUNCTION(vkCreateBuffer);
   LAZY_FUNCTION(vkDestroyBuffer);
@@ -557,6 +579,7 @@ class DeviceFunctions {
   LAZY_FUNCTION(vkResetFences);
   LAZY_FUNCTION(vkAcquireNextImageKHR);
   LAZY_FUNCTION(vkAcquireNextImage2KHR);
+  LAZY_FUNCTION(vkGetSwapchainStatusKHR);
   LAZY_FUNCTION(vkDeviceWaitIdle);
   LAZY_FUNCTION(vkCreateQueryPool);
   LAZY_FUNCTION(vkDestroyQueryPool);
@@ -574,24 +597,116 @@ class DeviceFunctions {
   LAZY_FUNCTION(vkDestroyDescriptorUpdateTemplateKHR);
   LAZY_FUNCTION(vkUpdateDescriptorSetWithTemplateKHR);
   LAZY_FUNCTION(vkResetQueryPoolEXT);
+  LAZY_FUNCTION(vkAcquireProfilingLockKHR);
+  LAZY_FUNCTION(vkReleaseProfilingLockKHR);
   LAZY_FUNCTION(vkGetPipelineExecutablePropertiesKHR);
   LAZY_FUNCTION(vkGetPipelineExecutableStatisticsKHR);
   LAZY_FUNCTION(vkGetPipelineExecutableInternalRepresentationsKHR);
   LAZY_FUNCTION(vkSetHdrMetadataEXT);
   LAZY_FUNCTION(vkWaitSemaphoresKHR);
+  LAZY_FUNCTION(vkGetSemaphoreCounterValueKHR);
   LAZY_FUNCTION(vkSignalSemaphoreKHR);
+  LAZY_FUNCTION(vkGetBufferDeviceAddressKHR);
 #if defined _WIN32
   LAZY_FUNCTION(vkGetMemoryWin32HandleKHR);
   LAZY_FUNCTION(vkGetFenceWin32HandleKHR);
   LAZY_FUNCTION(vkImportFenceWin32HandleKHR);
+  LAZY_FUNCTION(vkGetSemaphoreWin32HandleKHR);
+  LAZY_FUNCTION(vkImportSemaphoreWin32HandleKHR);
 #elif __linux__
   LAZY_FUNCTION(vkGetMemoryFdKHR);
   LAZY_FUNCTION(vkGetFenceFdKHR);
   LAZY_FUNCTION(vkImportFenceFdKHR);
+  LAZY_FUNCTION(vkGetSemaphoreFdKHR);
+  LAZY_FUNCTION(vkImportSemaphoreFdKHR);
 #endif
 #undef LAZY_FUNCTION
 };
 
+CommandBufferFunctions::CommandBufferFunctions(::VkDevice device,
+                                             DeviceFunctions* device_functions)
+    :
+#define CONSTRUCT_LAZY_FUNCTION(function) \
+  function(device, #function, device_functions)
+      CONSTRUCT_LAZY_FUNCTION(vkBeginCommandBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkEndCommandBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkResetCommandBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBufferToImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImageToBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderPass),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderPass),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdNextSubpass),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginConditionalRenderingEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndConditionalRenderingEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginTransformFeedbackEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndTransformFeedbackEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindPipeline),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetLineWidth),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetBlendConstants),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBias),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBounds),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissor),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetSampleLocationsEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilCompareMask),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilReference),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilWriteMask),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewport),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindDescriptorSets),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindTransformFeedbackBuffersEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdClearColorImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdClearDepthStencilImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindIndexBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDraw),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexed),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndirect),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirect),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDispatch),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDispatchIndirect),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBlitImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdPushConstants),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdExecuteCommands),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdResolveImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdClearAttachments),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdUpdateBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdFillBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdResetQueryPool),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginQuery),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndQuery),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyQueryPoolResults),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetEvent),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdResetEvent),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDeviceMask),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirectCountKHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdInsertDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdPushDescriptorSetKHR)
+#undef CONSTRUCT_LAZY_FUNCTION
+{
+}
+
+QueueFunctions::QueueFunctions(::VkDevice device,
+                             DeviceFunctions* device_functions)
+    :
+#define CONSTRUCT_LAZY_FUNCTION(function) \
+  function(device, #function, device_functions)
+      CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueWaitIdle),
+      CONSTRUCT_LAZY_FUNCTION(vkQueuePresentKHR),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueBindSparse),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueBeginDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueEndDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueInsertDebugUtilsLabelEXT)
+#undef CONSTRUCT_LAZY_FUNCTION
+{
+}
+
 }  // namespace vulkan
 
 #endif  // VULKAN_WRAPPER_FUNCTION_TABLE_H_
@@ -80,6 +80,10 @@ class VkInstance {
   }
 
   InstanceFunctions* functions() { return functions_.get(); }
+  // The callbacks that the instance was created with, or nullptr.
+  const VkAllocationCallbacks* allocation_callbacks() const {
+    return has_allocator_ ? &allocator_ : nullptr;
+  }
 
  private:
   ::VkInstance instance_;
@@ -16,15 +16,30 @@
 #ifndef VULKAN_WRAPPER_LAZY_FUNCTION_H_
 #define VULKAN_WRAPPER_LAZY_FUNCTION_H_
 
+#include <atomic>
+#include <cstdint>
+
 // This wraps a lazily initialized function pointer. It will be resolved
-// when it is first called.
+// when it is first called, or right away if the wrapper resolves its
+// functions eagerly. It may be called from several threads at once, e.g.
+// when command buffers are recorded in parallel. If the wrapper gives it a
+// call counter, every call is counted while the wrapper is counting calls.
 template <typename T, typename HANDLE, typename WRAPPER>
 class LazyFunction {
  public:
   // We retain a reference to the function name, so it must remain valid.
   // In practice this is expected to be used with string constants.
   LazyFunction(HANDLE handle, const char* function_name, WRAPPER* wrapper)
-      : handle_(handle), function_name_(function_name), wrapper_(wrapper) {}
+      : handle_(handle),
+        function_name_(function_name),
+        wrapper_(wrapper),
+        call_counter_(wrapper_->GetCallCounter(function_name_)) {
+    if (wrapper_->resolve_eagerly()) {
+      ptr_.store(
+          reinterpret_cast<T>(wrapper_->getProcAddr(handle_, function_name_)),
+          std::memory_order_relaxed);
+    }
+  }
 
   // When this functor is called, it will check if the function pointer
   // has been resolved. If not it will resolve it and then call the function.
@@ -36,24 +51,33 @@ class LazyFunction {
   HANDLE handle_;
   const char* function_name_;
   WRAPPER* wrapper_;
-  T ptr_ = nullptr;
+  // Owned by the wrapper, nullptr if calls to this function are not counted.
+  std::atomic<uint64_t>* call_counter_;
+  // Threads that race to resolve it all store the same pointer, so a call
+  // only costs a single load once it is resolved.
+  std::atomic<T> ptr_{nullptr};
 };
 
 template <typename T, typename HANDLE, typename WRAPPER>
 template <typename... Args>
 typename std::result_of<T(Args...)>::type LazyFunction<T, HANDLE, WRAPPER>::
 operator()(const Args&... args) {
-  if (!ptr_) {
-    ptr_ = reinterpret_cast<T>(wrapper_->getProcAddr(handle_, function_name_));
-    if (ptr_) {
-      wrapper_->GetLogger()->LogInfo(function_name_, " for instance ", handle_,
-                                     " resolved");
+  if (call_counter_ && wrapper_->counting_calls()) {
+    call_counter_->fetch_add(1, std::memory_order_relaxed);
+  }
+  T ptr = ptr_.load(std::memory_order_acquire);
+  if (!ptr) {
+    ptr = reinterpret_cast<T>(wrapper_->getProcAddr(handle_, function_name_));
+    ptr_.store(ptr, std::memory_order_release);
+    if (ptr) {
+      wrapper_->GetLogger()->LogVerbose(function_name_, " for instance ",
+                                        handle_, " resolved");
     } else {
       wrapper_->GetLogger()->LogError(function_name_, " for instance ", handle_,
                                       " could not be resolved, crashing now");
     }
   }
-  return ptr_(args...);
+  return ptr(args...);
 }
 
 #endif  //  VULKAN_WRAPPER_LAZY_FUNCTION_H_
\ No newline at end of file
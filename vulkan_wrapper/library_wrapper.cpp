@@ -15,15 +15,26 @@
 
 #include "vulkan_wrapper/library_wrapper.h"
 
+#include "support/trace/startup.h"
+#include "vulkan_wrapper/null_driver.h"
+
 namespace vulkan {
 
 LibraryWrapper::LibraryWrapper(containers::Allocator* allocator,
-                               logging::Logger* logger)
+                               logging::Logger* logger, bool null_driver)
     : logger_(logger) {
-  vulkan_lib_ = dynamic_loader::OpenLibrary(allocator, "vulkan");
+  if (null_driver) {
+    logger_->LogInfo("Using the null driver instead of libvulkan");
+    vkGetInstanceProcAddr = GetNullDriverProcAddr();
+    return;
+  }
+  {
+    STARTUP_PHASE("LoadVulkanLibrary");
+    vulkan_lib_ = dynamic_loader::OpenLibrary(allocator, "vulkan");
+  }
   if (vulkan_lib_) {
     if (vulkan_lib_->is_valid()) {
-      logger_->LogInfo("Successfully opened vulkan library");
+      logger_->LogVerbose("Successfully opened vulkan library");
       vulkan_lib_->Resolve("vkGetInstanceProcAddr", &vkGetInstanceProcAddr);
     }
     if (!vkGetInstanceProcAddr) {
@@ -31,7 +42,7 @@ LibraryWrapper::LibraryWrapper(containers::Allocator* allocator,
       logger_->LogError(
           "Could not resolve vkGetInstanceProcAddr from libvulkan");
     } else {
-      logger_->LogInfo("Resolved vkGetInstanceProcAddr.");
+      logger_->LogVerbose("Resolved vkGetInstanceProcAddr.");
     }
   } else {
     logger_->LogError("Could not find libvulkan");
@@ -33,17 +33,24 @@ using LazyLibraryFunction = LazyFunction<T, ::VkInstance, LibraryWrapper>;
 // for all global-scope functions.
 class LibraryWrapper {
  public:
-  LibraryWrapper(containers::Allocator* allocator, logging::Logger* logger);
-  bool is_valid() { return vulkan_lib_ && vulkan_lib_->is_valid(); }
+  // If |null_driver| is true, libvulkan is not loaded, and every function
+  // goes to the null driver of null_driver.h instead.
+  LibraryWrapper(containers::Allocator* allocator, logging::Logger* logger,
+                 bool null_driver = false);
+  bool is_valid() { return vkGetInstanceProcAddr != nullptr; }
 
-#define LAZY_FUNCTION(function)                   \
-  LazyLibraryFunction<PFN_##function> function = \
-      LazyLibraryFunction<PFN_##function>(nullptr, #function, this)
+#define LAZY_FUNCTION(function) \
+  LazyLibraryFunction<PFN_##function> function{nullptr, #function, this}
   LAZY_FUNCTION(vkCreateInstance);
   LAZY_FUNCTION(vkEnumerateInstanceExtensionProperties);
   LAZY_FUNCTION(vkEnumerateInstanceLayerProperties);
 #undef LAZY_FUNCTION
   logging::Logger* GetLogger() { return logger_; }
+  // The library functions are only resolved once the library is loaded, and
+  // their calls are not counted.
+  bool resolve_eagerly() const { return false; }
+  std::atomic<uint64_t>* GetCallCounter(const char*) { return nullptr; }
+  bool counting_calls() const { return false; }
 
   PFN_vkVoidFunction getProcAddr(::VkInstance instance, const char* function);
 
@@ -52,7 +59,7 @@ class LibraryWrapper {
   }
 
  private:
-  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
 
   logging::Logger* logger_;
   containers::unique_ptr<dynamic_loader::DynamicLibrary> vulkan_lib_;
@@ -0,0 +1,679 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_wrapper/null_driver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace vulkan {
+namespace {
+
+const VkDeviceSize kHeapSize = VkDeviceSize(16) << 30;
+const VkDeviceSize kAlignment = 256;
+const uint32_t kNumQueues = 16;
+
+const char* kDeviceExtensions[] = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+    VK_KHR_BIND_MEMORY_2_EXTENSION_NAME,
+    VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+    VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+    VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME,
+    VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+};
+
+// Memory, buffers and images point at one of these.
+struct NullObject {
+  VkDeviceSize size;
+  // The row pitch of linear images.
+  VkDeviceSize row_pitch;
+  // The host memory behind device memory.
+  void* data;
+};
+
+// Every other object is a counter. The first kNumQueues values are the
+// queues, so that every call to vkGetDeviceQueue returns the same ones.
+std::atomic<uint64_t> next_handle(kNumQueues + 1);
+
+template <typename T>
+T NewHandle() {
+  return (T)(uintptr_t)next_handle.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename T>
+T NewObject(VkDeviceSize size, VkDeviceSize row_pitch, void* data) {
+  return (T)(uintptr_t) new NullObject{size, row_pitch, data};
+}
+
+template <typename T>
+NullObject* ToObject(T handle) {
+  return (NullObject*)(uintptr_t)handle;
+}
+
+VkDeviceSize AlignUp(VkDeviceSize size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Implements the two calls of a Vulkan enumeration over |values|.
+template <typename T>
+VkResult Enumerate(const T* values, uint32_t num_values, uint32_t* count,
+                   T* out) {
+  if (!out) {
+    *count = num_values;
+    return VK_SUCCESS;
+  }
+  const uint32_t num_written = std::min(*count, num_values);
+  std::copy(values, values + num_written, out);
+  *count = num_written;
+  return num_written < num_values ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullSuccess() { return VK_SUCCESS; }
+
+// Creates any object that does not need a size with a create info.
+template <typename P, typename I, typename T>
+VKAPI_ATTR VkResult VKAPI_CALL NullCreate(P, const I*,
+                                          const VkAllocationCallbacks*,
+                                          T* object) {
+  *object = NewHandle<T>();
+  return VK_SUCCESS;
+}
+
+template <typename I>
+VKAPI_ATTR VkResult VKAPI_CALL NullCreatePipelines(
+    ::VkDevice, ::VkPipelineCache, uint32_t count, const I*,
+    const VkAllocationCallbacks*, ::VkPipeline* pipelines) {
+  for (uint32_t i = 0; i < count; ++i) {
+    pipelines[i] = NewHandle<::VkPipeline>();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+NullCreateInstance(const VkInstanceCreateInfo*, const VkAllocationCallbacks*,
+                   ::VkInstance* instance) {
+  *instance = NewHandle<::VkInstance>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullEnumerateInstanceExtensionProperties(
+    const char*, uint32_t* count, VkExtensionProperties*) {
+  *count = 0;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+NullEnumerateInstanceLayerProperties(uint32_t* count, VkLayerProperties*) {
+  *count = 0;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullEnumeratePhysicalDevices(
+    ::VkInstance, uint32_t* count, ::VkPhysicalDevice* devices) {
+  static const ::VkPhysicalDevice device = NewHandle<::VkPhysicalDevice>();
+  return Enumerate(&device, 1, count, devices);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullEnumeratePhysicalDeviceGroups(
+    ::VkInstance instance, uint32_t* count,
+    VkPhysicalDeviceGroupProperties* groups) {
+  if (!groups) {
+    *count = 1;
+    return VK_SUCCESS;
+  }
+  if (*count == 0) {
+    return VK_INCOMPLETE;
+  }
+  *count = 1;
+  uint32_t num_devices = 1;
+  NullEnumeratePhysicalDevices(instance, &num_devices,
+                               groups[0].physicalDevices);
+  groups[0].physicalDeviceCount = 1;
+  groups[0].subsetAllocation = VK_FALSE;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceProperties(
+    ::VkPhysicalDevice, VkPhysicalDeviceProperties* properties) {
+  *properties = {};
+  properties->apiVersion = VK_MAKE_VERSION(1, 1, 0);
+  properties->driverVersion = 1;
+  properties->deviceType = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+  strncpy(properties->deviceName, "Null driver",
+          VK_MAX_PHYSICAL_DEVICE_NAME_SIZE);
+
+  VkPhysicalDeviceLimits& limits = properties->limits;
+  limits.maxImageDimension1D = 16384;
+  limits.maxImageDimension2D = 16384;
+  limits.maxImageDimension3D = 2048;
+  limits.maxImageDimensionCube = 16384;
+  limits.maxImageArrayLayers = 2048;
+  limits.maxTexelBufferElements = 1 << 27;
+  limits.maxUniformBufferRange = 1 << 16;
+  limits.maxStorageBufferRange = 1u << 31;
+  limits.maxPushConstantsSize = 256;
+  limits.maxMemoryAllocationCount = 1 << 16;
+  limits.maxSamplerAllocationCount = 1 << 16;
+  limits.bufferImageGranularity = 1;
+  limits.maxBoundDescriptorSets = 32;
+  limits.maxPerStageDescriptorSamplers = 1 << 20;
+  limits.maxPerStageDescriptorUniformBuffers = 1 << 20;
+  limits.maxPerStageDescriptorStorageBuffers = 1 << 20;
+  limits.maxPerStageDescriptorSampledImages = 1 << 20;
+  limits.maxPerStageDescriptorStorageImages = 1 << 20;
+  limits.maxPerStageDescriptorInputAttachments = 1 << 20;
+  limits.maxPerStageResources = 1 << 20;
+  limits.maxDescriptorSetSamplers = 1 << 20;
+  limits.maxDescriptorSetUniformBuffers = 1 << 20;
+  limits.maxDescriptorSetUniformBuffersDynamic = 16;
+  limits.maxDescriptorSetStorageBuffers = 1 << 20;
+  limits.maxDescriptorSetStorageBuffersDynamic = 16;
+  limits.maxDescriptorSetSampledImages = 1 << 20;
+  limits.maxDescriptorSetStorageImages = 1 << 20;
+  limits.maxDescriptorSetInputAttachments = 1 << 20;
+  limits.maxVertexInputAttributes = 32;
+  limits.maxVertexInputBindings = 32;
+  limits.maxVertexInputAttributeOffset = 2047;
+  limits.maxVertexInputBindingStride = 2048;
+  limits.maxVertexOutputComponents = 128;
+  limits.maxTessellationGenerationLevel = 64;
+  limits.maxTessellationPatchSize = 32;
+  limits.maxTessellationControlPerVertexInputComponents = 128;
+  limits.maxTessellationControlPerVertexOutputComponents = 128;
+  limits.maxTessellationControlPerPatchOutputComponents = 120;
+  limits.maxTessellationControlTotalOutputComponents = 4096;
+  limits.maxTessellationEvaluationInputComponents = 128;
+  limits.maxTessellationEvaluationOutputComponents = 128;
+  limits.maxGeometryShaderInvocations = 32;
+  limits.maxGeometryInputComponents = 128;
+  limits.maxGeometryOutputComponents = 128;
+  limits.maxGeometryOutputVertices = 256;
+  limits.maxGeometryTotalOutputComponents = 1024;
+  limits.maxFragmentInputComponents = 128;
+  limits.maxFragmentOutputAttachments = 8;
+  limits.maxFragmentDualSrcAttachments = 1;
+  limits.maxFragmentCombinedOutputResources = 1 << 20;
+  limits.maxComputeSharedMemorySize = 1 << 15;
+  limits.maxComputeWorkGroupCount[0] = 1 << 16;
+  limits.maxComputeWorkGroupCount[1] = 1 << 16;
+  limits.maxComputeWorkGroupCount[2] = 1 << 16;
+  limits.maxComputeWorkGroupInvocations = 1024;
+  limits.maxComputeWorkGroupSize[0] = 1024;
+  limits.maxComputeWorkGroupSize[1] = 1024;
+  limits.maxComputeWorkGroupSize[2] = 64;
+  limits.subPixelPrecisionBits = 8;
+  limits.subTexelPrecisionBits = 8;
+  limits.mipmapPrecisionBits = 8;
+  limits.maxDrawIndexedIndexValue = ~0u;
+  limits.maxDrawIndirectCount = ~0u;
+  limits.maxSamplerLodBias = 16.0f;
+  limits.maxSamplerAnisotropy = 16.0f;
+  limits.maxViewports = 16;
+  limits.maxViewportDimensions[0] = 16384;
+  limits.maxViewportDimensions[1] = 16384;
+  limits.viewportBoundsRange[0] = -32768.0f;
+  limits.viewportBoundsRange[1] = 32767.0f;
+  limits.viewportSubPixelBits = 8;
+  limits.minMemoryMapAlignment = 16;
+  limits.minTexelBufferOffsetAlignment = 16;
+  limits.minUniformBufferOffsetAlignment = 16;
+  limits.minStorageBufferOffsetAlignment = 16;
+  limits.minTexelOffset = -8;
+  limits.maxTexelOffset = 7;
+  limits.minTexelGatherOffset = -32;
+  limits.maxTexelGatherOffset = 31;
+  limits.minInterpolationOffset = -0.5f;
+  limits.maxInterpolationOffset = 0.4375f;
+  limits.subPixelInterpolationOffsetBits = 4;
+  limits.maxFramebufferWidth = 16384;
+  limits.maxFramebufferHeight = 16384;
+  limits.maxFramebufferLayers = 2048;
+  const VkSampleCountFlags all_samples = VK_SAMPLE_COUNT_1_BIT |
+                                         VK_SAMPLE_COUNT_2_BIT |
+                                         VK_SAMPLE_COUNT_4_BIT |
+                                         VK_SAMPLE_COUNT_8_BIT;
+  limits.framebufferColorSampleCounts = all_samples;
+  limits.framebufferDepthSampleCounts = all_samples;
+  limits.framebufferStencilSampleCounts = all_samples;
+  limits.framebufferNoAttachmentsSampleCounts = all_samples;
+  limits.maxColorAttachments = 8;
+  limits.sampledImageColorSampleCounts = all_samples;
+  limits.sampledImageIntegerSampleCounts = all_samples;
+  limits.sampledImageDepthSampleCounts = all_samples;
+  limits.sampledImageStencilSampleCounts = all_samples;
+  limits.storageImageSampleCounts = all_samples;
+  limits.maxSampleMaskWords = 1;
+  limits.timestampComputeAndGraphics = VK_TRUE;
+  limits.timestampPeriod = 1.0f;
+  limits.maxClipDistances = 8;
+  limits.maxCullDistances = 8;
+  limits.maxCombinedClipAndCullDistances = 8;
+  limits.discreteQueuePriorities = 2;
+  limits.pointSizeRange[0] = 1.0f;
+  limits.pointSizeRange[1] = 64.0f;
+  limits.lineWidthRange[0] = 1.0f;
+  limits.lineWidthRange[1] = 8.0f;
+  limits.pointSizeGranularity = 1.0f;
+  limits.lineWidthGranularity = 1.0f;
+  limits.optimalBufferCopyOffsetAlignment = 1;
+  limits.optimalBufferCopyRowPitchAlignment = 1;
+  limits.nonCoherentAtomSize = 1;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceProperties2(
+    ::VkPhysicalDevice physical_device,
+    VkPhysicalDeviceProperties2* properties) {
+  NullGetPhysicalDeviceProperties(physical_device, &properties->properties);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceFeatures(
+    ::VkPhysicalDevice, VkPhysicalDeviceFeatures* features) {
+  VkBool32* feature = reinterpret_cast<VkBool32*>(features);
+  std::fill(feature, feature + sizeof(*features) / sizeof(VkBool32),
+            VK_TRUE);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceFeatures2(
+    ::VkPhysicalDevice physical_device, VkPhysicalDeviceFeatures2* features) {
+  NullGetPhysicalDeviceFeatures(physical_device, &features->features);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceMemoryProperties(
+    ::VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* properties) {
+  *properties = {};
+  properties->memoryTypeCount = 1;
+  properties->memoryTypes[0].propertyFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  properties->memoryTypes[0].heapIndex = 0;
+  properties->memoryHeapCount = 1;
+  properties->memoryHeaps[0].size = kHeapSize;
+  properties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceMemoryProperties2(
+    ::VkPhysicalDevice physical_device,
+    VkPhysicalDeviceMemoryProperties2* properties) {
+  NullGetPhysicalDeviceMemoryProperties(physical_device,
+                                        &properties->memoryProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceQueueFamilyProperties(
+    ::VkPhysicalDevice, uint32_t* count, VkQueueFamilyProperties* properties) {
+  const VkQueueFamilyProperties family = {
+      VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT |
+          VK_QUEUE_SPARSE_BINDING_BIT,  // queueFlags
+      kNumQueues,                       // queueCount
+      64,                               // timestampValidBits
+      {1, 1, 1}                         // minImageTransferGranularity
+  };
+  Enumerate(&family, 1, count, properties);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceFormatProperties(
+    ::VkPhysicalDevice, VkFormat, VkFormatProperties* properties) {
+  properties->linearTilingFeatures = ~0u;
+  properties->optimalTilingFeatures = ~0u;
+  properties->bufferFeatures = ~0u;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetPhysicalDeviceImageFormatProperties(
+    ::VkPhysicalDevice, VkFormat, VkImageType, VkImageTiling,
+    VkImageUsageFlags, VkImageCreateFlags,
+    VkImageFormatProperties* properties) {
+  properties->maxExtent = {16384, 16384, 2048};
+  properties->maxMipLevels = 15;
+  properties->maxArrayLayers = 2048;
+  properties->sampleCounts = VK_SAMPLE_COUNT_1_BIT | VK_SAMPLE_COUNT_2_BIT |
+                             VK_SAMPLE_COUNT_4_BIT | VK_SAMPLE_COUNT_8_BIT;
+  properties->maxResourceSize = kHeapSize;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetPhysicalDeviceImageFormatProperties2(
+    ::VkPhysicalDevice physical_device,
+    const VkPhysicalDeviceImageFormatInfo2* info,
+    VkImageFormatProperties2* properties) {
+  return NullGetPhysicalDeviceImageFormatProperties(
+      physical_device, info->format, info->type, info->tiling, info->usage,
+      info->flags, &properties->imageFormatProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceSparseImageFormatProperties(
+    ::VkPhysicalDevice, VkFormat, VkImageType, VkSampleCountFlagBits,
+    VkImageUsageFlags, VkImageTiling, uint32_t* count,
+    VkSparseImageFormatProperties*) {
+  *count = 0;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullEnumerateDeviceExtensionProperties(
+    ::VkPhysicalDevice, const char*, uint32_t* count,
+    VkExtensionProperties* properties) {
+  const uint32_t num_extensions =
+      sizeof(kDeviceExtensions) / sizeof(kDeviceExtensions[0]);
+  if (!properties) {
+    *count = num_extensions;
+    return VK_SUCCESS;
+  }
+  const uint32_t num_written = std::min(*count, num_extensions);
+  for (uint32_t i = 0; i < num_written; ++i) {
+    properties[i] = {};
+    strncpy(properties[i].extensionName, kDeviceExtensions[i],
+            VK_MAX_EXTENSION_NAME_SIZE - 1);
+    properties[i].specVersion = 1;
+  }
+  *count = num_written;
+  return num_written < num_extensions ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullEnumerateDeviceLayerProperties(
+    ::VkPhysicalDevice, uint32_t* count, VkLayerProperties*) {
+  *count = 0;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetDeviceQueue(::VkDevice, uint32_t,
+                                              uint32_t index,
+                                              ::VkQueue* queue) {
+  *queue = (::VkQueue)(uintptr_t)(index % kNumQueues + 1);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+NullAllocateMemory(::VkDevice, const VkMemoryAllocateInfo* info,
+                   const VkAllocationCallbacks*, ::VkDeviceMemory* memory) {
+  // malloc leaves the pages of large allocations untouched until they are
+  // written, so memory that is never mapped costs no host memory.
+  void* data = malloc(static_cast<size_t>(info->allocationSize));
+  if (!data) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+  *memory = NewObject<::VkDeviceMemory>(info->allocationSize, 0, data);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullFreeMemory(::VkDevice, ::VkDeviceMemory memory,
+                                          const VkAllocationCallbacks*) {
+  if (memory == VK_NULL_HANDLE) {
+    return;
+  }
+  NullObject* object = ToObject(memory);
+  free(object->data);
+  delete object;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullMapMemory(::VkDevice,
+                                             ::VkDeviceMemory memory,
+                                             VkDeviceSize offset, VkDeviceSize,
+                                             VkMemoryMapFlags, void** data) {
+  *data = static_cast<char*>(ToObject(memory)->data) + offset;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+NullCreateBuffer(::VkDevice, const VkBufferCreateInfo* info,
+                 const VkAllocationCallbacks*, ::VkBuffer* buffer) {
+  *buffer = NewObject<::VkBuffer>(AlignUp(info->size), 0, nullptr);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+NullCreateImage(::VkDevice, const VkImageCreateInfo* info,
+                const VkAllocationCallbacks*, ::VkImage* image) {
+  // Linear images can be mapped, so they get room for the largest texels.
+  // Optimal images are only sized for the arenas that they are placed in.
+  const bool linear = info->tiling == VK_IMAGE_TILING_LINEAR;
+  const VkDeviceSize row_pitch =
+      VkDeviceSize(info->extent.width) * (linear ? 16 : 4);
+  VkDeviceSize size = row_pitch * info->extent.height * info->extent.depth *
+                      info->arrayLayers * info->samples;
+  if (info->mipLevels > 1) {
+    size += size / 3;
+  }
+  *image = NewObject<::VkImage>(AlignUp(size), row_pitch, nullptr);
+  return VK_SUCCESS;
+}
+
+template <typename T>
+VKAPI_ATTR void VKAPI_CALL NullDestroyObject(::VkDevice, T object,
+                                             const VkAllocationCallbacks*) {
+  if (object != VK_NULL_HANDLE) {
+    delete ToObject(object);
+  }
+}
+
+template <typename T>
+VKAPI_ATTR void VKAPI_CALL
+NullGetMemoryRequirements(::VkDevice, T object,
+                          VkMemoryRequirements* requirements) {
+  requirements->size = ToObject(object)->size;
+  requirements->alignment = kAlignment;
+  requirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetImageMemoryRequirements2(
+    ::VkDevice device, const VkImageMemoryRequirementsInfo2* info,
+    VkMemoryRequirements2* requirements) {
+  NullGetMemoryRequirements(device, info->image,
+                            &requirements->memoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetImageSparseMemoryRequirements(
+    ::VkDevice, ::VkImage, uint32_t* count,
+    VkSparseImageMemoryRequirements*) {
+  *count = 0;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetImageSubresourceLayout(
+    ::VkDevice, ::VkImage image, const VkImageSubresource*,
+    VkSubresourceLayout* layout) {
+  const NullObject* object = ToObject(image);
+  layout->offset = 0;
+  layout->size = object->size;
+  layout->rowPitch = object->row_pitch;
+  layout->arrayPitch = object->size;
+  layout->depthPitch = object->size;
+}
+
+VKAPI_ATTR VkDeviceAddress VKAPI_CALL NullGetBufferDeviceAddress(
+    ::VkDevice, const VkBufferDeviceAddressInfoKHR* info) {
+  return VkDeviceAddress(uintptr_t(ToObject(info->buffer)));
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullAllocateCommandBuffers(
+    ::VkDevice, const VkCommandBufferAllocateInfo* info,
+    ::VkCommandBuffer* command_buffers) {
+  for (uint32_t i = 0; i < info->commandBufferCount; ++i) {
+    command_buffers[i] = NewHandle<::VkCommandBuffer>();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullAllocateDescriptorSets(
+    ::VkDevice, const VkDescriptorSetAllocateInfo* info,
+    ::VkDescriptorSet* sets) {
+  for (uint32_t i = 0; i < info->descriptorSetCount; ++i) {
+    sets[i] = NewHandle<::VkDescriptorSet>();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetQueryPoolResults(
+    ::VkDevice, ::VkQueryPool, uint32_t, uint32_t, size_t size, void* data,
+    VkDeviceSize, VkQueryResultFlags) {
+  memset(data, 0, size);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetPipelineCacheData(::VkDevice,
+                                                        ::VkPipelineCache,
+                                                        size_t* size, void*) {
+  *size = 0;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetEventStatus(::VkDevice, ::VkEvent) {
+  return VK_EVENT_SET;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetRenderAreaGranularity(::VkDevice,
+                                                        ::VkRenderPass,
+                                                        VkExtent2D* extent) {
+  *extent = {1, 1};
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetDeviceGroupPeerMemoryFeatures(
+    ::VkDevice, uint32_t, uint32_t, uint32_t,
+    VkPeerMemoryFeatureFlags* flags) {
+  *flags = VK_PEER_MEMORY_FEATURE_COPY_SRC_BIT |
+           VK_PEER_MEMORY_FEATURE_COPY_DST_BIT |
+           VK_PEER_MEMORY_FEATURE_GENERIC_SRC_BIT |
+           VK_PEER_MEMORY_FEATURE_GENERIC_DST_BIT;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+NullGetInstanceProcAddr(::VkInstance, const char* name);
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+NullGetDeviceProcAddr(::VkDevice, const char* name) {
+  return NullGetInstanceProcAddr(VK_NULL_HANDLE, name);
+}
+
+struct NullFunction {
+  const char* name;
+  PFN_vkVoidFunction function;
+};
+
+// The static_cast checks that every stub matches the Vulkan function that it
+// stands in for, and picks the instantiation of the templated ones.
+#define NULL_FUNCTION(function, stub)                 \
+  {                                                   \
+    #function, reinterpret_cast<PFN_vkVoidFunction>(  \
+                   static_cast<PFN_##function>(stub)) \
+  }
+
+const NullFunction kNullFunctions[] = {
+    NULL_FUNCTION(vkGetInstanceProcAddr, NullGetInstanceProcAddr),
+    NULL_FUNCTION(vkGetDeviceProcAddr, NullGetDeviceProcAddr),
+    NULL_FUNCTION(vkCreateInstance, NullCreateInstance),
+    NULL_FUNCTION(vkEnumerateInstanceExtensionProperties,
+                  NullEnumerateInstanceExtensionProperties),
+    NULL_FUNCTION(vkEnumerateInstanceLayerProperties,
+                  NullEnumerateInstanceLayerProperties),
+    NULL_FUNCTION(vkEnumeratePhysicalDevices, NullEnumeratePhysicalDevices),
+    NULL_FUNCTION(vkEnumeratePhysicalDeviceGroups,
+                  NullEnumeratePhysicalDeviceGroups),
+    NULL_FUNCTION(vkGetPhysicalDeviceProperties,
+                  NullGetPhysicalDeviceProperties),
+    NULL_FUNCTION(vkGetPhysicalDeviceProperties2,
+                  NullGetPhysicalDeviceProperties2),
+    NULL_FUNCTION(vkGetPhysicalDeviceProperties2KHR,
+                  NullGetPhysicalDeviceProperties2),
+    NULL_FUNCTION(vkGetPhysicalDeviceFeatures, NullGetPhysicalDeviceFeatures),
+    NULL_FUNCTION(vkGetPhysicalDeviceFeatures2,
+                  NullGetPhysicalDeviceFeatures2),
+    NULL_FUNCTION(vkGetPhysicalDeviceFeatures2KHR,
+                  NullGetPhysicalDeviceFeatures2),
+    NULL_FUNCTION(vkGetPhysicalDeviceMemoryProperties,
+                  NullGetPhysicalDeviceMemoryProperties),
+    NULL_FUNCTION(vkGetPhysicalDeviceMemoryProperties2,
+                  NullGetPhysicalDeviceMemoryProperties2),
+    NULL_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties,
+                  NullGetPhysicalDeviceQueueFamilyProperties),
+    NULL_FUNCTION(vkGetPhysicalDeviceFormatProperties,
+                  NullGetPhysicalDeviceFormatProperties),
+    NULL_FUNCTION(vkGetPhysicalDeviceImageFormatProperties,
+                  NullGetPhysicalDeviceImageFormatProperties),
+    NULL_FUNCTION(vkGetPhysicalDeviceImageFormatProperties2,
+                  NullGetPhysicalDeviceImageFormatProperties2),
+    NULL_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties,
+                  NullGetPhysicalDeviceSparseImageFormatProperties),
+    NULL_FUNCTION(vkEnumerateDeviceExtensionProperties,
+                  NullEnumerateDeviceExtensionProperties),
+    NULL_FUNCTION(vkEnumerateDeviceLayerProperties,
+                  NullEnumerateDeviceLayerProperties),
+    NULL_FUNCTION(vkCreateDevice, NullCreate),
+    NULL_FUNCTION(vkGetDeviceQueue, NullGetDeviceQueue),
+    NULL_FUNCTION(vkAllocateMemory, NullAllocateMemory),
+    NULL_FUNCTION(vkFreeMemory, NullFreeMemory),
+    NULL_FUNCTION(vkMapMemory, NullMapMemory),
+    NULL_FUNCTION(vkCreateBuffer, NullCreateBuffer),
+    NULL_FUNCTION(vkDestroyBuffer, NullDestroyObject),
+    NULL_FUNCTION(vkCreateImage, NullCreateImage),
+    NULL_FUNCTION(vkDestroyImage, NullDestroyObject),
+    NULL_FUNCTION(vkGetBufferMemoryRequirements, NullGetMemoryRequirements),
+    NULL_FUNCTION(vkGetImageMemoryRequirements, NullGetMemoryRequirements),
+    NULL_FUNCTION(vkGetImageMemoryRequirements2KHR,
+                  NullGetImageMemoryRequirements2),
+    NULL_FUNCTION(vkGetImageSparseMemoryRequirements,
+                  NullGetImageSparseMemoryRequirements),
+    NULL_FUNCTION(vkGetImageSubresourceLayout, NullGetImageSubresourceLayout),
+    NULL_FUNCTION(vkGetBufferDeviceAddressKHR, NullGetBufferDeviceAddress),
+    NULL_FUNCTION(vkAllocateCommandBuffers, NullAllocateCommandBuffers),
+    NULL_FUNCTION(vkAllocateDescriptorSets, NullAllocateDescriptorSets),
+    NULL_FUNCTION(vkCreateGraphicsPipelines, NullCreatePipelines),
+    NULL_FUNCTION(vkCreateComputePipelines, NullCreatePipelines),
+    NULL_FUNCTION(vkCreateBufferView, NullCreate),
+    NULL_FUNCTION(vkCreateCommandPool, NullCreate),
+    NULL_FUNCTION(vkCreateDescriptorPool, NullCreate),
+    NULL_FUNCTION(vkCreateDescriptorSetLayout, NullCreate),
+    NULL_FUNCTION(vkCreateDescriptorUpdateTemplateKHR, NullCreate),
+    NULL_FUNCTION(vkCreateEvent, NullCreate),
+    NULL_FUNCTION(vkCreateFence, NullCreate),
+    NULL_FUNCTION(vkCreateFramebuffer, NullCreate),
+    NULL_FUNCTION(vkCreateImageView, NullCreate),
+    NULL_FUNCTION(vkCreatePipelineCache, NullCreate),
+    NULL_FUNCTION(vkCreatePipelineLayout, NullCreate),
+    NULL_FUNCTION(vkCreateQueryPool, NullCreate),
+    NULL_FUNCTION(vkCreateRenderPass, NullCreate),
+    NULL_FUNCTION(vkCreateRenderPass2KHR, NullCreate),
+    NULL_FUNCTION(vkCreateSampler, NullCreate),
+    NULL_FUNCTION(vkCreateSamplerYcbcrConversionKHR, NullCreate),
+    NULL_FUNCTION(vkCreateSemaphore, NullCreate),
+    NULL_FUNCTION(vkCreateShaderModule, NullCreate),
+    NULL_FUNCTION(vkCreateSwapchainKHR, NullCreate),
+    NULL_FUNCTION(vkCreateDebugUtilsMessengerEXT, NullCreate),
+    NULL_FUNCTION(vkGetQueryPoolResults, NullGetQueryPoolResults),
+    NULL_FUNCTION(vkGetPipelineCacheData, NullGetPipelineCacheData),
+    NULL_FUNCTION(vkGetEventStatus, NullGetEventStatus),
+    NULL_FUNCTION(vkGetRenderAreaGranularity, NullGetRenderAreaGranularity),
+    NULL_FUNCTION(vkGetDeviceGroupPeerMemoryFeatures,
+                  NullGetDeviceGroupPeerMemoryFeatures),
+};
+#undef NULL_FUNCTION
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+NullGetInstanceProcAddr(::VkInstance, const char* name) {
+  for (const NullFunction& function : kNullFunctions) {
+    if (strcmp(function.name, name) == 0) {
+      return function.function;
+    }
+  }
+  return reinterpret_cast<PFN_vkVoidFunction>(&NullSuccess);
+}
+
+}  // anonymous namespace
+
+PFN_vkGetInstanceProcAddr GetNullDriverProcAddr() {
+  return &NullGetInstanceProcAddr;
+}
+
+}  // namespace vulkan
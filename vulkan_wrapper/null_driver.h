@@ -0,0 +1,44 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_WRAPPER_NULL_DRIVER_H_
+#define VULKAN_WRAPPER_NULL_DRIVER_H_
+
+#include "vulkan_helpers/vulkan_header_wrapper.h"
+
+namespace vulkan {
+
+// Returns the vkGetInstanceProcAddr of a driver that does nothing, which
+// LibraryWrapper uses instead of the one of libvulkan for -null-driver.
+//
+// Every function of the null driver returns VK_SUCCESS right away. Objects
+// are counters cast to handles, except for memory, buffers and images, which
+// keep their size so that memory requirements can be reported and memory can
+// be mapped. Memory is backed by host memory. It reports one physical device
+// with one queue family that supports everything, every feature of
+// VkPhysicalDeviceFeatures and a few device extensions, and queries, such as
+// vkGetQueryPoolResults, read back zeros. Features and properties that are
+// chained into the *2 queries are left as they are.
+//
+// This only measures the CPU time spent outside of the driver, it does not
+// render anything. Functions that the null driver does not know about all
+// resolve to the same stub that only returns VK_SUCCESS, which relies on the
+// caller cleaning up its arguments, so this can not be used where
+// VKAPI_CALL is __stdcall, on 32 bit Windows.
+PFN_vkGetInstanceProcAddr GetNullDriverProcAddr();
+
+}  // namespace vulkan
+
+#endif  // VULKAN_WRAPPER_NULL_DRIVER_H_
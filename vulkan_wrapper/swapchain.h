@@ -33,10 +33,11 @@ class VkSwapchainKHR : public VkSubObject<SwapchainTraits, DeviceTraits> {
  public:
   VkSwapchainKHR(::VkSwapchainKHR swapchain, VkAllocationCallbacks* allocator,
                  VkDevice* device, uint32_t width, uint32_t height,
-                 uint32_t depth, VkFormat format)
+                 uint32_t depth, VkFormat format, VkImageUsageFlags usage)
       : VkSubObject<SwapchainTraits, DeviceTraits>(swapchain, allocator,
                                                    device),
         format_(format),
+        usage_(usage),
         width_(width),
         height_(height),
         depth_(depth) {}
@@ -44,17 +45,33 @@ class VkSwapchainKHR : public VkSubObject<SwapchainTraits, DeviceTraits> {
   VkSwapchainKHR(VkSwapchainKHR&& other)
       : VkSubObject<SwapchainTraits, DeviceTraits>(std::move(other)),
         format_(other.format_),
+        usage_(other.usage_),
         width_(other.width_),
         height_(other.height_),
         depth_(other.depth_) {}
 
+  // Destroys the currently held swapchain, and takes over |other|. |other|
+  // should have been created with this swapchain as its oldSwapchain.
+  VkSwapchainKHR& operator=(VkSwapchainKHR&& other) {
+    reset(other.release());
+    format_ = other.format_;
+    usage_ = other.usage_;
+    width_ = other.width_;
+    height_ = other.height_;
+    depth_ = other.depth_;
+    return *this;
+  }
+
   uint32_t width() const { return width_; }
   uint32_t height() const { return height_; }
   uint32_t depth() const { return depth_; }
   VkFormat format() const { return format_; }
+  // The usage that the images of the swapchain were created with.
+  VkImageUsageFlags usage() const { return usage_; }
 
  private:
   VkFormat format_;
+  VkImageUsageFlags usage_;
   uint32_t width_;
   uint32_t height_;
   uint32_t depth_;